@@ -0,0 +1,56 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct AudioLevel
+{
+    float peak = 0;
+    float rms = 0;
+
+    /**
+     * @brief Loudness normalized to a full scale sine wave, as used for the input threshold.
+     */
+    float volume() const
+    {
+        const float rootTwo = 1.414213562f; // sqrt(2), but sqrt is not constexpr
+        return std::min(rms * rootTwo, 1.0f);
+    }
+
+    static AudioLevel measure(const int16_t* pcm, size_t samples);
+};
+
+class AudioLevelMeter
+{
+public:
+    AudioLevelMeter() = default;
+    AudioLevelMeter(const AudioLevelMeter&) = delete;
+    AudioLevelMeter& operator=(const AudioLevelMeter&) = delete;
+
+    void publish(const AudioLevel& level);
+    AudioLevel take();
+
+private:
+    std::atomic<uint32_t> packed{0};
+};
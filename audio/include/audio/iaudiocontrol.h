@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include "audio/audiolevel.h"
+
 #include <QObject>
 #include <QStringList>
 #include <memory>
@@ -92,6 +94,21 @@
  * @brief set the input threshold
  *
  * @param[in] percent the new input threshold percentage
+ *
+ * @fn void IAudioControl::setVoiceGate(bool enabled)
+ * @brief gate the input by voice activity detection instead of the input threshold
+ *
+ * @param[in] enabled true to only send frames the voice activity detection accepts
+ *
+ * @fn qreal IAudioControl::getCaptureBacklogMs() const
+ * @brief get how much audio was still waiting in the capture device after the last frame
+ *
+ * @return backlog in milliseconds
+ *
+ * @fn AudioLevel IAudioControl::takeInputLevel()
+ * @brief get the loudest input level since the last call, safe to poll from any thread
+ *
+ * @return input level, silence while the input gate is closed
  */
 
 class IAudioSink;
@@ -117,11 +134,14 @@ public:
 
     virtual qreal getInputThreshold() const = 0;
     virtual void setInputThreshold(qreal percent) = 0;
+    virtual void setVoiceGate(bool enabled) = 0;
 
     virtual void reinitInput(const QString& inDevDesc) = 0;
     virtual bool reinitOutput(const QString& outDevDesc) = 0;
 
     virtual bool isOutputReady() const = 0;
+    virtual qreal getCaptureBacklogMs() const = 0;
+    virtual AudioLevel takeInputLevel() = 0;
 
     virtual QStringList outDeviceNames() = 0;
     virtual QStringList inDeviceNames() = 0;
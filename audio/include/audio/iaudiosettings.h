@@ -25,6 +25,13 @@
 
 class IAudioSettings {
 public:
+    enum class InputMode
+    {
+        Voice = 0,
+        MicArray = 1,
+        Music = 2
+    };
+
     IAudioSettings() = default;
     virtual ~IAudioSettings();
     IAudioSettings(const IAudioSettings&) = default;
@@ -64,6 +71,9 @@ public:
     virtual int getScreenVideoFPS() const = 0;
     virtual void setScreenVideoFPS(int newValue) = 0;
 
+    virtual int getVideoEncoderPreset() const = 0;
+    virtual void setVideoEncoderPreset(int newValue) = 0;
+
     virtual bool getEchoCancellation() const = 0;
     virtual void setEchoCancellation(bool newValue) = 0;
 
@@ -76,6 +86,18 @@ public:
     virtual int getAecechonsmode() const = 0;
     virtual void setAecechonsmode(int newValue) = 0;
 
+    virtual bool getFullAudioProcessing() const = 0;
+    virtual void setFullAudioProcessing(bool newValue) = 0;
+
+    virtual bool getAudioTransientSuppression() const = 0;
+    virtual void setAudioTransientSuppression(bool newValue) = 0;
+
+    virtual bool getAudioVoiceGate() const = 0;
+    virtual void setAudioVoiceGate(bool newValue) = 0;
+
+    virtual InputMode getAudioInputMode() const = 0;
+    virtual void setAudioInputMode(InputMode newValue) = 0;
+
     DECLARE_SIGNAL(inDevChanged, const QString& device);
     DECLARE_SIGNAL(audioInDevEnabledChanged, bool enabled);
 
@@ -89,8 +111,13 @@ public:
     DECLARE_SIGNAL(enableTestSoundChanged, bool newValue);
 
     DECLARE_SIGNAL(screenVideoFPSChanged, int fps);
+    DECLARE_SIGNAL(videoEncoderPresetChanged, int preset);
     DECLARE_SIGNAL(echoCancellationChanged, bool newValue);
     DECLARE_SIGNAL(echoLatencyChanged, int latency_ms);
     DECLARE_SIGNAL(aecechomodeChanged, int mode);
     DECLARE_SIGNAL(aecechonsmodeChanged, int mode);
+    DECLARE_SIGNAL(fullAudioProcessingChanged, bool newValue);
+    DECLARE_SIGNAL(audioTransientSuppressionChanged, bool newValue);
+    DECLARE_SIGNAL(audioVoiceGateChanged, bool newValue);
+    DECLARE_SIGNAL(audioInputModeChanged, IAudioSettings::InputMode mode);
 };
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 
 #include <QObject>
 
@@ -53,6 +54,24 @@
  * @param[in] channels number of channels, currently 1 or 2 is supported
  * @param[in] sampleRate sample rate in Hertz
  *
+ * @fn qreal IAudioSink::getQueuedMs() const
+ * @brief Duration of the audio queued by playAudioBuffer that didn't play yet
+ *
+ * @return queued audio in milliseconds
+ *
+ * @fn uint64_t IAudioSink::getLateFrames() const
+ * @brief Frames given to playAudioBuffer that were too late to play on time
+ *
+ * Counts frames dropped because too much audio was queued, and frames that arrived after the
+ * queue ran dry.
+ *
+ * @return late frames since the sink was created
+ *
+ * @fn void IAudioSink::setExtraPlayoutFrames(unsigned frames)
+ * @brief buffer more frames than the jitter estimate asks for before playing
+ *
+ * @param[in] frames frames to add to the playout delay
+ *
  * @fn void IAudioSink::playMono16Sound(const Sound& sound)
  * @brief Play a 44100Hz mono 16bit PCM sound from the builtin sounds.
  *
@@ -105,6 +124,9 @@ public:
 
     virtual void playAudioBuffer(const int16_t* data, int samples, unsigned channels,
                                  int sampleRate) const = 0;
+    virtual qreal getQueuedMs() const = 0;
+    virtual uint64_t getLateFrames() const = 0;
+    virtual void setExtraPlayoutFrames(unsigned frames) = 0;
     virtual void playMono16Sound(const Sound& sound) = 0;
     virtual void startLoop() = 0;
     virtual void stopLoop() = 0;
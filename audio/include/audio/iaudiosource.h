@@ -40,6 +40,5 @@ public:
 signals:
     void frameAvailable(const int16_t* pcm, size_t sample_count, uint8_t channels,
                         uint32_t sampling_rate);
-    void volumeAvailable(qreal value);
     void invalidated();
 };
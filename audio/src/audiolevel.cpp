@@ -0,0 +1,153 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audio/audiolevel.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIOLEVEL_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define AUDIOLEVEL_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * @struct AudioLevel
+ * @brief Peak and RMS level of an audio frame, both normalized to [0, 1].
+ *
+ * @fn AudioLevel AudioLevel::measure(const int16_t* pcm, size_t samples)
+ * @brief Measures the level of interleaved 16 bit samples.
+ *
+ * Runs on the thread that owns the samples, eight samples at a time with SSE2 or NEON and
+ * with a scalar loop on other platforms and for the tail.
+ *
+ * @param pcm Samples of all channels.
+ * @param samples Number of samples of all channels.
+ */
+
+/**
+ * @class AudioLevelMeter
+ * @brief Hands audio levels from an audio thread to a GUI polling at its own rate.
+ *
+ * Peak and RMS are packed into a single atomic, so publishing never blocks the audio thread and
+ * no signal has to cross threads per frame. The meter keeps the loudest level published since
+ * the last take(), so a slow poll doesn't miss short sounds.
+ */
+
+namespace {
+constexpr float FULL_SCALE = 32767.0f;
+constexpr uint32_t LEVEL_STEPS = 0xFFFF;
+
+uint32_t toSteps(float value)
+{
+    return static_cast<uint32_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * LEVEL_STEPS));
+}
+} // namespace
+
+AudioLevel AudioLevel::measure(const int16_t* pcm, size_t samples)
+{
+    AudioLevel level;
+    if (samples == 0) {
+        return level;
+    }
+
+    size_t i = 0;
+    int32_t peak = 0;
+    uint64_t sumOfSquares = 0;
+#if defined(AUDIOLEVEL_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i peaks = zero;
+    __m128i sums = zero;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        // saturating negation, so -32768 counts as 32767 instead of wrapping around
+        peaks = _mm_max_epi16(peaks, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+        // two squares per lane fit into 32 bit when read as unsigned, widen before summing
+        const __m128i squares = _mm_madd_epi16(v, v);
+        sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(squares, zero));
+        sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(squares, zero));
+    }
+    alignas(16) int16_t peakLanes[8];
+    alignas(16) uint64_t sumLanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(peakLanes), peaks);
+    _mm_store_si128(reinterpret_cast<__m128i*>(sumLanes), sums);
+    peak = *std::max_element(peakLanes, peakLanes + 8);
+    sumOfSquares = sumLanes[0] + sumLanes[1];
+#elif defined(AUDIOLEVEL_NEON)
+    int16x8_t peaks = vdupq_n_s16(0);
+    uint64x2_t sums = vdupq_n_u64(0);
+    for (; i + 8 <= samples; i += 8) {
+        const int16x8_t v = vld1q_s16(pcm + i);
+        peaks = vmaxq_s16(peaks, vqabsq_s16(v));
+        const int32x4_t low = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        const int32x4_t high = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        sums = vpadalq_u32(sums, vreinterpretq_u32_s32(low));
+        sums = vpadalq_u32(sums, vreinterpretq_u32_s32(high));
+    }
+    alignas(16) int16_t peakLanes[8];
+    vst1q_s16(peakLanes, peaks);
+    peak = *std::max_element(peakLanes, peakLanes + 8);
+    sumOfSquares = vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1);
+#endif
+    for (; i < samples; ++i) {
+        const int32_t sample = pcm[i];
+        peak = std::max(peak, std::min<int32_t>(std::abs(sample), 32767));
+        sumOfSquares += static_cast<uint64_t>(sample * sample);
+    }
+
+    level.peak = static_cast<float>(peak) / FULL_SCALE;
+    level.rms = std::min(
+        static_cast<float>(std::sqrt(static_cast<double>(sumOfSquares) / samples)) / FULL_SCALE,
+        1.0f);
+    return level;
+}
+
+/**
+ * @brief Publishes the level of a frame, keeping the louder level of each kind.
+ * @note Lock free, safe to call from the audio thread.
+ */
+void AudioLevelMeter::publish(const AudioLevel& level)
+{
+    const uint32_t peak = toSteps(level.peak);
+    const uint32_t rms = toSteps(level.rms);
+    uint32_t current = packed.load(std::memory_order_relaxed);
+    uint32_t next;
+    do {
+        next = (std::max(current >> 16, peak) << 16) | std::max(current & LEVEL_STEPS, rms);
+        if (next == current) {
+            return;
+        }
+    } while (!packed.compare_exchange_weak(current, next, std::memory_order_release,
+                                           std::memory_order_relaxed));
+}
+
+/**
+ * @brief Takes the loudest level published since the last call and resets the meter.
+ */
+AudioLevel AudioLevelMeter::take()
+{
+    const uint32_t value = packed.exchange(0, std::memory_order_acquire);
+    AudioLevel level;
+    level.peak = static_cast<float>(value >> 16) / LEVEL_STEPS;
+    level.rms = static_cast<float>(value & LEVEL_STEPS) / LEVEL_STEPS;
+    return level;
+}
@@ -50,6 +50,37 @@ void AlSink::playAudioBuffer(const int16_t* data, int samples, unsigned channels
     }
 }
 
+qreal AlSink::getQueuedMs() const
+{
+    QMutexLocker locker{&killLock};
+
+    if (killed) {
+        return 0;
+    }
+
+    return audio.getQueuedMs(sourceId);
+}
+
+uint64_t AlSink::getLateFrames() const
+{
+    QMutexLocker locker{&killLock};
+
+    if (killed) {
+        return 0;
+    }
+
+    return audio.getLateFrames(sourceId);
+}
+
+void AlSink::setExtraPlayoutFrames(unsigned frames)
+{
+    QMutexLocker locker{&killLock};
+
+    if (!killed) {
+        audio.setExtraPlayoutFrames(sourceId, frames);
+    }
+}
+
 void AlSink::playMono16Sound(const IAudioSink::Sound& sound)
 {
     QMutexLocker locker{&killLock};
@@ -40,6 +40,9 @@ public:
     ~AlSink();
 
     void playAudioBuffer(const int16_t* data, int samples, unsigned channels, int sampleRate) const override;
+    qreal getQueuedMs() const override;
+    uint64_t getLateFrames() const override;
+    void setExtraPlayoutFrames(unsigned frames) override;
     void playMono16Sound(const IAudioSink::Sound& sound) override;
     void startLoop() override;
     void stopLoop() override;
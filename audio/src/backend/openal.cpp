@@ -20,6 +20,11 @@
 #include "openal.h"
 
 #include "audio/iaudiosettings.h"
+#include "util/lockprofiler.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
+#include "util/tracer.h"
+#include "webrtc6/webrtc/common_audio/vad/include/webrtc_vad.h"
 
 #include <QDateTime>
 #include <QDebug>
@@ -30,6 +35,7 @@
 #include <QWaitCondition>
 #include <QtMath>
 
+#include <algorithm>
 #include <cassert>
 
 namespace {
@@ -48,18 +54,43 @@ void applyGain(int16_t* buffer, uint32_t bufferSize, qreal gainFactor)
  * @brief Provides the OpenAL audio backend
  *
  * @var BUFFER_COUNT
- * @brief Number of buffers to use per audio source
+ * @brief Number of buffers to use per audio source, allocated once as a ring
+ *
+ * @var MIN_PLAYOUT_FRAMES
+ * @brief Frames buffered before a stream starts playing, even on a perfect network
+ *
+ * @var MAX_PLAYOUT_DELAY_MS
+ * @brief Upper bound of the playout delay, more jitter than that is played as gaps
+ *
+ * @var JITTER_FACTOR
+ * @brief Playout delay in multiples of the measured arrival jitter
+ *
+ * @var ARRIVAL_GAP_MS
+ * @brief Arrival gaps above this are a paused stream, e.g. silence suppression, not jitter
+ *
+ * @var VOICE_GATE_VAD_MODE
+ * @brief Aggressiveness of the voice gate from 0 to 3, higher values report voice less often
+ *
+ * @var MIN_CAPTURE_WAIT_MS
+ * @brief Shortest wait between two looks at the capture device, keeps a device that reports
+ * samples slowly from spinning the audio thread
  *
  * @var AUDIO_CHANNELS
  * @brief Ideally, we'd auto-detect, but that's a sane default
  */
 
-const unsigned int BUFFER_COUNT = 16;
 const uint32_t AUDIO_CHANNELS = 1;
 } // namespace
 
 constexpr qreal OpenAL::minInGain;
 constexpr qreal OpenAL::maxInGain;
+constexpr ALuint OpenAL::BUFFER_COUNT;
+constexpr qreal OpenAL::MIN_PLAYOUT_FRAMES;
+constexpr qreal OpenAL::MAX_PLAYOUT_DELAY_MS;
+constexpr qreal OpenAL::JITTER_FACTOR;
+constexpr qreal OpenAL::ARRIVAL_GAP_MS;
+constexpr int OpenAL::VOICE_GATE_VAD_MODE;
+constexpr int OpenAL::MIN_CAPTURE_WAIT_MS;
 
 OpenAL::OpenAL(IAudioSettings& _settings)
     : settings{_settings}
@@ -73,8 +104,14 @@ OpenAL::OpenAL(IAudioSettings& _settings)
     QObject::connect(audioThread, &QThread::finished, &voiceTimer, &QTimer::stop);
     QObject::connect(audioThread, &QThread::finished, &captureTimer, &QTimer::stop);
     QObject::connect(audioThread, &QThread::finished, audioThread, &QThread::deleteLater);
+    QObject::connect(audioThread, &QThread::started, this, []() {
+        ThreadCpuTime::registerCurrentThread(QStringLiteral("OpenAL"));
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::RealtimeAudio);
+    });
+    QObject::connect(audioThread, &QThread::finished, this,
+                     &ThreadCpuTime::unregisterCurrentThread, Qt::DirectConnection);
 
-    // audioThread->setPriority(QThread::HighPriority);
+    playbackClock.start();
 
     moveToThread(audioThread);
 
@@ -84,9 +121,11 @@ OpenAL::OpenAL(IAudioSettings& _settings)
             static_cast<void (QTimer::*)(int)>(&QTimer::start));
     connect(&voiceTimer, &QTimer::timeout, this, &OpenAL::stopActive);
 
+    // rearmed by doAudio for the time until the next frame is complete
     connect(&captureTimer, &QTimer::timeout, this, &OpenAL::doAudio);
-    captureTimer.setInterval(AUDIO_FRAME_DURATION / 4);
-    captureTimer.setSingleShot(false);
+    captureTimer.setInterval(AUDIO_FRAME_DURATION);
+    captureTimer.setSingleShot(true);
+    captureTimer.setTimerType(Qt::PreciseTimer);
     captureTimer.moveToThread(audioThread);
     // TODO for Qt 5.6+: use qOverload
     connect(audioThread, &QThread::started, &captureTimer,
@@ -131,7 +170,7 @@ void OpenAL::checkAlcError(ALCdevice* device) noexcept
  */
 void OpenAL::setOutputVolume(qreal volume)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     volume = std::max(0.0, std::min(volume, 1.0));
 
@@ -146,7 +185,7 @@ void OpenAL::setOutputVolume(qreal volume)
  */
 qreal OpenAL::minInputGain() const
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     return minInGain;
 }
 
@@ -157,7 +196,7 @@ qreal OpenAL::minInputGain() const
  */
 qreal OpenAL::maxInputGain() const
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     return maxInGain;
 }
 
@@ -168,7 +207,7 @@ qreal OpenAL::maxInputGain() const
  */
 qreal OpenAL::minInputThreshold() const
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     return minInThreshold;
 }
 
@@ -179,13 +218,13 @@ qreal OpenAL::minInputThreshold() const
  */
 qreal OpenAL::maxInputThreshold() const
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     return maxInThreshold;
 }
 
 void OpenAL::reinitInput(const QString& inDevDesc)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     const auto bakSources = sources;
     sources.clear();
@@ -203,7 +242,7 @@ void OpenAL::reinitInput(const QString& inDevDesc)
 
 bool OpenAL::reinitOutput(const QString& outDevDesc)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     const auto bakSinks = sinks;
 
@@ -228,7 +267,7 @@ bool OpenAL::reinitOutput(const QString& outDevDesc)
  */
 std::unique_ptr<IAudioSink> OpenAL::makeSink()
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     if (!autoInitOutput()) {
         qWarning("Failed to subscribe to audio output device.");
@@ -256,7 +295,7 @@ std::unique_ptr<IAudioSink> OpenAL::makeSink()
  */
 void OpenAL::destroySink(AlSink& sink)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     const auto sinksErased = sinks.erase(&sink);
     const auto soundSinksErased = soundSinks.erase(&sink);
@@ -272,6 +311,7 @@ void OpenAL::destroySink(AlSink& sink)
         // stop playing, marks all buffers as processed
         alSourceStop(sid);
         cleanupBuffers(sid);
+        releasePlaybackQueue(sid);
         qDebug() << "Audio source" << sid << "deleted. Sources active:" << sinks.size();
     } else {
         qWarning() << "Trying to delete invalid audio source" << sid;
@@ -289,7 +329,7 @@ void OpenAL::destroySink(AlSink& sink)
  */
 std::unique_ptr<IAudioSource> OpenAL::makeSource()
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     if (!autoInitInput()) {
         qWarning("Failed to subscribe to audio input device.");
@@ -315,7 +355,7 @@ std::unique_ptr<IAudioSource> OpenAL::makeSource()
  */
 void OpenAL::destroySource(AlSource& source)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     const auto s = sources.find(&source);
     if (s == sources.end()) {
@@ -354,7 +394,9 @@ bool OpenAL::autoInitOutput()
 
 bool OpenAL::initInput(const QString& deviceName)
 {
-    return initInput(deviceName, AUDIO_CHANNELS);
+    // OpenAL only captures mono or stereo, the array and music modes need both channels
+    const bool stereo = settings.getAudioInputMode() != IAudioSettings::InputMode::Voice;
+    return initInput(deviceName, stereo ? 2 : AUDIO_CHANNELS);
 }
 
 bool OpenAL::initInput(const QString& deviceName, uint32_t channels)
@@ -377,6 +419,8 @@ bool OpenAL::initInput(const QString& deviceName, uint32_t channels)
 
     const QByteArray qDevName = deviceName.toUtf8();
     const ALchar* tmpDevName = qDevName.isEmpty() ? nullptr : qDevName.constData();
+    // OpenAL doesn't report the native rate of capture devices, the backend converts to our rate
+    // once and the call DSP only resamples further down to its own processing rate
     alInDev = alcCaptureOpenDevice(tmpDevName, AUDIO_SAMPLE_RATE, stereoFlag, ringBufSize);
 
     // Restart the capture if necessary
@@ -388,6 +432,15 @@ bool OpenAL::initInput(const QString& deviceName, uint32_t channels)
     inputBuffer = new int16_t[AUDIO_FRAME_SAMPLE_COUNT_TOTAL];
     setInputGain(settings.getAudioInGainDecibel());
     setInputThreshold(settings.getAudioThreshold());
+    setVoiceGate(settings.getAudioVoiceGate());
+
+    inputVad = WebRtcVad_Create();
+    if (!inputVad || WebRtcVad_Init(inputVad) != 0
+        || WebRtcVad_set_mode(inputVad, VOICE_GATE_VAD_MODE) != 0) {
+        qWarning() << "Failed to initialize the voice gate, falling back to the input threshold";
+        WebRtcVad_Free(inputVad);
+        inputVad = nullptr;
+    }
 
     qDebug() << "Opened audio input" << deviceName;
     alcCaptureStart(alInDev);
@@ -420,7 +473,10 @@ bool OpenAL::initOutput(const QString& deviceName)
     }
 
     qDebug() << "Opened audio output" << deviceName;
-    alOutContext = alcCreateContext(alOutDev, nullptr);
+    // Mix at the rate calls and sounds are decoded at. Otherwise OpenAL mixes at its configured
+    // default, e.g. 44.1kHz, and a 48kHz sound server resamples everything back up again.
+    const ALCint attributes[] = {ALC_FREQUENCY, static_cast<ALCint>(AUDIO_SAMPLE_RATE), 0};
+    alOutContext = alcCreateContext(alOutDev, attributes);
     checkAlcError(alOutDev);
 
     if (!alcMakeContextCurrent(alOutContext)) {
@@ -428,54 +484,114 @@ bool OpenAL::initOutput(const QString& deviceName)
         return false;
     }
 
+    ALCint mixRate = 0;
+    alcGetIntegerv(alOutDev, ALC_FREQUENCY, 1, &mixRate);
+    if (mixRate != static_cast<ALCint>(AUDIO_SAMPLE_RATE)) {
+        qDebug() << "Audio output mixes at" << mixRate << "Hz, playback is resampled once";
+    }
+
     // init master volume
     alListenerf(AL_GAIN, settings.getOutVolume() * 0.01f);
     checkAlError();
 
     outputInitialized = true;
+
+    // upload the notification sounds now, not when the first message arrives
+    for (const auto sound : {IAudioSink::Sound::NewMessage, IAudioSink::Sound::Test,
+                             IAudioSink::Sound::IncomingCall, IAudioSink::Sound::OutgoingCall,
+                             IAudioSink::Sound::CallEnd}) {
+        soundBuffer(sound);
+    }
+
     return true;
 }
 
 /**
- * @brief Play a 48kHz mono 16bit PCM sound
+ * @brief Reads a builtin sound, only the first time it is asked for.
+ * @return 48kHz mono 16bit PCM, empty if the sound couldn't be read.
+ * @note audioLock must be locked.
  */
-void OpenAL::playMono16Sound(AlSink& sink, const IAudioSink::Sound& sound)
+const QByteArray& OpenAL::soundData(IAudioSink::Sound sound)
 {
-    const uint sourceId = sink.getSourceId();
+    auto it = sounds.find(sound);
+    if (it != sounds.end()) {
+        return it->second;
+    }
+
     QFile sndFile(IAudioSink::getSound(sound));
-    if (!sndFile.exists()) {
-        qDebug() << "Trying to open non-existent sound file";
-        return;
+    QByteArray data;
+    if (!sndFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Can't open sound file" << sndFile.fileName();
+    } else {
+        data = sndFile.readAll();
+        if (data.isEmpty()) {
+            qWarning() << "Sound file" << sndFile.fileName() << "contained no data";
+        }
+    }
+
+    // failures are kept too, trying again wouldn't change anything
+    return sounds.emplace(sound, data).first->second;
+}
+
+/**
+ * @brief Buffer holding a builtin sound on the open output device, uploaded on first use.
+ * @return Buffer id, 0 if the sound couldn't be read or the output isn't open.
+ * @note audioLock must be locked. The buffers go away with the device in cleanupOutput().
+ */
+ALuint OpenAL::soundBuffer(IAudioSink::Sound sound)
+{
+    if (!(alOutDev && outputInitialized)) {
+        return 0;
     }
 
-    sndFile.open(QIODevice::ReadOnly);
-    const QByteArray data{sndFile.readAll()};
+    auto it = soundBuffers.find(sound);
+    if (it != soundBuffers.end()) {
+        return it->second;
+    }
+
+    const QByteArray& data = soundData(sound);
     if (data.isEmpty()) {
-        qDebug() << "Sound file contained no data";
-        return;
+        return 0;
     }
 
-    QMutexLocker locker(&audioLock);
+    // drop errors of earlier calls, so only the upload is checked
+    alGetError();
+    ALuint bufid = 0;
+    alGenBuffers(1, &bufid);
+    alBufferData(bufid, AL_FORMAT_MONO16, data.constData(), data.size(), AUDIO_SAMPLE_RATE);
+    const ALenum error = alGetError();
+    if (error != AL_NO_ERROR) {
+        qWarning() << "Failed to upload sound" << IAudioSink::getSound(sound) << "error" << error;
+        alDeleteBuffers(1, &bufid);
+        return 0;
+    }
 
-    // interrupt possibly playing sound, we don't buffer here
-    alSourceStop(sourceId);
+    soundBuffers.emplace(sound, bufid);
+    return bufid;
+}
 
-    ALint processed = 0;
-    alGetSourcei(sourceId, AL_BUFFERS_PROCESSED, &processed);
-    alSourcei(sourceId, AL_LOOPING, AL_FALSE);
+/**
+ * @brief Play a 48kHz mono 16bit PCM sound
+ *
+ * Every sound has one buffer on the output device, attached to any number of sources, so
+ * playing a sound doesn't read or upload anything.
+ */
+void OpenAL::playMono16Sound(AlSink& sink, const IAudioSink::Sound& sound)
+{
+    const uint sourceId = sink.getSourceId();
 
-    ALuint bufid;
-    if (processed == 0) {
-        // create new buffer
-        alGenBuffers(1, &bufid);
-    } else {
-        // we only reserve space for one buffer
-        assert(processed == 1);
-        // unqueue all processed buffers
-        alSourceUnqueueBuffers(sourceId, processed, &bufid);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
+    const ALuint bufid = soundBuffer(sound);
+    if (bufid == 0) {
+        return;
     }
 
-    alBufferData(bufid, AL_FORMAT_MONO16, data.constData(), data.size(), AUDIO_SAMPLE_RATE);
+    // interrupt possibly playing sound, we don't buffer here
+    alSourceStop(sourceId);
+    // give streamed buffers back to the ring before replacing them
+    cleanupBuffers(sourceId);
+
+    alSourcei(sourceId, AL_LOOPING, AL_FALSE);
     alSourcei(sourceId, AL_BUFFER, bufid);
     alSourcePlay(sourceId);
     soundSinks.insert(&sink);
@@ -483,7 +599,7 @@ void OpenAL::playMono16Sound(AlSink& sink, const IAudioSink::Sound& sound)
 
 void OpenAL::cleanupSound()
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
     auto sinkIt = soundSinks.begin();
     while (sinkIt != soundSinks.end()) {
@@ -501,46 +617,211 @@ void OpenAL::cleanupSound()
     }
 }
 
+/**
+ * @brief Queues received audio on a source.
+ *
+ * Buffers come from a fixed ring per source instead of being generated and deleted per frame.
+ * Playback only starts, or restarts after running dry, once the playout delay is buffered. The
+ * delay follows the measured arrival jitter, frames arriving while the queue is far above it are
+ * dropped to bring the latency back down.
+ */
 void OpenAL::playAudioBuffer(uint sourceId, const int16_t* data, int samples, unsigned channels,
                              int sampleRate)
 {
+    TRACE_SCOPE("OpenAL::playAudioBuffer");
     assert(channels == 1 || channels == 2);
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
 
-    if (!(alOutDev && outputInitialized))
+    if (!(alOutDev && outputInitialized) || samples <= 0 || sampleRate <= 0)
         return;
 
-    ALuint bufids[BUFFER_COUNT];
-    ALint processed = 0, queued = 0;
-    alGetSourcei(sourceId, AL_BUFFERS_PROCESSED, &processed);
-    alGetSourcei(sourceId, AL_BUFFERS_QUEUED, &queued);
+    PlaybackQueue* queue = playbackQueue(sourceId);
+    if (!queue) {
+        return;
+    }
+
     alSourcei(sourceId, AL_LOOPING, AL_FALSE);
+    // return buffers that finished playing to the ring
+    cleanupBuffers(sourceId);
 
-    if (processed == 0) {
-        if (static_cast<ALuint>(queued) >= BUFFER_COUNT) {
-            // reached limit, drop audio
-            return;
-        }
-        // create new buffer if none got free and we're below the limit
-        alGenBuffers(1, bufids);
-    } else {
-        // unqueue all processed buffers
-        alSourceUnqueueBuffers(sourceId, processed, bufids);
-        // delete all but the first buffer, reuse first for new data
-        alDeleteBuffers(processed - 1, bufids + 1);
+    const qreal frameMs = samples * 1000.0 / sampleRate;
+    queue->onArrival(playbackClock.nsecsElapsed() / 1000000.0, frameMs);
+    const qreal targetMs = queue->targetDelayMs(frameMs);
+
+    const qreal queuedMs = queuedDurationMs(sourceId, frameMs);
+
+    if (queue->freeBuffers.empty() || queuedMs >= 2 * targetMs) {
+        // too much latency queued up, drop audio
+        ++queue->droppedFrames;
+        return;
     }
 
-    alBufferData(bufids[0], (channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, data,
+    const ALuint bufid = queue->freeBuffers.back();
+    queue->freeBuffers.pop_back();
+    alBufferData(bufid, (channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, data,
                  samples * 2 * channels, sampleRate);
-    alSourceQueueBuffers(sourceId, 1, bufids);
+    alSourceQueueBuffers(sourceId, 1, &bufid);
 
     ALint state;
     alGetSourcei(sourceId, AL_SOURCE_STATE, &state);
-    if (state != AL_PLAYING) {
+    if (state == AL_PLAYING) {
+        return;
+    }
+
+    if (!queue->buffering) {
+        // ran dry, buffer up to the playout delay again
+        queue->buffering = true;
+        ++queue->underruns;
+    }
+
+    if (queuedMs + frameMs >= targetMs) {
+        queue->buffering = false;
         alSourcePlay(sourceId);
     }
 }
 
+/**
+ * @brief Duration of the audio queued on a source that didn't play yet.
+ * @param sourceId Source to query.
+ * @return Queued audio in milliseconds, 0 for sources not fed by playAudioBuffer.
+ */
+qreal OpenAL::getQueuedMs(uint sourceId) const
+{
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
+
+    const auto it = playbackQueues.find(sourceId);
+    if (!(alOutDev && outputInitialized) || it == playbackQueues.end()) {
+        return 0;
+    }
+
+    return queuedDurationMs(sourceId, it->second.lastFrameMs);
+}
+
+/**
+ * @brief Frames of a source that were dropped or arrived after it ran dry.
+ * @param sourceId Source to query.
+ * @return Late frames, 0 for sources not fed by playAudioBuffer.
+ */
+uint64_t OpenAL::getLateFrames(uint sourceId) const
+{
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
+
+    const auto it = playbackQueues.find(sourceId);
+    if (it == playbackQueues.end()) {
+        return 0;
+    }
+
+    return it->second.droppedFrames + it->second.underruns;
+}
+
+/**
+ * @brief Makes a source buffer more frames before playing, e.g. to leave time for FEC recovery.
+ * @param sourceId Source to configure.
+ * @param frames Frames to add to the playout delay.
+ */
+void OpenAL::setExtraPlayoutFrames(uint sourceId, unsigned frames)
+{
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
+
+    if (!(alOutDev && outputInitialized)) {
+        return;
+    }
+
+    PlaybackQueue* queue = playbackQueue(sourceId);
+    if (queue) {
+        queue->extraFrames = frames;
+    }
+}
+
+/**
+ * @brief Estimates the queued audio from the buffer count, all buffers of a call have the same
+ *        frame duration.
+ */
+qreal OpenAL::queuedDurationMs(uint sourceId, qreal frameMs) const
+{
+    ALint queued = 0;
+    ALfloat playedSecs = 0;
+    alGetSourcei(sourceId, AL_BUFFERS_QUEUED, &queued);
+    alGetSourcef(sourceId, AL_SEC_OFFSET, &playedSecs);
+    return std::max<qreal>(0, queued * frameMs - playedSecs * 1000);
+}
+
+/**
+ * @brief Updates the interarrival jitter estimate, like RFC 3550 does for RTP.
+ * @param nowMs Arrival time of the frame.
+ * @param frameMs Duration of the frame.
+ */
+void OpenAL::PlaybackQueue::onArrival(qreal nowMs, qreal frameMs)
+{
+    if (lastArrivalMs >= 0) {
+        const qreal deviationMs = qAbs(nowMs - lastArrivalMs - lastFrameMs);
+        if (deviationMs < ARRIVAL_GAP_MS) {
+            jitterMs += (deviationMs - jitterMs) / 16;
+        }
+    }
+
+    lastArrivalMs = nowMs;
+    lastFrameMs = frameMs;
+}
+
+/**
+ * @brief Playout delay to buffer before playing.
+ * @param frameMs Duration of the current frames.
+ * @return Delay in milliseconds.
+ */
+qreal OpenAL::PlaybackQueue::targetDelayMs(qreal frameMs) const
+{
+    const qreal minMs = (MIN_PLAYOUT_FRAMES + extraFrames) * frameMs;
+    // keep room in the ring for the drop threshold of twice the target
+    const qreal maxMs = std::max(minMs, std::min(MAX_PLAYOUT_DELAY_MS, BUFFER_COUNT * frameMs / 2));
+    return qBound(minMs, frameMs + JITTER_FACTOR * jitterMs, maxMs);
+}
+
+/**
+ * @brief Returns the playback queue of a source, allocating its buffer ring on first use.
+ * @param sourceId Source to get the queue for.
+ * @return Queue, or nullptr if the buffers could not be allocated.
+ */
+OpenAL::PlaybackQueue* OpenAL::playbackQueue(uint sourceId)
+{
+    auto it = playbackQueues.find(sourceId);
+    if (it != playbackQueues.end()) {
+        return &it->second;
+    }
+
+    PlaybackQueue queue;
+    alGetError();
+    alGenBuffers(BUFFER_COUNT, queue.ring.data());
+    if (alGetError() != AL_NO_ERROR) {
+        qWarning() << "Failed to allocate playback buffers for source" << sourceId;
+        return nullptr;
+    }
+
+    queue.freeBuffers.assign(queue.ring.rbegin(), queue.ring.rend());
+    return &playbackQueues.emplace(sourceId, std::move(queue)).first->second;
+}
+
+/**
+ * @brief Deletes the buffer ring of a source, all its buffers must be unqueued.
+ * @param sourceId Source to delete the ring of.
+ */
+void OpenAL::releasePlaybackQueue(uint sourceId)
+{
+    auto it = playbackQueues.find(sourceId);
+    if (it == playbackQueues.end()) {
+        return;
+    }
+
+    const PlaybackQueue& queue = it->second;
+    if (queue.droppedFrames > 0 || queue.underruns > 0) {
+        qDebug() << "Audio source" << sourceId << "dropped" << queue.droppedFrames
+                 << "late frames and ran dry" << queue.underruns << "times";
+    }
+
+    alDeleteBuffers(BUFFER_COUNT, queue.ring.data());
+    playbackQueues.erase(it);
+}
+
 /**
  * @brief Close active audio input device.
  */
@@ -558,6 +839,8 @@ void OpenAL::cleanupInput()
     }
 
     delete[] inputBuffer;
+    WebRtcVad_Free(inputVad);
+    inputVad = nullptr;
 }
 
 /**
@@ -566,6 +849,9 @@ void OpenAL::cleanupInput()
 void OpenAL::cleanupOutput()
 {
     outputInitialized = false;
+    // buffers are freed together with the device
+    playbackQueues.clear();
+    soundBuffers.clear();
 
     if (alOutDev) {
         if (!alcMakeContextCurrent(nullptr)) {
@@ -585,26 +871,39 @@ void OpenAL::cleanupOutput()
 }
 
 /**
- * @brief Called by doCapture to calculate volume of the audio buffer
+ * @brief Called by doInput to run voice activity detection on the audio buffer
  *
- * @param[in] buf   the current audio buffer
+ * Stereo input is downmixed first, the VAD only takes mono audio. A frame has voice if any of
+ * its 10ms blocks has voice.
  *
- * @return normalized volume between 0-1
+ * @return true if the frame contains speech or can't be analyzed
  */
-qreal OpenAL::getVolume()
+bool OpenAL::hasVoice()
 {
-    const quint32 samples = AUDIO_FRAME_SAMPLE_COUNT_TOTAL;
-    const qreal rootTwo = 1.414213562; // sqrt(2), but sqrt is not constexpr
-    // calculate volume as the root mean squared of amplitudes in the sample
-    qreal sumOfSquares = 0;
-    for (quint32 i = 0; i < samples; i++) {
-        auto sample = static_cast<qreal>(inputBuffer[i]) / std::numeric_limits<int16_t>::max();
-        sumOfSquares += std::pow(sample, 2);
+    const uint32_t samples = AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL;
+    const int16_t* mono = inputBuffer;
+    if (inputChannels > 1) {
+        for (uint32_t i = 0; i < samples; ++i) {
+            int32_t sum = 0;
+            for (int c = 0; c < inputChannels; ++c) {
+                sum += inputBuffer[i * inputChannels + c];
+            }
+            vadBuffer[i] = static_cast<int16_t>(sum / inputChannels);
+        }
+        mono = vadBuffer.data();
+    }
+
+    const size_t blockSamples = AUDIO_SAMPLE_RATE / 100;
+    for (size_t offset = 0; offset + blockSamples <= samples; offset += blockSamples) {
+        const int result = WebRtcVad_Process(inputVad, static_cast<int>(AUDIO_SAMPLE_RATE),
+                                             mono + offset, blockSamples);
+        if (result != 0) {
+            // voice, or an error we don't want to silence the user for
+            return true;
+        }
     }
-    const qreal rms = std::sqrt(sumOfSquares / samples);
-    // our calculated normalized volume could possibly be above 1 because our RMS assumes a sinusoidal wave
-    const qreal normalizedVolume = std::min(rms * rootTwo, 1.0);
-    return normalizedVolume;
+
+    return false;
 }
 
 /**
@@ -617,35 +916,50 @@ void OpenAL::stopActive()
 
 /**
  * @brief handles recording of audio frames
+ * @return Samples left in the capture device after all complete frames were read.
  */
-void OpenAL::doInput()
+ALint OpenAL::doInput()
 {
     ALint curSamples = 0;
     alcGetIntegerv(alInDev, ALC_CAPTURE_SAMPLES, sizeof(curSamples), &curSamples);
-    if (curSamples < static_cast<ALint>(AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL)) {
-        return;
+    const ALint frameSamples = static_cast<ALint>(AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL);
+
+    // catch up at once if we woke up late instead of adding a frame of latency per wakeup
+    while (curSamples >= frameSamples && alInDev && !sources.empty()) {
+        curSamples -= frameSamples;
+        captureFrame(curSamples);
     }
 
+    return curSamples;
+}
+
+/**
+ * @brief Reads one frame from the capture device and hands it to all sources.
+ * @param backlogSamples Samples still waiting in the capture device after this frame.
+ */
+void OpenAL::captureFrame(ALint backlogSamples)
+{
+    TRACE_SCOPE("OpenAL::captureFrame");
     captureSamples(alInDev, inputBuffer, AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL);
+    captureBacklogMs = backlogSamples * 1000.0 / AUDIO_SAMPLE_RATE;
 
     applyGain(inputBuffer, AUDIO_FRAME_SAMPLE_COUNT_TOTAL, gainFactor);
 
-    auto volume = getVolume();
-    if (volume >= inputThreshold) {
+    const AudioLevel level = AudioLevel::measure(inputBuffer, AUDIO_FRAME_SAMPLE_COUNT_TOTAL);
+    const bool voiced =
+        voiceGate && inputVad ? hasVoice() : level.volume() >= inputThreshold;
+    if (voiced) {
         isActive = true;
         emit startActive(voiceHold);
-    } else if (!isActive) {
-        volume = 0;
     }
 
-    // NOTE(sudden6): this loop probably doesn't scale too well with many sources
-    for (auto source : sources) {
-        emit source->volumeAvailable(volume);
-    }
     if (!isActive) {
+        // a gated frame is shown as silence, just like it is sent
         return;
     }
 
+    inputMeter.publish(level);
+
 /*
     static qint64 delta = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
     qint64 prev = delta;
@@ -669,17 +983,31 @@ void OpenAL::doOutput()
 
 /**
  * @brief Called on the captureTimer events to capture audio
+ *
+ * Instead of polling the device, the timer is rearmed for the time the device still needs to
+ * complete the next frame, so a frame is sent about as soon as it is captured and the audio lock
+ * is only taken once per frame.
  */
 void OpenAL::doAudio()
 {
-    QMutexLocker lock(&audioLock);
-
-    // Output section does nothing
-
-    // Input section
-    if (alInDev && !sources.empty()) {
-        doInput();
+    TRACE_SCOPE("OpenAL::doAudio");
+    int waitMs = AUDIO_FRAME_DURATION;
+    {
+        PROFILED_MUTEX_LOCKER(lock, &audioLock, "OpenAL::audioLock");
+
+        // Output section does nothing
+
+        // Input section
+        if (alInDev && !sources.empty()) {
+            const ALint missing =
+                static_cast<ALint>(AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL) - doInput();
+            const ALint rate = static_cast<ALint>(AUDIO_SAMPLE_RATE);
+            // round up, waking up early would only cost another wakeup
+            waitMs = (missing * 1000 + rate - 1) / rate;
+        }
     }
+
+    captureTimer.start(std::max(waitMs, MIN_CAPTURE_WAIT_MS));
 }
 
 void OpenAL::captureSamples(ALCdevice* device, int16_t* buffer, ALCsizei samples)
@@ -687,12 +1015,30 @@ void OpenAL::captureSamples(ALCdevice* device, int16_t* buffer, ALCsizei samples
     alcCaptureSamples(device, buffer, samples);
 }
 
+/**
+ * @brief Audio left in the capture device after the last frame was read, this is latency the
+ *        capture timer adds before a frame even reaches the send path.
+ */
+qreal OpenAL::getCaptureBacklogMs() const
+{
+    return captureBacklogMs;
+}
+
+/**
+ * @brief Loudest captured level since the last call, frames muted by the input gate count as
+ *        silence.
+ */
+AudioLevel OpenAL::takeInputLevel()
+{
+    return inputMeter.take();
+}
+
 /**
  * @brief Returns true if the output device is open
  */
 bool OpenAL::isOutputReady() const
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     return alOutDev && outputInitialized;
 }
 
@@ -736,27 +1082,55 @@ QStringList OpenAL::inDeviceNames()
  */
 void OpenAL::cleanupBuffers(uint sourceId)
 {
+    ALint type = 0;
+    alGetSourcei(sourceId, AL_SOURCE_TYPE, &type);
+    if (type == AL_STATIC) {
+        // a shared sound buffer, detach it once it stopped so audio can be queued again
+        ALint state = 0;
+        alGetSourcei(sourceId, AL_SOURCE_STATE, &state);
+        if (state != AL_PLAYING) {
+            alSourcei(sourceId, AL_BUFFER, AL_NONE);
+        }
+        return;
+    }
+
     // unqueue all buffers from the source
     ALint processed = 0;
     alGetSourcei(sourceId, AL_BUFFERS_PROCESSED, &processed);
+    if (processed <= 0) {
+        return;
+    }
+
     std::vector<ALuint> bufids;
-    // should never be out of range, just to be sure
-    assert(processed >= 0);
     bufids.resize(processed);
     alSourceUnqueueBuffers(sourceId, processed, bufids.data());
-    // delete all buffers
-    alDeleteBuffers(processed, bufids.data());
+
+    auto it = playbackQueues.find(sourceId);
+    if (it == playbackQueues.end()) {
+        alDeleteBuffers(processed, bufids.data());
+        return;
+    }
+
+    // ring buffers are reused
+    PlaybackQueue& queue = it->second;
+    for (const ALuint bufid : bufids) {
+        if (std::find(queue.ring.begin(), queue.ring.end(), bufid) != queue.ring.end()) {
+            queue.freeBuffers.push_back(bufid);
+        } else {
+            alDeleteBuffers(1, &bufid);
+        }
+    }
 }
 
 void OpenAL::startLoop(uint sourceId)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     alSourcei(sourceId, AL_LOOPING, AL_TRUE);
 }
 
 void OpenAL::stopLoop(uint sourceId)
 {
-    QMutexLocker locker(&audioLock);
+    PROFILED_MUTEX_LOCKER(locker, &audioLock, "OpenAL::audioLock");
     alSourcei(sourceId, AL_LOOPING, AL_FALSE);
     alSourceStop(sourceId);
     cleanupBuffers(sourceId);
@@ -787,3 +1161,14 @@ void OpenAL::setInputThreshold(qreal normalizedThreshold)
 {
     inputThreshold = normalizedThreshold;
 }
+
+/**
+ * @brief Replaces the input threshold by voice activity detection
+ *
+ * While enabled, keyboard clicks and other loud noise no longer open the input and quiet speech
+ * isn't cut off. Frames without voice are never emitted, so they aren't encoded or sent either.
+ */
+void OpenAL::setVoiceGate(bool enabled)
+{
+    voiceGate = enabled;
+}
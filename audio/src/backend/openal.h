@@ -25,12 +25,18 @@
 #include "alsource.h"
 #include "util/compatiblerecursivemutex.h"
 
+#include <array>
+#include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <atomic>
 #include <cmath>
 
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QObject>
 #include <QTimer>
@@ -46,6 +52,7 @@
 #endif
 
 class IAudioSettings;
+struct WebRtcVadInst;
 
 class OpenAL : public IAudioControl
 {
@@ -76,11 +83,14 @@ public:
 
     qreal getInputThreshold() const;
     void setInputThreshold(qreal normalizedThreshold);
+    void setVoiceGate(bool enabled);
 
     void reinitInput(const QString& inDevDesc);
     bool reinitOutput(const QString& outDevDesc);
 
     bool isOutputReady() const;
+    qreal getCaptureBacklogMs() const;
+    AudioLevel takeInputLevel();
 
     QStringList outDeviceNames();
     QStringList inDeviceNames();
@@ -98,6 +108,18 @@ public:
 
     void playAudioBuffer(uint sourceId, const int16_t* data, int samples, unsigned channels,
                          int sampleRate);
+    qreal getQueuedMs(uint sourceId) const;
+    uint64_t getLateFrames(uint sourceId) const;
+    void setExtraPlayoutFrames(uint sourceId, unsigned frames);
+
+    static constexpr ALuint BUFFER_COUNT = 16;
+    static constexpr qreal MIN_PLAYOUT_FRAMES = 2;
+    static constexpr qreal MAX_PLAYOUT_DELAY_MS = 300;
+    static constexpr qreal JITTER_FACTOR = 3;
+    static constexpr qreal ARRIVAL_GAP_MS = 500;
+    static constexpr int VOICE_GATE_VAD_MODE = 2;
+    static constexpr int MIN_CAPTURE_WAIT_MS = 1;
+
 signals:
     void startActive(qreal msec);
 
@@ -116,7 +138,8 @@ protected:
 
     void doAudio();
 
-    virtual void doInput();
+    virtual ALint doInput();
+    void captureFrame(ALint backlogSamples);
     virtual void doOutput();
     virtual void captureSamples(ALCdevice* device, int16_t* buffer, ALCsizei samples);
 
@@ -124,10 +147,31 @@ private:
     virtual bool initInput(const QString& deviceName);
     virtual bool initOutput(const QString& deviceName);
 
+    struct PlaybackQueue
+    {
+        std::array<ALuint, BUFFER_COUNT> ring;
+        std::vector<ALuint> freeBuffers;
+        qreal jitterMs = 0;
+        qreal lastArrivalMs = -1;
+        qreal lastFrameMs = 0;
+        bool buffering = true;
+        uint64_t droppedFrames = 0;
+        uint64_t underruns = 0;
+        unsigned extraFrames = 0;
+
+        void onArrival(qreal nowMs, qreal frameMs);
+        qreal targetDelayMs(qreal frameMs) const;
+    };
+
+    PlaybackQueue* playbackQueue(uint sourceId);
+    void releasePlaybackQueue(uint sourceId);
+    qreal queuedDurationMs(uint sourceId, qreal frameMs) const;
     void cleanupBuffers(uint sourceId);
     void cleanupSound();
+    const QByteArray& soundData(IAudioSink::Sound sound);
+    ALuint soundBuffer(IAudioSink::Sound sound);
 
-    qreal getVolume();
+    bool hasVoice();
 
 protected:
     IAudioSettings& settings;
@@ -149,6 +193,12 @@ protected:
     std::unordered_set<AlSink*> sinks;
     std::unordered_set<AlSink*> soundSinks;
     std::unordered_set<AlSource*> sources;
+    std::unordered_map<uint, PlaybackQueue> playbackQueues;
+    QElapsedTimer playbackClock;
+    // PCM of the builtin sounds, read once and kept when the output device changes
+    std::map<IAudioSink::Sound, QByteArray> sounds;
+    // one buffer per sound on the open output device, shared by all sinks playing it
+    std::map<IAudioSink::Sound, ALuint> soundBuffers;
 
     int inputChannels = 0;
     qreal gain = 0;
@@ -162,4 +212,9 @@ protected:
     const qreal minInThreshold = 0.0;
     const qreal maxInThreshold = 0.4;
     int16_t* inputBuffer = nullptr;
+    std::atomic<bool> voiceGate{false};
+    WebRtcVadInst* inputVad = nullptr;
+    std::array<int16_t, AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL> vadBuffer;
+    std::atomic<qreal> captureBacklogMs{0};
+    AudioLevelMeter inputMeter;
 };
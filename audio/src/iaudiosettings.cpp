@@ -19,4 +19,18 @@
 
 #include "audio/iaudiosettings.h"
 
+/**
+ * @enum IAudioSettings::InputMode
+ * @brief How calls send a capture device with more than one channel.
+ *
+ * @var IAudioSettings::InputMode::Voice
+ * @brief Averages the channels to mono and runs the voice processing on the result.
+ *
+ * @var IAudioSettings::InputMode::MicArray
+ * @brief Beamforms a stereo microphone array to mono, then runs the voice processing.
+ *
+ * @var IAudioSettings::InputMode::Music
+ * @brief Sends stereo as captured, without any voice processing.
+ */
+
 IAudioSettings::~IAudioSettings() = default;
@@ -161,10 +161,24 @@ endif()
 
 search_dependency(OPENAL              PACKAGE openal)
 
+if(USE_LIBYUV)
+  # SIMD fast paths for the common video conversions, swscale handles the rest
+  search_dependency(LIBYUV            PACKAGE libyuv LIBRARY yuv HEADER libyuv.h OPTIONAL)
+endif()
+
+if(USE_LIBWEBP)
+  # direct, scaled decoding of the WebP images most group images are
+  search_dependency(LIBWEBP           PACKAGE libwebp OPTIONAL)
+endif()
+
 if (PLATFORM_EXTENSIONS AND UNIX AND NOT APPLE)
   # Automatic auto-away support. (X11 also using for capslock detection)
   search_dependency(X11               PACKAGE x11 OPTIONAL)
   search_dependency(XSS               PACKAGE xscrnsaver OPTIONAL)
+  # Native screen grabbing, falls back to FFmpeg's x11grab otherwise
+  search_dependency(XEXT              PACKAGE xext OPTIONAL)
+  search_dependency(XDAMAGE           PACKAGE xdamage OPTIONAL)
+  search_dependency(XFIXES            PACKAGE xfixes OPTIONAL)
 endif()
 
 if(APPLE)
@@ -246,6 +260,29 @@ if (X11_FOUND AND XSS_FOUND)
   set(X11_EXT True)
 endif()
 
+set(X11_SCREEN_GRAB False)
+if (X11_FOUND AND XEXT_FOUND AND XDAMAGE_FOUND AND XFIXES_FOUND)
+  set(X11_SCREEN_GRAB True)
+  add_definitions(
+    -DQTOX_X11_SCREEN_GRAB
+  )
+  message(STATUS "Using native X11 screen grabbing")
+endif()
+
+if (LIBYUV_FOUND)
+  add_definitions(
+    -DQTOX_LIBYUV
+  )
+  message(STATUS "Using libyuv for video conversions")
+endif()
+
+if (LIBWEBP_FOUND)
+  add_definitions(
+    -DQTOX_LIBWEBP
+  )
+  message(STATUS "Using libwebp for WebP images")
+endif()
+
 if (PLATFORM_EXTENSIONS)
   if (${APPLE_EXT} OR ${X11_EXT} OR WIN32)
     add_definitions(
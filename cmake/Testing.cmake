@@ -38,18 +38,53 @@ endfunction()
 add_subdirectory(test/mock)
 add_subdirectory(test/dbutility)
 
+auto_test(audio audiolevel "" "")
 auto_test(core core "${${PROJECT_NAME}_RESOURCES}" "mock_library")
 auto_test(core chatid "" "")
+auto_test(core toxeventrecorder "" "")
 auto_test(core toxid "" "")
 auto_test(core toxstring "" "")
+auto_test(core bootstrapnoderanking "" "")
+auto_test(core filechunkreader "" "")
+auto_test(core filechunkwriter "" "")
+auto_test(core filetransferscheduler "" "")
 auto_test(core fileprogress "" "")
+auto_test(core callaudioresilience "" "")
+auto_test(core callencoderprofile "" "")
+auto_test(core callratecontroller "" "")
+auto_test(core callstats "" "")
+auto_test(core callvideoladder "" "")
+auto_test(core connectionpathstats "" "")
+auto_test(core corestate "" "")
+auto_test(core cpugovernor "" "")
+auto_test(core custompacketregistry "" "")
+auto_test(core echodelayestimator "" "")
+auto_test(core groupaudiomixer "" "")
+auto_test(core lanpeercache "" "")
+auto_test(core latencyhistogram "" "")
+auto_test(core loopstats "" "")
+auto_test(core nearendmixer "" "")
+auto_test(core ngcfiletransfer "" "")
+auto_test(core ngcpacketreceiver "" "")
+auto_test(core ngcsynccoordinator "" "")
+auto_test(core ngcsyncindex "" "")
+auto_test(core polyphaseresampler "" "")
+auto_test(core voiceactivitydetector "" "")
+auto_test(video cameramodecache "" "")
+auto_test(video videoconversionplanner "" "")
 auto_test(chatlog textformatter "" "")
+auto_test(net avatarbroadcastqueue "" "")
 auto_test(net bsu "${${PROJECT_NAME}_RESOURCES}" "") # needs nodes list
 auto_test(chatlog chatlinestorage "" "")
+auto_test(chatlog sendercolorcache "" "")
 auto_test(persistence paths "" "")
+auto_test(persistence dbbackfill "" "")
 auto_test(persistence dbschema "" "dbutility_library")
 auto_test(persistence/dbupgrade dbTo11 "" "dbutility_library")
 auto_test(persistence offlinemsgengine "" "")
+auto_test(persistence blobstore "" "")
+auto_test(persistence settingsserializer "" "")
+auto_test(persistence toxsavewriter "" "")
 if(NOT "${SMILEYS}" STREQUAL "DISABLED")
 if(NOT WIN32)
   auto_test(persistence smileypack "${SMILEY_RESOURCES}" "") # needs emojione
@@ -57,13 +92,73 @@ endif()
 endif()
 auto_test(model friendlistmanager "" "")
 auto_test(model friendmessagedispatcher "" "")
+auto_test(model friendrequestintake "" "")
 auto_test(model groupmessagedispatcher "" "mock_library")
 auto_test(model messageprocessor "" "")
 auto_test(model sessionchatlog "" "")
+auto_test(model sessionsearchindex "" "")
+auto_test(model chatlogchunks "" "")
 auto_test(model exiftransform "" "")
+auto_test(model imagecontainer "" "")
+auto_test(model imagedecoder "" "")
+auto_test(model contactupdatecoalescer "" "")
+auto_test(model notificationcoalescer "" "")
 auto_test(model notificationgenerator "" "mock_library")
+auto_test(model peernametrie "" "")
+auto_test(model typingnotifier "" "")
 auto_test(widget filesform "" "")
+auto_test(util asynclogger "" "")
+auto_test(util cacheregistry "" "")
+auto_test(util diagnosticsregistry "" "")
+auto_test(util lockprofiler "" "")
+auto_test(util mpscqueue "" "")
+auto_test(util startupprofiler "" "")
+auto_test(util hitchwatchdog "" "")
+auto_test(util threadcputime "" "")
+auto_test(util threadscheduling "" "")
+auto_test(util tracer "" "")
 
 if (UNIX)
   auto_test(platform posixsignalnotifier "" "")
 endif()
+
+################################################################################
+#
+# :: Benchmarks
+#
+################################################################################
+
+# Not registered with ctest, "make bench" writes QtTest XML results to bench.xml,
+# history_bench.xml, chatwidget_bench.xml and toxevents_bench.xml
+add_executable(qtox_bench
+  test/bench/mediapipeline_bench.cpp)
+target_link_libraries(qtox_bench
+  ${PROJECT_NAME}_static
+  Qt5::Test
+  mock_library)
+add_executable(qtox_history_bench
+  test/bench/history_bench.cpp)
+target_link_libraries(qtox_history_bench
+  ${PROJECT_NAME}_static
+  Qt5::Test)
+add_executable(qtox_chatwidget_bench
+  test/bench/chatwidget_bench.cpp
+  ${${PROJECT_NAME}_RESOURCES})
+target_link_libraries(qtox_chatwidget_bench
+  ${PROJECT_NAME}_static
+  Qt5::Test
+  mock_library)
+add_executable(qtox_toxevents_bench
+  test/bench/toxevents_bench.cpp
+  ${${PROJECT_NAME}_RESOURCES})
+target_link_libraries(qtox_toxevents_bench
+  ${PROJECT_NAME}_static
+  Qt5::Test
+  mock_library)
+add_custom_target(bench
+  COMMAND ${TEST_CROSSCOMPILING_EMULATOR} $<TARGET_FILE:qtox_bench> -o ${CMAKE_BINARY_DIR}/bench.xml,xml
+  COMMAND ${TEST_CROSSCOMPILING_EMULATOR} $<TARGET_FILE:qtox_history_bench> -o ${CMAKE_BINARY_DIR}/history_bench.xml,xml
+  COMMAND ${TEST_CROSSCOMPILING_EMULATOR} $<TARGET_FILE:qtox_chatwidget_bench> -o ${CMAKE_BINARY_DIR}/chatwidget_bench.xml,xml
+  COMMAND ${TEST_CROSSCOMPILING_EMULATOR} $<TARGET_FILE:qtox_toxevents_bench> -o ${CMAKE_BINARY_DIR}/toxevents_bench.xml,xml
+  DEPENDS qtox_bench qtox_history_bench qtox_chatwidget_bench qtox_toxevents_bench
+  WORKING_DIRECTORY ${CMAKE_BINARY_DIR})
@@ -20,6 +20,7 @@
 #include "appmanager.h"
 
 #include "src/widget/tool/messageboxmanager.h"
+#include "src/headlesssession.h"
 #include "src/persistence/settings.h"
 #include "src/persistence/toxsave.h"
 #include "src/persistence/profile.h"
@@ -29,9 +30,23 @@
 #include "src/net/toxuri.h"
 #include "src/widget/widget.h"
 #include "src/video/camerasource.h"
+#include "src/core/loopstats.h"
+#include "src/core/toxeventrecorder.h"
+#include "util/asynclogger.h"
+#include "util/cacheregistry.h"
+#include "util/hitchwatchdog.h"
+#include "util/lockprofiler.h"
+#include "util/startupprofiler.h"
+#include "util/tracer.h"
+
+#ifdef QTOX_PLATFORM_EXT
+#include "src/platform/memorypressure.h"
+#endif
 
 #if defined(Q_OS_UNIX)
 #include "src/platform/posixsignalnotifier.h"
+
+#include <signal.h>
 #endif
 
 #include <QApplication>
@@ -41,110 +56,35 @@
 #include <QDir>
 #include <QMessageBox>
 #include <QObject>
+#include <QTimer>
+
+constexpr int AppManager::MEMORY_CHECK_MS;
+constexpr qint64 AppManager::MEMORY_PRESSURE_HOLD_MS;
 
 namespace
 {
-// logMessageHandler and associated data must be static due to qInstallMessageHandler's
-// inability to register a void* to get back to a class
-#ifdef LOG_TO_FILE
-QAtomicPointer<FILE> logFileFile = nullptr;
-QList<QByteArray>* logBuffer =
-    new QList<QByteArray>(); // Store log messages until log file opened
-QMutex* logBufferMutex = new QMutex();
-#endif
-
 void logMessageHandler(QtMsgType type, const QMessageLogContext& ctxt, const QString& msg)
 {
     // Silence qWarning spam due to bug in QTextBrowser (trying to open a file for base64 images)
-    if (QString::fromUtf8(ctxt.function) == QString("virtual bool QFSFileEngine::open(QIODevice::OpenMode)")
-        && msg == QString("QFSFileEngine::open: No file name specified")) {
-        return;
-    }
-    if (msg.startsWith("Unable to find any suggestion for")) {
-        // Prevent sonnet's complaints from leaking user chat messages to logs
-        return;
-    }
-
-    if (msg == QString("attempted to send message with network family 10 (probably IPv6) on IPv4 socket")) {
-        // non-stop c-toxcore spam for IPv4 users: https://github.com/TokTok/c-toxcore/issues/1432
+    if (ctxt.function
+        && qstrcmp(ctxt.function, "virtual bool QFSFileEngine::open(QIODevice::OpenMode)") == 0
+        && msg == QLatin1String("QFSFileEngine::open: No file name specified")) {
         return;
     }
 
-    QRegExp snoreFilter{QStringLiteral("Snore::Notification.*was already closed")};
-    if (type == QtWarningMsg
-        && msg.contains(snoreFilter))
-    {
-        // snorenotify logs this when we call requestCloseNotification correctly. The behaviour still works, so we'll
-        // just mask the warning for now. The issue has been reported upstream:
-        // https://github.com/qTox/qTox/pull/6073#pullrequestreview-420748519
-        return;
-    }
-
-    QString file = QString::fromUtf8(ctxt.file);
     // We're not using QT_MESSAGELOG_FILE here, because that can be 0, NULL, or
     // nullptr in release builds.
-    QString path = QString(__FILE__);
-    path = path.left(path.lastIndexOf('/') + 1);
-    if (file.startsWith(path)) {
-        file = file.mid(path.length());
-    }
-
-    // Time should be in UTC to save user privacy on log sharing
-    QTime time = QDateTime::currentDateTime().toUTC().time();
-    QString LogMsg =
-        QString("[%1 UTC] %2:%3 : ").arg(time.toString("HH:mm:ss.zzz")).arg(file).arg(ctxt.line);
-    switch (type) {
-    case QtDebugMsg:
-        LogMsg += "Debug";
-        break;
-    case QtInfoMsg:
-        LogMsg += "Info";
-        break;
-    case QtWarningMsg:
-        LogMsg += "Warning";
-        break;
-    case QtCriticalMsg:
-        LogMsg += "Critical";
-        break;
-    case QtFatalMsg:
-        LogMsg += "Fatal";
-        break;
-    default:
-        break;
-    }
-
-    LogMsg += ": " + msg + "\n";
-    QByteArray LogMsgBytes = LogMsg.toUtf8();
-    fwrite(LogMsgBytes.constData(), 1, LogMsgBytes.size(), stderr);
-
-#ifdef LOG_TO_FILE
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-    FILE* logFilePtr = logFileFile.loadRelaxed(); // atomically load the file pointer
-#else
-    FILE* logFilePtr = logFileFile.load(); // atomically load the file pointer
-#endif
-    if (!logFilePtr) {
-        logBufferMutex->lock();
-        if (logBuffer)
-            logBuffer->append(LogMsgBytes);
-
-        logBufferMutex->unlock();
-    } else {
-        logBufferMutex->lock();
-        if (logBuffer) {
-            // empty logBuffer to file
-            foreach (QByteArray bufferedMsg, *logBuffer)
-                fwrite(bufferedMsg.constData(), 1, bufferedMsg.size(), logFilePtr);
-
-            delete logBuffer; // no longer needed
-            logBuffer = nullptr;
-        }
-        logBufferMutex->unlock();
-
-        fwrite(LogMsgBytes.constData(), 1, LogMsgBytes.size(), logFilePtr);
-        fflush(logFilePtr);
+    static const QByteArray path = [] {
+        const QByteArray file{__FILE__};
+        return file.left(file.lastIndexOf('/') + 1);
+    }();
+    const char* file = ctxt.file;
+    if (file && qstrncmp(file, path.constData(), path.size()) == 0) {
+        file += path.size();
     }
-#endif
+
+    // formatting, filtering and writing happen on the logger thread
+    AsyncLogger::getInstance().log(type, file, ctxt.line, msg);
 }
 
 bool toxURIEventHandler(const QByteArray& eventData, void* userData)
@@ -164,13 +104,46 @@ bool toxURIEventHandler(const QByteArray& eventData, void* userData)
 } // namespace
 
 AppManager::AppManager(int& argc, char** argv)
-    : qapp((preConstructionInitialization(), new QApplication(argc, argv)))
-    , messageBoxManager(new MessageBoxManager(nullptr))
+    : headless(isHeadless(argc, argv))
+    , qapp((preConstructionInitialization(), makeApplication(headless, argc, argv)))
+    , messageBoxManager(headless
+                            ? static_cast<IMessageBoxManager*>(new HeadlessMessageBoxManager)
+                            : new MessageBoxManager(nullptr))
     , settings(new Settings(*messageBoxManager))
     , ipc(new IPC(settings->getCurrentProfileId()))
 {
 }
 
+/**
+ * @brief Checks for --headless, which has to be known before the application is created.
+ *
+ * Sending a command with --control doesn't need a display either.
+ */
+bool AppManager::isHeadless(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0 || qstrcmp(argv[i], "--control") == 0
+            || qstrncmp(argv[i], "--control=", 10) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QGuiApplication* AppManager::makeApplication(bool headless, int& argc, char** argv)
+{
+    if (!headless) {
+        return new QApplication(argc, argv);
+    }
+
+    // avatars are still QPixmaps, those need a QGuiApplication, but no display
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    return new QGuiApplication(argc, argv);
+}
+
 void AppManager::preConstructionInitialization()
 {
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 6, 0))
@@ -178,10 +151,19 @@ void AppManager::preConstructionInitialization()
     QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
 #endif
     qInstallMessageHandler(logMessageHandler);
+#ifdef LOG_TO_FILE
+    // Store log messages until log file opened
+    AsyncLogger::getInstance().startLogging(true);
+#else
+    AsyncLogger::getInstance().startLogging(false);
+#endif
 }
 
 int AppManager::run()
 {
+    // starts the clock of the startup timeline
+    StartupProfiler::getInstance();
+
 #if QT_VERSION < QT_VERSION_CHECK( 5, 10, 0 )
     // seeding random number generator once
     qsrand(QDateTime::currentMSecsSinceEpoch()%UINT_MAX);
@@ -189,11 +171,30 @@ int AppManager::run()
 #endif
 
 #if defined(Q_OS_UNIX)
-    // PosixSignalNotifier is used only for terminating signals,
-    // so it's connected directly to quit() without any filtering.
+    // SIGUSR1 dumps the main loop timing to the log and writes the trace, every other signal
+    // terminates
     connect(&PosixSignalNotifier::globalInstance(), &PosixSignalNotifier::activated,
-                     qapp.get(), &QApplication::quit);
+            qapp.get(), [this](int signum) {
+                if (signum == SIGUSR1) {
+                    qDebug().noquote() << "Main loop timing:\n" << LoopStats::report();
+#if QTOX_LOCK_PROFILING
+                    qDebug().noquote() << "Lock contention:\n" << LockProfiler::getInstance().report();
+#endif
+                    Tracer::getInstance().write();
+                    return;
+                }
+                qapp->quit();
+            });
     PosixSignalNotifier::watchCommonTerminatingSignals();
+    PosixSignalNotifier::watchSignal(SIGUSR1);
+#endif
+
+#if QTOX_LOCK_PROFILING
+    QTimer* lockReportTimer = new QTimer(qapp.get());
+    connect(lockReportTimer, &QTimer::timeout, qapp.get(), []() {
+        qDebug().noquote() << "Lock contention:\n" << LockProfiler::getInstance().report();
+    });
+    lockReportTimer->start(LockProfiler::REPORT_INTERVAL_MS);
 #endif
 
     qapp->setApplicationName("qTox");
@@ -205,7 +206,7 @@ int AppManager::run()
     // Install Unicode 6.1 supporting font
     // Keep this as close to the beginning of `main()` as possible, otherwise
     // on systems that have poor support for Unicode qTox will look bad.
-    if (QFontDatabase::addApplicationFont("://font/DejaVuSans.ttf") == -1) {
+    if (!headless && QFontDatabase::addApplicationFont("://font/DejaVuSans.ttf") == -1) {
         qWarning() << "Couldn't load font";
     }
 
@@ -248,8 +249,67 @@ int AppManager::run()
                                                       << "proxy",
                                         tr("Sets proxy settings. Default is NONE."),
                                         tr("(SOCKS5/HTTP/NONE):(ADDRESS):(PORT)")));
+    parser.addOption(QCommandLineOption(QStringList() << "startup-trace",
+                                        tr("Records the startup phases and writes them to <file> "
+                                           "on exit, as a Chrome trace JSON timeline."),
+                                        tr("file")));
+    parser.addOption(QCommandLineOption(QStringList() << "record-tox-events",
+                                        tr("Records the tox events of the session without their "
+                                           "content and writes them to <file> on exit, for "
+                                           "replaying them as a load test."),
+                                        tr("file")));
+    parser.addOption(QCommandLineOption(QStringList() << "log-level",
+                                        tr("Sets the log levels per category, e.g. "
+                                           "\"qtox.core.ngcpacket=warning,tox.core=info\". "
+                                           "Levels are debug, info, warning, critical and off."),
+                                        tr("levels")));
+    parser.addOption(QCommandLineOption(QStringList() << "hitch-threshold",
+                                        tr("Logs when the user interface doesn't respond for "
+                                           "longer than <ms> milliseconds, 0 turns it off. "
+                                           "Default is %1.")
+                                            .arg(HitchWatchdog::DEFAULT_THRESHOLD_MS),
+                                        tr("ms")));
+    parser.addOption(QCommandLineOption(QStringList() << "headless",
+                                        tr("Runs the profile without user interface, e.g. for "
+                                           "bots. The password of an encrypted profile is read "
+                                           "from QTOX_PROFILE_PASSWORD.")));
+    parser.addOption(QCommandLineOption(QStringList() << "control",
+                                        tr("Sends <command> to the headless instance running "
+                                           "the profile and exits. Commands are \"add <Tox ID> "
+                                           "[message]\", \"accept <public key>\", \"message "
+                                           "<public key> <text>\", \"status\" and \"quit\"."),
+                                        tr("command")));
+    parser.addOption(QCommandLineOption(QStringList() << "host-profile",
+                                        tr("Runs <profile> in the same headless process as the "
+                                           "profile chosen with -p, can be repeated. Commands "
+                                           "reach it with -p <profile> --control."),
+                                        tr("profile")));
+#if QTOX_TRACING
+    parser.addOption(QCommandLineOption(QStringList() << "trace",
+                                        tr("Records spans on all threads and writes the latest "
+                                           "to <file> on exit or SIGUSR1, as a Chrome trace JSON."),
+                                        tr("file")));
+#endif
     parser.process(*qapp);
 
+    if (parser.isSet("log-level") && !AsyncLogger::setLogLevels(parser.value("log-level"))) {
+        qWarning() << "Invalid log levels" << parser.value("log-level");
+    }
+
+    if (parser.isSet("startup-trace")) {
+        StartupProfiler::getInstance().enable(parser.value("startup-trace"));
+    }
+
+    if (parser.isSet("record-tox-events")) {
+        ToxEventRecorder::getInstance().enable(parser.value("record-tox-events"));
+    }
+
+#if QTOX_TRACING
+    if (parser.isSet("trace")) {
+        Tracer::getInstance().enable(parser.value("trace"));
+    }
+#endif
+
     if (ipc->isAttached()) {
         connect(settings.get(), &Settings::currentProfileIdChanged, ipc.get(), &IPC::setProfileId);
     } else {
@@ -289,11 +349,26 @@ int AppManager::run()
     if (!mainLogFilePtr)
         qCritical() << "Couldn't open logfile" << logfile;
 
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-    logFileFile.storeRelaxed(mainLogFilePtr); // atomically set the logFile
-#else
-    logFileFile.store(mainLogFilePtr); // atomically set the logFile
+    AsyncLogger::getInstance().setLogFile(mainLogFilePtr);
 #endif
+
+    qint64 hitchThresholdMs = HitchWatchdog::DEFAULT_THRESHOLD_MS;
+    if (parser.isSet("hitch-threshold")) {
+        hitchThresholdMs = parser.value("hitch-threshold").toLongLong();
+    }
+    if (hitchThresholdMs > 0) {
+        const QString hitchLogDir = settings->getPaths().getAppCacheDirPath();
+        QDir(hitchLogDir).mkpath(".");
+        HitchWatchdog::getInstance().start(hitchLogDir + "hitches.log", hitchThresholdMs);
+    }
+
+    applyCacheBudget();
+    connect(settings.get(), &Settings::cacheBudgetMbChanged, this, &AppManager::applyCacheBudget);
+    connect(settings.get(), &Settings::lowMemoryModeChanged, this, &AppManager::applyCacheBudget);
+#ifdef QTOX_PLATFORM_EXT
+    memoryCheckTimer.setInterval(MEMORY_CHECK_MS);
+    connect(&memoryCheckTimer, &QTimer::timeout, this, &AppManager::checkMemoryPressure);
+    memoryCheckTimer.start();
 #endif
 
     // Windows platform plugins DLL hell fix
@@ -334,6 +409,20 @@ int AppManager::run()
         profileName = settings->getCurrentProfile();
     }
 
+    if (parser.isSet("control")) {
+        if (!ipc->isAttached()) {
+            qCritical() << "Can't send the command, IPC is not available";
+            return EXIT_FAILURE;
+        }
+        const time_t event = ipc->postEvent(HeadlessSession::controlEventKey,
+                                            parser.value("control").toUtf8(), ipcDest);
+        if (!ipc->waitUntilAccepted(event, 2)) {
+            qCritical() << "No headless instance accepted the command";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (parser.positionalArguments().empty()) {
         eventType = "activate";
     } else {
@@ -371,6 +460,10 @@ int AppManager::run()
         return -1;
     }
 
+    if (headless) {
+        return runHeadless(profileName, parser);
+    }
+
     // TODO(kriby): Consider moving application initializing variables into a globalSettings object
     //  note: Because Settings is shouldering global settings as well as model specific ones it
     //  cannot be integrated into a central model object yet
@@ -418,37 +511,131 @@ int AppManager::run()
     return qapp->exec();
 }
 
+/**
+ * @brief Runs a profile without any widgets, camera or audio, see HeadlessSession.
+ * @param profileName Profile to run, it must exist.
+ */
+int AppManager::runHeadless(const QString& profileName, const QCommandLineParser& parser)
+{
+    if (profileName.isEmpty() || !Profile::exists(profileName, settings->getPaths())) {
+        qCritical() << "The headless mode needs an existing profile, choose it with -p";
+        return EXIT_FAILURE;
+    }
+
+    // nobody is there to type it in
+    const QString password = QString::fromLocal8Bit(qgetenv("QTOX_PROFILE_PASSWORD"));
+    Profile* profile =
+        Profile::loadHeadlessProfile(profileName, password, *settings, &parser, *messageBoxManager);
+    if (!profile) {
+        qCritical() << "Failed to load profile" << profileName;
+        return EXIT_FAILURE;
+    }
+
+    headlessSession = std::unique_ptr<HeadlessSession>(new HeadlessSession(profile, *settings, *ipc));
+    headlessSession->start();
+
+    // a relay host shares the process, its libraries and the thread pool between its profiles
+    for (const QString& hostedName : parser.values("host-profile")) {
+        if (hostedName == profileName || !Profile::exists(hostedName, settings->getPaths())) {
+            qWarning() << "Not hosting profile" << hostedName;
+            continue;
+        }
+
+        std::unique_ptr<Settings> hostedSetting{new Settings(*messageBoxManager)};
+        Profile* hostedProfile = Profile::loadHostedProfile(hostedName, password, *hostedSetting,
+                                                            &parser, *messageBoxManager);
+        if (!hostedProfile) {
+            qWarning() << "Failed to load hosted profile" << hostedName;
+            continue;
+        }
+
+        constexpr bool hosted = true;
+        std::unique_ptr<HeadlessSession> session{
+            new HeadlessSession(hostedProfile, *hostedSetting, *ipc, hosted)};
+        session->start();
+        hostedSessions.push_back(std::move(session));
+        hostedSettings.push_back(std::move(hostedSetting));
+    }
+
+    connect(qapp.get(), &QCoreApplication::aboutToQuit, this, &AppManager::cleanup);
+
+    return qapp->exec();
+}
+
 AppManager::~AppManager() = default;
 
+/**
+ * @brief Hands the cache budget of the settings to the CacheRegistry.
+ *
+ * The low memory mode applies if the user enabled it or the OS reported memory pressure
+ * within the last MEMORY_PRESSURE_HOLD_MS.
+ */
+void AppManager::applyCacheBudget()
+{
+    const bool lowMemory = settings->getLowMemoryMode() || memoryPressure;
+    const qint64 budget = lowMemory ? CacheRegistry::LOW_MEMORY_BUDGET
+                                    : static_cast<qint64>(settings->getCacheBudgetMb()) << 20;
+    qDebug() << "Cache budget is" << (budget >> 20) << "MiB, low memory mode" << lowMemory;
+    CacheRegistry& registry = CacheRegistry::getInstance();
+    registry.setLowMemory(lowMemory);
+    registry.setBudget(budget);
+}
+
+/**
+ * @brief Switches to the low memory mode while the OS reports memory pressure.
+ *
+ * The mode is kept for MEMORY_PRESSURE_HOLD_MS after the last report, so memory freed by
+ * trimming doesn't immediately fill the caches up again.
+ */
+void AppManager::checkMemoryPressure()
+{
+#ifdef QTOX_PLATFORM_EXT
+    if (Platform::isMemoryLow()) {
+        lastMemoryPressure.start();
+    }
+#endif
+
+    const bool pressure =
+        lastMemoryPressure.isValid() && lastMemoryPressure.elapsed() < MEMORY_PRESSURE_HOLD_MS;
+    if (pressure == memoryPressure || !settings) {
+        return;
+    }
+
+    memoryPressure = pressure;
+    qWarning() << (pressure ? "Memory is running low, entering" : "Memory pressure is gone, leaving")
+               << "the low memory mode";
+    applyCacheBudget();
+}
+
 void AppManager::cleanup()
 {
     // force save early even though destruction saves, because Windows OS will
     // close qTox before cleanup() is finished if logging out or shutting down,
     // once the top level window has exited, which occurs in ~Widget within
     // ~nexus-> Re-ordering Nexus destruction is not trivial.
+    // hosted settings go first, so the current profile saved in qtox.ini stays the -p one
+    hostedSessions.clear();
+    hostedSettings.clear();
     if (settings) {
         settings->saveGlobal();
         settings->savePersonal();
         settings->sync();
     }
 
+    memoryCheckTimer.stop();
+    headlessSession.reset();
     nexus.reset();
     settings.reset();
+    CacheRegistry::getInstance().setBudget(0);
+    HitchWatchdog::getInstance().stop();
+    StartupProfiler::getInstance().write();
+    Tracer::getInstance().write();
+    ToxEventRecorder::getInstance().write();
     qDebug() << "Cleanup success";
 
-    #ifdef LOG_TO_FILE
-    #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-        FILE* f = logFileFile.loadRelaxed();
-    #else
-        FILE* f = logFileFile.load();
-    #endif
-        if (f != nullptr) {
-            fclose(f);
-    #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-            logFileFile.storeRelaxed(nullptr); // atomically disable logging to file
-    #else
-            logFileFile.store(nullptr); // atomically disable logging to file
-    #endif
-        }
-    #endif
+    AsyncLogger::getInstance().stop();
+    FILE* f = AsyncLogger::getInstance().setLogFile(nullptr);
+    if (f != nullptr) {
+        fclose(f);
+    }
 }
@@ -19,17 +19,22 @@
 
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QTimer>
 
 #include <memory>
+#include <vector>
 
-class MessageBoxManager;
+class QCommandLineParser;
+class IMessageBoxManager;
 class Settings;
 class IPC;
-class QApplication;
+class QGuiApplication;
 class ToxURIDialog;
 class Nexus;
 class CameraSource;
+class HeadlessSession;
 
 class AppManager : public QObject
 {
@@ -42,13 +47,28 @@ public:
 
 private slots:
     void cleanup();
+    void checkMemoryPressure();
 private:
     void preConstructionInitialization();
-    std::unique_ptr<QApplication> qapp;
-    std::unique_ptr<MessageBoxManager> messageBoxManager;
+    static bool isHeadless(int argc, char** argv);
+    static QGuiApplication* makeApplication(bool headless, int& argc, char** argv);
+    int runHeadless(const QString& profileName, const QCommandLineParser& parser);
+    void applyCacheBudget();
+    static constexpr int MEMORY_CHECK_MS = 10000;
+    static constexpr qint64 MEMORY_PRESSURE_HOLD_MS = 5 * 60 * 1000;
+    QTimer memoryCheckTimer;
+    QElapsedTimer lastMemoryPressure;
+    bool memoryPressure = false;
+    const bool headless;
+    std::unique_ptr<QGuiApplication> qapp;
+    std::unique_ptr<IMessageBoxManager> messageBoxManager;
     std::unique_ptr<Settings> settings;
     std::unique_ptr<IPC> ipc;
     std::unique_ptr<ToxURIDialog> uriDialog;
     std::unique_ptr<CameraSource> cameraSource;
     std::unique_ptr<Nexus> nexus;
+    std::unique_ptr<HeadlessSession> headlessSession;
+    // profiles hosted next to the headless one, each session needs its own settings
+    std::vector<std::unique_ptr<Settings>> hostedSettings;
+    std::vector<std::unique_ptr<HeadlessSession>> hostedSessions;
 };
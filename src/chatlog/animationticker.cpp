@@ -0,0 +1,97 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "animationticker.h"
+#include "chatlinecontent.h"
+
+#include <QGraphicsScene>
+#include <QHash>
+
+/**
+ * @class AnimationTicker
+ * @brief One clock for all animated chat content.
+ *
+ * Animated content asks for the next frame from its paint(), so content that is off-screen or
+ * in a hidden window isn't painted, doesn't ask again and stops animating, and the timer stops
+ * when nothing is animated. On every tick all content that asked is advanced at once and each
+ * scene gets a single update for the united area of its animated content.
+ */
+
+constexpr int AnimationTicker::FRAMERATE;
+
+AnimationTicker::AnimationTicker()
+{
+    timer.setInterval(1000 / FRAMERATE);
+    connect(&timer, &QTimer::timeout, this, &AnimationTicker::tick);
+    clock.start();
+}
+
+AnimationTicker& AnimationTicker::getInstance()
+{
+    static AnimationTicker instance;
+    return instance;
+}
+
+/**
+ * @brief Advances the content on the next tick, call from paint().
+ */
+void AnimationTicker::requestFrame(ChatLineContent* content)
+{
+    pending.insert(content);
+    if (!timer.isActive()) {
+        timer.start();
+    }
+}
+
+/**
+ * @brief Drops a requested frame, must be called before the content is deleted.
+ */
+void AnimationTicker::cancelFrame(ChatLineContent* content)
+{
+    pending.remove(content);
+}
+
+void AnimationTicker::tick()
+{
+    if (pending.isEmpty()) {
+        timer.stop();
+        return;
+    }
+
+    // content asks again when it's painted with the new frame
+    const QSet<ChatLineContent*> contents = std::move(pending);
+    pending.clear();
+
+    // the same time for everything, so the animations are synced
+    const qint64 nowMs = clock.elapsed();
+    QHash<QGraphicsScene*, QRectF> dirty;
+    for (ChatLineContent* content : contents) {
+        content->animationTick(nowMs);
+        QGraphicsScene* scene = content->scene();
+        if (scene && content->isVisible()) {
+            QRectF& rect = dirty[scene];
+            rect = rect.united(content->sceneBoundingRect());
+        }
+    }
+
+    for (auto it = dirty.constBegin(); it != dirty.constEnd(); ++it) {
+        it.key()->invalidate(it.value());
+    }
+}
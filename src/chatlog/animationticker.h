@@ -0,0 +1,53 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+class ChatLineContent;
+
+class AnimationTicker : public QObject
+{
+    Q_OBJECT
+
+public:
+    void requestFrame(ChatLineContent* content);
+    void cancelFrame(ChatLineContent* content);
+    static AnimationTicker& getInstance();
+
+    static constexpr int FRAMERATE = 30;
+
+protected:
+    AnimationTicker();
+    AnimationTicker(AnimationTicker&) = delete;
+    AnimationTicker& operator=(const AnimationTicker&) = delete;
+
+private slots:
+    void tick();
+
+private:
+    QTimer timer;
+    QElapsedTimer clock;
+    QSet<ChatLineContent*> pending;
+};
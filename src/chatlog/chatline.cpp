@@ -19,10 +19,13 @@
 
 #include "chatline.h"
 #include "chatlinecontent.h"
+#include "textlayoutpool.h"
 
 #include <QDebug>
 #include <QGraphicsScene>
 
+constexpr int ChatLine::MAX_CACHED_HEIGHTS;
+
 ChatLine::ChatLine()
 {
 }
@@ -82,6 +85,11 @@ void ChatLine::addToScene(QGraphicsScene* scene)
         scene->addItem(c);
 }
 
+bool ChatLine::isInScene() const
+{
+    return !content.isEmpty() && content.first()->scene();
+}
+
 void ChatLine::setVisible(bool visible)
 {
     for (ChatLineContent* c : content)
@@ -148,6 +156,8 @@ void ChatLine::replaceContent(int col, ChatLineContent* lineContent)
     if (col >= 0 && col < content.size() && lineContent) {
         QGraphicsScene* scene = content[col]->scene();
         delete content[col];
+        cachedHeights.clear();
+        ++contentRevision;
 
         content[col] = lineContent;
         lineContent->setIndex(row, col);
@@ -169,32 +179,14 @@ void ChatLine::layout(qreal w, QPointF scenePos)
     width = w;
     bbox.setTopLeft(scenePos);
 
-    qreal fixedWidth = (content.size() - 1) * columnSpacing;
-    qreal varWidth = 0.0; // used for normalisation
-
-    for (int i = 0; i < format.size(); ++i) {
-        if (format[i].policy == ColumnFormat::FixedSize)
-            fixedWidth += format[i].size;
-        else
-            varWidth += format[i].size;
-    }
-
-    if (varWidth == 0.0)
-        varWidth = 1.0;
-
-    qreal leftover = qMax(0.0, width - fixedWidth);
+    const QVector<qreal> widths = columnWidths(width);
 
     qreal maxVOffset = 0.0;
     qreal xOffset = 0.0;
     QVector<qreal> xPos(content.size());
 
     for (int i = 0; i < content.size(); ++i) {
-        // calculate the effective width of the current column
-        qreal contentWidth;
-        if (format[i].policy == ColumnFormat::FixedSize)
-            contentWidth = format[i].size;
-        else
-            contentWidth = format[i].size / varWidth * leftover;
+        const qreal contentWidth = widths[i];
 
         // set the width of the current column
         content[i]->setWidth(contentWidth);
@@ -232,6 +224,117 @@ void ChatLine::layout(qreal w, QPointF scenePos)
     updateBBox();
 }
 
+/**
+ * @brief Positions the line without laying out its content.
+ * @param w Width of the line.
+ * @param scenePos Top left corner of the line.
+ * @param height Known or estimated height of the line.
+ *
+ * Used for lines outside of the viewport, their content must be laid out with layout() before
+ * it is added to a scene.
+ */
+void ChatLine::place(qreal w, QPointF scenePos, qreal height)
+{
+    width = w;
+    bbox = QRectF(scenePos, QSizeF(w, height));
+}
+
+/**
+ * @brief Looks up the height this line had when it was laid out with the same settings.
+ * @param widthBucket Line width divided into coarse steps.
+ * @param fontGeneration Changes whenever the chat fonts change.
+ * @param height Set to the cached height if there is one.
+ * @return True if a height was cached.
+ */
+bool ChatLine::getCachedHeight(int widthBucket, unsigned fontGeneration, qreal& height) const
+{
+    for (const CachedHeight& cached : cachedHeights) {
+        if (cached.widthBucket == widthBucket && cached.fontGeneration == fontGeneration) {
+            height = cached.height;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ChatLine::cacheHeight(int widthBucket, unsigned fontGeneration, qreal height)
+{
+    for (CachedHeight& cached : cachedHeights) {
+        if (cached.widthBucket == widthBucket && cached.fontGeneration == fontGeneration) {
+            cached.height = height;
+            return;
+        }
+    }
+
+    if (cachedHeights.size() >= MAX_CACHED_HEIGHTS)
+        cachedHeights.removeFirst();
+
+    cachedHeights.append({widthBucket, fontGeneration, height});
+}
+
+/**
+ * @brief Calculates the effective width of each column.
+ */
+QVector<qreal> ChatLine::columnWidths(qreal w) const
+{
+    qreal fixedWidth = (content.size() - 1) * columnSpacing;
+    qreal varWidth = 0.0; // used for normalisation
+
+    for (int i = 0; i < format.size(); ++i) {
+        if (format[i].policy == ColumnFormat::FixedSize)
+            fixedWidth += format[i].size;
+        else
+            varWidth += format[i].size;
+    }
+
+    if (varWidth == 0.0)
+        varWidth = 1.0;
+
+    qreal leftover = qMax(0.0, w - fixedWidth);
+
+    QVector<qreal> widths(content.size());
+    for (int i = 0; i < content.size(); ++i) {
+        if (format[i].policy == ColumnFormat::FixedSize)
+            widths[i] = format[i].size;
+        else
+            widths[i] = format[i].size / varWidth * leftover;
+    }
+
+    return widths;
+}
+
+/**
+ * @brief Copies everything needed to measure the line with the given width.
+ *
+ * The result can be measured on any thread with TextLayoutPool::measureLine().
+ */
+LineLayoutInput ChatLine::getLayoutInput(qreal w) const
+{
+    LineLayoutInput input;
+    const QVector<qreal> widths = columnWidths(w);
+
+    for (int i = 0; i < content.size(); ++i) {
+        LineLayoutInput::Column column;
+        column.isText = content[i]->getLayoutInput(widths[i], column.text);
+        if (!column.isText) {
+            column.height = content[i]->boundingRect().height();
+            column.ascent = content[i]->getAscent();
+        }
+        input.columns.append(column);
+    }
+
+    return input;
+}
+
+/**
+ * @brief Changes whenever content is replaced, e.g. to tell outdated measurements apart.
+ */
+unsigned ChatLine::getContentRevision() const
+{
+    return contentRevision;
+}
+
 void ChatLine::moveBy(qreal deltaY)
 {
     // reposition only
@@ -29,6 +29,7 @@ class ChatLineContent;
 class QGraphicsScene;
 class QStyleOptionGraphicsItem;
 class QFont;
+struct LineLayoutInput;
 
 struct ColumnFormat
 {
@@ -74,9 +75,11 @@ public:
 
     void replaceContent(int col, ChatLineContent* lineContent);
     void layout(qreal width, QPointF scenePos);
+    void place(qreal width, QPointF scenePos, qreal height);
     void moveBy(qreal deltaY);
     void removeFromScene();
     void addToScene(QGraphicsScene* scene);
+    bool isInScene() const;
     void setVisible(bool visible);
     void selectionCleared();
     void selectionFocusChanged(bool focusIn);
@@ -90,6 +93,11 @@ public:
 
     bool isOverSelection(QPointF scenePos);
 
+    bool getCachedHeight(int widthBucket, unsigned fontGeneration, qreal& height) const;
+    void cacheHeight(int widthBucket, unsigned fontGeneration, qreal height);
+    LineLayoutInput getLayoutInput(qreal width) const;
+    unsigned getContentRevision() const;
+
     // comparators
     static bool lessThanBSRectTop(const ChatLine::Ptr& lhs, const qreal& rhs);
     static bool lessThanBSRectBottom(const ChatLine::Ptr& lhs, const qreal& rhs);
@@ -102,9 +110,20 @@ protected:
     QPointF mapToContent(ChatLineContent* c, QPointF pos);
 
     void updateBBox();
+    QVector<qreal> columnWidths(qreal width) const;
     void visibilityChanged(bool visible);
 
 private:
+    struct CachedHeight
+    {
+        int widthBucket;
+        unsigned fontGeneration;
+        qreal height;
+    };
+
+    // a few widths are enough to cover resizing back and forth
+    static constexpr int MAX_CACHED_HEIGHTS = 4;
+
     int row = -1;
     QVector<ChatLineContent*> content;
     QVector<ColumnFormat> format;
@@ -112,4 +131,6 @@ private:
     qreal columnSpacing = 15.0;
     QRectF bbox;
     bool isVisible = false;
+    QVector<CachedHeight> cachedHeights;
+    unsigned contentRevision = 0;
 };
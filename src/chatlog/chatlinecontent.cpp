@@ -19,6 +19,8 @@
 
 #include "chatlinecontent.h"
 
+#include <tuple>
+
 void ChatLineContent::setIndex(int r, int c)
 {
     row = r;
@@ -85,11 +87,33 @@ qreal ChatLineContent::getAscent() const
     return 0.0;
 }
 
+/**
+ * @brief Describes how to lay out this content off the GUI thread.
+ * @param width Width the content will get.
+ * @param input Filled in if the content is text.
+ * @return False if the size of the content doesn't depend on its width.
+ */
+bool ChatLineContent::getLayoutInput(qreal width, TextLayoutInput& input) const
+{
+    std::ignore = width;
+    std::ignore = input;
+    return false;
+}
+
 void ChatLineContent::visibilityChanged(bool visible)
 {
     std::ignore = visible;
 }
 
+/**
+ * @brief Advances an animation by one frame, see AnimationTicker::requestFrame().
+ * @param nowMs Time of the frame, shared by all content animated at once.
+ */
+void ChatLineContent::animationTick(qint64 nowMs)
+{
+    std::ignore = nowMs;
+}
+
 void ChatLineContent::reloadTheme()
 {
 }
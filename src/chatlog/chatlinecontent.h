@@ -22,6 +22,7 @@
 #include <QGraphicsItem>
 
 class ChatLine;
+struct TextLayoutInput;
 
 class ChatLineContent : public QObject, public QGraphicsItem
 {
@@ -52,11 +53,13 @@ public:
     virtual QString getText() const;
 
     virtual qreal getAscent() const;
+    virtual bool getLayoutInput(qreal width, TextLayoutInput& input) const;
 
     virtual QRectF boundingRect() const = 0;
     virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) = 0;
 
     virtual void visibilityChanged(bool visible);
+    virtual void animationTick(qint64 nowMs);
     virtual void reloadTheme();
 
 private:
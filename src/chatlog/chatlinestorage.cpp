@@ -21,6 +21,14 @@
 
 #include <QDebug>
 
+#include <algorithm>
+#include <limits>
+
+namespace {
+// Key of date lines that aren't followed by any message
+const ChatLogIdx noMessageIdx{std::numeric_limits<size_t>::max()};
+} // namespace
+
 ChatLineStorage::iterator ChatLineStorage::insertChatMessage(ChatLogIdx idx, QDateTime timestamp, ChatLine::Ptr line)
 {
     if (idxInfoMap.find(idx) != idxInfoMap.end()) {
@@ -28,21 +36,11 @@ ChatLineStorage::iterator ChatLineStorage::insertChatMessage(ChatLogIdx idx, QDa
         return lines.end();
     }
 
-    auto linePosIncrementIt = infoIteratorForIdx(idx);
-
-    auto insertionPoint = equivalentLineIterator(linePosIncrementIt);
+    auto insertionPoint = std::next(lines.begin(), messagePos(idx));
     insertionPoint = adjustItForDate(insertionPoint, timestamp);
 
-    insertionPoint = lines.insert(insertionPoint, line);
-
-    // All indexes after the insertion have to be incremented by one
-    incrementLinePosAfter(linePosIncrementIt);
-
-    // Newly inserted index is insertinPoint - start
-    IdxInfo info;
-    info.linePos = std::distance(lines.begin(), insertionPoint);
-    info.timestamp = timestamp;
-    idxInfoMap[idx] = info;
+    insertionPoint = insertLine(insertionPoint, line, {idx, false});
+    idxInfoMap[idx] = timestamp;
 
     return insertionPoint;
 }
@@ -60,17 +58,14 @@ ChatLineStorage::iterator ChatLineStorage::insertDateLine(QDateTime timestamp, C
     // be sent/received in order. If we ever implement sender timestamps and
     // the sender screws us by changing their time we may need to revisit this
     auto idxMapIt = std::find_if(idxInfoMap.begin(), idxInfoMap.end(), [&] (const IdxInfoMap_t::value_type& v) {
-        return timestamp <= v.second.timestamp;
+        return timestamp <= v.second;
     });
 
-    auto insertionPoint = equivalentLineIterator(idxMapIt);
+    const ChatLogIdx nextIdx = idxMapIt == idxInfoMap.end() ? noMessageIdx : idxMapIt->first;
+    auto insertionPoint = std::next(lines.begin(), messagePos(nextIdx));
     insertionPoint = adjustItForDate(insertionPoint, timestamp);
 
-    insertionPoint = lines.insert(insertionPoint, line);
-
-    // All indexes after the insertion have to be incremented by one
-    incrementLinePosAfter(idxMapIt);
-
+    insertionPoint = insertLine(insertionPoint, line, {nextIdx, true});
     dateMap[line] = timestamp;
 
     return insertionPoint;
@@ -85,15 +80,14 @@ bool ChatLineStorage::contains(QDateTime timestamp) const
     return it != dateMap.end();
 }
 
+/**
+ * @brief Finds the line of a message.
+ * @param idx Index of the message.
+ * @return The line of the first message at or after idx, end() if there is none.
+ */
 ChatLineStorage::iterator ChatLineStorage::find(ChatLogIdx idx)
 {
-    auto infoIt = infoIteratorForIdx(idx);
-    if (infoIt == idxInfoMap.end()) {
-        return lines.end();
-    }
-
-    return lines.begin() + infoIt->second.linePos;
-
+    return std::next(lines.begin(), messagePos(idx));
 }
 
 ChatLineStorage::iterator ChatLineStorage::find(ChatLine::Ptr line)
@@ -103,8 +97,10 @@ ChatLineStorage::iterator ChatLineStorage::find(ChatLine::Ptr line)
 
 void ChatLineStorage::erase(ChatLogIdx idx)
 {
-    auto linePosDecrementIt = infoIteratorForIdx(idx);
-    auto lineIt = equivalentLineIterator(linePosDecrementIt);
+    auto lineIt = find(idx);
+    if (lineIt == lines.end()) {
+        return;
+    }
 
     erase(lineIt);
 }
@@ -116,20 +112,25 @@ ChatLineStorage::iterator ChatLineStorage::erase(iterator it)
     do {
         it = prevIt;
 
-        auto infoIterator = equivalentInfoIterator(it);
+        const auto pos = static_cast<size_t>(std::distance(lines.begin(), it));
+        const LineKey key = lineKeys[pos];
         auto dateMapIt = dateMap.find(*it);
 
         if (dateMapIt != dateMap.end()) {
             dateMap.erase(dateMapIt);
         }
 
-        if (infoIterator != idxInfoMap.end()) {
-            infoIterator = idxInfoMap.erase(infoIterator);
-            decrementLinePosAfter(infoIterator);
+        if (!key.isDateLine) {
+            idxInfoMap.erase(key.idx);
         }
 
+        lineKeys.erase(std::next(lineKeys.begin(), pos));
         it = lines.erase(it);
 
+        if (!key.isDateLine) {
+            setDateLineAnchors(pos, pos < lineKeys.size() ? lineKeys[pos].idx : noMessageIdx);
+        }
+
         if (it > lines.begin()) {
             prevIt = std::prev(it);
         } else {
@@ -140,38 +141,21 @@ ChatLineStorage::iterator ChatLineStorage::erase(iterator it)
     return it;
 }
 
-ChatLineStorage::iterator ChatLineStorage::equivalentLineIterator(IdxInfoMap_t::iterator it)
+/**
+ * @brief Position of the first message at or after idx, after the date lines in front of it.
+ * @note Binary search over the line keys, so O(log n).
+ */
+size_t ChatLineStorage::messagePos(ChatLogIdx idx) const
 {
-    if (it == idxInfoMap.end()) {
-        return lines.end();
-    }
-
-    return std::next(lines.begin(), it->second.linePos);
-}
+    auto it = std::lower_bound(lineKeys.begin(), lineKeys.end(), LineKey{idx, false}, keyLess);
 
-ChatLineStorage::IdxInfoMap_t::iterator ChatLineStorage::equivalentInfoIterator(iterator it)
-{
-    auto idx = static_cast<size_t>(std::distance(lines.begin(), it));
-    auto equivalentIt = std::find_if(idxInfoMap.begin(), idxInfoMap.end(), [&](const IdxInfoMap_t::value_type& v) {
-        return v.second.linePos >= idx;
-    });
-
-    return equivalentIt;
-}
-
-ChatLineStorage::IdxInfoMap_t::iterator ChatLineStorage::infoIteratorForIdx(ChatLogIdx idx_)
-{
-    // If lower_bound proves to be expensive for appending we can try
-    // special casing when idx > idxToLineMap.rbegin()->first
-
-    // If we find an exact match we return that index, otherwise we return
-    // the first item after it. It's up to the caller to check if there's an
-    // exact match first
-    auto it = std::lower_bound(idxInfoMap.begin(), idxInfoMap.end(), idx_, [](const IdxInfoMap_t::value_type& v, ChatLogIdx idx) {
-        return v.first < idx;
-    });
+    // Only date lines anchored to a later message or to no message at all can be
+    // in front of it
+    while (it != lineKeys.end() && it->isDateLine) {
+        ++it;
+    }
 
-    return it;
+    return static_cast<size_t>(std::distance(lineKeys.begin(), it));
 }
 
 ChatLineStorage::iterator ChatLineStorage::adjustItForDate(iterator it, QDateTime timestamp)
@@ -196,18 +180,28 @@ ChatLineStorage::iterator ChatLineStorage::adjustItForDate(iterator it, QDateTim
     return it;
 }
 
-void ChatLineStorage::incrementLinePosAfter(IdxInfoMap_t::iterator inputIt)
+ChatLineStorage::iterator ChatLineStorage::insertLine(iterator it, ChatLine::Ptr line, LineKey key)
 {
-    for (auto it = inputIt; it != idxInfoMap.end(); ++it) {
-        it->second.linePos++;
+    const auto pos = static_cast<size_t>(std::distance(lines.begin(), it));
+    lineKeys.insert(std::next(lineKeys.begin(), pos), key);
+    it = lines.insert(it, line);
+
+    if (!key.isDateLine) {
+        setDateLineAnchors(pos, key.idx);
     }
+
+    return it;
 }
 
-void ChatLineStorage::decrementLinePosAfter(IdxInfoMap_t::iterator inputIt)
+/**
+ * @brief Re-keys the date lines directly in front of pos after the message following them changed.
+ * @param pos Position of the line following the date lines.
+ * @param anchor Index of the message now following them.
+ */
+void ChatLineStorage::setDateLineAnchors(size_t pos, ChatLogIdx anchor)
 {
-    // All indexes after the insertion have to be incremented by one
-    for (auto it = inputIt; it != idxInfoMap.end(); ++it) {
-        it->second.linePos--;
+    for (; pos > 0 && lineKeys[pos - 1].isDateLine; --pos) {
+        lineKeys[pos - 1].idx = anchor;
     }
 }
 
@@ -220,3 +214,17 @@ bool ChatLineStorage::shouldRemovePreviousLine(iterator prevIt, iterator it)
             dateMap.find(*it) != dateMap.end() // Adjacent date lines
         );
 }
+
+bool ChatLineStorage::keyLess(const LineKey& lhs, const LineKey& rhs)
+{
+    if (lhs.idx < rhs.idx) {
+        return true;
+    }
+
+    if (rhs.idx < lhs.idx) {
+        return false;
+    }
+
+    // date lines come before the message they are anchored to
+    return lhs.isDateLine && !rhs.isDateLine;
+}
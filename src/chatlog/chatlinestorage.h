@@ -49,18 +49,27 @@
  * items, but with some tweaks for ensuring items tied to the current view are
  * moved correctly (selection indexes, removal of associated date lines,
  * mappings of ChatLogIdx -> ChatLine::Ptr, etc.)
+ *
+ * Line positions aren't stored per ChatLogIdx, since every insertion or removal
+ * would then have to shift the position of all later messages. Instead every
+ * line has a LineKey in a vector parallel to the lines. Keys are sorted, so the
+ * position of a ChatLogIdx is found with a binary search
  */
 class ChatLineStorage
 {
 
-    struct IdxInfo
+    /**
+     * Messages are keyed by their ChatLogIdx, date lines by the ChatLogIdx of
+     * the message following them, which keeps the keys sorted
+     */
+    struct LineKey
     {
-        size_t linePos;
-        QDateTime timestamp;
+        ChatLogIdx idx;
+        bool isDateLine;
     };
     using Lines_t = std::vector<ChatLine::Ptr>;
     using DateLineMap_t = std::map<ChatLine::Ptr, QDateTime>;
-    using IdxInfoMap_t = std::map<ChatLogIdx, IdxInfo>;
+    using IdxInfoMap_t = std::map<ChatLogIdx, QDateTime>;
 
 public:
     // Types to conform with other containers
@@ -88,7 +97,7 @@ public:
 
     const_reference operator[](size_type idx) const { return lines[idx]; }
 
-    const_reference operator[](ChatLogIdx idx) const { return lines[idxInfoMap.at(idx).linePos]; }
+    const_reference operator[](ChatLogIdx idx) const { return lines[messagePos(idx)]; }
 
     size_type size() const { return lines.size(); }
 
@@ -103,6 +112,7 @@ public:
     {
         idxInfoMap.clear();
         dateMap.clear();
+        lineKeys.clear();
         return lines.clear();
     }
 
@@ -113,19 +123,18 @@ public:
     iterator erase(iterator it);
 
 private:
-    iterator equivalentLineIterator(IdxInfoMap_t::iterator it);
-
-    IdxInfoMap_t::iterator equivalentInfoIterator(iterator it);
-
-    IdxInfoMap_t::iterator infoIteratorForIdx(ChatLogIdx idx_);
+    size_t messagePos(ChatLogIdx idx) const;
 
     iterator adjustItForDate(iterator it, QDateTime timestamp);
 
-    void incrementLinePosAfter(IdxInfoMap_t::iterator it);
-    void decrementLinePosAfter(IdxInfoMap_t::iterator it);
+    iterator insertLine(iterator it, ChatLine::Ptr line, LineKey key);
+    void setDateLineAnchors(size_t pos, ChatLogIdx anchor);
     bool shouldRemovePreviousLine(iterator prevIt, iterator it);
 
+    static bool keyLess(const LineKey& lhs, const LineKey& rhs);
+
     std::vector<ChatLine::Ptr> lines;
+    std::vector<LineKey> lineKeys;
     std::map<ChatLine::Ptr, QDateTime> dateMap;
     IdxInfoMap_t idxInfoMap;
 };
@@ -19,6 +19,7 @@
 
 #include "chatmessage.h"
 #include "chatlinecontentproxy.h"
+#include "sendercolorcache.h"
 #include "textformatter.h"
 #include "content/filetransferwidget.h"
 #include "content/image.h"
@@ -28,10 +29,8 @@
 #include "content/timestamp.h"
 #include "content/broken.h"
 #include "src/widget/style.h"
-#include "src/widget/tool/identicon.h"
 
 #include <QDebug>
-#include <QCryptographicHash>
 
 #include "src/persistence/settings.h"
 #include "src/persistence/smileypack.h"
@@ -55,7 +54,8 @@ ChatMessage::Ptr ChatMessage::createChatMessage(const QString& pubkey, const QSt
                                                 MessageType type, bool isMe, MessageState state,
                                                 const QDateTime& date, DocumentCache& documentCache,
                                                 SmileyPack& smileyPack, Settings& settings,
-                                                Style& style, bool colorizeName)
+                                                Style& style, bool colorizeName,
+                                                SenderColorCache* senderColors)
 {
     ChatMessage::Ptr msg = ChatMessage::Ptr(new ChatMessage(documentCache, settings, style));
 
@@ -101,18 +101,8 @@ ChatMessage::Ptr ChatMessage::createChatMessage(const QString& pubkey, const QSt
 
     QColor color = style.getColor(Style::ColorPalette::MainText);
     if (colorizeName) {
-        QByteArray hash;
-        if (pubkey.isEmpty()) {
-            hash = QCryptographicHash::hash((sender.toUtf8()), QCryptographicHash::Sha256);
-        } else {
-            hash = QByteArray::fromHex(pubkey.toLatin1());
-        }
-        auto lightness = color.lightnessF();
-        // Adapt as good as possible to Light/Dark themes
-        lightness = lightness*0.5 + 0.3;
-
-        // Magic values
-        color.setHslF(Identicon::bytesToColor(hash.left(Identicon::IDENTICON_COLOR_BYTES)), 1.0, lightness);
+        color = senderColors ? senderColors->get(pubkey, sender, color)
+                             : SenderColorCache::computeColor(pubkey, sender, color);
 
         if (!isMe && textType == Text::NORMAL) {
                 textType = Text::CUSTOM;
@@ -28,6 +28,7 @@
 class CoreFile;
 class QGraphicsScene;
 class DocumentCache;
+class SenderColorCache;
 class SmileyPack;
 class Settings;
 class Style;
@@ -60,7 +61,8 @@ public:
     static ChatMessage::Ptr createChatMessage(const QString& pubkey, const QString& sender, const QString& rawMessage,
                                               MessageType type, bool isMe, MessageState state,
                                               const QDateTime& date, DocumentCache& documentCache,
-                                              SmileyPack& smileyPack, Settings& settings, Style& style, bool colorizeName = false);
+                                              SmileyPack& smileyPack, Settings& settings, Style& style, bool colorizeName = false,
+                                              SenderColorCache* senderColors = nullptr);
     static ChatMessage::Ptr createChatInfoMessage(const QString& rawMessage, SystemMessageType type,
                                                   const QDateTime& date, DocumentCache& documentCache, Settings& settings,
                                                   Style& style);
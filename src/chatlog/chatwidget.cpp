@@ -21,22 +21,28 @@
 #include "chatlinecontent.h"
 #include "chatlinecontentproxy.h"
 #include "chatmessage.h"
+#include "textlayoutpool.h"
+#include "thumbnailloader.h"
 #include "content/filetransferwidget.h"
-#include "content/image.h"
 #include "content/text.h"
+#include "content/thumbnail.h"
 #include "src/widget/translator.h"
 #include "src/widget/style.h"
+#include "src/widget/tool/windowvisibility.h"
 #include "src/persistence/settings.h"
 #include "src/chatlog/chatlinestorage.h"
+#include "util/cacheregistry.h"
+#include "util/hitchwatchdog.h"
+#include "util/tracer.h"
 #include <iostream>
 
 #include <QAction>
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
+#include <QFontMetricsF>
+#include <QMimeData>
 #include <QMouseEvent>
-#include <QPixmap>
-#include <QImage>
 #include <QScrollBar>
 #include <QShortcut>
 #include <Qt>
@@ -45,6 +51,8 @@
 #include <algorithm>
 #include <cassert>
 #include <set>
+#include <utility>
+#include <vector>
 
 
 namespace
@@ -52,8 +60,19 @@ namespace
 
 // Maximum number of rendered messages at any given time
 int constexpr maxWindowSize = 300;
+// Same in the low memory mode, must stay above windowChunkSize
+int constexpr lowMemoryWindowSize = 150;
 // Amount of messages to purge when removing messages
 int constexpr windowChunkSize = 100;
+// Lines within this fraction of the viewport height above and below it are kept in the scene
+qreal constexpr overscanViewports = 0.5;
+// Widths within one bucket share their cached line heights
+int constexpr widthBucketSize = 16;
+
+int windowSize()
+{
+    return CacheRegistry::getInstance().isLowMemory() ? lowMemoryWindowSize : maxWindowSize;
+}
 
 template <class T>
 T clamp(T x, T min, T max)
@@ -76,7 +95,8 @@ ChatMessage::Ptr createDateMessage(QDateTime timestamp, DocumentCache& documentC
 
 ChatMessage::Ptr createMessage(const QString& pubkey, const QString& displayName, bool isSelf, bool colorizeNames,
                                const ChatLogMessage& chatLogMessage, DocumentCache& documentCache,
-                               SmileyPack& smileyPack, Settings& settings, Style& style)
+                               SmileyPack& smileyPack, Settings& settings, Style& style,
+                               SenderColorCache& senderColors)
 {
     auto messageType = chatLogMessage.message.isAction ? ChatMessage::MessageType::ACTION
                                                        : ChatMessage::MessageType::NORMAL;
@@ -94,13 +114,14 @@ ChatMessage::Ptr createMessage(const QString& pubkey, const QString& displayName
     const auto timestamp = chatLogMessage.message.timestamp;
     return ChatMessage::createChatMessage(pubkey, displayName, chatLogMessage.message.content,messageType,
                                           isSelf, chatLogMessage.state, timestamp, documentCache,
-                                          smileyPack, settings, style, colorizeNames);
+                                          smileyPack, settings, style, colorizeNames, &senderColors);
 }
 
 void renderMessageRaw(const QString& pubkey, const QString& displayName, bool isSelf, bool colorizeNames,
                    ChatLogMessage& chatLogMessage, ChatLine::Ptr& chatLine,
                    DocumentCache& documentCache, SmileyPack& smileyPack,
-                   Settings& settings, Style& style)
+                   Settings& settings, Style& style, ThumbnailLoader& thumbnailLoader,
+                   SenderColorCache& senderColors)
 {
     // HACK: This is kind of gross, but there's not an easy way to fit this into
     // the existing architecture. This shouldn't ever fail since we should only
@@ -122,67 +143,23 @@ void renderMessageRaw(const QString& pubkey, const QString& displayName, bool is
     } else {
         if ((chatLogMessage.message.id_or_hash.size() > 8) && (chatLogMessage.message.content == "___"))
         {
-            QByteArray image_data_bytes = QByteArray::fromHex(chatLogMessage.message.id_or_hash.toLatin1());
-            QPixmap pixmap_;
-            bool result = pixmap_.loadFromData(image_data_bytes);
-            if (!result)
-            {
-                qDebug() << "renderMessageRaw:loadFromData:trying with hardcoded WEBP type";
-                result = pixmap_.loadFromData(image_data_bytes, "WEBP");
-            }
-            qDebug() << "renderMessageRaw:loadFromData:res=" << result;
-
-            if (result)
-            {
-                // chatLogMessage.message.content = QString("_\n_\n_\n_\n_\n_\n_\n_\n");
-                chatLogMessage.message.content = QString("** Group Image **");
-                chatLine = createMessage(pubkey, displayName, isSelf, colorizeNames, chatLogMessage,
-                    documentCache, smileyPack, settings, style);
-
-                // HINT: since i couldn't figure out why the image was always too high and to much left
-                //       this hack is used. it works.
-                // TODO: make a proper solution for image displayed in chatwindow
-                int qx = 500; // canvas 500x600 transparent
-                int qy = 600; // canvas 500x600 transparent
-                int s = 280; // image 280x280 max
-                int dx = qx-s;
-                std::ignore = dx;
-                int dy = qy-s;
-                QPixmap scaled_image = pixmap_.scaled(s, s, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                QPixmap target(qx, qy);
-                QRect tgt(0, dy, s, s); // put image left top at (0, dy) in target rectangle -> put it on horizontal left and vertical bottom
-                QRect src(0, 0, s, s);
-                target.fill(Qt::transparent);
-                QPainter *paint = new QPainter(&target);
-                paint->drawPixmap(tgt, scaled_image, src);
-                // -----------------------------
-                // HINT: show red bounding box of pixmap for debugging
-                // paint->setPen(QColor("red"));
-                // paint->drawRect(0, 0, qx-1, qy-1);
-                // paint->setPen(QColor("blue"));
-                // paint->drawLine(0, 0, qx-1, 0);
-                // -----------------------------
-                delete paint;
-
-                //chatLine->replaceContentImage(2, new Image(QSize(280, 280),
-                //    pixmap_.scaled(s, s, Qt::KeepAspectRatio, Qt::SmoothTransformation)));
-
-                chatLine->addColumn(
-                    new Image(QSize(qx, qy), target) ,
-                        ColumnFormat(1.0, ColumnFormat::VariableSize, ColumnFormat::Left));
-            }
-            else
-            {
-                // HINT: write error text into text field
-                chatLogMessage.message.content = QString("** ERROR decoding Image **");
-                chatLine = createMessage(pubkey, displayName, isSelf, colorizeNames, chatLogMessage,
-                    documentCache, smileyPack, settings, style);
-            }
+            chatLogMessage.message.content = QString("** Group Image **");
+            chatLine = createMessage(pubkey, displayName, isSelf, colorizeNames, chatLogMessage,
+                documentCache, smileyPack, settings, style, senderColors);
+
+            // HINT: the image is drawn at the left bottom of a transparent 500x600 canvas,
+            //       otherwise it was always too high and too much left.
+            // TODO: make a proper solution for image displayed in chatwindow
+            // the image is only decoded once the line becomes visible, see Thumbnail
+            chatLine->addColumn(
+                new Thumbnail(QSize(500, 600), QSize(280, 280), thumbnailLoader,
+                              chatLogMessage.message.id_or_hash),
+                ColumnFormat(1.0, ColumnFormat::VariableSize, ColumnFormat::Left));
         }
         else
         {
             chatLine = createMessage(pubkey, displayName, isSelf, colorizeNames, chatLogMessage,
-                documentCache, smileyPack, settings, style);
+                documentCache, smileyPack, settings, style, senderColors);
         }
     }
 }
@@ -253,6 +230,100 @@ void forEachLineIn(ChatLine::Ptr first, ChatLine::Ptr last, ChatLineStorage& sto
     }
 }
 
+/**
+ * @brief Texts of one line of a multi line selection, shallow copies of the ChatLine's texts.
+ */
+struct SelectedLine
+{
+    QString author;
+    QString timestamp;
+    QString message;
+};
+
+std::vector<SelectedLine> collectSelectedLines(ChatLine::Ptr first, ChatLine::Ptr last,
+                                               ChatLineStorage& storage, const QString& pending)
+{
+    std::vector<SelectedLine> lines;
+    forEachLineIn(first, last, storage, [&](ChatLine::Ptr& line) {
+        if (line->content[1]->getText().isEmpty())
+            return;
+
+        const QString timestamp = line->content[2]->getText();
+        lines.push_back({line->content[0]->getText(), timestamp.isEmpty() ? pending : timestamp,
+                         line->content[1]->getText()});
+    });
+    return lines;
+}
+
+/**
+ * @brief Formats selected lines as "[timestamp] author: message", one per line.
+ *
+ * The result is allocated once, appending to a growing string copied it over and over for large
+ * selections.
+ */
+QString formatSelectedLines(const std::vector<SelectedLine>& lines)
+{
+    int length = 0;
+    for (const SelectedLine& line : lines) {
+        // "[", "] ", ": " and the line break
+        length += line.author.size() + line.timestamp.size() + line.message.size() + 6;
+    }
+
+    QString out;
+    out.reserve(length);
+    for (const SelectedLine& line : lines) {
+        if (!out.isEmpty()) {
+            out += QLatin1Char('\n');
+        }
+
+        out += QLatin1Char('[');
+        out += line.timestamp;
+        out += QLatin1String("] ");
+        out += line.author;
+        out += QLatin1String(": ");
+        out += line.message;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Clipboard data that formats a multi line selection only once it's pasted.
+ *
+ * The X11 selection buffer is replaced on every mouse move while selecting, formatting a large
+ * selection each time blocked the GUI.
+ */
+class SelectionMimeData : public QMimeData
+{
+public:
+    explicit SelectionMimeData(std::vector<SelectedLine> lines_)
+        : lines{std::move(lines_)}
+    {
+    }
+
+    QStringList formats() const override
+    {
+        return {QStringLiteral("text/plain")};
+    }
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override
+    {
+        if (mimeType != QLatin1String("text/plain")) {
+            return QMimeData::retrieveData(mimeType, type);
+        }
+
+        if (text.isNull()) {
+            text = formatSelectedLines(lines);
+        }
+        return text;
+    }
+
+private:
+    std::vector<SelectedLine> lines;
+    mutable QString text;
+};
+
 /**
  * @brief Helper function to add an offset ot a ChatLogIdx without going
  * outside the bounds of the associated chatlog
@@ -281,7 +352,7 @@ ChatLogIdx clampedAdd(ChatLogIdx idx, int val, IChatLog& chatLog)
 
 ChatWidget::ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& documentCache_,
     SmileyPack& smileyPack_, Settings& settings_, Style& style_,
-    IMessageBoxManager& messageBoxManager_, QWidget* parent)
+    IMessageBoxManager& messageBoxManager_, const BlobStore& blobStore_, QWidget* parent)
     : QGraphicsView(parent)
     , selectionRectColor{style_.getColor(Style::ColorPalette::SelectText)}
     , chatLog(chatLog_)
@@ -292,6 +363,7 @@ ChatWidget::ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& doc
     , settings(settings_)
     , style{style_}
     , messageBoxManager{messageBoxManager_}
+    , thumbnailLoader{new ThumbnailLoader(blobStore_, this)}
 {
     // Create the scene
     busyScene = new QGraphicsScene(this);
@@ -299,6 +371,8 @@ ChatWidget::ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& doc
     scene->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
     setScene(scene);
 
+    estimatedLineHeight = QFontMetricsF(settings.getChatMessageFont()).lineSpacing();
+
     busyNotification = ChatMessage::createBusyNotification(documentCache, settings, style);
     busyNotification->addToScene(busyScene);
     busyNotification->visibilityChanged(true);
@@ -351,6 +425,15 @@ ChatWidget::ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& doc
     workerTimer->setInterval(5);
     connect(workerTimer, &QTimer::timeout, this, &ChatWidget::onWorkerTimeout);
 
+    // Measures offscreen lines on the thread pool after a resize
+    textLayoutPool = new TextLayoutPool(this);
+    connect(textLayoutPool, &TextLayoutPool::linesMeasured, this, &ChatWidget::onLinesMeasured);
+
+    // Defers rendering while our window can't be seen
+    windowVisibility = new WindowVisibility(this);
+    connect(windowVisibility, &WindowVisibility::renderedChanged, this,
+            &ChatWidget::onWindowRenderedChanged);
+
     // This timer is used to detect multiple clicks
     multiClickTimer = new QTimer(this);
     multiClickTimer->setSingleShot(true);
@@ -367,7 +450,7 @@ ChatWidget::ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& doc
 
     reloadTheme();
     retranslateUi();
-    Translator::registerHandler(std::bind(&ChatWidget::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ChatWidget::retranslateUi, this), this, this);
 
     connect(this, &ChatWidget::renderFinished, this, &ChatWidget::onRenderFinished);
     connect(&chatLog_, &IChatLog::itemUpdated, this, &ChatWidget::onMessageUpdated);
@@ -422,11 +505,23 @@ void ChatWidget::updateSceneRect()
     setSceneRect(calculateSceneRect());
 }
 
+/**
+ * @brief Positions the lines in the range below each other.
+ *
+ * Only lines in the scene are laid out, all others are placed using the height they had the last
+ * time they were laid out with a similar width and the same fonts. Lines that were never measured
+ * get an estimate, updateMaterializedLines() corrects it once they come close to the viewport.
+ */
 void ChatWidget::layout(int start, int end, qreal width)
 {
     if (chatLineStorage->empty())
         return;
 
+    HitchScope hitchScope{"chat layout"};
+    TRACE_SCOPE("ChatWidget::layout");
+
+    const int widthBucket = qRound(width / widthBucketSize);
+
     qreal h = 0.0;
 
     // Line at start-1 is considered to have the correct position. All following lines are
@@ -440,11 +535,102 @@ void ChatWidget::layout(int start, int end, qreal width)
     for (int i = start; i < end; ++i) {
         ChatLine* l = (*chatLineStorage)[i].get();
 
-        l->layout(width, QPointF(0.0, h));
+        if (l->isInScene()) {
+            l->layout(width, QPointF(0.0, h));
+            rememberHeight(*l, widthBucket);
+        } else {
+            qreal height;
+            if (!l->getCachedHeight(widthBucket, fontGeneration, height)) {
+                height = l->sceneBoundingRect().height();
+                if (height <= 0.0)
+                    height = estimatedLineHeight;
+            }
+            l->place(width, QPointF(0.0, h), height);
+        }
+
         h += l->sceneBoundingRect().height() + lineSpacing;
     }
 }
 
+void ChatWidget::rememberHeight(ChatLine& line, int widthBucket)
+{
+    const qreal height = line.sceneBoundingRect().height();
+    line.cacheHeight(widthBucket, fontGeneration, height);
+    // follow slowly, a single large image shouldn't throw off all estimates
+    estimatedLineHeight += (height - estimatedLineHeight) / 16.0;
+}
+
+/**
+ * @brief Adds the lines around the viewport to the scene and removes all others.
+ *
+ * Lines entering the scene are laid out for real. If their height differs from the cached or
+ * estimated one, all lines below are moved, and if that happened above the viewport the view is
+ * scrolled by the same amount so the visible content stays in place.
+ */
+void ChatWidget::updateMaterializedLines()
+{
+    const QRect visibleRect = getVisibleRect();
+    const qreal overscan = visibleRect.height() * overscanViewports;
+    const bool stb = stickToBottom();
+
+    auto lowerBound = std::lower_bound(chatLineStorage->begin(), chatLineStorage->end(),
+                                       visibleRect.top() - overscan, ChatLine::lessThanBSRectBottom);
+    auto upperBound = std::lower_bound(lowerBound, chatLineStorage->end(),
+                                       visibleRect.bottom() + overscan, ChatLine::lessThanBSRectTop);
+
+    const qreal width = useableWidth();
+    const int widthBucket = qRound(width / widthBucketSize);
+    qreal shift = 0.0;
+    qreal shiftAboveViewport = 0.0;
+
+    QList<ChatLine::Ptr> newMaterializedLines;
+    for (auto itr = lowerBound; itr != chatLineStorage->end(); ++itr) {
+        ChatLine::Ptr line = *itr;
+        if (itr >= upperBound) {
+            if (shift == 0.0)
+                break;
+
+            line->moveBy(shift);
+            continue;
+        }
+
+        newMaterializedLines.append(line);
+        if (materializedLines.removeOne(line)) {
+            line->moveBy(shift);
+            continue;
+        }
+
+        const QRectF placed = line->sceneBoundingRect().translated(0.0, shift);
+        line->addToScene(scene);
+        line->layout(width, placed.topLeft());
+        rememberHeight(*line, widthBucket);
+
+        const qreal delta = line->sceneBoundingRect().height() - placed.height();
+        shift += delta;
+        if (placed.bottom() < visibleRect.top())
+            shiftAboveViewport += delta;
+    }
+
+    // these lines are too far from the viewport
+    for (ChatLine::Ptr line : materializedLines)
+        line->removeFromScene();
+
+    materializedLines = newMaterializedLines;
+
+    if (shift == 0.0)
+        return;
+
+    updateSceneRect();
+    updateTypingNotification();
+    updateMultiSelectionRect();
+
+    if (stb) {
+        scrollToBottom();
+    } else if (shiftAboveViewport != 0.0) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() + qRound(shiftAboveViewport));
+    }
+}
+
 void ChatWidget::mousePressEvent(QMouseEvent* ev)
 {
     QGraphicsView::mousePressEvent(ev);
@@ -606,9 +792,6 @@ void ChatWidget::insertChatlines(std::map<ChatLogIdx, ChatLine::Ptr> chatLines)
     bool allLinesAtEnd = !chatLineStorage->hasIndexedMessage() || chatLines.begin()->first > chatLineStorage->lastIdx();
     auto startLineSize = chatLineStorage->size();
 
-    QGraphicsScene::ItemIndexMethod oldIndexMeth = scene->itemIndexMethod();
-    scene->setItemIndexMethod(QGraphicsScene::NoIndex);
-
     for (auto const& chatLine : chatLines) {
         auto idx = chatLine.first;
         auto const& l = chatLine.second;
@@ -626,20 +809,15 @@ void ChatWidget::insertChatlines(std::map<ChatLogIdx, ChatLine::Ptr> chatLines)
             // above the line we'd like to insert.
             auto dateLine = createDateMessage(date, documentCache, settings, style);
             chatLineStorage->insertDateLine(date, dateLine);
-            dateLine->addToScene(scene);
             dateLine->visibilityChanged(false);
         }
 
-        l->addToScene(scene);
-
-        // Optimization copied from previous implementation of upwards
-        // rendering. This will be changed when we call updateVisibility
-        // later
+        // Lines are only added to the scene once they get close to the
+        // viewport, see updateMaterializedLines(). This will be changed when
+        // we call checkVisibility later
         l->visibilityChanged(false);
     }
 
-    scene->setItemIndexMethod(oldIndexMeth);
-
     // If all insertions are at the bottom we can get away with only rendering
     // the updated lines, otherwise we need to go through the resize workflow to
     // re-layout everything asynchronously.
@@ -708,6 +886,58 @@ void ChatWidget::startResizeWorker()
     workerTimer->start();
 
     verticalScrollBar()->hide();
+
+    measureOffscreenLines();
+}
+
+/**
+ * @brief Measures the lines outside of the scene on the thread pool.
+ *
+ * Until the results arrive these lines are placed with estimated heights.
+ */
+void ChatWidget::measureOffscreenLines()
+{
+    const qreal width = useableWidth();
+    const int widthBucket = qRound(width / widthBucketSize);
+
+    std::vector<ChatLine::Ptr> lines;
+    for (const ChatLine::Ptr& line : *chatLineStorage) {
+        qreal height;
+        if (!line->isInScene() && !line->getCachedHeight(widthBucket, fontGeneration, height))
+            lines.push_back(line);
+    }
+
+    textLayoutPool->measure(lines, width, widthBucket, fontGeneration);
+}
+
+/**
+ * @brief Moves the lines to their measured heights, keeping the visible content in place.
+ */
+void ChatWidget::onLinesMeasured()
+{
+    if (workerTimer->isActive()) {
+        // positioning is cheap, start over so all lines use the new heights
+        workerLastIndex = 0;
+        return;
+    }
+
+    const bool stb = stickToBottom();
+    const ChatLine::Ptr anchorLine = visibleLines.empty() ? ChatLine::Ptr() : visibleLines.first();
+    const qreal anchorOffset =
+        anchorLine ? anchorLine->sceneBoundingRect().top() - verticalScrollBar()->value() : 0.0;
+
+    layout(0, chatLineStorage->size(), useableWidth());
+    updateSceneRect();
+    updateTypingNotification();
+    updateMultiSelectionRect();
+
+    if (stb) {
+        scrollToBottom();
+    } else if (anchorLine) {
+        verticalScrollBar()->setValue(qRound(anchorLine->sceneBoundingRect().top() - anchorOffset));
+    }
+
+    checkVisibility();
 }
 
 void ChatWidget::mouseDoubleClickEvent(QMouseEvent* ev)
@@ -747,23 +977,9 @@ QString ChatWidget::getSelectedText() const
         return selClickedRow->content[selClickedCol]->getSelectedText();
     } else if (selectionMode == SelectionMode::Multi) {
         // build a nicely formatted message
-        QString out;
-
-        forEachLineIn(selFirstRow, selLastRow, *chatLineStorage, [&] (ChatLine::Ptr& line) {
-            if (line->content[1]->getText().isEmpty())
-                return;
-
-            QString timestamp = line->content[2]->getText().isEmpty()
-                                    ? tr("pending")
-                                    : line->content[2]->getText();
-            QString author = line->content[0]->getText();
-            QString msg = line->content[1]->getText();
-
-            out +=
-                QString(out.isEmpty() ? QStringLiteral("[%2] %1: %3") : QStringLiteral("\n[%2] %1: %3")).arg(author, timestamp, msg);
-        });
-
-        return out;
+        const auto lines =
+            collectSelectedLines(selFirstRow, selLastRow, *chatLineStorage, tr("pending"));
+        return lines.empty() ? QString() : formatSelectedLines(lines);
     }
 
     return QString();
@@ -804,6 +1020,11 @@ void ChatWidget::clear()
         }
     }
 
+    // the kept file transfers are materialized again where they end up
+    for (ChatLine::Ptr line : materializedLines)
+        line->removeFromScene();
+
+    materializedLines.clear();
     visibleLines.clear();
 
     checkVisibility();
@@ -812,11 +1033,23 @@ void ChatWidget::clear()
 
 void ChatWidget::copySelectedText(bool toSelectionBuffer) const
 {
-    QString text = getSelectedText();
     QClipboard* clipboard = QApplication::clipboard();
+    if (!clipboard)
+        return;
+
+    const QClipboard::Mode mode = toSelectionBuffer ? QClipboard::Selection : QClipboard::Clipboard;
+    if (selectionMode == SelectionMode::Multi) {
+        auto lines = collectSelectedLines(selFirstRow, selLastRow, *chatLineStorage, tr("pending"));
+        if (!lines.empty()) {
+            // the clipboard takes ownership
+            clipboard->setMimeData(new SelectionMimeData(std::move(lines)), mode);
+        }
+        return;
+    }
 
-    if (clipboard && !text.isNull())
-        clipboard->setText(text, toSelectionBuffer ? QClipboard::Selection : QClipboard::Clipboard);
+    QString text = getSelectedText();
+    if (!text.isNull())
+        clipboard->setText(text, mode);
 }
 
 void ChatWidget::setTypingNotificationVisible(bool visible)
@@ -866,6 +1099,10 @@ void ChatWidget::selectAll()
 
 void ChatWidget::fontChanged(const QFont& font)
 {
+    // cached heights are only valid for the old font
+    ++fontGeneration;
+    estimatedLineHeight = QFontMetricsF(font).lineSpacing();
+
     for (ChatLine::Ptr l : *chatLineStorage) {
         l->fontChanged(font);
     }
@@ -879,6 +1116,7 @@ void ChatWidget::reloadTheme()
     selGraphItem->setBrush(QBrush(selectionRectColor));
     selGraphItem->setPen(QPen(selectionRectColor.darker(120)));
     setTypingNotification();
+    senderColors.clear();
 
     for (ChatLine::Ptr l : *chatLineStorage) {
         l->reloadTheme();
@@ -976,6 +1214,8 @@ void ChatWidget::handleSearchResult(SearchResult result, SearchDirection directi
 
 void ChatWidget::forceRelayout()
 {
+    // e.g. the emoji size changed, nothing cached can be trusted
+    ++fontGeneration;
     startResizeWorker();
 }
 
@@ -984,6 +1224,8 @@ void ChatWidget::checkVisibility()
     if (chatLineStorage->empty())
         return;
 
+    updateMaterializedLines();
+
     // find first visible line
     auto lowerBound = std::lower_bound(chatLineStorage->begin(), chatLineStorage->end(), getVisibleRect().top(),
                                        ChatLine::lessThanBSRectBottom);
@@ -1103,6 +1345,7 @@ void ChatWidget::removeLines(ChatLogIdx begin, ChatLogIdx end)
     // Batching all our erases into one call would be more efficient
     for (auto it = chatLineStorage->find(begin); it != chatLineStorage->find(end);) {
         (*it)->removeFromScene();
+        materializedLines.removeOne(*it);
         it = chatLineStorage->erase(it);
     }
 
@@ -1186,8 +1429,66 @@ void ChatWidget::onMultiClickTimeout()
 
 void ChatWidget::onMessageUpdated(ChatLogIdx idx)
 {
-    if (shouldRenderMessage(idx)) {
-        renderMessage(idx);
+    if (!shouldRenderMessage(idx)) {
+        return;
+    }
+
+    if (!windowVisibility->isRendered()) {
+        if (chatLineStorage->contains(idx)) {
+            deferredUpdates.insert(idx);
+        } else {
+            deferredAppend = true;
+        }
+        return;
+    }
+
+    renderMessage(idx);
+}
+
+/**
+ * @brief Pauses the selection scroll timer while hidden and catches up on deferred messages.
+ */
+void ChatWidget::onWindowRenderedChanged(bool rendered)
+{
+    if (!rendered) {
+        selectionTimer->stop();
+        return;
+    }
+
+    selectionTimer->start();
+    renderDeferredMessages();
+}
+
+/**
+ * @brief Renders what changed while the window couldn't be seen, at once.
+ *
+ * A busy group in a minimized or covered window would otherwise lay out every message as it
+ * arrives, the user only sees the result. Messages appended meanwhile are rendered in one
+ * batch, or as a new window at the bottom if more arrived than are kept rendered.
+ */
+void ChatWidget::renderDeferredMessages()
+{
+    if (deferredAppend) {
+        deferredAppend = false;
+        const ChatLogIdx end = chatLog.getNextIdx();
+        if (!chatLineStorage->hasIndexedMessage()) {
+            renderMessages(clampedAdd(end, -windowSize(), chatLog), end);
+        } else {
+            const ChatLogIdx begin = chatLineStorage->lastIdx() + 1;
+            if (end - begin > static_cast<size_t>(windowSize()) && stickToBottom()) {
+                setRenderedWindowEnd(end - 1);
+            } else {
+                renderMessages(begin, end);
+            }
+        }
+    }
+
+    const std::set<ChatLogIdx> updates = std::move(deferredUpdates);
+    deferredUpdates.clear();
+    for (ChatLogIdx idx : updates) {
+        if (chatLineStorage->contains(idx)) {
+            renderMessage(idx);
+        }
     }
 }
 
@@ -1198,6 +1499,8 @@ void ChatWidget::renderMessage(ChatLogIdx idx)
 
 void ChatWidget::renderMessages(ChatLogIdx begin, ChatLogIdx end)
 {
+    HitchScope hitchScope{"chat render"};
+    TRACE_SCOPE("ChatWidget::renderMessages");
     auto linesToRender = std::map<ChatLogIdx, ChatLine::Ptr>();
 
     for (auto i = begin; i < end; ++i) {
@@ -1219,7 +1522,8 @@ void ChatWidget::setRenderedWindowStart(ChatLogIdx begin)
 {
     // End of the window is pre-determined as a hardcoded window size relative
     // to the start
-    auto end = clampedAdd(begin, maxWindowSize, chatLog);
+    auto end = clampedAdd(begin, windowSize(), chatLog);
+    chatLog.setRenderedWindow(begin, end);
 
     // Use invalid + equal ChatLogIdx to force a full re-render if we do not
     // have an indexed message to compare to
@@ -1260,8 +1564,8 @@ void ChatWidget::setRenderedWindowStart(ChatLogIdx begin)
 
 void ChatWidget::setRenderedWindowEnd(ChatLogIdx end)
 {
-    // Off by 1 since the maxWindowSize is not inclusive
-    auto start = clampedAdd(end, -maxWindowSize + 1, chatLog);
+    // Off by 1 since the window size is not inclusive
+    auto start = clampedAdd(end, -windowSize() + 1, chatLog);
 
     setRenderedWindowStart(start);
 }
@@ -1391,14 +1695,24 @@ void ChatWidget::showEvent(QShowEvent* event)
 void ChatWidget::hideEvent(QHideEvent* event)
 {
     std::ignore = event;
-    // Purge accumulated lines from the chatlog. We do not purge messages while
-    // the chatlog is open because it causes flickers. When a user leaves the
-    // chat we take the opportunity to remove old messages. If a user only has
-    // one friend this could end up accumulating chat logs until they restart
-    // qTox, but that isn't a regression from previously released behavior.
-
-    auto numLinesToRemove = chatLineStorage->size() > maxWindowSize
-        ? chatLineStorage->size() - maxWindowSize
+    // Empty.
+    // Hidden chats stay laid out in the form cache of their ContentLayout, lines are only
+    // purged by trimLines() once the form is evicted.
+}
+
+/**
+ * @brief Purge accumulated lines from the chatlog.
+ *
+ * We do not purge messages while the chatlog is open because it causes flickers. When the
+ * chat form leaves the form cache of its ContentLayout we take the opportunity to remove old
+ * messages. If a user only has a few chats this could end up accumulating chat logs until they
+ * restart qTox, but that isn't a regression from previously released behavior.
+ */
+void ChatWidget::trimLines()
+{
+    const size_t maxLines = static_cast<size_t>(windowSize());
+    auto numLinesToRemove = chatLineStorage->size() > maxLines
+        ? chatLineStorage->size() - maxLines
         : 0;
 
     if (numLinesToRemove > 0) {
@@ -1499,7 +1813,7 @@ void ChatWidget::renderItem(const ChatLogItem& item, bool hideName, bool coloriz
         // HINT: ***********render message**********
         // qDebug() << QString("renderItem:id_or_hash") << chatLogMessage.message.id_or_hash.left(5);
         renderMessageRaw(sender.toString(), item.getDisplayName(), isSelf, colorizeNames_, chatLogMessage,
-            chatMessage, documentCache, smileyPack, settings, style);
+            chatMessage, documentCache, smileyPack, settings, style, *thumbnailLoader, senderColors);
 
         break;
     }
@@ -25,8 +25,11 @@
 
 #include "chatline.h"
 #include "chatmessage.h"
+#include "sendercolorcache.h"
 #include "src/model/ichatlog.h"
 
+#include <set>
+
 class QGraphicsScene;
 class QGraphicsRectItem;
 class QMouseEvent;
@@ -38,6 +41,10 @@ class Settings;
 class Style;
 class ChatLineStorage;
 class IMessageBoxManager;
+class BlobStore;
+class TextLayoutPool;
+class ThumbnailLoader;
+class WindowVisibility;
 
 static const size_t DEF_NUM_MSG_TO_LOAD = 100;
 class ChatWidget : public QGraphicsView
@@ -46,7 +53,8 @@ class ChatWidget : public QGraphicsView
 public:
     ChatWidget(IChatLog& chatLog_, const Core& core_, DocumentCache& documentCache,
         SmileyPack& smileyPack, Settings& settings, Style& style,
-        IMessageBoxManager& messageBoxManager, QWidget* parent = nullptr);
+        IMessageBoxManager& messageBoxManager, const BlobStore& blobStore,
+        QWidget* parent = nullptr);
     virtual ~ChatWidget();
 
     void insertChatlines(std::map<ChatLogIdx, ChatLine::Ptr> chatLines);
@@ -69,6 +77,7 @@ public:
     void setColorizedNames(bool enable) { colorizeNames = enable; };
     void jumpToDate(QDate date);
     void jumpToIdx(ChatLogIdx idx);
+    void trimLines();
 
 signals:
     void selectionChanged();
@@ -100,6 +109,7 @@ private slots:
 
     void onRenderFinished();
     void onScrollValueChanged(int value);
+    void onLinesMeasured();
 protected:
     QRectF calculateSceneRect() const;
     QRect getVisibleRect() const;
@@ -113,8 +123,11 @@ protected:
 
     void updateSceneRect();
     void checkVisibility();
+    void updateMaterializedLines();
+    void rememberHeight(ChatLine& line, int widthBucket);
     void scrollToBottom();
     void startResizeWorker();
+    void measureOffscreenLines();
 
     void mouseDoubleClickEvent(QMouseEvent* ev) final;
     void mousePressEvent(QMouseEvent* ev) final;
@@ -152,6 +165,8 @@ private:
     void renderFile(QString displayName, ToxFile file, bool isSelf, QDateTime timestamp, ChatLine::Ptr &chatMessage);
     bool needsToHideName(ChatLogIdx idx, bool prevIdxRendered) const;
     bool shouldRenderMessage(ChatLogIdx idx) const;
+    void onWindowRenderedChanged(bool rendered);
+    void renderDeferredMessages();
     void disableSearchText();
 private:
     enum class SelectionMode
@@ -173,6 +188,8 @@ private:
     QGraphicsScene* scene = nullptr;
     QGraphicsScene* busyScene = nullptr;
     QList<ChatLine::Ptr> visibleLines;
+    // lines with their content in the scene, the visible ones plus some overscan
+    QList<ChatLine::Ptr> materializedLines;
     ChatLine::Ptr typingNotification;
     ChatLine::Ptr busyNotification;
 
@@ -195,6 +212,8 @@ private:
     QTimer* selectionTimer = nullptr;
     QTimer* workerTimer = nullptr;
     QTimer* multiClickTimer = nullptr;
+    TextLayoutPool* textLayoutPool = nullptr;
+    WindowVisibility* windowVisibility = nullptr;
     AutoScrollDirection selectionScrollDir = AutoScrollDirection::NoDirection;
     int clickCount = 0;
     QPoint lastClickPos;
@@ -208,6 +227,8 @@ private:
     // layout
     QMargins margins = QMargins(10, 10, 10, 10);
     qreal lineSpacing = 5.0;
+    unsigned fontGeneration = 0;
+    qreal estimatedLineHeight = 0.0;
 
     IChatLog& chatLog;
     bool colorizeNames = false;
@@ -215,12 +236,19 @@ private:
     const Core& core;
     bool scrollMonitoringEnabled = true;
 
+    // updates of rendered messages that arrived while the window couldn't be seen
+    std::set<ChatLogIdx> deferredUpdates;
+    // messages were appended while the window couldn't be seen
+    bool deferredAppend = false;
+
     std::unique_ptr<ChatLineStorage> chatLineStorage;
 
     std::vector<std::function<void(void)>> renderCompletionFns;
     DocumentCache& documentCache;
+    SenderColorCache senderColors;
     SmileyPack& smileyPack;
     Settings& settings;
     Style& style;
     IMessageBoxManager& messageBoxManager;
+    ThumbnailLoader* thumbnailLoader;
 };
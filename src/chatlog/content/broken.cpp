@@ -24,9 +24,12 @@
 class QStyleOptionGraphicsItem;
 
 Broken::Broken(const QString& img, QSize size_)
-    : pmap{PixmapCache::getInstance().get(img, size_)}
-    , size{size_}
+    : size{size_}
 {
+    pmap = PixmapCache::getInstance().get(img, size, this, [this](const QPixmap& pixmap) {
+        pmap = pixmap;
+        update();
+    });
 }
 
 QRectF Broken::boundingRect() const
@@ -18,24 +18,25 @@
 */
 
 #include "notificationicon.h"
+#include "../animationticker.h"
 #include "../pixmapcache.h"
 #include "src/widget/style.h"
 
-#include <QGraphicsScene>
 #include <QPainter>
-#include <QTimer>
 
 NotificationIcon::NotificationIcon(Settings& settings, Style& style, QSize Size)
     : size(Size)
 {
-    pmap = PixmapCache::getInstance().get(style.getImagePath("chatArea/typing.svg", settings), size);
-
-    // Timer for the animation, if the Widget is not redrawn, no paint events will
-    // arrive and the timer will not be restarted, so this stops automatically
-    updateTimer.setInterval(1000 / framerate);
-    updateTimer.setSingleShot(true);
+    pmap = PixmapCache::getInstance().get(style.getImagePath("chatArea/typing.svg", settings), size,
+                                          this, [this](const QPixmap& pixmap) {
+                                              pmap = pixmap;
+                                              update();
+                                          });
+}
 
-    connect(&updateTimer, &QTimer::timeout, this, &NotificationIcon::updateGradient);
+NotificationIcon::~NotificationIcon()
+{
+    AnimationTicker::getInstance().cancelFrame(this);
 }
 
 QRectF NotificationIcon::boundingRect() const
@@ -53,9 +54,9 @@ void NotificationIcon::paint(QPainter* painter, const QStyleOptionGraphicsItem*
     painter->fillRect(QRect(0, 0, size.width(), size.height()), grad);
     painter->drawPixmap(0, 0, size.width(), size.height(), pmap);
 
-    if (!updateTimer.isActive()) {
-        updateTimer.start();
-    }
+    // if the Widget is not redrawn, no paint events will arrive and no new frame is
+    // requested, so this stops automatically
+    AnimationTicker::getInstance().requestFrame(this);
 
     std::ignore = option;
     std::ignore = widget;
@@ -71,8 +72,10 @@ qreal NotificationIcon::getAscent() const
     return 3.0;
 }
 
-void NotificationIcon::updateGradient()
+void NotificationIcon::animationTick(qint64 nowMs)
 {
+    std::ignore = nowMs;
+
     // Update for next frame
     alpha += 0.01;
 
@@ -86,8 +89,4 @@ void NotificationIcon::updateGradient()
     grad.setColorAt(alpha, Qt::black);
     grad.setColorAt(qMin(1.0, alpha + dotWidth), Qt::lightGray);
     grad.setColorAt(1, Qt::lightGray);
-
-    if (scene() && isVisible()) {
-        scene()->invalidate(sceneBoundingRect());
-    }
 }
@@ -23,7 +23,6 @@
 
 #include <QLinearGradient>
 #include <QPixmap>
-#include <QTimer>
 
 class Settings;
 class Style;
@@ -33,23 +32,19 @@ class NotificationIcon : public ChatLineContent
     Q_OBJECT
 public:
     NotificationIcon(Settings& settings, Style& style, QSize size);
+    ~NotificationIcon() override;
 
     QRectF boundingRect() const override;
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
                        QWidget* widget) override;
     void setWidth(float width) override;
     qreal getAscent() const override;
-
-private slots:
-    void updateGradient();
+    void animationTick(qint64 nowMs) override;
 
 private:
-    static constexpr int framerate = 30; // 30Hz
-
     QSize size;
     QPixmap pmap;
     QLinearGradient grad;
-    QTimer updateTimer;
 
     qreal dotWidth = 0.2;
     qreal alpha = 0.0;
@@ -18,12 +18,11 @@
 */
 
 #include "spinner.h"
+#include "../animationticker.h"
 #include "../pixmapcache.h"
 
 #include <QDebug>
-#include <QGraphicsScene>
 #include <QPainter>
-#include <QTime>
 #include <QVariantAnimation>
 
 #include <math.h>
@@ -32,12 +31,10 @@ Spinner::Spinner(const QString& img, QSize Size, qreal speed)
     : size(Size)
     , rotSpeed(speed)
 {
-    pmap = PixmapCache::getInstance().get(img, size);
-
-    // Timer for the animation, if the Widget is not redrawn, no paint events will
-    // arrive and the timer will not be restarted, so this stops automatically
-    timer.setInterval(1000 / framerate);
-    timer.setSingleShot(true);
+    pmap = PixmapCache::getInstance().get(img, size, this, [this](const QPixmap& pixmap) {
+        pmap = pixmap;
+        update();
+    });
 
     blendAnimation = new QVariantAnimation(this);
     blendAnimation->setStartValue(0.0);
@@ -47,8 +44,11 @@ Spinner::Spinner(const QString& img, QSize Size, qreal speed)
     blendAnimation->start(QAbstractAnimation::DeleteWhenStopped);
     connect(blendAnimation, &QVariantAnimation::valueChanged, this,
             [this](const QVariant& val) { alpha = val.toDouble(); });
+}
 
-    QObject::connect(&timer, &QTimer::timeout, this, &Spinner::timeout);
+Spinner::~Spinner()
+{
+    AnimationTicker::getInstance().cancelFrame(this);
 }
 
 QRectF Spinner::boundingRect() const
@@ -67,9 +67,9 @@ void Spinner::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, Q
     painter->setRenderHint(QPainter::SmoothPixmapTransform);
     painter->drawPixmap(0, 0, pmap);
 
-    if (!timer.isActive()) {
-        timer.start(); // update bounding rectangle for next frame
-    }
+    // if the Widget is not redrawn, no paint events will arrive and no new frame is
+    // requested, so this stops automatically
+    AnimationTicker::getInstance().requestFrame(this);
 
     std::ignore = option;
     std::ignore = widget;
@@ -85,14 +85,9 @@ qreal Spinner::getAscent() const
     return 0.0;
 }
 
-void Spinner::timeout()
+void Spinner::animationTick(qint64 nowMs)
 {
-    // Use global time, so the animations are synced
-    float angle = QTime::currentTime().msecsSinceStartOfDay() / 1000.0f * rotSpeed;
+    float angle = nowMs / 1000.0f * rotSpeed;
     // limit to the range [0.0 - 360.0]
     curRot = remainderf(angle, 360.0f);
-
-    if (scene()) {
-        scene()->invalidate(sceneBoundingRect());
-    }
 }
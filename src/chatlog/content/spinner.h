@@ -23,7 +23,6 @@
 
 #include <QObject>
 #include <QPixmap>
-#include <QTimer>
 
 class QVariantAnimation;
 
@@ -32,23 +31,20 @@ class Spinner : public ChatLineContent
     Q_OBJECT
 public:
     Spinner(const QString& img, QSize size, qreal speed);
+    ~Spinner() override;
 
     QRectF boundingRect() const override;
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
                        QWidget* widget) override;
     void setWidth(float width) override;
     qreal getAscent() const override;
-
-private slots:
-    void timeout();
+    void animationTick(qint64 nowMs) override;
 
 private:
-    static constexpr int framerate = 30; // 30Hz
     QSize size;
     QPixmap pmap;
     float rotSpeed;
-    float curRot;
-    QTimer timer;
+    float curRot = 0.0f;
     qreal alpha = 0.0;
     QVariantAnimation* blendAnimation;
 };
@@ -19,6 +19,9 @@
 
 #include "text.h"
 #include "../documentcache.h"
+#include "../textlayoutpool.h"
+#include "../textrastercache.h"
+#include "src/persistence/settings.h"
 
 #include <QAbstractTextDocumentLayout>
 #include <QApplication>
@@ -29,6 +32,7 @@
 #include <QPainter>
 #include <QPalette>
 #include <QTextBlock>
+#include <QtMath>
 #include <QTextFragment>
 
 Text::Text(DocumentCache& documentCache_, Settings& settings_, Style& style_,
@@ -43,6 +47,7 @@ Text::Text(DocumentCache& documentCache_, Settings& settings_, Style& style_,
     , settings{settings_}
     , defStyleSheet(style_.getStylesheet(QStringLiteral("chatArea/innerStyle.css"), settings_, font))
     , style{style_}
+    , rasterId{TextRasterCache::nextId()}
 {
     color = textColor();
     setText(txt);
@@ -62,6 +67,8 @@ Text::~Text()
 {
     if (doc)
         documentCache.push(doc);
+
+    TextRasterCache::getInstance().drop(rasterId);
 }
 
 void Text::setText(const QString& txt)
@@ -230,6 +237,52 @@ void Text::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWid
 
     painter->setClipRect(boundingRect());
 
+    // unselected text looks the same until it's regenerated, blit it while scrolling
+    if (!hasSelection() && paintRaster(painter)) {
+        return;
+    }
+
+    drawDocument(painter);
+}
+
+/**
+ * @brief Paints the text from the TextRasterCache, rendering it there first if needed.
+ * @return False if the text has to be drawn directly.
+ */
+bool Text::paintRaster(QPainter* painter)
+{
+    // scaled or rotated views would blur the pixmap
+    if (painter->worldTransform().type() > QTransform::TxTranslate || size.isEmpty()) {
+        return false;
+    }
+
+    const qreal dpr = painter->device()->devicePixelRatioF();
+    const QSize deviceSize{qCeil(size.width() * dpr), qCeil(size.height() * dpr)};
+    TextRasterCache& cache = TextRasterCache::getInstance();
+    QPixmap pixmap = cache.get(rasterId, deviceSize);
+    if (pixmap.isNull()) {
+        pixmap = QPixmap{deviceSize};
+        pixmap.setDevicePixelRatio(dpr);
+        pixmap.fill(Qt::transparent);
+        QPainter rasterPainter{&pixmap};
+        rasterPainter.setRenderHints(painter->renderHints());
+        drawDocument(&rasterPainter);
+        rasterPainter.end();
+
+        if (!cache.insert(rasterId, pixmap)) {
+            return false;
+        }
+    }
+
+    painter->drawPixmap(QPointF{0, 0}, pixmap);
+    return true;
+}
+
+/**
+ * @brief Draws the document with the current selection.
+ */
+void Text::drawDocument(QPainter* painter)
+{
     // draw selection
     QAbstractTextDocumentLayout::PaintContext ctx;
     QAbstractTextDocumentLayout::Selection sel;
@@ -273,6 +326,17 @@ qreal Text::getAscent() const
     return ascent;
 }
 
+bool Text::getLayoutInput(qreal width_, TextLayoutInput& input) const
+{
+    input.text = text;
+    input.font = defFont;
+    input.styleSheet = defStyleSheet;
+    input.elide = elide;
+    input.width = width_;
+    input.emojiSize = settings.getEmojiFontPointSize();
+    return true;
+}
+
 void Text::mousePressEvent(QGraphicsSceneMouseEvent* event)
 {
     if (event->button() == Qt::LeftButton)
@@ -332,6 +396,8 @@ void Text::regenerate()
     }
 
     if (dirty) {
+        // content, width or colors changed, the rendering is stale
+        TextRasterCache::getInstance().drop(rasterId);
         doc->setDefaultFont(defFont);
 
         if (elide) {
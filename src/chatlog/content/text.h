@@ -24,6 +24,8 @@
 
 #include <QFont>
 
+#include <cstdint>
+
 class QTextDocument;
 class DocumentCache;
 class Settings;
@@ -73,6 +75,7 @@ public:
     void reloadTheme() final;
 
     qreal getAscent() const final;
+    bool getLayoutInput(qreal width, TextLayoutInput& input) const final;
     void mousePressEvent(QGraphicsSceneMouseEvent* event) final;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) final;
     void hoverMoveEvent(QGraphicsSceneHoverEvent* event) final;
@@ -100,6 +103,8 @@ protected:
 private:
     void selectText(QTextCursor& cursor, const std::pair<int, int>& point);
     QColor textColor() const;
+    void drawDocument(QPainter* painter);
+    bool paintRaster(QPainter* painter);
 
     QString text;
     QString rawText;
@@ -119,4 +124,5 @@ private:
     Settings& settings;
     QString defStyleSheet;
     Style& style;
+    const uint64_t rasterId;
 };
@@ -0,0 +1,153 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "thumbnail.h"
+#include "../thumbnailloader.h"
+
+#include <QDebug>
+#include <QGraphicsSceneMouseEvent>
+#include <QGuiApplication>
+#include <QLabel>
+#include <QPainter>
+#include <QScreen>
+#include <QScrollArea>
+
+/**
+ * @class Thumbnail
+ * @brief Downscaled image of a group image message, the full image opens on click.
+ *
+ * The thumbnail is only loaded while the line is visible and dropped again once it scrolls out
+ * of view, the ThumbnailLoader caches it on disk so showing it again is cheap.
+ */
+
+/**
+ * @param size Size of the content, the thumbnail is drawn at its bottom left.
+ * @param thumbnailSize Size the image is scaled to fit into.
+ * @param loader Decodes the image.
+ * @param imageId Id of the image message, a blob reference or inline hex data.
+ */
+Thumbnail::Thumbnail(QSize size_, QSize thumbnailSize_, ThumbnailLoader& loader_,
+                     const QString& imageId_)
+    : size{size_}
+    , thumbnailSize{thumbnailSize_}
+    , loader{loader_}
+    , imageId{imageId_}
+{
+    setCursor(Qt::PointingHandCursor);
+}
+
+QRectF Thumbnail::boundingRect() const
+{
+    return QRectF(QPointF(-size.width() / 2.0, -size.height() / 2.0), size);
+}
+
+void Thumbnail::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    painter->setClipRect(boundingRect());
+
+    const QRectF rect = thumbnailRect();
+    if (failed) {
+        painter->drawText(rect, Qt::AlignLeft | Qt::AlignBottom, tr("Image could not be decoded"));
+    } else if (!pmap.isNull()) {
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawPixmap(rect.topLeft(), pmap);
+    }
+
+    std::ignore = option;
+    std::ignore = widget;
+}
+
+void Thumbnail::setWidth(float width)
+{
+    std::ignore = width;
+}
+
+qreal Thumbnail::getAscent() const
+{
+    return 0.0;
+}
+
+void Thumbnail::visibilityChanged(bool visible_)
+{
+    visible = visible_;
+    if (!visible) {
+        // cheap to load again from the cache, no need to keep it in memory
+        pmap = QPixmap();
+        return;
+    }
+
+    if (!pmap.isNull() || loading || failed) {
+        return;
+    }
+
+    loading = true;
+    loader.loadThumbnail(imageId, thumbnailSize, this, [this](const QImage& image) {
+        loading = false;
+        failed = image.isNull();
+        if (visible && !failed) {
+            pmap = QPixmap::fromImage(image);
+        }
+        update();
+    });
+}
+
+void Thumbnail::mousePressEvent(QGraphicsSceneMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton) {
+        event->accept(); // grabber
+    }
+}
+
+void Thumbnail::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton || failed || !thumbnailRect().contains(event->pos())) {
+        return;
+    }
+
+    loader.loadImage(imageId, this, [this](const QImage& image) { showFullImage(image); });
+}
+
+QRectF Thumbnail::thumbnailRect() const
+{
+    const QRectF bounds = boundingRect();
+    const QSizeF shown = pmap.isNull() ? QSizeF(thumbnailSize)
+                                       : QSizeF(pmap.size()) / pmap.devicePixelRatio();
+    return QRectF(QPointF(bounds.left(), bounds.bottom() - thumbnailSize.height()), shown);
+}
+
+void Thumbnail::showFullImage(const QImage& image)
+{
+    if (image.isNull()) {
+        qWarning() << "Couldn't decode the full group image";
+        return;
+    }
+
+    auto label = new QLabel();
+    label->setPixmap(QPixmap::fromImage(image));
+
+    auto view = new QScrollArea();
+    view->setAttribute(Qt::WA_DeleteOnClose);
+    view->setWindowTitle(tr("Group Image"));
+    view->setWidget(label);
+
+    const QSize available = QGuiApplication::primaryScreen()->availableSize() * 0.8;
+    view->resize(image.size().boundedTo(available) + QSize(2, 2) * view->frameWidth());
+    view->show();
+}
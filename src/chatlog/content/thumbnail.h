@@ -0,0 +1,62 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "../chatlinecontent.h"
+
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+
+class QImage;
+class ThumbnailLoader;
+
+class Thumbnail : public ChatLineContent
+{
+    Q_OBJECT
+public:
+    Thumbnail(QSize size, QSize thumbnailSize, ThumbnailLoader& loader, const QString& imageId);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+               QWidget* widget) override;
+    void setWidth(float width) override;
+    qreal getAscent() const override;
+    void visibilityChanged(bool visible) override;
+
+protected:
+    void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
+
+private:
+    QRectF thumbnailRect() const;
+    void showFullImage(const QImage& image);
+
+private:
+    QSize size;
+    QSize thumbnailSize;
+    ThumbnailLoader& loader;
+    QString imageId;
+    QPixmap pmap;
+    bool visible = false;
+    bool loading = false;
+    bool failed = false;
+};
@@ -23,7 +23,6 @@
 #include "src/widget/style.h"
 
 #include <QDebug>
-#include <QIcon>
 #include <QUrl>
 
 CustomTextDocument::CustomTextDocument(SmileyPack& smileyPack_,
@@ -43,9 +42,7 @@ QVariant CustomTextDocument::loadResource(int type, const QUrl& name)
                            settings.getEmojiFontPointSize());
         QString fileName = QUrl::fromPercentEncoding(name.toEncoded()).mid(4).toHtmlEscaped();
 
-        std::shared_ptr<QIcon> icon = smileyPack.getAsIcon(fileName);
-        emoticonIcons.append(icon);
-        return icon->pixmap(size);
+        return smileyPack.getAsPixmap(fileName, size);
     }
 
     return QTextDocument::loadResource(type, name);
@@ -38,7 +38,6 @@ protected:
     virtual QVariant loadResource(int type, const QUrl& name);
 
 private:
-    QList<std::shared_ptr<QIcon>> emoticonIcons;
     SmileyPack& smileyPack;
     Settings& settings;
 };
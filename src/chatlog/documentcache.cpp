@@ -17,14 +17,44 @@
     along with qTox.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include "documentcache.h"
 #include "customtextdocument.h"
 
+#include <QDebug>
+
+/**
+ * @class DocumentCache
+ * @brief Pool of text documents shared by all chat widgets.
+ *
+ * Texts only hold a document while they are visible, so documents are recycled a lot while
+ * scrolling. Idle documents are kept up to HIGH_WATERMARK, trim() drops them down to
+ * LOW_WATERMARK, e.g. after a chat was closed. In the low memory mode of the CacheRegistry idle
+ * documents never exceed LOW_WATERMARK. PREWARM_COUNT documents are created in small
+ * batches shortly after start so opening the first chat doesn't have to.
+ */
+
+constexpr int DocumentCache::HIGH_WATERMARK;
+constexpr int DocumentCache::LOW_WATERMARK;
+constexpr int DocumentCache::PREWARM_COUNT;
+
+namespace {
+// rough size of an empty document with its layout, used for reporting and budgeting only
+constexpr qint64 estimatedDocumentBytes = 4 * 1024;
+constexpr int prewarmBatchSize = 4;
+constexpr int prewarmIntervalMs = 50;
+} // namespace
+
 DocumentCache::DocumentCache(SmileyPack& smileyPack_, Settings& settings_)
-    : smileyPack{smileyPack_}
+    : RegisteredCache("text documents")
+    , smileyPack{smileyPack_}
     , settings{settings_}
 {
+    prewarmTimer.setInterval(prewarmIntervalMs);
+    QObject::connect(&prewarmTimer, &QTimer::timeout, [this] { onPrewarmTimeout(); });
+    prewarmTimer.start();
 }
+
 DocumentCache::~DocumentCache()
 {
     while (!documents.isEmpty())
@@ -36,13 +66,69 @@ QTextDocument* DocumentCache::pop()
     if (documents.empty())
         documents.push(new CustomTextDocument(smileyPack, settings));
 
+    ++documentsInUse;
+    markCacheUsed();
     return documents.pop();
 }
 
 void DocumentCache::push(QTextDocument* doc)
 {
     if (doc) {
+        --documentsInUse;
+
+        const int maxIdle =
+            CacheRegistry::getInstance().isLowMemory() ? LOW_WATERMARK : HIGH_WATERMARK;
+        if (documents.size() >= maxIdle) {
+            delete doc;
+            return;
+        }
+
         doc->clear();
         documents.push(doc);
     }
 }
+
+/**
+ * @brief Deletes idle documents down to LOW_WATERMARK.
+ */
+void DocumentCache::trim()
+{
+    const int before = documents.size();
+    while (documents.size() > LOW_WATERMARK)
+        delete documents.pop();
+
+    if (before != documents.size()) {
+        const Stats stats = getStats();
+        qDebug() << "Trimmed document cache from" << before << "to" << stats.idleDocuments
+                 << "idle documents, about" << stats.estimatedIdleBytes << "bytes,"
+                 << stats.documentsInUse << "in use";
+    }
+}
+
+DocumentCache::Stats DocumentCache::getStats() const
+{
+    return {documents.size(), documentsInUse, documents.size() * estimatedDocumentBytes};
+}
+
+RegisteredCache::Usage DocumentCache::getCacheUsage() const
+{
+    return {documents.size() * estimatedDocumentBytes, documents.size()};
+}
+
+/**
+ * @brief Deletes idle documents, documents in use are not accounted for.
+ */
+void DocumentCache::trimCache(qint64 maxBytes)
+{
+    while (!documents.isEmpty() && documents.size() * estimatedDocumentBytes > maxBytes)
+        delete documents.pop();
+}
+
+void DocumentCache::onPrewarmTimeout()
+{
+    for (int i = 0; i < prewarmBatchSize && documents.size() < PREWARM_COUNT; ++i)
+        documents.push(new CustomTextDocument(smileyPack, settings));
+
+    if (documents.size() >= PREWARM_COUNT)
+        prewarmTimer.stop();
+}
@@ -17,17 +17,29 @@
     along with qTox.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #pragma once
 
+#include "util/cacheregistry.h"
+
 #include <QStack>
+#include <QTimer>
+#include <QtGlobal>
 
 class QTextDocument;
 class SmileyPack;
 class Settings;
 
-class DocumentCache
+class DocumentCache : public RegisteredCache
 {
 public:
+    struct Stats
+    {
+        int idleDocuments;
+        int documentsInUse;
+        qint64 estimatedIdleBytes;
+    };
+
     DocumentCache(SmileyPack& smileyPack, Settings& settings);
     ~DocumentCache();
     DocumentCache(DocumentCache&) = delete;
@@ -35,8 +47,22 @@ public:
 
     QTextDocument* pop();
     void push(QTextDocument* doc);
+    void trim();
+    Stats getStats() const;
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
+
+    static constexpr int HIGH_WATERMARK = 256;
+    static constexpr int LOW_WATERMARK = 64;
+    static constexpr int PREWARM_COUNT = 32;
+
+private:
+    void onPrewarmTimeout();
+
 private:
     QStack<QTextDocument*> documents;
+    int documentsInUse = 0;
+    QTimer prewarmTimer;
     SmileyPack& smileyPack;
     Settings& settings;
 };
@@ -17,21 +17,186 @@
     along with qTox.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include "pixmapcache.h"
 
-QPixmap PixmapCache::get(const QString& filename, QSize size)
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QGuiApplication>
+#include <QImage>
+#include <QImageReader>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class PixmapCache
+ * @brief Least recently used cache of rendered icons with a budget of BYTE_BUDGET bytes.
+ *
+ * The budget drops to LOW_MEMORY_BYTE_BUDGET in the low memory mode of the CacheRegistry.
+ *
+ * Images are rasterized on the thread pool, since rendering SVGs on the GUI thread made opening
+ * chats and switching themes hitch. Until an image is ready get() returns a transparent
+ * placeholder of the requested size and calls the callback once the real pixmap is there.
+ */
+
+constexpr qint64 PixmapCache::BYTE_BUDGET;
+constexpr qint64 PixmapCache::LOW_MEMORY_BYTE_BUDGET;
+
+/**
+ * @brief Returns the image rendered at size.
+ * @param filename Image file, usually an SVG.
+ * @param size Size in device independent pixels.
+ * @param receiver Callback is dropped if this object is deleted before the image is ready.
+ * @param onReady Called on the GUI thread once the image is ready, not called on a cache hit.
+ * @return The cached pixmap, or a placeholder if the image isn't ready yet.
+ */
+QPixmap PixmapCache::get(const QString& filename, QSize size, QObject* receiver,
+                         ReadyCallback onReady)
 {
-    auto itr = cache.find(filename);
+    const QString key = makeKey(filename, size);
 
-    if (itr == cache.end()) {
-        QIcon icon;
-        icon.addFile(filename);
+    auto itr = index.find(key);
+    if (itr != index.end()) {
+        ++hits;
+        markCacheUsed();
+        entries.splice(entries.begin(), entries, itr.value());
+        return itr.value()->pixmap;
+    }
+
+    ++misses;
+    const bool inFlight = pending.contains(key);
+    if (onReady) {
+        pending[key].push_back({QPointer<QObject>(receiver), std::move(onReady)});
+    } else if (!inFlight) {
+        pending.insert(key, {});
+    }
 
-        cache.insert(filename, icon);
-        return icon.pixmap(size);
+    if (!inFlight) {
+        const qreal dpr = qApp->devicePixelRatio();
+        auto watcher = new QFutureWatcher<QImage>(this);
+        connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, key] {
+            onRasterized(key, watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(&PixmapCache::rasterize, filename, size, dpr));
     }
 
-    return itr.value().pixmap(size);
+    QPixmap placeholder(size);
+    placeholder.fill(Qt::transparent);
+    return placeholder;
+}
+
+/**
+ * @brief Renders an image in the background, so later calls to get() hit the cache.
+ */
+void PixmapCache::prerender(const QString& filename, QSize size)
+{
+    if (!index.contains(makeKey(filename, size))) {
+        get(filename, size);
+    }
+}
+
+/**
+ * @brief Drops all cached pixmaps, e.g. after the theme changed.
+ */
+void PixmapCache::clear()
+{
+    entries.clear();
+    index.clear();
+    bytes = 0;
+}
+
+PixmapCache::Stats PixmapCache::getStats() const
+{
+    return {hits, misses, evictions, bytes, index.size()};
+}
+
+RegisteredCache::Usage PixmapCache::getCacheUsage() const
+{
+    return {bytes, index.size()};
+}
+
+/**
+ * @brief Drops the least recently used pixmaps, widgets still keep the ones they show.
+ */
+void PixmapCache::trimCache(qint64 maxBytes)
+{
+    evict(maxBytes, 0);
+}
+
+QString PixmapCache::makeKey(const QString& filename, QSize size)
+{
+    return QStringLiteral("%1@%2x%3").arg(filename).arg(size.width()).arg(size.height());
+}
+
+/**
+ * @brief Renders an image the way QIcon::pixmap() would.
+ * @note Thread safe, only uses QImage.
+ */
+QImage PixmapCache::rasterize(const QString& filename, QSize size, qreal devicePixelRatio)
+{
+    QImageReader reader(filename);
+    QSize scaledSize = reader.size();
+    const QSize deviceSize = size * devicePixelRatio;
+    if (scaledSize.isValid()) {
+        // shrink keeping the aspect ratio, but never scale up
+        if (scaledSize.width() > deviceSize.width() || scaledSize.height() > deviceSize.height()
+            || filename.endsWith(QStringLiteral(".svg"), Qt::CaseInsensitive)) {
+            scaledSize.scale(deviceSize, Qt::KeepAspectRatio);
+        }
+        reader.setScaledSize(scaledSize);
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to render" << filename << reader.errorString();
+        return image;
+    }
+
+    image.setDevicePixelRatio(devicePixelRatio);
+    return image;
+}
+
+void PixmapCache::insert(const QString& key, const QPixmap& pixmap)
+{
+    const qint64 pixmapBytes =
+        static_cast<qint64>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+
+    entries.push_front({key, pixmap, pixmapBytes});
+    index.insert(key, entries.begin());
+    bytes += pixmapBytes;
+    markCacheUsed();
+
+    // the newest entry always stays, even if it's larger than the budget
+    const bool lowMemory = CacheRegistry::getInstance().isLowMemory();
+    evict(lowMemory ? LOW_MEMORY_BYTE_BUDGET : BYTE_BUDGET, 1);
+}
+
+void PixmapCache::evict(qint64 maxBytes, size_t keepEntries)
+{
+    while (bytes > maxBytes && entries.size() > keepEntries) {
+        const Entry& last = entries.back();
+        bytes -= last.bytes;
+        index.remove(last.key);
+        entries.pop_back();
+        ++evictions;
+    }
+}
+
+void PixmapCache::onRasterized(const QString& key, const QImage& image)
+{
+    const std::vector<Waiter> waiters = pending.take(key);
+    if (image.isNull()) {
+        return;
+    }
+
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    insert(key, pixmap);
+
+    for (const Waiter& waiter : waiters) {
+        if (waiter.receiver) {
+            waiter.onReady(pixmap);
+        }
+    }
 }
 
 /**
@@ -17,25 +17,88 @@
     along with qTox.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #pragma once
 
+#include "util/cacheregistry.h"
+
 #include <QHash>
-#include <QIcon>
+#include <QObject>
 #include <QPixmap>
+#include <QPointer>
+#include <QSize>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <vector>
+
+class QImage;
 
-class PixmapCache
+class PixmapCache : public QObject, public RegisteredCache
 {
+    Q_OBJECT
+
 public:
-    QPixmap get(const QString& filename, QSize size);
+    using ReadyCallback = std::function<void(const QPixmap&)>;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        qint64 bytes;
+        int entries;
+    };
+
+    QPixmap get(const QString& filename, QSize size, QObject* receiver = nullptr,
+                ReadyCallback onReady = {});
+    void prerender(const QString& filename, QSize size);
+    void clear();
+    Stats getStats() const;
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
     static PixmapCache& getInstance();
 
+    static constexpr qint64 BYTE_BUDGET = 8 * 1024 * 1024;
+    static constexpr qint64 LOW_MEMORY_BYTE_BUDGET = 2 * 1024 * 1024;
+
 protected:
     PixmapCache()
+        : RegisteredCache("pixmaps")
     {
     }
     PixmapCache(PixmapCache&) = delete;
     PixmapCache& operator=(const PixmapCache&) = delete;
 
 private:
-    QHash<QString, QIcon> cache;
+    struct Entry
+    {
+        QString key;
+        QPixmap pixmap;
+        qint64 bytes;
+    };
+
+    struct Waiter
+    {
+        QPointer<QObject> receiver;
+        ReadyCallback onReady;
+    };
+
+    static QString makeKey(const QString& filename, QSize size);
+    static QImage rasterize(const QString& filename, QSize size, qreal devicePixelRatio);
+    void insert(const QString& key, const QPixmap& pixmap);
+    void evict(qint64 maxBytes, size_t keepEntries);
+    void onRasterized(const QString& key, const QImage& image);
+
+private:
+    // most recently used first
+    std::list<Entry> entries;
+    QHash<QString, std::list<Entry>::iterator> index;
+    QHash<QString, std::vector<Waiter>> pending;
+    qint64 bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
 };
@@ -0,0 +1,99 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sendercolorcache.h"
+#include "src/widget/tool/identicon.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+
+/**
+ * @class SenderColorCache
+ * @brief Colors of the sender names of one chat, so rendering a page of messages doesn't hash
+ * every sender again.
+ *
+ * Colors are keyed by public key, or by name for senders without one, so a rename doesn't need
+ * any invalidation. A change of the theme's text color drops all entries.
+ */
+
+constexpr int SenderColorCache::MAX_ENTRIES;
+
+/**
+ * @brief Returns the color of a sender name.
+ * @param pubkey Public key of the sender in hex, may be empty.
+ * @param sender Name of the sender, colors are derived from it if there is no public key.
+ * @param baseColor Text color of the theme, the name color keeps its lightness.
+ */
+QColor SenderColorCache::get(const QString& pubkey, const QString& sender, const QColor& baseColor)
+{
+    if (baseColor != base) {
+        colors.clear();
+        base = baseColor;
+    }
+
+    // '#' never starts a hex public key
+    const QString key = pubkey.isEmpty() ? QLatin1Char('#') + sender : pubkey;
+    auto it = colors.constFind(key);
+    if (it != colors.constEnd()) {
+        return it.value();
+    }
+
+    if (colors.size() >= MAX_ENTRIES) {
+        // groups this large are rare, starting over is cheaper than tracking use
+        colors.clear();
+    }
+
+    const QColor color = computeColor(pubkey, sender, baseColor);
+    colors.insert(key, color);
+    return color;
+}
+
+void SenderColorCache::clear()
+{
+    colors.clear();
+    base = QColor{};
+}
+
+int SenderColorCache::size() const
+{
+    return colors.size();
+}
+
+/**
+ * @brief Derives the color of a sender name without caching it.
+ */
+QColor SenderColorCache::computeColor(const QString& pubkey, const QString& sender,
+                                      const QColor& baseColor)
+{
+    QByteArray hash;
+    if (pubkey.isEmpty()) {
+        hash = QCryptographicHash::hash((sender.toUtf8()), QCryptographicHash::Sha256);
+    } else {
+        hash = QByteArray::fromHex(pubkey.toLatin1());
+    }
+
+    QColor color = baseColor;
+    auto lightness = color.lightnessF();
+    // Adapt as good as possible to Light/Dark themes
+    lightness = lightness*0.5 + 0.3;
+
+    // Magic values
+    color.setHslF(Identicon::bytesToColor(hash.left(Identicon::IDENTICON_COLOR_BYTES)), 1.0, lightness);
+    return color;
+}
@@ -0,0 +1,41 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QColor>
+#include <QHash>
+#include <QString>
+
+class SenderColorCache
+{
+public:
+    QColor get(const QString& pubkey, const QString& sender, const QColor& baseColor);
+    void clear();
+    int size() const;
+
+    static QColor computeColor(const QString& pubkey, const QString& sender,
+                               const QColor& baseColor);
+
+    static constexpr int MAX_ENTRIES = 1024;
+
+private:
+    QColor base;
+    QHash<QString, QColor> colors;
+};
@@ -22,6 +22,8 @@
 #include <QRegularExpression>
 #include <QVector>
 
+#include <cstdint>
+
 // clang-format off
 
 namespace {
@@ -58,43 +60,78 @@ const QString MULTILINE_CODE = QStringLiteral("(?<=^|\\s)"
                                                      "```"
                                                      "(?=$|\\s)");
 
-#define REGEXP_WRAPPER_PAIR(pattern, wrapper)\
-{QRegularExpression(pattern,QRegularExpression::UseUnicodePropertiesOption),QStringLiteral(wrapper)}
-
-const QPair<QRegularExpression, QString> REGEX_TO_WRAPPER[] {
-    REGEXP_WRAPPER_PAIR(SINGLE_SLASH_PATTERN, "<i>%1</i>"),
-    REGEXP_WRAPPER_PAIR(SINGLE_SIGN_PATTERN.arg('*'), "<b>%1</b>"),
-    REGEXP_WRAPPER_PAIR(SINGLE_SIGN_PATTERN.arg('_'), "<u>%1</u>"),
-    REGEXP_WRAPPER_PAIR(SINGLE_SIGN_PATTERN.arg('~'), "<s>%1</s>"),
-    REGEXP_WRAPPER_PAIR(SINGLE_SIGN_PATTERN.arg('`'), "<font color=#595959><code>%1</code></font>"),
-    REGEXP_WRAPPER_PAIR(DOUBLE_SIGN_PATTERN.arg('*'), "<b>%1</b>"),
-    REGEXP_WRAPPER_PAIR(DOUBLE_SIGN_PATTERN.arg('/'), "<i>%1</i>"),
-    REGEXP_WRAPPER_PAIR(DOUBLE_SIGN_PATTERN.arg('_'), "<u>%1</u>"),
-    REGEXP_WRAPPER_PAIR(DOUBLE_SIGN_PATTERN.arg('~'), "<s>%1</s>"),
-    REGEXP_WRAPPER_PAIR(MULTILINE_CODE, "<font color=#595959><code>%1</code></font>"),
+// Characters a markdown pattern can't match without, see scanMarkdownSigns()
+enum MarkdownSign : uint32_t
+{
+    SLASH_SIGN = 1 << 0,
+    STAR_SIGN = 1 << 1,
+    UNDERSCORE_SIGN = 1 << 2,
+    TILDE_SIGN = 1 << 3,
+    BACKTICK_SIGN = 1 << 4,
+};
+
+struct MarkdownRule
+{
+    QRegularExpression regex;
+    QString wrapper;
+    uint32_t sign;
+};
+
+#define REGEXP_WRAPPER_RULE(pattern, wrapper, sign)\
+{QRegularExpression(pattern,QRegularExpression::UseUnicodePropertiesOption),QStringLiteral(wrapper),sign}
+
+const MarkdownRule REGEX_TO_WRAPPER[] {
+    REGEXP_WRAPPER_RULE(SINGLE_SLASH_PATTERN, "<i>%1</i>", SLASH_SIGN),
+    REGEXP_WRAPPER_RULE(SINGLE_SIGN_PATTERN.arg('*'), "<b>%1</b>", STAR_SIGN),
+    REGEXP_WRAPPER_RULE(SINGLE_SIGN_PATTERN.arg('_'), "<u>%1</u>", UNDERSCORE_SIGN),
+    REGEXP_WRAPPER_RULE(SINGLE_SIGN_PATTERN.arg('~'), "<s>%1</s>", TILDE_SIGN),
+    REGEXP_WRAPPER_RULE(SINGLE_SIGN_PATTERN.arg('`'), "<font color=#595959><code>%1</code></font>", BACKTICK_SIGN),
+    REGEXP_WRAPPER_RULE(DOUBLE_SIGN_PATTERN.arg('*'), "<b>%1</b>", STAR_SIGN),
+    REGEXP_WRAPPER_RULE(DOUBLE_SIGN_PATTERN.arg('/'), "<i>%1</i>", SLASH_SIGN),
+    REGEXP_WRAPPER_RULE(DOUBLE_SIGN_PATTERN.arg('_'), "<u>%1</u>", UNDERSCORE_SIGN),
+    REGEXP_WRAPPER_RULE(DOUBLE_SIGN_PATTERN.arg('~'), "<s>%1</s>", TILDE_SIGN),
+    REGEXP_WRAPPER_RULE(MULTILINE_CODE, "<font color=#595959><code>%1</code></font>", BACKTICK_SIGN),
 };
 
-#undef REGEXP_WRAPPER_PAIR
+#undef REGEXP_WRAPPER_RULE
 
 const QString HREF_WRAPPER = QStringLiteral(R"(<a href="%1">%1</a>)");
 const QString WWW_WRAPPER = QStringLiteral(R"(<a href="http://%1">%1</a>)");
 
-const QVector<QRegularExpression> WWW_WORD_PATTERN = {
-        QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((www\.)\S+))"))
+// Substrings a URI pattern can't match without, see scanUriMarkers()
+enum UriMarker : uint32_t
+{
+    SCHEME_SLASHES_MARKER = 1 << 0, // "://"
+    TOX_MARKER = 1 << 1,
+    MAILTO_MARKER = 1 << 2,
+    MAGNET_MARKER = 1 << 3,
+    WWW_MARKER = 1 << 4,
 };
 
-const QVector<QRegularExpression> URI_WORD_PATTERNS = {
+struct UriRule
+{
+    QRegularExpression regex;
+    uint32_t marker;
+};
+
+const QVector<UriRule> WWW_WORD_PATTERN = {
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((www\.)\S+))")), WWW_MARKER}
+};
+
+const QVector<UriRule> URI_WORD_PATTERNS = {
     // Note: This does not match only strictly valid URLs, but we broaden search to any string following scheme to
     // allow UTF-8 "IRI"s instead of ASCII-only URLs
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((((http[s]?)|ftp)://)\S+))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((file|smb)://([\S| ]*)))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(tox:[a-zA-Z\d]{76}))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(mailto:\S+@\S+\.\S+))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(magnet:[?]((xt(.\d)?=urn:)|(mt=)|(kt=)|(tr=)|(dn=)|(xl=)|(xs=)|(as=)|(x.))[\S| ]+))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(gemini://\S+))")),
-    QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(ed2k://\|file\|\S+))")),
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((((http[s]?)|ftp)://)\S+))")), SCHEME_SLASHES_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*((file|smb)://([\S| ]*)))")), SCHEME_SLASHES_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(tox:[a-zA-Z\d]{76}))")), TOX_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(mailto:\S+@\S+\.\S+))")), MAILTO_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(magnet:[?]((xt(.\d)?=urn:)|(mt=)|(kt=)|(tr=)|(dn=)|(xl=)|(xs=)|(as=)|(x.))[\S| ]+))")), MAGNET_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(gemini://\S+))")), SCHEME_SLASHES_MARKER},
+    {QRegularExpression(QStringLiteral(R"((?<=^|\s)\S*(ed2k://\|file\|\S+))")), SCHEME_SLASHES_MARKER},
 };
 
+const QRegularExpression TAG_PATTERN(QStringLiteral("(?<=<)/?[a-zA-Z0-9]+(?=>)"));
+
 
 // clang-format on
 
@@ -163,18 +200,87 @@ MatchingUri stripSurroundingChars(const QStringRef wrappedUri, const int startOf
     return strippedMatch;
 }
 
+/**
+ * @brief Finds out in a single scan which URI patterns can match at all.
+ * @param message Message to scan
+ * @return UriMarker flags of the markers found in message
+ */
+uint32_t scanUriMarkers(const QString& message)
+{
+    uint32_t markers = 0;
+    const int length = message.length();
+    for (int i = 0; i < length; ++i) {
+        const QChar c = message.at(i);
+        if (c == QLatin1Char(':')) {
+            if (message.midRef(i + 1, 2) == QLatin1String("//")) {
+                markers |= SCHEME_SLASHES_MARKER;
+            }
+            const QStringRef before = message.leftRef(i);
+            if (before.endsWith(QLatin1String("tox"))) {
+                markers |= TOX_MARKER;
+            } else if (before.endsWith(QLatin1String("mailto"))) {
+                markers |= MAILTO_MARKER;
+            } else if (before.endsWith(QLatin1String("magnet"))) {
+                markers |= MAGNET_MARKER;
+            }
+        } else if (c == QLatin1Char('w') && message.midRef(i, 4) == QLatin1String("www.")) {
+            markers |= WWW_MARKER;
+        }
+    }
+    return markers;
+}
+
+/**
+ * @brief Finds out in a single scan which markdown patterns can match at all.
+ * @param text Text to scan
+ * @return MarkdownSign flags of the signs found in text
+ */
+uint32_t scanMarkdownSigns(const QString& text)
+{
+    uint32_t signs = 0;
+    for (const QChar c : text) {
+        switch (c.unicode()) {
+        case '/':
+            signs |= SLASH_SIGN;
+            break;
+        case '*':
+            signs |= STAR_SIGN;
+            break;
+        case '_':
+            signs |= UNDERSCORE_SIGN;
+            break;
+        case '~':
+            signs |= TILDE_SIGN;
+            break;
+        case '`':
+            signs |= BACKTICK_SIGN;
+            break;
+        default:
+            break;
+        }
+    }
+    return signs;
+}
+
 /**
  * @brief Wrap substrings matching "patterns" with "wrapper" in "message"
  * @param message Where search for patterns
  * @param patterns Array of regex patterns to find strings to wrap
  * @param wrapper Surrounds the matched strings
+ * @param markers UriMarker flags present in message, patterns needing other markers are skipped
  * @note done separately from URI since the link must have a scheme added to be valid
  * @return Copy of message with highlighted URLs
  */
-QString highlight(const QString& message, const QVector<QRegularExpression>& patterns, const QString& wrapper)
+QString highlight(const QString& message, const QVector<UriRule>& patterns, const QString& wrapper,
+                  uint32_t markers)
 {
     QString result = message;
-    for (const QRegularExpression& exp : patterns) {
+    for (const UriRule& rule : patterns) {
+        if (!(rule.marker & markers)) {
+            continue;
+        }
+
+        const QRegularExpression& exp = rule.regex;
         const int startLength = result.length();
         int offset = 0;
         QRegularExpressionMatchIterator iter = exp.globalMatch(result);
@@ -202,7 +308,9 @@ QString highlight(const QString& message, const QVector<QRegularExpression>& pat
  */
 bool isTagIntersection(const QString& str)
 {
-    const QRegularExpression TAG_PATTERN("(?<=<)/?[a-zA-Z0-9]+(?=>)");
+    if (!str.contains(QLatin1Char('<'))) {
+        return false;
+    }
 
     int openingTagCount = 0;
     int closingTagCount = 0;
@@ -222,8 +330,14 @@ bool isTagIntersection(const QString& str)
  */
 QString TextFormatter::highlightURI(const QString& message)
 {
-    QString result = highlight(message, URI_WORD_PATTERNS, HREF_WRAPPER);
-    result = highlight(result, WWW_WORD_PATTERN, WWW_WRAPPER);
+    // wrapping only adds markers that were already there, so one scan is enough
+    const uint32_t markers = scanUriMarkers(message);
+    if (!markers) {
+        return message;
+    }
+
+    QString result = highlight(message, URI_WORD_PATTERNS, HREF_WRAPPER, markers);
+    result = highlight(result, WWW_WORD_PATTERN, WWW_WRAPPER, markers);
     return result;
 }
 
@@ -237,8 +351,13 @@ QString TextFormatter::highlightURI(const QString& message)
 QString TextFormatter::applyMarkdown(const QString& message, bool showFormattingSymbols)
 {
     QString result = message;
-    for (const QPair<QRegularExpression, QString>& pair : REGEX_TO_WRAPPER) {
-        QRegularExpressionMatchIterator iter = pair.first.globalMatch(result);
+    uint32_t signs = scanMarkdownSigns(message);
+    for (const MarkdownRule& rule : REGEX_TO_WRAPPER) {
+        if (!(rule.sign & signs)) {
+            continue;
+        }
+
+        QRegularExpressionMatchIterator iter = rule.regex.globalMatch(result);
         int offset = 0;
         while (iter.hasNext()) {
             const QRegularExpressionMatch match = iter.next();
@@ -248,10 +367,12 @@ QString TextFormatter::applyMarkdown(const QString& message, bool showFormatting
             }
 
             const int length = match.capturedLength();
-            const QString wrappedText = pair.second.arg(captured);
+            const QString wrappedText = rule.wrapper.arg(captured);
             const int startPos = match.capturedStart() + offset;
             result.replace(startPos, length, wrappedText);
             offset += wrappedText.length() - length;
+            // the wrapper may contain signs later patterns look for
+            signs |= scanMarkdownSigns(rule.wrapper);
         }
     }
     return result;
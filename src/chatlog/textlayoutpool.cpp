@@ -0,0 +1,202 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "textlayoutpool.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QFontMetrics>
+#include <QImage>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+/**
+ * @class TextLayoutPool
+ * @brief Measures the height of chat lines on the global thread pool.
+ *
+ * The GUI thread snapshots everything a line's layout depends on into a LineLayoutInput, the
+ * workers lay the text out in private documents and only hand back heights. Those end up in the
+ * height cache of each line, so ChatWidget can position lines without laying them out itself.
+ *
+ * @note Emoticons are measured as blank images of the emoji size, loading the icons is only
+ * possible on the GUI thread.
+ */
+
+namespace {
+class MeasureDocument : public QTextDocument
+{
+public:
+    explicit MeasureDocument(int emojiSize_)
+        : emojiSize{emojiSize_}
+    {
+        setUndoRedoEnabled(false);
+        setUseDesignMetrics(false);
+    }
+
+protected:
+    QVariant loadResource(int type, const QUrl& name) override
+    {
+        if (type == QTextDocument::ImageResource && name.scheme() == "key") {
+            QImage placeholder(emojiSize, emojiSize, QImage::Format_ARGB32_Premultiplied);
+            placeholder.fill(Qt::transparent);
+            return placeholder;
+        }
+
+        return QTextDocument::loadResource(type, name);
+    }
+
+private:
+    int emojiSize;
+};
+} // namespace
+
+TextLayoutPool::TextLayoutPool(QObject* parent)
+    : QObject(parent)
+{
+    connect(&watcher, &QFutureWatcher<qreal>::finished, this, &TextLayoutPool::onFinished);
+}
+
+TextLayoutPool::~TextLayoutPool()
+{
+    cancel();
+}
+
+/**
+ * @brief Starts measuring lines with the given width, an older request is canceled.
+ * @param lines Lines to measure, they may be deleted while they are measured.
+ * @param width Width the lines will be laid out with.
+ * @param widthBucket Width bucket the heights are cached for.
+ * @param fontGeneration Font generation the heights are cached for.
+ */
+void TextLayoutPool::measure(const std::vector<ChatLine::Ptr>& lines, qreal width,
+                             int widthBucket, unsigned fontGeneration)
+{
+    cancel();
+
+    if (lines.empty())
+        return;
+
+    QVector<LineLayoutInput> inputs;
+    inputs.reserve(static_cast<int>(lines.size()));
+    for (const ChatLine::Ptr& line : lines) {
+        pendingLines.push_back({line, line->getContentRevision()});
+        inputs.append(line->getLayoutInput(width));
+    }
+
+    pendingWidthBucket = widthBucket;
+    pendingFontGeneration = fontGeneration;
+    watcher.setFuture(QtConcurrent::mapped(inputs, &TextLayoutPool::measureLine));
+}
+
+/**
+ * @brief Drops the running request, waits for measurements already in progress.
+ */
+void TextLayoutPool::cancel()
+{
+    if (watcher.isRunning()) {
+        watcher.cancel();
+        watcher.waitForFinished();
+    }
+
+    pendingLines.clear();
+}
+
+/**
+ * @brief Lays out text the same way Text does.
+ * @note Thread safe.
+ */
+TextLayoutResult TextLayoutPool::layoutText(const TextLayoutInput& input)
+{
+    MeasureDocument doc{input.emojiSize};
+    doc.setDefaultFont(input.font);
+
+    if (input.elide) {
+        QFontMetrics metrics = QFontMetrics(input.font);
+        doc.setPlainText(metrics.elidedText(input.text, Qt::ElideRight, qRound(input.width)));
+    } else {
+        doc.setDefaultStyleSheet(input.styleSheet);
+        doc.setHtml(input.text);
+    }
+
+    QTextOption opt;
+    opt.setWrapMode(input.elide ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
+    doc.setDefaultTextOption(opt);
+    doc.setTextWidth(input.width);
+
+    TextLayoutResult result;
+    result.size = doc.size();
+    if (doc.firstBlock().layout()->lineCount() > 0)
+        result.ascent = doc.firstBlock().layout()->lineAt(0).ascent();
+
+    return result;
+}
+
+/**
+ * @brief Calculates the height ChatLine::layout() would give a line.
+ * @note Thread safe.
+ */
+qreal TextLayoutPool::measureLine(const LineLayoutInput& input)
+{
+    QVector<TextLayoutResult> results;
+    results.reserve(input.columns.size());
+    qreal maxAscent = 0.0;
+
+    for (const LineLayoutInput::Column& column : input.columns) {
+        TextLayoutResult result;
+        if (column.isText) {
+            result = layoutText(column.text);
+        } else {
+            result.size = QSizeF(0.0, column.height);
+            result.ascent = column.ascent;
+        }
+
+        maxAscent = std::max(maxAscent, result.ascent);
+        results.append(result);
+    }
+
+    qreal height = 0.0;
+    for (const TextLayoutResult& result : results)
+        height = std::max(height, maxAscent - result.ascent + result.size.height());
+
+    return height;
+}
+
+void TextLayoutPool::onFinished()
+{
+    // a canceled or replaced request
+    if (watcher.isCanceled() || !watcher.isFinished())
+        return;
+
+    const QFuture<qreal> future = watcher.future();
+    for (int i = 0; i < future.resultCount(); ++i) {
+        const PendingLine& pending = pendingLines[i];
+        ChatLine::Ptr line = pending.line.lock();
+        // the content may have changed while it was measured
+        if (line && line->getContentRevision() == pending.contentRevision)
+            line->cacheHeight(pendingWidthBucket, pendingFontGeneration, future.resultAt(i));
+    }
+
+    pendingLines.clear();
+    emit linesMeasured();
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "chatline.h"
+
+#include <QFont>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSizeF>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+struct TextLayoutInput
+{
+    QString text;
+    QFont font;
+    QString styleSheet;
+    bool elide = false;
+    qreal width = 0.0;
+    int emojiSize = 0;
+};
+
+struct TextLayoutResult
+{
+    QSizeF size;
+    qreal ascent = 0.0;
+};
+
+struct LineLayoutInput
+{
+    struct Column
+    {
+        bool isText = false;
+        TextLayoutInput text;
+        // used as is for content that doesn't depend on the width
+        qreal height = 0.0;
+        qreal ascent = 0.0;
+    };
+
+    QVector<Column> columns;
+};
+
+class TextLayoutPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TextLayoutPool(QObject* parent = nullptr);
+    ~TextLayoutPool();
+
+    void measure(const std::vector<ChatLine::Ptr>& lines, qreal width, int widthBucket,
+                 unsigned fontGeneration);
+    void cancel();
+
+    static TextLayoutResult layoutText(const TextLayoutInput& input);
+    static qreal measureLine(const LineLayoutInput& input);
+
+signals:
+    void linesMeasured();
+
+private slots:
+    void onFinished();
+
+private:
+    struct PendingLine
+    {
+        std::weak_ptr<ChatLine> line;
+        unsigned contentRevision;
+    };
+
+    QFutureWatcher<qreal> watcher;
+    std::vector<PendingLine> pendingLines;
+    int pendingWidthBucket = 0;
+    unsigned pendingFontGeneration = 0;
+};
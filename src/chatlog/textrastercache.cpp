@@ -0,0 +1,156 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "textrastercache.h"
+
+#include <algorithm>
+#include <atomic>
+
+/**
+ * @class TextRasterCache
+ * @brief Least recently used cache of rendered chat texts with a budget of BYTE_BUDGET bytes.
+ *
+ * Most messages never change once rendered, so Text paints its document into a pixmap once and
+ * blits that while scrolling instead of laying out and drawing the document on every expose. Each
+ * Text owns an id from nextId() and drops its entry whenever its content, width or colors change.
+ * Selected text is always drawn directly, so selecting doesn't touch the cache.
+ *
+ * The budget drops to LOW_MEMORY_BYTE_BUDGET in the low memory mode of the CacheRegistry, texts
+ * larger than MAX_ENTRY_BYTES are never cached.
+ */
+
+constexpr qint64 TextRasterCache::BYTE_BUDGET;
+constexpr qint64 TextRasterCache::LOW_MEMORY_BYTE_BUDGET;
+constexpr qint64 TextRasterCache::MAX_ENTRY_BYTES;
+
+/**
+ * @brief Returns the rendered text.
+ * @param id Id of the Text.
+ * @param deviceSize Size the pixmap must have in device pixels, smaller or larger ones are stale.
+ * @return The cached pixmap, or a null pixmap if there is none of that size.
+ */
+QPixmap TextRasterCache::get(uint64_t id, QSize deviceSize)
+{
+    auto itr = index.find(id);
+    if (itr == index.end() || itr.value()->pixmap.size() != deviceSize) {
+        ++misses;
+        return {};
+    }
+
+    ++hits;
+    markCacheUsed();
+    entries.splice(entries.begin(), entries, itr.value());
+    return itr.value()->pixmap;
+}
+
+/**
+ * @brief Stores the rendered text, replacing an older rendering.
+ * @return False if the pixmap is too large to be cached.
+ */
+bool TextRasterCache::insert(uint64_t id, const QPixmap& pixmap)
+{
+    drop(id);
+
+    const qint64 entryBytes = pixmapBytes(pixmap.size());
+    const bool lowMemory = CacheRegistry::getInstance().isLowMemory();
+    const qint64 budget = lowMemory ? LOW_MEMORY_BYTE_BUDGET : BYTE_BUDGET;
+    if (entryBytes > std::min(MAX_ENTRY_BYTES, budget)) {
+        return false;
+    }
+
+    entries.push_front({id, pixmap, entryBytes});
+    index.insert(id, entries.begin());
+    bytes += entryBytes;
+    markCacheUsed();
+
+    evict(budget, 1);
+    return true;
+}
+
+/**
+ * @brief Drops the rendering of a Text, e.g. because it changed or was destroyed.
+ */
+void TextRasterCache::drop(uint64_t id)
+{
+    auto itr = index.find(id);
+    if (itr == index.end()) {
+        return;
+    }
+
+    bytes -= itr.value()->bytes;
+    entries.erase(itr.value());
+    index.erase(itr);
+}
+
+void TextRasterCache::clear()
+{
+    entries.clear();
+    index.clear();
+    bytes = 0;
+}
+
+TextRasterCache::Stats TextRasterCache::getStats() const
+{
+    return {hits, misses, evictions, bytes, index.size()};
+}
+
+RegisteredCache::Usage TextRasterCache::getCacheUsage() const
+{
+    return {bytes, index.size()};
+}
+
+/**
+ * @brief Drops the least recently used renderings, texts draw directly again until repainted.
+ */
+void TextRasterCache::trimCache(qint64 maxBytes)
+{
+    evict(maxBytes, 0);
+}
+
+/**
+ * @brief Returns a new id for a Text, ids are never reused.
+ */
+uint64_t TextRasterCache::nextId()
+{
+    static std::atomic<uint64_t> counter{0};
+    return ++counter;
+}
+
+TextRasterCache& TextRasterCache::getInstance()
+{
+    static TextRasterCache instance;
+    return instance;
+}
+
+qint64 TextRasterCache::pixmapBytes(QSize deviceSize)
+{
+    // rendered with alpha at 32 bits per pixel
+    return static_cast<qint64>(deviceSize.width()) * deviceSize.height() * 4;
+}
+
+void TextRasterCache::evict(qint64 maxBytes, size_t keepEntries)
+{
+    while (bytes > maxBytes && entries.size() > keepEntries) {
+        const Entry& last = entries.back();
+        bytes -= last.bytes;
+        index.remove(last.id);
+        entries.pop_back();
+        ++evictions;
+    }
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "util/cacheregistry.h"
+
+#include <QHash>
+#include <QPixmap>
+#include <QSize>
+
+#include <cstdint>
+#include <list>
+
+class TextRasterCache : public RegisteredCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        qint64 bytes;
+        int entries;
+    };
+
+    QPixmap get(uint64_t id, QSize deviceSize);
+    bool insert(uint64_t id, const QPixmap& pixmap);
+    void drop(uint64_t id);
+    void clear();
+    Stats getStats() const;
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
+    static uint64_t nextId();
+    static TextRasterCache& getInstance();
+
+    static constexpr qint64 BYTE_BUDGET = 32 * 1024 * 1024;
+    static constexpr qint64 LOW_MEMORY_BYTE_BUDGET = 4 * 1024 * 1024;
+    static constexpr qint64 MAX_ENTRY_BYTES = 4 * 1024 * 1024;
+
+protected:
+    TextRasterCache()
+        : RegisteredCache("text rasters")
+    {
+    }
+    TextRasterCache(TextRasterCache&) = delete;
+    TextRasterCache& operator=(const TextRasterCache&) = delete;
+
+private:
+    struct Entry
+    {
+        uint64_t id;
+        QPixmap pixmap;
+        qint64 bytes;
+    };
+
+    static qint64 pixmapBytes(QSize deviceSize);
+    void evict(qint64 maxBytes, size_t keepEntries);
+
+private:
+    // most recently used first
+    std::list<Entry> entries;
+    QHash<uint64_t, std::list<Entry>::iterator> index;
+    qint64 bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
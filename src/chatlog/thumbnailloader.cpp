@@ -0,0 +1,272 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "thumbnailloader.h"
+#include "src/model/imagecontainer.h"
+#include "src/persistence/blobstore.h"
+#include "util/threadscheduling.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrentRun>
+
+#ifdef QTOX_LIBWEBP
+#include <webp/decode.h>
+#endif
+
+/**
+ * @class ThumbnailLoader
+ * @brief Decodes group images for the chat log off the GUI thread.
+ *
+ * Chat lines only show a thumbnail of an image, so decoding every image at full resolution on
+ * the GUI thread wasted time and kept hundreds of MB of pixmaps alive in media heavy chats.
+ * Thumbnails are decoded directly at their display size and cached in the BlobStore, so
+ * scrolling back to an image later only reads a small file. The full image is only decoded
+ * when the user asks for it.
+ *
+ * Jobs run on a pool of MAX_THREADS threads, which is waited for on destruction because the
+ * jobs use the BlobStore.
+ *
+ * The decoder is picked from the image's magic bytes. Most group images are WebP from mobile
+ * clients, those are decoded with libwebp directly when it is available, which scales while
+ * decoding instead of decoding the full image first.
+ */
+
+constexpr int ThumbnailLoader::MAX_THREADS;
+
+namespace {
+#ifdef QTOX_LIBWEBP
+/**
+ * @brief Decodes a still WebP image with libwebp, scaled to fit into boundingSize.
+ * @return The image, null if libwebp can't decode it, e.g. because it is animated.
+ */
+QImage decodeWebp(const QByteArray& data, QSize boundingSize)
+{
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config)) {
+        return {};
+    }
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.constData());
+    const size_t length = static_cast<size_t>(data.size());
+    if (WebPGetFeatures(bytes, length, &config.input) != VP8_STATUS_OK
+        || config.input.has_animation) {
+        return {};
+    }
+
+    QSize size{config.input.width, config.input.height};
+    if (boundingSize.isValid()
+        && (size.width() > boundingSize.width() || size.height() > boundingSize.height())) {
+        size.scale(boundingSize, Qt::KeepAspectRatio);
+        size = size.expandedTo(QSize{1, 1});
+        config.options.use_scaling = 1;
+        config.options.scaled_width = size.width();
+        config.options.scaled_height = size.height();
+    }
+
+    QImage image{size, QImage::Format_RGBA8888_Premultiplied};
+    if (image.isNull()) {
+        return {};
+    }
+
+    // decode right into the image, premultiplied like Qt paints it
+    config.output.colorspace = MODE_rgbA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = image.bits();
+    config.output.u.RGBA.stride = image.bytesPerLine();
+    config.output.u.RGBA.size = static_cast<size_t>(image.bytesPerLine()) * image.height();
+    const VP8StatusCode status = WebPDecode(bytes, length, &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) {
+        qDebug() << "libwebp failed to decode image:" << status;
+        return {};
+    }
+
+    return image;
+}
+#endif
+} // namespace
+
+ThumbnailLoader::ThumbnailLoader(const BlobStore& blobStore_, QObject* parent)
+    : QObject(parent)
+    , blobStore{blobStore_}
+{
+    pool.setMaxThreadCount(MAX_THREADS);
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief Loads the thumbnail of an image, from the cache if possible.
+ * @param imageId Id of an image message, a blob reference or inline hex data.
+ * @param size Size the image has to fit into, in device independent pixels.
+ * @param receiver Callback is dropped if this object is deleted before the image is ready.
+ * @param onReady Called on the GUI thread, with a null image if decoding failed.
+ */
+void ThumbnailLoader::loadThumbnail(const QString& imageId, QSize size, QObject* receiver,
+                                    ReadyCallback onReady)
+{
+    const qreal dpr = qApp->devicePixelRatio();
+    const BlobStore& store = blobStore;
+    run([&store, imageId, size, dpr] { return makeThumbnail(store, imageId, size, dpr); },
+        receiver, std::move(onReady));
+}
+
+/**
+ * @brief Decodes an image at full resolution.
+ * @param imageId Id of an image message, a blob reference or inline hex data.
+ * @param receiver Callback is dropped if this object is deleted before the image is ready.
+ * @param onReady Called on the GUI thread, with a null image if decoding failed.
+ */
+void ThumbnailLoader::loadImage(const QString& imageId, QObject* receiver, ReadyCallback onReady)
+{
+    const BlobStore& store = blobStore;
+    run([&store, imageId] { return decode(loadSource(store, imageId), QSize()); }, receiver,
+        std::move(onReady));
+}
+
+/**
+ * @brief Name of the cached thumbnail of an image.
+ * @param imageId Id of the image message.
+ * @param deviceSize Size of the thumbnail in device pixels.
+ * @return File name, the same for equal arguments.
+ */
+QString ThumbnailLoader::thumbnailName(const QString& imageId, QSize deviceSize)
+{
+    // inline hex ids are far too long for a file name
+    const QByteArray hash =
+        QCryptographicHash::hash(imageId.toUtf8(), QCryptographicHash::Sha256).toHex();
+    return QStringLiteral("%1_%2x%3")
+        .arg(QString::fromLatin1(hash))
+        .arg(deviceSize.width())
+        .arg(deviceSize.height());
+}
+
+void ThumbnailLoader::run(std::function<QImage()> job, QObject* receiver, ReadyCallback onReady)
+{
+    QPointer<QObject> guard{receiver};
+    auto watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this,
+            [watcher, guard, onReady] {
+                if (guard) {
+                    onReady(watcher->result());
+                }
+                watcher->deleteLater();
+            });
+    watcher->setFuture(QtConcurrent::run(&pool, [job] {
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+        return job();
+    }));
+}
+
+/**
+ * @note Thread safe, BlobStore::get() may be called from workers.
+ */
+QByteArray ThumbnailLoader::loadSource(const BlobStore& blobStore, const QString& imageId)
+{
+    if (BlobStore::isReference(imageId)) {
+        return blobStore.get(imageId);
+    }
+
+    // HINT: older images are still stored inline as hex
+    return QByteArray::fromHex(imageId.toLatin1());
+}
+
+/**
+ * @brief Decodes an image, scaled to fit into boundingSize.
+ * @param data Encoded image.
+ * @param boundingSize Size to scale to keeping the aspect ratio, invalid for the original size.
+ * @return The image, null if it couldn't be decoded.
+ * @note Thread safe, only uses QImage.
+ */
+QImage ThumbnailLoader::decode(const QByteArray& data, QSize boundingSize)
+{
+    const ImageContainer::Format format = ImageContainer::sniff(data);
+#ifdef QTOX_LIBWEBP
+    if (format == ImageContainer::Format::Webp) {
+        const QImage image = decodeWebp(data, boundingSize);
+        if (!image.isNull()) {
+            return image;
+        }
+        // animated images are left to Qt, which shows their first frame
+    }
+#endif
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    // an unknown container is left to Qt's detection
+    QImageReader reader{&buffer, ImageContainer::qtFormat(format)};
+    reader.setAutoTransform(true);
+
+    QSize scaledSize = reader.size();
+    if (boundingSize.isValid() && scaledSize.isValid()) {
+        // decoders supporting it decode directly at the smaller size
+        scaledSize.scale(boundingSize, Qt::KeepAspectRatio);
+        reader.setScaledSize(scaledSize);
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qDebug() << "Failed to decode image:" << reader.errorString();
+    }
+    return image;
+}
+
+/**
+ * @note Thread safe, only uses QImage and the thread safe functions of the BlobStore.
+ */
+QImage ThumbnailLoader::makeThumbnail(const BlobStore& blobStore, const QString& imageId,
+                                      QSize size, qreal devicePixelRatio)
+{
+    const QSize deviceSize = size * devicePixelRatio;
+    const QString name = thumbnailName(imageId, deviceSize);
+
+    QImage image;
+    const QByteArray cached = blobStore.getThumbnail(name);
+    if (cached.isEmpty() || !image.loadFromData(cached, "PNG")) {
+        image = decode(loadSource(blobStore, imageId), deviceSize);
+        if (image.isNull()) {
+            qWarning() << "Couldn't decode group image for its thumbnail";
+            return image;
+        }
+
+        QByteArray encoded;
+        QBuffer buffer{&encoded};
+        buffer.open(QIODevice::WriteOnly);
+        if (!QImageWriter(&buffer, "PNG").write(image) || !blobStore.putThumbnail(name, encoded)) {
+            qWarning() << "Couldn't cache thumbnail" << name;
+        }
+    }
+
+    image.setDevicePixelRatio(devicePixelRatio);
+    return image;
+}
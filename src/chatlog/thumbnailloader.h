@@ -0,0 +1,62 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QImage>
+#include <QObject>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+
+class BlobStore;
+
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    using ReadyCallback = std::function<void(const QImage&)>;
+
+    explicit ThumbnailLoader(const BlobStore& blobStore, QObject* parent = nullptr);
+    ~ThumbnailLoader();
+
+    void loadThumbnail(const QString& imageId, QSize size, QObject* receiver,
+                       ReadyCallback onReady);
+    void loadImage(const QString& imageId, QObject* receiver, ReadyCallback onReady);
+
+    static QString thumbnailName(const QString& imageId, QSize deviceSize);
+
+    static constexpr int MAX_THREADS = 2;
+
+private:
+    void run(std::function<QImage()> job, QObject* receiver, ReadyCallback onReady);
+
+    static QByteArray loadSource(const BlobStore& blobStore, const QString& imageId);
+    static QImage decode(const QByteArray& data, QSize boundingSize);
+    static QImage makeThumbnail(const BlobStore& blobStore, const QString& imageId,
+                                QSize size, qreal devicePixelRatio);
+
+private:
+    const BlobStore& blobStore;
+    QThreadPool pool;
+};
@@ -0,0 +1,236 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "bootstrapnodeprober.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QNetworkProxy>
+#include <QTcpSocket>
+#include <QThreadPool>
+#include <QUdpSocket>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class BootstrapNodeProber
+ * @brief Measures concurrently which bootstrap nodes answer and how fast.
+ *
+ * Each node is probed on a worker thread, over UDP with the bootstrap info request every
+ * bootstrap daemon answers without a handshake, and over TCP by connecting to its first relay
+ * port. Waiting is bounded by BootstrapNodeRanking::PROBE_TIMEOUT_MS per transport and checks
+ * for an abort every POLL_INTERVAL_MS, so destroying the prober never blocks for long.
+ *
+ * The finished() signal is emitted once all probes of a round are done, the results are
+ * picked up with takeResults().
+ *
+ * @note Probes connect directly. Don't start them when a proxy is configured, they would
+ * bypass it and reveal our address to the nodes.
+ */
+
+constexpr int BootstrapNodeProber::MAX_THREADS;
+constexpr int BootstrapNodeProber::POLL_INTERVAL_MS;
+constexpr uint8_t BootstrapNodeProber::BOOTSTRAP_INFO_PACKET_ID;
+constexpr int BootstrapNodeProber::BOOTSTRAP_INFO_PACKET_SIZE;
+
+namespace {
+class ProbePool : public QThreadPool
+{
+public:
+    ProbePool()
+    {
+        setMaxThreadCount(BootstrapNodeProber::MAX_THREADS);
+    }
+};
+
+QThreadPool* probePool()
+{
+    static ProbePool pool;
+    return &pool;
+}
+
+BootstrapNodeRanking::Outcome probeInfoRequest(const QHostAddress& address, quint16 port,
+                                               const std::atomic<bool>& abort, qint64& rttMs)
+{
+    QUdpSocket socket;
+    QByteArray request(BootstrapNodeProber::BOOTSTRAP_INFO_PACKET_SIZE, '\0');
+    request[0] = static_cast<char>(BootstrapNodeProber::BOOTSTRAP_INFO_PACKET_ID);
+
+    QElapsedTimer timer;
+    timer.start();
+    if (socket.writeDatagram(request, address, port) != request.size()) {
+        return BootstrapNodeRanking::Outcome::Failed;
+    }
+
+    while (!abort && timer.elapsed() < BootstrapNodeRanking::PROBE_TIMEOUT_MS) {
+        if (!socket.waitForReadyRead(BootstrapNodeProber::POLL_INTERVAL_MS)) {
+            continue;
+        }
+
+        while (socket.hasPendingDatagrams()) {
+            QByteArray response(static_cast<int>(socket.pendingDatagramSize()), '\0');
+            QHostAddress sender;
+            socket.readDatagram(response.data(), response.size(), &sender);
+            if (!response.isEmpty()
+                && static_cast<uint8_t>(response[0]) == BootstrapNodeProber::BOOTSTRAP_INFO_PACKET_ID) {
+                rttMs = timer.elapsed();
+                return BootstrapNodeRanking::Outcome::Ok;
+            }
+        }
+    }
+
+    return abort ? BootstrapNodeRanking::Outcome::Skipped : BootstrapNodeRanking::Outcome::Failed;
+}
+
+BootstrapNodeRanking::Outcome probeTcpConnect(const QHostAddress& address, quint16 port,
+                                              const std::atomic<bool>& abort, qint64& rttMs)
+{
+    QTcpSocket socket;
+    socket.setProxy(QNetworkProxy::NoProxy);
+
+    QElapsedTimer timer;
+    timer.start();
+    socket.connectToHost(address, port);
+
+    while (!abort && timer.elapsed() < BootstrapNodeRanking::PROBE_TIMEOUT_MS) {
+        if (socket.waitForConnected(BootstrapNodeProber::POLL_INTERVAL_MS)) {
+            rttMs = timer.elapsed();
+            socket.abort();
+            return BootstrapNodeRanking::Outcome::Ok;
+        }
+
+        if (socket.state() == QAbstractSocket::UnconnectedState) {
+            // refused or unreachable, no need to wait for the timeout
+            return BootstrapNodeRanking::Outcome::Failed;
+        }
+    }
+
+    socket.abort();
+    return abort ? BootstrapNodeRanking::Outcome::Skipped : BootstrapNodeRanking::Outcome::Failed;
+}
+} // namespace
+
+BootstrapNodeProber::BootstrapNodeProber(QObject* parent)
+    : QObject(parent)
+{
+}
+
+BootstrapNodeProber::~BootstrapNodeProber()
+{
+    aborting = true;
+    for (auto& task : tasks) {
+        task.waitForFinished();
+    }
+}
+
+/**
+ * @brief Starts probing nodes in the background.
+ * @param nodes Nodes to probe, see BootstrapNodeRanking::probeCandidates().
+ * @param enableIPv6 True if nodes without an IPv4 address may be probed over IPv6.
+ * @param probeUdp False if UDP is disabled, only TCP is probed then.
+ * @return False if a probe round is still running or there is nothing to probe.
+ */
+bool BootstrapNodeProber::start(const QList<DhtServer>& nodes, bool enableIPv6, bool probeUdp)
+{
+    if (isRunning() || nodes.isEmpty()) {
+        return false;
+    }
+
+    {
+        QMutexLocker locker{&mutex};
+        results.clear();
+    }
+    tasks.clear();
+    pending = nodes.size();
+
+    for (const auto& node : nodes) {
+        tasks.append(QtConcurrent::run(probePool(), [this, node, enableIPv6, probeUdp]() {
+            const BootstrapNodeRanking::ProbeResult probe =
+                probeNode(node, enableIPv6, probeUdp, aborting);
+            {
+                QMutexLocker locker{&mutex};
+                results.append({node.publicKey, probe});
+            }
+
+            if (--pending == 0 && !aborting) {
+                emit finished();
+            }
+        }));
+    }
+
+    qDebug() << "Probing" << nodes.size() << "bootstrap nodes";
+    return true;
+}
+
+bool BootstrapNodeProber::isRunning() const
+{
+    return pending > 0;
+}
+
+/**
+ * @brief Hands out the results of the last probe round.
+ * @return One result per probed node.
+ */
+QVector<BootstrapNodeProber::Result> BootstrapNodeProber::takeResults()
+{
+    QMutexLocker locker{&mutex};
+    QVector<Result> taken;
+    taken.swap(results);
+    return taken;
+}
+
+/**
+ * @brief Probes a single node, blocking until both transports answered or timed out.
+ * @param node Node to probe.
+ * @param enableIPv6 True if a node without an IPv4 address may be probed over IPv6.
+ * @param probeUdp False to only probe TCP.
+ * @param abort Set to stop waiting early, unfinished probes are reported as skipped.
+ * @return Outcome and round trip time per transport.
+ */
+BootstrapNodeRanking::ProbeResult BootstrapNodeProber::probeNode(const DhtServer& node,
+                                                                 bool enableIPv6, bool probeUdp,
+                                                                 const std::atomic<bool>& abort)
+{
+    BootstrapNodeRanking::ProbeResult result{BootstrapNodeRanking::Outcome::Skipped, -1,
+                                             BootstrapNodeRanking::Outcome::Skipped, -1};
+
+    QHostAddress address;
+    if (!node.ipv4.isEmpty()) {
+        address = QHostAddress{node.ipv4};
+    } else if (!node.ipv6.isEmpty() && enableIPv6) {
+        address = QHostAddress{node.ipv6};
+    }
+
+    if (address.isNull()) {
+        // host names would need a blocking DNS lookup, toxcore resolves those itself
+        return result;
+    }
+
+    if (probeUdp && node.statusUdp) {
+        result.udp = probeInfoRequest(address, node.udpPort, abort, result.udpRttMs);
+    }
+
+    if (node.statusTcp && !node.tcpPorts.empty() && !abort) {
+        result.tcp = probeTcpConnect(address, node.tcpPorts.front(), abort, result.tcpRttMs);
+    }
+
+    return result;
+}
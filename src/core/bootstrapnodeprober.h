@@ -0,0 +1,70 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "bootstrapnoderanking.h"
+#include "dhtserver.h"
+
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+#include <atomic>
+#include <cstdint>
+
+class BootstrapNodeProber : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        ToxPk publicKey;
+        BootstrapNodeRanking::ProbeResult probe;
+    };
+
+    explicit BootstrapNodeProber(QObject* parent = nullptr);
+    ~BootstrapNodeProber();
+
+    bool start(const QList<DhtServer>& nodes, bool enableIPv6, bool probeUdp);
+    bool isRunning() const;
+    QVector<Result> takeResults();
+
+    static BootstrapNodeRanking::ProbeResult probeNode(const DhtServer& node, bool enableIPv6,
+                                                       bool probeUdp,
+                                                       const std::atomic<bool>& abort);
+
+    static constexpr int MAX_THREADS = 8;
+    static constexpr int POLL_INTERVAL_MS = 100;
+    static constexpr uint8_t BOOTSTRAP_INFO_PACKET_ID = 0xF0;
+    static constexpr int BOOTSTRAP_INFO_PACKET_SIZE = 78;
+
+signals:
+    void finished();
+
+private:
+    mutable QMutex mutex;
+    QVector<Result> results;
+    QVector<QFuture<void>> tasks;
+    std::atomic<int> pending{0};
+    std::atomic<bool> aborting{false};
+};
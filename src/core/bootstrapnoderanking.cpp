@@ -0,0 +1,322 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "bootstrapnoderanking.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+/**
+ * @class BootstrapNodeRanking
+ * @brief Remembers how well bootstrap nodes answered our probes and orders them accordingly.
+ *
+ * Every node is rated by the time we expect to wait for an answer: its smoothed round trip time
+ * weighted with how often it answered at all, a failed probe counting as PROBE_TIMEOUT_MS.
+ * Nodes we know nothing about are rated UNKNOWN_LATENCY_MS, so a node that answers quickly
+ * is tried before them and a node that keeps failing only after them.
+ *
+ * Nodes that got us a stable connection before are marked with markConnected() and tried
+ * before all others, the most recent first, until a probe finds them unreachable. Together
+ * with the UDP port we had, see setLastUdpPort(), this lets a restart reconnect through the
+ * same paths the last session ended with.
+ *
+ * The ranking is small and stored as JSON in the personal settings, see save() and load().
+ *
+ * @note Not thread safe, Core uses it from its own thread only.
+ */
+
+constexpr qint64 BootstrapNodeRanking::PROBE_TIMEOUT_MS;
+constexpr qint64 BootstrapNodeRanking::UNKNOWN_LATENCY_MS;
+constexpr qint64 BootstrapNodeRanking::PROBE_INTERVAL_SECS;
+constexpr qint64 BootstrapNodeRanking::MAX_AGE_SECS;
+constexpr int BootstrapNodeRanking::MAX_PROBED_NODES;
+constexpr int BootstrapNodeRanking::MAX_HISTORY;
+
+/**
+ * @brief Updates the statistics of a node with the result of a probe.
+ * @param publicKey DHT key of the probed node.
+ * @param result Outcome of the UDP and TCP probe.
+ * @param nowSecs Current time in seconds since epoch.
+ */
+void BootstrapNodeRanking::recordProbe(const ToxPk& publicKey, const ProbeResult& result,
+                                       qint64 nowSecs)
+{
+    NodeStats& node = stats[publicKey.toString()];
+    record(node.udpRttMs, node.udpSuccesses, node.udpFailures, result.udp, result.udpRttMs);
+    record(node.tcpRttMs, node.tcpSuccesses, node.tcpFailures, result.tcp, result.tcpRttMs);
+    node.lastProbeSecs = nowSecs;
+
+    const bool answered = result.udp == Outcome::Ok || result.tcp == Outcome::Ok;
+    const bool failed = result.udp == Outcome::Failed || result.tcp == Outcome::Failed;
+    if (failed && !answered) {
+        // it doesn't matter that we once connected through it, it's gone now
+        node.lastConnectSecs = 0;
+    }
+}
+
+/**
+ * @brief Remembers the nodes we bootstrapped from before getting a stable connection.
+ * @param publicKeys DHT keys of the nodes.
+ * @param nowSecs Current time in seconds since epoch.
+ */
+void BootstrapNodeRanking::markConnected(const QList<ToxPk>& publicKeys, qint64 nowSecs)
+{
+    for (const auto& publicKey : publicKeys) {
+        stats[publicKey.toString()].lastConnectSecs = nowSecs;
+    }
+}
+
+/**
+ * @brief Orders nodes from the most to the least promising one.
+ * @param nodes Nodes to order.
+ * @param tcpOnly True if UDP is disabled and only the TCP results matter.
+ * @return The nodes, nodes with the same expected latency are shuffled.
+ */
+QList<DhtServer> BootstrapNodeRanking::rank(QList<DhtServer> nodes, bool tcpOnly) const
+{
+    // shuffle first, so unknown nodes don't get tried in the same order on every start
+    std::mt19937 rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    std::shuffle(nodes.begin(), nodes.end(), rng);
+
+    struct RatedNode
+    {
+        qint64 connectSecs;
+        qint64 latencyMs;
+        DhtServer node;
+    };
+
+    QVector<RatedNode> rated;
+    rated.reserve(nodes.size());
+    for (const auto& node : nodes) {
+        const auto it = stats.constFind(node.publicKey.toString());
+        const qint64 connectSecs = it == stats.constEnd() ? 0 : it->lastConnectSecs;
+        rated.append({connectSecs, expectedLatencyMs(node.publicKey, tcpOnly), node});
+    }
+
+    std::stable_sort(rated.begin(), rated.end(), [](const RatedNode& a, const RatedNode& b) {
+        if (a.connectSecs != b.connectSecs) {
+            return a.connectSecs > b.connectSecs;
+        }
+        return a.latencyMs < b.latencyMs;
+    });
+
+    QList<DhtServer> ranked;
+    ranked.reserve(rated.size());
+    for (const auto& node : rated) {
+        ranked.append(node.node);
+    }
+    return ranked;
+}
+
+/**
+ * @brief Picks the nodes worth probing next.
+ * @param nodes All known bootstrap nodes.
+ * @param tcpOnly True if UDP is disabled and only the TCP results matter.
+ * @return Up to MAX_PROBED_NODES nodes: the best ranked half, to keep their ratings current,
+ * and a random pick of the others, so nodes that failed in the past get another chance.
+ */
+QList<DhtServer> BootstrapNodeRanking::probeCandidates(const QList<DhtServer>& nodes,
+                                                       bool tcpOnly) const
+{
+    QList<DhtServer> ranked = rank(nodes, tcpOnly);
+    if (ranked.size() <= MAX_PROBED_NODES) {
+        return ranked;
+    }
+
+    const int best = MAX_PROBED_NODES / 2;
+    QList<DhtServer> candidates = ranked.mid(0, best);
+    QList<DhtServer> others = ranked.mid(best);
+
+    std::mt19937 rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    std::shuffle(others.begin(), others.end(), rng);
+    candidates.append(others.mid(0, MAX_PROBED_NODES - best));
+    return candidates;
+}
+
+/**
+ * @brief Time we expect to wait for an answer of a node.
+ * @param publicKey DHT key of the node.
+ * @param tcpOnly True if UDP is disabled and only the TCP results matter.
+ * @return Expected latency in milliseconds.
+ */
+qint64 BootstrapNodeRanking::expectedLatencyMs(const ToxPk& publicKey, bool tcpOnly) const
+{
+    const auto it = stats.constFind(publicKey.toString());
+    if (it == stats.constEnd()) {
+        return UNKNOWN_LATENCY_MS;
+    }
+
+    const qint64 tcp = expectedLatencyMs(it->tcpRttMs, it->tcpSuccesses, it->tcpFailures);
+    if (tcpOnly) {
+        return tcp;
+    }
+
+    const qint64 udp = expectedLatencyMs(it->udpRttMs, it->udpSuccesses, it->udpFailures);
+    return std::min(udp, tcp);
+}
+
+/**
+ * @brief Checks if the last probe round is old enough to probe again.
+ * @param nowSecs Current time in seconds since epoch.
+ */
+bool BootstrapNodeRanking::needsProbe(qint64 nowSecs) const
+{
+    return nowSecs - lastProbeSecs >= PROBE_INTERVAL_SECS || nowSecs < lastProbeSecs;
+}
+
+void BootstrapNodeRanking::setProbed(qint64 nowSecs)
+{
+    lastProbeSecs = nowSecs;
+}
+
+/**
+ * @brief UDP port of the last session that got a stable connection.
+ * @return The port, 0 if unknown.
+ */
+quint16 BootstrapNodeRanking::getLastUdpPort() const
+{
+    return lastUdpPort;
+}
+
+void BootstrapNodeRanking::setLastUdpPort(quint16 port)
+{
+    lastUdpPort = port;
+}
+
+/**
+ * @brief Serializes the ranking, dropping nodes we didn't hear of for MAX_AGE_SECS.
+ * @param nowSecs Current time in seconds since epoch.
+ * @return Compact JSON document.
+ */
+QByteArray BootstrapNodeRanking::save(qint64 nowSecs) const
+{
+    QJsonArray nodes;
+    for (auto it = stats.constBegin(); it != stats.constEnd(); ++it) {
+        if (nowSecs - std::max(it->lastProbeSecs, it->lastConnectSecs) > MAX_AGE_SECS) {
+            continue;
+        }
+
+        QJsonObject node;
+        node["pk"] = it.key();
+        node["udpRtt"] = it->udpRttMs;
+        node["udpOk"] = it->udpSuccesses;
+        node["udpFail"] = it->udpFailures;
+        node["tcpRtt"] = it->tcpRttMs;
+        node["tcpOk"] = it->tcpSuccesses;
+        node["tcpFail"] = it->tcpFailures;
+        node["probed"] = it->lastProbeSecs;
+        node["connected"] = it->lastConnectSecs;
+        nodes.append(node);
+    }
+
+    QJsonObject root;
+    root["probed"] = lastProbeSecs;
+    root["udpPort"] = lastUdpPort;
+    root["nodes"] = nodes;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @brief Replaces the ranking with a serialized one.
+ * @param data JSON document created by save(), can be empty.
+ * @return False if the data couldn't be parsed, the ranking is empty then.
+ */
+bool BootstrapNodeRanking::load(const QByteArray& data)
+{
+    stats.clear();
+    lastProbeSecs = 0;
+    lastUdpPort = 0;
+
+    if (data.isEmpty()) {
+        return true;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        qWarning() << "Failed to parse bootstrap node ranking:" << error.errorString();
+        return false;
+    }
+
+    const QJsonObject root = doc.object();
+    lastProbeSecs = static_cast<qint64>(root["probed"].toDouble());
+    lastUdpPort = static_cast<quint16>(root["udpPort"].toInt());
+    for (const QJsonValue& value : root["nodes"].toArray()) {
+        const QJsonObject node = value.toObject();
+        const QString publicKey = node["pk"].toString().toUpper();
+        if (publicKey.length() != ToxPk::numHexChars) {
+            continue;
+        }
+
+        NodeStats& entry = stats[publicKey];
+        entry.udpRttMs = static_cast<qint64>(node["udpRtt"].toDouble(-1));
+        entry.udpSuccesses = node["udpOk"].toInt();
+        entry.udpFailures = node["udpFail"].toInt();
+        entry.tcpRttMs = static_cast<qint64>(node["tcpRtt"].toDouble(-1));
+        entry.tcpSuccesses = node["tcpOk"].toInt();
+        entry.tcpFailures = node["tcpFail"].toInt();
+        entry.lastProbeSecs = static_cast<qint64>(node["probed"].toDouble());
+        entry.lastConnectSecs = static_cast<qint64>(node["connected"].toDouble());
+    }
+
+    return true;
+}
+
+qint64 BootstrapNodeRanking::expectedLatencyMs(qint64 rttMs, int successes, int failures)
+{
+    if (successes + failures <= 0) {
+        return UNKNOWN_LATENCY_MS;
+    }
+
+    if (successes <= 0 || rttMs < 0) {
+        return PROBE_TIMEOUT_MS;
+    }
+
+    return (rttMs * successes + PROBE_TIMEOUT_MS * failures) / (successes + failures);
+}
+
+void BootstrapNodeRanking::record(qint64& rttMs, int& successes, int& failures, Outcome outcome,
+                                  qint64 sampleMs)
+{
+    switch (outcome) {
+    case Outcome::Skipped:
+        return;
+    case Outcome::Ok:
+        rttMs = rttMs < 0 ? sampleMs : (3 * rttMs + sampleMs) / 4;
+        ++successes;
+        break;
+    case Outcome::Failed:
+        ++failures;
+        break;
+    }
+
+    // forget old results slowly, so a node that went down or came back is noticed
+    if (successes + failures > MAX_HISTORY) {
+        successes = (successes + 1) / 2;
+        failures = (failures + 1) / 2;
+    }
+}
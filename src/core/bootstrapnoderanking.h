@@ -0,0 +1,92 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "dhtserver.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+class BootstrapNodeRanking
+{
+public:
+    enum class Outcome
+    {
+        Skipped,
+        Ok,
+        Failed
+    };
+
+    struct ProbeResult
+    {
+        Outcome udp;
+        qint64 udpRttMs;
+        Outcome tcp;
+        qint64 tcpRttMs;
+    };
+
+    void recordProbe(const ToxPk& publicKey, const ProbeResult& result, qint64 nowSecs);
+    void markConnected(const QList<ToxPk>& publicKeys, qint64 nowSecs);
+    QList<DhtServer> rank(QList<DhtServer> nodes, bool tcpOnly) const;
+    QList<DhtServer> probeCandidates(const QList<DhtServer>& nodes, bool tcpOnly) const;
+    qint64 expectedLatencyMs(const ToxPk& publicKey, bool tcpOnly) const;
+
+    bool needsProbe(qint64 nowSecs) const;
+    void setProbed(qint64 nowSecs);
+
+    quint16 getLastUdpPort() const;
+    void setLastUdpPort(quint16 port);
+
+    QByteArray save(qint64 nowSecs) const;
+    bool load(const QByteArray& data);
+
+    static constexpr qint64 PROBE_TIMEOUT_MS = 2000;
+    static constexpr qint64 UNKNOWN_LATENCY_MS = PROBE_TIMEOUT_MS / 2;
+    static constexpr qint64 PROBE_INTERVAL_SECS = 6 * 60 * 60;
+    static constexpr qint64 MAX_AGE_SECS = 30 * 24 * 60 * 60;
+    static constexpr int MAX_PROBED_NODES = 16;
+    static constexpr int MAX_HISTORY = 16;
+
+private:
+    struct NodeStats
+    {
+        qint64 udpRttMs = -1;
+        qint64 tcpRttMs = -1;
+        int udpSuccesses = 0;
+        int udpFailures = 0;
+        int tcpSuccesses = 0;
+        int tcpFailures = 0;
+        qint64 lastProbeSecs = 0;
+        qint64 lastConnectSecs = 0;
+    };
+
+    static qint64 expectedLatencyMs(qint64 rttMs, int successes, int failures);
+    static void record(qint64& rttMs, int& successes, int& failures, Outcome outcome,
+                       qint64 sampleMs);
+
+private:
+    QHash<QString, NodeStats> stats;
+    qint64 lastProbeSecs = 0;
+    quint16 lastUdpPort = 0;
+};
@@ -0,0 +1,445 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callaudiodsp.h"
+
+#include "webrtc6/webrtc/common_audio/include/audio_util.h"
+#include "webrtc6/webrtc/modules/audio_processing/agc/legacy/gain_control.h"
+#include "webrtc6/webrtc/modules/audio_processing/transient/transient_suppressor.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @class CallAudioDsp
+ * @brief Echo cancellation and noise suppression state of a single call.
+ *
+ * Everything the send path needs is allocated once when the call is set up, so processing a
+ * frame never touches the allocator. The near end (microphone) is processed on the audio send
+ * thread, the far end (received audio) is buffered from the CoreAV thread, each direction has its
+ * own PolyphaseResampler state. The far end thread only resamples and hands 10ms blocks over
+ * through a lock-free queue, the near end thread feeds them to AECM before each frame. So the
+ * AECM instance is only ever touched by one thread and neither side can stall the other.
+ *
+ * With full processing enabled, each 10ms block runs through the rest of the webrtc capture
+ * chain as well: high-pass filter, noise suppression, echo cancellation, adaptive digital gain
+ * control and voice activity detection, in the order AudioProcessing uses. The VAD decision
+ * lets the caller skip sending silent frames.
+ *
+ * Transient suppression is a separate optional stage at the end of the chain, like in
+ * AudioProcessing. It attenuates keyboard clicks, but only once the caller reported typing
+ * through the keyPressed hint of processNearEnd(), the click detection alone never enables it.
+ * The stage delays the signal by a few milliseconds while it is enabled.
+ *
+ * The send path takes the output of filterNearEnd() at PROCESS_SAMPLE_RATE straight to the
+ * encoder, so a captured sample is only resampled once, down to the processing rate. Received
+ * audio is played as it is, the far end reference is a separate downsampled copy.
+ *
+ * @var CallAudioDsp::MAX_FRAME_SAMPLES
+ * @brief Largest frame accepted, 60ms at 48kHz mono.
+ *
+ * @var CallAudioDsp::BLOCK_SAMPLES
+ * @brief AECM and NSX work on 10ms blocks.
+ *
+ * @var CallAudioDsp::FAR_END_QUEUE_BLOCKS
+ * @brief Far end blocks queued for the near end thread, 630ms. More than that means the near
+ * end stopped processing, e.g. because the microphone is muted, and new blocks are dropped.
+ */
+
+constexpr uint32_t CallAudioDsp::INPUT_SAMPLE_RATE;
+constexpr uint32_t CallAudioDsp::PROCESS_SAMPLE_RATE;
+constexpr size_t CallAudioDsp::RESAMPLE_FACTOR;
+constexpr size_t CallAudioDsp::BLOCK_SAMPLES;
+constexpr size_t CallAudioDsp::MAX_FRAME_SAMPLES;
+constexpr size_t CallAudioDsp::MAX_PROCESS_SAMPLES;
+constexpr size_t CallAudioDsp::FAR_END_QUEUE_BLOCKS;
+
+static_assert(CallAudioDsp::RESAMPLE_FACTOR == PolyphaseResampler::FACTOR,
+              "The echo cancellation path resamples by a fixed factor");
+
+CallAudioDsp::CallAudioDsp()
+    : aecmInst{WebRtcAecm_Create()}
+    , nsxInst{WebRtcNsx_Create()}
+    , agcInst{WebRtcAgc_Create()}
+    , voiceDetector{PROCESS_SAMPLE_RATE}
+    , transientSuppressor{new webrtc::TransientSuppressor}
+    , nearDownsampler{PolyphaseResampler::Direction::Downsample, MAX_FRAME_SAMPLES}
+    , nearUpsampler{PolyphaseResampler::Direction::Upsample, MAX_PROCESS_SAMPLES}
+    , farDownsampler{PolyphaseResampler::Direction::Downsample, MAX_FRAME_SAMPLES}
+{
+    highPass.reset();
+    nearResampled.fill(0);
+    nearFiltered.fill(0);
+    nearCancelled.fill(0);
+    farResampled.fill(0);
+    nearOut.fill(0);
+    transientBlock.fill(0);
+
+    if (WebRtcAecm_Init(aecmInst, PROCESS_SAMPLE_RATE) != 0) {
+        qWarning() << "WebRtcAecm_Init failed";
+    }
+
+    if (WebRtcNsx_Init(nsxInst, PROCESS_SAMPLE_RATE) != 0) {
+        qWarning() << "WebRtcNsx_Init failed";
+    }
+}
+
+CallAudioDsp::~CallAudioDsp()
+{
+    WebRtcAecm_Free(aecmInst);
+    WebRtcNsx_Free(nsxInst);
+    WebRtcAgc_Free(agcInst);
+}
+
+/**
+ * @brief Checks if a 48kHz mono frame of this size can be run through the filters.
+ * @param samples Number of samples in the frame.
+ * @return True if the frame is a multiple of 10ms and not larger than MAX_FRAME_SAMPLES.
+ */
+bool CallAudioDsp::canProcess(size_t samples)
+{
+    const size_t inputBlock = BLOCK_SAMPLES * RESAMPLE_FACTOR;
+    return samples > 0 && samples <= MAX_FRAME_SAMPLES && (samples % inputBlock) == 0;
+}
+
+/**
+ * @brief Sets the AECM comfort noise mode, does nothing if the mode didn't change.
+ * @param mode AecmFalse or AecmTrue.
+ */
+void CallAudioDsp::setAecMode(int mode)
+{
+    if (mode == aecMode) {
+        return;
+    }
+
+    aecMode = mode;
+    qDebug() << "Setting AEC Mode to: " << aecMode;
+
+    AecmConfig config;
+    config.echoMode = AecmTrue;
+    config.cngMode = static_cast<int16_t>(aecMode);
+
+    WebRtcAecm_set_config(aecmInst, config);
+}
+
+/**
+ * @brief Sets the noise suppression policy, does nothing if the policy didn't change.
+ * @param mode 0: Mild, 1: Medium , 2: Aggressive, 3: more Aggressive
+ */
+void CallAudioDsp::setNsMode(int mode)
+{
+    if (mode == nsMode) {
+        return;
+    }
+
+    nsMode = mode;
+    const int res = WebRtcNsx_set_policy(nsxInst, nsMode);
+    qDebug() << "WebRtcNsx_set_policy: mode: " << nsMode << "res :----->" << res;
+}
+
+/**
+ * @brief Switches the high-pass filter, gain control and voice activity detection on or off.
+ * @param enabled True for the full processing chain, false for NS and AECM only.
+ */
+void CallAudioDsp::setFullProcessing(bool enabled)
+{
+    if (enabled == fullProcessing) {
+        return;
+    }
+
+    fullProcessing = enabled;
+    voiceActive = true;
+    qDebug() << "Full audio processing:" << fullProcessing;
+    if (!fullProcessing) {
+        return;
+    }
+
+    // start from a clean state, the filters didn't see the audio in between
+    highPass.reset();
+    voiceDetector.reset();
+    agcMicLevel = 0;
+    if (WebRtcAgc_Init(agcInst, 0, 255, kAgcModeAdaptiveDigital, PROCESS_SAMPLE_RATE) != 0) {
+        qWarning() << "WebRtcAgc_Init failed";
+        return;
+    }
+
+    WebRtcAgcConfig config;
+    config.targetLevelDbfs = 3;
+    config.compressionGaindB = 9;
+    config.limiterEnable = 1;
+    if (WebRtcAgc_set_config(agcInst, config) != 0) {
+        qWarning() << "WebRtcAgc_set_config failed";
+    }
+}
+
+/**
+ * @brief Switches keyboard click suppression on or off.
+ * @param enabled True to run the transient suppressor after the rest of the chain.
+ */
+void CallAudioDsp::setTransientSuppression(bool enabled)
+{
+    if (enabled == transientSuppression) {
+        return;
+    }
+
+    transientSuppression = enabled;
+    qDebug() << "Transient suppression:" << transientSuppression;
+    if (!transientSuppression) {
+        return;
+    }
+
+    // forget the typing state and the delayed audio of the last time it was enabled
+    const int rate = static_cast<int>(PROCESS_SAMPLE_RATE);
+    if (transientSuppressor->Initialize(rate, rate, 1) != 0) {
+        qWarning() << "TransientSuppressor::Initialize failed";
+        transientSuppression = false;
+    }
+}
+
+/**
+ * @brief Runs noise suppression and echo cancellation on a captured frame.
+ * @param pcm 48kHz mono samples.
+ * @param samples Number of samples in pcm.
+ * @param echoDelayMs Delay between playback and capture reported by the device, only used until
+ * the echo delay estimator found the delay.
+ * @param keyPressed True if a key was held down while the frame was captured.
+ * @return Pointer to the filtered frame, valid until the next call. If the frame can't be
+ * processed, pcm is returned unchanged.
+ */
+const int16_t* CallAudioDsp::processNearEnd(const int16_t* pcm, size_t samples, int echoDelayMs,
+                                            bool keyPressed)
+{
+    const int16_t* filtered = filterNearEnd(pcm, samples, echoDelayMs, keyPressed);
+    if (!filtered) {
+        return pcm;
+    }
+
+    if (nearUpsampler.process(filtered, samples / RESAMPLE_FACTOR, nearOut.data()) != samples) {
+        return pcm;
+    }
+
+    return nearOut.data();
+}
+
+/**
+ * @brief Like processNearEnd(), but returns the frame at PROCESS_SAMPLE_RATE.
+ *
+ * The filtered audio has no content above PROCESS_SAMPLE_RATE / 2 anyway, so callers that can
+ * take the lower rate, like the Opus encoder, save resampling it back up.
+ * @param pcm 48kHz mono samples.
+ * @param samples Number of samples in pcm.
+ * @param echoDelayMs See processNearEnd().
+ * @param keyPressed See processNearEnd().
+ * @return Pointer to samples / RESAMPLE_FACTOR filtered samples, valid until the next call, or
+ * nullptr if the frame can't be processed.
+ */
+const int16_t* CallAudioDsp::filterNearEnd(const int16_t* pcm, size_t samples, int echoDelayMs,
+                                           bool keyPressed)
+{
+    // never suppress a frame we couldn't look at
+    voiceActive = true;
+
+    if (!canProcess(samples)) {
+        return nullptr;
+    }
+
+    const size_t resampled = samples / RESAMPLE_FACTOR;
+    if (nearDownsampler.process(pcm, samples, nearResampled.data()) != resampled) {
+        return nullptr;
+    }
+
+    drainFarEnd();
+    delayEstimator.addNearEnd(nearResampled.data(), resampled);
+    const int estimatedDelayMs = delayEstimator.getDelayMs();
+    if (estimatedDelayMs >= 0) {
+        echoDelayMs = estimatedDelayMs;
+    }
+
+    for (size_t offset = 0; offset < resampled; offset += BLOCK_SAMPLES) {
+        if (fullProcessing) {
+            highPass.process(nearResampled.data() + offset, BLOCK_SAMPLES);
+        }
+
+        const int16_t* const nsIn[] = {nearResampled.data() + offset, nullptr};
+        int16_t* const nsOut[] = {nearFiltered.data() + offset, nullptr};
+        WebRtcNsx_Process(nsxInst, nsIn, 1, nsOut);
+
+        WebRtcAecm_Process(aecmInst, nearResampled.data() + offset, nearFiltered.data() + offset,
+                           nearCancelled.data() + offset, BLOCK_SAMPLES,
+                           static_cast<int16_t>(echoDelayMs));
+
+        if (fullProcessing) {
+            processGain(nearCancelled.data() + offset);
+        }
+
+        if (transientSuppression) {
+            processTransients(nearCancelled.data() + offset, keyPressed);
+        }
+    }
+
+    if (fullProcessing) {
+        voiceActive = voiceDetector.process(nearCancelled.data(), resampled);
+    }
+
+    return nearCancelled.data();
+}
+
+/**
+ * @brief Queues a received frame for the echo canceller as far end reference.
+ * @param pcm 48kHz mono samples.
+ * @param samples Number of samples in pcm.
+ * @note Must always be called from the same thread.
+ */
+void CallAudioDsp::bufferFarEnd(const int16_t* pcm, size_t samples)
+{
+    if (!canProcess(samples)) {
+        return;
+    }
+
+    const size_t resampled = samples / RESAMPLE_FACTOR;
+    if (farDownsampler.process(pcm, samples, farResampled.data()) != resampled) {
+        return;
+    }
+
+    for (size_t offset = 0; offset < resampled; offset += BLOCK_SAMPLES) {
+        FarEndBlock* block = farEndQueue.producerSlot();
+        if (!block) {
+            ++droppedFarEndBlocks;
+            continue;
+        }
+
+        std::copy(farResampled.begin() + offset, farResampled.begin() + offset + BLOCK_SAMPLES,
+                  block->begin());
+        farEndQueue.commitPush();
+    }
+}
+
+/**
+ * @brief Far end blocks dropped because the near end didn't take them in time.
+ */
+uint64_t CallAudioDsp::getDroppedFarEndBlocks() const
+{
+    return droppedFarEndBlocks;
+}
+
+/**
+ * @brief Hands all queued far end blocks to AECM, near end thread only.
+ */
+void CallAudioDsp::drainFarEnd()
+{
+    while (FarEndBlock* block = farEndQueue.consumerSlot()) {
+        WebRtcAecm_BufferFarend(aecmInst, block->data(), BLOCK_SAMPLES);
+        delayEstimator.addFarEnd(block->data(), BLOCK_SAMPLES);
+        farEndQueue.commitPop();
+    }
+}
+
+/**
+ * @brief Tells if the last processed frame should be sent.
+ * @return False only if full processing is enabled and the VAD found no voice recently.
+ */
+bool CallAudioDsp::isVoiceActive() const
+{
+    return voiceActive;
+}
+
+/**
+ * @brief Applies adaptive digital gain to a 10ms block in place.
+ */
+void CallAudioDsp::processGain(int16_t* block)
+{
+    int16_t* const bands[] = {block};
+    int32_t levelOut = agcMicLevel;
+    // there is no analog volume to control, the virtual mic emulates one digitally
+    if (WebRtcAgc_VirtualMic(agcInst, bands, 1, BLOCK_SAMPLES, agcMicLevel, &levelOut) != 0) {
+        return;
+    }
+    agcMicLevel = levelOut;
+
+    uint8_t saturated = 0;
+    if (WebRtcAgc_Process(agcInst, bands, 1, BLOCK_SAMPLES, bands, agcMicLevel, &levelOut, 0,
+                          &saturated)
+        == 0) {
+        agcMicLevel = levelOut;
+    }
+}
+
+/**
+ * @brief Suppresses keyboard clicks in a 10ms block in place.
+ */
+void CallAudioDsp::processTransients(int16_t* block, bool keyPressed)
+{
+    // the suppressor works on int16 ranged floats
+    std::copy(block, block + BLOCK_SAMPLES, transientBlock.begin());
+
+    // no voice probability available at this point, 1 is what the suppressor expects then
+    if (transientSuppressor->Suppress(transientBlock.data(), BLOCK_SAMPLES, 1, nullptr,
+                                      BLOCK_SAMPLES, nullptr, 0, 1.f, keyPressed)
+        != 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < BLOCK_SAMPLES; ++i) {
+        block[i] = webrtc::FloatS16ToS16(transientBlock[i]);
+    }
+}
+
+void CallAudioDsp::HighPassFilter::reset()
+{
+    x.fill(0);
+    y.fill(0);
+}
+
+/**
+ * @brief Second order high-pass at 16kHz, fixed point like webrtc's HighPassFilterImpl.
+ */
+void CallAudioDsp::HighPassFilter::process(int16_t* data, size_t length)
+{
+    static const int16_t ba[5] = {4012, -8024, 4012, 8002, -3913};
+
+    for (size_t i = 0; i < length; ++i) {
+        // y[i] = b[0] * x[i] + b[1] * x[i-1] + b[2] * x[i-2] - a[1] * y[i-1] - a[2] * y[i-2]
+        // y is kept in high and low parts for precision
+        int32_t acc = y[1] * ba[3];
+        acc += y[3] * ba[4];
+        acc >>= 15;
+        acc += y[0] * ba[3];
+        acc += y[2] * ba[4];
+        acc <<= 1;
+
+        acc += data[i] * ba[0];
+        acc += x[0] * ba[1];
+        acc += x[1] * ba[2];
+
+        x[1] = x[0];
+        x[0] = data[i];
+
+        y[2] = y[0];
+        y[3] = y[1];
+        y[0] = static_cast<int16_t>(acc >> 13);
+        y[1] = static_cast<int16_t>((acc - (static_cast<int32_t>(y[0]) << 13)) << 2);
+
+        // round in Q12 and saturate to 2^27 so the result fits 16 bit
+        acc += 2048;
+        acc = std::max<int32_t>(-134217728, std::min<int32_t>(134217727, acc));
+        data[i] = static_cast<int16_t>(acc >> 12);
+    }
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// commit 051b62014cfa18adf7ca7caf327b0c0882353f22
+// Author: kjellander <kjellander@webrtc.org>
+// Date:   Wed Dec 30 11:58:12 2015 -0800
+//
+//     Roll chromium_revision 58e631b..d66326c (367148:367167)
+#include "webrtc6/webrtc/modules/audio_processing/aecm/echo_control_mobile.h"
+#include "webrtc6/webrtc/modules/audio_processing/ns/noise_suppression_x.h"
+
+#include "echodelayestimator.h"
+#include "polyphaseresampler.h"
+#include "voiceactivitydetector.h"
+#include "util/spscqueue.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace webrtc {
+class TransientSuppressor;
+}
+
+class CallAudioDsp
+{
+public:
+    CallAudioDsp();
+    ~CallAudioDsp();
+
+    CallAudioDsp(const CallAudioDsp&) = delete;
+    CallAudioDsp& operator=(const CallAudioDsp&) = delete;
+    CallAudioDsp(CallAudioDsp&&) = delete;
+    CallAudioDsp& operator=(CallAudioDsp&&) = delete;
+
+    void setAecMode(int mode);
+    void setNsMode(int mode);
+    void setFullProcessing(bool enabled);
+    void setTransientSuppression(bool enabled);
+
+    const int16_t* processNearEnd(const int16_t* pcm, size_t samples, int echoDelayMs,
+                                  bool keyPressed);
+    const int16_t* filterNearEnd(const int16_t* pcm, size_t samples, int echoDelayMs,
+                                 bool keyPressed);
+    void bufferFarEnd(const int16_t* pcm, size_t samples);
+    bool isVoiceActive() const;
+    uint64_t getDroppedFarEndBlocks() const;
+
+    static bool canProcess(size_t samples);
+
+    static constexpr uint32_t INPUT_SAMPLE_RATE = 48000;
+    static constexpr uint32_t PROCESS_SAMPLE_RATE = 16000;
+    static constexpr size_t RESAMPLE_FACTOR = INPUT_SAMPLE_RATE / PROCESS_SAMPLE_RATE;
+    static constexpr size_t BLOCK_SAMPLES = PROCESS_SAMPLE_RATE / 100;
+    static constexpr size_t MAX_FRAME_SAMPLES = INPUT_SAMPLE_RATE * 60 / 1000;
+    static constexpr size_t MAX_PROCESS_SAMPLES = MAX_FRAME_SAMPLES / RESAMPLE_FACTOR;
+    static constexpr size_t FAR_END_QUEUE_BLOCKS = 64;
+
+private:
+    struct HighPassFilter
+    {
+        std::array<int16_t, 2> x;
+        std::array<int16_t, 4> y;
+
+        void reset();
+        void process(int16_t* data, size_t length);
+    };
+
+    using FarEndBlock = std::array<int16_t, BLOCK_SAMPLES>;
+
+    void drainFarEnd();
+    void processGain(int16_t* block);
+    void processTransients(int16_t* block, bool keyPressed);
+
+private:
+    void* aecmInst = nullptr;
+    NsxHandle* nsxInst = nullptr;
+    void* agcInst = nullptr;
+    int aecMode = -1;
+    int nsMode = -1;
+
+    bool fullProcessing = false;
+    bool transientSuppression = false;
+    bool voiceActive = true;
+    int32_t agcMicLevel = 0;
+    HighPassFilter highPass;
+    VoiceActivityDetector voiceDetector;
+    EchoDelayEstimator delayEstimator;
+    std::unique_ptr<webrtc::TransientSuppressor> transientSuppressor;
+
+    PolyphaseResampler nearDownsampler;
+    PolyphaseResampler nearUpsampler;
+    PolyphaseResampler farDownsampler;
+
+    // near end and far end are fed from different threads, only the near end thread uses AECM
+    SpscQueue<FarEndBlock, FAR_END_QUEUE_BLOCKS> farEndQueue;
+    std::atomic<uint64_t> droppedFarEndBlocks{0};
+
+    std::array<int16_t, MAX_PROCESS_SAMPLES> nearResampled;
+    std::array<int16_t, MAX_PROCESS_SAMPLES> nearFiltered;
+    std::array<int16_t, MAX_PROCESS_SAMPLES> nearCancelled;
+    std::array<int16_t, MAX_PROCESS_SAMPLES> farResampled;
+    std::array<int16_t, MAX_FRAME_SAMPLES> nearOut;
+    std::array<float, BLOCK_SAMPLES> transientBlock;
+};
@@ -0,0 +1,160 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callaudioresilience.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @class CallAudioResilience
+ * @brief Picks how a call's audio copes with packet loss.
+ *
+ * The loss of a call is measured on both ends we can see: audio frames toxav failed to send, and
+ * received frames the playback queue had to drop or that arrived after it ran dry. Once per
+ * UPDATE_INTERVAL_MS the loss of the interval is folded into a smoothed estimate, which drives
+ * the Profile:
+ *
+ * - fec: toxav always runs Opus with in-band FEC, but the encoder only spends bits on it if the
+ *   bitrate leaves room for it. A lossy call keeps its audio bitrate at FEC_MIN_AUDIO_KBPS or
+ *   above, and the receiver buffers FEC_EXTRA_PLAYOUT_FRAMES more, because a frame can only be
+ *   recovered once the packet after it arrived.
+ * - frameMs: on heavy loss the frames are sent in SHORT_FRAME_MS packets, so each lost packet
+ *   leaves a shorter gap for packet loss concealment to fill.
+ *
+ * Both switch back with a lower threshold than they switch on, so the profile doesn't flap
+ * around a threshold.
+ *
+ * @note All methods are thread safe, the send thread and the CoreAV thread feed the same object.
+ */
+
+constexpr uint32_t CallAudioResilience::LONG_FRAME_MS;
+constexpr uint32_t CallAudioResilience::SHORT_FRAME_MS;
+constexpr qint64 CallAudioResilience::UPDATE_INTERVAL_MS;
+constexpr uint32_t CallAudioResilience::FEC_ON_LOSS_PERCENT;
+constexpr uint32_t CallAudioResilience::FEC_OFF_LOSS_PERCENT;
+constexpr uint32_t CallAudioResilience::SHORT_FRAME_ON_LOSS_PERCENT;
+constexpr uint32_t CallAudioResilience::SHORT_FRAME_OFF_LOSS_PERCENT;
+constexpr uint32_t CallAudioResilience::FEC_MIN_AUDIO_KBPS;
+constexpr unsigned CallAudioResilience::FEC_EXTRA_PLAYOUT_FRAMES;
+
+CallAudioResilience::CallAudioResilience()
+{
+    reset();
+}
+
+/**
+ * @brief Starts over without any loss, e.g. when a call starts.
+ */
+void CallAudioResilience::reset()
+{
+    QMutexLocker locker{&mutex};
+    profile = Profile{};
+    lossPercent = 0;
+    lastUpdateMs = -1;
+    sentFrames = 0;
+    droppedFrames = 0;
+    receivedFrames = 0;
+    lateFrames = 0;
+    lastLateTotal = 0;
+}
+
+/**
+ * @brief Records an audio frame send attempt.
+ * @param dropped True if the frame could not be sent.
+ */
+void CallAudioResilience::onAudioSent(bool dropped)
+{
+    QMutexLocker locker{&mutex};
+    ++sentFrames;
+    droppedFrames += dropped ? 1 : 0;
+}
+
+/**
+ * @brief Records a received audio frame.
+ * @param lateTotal Total late frames of the playback queue, see IAudioSink::getLateFrames().
+ */
+void CallAudioResilience::onAudioReceived(uint64_t lateTotal)
+{
+    QMutexLocker locker{&mutex};
+    ++receivedFrames;
+    // the sink may have been replaced and started counting from zero
+    if (lateTotal >= lastLateTotal) {
+        lateFrames += static_cast<uint32_t>(lateTotal - lastLateTotal);
+    }
+    lastLateTotal = lateTotal;
+}
+
+/**
+ * @brief Re-evaluates the profile if the update interval passed.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @return True if FEC or the frame duration changed and must be applied.
+ */
+bool CallAudioResilience::update(qint64 nowMs)
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastUpdateMs < 0) {
+        lastUpdateMs = nowMs;
+        return false;
+    }
+
+    if (nowMs - lastUpdateMs < UPDATE_INTERVAL_MS) {
+        return false;
+    }
+    lastUpdateMs = nowMs;
+
+    const uint32_t frames = sentFrames + receivedFrames;
+    if (frames > 0) {
+        const qreal intervalLoss = 100.0 * std::min(droppedFrames + lateFrames, frames) / frames;
+        // react to loss quickly, but only believe a clean path after a few intervals
+        const qreal weight = intervalLoss > lossPercent ? 0.5 : 0.125;
+        lossPercent += (intervalLoss - lossPercent) * weight;
+    }
+    sentFrames = 0;
+    droppedFrames = 0;
+    receivedFrames = 0;
+    lateFrames = 0;
+
+    const Profile old = profile;
+    profile.expectedLossPercent = static_cast<uint32_t>(std::lround(lossPercent));
+
+    const uint32_t loss = profile.expectedLossPercent;
+    if (loss >= FEC_ON_LOSS_PERCENT) {
+        profile.fec = true;
+    } else if (loss < FEC_OFF_LOSS_PERCENT) {
+        profile.fec = false;
+    }
+
+    if (loss >= SHORT_FRAME_ON_LOSS_PERCENT) {
+        profile.frameMs = SHORT_FRAME_MS;
+    } else if (loss < SHORT_FRAME_OFF_LOSS_PERCENT) {
+        profile.frameMs = LONG_FRAME_MS;
+    }
+
+    return profile.fec != old.fec || profile.frameMs != old.frameMs;
+}
+
+CallAudioResilience::Profile CallAudioResilience::getProfile() const
+{
+    QMutexLocker locker{&mutex};
+    return profile;
+}
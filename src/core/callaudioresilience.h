@@ -0,0 +1,72 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+#include <cstdint>
+
+class CallAudioResilience
+{
+public:
+    struct Profile
+    {
+        bool fec = false;
+        uint32_t expectedLossPercent = 0;
+        uint32_t frameMs = LONG_FRAME_MS;
+    };
+
+    CallAudioResilience();
+
+    void reset();
+
+    void onAudioSent(bool dropped);
+    void onAudioReceived(uint64_t lateTotal);
+
+    bool update(qint64 nowMs);
+
+    Profile getProfile() const;
+
+    static constexpr uint32_t LONG_FRAME_MS = 40;
+    static constexpr uint32_t SHORT_FRAME_MS = 20;
+    static constexpr qint64 UPDATE_INTERVAL_MS = 1000;
+    static constexpr uint32_t FEC_ON_LOSS_PERCENT = 2;
+    static constexpr uint32_t FEC_OFF_LOSS_PERCENT = 1;
+    static constexpr uint32_t SHORT_FRAME_ON_LOSS_PERCENT = 8;
+    static constexpr uint32_t SHORT_FRAME_OFF_LOSS_PERCENT = 4;
+    static constexpr uint32_t FEC_MIN_AUDIO_KBPS = 24;
+    static constexpr unsigned FEC_EXTRA_PLAYOUT_FRAMES = 1;
+
+private:
+    mutable QMutex mutex;
+
+    Profile profile;
+    // loss estimate in percent, smoothed over the intervals
+    qreal lossPercent = 0;
+    qint64 lastUpdateMs = -1;
+
+    // per interval measurements
+    uint32_t sentFrames = 0;
+    uint32_t droppedFrames = 0;
+    uint32_t receivedFrames = 0;
+    uint32_t lateFrames = 0;
+    uint64_t lastLateTotal = 0;
+};
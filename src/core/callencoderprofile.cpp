@@ -0,0 +1,112 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callencoderprofile.h"
+
+#include <algorithm>
+
+/**
+ * @class CallEncoderProfile
+ * @brief Speed and tuning of the VP8 encoder toxav runs for one call.
+ *
+ * The preset trades picture quality for encoder CPU time, it maps to libvpx's cpu-used speed
+ * setting. Screen content keeps VP8's high quality mode, so text stays readable, and relies on
+ * the preset for speed instead.
+ *
+ * @enum CallEncoderProfile::Preset
+ * @brief Encoder speed, from slowest to fastest. Stored as int in the settings.
+ */
+
+constexpr int CallEncoderProfile::PRESET_COUNT;
+
+namespace {
+// libvpx cpu-used values, higher is faster and looks worse
+const int cpuUsedForPreset[CallEncoderProfile::PRESET_COUNT] = {4, 8, 12};
+} // namespace
+
+CallEncoderProfile::CallEncoderProfile()
+    : CallEncoderProfile(Preset::Balanced, false)
+{
+}
+
+CallEncoderProfile::CallEncoderProfile(Preset preset_, bool screenContent_)
+    : preset{preset_}
+    , screenContent{screenContent_}
+{
+}
+
+/**
+ * @brief Converts a stored preset back, out of range values are clamped.
+ */
+CallEncoderProfile::Preset CallEncoderProfile::presetFromInt(int value)
+{
+    return static_cast<Preset>(std::max(0, std::min(PRESET_COUNT - 1, value)));
+}
+
+CallEncoderProfile::Preset CallEncoderProfile::getPreset() const
+{
+    return preset;
+}
+
+bool CallEncoderProfile::isScreenContent() const
+{
+    return screenContent;
+}
+
+/**
+ * @brief Value for TOXAV_ENCODER_CPU_USED.
+ */
+int CallEncoderProfile::getCpuUsed() const
+{
+    return cpuUsedForPreset[static_cast<int>(preset)];
+}
+
+/**
+ * @brief Whether to set TOXAV_ENCODER_VP8_QUALITY to high instead of normal.
+ */
+bool CallEncoderProfile::getHighQuality() const
+{
+    return screenContent;
+}
+
+/**
+ * @brief The same profile one preset faster, or this profile if it's the fastest already.
+ */
+CallEncoderProfile CallEncoderProfile::faster() const
+{
+    return {presetFromInt(static_cast<int>(preset) + 1), screenContent};
+}
+
+/**
+ * @brief The same profile one preset slower, or this profile if it's the slowest already.
+ */
+CallEncoderProfile CallEncoderProfile::slower() const
+{
+    return {presetFromInt(static_cast<int>(preset) - 1), screenContent};
+}
+
+bool CallEncoderProfile::operator==(const CallEncoderProfile& other) const
+{
+    return preset == other.preset && screenContent == other.screenContent;
+}
+
+bool CallEncoderProfile::operator!=(const CallEncoderProfile& other) const
+{
+    return !(*this == other);
+}
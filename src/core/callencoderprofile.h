@@ -0,0 +1,53 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class CallEncoderProfile
+{
+public:
+    enum class Preset
+    {
+        Quality = 0,
+        Balanced = 1,
+        Fast = 2
+    };
+
+    static constexpr int PRESET_COUNT = 3;
+
+    CallEncoderProfile();
+    CallEncoderProfile(Preset preset_, bool screenContent_);
+
+    static Preset presetFromInt(int value);
+
+    Preset getPreset() const;
+    bool isScreenContent() const;
+    int getCpuUsed() const;
+    bool getHighQuality() const;
+
+    CallEncoderProfile faster() const;
+    CallEncoderProfile slower() const;
+
+    bool operator==(const CallEncoderProfile& other) const;
+    bool operator!=(const CallEncoderProfile& other) const;
+
+private:
+    Preset preset;
+    bool screenContent;
+};
@@ -0,0 +1,303 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callratecontroller.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+/**
+ * @class CallRateController
+ * @brief Picks the audio and video bitrate of a single call at runtime.
+ *
+ * Inputs are the bitrates recommended by toxav, the bitrate the video encoder reports and how
+ * long sending frames takes. Once per UPDATE_INTERVAL_MS the rates are re-evaluated: on
+ * congestion the video bitrate is reduced multiplicatively down to VideoLimits::minKbps, and
+ * only when video is already at its floor the audio bitrate is lowered as well. After
+ * INCREASE_HOLD_INTERVALS clean intervals both rates grow again additively.
+ *
+ * Congestion means any of: toxav recommending less than we send, more than 5% of the frames of
+ * an interval failing to send, or the average send latency clearly rising above the lowest
+ * latency seen so far.
+ *
+ * A floor set with setAudioFloor() keeps the audio bitrate from going that low, e.g. to leave
+ * Opus room for in-band FEC on a lossy path.
+ *
+ * @note All methods are thread safe, toxav callbacks and the send threads feed the same object.
+ */
+
+constexpr uint32_t CallRateController::AUDIO_MIN_KBPS;
+constexpr qint64 CallRateController::UPDATE_INTERVAL_MS;
+constexpr int CallRateController::INCREASE_HOLD_INTERVALS;
+constexpr qint64 CallRateController::LATENCY_MARGIN_MS;
+
+/**
+ * @brief Video bitrate range for a configured frame rate.
+ * @param fps Video frame rate from the settings.
+ * @return Bitrate range in kbit/s.
+ */
+CallRateController::VideoLimits CallRateController::limitsForFps(int fps)
+{
+    if (fps >= 25) {
+        return {500, 4000, 11000};
+    }
+
+    return {180, 1500, 2700};
+}
+
+CallRateController::CallRateController()
+    : limits(limitsForFps(0))
+{
+    reset(0, limits);
+}
+
+/**
+ * @brief Starts over with new settings, e.g. when a call starts.
+ * @param audioKbps_ Configured audio bitrate, never exceeded.
+ * @param limits_ Video bitrate range.
+ */
+void CallRateController::reset(uint32_t audioKbps_, VideoLimits limits_)
+{
+    QMutexLocker locker{&mutex};
+
+    limits = limits_;
+    configuredAudioKbps = audioKbps_;
+    audioFloorKbps = 0;
+    audioKbps = audioKbps_;
+    videoKbps = limits.startKbps;
+    recommendedAudioKbps = 0;
+    recommendedVideoKbps = 0;
+    lastUpdateMs = -1;
+    cleanIntervals = 0;
+    encoderKbps = 0;
+    audioStats = SendStats{};
+    videoStats = SendStats{};
+}
+
+void CallRateController::onRecommendedAudioBitrate(uint32_t kbps)
+{
+    QMutexLocker locker{&mutex};
+    recommendedAudioKbps = kbps;
+}
+
+void CallRateController::onRecommendedVideoBitrate(uint32_t kbps)
+{
+    QMutexLocker locker{&mutex};
+    recommendedVideoKbps = kbps;
+}
+
+void CallRateController::onEncoderBitrate(uint32_t kbps)
+{
+    QMutexLocker locker{&mutex};
+    encoderKbps = kbps;
+}
+
+/**
+ * @brief Records an audio frame send attempt.
+ * @param latencyMs Time toxav_audio_send_frame took, including retries.
+ * @param dropped True if the frame could not be sent.
+ */
+void CallRateController::onAudioSent(qint64 latencyMs, bool dropped)
+{
+    QMutexLocker locker{&mutex};
+    ++audioStats.frames;
+    audioStats.latencySumMs += latencyMs;
+    audioStats.dropped += dropped ? 1 : 0;
+}
+
+/**
+ * @brief Records a video frame send attempt.
+ * @param latencyMs Time toxav_video_send_frame took.
+ * @param dropped True if the frame could not be sent.
+ */
+void CallRateController::onVideoSent(qint64 latencyMs, bool dropped)
+{
+    QMutexLocker locker{&mutex};
+    ++videoStats.frames;
+    videoStats.latencySumMs += latencyMs;
+    videoStats.dropped += dropped ? 1 : 0;
+}
+
+/**
+ * @brief Sets the audio bitrate the controller doesn't go below, capped to the configured one.
+ * @param kbps Lowest audio bitrate, 0 to allow going down to AUDIO_MIN_KBPS.
+ * @return True if the audio bitrate was raised and must be applied.
+ */
+bool CallRateController::setAudioFloor(uint32_t kbps)
+{
+    QMutexLocker locker{&mutex};
+    audioFloorKbps = std::min(kbps, configuredAudioKbps);
+    if (audioKbps >= minAudioKbps()) {
+        return false;
+    }
+
+    audioKbps = minAudioKbps();
+    return true;
+}
+
+/**
+ * @brief Re-evaluates the bitrates if the update interval passed.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @return True if the audio or video bitrate changed and must be applied.
+ */
+bool CallRateController::update(qint64 nowMs)
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastUpdateMs < 0) {
+        lastUpdateMs = nowMs;
+        return false;
+    }
+
+    if (nowMs - lastUpdateMs < UPDATE_INTERVAL_MS) {
+        return false;
+    }
+    lastUpdateMs = nowMs;
+
+    const uint32_t oldAudioKbps = audioKbps;
+    const uint32_t oldVideoKbps = videoKbps;
+
+    const bool recommendedLess = (recommendedVideoKbps > 0 && recommendedVideoKbps < videoKbps)
+                                 || (recommendedAudioKbps > 0 && recommendedAudioKbps < audioKbps);
+
+    if (recommendedLess) {
+        cleanIntervals = 0;
+        applyRecommendations();
+    } else if (audioStats.isCongested() || videoStats.isCongested()) {
+        cleanIntervals = 0;
+        decrease();
+    } else if (++cleanIntervals >= INCREASE_HOLD_INTERVALS) {
+        increase();
+    }
+
+    audioStats.updateBaseLatency();
+    videoStats.updateBaseLatency();
+    audioStats.clear();
+    videoStats.clear();
+    encoderKbps = 0;
+
+    return audioKbps != oldAudioKbps || videoKbps != oldVideoKbps;
+}
+
+uint32_t CallRateController::getAudioBitrate() const
+{
+    QMutexLocker locker{&mutex};
+    return audioKbps;
+}
+
+uint32_t CallRateController::getVideoBitrate() const
+{
+    QMutexLocker locker{&mutex};
+    return videoKbps;
+}
+
+CallRateController::VideoLimits CallRateController::getVideoLimits() const
+{
+    QMutexLocker locker{&mutex};
+    return limits;
+}
+
+void CallRateController::applyRecommendations()
+{
+    if (recommendedVideoKbps > 0 && recommendedVideoKbps < videoKbps) {
+        videoKbps = std::max(limits.minKbps, recommendedVideoKbps);
+    }
+
+    if (recommendedAudioKbps > 0 && recommendedAudioKbps < audioKbps) {
+        audioKbps = std::max(minAudioKbps(), recommendedAudioKbps);
+    }
+}
+
+void CallRateController::decrease()
+{
+    if (videoKbps > limits.minKbps) {
+        videoKbps = std::max(limits.minKbps, videoKbps * 85 / 100);
+        return;
+    }
+
+    // video can't go any lower, give up some audio quality
+    audioKbps = std::max(minAudioKbps(), audioKbps * 3 / 4);
+}
+
+void CallRateController::increase()
+{
+    uint32_t audioCeiling = configuredAudioKbps;
+    if (recommendedAudioKbps > 0) {
+        audioCeiling = std::min(audioCeiling, std::max(minAudioKbps(), recommendedAudioKbps));
+    }
+    if (audioKbps < audioCeiling) {
+        audioKbps = std::min(audioCeiling, audioKbps + 4);
+        // recover audio first, it is cheap and matters most
+        return;
+    }
+
+    uint32_t videoCeiling = limits.maxKbps;
+    if (recommendedVideoKbps > 0) {
+        videoCeiling = std::min(videoCeiling, std::max(limits.minKbps, recommendedVideoKbps));
+    }
+    if (encoderKbps > 0) {
+        // the encoder doesn't even use what we give it, probing higher tells us nothing
+        videoCeiling = std::min(videoCeiling, std::max(limits.minKbps, encoderKbps * 3 / 2));
+    }
+    if (videoKbps < videoCeiling) {
+        videoKbps = std::min(videoCeiling, videoKbps + std::max<uint32_t>(50, videoKbps / 20));
+    }
+}
+
+uint32_t CallRateController::minAudioKbps() const
+{
+    return std::max(AUDIO_MIN_KBPS, audioFloorKbps);
+}
+
+bool CallRateController::SendStats::isCongested() const
+{
+    if (frames == 0) {
+        return false;
+    }
+
+    if (dropped * 20 > frames) {
+        return true;
+    }
+
+    const qint64 averageMs = latencySumMs / frames;
+    return baseLatencyMs >= 0 && averageMs > 2 * baseLatencyMs + LATENCY_MARGIN_MS;
+}
+
+void CallRateController::SendStats::updateBaseLatency()
+{
+    if (frames == 0) {
+        return;
+    }
+
+    const qint64 averageMs = latencySumMs / frames;
+    if (baseLatencyMs < 0 || averageMs < baseLatencyMs) {
+        baseLatencyMs = averageMs;
+    } else {
+        // follow slowly, e.g. after the resolution changed
+        baseLatencyMs += (averageMs - baseLatencyMs) / 16;
+    }
+}
+
+void CallRateController::SendStats::clear()
+{
+    frames = 0;
+    dropped = 0;
+    latencySumMs = 0;
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+#include <cstdint>
+
+class CallRateController
+{
+public:
+    struct VideoLimits
+    {
+        uint32_t minKbps;
+        uint32_t startKbps;
+        uint32_t maxKbps;
+    };
+
+    static VideoLimits limitsForFps(int fps);
+
+    CallRateController();
+
+    void reset(uint32_t audioKbps, VideoLimits limits);
+
+    void onRecommendedAudioBitrate(uint32_t kbps);
+    void onRecommendedVideoBitrate(uint32_t kbps);
+    void onEncoderBitrate(uint32_t kbps);
+    void onAudioSent(qint64 latencyMs, bool dropped);
+    void onVideoSent(qint64 latencyMs, bool dropped);
+    bool setAudioFloor(uint32_t kbps);
+
+    bool update(qint64 nowMs);
+
+    uint32_t getAudioBitrate() const;
+    uint32_t getVideoBitrate() const;
+    VideoLimits getVideoLimits() const;
+
+    static constexpr uint32_t AUDIO_MIN_KBPS = 8;
+    static constexpr qint64 UPDATE_INTERVAL_MS = 1000;
+    static constexpr int INCREASE_HOLD_INTERVALS = 3;
+    static constexpr qint64 LATENCY_MARGIN_MS = 10;
+
+private:
+    struct SendStats
+    {
+        int frames = 0;
+        int dropped = 0;
+        qint64 latencySumMs = 0;
+        qint64 baseLatencyMs = -1;
+
+        bool isCongested() const;
+        void updateBaseLatency();
+        void clear();
+    };
+
+    void applyRecommendations();
+    void decrease();
+    void increase();
+    uint32_t minAudioKbps() const;
+
+private:
+    mutable QMutex mutex;
+
+    VideoLimits limits;
+    uint32_t configuredAudioKbps = 0;
+    uint32_t audioFloorKbps = 0;
+    uint32_t audioKbps = 0;
+    uint32_t videoKbps = 0;
+    uint32_t recommendedAudioKbps = 0;
+    uint32_t recommendedVideoKbps = 0;
+
+    qint64 lastUpdateMs = -1;
+    int cleanIntervals = 0;
+
+    // per interval measurements
+    uint32_t encoderKbps = 0;
+    SendStats audioStats;
+    SendStats videoStats;
+};
@@ -0,0 +1,131 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callstats.h"
+
+#include <algorithm>
+
+/**
+ * @class CallStats
+ * @brief Counters of a friend call for the call statistics overlay.
+ *
+ * The send and receive threads only bump relaxed atomics, so keeping the counters costs next to
+ * nothing while nobody looks at them. takeSnapshot() turns the counts since the previous
+ * snapshot into rates and must only be called from one thread.
+ */
+
+/**
+ * @brief Records a video frame handed to toxav.
+ * @param width Width of the sent frame.
+ * @param height Height of the sent frame.
+ * @param processNs Time spent converting and encoding the frame.
+ * @param dropped True if toxav refused the frame.
+ */
+void CallStats::onVideoSent(int width, int height, qint64 processNs_, bool dropped)
+{
+    if (dropped) {
+        videoDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    sentFrames.fetch_add(1, std::memory_order_relaxed);
+    sentSize.store(packSize(width, height), std::memory_order_relaxed);
+    processNs.fetch_add(static_cast<uint64_t>(std::max<qint64>(processNs_, 0)),
+                        std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records a video frame decoded by toxav.
+ * @param width Width of the received frame.
+ * @param height Height of the received frame.
+ */
+void CallStats::onVideoReceived(int width, int height)
+{
+    receivedFrames.fetch_add(1, std::memory_order_relaxed);
+    receivedSize.store(packSize(width, height), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records an audio frame handed to toxav.
+ * @param dropped True if toxav refused the frame.
+ */
+void CallStats::onAudioSent(bool dropped)
+{
+    audioFrames.fetch_add(1, std::memory_order_relaxed);
+    if (dropped) {
+        audioDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Records the bitrate the video encoder currently runs at.
+ * @param kbps Bitrate reported by toxav.
+ */
+void CallStats::onEncoderBitrate(uint32_t kbps)
+{
+    encoderKbps.store(kbps, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the statistics since the previous snapshot and starts a new interval.
+ * @param nowMs Monotonic time in milliseconds.
+ * @return Rates are zero for the first snapshot, targetKbps and audioQueueMs are left to the
+ *         caller.
+ */
+CallStats::Snapshot CallStats::takeSnapshot(qint64 nowMs)
+{
+    const uint32_t sent = sentFrames.exchange(0, std::memory_order_relaxed);
+    const uint64_t process = processNs.exchange(0, std::memory_order_relaxed);
+    const uint32_t received = receivedFrames.exchange(0, std::memory_order_relaxed);
+    const uint32_t audio = audioFrames.exchange(0, std::memory_order_relaxed);
+    const uint32_t droppedAudio = audioDropped.exchange(0, std::memory_order_relaxed);
+    const uint32_t droppedVideo = videoDropped.exchange(0, std::memory_order_relaxed);
+
+    Snapshot snapshot;
+    snapshot.sentSize = unpackSize(sentSize.load(std::memory_order_relaxed));
+    snapshot.receivedSize = unpackSize(receivedSize.load(std::memory_order_relaxed));
+    snapshot.encoderKbps = encoderKbps.load(std::memory_order_relaxed);
+    if (sent > 0) {
+        snapshot.processMs = process / 1000000.0 / sent;
+    }
+
+    const uint32_t attempts = sent + droppedVideo + audio;
+    if (attempts > 0) {
+        snapshot.sendLoss = static_cast<qreal>(droppedAudio + droppedVideo) / attempts;
+    }
+
+    const qint64 intervalMs = nowMs - lastSnapshotMs;
+    if (lastSnapshotMs >= 0 && intervalMs > 0) {
+        snapshot.sentFps = sent * 1000.0 / intervalMs;
+        snapshot.receivedFps = received * 1000.0 / intervalMs;
+    }
+
+    lastSnapshotMs = nowMs;
+    return snapshot;
+}
+
+uint32_t CallStats::packSize(int width, int height)
+{
+    return (static_cast<uint32_t>(width & 0xFFFF) << 16) | static_cast<uint32_t>(height & 0xFFFF);
+}
+
+QSize CallStats::unpackSize(uint32_t size)
+{
+    return QSize(static_cast<int>(size >> 16), static_cast<int>(size & 0xFFFF));
+}
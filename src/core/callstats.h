@@ -0,0 +1,68 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QSize>
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstdint>
+
+class CallStats
+{
+public:
+    struct Snapshot
+    {
+        qreal sentFps = 0;
+        QSize sentSize;
+        qreal processMs = 0;
+        qreal receivedFps = 0;
+        QSize receivedSize;
+        uint32_t encoderKbps = 0;
+        uint32_t targetKbps = 0;
+        qreal audioQueueMs = 0;
+        qreal sendLoss = 0;
+    };
+
+    void onVideoSent(int width, int height, qint64 processNs, bool dropped);
+    void onVideoReceived(int width, int height);
+    void onAudioSent(bool dropped);
+    void onEncoderBitrate(uint32_t kbps);
+
+    Snapshot takeSnapshot(qint64 nowMs);
+
+private:
+    static uint32_t packSize(int width, int height);
+    static QSize unpackSize(uint32_t size);
+
+private:
+    std::atomic<uint32_t> sentFrames{0};
+    std::atomic<uint32_t> sentSize{0};
+    std::atomic<uint64_t> processNs{0};
+    std::atomic<uint32_t> receivedFrames{0};
+    std::atomic<uint32_t> receivedSize{0};
+    std::atomic<uint32_t> audioFrames{0};
+    std::atomic<uint32_t> audioDropped{0};
+    std::atomic<uint32_t> videoDropped{0};
+    std::atomic<uint32_t> encoderKbps{0};
+
+    // only touched by the reader
+    qint64 lastSnapshotMs = -1;
+};
@@ -0,0 +1,262 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "callvideoladder.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+/**
+ * @class CallVideoLadder
+ * @brief Picks the resolution and frame rate we send in a single call.
+ *
+ * The ladder goes from 1080p at 30 fps down to 360p at 15 fps. The send thread reports how
+ * long converting and encoding each frame took, which is our measure of CPU load: a machine
+ * that can't keep up spends most of the frame interval in the encoder. Together with the video
+ * bitrate picked by CallRateController this moves the call one rung at a time.
+ *
+ * To avoid flapping, stepping down needs DOWN_HOLD_MS since the last change and stepping up
+ * needs UP_HOLD_MS, the bitrate of the next rung with some headroom, and a predicted encode
+ * time for the bigger frames well below the point where we would step down again.
+ *
+ * CpuGovernor can cap the size and frame rate on top of that, see setCpuCap().
+ *
+ * @note All methods are thread safe, but frames are only reported by the video send thread.
+ */
+
+constexpr int CallVideoLadder::RUNG_COUNT;
+constexpr int CallVideoLadder::MIN_SAMPLES;
+constexpr qint64 CallVideoLadder::DOWN_HOLD_MS;
+constexpr qint64 CallVideoLadder::UP_HOLD_MS;
+
+namespace {
+const CallVideoLadder::Rung rungs[CallVideoLadder::RUNG_COUNT] = {
+    {1920, 1080, 30, 2500},
+    {1280, 720, 30, 1200},
+    {960, 540, 30, 600},
+    {640, 360, 15, 0},
+};
+
+// fraction of the frame interval processing may take before we step down
+constexpr double OVERLOAD_RATIO = 0.8;
+// fraction of the frame interval the next rung may be predicted to take to step up
+constexpr double HEADROOM_RATIO = 0.6;
+
+double smooth(double average, double sample)
+{
+    if (average <= 0.0) {
+        return sample;
+    }
+    return average + (sample - average) / 8.0;
+}
+} // namespace
+
+CallVideoLadder::CallVideoLadder()
+{
+    reset();
+}
+
+/**
+ * @brief Starts over at the top rung, e.g. when a call starts.
+ */
+void CallVideoLadder::reset()
+{
+    QMutexLocker locker{&mutex};
+
+    rungIndex = 0;
+    lastChangeMs = -1;
+    lastSentMs = -1;
+    samples = 0;
+    avgProcessMs = 0.0;
+    avgIntervalMs = 0.0;
+}
+
+/**
+ * @brief Limits what we send while the machine as a whole is short on CPU.
+ *
+ * The cap is kept by reset() and doesn't move the ladder itself, so the rung picked from the
+ * call's own load is back as soon as the cap is lifted.
+ * @param rungIndex Biggest rung to send, 0 for no cap.
+ * @param fps Highest frame rate to send, 0 for no cap.
+ */
+void CallVideoLadder::setCpuCap(int rungIndex, int fps)
+{
+    QMutexLocker locker{&mutex};
+
+    capRungIndex = std::max(0, std::min(RUNG_COUNT - 1, rungIndex));
+    capFps = std::max(0, fps);
+}
+
+/**
+ * @brief Checks the frame rate cap of the current rung.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @return False if the frame should be skipped.
+ */
+bool CallVideoLadder::shouldSend(qint64 nowMs) const
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastSentMs < 0) {
+        return true;
+    }
+
+    // allow some jitter, otherwise a source at exactly the cap loses frames
+    int fps = rungs[sendRungIndex()].fps;
+    if (capFps > 0) {
+        fps = std::min(fps, capFps);
+    }
+    const qint64 minIntervalMs = 750 / fps;
+    return nowMs - lastSentMs >= minIntervalMs;
+}
+
+/**
+ * @brief Records a sent video frame.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @param processMs Time converting and sending the frame took.
+ */
+void CallVideoLadder::onFrameSent(qint64 nowMs, qint64 processMs)
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastChangeMs < 0) {
+        lastChangeMs = nowMs;
+    }
+    if (lastSentMs >= 0) {
+        avgIntervalMs = smooth(avgIntervalMs, static_cast<double>(nowMs - lastSentMs));
+    }
+    lastSentMs = nowMs;
+
+    avgProcessMs = smooth(avgProcessMs, static_cast<double>(processMs));
+    ++samples;
+}
+
+/**
+ * @brief Moves one rung up or down if needed.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @param videoKbps Current video bitrate of the call.
+ * @return True if the rung changed.
+ */
+bool CallVideoLadder::update(qint64 nowMs, uint32_t videoKbps)
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastChangeMs < 0 || samples < MIN_SAMPLES) {
+        return false;
+    }
+
+    const qint64 heldMs = nowMs - lastChangeMs;
+    const Rung& rung = rungs[rungIndex];
+    const bool overloaded = avgProcessMs > OVERLOAD_RATIO * budgetMs();
+    const bool starved = videoKbps < rung.minKbps;
+
+    if (overloaded || starved) {
+        if (rungIndex < RUNG_COUNT - 1 && heldMs >= DOWN_HOLD_MS) {
+            switchTo(rungIndex + 1, nowMs);
+            return true;
+        }
+        return false;
+    }
+
+    if (rungIndex == 0 || heldMs < UP_HOLD_MS) {
+        return false;
+    }
+
+    const Rung& next = rungs[rungIndex - 1];
+    if (videoKbps < next.minKbps * 5 / 4) {
+        return false;
+    }
+
+    const double cost = static_cast<double>(next.width) * next.height * next.fps
+                        / (static_cast<double>(rung.width) * rung.height * rung.fps);
+    // a source slower than the cap stays slower after the switch
+    const double nextBudgetMs =
+        std::max(1000.0 / next.fps, avgIntervalMs * rung.fps / next.fps);
+    if (avgProcessMs * cost >= HEADROOM_RATIO * nextBudgetMs) {
+        return false;
+    }
+
+    switchTo(rungIndex - 1, nowMs);
+    return true;
+}
+
+/**
+ * @brief Fits a source frame into the current rung, keeping its aspect ratio.
+ * @param source Size of the captured frame.
+ * @return Size to encode, never bigger than the source.
+ */
+QSize CallVideoLadder::scaledSize(QSize source) const
+{
+    QMutexLocker locker{&mutex};
+
+    const Rung& rung = rungs[sendRungIndex()];
+    int maxWidth = rung.width;
+    int maxHeight = rung.height;
+    if (source.height() > source.width()) {
+        // portrait camera, limit the long edge all the same
+        std::swap(maxWidth, maxHeight);
+    }
+
+    if (source.width() <= maxWidth && source.height() <= maxHeight) {
+        return source;
+    }
+
+    const double scale = std::min(static_cast<double>(maxWidth) / source.width(),
+                                  static_cast<double>(maxHeight) / source.height());
+    // VP8 wants even dimensions for the chroma planes
+    const int width = std::max(2, static_cast<int>(source.width() * scale) & ~1);
+    const int height = std::max(2, static_cast<int>(source.height() * scale) & ~1);
+    return QSize(width, height);
+}
+
+int CallVideoLadder::getRungIndex() const
+{
+    QMutexLocker locker{&mutex};
+    return rungIndex;
+}
+
+CallVideoLadder::Rung CallVideoLadder::getRung() const
+{
+    QMutexLocker locker{&mutex};
+    return rungs[rungIndex];
+}
+
+const CallVideoLadder::Rung& CallVideoLadder::rungAt(int index)
+{
+    return rungs[std::max(0, std::min(RUNG_COUNT - 1, index))];
+}
+
+double CallVideoLadder::budgetMs() const
+{
+    return std::max(1000.0 / rungs[rungIndex].fps, avgIntervalMs);
+}
+
+int CallVideoLadder::sendRungIndex() const
+{
+    return std::max(rungIndex, capRungIndex);
+}
+
+void CallVideoLadder::switchTo(int index, qint64 nowMs)
+{
+    rungIndex = index;
+    lastChangeMs = nowMs;
+    samples = 0;
+    avgProcessMs = 0.0;
+    avgIntervalMs = 0.0;
+}
@@ -0,0 +1,75 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QSize>
+#include <QtGlobal>
+
+#include <cstdint>
+
+class CallVideoLadder
+{
+public:
+    struct Rung
+    {
+        int width;
+        int height;
+        int fps;
+        uint32_t minKbps;
+    };
+
+    CallVideoLadder();
+
+    void reset();
+    void setCpuCap(int rungIndex, int fps);
+
+    bool shouldSend(qint64 nowMs) const;
+    void onFrameSent(qint64 nowMs, qint64 processMs);
+    bool update(qint64 nowMs, uint32_t videoKbps);
+
+    QSize scaledSize(QSize source) const;
+    int getRungIndex() const;
+    Rung getRung() const;
+
+    static const Rung& rungAt(int index);
+
+    static constexpr int RUNG_COUNT = 4;
+    static constexpr int MIN_SAMPLES = 15;
+    static constexpr qint64 DOWN_HOLD_MS = 2000;
+    static constexpr qint64 UP_HOLD_MS = 10000;
+
+private:
+    double budgetMs() const;
+    int sendRungIndex() const;
+    void switchTo(int index, qint64 nowMs);
+
+private:
+    mutable QMutex mutex;
+
+    int rungIndex = 0;
+    qint64 lastChangeMs = -1;
+    qint64 lastSentMs = -1;
+    int samples = 0;
+    double avgProcessMs = 0.0;
+    double avgIntervalMs = 0.0;
+    int capRungIndex = 0;
+    int capFps = 0;
+};
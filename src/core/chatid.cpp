@@ -21,13 +21,26 @@
 #include <QString>
 #include <cstdint>
 #include <QHash>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include "src/core/chatid.h"
 
+/**
+ * @class ChatId
+ * @brief Base of the fixed size Tox keys, stored inline so copying, comparing and hashing them
+ * never allocates. QByteArray is only used when converting at API boundaries.
+ *
+ * @var ChatId::maxSize
+ * @brief Size of the largest key, both ToxPk and GroupId are 32 bytes.
+ */
+
+constexpr int ChatId::maxSize;
+
 /**
  * @brief The default constructor. Creates an empty id.
  */
 ChatId::ChatId()
-    : id()
 {
 }
 ChatId::~ChatId() = default;
@@ -37,8 +50,20 @@ ChatId::~ChatId() = default;
  * @param rawId The bytes to construct the ChatId from.
  */
 ChatId::ChatId(const QByteArray& rawId)
+    : ChatId(reinterpret_cast<const uint8_t*>(rawId.constData()), rawId.size())
 {
-    id = QByteArray(rawId);
+}
+
+/**
+ * @brief Constructs a ChatId from bytes.
+ * @param rawId The bytes to construct the ChatId from.
+ * @param size Number of bytes to read, at most ChatId::maxSize.
+ */
+ChatId::ChatId(const uint8_t* rawId, int size)
+{
+    assert(size >= 0 && size <= maxSize);
+    idSize = static_cast<uint8_t>(std::min(std::max(size, 0), maxSize));
+    std::copy(rawId, rawId + idSize, id.begin());
 }
 
 /**
@@ -48,7 +73,7 @@ ChatId::ChatId(const QByteArray& rawId)
  */
 bool ChatId::operator==(const ChatId& other) const
 {
-    return id == other.id;
+    return idSize == other.idSize && std::memcmp(id.data(), other.id.data(), idSize) == 0;
 }
 
 /**
@@ -58,7 +83,7 @@ bool ChatId::operator==(const ChatId& other) const
  */
 bool ChatId::operator!=(const ChatId& other) const
 {
-    return id != other.id;
+    return !(*this == other);
 }
 
 /**
@@ -68,7 +93,8 @@ bool ChatId::operator!=(const ChatId& other) const
  */
 bool ChatId::operator<(const ChatId& other) const
 {
-    return id < other.id;
+    return std::lexicographical_compare(id.begin(), id.begin() + idSize, other.id.begin(),
+                                        other.id.begin() + other.idSize);
 }
 
 /**
@@ -77,7 +103,15 @@ bool ChatId::operator<(const ChatId& other) const
  */
 QString ChatId::toString() const
 {
-    return QString::fromUtf8(id.toHex()).toUpper();
+    static const char hexDigits[] = "0123456789ABCDEF";
+    QString hex(idSize * 2, Qt::Uninitialized);
+    QChar* out = hex.data();
+    for (int i = 0; i < idSize; ++i) {
+        *out++ = QLatin1Char(hexDigits[id[i] >> 4]);
+        *out++ = QLatin1Char(hexDigits[id[i] & 0xF]);
+    }
+
+    return hex;
 }
 
 /**
@@ -87,11 +121,11 @@ QString ChatId::toString() const
  */
 const uint8_t* ChatId::getData() const
 {
-    if (id.isEmpty()) {
+    if (idSize == 0) {
         return nullptr;
     }
 
-    return reinterpret_cast<const uint8_t*>(id.constData());
+    return id.data();
 }
 
 /**
@@ -100,7 +134,7 @@ const uint8_t* ChatId::getData() const
  */
 QByteArray ChatId::getByteArray() const
 {
-    return QByteArray(id); // TODO: Is a copy really necessary?
+    return QByteArray(reinterpret_cast<const char*>(id.data()), idSize);
 }
 
 /**
@@ -109,5 +143,5 @@ QByteArray ChatId::getByteArray() const
  */
 bool ChatId::isEmpty() const
 {
-    return id.isEmpty();
+    return idSize == 0;
 }
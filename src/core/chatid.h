@@ -23,11 +23,14 @@
 #include <QString>
 #include <cstdint>
 #include <QHash>
+#include <array>
 #include <memory>
 
 class ChatId
 {
 public:
+    static constexpr int maxSize = 32;
+
     virtual ~ChatId();
     ChatId(const ChatId&) = default;
     ChatId& operator=(const ChatId&) = default;
@@ -43,15 +46,17 @@ public:
     virtual int getSize() const = 0;
     virtual std::unique_ptr<ChatId> clone() const = 0;
 
+    friend uint qHash(const ChatId& id, uint seed = 0)
+    {
+        return qHashBits(id.id.data(), id.idSize, seed);
+    }
+
 protected:
     ChatId();
     explicit ChatId(const QByteArray& rawId);
-    QByteArray id;
+    ChatId(const uint8_t* rawId, int size);
+    std::array<uint8_t, maxSize> id{};
+    uint8_t idSize = 0;
 };
 
-inline uint qHash(const ChatId& id)
-{
-    return qHash(id.getByteArray());
-}
-
 using ChatIdPtr = std::shared_ptr<const ChatId>;
@@ -0,0 +1,331 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "connectionpathstats.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @class ConnectionPathStats
+ * @brief Tracks per friend whether we talk directly with UDP or through a TCP relay.
+ *
+ * Core reports every connection status change of a friend with setPath(). For each friend we
+ * count how often the path flipped between UDP and a TCP relay, how often UDP fell back to a
+ * relay, how often the friend went offline, and how long each path was in use. When a proxy is
+ * configured all traffic goes through it, so a relayed path is marked as proxied.
+ *
+ * toxcore doesn't expose the round trip time to friends, so it is measured from the time
+ * between sending a message and receiving its read receipt. For a friend that doesn't read
+ * receipts or that we never message, no round trip time is known.
+ *
+ * Every instance is listed by report(), like LoopStats. The "connections" section of the
+ * diagnostics report holds the same numbers without the friend names.
+ *
+ * @note Thread safe, Core updates it from its thread and the GUI reads it.
+ */
+
+constexpr int ConnectionPathStats::MAX_PENDING_RECEIPTS;
+constexpr qint64 ConnectionPathStats::MAX_RTT_SAMPLE_MS;
+
+namespace {
+QMutex& registryLock()
+{
+    static QMutex lock;
+    return lock;
+}
+
+std::vector<const ConnectionPathStats*>& registry()
+{
+    static std::vector<const ConnectionPathStats*> instances;
+    return instances;
+}
+
+int pathIndex(ConnectionPathStats::Path path)
+{
+    return static_cast<int>(path);
+}
+} // namespace
+
+ConnectionPathStats::ConnectionPathStats()
+    : diagnostics{"connections",
+                  [this] { return toJson(QDateTime::currentMSecsSinceEpoch()); }}
+{
+    QMutexLocker locker{&registryLock()};
+    registry().push_back(this);
+}
+
+ConnectionPathStats::~ConnectionPathStats()
+{
+    QMutexLocker locker{&registryLock()};
+    auto& instances = registry();
+    instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+/**
+ * @brief Records a connection status change of a friend.
+ * @param friendId Friend number.
+ * @param name Shown in the report.
+ * @param path The new path.
+ * @param proxied True if a proxy is configured.
+ * @param nowMs Current time in milliseconds.
+ */
+void ConnectionPathStats::setPath(uint32_t friendId, const QString& name, Path path, bool proxied,
+                                  qint64 nowMs)
+{
+    QMutexLocker locker{&lock};
+    const bool known = friends.contains(friendId);
+    FriendStats& stats = friends[friendId];
+    stats.name = name;
+    if (!known) {
+        stats.sinceMs = nowMs;
+    }
+
+    if (stats.path == path) {
+        stats.proxied = proxied;
+        return;
+    }
+
+    stats.totalMs[pathIndex(stats.path)] += std::max(qint64{0}, nowMs - stats.sinceMs);
+    if (path == Path::Offline) {
+        ++stats.disconnects;
+        // receipts of messages sent before won't arrive anymore
+        stats.pending.clear();
+    } else if (stats.path != Path::Offline) {
+        ++stats.flips;
+        if (path == Path::TcpRelay) {
+            ++stats.fallbacks;
+        }
+    }
+
+    stats.path = path;
+    stats.proxied = proxied;
+    stats.sinceMs = nowMs;
+}
+
+/**
+ * @brief Remembers when a message was sent, to measure the round trip time when its receipt
+ * arrives.
+ */
+void ConnectionPathStats::messageSent(uint32_t friendId, uint32_t receipt, qint64 nowMs)
+{
+    QMutexLocker locker{&lock};
+    auto it = friends.find(friendId);
+    if (it == friends.end() || it->path == Path::Offline) {
+        return;
+    }
+
+    if (it->pending.size() >= MAX_PENDING_RECEIPTS) {
+        it->pending.removeFirst();
+    }
+    it->pending.append({receipt, nowMs});
+}
+
+void ConnectionPathStats::receiptReceived(uint32_t friendId, uint32_t receipt, qint64 nowMs)
+{
+    QMutexLocker locker{&lock};
+    auto it = friends.find(friendId);
+    if (it == friends.end()) {
+        return;
+    }
+
+    QVector<QPair<uint32_t, qint64>>& pending = it->pending;
+    const auto sent = std::find_if(pending.begin(), pending.end(),
+                                   [receipt](const QPair<uint32_t, qint64>& entry) {
+                                       return entry.first == receipt;
+                                   });
+    if (sent == pending.end()) {
+        return;
+    }
+
+    const qint64 sampleMs = nowMs - sent->second;
+    pending.erase(sent);
+    // a receipt that took this long waited for the friend, not for the network
+    if (sampleMs < 0 || sampleMs > MAX_RTT_SAMPLE_MS) {
+        return;
+    }
+
+    it->rttMs = it->rttMs < 0 ? sampleMs : (7 * it->rttMs + sampleMs) / 8;
+    ++it->rttSamples;
+}
+
+void ConnectionPathStats::removeFriend(uint32_t friendId)
+{
+    QMutexLocker locker{&lock};
+    friends.remove(friendId);
+}
+
+/**
+ * @brief Current state of a friend, an offline friend without history if we know nothing.
+ */
+ConnectionPathStats::Snapshot ConnectionPathStats::getSnapshot(uint32_t friendId,
+                                                               qint64 nowMs) const
+{
+    QMutexLocker locker{&lock};
+    const auto it = friends.constFind(friendId);
+    return it == friends.constEnd() ? Snapshot{} : makeSnapshot(*it, nowMs);
+}
+
+/**
+ * @brief One line per friend that was online at least once, the friends on a relay first.
+ */
+QString ConnectionPathStats::toString(qint64 nowMs) const
+{
+    const std::vector<Snapshot> snapshots = getSeenFriends(nowMs);
+
+    QStringList lines;
+    for (const Snapshot& s : snapshots) {
+        const QString rtt =
+            s.rttMs < 0 ? QStringLiteral("unknown") : QStringLiteral("%1 ms").arg(s.rttMs);
+        lines << s.name + QStringLiteral(": ")
+                     + QStringLiteral("%1 for %2, UDP %3, TCP relay %4, offline %5, %6 flips, "
+                                      "%7 UDP fallbacks, %8 disconnects, RTT %9")
+                           .arg(pathName(s.path, s.proxied), formatDuration(s.currentMs),
+                                formatDuration(s.totalMs[pathIndex(Path::Udp)]),
+                                formatDuration(s.totalMs[pathIndex(Path::TcpRelay)]),
+                                formatDuration(s.totalMs[pathIndex(Path::Offline)]),
+                                QString::number(s.flips), QString::number(s.fallbacks),
+                                QString::number(s.disconnects), rtt);
+    }
+
+    return lines.join(QLatin1Char('\n'));
+}
+
+/**
+ * @brief Connection paths for the diagnostics report, without the friend names.
+ * @param nowMs Current time in ms since the epoch.
+ */
+QJsonObject ConnectionPathStats::toJson(qint64 nowMs) const
+{
+    std::array<int, 3> onPath{};
+    QJsonArray friendStats;
+    for (const Snapshot& s : getSeenFriends(nowMs)) {
+        ++onPath[pathIndex(s.path)];
+        friendStats.append(QJsonObject{
+            {"path", pathName(s.path, s.proxied)},
+            {"currentMs", s.currentMs},
+            {"udpMs", s.totalMs[pathIndex(Path::Udp)]},
+            {"tcpRelayMs", s.totalMs[pathIndex(Path::TcpRelay)]},
+            {"offlineMs", s.totalMs[pathIndex(Path::Offline)]},
+            {"flips", static_cast<qint64>(s.flips)},
+            {"fallbacks", static_cast<qint64>(s.fallbacks)},
+            {"disconnects", static_cast<qint64>(s.disconnects)},
+            {"rttMs", s.rttMs},
+            {"rttSamples", static_cast<qint64>(s.rttSamples)}});
+    }
+
+    return QJsonObject{{"udp", onPath[pathIndex(Path::Udp)]},
+                       {"tcpRelay", onPath[pathIndex(Path::TcpRelay)]},
+                       {"offline", onPath[pathIndex(Path::Offline)]},
+                       {"friends", friendStats}};
+}
+
+/**
+ * @brief Connection paths of all friends, for the debug log and the advanced settings.
+ * @return One block per instance, empty if there is none.
+ */
+QString ConnectionPathStats::report()
+{
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    QMutexLocker locker{&registryLock()};
+    QStringList report;
+    for (const ConnectionPathStats* stats : registry()) {
+        const QString friends = stats->toString(nowMs);
+        report << (friends.isEmpty() ? QStringLiteral("No friend was online yet") : friends);
+    }
+
+    return report.join(QStringLiteral("\n\n"));
+}
+
+/**
+ * @brief Untranslated name of a path, for logs and reports.
+ */
+QString ConnectionPathStats::pathName(Path path, bool proxied)
+{
+    switch (path) {
+    case Path::Offline:
+        return QStringLiteral("offline");
+    case Path::TcpRelay:
+        return proxied ? QStringLiteral("TCP relay via proxy") : QStringLiteral("TCP relay");
+    case Path::Udp:
+        return QStringLiteral("direct UDP");
+    }
+
+    return {};
+}
+
+ConnectionPathStats::Snapshot ConnectionPathStats::makeSnapshot(const FriendStats& stats,
+                                                                qint64 nowMs)
+{
+    Snapshot snapshot;
+    snapshot.name = stats.name;
+    snapshot.path = stats.path;
+    snapshot.proxied = stats.proxied;
+    snapshot.currentMs = std::max(qint64{0}, nowMs - stats.sinceMs);
+    snapshot.totalMs = stats.totalMs;
+    snapshot.totalMs[pathIndex(stats.path)] += snapshot.currentMs;
+    snapshot.flips = stats.flips;
+    snapshot.fallbacks = stats.fallbacks;
+    snapshot.disconnects = stats.disconnects;
+    snapshot.rttMs = stats.rttMs;
+    snapshot.rttSamples = stats.rttSamples;
+    return snapshot;
+}
+
+/**
+ * @brief Friends that were online at some point, relayed ones first, then by name.
+ */
+std::vector<ConnectionPathStats::Snapshot> ConnectionPathStats::getSeenFriends(qint64 nowMs) const
+{
+    std::vector<Snapshot> snapshots;
+    {
+        QMutexLocker locker{&lock};
+        snapshots.reserve(static_cast<size_t>(friends.size()));
+        for (const FriendStats& stats : friends) {
+            if (stats.path != Path::Offline || stats.disconnects > 0) {
+                snapshots.push_back(makeSnapshot(stats, nowMs));
+            }
+        }
+    }
+
+    std::sort(snapshots.begin(), snapshots.end(), [](const Snapshot& a, const Snapshot& b) {
+        if (a.path != b.path) {
+            return a.path == Path::TcpRelay || (a.path == Path::Udp && b.path == Path::Offline);
+        }
+        return a.name < b.name;
+    });
+    return snapshots;
+}
+
+QString ConnectionPathStats::formatDuration(qint64 ms)
+{
+    const qint64 secs = ms / 1000;
+    if (secs < 60) {
+        return QStringLiteral("%1s").arg(secs);
+    }
+    if (secs < 60 * 60) {
+        return QStringLiteral("%1m %2s").arg(secs / 60).arg(secs % 60);
+    }
+    return QStringLiteral("%1h %2m").arg(secs / 3600).arg((secs / 60) % 60);
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "util/diagnosticsregistry.h"
+
+#include <QHash>
+#include <QJsonObject>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class ConnectionPathStats
+{
+public:
+    enum class Path
+    {
+        Offline,
+        TcpRelay,
+        Udp
+    };
+
+    struct Snapshot
+    {
+        QString name;
+        Path path = Path::Offline;
+        bool proxied = false;
+        qint64 currentMs = 0;
+        // indexed by Path, including the time in the current path
+        std::array<qint64, 3> totalMs{};
+        uint32_t flips = 0;
+        uint32_t fallbacks = 0;
+        uint32_t disconnects = 0;
+        qint64 rttMs = -1;
+        uint32_t rttSamples = 0;
+    };
+
+    ConnectionPathStats();
+    ~ConnectionPathStats();
+
+    ConnectionPathStats(const ConnectionPathStats&) = delete;
+    ConnectionPathStats& operator=(const ConnectionPathStats&) = delete;
+
+    void setPath(uint32_t friendId, const QString& name, Path path, bool proxied, qint64 nowMs);
+    void messageSent(uint32_t friendId, uint32_t receipt, qint64 nowMs);
+    void receiptReceived(uint32_t friendId, uint32_t receipt, qint64 nowMs);
+    void removeFriend(uint32_t friendId);
+
+    Snapshot getSnapshot(uint32_t friendId, qint64 nowMs) const;
+    QString toString(qint64 nowMs) const;
+    QJsonObject toJson(qint64 nowMs) const;
+    static QString report();
+    static QString pathName(Path path, bool proxied);
+
+    static constexpr int MAX_PENDING_RECEIPTS = 16;
+    static constexpr qint64 MAX_RTT_SAMPLE_MS = 30 * 1000;
+
+private:
+    struct FriendStats
+    {
+        QString name;
+        Path path = Path::Offline;
+        bool proxied = false;
+        qint64 sinceMs = 0;
+        std::array<qint64, 3> totalMs{};
+        uint32_t flips = 0;
+        uint32_t fallbacks = 0;
+        uint32_t disconnects = 0;
+        qint64 rttMs = -1;
+        uint32_t rttSamples = 0;
+        // receipt, time sent
+        QVector<QPair<uint32_t, qint64>> pending;
+    };
+
+    static Snapshot makeSnapshot(const FriendStats& stats, qint64 nowMs);
+    std::vector<Snapshot> getSeenFriends(qint64 nowMs) const;
+    static QString formatDuration(qint64 ms);
+
+private:
+    mutable QMutex lock;
+    QHash<uint32_t, FriendStats> friends;
+    // last, so it unregisters before the stats it reads are destroyed
+    DiagnosticsSource diagnostics;
+};
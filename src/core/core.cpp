@@ -22,9 +22,13 @@
 #include "coreav.h"
 #include "corefile.h"
 
+#include "src/core/bootstrapnodeprober.h"
 #include "src/core/coreext.h"
 #include "src/core/dhtserver.h"
+#include "src/core/groupsyncsender.h"
+#include "src/core/ngcpacketreceiver.h"
 #include "src/core/icoresettings.h"
+#include "src/core/toxeventrecorder.h"
 #include "src/core/toxlogger.h"
 #include "src/core/toxoptions.h"
 #include "src/core/toxstring.h"
@@ -36,7 +40,10 @@
 #include "src/widget/widget.h"
 #include "util/strongtype.h"
 #include "util/compatiblerecursivemutex.h"
+#include "util/lockprofiler.h"
+#include "util/startupprofiler.h"
 #include "util/toxcoreerrorparser.h"
+#include "util/tracer.h"
 
 #include <QCoreApplication>
 #include <QDateTime>
@@ -47,6 +54,7 @@
 #include <QRandomGenerator>
 #endif
 // zoff
+#include <QLoggingCategory>
 #include <QRegularExpression>
 #include <QString>
 #include <QStringBuilder>
@@ -58,28 +66,70 @@
 
 #include <algorithm>
 #include <cassert>
-#include <chrono>
 #include <memory>
-#include <random>
+#include <set>
 
 const QString Core::TOX_EXT = ".tox";
 
 #define ASSERT_CORE_THREAD assert(QThread::currentThread() == coreThread.get())
 
+constexpr int Core::CONNECTION_WATCHDOG_INTERVAL_MS;
+constexpr int Core::DISCONNECT_TOLERANCE_TICKS;
+constexpr qint64 Core::TOX_INTERVAL_REFRESH_MS;
+constexpr int Core::STABLE_CONNECTION_TICKS;
+constexpr qint64 Core::RESUME_GAP_MS;
+constexpr qint64 Core::LOOP_STALL_MS;
+constexpr size_t Core::FRIEND_SEND_BATCH_SIZE;
+constexpr uint8_t Core::NGC_PACKET_VERSION;
+constexpr uint8_t Core::NGC_SYNC_REQUEST;
+constexpr uint8_t Core::NGC_SYNC_MESSAGE;
+constexpr uint8_t Core::NGC_SYNC_FILE;
+constexpr uint8_t Core::PUSH_URL_PACKET_ID;
+constexpr uint8_t Core::LAN_PEER_PACKET_ID;
+
 namespace {
+// logged once per packet, disable with AsyncLogger::setLogLevels() when it gets too noisy
+Q_LOGGING_CATEGORY(ngcPacketLog, "qtox.core.ngcpacket")
+
+using ToxEvent = ToxEventRecorder::Type;
 
-QList<DhtServer> shuffleBootstrapNodes(QList<DhtServer> bootstrapNodes)
+/**
+ * @brief Adds a callback to the ToxEventRecorder, which is off unless --record-tox-events was
+ * given.
+ */
+void recordToxEvent(ToxEvent type, uint32_t target, uint32_t peer = 0, uint32_t value = 0,
+                    size_t length = 0, const uint8_t* data = nullptr)
 {
-    std::mt19937 rng(std::chrono::high_resolution_clock::now().time_since_epoch().count());
-    std::shuffle(bootstrapNodes.begin(), bootstrapNodes.end(), rng);
-    return bootstrapNodes;
+    ToxEventRecorder::getInstance().record(type, target, peer, value, length, data);
 }
 
+/**
+ * @brief Prefixes a received message with its id as upper case hex and ':', in one allocation.
+ * @param id Bytes of the message id.
+ * @param idSize Number of bytes in the id.
+ * @param msg Decoded message text.
+ * @return The message as the chat log expects it.
+ */
+QString withHexId(const uint8_t* id, size_t idSize, const QString& msg)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    QString wrapped;
+    wrapped.reserve(static_cast<int>(idSize * 2 + 1) + msg.size());
+    for (size_t i = 0; i < idSize; ++i) {
+        wrapped += QLatin1Char(digits[id[i] >> 4]);
+        wrapped += QLatin1Char(digits[id[i] & 0xF]);
+    }
+    wrapped += QLatin1Char(':');
+    wrapped += msg;
+    return wrapped;
+}
 } // namespace
 
 Core::Core(QThread* coreThread_, IBootstrapListGenerator& bootstrapListGenerator_, ICoreSettings& settings_)
     : tox(nullptr)
     , toxTimer{new QTimer{this}}
+    , connectionWatchdog{new QTimer{this}}
+    , nodeProber{new BootstrapNodeProber{this}}
     , coreThread(coreThread_)
     , bootstrapListGenerator(bootstrapListGenerator_)
     , settings(settings_)
@@ -92,6 +142,42 @@ Core::Core(QThread* coreThread_, IBootstrapListGenerator& bootstrapListGenerator
     toxTimer->setSingleShot(true);
     connect(toxTimer, &QTimer::timeout, this, &Core::process);
     connect(coreThread_, &QThread::finished, toxTimer, &QTimer::stop);
+    connectionWatchdog->setInterval(CONNECTION_WATCHDOG_INTERVAL_MS);
+    connect(connectionWatchdog, &QTimer::timeout, this, &Core::onConnectionWatchdog);
+    connect(coreThread_, &QThread::finished, connectionWatchdog, &QTimer::stop);
+    connect(nodeProber, &BootstrapNodeProber::finished, this, &Core::onBootstrapProbeFinished);
+
+    if (!nodeRanking.load(settings.getBootstrapNodeRanking())) {
+        qWarning() << "Ignoring the stored bootstrap node ranking";
+    }
+    if (!lanPeers.load(settings.getLanPeerCache())) {
+        qWarning() << "Ignoring the stored LAN peers";
+    }
+
+    const auto sendPrivatePacket = [this](uint32_t groupNumber, uint32_t peerId,
+                                          const QByteArray& packet) {
+        // only hold the lock for the packet itself, the sender paces without it
+        PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+        Tox_Err_Group_Send_Custom_Private_Packet error;
+        tox_group_send_custom_private_packet(tox.get(), groupNumber, peerId, true,
+                                             reinterpret_cast<const uint8_t*>(packet.constData()),
+                                             static_cast<size_t>(packet.size()), &error);
+        return error == TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_OK;
+    };
+    groupSyncSender.reset(new GroupSyncSender(sendPrivatePacket));
+    // file chunks get their own queue, so they neither restart nor wait for a history sync
+    groupFileSender.reset(new GroupSyncSender(sendPrivatePacket));
+
+    ngcPacketReceiver.reset(new NgcPacketReceiver(
+        [this](int groupnumber, uint32_t peerId, QVector<QByteArray> packets) {
+            groupFileSender->append(groupnumber - Settings::NGC_GROUPNUM_OFFSET, peerId,
+                                    std::move(packets));
+        }));
+    // emitted from the receiver's pool threads, receivers of our signal get it queued anyway
+    connect(ngcPacketReceiver.get(), &NgcPacketReceiver::groupImageReceived, this,
+            &Core::groupMessageReceivedImage, Qt::DirectConnection);
+    ngcSyncIndex.reset(new NgcSyncIndex);
+    registerPacketHandlers();
 }
 
 Core::~Core()
@@ -102,6 +188,9 @@ Core::~Core()
      */
     coreThread->exit(0);
     coreThread->wait();
+    groupSyncSender->stop();
+    ngcPacketReceiver.reset();
+    groupFileSender->stop();
 
     tox.reset();
 }
@@ -141,6 +230,79 @@ void Core::registerCallbacks(Tox* tox)
     qDebug() << "QT_COMPILE_VERSION:" << QT_VERSION_STR << "QT_RUNTIME_VERSION:" << qVersion();
 }
 
+/**
+ * @brief Registers the handlers of the custom packets we understand
+ *
+ * Parsing, hashing and storing files is too slow for the tox thread, those packets go to the
+ * pool of the NgcPacketReceiver. Everything that needs toxcore or the sync state runs inline.
+ */
+void Core::registerPacketHandlers()
+{
+    NgcPacketReceiver* receiver = ngcPacketReceiver.get();
+    const auto worker = [receiver](std::function<void()> job) {
+        return receiver->post(std::move(job));
+    };
+    const auto fileType = [](NgcFileTransfer::PacketType type) {
+        return NgcPacketHeader::type(NGC_PACKET_VERSION, static_cast<uint8_t>(type));
+    };
+    using Context = NgcPacketRegistry::Context;
+
+    ngcPackets.reset(new NgcPacketRegistry(worker));
+    ngcPackets->add(fileType(NgcFileTransfer::PacketType::GroupFile), Context::Worker,
+                    [receiver](const NgcPacketSource& source, const QByteArray& packet) {
+                        receiver->handleGroupFile(source.groupnumber,
+                                                  static_cast<int>(source.peerId), source.author,
+                                                  packet);
+                    });
+    ngcPackets->add(fileType(NgcFileTransfer::PacketType::FileAnnounce), Context::Worker,
+                    [receiver](const NgcPacketSource& source, const QByteArray& packet) {
+                        receiver->handleFileAnnounce(source.groupnumber, source.peerId,
+                                                     source.author, packet);
+                    });
+
+    ngcPrivatePackets.reset(new NgcPacketRegistry(worker));
+    // a peer may send chunks to the whole group or only to us
+    for (NgcPacketRegistry* registry : {ngcPackets.get(), ngcPrivatePackets.get()}) {
+        registry->add(fileType(NgcFileTransfer::PacketType::ChunkRequest), Context::Worker,
+                      [receiver](const NgcPacketSource& source, const QByteArray& packet) {
+                          receiver->handleChunkRequest(source.groupnumber, source.peerId,
+                                                       packet);
+                      });
+        registry->add(fileType(NgcFileTransfer::PacketType::Chunk), Context::Worker,
+                      [receiver](const NgcPacketSource& source, const QByteArray& packet) {
+                          receiver->handleChunk(source.groupnumber, source.peerId,
+                                                source.author, packet);
+                      });
+    }
+    ngcPrivatePackets->add(NgcPacketHeader::type(NGC_PACKET_VERSION, NGC_SYNC_REQUEST),
+                           Context::Inline,
+                           [this](const NgcPacketSource& source, const QByteArray& packet) {
+                               onNgcSyncRequestPacket(source, packet);
+                           });
+    ngcPrivatePackets->add(NgcPacketHeader::type(NGC_PACKET_VERSION, NGC_SYNC_MESSAGE),
+                           Context::Inline,
+                           [this](const NgcPacketSource& source, const QByteArray& packet) {
+                               onNgcSyncMessagePacket(source, packet);
+                           });
+    ngcPrivatePackets->add(NgcPacketHeader::type(NGC_PACKET_VERSION, NGC_SYNC_FILE),
+                           Context::Inline,
+                           [this](const NgcPacketSource& source, const QByteArray& packet) {
+                               onNgcSyncFilePacket(source, packet);
+                           });
+
+    losslessPackets.reset(new LosslessPacketRegistry(worker));
+    losslessPackets->add(LosslessPacketHeader::type(PUSH_URL_PACKET_ID),
+                         LosslessPacketRegistry::Context::Inline,
+                         [this](const uint32_t& friendId, const QByteArray& packet) {
+                             onPushtokenPacket(friendId, packet);
+                         });
+    losslessPackets->add(LosslessPacketHeader::type(LAN_PEER_PACKET_ID),
+                         LosslessPacketRegistry::Context::Inline,
+                         [this](const uint32_t& friendId, const QByteArray& packet) {
+                             onLanPeerPacket(friendId, packet);
+                         });
+}
+
 /**
  * @brief Factory method for the Core object
  * @param savedata empty if new profile or saved data else
@@ -176,8 +338,19 @@ ToxCorePtr Core::makeToxCore(const QByteArray& savedata, ICoreSettings& settings
         return {};
     }
 
+    // friends that still know our address from the last session can reach us right away
+    const quint16 lastUdpPort = core->nodeRanking.getLastUdpPort();
+    if (lastUdpPort != 0) {
+        toxOptions->setUdpPort(lastUdpPort);
+    }
+
     Tox_Err_New tox_err;
     core->tox = ToxPtr(tox_new(*toxOptions, &tox_err));
+    if (tox_err == TOX_ERR_NEW_PORT_ALLOC && lastUdpPort != 0) {
+        qDebug() << "UDP port" << lastUdpPort << "of the last session is taken";
+        toxOptions->setUdpPort(0);
+        core->tox = ToxPtr(tox_new(*toxOptions, &tox_err));
+    }
 
     switch (tox_err) {
     case TOX_ERR_NEW_OK:
@@ -304,6 +477,9 @@ void Core::onStarted()
     loadFriends();
     loadGroups();
 
+    connectionWatchdog->start();
+    // don't wait for the watchdog, the nodes of the last session are worth trying right away
+    bootstrapDht();
     process(); // starts its own timer
 }
 
@@ -356,71 +532,119 @@ CoreExt* Core::getExt()
 }
 
 /**
- * @brief Processes toxcore events and ensure we stay connected, called by its own timer
+ * @brief Processes toxcore events, called by its own timer
  */
 void Core::process()
 {
-    QMutexLocker ml{&coreLoopLock};
+    TRACE_SCOPE("Core::process");
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     ASSERT_CORE_THREAD;
 
-    tox_iterate(tox.get(), this);
+    loopStats.beginIteration();
+    loopStats.beginStage("friend message queue");
+    const bool friendBacklog = sendQueuedFriendMessages();
+    loopStats.beginStage("group message queue");
+    sendQueuedGroupMessages();
+    // the callbacks run inside tox_iterate, so a slow one shows up here
+    loopStats.beginStage("tox_iterate");
+    {
+        TRACE_SCOPE("tox_iterate");
+        tox_iterate(tox.get(), this);
+    }
+    loopStats.beginStage("file chunks");
+    getCoreFile()->serveChunkRequests(av && av->hasCalls());
+    loopStats.beginStage("extensions");
     ext->process();
+    loopStats.beginStage("NGC transfers");
+    ngcPacketReceiver->checkTransfers();
+    loopStats.beginStage("NGC sync");
+    sendGroupSyncRequests();
+    loopStats.endIteration();
 
 #ifdef DEBUG
     // we want to see the debug messages immediately
     fflush(stdout);
 #endif
 
-    // HINT: checking the connection on every iteration is overkill and does lots of locking in toxcore
-    //       sadly when fixing this, core_test keeps failing. meh.
-    if (checkConnection()) {
-        tolerance = CORE_DISCONNECT_TOLERANCE;
-    } else if (!(--tolerance)) {
-        bootstrapDht();
-        tolerance = 3 * CORE_DISCONNECT_TOLERANCE;
-    }
-
     unsigned sleeptime_file = getCoreFile()->corefileIterationInterval();
-    unsigned sleeptime_toxcore = tox_iteration_interval(tox.get());
+    // the hint hardly ever changes, no need to ask toxcore on every fast file iteration
+    if (!toxIntervalAge.isValid() || toxIntervalAge.elapsed() >= TOX_INTERVAL_REFRESH_MS) {
+        toxIterationInterval = tox_iteration_interval(tox.get());
+        toxIntervalAge.start();
+    }
+    unsigned sleeptime_toxcore = toxIterationInterval;
     unsigned sleeptime = qMin(sleeptime_toxcore, sleeptime_file);
+    if (friendBacklog) {
+        // toxcore still has room, send the next batch right away
+        sleeptime = 0;
+    }
     // qDebug() << "Core::process:sleeptime_file:" << sleeptime_file << "sleeptime_toxcore:" << sleeptime_toxcore << "sleeptime:" << sleeptime;
     // TODO: check for active AV calls and lower iteration interval only when calls are active
     toxTimer->start(sleeptime);
+    loopStats.timerStarted(sleeptime);
 }
 
-bool Core::checkConnection()
+/**
+ * @brief Bootstraps again if toxcore stays disconnected, called by a slow timer
+ *
+ * The connection state itself is tracked by onSelfConnectionStatusChanged(), so this only
+ * counts down the ticks toxcore gets to reconnect on its own. A tick arriving much too late
+ * means the machine was suspended, and likely joined another network meanwhile, so we
+ * bootstrap right away instead of waiting for toxcore to notice its peers are gone.
+ */
+void Core::onConnectionWatchdog()
 {
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
     ASSERT_CORE_THREAD;
-    auto selfConnection = tox_self_get_connection_status(tox.get());
-    QString connectionName;
-    bool toxConnected = false;
-    switch (selfConnection)
-    {
-        case TOX_CONNECTION_NONE:
-            toxConnected = false;
-            break;
-        case TOX_CONNECTION_TCP:
-            toxConnected = true;
-            connectionName = "a TCP relay";
-            break;
-        case TOX_CONNECTION_UDP:
-            toxConnected = true;
-            connectionName = "the UDP DHT";
-            break;
-        qWarning() << "tox_self_get_connection_status returned unknown enum!";
+
+    // the monotonic clock stops during suspend on some platforms, the wall clock doesn't
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    const bool resumed = lastWatchdogMs > 0 && nowMs - lastWatchdogMs > RESUME_GAP_MS;
+    lastWatchdogMs = nowMs;
+
+    if (resumed) {
+        qDebug() << "Woke up from suspend, bootstrapping again";
+        connectedTicks = 0;
+        bootstrapDht();
+        tolerance = 3 * DISCONNECT_TOLERANCE_TICKS;
+    } else if (isConnected) {
+        tolerance = DISCONNECT_TOLERANCE_TICKS;
+        if (++connectedTicks == STABLE_CONNECTION_TICKS) {
+            rememberConnectFastState();
+        }
+    } else {
+        connectedTicks = 0;
+        if (!(--tolerance)) {
+            bootstrapDht();
+            tolerance = 3 * DISCONNECT_TOLERANCE_TICKS;
+        }
     }
+}
 
-    if (toxConnected && !isConnected) {
-        qDebug().noquote() << "Connected to" << connectionName;
-        emit connected(static_cast<uint32_t>(selfConnection));
-    } else if (!toxConnected && isConnected) {
-        qDebug() << "Disconnected from the DHT";
-        emit disconnected();
+/**
+ * @brief Stores how we got a stable connection, so the next start can take the same way
+ *
+ * The nodes we bootstrapped from are ranked first and our UDP port is reused next time.
+ * toxcore keeps its closest DHT nodes and TCP relays in the save data, saving now replaces
+ * the ones from whenever the profile was saved last.
+ */
+void Core::rememberConnectFastState()
+{
+    ASSERT_CORE_THREAD;
+
+    const qint64 nowSecs = QDateTime::currentMSecsSinceEpoch() / 1000;
+    nodeRanking.markConnected(lastBootstrapNodes, nowSecs);
+    if (!settings.getForceTCP()) {
+        const int port = getSelfUdpPort();
+        if (port > 0) {
+            nodeRanking.setLastUdpPort(static_cast<quint16>(port));
+        }
     }
 
-    isConnected = toxConnected;
-    return toxConnected;
+    settings.setBootstrapNodeRanking(nodeRanking.save(nowSecs));
+    emit saveRequest();
 }
 
 /**
@@ -430,17 +654,23 @@ void Core::bootstrapDht()
 {
     ASSERT_CORE_THREAD;
 
+    // friends on the same LAN are the closest way into the DHT
+    bootstrapLanPeers();
 
-    auto const shuffledBootstrapNodes = shuffleBootstrapNodes(bootstrapListGenerator.getBootstrapNodes());
-    if (shuffledBootstrapNodes.empty()) {
+    // known good nodes first, unknown ones in random order after them
+    auto const rankedBootstrapNodes =
+        nodeRanking.rank(bootstrapListGenerator.getBootstrapNodes(), settings.getForceTCP());
+    if (rankedBootstrapNodes.empty()) {
         qWarning() << "No bootstrap node list";
         return;
     }
 
+    lastBootstrapNodes.clear();
+
     // i think the more we bootstrap, the more we jitter because the more we overwrite nodes
     auto numNewNodes = 2;
-    for (int i = 0; i < numNewNodes && i < shuffledBootstrapNodes.size(); ++i) {
-        const auto& dhtServer = shuffledBootstrapNodes.at(i);
+    for (int i = 0; i < numNewNodes && i < rankedBootstrapNodes.size(); ++i) {
+        const auto& dhtServer = rankedBootstrapNodes.at(i);
         QByteArray address;
         if (!dhtServer.ipv4.isEmpty()) {
             address = dhtServer.ipv4.toLatin1();
@@ -453,6 +683,7 @@ void Core::bootstrapDht()
 
         ToxPk pk{dhtServer.publicKey};
         qDebug() << "Connecting to bootstrap node" << pk.toString();
+        lastBootstrapNodes.append(pk);
         const uint8_t* pkPtr = pk.getData();
 
         Tox_Err_Bootstrap error;
@@ -467,11 +698,153 @@ void Core::bootstrapDht()
             PARSE_ERR(error);
         }
     }
+
+    probeBootstrapNodes();
+}
+
+/**
+ * @brief Bootstraps from the friends we saw on the LAN we are in now
+ *
+ * Also selects the current network for the LAN peer cache, so announcements of friends are
+ * stored for the right network.
+ */
+void Core::bootstrapLanPeers()
+{
+    ASSERT_CORE_THREAD;
+
+    if (!canUseLanPeers()) {
+        return;
+    }
+
+    lanPeers.setNetwork(LanPeerCache::localAddresses());
+    const auto peers = lanPeers.getPeers();
+    for (const auto& peer : peers) {
+        const QByteArray address = peer.address.toString().toLatin1();
+        Tox_Err_Bootstrap error;
+        tox_bootstrap(tox.get(), address.constData(), peer.port, peer.dhtId.getData(), &error);
+        PARSE_ERR(error);
+    }
+
+    if (!peers.isEmpty()) {
+        qDebug() << "Bootstrapping from" << peers.size() << "LAN peers";
+    }
+}
+
+/**
+ * @brief LAN peers are only exchanged and used if LAN discovery is enabled and we talk UDP
+ * directly, a proxy or forced TCP means we don't want to reveal or use local addresses.
+ */
+bool Core::canUseLanPeers() const
+{
+    return settings.getEnableLanDiscovery() && !settings.getForceTCP()
+           && settings.getProxyType() == ICoreSettings::ProxyType::ptNone;
+}
+
+/**
+ * @brief Tells a friend connected with UDP how to reach us on the LAN
+ * @param friendId Friend to announce us to.
+ *
+ * The friend only stores it if it's in one of our subnets, see LanPeerCache.
+ */
+void Core::sendLanAnnouncement(uint32_t friendId)
+{
+    ASSERT_CORE_THREAD;
+
+    if (!canUseLanPeers()) {
+        return;
+    }
+
+    if (lanPeers.getNetworkKey().isEmpty()) {
+        lanPeers.setNetwork(LanPeerCache::localAddresses());
+    }
+
+    const int port = getSelfUdpPort();
+    const QList<QHostAddress> addresses = lanPeers.getLocalAddresses();
+    if (port <= 0 || addresses.isEmpty()) {
+        return;
+    }
+
+    LanPeerCache::Announcement announcement{ToxPk{getSelfDhtId()}, static_cast<quint16>(port),
+                                            addresses};
+    QByteArray packet = LanPeerCache::makeAnnouncement(announcement);
+    packet.prepend(static_cast<char>(LAN_PEER_PACKET_ID));
+
+    Tox_Err_Friend_Custom_Packet error;
+    tox_friend_send_lossless_packet(tox.get(), friendId,
+                                    reinterpret_cast<const uint8_t*>(packet.constData()),
+                                    static_cast<size_t>(packet.size()), &error);
+    PARSE_ERR(error);
+}
+
+void Core::onLanPeerPacket(uint32_t friendId, const QByteArray& packet)
+{
+    if (!canUseLanPeers()) {
+        return;
+    }
+
+    LanPeerCache::Announcement announcement;
+    if (!LanPeerCache::parseAnnouncement(packet.mid(static_cast<int>(LosslessPacketHeader::SIZE)), announcement)) {
+        qWarning() << "Invalid LAN peer packet from friend" << friendId;
+        return;
+    }
+
+    const ToxPk friendPk = getFriendPublicKey(friendId);
+    const qint64 nowSecs = QDateTime::currentMSecsSinceEpoch() / 1000;
+    if (!friendPk.isEmpty() && lanPeers.recordAnnouncement(friendPk, announcement, nowSecs)) {
+        qDebug() << "Friend" << friendId << "is on our LAN";
+        settings.setLanPeerCache(lanPeers.save(nowSecs));
+    }
+}
+
+/**
+ * @brief Starts a probe round if the bootstrap node ranking is outdated
+ *
+ * Probes talk to the nodes directly, so nothing is probed while a proxy is configured.
+ */
+void Core::probeBootstrapNodes()
+{
+    ASSERT_CORE_THREAD;
+
+    if (settings.getProxyType() != ICoreSettings::ProxyType::ptNone || nodeProber->isRunning()) {
+        return;
+    }
+
+    const qint64 nowSecs = QDateTime::currentMSecsSinceEpoch() / 1000;
+    if (!nodeRanking.needsProbe(nowSecs)) {
+        return;
+    }
+
+    const bool tcpOnly = settings.getForceTCP();
+    const auto candidates =
+        nodeRanking.probeCandidates(bootstrapListGenerator.getBootstrapNodes(), tcpOnly);
+    if (nodeProber->start(candidates, settings.getEnableIPv6(), !tcpOnly)) {
+        nodeRanking.setProbed(nowSecs);
+    }
+}
+
+void Core::onBootstrapProbeFinished()
+{
+    ASSERT_CORE_THREAD;
+
+    const qint64 nowSecs = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const auto results = nodeProber->takeResults();
+    int answered = 0;
+    for (const auto& result : results) {
+        nodeRanking.recordProbe(result.publicKey, result.probe, nowSecs);
+        if (result.probe.udp == BootstrapNodeRanking::Outcome::Ok
+            || result.probe.tcp == BootstrapNodeRanking::Outcome::Ok) {
+            ++answered;
+        }
+    }
+
+    qDebug() << answered << "of" << results.size() << "probed bootstrap nodes answered";
+    settings.setBootstrapNodeRanking(nodeRanking.save(nowSecs));
 }
 
 void Core::onFriendRequest(Tox* tox, const uint8_t* cFriendPk, const uint8_t* cMessage,
                            size_t cMessageSize, void* core)
 {
+    TRACE_SCOPE("Core::onFriendRequest");
     std::ignore = tox;
     ToxPk friendPk(cFriendPk);
     std::ignore = cMessage;
@@ -554,6 +927,8 @@ static void send_highlevel_ack(Tox* tox, uint32_t friendId, QByteArray& hash_buf
 void Core::onFriendMessage(Tox* tox, uint32_t friendId, Tox_Message_Type type, const uint8_t* cMessage,
                            size_t cMessageSize, void* core)
 {
+    TRACE_SCOPE("Core::onFriendMessage");
+    recordToxEvent(ToxEvent::FriendMessage, friendId, 0, type, cMessageSize);
     std::ignore = tox;
     uint32_t msgV3_timestamp = 0;
     bool isAction = (type == TOX_MESSAGE_TYPE_ACTION);
@@ -575,7 +950,7 @@ void Core::onFriendMessage(Tox* tox, uint32_t friendId, Tox_Message_Type type, c
             p += xnet_unpack_u32(p, &msgV3_timestamp);
             msgv3hash = QByteArray(msgV3_hash_buffer_bin, 32);
             // qDebug() << "msgv3hash:" << QString::fromUtf8(msgv3hash.toHex()).toUpper();
-            msg = QString::fromUtf8(msgv3hash.toHex()).toUpper().rightJustified(64, '0') + QString(":") + msg;
+            msg = withHexId(reinterpret_cast<const uint8_t*>(msgV3_hash_buffer_bin), 32, msg);
             has_msgv3 = true;
 
             if (type == TOX_MESSAGE_TYPE_HIGH_LEVEL_ACK) {
@@ -602,14 +977,18 @@ void Core::onFriendMessage(Tox* tox, uint32_t friendId, Tox_Message_Type type, c
 
 void Core::onFriendNameChange(Tox* tox, uint32_t friendId, const uint8_t* cName, size_t cNameSize, void* core)
 {
+    recordToxEvent(ToxEvent::FriendName, friendId, 0, 0, cNameSize);
     std::ignore = tox;
     QString newName = ToxString(cName, cNameSize).getQString();
+    static_cast<Core*>(core)->updateFriendState(
+        friendId, [&newName](CoreState::Friend& friendState) { friendState.name = newName; });
     // no saveRequest, this callback is called on every connection, not just on name change
     emit static_cast<Core*>(core)->friendUsernameChanged(friendId, newName);
 }
 
 void Core::onFriendTypingChange(Tox* tox, uint32_t friendId, bool isTyping, void* core)
 {
+    recordToxEvent(ToxEvent::FriendTyping, friendId, 0, isTyping);
     std::ignore = tox;
     emit static_cast<Core*>(core)->friendTypingChanged(friendId, isTyping);
 }
@@ -617,6 +996,7 @@ void Core::onFriendTypingChange(Tox* tox, uint32_t friendId, bool isTyping, void
 void Core::onStatusMessageChanged(Tox* tox, uint32_t friendId, const uint8_t* cMessage,
                                   size_t cMessageSize, void* core)
 {
+    recordToxEvent(ToxEvent::FriendStatusMessage, friendId, 0, 0, cMessageSize);
     std::ignore = tox;
     QString message = ToxString(cMessage, cMessageSize).getQString();
     // no saveRequest, this callback is called on every connection, not just on name change
@@ -625,6 +1005,7 @@ void Core::onStatusMessageChanged(Tox* tox, uint32_t friendId, const uint8_t* cM
 
 void Core::onUserStatusChanged(Tox* tox, uint32_t friendId, Tox_User_Status userstatus, void* core)
 {
+    recordToxEvent(ToxEvent::FriendStatus, friendId, 0, userstatus);
     std::ignore = tox;
     Status::Status status;
     switch (userstatus) {
@@ -647,27 +1028,49 @@ void Core::onUserStatusChanged(Tox* tox, uint32_t friendId, Tox_User_Status user
 
 void Core::onSelfConnectionStatusChanged(Tox* tox, Tox_Connection status, void* vCore)
 {
+    recordToxEvent(ToxEvent::SelfConnection, 0, 0, status);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
-    std::ignore = core;
 
+    bool toxConnected = false;
     switch (status)
     {
         case TOX_CONNECTION_NONE:
             qDebug() << "Disconnected from Tox Network";
             break;
         case TOX_CONNECTION_TCP:
+            toxConnected = true;
             qDebug() << "Connected to Tox Network through a TCP relay";
             break;
         case TOX_CONNECTION_UDP:
+            toxConnected = true;
             qDebug() << "Connected to Tox Network directly with UDP";
             break;
-        qWarning() << "tox_callback_self_connection_status returned unknown enum!";
+        default:
+            qWarning() << "tox_callback_self_connection_status returned unknown enum!";
+            return;
+    }
+
+    // switching between TCP and UDP doesn't change whether we are connected
+    if (toxConnected && !core->isConnected) {
+        StartupProfiler::getInstance().addMark("Core connected");
+        emit core->connected(static_cast<uint32_t>(status));
+    } else if (!toxConnected && core->isConnected) {
+        // the network may have changed, don't wait for the watchdog to reach friends on the LAN
+        core->bootstrapLanPeers();
+        emit core->disconnected();
+    }
+
+    core->isConnected = toxConnected;
+    if (toxConnected) {
+        core->tolerance = DISCONNECT_TOLERANCE_TICKS;
     }
 }
 
 void Core::onConnectionStatusChanged(Tox* tox, uint32_t friendId, Tox_Connection status, void* vCore)
 {
+    TRACE_SCOPE("Core::onConnectionStatusChanged");
+    recordToxEvent(ToxEvent::FriendConnection, friendId, 0, status);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     Status::Status friendStatus = Status::Status::Offline;
@@ -684,10 +1087,17 @@ void Core::onConnectionStatusChanged(Tox* tox, uint32_t friendId, Tox_Connection
         case TOX_CONNECTION_UDP:
             friendStatus = Status::Status::Online;
             qDebug() << "Connected to friend" << friendId << "directly with UDP";
+            // only a direct connection can be a LAN one
+            core->sendLanAnnouncement(friendId);
             break;
         qWarning() << "tox_callback_friend_connection_status returned unknown enum!";
     }
 
+    core->updateFriendState(friendId, [status](CoreState::Friend& friendState) {
+        friendState.online = status != TOX_CONNECTION_NONE;
+    });
+    core->recordConnectionPath(friendId, status);
+
     // Ignore Online because it will be emited from onUserStatusChanged
     bool isOffline = friendStatus == Status::Status::Offline;
     if (isOffline) {
@@ -697,6 +1107,41 @@ void Core::onConnectionStatusChanged(Tox* tox, uint32_t friendId, Tox_Connection
     emit core->onFriendConnectionStatusFullChanged(friendId, static_cast<uint32_t>(status));
 }
 
+/**
+ * @brief Updates the connection path statistics of a friend
+ * @param friendId Friend whose connection status changed.
+ * @param status The new status.
+ */
+void Core::recordConnectionPath(uint32_t friendId, Tox_Connection status)
+{
+    ConnectionPathStats::Path path = ConnectionPathStats::Path::Offline;
+    if (status == TOX_CONNECTION_UDP) {
+        path = ConnectionPathStats::Path::Udp;
+    } else if (status == TOX_CONNECTION_TCP) {
+        path = ConnectionPathStats::Path::TcpRelay;
+    }
+
+    QString name;
+    const CoreStatePtr state = getState();
+    if (const CoreState::Friend* friendState = state->findFriend(friendId)) {
+        const QString shortKey = friendState->publicKey.toString().left(8);
+        name = friendState->name.isEmpty()
+                   ? shortKey
+                   : QStringLiteral("%1 (%2)").arg(friendState->name, shortKey);
+    }
+
+    const bool proxied = settings.getProxyType() != ICoreSettings::ProxyType::ptNone;
+    connectionPaths.setPath(friendId, name, path, proxied, QDateTime::currentMSecsSinceEpoch());
+}
+
+/**
+ * @brief Returns how we are connected to a friend and how that changed over time
+ */
+ConnectionPathStats::Snapshot Core::getFriendConnectionPath(uint32_t friendId) const
+{
+    return connectionPaths.getSnapshot(friendId, QDateTime::currentMSecsSinceEpoch());
+}
+
 void Core::onGroupInvite(Tox* tox, uint32_t friendId, Tox_Conference_Type type,
                          const uint8_t* cookie, size_t length, void* vCore)
 {
@@ -790,6 +1235,7 @@ void Core::onNgcInvite(Tox* tox, uint32_t friendId, const uint8_t* invite_data,
         qDebug() << QString("NGC group invite by %1: FAILED").arg(friendId);
     } else {
         qDebug() << QString("NGC group invite by %1: OK").arg(friendId);
+        core->updateGroupState(Settings::NGC_GROUPNUM_OFFSET + groupId);
         emit core->saveRequest();
         emit core->groupJoined((Settings::NGC_GROUPNUM_OFFSET + groupId), core->getGroupPersistentId(groupId, 1));
     }
@@ -800,24 +1246,31 @@ void Core::onNgcSelfJoin(Tox* tox, uint32_t group_number, void* vCore)
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     qDebug() << QString("onNgcSelfJoin:gn #%1").arg(group_number);
+    core->updateGroupState(Settings::NGC_GROUPNUM_OFFSET + group_number);
+    core->startGroupSyncRound(group_number);
+    // the only full resync of the peer list, after this peers are reported one by one
+    emit core->groupPeerlistChanged(Settings::NGC_GROUPNUM_OFFSET + group_number);
     emit core->saveRequest();
 }
 
 void Core::onNgcPeerName(Tox *tox, uint32_t group_number, uint32_t peer_id, const uint8_t *name,
                                     size_t length, void *vCore)
 {
+    recordToxEvent(ToxEvent::NgcPeerName, group_number, peer_id, 0, length);
     std::ignore = tox;
-    std::ignore = name;
-    std::ignore = length;
     Core* core = static_cast<Core*>(vCore);
     qDebug() << QString("onNgcPeerName:peer_id") << peer_id;
-    emit core->groupPeerlistChanged(Settings::NGC_GROUPNUM_OFFSET + group_number);
+    const int groupId = Settings::NGC_GROUPNUM_OFFSET + group_number;
+    core->updateGroupPeerState(groupId, peer_id);
+    emit core->groupPeerRenamed(groupId, peer_id, core->getGroupPeerPk(groupId, peer_id),
+                                ToxString(name, length).getQString());
     emit core->saveRequest();
 }
 
 void Core::onNgcPeerExit(Tox *tox, uint32_t group_number, uint32_t peer_id, Tox_Group_Exit_Type exit_type,
                                     const uint8_t *name, size_t name_length, const uint8_t *part_message, size_t length, void *vCore)
 {
+    recordToxEvent(ToxEvent::NgcPeerExit, group_number, peer_id, exit_type, name_length);
     std::ignore = tox;
     std::ignore = name;
     std::ignore = name_length;
@@ -825,39 +1278,43 @@ void Core::onNgcPeerExit(Tox *tox, uint32_t group_number, uint32_t peer_id, Tox_
     std::ignore = length;
     Core* core = static_cast<Core*>(vCore);
     qDebug() << QString("onNgcPeerExit:peer_id") << peer_id << "exit type" << exit_type;
-    emit core->groupPeerlistChanged(Settings::NGC_GROUPNUM_OFFSET + group_number);
+    // the peer id may be given to the next peer joining
+    core->groupSyncSender->cancel(group_number, peer_id);
+    core->groupFileSender->cancel(group_number, peer_id);
+    core->ngcSyncCoordinator.removePeer(group_number, peer_id);
+    const int groupId = Settings::NGC_GROUPNUM_OFFSET + group_number;
+    // the key is gone with the peer state, so look it up first
+    const ToxPk peerPk = core->getGroupPeerPk(groupId, peer_id);
+    core->removeGroupPeerState(groupId, peer_id);
+    emit core->groupPeerExited(groupId, peer_id, peerPk);
     emit core->saveRequest();
 }
 
 void Core::onNgcPeerJoin(Tox* tox, uint32_t group_number, uint32_t peer_id, void* vCore)
 {
+    recordToxEvent(ToxEvent::NgcPeerJoin, group_number, peer_id);
     std::ignore = tox;
-    std::ignore = group_number;
     Core* core = static_cast<Core*>(vCore);
+    qDebug() << QString("onNgcPeerJoin:peer #%1").arg(peer_id);
 
-    auto peerPk = core->getGroupPeerPk((Settings::NGC_GROUPNUM_OFFSET + group_number), peer_id);
-
-    Tox_Err_Group_Peer_Query error;
-    size_t name_length = tox_group_peer_get_name_size(tox, group_number, peer_id, &error);
-    if ((name_length > 0) && (name_length < 500)) {
-        uint8_t *name = reinterpret_cast<uint8_t*>(calloc(1, name_length + 1));
-        if (name) {
-            bool res = tox_group_peer_get_name(tox, group_number, peer_id, name, &error);
-            if (res) {
-                const auto newName = ToxString(name, name_length).getQString();
-                emit core->groupPeerlistChanged(Settings::NGC_GROUPNUM_OFFSET + group_number);
-            }
-            free(name);
-        }
+    const int groupId = Settings::NGC_GROUPNUM_OFFSET + group_number;
+    core->updateGroupPeerState(groupId, peer_id);
+    const auto current = core->getState();
+    const auto group = current->findGroup(groupId);
+    const auto peer = group ? group->findPeer(peer_id) : nullptr;
+    if (peer) {
+        emit core->groupPeerJoined(groupId, peer_id, peer->publicKey, peer->name);
     }
+    core->ngcSyncCoordinator.addPeer(group_number, peer_id);
 
-    qDebug() << QString("onNgcPeerJoin:peer #%1").arg(peer_id);
     emit core->saveRequest();
 }
 
 void Core::onNgcGroupMessage(Tox* tox, uint32_t group_number, uint32_t peer_id, Tox_Message_Type type,
                              const uint8_t *message, size_t length, uint32_t message_id, void* vCore)
 {
+    TRACE_SCOPE("Core::onNgcGroupMessage");
+    recordToxEvent(ToxEvent::NgcMessage, group_number, peer_id, type, length);
     std::ignore = tox;
     std::ignore = type;
     Core* core = static_cast<Core*>(vCore);
@@ -867,12 +1324,16 @@ void Core::onNgcGroupMessage(Tox* tox, uint32_t group_number, uint32_t peer_id,
     xnet_unpack_u32(p, &message_id_hostenc);
     QByteArray msgIdhash = QByteArray(reinterpret_cast<const char*>(&message_id_hostenc), 4);
     // qDebug() << "msgIdhash:" << QString::fromUtf8(msgIdhash.toHex()).toUpper();
-    msg = QString::fromUtf8(msgIdhash.toHex()).toUpper().rightJustified(8, '0') + QString(":") + msg;
+    const QByteArray messageHash = NgcSyncIndex::messageHash(msgIdhash, msg);
+    msg = withHexId(reinterpret_cast<const uint8_t*>(&message_id_hostenc), 4, msg);
 
     // const bool isGuiThread = QThread::currentThread() == QCoreApplication::instance()->thread();
     // qDebug() << QString("onNgcGroupMessage:THREAD:TOX:010:") << QThread::currentThreadId() << "isGuiThread" << isGuiThread;
 
     auto peerPk = core->getGroupPeerPk((Settings::NGC_GROUPNUM_OFFSET + group_number), peer_id);
+    // a later history sync will send this message again
+    core->ngcSyncIndex->insert(Settings::NGC_GROUPNUM_OFFSET + group_number, peerPk,
+                               QDateTime::currentMSecsSinceEpoch(), messageHash);
     emit core->groupMessageReceived((Settings::NGC_GROUPNUM_OFFSET + group_number), peer_id, msg,
         false, false, static_cast<int>(Widget::MessageHasIdType::NGC_MSG_ID));
 }
@@ -880,6 +1341,7 @@ void Core::onNgcGroupMessage(Tox* tox, uint32_t group_number, uint32_t peer_id,
 void Core::onNgcGroupPrivateMessage(Tox* tox, uint32_t group_number, uint32_t peer_id, Tox_Message_Type type,
         const uint8_t *message, size_t length, void* vCore)
 {
+    recordToxEvent(ToxEvent::NgcPrivateMessage, group_number, peer_id, type, length);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     std::ignore = type;
@@ -893,48 +1355,29 @@ void Core::onNgcGroupPrivateMessage(Tox* tox, uint32_t group_number, uint32_t pe
 void Core::onNgcGroupCustomPacket(Tox* tox, uint32_t group_number, uint32_t peer_id, const uint8_t *data,
         size_t length, void* vCore)
 {
+    TRACE_SCOPE("Core::onNgcGroupCustomPacket");
+    recordToxEvent(ToxEvent::NgcCustomPacket, group_number, peer_id, 0, length, data);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
-    std::ignore = length;
-    qDebug() << QString("onNgcGroupCustomPacket:peer=") << peer_id << QString("length=") << length;
-    const bool isGuiThread = QThread::currentThread() == QCoreApplication::instance()->thread();
-    qDebug() << QString("onNgcGroupCustomPacket:THREAD:TOX:011:") << QThread::currentThreadId() << "isGuiThread" << isGuiThread;
+    qCDebug(ngcPacketLog) << QString("onNgcGroupCustomPacket:peer=") << peer_id << QString("length=") << length;
 
-    size_t header_len = 6 + 1 + 1 + 32 + 4 + 255;
-    if (length > header_len)
-    {
-        if (
-            (data[0] == 0x66) &&
-            (data[1] == 0x77) &&
-            (data[2] == 0x88) &&
-            (data[3] == 0x11) &&
-            (data[4] == 0x34) &&
-            (data[5] == 0x35))
-        {
-            if ((data[6] == 0x1) && (data[7] == 0x11))
-            {
-                // HINT: ok we have a group file
-                auto peerPk = core->getGroupPeerPk((Settings::NGC_GROUPNUM_OFFSET + group_number), peer_id);
-                QByteArray image_data_bytes = QByteArray(reinterpret_cast<const char*>(data + header_len), (length - header_len));
-                emit core->groupMessageReceivedImage((Settings::NGC_GROUPNUM_OFFSET + group_number),
-                    peer_id, image_data_bytes,
-                    (length - header_len), false,
-                    static_cast<int>(Widget::MessageHasIdType::NGC_MSG_ID));
-            }
-        }
-    }
+    const int groupnumber = Settings::NGC_GROUPNUM_OFFSET + group_number;
+    const NgcPacketSource source{group_number, groupnumber, peer_id,
+                                 core->getGroupPeerPk(groupnumber, peer_id)};
+    core->ngcPackets->dispatch(source, data, length);
 }
 
 void Core::onNgcGroupCustomPrivatePacket(Tox* tox, uint32_t group_number, uint32_t peer_id, const uint8_t *data,
         size_t length, void* vCore)
 {
+    recordToxEvent(ToxEvent::NgcCustomPrivatePacket, group_number, peer_id, 0, length, data);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     std::ignore = core;
     std::ignore = group_number;
     std::ignore = data;
     std::ignore = length;
-    qDebug() << QString("onNgcGroupCustomPrivatePacket:group_number=") << group_number << "peer=" << peer_id << QString("length=") << length;
+    qCDebug(ngcPacketLog) << QString("onNgcGroupCustomPrivatePacket:group_number=") << group_number << "peer=" << peer_id << QString("length=") << length;
 
 
     Tox_Err_Group_Self_Query error;
@@ -950,7 +1393,7 @@ void Core::onNgcGroupCustomPrivatePacket(Tox* tox, uint32_t group_number, uint32
     if (res == peer_id)
     {
         // HINT: ignore own packets
-        qDebug() << QString("onNgcGroupCustomPrivatePacket:group_number=") << group_number
+        qCDebug(ngcPacketLog) << QString("onNgcGroupCustomPrivatePacket:group_number=") << group_number
             << "peer=" << peer_id << QString("ignoring own packet");
         return;
     }
@@ -963,64 +1406,82 @@ void Core::onNgcGroupCustomPrivatePacket(Tox* tox, uint32_t group_number, uint32
         return;
     }
 
-        if (
-            (data[0] == 0x66) &&
-            (data[1] == 0x77) &&
-            (data[2] == 0x88) &&
-            (data[3] == 0x11) &&
-            (data[4] == 0x34) &&
-            (data[5] == 0x35))
-        {
-            if ((data[6] == 0x1) && (data[7] == 0x1))
-            {
-                qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_request");
-                Tox_Err_Group_State_Queries error2;
-                Tox_Group_Privacy_State privacy_state =
-                    tox_group_get_privacy_state(tox, group_number, &error2);
-                if (error2 != TOX_ERR_GROUP_STATE_QUERIES_OK)
-                {
-                    qDebug() << QString("onNgcGroupCustomPrivatePacket: tox_group_get_privacy_state: error=") << error2;
-                    return;
-                }
+    const int groupnumber = Settings::NGC_GROUPNUM_OFFSET + group_number;
+    const NgcPacketSource source{group_number, groupnumber, peer_id,
+                                 core->getGroupPeerPk(groupnumber, peer_id)};
+    core->ngcPrivatePackets->dispatch(source, data, length);
+}
 
-                if (privacy_state == TOX_GROUP_PRIVACY_STATE_PUBLIC)
-                {
-                    qDebug() << QString("onNgcGroupCustomPrivatePacket:sync_history:peer=") << peer_id;
-                    auto peerPk = core->getGroupPeerPk((Settings::NGC_GROUPNUM_OFFSET + group_number), peer_id);
-                    emit core->groupSyncHistoryReqReceived(
-                        (Settings::NGC_GROUPNUM_OFFSET + group_number),
-                        peer_id, peerPk);
-                }
-                else
-                {
-                    qDebug() << QString("onNgcGroupCustomPrivatePacket: only sync history for public groups!");
-                }
-            }
-            else if ((data[6] == 0x1) && (data[7] == 0x2))
-            {
-                const int header_syncmsg = 6 + 1 + 1 + 4 + 32 + 4 + 25;
-                if (length >= (header_syncmsg + 1))
-                {
-                    qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_syncmsg");
-                    // TODO: write me // handle_incoming_sync_group_message(group_number, peer_id, data, length);
-                }
-            }
-            else if ((data[6] == 0x1) && (data[7] == 0x3))
-            {
-                qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_syncfile:A");
-                const int header_syncfile = 6 + 1 + 1 + 32 + 32 + 4 + 25 + 255;
-                if (length >= (header_syncfile + 1))
-                {
-                    qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_syncfile:B");
-                    // TODO: write me // handle_incoming_sync_group_file(group_number, peer_id, data, length);
-                }
-            }
+void Core::onNgcSyncRequestPacket(const NgcPacketSource& source, const QByteArray& packet)
+{
+    std::ignore = packet;
+    qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_request");
+    Tox_Err_Group_State_Queries error;
+    Tox_Group_Privacy_State privacy_state =
+        tox_group_get_privacy_state(tox.get(), source.groupNumber, &error);
+    if (error != TOX_ERR_GROUP_STATE_QUERIES_OK)
+    {
+        qDebug() << QString("onNgcGroupCustomPrivatePacket: tox_group_get_privacy_state: error=") << error;
+        return;
+    }
+
+    if (privacy_state == TOX_GROUP_PRIVACY_STATE_PUBLIC)
+    {
+        qDebug() << QString("onNgcGroupCustomPrivatePacket:sync_history:peer=") << source.peerId;
+        if (!ngcSyncCoordinator.acceptRequest(
+                source.groupNumber, source.author, QDateTime::currentMSecsSinceEpoch())) {
+            qDebug() << "onNgcGroupCustomPrivatePacket: dropping sync request, too many of them";
+            return;
         }
+        emit groupSyncHistoryReqReceived(source.groupnumber, source.peerId, source.author);
+    }
+    else
+    {
+        qDebug() << QString("onNgcGroupCustomPrivatePacket: only sync history for public groups!");
+    }
+}
+
+void Core::onNgcSyncMessagePacket(const NgcPacketSource& source, const QByteArray& packet)
+{
+    // keeps the request outstanding, even if the message turns out to be a duplicate
+    ngcSyncCoordinator.onReplyPacket(source.groupNumber, source.peerId,
+                                     QDateTime::currentMSecsSinceEpoch());
+    NgcSyncIndex::SyncMessage syncMessage;
+    if (!NgcSyncIndex::parseSyncMessage(packet, syncMessage)) {
+        return;
+    }
+
+    qCDebug(ngcPacketLog) << QString("onNgcGroupCustomPrivatePacket: got ngch_syncmsg");
+    const QByteArray messageHash = NgcSyncIndex::messageHash(syncMessage.msgId, syncMessage.text);
+    // every peer answering the sync request sends the same messages
+    if (!ngcSyncIndex->insert(source.groupnumber, syncMessage.sender, syncMessage.timestampMs,
+                              messageHash)) {
+        return;
+    }
+
+    const QString msg = QString::fromUtf8(syncMessage.msgId.toHex()).toUpper()
+                        + QString(":") + syncMessage.text;
+    emit groupSyncMessageReceived(source.groupnumber, syncMessage.sender,
+                                  QDateTime::fromMSecsSinceEpoch(syncMessage.timestampMs), msg);
+}
+
+void Core::onNgcSyncFilePacket(const NgcPacketSource& source, const QByteArray& packet)
+{
+    std::ignore = source;
+    qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_syncfile:A");
+    const int header_syncfile = 6 + 1 + 1 + 32 + 32 + 4 + 25 + 255;
+    if (packet.size() >= (header_syncfile + 1))
+    {
+        qDebug() << QString("onNgcGroupCustomPrivatePacket: got ngch_syncfile:B");
+        // TODO: write me // handle_incoming_sync_group_file(group_number, peer_id, data, length);
+    }
 }
 
 void Core::onGroupMessage(Tox* tox, uint32_t groupId, uint32_t peerId, Tox_Message_Type type,
                           const uint8_t* cMessage, size_t length, void* vCore)
 {
+    TRACE_SCOPE("Core::onGroupMessage");
+    recordToxEvent(ToxEvent::ConferenceMessage, groupId, peerId, type, length);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     bool isAction = type == TOX_MESSAGE_TYPE_ACTION;
@@ -1041,6 +1502,7 @@ void Core::onGroupPeerListChange(Tox* tox, uint32_t groupId, void* vCore)
     std::ignore = tox;
     const auto core = static_cast<Core*>(vCore);
     qDebug() << QString("Group %1 peerlist changed").arg(groupId);
+    core->updateGroupState(groupId);
     // no saveRequest, this callback is called on every connection to group peer, not just on brand new peers
     emit core->groupPeerlistChanged(groupId);
 }
@@ -1052,6 +1514,7 @@ void Core::onGroupPeerNameChange(Tox* tox, uint32_t groupId, uint32_t peerId, co
     const auto newName = ToxString(name, length).getQString();
     qDebug() << QString("Group %1, peer %2, name changed to %3").arg(groupId).arg(peerId).arg(newName);
     auto* core = static_cast<Core*>(vCore);
+    core->updateGroupPeerState(groupId, peerId);
     auto peerPk = core->getGroupPeerPk(groupId, peerId);
     emit core->groupPeerNameChanged(groupId, peerPk, newName);
 }
@@ -1076,41 +1539,49 @@ void Core::onGroupTitleChange(Tox* tox, uint32_t groupId, uint32_t peerId, const
 void Core::onLosslessPacket(Tox* tox, uint32_t friendId,
                             const uint8_t* data, size_t length, void* vCore)
 {
+    TRACE_SCOPE("Core::onLosslessPacket");
+    recordToxEvent(ToxEvent::LosslessPacket, friendId, 0, 0, length, data);
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     //* disable toxext handling for now *// core->ext->onLosslessPacket(friendId, data, length);
 
+    core->losslessPackets->dispatch(friendId, data, length);
+}
+
+void Core::onPushtokenPacket(uint32_t friendId, const QByteArray& packet)
+{
     // zoff
-    // qDebug() << "onLosslessPacket:fn=" << friendId << " data:" << (int)data[0] << (int)data[1] << (int)data[2];
-    if (data[0] == 181) // HINT: pkt id for CONTROL_PROXY_MESSAGE_TYPE_PUSH_URL_FOR_FRIEND == 181
+    if (packet.size() > 5)
     {
-        if (length > 5)
-        {
-            const uint8_t* data_str = data + 1;
-            QString pushtoken = ToxString(data_str, (length - 1)).getQString();
-            emit static_cast<Core*>(core)->friendPushtokenReceived(friendId, pushtoken);
-        }
-        else
-        {
-            qDebug() << "onLosslessPacket:DEL:Pushtoken";
-            emit static_cast<Core*>(core)->friendPushtokenReceived(friendId, " ");
-        }
+        QString pushtoken = ToxString(reinterpret_cast<const uint8_t*>(packet.constData()) + 1,
+                                      static_cast<size_t>(packet.size() - 1)).getQString();
+        emit friendPushtokenReceived(friendId, pushtoken);
+    }
+    else
+    {
+        qDebug() << "onLosslessPacket:DEL:Pushtoken";
+        emit friendPushtokenReceived(friendId, " ");
     }
     // zoff
 }
 
 void Core::onReadReceiptCallback(Tox* tox, uint32_t friendId, uint32_t receipt, void* core)
 {
+    TRACE_SCOPE("Core::onReadReceiptCallback");
+    recordToxEvent(ToxEvent::ReadReceipt, friendId, 0, receipt);
     std::ignore = tox;
+    static_cast<Core*>(core)->connectionPaths.receiptReceived(
+        friendId, receipt, QDateTime::currentMSecsSinceEpoch());
     emit static_cast<Core*>(core)->receiptRecieved(friendId, ReceiptNum{receipt});
 }
 
 void Core::acceptFriendRequest(const ToxPk& friendPk)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
     Tox_Err_Friend_Add error;
     uint32_t friendId = tox_friend_add_norequest(tox.get(), friendPk.getData(), &error);
     if (PARSE_ERR(error)) {
+        updateFriendState(friendId);
         emit saveRequest();
         emit friendAdded(friendId, friendPk);
     } else {
@@ -1126,7 +1597,7 @@ void Core::acceptFriendRequest(const ToxPk& friendPk)
  */
 QString Core::getFriendRequestErrorMessage(const ToxId& friendId, const QString& message) const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (!friendId.isValid()) {
         return tr("Invalid Tox ID", "Error while sending friend request");
@@ -1150,7 +1621,7 @@ QString Core::getFriendRequestErrorMessage(const ToxId& friendId, const QString&
 
 void Core::requestNgc(const QString& ngcId, const QString& message)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     std::ignore = message;
 
@@ -1174,6 +1645,7 @@ void Core::requestNgc(const QString& ngcId, const QString& message)
         qDebug() << "requestNgc join failed, error: " << error;
     } else {
         qDebug() << "requestNgc join OK, group num: " << groupId;
+        updateGroupState(Settings::NGC_GROUPNUM_OFFSET + groupId);
         emit saveRequest();
         emit groupJoined((Settings::NGC_GROUPNUM_OFFSET + groupId), getGroupPersistentId(groupId, 1));
     }
@@ -1181,7 +1653,7 @@ void Core::requestNgc(const QString& ngcId, const QString& message)
 
 void Core::requestFriendship(const ToxId& friendId, const QString& message)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     ToxPk friendPk = friendId.getPublicKey();
     QString errorMessage = getFriendRequestErrorMessage(friendId, message);
@@ -1197,6 +1669,7 @@ void Core::requestFriendship(const ToxId& friendId, const QString& message)
         tox_friend_add(tox.get(), friendId.getBytes(), cMessage.data(), cMessage.size(), &error);
     if (PARSE_ERR(error)) {
         qDebug() << "Requested friendship from " << friendNumber;
+        updateFriendState(friendNumber);
         emit saveRequest();
         emit friendAdded(friendNumber, friendPk);
         emit requestSent(friendPk, message);
@@ -1206,8 +1679,12 @@ void Core::requestFriendship(const ToxId& friendId, const QString& message)
     }
 }
 
-bool Core::sendMessageWithType(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp,
-                               Tox_Message_Type type, ReceiptNum& receipt)
+/**
+ * @brief Hands one message to toxcore, under the lock process() already holds
+ * @return TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ if it should be tried again later
+ */
+Tox_Err_Friend_Send_Message Core::sendMessageWithType(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp,
+                                                      Tox_Message_Type type, ReceiptNum& receipt)
 {
     int size = message.toUtf8().size();
     auto maxSize = static_cast<int>(TOX_MSGV3_MAX_MESSAGE_LENGTH);
@@ -1215,7 +1692,7 @@ bool Core::sendMessageWithType(uint32_t friendId, const QString& message, const
         assert(false);
         qCritical() << "Core::sendMessageWithType called with message of size:" << size
                     << "when max is:" << maxSize << ". Ignoring.";
-        return false;
+        return TOX_ERR_FRIEND_SEND_MESSAGE_TOO_LONG;
     }
 
     ToxString cMessage(message);
@@ -1225,7 +1702,8 @@ bool Core::sendMessageWithType(uint32_t friendId, const QString& message, const
                     cMessage.size() + TOX_MSGV3_GUARD + TOX_MSGV3_MSGID_LENGTH + TOX_MSGV3_TIMESTAMP_LENGTH)));
     if (!message_str_v3)
     {
-        return false;
+        // just as toxcore failing to grow its queue, worth another try
+        return TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ;
     }
 
     uint32_t timestamp_unix = static_cast<uint32_t>((timestamp.toMSecsSinceEpoch() / 1000));
@@ -1249,27 +1727,140 @@ bool Core::sendMessageWithType(uint32_t friendId, const QString& message, const
                                                  new_len, &error)};
     free(message_str_v3);
 
+    // a full queue is normal backpressure while toxcore waits for acks, not worth a warning
+    if (error == TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ) {
+        return error;
+    }
+
     if (PARSE_ERR(error)) {
-        return true;
+        connectionPaths.messageSent(friendId, receipt.get(), QDateTime::currentMSecsSinceEpoch());
     }
-    return false;
+    return error;
+}
+
+uint64_t Core::queueMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp)
+{
+    return queueFriendMessage(friendId, message, id_or_hash, timestamp, TOX_MESSAGE_TYPE_NORMAL);
+}
+
+uint64_t Core::queueAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp)
+{
+    return queueFriendMessage(friendId, action, id_or_hash, timestamp, TOX_MESSAGE_TYPE_ACTION);
 }
 
-bool Core::sendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt)
+/**
+ * @brief Queues a message for sendQueuedFriendMessages(), without waiting for coreLoopLock
+ * @return Id the result is reported with, through friendMessageSent or friendMessagesRefused
+ */
+uint64_t Core::queueFriendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash,
+                                  const QDateTime& timestamp, Tox_Message_Type type)
 {
-    QMutexLocker ml(&coreLoopLock);
-    return sendMessageWithType(friendId, message, id_or_hash, timestamp, TOX_MESSAGE_TYPE_NORMAL, receipt);
+    bool wasEmpty;
+    uint64_t queuedId;
+    {
+        QMutexLocker locker{&friendSendLock};
+        queuedId = nextQueuedId++;
+        auto& queue = queuedFriendMessages[friendId];
+        wasEmpty = queue.empty();
+        queue.push_back({queuedId, message, id_or_hash, timestamp, type});
+    }
+
+    if (wasEmpty) {
+        // don't wait for the rest of the tox iteration interval
+        QMetaObject::invokeMethod(toxTimer, "start", Qt::QueuedConnection, Q_ARG(int, 0));
+    }
+    return queuedId;
 }
 
-bool Core::sendAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt)
+/**
+ * @brief Hands the next batch of queued messages of every friend to toxcore, under the lock
+ * process() already holds
+ *
+ * A friend whose toxcore send queue is full keeps its messages for the next iteration. Any
+ * other error refuses the message and everything queued behind it for that friend at once,
+ * so the dispatcher can queue them again in order.
+ *
+ * @return True if a friend has more messages waiting and toxcore has room for them.
+ */
+bool Core::sendQueuedFriendMessages()
 {
-    QMutexLocker ml(&coreLoopLock);
-    return sendMessageWithType(friendId, action, id_or_hash, timestamp, TOX_MESSAGE_TYPE_ACTION, receipt);
+    std::map<uint32_t, std::deque<QueuedFriendMessage>> batches;
+    {
+        QMutexLocker locker{&friendSendLock};
+        for (auto& queue : queuedFriendMessages) {
+            auto& pending = queue.second;
+            const auto end = pending.begin()
+                             + static_cast<std::ptrdiff_t>(std::min(pending.size(), FRIEND_SEND_BATCH_SIZE));
+            batches[queue.first].assign(std::make_move_iterator(pending.begin()),
+                                        std::make_move_iterator(end));
+            pending.erase(pending.begin(), end);
+        }
+    }
+
+    std::map<uint32_t, QVector<uint64_t>> refused;
+    std::set<uint32_t> blocked;
+    for (auto& batch : batches) {
+        const uint32_t friendId = batch.first;
+        auto& messages = batch.second;
+        while (!messages.empty()) {
+            const auto& queued = messages.front();
+            ReceiptNum receipt;
+            const auto error = sendMessageWithType(friendId, queued.message, queued.id_or_hash,
+                                                   queued.timestamp, queued.type, receipt);
+            if (error == TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ) {
+                blocked.insert(friendId);
+                break;
+            }
+
+            if (error != TOX_ERR_FRIEND_SEND_MESSAGE_OK) {
+                auto& ids = refused[friendId];
+                for (const auto& message : messages) {
+                    ids.append(message.queuedId);
+                }
+                messages.clear();
+                break;
+            }
+
+            emit friendMessageSent(friendId, queued.queuedId, receipt);
+            messages.pop_front();
+        }
+    }
+
+    bool backlog = false;
+    {
+        QMutexLocker locker{&friendSendLock};
+        for (auto& batch : batches) {
+            auto it = queuedFriendMessages.find(batch.first);
+            auto& pending = it->second;
+            auto refusedIt = refused.find(batch.first);
+            if (refusedIt != refused.end()) {
+                // messages queued meanwhile must not overtake the refused ones
+                for (const auto& message : pending) {
+                    refusedIt->second.append(message.queuedId);
+                }
+                pending.clear();
+            } else {
+                pending.insert(pending.begin(), std::make_move_iterator(batch.second.begin()),
+                               std::make_move_iterator(batch.second.end()));
+            }
+
+            if (pending.empty()) {
+                queuedFriendMessages.erase(it);
+            } else if (!blocked.count(batch.first)) {
+                backlog = true;
+            }
+        }
+    }
+
+    for (const auto& ids : refused) {
+        emit friendMessagesRefused(ids.first, ids.second);
+    }
+    return backlog;
 }
 
 void Core::sendTyping(uint32_t friendId, bool typing)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     Tox_Err_Set_Typing error;
     tox_self_set_typing(tox.get(), friendId, typing, &error);
@@ -1280,7 +1871,7 @@ void Core::sendTyping(uint32_t friendId, bool typing)
 
 void Core::sendGroupMessageWithType(int groupId, const QString& message, Tox_Message_Type type)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
         int size = message.toUtf8().size();
@@ -1318,23 +1909,59 @@ void Core::sendGroupMessageWithType(int groupId, const QString& message, Tox_Mes
     }
 }
 
+/**
+ * @brief Queues a group message, it is sent at the start of the next core iteration
+ *
+ * A long paste is split into many messages, sending each of them right away would take
+ * coreLoopLock once per message and stall the GUI whenever toxcore is iterating.
+ */
 void Core::sendGroupMessage(int groupId, const QString& message)
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    sendGroupMessageWithType(groupId, message, TOX_MESSAGE_TYPE_NORMAL);
+    queueGroupMessage(groupId, message, TOX_MESSAGE_TYPE_NORMAL);
 }
 
+/**
+ * @brief Queues a group action, see sendGroupMessage()
+ */
 void Core::sendGroupAction(int groupId, const QString& message)
 {
-    QMutexLocker ml{&coreLoopLock};
+    queueGroupMessage(groupId, message, TOX_MESSAGE_TYPE_ACTION);
+}
+
+void Core::queueGroupMessage(int groupId, const QString& message, Tox_Message_Type type)
+{
+    bool wasEmpty;
+    {
+        QMutexLocker locker{&groupSendLock};
+        wasEmpty = queuedGroupMessages.isEmpty();
+        queuedGroupMessages.append({groupId, message, type});
+    }
+
+    if (wasEmpty) {
+        // don't wait for the rest of the tox iteration interval
+        QMetaObject::invokeMethod(toxTimer, "start", Qt::QueuedConnection, Q_ARG(int, 0));
+    }
+}
+
+/**
+ * @brief Sends all queued group messages in order, under the lock process() already holds
+ */
+void Core::sendQueuedGroupMessages()
+{
+    QVector<QueuedGroupMessage> messages;
+    {
+        QMutexLocker locker{&groupSendLock};
+        messages.swap(queuedGroupMessages);
+    }
 
-    sendGroupMessageWithType(groupId, message, TOX_MESSAGE_TYPE_ACTION);
+    for (const auto& queued : messages) {
+        sendGroupMessageWithType(queued.groupId, queued.message, queued.type);
+    }
 }
 
 void Core::changeGroupTitle(int groupId, const QString& title)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     ToxString cTitle(title);
     Tox_Err_Conference_Title error;
@@ -1347,7 +1974,7 @@ void Core::changeGroupTitle(int groupId, const QString& title)
 
 void Core::removeFriend(uint32_t friendId)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     Tox_Err_Friend_Delete error;
     tox_friend_delete(tox.get(), friendId, &error);
@@ -1356,24 +1983,32 @@ void Core::removeFriend(uint32_t friendId)
         return;
     }
 
+    updateState([friendId](CoreState& next) { next.removeFriend(friendId); });
+    connectionPaths.removeFriend(friendId);
     emit saveRequest();
     emit friendRemoved(friendId);
 }
 
 void Core::removeGroup(int groupId)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
+        groupSyncSender->cancelGroup(groupId - Settings::NGC_GROUPNUM_OFFSET);
+        ngcSyncIndex->removeGroup(groupId);
+        ngcSyncCoordinator.removeGroup(groupId - Settings::NGC_GROUPNUM_OFFSET);
+        groupFileSender->cancelGroup(groupId - Settings::NGC_GROUPNUM_OFFSET);
         Tox_Err_Group_Leave error;
         tox_group_leave(tox.get(), (groupId - Settings::NGC_GROUPNUM_OFFSET), reinterpret_cast<const uint8_t*>("exit"), 4, &error);
         if (PARSE_ERR(error)) {
+            updateState([groupId](CoreState& next) { next.removeGroup(groupId); });
             emit saveRequest();
         }
     } else {
         Tox_Err_Conference_Delete error;
         tox_conference_delete(tox.get(), groupId, &error);
         if (PARSE_ERR(error)) {
+            updateState([groupId](CoreState& next) { next.removeGroup(groupId); });
             emit saveRequest();
 
             /*
@@ -1388,12 +2023,85 @@ void Core::removeGroup(int groupId)
     }
 }
 
+/**
+ * @brief Sends the reply to a history sync request of a group peer.
+ * @param groupnumber Group the request came from, including the NGC offset.
+ * @param peernumber Peer that requested the sync.
+ * @param packets Sync packets built by History, sent paced on their own thread.
+ */
+void Core::queueGroupSyncPackets(int groupnumber, int peernumber, QVector<QByteArray> packets)
+{
+    if (groupnumber < static_cast<int>(Settings::NGC_GROUPNUM_OFFSET) || peernumber < 0) {
+        return;
+    }
+
+    groupSyncSender->enqueue(groupnumber - Settings::NGC_GROUPNUM_OFFSET,
+                             static_cast<uint32_t>(peernumber), std::move(packets));
+}
+
+/**
+ * @brief Sets where images received in NGC groups are stored.
+ * @param store Called from worker threads, returns the id the image is referenced by in the
+ * chat. Set an empty store before the old one is destroyed.
+ */
+/**
+ * @brief Offers a file to the peers of an NGC group, they pull it in chunks.
+ * @param groupId Group to announce the file in.
+ * @param file Content of the file, at most NgcFileTransfer::MAX_FILE_SIZE bytes.
+ * @return False if the file could not be announced.
+ */
+bool Core::sendGroupFile(int groupId, const QByteArray& file)
+{
+    if (groupId < static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
+        return false;
+    }
+
+    const QByteArray announce = ngcPacketReceiver->offerFile(file);
+    if (announce.isEmpty()) {
+        return false;
+    }
+
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+    Tox_Err_Group_Send_Custom_Packet error;
+    tox_group_send_custom_packet(tox.get(), groupId - Settings::NGC_GROUPNUM_OFFSET, true,
+                                 reinterpret_cast<const uint8_t*>(announce.constData()),
+                                 static_cast<size_t>(announce.size()), &error);
+    if (error != TOX_ERR_GROUP_SEND_CUSTOM_PACKET_OK) {
+        qWarning() << "Failed to announce group file, error:" << error;
+        return false;
+    }
+
+    return true;
+}
+
+void Core::setGroupImageStore(std::function<QString(const QByteArray&)> store)
+{
+    ngcPacketReceiver->setImageStore(std::move(store));
+}
+
+/**
+ * @brief Sets where the messages already stored for a group are read from.
+ * @param loader Called on the tox thread the first time a group gets a message, with the
+ * persistent id of the group. Any call in progress is finished when this returns.
+ */
+void Core::setNgcSyncIndexLoader(std::function<QVector<NgcSyncIndex::Entry>(const GroupId&)> loader)
+{
+    if (!loader) {
+        ngcSyncIndex->setLoader({});
+        return;
+    }
+
+    ngcSyncIndex->setLoader([this, loader](int groupnumber) {
+        return loader(getGroupPersistentId(groupnumber - Settings::NGC_GROUPNUM_OFFSET, 1));
+    });
+}
+
 /**
  * @brief Returns our username, or an empty string on failure
  */
 QString Core::getUsername() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     QString sname;
     if (!tox) {
@@ -1411,7 +2119,7 @@ QString Core::getUsername() const
 
 void Core::setUsername(const QString& username)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (username == getUsername()) {
         return;
@@ -1434,7 +2142,7 @@ void Core::setUsername(const QString& username)
  */
 ToxId Core::getSelfId() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     uint8_t friendId[TOX_ADDRESS_SIZE] = {0x00};
     tox_self_get_address(tox.get(), friendId);
@@ -1447,7 +2155,7 @@ ToxId Core::getSelfId() const
  */
 ToxPk Core::getSelfPublicKey() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     uint8_t selfPk[TOX_PUBLIC_KEY_SIZE] = {0x00};
     tox_self_get_public_key(tox.get(), selfPk);
@@ -1456,7 +2164,7 @@ ToxPk Core::getSelfPublicKey() const
 
 QByteArray Core::getSelfDhtId() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
     QByteArray dhtKey(TOX_PUBLIC_KEY_SIZE, 0x00);
     tox_self_get_dht_id(tox.get(), reinterpret_cast<uint8_t*>(dhtKey.data()));
     return dhtKey;
@@ -1464,7 +2172,7 @@ QByteArray Core::getSelfDhtId() const
 
 int Core::getSelfUdpPort() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
     Tox_Err_Get_Port error;
     auto port = tox_self_get_udp_port(tox.get(), &error);
     if (!PARSE_ERR(error)) {
@@ -1478,7 +2186,7 @@ int Core::getSelfUdpPort() const
  */
 QString Core::getStatusMessage() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     assert(tox != nullptr);
 
@@ -1496,14 +2204,14 @@ QString Core::getStatusMessage() const
  */
 Status::Status Core::getStatus() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     return static_cast<Status::Status>(tox_self_get_status(tox.get()));
 }
 
 void Core::setStatusMessage(const QString& message)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (message == getStatusMessage()) {
         return;
@@ -1523,7 +2231,7 @@ void Core::setStatusMessage(const QString& message)
 
 void Core::setStatus(Status::Status status)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     Tox_User_Status userstatus;
     switch (status) {
@@ -1554,7 +2262,7 @@ void Core::setStatus(Status::Status status)
  */
 QByteArray Core::getToxSaveData()
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     uint32_t fileSize = tox_get_savedata_size(tox.get());
     QByteArray data;
@@ -1565,7 +2273,8 @@ QByteArray Core::getToxSaveData()
 
 void Core::loadFriends()
 {
-    QMutexLocker ml{&coreLoopLock};
+    StartupPhase phase{"Core::loadFriends"};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     const size_t friendCount = tox_self_get_friend_list_size(tox.get());
     if (friendCount == 0) {
@@ -1574,6 +2283,17 @@ void Core::loadFriends()
 
     std::vector<uint32_t> ids(friendCount);
     tox_self_get_friend_list(tox.get(), ids.data());
+    updateState([this, &ids](CoreState& next) {
+        for (const auto friendId : ids) {
+            CoreState::Friend friendState;
+            if (queryFriendState(friendId, friendState)) {
+                next.setFriend(friendId, friendState);
+            }
+        }
+    });
+    // a single queued event for the whole friend list, instead of a handful per friend
+    QVector<LoadedFriend> friends;
+    friends.reserve(static_cast<int>(friendCount));
     uint8_t friendPk[TOX_PUBLIC_KEY_SIZE] = {0x00};
     for (size_t i = 0; i < friendCount; ++i) {
         Tox_Err_Friend_Get_Public_Key keyError;
@@ -1581,49 +2301,50 @@ void Core::loadFriends()
         if (!PARSE_ERR(keyError)) {
             continue;
         }
-        emit friendAdded(ids[i], ToxPk(friendPk));
-        emit friendUsernameChanged(ids[i], getFriendUsername(ids[i]));
+        LoadedFriend loaded;
+        loaded.friendId = ids[i];
+        loaded.publicKey = ToxPk(friendPk);
+        loaded.username = getFriendUsername(ids[i]);
         Tox_Err_Friend_Query queryError;
         size_t statusMessageSize = tox_friend_get_status_message_size(tox.get(), ids[i], &queryError);
         if (PARSE_ERR(queryError) && statusMessageSize) {
             std::vector<uint8_t> messageData(statusMessageSize);
             tox_friend_get_status_message(tox.get(), ids[i], messageData.data(), &queryError);
-            QString friendStatusMessage = ToxString(messageData.data(), statusMessageSize).getQString();
-            emit friendStatusMessageChanged(ids[i], friendStatusMessage);
+            loaded.statusMessage = ToxString(messageData.data(), statusMessageSize).getQString();
         }
-        checkLastOnline(ids[i]);
 
-        // HINT: load pushtoken for friend from db, and put it in the Friend object
-        emit friendLoaded(ids[i]);
-        // HINT: update connection status so that the icon get drawn again, and takes pushtoken into account
         Tox_Err_Friend_Query error2;
         Tox_Connection connection_status = tox_friend_get_connection_status(tox.get(), ids[i], &error2);
-        Status::Status friendStatus = Status::Status::Offline;
         switch (connection_status)
         {
-            case TOX_CONNECTION_NONE:
-                friendStatus = Status::Status::Offline;
-                break;
             case TOX_CONNECTION_TCP:
-                friendStatus = Status::Status::Online;
-                break;
             case TOX_CONNECTION_UDP:
-                friendStatus = Status::Status::Online;
+                loaded.status = Status::Status::Online;
                 break;
             default:
-                friendStatus = Status::Status::Offline;
+                loaded.status = Status::Status::Offline;
                 break;
         }
-        // HINT: yes 3 times. we need to force a status change so the UI will update
-        emit friendStatusChanged(ids[i], Status::Status::Online);
-        emit friendStatusChanged(ids[i], Status::Status::Offline);
-        emit friendStatusChanged(ids[i], friendStatus);
+        friends.append(loaded);
     }
+
+    emit friendsLoaded(friends);
 }
 
 void Core::loadGroups()
 {
-    QMutexLocker ml{&coreLoopLock};
+    StartupPhase phase{"Core::loadGroups"};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
+    QVector<LoadedGroup> groups;
+    auto appendLoadedGroup = [&groups](int groupNumber, const GroupId& persistentId,
+                                       const QString& title) {
+        LoadedGroup loaded;
+        loaded.groupNumber = groupNumber;
+        loaded.persistentId = persistentId;
+        loaded.title = title;
+        groups.append(loaded);
+    };
 
     const size_t groupCount = tox_conference_get_chatlist_size(tox.get());
     if (groupCount > 0) {
@@ -1653,7 +2374,8 @@ void Core::loadGroups()
                     qCritical() << "Failed to enable audio on loaded group" << groupNumber;
                 }
             }
-            emit emptyGroupCreated(groupNumber, persistentId, name);
+            updateGroupState(groupNumber);
+            appendLoadedGroup(static_cast<int>(groupNumber), persistentId, name);
         }
     }
 
@@ -1680,14 +2402,19 @@ void Core::loadGroups()
             } else {
                 name = defaultName;
             }
-            emit emptyGroupCreated((Settings::NGC_GROUPNUM_OFFSET + groupNumber), persistentId, name);
+            updateGroupState(Settings::NGC_GROUPNUM_OFFSET + groupNumber);
+            appendLoadedGroup(static_cast<int>(Settings::NGC_GROUPNUM_OFFSET + groupNumber), persistentId, name);
         }
     }
+
+    if (!groups.isEmpty()) {
+        emit groupsLoaded(groups);
+    }
 }
 
 void Core::checkLastOnline(uint32_t friendId)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     Tox_Err_Friend_Get_Last_Online error;
     const uint64_t lastOnline = tox_friend_get_last_online(tox.get(), friendId, &error);
@@ -1701,7 +2428,7 @@ void Core::checkLastOnline(uint32_t friendId)
  */
 QVector<uint32_t> Core::getFriendList() const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     QVector<uint32_t> friends;
     friends.resize(tox_self_get_friend_list_size(tox.get()));
@@ -1711,7 +2438,7 @@ QVector<uint32_t> Core::getFriendList() const
 
 GroupId Core::getGroupPersistentId(uint32_t groupNumber, int is_ngc) const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (is_ngc == 1) {
         std::vector<uint8_t> idBuff(TOX_GROUP_CHAT_ID_SIZE);
@@ -1741,7 +2468,7 @@ GroupId Core::getGroupPersistentId(uint32_t groupNumber, int is_ngc) const
  */
 uint32_t Core::getGroupNumberPeers(int groupId) const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
         Tox_Err_Group_Peer_Query error;
@@ -1767,23 +2494,15 @@ uint32_t Core::getGroupNumberPeers(int groupId) const
  */
 QString Core::getGroupPeerName(int groupId, int peerId) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    Tox_Err_Conference_Peer_Query error;
-    size_t length = tox_conference_peer_get_name_size(tox.get(), groupId, peerId, &error);
-    if (!PARSE_ERR(error) || !length) {
-        qDebug() << "getGroupPeerName:error:1";
-        return QString{};
-    }
-
-    std::vector<uint8_t> nameBuf(length);
-    tox_conference_peer_get_name(tox.get(), groupId, peerId, nameBuf.data(), &error);
-    if (!PARSE_ERR(error)) {
-        qDebug() << "getGroupPeerName:error:2";
+    const auto current = getState();
+    const auto group = current->findGroup(groupId);
+    const auto peer = group ? group->findPeer(peerId) : nullptr;
+    if (!peer || peer->name.isEmpty()) {
+        qDebug() << "getGroupPeerName: Unknown peer or no name";
         return QString{};
     }
 
-    return ToxString(nameBuf.data(), length).getQString();
+    return peer->name;
 }
 
 /**
@@ -1791,28 +2510,15 @@ QString Core::getGroupPeerName(int groupId, int peerId) const
  */
 ToxPk Core::getGroupPeerPk(int groupId, int peerId) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    uint8_t friendPk[TOX_PUBLIC_KEY_SIZE] = {0x00};
-
-    if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
-        Tox_Err_Group_Peer_Query error;
-        tox_group_peer_get_public_key(tox.get(), (groupId - Settings::NGC_GROUPNUM_OFFSET), peerId, friendPk, &error);
-        if (!PARSE_ERR(error)) {
-            qDebug() << "getGroupPeerPk:error:1";
-            return ToxPk{};
-        }
-
-    } else {
-        Tox_Err_Conference_Peer_Query error;
-        tox_conference_peer_get_public_key(tox.get(), groupId, peerId, friendPk, &error);
-        if (!PARSE_ERR(error)) {
-            qDebug() << "getGroupPeerPk:error:2";
-            return ToxPk{};
-        }
+    const auto current = getState();
+    const auto group = current->findGroup(groupId);
+    const auto peer = group ? group->findPeer(peerId) : nullptr;
+    if (!peer) {
+        qDebug() << "getGroupPeerPk: Unknown peer";
+        return ToxPk{};
     }
 
-    return ToxPk(friendPk);
+    return peer->publicKey;
 }
 
 /**
@@ -1820,84 +2526,26 @@ ToxPk Core::getGroupPeerPk(int groupId, int peerId) const
  */
 QStringList Core::getGroupPeerNames(int groupId) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    assert(tox != nullptr);
-
-    if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
-        uint32_t nPeers = getGroupNumberPeers(groupId);
-        if (nPeers == std::numeric_limits<uint32_t>::max()) {
-            qWarning() << "getGroupPeerNames NGC: Unable to get number of peers";
-            return {};
-        }
-
-        Tox_Err_Group_Peer_Query error;
-        uint32_t *peerlist = static_cast<uint32_t *>(calloc(nPeers, sizeof(uint32_t)));
-
-        if (!peerlist) {
-            qWarning() << "getGroupPeerNames NGC: calloc failed";
-            return {};
-        }
-
-        tox_group_get_peerlist(tox.get(), (groupId - Settings::NGC_GROUPNUM_OFFSET), peerlist, &error);
-        if (!PARSE_ERR(error)) {
-            qWarning() << "getGroupPeerNames NGC: Unable to get peerlist";
-            return {};
-        }
-
-        QStringList names;
-        for (int i = 0; i < static_cast<int>(nPeers); ++i) {
-            size_t length = tox_group_peer_get_name_size(tox.get(), (groupId - Settings::NGC_GROUPNUM_OFFSET), *(peerlist + i), &error);
-
-            if (!PARSE_ERR(error) || !length) {
-                names.append(QString());
-                continue;
-            }
-
-            std::vector<uint8_t> nameBuf(length);
-            tox_group_peer_get_name(tox.get(), (groupId - Settings::NGC_GROUPNUM_OFFSET), *(peerlist + i), nameBuf.data(), &error);
-            if (PARSE_ERR(error)) {
-                names.append(QString::number(*(peerlist + i)) + QString(":") + ToxString(nameBuf.data(), length).getQString());
-            } else {
-                qWarning() << "getGroupPeerNames NGC: tox_group_peer_get_name error";
-                names.append(QString());
-            }
-        }
-
-        free(peerlist);
-        assert(names.size() == static_cast<int>(nPeers));
-
-        return names;
-    } else {
-        uint32_t nPeers = getGroupNumberPeers(groupId);
-        if (nPeers == std::numeric_limits<uint32_t>::max()) {
-            qWarning() << "getGroupPeerNames: Unable to get number of peers";
-            return {};
-        }
-
-        QStringList names;
-        for (int i = 0; i < static_cast<int>(nPeers); ++i) {
-            Tox_Err_Conference_Peer_Query error;
-            size_t length = tox_conference_peer_get_name_size(tox.get(), groupId, i, &error);
-
-            if (!PARSE_ERR(error) || !length) {
-                names.append(QString());
-                continue;
-            }
+    const auto current = getState();
+    const auto group = current->findGroup(groupId);
+    if (!group) {
+        qWarning() << "getGroupPeerNames: Unknown group" << groupId;
+        return {};
+    }
 
-            std::vector<uint8_t> nameBuf(length);
-            tox_conference_peer_get_name(tox.get(), groupId, i, nameBuf.data(), &error);
-            if (PARSE_ERR(error)) {
-                names.append(ToxString(nameBuf.data(), length).getQString());
-            } else {
-                names.append(QString());
-            }
+    const bool isNgc = groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET);
+    QStringList names;
+    names.reserve(group->getPeers().size());
+    for (const auto& peer : group->getPeers()) {
+        if (isNgc && !peer.name.isEmpty()) {
+            // NGC peer ids aren't the position in the list, so the caller needs them
+            names.append(QString::number(peer.peerId) + QString(":") + peer.name);
+        } else {
+            names.append(peer.name);
         }
-
-        assert(names.size() == static_cast<int>(nPeers));
-
-        return names;
     }
+
+    return names;
 }
 
 /**
@@ -1910,7 +2558,7 @@ bool Core::getGroupAvEnabled(int groupId) const
     if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
         return TOX_CONFERENCE_TYPE_TEXT;
     } else {
-        QMutexLocker ml{&coreLoopLock};
+        PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
         Tox_Err_Conference_Get_Type error;
         Tox_Conference_Type type = tox_conference_get_type(tox.get(), groupId, &error);
         PARSE_ERR(error);
@@ -1927,7 +2575,7 @@ bool Core::getGroupAvEnabled(int groupId) const
  */
 uint32_t Core::joinGroupchat(const GroupInvite& inviteInfo)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     const uint32_t friendId = inviteInfo.getFriendId();
     const uint8_t confType = inviteInfo.getType();
@@ -1955,6 +2603,7 @@ uint32_t Core::joinGroupchat(const GroupInvite& inviteInfo)
         qWarning() << "joinGroupchat: Unknown groupchat type " << confType;
     }
     if (groupNum != std::numeric_limits<uint32_t>::max()) {
+        updateGroupState(groupNum);
         emit saveRequest();
         emit groupJoined(groupNum, getGroupPersistentId(groupNum, 0));
     }
@@ -1963,7 +2612,7 @@ uint32_t Core::joinGroupchat(const GroupInvite& inviteInfo)
 
 void Core::groupInviteFriend(uint32_t friendId, int groupId)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
         Tox_Err_Group_Invite_Friend error;
@@ -1992,6 +2641,7 @@ void Core::changeOwnNgcName(uint32_t groupnumber, const QString& name)
         if (res == false) {
             qWarning() << "changeOwnNgcName: setting new self name failed";
         } else {
+            updateGroupState(groupnumber);
             emit groupPeerlistChanged(groupnumber);
             emit saveRequest();
         }
@@ -2000,12 +2650,13 @@ void Core::changeOwnNgcName(uint32_t groupnumber, const QString& name)
 
 int Core::createGroup(uint8_t type)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (type == TOX_CONFERENCE_TYPE_TEXT) {
         Tox_Err_Conference_New error;
         uint32_t groupId = tox_conference_new(tox.get(), &error);
         if (PARSE_ERR(error)) {
+            updateGroupState(groupId);
             emit saveRequest();
             emit emptyGroupCreated(groupId, getGroupPersistentId(groupId, 0));
             return groupId;
@@ -2017,6 +2668,7 @@ int Core::createGroup(uint8_t type)
         // only indication of an error
         int groupId = toxav_add_av_groupchat(tox.get(), CoreAV::groupCallCallback, this);
         if (groupId != -1) {
+            updateGroupState(groupId);
             emit saveRequest();
             emit emptyGroupCreated(groupId, getGroupPersistentId(groupId, 0));
         } else {
@@ -2034,12 +2686,9 @@ int Core::createGroup(uint8_t type)
  */
 bool Core::isFriendOnline(uint32_t friendId) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    Tox_Err_Friend_Query error;
-    Tox_Connection connection = tox_friend_get_connection_status(tox.get(), friendId, &error);
-    PARSE_ERR(error);
-    return connection != TOX_CONNECTION_NONE;
+    const auto current = getState();
+    const auto friendState = current->findFriend(friendId);
+    return friendState && friendState->online;
 }
 
 /**
@@ -2047,7 +2696,7 @@ bool Core::isFriendOnline(uint32_t friendId) const
  */
 bool Core::hasFriendWithPublicKey(const ToxPk& publicKey) const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     if (publicKey.isEmpty()) {
         return false;
@@ -2063,7 +2712,7 @@ bool Core::hasFriendWithPublicKey(const ToxPk& publicKey) const
  */
 ToxPk Core::getFriendPublicKey(uint32_t friendNumber) const
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     uint8_t rawid[TOX_PUBLIC_KEY_SIZE];
     Tox_Err_Friend_Get_Public_Key error;
@@ -2081,20 +2730,9 @@ ToxPk Core::getFriendPublicKey(uint32_t friendNumber) const
  */
 QString Core::getFriendUsername(uint32_t friendnumber) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    Tox_Err_Friend_Query error;
-    size_t nameSize = tox_friend_get_name_size(tox.get(), friendnumber, &error);
-    if (!PARSE_ERR(error) || !nameSize) {
-        return QString();
-    }
-
-    std::vector<uint8_t> nameBuf(nameSize);
-    tox_friend_get_name(tox.get(), friendnumber, nameBuf.data(), &error);
-    if (!PARSE_ERR(error)) {
-        return QString();
-    }
-    return ToxString(nameBuf.data(), nameSize).getQString();
+    const auto current = getState();
+    const auto friendState = current->findFriend(friendnumber);
+    return friendState ? friendState->name : QString();
 }
 
 uint64_t Core::getMaxMessageSize() const
@@ -2114,29 +2752,289 @@ uint64_t Core::getMaxMessageSize() const
 
 QString Core::getPeerName(const ToxPk& id) const
 {
-    QMutexLocker ml{&coreLoopLock};
-
-    Tox_Err_Friend_By_Public_Key keyError;
-    uint32_t friendId = tox_friend_by_public_key(tox.get(), id.getData(), &keyError);
-    if (!PARSE_ERR(keyError)) {
+    const auto current = getState();
+    const auto friendState = current->findFriend(id);
+    if (!friendState) {
         qWarning() << "getPeerName: No such peer";
         return {};
     }
 
-    Tox_Err_Friend_Query queryError;
-    const size_t nameSize = tox_friend_get_name_size(tox.get(), friendId, &queryError);
-    if (!PARSE_ERR(queryError) || !nameSize) {
-        return {};
+    return friendState->name;
+}
+
+/**
+ * @brief The currently published state, safe to call from any thread without locking
+ */
+CoreStatePtr Core::getState() const
+{
+    return std::atomic_load(&state);
+}
+
+/**
+ * @brief Publishes a new version of the state
+ * @param change Applied to a copy of the current state
+ */
+void Core::updateState(const std::function<void(CoreState&)>& change)
+{
+    // writers are serialized by the lock, readers only ever load a complete version
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
+    auto next = std::make_shared<CoreState>(*getState());
+    change(*next);
+    next->advanceVersion();
+    std::atomic_store(&state, CoreStatePtr{std::move(next)});
+}
+
+/**
+ * @brief Reads a friend from toxcore again, or drops it if it doesn't exist anymore
+ * @param change Applied on top, for values toxcore just reported through a callback
+ */
+void Core::updateFriendState(uint32_t friendId,
+                             const std::function<void(CoreState::Friend&)>& change)
+{
+    updateState([this, friendId, &change](CoreState& next) {
+        CoreState::Friend friendState;
+        if (!queryFriendState(friendId, friendState)) {
+            next.removeFriend(friendId);
+            return;
+        }
+
+        if (change) {
+            change(friendState);
+        }
+        next.setFriend(friendId, friendState);
+    });
+}
+
+/**
+ * @brief Reads all peers of a group from toxcore again, or drops the group if it is gone
+ */
+void Core::updateGroupState(int groupId)
+{
+    updateState([this, groupId](CoreState& next) {
+        CoreState::Group group;
+        if (queryGroupState(groupId, group)) {
+            next.setGroup(groupId, std::move(group));
+        } else {
+            next.removeGroup(groupId);
+        }
+    });
+}
+
+/**
+ * @brief Reads a single peer from toxcore again, cheaper than updateGroupState() for big groups
+ */
+void Core::updateGroupPeerState(int groupId, uint32_t peerId)
+{
+    updateState([this, groupId, peerId](CoreState& next) {
+        const auto current = next.findGroup(groupId);
+        CoreState::Group group;
+        if (!current) {
+            if (queryGroupState(groupId, group)) {
+                next.setGroup(groupId, std::move(group));
+            }
+            return;
+        }
+
+        group = *current;
+        CoreState::Peer peer;
+        if (queryGroupPeerState(groupId, peerId, peer)) {
+            group.setPeer(peer);
+        } else {
+            group.removePeer(peerId);
+        }
+        next.setGroup(groupId, std::move(group));
+    });
+}
+
+/**
+ * @brief Starts asking peers of a group for the messages we missed while we were away
+ * @param groupNumber Toxcore group number.
+ */
+void Core::startGroupSyncRound(uint32_t groupNumber)
+{
+    // only public groups answer sync requests
+    Tox_Err_Group_State_Queries error;
+    const Tox_Group_Privacy_State privacyState =
+        tox_group_get_privacy_state(tox.get(), groupNumber, &error);
+    if (error != TOX_ERR_GROUP_STATE_QUERIES_OK || privacyState != TOX_GROUP_PRIVACY_STATE_PUBLIC) {
+        return;
     }
 
-    std::vector<uint8_t> nameBuf(nameSize);
-    tox_friend_get_name(tox.get(), friendId, nameBuf.data(), &queryError);
-    if (!PARSE_ERR(queryError)) {
-        qWarning() << "getPeerName: Can't get name of friend " + QString().setNum(friendId);
-        return {};
+    Tox_Err_Group_Self_Query selfError;
+    const uint32_t selfPeerId = tox_group_self_get_peer_id(tox.get(), groupNumber, &selfError);
+    const int groupId = Settings::NGC_GROUPNUM_OFFSET + groupNumber;
+    std::vector<uint32_t> peerIds;
+    const auto current = getState();
+    if (const auto group = current->findGroup(groupId)) {
+        for (const auto& peer : group->getPeers()) {
+            if (selfError != TOX_ERR_GROUP_SELF_QUERY_OK || peer.peerId != selfPeerId) {
+                peerIds.push_back(peer.peerId);
+            }
+        }
     }
 
-    return ToxString(nameBuf.data(), nameSize).getQString();
+    ngcSyncCoordinator.setPeers(groupNumber, std::move(peerIds));
+    ngcSyncCoordinator.startRound(groupNumber, QDateTime::currentMSecsSinceEpoch(),
+                                  ngcSyncIndex->getNewestTimestamp(groupId));
+}
+
+/**
+ * @brief Sends the history sync requests NgcSyncCoordinator spread over time
+ */
+void Core::sendGroupSyncRequests()
+{
+    const char request[] = {0x66, 0x77, static_cast<char>(0x88), 0x11, 0x34, 0x35, 0x1, 0x1};
+    for (const auto& due : ngcSyncCoordinator.takeDueRequests(QDateTime::currentMSecsSinceEpoch())) {
+        qDebug() << "Requesting history sync from peer" << due.peerId << "of group"
+                 << due.groupNumber;
+        Tox_Err_Group_Send_Custom_Private_Packet error;
+        tox_group_send_custom_private_packet(tox.get(), due.groupNumber, due.peerId, true,
+                                             reinterpret_cast<const uint8_t*>(request),
+                                             sizeof(request), &error);
+        if (error != TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_OK) {
+            qDebug() << "Failed to send history sync request, error" << error;
+        }
+    }
+}
+
+void Core::removeGroupPeerState(int groupId, uint32_t peerId)
+{
+    updateState([groupId, peerId](CoreState& next) {
+        const auto current = next.findGroup(groupId);
+        if (!current) {
+            return;
+        }
+
+        CoreState::Group group = *current;
+        group.removePeer(peerId);
+        next.setGroup(groupId, std::move(group));
+    });
+}
+
+/**
+ * @return False if toxcore doesn't know the friend
+ */
+bool Core::queryFriendState(uint32_t friendId, CoreState::Friend& friendState) const
+{
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
+    uint8_t rawPk[TOX_PUBLIC_KEY_SIZE] = {0x00};
+    Tox_Err_Friend_Get_Public_Key keyError;
+    // no PARSE_ERR, asking for removed friends is expected here
+    if (!tox_friend_get_public_key(tox.get(), friendId, rawPk, &keyError)) {
+        return false;
+    }
+    friendState.publicKey = ToxPk(rawPk);
+
+    Tox_Err_Friend_Query error;
+    friendState.name = QString();
+    const size_t nameSize = tox_friend_get_name_size(tox.get(), friendId, &error);
+    if (PARSE_ERR(error) && nameSize) {
+        std::vector<uint8_t> nameBuf(nameSize);
+        tox_friend_get_name(tox.get(), friendId, nameBuf.data(), &error);
+        if (PARSE_ERR(error)) {
+            friendState.name = ToxString(nameBuf.data(), nameSize).getQString();
+        }
+    }
+
+    const Tox_Connection connection = tox_friend_get_connection_status(tox.get(), friendId, &error);
+    friendState.online = PARSE_ERR(error) && connection != TOX_CONNECTION_NONE;
+    return true;
+}
+
+/**
+ * @return False if toxcore doesn't know the group
+ */
+bool Core::queryGroupState(int groupId, CoreState::Group& group) const
+{
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
+    std::vector<uint32_t> peerIds;
+    if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
+        const uint32_t groupNumber = groupId - Settings::NGC_GROUPNUM_OFFSET;
+        Tox_Err_Group_Peer_Query error;
+        const uint32_t count = tox_group_peer_count(tox.get(), groupNumber, &error);
+        if (error != TOX_ERR_GROUP_PEER_QUERY_OK) {
+            return false;
+        }
+
+        peerIds.resize(count);
+        tox_group_get_peerlist(tox.get(), groupNumber, peerIds.data(), &error);
+        if (!PARSE_ERR(error)) {
+            return false;
+        }
+    } else {
+        Tox_Err_Conference_Peer_Query error;
+        const uint32_t count = tox_conference_peer_count(tox.get(), groupId, &error);
+        if (error != TOX_ERR_CONFERENCE_PEER_QUERY_OK) {
+            return false;
+        }
+
+        // conference peers are numbered by their position
+        for (uint32_t i = 0; i < count; ++i) {
+            peerIds.push_back(i);
+        }
+    }
+
+    QVector<CoreState::Peer> peers;
+    peers.reserve(static_cast<int>(peerIds.size()));
+    for (const auto peerId : peerIds) {
+        CoreState::Peer peer;
+        // keep peers we can't query, so the list matches toxcore's
+        queryGroupPeerState(groupId, peerId, peer);
+        peers.append(peer);
+    }
+
+    group.setPeers(std::move(peers));
+    return true;
+}
+
+/**
+ * @return False if toxcore doesn't know the peer
+ */
+bool Core::queryGroupPeerState(int groupId, uint32_t peerId, CoreState::Peer& peer) const
+{
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
+
+    peer.peerId = peerId;
+    peer.publicKey = ToxPk{};
+    peer.name = QString();
+
+    uint8_t rawPk[TOX_PUBLIC_KEY_SIZE] = {0x00};
+    std::vector<uint8_t> nameBuf;
+    if (groupId >= static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
+        const uint32_t groupNumber = groupId - Settings::NGC_GROUPNUM_OFFSET;
+        Tox_Err_Group_Peer_Query error;
+        if (!tox_group_peer_get_public_key(tox.get(), groupNumber, peerId, rawPk, &error)) {
+            return false;
+        }
+
+        const size_t length = tox_group_peer_get_name_size(tox.get(), groupNumber, peerId, &error);
+        nameBuf.resize(length);
+        if (error != TOX_ERR_GROUP_PEER_QUERY_OK || !length
+            || !tox_group_peer_get_name(tox.get(), groupNumber, peerId, nameBuf.data(), &error)) {
+            nameBuf.clear();
+        }
+    } else {
+        Tox_Err_Conference_Peer_Query error;
+        if (!tox_conference_peer_get_public_key(tox.get(), groupId, peerId, rawPk, &error)) {
+            return false;
+        }
+
+        const size_t length = tox_conference_peer_get_name_size(tox.get(), groupId, peerId, &error);
+        nameBuf.resize(length);
+        if (error != TOX_ERR_CONFERENCE_PEER_QUERY_OK || !length
+            || !tox_conference_peer_get_name(tox.get(), groupId, peerId, nameBuf.data(), &error)) {
+            nameBuf.clear();
+        }
+    }
+
+    peer.publicKey = ToxPk(rawPk);
+    if (!nameBuf.empty()) {
+        peer.name = ToxString(nameBuf.data(), nameBuf.size()).getQString();
+    }
+    return true;
 }
 
 /**
@@ -2145,7 +3043,7 @@ QString Core::getPeerName(const ToxPk& id) const
  */
 void Core::setNospam(uint32_t nospam)
 {
-    QMutexLocker ml{&coreLoopLock};
+    PROFILED_MUTEX_LOCKER(ml, &coreLoopLock, "Core::coreLoopLock");
 
     tox_self_set_nospam(tox.get(), nospam);
     emit idSet(getSelfId());
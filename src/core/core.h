@@ -20,11 +20,19 @@
 
 #pragma once
 
+#include "bootstrapnoderanking.h"
+#include "connectionpathstats.h"
+#include "corestate.h"
+#include "custompacketregistry.h"
 #include "groupid.h"
 #include "icorefriendmessagesender.h"
 #include "icoregroupmessagesender.h"
 #include "icoregroupquery.h"
 #include "icoreidhandler.h"
+#include "lanpeercache.h"
+#include "loopstats.h"
+#include "ngcsynccoordinator.h"
+#include "ngcsyncindex.h"
 #include "receiptnum.h"
 #include "toxfile.h"
 #include "toxid.h"
@@ -35,16 +43,26 @@
 #include "src/model/status.h"
 #include <tox/tox.h>
 
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
 #include <QMutex>
 #include <QObject>
 #include <QThread>
 #include <QTimer>
+#include <QVector>
 
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 
+class BootstrapNodeProber;
 class CoreAV;
 class CoreFile;
+class GroupSyncSender;
+class NgcPacketReceiver;
+class ToxEventReplayer;
 class CoreExt;
 class IAudioControl;
 class ICoreSettings;
@@ -56,6 +74,22 @@ struct DhtServer;
 
 using ToxCorePtr = std::unique_ptr<Core>;
 
+struct LoadedFriend
+{
+    uint32_t friendId = 0;
+    ToxPk publicKey;
+    QString username;
+    QString statusMessage;
+    Status::Status status = Status::Status::Offline;
+};
+
+struct LoadedGroup
+{
+    int groupNumber = 0;
+    GroupId persistentId;
+    QString title;
+};
+
 class Core : public QObject,
              public ICoreFriendMessageSender,
              public ICoreIdHandler,
@@ -112,6 +146,7 @@ public:
 
     QByteArray getSelfDhtId() const;
     int getSelfUdpPort() const;
+    ConnectionPathStats::Snapshot getFriendConnectionPath(uint32_t friendId) const;
 
 public slots:
     void start();
@@ -132,12 +167,16 @@ public slots:
     void setUsername(const QString& username);
     void setStatusMessage(const QString& message);
 
-    bool sendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt) override;
+    uint64_t queueMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp) override;
     void sendGroupMessage(int groupId, const QString& message) override;
     void sendGroupAction(int groupId, const QString& message) override;
     void changeGroupTitle(int groupId, const QString& title);
-    bool sendAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt) override;
+    uint64_t queueAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp) override;
     void sendTyping(uint32_t friendId, bool typing);
+    void queueGroupSyncPackets(int groupnumber, int peernumber, QVector<QByteArray> packets);
+    bool sendGroupFile(int groupId, const QByteArray& file);
+    void setGroupImageStore(std::function<QString(const QByteArray&)> store);
+    void setNgcSyncIndexLoader(std::function<QVector<NgcSyncIndex::Entry>(const GroupId&)> loader);
 
     void setNospam(uint32_t nospam);
 
@@ -178,31 +217,57 @@ signals:
     void onFriendConnectionStatusFullChanged(uint32_t friendId, uint32_t status);
     void friendStatusMessageChanged(uint32_t friendId, const QString& message);
     void friendUsernameChanged(uint32_t friendId, const QString& username);
-    void friendLoaded(uint32_t friendId);
+    void friendsLoaded(const QVector<LoadedFriend>& friends);
     void friendTypingChanged(uint32_t friendId, bool isTyping);
 
     void friendRemoved(uint32_t friendId);
     void friendLastSeenChanged(uint32_t friendId, const QDateTime& dateTime);
 
     void emptyGroupCreated(int groupnumber, const GroupId groupId, const QString& title = QString());
+    void groupsLoaded(const QVector<LoadedGroup>& groups);
     void groupInviteReceived(const GroupInvite& inviteInfo);
     void groupMessageReceived(int groupnumber, int peernumber, const QString& message, bool isAction, bool isPrivate = false, const int hasIdType = 0);
-    void groupMessageReceivedImage(int groupnumber, int peernumber, const QByteArray& image_bytes, size_t length, bool isAction, const int hasIdType = 0);
+    void groupMessageReceivedImage(int groupnumber, int peernumber, const ToxPk& author, const QString& imageId);
     void groupSyncHistoryReqReceived(int groupnumber, int peernumber, ToxPk peerPk);
+    void groupSyncMessageReceived(int groupnumber, const ToxPk& sender, const QDateTime& timestamp,
+                                  const QString& message);
     void groupNamelistChanged(int groupnumber, int peernumber, uint8_t change);
     void groupPeerlistChanged(int groupnumber);
     void groupPeerNameChanged(int groupnumber, const ToxPk& peerPk, const QString& newName);
+    void groupPeerJoined(int groupnumber, uint32_t peerId, const ToxPk& peerPk, const QString& name);
+    void groupPeerExited(int groupnumber, uint32_t peerId, const ToxPk& peerPk);
+    void groupPeerRenamed(int groupnumber, uint32_t peerId, const ToxPk& peerPk,
+                          const QString& name);
     void groupTitleChanged(int groupnumber, const QString& author, const QString& title);
-    void groupPeerAudioPlaying(int groupnumber, ToxPk peerPk);
     void groupSentFailed(int groupId);
     void groupJoined(int groupnumber, GroupId groupId);
     void actionSentResult(uint32_t friendId, const QString& action, int success);
 
     void receiptRecieved(int friedId, ReceiptNum receipt);
+    void friendMessageSent(uint32_t friendId, uint64_t queuedId, ReceiptNum receipt);
+    void friendMessagesRefused(uint32_t friendId, const QVector<uint64_t>& queuedIds);
 
     void failedToRemoveFriend(uint32_t friendId);
 
 private:
+    // calls the toxcore callbacks to replay recorded traffic
+    friend class ToxEventReplayer;
+
+    // all NGC custom packets start with these magic bytes, then a version and a type byte
+    using NgcPacketHeader = CustomPacketHeader<2, 0x66, 0x77, 0x88, 0x11, 0x34, 0x35>;
+    // custom lossless packets to friends only have their packet id
+    using LosslessPacketHeader = CustomPacketHeader<1>;
+    struct NgcPacketSource
+    {
+        uint32_t groupNumber;
+        // including the NGC offset
+        int groupnumber;
+        uint32_t peerId;
+        ToxPk author;
+    };
+    using NgcPacketRegistry = CustomPacketRegistry<NgcPacketHeader, NgcPacketSource>;
+    using LosslessPacketRegistry = CustomPacketRegistry<LosslessPacketHeader, uint32_t>;
+
     Core(QThread* coreThread_, IBootstrapListGenerator& bootstrapListGenerator_, ICoreSettings& settings_);
 
     static void onFriendRequest(Tox* tox, const uint8_t* cFriendPk, const uint8_t* cMessage,
@@ -241,6 +306,9 @@ private:
         size_t length, void* vCore);
     static void onNgcGroupCustomPrivatePacket(Tox* tox, uint32_t group_number, uint32_t peer_id, const uint8_t *data,
         size_t length, void* vCore);
+    void onNgcSyncRequestPacket(const NgcPacketSource& source, const QByteArray& packet);
+    void onNgcSyncMessagePacket(const NgcPacketSource& source, const QByteArray& packet);
+    void onNgcSyncFilePacket(const NgcPacketSource& source, const QByteArray& packet);
 
     static void onGroupMessage(Tox* tox, uint32_t groupId, uint32_t peerId, Tox_Message_Type type,
                                const uint8_t* cMessage, size_t length, void* vCore);
@@ -252,26 +320,54 @@ private:
 
     static void onLosslessPacket(Tox* tox, uint32_t friendId,
                                    const uint8_t* data, size_t length, void* core);
+    void onPushtokenPacket(uint32_t friendId, const QByteArray& packet);
+    void onLanPeerPacket(uint32_t friendId, const QByteArray& packet);
     static void onReadReceiptCallback(Tox* tox, uint32_t friendId, uint32_t receipt, void* core);
 
     void sendGroupMessageWithType(int groupId, const QString& message, Tox_Message_Type type);
-    bool sendMessageWithType(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp,
-                               Tox_Message_Type type, ReceiptNum& receipt);
-    bool checkConnection();
+    void queueGroupMessage(int groupId, const QString& message, Tox_Message_Type type);
+    void sendQueuedGroupMessages();
+    uint64_t queueFriendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash,
+                                const QDateTime& timestamp, Tox_Message_Type type);
+    bool sendQueuedFriendMessages();
+    Tox_Err_Friend_Send_Message sendMessageWithType(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp,
+                                                    Tox_Message_Type type, ReceiptNum& receipt);
 
     void makeTox(QByteArray savedata, ICoreSettings* s);
     void loadFriends();
     void loadGroups();
     void bootstrapDht();
+    void bootstrapLanPeers();
+    bool canUseLanPeers() const;
+    void sendLanAnnouncement(uint32_t friendId);
+    void probeBootstrapNodes();
+    void rememberConnectFastState();
 
     void checkLastOnline(uint32_t friendId);
+    void recordConnectionPath(uint32_t friendId, Tox_Connection status);
+
+    CoreStatePtr getState() const;
+    void updateState(const std::function<void(CoreState&)>& change);
+    void updateFriendState(uint32_t friendId,
+                           const std::function<void(CoreState::Friend&)>& change = {});
+    void updateGroupState(int groupId);
+    void updateGroupPeerState(int groupId, uint32_t peerId);
+    void removeGroupPeerState(int groupId, uint32_t peerId);
+    void startGroupSyncRound(uint32_t groupNumber);
+    void sendGroupSyncRequests();
+    bool queryFriendState(uint32_t friendId, CoreState::Friend& friendState) const;
+    bool queryGroupState(int groupId, CoreState::Group& group) const;
+    bool queryGroupPeerState(int groupId, uint32_t peerId, CoreState::Peer& peer) const;
 
     QString getFriendRequestErrorMessage(const ToxId& friendId, const QString& message) const;
     static void registerCallbacks(Tox* tox);
+    void registerPacketHandlers();
 
 private slots:
     void process();
     void onStarted();
+    void onConnectionWatchdog();
+    void onBootstrapProbeFinished();
 
 private:
     struct ToxDeleter
@@ -282,14 +378,28 @@ private:
             tox_kill(tox_);
         }
     };
-    /* Using the now commented out statements in checkConnection(), I watched how
-    * many ticks disconnects-after-initial-connect lasted. Out of roughly 15 trials,
-    * 5 disconnected; 4 were DCd for less than 20 ticks, while the 5th was ~50 ticks.
-    * So I set the tolerance here at 25, and initial DCs should be very rare now.
-    * This should be able to go to 50 or 100 without affecting legitimate disconnects'
-    * downtime, but lets be conservative for now. Edit: now ~~40~~ 30.
+    /* Disconnects after the initial connect used to be measured in tox_iterate ticks, and
+    * almost all of them lasted less than 20 ticks, about a second. So we give toxcore a couple
+    * of watchdog ticks to reconnect on its own before bootstrapping again, and wait three
+    * times as long after that bootstrap.
     */
-    #define CORE_DISCONNECT_TOLERANCE 30
+    static constexpr int CONNECTION_WATCHDOG_INTERVAL_MS = 1000;
+    static constexpr int DISCONNECT_TOLERANCE_TICKS = 2;
+    static constexpr qint64 TOX_INTERVAL_REFRESH_MS = 250;
+    // a connection lasting a minute is good enough to start from next time
+    static constexpr int STABLE_CONNECTION_TICKS = 60;
+    static constexpr qint64 RESUME_GAP_MS = 30 * 1000;
+    static constexpr qint64 LOOP_STALL_MS = 200;
+    // per friend and iteration, so a long backlog doesn't delay tox_iterate
+    static constexpr size_t FRIEND_SEND_BATCH_SIZE = 32;
+    static constexpr uint8_t NGC_PACKET_VERSION = 0x1;
+    static constexpr uint8_t NGC_SYNC_REQUEST = 0x1;
+    static constexpr uint8_t NGC_SYNC_MESSAGE = 0x2;
+    static constexpr uint8_t NGC_SYNC_FILE = 0x3;
+    // CONTROL_PROXY_MESSAGE_TYPE_PUSH_URL_FOR_FRIEND
+    static constexpr uint8_t PUSH_URL_PACKET_ID = 181;
+    // our DHT key and LAN addresses for friends on the same network, see LanPeerCache
+    static constexpr uint8_t LAN_PEER_PACKET_ID = 185;
 
     using ToxPtr = std::unique_ptr<Tox, ToxDeleter>;
     ToxPtr tox;
@@ -297,13 +407,60 @@ private:
     std::unique_ptr<CoreFile> file;
     CoreAV* av = nullptr;
     std::unique_ptr<CoreExt> ext;
+    std::unique_ptr<GroupSyncSender> groupSyncSender;
+    std::unique_ptr<GroupSyncSender> groupFileSender;
+    std::unique_ptr<NgcPacketReceiver> ngcPacketReceiver;
+    std::unique_ptr<NgcSyncIndex> ngcSyncIndex;
+    std::unique_ptr<NgcPacketRegistry> ngcPackets;
+    std::unique_ptr<NgcPacketRegistry> ngcPrivatePackets;
+    std::unique_ptr<LosslessPacketRegistry> losslessPackets;
+    NgcSyncCoordinator ngcSyncCoordinator;
     QTimer* toxTimer = nullptr;
+    QTimer* connectionWatchdog = nullptr;
+    BootstrapNodeProber* nodeProber = nullptr;
+    BootstrapNodeRanking nodeRanking;
+    LanPeerCache lanPeers;
+    ConnectionPathStats connectionPaths;
+    QList<ToxPk> lastBootstrapNodes;
+    int connectedTicks = 0;
+    qint64 lastWatchdogMs = 0;
+    QElapsedTimer toxIntervalAge;
+    LoopStats loopStats{QStringLiteral("Core"), LOOP_STALL_MS};
+    unsigned toxIterationInterval = 0;
     // recursive, since we might call our own functions
     mutable CompatibleRecursiveMutex coreLoopLock;
 
+    struct QueuedGroupMessage
+    {
+        int groupId;
+        QString message;
+        Tox_Message_Type type;
+    };
+    // filled without coreLoopLock, so sending doesn't wait for tox_iterate
+    QMutex groupSendLock;
+    QVector<QueuedGroupMessage> queuedGroupMessages;
+
+    struct QueuedFriendMessage
+    {
+        uint64_t queuedId;
+        QString message;
+        QString id_or_hash;
+        QDateTime timestamp;
+        Tox_Message_Type type;
+    };
+    // same as the group messages, kept in order per friend until toxcore takes them
+    QMutex friendSendLock;
+    std::map<uint32_t, std::deque<QueuedFriendMessage>> queuedFriendMessages;
+    uint64_t nextQueuedId = 0;
+
     std::unique_ptr<QThread> coreThread;
     const IBootstrapListGenerator& bootstrapListGenerator;
     ICoreSettings& settings;
     bool isConnected = false;
-    int tolerance = CORE_DISCONNECT_TOLERANCE;
+    // Only replaced under coreLoopLock, read without it through getState()
+    CoreStatePtr state = std::make_shared<const CoreState>();
+    int tolerance = DISCONNECT_TOLERANCE_TICKS;
 };
+
+Q_DECLARE_METATYPE(LoadedFriend)
+Q_DECLARE_METATYPE(LoadedGroup)
@@ -0,0 +1,140 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "coreaudiosender.h"
+#include "coreav.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+/**
+ * @class CoreAudioSender
+ * @brief Thread running echo cancellation and toxav_audio_send_frame for captured audio.
+ *
+ * The capture thread only copies its frame into a preallocated single producer, single consumer
+ * queue and wakes this thread up, so filtering and a busy toxav lock never stall the capture
+ * device. If this thread falls behind, new frames are dropped instead of blocking the producer.
+ *
+ * @note enqueue() must always be called from the same thread, which is the OpenAL audio thread.
+ */
+
+constexpr size_t CoreAudioSender::MAX_FRAME_SAMPLES;
+
+CoreAudioSender::CoreAudioSender(CoreAV& av_)
+    : av{av_}
+{
+    setObjectName("qTox AudioSend");
+    clock.start();
+}
+
+CoreAudioSender::~CoreAudioSender()
+{
+    stop();
+}
+
+/**
+ * @brief Queues a captured frame for sending.
+ * @param callId Id of friend in call list.
+ * @param pcm An array of audio samples (Pulse-code modulation).
+ * @param samples Number of samples per channel in this frame.
+ * @param chans Number of audio channels.
+ * @param rate Audio sampling rate used in this frame.
+ * @return False if the frame was dropped.
+ */
+bool CoreAudioSender::enqueue(uint32_t callId, const int16_t* pcm, size_t samples, uint8_t chans,
+                              uint32_t rate)
+{
+    const size_t total = samples * chans;
+    if (!running || total > MAX_FRAME_SAMPLES) {
+        return false;
+    }
+
+    Frame* frame = queue.producerSlot();
+    if (!frame) {
+        ++droppedFrames;
+        return false;
+    }
+
+    frame->callId = callId;
+    frame->rate = rate;
+    frame->samples = samples;
+    frame->chans = chans;
+    frame->queuedNs = clock.nsecsElapsed();
+    std::copy(pcm, pcm + total, frame->pcm.begin());
+    queue.commitPush();
+    pending.release();
+    return true;
+}
+
+/**
+ * @brief Starts the send thread with the highest priority the platform allows.
+ */
+void CoreAudioSender::startSending()
+{
+    if (running.exchange(true)) {
+        return;
+    }
+
+    start(QThread::TimeCriticalPriority);
+}
+
+/**
+ * @brief Stops the thread and waits for it to finish, queued frames are discarded.
+ */
+void CoreAudioSender::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    pending.release();
+    wait();
+}
+
+uint64_t CoreAudioSender::getDroppedFrames() const
+{
+    return droppedFrames;
+}
+
+void CoreAudioSender::run()
+{
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("Audio Send"));
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::RealtimeAudio);
+    while (true) {
+        pending.acquire();
+        if (!running) {
+            break;
+        }
+
+        Frame* frame = queue.consumerSlot();
+        if (!frame) {
+            continue;
+        }
+
+        const qreal queuedMs = (clock.nsecsElapsed() - frame->queuedNs) / 1000000.0;
+        av.sendCallAudio(frame->callId, frame->pcm.data(), frame->samples, frame->chans,
+                         frame->rate, queuedMs);
+        queue.commitPop();
+    }
+
+    ThreadCpuTime::unregisterCurrentThread();
+}
@@ -20,51 +20,47 @@
 
 #include "coreav.h"
 #include "audio/iaudiosettings.h"
+#include "callaudiodsp.h"
+#include "callaudioresilience.h"
+#include "callratecontroller.h"
+#include "callvideoladder.h"
 #include "core.h"
+#include "coreaudiosender.h"
+#include "coregroupaudioreceiver.h"
+#include "corevideosender.h"
+#include "latencyhistogram.h"
+#include "nearendmixer.h"
+#include "voiceactivitydetector.h"
 #include "src/model/friend.h"
 #include "src/model/group.h"
 #include "src/persistence/igroupsettings.h"
+#include "src/video/camerasource.h"
 #include "src/video/corevideosource.h"
 #include "src/video/videoframe.h"
+#include "src/video/videosurface.h"
 #include "util/compatiblerecursivemutex.h"
+#include "util/lockprofiler.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
 #include "util/toxcoreerrorparser.h"
+#include "util/tracer.h"
+#ifdef QTOX_PLATFORM_EXT
+#include "src/platform/keypress.h"
+#endif
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
 #include <QMutex>
+#include <QStringList>
 #include <QThread>
 #include <QTimer>
 #include <QtConcurrent/QtConcurrentRun>
 
 #include <tox/toxav.h>
 
-#define MINIAUDIO_IMPLEMENTATION
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpragmas"
-#pragma GCC diagnostic ignored "-Wunknown-pragmas"
-#pragma GCC diagnostic ignored "-Wdouble-promotion"
-#pragma GCC diagnostic ignored "-Watomic-implicit-seq-cst"
-#pragma GCC diagnostic ignored "-Wbad-function-cast"
-#pragma GCC diagnostic ignored "-Wswitch-enum"
-#pragma GCC diagnostic ignored "-Wvector-conversion"
-#pragma GCC diagnostic ignored "-Wtautological-type-limit-compare"
-#pragma GCC diagnostic ignored "-Wmissing-declarations"
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-#pragma GCC diagnostic ignored "-Wunused-function"
-#pragma GCC diagnostic ignored "-Wnull-dereference"
-#ifndef __APPLE__
-#pragma GCC diagnostic ignored "-Wstringop-overflow="
-#pragma GCC diagnostic ignored "-Wstringop-overflow"
-#endif
-#pragma GCC diagnostic ignored "-Wshadow"
-#pragma GCC diagnostic ignored "-Wformat"
-#pragma GCC diagnostic ignored "-Wpedantic"
-#pragma GCC diagnostic ignored "-Wextra"
-#pragma GCC diagnostic ignored "-Wall"
-#include "miniaudio.h"
-#pragma GCC diagnostic pop
-
-
+#include <algorithm>
 #include <cassert>
 
 #ifdef QTDEBUGMUTEXLOCKS
@@ -98,6 +94,32 @@ void my_wunlock_aux(const char *file, int line, const char *function)
 #define my_unlockwritelock() do {} while(0)
 #endif
 
+namespace {
+/**
+ * @brief Name of the thread that used the most CPU time between two samples.
+ */
+QString busiestThread(const QVector<ThreadCpuTime::Sample>& before,
+                      const QVector<ThreadCpuTime::Sample>& now)
+{
+    QString busiest = QStringLiteral("unknown");
+    qint64 busiestNs = 0;
+    for (const ThreadCpuTime::Sample& sample : now) {
+        qint64 usedNs = sample.cpuNs;
+        for (const ThreadCpuTime::Sample& old : before) {
+            if (old.name == sample.name) {
+                usedNs -= old.cpuNs;
+                break;
+            }
+        }
+        if (usedNs > busiestNs) {
+            busiest = sample.name;
+            busiestNs = usedNs;
+        }
+    }
+    return busiest;
+}
+} // namespace
+
 /**
  * @fn void CoreAV::avInvite(uint32_t friendId, bool video)
  * @brief Sent when a friend calls us.
@@ -115,8 +137,33 @@ void my_wunlock_aux(const char *file, int line, const char *function)
  *
  * @var CoreAV::VIDEO_DEFAULT_BITRATE
  * @brief Picked at random by fair dice roll.
+ *
+ * @var CoreAV::AUDIO_LOOP_STALL_MS
+ * @brief Audio iterations taking longer than a frame are logged.
+ *
+ * @var CoreAV::VIDEO_LOOP_STALL_MS
+ * @brief Video iterations taking longer than a few frames are logged.
+ *
+ * @var CoreAV::CPU_SAMPLE_MS
+ * @brief Interval the CPU governor samples the process at.
+ *
+ * @var CoreAV::CPU_CORES_PER_CALL
+ * @brief Cores a single call may keep busy, enough for 720p in software.
+ *
+ * @var CoreAV::MAX_CPU_SHARE
+ * @brief Share of all cores the calls together may use, the rest is left for the desktop.
+ *
+ * @var CoreAV::GOVERNED_RUNG_INDEX
+ * @brief Biggest CallVideoLadder rung we send while the governor limits the resolution.
  */
 
+constexpr int CoreAV::CPU_SAMPLE_MS;
+constexpr double CoreAV::CPU_CORES_PER_CALL;
+constexpr double CoreAV::MAX_CPU_SHARE;
+constexpr int CoreAV::GOVERNED_PREVIEW_FPS;
+constexpr int CoreAV::GOVERNED_RUNG_INDEX;
+constexpr int CoreAV::GOVERNED_VIDEO_FPS;
+
 /**
  * @var std::atomic_flag CoreAV::threadSwitchLock
  * @brief This flag is to be acquired before switching in a blocking way between the UI and CoreAV
@@ -125,120 +172,99 @@ void my_wunlock_aux(const char *file, int line, const char *function)
  * The CoreAV thread must have priority for the flag, other threads should back off or release it
  * quickly.
  * CoreAV needs to interface with three threads, the toxcore/Core thread that fires non-payload
- * toxav callbacks, the toxav/CoreAV thread that fires AV payload callbacks and manages
+ * toxav callbacks, the toxav/CoreAV thread that fires audio payload callbacks and manages
  * most of CoreAV's members, and the UI thread, which calls our [start/answer/cancel]Call functions
  * and which we call via signals.
  * When the UI calls us, we switch from the UI thread to the CoreAV thread to do the processing,
  * when toxcore fires a non-payload av callback, we do the processing in the CoreAV thread and then
  * switch to the UI thread to send it a signal. Both switches block both threads, so this would
  * deadlock.
+ * Video is iterated on a separate thread, so decoding a large video frame never delays the
+ * audio iteration. Video payload callbacks come from that thread.
+ * Conference audio is decoded on the Core thread and only queued there, it is mixed and played on
+ * the group audio thread, see CoreGroupAudioReceiver.
+ *
+ * Friend calls are read from an immutable snapshot, see loadCalls(), so the audio and video hot
+ * paths never take a lock. Writers copy the snapshot, modify the copy and publish it while
+ * holding callsLock, which still protects the group calls.
  */
 
-ma_resampler_config miniaudio_downsample_config;
-ma_resampler miniaudio_downsample_resampler;
-ma_resampler_config miniaudio_upsample_config;
-ma_resampler miniaudio_upsample_resampler;
-
 CoreAV::CoreAV(std::unique_ptr<ToxAV, ToxAVDeleter> toxav_, CompatibleRecursiveMutex& toxCoreLock,
                IAudioSettings& audioSettings_, IGroupSettings& groupSettings_, CameraSource& cameraSource_)
     : audio{nullptr}
     , toxav{std::move(toxav_)}
     , coreavThread{new QThread{this}}
+    , videoIterateThread{new QThread{this}}
+    , audioSender{new CoreAudioSender{*this}}
+    , groupAudioReceiver{new CoreGroupAudioReceiver{*this}}
+    , videoSender{new CoreVideoSender{*this}}
     , iterateTimer{new QTimer{this}}
+    , videoIterateTimer{new QTimer}
+    , governorTimer{new QTimer{this}}
     , coreLock{toxCoreLock}
     , audioSettings{audioSettings_}
     , groupSettings{groupSettings_}
     , cameraSource{cameraSource_}
+    , videoEncoderPreset{audioSettings_.getVideoEncoderPreset()}
 {
     assert(coreavThread);
+    assert(videoIterateThread);
     assert(iterateTimer);
+    assert(videoIterateTimer);
+    assert(governorTimer);
 
-    // filteraudio:X //
-    assert(IAudioControl::AUDIO_SAMPLE_RATE == 48000);
-
-
-
-    // ----------------------------------------------------------
-    // Audio Resampling
-    //
-    miniaudio_downsample_config = ma_resampler_config_init(
-        ma_format_s16,
-        1,
-        48000,
-        16000,
-        ma_resample_algorithm_linear);
-
-    ma_result result1 = ma_resampler_init(&miniaudio_downsample_config, nullptr, &miniaudio_downsample_resampler);
-    if (result1 != MA_SUCCESS) {
-        qDebug() << "ma_resampler_init downsample -----> ERROR";
-    }
-    ma_resampler_set_rate(&miniaudio_downsample_resampler, 48000, 16000);
-
-    miniaudio_upsample_config = ma_resampler_config_init(
-        ma_format_s16,
-        1,
-        16000,
-        48000,
-        ma_resample_algorithm_linear);
-
-    ma_result result2 = ma_resampler_init(&miniaudio_upsample_config, nullptr, &miniaudio_upsample_resampler);
-    if (result2 != MA_SUCCESS) {
-        qDebug() << "ma_resampler_init upsample -----> ERROR";
-    }
-    ma_resampler_set_rate(&miniaudio_upsample_resampler, 16000, 48000);
-    //
-    // ----------------------------------------------------------
-
-
-
-    // ----------------------------------------------------------
-    // Acoustic Echo Cancellation
-    //
-    webrtc_aecmInst = WebRtcAecm_Create();
-    int32_t res1 = WebRtcAecm_Init(webrtc_aecmInst, (int32_t)(IAudioControl::AUDIO_SAMPLE_RATE / 3));
-    qDebug() << "WebRtcAecm_Init ----->" << res1;
-    // ----------------------------------------------------------
-    // typedef struct {
-    //     int16_t cngMode;            // AecmFalse, AecmTrue (default)
-    //     int16_t echoMode;           // 0, 1, 2, 3 (default), 4
-    // } AecmConfig;
-    // ----------------------------------------------------------
-    AecmConfig config;
-    config.echoMode = AecmTrue;
-    config.cngMode = audioSettings.getAecechomode();
-    WebRtcAecm_set_config(webrtc_aecmInst, config);
-    qDebug() << "WebRtcAecm_set_config ----->" << audioSettings.getAecechomode();
-    //
-    // ----------------------------------------------------------
-
-
-
-    // ----------------------------------------------------------
-    // Noise Suppression
-    //
-    nsxInst = WebRtcNsx_Create();
-    int res2 = WebRtcNsx_Init(nsxInst, (int32_t)(IAudioControl::AUDIO_SAMPLE_RATE / 3));
-    qDebug() << "WebRtcNsx_Init ----->" << res2;
-    // ----------------------------------------------------------
-    // mode          : 0: Mild, 1: Medium , 2: Aggressive, 3: more Aggressive
-    // ----------------------------------------------------------
-    int res3 = WebRtcNsx_set_policy(nsxInst, audioSettings.getAecechonsmode());
-    qDebug() << "WebRtcNsx_set_policy: mode: " <<  audioSettings.getAecechonsmode() << "res :----->" << res3;
-    //
-    // ----------------------------------------------------------
-
+    rateClock.start();
 
+    assert(IAudioControl::AUDIO_SAMPLE_RATE == CallAudioDsp::INPUT_SAMPLE_RATE);
 
     coreavThread->setObjectName("qTox CoreAV");
     moveToThread(coreavThread.get());
 
     connectCallbacks();
 
+    audioSettings.connectTo_videoEncoderPresetChanged(this, [this](int preset) {
+        videoEncoderPreset = preset;
+    });
+
     iterateTimer->setSingleShot(true);
+    iterateTimer->setTimerType(Qt::PreciseTimer);
 
-    connect(iterateTimer, &QTimer::timeout, this, &CoreAV::process);
+    // toxav_audio_iterate decodes the audio of all calls here, it must not wait for bulk work
+    connect(coreavThread.get(), &QThread::started, this, []() {
+        ThreadCpuTime::registerCurrentThread(QStringLiteral("CoreAV"));
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::RealtimeAudio);
+    });
+    connect(coreavThread.get(), &QThread::finished, this, &ThreadCpuTime::unregisterCurrentThread,
+            Qt::DirectConnection);
+
+    connect(iterateTimer, &QTimer::timeout, this, &CoreAV::processAudio);
     connect(coreavThread.get(), &QThread::finished, iterateTimer, &QTimer::stop);
-    connect(coreavThread.get(), &QThread::started, this, &CoreAV::process);
+    connect(coreavThread.get(), &QThread::started, this, &CoreAV::processAudio);
+
+    governorTimer->setInterval(CPU_SAMPLE_MS);
+    connect(governorTimer, &QTimer::timeout, this, &CoreAV::updateCpuGovernor);
+    // loss is judged once per second as well, on the same thread
+    connect(governorTimer, &QTimer::timeout, this, &CoreAV::updateAudioResilience);
+    connect(coreavThread.get(), &QThread::finished, governorTimer, &QTimer::stop);
+    connect(coreavThread.get(), &QThread::started, governorTimer,
+            static_cast<void (QTimer::*)()>(&QTimer::start));
+
+    videoIterateThread->setObjectName("qTox CoreAV Video");
+    videoIterateTimer->setSingleShot(true);
+    videoIterateTimer->setTimerType(Qt::PreciseTimer);
+    videoIterateTimer->moveToThread(videoIterateThread.get());
+
+    // the timer lives in the video thread, so it is the context that runs processVideo there
+    QTimer* const videoTimer = videoIterateTimer.get();
+    connect(videoTimer, &QTimer::timeout, videoTimer, [this]() { processVideo(); });
+    connect(videoIterateThread.get(), &QThread::finished, videoTimer, &QTimer::stop);
+    connect(videoIterateThread.get(), &QThread::started, videoTimer, [this]() {
+        ThreadCpuTime::registerCurrentThread(QStringLiteral("CoreAV Video"));
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Interactive);
+        processVideo();
+    });
+    connect(videoIterateThread.get(), &QThread::finished, videoTimer,
+            &ThreadCpuTime::unregisterCurrentThread, Qt::DirectConnection);
 }
 
 void CoreAV::connectCallbacks()
@@ -306,26 +332,31 @@ IAudioControl* CoreAV::getAudio()
 
 CoreAV::~CoreAV()
 {
+    audioSender->stop();
+    groupAudioReceiver->stop();
+    videoSender->stop();
+
     /* Gracefully leave calls and group calls to avoid deadlocks in destructor */
-    for (const auto& call : calls) {
-        cancelCall(call.first);
+    {
+        const auto snapshot = loadCalls();
+        for (const auto& call : *snapshot) {
+            cancelCall(call.first);
+        }
     }
     for (const auto& call : groupCalls) {
         leaveGroupCall(call.first);
     }
 
-    assert(calls.empty());
+    assert(loadCalls()->empty());
     assert(groupCalls.empty());
 
+    videoIterateThread->exit(0);
+    videoIterateThread->wait();
     coreavThread->exit(0);
     coreavThread->wait();
 
-    // filteraudio:X //
-    WebRtcAecm_Free(webrtc_aecmInst);
-    free(pcm_buf_out);
-
-    ma_resampler_uninit(&miniaudio_downsample_resampler, nullptr);
-    ma_resampler_uninit(&miniaudio_upsample_resampler, nullptr);
+    // no reader is left, destroy the ended calls while CoreAV is still intact
+    retiredCalls.clear();
 }
 
 /**
@@ -333,20 +364,105 @@ CoreAV::~CoreAV()
  */
 void CoreAV::start()
 {
-    coreavThread->start();
+    coreavThread->start(QThread::HighPriority);
+    videoIterateThread->start();
+    audioSender->startSending();
+    groupAudioReceiver->startReceiving();
+    videoSender->startSending();
 }
 
-void CoreAV::process()
+/**
+ * @brief Runs toxav's audio main loop on the CoreAV thread.
+ */
+void CoreAV::processAudio()
 {
+    TRACE_SCOPE("CoreAV::processAudio");
     assert(QThread::currentThread() == coreavThread.get());
-    toxav_iterate(toxav.get());
-    uint32_t interval = toxav_iteration_interval(toxav.get());
-    if (interval <= 5)
-    {
-        interval = 10;
+    audioLoopStats.beginIteration();
+    audioLoopStats.beginStage("toxav_audio_iterate");
+    toxav_audio_iterate(toxav.get());
+
+    // never wait for a writer on the audio thread, retry on the next iteration instead
+    audioLoopStats.beginStage("reclaim calls");
+    if (haveRetiredCalls && callsLock.tryLockForWrite()) {
+        reclaimCalls();
+        callsLock.unlock();
     }
-    // qDebug() << "CoreAV:interval:" << interval;
+    audioLoopStats.endIteration();
+
+    // a zero interval would spin, toxav has nothing due sooner than 1ms anyway
+    const uint32_t interval = std::max<uint32_t>(1, toxav_audio_iteration_interval(toxav.get()));
     iterateTimer->start(interval);
+    audioLoopStats.timerStarted(interval);
+}
+
+/**
+ * @brief Runs toxav's video main loop on its own thread.
+ */
+void CoreAV::processVideo()
+{
+    TRACE_SCOPE("CoreAV::processVideo");
+    assert(QThread::currentThread() == videoIterateThread.get());
+    videoLoopStats.beginIteration();
+    videoLoopStats.beginStage("toxav_video_iterate");
+    toxav_video_iterate(toxav.get());
+    videoLoopStats.endIteration();
+
+    const uint32_t interval = std::max<uint32_t>(1, toxav_video_iteration_interval(toxav.get()));
+    videoIterateTimer->start(interval);
+    videoLoopStats.timerStarted(interval);
+}
+
+/**
+ * @brief Current friend calls, readers get a consistent view without locking.
+ * @return Immutable snapshot, keeps the calls in it alive as long as it is held.
+ * @note Only hold the snapshot while handling a single frame or event.
+ */
+std::shared_ptr<const CoreAV::CallMap> CoreAV::loadCalls() const
+{
+    return std::atomic_load(&callSnapshot);
+}
+
+/**
+ * @brief Replaces the friend calls seen by readers.
+ * @param newCalls Modified copy of the current snapshot.
+ * @note callsLock must be held for writing.
+ */
+void CoreAV::publishCalls(CallMap newCalls)
+{
+    std::shared_ptr<const CallMap> oldCalls =
+        std::atomic_exchange(&callSnapshot,
+                             std::shared_ptr<const CallMap>{std::make_shared<CallMap>(
+                                 std::move(newCalls))});
+    // readers may still use the old snapshot, removed calls are destroyed once they are done
+    retiredCalls.push_back(std::move(oldCalls));
+    reclaimCalls();
+}
+
+/**
+ * @brief Removes a call from the snapshot.
+ * @param friendNum Id of friend in call list.
+ * @note callsLock must be held for writing.
+ */
+void CoreAV::removeCall(uint32_t friendNum)
+{
+    CallMap calls = *loadCalls();
+    calls.erase(friendNum);
+    publishCalls(std::move(calls));
+}
+
+/**
+ * @brief Drops retired snapshots no reader holds anymore.
+ * @note callsLock must be held for writing.
+ */
+void CoreAV::reclaimCalls()
+{
+    retiredCalls.erase(std::remove_if(retiredCalls.begin(), retiredCalls.end(),
+                                      [](const std::shared_ptr<const CallMap>& retired) {
+                                          return retired.use_count() == 1;
+                                      }),
+                       retiredCalls.end());
+    haveRetiredCalls = !retiredCalls.empty();
 }
 
 /**
@@ -356,10 +472,9 @@ void CoreAV::process()
  */
 bool CoreAV::isCallStarted(const Friend* f) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
     bool ret = f && (calls.find(f->getId()) != calls.end());
-    my_unlockreadlock();
     return ret;
 }
 
@@ -371,12 +486,29 @@ bool CoreAV::isCallStarted(const Friend* f) const
 bool CoreAV::isCallStarted(const Group* g) const
 {
     my_readlock();
-    QReadLocker locker{&callsLock};
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
     bool ret = g && (groupCalls.find(g->getId()) != groupCalls.end());
     my_unlockreadlock();
     return ret;
 }
 
+/**
+ * @brief Checks whether any friend or group call is running.
+ * @return true, if there is at least one call, false otherwise
+ */
+bool CoreAV::hasCalls() const
+{
+    if (!loadCalls()->empty()) {
+        return true;
+    }
+
+    my_readlock();
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
+    bool ret = !groupCalls.empty();
+    my_unlockreadlock();
+    return ret;
+}
+
 /**
  * @brief Checks the call status for a Tox friend.
  * @param f the friend to check
@@ -384,15 +516,13 @@ bool CoreAV::isCallStarted(const Group* g) const
  */
 bool CoreAV::isCallActive(const Friend* f) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
     auto it = calls.find(f->getId());
     if (it == calls.end()) {
-        my_unlockreadlock();
         return false;
     }
     bool ret = isCallStarted(f) && it->second->isActive();
-    my_unlockreadlock();
     return ret;
 }
 
@@ -404,7 +534,7 @@ bool CoreAV::isCallActive(const Friend* f) const
 bool CoreAV::isCallActive(const Group* g) const
 {
     my_readlock();
-    QReadLocker locker{&callsLock};
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
     auto it = groupCalls.find(g->getId());
     if (it == groupCalls.end()) {
         my_unlockreadlock();
@@ -417,46 +547,30 @@ bool CoreAV::isCallActive(const Group* g) const
 
 bool CoreAV::isCallVideoEnabled(const Friend* f) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
     auto it = calls.find(f->getId());
     bool ret = isCallStarted(f) && it->second->getVideoEnabled();
-    my_unlockreadlock();
     return ret;
 }
 
 bool CoreAV::answerCall(uint32_t friendNum, bool video)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
     //**// QMutexLocker coreLocker{&coreLock};
 
     qDebug() << QString("Answering call %1").arg(friendNum);
-    auto it = calls.find(friendNum);
-    assert(it != calls.end());
+    const auto snapshot = loadCalls();
+    auto it = snapshot->find(friendNum);
+    assert(it != snapshot->end());
     Toxav_Err_Answer err;
 
     const uint32_t videoBitrate = video ? VIDEO_DEFAULT_BITRATE : 0;
     if (toxav_answer(toxav.get(), friendNum, audioSettings.getAudioBitrate(),
                      videoBitrate, &err)) {
         it->second->setActive(true);
-
-        if (audioSettings.getScreenVideoFPS() == 30) {
-            qDebug() << "answerCall:setting HQ bitrate: 10000";
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-        } else if (audioSettings.getScreenVideoFPS() == 25) {
-            qDebug() << "answerCall:setting HQ bitrate: 10000";
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-        } else if (audioSettings.getScreenVideoFPS() == 20) {
-            qDebug() << "answerCall:setting HQ bitrate: AUTOSET";
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 1, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 180, NULL);
-            toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 2700, NULL);
-        }
+        startRateControl(friendNum, *it->second);
 
         my_unlockwritelock();
         return true;
@@ -465,7 +579,7 @@ bool CoreAV::answerCall(uint32_t friendNum, bool video)
         Toxav_Err_Call_Control controlErr;
         toxav_call_control(toxav.get(), friendNum, TOXAV_CALL_CONTROL_CANCEL, &controlErr);
         PARSE_ERR(controlErr);
-        calls.erase(it);
+        removeCall(friendNum);
         my_unlockwritelock();
         return false;
     }
@@ -474,10 +588,11 @@ bool CoreAV::answerCall(uint32_t friendNum, bool video)
 bool CoreAV::startCall(uint32_t friendNum, bool video)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
     //**// QMutexLocker coreLocker{&coreLock};
 
     qDebug() << QString("Starting call with %1").arg(friendNum);
+    CallMap calls = *loadCalls();
     auto it = calls.find(friendNum);
     if (it != calls.end()) {
         qWarning() << QString("Can't start call with %1, we're already in this call!").arg(friendNum);
@@ -501,24 +616,9 @@ bool CoreAV::startCall(uint32_t friendNum, bool video)
     // Call object must be owned by this thread or there will be locking problems with Audio
     call->moveToThread(thread());
     assert(call != nullptr);
-    calls.emplace(friendNum, std::move(call));
-
-    if (audioSettings.getScreenVideoFPS() == 30) {
-        qDebug() << "startCall:setting HQ bitrate: 10000";
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-    } else if (audioSettings.getScreenVideoFPS() == 25) {
-        qDebug() << "startCall:setting HQ bitrate: 10000";
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-    } else if (audioSettings.getScreenVideoFPS() == 20) {
-        qDebug() << "startCall:setting HQ bitrate: AUTOSET";
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 1, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 180, NULL);
-        toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 2700, NULL);
-    }
+    auto ret = calls.emplace(friendNum, std::move(call));
+    startRateControl(friendNum, *ret.first->second);
+    publishCalls(std::move(calls));
 
     my_unlockwritelock();
     return true;
@@ -527,7 +627,7 @@ bool CoreAV::startCall(uint32_t friendNum, bool video)
 bool CoreAV::cancelCall(uint32_t friendNum)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
     //**// QMutexLocker coreLocker{&coreLock};
 
     qDebug() << QString("Cancelling call with %1").arg(friendNum);
@@ -544,7 +644,7 @@ bool CoreAV::cancelCall(uint32_t friendNum)
         return false;
     }
 
-    calls.erase(friendNum);
+    removeCall(friendNum);
     my_unlockwritelock();
     locker.unlock();
 
@@ -555,7 +655,7 @@ bool CoreAV::cancelCall(uint32_t friendNum)
 void CoreAV::timeoutCall(uint32_t friendNum)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     if (!cancelCall(friendNum)) {
         qWarning() << QString("Failed to timeout call with %1").arg(friendNum);
@@ -564,6 +664,22 @@ void CoreAV::timeoutCall(uint32_t friendNum)
     qDebug() << "Call with friend" << friendNum << "timed out";
 }
 
+/**
+ * @brief Hand a captured audio frame over to the audio send thread
+ * @param callId Id of friend in call list.
+ * @param pcm An array of audio samples (Pulse-code modulation), copied before returning.
+ * @param samples Number of samples in this frame.
+ * @param chans Number of audio channels.
+ * @param rate Audio sampling rate used in this frame.
+ * @return False if the frame was dropped because the send thread is behind.
+ * @note Must only be called from the audio capture thread.
+ */
+bool CoreAV::queueCallAudio(uint32_t callId, const int16_t* pcm, size_t samples, uint8_t chans,
+                            uint32_t rate)
+{
+    return audioSender->enqueue(callId, pcm, samples, chans, rate);
+}
+
 /**
  * @brief Send audio frame to a friend
  * @param callId Id of friend in call list.
@@ -571,11 +687,14 @@ void CoreAV::timeoutCall(uint32_t friendNum)
  * @param samples Number of samples in this frame.
  * @param chans Number of audio channels.
  * @param rate Audio sampling rate used in this frame.
+ * @param queuedMs Time the frame waited for the audio send thread.
  * @return False only on error, but not if there's nothing to send.
+ * @note Called from the audio send thread, see CoreAudioSender.
  */
 bool CoreAV::sendCallAudio(uint32_t callId, const int16_t* pcm, size_t samples, uint8_t chans,
-                           uint32_t rate) const
+                           uint32_t rate, qreal queuedMs) const
 {
+    TRACE_SCOPE("CoreAV::sendCallAudio");
 #ifdef AV_TIMING_DEBUG
     qDebug() << "THREAD:sendCallAudio" <<  QThread::currentThread();
     static qint64 recurring_send_audio = QDateTime::currentDateTime().toMSecsSinceEpoch();
@@ -586,21 +705,12 @@ bool CoreAV::sendCallAudio(uint32_t callId, const int16_t* pcm, size_t samples,
     myTimer.start();
 #endif
 
-/*
-    if (!callsLock.tryLockForWrite()) {
-        return false;
-    } else {
-        callsLock.unlock();
-    }
-*/
-/*
-    my_writelock();
-    QWriteLocker locker{&callsLock};
-*/
+    // the call and its DSP state must stay alive while we filter and send
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     auto it = calls.find(callId);
     if (it == calls.end()) {
-        //my_unlockwritelock();
         return false;
     }
 
@@ -608,98 +718,111 @@ bool CoreAV::sendCallAudio(uint32_t callId, const int16_t* pcm, size_t samples,
 
     if (call.getMuteMic() || !call.isActive()
         || !(call.getState() & TOXAV_FRIEND_CALL_STATE_ACCEPTING_A)) {
-        //my_unlockwritelock();
         return true;
     }
 
-    // filteraudio:X //
-    static int current_echo_latency = 80; // HINT: static, to remember the value on the next calls
-    static int current_aec_echo_mode = 0; // HINT: static, to remember the value on the next calls
-    static int current_aec_ns_echo_mode = 0; // HINT: static, to remember the value on the next calls
-    // qDebug() << "filter_audio recorded audio: chans:" << chans << " rate:" << rate;
-    if ((chans == 1) && (rate == IAudioControl::AUDIO_SAMPLE_RATE)) {
-        if (audioSettings.getEchoCancellation()) {
-            int new_echo_latency = audioSettings.getEchoLatency();
-            if (new_echo_latency != current_echo_latency) {
-                current_echo_latency = new_echo_latency;
-                int16_t filterLatency = current_echo_latency;
-                qDebug() << "Setting filter delay to: " << filterLatency << "ms";
-            }
-
-            int new_aec_echo_mode = audioSettings.getAecechomode();
-            if (new_aec_echo_mode != current_aec_echo_mode) {
-                current_aec_echo_mode = new_aec_echo_mode;
-                qDebug() << "Setting AEC Mode to: " << current_aec_echo_mode;
-
-                AecmConfig config;
-                config.echoMode = AecmTrue;
-                config.cngMode = current_aec_echo_mode;
-                WebRtcAecm_set_config(webrtc_aecmInst, config);
-                qDebug() << "WebRtcAecm_set_config ----->" << audioSettings.getAecechomode();
-            }
+    AudioLatencyStats& latency = call.getLatencyStats();
+    latency.capture.add(audio.load()->getCaptureBacklogMs());
+    latency.queue.add(queuedMs);
+
+    const int16_t* sendPcm = pcm;
+    size_t sendSamples = samples;
+    uint8_t sendChans = chans;
+    uint32_t sendRate = rate;
+
+    // music is sent in stereo as captured, anything else is turned into one voice channel
+    const IAudioSettings::InputMode inputMode = audioSettings.getAudioInputMode();
+    if (chans > 1 && rate == NearEndMixer::SAMPLE_RATE
+        && inputMode != IAudioSettings::InputMode::Music) {
+        NearEndMixer& mixer = call.getNearEndMixer();
+        mixer.setBeamforming(inputMode == IAudioSettings::InputMode::MicArray);
+        sendPcm = mixer.process(pcm, samples, chans);
+        if (sendPcm != pcm) {
+            sendChans = 1;
+        }
+    }
 
-            int new_aec_ns_echo_mode = audioSettings.getAecechonsmode();
-            if (new_aec_ns_echo_mode != current_aec_ns_echo_mode) {
-                current_aec_ns_echo_mode = new_aec_ns_echo_mode;
-                qDebug() << "Setting AEC NS Mode to: " << new_aec_ns_echo_mode;
-                int res3 = WebRtcNsx_set_policy(nsxInst, new_aec_ns_echo_mode);
-                qDebug() << "WebRtcNsx_set_policy: mode: " <<  new_aec_ns_echo_mode << "res :----->" << res3;
-            }
+    // filteraudio:X //
+    const bool fullProcessing = audioSettings.getFullAudioProcessing();
+    if ((sendChans == 1) && (rate == IAudioControl::AUDIO_SAMPLE_RATE)
+        && (audioSettings.getEchoCancellation() || fullProcessing)) {
+        CallAudioDsp& dsp = call.getAudioDsp();
+        dsp.setAecMode(audioSettings.getAecechomode());
+        int nsMode = audioSettings.getAecechonsmode();
+        if (cpuGovernor.isActive(CpuGovernor::Step::NoiseSuppression)) {
+            nsMode = std::max(0, nsMode - 1);
+        }
+        dsp.setNsMode(nsMode);
+        dsp.setFullProcessing(fullProcessing);
+        const bool transientSuppression = audioSettings.getAudioTransientSuppression();
+        dsp.setTransientSuppression(transientSuppression);
+        // the suppressor only acts on clicks while it knows the user is typing
+        bool keyPressed = false;
+#ifdef QTOX_PLATFORM_EXT
+        keyPressed = transientSuppression && Platform::anyKeyPressed();
+#endif
+        TRACE_SCOPE("CallAudioDsp::filterNearEnd");
+        QElapsedTimer dspTimer;
+        dspTimer.start();
+        const int16_t* filtered = dsp.filterNearEnd(sendPcm, samples,
+                                                    audioSettings.getEchoLatency()
+                                                        + IAudioControl::AUDIO_FRAME_DURATION,
+                                                    keyPressed);
+        latency.dsp.add(dspTimer.nsecsElapsed() / 1000000.0);
+        if (filtered) {
+            // Opus takes the processing rate as is, resampling back to 48kHz adds nothing
+            sendPcm = filtered;
+            sendSamples = samples / CallAudioDsp::RESAMPLE_FACTOR;
+            sendRate = CallAudioDsp::PROCESS_SAMPLE_RATE;
+        }
 
-            const int split_factor = (IAudioControl::AUDIO_FRAME_DURATION / 10);
-            const int sample_count_split = samples / split_factor;
+        // discontinuous transmission, the peer conceals the gap
+        if (!dsp.isVoiceActive()) {
+            return true;
+        }
+    }
 
-            if (pcm_buf_out_samples != samples) {
-                free(pcm_buf_out);
-                pcm_buf_out = nullptr;
-            }
-            if (pcm_buf_out == nullptr) {
-                pcm_buf_out = (int16_t *)calloc(1, 2 * samples);
-                pcm_buf_out_samples = samples;
-            }
+    // on heavy loss the frame goes out in shorter packets, a lost one leaves a shorter gap
+    CallAudioResilience& resilience = call.getAudioResilience();
+    size_t packetSamples = sendRate * resilience.getProfile().frameMs / 1000;
+    if (packetSamples == 0 || sendSamples % packetSamples != 0) {
+        packetSamples = sendSamples;
+    }
 
-            // downsample to 16khz
-            int16_t *pcm_buf_resampled = (int16_t *)calloc(1, sizeof(int16_t) * (samples / 3));
-            downsample_48000_to_16000_basic(pcm, pcm_buf_resampled, samples);
-            // printf("WebRtcAecm_Process:samples=%d split_factor=%d sample_count_split=%d\n",
-            //         (int32_t)samples, split_factor, sample_count_split);
-            int16_t *pcm_buf_out_resampled = (int16_t *)calloc(1, sizeof(int16_t) * (samples / 3));
-            int16_t *pcm_buf_filtered_out_resampled = (int16_t *)calloc(1, sizeof(int16_t) * (samples / 3));
-
-            for (int x=0;x<split_factor;x++)
-            {
-                short const *const tmp1[] = { pcm_buf_resampled + (x * (sample_count_split / 3)), 0 };
-                short *const tmp2[] = { pcm_buf_filtered_out_resampled + (x * (sample_count_split / 3)), 0 };
-                WebRtcNsx_Process(nsxInst,
-                                tmp1,
-                                1,
-                                tmp2);
-
-                aec_mutex.lock();
-                int32_t res = WebRtcAecm_Process(
-                        webrtc_aecmInst,
-                        const_cast<int16_t *>(pcm_buf_resampled + (x * (sample_count_split / 3))),
-                        const_cast<int16_t *>(pcm_buf_filtered_out_resampled + (x * (sample_count_split / 3))),
-                        pcm_buf_out_resampled + (x * (sample_count_split / 3)),
-                        (sample_count_split / 3),
-                        current_echo_latency + IAudioControl::AUDIO_FRAME_DURATION
-                        );
-                aec_mutex.unlock();
-                std::ignore = res;
-                // printf("WebRtcAecm_Process:%d\n", res);
-            }
+    QElapsedTimer sendTimer;
+    sendTimer.start();
+    Toxav_Err_Send_Frame err = TOXAV_ERR_SEND_FRAME_OK;
+    for (size_t offset = 0; offset < sendSamples && err == TOXAV_ERR_SEND_FRAME_OK;
+         offset += packetSamples) {
+        err = sendAudioPacket(callId, sendPcm + offset * sendChans, packetSamples, sendChans,
+                              sendRate);
+    }
 
-            // upsample back to 48khz
-            upsample_16000_to_48000_basic(pcm_buf_out_resampled, pcm_buf_out, samples / 3);
-            free(pcm_buf_filtered_out_resampled);
-            free(pcm_buf_resampled);
-            free(pcm_buf_out_resampled);
+    latency.send.add(sendTimer.nsecsElapsed() / 1000000.0);
+    call.getCallStats().onAudioSent(err != TOXAV_ERR_SEND_FRAME_OK);
+    resilience.onAudioSent(err != TOXAV_ERR_SEND_FRAME_OK);
 
-            memcpy(const_cast<int16_t *>(pcm), pcm_buf_out, 2 * samples);
-        }
+    CallRateController& rates = call.getRateController();
+    rates.onAudioSent(sendTimer.elapsed(), err != TOXAV_ERR_SEND_FRAME_OK);
+    if (rates.update(rateClock.elapsed())) {
+        applyCallRates(callId, call);
     }
 
-    // TOXAV_ERR_SEND_FRAME_SYNC means toxav failed to lock, retry 5 times in this case
+#ifdef AV_TIMING_DEBUG
+    qDebug() << "THREAD:sendCallAudio:duration:" << myTimer.elapsed();
+#endif
+    return true;
+}
+
+/**
+ * @brief Sends one Opus packet worth of audio.
+ *
+ * TOXAV_ERR_SEND_FRAME_SYNC means toxav failed to lock, the send is retried a few times then.
+ * @return Error of the last attempt.
+ */
+Toxav_Err_Send_Frame CoreAV::sendAudioPacket(uint32_t callId, const int16_t* pcm, size_t samples,
+                                             uint8_t chans, uint32_t rate) const
+{
     Toxav_Err_Send_Frame err;
     int retries = 0;
     do {
@@ -716,15 +839,28 @@ bool CoreAV::sendCallAudio(uint32_t callId, const int16_t* pcm, size_t samples,
         qDebug() << "toxav_audio_send_frame error: Lock busy, dropping frame";
     }
 
-    //my_unlockwritelock();
-#ifdef AV_TIMING_DEBUG
-    qDebug() << "THREAD:sendCallAudio:duration:" << myTimer.elapsed();
-#endif
-    return true;
+    return err;
+}
+
+/**
+ * @brief Hand a captured video frame over to the video send thread
+ * @param callId Id of friend in call list.
+ * @param vframe Captured frame, replaces the previous one if that wasn't sent yet.
+ */
+void CoreAV::queueCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
+{
+    videoSender->post(callId, std::move(vframe));
 }
 
+/**
+ * @brief Converts and sends a video frame to a friend
+ * @param callId Id of friend in call list.
+ * @param vframe Frame to send.
+ * @note Only called from the video send thread, see queueCallVideo().
+ */
 void CoreAV::sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
 {
+    TRACE_SCOPE("CoreAV::sendCallVideo");
 #ifdef AV_TIMING_DEBUG
     qDebug() << "THREAD:sendCallVideo" <<  QThread::currentThread();
     static qint64 recurring_send_video = QDateTime::currentDateTime().toMSecsSinceEpoch();
@@ -735,20 +871,12 @@ void CoreAV::sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
     myTimer.start();
 #endif
 
-    if (!callsLock.tryLockForRead()) {
-        qDebug() << "sendCallVideo:tryLockForRead failed";
-        return;
-    } else {
-        callsLock.unlock();
-    }
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    // Running in our own send thread, so waiting for toxav doesn't stall capture
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
-    // We might be running in the FFmpeg thread and holding the CameraSource lock
-    // So be careful not to deadlock with anything while toxav locks in toxav_video_send_frame
     auto it = calls.find(callId);
     if (it == calls.end()) {
-        my_unlockreadlock();
         return;
     }
 
@@ -756,7 +884,6 @@ void CoreAV::sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
 
     if (!call.getVideoEnabled() || !call.isActive()
         || !(call.getState() & TOXAV_FRIEND_CALL_STATE_ACCEPTING_V)) {
-        my_unlockreadlock();
         return;
     }
 
@@ -764,36 +891,63 @@ void CoreAV::sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
         qDebug() << "Restarting video stream to friend" << callId;
         //**// QMutexLocker coreLocker{&coreLock};
         Toxav_Err_Bit_Rate_Set err;
-        toxav_video_set_bit_rate(toxav.get(), callId, VIDEO_DEFAULT_BITRATE, &err);
+        toxav_video_set_bit_rate(toxav.get(), callId, call.getRateController().getVideoBitrate(),
+                                 &err);
         if (!PARSE_ERR(err)) {
-            my_unlockreadlock();
             return;
         }
         call.setNullVideoBitrate(false);
     }
 
-    QRect vsize = vframe->getSourceDimensions();
-    QSize new_size = QSize(vsize.width(), vsize.height());
-    // 3840x2160 -> 4K resolution
-    if ((vsize.width() > 1920) || (vsize.height() > 1080)) {
-        new_size = QSize(1920, 1080);
+    CallVideoLadder& ladder = call.getVideoLadder();
+    const qint64 nowMs = rateClock.elapsed();
+    if (!ladder.shouldSend(nowMs)) {
+        return;
+    }
+
+    // the preset or the device may have changed since the last frame
+    const CallEncoderProfile profile = wantedEncoderProfile();
+    if (profile != call.getEncoderProfile()) {
+        applyEncoderProfile(callId, call, profile);
     }
-    ToxYUVFrame frame = vframe->toToxYUVFrame(new_size);
+
+    // conversion and encoding together tell us if the CPU keeps up with the current rung
+    QElapsedTimer processTimer;
+    processTimer.start();
+    QRect vsize = vframe->getSourceDimensions();
+    const QSize sendSize = ladder.scaledSize(vsize.size());
+    call.setVideoOutputSize(sendSize);
+    ToxYUVFrame frame = vframe->toToxYUVFrame(sendSize);
 
     if (!frame) {
-        my_unlockreadlock();
         return;
     }
 
     // TOXAV_ERR_SEND_FRAME_SYNC means toxav failed to lock, retry 5 times in this case
     // We don't want to be dropping iframes because of some lock held by toxav_iterate
+    QElapsedTimer sendTimer;
+    sendTimer.start();
     Toxav_Err_Send_Frame err;
     if (!toxav_video_send_frame(toxav.get(), callId, frame.width, frame.height, frame.y,
                                 frame.u, frame.v, &err)) {
             qDebug() << "toxav_video_send_frame error: " << err;
     }
 
-    my_unlockreadlock();
+    CallRateController& rates = call.getRateController();
+    rates.onVideoSent(sendTimer.elapsed(), err != TOXAV_ERR_SEND_FRAME_OK);
+    if (rates.update(rateClock.elapsed())) {
+        applyCallRates(callId, call);
+    }
+
+    ladder.onFrameSent(nowMs, processTimer.elapsed());
+    call.getCallStats().onVideoSent(frame.width, frame.height, processTimer.nsecsElapsed(),
+                                    err != TOXAV_ERR_SEND_FRAME_OK);
+    if (ladder.update(rateClock.elapsed(), rates.getVideoBitrate())) {
+        const CallVideoLadder::Rung rung = ladder.getRung();
+        qDebug() << "Sending video to friend" << callId << "at up to" << rung.width << "x"
+                 << rung.height << "@" << rung.fps << "fps";
+    }
+
 #ifdef AV_TIMING_DEBUG
     qDebug() << "THREAD:sendCallVideo:duration:" << myTimer.elapsed();
 #endif
@@ -806,7 +960,9 @@ void CoreAV::sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> vframe)
 void CoreAV::toggleMuteCallInput(const Friend* f)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     auto it = calls.find(f->getId());
     if (f && (it != calls.end())) {
@@ -822,7 +978,9 @@ void CoreAV::toggleMuteCallInput(const Friend* f)
 void CoreAV::toggleMuteCallOutput(const Friend* f)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     auto it = calls.find(f->getId());
     if (f && (it != calls.end())) {
@@ -858,19 +1016,37 @@ void CoreAV::groupCallCallback(void* tox, uint32_t group, uint32_t peer, const i
     Core* c = static_cast<Core*>(core);
     CoreAV* cav = c->getAv();
 
-    my_readlock();
-    QReadLocker locker{&cav->callsLock};
+    // everything else happens on the group audio thread, see CoreGroupAudioReceiver
+    cav->groupAudioReceiver->enqueue(static_cast<int>(group), c->getGroupPeerPk(group, peer), data,
+                                     samples, channels, sample_rate);
+}
 
-    const ToxPk peerPk = c->getGroupPeerPk(group, peer);
+/**
+ * @brief Measures and plays a decoded frame of a conference peer.
+ * @param groupNum Id of the conference.
+ * @param peerPk Peer the audio came from.
+ * @param pcm An array of audio samples (Pulse-code modulation).
+ * @param samples Number of samples per channel in this frame.
+ * @param chans Number of audio channels.
+ * @param rate Audio sampling rate used in this frame.
+ * @note Called from the group audio thread, see CoreGroupAudioReceiver.
+ */
+void CoreAV::playGroupCallAudio(int groupNum, const ToxPk& peerPk, const int16_t* pcm,
+                                size_t samples, uint8_t chans, uint32_t rate)
+{
+    TRACE_SCOPE("CoreAV::playGroupCallAudio");
     // don't play the audio if it comes from a muted peer
-    if (cav->groupSettings.getBlackList().contains(peerPk.toString())) {
+    if (groupSettings.getBlackList().contains(peerPk.toString())) {
         return;
     }
 
-    emit c->groupPeerAudioPlaying(group, peerPk);
+    publishGroupPeerLevel(groupNum, peerPk, AudioLevel::measure(pcm, samples * chans));
 
-    auto it = cav->groupCalls.find(group);
-    if (it == cav->groupCalls.end()) {
+    my_readlock();
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
+
+    auto it = groupCalls.find(groupNum);
+    if (it == groupCalls.end()) {
         return;
     }
 
@@ -880,7 +1056,7 @@ void CoreAV::groupCallCallback(void* tox, uint32_t group, uint32_t peer, const i
         return;
     }
 
-    call.playAudioBuffer(peerPk, data, samples, channels, sample_rate);
+    call.playAudioBuffer(peerPk, pcm, static_cast<int>(samples), chans, static_cast<int>(rate));
 }
 
 /**
@@ -891,13 +1067,49 @@ void CoreAV::groupCallCallback(void* tox, uint32_t group, uint32_t peer, const i
 void CoreAV::invalidateGroupCallPeerSource(const Group& group, ToxPk peerPk)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     auto it = groupCalls.find(group.getId());
     if (it == groupCalls.end()) {
         return;
     }
     it->second->removePeer(peerPk);
+
+    QMutexLocker levelsLocker{&groupPeerLevelsLock};
+    auto levels = groupPeerLevels.find(group.getId());
+    if (levels != groupPeerLevels.end()) {
+        levels->second.erase(peerPk);
+    }
+}
+
+/**
+ * @brief Makes the level of a group peer's audio available to takeGroupPeerLevels.
+ * @note Called from the Core thread for every decoded frame.
+ */
+void CoreAV::publishGroupPeerLevel(int groupNum, const ToxPk& peerPk, const AudioLevel& level)
+{
+    QMutexLocker locker{&groupPeerLevelsLock};
+    groupPeerLevels[groupNum][peerPk].publish(level);
+}
+
+/**
+ * @brief Takes the loudest audio level of each group peer since the last call.
+ * @param groupNum Id of the group.
+ * @return Levels by peer, peers we never received audio from are missing.
+ */
+std::map<ToxPk, AudioLevel> CoreAV::takeGroupPeerLevels(int groupNum)
+{
+    std::map<ToxPk, AudioLevel> result;
+    QMutexLocker locker{&groupPeerLevelsLock};
+    auto it = groupPeerLevels.find(groupNum);
+    if (it == groupPeerLevels.end()) {
+        return result;
+    }
+
+    for (auto& peer : it->second) {
+        result.emplace(peer.first, peer.second.take());
+    }
+    return result;
 }
 
 /**
@@ -907,21 +1119,94 @@ void CoreAV::invalidateGroupCallPeerSource(const Group& group, ToxPk peerPk)
  */
 VideoSource* CoreAV::getVideoSourceFromCall(int friendNum) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     auto it = calls.find(friendNum);
     if (it == calls.end()) {
         qWarning() << "CoreAV::getVideoSourceFromCall: No such call, possibly cancelled";
-        my_unlockreadlock();
         return nullptr;
     }
 
     VideoSource* ret = it->second->getVideoSource();
-    my_unlockreadlock();
     return ret;
 }
 
+/**
+ * @brief Describes the audio latency of each stage for all friend calls, for the settings and
+ *        debug logs.
+ * @return One block per call, empty if there are no calls.
+ */
+QString CoreAV::getAudioLatencyReport() const
+{
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
+
+    QStringList report;
+    for (const auto& call : calls) {
+        report << tr("Call with friend %1:\n%2")
+                      .arg(call.first)
+                      .arg(call.second->getLatencyStats().toString());
+    }
+
+    return report.join(QStringLiteral("\n\n"));
+}
+
+/**
+ * @brief Collects the statistics of a friend call for the call statistics overlay.
+ * @param friendNum Id of friend in call list.
+ * @return Statistics since the previous call, all zero if there is no such call.
+ * @note Only call from one thread, usually the GUI thread, and only while the overlay is shown.
+ */
+CallStats::Snapshot CoreAV::takeCallStats(uint32_t friendNum) const
+{
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
+
+    auto it = calls.find(friendNum);
+    if (it == calls.end()) {
+        return {};
+    }
+
+    const ToxFriendCall& call = *it->second;
+    CallStats::Snapshot stats = call.getCallStats().takeSnapshot(rateClock.elapsed());
+    stats.targetKbps = call.getRateController().getVideoBitrate();
+    stats.audioQueueMs = call.getLatencyStats().queue.percentile(0.5);
+    return stats;
+}
+
+/**
+ * @brief Per call media stats for the "av" section of the diagnostics report.
+ * @note Thread safe, calls are numbered instead of naming the friend.
+ */
+QJsonObject CoreAV::collectDiagnostics() const
+{
+    const auto snapshot = loadCalls();
+    QJsonArray calls;
+    for (const auto& entry : *snapshot) {
+        const ToxFriendCall& call = *entry.second;
+        const CallRateController& rates = call.getRateController();
+        const CallAudioResilience::Profile resilience = call.getAudioResilience().getProfile();
+        calls.append(QJsonObject{{"active", call.isActive()},
+                                 {"video", call.getVideoEnabled()},
+                                 {"audioKbps", static_cast<qint64>(rates.getAudioBitrate())},
+                                 {"videoKbps", static_cast<qint64>(rates.getVideoBitrate())},
+                                 {"fec", resilience.fec},
+                                 {"expectedLossPercent",
+                                  static_cast<qint64>(resilience.expectedLossPercent)},
+                                 {"audioFrameMs", static_cast<qint64>(resilience.frameMs)},
+                                 {"audioLatency", call.getLatencyStats().toJson()}});
+    }
+
+    return QJsonObject{{"calls", calls},
+                       {"droppedCaptureFrames",
+                        static_cast<qint64>(audioSender->getDroppedFrames())},
+                       {"droppedGroupAudioFrames",
+                        static_cast<qint64>(groupAudioReceiver->getDroppedFrames())},
+                       {"cpuLoad", cpuGovernor.getLoad()},
+                       {"cpuBudget", cpuGovernor.getBudget()}};
+}
+
 /**
  * @brief Starts a call in an existing AV groupchat.
  * @note Call from the GUI thread.
@@ -930,7 +1215,7 @@ VideoSource* CoreAV::getVideoSourceFromCall(int friendNum) const
 void CoreAV::joinGroupCall(const Group& group)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     qDebug() << QString("Joining group call %1").arg(group.getId());
 
@@ -957,18 +1242,21 @@ void CoreAV::joinGroupCall(const Group& group)
 void CoreAV::leaveGroupCall(int groupNum)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     qDebug() << QString("Leaving group call %1").arg(groupNum);
 
     groupCalls.erase(groupNum);
+
+    QMutexLocker levelsLocker{&groupPeerLevelsLock};
+    groupPeerLevels.erase(groupNum);
 }
 
 bool CoreAV::sendGroupCallAudio(int groupNum, const int16_t* pcm, size_t samples, uint8_t chans,
                                 uint32_t rate) const
 {
     my_readlock();
-    QReadLocker locker{&callsLock};
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     std::map<int, ToxGroupCallPtr>::const_iterator it = groupCalls.find(groupNum);
     if (it == groupCalls.end()) {
@@ -981,6 +1269,14 @@ bool CoreAV::sendGroupCallAudio(int groupNum, const int16_t* pcm, size_t samples
         return true;
     }
 
+    // most participants of a big group are silent, don't send their noise floor
+    if ((chans == 1) && (rate == IAudioControl::AUDIO_SAMPLE_RATE)
+        && audioSettings.getFullAudioProcessing()
+        && !it->second->getVoiceDetector().process(pcm, samples)) {
+        my_unlockreadlock();
+        return true;
+    }
+
     if (toxav_group_send_audio(toxav_get_tox(toxav.get()), groupNum, pcm, samples, chans, rate) != 0)
         qDebug() << "toxav_group_send_audio error";
 
@@ -996,7 +1292,7 @@ bool CoreAV::sendGroupCallAudio(int groupNum, const int16_t* pcm, size_t samples
 void CoreAV::muteCallInput(const Group* g, bool mute)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     auto it = groupCalls.find(g->getId());
     if (g && (it != groupCalls.end())) {
@@ -1012,7 +1308,7 @@ void CoreAV::muteCallInput(const Group* g, bool mute)
 void CoreAV::muteCallOutput(const Group* g, bool mute)
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     auto it = groupCalls.find(g->getId());
     if (g && (it != groupCalls.end())) {
@@ -1028,7 +1324,7 @@ void CoreAV::muteCallOutput(const Group* g, bool mute)
 bool CoreAV::isGroupCallInputMuted(const Group* g) const
 {
     my_readlock();
-    QReadLocker locker{&callsLock};
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     if (!g) {
         my_unlockreadlock();
@@ -1050,7 +1346,7 @@ bool CoreAV::isGroupCallInputMuted(const Group* g) const
 bool CoreAV::isGroupCallOutputMuted(const Group* g) const
 {
     my_readlock();
-    QReadLocker locker{&callsLock};
+    PROFILED_READ_LOCKER(locker, &callsLock, "CoreAV::callsLock");
 
     if (!g) {
         my_unlockreadlock();
@@ -1071,17 +1367,15 @@ bool CoreAV::isGroupCallOutputMuted(const Group* g) const
  */
 bool CoreAV::isCallInputMuted(const Friend* f) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     if (!f) {
-        my_unlockreadlock();
         return false;
     }
     const uint32_t friendId = f->getId();
     auto it = calls.find(friendId);
     bool ret = (it != calls.end()) && it->second->getMuteMic();
-    my_unlockreadlock();
     return ret;
 }
 
@@ -1092,17 +1386,15 @@ bool CoreAV::isCallInputMuted(const Friend* f) const
  */
 bool CoreAV::isCallOutputMuted(const Friend* f) const
 {
-    my_readlock();
-    QReadLocker locker{&callsLock};
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     if (!f) {
-        my_unlockreadlock();
         return false;
     }
     const uint32_t friendId = f->getId();
     auto it = calls.find(friendId);
     bool ret = (it != calls.end()) && it->second->getMuteVol();
-    my_unlockreadlock();
     return ret;
 }
 
@@ -1113,7 +1405,9 @@ bool CoreAV::isCallOutputMuted(const Friend* f) const
 void CoreAV::sendNoVideo()
 {
     my_writelock();
-    QWriteLocker locker{&callsLock};
+    PROFILED_WRITE_LOCKER(locker, &callsLock, "CoreAV::callsLock");
+    const auto snapshot = loadCalls();
+    const CallMap& calls = *snapshot;
 
     // We don't change the audio bitrate, but we signal that we're not sending video anymore
     qDebug() << "CoreAV: Signaling end of video sending";
@@ -1133,7 +1427,7 @@ void CoreAV::callCallback(ToxAV* toxav, uint32_t friendNum, bool audio, bool vid
     CoreAV* self = static_cast<CoreAV*>(vSelf);
 
     my_writelock();
-    QWriteLocker locker{&self->callsLock};
+    PROFILED_WRITE_LOCKER(locker, &self->callsLock, "CoreAV::callsLock");
 
     // Audio backend must be set before receiving a call
     assert(self->audio != nullptr);
@@ -1143,7 +1437,8 @@ void CoreAV::callCallback(ToxAV* toxav, uint32_t friendNum, bool audio, bool vid
     call->moveToThread(self->thread());
     assert(call != nullptr);
 
-    auto it = self->calls.emplace(friendNum, std::move(call));
+    CallMap calls = *self->loadCalls();
+    auto it = calls.emplace(friendNum, std::move(call));
     if (it.second == false) {
         qWarning() << QString("Rejecting call invite from %1, we're already in that call!").arg(friendNum);
         Toxav_Err_Call_Control err;
@@ -1160,6 +1455,7 @@ void CoreAV::callCallback(ToxAV* toxav, uint32_t friendNum, bool audio, bool vid
     if (video)
         state |= TOXAV_FRIEND_CALL_STATE_SENDING_V | TOXAV_FRIEND_CALL_STATE_ACCEPTING_V;
     it.first->second->setState(static_cast<TOXAV_FRIEND_CALL_STATE>(state));
+    self->publishCalls(std::move(calls));
 
     // Must explicitely unlock, because a deadlock can happen via ChatForm/Audio
     locker.unlock();
@@ -1174,10 +1470,11 @@ void CoreAV::stateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t state, voi
 
     // we must unlock this lock before emitting any signals
     my_writelock();
-    QWriteLocker locker{&self->callsLock};
+    PROFILED_WRITE_LOCKER(locker, &self->callsLock, "CoreAV::callsLock");
 
-    auto it = self->calls.find(friendNum);
-    if (it == self->calls.end()) {
+    const auto snapshot = self->loadCalls();
+    auto it = snapshot->find(friendNum);
+    if (it == snapshot->end()) {
         qWarning() << QString("stateCallback called, but call %1 is already dead").arg(friendNum);
         my_unlockwritelock();
         return;
@@ -1187,13 +1484,13 @@ void CoreAV::stateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t state, voi
 
     if (state & TOXAV_FRIEND_CALL_STATE_ERROR) {
         qWarning() << "Call with friend" << friendNum << "died of unnatural causes!";
-        self->calls.erase(friendNum);
+        self->removeCall(friendNum);
         my_unlockwritelock();
         locker.unlock();
         emit self->avEnd(friendNum, true);
     } else if (state & TOXAV_FRIEND_CALL_STATE_FINISHED) {
         qDebug() << "Call with friend" << friendNum << "finished quietly";
-        self->calls.erase(friendNum);
+        self->removeCall(friendNum);
         my_unlockwritelock();
         locker.unlock();
         emit self->avEnd(friendNum);
@@ -1233,49 +1530,60 @@ void CoreAV::stateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t state, voi
     my_unlockwritelock();
 }
 
-// This is only a dummy implementation for now
 void CoreAV::bitrateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t arate, uint32_t vrate,
                              void* vSelf)
 {
-    CoreAV* self = static_cast<CoreAV*>(vSelf);
-    std::ignore = self;
-    std::ignore = toxav;
-
-    qDebug() << "Recommended bitrate with" << friendNum << " is now " << arate << "/" << vrate
-             << ", ignoring it";
+    audioBitrateCallback(toxav, friendNum, arate, vSelf);
+    videoBitrateCallback(toxav, friendNum, vrate, vSelf);
 }
 
-// This is only a dummy implementation for now
 void CoreAV::audioBitrateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t rate, void* vSelf)
 {
-    CoreAV* self = static_cast<CoreAV*>(vSelf);
-    std::ignore = self;
     std::ignore = toxav;
+    CoreAV* self = static_cast<CoreAV*>(vSelf);
+
+    const auto snapshot = self->loadCalls();
+    const CallMap& calls = *snapshot;
 
-    qDebug() << "Recommended audio bitrate with" << friendNum << " is now " << rate << ", ignoring it";
+    auto it = calls.find(friendNum);
+    if (it == calls.end()) {
+        return;
+    }
+
+    qDebug() << "Recommended audio bitrate with" << friendNum << " is now " << rate;
+    it->second->getRateController().onRecommendedAudioBitrate(rate);
 }
 
-// This is only a dummy implementation for now
 void CoreAV::videoBitrateCallback(ToxAV* toxav, uint32_t friendNum, uint32_t rate, void* vSelf)
 {
-    CoreAV* self = static_cast<CoreAV*>(vSelf);
-    std::ignore = self;
     std::ignore = toxav;
+    CoreAV* self = static_cast<CoreAV*>(vSelf);
+
+    const auto snapshot = self->loadCalls();
+    const CallMap& calls = *snapshot;
+
+    auto it = calls.find(friendNum);
+    if (it == calls.end()) {
+        return;
+    }
 
-    qDebug() << "Recommended video bitrate with" << friendNum << " is now " << rate << ", ignoring it";
+    qDebug() << "Recommended video bitrate with" << friendNum << " is now " << rate;
+    it->second->getRateController().onRecommendedVideoBitrate(rate);
 }
 
 void CoreAV::audioFrameCallback(ToxAV* toxAV, uint32_t friendNum, const int16_t* pcm, size_t sampleCount,
                                 uint8_t channels, uint32_t samplingRate, void* vSelf)
 {
+    TRACE_SCOPE("CoreAV::audioFrameCallback");
     std::ignore = toxAV;
     CoreAV* self = static_cast<CoreAV*>(vSelf);
     // This callback should come from the CoreAV thread
     assert(QThread::currentThread() == self->coreavThread.get());
-    // QReadLocker locker{&self->callsLock};
+    const auto snapshot = self->loadCalls();
+    const CallMap& calls = *snapshot;
 
-    auto it = self->calls.find(friendNum);
-    if (it == self->calls.end()) {
+    auto it = calls.find(friendNum);
+    if (it == calls.end()) {
         return;
     }
 
@@ -1285,59 +1593,34 @@ void CoreAV::audioFrameCallback(ToxAV* toxAV, uint32_t friendNum, const int16_t*
         return;
     }
 
+    QElapsedTimer receiveTimer;
+    receiveTimer.start();
+
     // filteraudio:X //
-    // qDebug() << "filter_audio playback audio: chans:" << channels << "rate:" << samplingRate << "sampleCount:" << sampleCount;
-    if (    (channels == 1)
-            && (samplingRate == IAudioControl::AUDIO_SAMPLE_RATE)
-            && ((sampleCount == 1920) || (sampleCount == 2880))
-        ) {
-        if (self->audioSettings.getEchoCancellation()) {
-            const int audio_frame_in_ms = (sampleCount * 1000) / samplingRate;
-            // HINT: we allow 40ms and 60ms sound incoming @48kHz Mono
-            // printf("WebRtcAecm_BufferFarend:audio_frame_in_ms:%d\n", audio_frame_in_ms);
-            if (audio_frame_in_ms >= 10)
-            {
-                // downsample to 16khz
-                int16_t *pcm_buf_resampled = (int16_t *)calloc(1, sizeof(int16_t) * (sampleCount / 3));
-                downsample_48000_to_16000_basic(pcm, pcm_buf_resampled, sampleCount);
-
-                const int split_factor = (audio_frame_in_ms / 10);
-                const int sample_count_split = sampleCount / split_factor;
-                // printf("WebRtcAecm_BufferFarend:audio_frame_in_ms:split_factor=%d sampleCount=%d sample_count_split=%d\n",
-                //         split_factor, (int32_t)sampleCount, sample_count_split);
-                for (int x=0;x<split_factor;x++)
-                {
-                    self->aec_mutex.lock();
-                    int32_t res = WebRtcAecm_BufferFarend(
-                                    self->webrtc_aecmInst,
-                                    pcm_buf_resampled + (x * (sample_count_split / 3)),
-                                    (int16_t)(sample_count_split / 3)
-                                    );
-                    self->aec_mutex.unlock();
-                    std::ignore = res;
-                    // printf("WebRtcAecm_BufferFarend:#%d %d\n", x, res);
-                }
-
-                free(pcm_buf_resampled);
-            }
-        }
+    if ((channels == 1) && (samplingRate == IAudioControl::AUDIO_SAMPLE_RATE)
+        && (self->audioSettings.getEchoCancellation()
+            || self->audioSettings.getFullAudioProcessing())) {
+        call.getAudioDsp().bufferFarEnd(pcm, sampleCount);
     }
 
     call.playAudioBuffer(pcm, sampleCount, channels, samplingRate);
+    call.getLatencyStats().receive.add(receiveTimer.nsecsElapsed() / 1000000.0);
 }
 
 void CoreAV::videoFrameCallback(ToxAV* toxAV, uint32_t friendNum, uint16_t w, uint16_t h,
                                 const uint8_t* y, const uint8_t* u, const uint8_t* v,
                                 int32_t ystride, int32_t ustride, int32_t vstride, void* vSelf)
 {
+    TRACE_SCOPE("CoreAV::videoFrameCallback");
     std::ignore = toxAV;
     auto self = static_cast<CoreAV*>(vSelf);
-    // This callback should come from the CoreAV thread
-    assert(QThread::currentThread() == self->coreavThread.get());
-    QReadLocker locker{&self->callsLock};
+    // This callback should come from the video iteration thread
+    assert(QThread::currentThread() == self->videoIterateThread.get());
+    const auto snapshot = self->loadCalls();
+    const CallMap& calls = *snapshot;
 
-    auto it = self->calls.find(friendNum);
-    if (it == self->calls.end()) {
+    auto it = calls.find(friendNum);
+    if (it == calls.end()) {
         return;
     }
 
@@ -1346,6 +1629,8 @@ void CoreAV::videoFrameCallback(ToxAV* toxAV, uint32_t friendNum, uint16_t w, ui
         return;
     }
 
+    it->second->getCallStats().onVideoReceived(w, h);
+
     vpx_image frame;
     frame.d_h = h;
     frame.d_w = w;
@@ -1362,86 +1647,215 @@ void CoreAV::videoFrameCallback(ToxAV* toxAV, uint32_t friendNum, uint16_t w, ui
 void CoreAV::videoCommCallback(ToxAV* toxAV, uint32_t friend_number, TOXAV_CALL_COMM_INFO comm_value,
                                 int64_t comm_number, void *vSelf)
 {
-    std::ignore = comm_number;
+    std::ignore = toxAV;
     auto self = static_cast<CoreAV*>(vSelf);
 
-    if (comm_value == TOXAV_CALL_COMM_ENCODER_CURRENT_BITRATE) {
-        if (self->audioSettings.getScreenVideoFPS() == 30) {
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-        } else if (self->audioSettings.getScreenVideoFPS() == 25) {
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 11000, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 10000, NULL);
-        } else if (self->audioSettings.getScreenVideoFPS() == 20) {
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 1, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MAX_BITRATE, 180, NULL);
-            toxav_option_set(toxAV, friend_number, TOXAV_ENCODER_VIDEO_MIN_BITRATE, 2700, NULL);
+    if (comm_value != TOXAV_CALL_COMM_ENCODER_CURRENT_BITRATE) {
+        return;
+    }
+
+    const auto snapshot = self->loadCalls();
+    const CallMap& calls = *snapshot;
+
+    auto it = calls.find(friend_number);
+    if (it == calls.end()) {
+        return;
+    }
+
+    // the encoder adjusted its bitrate on its own, feed it to the controller and restore our limits
+    ToxFriendCall& call = *it->second;
+    const uint32_t encoderKbps = static_cast<uint32_t>(std::max<int64_t>(0, comm_number));
+    call.getCallStats().onEncoderBitrate(encoderKbps);
+    call.getRateController().onEncoderBitrate(encoderKbps);
+    self->applyCallRates(friend_number, call);
+}
+
+/**
+ * @brief Resets the rate control of a call that just started and applies its initial rates.
+ * @param friendNum Id of friend in call list.
+ * @param call The call to start rate control for.
+ */
+void CoreAV::startRateControl(uint32_t friendNum, ToxFriendCall& call) const
+{
+    const auto limits = CallRateController::limitsForFps(audioSettings.getScreenVideoFPS());
+    call.getRateController().reset(audioSettings.getAudioBitrate(), limits);
+    call.getAudioResilience().reset();
+    call.setExtraPlayoutFrames(0);
+    call.getVideoLadder().reset();
+    applyCpuCap(call);
+    qDebug() << "Video bitrate range for call" << friendNum << ":" << limits.minKbps << "-"
+             << limits.maxKbps << "kbit/s";
+    applyCallRates(friendNum, call);
+    applyEncoderProfile(friendNum, call, wantedEncoderProfile());
+}
+
+/**
+ * @brief Encoder profile for the preset picked in the settings and the current video device.
+ */
+CallEncoderProfile CoreAV::wantedEncoderProfile() const
+{
+    const CallEncoderProfile profile{CallEncoderProfile::presetFromInt(videoEncoderPreset),
+                                     cameraSource.isScreen()};
+    return cpuGovernor.isActive(CpuGovernor::Step::EncoderSpeed) ? profile.faster() : profile;
+}
+
+/**
+ * @brief Sets the encoder speed and tuning of a call in toxav.
+ *
+ * toxav doesn't expose the encoder's thread count or keyframe interval, so speed and content
+ * tuning are what's left to pick per call.
+ * @param friendNum Id of friend in call list.
+ * @param call The call to apply the profile for.
+ * @param profile The profile to apply.
+ */
+void CoreAV::applyEncoderProfile(uint32_t friendNum, ToxFriendCall& call,
+                                 const CallEncoderProfile& profile) const
+{
+    toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_CPU_USED, profile.getCpuUsed(),
+                     nullptr);
+    toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VP8_QUALITY,
+                     profile.getHighQuality() ? TOXAV_ENCODER_VP8_QUALITY_HIGH
+                                              : TOXAV_ENCODER_VP8_QUALITY_NORMAL,
+                     nullptr);
+    call.setEncoderProfile(profile);
+    qDebug() << "Encoder profile for call" << friendNum << ": cpu-used" << profile.getCpuUsed()
+             << (profile.isScreenContent() ? "screen content" : "camera");
+}
+
+/**
+ * @brief Lets the CallAudioResilience of every call re-evaluate the measured loss.
+ */
+void CoreAV::updateAudioResilience()
+{
+    assert(QThread::currentThread() == coreavThread.get());
+
+    const auto snapshot = loadCalls();
+    const qint64 nowMs = rateClock.elapsed();
+    for (const auto& it : *snapshot) {
+        ToxFriendCall& call = *it.second;
+        if (call.getAudioResilience().update(nowMs)) {
+            applyAudioResilience(it.first, call);
         }
     }
 }
 
-int32_t CoreAV::upsample_16000_to_48000_basic(const int16_t* in, int16_t *out, int32_t sample_count)
+/**
+ * @brief Applies the parts of the audio resilience profile that aren't read with every frame.
+ *
+ * toxav always runs Opus with in-band FEC and does the packet loss concealment of received
+ * audio itself, but has no API to configure either. What we can do is keep enough bitrate for
+ * the encoder to spend on FEC, and buffer a frame more so recovered frames are still on time.
+ * The packet size is picked by sendCallAudio.
+ * @param friendNum Id of friend in call list.
+ * @param call The call to apply the profile for.
+ */
+void CoreAV::applyAudioResilience(uint32_t friendNum, ToxFriendCall& call) const
 {
-    if (sample_count < 1)
-    {
-        return -1;
+    const CallAudioResilience::Profile profile = call.getAudioResilience().getProfile();
+    qDebug() << "Audio resilience for call" << friendNum << ": expected loss"
+             << profile.expectedLossPercent << "%, FEC" << profile.fec << ", packets of"
+             << profile.frameMs << "ms";
+
+    call.setExtraPlayoutFrames(profile.fec ? CallAudioResilience::FEC_EXTRA_PLAYOUT_FRAMES : 0);
+    if (call.getRateController().setAudioFloor(
+            profile.fec ? CallAudioResilience::FEC_MIN_AUDIO_KBPS : 0)) {
+        applyCallRates(friendNum, call);
     }
+}
 
-    ma_uint64 frameCountIn  = sample_count;
-    ma_uint64 frameCountOut = sample_count * 3;
-    ma_result result = ma_resampler_process_pcm_frames(&miniaudio_upsample_resampler, in, &frameCountIn, out, &frameCountOut);
-    if (result != MA_SUCCESS) {
-        qDebug() << "upsample_16000_to_48000_basic:error!!";
+/**
+ * @brief Samples the CPU time of the process and lets the governor step up or down.
+ *
+ * The budget grows with the number of calls, but never takes more than MAX_CPU_SHARE of the
+ * machine. Without calls everything goes back to full quality.
+ */
+void CoreAV::updateCpuGovernor()
+{
+    assert(QThread::currentThread() == coreavThread.get());
+
+    const auto snapshot = loadCalls();
+    if (snapshot->empty()) {
+        const bool wasActive = cpuGovernor.getLevel() != CpuGovernor::Step::None;
+        cpuGovernor.reset();
+        lastThreadCpu.clear();
+        if (wasActive) {
+            qDebug() << "No call left, lifting the CPU limits";
+            applyCpuGovernor(*snapshot);
+        }
+        return;
     }
 
-#if 0
-    int16_t tmp1;
-    int16_t tmp2;
-    int16_t v1;
-    int16_t v2;
-    for (int i=0;i<sample_count;i++)
-    {
-        tmp1 = *(in);
-        tmp2 = *(in + 1);
-        v1 =   (int16_t)((float)(tmp2 - tmp1) / 3.0f);
-        v2 =   (int16_t)(((float)(tmp2 - tmp1) * 2.0f) / 3.0f);
-        *out = tmp1;
-        out++;
-        *out = tmp1 + v1;
-        out++;
-        *out = tmp1 + v2;
-        out++;
-        in++;
+    const double budget = std::min(snapshot->size() * CPU_CORES_PER_CALL,
+                                   std::max(1, QThread::idealThreadCount()) * MAX_CPU_SHARE);
+    cpuGovernor.setBudget(budget);
+
+    const qint64 cpuNs = ThreadCpuTime::processNs();
+    if (cpuNs < 0) {
+        return;
     }
-#endif
 
-    return 0;
+    const QVector<ThreadCpuTime::Sample> threads = ThreadCpuTime::sample();
+    if (cpuGovernor.update(rateClock.elapsed(), cpuNs)) {
+        qDebug() << "CPU load" << cpuGovernor.getLoad() << "of" << budget << "cores, busiest thread"
+                 << busiestThread(lastThreadCpu, threads) << ", limiting up to"
+                 << CpuGovernor::stepName(cpuGovernor.getLevel());
+        applyCpuGovernor(*snapshot);
+    }
+    lastThreadCpu = threads;
 }
 
-int32_t CoreAV::downsample_48000_to_16000_basic(const int16_t* in, int16_t *out, int32_t sample_count)
+/**
+ * @brief Applies the governor's steps that aren't read on the fly.
+ *
+ * Encoder speed and noise suppression are picked up with the next frame.
+ * @param calls The calls to cap.
+ */
+void CoreAV::applyCpuGovernor(const CallMap& calls) const
 {
-    if (sample_count < 3)
-    {
-        return -1;
+    const bool limitPreview = cpuGovernor.isActive(CpuGovernor::Step::PreviewFps);
+    VideoSurface::setPreviewFpsLimit(limitPreview ? GOVERNED_PREVIEW_FPS : 0);
+    for (const auto& call : calls) {
+        applyCpuCap(*call.second);
     }
+}
 
-    ma_uint64 frameCountIn  = sample_count;
-    ma_uint64 frameCountOut = sample_count / 3;
-    ma_result result = ma_resampler_process_pcm_frames(&miniaudio_downsample_resampler, in, &frameCountIn, out, &frameCountOut);
-    if (result != MA_SUCCESS) {
-        qDebug() << "downsample_48000_to_16000_basic:error!!";
-    }
+/**
+ * @brief Caps the resolution and frame rate a call sends to the governor's current steps.
+ * @param call The call to cap.
+ */
+void CoreAV::applyCpuCap(const ToxFriendCall& call) const
+{
+    const bool limitSize = cpuGovernor.isActive(CpuGovernor::Step::CaptureResolution);
+    const bool limitFps = cpuGovernor.isActive(CpuGovernor::Step::VideoFps);
+    call.getVideoLadder().setCpuCap(limitSize ? GOVERNED_RUNG_INDEX : 0,
+                                    limitFps ? GOVERNED_VIDEO_FPS : 0);
+}
 
-#if 0
-    for (int i=0;i<(sample_count / 3);i++)
-    {
-        *out = *(in + 0);
-        out++;
-        in = in + 3;
+/**
+ * @brief Pushes the rates picked by the call's CallRateController to toxav.
+ * @param friendNum Id of friend in call list.
+ * @param call The call to apply the rates for.
+ */
+void CoreAV::applyCallRates(uint32_t friendNum, const ToxFriendCall& call) const
+{
+    const CallRateController& rates = call.getRateController();
+
+    Toxav_Err_Bit_Rate_Set err;
+    toxav_audio_set_bit_rate(toxav.get(), friendNum, rates.getAudioBitrate(), &err);
+    PARSE_ERR(err);
+
+    if (!call.getVideoEnabled() || call.getNullVideoBitrate()) {
+        return;
     }
-#endif
 
-    return 0;
+    // we pick the bitrate ourselves, don't let the encoder override it
+    const uint32_t videoKbps = rates.getVideoBitrate();
+    const CallRateController::VideoLimits limits = rates.getVideoLimits();
+    toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_BITRATE_AUTOSET, 0, nullptr);
+    toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MIN_BITRATE,
+                     static_cast<int32_t>(std::min(limits.minKbps, videoKbps)), nullptr);
+    toxav_option_set(toxav.get(), friendNum, TOXAV_ENCODER_VIDEO_MAX_BITRATE,
+                     static_cast<int32_t>(videoKbps), nullptr);
+    toxav_video_set_bit_rate(toxav.get(), friendNum, videoKbps, &err);
+    PARSE_ERR(err);
 }
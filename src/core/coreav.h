@@ -20,26 +20,24 @@
 
 #pragma once
 
-#if 0
-#include "filter_audio/filter_audio.h"
-#else
-// commit 051b62014cfa18adf7ca7caf327b0c0882353f22
-// Author: kjellander <kjellander@webrtc.org>
-// Date:   Wed Dec 30 11:58:12 2015 -0800
-//
-//     Roll chromium_revision 58e631b..d66326c (367148:367167)
-#include "webrtc6/webrtc/modules/audio_processing/aecm/echo_control_mobile.h"
-#include "webrtc6/webrtc/modules/audio_processing/ns/noise_suppression_x.h"
-#endif
-
+#include "audio/audiolevel.h"
+#include "src/core/callstats.h"
+#include "src/core/cpugovernor.h"
+#include "src/core/loopstats.h"
 #include "src/core/toxcall.h"
 #include "util/compatiblerecursivemutex.h"
+#include "util/diagnosticsregistry.h"
+#include "util/threadcputime.h"
 
+#include <QElapsedTimer>
+#include <QJsonObject>
 #include <QObject>
 #include <QMutex>
 #include <QReadWriteLock>
 #include <atomic>
+#include <map>
 #include <memory>
+#include <vector>
 #include <tox/toxav.h>
 
 class Friend;
@@ -54,6 +52,9 @@ class CameraSource;
 class VideoSource;
 class VideoFrame;
 class Core;
+class CoreAudioSender;
+class CoreGroupAudioReceiver;
+class CoreVideoSender;
 struct vpx_image;
 
 class CoreAV : public QObject
@@ -76,13 +77,21 @@ public:
     bool isCallActive(const Friend* f) const;
     bool isCallActive(const Group* g) const;
     bool isCallVideoEnabled(const Friend* f) const;
+    bool hasCalls() const;
+    bool queueCallAudio(uint32_t callId, const int16_t* pcm, size_t samples, uint8_t chans,
+                        uint32_t rate);
     bool sendCallAudio(uint32_t callId, const int16_t* pcm, size_t samples, uint8_t chans,
-                       uint32_t rate) const;
+                       uint32_t rate, qreal queuedMs) const;
+    void queueCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> frame);
     void sendCallVideo(uint32_t callId, std::shared_ptr<VideoFrame> frame);
     bool sendGroupCallAudio(int groupNum, const int16_t* pcm, size_t samples, uint8_t chans,
                             uint32_t rate) const;
+    void playGroupCallAudio(int groupNum, const ToxPk& peerPk, const int16_t* pcm, size_t samples,
+                            uint8_t chans, uint32_t rate);
 
     VideoSource* getVideoSourceFromCall(int friendNum) const;
+    QString getAudioLatencyReport() const;
+    CallStats::Snapshot takeCallStats(uint32_t friendNum) const;
     void sendNoVideo();
 
     void joinGroupCall(const Group& group);
@@ -100,6 +109,7 @@ public:
                                   unsigned samples, uint8_t channels, uint32_t sample_rate,
                                   void* core);
     void invalidateGroupCallPeerSource(const Group& group, ToxPk peerPk);
+    std::map<ToxPk, AudioLevel> takeGroupPeerLevels(int groupNum);
 
 public slots:
     bool startCall(uint32_t friendNum, bool video);
@@ -134,7 +144,34 @@ private:
            IAudioSettings& audioSettings_, IGroupSettings& groupSettings_, CameraSource& cameraSource);
     void connectCallbacks();
 
-    void process();
+    using ToxFriendCallPtr = std::shared_ptr<ToxFriendCall>;
+    /**
+     * @brief Maps friend IDs to ToxFriendCall.
+     * @note Need to use STL container here, because Qt containers need a copy constructor.
+     */
+    using CallMap = std::map<uint32_t, ToxFriendCallPtr>;
+
+    std::shared_ptr<const CallMap> loadCalls() const;
+    void publishCalls(CallMap newCalls);
+    void removeCall(uint32_t friendNum);
+    void reclaimCalls();
+
+    void processAudio();
+    void processVideo();
+    Toxav_Err_Send_Frame sendAudioPacket(uint32_t callId, const int16_t* pcm, size_t samples,
+                                         uint8_t chans, uint32_t rate) const;
+    void startRateControl(uint32_t friendNum, ToxFriendCall& call) const;
+    void applyCallRates(uint32_t friendNum, const ToxFriendCall& call) const;
+    CallEncoderProfile wantedEncoderProfile() const;
+    void applyEncoderProfile(uint32_t friendNum, ToxFriendCall& call,
+                             const CallEncoderProfile& profile) const;
+    void publishGroupPeerLevel(int groupNum, const ToxPk& peerPk, const AudioLevel& level);
+    void updateCpuGovernor();
+    void updateAudioResilience();
+    void applyAudioResilience(uint32_t friendNum, ToxFriendCall& call) const;
+    void applyCpuGovernor(const CallMap& calls) const;
+    void applyCpuCap(const ToxFriendCall& call) const;
+    QJsonObject collectDiagnostics() const;
     static void audioFrameCallback(ToxAV* toxAV, uint32_t friendNum, const int16_t* pcm,
                                    size_t sampleCount, uint8_t channels, uint32_t samplingRate,
                                    void* self);
@@ -144,25 +181,38 @@ private:
     static void videoCommCallback(ToxAV *av, uint32_t friend_number, TOXAV_CALL_COMM_INFO comm_value,
                                 int64_t comm_number, void *vSelf);
 
-    static int32_t downsample_48000_to_16000_basic(const int16_t* in, int16_t *out, int32_t sample_count);
-    static int32_t upsample_16000_to_48000_basic(const int16_t* in, int16_t *out, int32_t sample_count);
-    static int32_t downsample_48000_to_16000_advanced_001(const int16_t* in, int16_t *out, int32_t sample_count);
-    static int32_t downsample_48000_to_16000_advanced_002(const int16_t* in, int16_t *out, int32_t sample_count);
 private:
     static constexpr uint32_t VIDEO_DEFAULT_BITRATE = 8000;
+    static constexpr qint64 AUDIO_LOOP_STALL_MS = 20;
+    static constexpr qint64 VIDEO_LOOP_STALL_MS = 100;
+    static constexpr int CPU_SAMPLE_MS = 1000;
+    static constexpr double CPU_CORES_PER_CALL = 1.5;
+    static constexpr double MAX_CPU_SHARE = 0.75;
+    static constexpr int GOVERNED_PREVIEW_FPS = 15;
+    static constexpr int GOVERNED_RUNG_INDEX = 2;
+    static constexpr int GOVERNED_VIDEO_FPS = 15;
 
 private:
     // atomic because potentially accessed by different threads
     std::atomic<IAudioControl*> audio;
     std::unique_ptr<ToxAV, ToxAVDeleter> toxav;
     std::unique_ptr<QThread> coreavThread;
+    std::unique_ptr<QThread> videoIterateThread;
+    std::unique_ptr<CoreAudioSender> audioSender;
+    std::unique_ptr<CoreGroupAudioReceiver> groupAudioReceiver;
+    std::unique_ptr<CoreVideoSender> videoSender;
     QTimer* iterateTimer = nullptr;
-    using ToxFriendCallPtr = std::unique_ptr<ToxFriendCall>;
+    std::unique_ptr<QTimer> videoIterateTimer;
+    QTimer* governorTimer = nullptr;
     /**
-     * @brief Maps friend IDs to ToxFriendCall.
-     * @note Need to use STL container here, because Qt containers need a copy constructor.
+     * @brief Published friend calls, only accessed with std::atomic_load/std::atomic_exchange.
      */
-    std::map<uint32_t, ToxFriendCallPtr> calls;
+    std::shared_ptr<const CallMap> callSnapshot{std::make_shared<CallMap>()};
+    /**
+     * @brief Replaced snapshots that readers may still hold, protected by callsLock.
+     */
+    std::vector<std::shared_ptr<const CallMap>> retiredCalls;
+    std::atomic<bool> haveRetiredCalls{false};
 
 
     using ToxGroupCallPtr = std::unique_ptr<ToxGroupCall>;
@@ -172,9 +222,17 @@ private:
      */
     std::map<int, ToxGroupCallPtr> groupCalls;
 
-    // protect 'calls' and 'groupCalls'
+    // serializes writers of 'callSnapshot' and protects 'groupCalls'
     mutable QReadWriteLock callsLock{QReadWriteLock::Recursive};
 
+    /**
+     * @brief Audio level of each group peer we receive audio from, polled by the GUI.
+     * @note Need to use STL container here, because the meters can't be copied.
+     */
+    std::map<int, std::map<ToxPk, AudioLevelMeter>> groupPeerLevels;
+    // only protects the structure of 'groupPeerLevels', the meters themselves are lock free
+    QMutex groupPeerLevelsLock;
+
     /**
      * @brief needed to synchronize with the Core thread, some toxav_* functions
      *        must not execute at the same time as tox_iterate()
@@ -186,10 +244,19 @@ private:
     IGroupSettings& groupSettings;
     CameraSource& cameraSource;
 
-    // filteraudio:X //
-    NsxHandle* nsxInst = nullptr;
-    void *webrtc_aecmInst = nullptr;
-    mutable int16_t *pcm_buf_out = nullptr;
-    mutable size_t pcm_buf_out_samples = 0;
-    mutable QMutex aec_mutex;
+    // CallEncoderProfile::Preset picked in the settings, read by the video send thread
+    std::atomic_int videoEncoderPreset;
+
+    // monotonic time base for the per call rate controllers
+    QElapsedTimer rateClock;
+
+    // only accessed on the CoreAV thread, apart from CpuGovernor's own thread safe getters
+    CpuGovernor cpuGovernor;
+    QVector<ThreadCpuTime::Sample> lastThreadCpu;
+
+    LoopStats audioLoopStats{QStringLiteral("CoreAV audio"), AUDIO_LOOP_STALL_MS};
+    LoopStats videoLoopStats{QStringLiteral("CoreAV video"), VIDEO_LOOP_STALL_MS};
+
+    // last, so it unregisters before the calls and senders it reads are destroyed
+    DiagnosticsSource diagnostics{"av", [this] { return collectDiagnostics(); }};
 };
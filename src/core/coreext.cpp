@@ -57,42 +57,88 @@ CoreExt::CoreExt(ExtensionPtr<ToxExt> toxExt_)
         tox_extension_messages_free);
 }
 
+CoreExt::~CoreExt()
+{
+    // toxext has no way to drop a packet list, so messages added after the last iteration go out
+    std::lock_guard<std::mutex> lock(toxext_mutex);
+    sendPendingLists();
+}
+
 void CoreExt::process()
 {
     std::lock_guard<std::mutex> lock(toxext_mutex);
+    for (size_t i = 0; i < incomingCount; ++i) {
+        const IncomingPacket& packet = incomingPackets[i];
+        toxext_handle_lossless_custom_packet(toxExt.get(), packet.friendId, packet.data.data(),
+                                             packet.data.size());
+    }
+    incomingCount = 0;
+
+    sendPendingLists();
     toxext_iterate(toxExt.get());
 }
 
 void CoreExt::onLosslessPacket(uint32_t friendId, const uint8_t* data, size_t length)
 {
-    if (is_toxext_packet(data, length)) {
-        std::lock_guard<std::mutex> lock(toxext_mutex);
-        toxext_handle_lossless_custom_packet(toxExt.get(), friendId, data, length);
+    if (!is_toxext_packet(data, length)) {
+        return;
     }
+
+    // called during tox_iterate, process() runs right after it on the same thread
+    if (incomingCount == incomingPackets.size()) {
+        incomingPackets.emplace_back();
+    }
+
+    IncomingPacket& packet = incomingPackets[incomingCount++];
+    packet.friendId = friendId;
+    packet.data.assign(data, data + length);
+}
+
+/**
+ * @brief Gets the list collecting the extended messages to a friend until the next process().
+ * @note toxext_mutex must be locked.
+ */
+ToxExtPacketList* CoreExt::getPendingList(uint32_t friendId)
+{
+    ToxExtPacketList*& packetList = pendingLists[friendId];
+    if (!packetList) {
+        packetList = toxext_packet_list_create(toxExt.get(), friendId);
+    }
+
+    return packetList;
+}
+
+/**
+ * @brief Sends one packet list per friend with all extended messages added since the last call.
+ * @note toxext_mutex must be locked.
+ */
+void CoreExt::sendPendingLists()
+{
+    for (const auto& pending : pendingLists) {
+        if (toxext_send(pending.second) != TOXEXT_SUCCESS) {
+            qWarning() << "Failed to send packet to friend" << pending.first;
+        }
+    }
+
+    pendingLists.clear();
 }
 
 CoreExt::Packet::Packet(
-    ToxExtPacketList* packetList_,
-    ToxExtensionMessages* toxExtMessages_,
+    CoreExt* coreExt_,
     uint32_t friendId_,
-    std::mutex* toxext_mutex_,
     PacketPassKey passKey)
-    : toxext_mutex(toxext_mutex_)
-    , toxExtMessages(toxExtMessages_)
-    , packetList(packetList_)
+    : coreExt(coreExt_)
     , friendId(friendId_)
 {
     std::ignore = passKey;
-    assert(toxext_mutex != nullptr);
+    assert(coreExt != nullptr);
 }
 
 std::unique_ptr<ICoreExtPacket> CoreExt::getPacket(uint32_t friendId)
 {
     return std::unique_ptr<Packet>(new Packet(
-        toxext_packet_list_create(toxExt.get(), friendId),
-        toxExtMessages.get(),
+        this,
         friendId,
-        &toxext_mutex,
         PacketPassKey{}));
 }
 
@@ -108,6 +154,7 @@ uint64_t CoreExt::Packet::addExtendedMessage(QString message)
 
     int size = message.toUtf8().size();
     enum Tox_Extension_Messages_Error err;
+    ToxExtensionMessages* toxExtMessages = coreExt->toxExtMessages.get();
     auto maxSize = static_cast<int>(tox_extension_messages_get_max_sending_size(
         toxExtMessages,
         friendId,
@@ -121,9 +168,11 @@ uint64_t CoreExt::Packet::addExtendedMessage(QString message)
     }
 
     ToxString toxString(message);
+    // appended to the messages other packets queued for this friend during this iteration
+    std::lock_guard<std::mutex> lock(coreExt->toxext_mutex);
     const auto receipt = tox_extension_messages_append(
         toxExtMessages,
-        packetList,
+        coreExt->getPendingList(friendId),
         toxString.data(),
         toxString.size(),
         friendId,
@@ -136,18 +185,23 @@ uint64_t CoreExt::Packet::addExtendedMessage(QString message)
     return receipt;
 }
 
+/**
+ * @brief Hands the packet to the core thread, which sends it with the next iteration.
+ * @return Always true, a failed send is only logged, like a failed tox_friend_send_message
+ *  is noticed by the missing receipt.
+ */
 bool CoreExt::Packet::send()
 {
-    std::lock_guard<std::mutex> lock(*toxext_mutex);
-
-    auto ret = toxext_send(packetList);
-    if (ret != TOXEXT_SUCCESS) {
-        qWarning() << "Failed to send packet";
+    if (hasBeenSent) {
+        assert(false);
+        qWarning() << "Invalid use of CoreExt::Packet";
+        return false;
     }
-    // Indicate we've sent the packet even on failure since our packetlist will
-    // be invalid no matter what
+
+    // The messages are already in the friend's pending list, they go out with the next
+    // CoreExt::process() together with all other messages to this friend
     hasBeenSent = true;
-    return ret == TOXEXT_SUCCESS;
+    return true;
 }
 
 uint64_t CoreExt::getMaxExtendedMessageSize()
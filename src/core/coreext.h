@@ -29,6 +29,7 @@
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 struct Tox;
 struct ToxExt;
@@ -60,17 +61,20 @@ public:
     CoreExt(CoreExt&& other) = delete;
     CoreExt& operator=(CoreExt const& other) = delete;
     CoreExt& operator=(CoreExt&& other) = delete;
+    ~CoreExt() override;
 
     /**
-     * @brief Periodic service function
+     * @brief Periodic service function, hands the packets queued since the last call to
+     *  toxext and sends the extended messages added meanwhile, all in one locked section
      */
     void process();
 
     /**
-     * @brief Handles extension related lossless packets
+     * @brief Queues extension related lossless packets until the next process() call
      * @param[in] friendId Core id of friend
      * @param[in] data Packet data
      * @param[in] length Length of packet data
+     * @note Must be called on the core thread, like process()
      */
     void onLosslessPacket(uint32_t friendId, const uint8_t* data, size_t length);
 
@@ -84,10 +88,8 @@ public:
          * @brief Internal constructor for a packet.
          */
         Packet(
-            ToxExtPacketList* packetList,
-            ToxExtensionMessages* toxExtMessages,
+            CoreExt* coreExt,
             uint32_t friendId,
-            std::mutex* toxext_mutex,
             PacketPassKey passKey);
 
         // Delete copy constructor, we shouldn't be able to copy
@@ -95,28 +97,21 @@ public:
 
         Packet(Packet&& other)
         {
-            toxExtMessages = other.toxExtMessages;
-            packetList = other.packetList;
+            coreExt = other.coreExt;
             friendId = other.friendId;
             hasBeenSent = other.hasBeenSent;
-            toxext_mutex = other.toxext_mutex;
-            other.toxExtMessages = nullptr;
-            other.packetList = nullptr;
+            other.coreExt = nullptr;
             other.friendId = 0;
             other.hasBeenSent = false;
-            other.toxext_mutex = nullptr;
         }
 
         uint64_t addExtendedMessage(QString message) override;
 
         bool send() override;
     private:
-        std::mutex* toxext_mutex;
         bool hasBeenSent = false;
         // Note: non-owning pointer
-        ToxExtensionMessages* toxExtMessages;
-        // Note: packetList is freed on send() call
-        ToxExtPacketList* packetList;
+        CoreExt* coreExt;
         uint32_t friendId;
     };
 
@@ -144,9 +139,24 @@ private:
     template <class T>
     using ExtensionPtr = std::unique_ptr<T, void(*)(T*)>;
 
+    struct IncomingPacket
+    {
+        uint32_t friendId;
+        std::vector<uint8_t> data;
+    };
+
     CoreExt(ExtensionPtr<ToxExt> toxExt);
 
+    ToxExtPacketList* getPendingList(uint32_t friendId);
+    void sendPendingLists();
+
     std::mutex toxext_mutex;
+    // only touched on the core thread, entries are reused to save allocations
+    std::vector<IncomingPacket> incomingPackets;
+    size_t incomingCount = 0;
+    // extended messages of all packets sent to a friend since the last process(), guarded by
+    // toxext_mutex. Note: the lists are freed by toxext_send()
+    std::unordered_map<uint32_t, ToxExtPacketList*> pendingLists;
     std::unordered_map<uint32_t, Status::Status> currentStatuses;
     ExtensionPtr<ToxExt> toxExt;
     ExtensionPtr<ToxExtensionMessages> toxExtMessages;
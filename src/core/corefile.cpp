@@ -20,22 +20,29 @@
 
 #include "corefile.h"
 #include "core.h"
+#include "filechunkreader.h"
+#include "filechunkwriter.h"
 #include "toxfile.h"
 #include "toxstring.h"
 #include "src/persistence/settings.h"
 #include "src/model/status.h"
 #include "src/model/toxclientstandards.h"
 #include "util/compatiblerecursivemutex.h"
+#include "util/lockprofiler.h"
 #include "util/toxcoreerrorparser.h"
+#include "util/tracer.h"
 
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
 #include <QRegularExpression>
 #include <QThread>
 
 #include <tox/tox.h>
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
@@ -46,6 +53,37 @@
  * @brief Manages the file transfer service of toxcore
  */
 
+constexpr unsigned CoreFile::IDLE_INTERVAL_MS;
+constexpr unsigned CoreFile::START_INTERVAL_MS;
+constexpr unsigned CoreFile::MIN_INTERVAL_MS;
+constexpr unsigned CoreFile::MAX_ACTIVE_INTERVAL_MS;
+constexpr int CoreFile::BUSY_CHUNK_EVENTS;
+constexpr qint64 CoreFile::CALL_UPSTREAM_LIMIT;
+constexpr uint64_t CoreFile::RESUME_SAVE_BYTES;
+constexpr int CoreFile::DIAGNOSTICS_LOCK_TIMEOUT_MS;
+
+namespace {
+QString statusName(ToxFile::FileStatus status)
+{
+    switch (status) {
+    case ToxFile::INITIALIZING:
+        return QStringLiteral("initializing");
+    case ToxFile::PAUSED:
+        return QStringLiteral("paused");
+    case ToxFile::TRANSMITTING:
+        return QStringLiteral("transmitting");
+    case ToxFile::BROKEN:
+        return QStringLiteral("broken");
+    case ToxFile::CANCELED:
+        return QStringLiteral("canceled");
+    case ToxFile::FINISHED:
+        return QStringLiteral("finished");
+    }
+
+    return {};
+}
+} // namespace
+
 CoreFilePtr CoreFile::makeCoreFile(Core *core, Tox *tox, CompatibleRecursiveMutex &coreLoopLock)
 {
     assert(core != nullptr);
@@ -61,6 +99,45 @@ CoreFile::CoreFile(Tox *core_, CompatibleRecursiveMutex &coreLoopLock_)
     : tox{core_}
     , coreLoopLock{&coreLoopLock_}
 {
+    clock.start();
+}
+
+CoreFile::~CoreFile() = default;
+
+/**
+ * @brief Throughput of the transfers for the "transfers" section of the diagnostics report.
+ * @note Thread safe, leaves out file names and friends.
+ */
+QJsonObject CoreFile::collectDiagnostics() const
+{
+    // the core thread may hold the lock while waiting for the diagnostics registry
+    if (!coreLoopLock->tryLock(DIAGNOSTICS_LOCK_TIMEOUT_MS)) {
+        return QJsonObject{{"busy", true}};
+    }
+
+    QJsonArray transfers;
+    double sendingSpeed = 0;
+    double receivingSpeed = 0;
+    for (const ToxFile& file : fileMap) {
+        const double speed = file.progress.getSpeed();
+        const bool sending = file.direction == ToxFile::SENDING;
+        (sending ? sendingSpeed : receivingSpeed) += speed;
+        transfers.append(
+            QJsonObject{{"direction", sending ? QStringLiteral("send") : QStringLiteral("receive")},
+                        {"avatar", file.fileKind == TOX_FILE_KIND_AVATAR},
+                        {"status", statusName(file.status)},
+                        {"sizeBytes", static_cast<qint64>(file.progress.getFileSize())},
+                        {"doneBytes", static_cast<qint64>(file.progress.getBytesSent())},
+                        {"bytesPerSecond", speed}});
+    }
+
+    QJsonObject json{{"active", activeTransfers},
+                     {"upstreamLimit", upstreamLimit},
+                     {"sendingBytesPerSecond", sendingSpeed},
+                     {"receivingBytesPerSecond", receivingSpeed},
+                     {"transfers", transfers}};
+    coreLoopLock->unlock();
+    return json;
 }
 
 /**
@@ -68,23 +145,69 @@ CoreFile::CoreFile(Tox *core_, CompatibleRecursiveMutex &coreLoopLock_)
  *
  * tox_iterate calls to get good file transfer performances
  * @return The maximum amount of time in ms that Core should wait between two tox_iterate() calls.
+ *
+ * Without transfers we sleep IDLE_INTERVAL_MS. While files are transmitting, the interval adapts
+ * to how many chunks toxcore requested or delivered since the last call: many chunks per
+ * iteration mean the transfer is limited by how often we iterate, so we iterate more often, down
+ * to MIN_INTERVAL_MS. Hardly any chunks mean a slow transfer, which loses nothing if we wait
+ * longer, up to MAX_ACTIVE_INTERVAL_MS.
  */
 unsigned CoreFile::corefileIterationInterval()
 {
-    /*
-       Sleep at most 1000ms if we have no FT, 10 for user FTs
-       There is no real difference between 10ms sleep and 50ms sleep when it
-       comes to CPU usage – just keep the CPU usage low when there are no file
-       transfers, and speed things up when there is an ongoing file transfer.
-    */
-    constexpr unsigned fileInterval = 4, idleInterval = 1000;
-
-    for (ToxFile& file : fileMap) {
-        if (file.status == ToxFile::TRANSMITTING) {
-            return fileInterval;
-        }
+    // paused transfers don't get chunks, so this is where they are resumed
+    checkBackpressure();
+
+    const int events = chunkEvents;
+    chunkEvents = 0;
+
+    if (activeTransfers == 0) {
+        return IDLE_INTERVAL_MS;
+    }
+
+    if (events >= BUSY_CHUNK_EVENTS) {
+        activeInterval = std::max(MIN_INTERVAL_MS, activeInterval / 2);
+    } else if (events <= 1) {
+        activeInterval = std::min(MAX_ACTIVE_INTERVAL_MS, activeInterval * 2);
+    }
+    return activeInterval;
+}
+
+/**
+ * @brief Checks whether any file is being sent or received right now.
+ * @return Thread safe, the state of the last core iteration.
+ */
+bool CoreFile::hasActiveTransfers() const
+{
+    return transmitting;
+}
+
+/**
+ * @brief Changes the status of a file, keeping count of the transmitting files.
+ * @param file File in fileMap.
+ * @param status New status.
+ */
+void CoreFile::setFileStatus(ToxFile& file, ToxFile::FileStatus status)
+{
+    countTransfer(file, -1);
+    file.status = status;
+    countTransfer(file, 1);
+
+    if (status == ToxFile::FINISHED || status == ToxFile::CANCELED) {
+        forgetTransfer(file);
+    }
+}
+
+void CoreFile::countTransfer(const ToxFile& file, int delta)
+{
+    if (file.status != ToxFile::TRANSMITTING) {
+        return;
     }
-    return idleInterval;
+
+    if (delta > 0 && activeTransfers == 0) {
+        activeInterval = START_INTERVAL_MS;
+    }
+    activeTransfers += delta;
+    transmitting = activeTransfers > 0;
 }
 
 void CoreFile::connectCallbacks(Tox &tox)
@@ -96,9 +219,15 @@ void CoreFile::connectCallbacks(Tox &tox)
     tox_callback_file_recv_control(&tox, CoreFile::onFileControlCallback);
 }
 
-void CoreFile::sendAvatarFile(uint32_t friendId, const QByteArray& data)
+/**
+ * @brief Offers our avatar to a friend.
+ * @param friendId Id of friend to send the avatar to.
+ * @param data Avatar image, empty to tell the friend we have none.
+ * @return False if toxcore refused the transfer, avatarSendFinished() follows otherwise.
+ */
+bool CoreFile::sendAvatarFile(uint32_t friendId, const QByteArray& data)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     uint64_t filesize = 0;
     uint8_t *file_id = nullptr;
@@ -117,7 +246,7 @@ void CoreFile::sendAvatarFile(uint32_t friendId, const QByteArray& data)
     const uint32_t fileNum = tox_file_send(tox, friendId, TOX_FILE_KIND_AVATAR, filesize,
                                     file_id, file_name, nameLength, &error);
     if (!PARSE_ERR(error)) {
-        return;
+        return false;
     }
 
     ToxFile file{fileNum, friendId, "", "", filesize, ToxFile::SENDING, static_cast<uint32_t>(TOX_FILE_KIND_AVATAR)};
@@ -127,16 +256,27 @@ void CoreFile::sendAvatarFile(uint32_t friendId, const QByteArray& data)
     tox_file_get_file_id(tox, friendId, fileNum, reinterpret_cast<uint8_t*>(file.resumeFileId.data()),
                          &fileGetErr);
     if (!PARSE_ERR(fileGetErr)) {
-        return;
+        return false;
     }
     addFile(friendId, fileNum, file);
+    return true;
 }
 
 void CoreFile::sendFile(uint32_t friendId, QString filename, QString filePath,
                         long long filesize)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
+    startSend(friendId, filename, filePath, static_cast<uint64_t>(filesize), {});
+}
 
+/**
+ * @brief Offers a file to a friend.
+ * @param fileId File id of an earlier offer to continue, empty for a new one.
+ * @return False if toxcore refused the offer.
+ */
+bool CoreFile::startSend(uint32_t friendId, const QString& filename, const QString& filePath,
+                         uint64_t filesize, const QByteArray& fileId)
+{
     ToxString fileName(filename);
     Tox_Err_File_Send sendErr;
     uint32_t file_kind;
@@ -150,35 +290,41 @@ void CoreFile::sendFile(uint32_t friendId, QString filename, QString filePath,
         file_kind = TOX_FILE_KIND_DATA;
     }
 
+    const uint8_t* requestedId =
+        fileId.size() == TOX_FILE_ID_LENGTH ? reinterpret_cast<const uint8_t*>(fileId.constData())
+                                            : nullptr;
     uint32_t fileNum = tox_file_send(tox, friendId, file_kind, filesize,
-                                     nullptr, fileName.data(), fileName.size(), &sendErr);
+                                     requestedId, fileName.data(), fileName.size(), &sendErr);
 
     if (!PARSE_ERR(sendErr)) {
         emit fileSendFailed(friendId, fileName.getQString());
-        return;
+        return false;
     }
     qDebug() << QString("sendFile: Created file sender %1 with friend %2 type %3").arg(fileNum).arg(friendId).arg(file_kind);
 
-    ToxFile file{fileNum, friendId, fileName.getQString(), filePath, static_cast<uint64_t>(filesize), ToxFile::SENDING, file_kind};
+    ToxFile file{fileNum, friendId, fileName.getQString(), filePath, filesize, ToxFile::SENDING, file_kind};
     file.resumeFileId.resize(TOX_FILE_ID_LENGTH);
     Tox_Err_File_Get fileGetErr;
     tox_file_get_file_id(tox, friendId, fileNum, reinterpret_cast<uint8_t*>(file.resumeFileId.data()),
                          &fileGetErr);
     if (!PARSE_ERR(fileGetErr)) {
-        return;
+        return false;
     }
     if (!file.open(false)) {
         qWarning() << QString("sendFile: Can't open file, error: %1").arg(file.file->errorString());
     }
 
     addFile(friendId, fileNum, file);
+    // the receiver decides where to continue, so the offset is not ours to track
+    rememberTransfer(file, 0);
 
     emit fileSendStarted(file);
+    return true;
 }
 
 void CoreFile::pauseResumeFile(uint32_t friendId, uint32_t fileId)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     ToxFile* file = findFile(friendId, fileId);
     if (!file) {
@@ -194,11 +340,11 @@ void CoreFile::pauseResumeFile(uint32_t friendId, uint32_t fileId)
     file->pauseStatus.localPauseToggle();
 
     if (file->pauseStatus.paused()) {
-        file->status = ToxFile::PAUSED;
+        setFileStatus(*file, ToxFile::PAUSED);
         file->progress.resetSpeed();
         emit fileTransferPaused(*file);
     } else {
-        file->status = ToxFile::TRANSMITTING;
+        setFileStatus(*file, ToxFile::TRANSMITTING);
         emit fileTransferAccepted(*file);
     }
 
@@ -215,7 +361,7 @@ void CoreFile::pauseResumeFile(uint32_t friendId, uint32_t fileId)
 
 void CoreFile::cancelFileSend(uint32_t friendId, uint32_t fileId)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     ToxFile* file = findFile(friendId, fileId);
     if (!file) {
@@ -228,14 +374,14 @@ void CoreFile::cancelFileSend(uint32_t friendId, uint32_t fileId)
     if (!PARSE_ERR(err)) {
         return;
     }
-    file->status = ToxFile::CANCELED;
+    setFileStatus(*file, ToxFile::CANCELED);
     emit fileTransferCancelled(*file);
     removeFile(friendId, fileId);
 }
 
 void CoreFile::cancelFileRecv(uint32_t friendId, uint32_t fileId)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     ToxFile* file = findFile(friendId, fileId);
     if (!file) {
@@ -247,14 +393,14 @@ void CoreFile::cancelFileRecv(uint32_t friendId, uint32_t fileId)
     if (!PARSE_ERR(err)) {
         return;
     }
-    file->status = ToxFile::CANCELED;
+    setFileStatus(*file, ToxFile::CANCELED);
     emit fileTransferCancelled(*file);
     removeFile(friendId, fileId);
 }
 
 void CoreFile::rejectFileRecvRequest(uint32_t friendId, uint32_t fileId)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     ToxFile* file = findFile(friendId, fileId);
     if (!file) {
@@ -266,20 +412,24 @@ void CoreFile::rejectFileRecvRequest(uint32_t friendId, uint32_t fileId)
     if (!PARSE_ERR(err)) {
         return;
     }
-    file->status = ToxFile::CANCELED;
+    setFileStatus(*file, ToxFile::CANCELED);
     emit fileTransferCancelled(*file);
     removeFile(friendId, fileId);
 }
 
 void CoreFile::acceptFileRecvRequest(uint32_t friendId, uint32_t fileId, QString path)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     ToxFile* file = findFile(friendId, fileId);
     if (!file) {
         qWarning("acceptFileRecvRequest: No such file in queue");
         return;
     }
+    if (file->file->isOpen()) {
+        // continued from an earlier transfer of the same file already
+        return;
+    }
     file->setFilePath(path);
     if (!file->open(true)) {
         qWarning() << "acceptFileRecvRequest: Unable to open file";
@@ -290,13 +440,14 @@ void CoreFile::acceptFileRecvRequest(uint32_t friendId, uint32_t fileId, QString
     if (!PARSE_ERR(err)) {
         return;
     }
-    file->status = ToxFile::TRANSMITTING;
+    setFileStatus(*file, ToxFile::TRANSMITTING);
+    rememberTransfer(*file, 0);
     emit fileTransferAccepted(*file);
 }
 
 ToxFile* CoreFile::findFile(uint32_t friendId, uint32_t fileId)
 {
-    QMutexLocker locker{coreLoopLock};
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
 
     uint64_t key = getFriendKey(friendId, fileId);
     if (fileMap.contains(key)) {
@@ -314,9 +465,15 @@ void CoreFile::addFile(uint32_t friendId, uint32_t fileId, const ToxFile& file)
     if (fileMap.contains(key)) {
         qWarning() << "addFile: Overwriting existing file transfer with same ID" << friendId << ':'
                    << fileId;
+        countTransfer(fileMap[key], -1);
+        chunkReaders.erase(key);
+        chunkWriters.erase(key);
+        backpressured.remove(key);
+        scheduler.remove(key);
     }
 
     fileMap.insert(key, file);
+    countTransfer(file, 1);
 }
 
 void CoreFile::removeFile(uint32_t friendId, uint32_t fileId)
@@ -326,10 +483,264 @@ void CoreFile::removeFile(uint32_t friendId, uint32_t fileId)
         qWarning() << "removeFile: No such file in queue";
         return;
     }
+    const ToxFile& file = fileMap[key];
+    if (file.direction == ToxFile::SENDING && file.fileKind == TOX_FILE_KIND_AVATAR) {
+        // friends cancel avatars they already have, which counts as delivered as well
+        emit avatarSendFinished(friendId, file.status == ToxFile::FINISHED
+                                              || file.status == ToxFile::CANCELED);
+    }
+    countTransfer(file, -1);
+    // the reader may still be reading ahead, it must be gone before the file is closed
+    chunkReaders.erase(key);
+    chunkWriters.erase(key);
+    backpressured.remove(key);
+    scheduler.remove(key);
     fileMap[key].file->close();
     fileMap.remove(key);
 }
 
+FileChunkReader& CoreFile::getChunkReader(const ToxFile& file)
+{
+    std::unique_ptr<FileChunkReader>& reader =
+        chunkReaders[getFriendKey(file.friendId, file.fileNum)];
+    if (!reader) {
+        reader.reset(new FileChunkReader(file.file));
+    }
+    return *reader;
+}
+
+FileChunkWriter& CoreFile::getChunkWriter(const ToxFile& file)
+{
+    std::unique_ptr<FileChunkWriter>& writer =
+        chunkWriters[getFriendKey(file.friendId, file.fileNum)];
+    if (!writer) {
+        writer.reset(new FileChunkWriter(file.file, file.hashGenerator));
+    }
+    return *writer;
+}
+
+/**
+ * @brief Waits for all received chunks of a file to be written.
+ * @return False if writing failed.
+ */
+bool CoreFile::finishWriting(const ToxFile& file)
+{
+    auto it = chunkWriters.find(getFriendKey(file.friendId, file.fileNum));
+    if (it == chunkWriters.end()) {
+        return true;
+    }
+
+    return it->second->finish(syncPolicy);
+}
+
+/**
+ * @brief Sets how received files are synced to disk once complete.
+ */
+void CoreFile::setSyncPolicy(FileChunkWriter::SyncPolicy policy)
+{
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
+    syncPolicy = policy;
+}
+
+/**
+ * @brief Pauses a receiving transfer while too much of it waits to be written.
+ * @param file Receiving file.
+ * @param pendingBytes Bytes received but not written yet.
+ *
+ * Backpressure pauses are ours, they don't change the pause state the user sees.
+ */
+void CoreFile::applyBackpressure(const ToxFile& file, qint64 pendingBytes)
+{
+    const uint64_t key = getFriendKey(file.friendId, file.fileNum);
+    const bool paused = backpressured.contains(key);
+
+    Tox_Err_File_Control err;
+    if (!paused && pendingBytes > FileChunkWriter::HIGH_WATERMARK) {
+        qDebug() << "Pausing file transfer" << file.friendId << ':' << file.fileNum
+                 << "until the disk caught up";
+        tox_file_control(tox, file.friendId, file.fileNum, TOX_FILE_CONTROL_PAUSE, &err);
+        if (PARSE_ERR(err)) {
+            backpressured.insert(key);
+        }
+    } else if (paused && pendingBytes < FileChunkWriter::LOW_WATERMARK) {
+        backpressured.remove(key);
+        if (!file.pauseStatus.localPaused()) {
+            tox_file_control(tox, file.friendId, file.fileNum, TOX_FILE_CONTROL_RESUME, &err);
+            PARSE_ERR(err);
+        }
+    }
+}
+
+void CoreFile::checkBackpressure()
+{
+    for (uint64_t key : backpressured.values()) {
+        auto it = chunkWriters.find(key);
+        if (it == chunkWriters.end() || !fileMap.contains(key)) {
+            backpressured.remove(key);
+            continue;
+        }
+        applyBackpressure(fileMap[key], it->second->getPendingBytes());
+    }
+}
+
+/**
+ * @brief Sets where the progress of interrupted transfers is kept, nullptr to not keep it.
+ * @param store Must outlive this object or be unset first.
+ */
+void CoreFile::setResumeStore(IFileResumeStore* store)
+{
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
+    resumeStore = store;
+}
+
+ToxPk CoreFile::getFriendPk(uint32_t friendId) const
+{
+    uint8_t rawid[TOX_PUBLIC_KEY_SIZE];
+    Tox_Err_Friend_Get_Public_Key error;
+    tox_friend_get_public_key(tox, friendId, rawid, &error);
+    if (!PARSE_ERR(error)) {
+        return ToxPk();
+    }
+
+    return ToxPk(rawid);
+}
+
+/**
+ * @brief Checks whether a transfer can be continued after it was interrupted.
+ *
+ * Avatars are small and offered again anyway.
+ */
+bool CoreFile::isResumable(const ToxFile& file)
+{
+    return file.fileKind == TOX_FILE_KIND_DATA || file.fileKind == TOX_FILE_KIND_FTV2;
+}
+
+/**
+ * @brief Persists how far a transfer got, so it can be continued later.
+ * @param bytesDone Bytes of a received file safely on disk.
+ */
+void CoreFile::rememberTransfer(const ToxFile& file, uint64_t bytesDone)
+{
+    if (!resumeStore || !isResumable(file) || file.resumeFileId.size() != TOX_FILE_ID_LENGTH) {
+        return;
+    }
+
+    const ToxPk friendPk = getFriendPk(file.friendId);
+    if (friendPk.isEmpty()) {
+        return;
+    }
+
+    IFileResumeStore::Entry entry;
+    entry.fileId = file.resumeFileId;
+    entry.friendPk = friendPk;
+    entry.sending = file.direction == ToxFile::SENDING;
+    entry.fileName = file.fileName;
+    entry.filePath = file.filePath;
+    entry.fileSize = file.progress.getFileSize();
+    entry.bytesDone = bytesDone;
+    resumeStore->saveFileProgress(entry);
+}
+
+void CoreFile::forgetTransfer(const ToxFile& file)
+{
+    if (resumeStore && isResumable(file) && !file.resumeFileId.isEmpty()) {
+        resumeStore->removeFileProgress(file.resumeFileId);
+    }
+}
+
+/**
+ * @brief Continues an offered file we received part of before.
+ * @return True if the transfer was accepted where the partial file ends.
+ *
+ * toxcore only keeps the file id of a broken transfer, so the sender offers it again under a new
+ * file number and we seek past what is on disk already.
+ */
+bool CoreFile::resumeReceive(uint32_t friendId, uint32_t fileId)
+{
+    ToxFile* file = findFile(friendId, fileId);
+    if (!resumeStore || !file || !isResumable(*file)) {
+        return false;
+    }
+
+    const uint64_t fileSize = file->progress.getFileSize();
+    IFileResumeStore::Entry stored;
+    bool found = false;
+    for (const IFileResumeStore::Entry& entry : resumeStore->getResumableFiles(getFriendPk(friendId))) {
+        if (!entry.sending && entry.fileId == file->resumeFileId && entry.fileSize == fileSize) {
+            stored = entry;
+            found = true;
+            break;
+        }
+    }
+
+    const QFileInfo partial{stored.filePath};
+    if (!found || !partial.exists()) {
+        return false;
+    }
+
+    const uint64_t offset = std::min(stored.bytesDone, static_cast<uint64_t>(partial.size()));
+    file->setFilePath(stored.filePath);
+    if (!file->open(true)) {
+        qWarning() << "resumeReceive: Unable to open the partially received file";
+        return false;
+    }
+
+    Tox_Err_File_Seek seekErr = TOX_ERR_FILE_SEEK_OK;
+    if (offset > 0) {
+        tox_file_seek(tox, friendId, fileId, offset, &seekErr);
+    }
+    if (!PARSE_ERR(seekErr)) {
+        file->file->close();
+        return false;
+    }
+
+    getChunkWriter(*file).resumeFrom(static_cast<qint64>(offset));
+    file->progress.addSample(offset);
+
+    Tox_Err_File_Control err;
+    tox_file_control(tox, friendId, fileId, TOX_FILE_CONTROL_RESUME, &err);
+    if (!PARSE_ERR(err)) {
+        return false;
+    }
+
+    qDebug() << "Continuing file transfer" << friendId << ':' << fileId << "at" << offset << "bytes";
+    setFileStatus(*file, ToxFile::TRANSMITTING);
+    return true;
+}
+
+/**
+ * @brief Offers the files again that were being sent when the friend went offline.
+ *
+ * Files that changed since are given up, the receiver would otherwise complete them with the
+ * wrong content.
+ */
+void CoreFile::resumeSends(uint32_t friendId)
+{
+    if (!resumeStore) {
+        return;
+    }
+
+    for (const IFileResumeStore::Entry& entry : resumeStore->getResumableFiles(getFriendPk(friendId))) {
+        if (!entry.sending) {
+            continue;
+        }
+
+        const bool running =
+            std::any_of(fileMap.cbegin(), fileMap.cend(), [&entry, friendId](const ToxFile& file) {
+                return file.friendId == friendId && file.resumeFileId == entry.fileId;
+            });
+        if (running) {
+            continue;
+        }
+
+        const QFileInfo info{entry.filePath};
+        if (!info.exists() || static_cast<uint64_t>(info.size()) != entry.fileSize
+            || !startSend(friendId, entry.fileName, entry.filePath, entry.fileSize, entry.fileId)) {
+            resumeStore->removeFileProgress(entry.fileId);
+        }
+    }
+}
+
 QString CoreFile::getCleanFileName(QString filename)
 {
     QRegularExpression regex{QStringLiteral(R"([<>:"/\\|?])")};
@@ -342,6 +753,7 @@ void CoreFile::onFileReceiveCallback(Tox* tox, uint32_t friendId, uint32_t fileI
                                      uint64_t filesize, const uint8_t* fname, size_t fnameLen,
                                      void* vCore)
 {
+    TRACE_SCOPE("CoreFile::onFileReceiveCallback");
     Core* core = static_cast<Core*>(vCore);
     CoreFile* coreFile = core->getCoreFile();
     auto filename = ToxString(fname, fnameLen);
@@ -402,6 +814,9 @@ void CoreFile::onFileReceiveCallback(Tox* tox, uint32_t friendId, uint32_t fileI
     coreFile->addFile(friendId, fileId, file);
     if (kind != TOX_FILE_KIND_AVATAR) {
         emit coreFile->fileReceiveRequested(file);
+        if (coreFile->resumeReceive(friendId, fileId)) {
+            emit coreFile->fileTransferAccepted(*coreFile->findFile(friendId, fileId));
+        }
     }
 }
 
@@ -443,6 +858,7 @@ void CoreFile::handleAvatarOffer(uint32_t friendId, uint32_t fileId, bool accept
 void CoreFile::onFileControlCallback(Tox* tox, uint32_t friendId, uint32_t fileId,
                                      Tox_File_Control control, void* vCore)
 {
+    TRACE_SCOPE("CoreFile::onFileControlCallback");
     std::ignore = tox;
     Core* core = static_cast<Core*>(vCore);
     CoreFile* coreFile = core->getCoreFile();
@@ -455,13 +871,13 @@ void CoreFile::onFileControlCallback(Tox* tox, uint32_t friendId, uint32_t fileI
     if (control == TOX_FILE_CONTROL_CANCEL) {
         if (file->fileKind != TOX_FILE_KIND_AVATAR)
             qDebug() << "File transfer" << friendId << ":" << fileId << "cancelled by friend";
-        file->status = ToxFile::CANCELED;
+        coreFile->setFileStatus(*file, ToxFile::CANCELED);
         emit coreFile->fileTransferCancelled(*file);
         coreFile->removeFile(friendId, fileId);
     } else if (control == TOX_FILE_CONTROL_PAUSE) {
         qDebug() << "onFileControlCallback: Received pause for file " << friendId << ":" << fileId;
         file->pauseStatus.remotePause();
-        file->status = ToxFile::PAUSED;
+        coreFile->setFileStatus(*file, ToxFile::PAUSED);
         emit coreFile->fileTransferRemotePausedUnpaused(*file, true);
     } else if (control == TOX_FILE_CONTROL_RESUME) {
         if (file->direction == ToxFile::SENDING && file->fileKind == TOX_FILE_KIND_AVATAR)
@@ -469,7 +885,7 @@ void CoreFile::onFileControlCallback(Tox* tox, uint32_t friendId, uint32_t fileI
         else
             qDebug() << "onFileControlCallback: Received resume for file " << friendId << ":" << fileId;
         file->pauseStatus.remoteResume();
-        file->status = file->pauseStatus.paused() ? ToxFile::PAUSED : ToxFile::TRANSMITTING;
+        coreFile->setFileStatus(*file, file->pauseStatus.paused() ? ToxFile::PAUSED : ToxFile::TRANSMITTING);
         emit coreFile->fileTransferRemotePausedUnpaused(*file, false);
     } else {
         qWarning() << "Unhandled file control " << control << " for file " << friendId << ':' << fileId;
@@ -479,6 +895,7 @@ void CoreFile::onFileControlCallback(Tox* tox, uint32_t friendId, uint32_t fileI
 void CoreFile::onFileDataCallback(Tox* tox, uint32_t friendId, uint32_t fileId, uint64_t pos,
                                   size_t length, void* vCore)
 {
+    TRACE_SCOPE("CoreFile::onFileDataCallback");
 
     Core* core = static_cast<Core*>(vCore);
     CoreFile* coreFile = core->getCoreFile();
@@ -487,10 +904,11 @@ void CoreFile::onFileDataCallback(Tox* tox, uint32_t friendId, uint32_t fileId,
         qWarning("onFileDataCallback: No such file in queue");
         return;
     }
+    ++coreFile->chunkEvents;
 
     // If we reached EOF, ack and cleanup the transfer
     if (!length) {
-        file->status = ToxFile::FINISHED;
+        coreFile->setFileStatus(*file, ToxFile::FINISHED);
         if (file->fileKind != TOX_FILE_KIND_AVATAR) {
             emit coreFile->fileTransferFinished(*file);
         }
@@ -498,55 +916,128 @@ void CoreFile::onFileDataCallback(Tox* tox, uint32_t friendId, uint32_t fileId,
         return;
     }
 
-    std::unique_ptr<uint8_t[]> data(new uint8_t[length]);
-    int64_t nread;
+    // sent by serveChunkRequests(), more important transfers may go first
+    coreFile->scheduler.enqueue(
+        {getFriendKey(friendId, fileId), friendId, pos, length,
+         FileTransferScheduler::priorityFor(file->fileKind, file->progress.getFileSize())});
+}
 
-    if (file->fileKind == TOX_FILE_KIND_AVATAR) {
-        QByteArray chunk = file->avatarData.mid(pos, length);
-        nread = chunk.size();
-        memcpy(data.get(), chunk.data(), nread);
+/**
+ * @brief Sends one requested chunk of an outgoing file.
+ * @param file Outgoing file.
+ * @param pos Position toxcore asked for.
+ * @param length Size toxcore asked for.
+ * @return Whether the chunk was sent, toxcore's send queue was full or the transfer failed and
+ * was removed.
+ */
+CoreFile::SendResult CoreFile::sendChunk(ToxFile& file, uint64_t pos, size_t length)
+{
+    const uint32_t friendId = file.friendId;
+    const uint32_t fileId = file.fileNum;
+    const char* data = nullptr;
+    qint64 nread = 0;
+
+    if (file.fileKind == TOX_FILE_KIND_AVATAR) {
+        // avatars are in memory already, no need to copy them
+        const qint64 avatarSize = file.avatarData.size();
+        if (static_cast<qint64>(pos) < avatarSize) {
+            data = file.avatarData.constData() + pos;
+            nread = std::min(static_cast<qint64>(length), avatarSize - static_cast<qint64>(pos));
+        }
     } else {
-        file->file->seek(pos);
-        nread = file->file->read(reinterpret_cast<char*>(data.get()), length);
-        if (nread <= 0) {
-            qWarning("onFileDataCallback: Failed to read from file");
-            file->status = ToxFile::CANCELED;
-            emit coreFile->fileTransferCancelled(*file);
+        data = getChunkReader(file).read(static_cast<qint64>(pos), static_cast<qint64>(length),
+                                         nread);
+        if (!data) {
+            qWarning("sendChunk: Failed to read from file");
+            setFileStatus(file, ToxFile::CANCELED);
+            emit fileTransferCancelled(file);
             Tox_Err_File_Send_Chunk err;
             tox_file_send_chunk(tox, friendId, fileId, pos, nullptr, 0, &err);
             PARSE_ERR(err);
-            coreFile->removeFile(friendId, fileId);
-            return;
+            removeFile(friendId, fileId);
+            return SendResult::Failed;
         }
-        file->progress.addSample(file->progress.getBytesSent() + length);
-        file->hashGenerator->addData(reinterpret_cast<const char*>(data.get()), length);
     }
 
     Tox_Err_File_Send_Chunk err;
 
-    if (file->fileKind == TOX_FILE_KIND_FTV2) {
-        uint8_t *f_data = reinterpret_cast<uint8_t*>(calloc(1, nread + TOX_FILE_ID_LENGTH));
-        if (f_data == nullptr) {
-            return;
-        }
-        memcpy((f_data + TOX_FILE_ID_LENGTH), data.get(), nread);
-        memcpy(f_data, reinterpret_cast<uint8_t*>(file->resumeFileId.data()), TOX_FILE_ID_LENGTH);
-        tox_file_send_chunk(tox, friendId, fileId, pos, f_data, nread + TOX_FILE_ID_LENGTH, &err);
-        free(f_data);
+    if (file.fileKind == TOX_FILE_KIND_FTV2) {
+        // HINT: FTV2 chunks start with the file id, reuse one buffer for all of them
+        sendBuffer.resize(TOX_FILE_ID_LENGTH + static_cast<int>(nread));
+        memcpy(sendBuffer.data(), file.resumeFileId.constData(), TOX_FILE_ID_LENGTH);
+        memcpy(sendBuffer.data() + TOX_FILE_ID_LENGTH, data, static_cast<size_t>(nread));
+        tox_file_send_chunk(tox, friendId, fileId, pos,
+                            reinterpret_cast<const uint8_t*>(sendBuffer.constData()),
+                            static_cast<size_t>(sendBuffer.size()), &err);
     } else {
-        tox_file_send_chunk(tox, friendId, fileId, pos, data.get(), nread, &err);
+        tox_file_send_chunk(tox, friendId, fileId, pos, reinterpret_cast<const uint8_t*>(data),
+                            static_cast<size_t>(nread), &err);
+    }
+    if (err == TOX_ERR_FILE_SEND_CHUNK_SENDQ) {
+        // the chunk stays queued, toxcore accepts it again in a later iteration
+        return SendResult::QueueFull;
     }
     if (!PARSE_ERR(err)) {
-        return;
+        // nothing we can do about it, toxcore won't ask for this chunk again either
+        return SendResult::Sent;
     }
-    if (file->fileKind != TOX_FILE_KIND_AVATAR) {
-        emit coreFile->fileTransferInfo(*file);
+
+    if (file.fileKind != TOX_FILE_KIND_AVATAR) {
+        const QTime now = QTime::currentTime();
+        file.progress.addSample(file.progress.getBytesSent() + length, now);
+        file.hashGenerator->addData(data, static_cast<int>(nread));
+        if (file.progress.shouldReport(now)) {
+            emit fileTransferInfo(file);
+        }
     }
+    return SendResult::Sent;
+}
+
+/**
+ * @brief Sends the queued chunk requests allowed by the scheduler, call after tox_iterate().
+ * @param callActive True while an audio or video call runs, transfers then leave room for it.
+ */
+void CoreFile::serveChunkRequests(bool callActive)
+{
+    qint64 limit = upstreamLimit;
+    if (callActive) {
+        limit = limit > 0 ? std::min(limit, CALL_UPSTREAM_LIMIT) : CALL_UPSTREAM_LIMIT;
+    }
+    scheduler.setUpstreamLimit(limit);
+    scheduler.refill(clock.elapsed());
+
+    FileTransferScheduler::ChunkRequest request;
+    while (scheduler.next(request)) {
+        auto it = fileMap.find(request.key);
+        if (it == fileMap.end()) {
+            scheduler.remove(request.key);
+            continue;
+        }
+
+        const SendResult result = sendChunk(*it, request.pos, request.length);
+        if (result == SendResult::QueueFull) {
+            break;
+        }
+        if (result == SendResult::Sent) {
+            scheduler.commit(request);
+        }
+    }
+}
+
+/**
+ * @brief Limits the upstream used by all outgoing files together.
+ * @param bytesPerSecond Limit, 0 for none.
+ */
+void CoreFile::setUpstreamLimit(qint64 bytesPerSecond)
+{
+    PROFILED_MUTEX_LOCKER(locker, coreLoopLock, "Core::coreLoopLock");
+    upstreamLimit = bytesPerSecond;
 }
 
 void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fileId, uint64_t position,
                                        const uint8_t* data, size_t length, void* vCore)
 {
+    TRACE_SCOPE("CoreFile::onFileRecvChunkCallback");
     Core* core = static_cast<Core*>(vCore);
     CoreFile* coreFile = core->getCoreFile();
     ToxFile* file = coreFile->findFile(friendId, fileId);
@@ -557,11 +1048,12 @@ void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fil
         PARSE_ERR(err);
         return;
     }
+    ++coreFile->chunkEvents;
 
     if (file->progress.getBytesSent() != position) {
         qWarning("onFileRecvChunkCallback: Received a chunk out-of-order, aborting transfer");
         if (file->fileKind != TOX_FILE_KIND_AVATAR) {
-            file->status = ToxFile::CANCELED;
+            coreFile->setFileStatus(*file, ToxFile::CANCELED);
             emit coreFile->fileTransferCancelled(*file);
         }
         Tox_Err_File_Control err;
@@ -572,7 +1064,24 @@ void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fil
     }
 
     if (!length) {
-        file->status = ToxFile::FINISHED;
+        if (file->fileKind != TOX_FILE_KIND_AVATAR && !coreFile->finishWriting(*file)) {
+            qWarning("onFileRecvChunkCallback: Failed to write the received file");
+            coreFile->setFileStatus(*file, ToxFile::CANCELED);
+            emit coreFile->fileTransferCancelled(*file);
+            coreFile->removeFile(friendId, fileId);
+            return;
+        }
+        if (file->fileKind != TOX_FILE_KIND_AVATAR
+            && static_cast<uint64_t>(file->file->size()) != file->progress.getFileSize()) {
+            qWarning() << "onFileRecvChunkCallback: Received file has" << file->file->size()
+                       << "bytes instead of" << file->progress.getFileSize();
+            coreFile->setFileStatus(*file, ToxFile::CANCELED);
+            emit coreFile->fileTransferCancelled(*file);
+            coreFile->removeFile(friendId, fileId);
+            return;
+        }
+
+        coreFile->setFileStatus(*file, ToxFile::FINISHED);
         if (file->fileKind == TOX_FILE_KIND_AVATAR) {
             QPixmap pic;
             pic.loadFromData(file->avatarData);
@@ -589,6 +1098,7 @@ void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fil
 
     if (file->fileKind == TOX_FILE_KIND_AVATAR) {
         file->avatarData.append(reinterpret_cast<const char*>(data), length);
+        file->hashGenerator->addData(reinterpret_cast<const char*>(data), length);
     } else {
         if (file->fileKind == TOX_FILE_KIND_FTV2) {
             if (length < (TOX_FILE_ID_LENGTH + 1)) {
@@ -598,12 +1108,23 @@ void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fil
             length = length - TOX_FILE_ID_LENGTH;
             data = data + TOX_FILE_ID_LENGTH;
         }
-        file->file->write(reinterpret_cast<const char*>(data), length);
+        // written and hashed on a worker thread
+        FileChunkWriter& writer = coreFile->getChunkWriter(*file);
+        writer.write(reinterpret_cast<const char*>(data), static_cast<qint64>(length));
+        coreFile->applyBackpressure(*file, writer.getPendingBytes());
+    }
+    const QTime now = QTime::currentTime();
+    const uint64_t before = file->progress.getBytesSent();
+    file->progress.addSample(before + length, now);
+
+    if (file->fileKind != TOX_FILE_KIND_AVATAR
+        && before / RESUME_SAVE_BYTES != (before + length) / RESUME_SAVE_BYTES) {
+        // only what reached the disk can be kept if the transfer breaks
+        const qint64 pending = coreFile->getChunkWriter(*file).getPendingBytes();
+        coreFile->rememberTransfer(*file, before + length - static_cast<uint64_t>(pending));
     }
-    file->progress.addSample(file->progress.getBytesSent() + length);
-    file->hashGenerator->addData(reinterpret_cast<const char*>(data), length);
 
-    if (file->fileKind != TOX_FILE_KIND_AVATAR) {
+    if (file->fileKind != TOX_FILE_KIND_AVATAR && file->progress.shouldReport(now)) {
         emit coreFile->fileTransferInfo(*file);
     }
 }
@@ -611,13 +1132,8 @@ void CoreFile::onFileRecvChunkCallback(Tox* tox, uint32_t friendId, uint32_t fil
 void CoreFile::onConnectionStatusChanged(uint32_t friendId, Status::Status state)
 {
     bool isOffline = state == Status::Status::Offline;
-    // TODO: Actually resume broken file transfers
-    // We need to:
-    // - Start a new file transfer with the same 32byte file ID with toxcore
-    // - Seek to the correct position again
-    // - Update the fileNum in our ToxFile
-    // - Update the users of our signals to check the 32byte tox file ID, not the uint32_t file_num
-    // (fileId)
+    // broken transfers are continued under a new file number once the friend offers them again,
+    // see resumeReceive() and resumeSends()
     ToxFile::FileStatus status = !isOffline ? ToxFile::TRANSMITTING : ToxFile::BROKEN;
     for (uint64_t key : fileMap.keys()) {
         if (key >> 32 != friendId) {
@@ -629,8 +1145,18 @@ void CoreFile::onConnectionStatusChanged(uint32_t friendId, Status::Status state
             continue;
         }
 
-        fileMap[key].status = status;
-        emit fileTransferBrokenUnbroken(fileMap[key], isOffline);
-        removeFile(friendId, fileMap[key].fileNum);
+        ToxFile& file = fileMap[key];
+        if (isOffline && file.direction == ToxFile::RECEIVING && file.file->isOpen()
+            && isResumable(file) && finishWriting(file)) {
+            rememberTransfer(file, file.progress.getBytesSent());
+        }
+
+        setFileStatus(file, status);
+        emit fileTransferBrokenUnbroken(file, isOffline);
+        removeFile(friendId, file.fileNum);
+    }
+
+    if (!isOffline) {
+        resumeSends(friendId);
     }
 }
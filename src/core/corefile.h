@@ -22,24 +22,34 @@
 
 #include <tox/tox.h>
 
+#include "filechunkwriter.h"
+#include "filetransferscheduler.h"
+#include "ifileresumestore.h"
 #include "toxfile.h"
 #include "src/core/core.h"
 #include "src/core/toxpk.h"
 #include "src/model/status.h"
 
 #include "util/compatiblerecursivemutex.h"
+#include "util/diagnosticsregistry.h"
 
+#include <QElapsedTimer>
 #include <QHash>
+#include <QJsonObject>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
 #include <QString>
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <unordered_map>
 
 struct Tox;
 class CoreFile;
+class FileChunkReader;
 
 using CoreFilePtr = std::unique_ptr<CoreFile>;
 
@@ -48,12 +58,14 @@ class CoreFile : public QObject
     Q_OBJECT
 
 public:
+    ~CoreFile();
+
     void handleAvatarOffer(uint32_t friendId, uint32_t fileId, bool accept, uint64_t filesize);
     static CoreFilePtr makeCoreFile(Core* core, Tox* tox, CompatibleRecursiveMutex& coreLoopLock);
 
     void sendFile(uint32_t friendId, QString filename, QString filePath,
                          long long filesize);
-    void sendAvatarFile(uint32_t friendId, const QByteArray& data);
+    bool sendAvatarFile(uint32_t friendId, const QByteArray& data);
     void pauseResumeFile(uint32_t friendId, uint32_t fileId);
     void cancelFileSend(uint32_t friendId, uint32_t fileId);
 
@@ -62,6 +74,20 @@ public:
     void acceptFileRecvRequest(uint32_t friendId, uint32_t fileId, QString path);
 
     unsigned corefileIterationInterval();
+    bool hasActiveTransfers() const;
+    void setSyncPolicy(FileChunkWriter::SyncPolicy policy);
+    void setUpstreamLimit(qint64 bytesPerSecond);
+    void serveChunkRequests(bool callActive);
+    void setResumeStore(IFileResumeStore* store);
+
+    static constexpr unsigned IDLE_INTERVAL_MS = 1000;
+    static constexpr unsigned START_INTERVAL_MS = 4;
+    static constexpr unsigned MIN_INTERVAL_MS = 1;
+    static constexpr unsigned MAX_ACTIVE_INTERVAL_MS = 50;
+    static constexpr int BUSY_CHUNK_EVENTS = 8;
+    static constexpr qint64 CALL_UPSTREAM_LIMIT = 64 * 1024;
+    static constexpr uint64_t RESUME_SAVE_BYTES = 4 * 1024 * 1024;
+    static constexpr int DIAGNOSTICS_LOCK_TIMEOUT_MS = 100;
 
 signals:
     void fileSendStarted(ToxFile file);
@@ -75,13 +101,37 @@ signals:
     void fileTransferBrokenUnbroken(ToxFile file, bool broken);
     void fileNameChanged(const ToxPk& friendPk);
     void fileSendFailed(uint32_t friendId, const QString& fname);
+    void avatarSendFinished(uint32_t friendId, bool delivered);
 
 private:
+    enum class SendResult
+    {
+        Sent,
+        QueueFull,
+        Failed
+    };
+
     CoreFile(Tox* core_, CompatibleRecursiveMutex& coreLoopLock_);
 
     ToxFile* findFile(uint32_t friendId, uint32_t fileId);
     void addFile(uint32_t friendId, uint32_t fileId, const ToxFile& file);
     void removeFile(uint32_t friendId, uint32_t fileId);
+    void setFileStatus(ToxFile& file, ToxFile::FileStatus status);
+    void countTransfer(const ToxFile& file, int delta);
+    FileChunkReader& getChunkReader(const ToxFile& file);
+    FileChunkWriter& getChunkWriter(const ToxFile& file);
+    bool finishWriting(const ToxFile& file);
+    void applyBackpressure(const ToxFile& file, qint64 pendingBytes);
+    void checkBackpressure();
+    SendResult sendChunk(ToxFile& file, uint64_t pos, size_t length);
+    bool startSend(uint32_t friendId, const QString& filename, const QString& filePath,
+                   uint64_t filesize, const QByteArray& fileId);
+    ToxPk getFriendPk(uint32_t friendId) const;
+    static bool isResumable(const ToxFile& file);
+    void rememberTransfer(const ToxFile& file, uint64_t bytesDone);
+    void forgetTransfer(const ToxFile& file);
+    bool resumeReceive(uint32_t friendId, uint32_t fileId);
+    void resumeSends(uint32_t friendId);
     static constexpr uint64_t getFriendKey(uint32_t friendId, uint32_t fileId)
     {
         return (static_cast<std::uint64_t>(friendId) << 32) + fileId;
@@ -99,12 +149,30 @@ private:
                                         const uint8_t* data, size_t length, void* vCore);
 
     static QString getCleanFileName(QString filename);
+    QJsonObject collectDiagnostics() const;
 
 private slots:
     void onConnectionStatusChanged(uint32_t friendId, Status::Status state);
 
 private:
     QHash<uint64_t, ToxFile> fileMap;
+    // only touched on the core thread or under coreLoopLock
+    int activeTransfers = 0;
+    int chunkEvents = 0;
+    unsigned activeInterval = START_INTERVAL_MS;
+    std::unordered_map<uint64_t, std::unique_ptr<FileChunkReader>> chunkReaders;
+    QByteArray sendBuffer;
+    std::unordered_map<uint64_t, std::unique_ptr<FileChunkWriter>> chunkWriters;
+    QSet<uint64_t> backpressured;
+    FileChunkWriter::SyncPolicy syncPolicy = FileChunkWriter::SyncPolicy::Flush;
+    FileTransferScheduler scheduler;
+    qint64 upstreamLimit = 0;
+    QElapsedTimer clock;
+    IFileResumeStore* resumeStore = nullptr;
+    // updated on the core thread, read from any thread
+    std::atomic<bool> transmitting{false};
     Tox* tox;
     CompatibleRecursiveMutex* coreLoopLock = nullptr;
+    // last, so it unregisters before the transfers it reads are destroyed
+    DiagnosticsSource diagnostics{"transfers", [this] { return collectDiagnostics(); }};
 };
@@ -0,0 +1,139 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "coregroupaudioreceiver.h"
+#include "coreav.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
+
+#include <algorithm>
+
+/**
+ * @class CoreGroupAudioReceiver
+ * @brief Thread mixing and playing the decoded audio of conference calls.
+ *
+ * toxcore decodes conference audio inside tox_iterate, so the callback only copies each frame
+ * into a preallocated single producer, single consumer queue and wakes this thread up. Mixing,
+ * the audio sink and the locks they need never stall the Core loop, however many peers talk.
+ * If this thread falls behind, new frames are dropped instead of blocking the Core thread.
+ *
+ * @note enqueue() must always be called from the same thread, which is the Core thread.
+ */
+
+constexpr size_t CoreGroupAudioReceiver::MAX_FRAME_SAMPLES;
+
+CoreGroupAudioReceiver::CoreGroupAudioReceiver(CoreAV& av_)
+    : av{av_}
+{
+    setObjectName("qTox GroupAudio");
+}
+
+CoreGroupAudioReceiver::~CoreGroupAudioReceiver()
+{
+    stop();
+}
+
+/**
+ * @brief Queues a decoded frame of a conference peer for playing.
+ * @param group Id of the conference.
+ * @param peer Peer the audio came from.
+ * @param pcm An array of audio samples (Pulse-code modulation), copied before returning.
+ * @param samples Number of samples per channel in this frame.
+ * @param chans Number of audio channels.
+ * @param rate Audio sampling rate used in this frame.
+ * @return False if the frame was dropped.
+ */
+bool CoreGroupAudioReceiver::enqueue(int group, const ToxPk& peer, const int16_t* pcm,
+                                     size_t samples, uint8_t chans, uint32_t rate)
+{
+    const size_t total = samples * chans;
+    if (!running || total > MAX_FRAME_SAMPLES) {
+        return false;
+    }
+
+    Frame* frame = queue.producerSlot();
+    if (!frame) {
+        ++droppedFrames;
+        return false;
+    }
+
+    frame->group = group;
+    frame->peer = peer;
+    frame->rate = rate;
+    frame->samples = samples;
+    frame->chans = chans;
+    std::copy(pcm, pcm + total, frame->pcm.begin());
+    queue.commitPush();
+    pending.release();
+    return true;
+}
+
+/**
+ * @brief Starts the thread, with the same priority as the audio send thread.
+ */
+void CoreGroupAudioReceiver::startReceiving()
+{
+    if (running.exchange(true)) {
+        return;
+    }
+
+    start(QThread::TimeCriticalPriority);
+}
+
+/**
+ * @brief Stops the thread and waits for it to finish, queued frames are discarded.
+ */
+void CoreGroupAudioReceiver::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    pending.release();
+    wait();
+}
+
+uint64_t CoreGroupAudioReceiver::getDroppedFrames() const
+{
+    return droppedFrames;
+}
+
+void CoreGroupAudioReceiver::run()
+{
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("Group Audio"));
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::RealtimeAudio);
+    while (true) {
+        pending.acquire();
+        if (!running) {
+            break;
+        }
+
+        Frame* frame = queue.consumerSlot();
+        if (!frame) {
+            continue;
+        }
+
+        av.playGroupCallAudio(frame->group, frame->peer, frame->pcm.data(), frame->samples,
+                              frame->chans, frame->rate);
+        queue.commitPop();
+    }
+
+    ThreadCpuTime::unregisterCurrentThread();
+}
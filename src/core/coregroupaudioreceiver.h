@@ -0,0 +1,72 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "toxpk.h"
+#include "util/spscqueue.h"
+
+#include <QSemaphore>
+#include <QThread>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class CoreAV;
+
+class CoreGroupAudioReceiver : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CoreGroupAudioReceiver(CoreAV& av);
+    ~CoreGroupAudioReceiver();
+
+    bool enqueue(int group, const ToxPk& peer, const int16_t* pcm, size_t samples, uint8_t chans,
+                 uint32_t rate);
+    void startReceiving();
+    void stop();
+    uint64_t getDroppedFrames() const;
+
+    // 60ms of 48kHz stereo audio
+    static constexpr size_t MAX_FRAME_SAMPLES = 48000 * 60 / 1000 * 2;
+
+protected:
+    void run() override;
+
+private:
+    struct Frame
+    {
+        int group = 0;
+        ToxPk peer;
+        uint32_t rate = 0;
+        size_t samples = 0;
+        uint8_t chans = 0;
+        std::array<int16_t, MAX_FRAME_SAMPLES> pcm;
+    };
+
+    CoreAV& av;
+    // a few frames of every peer of a large conference
+    SpscQueue<Frame, 64> queue;
+    QSemaphore pending;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> droppedFrames{0};
+};
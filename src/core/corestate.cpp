@@ -0,0 +1,148 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "corestate.h"
+
+/**
+ * @class CoreState
+ * @brief Snapshot of the friends, groups and group peers known to toxcore.
+ *
+ * Core publishes a new, immutable version every time a tox callback or one of its own calls
+ * changes something, so other threads can read names, keys and online states without taking
+ * the core loop lock. A new version is a copy of the previous one with the changed entries
+ * replaced. Group peer lists are shared between versions until their group changes.
+ *
+ * Groups use the group ids of Core, i.e. NGC groups are offset by Settings::NGC_GROUPNUM_OFFSET.
+ * For conferences the peer id is the peer number in the conference.
+ */
+
+/**
+ * @brief Peers in the order toxcore lists them.
+ */
+const QVector<CoreState::Peer>& CoreState::Group::getPeers() const
+{
+    return peers;
+}
+
+const CoreState::Peer* CoreState::Group::findPeer(uint32_t peerId) const
+{
+    auto it = peerIndex.constFind(peerId);
+    return it != peerIndex.constEnd() ? &peers[*it] : nullptr;
+}
+
+void CoreState::Group::setPeers(QVector<Peer> peers_)
+{
+    peers = std::move(peers_);
+    reindex();
+}
+
+/**
+ * @brief Updates a peer, appending it if it is new.
+ */
+void CoreState::Group::setPeer(const Peer& peer)
+{
+    auto it = peerIndex.constFind(peer.peerId);
+    if (it != peerIndex.constEnd()) {
+        peers[*it] = peer;
+        return;
+    }
+
+    peerIndex.insert(peer.peerId, peers.size());
+    peers.append(peer);
+}
+
+void CoreState::Group::removePeer(uint32_t peerId)
+{
+    auto it = peerIndex.constFind(peerId);
+    if (it == peerIndex.constEnd()) {
+        return;
+    }
+
+    peers.remove(*it);
+    reindex();
+}
+
+void CoreState::Group::reindex()
+{
+    peerIndex.clear();
+    peerIndex.reserve(peers.size());
+    for (int i = 0; i < peers.size(); ++i) {
+        peerIndex.insert(peers[i].peerId, i);
+    }
+}
+
+/**
+ * @brief Number of changes published before this state, to tell two states apart.
+ */
+uint64_t CoreState::getVersion() const
+{
+    return version;
+}
+
+void CoreState::advanceVersion()
+{
+    ++version;
+}
+
+const CoreState::Friend* CoreState::findFriend(uint32_t friendId) const
+{
+    auto it = friends.constFind(friendId);
+    return it != friends.constEnd() ? &*it : nullptr;
+}
+
+const CoreState::Friend* CoreState::findFriend(const ToxPk& publicKey) const
+{
+    auto it = friendsByKey.constFind(publicKey);
+    return it != friendsByKey.constEnd() ? findFriend(*it) : nullptr;
+}
+
+const CoreState::Group* CoreState::findGroup(int groupId) const
+{
+    auto it = groups.constFind(groupId);
+    return it != groups.constEnd() ? it->get() : nullptr;
+}
+
+void CoreState::setFriend(uint32_t friendId, const Friend& state)
+{
+    removeFriend(friendId);
+    friends.insert(friendId, state);
+    friendsByKey.insert(state.publicKey, friendId);
+}
+
+void CoreState::removeFriend(uint32_t friendId)
+{
+    auto it = friends.find(friendId);
+    if (it == friends.end()) {
+        return;
+    }
+
+    friendsByKey.remove(it->publicKey);
+    friends.erase(it);
+}
+
+void CoreState::setGroup(int groupId, Group group)
+{
+    groups.insert(groupId, std::make_shared<const Group>(std::move(group)));
+}
+
+void CoreState::removeGroup(int groupId)
+{
+    groups.remove(groupId);
+}
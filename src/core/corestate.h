@@ -0,0 +1,87 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+#include <memory>
+
+class CoreState
+{
+public:
+    struct Friend
+    {
+        ToxPk publicKey;
+        QString name;
+        bool online = false;
+    };
+
+    struct Peer
+    {
+        uint32_t peerId = 0;
+        ToxPk publicKey;
+        QString name;
+    };
+
+    class Group
+    {
+    public:
+        const QVector<Peer>& getPeers() const;
+        const Peer* findPeer(uint32_t peerId) const;
+
+        void setPeers(QVector<Peer> peers);
+        void setPeer(const Peer& peer);
+        void removePeer(uint32_t peerId);
+
+    private:
+        void reindex();
+
+    private:
+        QVector<Peer> peers;
+        QHash<uint32_t, int> peerIndex;
+    };
+
+    uint64_t getVersion() const;
+    void advanceVersion();
+
+    const Friend* findFriend(uint32_t friendId) const;
+    const Friend* findFriend(const ToxPk& publicKey) const;
+    const Group* findGroup(int groupId) const;
+
+    void setFriend(uint32_t friendId, const Friend& state);
+    void removeFriend(uint32_t friendId);
+    void setGroup(int groupId, Group group);
+    void removeGroup(int groupId);
+
+private:
+    uint64_t version = 0;
+    QHash<uint32_t, Friend> friends;
+    QHash<ToxPk, uint32_t> friendsByKey;
+    // Shared between versions, so copying the state doesn't copy every peer list
+    QHash<int, std::shared_ptr<const Group>> groups;
+};
+
+using CoreStatePtr = std::shared_ptr<const CoreState>;
@@ -0,0 +1,137 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "corevideosender.h"
+#include "coreav.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
+
+#include <QMutexLocker>
+
+#include <utility>
+
+/**
+ * @class CoreVideoSender
+ * @brief Thread converting and encoding captured video frames with toxav_video_send_frame.
+ *
+ * Every call has a single slot mailbox. Posting a frame replaces the one still waiting, so the
+ * encoder always works on the newest frame and a slow encode never queues up latency. The capture
+ * thread only swaps a shared pointer and never waits for toxav.
+ */
+
+CoreVideoSender::CoreVideoSender(CoreAV& av_)
+    : av{av_}
+{
+    setObjectName("qTox VideoSend");
+}
+
+CoreVideoSender::~CoreVideoSender()
+{
+    stop();
+}
+
+/**
+ * @brief Hands a frame to the send thread, replacing the previous one if it wasn't sent yet.
+ * @param callId Id of friend in call list.
+ * @param frame Captured frame.
+ */
+void CoreVideoSender::post(uint32_t callId, std::shared_ptr<VideoFrame> frame)
+{
+    QMutexLocker locker{&mutex};
+    if (!running) {
+        return;
+    }
+
+    std::shared_ptr<VideoFrame>& slot = mailboxes[callId];
+    if (slot) {
+        ++replacedFrames;
+    }
+    slot = std::move(frame);
+    framePosted.wakeOne();
+}
+
+/**
+ * @brief Starts the send thread.
+ */
+void CoreVideoSender::startSending()
+{
+    QMutexLocker locker{&mutex};
+    if (running) {
+        return;
+    }
+
+    running = true;
+    start(QThread::HighPriority);
+}
+
+/**
+ * @brief Stops the thread and waits for it to finish, frames not sent yet are discarded.
+ */
+void CoreVideoSender::stop()
+{
+    {
+        QMutexLocker locker{&mutex};
+        if (!running) {
+            return;
+        }
+
+        running = false;
+        mailboxes.clear();
+        framePosted.wakeOne();
+    }
+
+    wait();
+}
+
+/**
+ * @brief Number of frames that were replaced by a newer one before they could be sent.
+ */
+uint64_t CoreVideoSender::getReplacedFrames() const
+{
+    return replacedFrames;
+}
+
+void CoreVideoSender::run()
+{
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("Video Send"));
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Interactive);
+    std::unordered_map<uint32_t, std::shared_ptr<VideoFrame>> frames;
+
+    while (true) {
+        {
+            QMutexLocker locker{&mutex};
+            while (running && mailboxes.empty()) {
+                framePosted.wait(&mutex);
+            }
+
+            if (!running) {
+                break;
+            }
+
+            frames.swap(mailboxes);
+        }
+
+        for (auto& entry : frames) {
+            av.sendCallVideo(entry.first, std::move(entry.second));
+        }
+        frames.clear();
+    }
+
+    ThreadCpuTime::unregisterCurrentThread();
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+class CoreAV;
+class VideoFrame;
+
+class CoreVideoSender : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CoreVideoSender(CoreAV& av);
+    ~CoreVideoSender();
+
+    void post(uint32_t callId, std::shared_ptr<VideoFrame> frame);
+    void startSending();
+    void stop();
+    uint64_t getReplacedFrames() const;
+
+protected:
+    void run() override;
+
+private:
+    CoreAV& av;
+    QMutex mutex;
+    QWaitCondition framePosted;
+    std::unordered_map<uint32_t, std::shared_ptr<VideoFrame>> mailboxes;
+    bool running = false;
+    std::atomic<uint64_t> replacedFrames{0};
+};
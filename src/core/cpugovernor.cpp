@@ -0,0 +1,186 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cpugovernor.h"
+
+#include <QMutexLocker>
+
+/**
+ * @class CpuGovernor
+ * @brief Keeps calls within a CPU budget by giving up quality one step at a time.
+ *
+ * CoreAV feeds it the CPU time of the whole process about once a second. While the load
+ * stays above the budget for DOWN_HOLD_MS, the governor takes the next step: first the
+ * preview repaints slow down, then we send smaller frames, encode faster, lower noise
+ * suppression and finally halve the frame rate. Audio is only touched after everything the
+ * user sees of themselves and the encoder speed.
+ *
+ * Steps are given back in reverse order once the load stayed below UP_HOLD_RATIO of the
+ * budget for UP_HOLD_MS, so a short burst doesn't flap the call between two levels.
+ *
+ * @note All methods are thread safe, but samples are only reported by the CoreAV thread.
+ */
+
+constexpr qint64 CpuGovernor::DOWN_HOLD_MS;
+constexpr qint64 CpuGovernor::UP_HOLD_MS;
+
+namespace {
+const int MAX_LEVEL = static_cast<int>(CpuGovernor::Step::VideoFps);
+// fraction of the budget the load must stay below to give a step back
+constexpr double UP_HOLD_RATIO = 0.6;
+
+double smooth(double average, double sample)
+{
+    if (average <= 0.0) {
+        return sample;
+    }
+    return average + (sample - average) / 2.0;
+}
+} // namespace
+
+CpuGovernor::CpuGovernor()
+{
+    reset();
+}
+
+/**
+ * @brief Gives back all steps and forgets the load, e.g. when the last call ended.
+ */
+void CpuGovernor::reset()
+{
+    QMutexLocker locker{&mutex};
+
+    level = 0;
+    avgLoad = 0.0;
+    lastSampleMs = -1;
+    lastCpuNs = 0;
+    lastChangeMs = -1;
+}
+
+/**
+ * @brief Sets the number of cores the calls may keep busy.
+ * @param cores Budget in cores, zero or less disables the governor.
+ */
+void CpuGovernor::setBudget(double cores)
+{
+    QMutexLocker locker{&mutex};
+    budgetCores = cores;
+}
+
+/**
+ * @brief Records a CPU time sample and takes or gives back a step if needed.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @param cpuNs CPU time the process used so far, in nanoseconds.
+ * @return True if the level changed.
+ */
+bool CpuGovernor::update(qint64 nowMs, qint64 cpuNs)
+{
+    QMutexLocker locker{&mutex};
+
+    if (lastSampleMs < 0 || nowMs <= lastSampleMs || cpuNs < lastCpuNs) {
+        lastSampleMs = nowMs;
+        lastCpuNs = cpuNs;
+        lastChangeMs = nowMs;
+        return false;
+    }
+
+    const double load = static_cast<double>(cpuNs - lastCpuNs) / ((nowMs - lastSampleMs) * 1000000.0);
+    avgLoad = smooth(avgLoad, load);
+    lastSampleMs = nowMs;
+    lastCpuNs = cpuNs;
+
+    const qint64 heldMs = nowMs - lastChangeMs;
+    if (budgetCores <= 0.0) {
+        if (level == 0) {
+            return false;
+        }
+        level = 0;
+        lastChangeMs = nowMs;
+        return true;
+    }
+
+    if (avgLoad > budgetCores) {
+        if (level < MAX_LEVEL && heldMs >= DOWN_HOLD_MS) {
+            ++level;
+            lastChangeMs = nowMs;
+            return true;
+        }
+        return false;
+    }
+
+    if (level > 0 && avgLoad < UP_HOLD_RATIO * budgetCores && heldMs >= UP_HOLD_MS) {
+        --level;
+        lastChangeMs = nowMs;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief The last step taken, Step::None if everything runs at full quality.
+ */
+CpuGovernor::Step CpuGovernor::getLevel() const
+{
+    QMutexLocker locker{&mutex};
+    return static_cast<Step>(level);
+}
+
+/**
+ * @brief Whether the given step is currently taken.
+ */
+bool CpuGovernor::isActive(Step step) const
+{
+    QMutexLocker locker{&mutex};
+    return step != Step::None && level >= static_cast<int>(step);
+}
+
+/**
+ * @brief Smoothed load in cores.
+ */
+double CpuGovernor::getLoad() const
+{
+    QMutexLocker locker{&mutex};
+    return avgLoad;
+}
+
+double CpuGovernor::getBudget() const
+{
+    QMutexLocker locker{&mutex};
+    return budgetCores;
+}
+
+const char* CpuGovernor::stepName(Step step)
+{
+    switch (step) {
+    case Step::None:
+        return "none";
+    case Step::PreviewFps:
+        return "preview fps";
+    case Step::CaptureResolution:
+        return "capture resolution";
+    case Step::EncoderSpeed:
+        return "encoder speed";
+    case Step::NoiseSuppression:
+        return "noise suppression";
+    case Step::VideoFps:
+        return "video fps";
+    }
+    return "unknown";
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+class CpuGovernor
+{
+public:
+    /**
+     * @brief Ways to save CPU, in the order they are taken.
+     */
+    enum class Step
+    {
+        None = 0,
+        PreviewFps,
+        CaptureResolution,
+        EncoderSpeed,
+        NoiseSuppression,
+        VideoFps
+    };
+
+    CpuGovernor();
+
+    void reset();
+    void setBudget(double cores);
+    bool update(qint64 nowMs, qint64 cpuNs);
+
+    Step getLevel() const;
+    bool isActive(Step step) const;
+    double getLoad() const;
+    double getBudget() const;
+
+    static const char* stepName(Step step);
+
+    static constexpr qint64 DOWN_HOLD_MS = 3000;
+    static constexpr qint64 UP_HOLD_MS = 15000;
+
+private:
+    mutable QMutex mutex;
+
+    int level = 0;
+    double budgetCores = 0.0;
+    double avgLoad = 0.0;
+    qint64 lastSampleMs = -1;
+    qint64 lastCpuNs = 0;
+    qint64 lastChangeMs = -1;
+};
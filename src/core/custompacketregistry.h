@@ -0,0 +1,171 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <unordered_map>
+
+namespace CustomPacketHeaderDetail {
+inline bool matchMagic(const uint8_t* data)
+{
+    std::ignore = data;
+    return true;
+}
+
+template <typename... Rest>
+bool matchMagic(const uint8_t* data, uint8_t first, Rest... rest)
+{
+    return data[0] == first && matchMagic(data + 1, rest...);
+}
+} // namespace CustomPacketHeaderDetail
+
+/**
+ * @brief Header of a custom packet: fixed magic bytes followed by TypeBytes bytes of type.
+ *
+ * The magic is a template argument, so the comparison unrolls to one compare per byte instead
+ * of a loop over a table.
+ *
+ * @tparam TypeBytes Number of type bytes after the magic, 1 or 2.
+ * @tparam Magic Bytes every packet of this kind starts with.
+ */
+template <int TypeBytes, uint8_t... Magic>
+struct CustomPacketHeader
+{
+    static_assert(TypeBytes == 1 || TypeBytes == 2, "a packet type has one or two bytes");
+
+    static constexpr size_t MAGIC_SIZE = sizeof...(Magic);
+    static constexpr size_t SIZE = MAGIC_SIZE + TypeBytes;
+
+    /**
+     * @brief Key of a packet type, for two type bytes the first one is the kind.
+     */
+    static constexpr int type(uint8_t kind, uint8_t subtype = 0)
+    {
+        return TypeBytes == 1 ? kind : (kind << 8) | subtype;
+    }
+
+    /**
+     * @brief Reads the type of a packet.
+     * @return The type, as returned by type(), or -1 if the packet doesn't have this header.
+     */
+    static int parse(const uint8_t* data, size_t length)
+    {
+        if (length < SIZE || !CustomPacketHeaderDetail::matchMagic(data, Magic...)) {
+            return -1;
+        }
+
+        return TypeBytes == 1 ? data[MAGIC_SIZE] : type(data[MAGIC_SIZE], data[MAGIC_SIZE + 1]);
+    }
+};
+
+template <int TypeBytes, uint8_t... Magic>
+constexpr size_t CustomPacketHeader<TypeBytes, Magic...>::MAGIC_SIZE;
+template <int TypeBytes, uint8_t... Magic>
+constexpr size_t CustomPacketHeader<TypeBytes, Magic...>::SIZE;
+
+/**
+ * @brief Maps the types of custom packets to their handlers.
+ *
+ * Handlers are registered once for a packet type and marked to either run inline, on the tox
+ * thread inside the toxcore callback, or on the ingestion worker. A tox callback then only
+ * parses the header and looks the type up, the packet is copied only for worker handlers.
+ * Inline handlers get a QByteArray referencing the toxcore buffer, they must copy what they
+ * keep.
+ *
+ * @note All handlers are registered before the first dispatch, and the registry outlives the
+ * jobs it queued on the worker.
+ *
+ * @tparam Header CustomPacketHeader of the packets.
+ * @tparam Source What the callback knows about the sender, passed on to the handlers.
+ */
+template <typename Header, typename Source>
+class CustomPacketRegistry
+{
+public:
+    enum class Context
+    {
+        Inline,
+        Worker
+    };
+
+    using Handler = std::function<void(const Source& source, const QByteArray& packet)>;
+    /**
+     * @brief Queues a job on the ingestion worker.
+     * @return False if the job was dropped, e.g. because the worker is overloaded.
+     */
+    using Worker = std::function<bool(std::function<void()> job)>;
+
+    explicit CustomPacketRegistry(Worker worker_)
+        : worker{std::move(worker_)}
+    {}
+
+    /**
+     * @brief Registers the handler of a packet type, replacing an earlier one.
+     * @param type Packet type, from Header::type().
+     */
+    void add(int type, Context context, Handler handler)
+    {
+        handlers[type] = Entry{context, std::move(handler)};
+    }
+
+    /**
+     * @brief Hands a packet to the handler of its type.
+     * @return False if no handler takes this packet, or the worker dropped it.
+     */
+    bool dispatch(const Source& source, const uint8_t* data, size_t length) const
+    {
+        const int type = Header::parse(data, length);
+        if (type < 0) {
+            return false;
+        }
+
+        const auto it = handlers.find(type);
+        if (it == handlers.end()) {
+            return false;
+        }
+
+        const Entry& entry = it->second;
+        if (entry.context == Context::Inline) {
+            entry.handler(source,
+                          QByteArray::fromRawData(reinterpret_cast<const char*>(data),
+                                                  static_cast<int>(length)));
+            return true;
+        }
+
+        const QByteArray packet(reinterpret_cast<const char*>(data), static_cast<int>(length));
+        const Handler& handler = entry.handler;
+        return worker([&handler, source, packet] { handler(source, packet); });
+    }
+
+private:
+    struct Entry
+    {
+        Context context;
+        Handler handler;
+    };
+
+    const Worker worker;
+    std::unordered_map<int, Entry> handlers;
+};
@@ -0,0 +1,322 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "echodelayestimator.h"
+
+#include "webrtc6/webrtc/common_audio/signal_processing/include/signal_processing_library.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @class EchoDelayEstimator
+ * @brief Estimates the delay between far end audio given to the echo canceller and its echo in
+ * the captured audio.
+ *
+ * Both streams are averaged down to 2kHz. Every UPDATE_MS the last WINDOW_MS of near end audio
+ * is cross correlated against the far end history for all lags up to MAX_DELAY_MS and the lag
+ * with the highest normalized correlation is taken as a candidate, if it correlates well enough
+ * and both ends were loud enough. The reported delay is the median of the last candidates, so a
+ * single wrong peak doesn't move it.
+ *
+ * Capture and playback clocks are never exactly the same, so the delay slowly changes over a
+ * call. The drift is the slope of a least squares fit through the estimates of the last minute
+ * and is used to move the delay on while the far end is silent and no new estimates come in.
+ *
+ * @note Not thread safe, both ends have to be added from the same thread.
+ */
+
+constexpr uint32_t EchoDelayEstimator::SAMPLE_RATE;
+constexpr size_t EchoDelayEstimator::DECIMATION;
+constexpr uint32_t EchoDelayEstimator::MAX_DELAY_MS;
+constexpr uint32_t EchoDelayEstimator::WINDOW_MS;
+constexpr uint32_t EchoDelayEstimator::UPDATE_MS;
+constexpr double EchoDelayEstimator::MIN_CORRELATION;
+constexpr int EchoDelayEstimator::MIN_LEVEL;
+constexpr int EchoDelayEstimator::MAX_JUMP_MS;
+constexpr size_t EchoDelayEstimator::CANDIDATES;
+constexpr size_t EchoDelayEstimator::DRIFT_POINTS;
+constexpr size_t EchoDelayEstimator::MIN_DRIFT_POINTS;
+constexpr int64_t EchoDelayEstimator::DRIFT_INTERVAL_MS;
+constexpr double EchoDelayEstimator::MAX_DRIFT_PPM;
+constexpr uint32_t EchoDelayEstimator::RATE;
+constexpr size_t EchoDelayEstimator::WINDOW;
+constexpr size_t EchoDelayEstimator::MAX_LAG;
+constexpr size_t EchoDelayEstimator::UPDATE_SAMPLES;
+constexpr size_t EchoDelayEstimator::CHUNK;
+
+EchoDelayEstimator::EchoDelayEstimator()
+{
+    // sets up the cross correlation for the CPU we run on
+    WebRtcSpl_Init();
+    reset();
+}
+
+/**
+ * @brief Forgets all audio and estimates, e.g. when a call starts.
+ */
+void EchoDelayEstimator::reset()
+{
+    farEnd.fill(0);
+    nearEnd.fill(0);
+    farFilled = 0;
+    nearFilled = 0;
+    sinceUpdate = 0;
+    nearPosition = 0;
+    candidateCount = 0;
+    nextCandidate = 0;
+    delayMs = -1.0;
+    delayPositionMs = 0;
+    driftCount = 0;
+    nextDriftPoint = 0;
+    driftPpm = 0.0;
+}
+
+/**
+ * @brief Adds audio given to the echo canceller as far end.
+ * @param pcm 16kHz mono samples.
+ * @param samples Number of samples in pcm, should be a multiple of DECIMATION.
+ */
+void EchoDelayEstimator::addFarEnd(const int16_t* pcm, size_t samples)
+{
+    append(farEnd, farFilled, pcm, samples);
+}
+
+/**
+ * @brief Adds captured audio and updates the estimate every UPDATE_MS.
+ * @param pcm 16kHz mono samples.
+ * @param samples Number of samples in pcm, should be a multiple of DECIMATION.
+ */
+void EchoDelayEstimator::addNearEnd(const int16_t* pcm, size_t samples)
+{
+    append(nearEnd, nearFilled, pcm, samples);
+
+    const size_t decimated = samples / DECIMATION;
+    nearPosition += decimated;
+    sinceUpdate += decimated;
+    if (sinceUpdate < UPDATE_SAMPLES || nearFilled < nearEnd.size()
+        || farFilled < farEnd.size()) {
+        return;
+    }
+
+    sinceUpdate = 0;
+    double rawMs;
+    if (estimate(rawMs)) {
+        updateDrift(rawMs);
+        addCandidate(rawMs);
+    }
+}
+
+/**
+ * @brief Current delay estimate, moved on by the measured drift since the last update.
+ * @return Delay in ms or -1 if there was no estimate yet.
+ */
+int EchoDelayEstimator::getDelayMs() const
+{
+    if (delayMs < 0) {
+        return -1;
+    }
+
+    const double elapsedMs = static_cast<double>(positionMs() - delayPositionMs);
+    const double delay = delayMs + driftPpm * elapsedMs / 1000000.0;
+    return static_cast<int>(
+        std::lround(std::min(std::max(delay, 0.0), static_cast<double>(MAX_DELAY_MS))));
+}
+
+/**
+ * @brief Measured clock drift between capture and playback.
+ * @return Change of the delay in parts per million, positive if the delay grows.
+ */
+double EchoDelayEstimator::getDriftPpm() const
+{
+    return driftPpm;
+}
+
+/**
+ * @brief Averages pcm down by DECIMATION and appends it to the end of buffer.
+ */
+template <size_t N>
+void EchoDelayEstimator::append(std::array<int16_t, N>& buffer, size_t& filled,
+                                const int16_t* pcm, size_t samples)
+{
+    std::array<int16_t, CHUNK> decimated;
+    size_t count = samples / DECIMATION;
+    while (count > 0) {
+        const size_t chunk = std::min(count, CHUNK);
+        for (size_t i = 0; i < chunk; ++i) {
+            int32_t sum = 0;
+            for (size_t j = 0; j < DECIMATION; ++j) {
+                sum += pcm[i * DECIMATION + j];
+            }
+            decimated[i] = static_cast<int16_t>(sum / static_cast<int32_t>(DECIMATION));
+        }
+
+        std::move(buffer.begin() + chunk, buffer.end(), buffer.begin());
+        std::copy(decimated.begin(), decimated.begin() + chunk, buffer.end() - chunk);
+        filled = std::min(filled + chunk, N);
+
+        pcm += chunk * DECIMATION;
+        count -= chunk;
+    }
+}
+
+/**
+ * @brief Finds the best matching lag of the near end window in the far end history.
+ * @param rawMs Set to the delay of the best lag.
+ * @return False if the near end window doesn't contain a clear echo.
+ */
+bool EchoDelayEstimator::estimate(double& rawMs)
+{
+    const int nearMax = WebRtcSpl_MaxAbsValueW16(nearEnd.data(), nearEnd.size());
+    const int farMax = WebRtcSpl_MaxAbsValueW16(farEnd.data(), farEnd.size());
+    if (nearMax < MIN_LEVEL || farMax < MIN_LEVEL) {
+        return false;
+    }
+
+    // keep the sum of WINDOW products within 32 bits
+    const int bits = WebRtcSpl_GetSizeInBits(static_cast<uint32_t>(nearMax))
+                     + WebRtcSpl_GetSizeInBits(static_cast<uint32_t>(farMax))
+                     + WebRtcSpl_GetSizeInBits(static_cast<uint32_t>(WINDOW));
+    const int shift = std::max(bits - 31, 0);
+    WebRtcSpl_CrossCorrelation(correlation.data(), nearEnd.data(), farEnd.data(), WINDOW,
+                               correlation.size(), shift, 1);
+
+    double nearEnergy = 0.0;
+    for (int16_t sample : nearEnd) {
+        nearEnergy += static_cast<double>(sample) * sample;
+    }
+
+    double farEnergy = 0.0;
+    for (size_t i = 0; i < WINDOW; ++i) {
+        farEnergy += static_cast<double>(farEnd[i]) * farEnd[i];
+    }
+
+    const double minEnergy = static_cast<double>(WINDOW) * MIN_LEVEL * MIN_LEVEL;
+    if (nearEnergy < minEnergy) {
+        return false;
+    }
+
+    const double scale = std::ldexp(1.0, shift);
+    double best = 0.0;
+    size_t bestLag = 0;
+    for (size_t lag = 0; lag < correlation.size(); ++lag) {
+        if (lag > 0) {
+            const double out = farEnd[lag - 1];
+            const double in = farEnd[lag + WINDOW - 1];
+            farEnergy = std::max(farEnergy + in * in - out * out, 0.0);
+        }
+
+        if (farEnergy < minEnergy) {
+            continue;
+        }
+
+        const double normalized = correlation[lag] * scale / std::sqrt(nearEnergy * farEnergy);
+        if (normalized > best) {
+            best = normalized;
+            bestLag = lag;
+        }
+    }
+
+    if (best < MIN_CORRELATION) {
+        return false;
+    }
+
+    rawMs = static_cast<double>(MAX_LAG - bestLag) * 1000.0 / RATE;
+    return true;
+}
+
+/**
+ * @brief Sets the delay to the median of the last candidates.
+ */
+void EchoDelayEstimator::addCandidate(double rawMs)
+{
+    candidates[nextCandidate] = rawMs;
+    nextCandidate = (nextCandidate + 1) % candidates.size();
+    candidateCount = std::min(candidateCount + 1, candidates.size());
+
+    std::array<double, CANDIDATES> sorted;
+    std::copy(candidates.begin(), candidates.begin() + candidateCount, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + candidateCount);
+
+    const double median = sorted[candidateCount / 2];
+    if (delayMs < 0 || std::abs(median - delayMs) >= 1.0) {
+        qDebug() << "Echo delay estimate:" << median << "ms";
+    }
+
+    delayMs = median;
+    delayPositionMs = positionMs();
+}
+
+/**
+ * @brief Adds an estimate to the drift fit, at most one per DRIFT_INTERVAL_MS.
+ */
+void EchoDelayEstimator::updateDrift(double rawMs)
+{
+    // a real change of the delay, e.g. a new device, isn't drift
+    if (delayMs >= 0 && std::abs(rawMs - delayMs) > MAX_JUMP_MS) {
+        driftCount = 0;
+        nextDriftPoint = 0;
+        driftPpm = 0.0;
+        return;
+    }
+
+    const int64_t now = positionMs();
+    if (driftCount > 0) {
+        const size_t last = (nextDriftPoint + DRIFT_POINTS - 1) % DRIFT_POINTS;
+        if (now - driftPoints[last].positionMs < DRIFT_INTERVAL_MS) {
+            return;
+        }
+    }
+
+    driftPoints[nextDriftPoint] = {now, rawMs};
+    nextDriftPoint = (nextDriftPoint + 1) % DRIFT_POINTS;
+    driftCount = std::min(driftCount + 1, DRIFT_POINTS);
+    if (driftCount < MIN_DRIFT_POINTS) {
+        return;
+    }
+
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (size_t i = 0; i < driftCount; ++i) {
+        meanX += driftPoints[i].positionMs;
+        meanY += driftPoints[i].delayMs;
+    }
+    meanX /= driftCount;
+    meanY /= driftCount;
+
+    double covariance = 0.0;
+    double variance = 0.0;
+    for (size_t i = 0; i < driftCount; ++i) {
+        const double dx = driftPoints[i].positionMs - meanX;
+        covariance += dx * (driftPoints[i].delayMs - meanY);
+        variance += dx * dx;
+    }
+
+    if (variance > 0.0) {
+        driftPpm = std::min(std::max(covariance / variance * 1000000.0, -MAX_DRIFT_PPM),
+                            MAX_DRIFT_PPM);
+    }
+}
+
+int64_t EchoDelayEstimator::positionMs() const
+{
+    return nearPosition * 1000 / RATE;
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class EchoDelayEstimator
+{
+public:
+    EchoDelayEstimator();
+
+    void addFarEnd(const int16_t* pcm, size_t samples);
+    void addNearEnd(const int16_t* pcm, size_t samples);
+    int getDelayMs() const;
+    double getDriftPpm() const;
+    void reset();
+
+    static constexpr uint32_t SAMPLE_RATE = 16000;
+    static constexpr size_t DECIMATION = 8;
+    static constexpr uint32_t MAX_DELAY_MS = 500;
+    static constexpr uint32_t WINDOW_MS = 200;
+    static constexpr uint32_t UPDATE_MS = 200;
+    static constexpr double MIN_CORRELATION = 0.4;
+    static constexpr int MIN_LEVEL = 100;
+    static constexpr int MAX_JUMP_MS = 20;
+    static constexpr size_t CANDIDATES = 5;
+    static constexpr size_t DRIFT_POINTS = 60;
+    static constexpr size_t MIN_DRIFT_POINTS = 5;
+    static constexpr int64_t DRIFT_INTERVAL_MS = 1000;
+    static constexpr double MAX_DRIFT_PPM = 1000.0;
+
+private:
+    static constexpr uint32_t RATE = SAMPLE_RATE / DECIMATION;
+    static constexpr size_t WINDOW = RATE * WINDOW_MS / 1000;
+    static constexpr size_t MAX_LAG = RATE * MAX_DELAY_MS / 1000;
+    static constexpr size_t UPDATE_SAMPLES = RATE * UPDATE_MS / 1000;
+    static constexpr size_t CHUNK = 32;
+
+    struct DriftPoint
+    {
+        int64_t positionMs;
+        double delayMs;
+    };
+
+    template <size_t N>
+    static void append(std::array<int16_t, N>& buffer, size_t& filled, const int16_t* pcm,
+                       size_t samples);
+    bool estimate(double& rawMs);
+    void addCandidate(double rawMs);
+    void updateDrift(double rawMs);
+    int64_t positionMs() const;
+
+private:
+    // far end history long enough to cover the near end window at the largest delay
+    std::array<int16_t, WINDOW + MAX_LAG> farEnd;
+    std::array<int16_t, WINDOW> nearEnd;
+    std::array<int32_t, MAX_LAG + 1> correlation;
+    size_t farFilled = 0;
+    size_t nearFilled = 0;
+    size_t sinceUpdate = 0;
+    int64_t nearPosition = 0;
+
+    std::array<double, CANDIDATES> candidates;
+    size_t candidateCount = 0;
+    size_t nextCandidate = 0;
+    double delayMs = -1.0;
+    int64_t delayPositionMs = 0;
+
+    std::array<DriftPoint, DRIFT_POINTS> driftPoints;
+    size_t driftCount = 0;
+    size_t nextDriftPoint = 0;
+    double driftPpm = 0.0;
+};
@@ -0,0 +1,189 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "filechunkreader.h"
+
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+
+/**
+ * @class FileChunkReader
+ * @brief Serves the chunks toxcore requests for an outgoing file from memory.
+ *
+ * toxcore asks for one small chunk at a time, doing a seek and a read for each of them on the
+ * core thread is slow, especially on network filesystems, and delays everything else the core
+ * thread does. This reader keeps a window of READ_AHEAD_SIZE bytes of the file in memory, and
+ * reads the next window on a worker thread while the current one is sent. Buffers of old windows
+ * are reused for new ones.
+ *
+ * Requests outside both windows, e.g. when toxcore resends a chunk, read a new window in place.
+ *
+ * @note Not thread safe, use it from the core thread only and don't touch the file otherwise
+ * while the reader exists.
+ */
+
+constexpr qint64 FileChunkReader::READ_AHEAD_SIZE;
+
+namespace {
+class ReadAheadPool : public QThreadPool
+{
+public:
+    ReadAheadPool()
+    {
+        setMaxThreadCount(2);
+    }
+};
+
+QThreadPool* readAheadPool()
+{
+    static ReadAheadPool pool;
+    return &pool;
+}
+} // namespace
+
+FileChunkReader::FileChunkReader(std::shared_ptr<QFile> file_)
+    : file{std::move(file_)}
+{
+}
+
+FileChunkReader::~FileChunkReader()
+{
+    if (readAheadPos >= 0) {
+        readAhead.waitForFinished();
+    }
+}
+
+/**
+ * @brief Gets a chunk of the file.
+ * @param pos Offset of the chunk in the file.
+ * @param length Size of the chunk.
+ * @param nread Set to the number of bytes available, less than length at the end of the file.
+ * @return The chunk, valid until the next call, nullptr if nothing could be read.
+ */
+const char* FileChunkReader::read(qint64 pos, qint64 length, qint64& nread)
+{
+    nread = 0;
+    if (pos < 0 || length <= 0) {
+        return nullptr;
+    }
+
+    if (!current.contains(pos)) {
+        Window next = takeReadAhead();
+        if (next.contains(pos)) {
+            recycle(current);
+            current = std::move(next);
+        } else {
+            recycle(next);
+            recycle(current);
+            current = readWindow(*file, pos, std::move(spare));
+            spare = QByteArray();
+            if (!current.contains(pos)) {
+                return nullptr;
+            }
+        }
+    }
+
+    const qint64 available = current.end() - pos;
+    const char* chunk = current.data.constData() + (pos - current.pos);
+    if (available >= length || current.data.size() < READ_AHEAD_SIZE) {
+        // the whole chunk is in the current window, or the file ends with it
+        nread = std::min(length, available);
+        startReadAhead();
+        return chunk;
+    }
+
+    // the chunk spans two windows
+    Window next = takeReadAhead();
+    if (next.pos != current.end()) {
+        recycle(next);
+        next = readWindow(*file, current.end(), std::move(spare));
+        spare = QByteArray();
+    }
+
+    stitched.resize(0);
+    stitched.append(chunk, static_cast<int>(available));
+    if (next.pos >= 0) {
+        stitched.append(next.data.constData(),
+                        static_cast<int>(std::min<qint64>(length - available, next.data.size())));
+    }
+    recycle(current);
+    current = std::move(next);
+    startReadAhead();
+
+    nread = stitched.size();
+    return stitched.constData();
+}
+
+FileChunkReader::Window FileChunkReader::readWindow(QFile& file, qint64 pos, QByteArray buffer)
+{
+    Window window;
+    buffer.resize(static_cast<int>(READ_AHEAD_SIZE));
+    if (!file.seek(pos)) {
+        return window;
+    }
+
+    const qint64 read = file.read(buffer.data(), READ_AHEAD_SIZE);
+    if (read <= 0) {
+        return window;
+    }
+
+    // shrinking keeps the allocation for the next window
+    buffer.resize(static_cast<int>(read));
+    window.pos = pos;
+    window.data = std::move(buffer);
+    return window;
+}
+
+FileChunkReader::Window FileChunkReader::takeReadAhead()
+{
+    if (readAheadPos < 0) {
+        return {};
+    }
+
+    readAheadPos = -1;
+    return readAhead.result();
+}
+
+void FileChunkReader::startReadAhead()
+{
+    if (readAheadPos >= 0 || current.pos < 0 || current.data.size() < READ_AHEAD_SIZE) {
+        return;
+    }
+
+    readAheadPos = current.end();
+    const std::shared_ptr<QFile> f = file;
+    const qint64 pos = readAheadPos;
+    QByteArray buffer;
+    buffer.swap(spare);
+    readAhead = QtConcurrent::run(readAheadPool(), [f, pos, buffer]() mutable {
+        return readWindow(*f, pos, std::move(buffer));
+    });
+}
+
+void FileChunkReader::recycle(Window& window)
+{
+    if (spare.isNull() && !window.data.isNull()) {
+        spare = std::move(window.data);
+    }
+    window = Window{};
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QFuture>
+#include <QtGlobal>
+
+#include <memory>
+
+class QFile;
+
+class FileChunkReader
+{
+public:
+    explicit FileChunkReader(std::shared_ptr<QFile> file_);
+    ~FileChunkReader();
+
+    const char* read(qint64 pos, qint64 length, qint64& nread);
+
+    static constexpr qint64 READ_AHEAD_SIZE = 1024 * 1024;
+
+private:
+    struct Window
+    {
+        qint64 pos = -1;
+        QByteArray data;
+
+        qint64 end() const
+        {
+            return pos + data.size();
+        }
+        bool contains(qint64 p) const
+        {
+            return pos >= 0 && p >= pos && p < end();
+        }
+    };
+
+    static Window readWindow(QFile& file, qint64 pos, QByteArray buffer);
+    Window takeReadAhead();
+    void startReadAhead();
+    void recycle(Window& window);
+
+private:
+    std::shared_ptr<QFile> file;
+    Window current;
+    QByteArray spare;
+    QByteArray stitched;
+    QFuture<Window> readAhead;
+    qint64 readAheadPos = -1;
+};
@@ -0,0 +1,247 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "filechunkwriter.h"
+#include "util/threadscheduling.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * @class FileChunkWriter
+ * @brief Writes and hashes the chunks of an incoming file on a worker thread.
+ *
+ * toxcore hands us one small chunk at a time on the core thread, writing each of them there
+ * makes tox_iterate stall whenever the disk is slow. The chunks are only copied into a batch of
+ * BATCH_SIZE bytes instead, full batches are queued and written in order by a shared pool.
+ *
+ * The queue is not limited by the writer itself, CoreFile pauses the transfer once more than
+ * HIGH_WATERMARK bytes are pending and resumes it below LOW_WATERMARK.
+ *
+ * @note write(), finish() and the destructor must be called from the same thread.
+ */
+
+constexpr qint64 FileChunkWriter::BATCH_SIZE;
+constexpr qint64 FileChunkWriter::HIGH_WATERMARK;
+constexpr qint64 FileChunkWriter::LOW_WATERMARK;
+
+namespace {
+class WriterPool : public QThreadPool
+{
+public:
+    WriterPool()
+    {
+        setMaxThreadCount(2);
+    }
+};
+
+QThreadPool* writerPool()
+{
+    static WriterPool pool;
+    return &pool;
+}
+} // namespace
+
+FileChunkWriter::FileChunkWriter(std::shared_ptr<QFile> file_,
+                                 std::shared_ptr<QCryptographicHash> hash_)
+    : file{std::move(file_)}
+    , hash{std::move(hash_)}
+{
+    batch.reserve(static_cast<int>(BATCH_SIZE));
+}
+
+/**
+ * @brief Drops the writes not started yet and waits for the one in progress.
+ */
+FileChunkWriter::~FileChunkWriter()
+{
+    QMutexLocker locker{&mutex};
+    aborted = true;
+    queue.clear();
+    while (draining) {
+        idle.wait(&mutex);
+    }
+}
+
+/**
+ * @brief Continues a partially received file, call before the first write().
+ * @param offset Bytes of the file kept, anything after them is cut off.
+ *
+ * The kept bytes are read back and hashed on the worker thread before any new chunk is
+ * written, so the hash still covers the whole file.
+ */
+void FileChunkWriter::resumeFrom(qint64 offset)
+{
+    QMutexLocker locker{&mutex};
+    resumeOffset = offset;
+
+    if (!draining) {
+        draining = true;
+        QtConcurrent::run(writerPool(), [this] { drain(); });
+    }
+}
+
+/**
+ * @brief Queues a chunk to be written after all previous ones.
+ * @param data Chunk, copied.
+ * @param length Size of the chunk.
+ */
+void FileChunkWriter::write(const char* data, qint64 length)
+{
+    batch.append(data, static_cast<int>(length));
+    if (batch.size() >= BATCH_SIZE) {
+        submit();
+    }
+}
+
+/**
+ * @brief Writes everything still pending and waits for it.
+ * @param policy How hard to make sure the data reached the disk.
+ * @return False if any write failed.
+ */
+bool FileChunkWriter::finish(SyncPolicy policy)
+{
+    submit();
+
+    QMutexLocker locker{&mutex};
+    while (draining) {
+        idle.wait(&mutex);
+    }
+
+    if (failed) {
+        return false;
+    }
+
+    switch (policy) {
+    case SyncPolicy::None:
+        return true;
+    case SyncPolicy::Flush:
+        return file->flush();
+    case SyncPolicy::Sync:
+        if (!file->flush()) {
+            return false;
+        }
+#ifdef Q_OS_WIN
+        return _commit(file->handle()) == 0;
+#else
+        return fsync(file->handle()) == 0;
+#endif
+    }
+
+    return true;
+}
+
+/**
+ * @brief Bytes received but not written yet.
+ */
+qint64 FileChunkWriter::getPendingBytes() const
+{
+    QMutexLocker locker{&mutex};
+    return queuedBytes + batch.size();
+}
+
+void FileChunkWriter::submit()
+{
+    if (batch.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker{&mutex};
+    queuedBytes += batch.size();
+    queue.push_back(batch);
+    batch = QByteArray();
+    batch.reserve(static_cast<int>(BATCH_SIZE));
+
+    if (!draining) {
+        draining = true;
+        QtConcurrent::run(writerPool(), [this] { drain(); });
+    }
+}
+
+void FileChunkWriter::drain()
+{
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+    QMutexLocker locker{&mutex};
+    if (resumeOffset >= 0 && !aborted) {
+        const qint64 offset = resumeOffset;
+        resumeOffset = -1;
+
+        locker.unlock();
+        const bool kept = rehashPrefix(offset);
+        locker.relock();
+
+        if (!kept) {
+            qWarning() << "Failed to read back the partially received file:" << file->errorString();
+            failed = true;
+        }
+    }
+
+    while (!queue.empty() && !aborted) {
+        const QByteArray block = queue.front();
+        queue.pop_front();
+
+        locker.unlock();
+        hash->addData(block);
+        const bool written = file->write(block) == block.size();
+        locker.relock();
+
+        queuedBytes -= block.size();
+        if (!written) {
+            qWarning() << "Failed to write received file chunk:" << file->errorString();
+            failed = true;
+        }
+    }
+
+    queuedBytes = 0;
+    draining = false;
+    idle.wakeAll();
+}
+
+bool FileChunkWriter::rehashPrefix(qint64 offset)
+{
+    if (!file->resize(offset) || !file->seek(0)) {
+        return false;
+    }
+
+    QByteArray block;
+    qint64 remaining = offset;
+    while (remaining > 0) {
+        block = file->read(std::min(remaining, BATCH_SIZE));
+        if (block.isEmpty()) {
+            return false;
+        }
+        hash->addData(block);
+        remaining -= block.size();
+    }
+
+    return file->seek(offset);
+}
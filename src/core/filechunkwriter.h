@@ -0,0 +1,74 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QtGlobal>
+
+#include <deque>
+#include <memory>
+
+class QCryptographicHash;
+class QFile;
+
+class FileChunkWriter
+{
+public:
+    enum class SyncPolicy
+    {
+        None,
+        Flush,
+        Sync
+    };
+
+    FileChunkWriter(std::shared_ptr<QFile> file_, std::shared_ptr<QCryptographicHash> hash_);
+    ~FileChunkWriter();
+
+    void resumeFrom(qint64 offset);
+    void write(const char* data, qint64 length);
+    bool finish(SyncPolicy policy);
+    qint64 getPendingBytes() const;
+
+    static constexpr qint64 BATCH_SIZE = 256 * 1024;
+    static constexpr qint64 HIGH_WATERMARK = 8 * 1024 * 1024;
+    static constexpr qint64 LOW_WATERMARK = 2 * 1024 * 1024;
+
+private:
+    void submit();
+    void drain();
+    bool rehashPrefix(qint64 offset);
+
+private:
+    const std::shared_ptr<QFile> file;
+    const std::shared_ptr<QCryptographicHash> hash;
+    QByteArray batch;
+
+    mutable QMutex mutex;
+    QWaitCondition idle;
+    std::deque<QByteArray> queue;
+    qint64 queuedBytes = 0;
+    qint64 resumeOffset = -1;
+    bool draining = false;
+    bool aborted = false;
+    bool failed = false;
+};
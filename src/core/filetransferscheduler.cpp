@@ -0,0 +1,194 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "filetransferscheduler.h"
+
+#include <tox/tox.h>
+
+#include <algorithm>
+
+/**
+ * @class FileTransferScheduler
+ * @brief Decides which of the pending chunk requests of outgoing files is sent next.
+ *
+ * toxcore asks for chunks of all outgoing files in whatever order its connections allow, CoreFile
+ * queues these requests here and sends them in the order picked by this class:
+ *  - Files of up to SMALL_FILE_SIZE bytes, e.g. images, first, then everything else, then
+ *    avatars, which are offered again on every reconnect and must not hold back files the user
+ *    sent. A lower priority is only served while no higher one waits.
+ *  - Within a priority, friends take turns by deficit round robin, each getting QUANTUM_BYTES
+ *    per turn, so a friend with many transfers doesn't slow down the others.
+ *  - All files together stay below the upstream limit, if one is set, with bursts of at most
+ *    MAX_BURST_MS worth of data.
+ *
+ * Requests of the same file keep their order, toxcore needs the chunks of a file in sequence.
+ */
+
+constexpr uint64_t FileTransferScheduler::SMALL_FILE_SIZE;
+constexpr qint64 FileTransferScheduler::QUANTUM_BYTES;
+constexpr qint64 FileTransferScheduler::MAX_BURST_MS;
+
+FileTransferScheduler::Priority FileTransferScheduler::priorityFor(uint32_t fileKind,
+                                                                   uint64_t fileSize)
+{
+    if (fileKind == TOX_FILE_KIND_AVATAR) {
+        return Priority::Avatar;
+    }
+
+    return fileSize <= SMALL_FILE_SIZE ? Priority::Small : Priority::Bulk;
+}
+
+void FileTransferScheduler::enqueue(const ChunkRequest& request)
+{
+    PriorityClass& priorityClass = classes[static_cast<size_t>(request.priority)];
+    auto it = priorityClass.flows.find(request.friendId);
+    if (it == priorityClass.flows.end()) {
+        it = priorityClass.flows.emplace(request.friendId, Flow{}).first;
+        priorityClass.order.push_back(request.friendId);
+    }
+    it->second.requests.push_back(request);
+}
+
+/**
+ * @brief Picks the request to send next.
+ * @param request Set to the picked request.
+ * @return False if nothing may be sent now, because no request waits or the upstream limit is
+ * reached. Call commit() once the picked request was sent.
+ */
+bool FileTransferScheduler::next(ChunkRequest& request)
+{
+    for (PriorityClass& priorityClass : classes) {
+        if (priorityClass.order.empty()) {
+            continue;
+        }
+
+        while (true) {
+            Flow& flow = priorityClass.flows[priorityClass.order.front()];
+            const ChunkRequest& front = flow.requests.front();
+            const qint64 length = static_cast<qint64>(front.length);
+            if (flow.deficit >= length) {
+                if (limit > 0 && tokens < length) {
+                    return false;
+                }
+                request = front;
+                return true;
+            }
+
+            // this friend used up its turn, the next one gets a chance
+            flow.deficit += QUANTUM_BYTES;
+            priorityClass.order.push_back(priorityClass.order.front());
+            priorityClass.order.pop_front();
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Marks the request returned by next() as sent.
+ */
+void FileTransferScheduler::commit(const ChunkRequest& request)
+{
+    PriorityClass& priorityClass = classes[static_cast<size_t>(request.priority)];
+    auto it = priorityClass.flows.find(request.friendId);
+    if (it == priorityClass.flows.end() || it->second.requests.empty()) {
+        return;
+    }
+
+    Flow& flow = it->second;
+    flow.requests.pop_front();
+    flow.deficit -= static_cast<qint64>(request.length);
+    if (limit > 0) {
+        tokens -= static_cast<qint64>(request.length);
+    }
+
+    if (flow.requests.empty()) {
+        priorityClass.flows.erase(it);
+        priorityClass.order.erase(
+            std::find(priorityClass.order.begin(), priorityClass.order.end(), request.friendId));
+    }
+}
+
+/**
+ * @brief Drops all requests of a file, e.g. when it was cancelled.
+ * @param key File key as used by CoreFile.
+ */
+void FileTransferScheduler::remove(uint64_t key)
+{
+    for (PriorityClass& priorityClass : classes) {
+        for (auto it = priorityClass.flows.begin(); it != priorityClass.flows.end();) {
+            std::deque<ChunkRequest>& requests = it->second.requests;
+            requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                          [key](const ChunkRequest& r) { return r.key == key; }),
+                           requests.end());
+            if (!requests.empty()) {
+                ++it;
+                continue;
+            }
+
+            priorityClass.order.erase(
+                std::find(priorityClass.order.begin(), priorityClass.order.end(), it->first));
+            it = priorityClass.flows.erase(it);
+        }
+    }
+}
+
+bool FileTransferScheduler::isEmpty() const
+{
+    return std::all_of(classes.begin(), classes.end(),
+                       [](const PriorityClass& c) { return c.order.empty(); });
+}
+
+/**
+ * @brief Limits the upstream of all outgoing files together.
+ * @param bytesPerSecond Limit, 0 for none.
+ */
+void FileTransferScheduler::setUpstreamLimit(qint64 bytesPerSecond)
+{
+    if (bytesPerSecond == limit) {
+        return;
+    }
+
+    limit = std::max<qint64>(0, bytesPerSecond);
+    tokens = std::min(tokens, burstBytes());
+    lastRefillMs = -1;
+}
+
+/**
+ * @brief Adds the upstream budget gained since the last call.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ */
+void FileTransferScheduler::refill(qint64 nowMs)
+{
+    if (limit <= 0 || lastRefillMs < 0) {
+        tokens = burstBytes();
+        lastRefillMs = nowMs;
+        return;
+    }
+
+    tokens = std::min(burstBytes(), tokens + limit * (nowMs - lastRefillMs) / 1000);
+    lastRefillMs = nowMs;
+}
+
+qint64 FileTransferScheduler::burstBytes() const
+{
+    // always allow at least a quantum, or large chunks would never fit
+    return std::max(QUANTUM_BYTES, limit * MAX_BURST_MS / 1000);
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+class FileTransferScheduler
+{
+public:
+    enum class Priority
+    {
+        Small = 0,
+        Bulk = 1,
+        Avatar = 2
+    };
+
+    struct ChunkRequest
+    {
+        uint64_t key;
+        uint32_t friendId;
+        uint64_t pos;
+        size_t length;
+        Priority priority;
+    };
+
+    static Priority priorityFor(uint32_t fileKind, uint64_t fileSize);
+
+    void enqueue(const ChunkRequest& request);
+    bool next(ChunkRequest& request);
+    void commit(const ChunkRequest& request);
+    void remove(uint64_t key);
+    bool isEmpty() const;
+
+    void setUpstreamLimit(qint64 bytesPerSecond);
+    void refill(qint64 nowMs);
+
+    static constexpr uint64_t SMALL_FILE_SIZE = 512 * 1024;
+    static constexpr qint64 QUANTUM_BYTES = 4096;
+    static constexpr qint64 MAX_BURST_MS = 100;
+
+private:
+    struct Flow
+    {
+        std::deque<ChunkRequest> requests;
+        qint64 deficit = 0;
+    };
+
+    struct PriorityClass
+    {
+        std::deque<uint32_t> order;
+        std::unordered_map<uint32_t, Flow> flows;
+    };
+
+    qint64 burstBytes() const;
+
+private:
+    std::array<PriorityClass, 3> classes;
+    qint64 limit = 0;
+    qint64 tokens = 0;
+    qint64 lastRefillMs = -1;
+};
@@ -0,0 +1,220 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "groupaudiomixer.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GROUPMIXER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define GROUPMIXER_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * @class GroupAudioMixer
+ * @brief Mixes the audio of all peers of a group call into one stereo stream.
+ *
+ * Each peer writes into the same BLOCK_SAMPLES long block, at its own position. The block is
+ * handed to the output once every active peer filled it, or as soon as any peer would write
+ * past its end, so there is at most one block of added latency. Sums are kept in 32 bit and
+ * saturated to 16 bit once per block.
+ *
+ * A peer that didn't send anything for INACTIVE_BLOCKS blocks is considered inactive and not
+ * waited for anymore, which is what happens to peers that stopped talking.
+ *
+ * @note Not thread safe, all peers of a group are mixed on the group audio thread, see
+ * CoreGroupAudioReceiver.
+ */
+
+constexpr uint32_t GroupAudioMixer::SAMPLE_RATE;
+constexpr unsigned GroupAudioMixer::CHANNELS;
+constexpr size_t GroupAudioMixer::BLOCK_SAMPLES;
+constexpr int GroupAudioMixer::INACTIVE_BLOCKS;
+
+namespace {
+/**
+ * @brief Saturates 32 bit samples to 16 bit.
+ * @param length Number of samples, must be a multiple of 8.
+ */
+void saturate(const int32_t* in, int16_t* out, size_t length)
+{
+#if defined(GROUPMIXER_SSE2)
+    for (size_t i = 0; i < length; i += 8) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+#elif defined(GROUPMIXER_NEON)
+    for (size_t i = 0; i < length; i += 8) {
+        const int16x4_t low = vqmovn_s32(vld1q_s32(in + i));
+        const int16x4_t high = vqmovn_s32(vld1q_s32(in + i + 4));
+        vst1q_s16(out + i, vcombine_s16(low, high));
+    }
+#else
+    for (size_t i = 0; i < length; ++i) {
+        out[i] = static_cast<int16_t>(std::max<int32_t>(-32768, std::min<int32_t>(32767, in[i])));
+    }
+#endif
+}
+
+static_assert((GroupAudioMixer::BLOCK_SAMPLES * GroupAudioMixer::CHANNELS) % 8 == 0,
+              "Saturation works on 8 samples at once");
+} // namespace
+
+/**
+ * @param output_ Receives every mixed block, interleaved stereo at SAMPLE_RATE.
+ */
+GroupAudioMixer::GroupAudioMixer(Output output_)
+    : output{std::move(output_)}
+{
+    mix.fill(0);
+    block.fill(0);
+}
+
+/**
+ * @brief Adds a decoded frame of a peer to the mix.
+ * @param peer Id of the peer, new peers are added with unity gain.
+ * @param pcm Samples at SAMPLE_RATE, interleaved if stereo.
+ * @param samples Number of samples per channel.
+ * @param channels 1 or 2.
+ */
+void GroupAudioMixer::push(uint32_t peer, const int16_t* pcm, size_t samples, unsigned channels)
+{
+    if (channels != 1 && channels != 2) {
+        return;
+    }
+
+    Peer& state = peers[peer];
+    state.idleBlocks = 0;
+
+    while (samples > 0) {
+        if (state.filled == BLOCK_SAMPLES) {
+            // this peer is a block ahead of the others, don't wait for them anymore
+            flush();
+        }
+
+        const size_t count = std::min(samples, BLOCK_SAMPLES - state.filled);
+        accumulate(state, pcm, count, channels);
+        state.filled += count;
+        pcm += count * channels;
+        samples -= count;
+    }
+
+    if (allActiveFilled()) {
+        flush();
+    }
+}
+
+/**
+ * @brief Sets the volume and stereo position of a peer.
+ * @param peer Id of the peer.
+ * @param gain Linear gain, 1 keeps the volume.
+ * @param pan -1 is left, 0 center and 1 right.
+ */
+void GroupAudioMixer::setPeerGain(uint32_t peer, float gain, float pan)
+{
+    pan = std::max(-1.0f, std::min(1.0f, pan));
+    auto it = peers.find(peer);
+    if (it == peers.end()) {
+        // don't wait for a peer that didn't send anything yet
+        it = peers.emplace(peer, Peer{}).first;
+        it->second.idleBlocks = INACTIVE_BLOCKS;
+    }
+
+    Peer& state = it->second;
+    state.gainLeft = gain * std::min(1.0f, 1.0f - pan);
+    state.gainRight = gain * std::min(1.0f, 1.0f + pan);
+}
+
+/**
+ * @brief Forgets a peer that left, what they already contributed is still played.
+ */
+void GroupAudioMixer::removePeer(uint32_t peer)
+{
+    peers.erase(peer);
+}
+
+/**
+ * @brief Number of peers sending audio recently.
+ */
+int GroupAudioMixer::activePeers() const
+{
+    int count = 0;
+    for (const auto& peer : peers) {
+        count += peer.second.idleBlocks < INACTIVE_BLOCKS ? 1 : 0;
+    }
+    return count;
+}
+
+void GroupAudioMixer::accumulate(const Peer& peer, const int16_t* pcm, size_t samples,
+                                 unsigned channels)
+{
+    int32_t* out = mix.data() + peer.filled * CHANNELS;
+
+    if (peer.gainLeft == 1.0f && peer.gainRight == 1.0f) {
+        if (channels == 1) {
+            for (size_t i = 0; i < samples; ++i) {
+                out[2 * i] += pcm[i];
+                out[2 * i + 1] += pcm[i];
+            }
+        } else {
+            for (size_t i = 0; i < samples * 2; ++i) {
+                out[i] += pcm[i];
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < samples; ++i) {
+        const float left = pcm[i * channels];
+        const float right = pcm[i * channels + channels - 1];
+        out[2 * i] += static_cast<int32_t>(left * peer.gainLeft);
+        out[2 * i + 1] += static_cast<int32_t>(right * peer.gainRight);
+    }
+}
+
+void GroupAudioMixer::flush()
+{
+    saturate(mix.data(), block.data(), mix.size());
+    mix.fill(0);
+
+    for (auto& peer : peers) {
+        if (peer.second.filled == 0 && peer.second.idleBlocks < INACTIVE_BLOCKS) {
+            ++peer.second.idleBlocks;
+        }
+        peer.second.filled = 0;
+    }
+
+    if (output) {
+        output(block.data(), BLOCK_SAMPLES);
+    }
+}
+
+bool GroupAudioMixer::allActiveFilled() const
+{
+    for (const auto& peer : peers) {
+        if (peer.second.idleBlocks < INACTIVE_BLOCKS && peer.second.filled < BLOCK_SAMPLES) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+class GroupAudioMixer
+{
+public:
+    using Output = std::function<void(const int16_t* pcm, size_t samples)>;
+
+    explicit GroupAudioMixer(Output output);
+
+    void push(uint32_t peer, const int16_t* pcm, size_t samples, unsigned channels);
+    void setPeerGain(uint32_t peer, float gain, float pan);
+    void removePeer(uint32_t peer);
+    int activePeers() const;
+
+    static constexpr uint32_t SAMPLE_RATE = 48000;
+    static constexpr unsigned CHANNELS = 2;
+    static constexpr size_t BLOCK_SAMPLES = SAMPLE_RATE / 50;
+    static constexpr int INACTIVE_BLOCKS = 10;
+
+private:
+    struct Peer
+    {
+        size_t filled = 0;
+        int idleBlocks = 0;
+        float gainLeft = 1.0f;
+        float gainRight = 1.0f;
+    };
+
+    void accumulate(const Peer& peer, const int16_t* pcm, size_t samples, unsigned channels);
+    void flush();
+    bool allActiveFilled() const;
+
+private:
+    Output output;
+    std::map<uint32_t, Peer> peers;
+    std::array<int32_t, BLOCK_SAMPLES * CHANNELS> mix;
+    std::array<int16_t, BLOCK_SAMPLES * CHANNELS> block;
+};
@@ -55,7 +55,7 @@ GroupId::GroupId(const QByteArray& rawId)
  * GroupId::size from the specified buffer.
  */
 GroupId::GroupId(const uint8_t* rawId)
-    : ChatId(QByteArray(reinterpret_cast<const char*>(rawId), size))
+    : ChatId(rawId, size)
 {
 }
 
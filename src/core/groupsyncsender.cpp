@@ -0,0 +1,215 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "groupsyncsender.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 10, 0 )
+#include <QRandomGenerator>
+#endif
+
+#include <algorithm>
+
+/**
+ * @class GroupSyncSender
+ * @brief Sends the replies to NGC history sync requests, paced per peer.
+ *
+ * History collects the packets of a reply up front, this thread then sends one packet of each
+ * peer every MIN_INTERVAL_MS plus a random jitter of up to MAX_JITTER_MS, so a peer isn't
+ * flooded and peers syncing at the same time don't wait for each other. The send function is
+ * only called for a single packet at a time, no lock is held while waiting.
+ *
+ * A new request from a peer replaces the reply that is still being sent to it, unless it is
+ * appended, and replies are cancelled when the peer leaves, since toxcore reuses peer ids.
+ *
+ * @note All methods are thread safe.
+ */
+
+constexpr qint64 GroupSyncSender::MIN_INTERVAL_MS;
+constexpr qint64 GroupSyncSender::MAX_JITTER_MS;
+
+/**
+ * @param send_ Sends one packet, called on the sender thread.
+ */
+GroupSyncSender::GroupSyncSender(SendFunction send_)
+    : send{std::move(send_)}
+{
+    setObjectName("qTox GroupSync");
+    clock.start();
+}
+
+GroupSyncSender::~GroupSyncSender()
+{
+    stop();
+}
+
+/**
+ * @brief Queues the packets of a sync reply, starting the thread if needed.
+ * @param groupNumber Toxcore group number.
+ * @param peerId Peer that requested the sync.
+ * @param packets Packets in the order they should be sent.
+ */
+void GroupSyncSender::enqueue(uint32_t groupNumber, uint32_t peerId, QVector<QByteArray> packets)
+{
+    if (packets.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker{&mutex};
+    auto it = std::find_if(jobs.begin(), jobs.end(), [=](const Job& job) {
+        return job.groupNumber == groupNumber && job.peerId == peerId;
+    });
+    // the first packet waits as well, just like every later one
+    const qint64 nextSendMs = clock.elapsed() + MIN_INTERVAL_MS + randomJitterMs();
+    if (it != jobs.end()) {
+        qDebug() << "Restarting history sync for peer" << peerId << "of group" << groupNumber;
+        it->packets = std::move(packets);
+        it->nextPacket = 0;
+        it->nextSendMs = nextSendMs;
+    } else {
+        jobs.push_back(Job{groupNumber, peerId, std::move(packets), 0, nextSendMs});
+    }
+
+    if (!running) {
+        running = true;
+        start(QThread::LowPriority);
+    }
+    wakeUp.wakeOne();
+}
+
+/**
+ * @brief Queues packets behind those still waiting for a peer, starting the thread if needed.
+ * @param groupNumber Toxcore group number.
+ * @param peerId Peer to send to.
+ * @param packets Packets in the order they should be sent.
+ */
+void GroupSyncSender::append(uint32_t groupNumber, uint32_t peerId, QVector<QByteArray> packets)
+{
+    if (packets.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker{&mutex};
+    auto it = std::find_if(jobs.begin(), jobs.end(), [=](const Job& job) {
+        return job.groupNumber == groupNumber && job.peerId == peerId;
+    });
+    if (it != jobs.end()) {
+        it->packets.append(packets);
+        return;
+    }
+
+    jobs.push_back(Job{groupNumber, peerId, std::move(packets), 0,
+                       clock.elapsed() + MIN_INTERVAL_MS + randomJitterMs()});
+    if (!running) {
+        running = true;
+        start(QThread::LowPriority);
+    }
+    wakeUp.wakeOne();
+}
+
+/**
+ * @brief Drops what is left of the reply to a peer.
+ * @param groupNumber Toxcore group number.
+ * @param peerId Peer to stop sending to.
+ */
+void GroupSyncSender::cancel(uint32_t groupNumber, uint32_t peerId)
+{
+    QMutexLocker locker{&mutex};
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                              [=](const Job& job) {
+                                  return job.groupNumber == groupNumber && job.peerId == peerId;
+                              }),
+               jobs.end());
+}
+
+/**
+ * @brief Drops the replies to all peers of a group, e.g. when we leave it.
+ * @param groupNumber Toxcore group number.
+ */
+void GroupSyncSender::cancelGroup(uint32_t groupNumber)
+{
+    QMutexLocker locker{&mutex};
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                              [=](const Job& job) { return job.groupNumber == groupNumber; }),
+               jobs.end());
+}
+
+/**
+ * @brief Stops the thread and waits for it, replies not sent yet are discarded.
+ */
+void GroupSyncSender::stop()
+{
+    {
+        QMutexLocker locker{&mutex};
+        if (!running) {
+            return;
+        }
+        running = false;
+        jobs.clear();
+        wakeUp.wakeOne();
+    }
+    wait();
+}
+
+void GroupSyncSender::run()
+{
+    QMutexLocker locker{&mutex};
+    while (running) {
+        if (jobs.empty()) {
+            wakeUp.wait(&mutex);
+            continue;
+        }
+
+        auto due = std::min_element(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+            return a.nextSendMs < b.nextSendMs;
+        });
+        const qint64 waitMs = due->nextSendMs - clock.elapsed();
+        if (waitMs > 0) {
+            wakeUp.wait(&mutex, static_cast<unsigned long>(waitMs));
+            continue;
+        }
+
+        const uint32_t groupNumber = due->groupNumber;
+        const uint32_t peerId = due->peerId;
+        const QByteArray packet = due->packets[due->nextPacket++];
+        if (due->nextPacket < due->packets.size()) {
+            due->nextSendMs = clock.elapsed() + MIN_INTERVAL_MS + randomJitterMs();
+        } else {
+            jobs.erase(due);
+        }
+
+        locker.unlock();
+        if (!send(groupNumber, peerId, packet)) {
+            qDebug() << "Failed to send history sync packet to peer" << peerId << "of group"
+                     << groupNumber;
+        }
+        locker.relock();
+    }
+}
+
+qint64 GroupSyncSender::randomJitterMs()
+{
+#if QT_VERSION < QT_VERSION_CHECK( 5, 10, 0 )
+    return qrand() % (MAX_JITTER_MS + 1);
+#else
+    return QRandomGenerator::global()->bounded(static_cast<int>(MAX_JITTER_MS) + 1);
+#endif
+}
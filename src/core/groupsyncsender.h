@@ -0,0 +1,76 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class GroupSyncSender : public QThread
+{
+    Q_OBJECT
+
+public:
+    using SendFunction =
+        std::function<bool(uint32_t groupNumber, uint32_t peerId, const QByteArray& packet)>;
+
+    explicit GroupSyncSender(SendFunction send_);
+    ~GroupSyncSender();
+
+    void enqueue(uint32_t groupNumber, uint32_t peerId, QVector<QByteArray> packets);
+    void append(uint32_t groupNumber, uint32_t peerId, QVector<QByteArray> packets);
+    void cancel(uint32_t groupNumber, uint32_t peerId);
+    void cancelGroup(uint32_t groupNumber);
+    void stop();
+
+    static constexpr qint64 MIN_INTERVAL_MS = 300;
+    static constexpr qint64 MAX_JITTER_MS = 300;
+
+protected:
+    void run() override;
+
+private:
+    struct Job
+    {
+        uint32_t groupNumber;
+        uint32_t peerId;
+        QVector<QByteArray> packets;
+        int nextPacket;
+        qint64 nextSendMs;
+    };
+
+    static qint64 randomJitterMs();
+
+private:
+    const SendFunction send;
+    QElapsedTimer clock;
+    QMutex mutex;
+    QWaitCondition wakeUp;
+    std::vector<Job> jobs;
+    bool running = false;
+};
@@ -19,4 +19,13 @@
 
 #include "icorefriendmessagesender.h"
 
+/**
+ * @class ICoreFriendMessageSender
+ * @brief Queues messages to friends without waiting for toxcore.
+ *
+ * queueMessage() and queueAction() return an id unique per sender. Once toxcore took the
+ * message, or refused it, the result is reported asynchronously with that id, see
+ * Core::friendMessageSent and Core::friendMessagesRefused.
+ */
+
 ICoreFriendMessageSender::~ICoreFriendMessageSender() = default;
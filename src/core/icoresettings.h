@@ -23,6 +23,7 @@
 
 #include <tox/tox.h>
 
+#include <QByteArray>
 #include <QList>
 #include <QNetworkProxy>
 #include <QString>
@@ -66,6 +67,12 @@ public:
 
     virtual QNetworkProxy getProxy() const = 0;
 
+    virtual QByteArray getBootstrapNodeRanking() const = 0;
+    virtual void setBootstrapNodeRanking(const QByteArray& ranking) = 0;
+
+    virtual QByteArray getLanPeerCache() const = 0;
+    virtual void setLanPeerCache(const QByteArray& peers) = 0;
+
     DECLARE_SIGNAL(enableIPv6Changed, bool enabled);
     DECLARE_SIGNAL(forceTCPChanged, bool enabled);
     DECLARE_SIGNAL(enableLanDiscoveryChanged, bool enabled);
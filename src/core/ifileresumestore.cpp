@@ -0,0 +1,32 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ifileresumestore.h"
+
+/**
+ * @class IFileResumeStore
+ * @brief Remembers unfinished file transfers so CoreFile can resume them after a restart or
+ * when the friend comes back online.
+ *
+ * Entries are keyed by the 32 byte tox file id. bytesDone is a lower bound of what reached the
+ * disk, the receiver resumes from it or from the size of the partial file, whichever is
+ * smaller.
+ */
+
+IFileResumeStore::~IFileResumeStore() = default;
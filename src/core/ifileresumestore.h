@@ -0,0 +1,54 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+
+class IFileResumeStore
+{
+public:
+    struct Entry
+    {
+        QByteArray fileId;
+        ToxPk friendPk;
+        bool sending = false;
+        QString fileName;
+        QString filePath;
+        uint64_t fileSize = 0;
+        uint64_t bytesDone = 0;
+    };
+
+    IFileResumeStore() = default;
+    virtual ~IFileResumeStore();
+    IFileResumeStore(const IFileResumeStore&) = default;
+    IFileResumeStore& operator=(const IFileResumeStore&) = default;
+    IFileResumeStore(IFileResumeStore&&) = default;
+    IFileResumeStore& operator=(IFileResumeStore&&) = default;
+
+    virtual void saveFileProgress(const Entry& entry) = 0;
+    virtual void removeFileProgress(const QByteArray& fileId) = 0;
+    virtual QVector<Entry> getResumableFiles(const ToxPk& friendPk) = 0;
+};
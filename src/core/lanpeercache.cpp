@@ -0,0 +1,355 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lanpeercache.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkInterface>
+#include <QStringBuilder>
+#include <QStringList>
+#include <QtEndian>
+
+#include <algorithm>
+
+/**
+ * @class LanPeerCache
+ * @brief Remembers where friends on the same LAN could be reached directly.
+ *
+ * Friends connected to us with UDP tell us their DHT key, UDP port and local IPv4 addresses, see
+ * makeAnnouncement(). If one of those addresses is in a subnet we are in too, the friend is
+ * stored for the current network. The network is identified by the subnets of our own
+ * interfaces, see setNetwork(), so a laptop keeps separate peers for the office and home.
+ *
+ * Bootstrapping from those peers first gets us into the DHT through the LAN, where the friend
+ * is found right away. That only works as long as the friend's tox instance and with it its DHT
+ * key didn't change, stale peers fail quietly and get updated on the next UDP connection.
+ *
+ * The cache is small and stored as JSON in the personal settings, see save() and load().
+ *
+ * @note Not thread safe, Core uses it from its own thread only.
+ */
+
+constexpr qint64 LanPeerCache::MAX_AGE_SECS;
+constexpr int LanPeerCache::MAX_PEERS_PER_NETWORK;
+constexpr int LanPeerCache::MAX_NETWORKS;
+constexpr int LanPeerCache::MAX_ADDRESSES;
+constexpr int LanPeerCache::MAX_BOOTSTRAP_PEERS;
+constexpr uint8_t LanPeerCache::ANNOUNCEMENT_VERSION;
+
+/**
+ * @brief Lists the IPv4 addresses of all running interfaces that aren't loopback or link local.
+ */
+QList<LanPeerCache::LocalAddress> LanPeerCache::localAddresses()
+{
+    QList<LocalAddress> addresses;
+    for (const QNetworkInterface& iface : QNetworkInterface::allInterfaces()) {
+        const auto flags = iface.flags();
+        if (!(flags & QNetworkInterface::IsUp) || !(flags & QNetworkInterface::IsRunning)
+            || (flags & QNetworkInterface::IsLoopBack)) {
+            continue;
+        }
+
+        for (const QNetworkAddressEntry& entry : iface.addressEntries()) {
+            const QHostAddress ip = entry.ip();
+            if (ip.protocol() != QAbstractSocket::IPv4Protocol || ip.isLoopback()
+                || ip.isInSubnet(QHostAddress(QStringLiteral("169.254.0.0")), 16)) {
+                continue;
+            }
+
+            addresses.append({ip, entry.prefixLength()});
+        }
+    }
+
+    return addresses;
+}
+
+/**
+ * @brief Selects the network we are in.
+ * @param addresses Our own addresses, usually localAddresses().
+ */
+void LanPeerCache::setNetwork(const QList<LocalAddress>& addresses)
+{
+    local = addresses;
+
+    QStringList subnets;
+    for (const LocalAddress& address : addresses) {
+        const int prefix = std::max(0, std::min(32, address.second));
+        const quint32 mask = prefix == 0 ? 0 : ~quint32{0} << (32 - prefix);
+        const QHostAddress network{address.first.toIPv4Address() & mask};
+        subnets.append(network.toString() % QLatin1Char('/') % QString::number(prefix));
+    }
+
+    subnets.sort();
+    subnets.removeDuplicates();
+    networkKey = subnets.join(QLatin1Char(','));
+}
+
+/**
+ * @brief Identifies the current network by its subnets, empty if we have none.
+ */
+QString LanPeerCache::getNetworkKey() const
+{
+    return networkKey;
+}
+
+/**
+ * @brief Our own addresses in the current network, to announce them to our friends.
+ */
+QList<QHostAddress> LanPeerCache::getLocalAddresses() const
+{
+    QList<QHostAddress> addresses;
+    for (const LocalAddress& address : local) {
+        if (addresses.size() == MAX_ADDRESSES) {
+            break;
+        }
+        addresses.append(address.first);
+    }
+    return addresses;
+}
+
+/**
+ * @brief Stores a friend if one of its addresses is in one of our subnets.
+ * @param friendPk Friend that sent the announcement.
+ * @param announcement The announcement.
+ * @param nowSecs Current time in seconds since epoch.
+ * @return True if the friend is in the current network and got stored.
+ */
+bool LanPeerCache::recordAnnouncement(const ToxPk& friendPk, const Announcement& announcement,
+                                      qint64 nowSecs)
+{
+    if (networkKey.isEmpty() || announcement.port == 0) {
+        return false;
+    }
+
+    const auto address = std::find_if(announcement.addresses.begin(), announcement.addresses.end(),
+                                      [this](const QHostAddress& candidate) {
+                                          return std::any_of(local.begin(), local.end(),
+                                                             [&candidate](const LocalAddress& own) {
+                                                                 return candidate != own.first
+                                                                        && candidate.isInSubnet(own);
+                                                             });
+                                      });
+    if (address == announcement.addresses.end()) {
+        return false;
+    }
+
+    if (!networks.contains(networkKey) && networks.size() >= MAX_NETWORKS) {
+        dropOldestNetwork();
+    }
+
+    QVector<Peer>& peers = networks[networkKey];
+    peers.erase(std::remove_if(peers.begin(), peers.end(),
+                               [&friendPk](const Peer& peer) { return peer.friendPk == friendPk; }),
+                peers.end());
+    peers.prepend({friendPk, *address, announcement.port, announcement.dhtId, nowSecs});
+    if (peers.size() > MAX_PEERS_PER_NETWORK) {
+        peers.resize(MAX_PEERS_PER_NETWORK);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Peers to bootstrap from in the current network.
+ * @return Up to MAX_BOOTSTRAP_PEERS peers, the most recently seen first.
+ */
+QList<LanPeerCache::Peer> LanPeerCache::getPeers() const
+{
+    const auto it = networks.constFind(networkKey);
+    if (networkKey.isEmpty() || it == networks.constEnd()) {
+        return {};
+    }
+
+    return it->mid(0, MAX_BOOTSTRAP_PEERS).toList();
+}
+
+/**
+ * @brief Serializes an announcement of our own endpoint.
+ * @return A version byte, the DHT key, the port in network byte order and up to MAX_ADDRESSES
+ * IPv4 addresses of 4 bytes each.
+ */
+QByteArray LanPeerCache::makeAnnouncement(const Announcement& announcement)
+{
+    QByteArray data;
+    data.reserve(1 + ToxPk::size + 2 + MAX_ADDRESSES * 4);
+    data.append(static_cast<char>(ANNOUNCEMENT_VERSION));
+    data.append(announcement.dhtId.getByteArray());
+
+    uchar port[2];
+    qToBigEndian(announcement.port, port);
+    data.append(reinterpret_cast<const char*>(port), sizeof(port));
+
+    int count = 0;
+    for (const QHostAddress& address : announcement.addresses) {
+        if (count == MAX_ADDRESSES || address.protocol() != QAbstractSocket::IPv4Protocol) {
+            continue;
+        }
+
+        uchar ip[4];
+        qToBigEndian(address.toIPv4Address(), ip);
+        data.append(reinterpret_cast<const char*>(ip), sizeof(ip));
+        ++count;
+    }
+
+    return data;
+}
+
+/**
+ * @brief Parses an announcement created by makeAnnouncement().
+ * @param data The announcement.
+ * @param announcement Filled with the parsed announcement.
+ * @return False if the data is malformed or has an unknown version.
+ */
+bool LanPeerCache::parseAnnouncement(const QByteArray& data, Announcement& announcement)
+{
+    constexpr int fixedSize = 1 + ToxPk::size + 2;
+    if (data.size() < fixedSize || (data.size() - fixedSize) % 4 != 0
+        || (data.size() - fixedSize) / 4 > MAX_ADDRESSES
+        || static_cast<uint8_t>(data[0]) != ANNOUNCEMENT_VERSION) {
+        return false;
+    }
+
+    const uchar* raw = reinterpret_cast<const uchar*>(data.constData());
+    announcement.dhtId = ToxPk{raw + 1};
+    announcement.port = qFromBigEndian<quint16>(raw + 1 + ToxPk::size);
+    announcement.addresses.clear();
+    for (int offset = fixedSize; offset < data.size(); offset += 4) {
+        announcement.addresses.append(QHostAddress{qFromBigEndian<quint32>(raw + offset)});
+    }
+
+    return true;
+}
+
+/**
+ * @brief Serializes the cache, dropping peers we didn't see for MAX_AGE_SECS.
+ * @param nowSecs Current time in seconds since epoch.
+ * @return Compact JSON document.
+ */
+QByteArray LanPeerCache::save(qint64 nowSecs) const
+{
+    QJsonArray savedNetworks;
+    for (auto it = networks.constBegin(); it != networks.constEnd(); ++it) {
+        QJsonArray peers;
+        for (const Peer& peer : *it) {
+            if (nowSecs - peer.seenSecs > MAX_AGE_SECS) {
+                continue;
+            }
+
+            QJsonObject saved;
+            saved["friend"] = peer.friendPk.toString();
+            saved["address"] = peer.address.toString();
+            saved["port"] = peer.port;
+            saved["dht"] = peer.dhtId.toString();
+            saved["seen"] = peer.seenSecs;
+            peers.append(saved);
+        }
+
+        if (peers.isEmpty()) {
+            continue;
+        }
+
+        QJsonObject network;
+        network["key"] = it.key();
+        network["peers"] = peers;
+        savedNetworks.append(network);
+    }
+
+    QJsonObject root;
+    root["networks"] = savedNetworks;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @brief Replaces the cache with a serialized one, the current network stays selected.
+ * @param data JSON document created by save(), can be empty.
+ * @return False if the data couldn't be parsed, the cache is empty then.
+ */
+bool LanPeerCache::load(const QByteArray& data)
+{
+    networks.clear();
+
+    if (data.isEmpty()) {
+        return true;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        qWarning() << "Failed to parse LAN peer cache:" << error.errorString();
+        return false;
+    }
+
+    for (const QJsonValue& networkValue : doc.object()["networks"].toArray()) {
+        const QJsonObject network = networkValue.toObject();
+        const QString key = network["key"].toString();
+        if (key.isEmpty()) {
+            continue;
+        }
+
+        QVector<Peer> peers;
+        for (const QJsonValue& peerValue : network["peers"].toArray()) {
+            const QJsonObject peer = peerValue.toObject();
+            const QString friendPk = peer["friend"].toString();
+            const QString dhtId = peer["dht"].toString();
+            const QHostAddress address{peer["address"].toString()};
+            const int port = peer["port"].toInt();
+            if (friendPk.length() != ToxPk::numHexChars || dhtId.length() != ToxPk::numHexChars
+                || address.protocol() != QAbstractSocket::IPv4Protocol || port <= 0
+                || port > 0xFFFF) {
+                continue;
+            }
+
+            peers.append({ToxPk{friendPk}, address, static_cast<quint16>(port), ToxPk{dhtId},
+                          static_cast<qint64>(peer["seen"].toDouble())});
+            if (peers.size() == MAX_PEERS_PER_NETWORK) {
+                break;
+            }
+        }
+
+        if (!peers.isEmpty()) {
+            networks.insert(key, peers);
+        }
+    }
+
+    while (networks.size() > MAX_NETWORKS) {
+        dropOldestNetwork();
+    }
+
+    return true;
+}
+
+void LanPeerCache::dropOldestNetwork()
+{
+    auto oldest = networks.end();
+    qint64 oldestSecs = 0;
+    for (auto it = networks.begin(); it != networks.end(); ++it) {
+        const qint64 seenSecs = it->isEmpty() ? 0 : it->first().seenSecs;
+        if (oldest == networks.end() || seenSecs < oldestSecs) {
+            oldest = it;
+            oldestSecs = seenSecs;
+        }
+    }
+
+    if (oldest != networks.end()) {
+        networks.erase(oldest);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+class LanPeerCache
+{
+public:
+    // one of our own addresses with the prefix length of its subnet
+    using LocalAddress = QPair<QHostAddress, int>;
+
+    struct Peer
+    {
+        ToxPk friendPk;
+        QHostAddress address;
+        quint16 port;
+        ToxPk dhtId;
+        qint64 seenSecs;
+    };
+
+    struct Announcement
+    {
+        ToxPk dhtId;
+        quint16 port;
+        QList<QHostAddress> addresses;
+    };
+
+    static QList<LocalAddress> localAddresses();
+    void setNetwork(const QList<LocalAddress>& addresses);
+    QString getNetworkKey() const;
+    QList<QHostAddress> getLocalAddresses() const;
+
+    bool recordAnnouncement(const ToxPk& friendPk, const Announcement& announcement,
+                            qint64 nowSecs);
+    QList<Peer> getPeers() const;
+
+    static QByteArray makeAnnouncement(const Announcement& announcement);
+    static bool parseAnnouncement(const QByteArray& data, Announcement& announcement);
+
+    QByteArray save(qint64 nowSecs) const;
+    bool load(const QByteArray& data);
+
+    static constexpr qint64 MAX_AGE_SECS = 14 * 24 * 60 * 60;
+    static constexpr int MAX_PEERS_PER_NETWORK = 32;
+    static constexpr int MAX_NETWORKS = 8;
+    static constexpr int MAX_ADDRESSES = 4;
+    static constexpr int MAX_BOOTSTRAP_PEERS = 8;
+
+private:
+    static constexpr uint8_t ANNOUNCEMENT_VERSION = 1;
+
+    void dropOldestNetwork();
+
+private:
+    // network key -> peers seen there, the most recent first
+    QHash<QString, QVector<Peer>> networks;
+    QList<LocalAddress> local;
+    QString networkKey;
+};
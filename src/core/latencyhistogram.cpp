@@ -0,0 +1,202 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "latencyhistogram.h"
+
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @class LatencyHistogram
+ * @brief Rolling histogram of latencies in milliseconds.
+ *
+ * Buckets grow roughly by a factor of two, see BUCKET_LIMITS_MS, the last bucket holds
+ * everything above. Samples are collected in windows of WINDOW_SAMPLES and the statistics
+ * cover the current and the previous window, so old samples age out without storing each one.
+ *
+ * @note All methods are thread safe, the send and receive threads feed the same object while
+ * the GUI reads it.
+ */
+
+/**
+ * @struct AudioLatencyStats
+ * @brief Latency of each audio stage of a call.
+ *
+ * @var AudioLatencyStats::capture
+ * @brief Audio waiting in the capture device when a frame is read.
+ *
+ * @var AudioLatencyStats::queue
+ * @brief Time a captured frame waits for the audio send thread.
+ *
+ * @var AudioLatencyStats::dsp
+ * @brief Echo cancellation and audio processing time per frame.
+ *
+ * @var AudioLatencyStats::send
+ * @brief Time toxav_audio_send_frame takes, including retries.
+ *
+ * @var AudioLatencyStats::receive
+ * @brief Time from the toxav audio callback until the frame is queued for playback.
+ *
+ * @var AudioLatencyStats::playout
+ * @brief Audio queued for playback after a received frame was added.
+ */
+
+constexpr int LatencyHistogram::BUCKET_COUNT;
+constexpr uint32_t LatencyHistogram::WINDOW_SAMPLES;
+const std::array<qreal, LatencyHistogram::BUCKET_COUNT - 1> LatencyHistogram::BUCKET_LIMITS_MS{
+    {1, 2, 5, 10, 20, 40, 80, 160, 320}};
+
+void LatencyHistogram::add(qreal ms)
+{
+    const auto it = std::lower_bound(BUCKET_LIMITS_MS.begin(), BUCKET_LIMITS_MS.end(), ms);
+    const size_t bucket = static_cast<size_t>(it - BUCKET_LIMITS_MS.begin());
+
+    QMutexLocker locker{&mutex};
+    if (current.count >= WINDOW_SAMPLES) {
+        previous = current;
+        current = Window{};
+    }
+
+    ++current.buckets[bucket];
+    ++current.count;
+    current.maxMs = std::max(current.maxMs, ms);
+}
+
+void LatencyHistogram::reset()
+{
+    QMutexLocker locker{&mutex};
+    current = Window{};
+    previous = Window{};
+}
+
+uint32_t LatencyHistogram::getCount() const
+{
+    QMutexLocker locker{&mutex};
+    return countLocked();
+}
+
+/**
+ * @brief Upper bound of the latency that a fraction of the samples stays below.
+ * @param fraction Between 0 and 1, e.g. 0.95 for the 95th percentile.
+ * @return Bucket limit in milliseconds, the maximum for the last bucket or -1 without samples.
+ */
+qreal LatencyHistogram::percentile(qreal fraction) const
+{
+    QMutexLocker locker{&mutex};
+    return percentileLocked(fraction);
+}
+
+qreal LatencyHistogram::getMax() const
+{
+    QMutexLocker locker{&mutex};
+    return maxLocked();
+}
+
+/**
+ * @brief Short summary for the settings and the log, e.g. "p50 <20 ms, p95 <40 ms, max 31 ms".
+ */
+QString LatencyHistogram::toString() const
+{
+    QMutexLocker locker{&mutex};
+    if (countLocked() == 0) {
+        return QStringLiteral("-");
+    }
+
+    return QStringLiteral("p50 <%1 ms, p95 <%2 ms, max %3 ms")
+        .arg(percentileLocked(0.5))
+        .arg(percentileLocked(0.95))
+        .arg(qRound(maxLocked()));
+}
+
+/**
+ * @brief Statistics for the diagnostics report.
+ * @return Sample count, percentiles and max in ms, and the count of every bucket.
+ */
+QJsonObject LatencyHistogram::toJson() const
+{
+    QMutexLocker locker{&mutex};
+    QJsonArray buckets;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        const size_t bucket = static_cast<size_t>(i);
+        buckets.append(static_cast<qint64>(current.buckets[bucket] + previous.buckets[bucket]));
+    }
+
+    return QJsonObject{{"count", static_cast<qint64>(countLocked())},
+                       {"p50Ms", percentileLocked(0.5)},
+                       {"p95Ms", percentileLocked(0.95)},
+                       {"p99Ms", percentileLocked(0.99)},
+                       {"maxMs", maxLocked()},
+                       {"buckets", buckets}};
+}
+
+uint32_t LatencyHistogram::countLocked() const
+{
+    return current.count + previous.count;
+}
+
+qreal LatencyHistogram::percentileLocked(qreal fraction) const
+{
+    const uint32_t total = countLocked();
+    if (total == 0) {
+        return -1;
+    }
+
+    const uint32_t rank = std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil(fraction * total)));
+    uint32_t seen = 0;
+    for (size_t i = 0; i < BUCKET_LIMITS_MS.size(); ++i) {
+        seen += current.buckets[i] + previous.buckets[i];
+        if (seen >= rank) {
+            return BUCKET_LIMITS_MS[i];
+        }
+    }
+
+    return maxLocked();
+}
+
+qreal LatencyHistogram::maxLocked() const
+{
+    return std::max(current.maxMs, previous.maxMs);
+}
+
+/**
+ * @brief One line per stage, empty stages are shown as "-".
+ */
+QString AudioLatencyStats::toString() const
+{
+    QStringList lines;
+    lines << QStringLiteral("capture: ") + capture.toString()
+          << QStringLiteral("send queue: ") + queue.toString()
+          << QStringLiteral("processing: ") + dsp.toString()
+          << QStringLiteral("send: ") + send.toString()
+          << QStringLiteral("receive: ") + receive.toString()
+          << QStringLiteral("playout queue: ") + playout.toString();
+    return lines.join(QLatin1Char('\n'));
+}
+
+QJsonObject AudioLatencyStats::toJson() const
+{
+    return QJsonObject{{"capture", capture.toJson()}, {"sendQueue", queue.toJson()},
+                       {"processing", dsp.toJson()},  {"send", send.toJson()},
+                       {"receive", receive.toJson()}, {"playoutQueue", playout.toJson()}};
+}
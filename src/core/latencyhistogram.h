@@ -0,0 +1,76 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+#include <array>
+#include <cstdint>
+
+class LatencyHistogram
+{
+public:
+    static constexpr int BUCKET_COUNT = 10;
+    static constexpr uint32_t WINDOW_SAMPLES = 500;
+    static const std::array<qreal, BUCKET_COUNT - 1> BUCKET_LIMITS_MS;
+
+    void add(qreal ms);
+    void reset();
+
+    uint32_t getCount() const;
+    qreal percentile(qreal fraction) const;
+    qreal getMax() const;
+    QString toString() const;
+    QJsonObject toJson() const;
+
+private:
+    struct Window
+    {
+        std::array<uint32_t, BUCKET_COUNT> buckets{};
+        uint32_t count = 0;
+        qreal maxMs = 0;
+    };
+
+    uint32_t countLocked() const;
+    qreal percentileLocked(qreal fraction) const;
+    qreal maxLocked() const;
+
+private:
+    mutable QMutex mutex;
+    Window current;
+    Window previous;
+};
+
+struct AudioLatencyStats
+{
+    LatencyHistogram capture;
+    LatencyHistogram queue;
+    LatencyHistogram dsp;
+    LatencyHistogram send;
+    LatencyHistogram receive;
+    LatencyHistogram playout;
+
+    QString toString() const;
+    QJsonObject toJson() const;
+};
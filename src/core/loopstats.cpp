@@ -0,0 +1,249 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "loopstats.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <algorithm>
+
+/**
+ * @class LoopStats
+ * @brief Always-on timing of a timer driven main loop, such as the one calling tox_iterate.
+ *
+ * Each iteration is split into named stages. The stage durations, the iteration duration and
+ * how late the loop timer fired compared to the interval it was started with are collected in
+ * LatencyHistograms. An iteration taking longer than the stall threshold is logged with the
+ * stage it spent most time in, at most once per STALL_LOG_INTERVAL_MS.
+ *
+ * Every instance is listed by report(), which also tells which stage a loop is in right now,
+ * so a loop that hangs can be told apart from one that is just slow. The same data is part of
+ * the "loops" section of the diagnostics report.
+ *
+ * @note Only timerStarted(), beginIteration(), beginStage() and endIteration() have to be
+ * called from the loop's thread, toString() and report() can be called from any thread.
+ */
+
+/**
+ * @var LoopStats::STALL_LOG_INTERVAL_MS
+ * @brief Minimum time between two stall warnings of the same loop.
+ */
+constexpr qint64 LoopStats::STALL_LOG_INTERVAL_MS;
+
+namespace {
+QMutex& registryLock()
+{
+    static QMutex lock;
+    return lock;
+}
+
+std::vector<const LoopStats*>& registry()
+{
+    static std::vector<const LoopStats*> loops;
+    return loops;
+}
+} // namespace
+
+/**
+ * @param name Shown in the report and the log, e.g. "Core".
+ * @param stallThresholdMs Iterations taking longer are logged.
+ */
+LoopStats::LoopStats(const QString& name_, qint64 stallThresholdMs_)
+    : name{name_}
+    , stallThresholdMs{stallThresholdMs_}
+{
+    clock.start();
+    QMutexLocker locker{&registryLock()};
+    registry().push_back(this);
+}
+
+LoopStats::~LoopStats()
+{
+    QMutexLocker locker{&registryLock()};
+    auto& loops = registry();
+    loops.erase(std::remove(loops.begin(), loops.end(), this), loops.end());
+}
+
+/**
+ * @brief Call when starting the loop timer, so the next iteration knows when it was due.
+ * @param intervalMs Interval the timer was started with.
+ */
+void LoopStats::timerStarted(qint64 intervalMs)
+{
+    expectedNs = clock.nsecsElapsed() + intervalMs * 1000000;
+}
+
+/**
+ * @brief Call first thing in an iteration.
+ */
+void LoopStats::beginIteration()
+{
+    const qint64 nowNs = clock.nsecsElapsed();
+    if (expectedNs >= 0) {
+        lateness.add(std::max<qint64>(0, nowNs - expectedNs) / 1000000.0);
+        expectedNs = -1;
+    }
+
+    iterationStartNs = nowNs;
+    slowestStage = nullptr;
+    slowestStageNs = 0;
+    runningSinceNs = nowNs;
+    runningStage = nullptr;
+}
+
+/**
+ * @brief Ends the running stage and starts the next one.
+ * @param stage Name of the stage, must be a string literal, e.g. "tox_iterate".
+ */
+void LoopStats::beginStage(const char* stage)
+{
+    const qint64 nowNs = clock.nsecsElapsed();
+    endStage(nowNs);
+    runningSinceNs = nowNs;
+    runningStage = stage;
+}
+
+/**
+ * @brief Call last thing in an iteration, logs the iteration if it was a stall.
+ */
+void LoopStats::endIteration()
+{
+    const qint64 nowNs = clock.nsecsElapsed();
+    endStage(nowNs);
+    runningStage = nullptr;
+
+    const qreal durationMs = (nowNs - iterationStartNs) / 1000000.0;
+    iteration.add(durationMs);
+    if (durationMs <= stallThresholdMs) {
+        return;
+    }
+
+    ++stalls;
+    ++unloggedStalls;
+    const qint64 nowMs = nowNs / 1000000;
+    if (nowMs - lastStallLogMs < STALL_LOG_INTERVAL_MS) {
+        return;
+    }
+
+    qWarning().nospace().noquote()
+        << name << " loop iteration took " << qRound(durationMs) << " ms, "
+        << (slowestStage ? slowestStage : "no stage") << " took "
+        << qRound(slowestStageNs / 1000000.0) << " ms (" << unloggedStalls
+        << " stalls since the last warning)";
+    lastStallLogMs = nowMs;
+    unloggedStalls = 0;
+}
+
+void LoopStats::endStage(qint64 nowNs)
+{
+    const char* stage = runningStage;
+    if (!stage) {
+        return;
+    }
+
+    const qint64 durationNs = nowNs - runningSinceNs;
+    if (durationNs > slowestStageNs) {
+        slowestStage = stage;
+        slowestStageNs = durationNs;
+    }
+
+    // stages are string literals, comparing the pointers is enough
+    auto it = std::find_if(stages.begin(), stages.end(),
+                           [stage](const std::unique_ptr<Stage>& s) { return s->name == stage; });
+    if (it == stages.end()) {
+        QMutexLocker locker{&stagesLock};
+        it = stages.insert(stages.end(), std::unique_ptr<Stage>(new Stage(stage)));
+    }
+
+    (*it)->duration.add(durationNs / 1000000.0);
+}
+
+/**
+ * @brief Summary of this loop, one line per histogram.
+ */
+QString LoopStats::toString() const
+{
+    QStringList lines;
+    lines << QStringLiteral("%1 loop, %2 stalls over %3 ms")
+                 .arg(name)
+                 .arg(stalls.load())
+                 .arg(stallThresholdMs);
+
+    const char* stage = runningStage;
+    if (stage) {
+        lines << QStringLiteral("  running %1 for %2 ms")
+                     .arg(QString::fromLatin1(stage))
+                     .arg((clock.nsecsElapsed() - runningSinceNs) / 1000000);
+    }
+
+    lines << QStringLiteral("  iteration: ") + iteration.toString()
+          << QStringLiteral("  timer lateness: ") + lateness.toString();
+
+    QMutexLocker locker{&stagesLock};
+    for (const auto& s : stages) {
+        lines << QStringLiteral("  %1: %2").arg(QString::fromLatin1(s->name), s->duration.toString());
+    }
+
+    return lines.join(QLatin1Char('\n'));
+}
+
+/**
+ * @brief All histograms of this loop, for the diagnostics report.
+ */
+QJsonObject LoopStats::toJson() const
+{
+    QJsonObject json{{"name", name},
+                     {"stallThresholdMs", stallThresholdMs},
+                     {"stalls", static_cast<qint64>(stalls.load())},
+                     {"iteration", iteration.toJson()},
+                     {"timerLateness", lateness.toJson()}};
+
+    const char* stage = runningStage;
+    if (stage) {
+        json["runningStage"] = QString::fromLatin1(stage);
+        json["runningMs"] = (clock.nsecsElapsed() - runningSinceNs) / 1000000;
+    }
+
+    QJsonArray stageStats;
+    QMutexLocker locker{&stagesLock};
+    for (const auto& s : stages) {
+        stageStats.append(QJsonObject{{"name", QString::fromLatin1(s->name)},
+                                      {"duration", s->duration.toJson()}});
+    }
+    json["stages"] = stageStats;
+    return json;
+}
+
+/**
+ * @brief Summary of all loops, for the debug log and the advanced settings.
+ * @return One block per loop, empty if there is none.
+ */
+QString LoopStats::report()
+{
+    QMutexLocker locker{&registryLock()};
+    QStringList report;
+    for (const LoopStats* loop : registry()) {
+        report << loop->toString();
+    }
+
+    return report.join(QStringLiteral("\n\n"));
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "latencyhistogram.h"
+
+#include "util/diagnosticsregistry.h"
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class LoopStats
+{
+public:
+    LoopStats(const QString& name, qint64 stallThresholdMs);
+    ~LoopStats();
+
+    LoopStats(const LoopStats&) = delete;
+    LoopStats& operator=(const LoopStats&) = delete;
+
+    void timerStarted(qint64 intervalMs);
+    void beginIteration();
+    void beginStage(const char* stage);
+    void endIteration();
+
+    QString toString() const;
+    QJsonObject toJson() const;
+    static QString report();
+
+    static constexpr qint64 STALL_LOG_INTERVAL_MS = 10000;
+
+private:
+    struct Stage
+    {
+        explicit Stage(const char* name_)
+            : name{name_}
+        {}
+
+        const char* name;
+        LatencyHistogram duration;
+    };
+
+    void endStage(qint64 nowNs);
+
+private:
+    const QString name;
+    const qint64 stallThresholdMs;
+    QElapsedTimer clock;
+
+    LatencyHistogram iteration;
+    LatencyHistogram lateness;
+    std::atomic<uint32_t> stalls{0};
+
+    // read by report() from other threads
+    std::atomic<const char*> runningStage{nullptr};
+    std::atomic<qint64> runningSinceNs{0};
+
+    // only grows on the loop thread, under stagesLock so report() can read it meanwhile
+    mutable QMutex stagesLock;
+    std::vector<std::unique_ptr<Stage>> stages;
+
+    // only used on the thread running the loop
+    qint64 expectedNs = -1;
+    qint64 iterationStartNs = 0;
+    const char* slowestStage = nullptr;
+    qint64 slowestStageNs = 0;
+    qint64 lastStallLogMs = -STALL_LOG_INTERVAL_MS;
+    uint32_t unloggedStalls = 0;
+
+    // last, so it unregisters before the stats it reads are destroyed
+    DiagnosticsSource diagnostics{"loops", [this] { return toJson(); }};
+};
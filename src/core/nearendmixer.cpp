@@ -0,0 +1,139 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "nearendmixer.h"
+
+#include "webrtc6/webrtc/common_audio/channel_buffer.h"
+#include "webrtc6/webrtc/common_audio/include/audio_util.h"
+#include "webrtc6/webrtc/modules/audio_processing/beamformer/nonlinear_beamformer.h"
+
+#include <QDebug>
+
+#include <vector>
+
+/**
+ * @class NearEndMixer
+ * @brief Turns a captured frame with several channels into the mono frame a call sends.
+ *
+ * CallAudioDsp and the voice encoder settings expect mono audio, sending a stereo microphone
+ * as is would skip echo cancellation and double the bitrate for no gain. By default the
+ * channels are averaged. For a microphone array, NonlinearBeamformer points a beam straight
+ * ahead of a pair of microphones MIC_SPACING_M apart, like most laptop and webcam arrays,
+ * and attenuates sound coming from the sides.
+ *
+ * The beamformer works on 10ms chunks, frames that aren't a multiple of that or don't have
+ * BEAMFORMER_CHANNELS channels are downmixed instead.
+ *
+ * @note process() must always be called from the same thread, the audio send thread.
+ */
+
+constexpr uint32_t NearEndMixer::SAMPLE_RATE;
+constexpr size_t NearEndMixer::MAX_CHANNELS;
+constexpr size_t NearEndMixer::MAX_FRAME_SAMPLES;
+constexpr size_t NearEndMixer::CHUNK_SAMPLES;
+constexpr size_t NearEndMixer::BEAMFORMER_CHANNELS;
+constexpr float NearEndMixer::MIC_SPACING_M;
+
+NearEndMixer::NearEndMixer() = default;
+
+NearEndMixer::~NearEndMixer() = default;
+
+/**
+ * @brief Switches between averaging the channels and beamforming.
+ *
+ * The beamformer is only allocated the first time it's enabled, a call that never uses it
+ * doesn't pay for its covariance matrices.
+ * @param enabled True to beamform stereo frames.
+ */
+void NearEndMixer::setBeamforming(bool enabled)
+{
+    if (enabled == beamforming) {
+        return;
+    }
+
+    beamforming = enabled;
+    if (!beamforming || beamformer) {
+        return;
+    }
+
+    const std::vector<webrtc::Point> geometry{webrtc::Point(-MIC_SPACING_M / 2, 0.f, 0.f),
+                                              webrtc::Point(MIC_SPACING_M / 2, 0.f, 0.f)};
+    beamformer.reset(new webrtc::NonlinearBeamformer(geometry));
+    beamformer->Initialize(CHUNK_SAMPLES * 1000 / SAMPLE_RATE, SAMPLE_RATE);
+    chunkIn.reset(new webrtc::ChannelBuffer<float>(CHUNK_SAMPLES, BEAMFORMER_CHANNELS));
+    chunkOut.reset(new webrtc::ChannelBuffer<float>(CHUNK_SAMPLES, 1));
+    qDebug() << "Beamforming the microphone array";
+}
+
+/**
+ * @brief Mixes a captured frame down to mono.
+ * @param pcm Interleaved 48kHz samples.
+ * @param samples Number of samples per channel in pcm.
+ * @param chans Number of channels in pcm.
+ * @return Pointer to samples mono samples, valid until the next call. pcm itself for mono
+ * frames and frames that are too big.
+ */
+const int16_t* NearEndMixer::process(const int16_t* pcm, size_t samples, uint8_t chans)
+{
+    if (chans <= 1 || chans > MAX_CHANNELS || samples > MAX_FRAME_SAMPLES) {
+        return pcm;
+    }
+
+    if (beamforming && chans == BEAMFORMER_CHANNELS && samples % CHUNK_SAMPLES == 0) {
+        beamform(pcm, samples);
+    } else {
+        downmix(pcm, samples, chans);
+    }
+
+    return mono.data();
+}
+
+void NearEndMixer::downmix(const int16_t* pcm, size_t samples, uint8_t chans)
+{
+    for (size_t i = 0; i < samples; ++i) {
+        int32_t sum = 0;
+        for (uint8_t c = 0; c < chans; ++c) {
+            sum += pcm[i * chans + c];
+        }
+        mono[i] = static_cast<int16_t>(sum / chans);
+    }
+}
+
+void NearEndMixer::beamform(const int16_t* pcm, size_t samples)
+{
+    float* const* in = chunkIn->channels();
+    const float* out = chunkOut->channels()[0];
+    // the beam sums the aligned channels, scale back to the level of a single microphone
+    const float scale = 1.f / BEAMFORMER_CHANNELS;
+
+    for (size_t offset = 0; offset < samples; offset += CHUNK_SAMPLES) {
+        for (size_t i = 0; i < CHUNK_SAMPLES; ++i) {
+            for (size_t c = 0; c < BEAMFORMER_CHANNELS; ++c) {
+                in[c][i] = pcm[(offset + i) * BEAMFORMER_CHANNELS + c];
+            }
+        }
+
+        beamformer->ProcessChunk(*chunkIn, chunkOut.get());
+
+        for (size_t i = 0; i < CHUNK_SAMPLES; ++i) {
+            mono[offset + i] = webrtc::FloatS16ToS16(out[i] * scale);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace webrtc {
+template <typename T>
+class ChannelBuffer;
+class NonlinearBeamformer;
+}
+
+class NearEndMixer
+{
+public:
+    NearEndMixer();
+    ~NearEndMixer();
+
+    NearEndMixer(const NearEndMixer&) = delete;
+    NearEndMixer& operator=(const NearEndMixer&) = delete;
+    NearEndMixer(NearEndMixer&&) = delete;
+    NearEndMixer& operator=(NearEndMixer&&) = delete;
+
+    void setBeamforming(bool enabled);
+    const int16_t* process(const int16_t* pcm, size_t samples, uint8_t chans);
+
+    static constexpr uint32_t SAMPLE_RATE = 48000;
+    static constexpr size_t MAX_CHANNELS = 8;
+    static constexpr size_t MAX_FRAME_SAMPLES = SAMPLE_RATE * 60 / 1000;
+    static constexpr size_t CHUNK_SAMPLES = SAMPLE_RATE / 100;
+    static constexpr size_t BEAMFORMER_CHANNELS = 2;
+    static constexpr float MIC_SPACING_M = 0.05f;
+
+private:
+    void downmix(const int16_t* pcm, size_t samples, uint8_t chans);
+    void beamform(const int16_t* pcm, size_t samples);
+
+private:
+    bool beamforming = false;
+    std::unique_ptr<webrtc::NonlinearBeamformer> beamformer;
+    std::unique_ptr<webrtc::ChannelBuffer<float>> chunkIn;
+    std::unique_ptr<webrtc::ChannelBuffer<float>> chunkOut;
+    std::array<int16_t, MAX_FRAME_SAMPLES> mono;
+};
@@ -0,0 +1,406 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ngcfiletransfer.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <algorithm>
+
+/**
+ * @class NgcFileTransfer
+ * @brief Chunked transfer of files too large for a single NGC group custom packet.
+ *
+ * The sender only broadcasts a FileAnnounce packet with the SHA256 of the file, which is also the
+ * file id, and its size. Every interested peer then pulls the file: it asks the sender for up to
+ * WINDOW_CHUNKS chunks at a time with private ChunkRequest packets, and requests more once half
+ * of them arrived, so each receiver controls its own rate and the sender only has to answer.
+ *
+ * Chunks may arrive in any order and are copied into a buffer allocated at the announce. If no
+ * chunk arrives for STALL_TIMEOUT_MS, the missing chunks are requested again, which also resumes
+ * a transfer after the sender reconnected or announced the file again. Completed files are only
+ * handed out if their hash matches the file id.
+ *
+ * Packet layouts, after the common 8 byte header:
+ *  - FileAnnounce: file id (32 bytes), file size (4 bytes)
+ *  - ChunkRequest: file id (32 bytes), count (1 byte), chunk indices (4 bytes each)
+ *  - Chunk: file id (32 bytes), chunk index (4 bytes), data
+ *
+ * All integers are big endian. All methods are thread safe.
+ */
+
+constexpr int NgcFileTransfer::HEADER_SIZE;
+constexpr int NgcFileTransfer::FILE_ID_SIZE;
+constexpr int NgcFileTransfer::CHUNK_SIZE;
+constexpr int NgcFileTransfer::WINDOW_CHUNKS;
+constexpr uint32_t NgcFileTransfer::MAX_FILE_SIZE;
+constexpr qint64 NgcFileTransfer::MAX_INCOMING_BYTES;
+constexpr int NgcFileTransfer::MAX_TRANSFERS_PER_PEER;
+constexpr int NgcFileTransfer::MAX_OFFERED_FILES;
+constexpr qint64 NgcFileTransfer::STALL_TIMEOUT_MS;
+constexpr int NgcFileTransfer::MAX_RETRIES;
+
+namespace {
+const char packetMagic[] = {0x66, 0x77, static_cast<char>(0x88), 0x11, 0x34, 0x35};
+constexpr char packetVersion = 0x1;
+constexpr int announceSize = NgcFileTransfer::HEADER_SIZE + NgcFileTransfer::FILE_ID_SIZE + 4;
+constexpr int requestHeaderSize = NgcFileTransfer::HEADER_SIZE + NgcFileTransfer::FILE_ID_SIZE + 1;
+constexpr int chunkHeaderSize = NgcFileTransfer::HEADER_SIZE + NgcFileTransfer::FILE_ID_SIZE + 4;
+
+void appendUInt32(QByteArray& packet, uint32_t value)
+{
+    uchar buf[4];
+    qToBigEndian(value, buf);
+    packet.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+uint32_t readUInt32(const QByteArray& packet, int offset)
+{
+    return qFromBigEndian<uint32_t>(reinterpret_cast<const uchar*>(packet.constData() + offset));
+}
+
+QByteArray readFileId(const QByteArray& packet)
+{
+    return packet.mid(NgcFileTransfer::HEADER_SIZE, NgcFileTransfer::FILE_ID_SIZE);
+}
+
+int chunkCount(qint64 fileSize)
+{
+    return static_cast<int>((fileSize + NgcFileTransfer::CHUNK_SIZE - 1) / NgcFileTransfer::CHUNK_SIZE);
+}
+
+int chunkSize(qint64 fileSize, int index)
+{
+    return static_cast<int>(
+        std::min<qint64>(NgcFileTransfer::CHUNK_SIZE,
+                         fileSize - static_cast<qint64>(index) * NgcFileTransfer::CHUNK_SIZE));
+}
+} // namespace
+
+/**
+ * @brief Checks the common header of NGC custom packets.
+ * @param packet Group custom packet.
+ * @return The packet type byte, or -1 if the packet has no valid header.
+ */
+int NgcFileTransfer::packetType(const QByteArray& packet)
+{
+    if (packet.size() < HEADER_SIZE
+        || !packet.startsWith(QByteArray::fromRawData(packetMagic, sizeof(packetMagic)))
+        || packet[6] != packetVersion) {
+        return -1;
+    }
+
+    return static_cast<uint8_t>(packet[7]);
+}
+
+QByteArray NgcFileTransfer::packetHeader(PacketType type)
+{
+    QByteArray header(packetMagic, sizeof(packetMagic));
+    header.append(packetVersion);
+    header.append(static_cast<char>(type));
+    return header;
+}
+
+/**
+ * @brief Makes a file available to the peers of a group.
+ * @param file Content of the file, at most MAX_FILE_SIZE bytes.
+ * @return FileAnnounce packet to broadcast to the group, empty if the file can't be sent.
+ *
+ * Only the last MAX_OFFERED_FILES files are kept for peers to request.
+ */
+QByteArray NgcFileTransfer::offerFile(const QByteArray& file)
+{
+    if (file.isEmpty() || static_cast<uint32_t>(file.size()) > MAX_FILE_SIZE) {
+        qWarning() << "Can't offer group file of" << file.size() << "bytes";
+        return {};
+    }
+
+    const QByteArray fileId = QCryptographicHash::hash(file, QCryptographicHash::Sha256);
+
+    QMutexLocker locker{&mutex};
+    auto it = std::remove_if(offered.begin(), offered.end(),
+                             [&fileId](const Offered& o) { return o.fileId == fileId; });
+    offered.erase(it, offered.end());
+    if (offered.size() >= MAX_OFFERED_FILES) {
+        offered.removeFirst();
+    }
+    offered.append({fileId, file});
+
+    QByteArray packet = packetHeader(PacketType::FileAnnounce);
+    packet.append(fileId);
+    appendUInt32(packet, static_cast<uint32_t>(file.size()));
+    return packet;
+}
+
+/**
+ * @brief Answers a ChunkRequest of a peer for one of our offered files.
+ * @param packet ChunkRequest packet.
+ * @return Chunk packets to send to the peer, empty if the file isn't offered anymore.
+ */
+QVector<QByteArray> NgcFileTransfer::handleRequest(const QByteArray& packet) const
+{
+    if (packet.size() < requestHeaderSize) {
+        return {};
+    }
+
+    const int count = std::min(static_cast<int>(static_cast<uint8_t>(packet[requestHeaderSize - 1])),
+                               WINDOW_CHUNKS);
+    if (packet.size() < requestHeaderSize + count * 4) {
+        return {};
+    }
+
+    const QByteArray fileId = readFileId(packet);
+
+    QMutexLocker locker{&mutex};
+    auto it = std::find_if(offered.begin(), offered.end(),
+                           [&fileId](const Offered& o) { return o.fileId == fileId; });
+    if (it == offered.end()) {
+        return {};
+    }
+
+    const int chunks = chunkCount(it->data.size());
+    QVector<QByteArray> replies;
+    for (int i = 0; i < count; ++i) {
+        const uint32_t index = readUInt32(packet, requestHeaderSize + i * 4);
+        if (index >= static_cast<uint32_t>(chunks)) {
+            continue;
+        }
+
+        const int offset = static_cast<int>(index) * CHUNK_SIZE;
+        QByteArray chunk = packetHeader(PacketType::Chunk);
+        chunk.reserve(chunkHeaderSize + CHUNK_SIZE);
+        chunk.append(fileId);
+        appendUInt32(chunk, index);
+        chunk.append(it->data.constData() + offset, chunkSize(it->data.size(), index));
+        replies.append(chunk);
+    }
+
+    return replies;
+}
+
+/**
+ * @brief Starts or resumes receiving an announced file.
+ * @param groupnumber Group the announce came from.
+ * @param peerId Current peer id of the sender.
+ * @param author Public key of the sender.
+ * @param packet FileAnnounce packet.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @return ChunkRequest packet to send privately to the sender, empty if the file is rejected.
+ */
+QByteArray NgcFileTransfer::handleAnnounce(int groupnumber, uint32_t peerId, const ToxPk& author,
+                                           const QByteArray& packet, qint64 nowMs)
+{
+    if (packet.size() < announceSize) {
+        return {};
+    }
+
+    const QByteArray fileId = readFileId(packet);
+    const uint32_t fileSize = readUInt32(packet, HEADER_SIZE + FILE_ID_SIZE);
+    const QByteArray key = transferKey(groupnumber, author, fileId);
+
+    QMutexLocker locker{&mutex};
+    auto it = incoming.find(key);
+    if (it != incoming.end()) {
+        // announced again, e.g. after the sender reconnected with a new peer id
+        it->peerId = peerId;
+        it->lastActivityMs = nowMs;
+        it->retries = 0;
+        restartRequests(*it);
+        return nextRequest(*it);
+    }
+
+    if (fileSize == 0 || fileSize > MAX_FILE_SIZE) {
+        qWarning() << "Ignoring group file of" << fileSize << "bytes";
+        return {};
+    }
+
+    const int peerTransfers = static_cast<int>(
+        std::count_if(incoming.cbegin(), incoming.cend(),
+                      [&author](const Incoming& i) { return i.author == author; }));
+    if (peerTransfers >= MAX_TRANSFERS_PER_PEER || incomingBytes + fileSize > MAX_INCOMING_BYTES) {
+        qWarning() << "Ignoring group file, too many transfers in progress";
+        return {};
+    }
+
+    Incoming transfer;
+    transfer.groupnumber = groupnumber;
+    transfer.peerId = peerId;
+    transfer.author = author;
+    transfer.fileId = fileId;
+    transfer.data = QByteArray(static_cast<int>(fileSize), Qt::Uninitialized);
+    transfer.received = QBitArray(chunkCount(fileSize));
+    transfer.requested = QBitArray(chunkCount(fileSize));
+    transfer.lastActivityMs = nowMs;
+    incomingBytes += fileSize;
+
+    return nextRequest(*incoming.insert(key, transfer));
+}
+
+/**
+ * @brief Stores a received chunk.
+ * @param groupnumber Group the chunk came from.
+ * @param peerId Peer that sent the chunk.
+ * @param author Public key of the peer.
+ * @param packet Chunk packet.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @param request Set to a ChunkRequest packet to send to the peer, if more chunks are needed.
+ * @param file Set to the complete file.
+ * @return True if the file is complete and its hash matched.
+ */
+bool NgcFileTransfer::handleChunk(int groupnumber, uint32_t peerId, const ToxPk& author,
+                                  const QByteArray& packet, qint64 nowMs, QByteArray& request,
+                                  QByteArray& file)
+{
+    if (packet.size() <= chunkHeaderSize) {
+        return false;
+    }
+
+    const QByteArray fileId = readFileId(packet);
+    const uint32_t index = readUInt32(packet, HEADER_SIZE + FILE_ID_SIZE);
+
+    QMutexLocker locker{&mutex};
+    auto it = incoming.find(transferKey(groupnumber, author, fileId));
+    if (it == incoming.end() || index >= static_cast<uint32_t>(it->received.size())) {
+        return false;
+    }
+
+    Incoming& transfer = *it;
+    transfer.peerId = peerId;
+    transfer.lastActivityMs = nowMs;
+    transfer.retries = 0;
+
+    const int i = static_cast<int>(index);
+    const int size = packet.size() - chunkHeaderSize;
+    if (transfer.received.testBit(i) || size != chunkSize(transfer.data.size(), i)) {
+        return false;
+    }
+
+    std::copy(packet.constBegin() + chunkHeaderSize, packet.constEnd(),
+              transfer.data.begin() + i * CHUNK_SIZE);
+    transfer.received.setBit(i);
+    ++transfer.receivedCount;
+    if (transfer.requested.testBit(i)) {
+        --transfer.outstanding;
+    } else {
+        transfer.requested.setBit(i);
+    }
+
+    if (transfer.receivedCount < transfer.received.size()) {
+        if (transfer.outstanding <= WINDOW_CHUNKS / 2) {
+            request = nextRequest(transfer);
+        }
+        return false;
+    }
+
+    const QByteArray data = transfer.data;
+    incomingBytes -= data.size();
+    incoming.erase(it);
+
+    if (QCryptographicHash::hash(data, QCryptographicHash::Sha256) != fileId) {
+        qWarning() << "Discarding group file, hash doesn't match";
+        return false;
+    }
+
+    file = data;
+    return true;
+}
+
+/**
+ * @brief Requests the missing chunks of stalled transfers again.
+ * @param nowMs Monotonic timestamp in milliseconds.
+ * @return ChunkRequest packets to send, transfers stalled MAX_RETRIES times are dropped.
+ */
+QVector<NgcFileTransfer::Request> NgcFileTransfer::expire(qint64 nowMs)
+{
+    QVector<Request> requests;
+
+    QMutexLocker locker{&mutex};
+    for (auto it = incoming.begin(); it != incoming.end();) {
+        if (nowMs - it->lastActivityMs < STALL_TIMEOUT_MS) {
+            ++it;
+            continue;
+        }
+
+        if (++it->retries > MAX_RETRIES) {
+            qDebug() << "Giving up on group file after" << it->receivedCount << "of"
+                     << it->received.size() << "chunks";
+            incomingBytes -= it->data.size();
+            it = incoming.erase(it);
+            continue;
+        }
+
+        it->lastActivityMs = nowMs;
+        restartRequests(*it);
+        requests.append({it->groupnumber, it->peerId, nextRequest(*it)});
+        ++it;
+    }
+
+    return requests;
+}
+
+int NgcFileTransfer::getIncomingCount() const
+{
+    QMutexLocker locker{&mutex};
+    return incoming.size();
+}
+
+QByteArray NgcFileTransfer::transferKey(int groupnumber, const ToxPk& author,
+                                        const QByteArray& fileId)
+{
+    QByteArray key;
+    appendUInt32(key, static_cast<uint32_t>(groupnumber));
+    key.append(author.getByteArray());
+    key.append(fileId);
+    return key;
+}
+
+QByteArray NgcFileTransfer::nextRequest(Incoming& transfer)
+{
+    QVector<uint32_t> indices;
+    for (int i = 0; i < transfer.requested.size() && transfer.outstanding < WINDOW_CHUNKS; ++i) {
+        if (!transfer.requested.testBit(i)) {
+            transfer.requested.setBit(i);
+            ++transfer.outstanding;
+            indices.append(static_cast<uint32_t>(i));
+        }
+    }
+
+    if (indices.isEmpty()) {
+        return {};
+    }
+
+    QByteArray packet = packetHeader(PacketType::ChunkRequest);
+    packet.append(transfer.fileId);
+    packet.append(static_cast<char>(indices.size()));
+    for (uint32_t index : indices) {
+        appendUInt32(packet, index);
+    }
+    return packet;
+}
+
+void NgcFileTransfer::restartRequests(Incoming& transfer)
+{
+    // forget what we asked for, whatever didn't arrive so far is requested again
+    transfer.requested = transfer.received;
+    transfer.outstanding = 0;
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QtGlobal>
+
+#include <cstdint>
+
+class NgcFileTransfer
+{
+public:
+    enum class PacketType : uint8_t
+    {
+        GroupFile = 0x11,
+        FileAnnounce = 0x12,
+        ChunkRequest = 0x13,
+        Chunk = 0x14
+    };
+
+    struct Request
+    {
+        int groupnumber;
+        uint32_t peerId;
+        QByteArray packet;
+    };
+
+    static int packetType(const QByteArray& packet);
+    static QByteArray packetHeader(PacketType type);
+
+    QByteArray offerFile(const QByteArray& file);
+    QVector<QByteArray> handleRequest(const QByteArray& packet) const;
+
+    QByteArray handleAnnounce(int groupnumber, uint32_t peerId, const ToxPk& author,
+                              const QByteArray& packet, qint64 nowMs);
+    bool handleChunk(int groupnumber, uint32_t peerId, const ToxPk& author,
+                     const QByteArray& packet, qint64 nowMs, QByteArray& request,
+                     QByteArray& file);
+    QVector<Request> expire(qint64 nowMs);
+
+    int getIncomingCount() const;
+
+    static constexpr int HEADER_SIZE = 6 + 1 + 1;
+    static constexpr int FILE_ID_SIZE = 32;
+    static constexpr int CHUNK_SIZE = 32000;
+    static constexpr int WINDOW_CHUNKS = 4;
+    static constexpr uint32_t MAX_FILE_SIZE = 16 * 1024 * 1024;
+    static constexpr qint64 MAX_INCOMING_BYTES = 64 * 1024 * 1024;
+    static constexpr int MAX_TRANSFERS_PER_PEER = 2;
+    static constexpr int MAX_OFFERED_FILES = 4;
+    static constexpr qint64 STALL_TIMEOUT_MS = 10000;
+    static constexpr int MAX_RETRIES = 6;
+
+private:
+    struct Incoming
+    {
+        int groupnumber;
+        uint32_t peerId;
+        ToxPk author;
+        QByteArray fileId;
+        QByteArray data;
+        QBitArray received;
+        QBitArray requested;
+        int receivedCount = 0;
+        int outstanding = 0;
+        int retries = 0;
+        qint64 lastActivityMs = 0;
+    };
+
+    struct Offered
+    {
+        QByteArray fileId;
+        QByteArray data;
+    };
+
+    static QByteArray transferKey(int groupnumber, const ToxPk& author, const QByteArray& fileId);
+    static QByteArray nextRequest(Incoming& incoming);
+    static void restartRequests(Incoming& incoming);
+
+private:
+    mutable QMutex mutex;
+    QHash<QByteArray, Incoming> incoming;
+    qint64 incomingBytes = 0;
+    QVector<Offered> offered;
+};
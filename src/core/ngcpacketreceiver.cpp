@@ -0,0 +1,204 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ngcpacketreceiver.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class NgcPacketReceiver
+ * @brief Handles NGC group custom packets off the tox thread.
+ *
+ * The toxcore callback only copies the packet into a QByteArray and queues it with post(), the
+ * packet is parsed, hashed and stored by the handle functions on a pool of MAX_THREADS threads. Busy groups flooding images would
+ * otherwise stall tox_iterate and the GUI thread, which hashed and wrote every image.
+ *
+ * Files too large for a single packet are pulled in chunks through NgcFileTransfer, the chunk
+ * requests are handed to the send function.
+ *
+ * At most MAX_PENDING_PACKETS packets wait for processing, later ones are dropped until the
+ * pool caught up. Signals are emitted from the pool threads.
+ */
+
+constexpr int NgcPacketReceiver::GROUP_FILE_HEADER_SIZE;
+constexpr int NgcPacketReceiver::MAX_THREADS;
+constexpr int NgcPacketReceiver::MAX_PENDING_PACKETS;
+
+NgcPacketReceiver::NgcPacketReceiver(SendFunction send_)
+    : send{std::move(send_)}
+{
+    clock.start();
+    pool.setMaxThreadCount(MAX_THREADS);
+}
+
+NgcPacketReceiver::~NgcPacketReceiver()
+{
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief Sets where received images are stored.
+ * @param store Called on the pool threads, returns the id to reference the image by. Any call
+ * in progress is finished when this returns, so an empty store can be set before the old one
+ * is destroyed.
+ */
+void NgcPacketReceiver::setImageStore(ImageStore store)
+{
+    QWriteLocker locker{&storeLock};
+    imageStore = std::move(store);
+}
+
+/**
+ * @brief Queues a job on the pool, used for the group custom packets that are too slow to
+ * handle on the tox thread.
+ * @param job Called on a pool thread.
+ * @return False if the job was dropped, because too many are waiting already.
+ */
+bool NgcPacketReceiver::post(std::function<void()> job)
+{
+    if (pendingPackets.fetch_add(1) >= MAX_PENDING_PACKETS) {
+        pendingPackets.fetch_sub(1);
+        qWarning() << "Dropping group packet, too many are pending";
+        return false;
+    }
+
+    QtConcurrent::run(&pool, [this, job] {
+        job();
+        pendingPackets.fetch_sub(1);
+    });
+    return true;
+}
+
+/**
+ * @brief Extracts the file of a group file packet.
+ * @param packet Group custom packet.
+ * @param fileData Set to the content of the file.
+ * @return False if the packet isn't a group file.
+ */
+bool NgcPacketReceiver::parseGroupFile(const QByteArray& packet, QByteArray& fileData)
+{
+    if (packet.size() <= GROUP_FILE_HEADER_SIZE
+        || NgcFileTransfer::packetType(packet)
+               != static_cast<int>(NgcFileTransfer::PacketType::GroupFile)) {
+        return false;
+    }
+
+    fileData = packet.mid(GROUP_FILE_HEADER_SIZE);
+    return true;
+}
+
+/**
+ * @brief Makes a file available to be pulled in chunks by the peers of our groups.
+ * @param file Content of the file.
+ * @return FileAnnounce packet to broadcast, empty if the file can't be offered.
+ */
+QByteArray NgcPacketReceiver::offerFile(const QByteArray& file)
+{
+    return fileTransfer.offerFile(file);
+}
+
+/**
+ * @brief Requests missing chunks of stalled file transfers again, call this periodically.
+ */
+void NgcPacketReceiver::checkTransfers()
+{
+    for (const auto& request : fileTransfer.expire(clock.elapsed())) {
+        send(request.groupnumber, request.peerId, {request.packet});
+    }
+}
+
+/**
+ * @brief Stores the image of a GroupFile packet, call on the pool.
+ */
+void NgcPacketReceiver::handleGroupFile(int groupnumber, int peernumber, const ToxPk& author,
+                                        const QByteArray& packet)
+{
+    QByteArray image;
+    if (parseGroupFile(packet, image)) {
+        storeImage(groupnumber, peernumber, author, image);
+    }
+}
+
+/**
+ * @brief Starts pulling the file of a FileAnnounce packet, call on the pool.
+ */
+void NgcPacketReceiver::handleFileAnnounce(int groupnumber, uint32_t peerId, const ToxPk& author,
+                                           const QByteArray& packet)
+{
+    const QByteArray request =
+        fileTransfer.handleAnnounce(groupnumber, peerId, author, packet, clock.elapsed());
+    if (!request.isEmpty()) {
+        send(groupnumber, peerId, {request});
+    }
+}
+
+/**
+ * @brief Sends the chunks a ChunkRequest packet asks for, call on the pool.
+ */
+void NgcPacketReceiver::handleChunkRequest(int groupnumber, uint32_t peerId,
+                                           const QByteArray& packet)
+{
+    QVector<QByteArray> chunks = fileTransfer.handleRequest(packet);
+    if (!chunks.isEmpty()) {
+        send(groupnumber, peerId, std::move(chunks));
+    }
+}
+
+/**
+ * @brief Adds the content of a Chunk packet to its transfer, call on the pool.
+ */
+void NgcPacketReceiver::handleChunk(int groupnumber, uint32_t peerId, const ToxPk& author,
+                                    const QByteArray& packet)
+{
+    QByteArray request;
+    QByteArray file;
+    if (fileTransfer.handleChunk(groupnumber, peerId, author, packet, clock.elapsed(), request,
+                                 file)) {
+        storeImage(groupnumber, static_cast<int>(peerId), author, file);
+    } else if (!request.isEmpty()) {
+        send(groupnumber, peerId, {request});
+    }
+}
+
+void NgcPacketReceiver::storeImage(int groupnumber, int peernumber, const ToxPk& author,
+                                   const QByteArray& image)
+{
+    QString imageId;
+    {
+        QReadLocker locker{&storeLock};
+        if (imageStore) {
+            imageId = imageStore(image);
+        }
+    }
+
+    if (imageId.isEmpty()) {
+        // HINT: keep the image inline as hex rather than losing it
+        imageId = QString::fromUtf8(image.toHex()).toUpper();
+    }
+
+    qDebug() << "Received group image of" << image.size() << "bytes, SHA256:"
+             << QString::fromUtf8(
+                    QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex())
+                    .toUpper();
+    emit groupImageReceived(groupnumber, peernumber, author, imageId);
+}
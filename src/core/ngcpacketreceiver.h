@@ -0,0 +1,83 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "ngcfiletransfer.h"
+#include "toxpk.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+class NgcPacketReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    using ImageStore = std::function<QString(const QByteArray& image)>;
+    using SendFunction =
+        std::function<void(int groupnumber, uint32_t peerId, QVector<QByteArray> packets)>;
+
+    explicit NgcPacketReceiver(SendFunction send_);
+    ~NgcPacketReceiver();
+
+    void setImageStore(ImageStore store);
+    bool post(std::function<void()> job);
+    void handleGroupFile(int groupnumber, int peernumber, const ToxPk& author,
+                         const QByteArray& packet);
+    void handleFileAnnounce(int groupnumber, uint32_t peerId, const ToxPk& author,
+                            const QByteArray& packet);
+    void handleChunkRequest(int groupnumber, uint32_t peerId, const QByteArray& packet);
+    void handleChunk(int groupnumber, uint32_t peerId, const ToxPk& author,
+                     const QByteArray& packet);
+    QByteArray offerFile(const QByteArray& file);
+    void checkTransfers();
+
+    static bool parseGroupFile(const QByteArray& packet, QByteArray& fileData);
+
+    static constexpr int GROUP_FILE_HEADER_SIZE = 6 + 1 + 1 + 32 + 4 + 255;
+    static constexpr int MAX_THREADS = 2;
+    static constexpr int MAX_PENDING_PACKETS = 32;
+
+signals:
+    void groupImageReceived(int groupnumber, int peernumber, const ToxPk& author,
+                            const QString& imageId);
+
+private:
+    void storeImage(int groupnumber, int peernumber, const ToxPk& author, const QByteArray& image);
+
+private:
+    const SendFunction send;
+    QElapsedTimer clock;
+    NgcFileTransfer fileTransfer;
+    QThreadPool pool;
+    QReadWriteLock storeLock;
+    ImageStore imageStore;
+    std::atomic<int> pendingPackets{0};
+};
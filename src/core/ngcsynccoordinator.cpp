@@ -0,0 +1,288 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ngcsynccoordinator.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @class NgcSyncCoordinator
+ * @brief Decides when and whom to ask for NGC history syncs, and which requests to answer.
+ *
+ * After a network blip every member of a group rejoins at about the same time, and if each of
+ * them asked every other member for the sync window, big groups would see a burst of replies
+ * growing with the square of their size. Instead a round of requests starts with a random
+ * delay, asks at most MAX_RESPONDERS randomly picked peers, spaced out with jitter, and keeps
+ * at most MAX_OUTSTANDING of them replying at the same time.
+ *
+ * A reply is outstanding until its packets stop arriving for REPLY_IDLE_MS. Peers without any
+ * message in the sync window don't reply at all, so a request without any packet times out
+ * after FIRST_REPLY_TIMEOUT_MS.
+ *
+ * The sync window of the protocol is fixed, so we can't ask for the missing part only. A round
+ * is skipped though if the watermark, the newest message we hold or the start of the last
+ * finished round, is less than SKIP_GAP_MS old, since nothing worth a sync can be missing.
+ *
+ * On the answering side at most MAX_REPLIES_PER_WINDOW requests of a group are accepted within
+ * REPLY_WINDOW_MS, and only one per peer.
+ *
+ * @note Not thread safe, Core only uses it on the tox thread. Times are milliseconds since the
+ * epoch, so they compare to message timestamps.
+ */
+
+constexpr qint64 NgcSyncCoordinator::START_DELAY_MS;
+constexpr qint64 NgcSyncCoordinator::START_JITTER_MS;
+constexpr qint64 NgcSyncCoordinator::REQUEST_SPACING_MS;
+constexpr qint64 NgcSyncCoordinator::REQUEST_JITTER_MS;
+constexpr int NgcSyncCoordinator::MAX_RESPONDERS;
+constexpr int NgcSyncCoordinator::MAX_OUTSTANDING;
+constexpr qint64 NgcSyncCoordinator::FIRST_REPLY_TIMEOUT_MS;
+constexpr qint64 NgcSyncCoordinator::REPLY_IDLE_MS;
+constexpr qint64 NgcSyncCoordinator::ROUND_TIMEOUT_MS;
+constexpr qint64 NgcSyncCoordinator::SKIP_GAP_MS;
+constexpr qint64 NgcSyncCoordinator::REPLY_WINDOW_MS;
+constexpr int NgcSyncCoordinator::MAX_REPLIES_PER_WINDOW;
+
+NgcSyncCoordinator::NgcSyncCoordinator()
+    : NgcSyncCoordinator(
+        static_cast<uint32_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count()))
+{
+}
+
+/**
+ * @param seed Seed of the random responder choice and delays, fixed for tests.
+ */
+NgcSyncCoordinator::NgcSyncCoordinator(uint32_t seed)
+    : rng{seed}
+{
+}
+
+/**
+ * @brief Replaces the peers of a group, e.g. after we joined it again.
+ * @param peerIds Peers other than ourselves.
+ */
+void NgcSyncCoordinator::setPeers(uint32_t groupNumber, std::vector<uint32_t> peerIds)
+{
+    Group& group = groups[groupNumber];
+    group.peers = std::move(peerIds);
+    if (group.roundActive) {
+        group.candidates = group.peers;
+        group.outstanding.clear();
+    }
+}
+
+void NgcSyncCoordinator::addPeer(uint32_t groupNumber, uint32_t peerId)
+{
+    Group& group = groups[groupNumber];
+    if (std::find(group.peers.begin(), group.peers.end(), peerId) != group.peers.end()) {
+        return;
+    }
+
+    group.peers.push_back(peerId);
+    if (group.roundActive) {
+        group.candidates.push_back(peerId);
+    }
+}
+
+/**
+ * @brief Forgets a peer that left, toxcore reuses its id for the next peer joining.
+ */
+void NgcSyncCoordinator::removePeer(uint32_t groupNumber, uint32_t peerId)
+{
+    auto it = groups.find(groupNumber);
+    if (it == groups.end()) {
+        return;
+    }
+
+    Group& group = it->second;
+    group.peers.erase(std::remove(group.peers.begin(), group.peers.end(), peerId),
+                      group.peers.end());
+    group.candidates.erase(std::remove(group.candidates.begin(), group.candidates.end(), peerId),
+                           group.candidates.end());
+    group.outstanding.erase(std::remove_if(group.outstanding.begin(), group.outstanding.end(),
+                                           [peerId](const Outstanding& request) {
+                                               return request.peerId == peerId;
+                                           }),
+                            group.outstanding.end());
+}
+
+void NgcSyncCoordinator::removeGroup(uint32_t groupNumber)
+{
+    auto it = groups.find(groupNumber);
+    if (it == groups.end()) {
+        return;
+    }
+
+    if (it->second.roundActive) {
+        --activeRounds;
+    }
+    groups.erase(it);
+}
+
+/**
+ * @brief Starts a round of sync requests for a group we just joined.
+ * @param nowMs Current time.
+ * @param watermarkMs Timestamp of the newest message we hold of the group, 0 if unknown.
+ * @return False if a round is running already or nothing can be missing.
+ */
+bool NgcSyncCoordinator::startRound(uint32_t groupNumber, qint64 nowMs, qint64 watermarkMs)
+{
+    Group& group = groups[groupNumber];
+    if (group.roundActive) {
+        return false;
+    }
+
+    const qint64 heldUntilMs = std::max(watermarkMs, group.heldUntilMs);
+    if (heldUntilMs > 0 && nowMs - heldUntilMs < SKIP_GAP_MS) {
+        qDebug() << "Skipping history sync of group" << groupNumber << ", held until"
+                 << (nowMs - heldUntilMs) << "ms ago";
+        return false;
+    }
+
+    group.roundActive = true;
+    group.roundStartMs = nowMs;
+    // members rejoining after the same blip shouldn't all ask at once
+    group.nextRequestMs = nowMs + randomDelayMs(START_DELAY_MS, START_JITTER_MS);
+    group.requested = 0;
+    group.candidates = group.peers;
+    group.outstanding.clear();
+    ++activeRounds;
+    return true;
+}
+
+bool NgcSyncCoordinator::isRoundActive(uint32_t groupNumber) const
+{
+    auto it = groups.find(groupNumber);
+    return it != groups.end() && it->second.roundActive;
+}
+
+/**
+ * @brief Notes a packet of a sync reply, the reply is outstanding while packets keep coming.
+ */
+void NgcSyncCoordinator::onReplyPacket(uint32_t groupNumber, uint32_t peerId, qint64 nowMs)
+{
+    auto it = groups.find(groupNumber);
+    if (it == groups.end()) {
+        return;
+    }
+
+    for (Outstanding& request : it->second.outstanding) {
+        if (request.peerId == peerId) {
+            request.lastActivityMs = nowMs;
+            request.replied = true;
+        }
+    }
+}
+
+/**
+ * @brief Returns the requests to send now, cheap to call if no round is running.
+ */
+std::vector<NgcSyncCoordinator::Request> NgcSyncCoordinator::takeDueRequests(qint64 nowMs)
+{
+    std::vector<Request> requests;
+    if (activeRounds == 0) {
+        return requests;
+    }
+
+    for (auto& entry : groups) {
+        Group& group = entry.second;
+        if (group.roundActive && !updateRound(entry.first, group, nowMs, requests)) {
+            group.roundActive = false;
+            --activeRounds;
+        }
+    }
+
+    return requests;
+}
+
+/**
+ * @brief Decides whether to answer a sync request.
+ * @param peerPk Key of the requesting peer, it keeps it when rejoining with a new peer id.
+ * @return False if the request should be dropped.
+ */
+bool NgcSyncCoordinator::acceptRequest(uint32_t groupNumber, const ToxPk& peerPk, qint64 nowMs)
+{
+    auto& replies = groups[groupNumber].replies;
+    while (!replies.empty() && nowMs - replies.front().second >= REPLY_WINDOW_MS) {
+        replies.pop_front();
+    }
+
+    const bool repeated = std::any_of(replies.begin(), replies.end(),
+                                      [&peerPk](const std::pair<ToxPk, qint64>& reply) {
+                                          return reply.first == peerPk;
+                                      });
+    if (repeated || replies.size() >= static_cast<size_t>(MAX_REPLIES_PER_WINDOW)) {
+        return false;
+    }
+
+    replies.emplace_back(peerPk, nowMs);
+    return true;
+}
+
+qint64 NgcSyncCoordinator::randomDelayMs(qint64 minMs, qint64 jitterMs)
+{
+    return minMs + std::uniform_int_distribution<qint64>{0, jitterMs}(rng);
+}
+
+/**
+ * @brief Expires finished replies and picks the next responder if it is time.
+ * @return False once the round is finished.
+ */
+bool NgcSyncCoordinator::updateRound(uint32_t groupNumber, Group& group, qint64 nowMs,
+                                     std::vector<Request>& requests)
+{
+    group.outstanding.erase(
+        std::remove_if(group.outstanding.begin(), group.outstanding.end(),
+                       [nowMs](const Outstanding& request) {
+                           const qint64 timeout =
+                               request.replied ? REPLY_IDLE_MS : FIRST_REPLY_TIMEOUT_MS;
+                           return nowMs - request.lastActivityMs >= timeout;
+                       }),
+        group.outstanding.end());
+
+    // peers keep joining for a while after we rejoined, so wait for them until the timeout
+    const bool expired = nowMs - group.roundStartMs >= ROUND_TIMEOUT_MS;
+    if (!expired && group.requested < MAX_RESPONDERS
+        && group.outstanding.size() < static_cast<size_t>(MAX_OUTSTANDING)
+        && nowMs >= group.nextRequestMs && !group.candidates.empty()) {
+        const size_t index =
+            std::uniform_int_distribution<size_t>{0, group.candidates.size() - 1}(rng);
+        const uint32_t peerId = group.candidates[index];
+        group.candidates.erase(group.candidates.begin() + static_cast<std::ptrdiff_t>(index));
+        group.outstanding.push_back({peerId, nowMs, false});
+        ++group.requested;
+        group.nextRequestMs = nowMs + randomDelayMs(REQUEST_SPACING_MS, REQUEST_JITTER_MS);
+        requests.push_back({groupNumber, peerId});
+    }
+
+    if (!group.outstanding.empty() || (!expired && group.requested < MAX_RESPONDERS)) {
+        return true;
+    }
+
+    if (group.requested > 0) {
+        group.heldUntilMs = std::max(group.heldUntilMs, group.roundStartMs);
+    }
+    qDebug() << "History sync round of group" << groupNumber << "finished after"
+             << group.requested << "requests";
+    return false;
+}
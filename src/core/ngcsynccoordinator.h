@@ -0,0 +1,100 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+class NgcSyncCoordinator
+{
+public:
+    struct Request
+    {
+        uint32_t groupNumber;
+        uint32_t peerId;
+    };
+
+    NgcSyncCoordinator();
+    explicit NgcSyncCoordinator(uint32_t seed);
+
+    void setPeers(uint32_t groupNumber, std::vector<uint32_t> peerIds);
+    void addPeer(uint32_t groupNumber, uint32_t peerId);
+    void removePeer(uint32_t groupNumber, uint32_t peerId);
+    void removeGroup(uint32_t groupNumber);
+
+    bool startRound(uint32_t groupNumber, qint64 nowMs, qint64 watermarkMs);
+    bool isRoundActive(uint32_t groupNumber) const;
+    void onReplyPacket(uint32_t groupNumber, uint32_t peerId, qint64 nowMs);
+    std::vector<Request> takeDueRequests(qint64 nowMs);
+
+    bool acceptRequest(uint32_t groupNumber, const ToxPk& peerPk, qint64 nowMs);
+
+    static constexpr qint64 START_DELAY_MS = 2000;
+    static constexpr qint64 START_JITTER_MS = 8000;
+    static constexpr qint64 REQUEST_SPACING_MS = 1000;
+    static constexpr qint64 REQUEST_JITTER_MS = 2000;
+    static constexpr int MAX_RESPONDERS = 3;
+    static constexpr int MAX_OUTSTANDING = 2;
+    static constexpr qint64 FIRST_REPLY_TIMEOUT_MS = 10000;
+    static constexpr qint64 REPLY_IDLE_MS = 5000;
+    static constexpr qint64 ROUND_TIMEOUT_MS = 60000;
+    static constexpr qint64 SKIP_GAP_MS = 30000;
+    static constexpr qint64 REPLY_WINDOW_MS = 60000;
+    static constexpr int MAX_REPLIES_PER_WINDOW = 5;
+
+private:
+    struct Outstanding
+    {
+        uint32_t peerId;
+        qint64 lastActivityMs;
+        bool replied;
+    };
+
+    struct Group
+    {
+        std::vector<uint32_t> peers;
+        bool roundActive = false;
+        qint64 roundStartMs = 0;
+        qint64 nextRequestMs = 0;
+        int requested = 0;
+        std::vector<uint32_t> candidates;
+        std::vector<Outstanding> outstanding;
+        // everything before this was received live or by a finished round
+        qint64 heldUntilMs = 0;
+        std::deque<std::pair<ToxPk, qint64>> replies;
+    };
+
+    qint64 randomDelayMs(qint64 minMs, qint64 jitterMs);
+    bool updateRound(uint32_t groupNumber, Group& group, qint64 nowMs,
+                     std::vector<Request>& requests);
+
+private:
+    std::mt19937 rng;
+    std::map<uint32_t, Group> groups;
+    int activeRounds = 0;
+};
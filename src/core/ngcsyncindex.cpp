@@ -0,0 +1,250 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ngcsyncindex.h"
+
+#include <QCryptographicHash>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * @class NgcSyncIndex
+ * @brief Remembers which NGC group messages we already have, to drop repeated history sync
+ * messages before they reach the chat log and the database.
+ *
+ * Every peer answering a history sync request sends all messages of the sync window, so with
+ * several peers answering we get each message several times. A message is identified by its
+ * group, its sender and a hash of its NGC message id and text. The timestamp is part of the
+ * match as well, but only within MATCH_WINDOW_MS, since each responder sends the time it
+ * received the message itself.
+ *
+ * At most the given capacity of entries is kept in memory, the oldest ones are evicted first.
+ * The first message of a group loads the entries we stored in the database before, so a sync
+ * after a restart doesn't insert everything a second time.
+ *
+ * @note Not thread safe, except for setLoader(). Core only uses it on the tox thread.
+ *
+ * @var MATCH_WINDOW_MS
+ * @brief Largest difference between two timestamps of the same message
+ */
+
+constexpr size_t NgcSyncIndex::MAX_ENTRIES;
+constexpr qint64 NgcSyncIndex::MATCH_WINDOW_MS;
+constexpr int NgcSyncIndex::MSG_ID_SIZE;
+constexpr int NgcSyncIndex::NAME_SIZE;
+constexpr int NgcSyncIndex::SYNC_MESSAGE_HEADER_SIZE;
+
+namespace {
+const char syncMessageHeader[] = {0x66, 0x77, static_cast<char>(0x88), 0x11, 0x34, 0x35, 0x1, 0x2};
+} // namespace
+
+NgcSyncIndex::NgcSyncIndex(size_t capacity_)
+    : capacity{capacity_}
+{
+}
+
+/**
+ * @brief Sets where the stored entries of a group are loaded from.
+ * @param loader_ Called on the thread using the index. Any call in progress is finished when
+ * this returns, so an empty loader can be set before the database goes away.
+ */
+void NgcSyncIndex::setLoader(Loader loader_)
+{
+    QMutexLocker locker{&loaderLock};
+    loader = std::move(loader_);
+}
+
+/**
+ * @brief Adds a message to the index.
+ * @param groupnumber Group of the message, including the NGC offset.
+ * @param sender Public key of the author.
+ * @param timestampMs Time the message was sent, or received by whoever synced it to us.
+ * @param messageHash Hash from messageHash().
+ * @return False if the message was seen before and should be dropped.
+ */
+bool NgcSyncIndex::insert(int groupnumber, const ToxPk& sender, qint64 timestampMs,
+                          const QByteArray& messageHash)
+{
+    if (!loadedGroups.contains(groupnumber)) {
+        load(groupnumber);
+    }
+
+    qint64& newest = newestTimestamps[groupnumber];
+    newest = std::max(newest, timestampMs);
+    if (!add(makeKey(groupnumber, sender, messageHash), timestampMs)) {
+        ++duplicates;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Forgets all messages of a group, e.g. after leaving it.
+ */
+void NgcSyncIndex::removeGroup(int groupnumber)
+{
+    loadedGroups.remove(groupnumber);
+    newestTimestamps.remove(groupnumber);
+
+    const int32_t group = groupnumber;
+    const QByteArray prefix(reinterpret_cast<const char*>(&group), sizeof(group));
+    order.erase(std::remove_if(order.begin(), order.end(),
+                               [&prefix](const QByteArray& key) { return key.startsWith(prefix); }),
+                order.end());
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it.key().startsWith(prefix)) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief Timestamp of the newest message of a group we hold, 0 if there is none.
+ */
+qint64 NgcSyncIndex::getNewestTimestamp(int groupnumber)
+{
+    if (!loadedGroups.contains(groupnumber)) {
+        load(groupnumber);
+    }
+
+    return newestTimestamps.value(groupnumber, 0);
+}
+
+size_t NgcSyncIndex::size() const
+{
+    return static_cast<size_t>(entries.size());
+}
+
+/**
+ * @brief Number of messages insert() rejected as seen before.
+ */
+uint64_t NgcSyncIndex::getDuplicates() const
+{
+    return duplicates;
+}
+
+/**
+ * @brief Hash identifying a message within a group and sender.
+ * @param msgId NGC message id, MSG_ID_SIZE bytes.
+ * @param text Message text as it is stored.
+ */
+QByteArray NgcSyncIndex::messageHash(const QByteArray& msgId, const QString& text)
+{
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    hash.addData(msgId);
+    hash.addData(text.toUtf8());
+    return hash.result();
+}
+
+/**
+ * @brief Parses a message packet of a history sync reply, see History::getGroupSyncPackets.
+ * @param packet Received custom private packet.
+ * @param message Set to the content of the packet.
+ * @return False if the packet isn't a valid sync message.
+ */
+bool NgcSyncIndex::parseSyncMessage(const QByteArray& packet, SyncMessage& message)
+{
+    if (packet.size() <= SYNC_MESSAGE_HEADER_SIZE
+        || !packet.startsWith(QByteArray::fromRawData(syncMessageHeader,
+                                                      sizeof(syncMessageHeader)))) {
+        return false;
+    }
+
+    int offset = sizeof(syncMessageHeader);
+    message.msgId = packet.mid(offset, MSG_ID_SIZE);
+    offset += MSG_ID_SIZE;
+    message.sender = ToxPk{packet.mid(offset, ToxPk::size)};
+    offset += ToxPk::size;
+
+    const auto* timestamp = reinterpret_cast<const uint8_t*>(packet.constData() + offset);
+    const uint32_t seconds = (static_cast<uint32_t>(timestamp[0]) << 24)
+                             | (static_cast<uint32_t>(timestamp[1]) << 16)
+                             | (static_cast<uint32_t>(timestamp[2]) << 8) | timestamp[3];
+    message.timestampMs = static_cast<qint64>(seconds) * 1000;
+    offset += 4;
+
+    QByteArray name = packet.mid(offset, NAME_SIZE);
+    const int nameEnd = name.indexOf('\0');
+    if (nameEnd >= 0) {
+        name.truncate(nameEnd);
+    }
+    message.senderName = QString::fromUtf8(name);
+    offset += NAME_SIZE;
+
+    message.text = QString::fromUtf8(packet.mid(offset));
+    return true;
+}
+
+QByteArray NgcSyncIndex::makeKey(int groupnumber, const ToxPk& sender,
+                                 const QByteArray& messageHash)
+{
+    const int32_t group = groupnumber;
+    QByteArray key(reinterpret_cast<const char*>(&group), sizeof(group));
+    key.append(sender.getByteArray());
+    key.append(messageHash);
+    return key;
+}
+
+void NgcSyncIndex::load(int groupnumber)
+{
+    loadedGroups.insert(groupnumber);
+
+    QVector<Entry> stored;
+    {
+        QMutexLocker locker{&loaderLock};
+        if (!loader) {
+            return;
+        }
+        stored = loader(groupnumber);
+    }
+
+    qint64& newest = newestTimestamps[groupnumber];
+    for (const Entry& entry : stored) {
+        newest = std::max(newest, entry.timestampMs);
+        add(makeKey(groupnumber, entry.sender, entry.messageHash), entry.timestampMs);
+    }
+}
+
+bool NgcSyncIndex::add(const QByteArray& key, qint64 timestampMs)
+{
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        if (std::abs(*it - timestampMs) <= MATCH_WINDOW_MS) {
+            return false;
+        }
+
+        // same id and text much later, that's a new message
+        *it = timestampMs;
+        return true;
+    }
+
+    entries.insert(key, timestampMs);
+    order.push_back(key);
+    while (order.size() > capacity) {
+        entries.remove(order.front());
+        order.pop_front();
+    }
+
+    return true;
+}
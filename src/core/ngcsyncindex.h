@@ -0,0 +1,93 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "toxpk.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+class NgcSyncIndex
+{
+public:
+    struct Entry
+    {
+        ToxPk sender;
+        qint64 timestampMs = 0;
+        QByteArray messageHash;
+    };
+
+    struct SyncMessage
+    {
+        QByteArray msgId;
+        ToxPk sender;
+        qint64 timestampMs = 0;
+        QString senderName;
+        QString text;
+    };
+
+    using Loader = std::function<QVector<Entry>(int groupnumber)>;
+
+    explicit NgcSyncIndex(size_t capacity_ = MAX_ENTRIES);
+
+    void setLoader(Loader loader_);
+    bool insert(int groupnumber, const ToxPk& sender, qint64 timestampMs,
+                const QByteArray& messageHash);
+    void removeGroup(int groupnumber);
+    qint64 getNewestTimestamp(int groupnumber);
+    size_t size() const;
+    uint64_t getDuplicates() const;
+
+    static QByteArray messageHash(const QByteArray& msgId, const QString& text);
+    static bool parseSyncMessage(const QByteArray& packet, SyncMessage& message);
+
+    static constexpr size_t MAX_ENTRIES = 20000;
+    static constexpr qint64 MATCH_WINDOW_MS = 10 * 60 * 1000;
+    static constexpr int MSG_ID_SIZE = 4;
+    static constexpr int NAME_SIZE = 25;
+    static constexpr int SYNC_MESSAGE_HEADER_SIZE = 6 + 1 + 1 + MSG_ID_SIZE + 32 + 4 + NAME_SIZE;
+
+private:
+    static QByteArray makeKey(int groupnumber, const ToxPk& sender, const QByteArray& messageHash);
+    void load(int groupnumber);
+    bool add(const QByteArray& key, qint64 timestampMs);
+
+private:
+    const size_t capacity;
+    // key to the timestamp it was seen with, responders stamp messages with their own time
+    QHash<QByteArray, qint64> entries;
+    // insertion order, the oldest entry is evicted first
+    std::deque<QByteArray> order;
+    QSet<int> loadedGroups;
+    QHash<int, qint64> newestTimestamps;
+    uint64_t duplicates = 0;
+
+    QMutex loaderLock;
+    Loader loader;
+};
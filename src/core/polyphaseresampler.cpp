@@ -0,0 +1,217 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "polyphaseresampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POLYPHASE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define POLYPHASE_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * @class PolyphaseResampler
+ * @brief Fixed 3:1 resampler between 48kHz and 16kHz for the echo cancellation path.
+ *
+ * A single windowed sinc low pass with TAPS coefficients serves both directions. Downsampling
+ * only evaluates every third output of the filter, upsampling splits it into FACTOR sub-filters
+ * of PHASE_TAPS coefficients, so no work is spent on samples that are thrown away or known to be
+ * zero. The inner loop is a plain dot product, vectorized with SSE2 or NEON where available.
+ *
+ * Each instance keeps the filter history of one stream, use one per direction and per call.
+ * All memory is allocated in the constructor.
+ *
+ * @var PolyphaseResampler::FACTOR
+ * @brief Ratio between the high and the low sample rate.
+ */
+
+constexpr size_t PolyphaseResampler::FACTOR;
+constexpr size_t PolyphaseResampler::TAPS;
+constexpr size_t PolyphaseResampler::PHASE_TAPS;
+
+namespace {
+static_assert(PolyphaseResampler::PHASE_TAPS % 4 == 0, "Kernels work on 4 floats at once");
+
+// pass band up to ~6kHz, stop band from ~8.5kHz, relative to 48kHz
+constexpr double CUTOFF = 7200.0 / 48000.0;
+constexpr double PI = 3.14159265358979323846;
+
+/**
+ * @brief Designs the Blackman windowed sinc low pass, normalized to unity gain at DC.
+ */
+std::array<double, PolyphaseResampler::TAPS> designLowPass()
+{
+    std::array<double, PolyphaseResampler::TAPS> taps;
+    const size_t n = taps.size();
+    const double center = (n - 1) / 2.0;
+    double sum = 0.0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const double x = i - center;
+        const double sinc = 2.0 * CUTOFF * (x == 0.0 ? 1.0 : std::sin(2.0 * PI * CUTOFF * x)
+                                                                / (2.0 * PI * CUTOFF * x));
+        const double window = 0.42 - 0.5 * std::cos(2.0 * PI * i / (n - 1))
+                              + 0.08 * std::cos(4.0 * PI * i / (n - 1));
+        taps[i] = sinc * window;
+        sum += taps[i];
+    }
+
+    for (double& tap : taps) {
+        tap /= sum;
+    }
+
+    return taps;
+}
+
+/**
+ * @brief Dot product of two float vectors.
+ * @param length Number of elements, must be a multiple of 4.
+ */
+float dot(const float* a, const float* b, size_t length)
+{
+#if defined(POLYPHASE_SSE2)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i < length; i += 4) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#elif defined(POLYPHASE_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (size_t i = 0; i < length; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+#else
+    float sum = 0.0f;
+    for (size_t i = 0; i < length; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+#endif
+}
+
+int16_t toSample(float value)
+{
+    const float rounded = std::floor(value + 0.5f);
+    return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, rounded)));
+}
+} // namespace
+
+/**
+ * @brief Creates a resampler for one stream.
+ * @param direction_ Downsample turns 48kHz into 16kHz, Upsample the other way around.
+ * @param maxInputSamples_ Largest frame process() will be called with.
+ */
+PolyphaseResampler::PolyphaseResampler(Direction direction_, size_t maxInputSamples_)
+    : direction{direction_}
+    , maxInputSamples{maxInputSamples_}
+    , historySamples{direction_ == Direction::Downsample ? TAPS - 1 : PHASE_TAPS - 1}
+    , buffer{new float[historySamples + maxInputSamples_]}
+{
+    const std::array<double, TAPS> taps = designLowPass();
+
+    if (direction == Direction::Downsample) {
+        for (size_t i = 0; i < TAPS; ++i) {
+            kernel[i] = static_cast<float>(taps[TAPS - 1 - i]);
+        }
+    } else {
+        // every sub-filter sees only one in FACTOR samples, make up for the lost gain
+        for (size_t phase = 0; phase < FACTOR; ++phase) {
+            for (size_t i = 0; i < PHASE_TAPS; ++i) {
+                const size_t tap = FACTOR * (PHASE_TAPS - 1 - i) + phase;
+                kernel[phase * PHASE_TAPS + i] = static_cast<float>(FACTOR * taps[tap]);
+            }
+        }
+    }
+
+    reset();
+}
+
+/**
+ * @brief Forgets the filter history, e.g. after a gap in the stream.
+ */
+void PolyphaseResampler::reset()
+{
+    std::fill(buffer.get(), buffer.get() + historySamples + maxInputSamples, 0.0f);
+}
+
+/**
+ * @brief Resamples the next frame of the stream.
+ * @param in Input samples, mono.
+ * @param inSamples Number of input samples, for downsampling a multiple of FACTOR.
+ * @param out Output buffer, must hold inSamples / FACTOR or inSamples * FACTOR samples.
+ * @return Number of samples written, 0 if the frame can't be processed.
+ */
+size_t PolyphaseResampler::process(const int16_t* in, size_t inSamples, int16_t* out)
+{
+    if (inSamples == 0 || inSamples > maxInputSamples
+        || (direction == Direction::Downsample && inSamples % FACTOR != 0)) {
+        return 0;
+    }
+
+    float* const input = buffer.get() + historySamples;
+    for (size_t i = 0; i < inSamples; ++i) {
+        input[i] = in[i];
+    }
+
+    const size_t written =
+        direction == Direction::Downsample ? downsample(inSamples, out) : upsample(inSamples, out);
+
+    // the tail of this frame is the history of the next one
+    std::memmove(buffer.get(), buffer.get() + inSamples, historySamples * sizeof(float));
+    return written;
+}
+
+size_t PolyphaseResampler::downsample(size_t inSamples, int16_t* out) const
+{
+    const size_t outSamples = inSamples / FACTOR;
+    // output m is aligned to the last input of its group of FACTOR samples
+    for (size_t m = 0; m < outSamples; ++m) {
+        out[m] = toSample(dot(kernel.data(), buffer.get() + FACTOR * m + FACTOR - 1, TAPS));
+    }
+    return outSamples;
+}
+
+size_t PolyphaseResampler::upsample(size_t inSamples, int16_t* out) const
+{
+    for (size_t m = 0; m < inSamples; ++m) {
+        const float* const window = buffer.get() + m;
+        for (size_t phase = 0; phase < FACTOR; ++phase) {
+            out[FACTOR * m + phase] =
+                toSample(dot(kernel.data() + phase * PHASE_TAPS, window, PHASE_TAPS));
+        }
+    }
+    return inSamples * FACTOR;
+}
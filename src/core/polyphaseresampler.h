@@ -0,0 +1,61 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class PolyphaseResampler
+{
+public:
+    enum class Direction
+    {
+        Downsample,
+        Upsample
+    };
+
+    PolyphaseResampler(Direction direction, size_t maxInputSamples);
+
+    PolyphaseResampler(const PolyphaseResampler&) = delete;
+    PolyphaseResampler& operator=(const PolyphaseResampler&) = delete;
+
+    size_t process(const int16_t* in, size_t inSamples, int16_t* out);
+    void reset();
+
+    static constexpr size_t FACTOR = 3;
+    static constexpr size_t TAPS = 96;
+    static constexpr size_t PHASE_TAPS = TAPS / FACTOR;
+
+private:
+    size_t downsample(size_t inSamples, int16_t* out) const;
+    size_t upsample(size_t inSamples, int16_t* out) const;
+
+private:
+    const Direction direction;
+    const size_t maxInputSamples;
+    const size_t historySamples;
+
+    // downsampling uses all taps, upsampling one sub-filter per output phase, both reversed
+    alignas(16) std::array<float, TAPS> kernel;
+    // history followed by the current input, converted to float
+    std::unique_ptr<float[]> buffer;
+};
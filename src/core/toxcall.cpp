@@ -19,7 +19,16 @@
 
 #include "src/core/toxcall.h"
 #include "audio/audio.h"
+#include "src/core/callaudiodsp.h"
+#include "src/core/callaudioresilience.h"
+#include "src/core/callratecontroller.h"
+#include "src/core/callstats.h"
+#include "src/core/callvideoladder.h"
 #include "src/core/coreav.h"
+#include "src/core/groupaudiomixer.h"
+#include "src/core/latencyhistogram.h"
+#include "src/core/nearendmixer.h"
+#include "src/core/voiceactivitydetector.h"
 #include "src/persistence/settings.h"
 #include "src/video/camerasource.h"
 #include "src/video/corevideosource.h"
@@ -27,6 +36,10 @@
 #include <QTimer>
 #include <QtConcurrent/QtConcurrent>
 
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
 /**
  * @var uint32_t ToxCall::callId
  * @brief Could be a friendNum or groupNum, must uniquely identify the call. Do not modify!
@@ -44,8 +57,32 @@
  * @var TOXAV_FRIEND_CALL_STATE ToxFriendCall::state
  * @brief State of the peer (not ours!)
  *
- * @var QMap ToxGroupCall::peers
- * @brief Keeps sources for users in group calls.
+ * @var std::unique_ptr<CallAudioDsp> ToxFriendCall::audioDsp
+ * @brief Echo cancellation state of this call, allocated once for the lifetime of the call.
+ *
+ * @var std::unique_ptr<NearEndMixer> ToxFriendCall::nearEndMixer
+ * @brief Turns multichannel capture into the mono frame the call DSP works on.
+ *
+ * @var std::unique_ptr<CallRateController> ToxFriendCall::rateController
+ * @brief Picks the audio and video bitrate of this call.
+ *
+ * @var std::unique_ptr<CallAudioResilience> ToxFriendCall::audioResilience
+ * @brief Picks how the audio of this call copes with packet loss.
+ *
+ * @var std::unique_ptr<CallVideoLadder> ToxFriendCall::videoLadder
+ * @brief Picks the resolution and frame rate we send in this call.
+ *
+ * @var CallEncoderProfile ToxFriendCall::encoderProfile
+ * @brief Encoder profile last applied to toxav for this call, see CoreAV::applyEncoderProfile().
+ *
+ * @var std::map<ToxPk, uint32_t> ToxGroupCall::peers
+ * @brief Mixer ids of the peers we received audio from.
+ *
+ * @var std::unique_ptr<GroupAudioMixer> ToxGroupCall::mixer
+ * @brief Mixes all peers into the single sink of the group call.
+ *
+ * @var std::unique_ptr<VoiceActivityDetector> ToxGroupCall::voiceDetector
+ * @brief Decides when our microphone is silent, so we can stop sending.
  */
 
 ToxCall::ToxCall(bool VideoEnabled_, CoreAV& av_, IAudioControl& audio_)
@@ -121,15 +158,17 @@ ToxFriendCall::ToxFriendCall(uint32_t friendNum, bool VideoEnabled, CoreAV& av_,
     IAudioControl& audio_, CameraSource& cameraSource_)
     : ToxCall(VideoEnabled, av_, audio_)
     , sink(audio_.makeSink())
+    , audioDsp{new CallAudioDsp}
+    , nearEndMixer{new NearEndMixer}
+    , rateController{new CallRateController}
+    , audioResilience{new CallAudioResilience}
+    , videoLadder{new CallVideoLadder}
+    , latencyStats{new AudioLatencyStats}
+    , callStats{new CallStats}
     , friendId{friendNum}
     , cameraSource{cameraSource_}
 {
-    connect(audioSource.get(), &IAudioSource::frameAvailable, this,
-                         [this](const int16_t* pcm, size_t samples, uint8_t chans, uint32_t rate) {
-                             av->sendCallAudio(friendId, pcm, samples, chans, rate);
-                         });
-
-    connect(audioSource.get(), &IAudioSource::invalidated, this, &ToxFriendCall::onAudioSourceInvalidated);
+    connectAudioSource();
 
     if (sink) {
         audioSinkInvalid = sink->connectTo_invalidated(this, [this]() { onAudioSinkInvalidated(); });
@@ -143,9 +182,10 @@ ToxFriendCall::ToxFriendCall(uint32_t friendNum, bool VideoEnabled, CoreAV& av_,
             cameraSource.setupDefault();
         }
         cameraSource.subscribe();
+        videoOutput = cameraSource.getConversionPlanner().addOutput({});
         videoInConn = QObject::connect(&cameraSource, &VideoSource::frameAvailable,
                                        [&av_, friendNum](std::shared_ptr<VideoFrame> frame) {
-                                           av_.sendCallVideo(friendNum, frame);
+                                           av_.queueCallVideo(friendNum, frame);
                                        });
         if (!videoInConn) {
             qDebug() << "Video connection not working";
@@ -156,19 +196,42 @@ ToxFriendCall::ToxFriendCall(uint32_t friendNum, bool VideoEnabled, CoreAV& av_,
 ToxFriendCall::~ToxFriendCall()
 {
     if (videoEnabled) {
+        cameraSource.getConversionPlanner().removeOutput(videoOutput);
         cameraSource.unsubscribe();
     }
     QObject::disconnect(audioSinkInvalid);
+
+    if (latencyStats->send.getCount() > 0 || latencyStats->playout.getCount() > 0) {
+        qDebug().noquote() << "Audio latency of call with friend" << friendId << ":\n"
+                           << latencyStats->toString();
+    }
 }
 
 void ToxFriendCall::onAudioSourceInvalidated()
 {
-    auto newSrc = audio.makeSource();
-    connect(newSrc.get(), &IAudioSource::frameAvailable, this,
-                         [this](const int16_t* pcm, size_t samples, uint8_t chans, uint32_t rate) {
-                             av->sendCallAudio(friendId, pcm, samples, chans, rate);
-                         });
-    audioSource = std::move(newSrc);
+    audioSource = audio.makeSource();
+    connectAudioSource();
+}
+
+/**
+ * @brief Forwards captured frames to the CoreAV send thread.
+ *
+ * The connection is direct, so the frame is copied into the send queue on the capture thread
+ * while the buffer is still valid. Nothing of this call object is touched there.
+ */
+void ToxFriendCall::connectAudioSource()
+{
+    if (!audioSource) {
+        return;
+    }
+
+    CoreAV* const coreAv = av;
+    const uint32_t callId = friendId;
+    connect(audioSource.get(), &IAudioSource::frameAvailable, this,
+            [coreAv, callId](const int16_t* pcm, size_t samples, uint8_t chans, uint32_t rate) {
+                coreAv->queueCallAudio(callId, pcm, samples, chans, rate);
+            },
+            Qt::DirectConnection);
 
     connect(audioSource.get(), &IAudioSource::invalidated, this, &ToxFriendCall::onAudioSourceInvalidated);
 }
@@ -179,6 +242,7 @@ void ToxFriendCall::onAudioSinkInvalidated()
 
     if (newSink) {
         audioSinkInvalid = newSink->connectTo_invalidated(this, [this]() { onAudioSinkInvalidated(); });
+        newSink->setExtraPlayoutFrames(extraPlayoutFrames);
     }
 
     sink = std::move(newSink);
@@ -199,13 +263,99 @@ void ToxFriendCall::playAudioBuffer(const int16_t* data, int samples, unsigned c
 {
     if (sink) {
         sink->playAudioBuffer(data, samples, channels, sampleRate);
+        latencyStats->playout.add(sink->getQueuedMs());
+        audioResilience->onAudioReceived(sink->getLateFrames());
+    }
+}
+
+CallAudioDsp& ToxFriendCall::getAudioDsp() const
+{
+    return *audioDsp;
+}
+
+NearEndMixer& ToxFriendCall::getNearEndMixer() const
+{
+    return *nearEndMixer;
+}
+
+CallRateController& ToxFriendCall::getRateController() const
+{
+    return *rateController;
+}
+
+CallAudioResilience& ToxFriendCall::getAudioResilience() const
+{
+    return *audioResilience;
+}
+
+/**
+ * @brief Makes the sink buffer more frames than the jitter asks for, kept across sink changes.
+ * @param frames Frames to add to the playout delay.
+ */
+void ToxFriendCall::setExtraPlayoutFrames(unsigned frames)
+{
+    extraPlayoutFrames = frames;
+    if (sink) {
+        sink->setExtraPlayoutFrames(frames);
+    }
+}
+
+CallVideoLadder& ToxFriendCall::getVideoLadder() const
+{
+    return *videoLadder;
+}
+
+AudioLatencyStats& ToxFriendCall::getLatencyStats() const
+{
+    return *latencyStats;
+}
+
+CallStats& ToxFriendCall::getCallStats() const
+{
+    return *callStats;
+}
+
+/**
+ * @brief Lets the camera convert its frames to the size we send before emitting them.
+ * @note Called on the video send thread, the change applies to the next camera frame.
+ */
+void ToxFriendCall::setVideoOutputSize(const QSize& size)
+{
+    if (!videoEnabled || size == videoOutputSize) {
+        return;
     }
+
+    videoOutputSize = size;
+    cameraSource.getConversionPlanner().setOutput(videoOutput,
+                                                  {size, AV_PIX_FMT_YUV420P, true});
+}
+
+const CallEncoderProfile& ToxFriendCall::getEncoderProfile() const
+{
+    return encoderProfile;
+}
+
+/**
+ * @note Only called when the call starts and on the video send thread afterwards.
+ */
+void ToxFriendCall::setEncoderProfile(const CallEncoderProfile& profile)
+{
+    encoderProfile = profile;
 }
 
 ToxGroupCall::ToxGroupCall(const Group& group_, CoreAV& av_, IAudioControl& audio_)
     : ToxCall(false, av_, audio_)
+    , sink(audio_.makeSink())
+    , mixer{new GroupAudioMixer{[this](const int16_t* data, size_t samples) {
+        playMixed(data, samples);
+    }}}
+    , voiceDetector{new VoiceActivityDetector{IAudioControl::AUDIO_SAMPLE_RATE}}
     , group{group_}
 {
+    if (sink) {
+        sinkInvalid = sink->connectTo_invalidated(this, [this]() { onAudioSinkInvalidated(); });
+    }
+
     // register audio
     connect(audioSource.get(), &IAudioSource::frameAvailable, this,
             [this](const int16_t* pcm, size_t samples, uint8_t chans, uint32_t rate) {
@@ -243,10 +393,15 @@ void ToxGroupCall::onAudioSourceInvalidated()
 }
 
 
-void ToxGroupCall::onAudioSinkInvalidated(ToxPk peerId)
+void ToxGroupCall::onAudioSinkInvalidated()
 {
-    removePeer(peerId);
-    addPeer(peerId);
+    auto newSink = audio.makeSink();
+
+    if (newSink) {
+        sinkInvalid = newSink->connectTo_invalidated(this, [this]() { onAudioSinkInvalidated(); });
+    }
+
+    sink = std::move(newSink);
 }
 
 void ToxGroupCall::removePeer(ToxPk peerId)
@@ -257,49 +412,58 @@ void ToxGroupCall::removePeer(ToxPk peerId)
         return;
     }
 
+    mixer->removePeer(source->second);
     peers.erase(source);
-    QObject::disconnect(sinkInvalid[peerId]);
-    sinkInvalid.erase(peerId);
 }
 
-void ToxGroupCall::addPeer(ToxPk peerId)
+uint32_t ToxGroupCall::addPeer(ToxPk peerId)
 {
-    std::unique_ptr<IAudioSink> newSink = audio.makeSink();
+    const uint32_t id = nextPeerId++;
+    peers.emplace(peerId, id);
+    return id;
+}
 
-    QMetaObject::Connection con;
+void ToxGroupCall::clearPeers()
+{
+    peers.clear();
+    QObject::disconnect(sinkInvalid);
+}
 
-    if (newSink) {
-         con = newSink->connectTo_invalidated(this, [this, peerId]() { onAudioSinkInvalidated(peerId); });
+void ToxGroupCall::playAudioBuffer(const ToxPk& peer, const int16_t* data, int samples,
+                                   unsigned channels, int sampleRate)
+{
+    // toxcore decodes group audio at 48kHz, anything else can't be mixed
+    if (sampleRate != static_cast<int>(GroupAudioMixer::SAMPLE_RATE) || samples <= 0) {
+        return;
     }
 
-    peers.emplace(peerId, std::move(newSink));
-    sinkInvalid.insert({peerId, con});
+    auto it = peers.find(peer);
+    const uint32_t id = it == peers.end() ? addPeer(peer) : it->second;
+    mixer->push(id, data, static_cast<size_t>(samples), channels);
 }
 
-bool ToxGroupCall::havePeer(ToxPk peerId)
+/**
+ * @brief Sets the volume and stereo position of a peer in the mix.
+ * @param peer The peer to change.
+ * @param gain Linear gain, 1 keeps the volume.
+ * @param pan -1 is left, 0 center and 1 right.
+ */
+void ToxGroupCall::setPeerVolume(const ToxPk& peer, float gain, float pan)
 {
-    const auto& source = peers.find(peerId);
-    return source != peers.cend();
+    auto it = peers.find(peer);
+    const uint32_t id = it == peers.end() ? addPeer(peer) : it->second;
+    mixer->setPeerGain(id, gain, pan);
 }
 
-void ToxGroupCall::clearPeers()
+void ToxGroupCall::playMixed(const int16_t* data, size_t samples)
 {
-    peers.clear();
-    for (auto con : sinkInvalid) {
-        QObject::disconnect(con.second);
+    if (sink) {
+        sink->playAudioBuffer(data, static_cast<int>(samples), GroupAudioMixer::CHANNELS,
+                              GroupAudioMixer::SAMPLE_RATE);
     }
-
-    sinkInvalid.clear();
 }
 
-void ToxGroupCall::playAudioBuffer(const ToxPk& peer, const int16_t* data, int samples,
-                                   unsigned channels, int sampleRate)
+VoiceActivityDetector& ToxGroupCall::getVoiceDetector() const
 {
-    if (!havePeer(peer)) {
-        addPeer(peer);
-    }
-    const auto& source = peers.find(peer);
-    if (source->second) {
-        source->second->playAudioBuffer(data, samples, channels, sampleRate);
-    }
+    return *voiceDetector;
 }
@@ -22,11 +22,13 @@
 #include "audio/iaudiocontrol.h"
 #include "audio/iaudiosink.h"
 #include "audio/iaudiosource.h"
+#include "src/core/callencoderprofile.h"
 #include <src/core/toxpk.h>
 #include <tox/toxav.h>
 
 #include <QMap>
 #include <QMetaObject>
+#include <QSize>
 #include <QtGlobal>
 
 #include <cstdint>
@@ -34,6 +36,15 @@
 
 class QTimer;
 class AudioFilterer;
+struct AudioLatencyStats;
+class CallAudioDsp;
+class CallAudioResilience;
+class CallRateController;
+class CallStats;
+class CallVideoLadder;
+class GroupAudioMixer;
+class NearEndMixer;
+class VoiceActivityDetector;
 class CoreVideoSource;
 class CoreAV;
 class Group;
@@ -102,16 +113,41 @@ public:
 
     void playAudioBuffer(const int16_t* data, int samples, unsigned channels, int sampleRate) const;
 
+    CallAudioDsp& getAudioDsp() const;
+    NearEndMixer& getNearEndMixer() const;
+    CallRateController& getRateController() const;
+    CallAudioResilience& getAudioResilience() const;
+    void setExtraPlayoutFrames(unsigned frames);
+    CallVideoLadder& getVideoLadder() const;
+    AudioLatencyStats& getLatencyStats() const;
+    CallStats& getCallStats() const;
+    void setVideoOutputSize(const QSize& size);
+    const CallEncoderProfile& getEncoderProfile() const;
+    void setEncoderProfile(const CallEncoderProfile& profile);
+
 private slots:
     void onAudioSourceInvalidated();
     void onAudioSinkInvalidated();
 
 private:
+    void connectAudioSource();
+
     QMetaObject::Connection audioSinkInvalid;
     TOXAV_FRIEND_CALL_STATE state{TOXAV_FRIEND_CALL_STATE_NONE};
     std::unique_ptr<IAudioSink> sink;
+    std::unique_ptr<CallAudioDsp> audioDsp;
+    std::unique_ptr<NearEndMixer> nearEndMixer;
+    std::unique_ptr<CallRateController> rateController;
+    std::unique_ptr<CallAudioResilience> audioResilience;
+    std::unique_ptr<CallVideoLadder> videoLadder;
+    std::unique_ptr<AudioLatencyStats> latencyStats;
+    std::unique_ptr<CallStats> callStats;
     uint32_t friendId;
     CameraSource& cameraSource;
+    unsigned extraPlayoutFrames{0};
+    int videoOutput{-1};
+    QSize videoOutputSize;
+    CallEncoderProfile encoderProfile;
 };
 
 class ToxGroupCall : public ToxCall
@@ -128,17 +164,24 @@ public:
 
     void playAudioBuffer(const ToxPk& peer, const int16_t* data, int samples, unsigned channels,
                          int sampleRate);
+    void setPeerVolume(const ToxPk& peer, float gain, float pan);
+
+    VoiceActivityDetector& getVoiceDetector() const;
 
 private:
-    void addPeer(ToxPk peerId);
-    bool havePeer(ToxPk peerId);
+    uint32_t addPeer(ToxPk peerId);
     void clearPeers();
+    void playMixed(const int16_t* data, size_t samples);
 
-    std::map<ToxPk, std::unique_ptr<IAudioSink>> peers;
-    std::map<ToxPk, QMetaObject::Connection> sinkInvalid;
+    std::map<ToxPk, uint32_t> peers;
+    uint32_t nextPeerId = 0;
+    std::unique_ptr<IAudioSink> sink;
+    QMetaObject::Connection sinkInvalid;
+    std::unique_ptr<GroupAudioMixer> mixer;
+    std::unique_ptr<VoiceActivityDetector> voiceDetector;
     const Group& group;
 
 private slots:
     void onAudioSourceInvalidated();
-    void onAudioSinkInvalidated(ToxPk peerId);
+    void onAudioSinkInvalidated();
 };
@@ -0,0 +1,268 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "toxeventrecorder.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <algorithm>
+
+/**
+ * @class ToxEventRecorder
+ * @brief Records the toxcore callbacks Core receives, to replay them later as a load test.
+ *
+ * Recording is off unless enable() was called, which the --record-tox-events command line
+ * option does. Core then adds one Event per callback, with the time since recording started.
+ * The recording is anonymized: it only keeps the local friend, group and peer numbers, the
+ * status and type values and the length of messages and names, never their text, public keys
+ * or packet payloads. Custom packets keep their first HEADER_BYTES, which only hold the packet
+ * id, so the replay reaches the same handler. Friend requests and invites aren't recorded,
+ * they carry public keys and can't be replayed without them anyway.
+ *
+ * The file has one compact JSON object per event and line, see serialize(). ToxEventReplayer
+ * feeds it back into a Core.
+ *
+ * @note Thread safe, though all callbacks run on the Core thread.
+ */
+
+constexpr int ToxEventRecorder::MAX_EVENTS;
+constexpr int ToxEventRecorder::HEADER_BYTES;
+
+namespace {
+struct TypeName
+{
+    ToxEventRecorder::Type type;
+    const char* name;
+};
+
+const TypeName typeNames[] = {
+    {ToxEventRecorder::Type::SelfConnection, "selfConnection"},
+    {ToxEventRecorder::Type::FriendConnection, "friendConnection"},
+    {ToxEventRecorder::Type::FriendStatus, "friendStatus"},
+    {ToxEventRecorder::Type::FriendName, "friendName"},
+    {ToxEventRecorder::Type::FriendStatusMessage, "friendStatusMessage"},
+    {ToxEventRecorder::Type::FriendTyping, "friendTyping"},
+    {ToxEventRecorder::Type::FriendMessage, "friendMessage"},
+    {ToxEventRecorder::Type::ReadReceipt, "readReceipt"},
+    {ToxEventRecorder::Type::LosslessPacket, "losslessPacket"},
+    {ToxEventRecorder::Type::ConferenceMessage, "conferenceMessage"},
+    {ToxEventRecorder::Type::NgcPeerJoin, "ngcPeerJoin"},
+    {ToxEventRecorder::Type::NgcPeerExit, "ngcPeerExit"},
+    {ToxEventRecorder::Type::NgcPeerName, "ngcPeerName"},
+    {ToxEventRecorder::Type::NgcMessage, "ngcMessage"},
+    {ToxEventRecorder::Type::NgcPrivateMessage, "ngcPrivateMessage"},
+    {ToxEventRecorder::Type::NgcCustomPacket, "ngcCustomPacket"},
+    {ToxEventRecorder::Type::NgcCustomPrivatePacket, "ngcCustomPrivatePacket"},
+};
+
+const char* typeName(ToxEventRecorder::Type type)
+{
+    for (const TypeName& entry : typeNames) {
+        if (entry.type == type) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+bool typeFromName(const QString& name, ToxEventRecorder::Type& type)
+{
+    for (const TypeName& entry : typeNames) {
+        if (name == QLatin1String(entry.name)) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+ToxEventRecorder& ToxEventRecorder::getInstance()
+{
+    static ToxEventRecorder recorder;
+    return recorder;
+}
+
+/**
+ * @brief Starts recording.
+ * @param recordingPath File the events get written to by write().
+ */
+void ToxEventRecorder::enable(const QString& recordingPath)
+{
+    QMutexLocker locker{&mutex};
+    path = recordingPath;
+    clock.start();
+    enabled = true;
+    qDebug() << "Recording the tox events to" << path;
+}
+
+/**
+ * @brief Adds a callback to the recording, does nothing while recording is off.
+ * @param type Which callback it was.
+ * @param target Friend, conference or group number.
+ * @param peer Peer number in the group.
+ * @param value Status, message type, receipt or exit type, depending on the callback.
+ * @param length Length of the message, name or packet.
+ * @param data Packet payload, only the first HEADER_BYTES are kept.
+ */
+void ToxEventRecorder::record(Type type, uint32_t target, uint32_t peer, uint32_t value,
+                              size_t length, const uint8_t* data)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    QMutexLocker locker{&mutex};
+    if (events.size() >= MAX_EVENTS) {
+        if (!full) {
+            qWarning() << "Tox event recording is full, dropping the following events";
+            full = true;
+        }
+        return;
+    }
+
+    QByteArray header;
+    if (data) {
+        const size_t headerSize = std::min<size_t>(length, HEADER_BYTES);
+        header = QByteArray(reinterpret_cast<const char*>(data), static_cast<int>(headerSize));
+    }
+
+    events.append({clock.nsecsElapsed() / 1000, type, target, peer, value,
+                   static_cast<uint32_t>(length), header});
+}
+
+QVector<ToxEventRecorder::Event> ToxEventRecorder::getEvents() const
+{
+    QMutexLocker locker{&mutex};
+    return events;
+}
+
+/**
+ * @brief Writes the recording to the file given to enable().
+ * @return False if recording is off or the file couldn't be written.
+ */
+bool ToxEventRecorder::write() const
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    QString recordingPath;
+    QVector<Event> recorded;
+    {
+        QMutexLocker locker{&mutex};
+        recordingPath = path;
+        recorded = events;
+    }
+
+    const QByteArray data = serialize(recorded);
+    QSaveFile file{recordingPath};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Failed to write the tox events to" << recordingPath;
+        return false;
+    }
+
+    qDebug() << "Wrote" << recorded.size() << "tox events to" << recordingPath;
+    return true;
+}
+
+/**
+ * @brief Serializes events, one JSON object per line.
+ *
+ * "t" is the time in microseconds, "e" the callback, "n" the friend or group number, "p" the
+ * peer, "v" the value, "l" the length and "h" the hex encoded packet header. Zero values and
+ * empty headers are left out.
+ */
+QByteArray ToxEventRecorder::serialize(const QVector<Event>& events)
+{
+    QByteArray data;
+    for (const Event& event : events) {
+        QJsonObject object;
+        object["t"] = event.timeUs;
+        object["e"] = QLatin1String(typeName(event.type));
+        object["n"] = static_cast<qint64>(event.target);
+        if (event.peer) {
+            object["p"] = static_cast<qint64>(event.peer);
+        }
+        if (event.value) {
+            object["v"] = static_cast<qint64>(event.value);
+        }
+        if (event.length) {
+            object["l"] = static_cast<qint64>(event.length);
+        }
+        if (!event.header.isEmpty()) {
+            object["h"] = QString::fromLatin1(event.header.toHex());
+        }
+        data += QJsonDocument(object).toJson(QJsonDocument::Compact);
+        data += '\n';
+    }
+    return data;
+}
+
+/**
+ * @brief Parses events written by serialize().
+ * @param data Serialized events.
+ * @param events Gets the parsed events appended.
+ * @return False if a line isn't a valid event, events then holds the ones before it.
+ */
+bool ToxEventRecorder::parse(const QByteArray& data, QVector<Event>& events)
+{
+    for (const QByteArray& line : data.split('\n')) {
+        if (line.trimmed().isEmpty()) {
+            continue;
+        }
+
+        const QJsonObject object = QJsonDocument::fromJson(line).object();
+        Event event{};
+        if (object.isEmpty() || !typeFromName(object["e"].toString(), event.type)) {
+            qWarning() << "Invalid tox event" << line.left(80);
+            return false;
+        }
+
+        event.timeUs = static_cast<qint64>(object["t"].toDouble());
+        event.target = static_cast<uint32_t>(object["n"].toDouble());
+        event.peer = static_cast<uint32_t>(object["p"].toDouble());
+        event.value = static_cast<uint32_t>(object["v"].toDouble());
+        event.length = static_cast<uint32_t>(object["l"].toDouble());
+        event.header = QByteArray::fromHex(object["h"].toString().toLatin1());
+        events.append(event);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a recording written by write().
+ * @param path Recording file.
+ * @param events Gets the events appended.
+ * @return False if the file couldn't be read or isn't a recording.
+ */
+bool ToxEventRecorder::load(const QString& path, QVector<Event>& events)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open the tox events" << path;
+        return false;
+    }
+    return parse(file.readAll(), events);
+}
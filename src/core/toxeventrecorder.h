@@ -0,0 +1,100 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class ToxEventRecorder
+{
+public:
+    enum class Type
+    {
+        SelfConnection,
+        FriendConnection,
+        FriendStatus,
+        FriendName,
+        FriendStatusMessage,
+        FriendTyping,
+        FriendMessage,
+        ReadReceipt,
+        LosslessPacket,
+        ConferenceMessage,
+        NgcPeerJoin,
+        NgcPeerExit,
+        NgcPeerName,
+        NgcMessage,
+        NgcPrivateMessage,
+        NgcCustomPacket,
+        NgcCustomPrivatePacket
+    };
+
+    struct Event
+    {
+        qint64 timeUs;
+        Type type;
+        // friend, conference or group number
+        uint32_t target;
+        uint32_t peer;
+        // status, message type, receipt or exit type
+        uint32_t value;
+        uint32_t length;
+        // packet id bytes of custom packets, nothing of the payload
+        QByteArray header;
+    };
+
+    static ToxEventRecorder& getInstance();
+
+    void enable(const QString& recordingPath);
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void record(Type type, uint32_t target, uint32_t peer = 0, uint32_t value = 0,
+                size_t length = 0, const uint8_t* data = nullptr);
+    QVector<Event> getEvents() const;
+    bool write() const;
+
+    static QByteArray serialize(const QVector<Event>& events);
+    static bool parse(const QByteArray& data, QVector<Event>& events);
+    static bool load(const QString& path, QVector<Event>& events);
+
+    static constexpr int MAX_EVENTS = 1000000;
+    static constexpr int HEADER_BYTES = 8;
+
+private:
+    ToxEventRecorder() = default;
+
+private:
+    std::atomic<bool> enabled{false};
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    QString path;
+    QVector<Event> events;
+    bool full = false;
+};
@@ -0,0 +1,198 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "toxeventreplayer.h"
+#include "core.h"
+
+#include "util/lockprofiler.h"
+
+#include <QTimer>
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @class ToxEventReplayer
+ * @brief Feeds events recorded by ToxEventRecorder back into a Core, as a repeatable load test.
+ *
+ * The events go through the same static callbacks toxcore calls, on the Core thread and under
+ * the Core loop lock, so everything connected to Core sees them like real traffic. Messages,
+ * names and packets are filled up to their recorded length, packets behind their recorded
+ * header. Friend, group and peer numbers are used as recorded, the Core should know them for
+ * realistic work, but unknown ones are fine too.
+ *
+ * With a speed of 1 the events keep their recorded timing, 10 replays ten times faster and 0
+ * or less as fast as the Core thread manages. Due events are dispatched in batches of at most
+ * MAX_BATCH_EVENTS, like tox_iterate delivers them, so the Core timers still get their turn.
+ *
+ * @note Lives on the Core thread, the Core must be started. getStats() may be called once
+ * finished() was received.
+ */
+
+constexpr int ToxEventReplayer::MAX_BATCH_EVENTS;
+
+ToxEventReplayer::ToxEventReplayer(Core& core_, QVector<ToxEventRecorder::Event> events_,
+                                   double speed_)
+    : core{core_}
+    , events{std::move(events_)}
+    , speed{speed_}
+    , timer{new QTimer(this)}
+{
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &ToxEventReplayer::replayDue);
+    moveToThread(core.thread());
+}
+
+/**
+ * @brief Starts replaying, can be called from any thread.
+ */
+void ToxEventReplayer::start()
+{
+    next = 0;
+    stats = {0, 0, 0};
+    clock.start();
+    QMetaObject::invokeMethod(this, "replayDue", Qt::QueuedConnection);
+}
+
+ToxEventReplayer::Stats ToxEventReplayer::getStats() const
+{
+    return stats;
+}
+
+qint64 ToxEventReplayer::dueUs(int index) const
+{
+    if (speed <= 0) {
+        return 0;
+    }
+
+    const qint64 firstUs = events.first().timeUs;
+    return static_cast<qint64>((events.at(index).timeUs - firstUs) / speed);
+}
+
+void ToxEventReplayer::replayDue()
+{
+    {
+        PROFILED_MUTEX_LOCKER(ml, &core.coreLoopLock, "Core::coreLoopLock");
+        const int end = std::min(events.size(), next + MAX_BATCH_EVENTS);
+        while (next < end) {
+            const qint64 lagUs = clock.nsecsElapsed() / 1000 - dueUs(next);
+            if (lagUs < 0) {
+                break;
+            }
+
+            stats.maxLagUs = std::max(stats.maxLagUs, lagUs);
+            dispatch(core, events.at(next), static_cast<uint32_t>(next));
+            ++next;
+        }
+    }
+
+    stats.events = next;
+    if (next >= events.size()) {
+        stats.wallUs = clock.nsecsElapsed() / 1000;
+        emit finished();
+        return;
+    }
+
+    const qint64 waitUs = dueUs(next) - clock.nsecsElapsed() / 1000;
+    timer->start(static_cast<int>(std::max<qint64>(0, (waitUs + 999) / 1000)));
+}
+
+/**
+ * @brief Calls the Core callback of a recorded event with a generated payload.
+ * @param core Core to feed, the Core loop lock must be held.
+ * @param event Recorded event.
+ * @param sequence Replay position, used as NGC message id so messages don't look repeated.
+ */
+void ToxEventReplayer::dispatch(Core& core, const ToxEventRecorder::Event& event,
+                                uint32_t sequence)
+{
+    using Type = ToxEventRecorder::Type;
+
+    QByteArray payload = event.header.left(static_cast<int>(event.length));
+    payload.append(QByteArray(static_cast<int>(event.length) - payload.size(),
+                              event.header.isEmpty() ? 'x' : '\0'));
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.constData());
+    const size_t length = static_cast<size_t>(payload.size());
+    Tox* tox = core.tox.get();
+
+    switch (event.type) {
+    case Type::SelfConnection:
+        Core::onSelfConnectionStatusChanged(tox, static_cast<Tox_Connection>(event.value), &core);
+        break;
+    case Type::FriendConnection:
+        Core::onConnectionStatusChanged(tox, event.target,
+                                        static_cast<Tox_Connection>(event.value), &core);
+        break;
+    case Type::FriendStatus:
+        Core::onUserStatusChanged(tox, event.target, static_cast<Tox_User_Status>(event.value),
+                                  &core);
+        break;
+    case Type::FriendName:
+        Core::onFriendNameChange(tox, event.target, data, length, &core);
+        break;
+    case Type::FriendStatusMessage:
+        Core::onStatusMessageChanged(tox, event.target, data, length, &core);
+        break;
+    case Type::FriendTyping:
+        Core::onFriendTypingChange(tox, event.target, event.value != 0, &core);
+        break;
+    case Type::FriendMessage:
+        Core::onFriendMessage(tox, event.target, static_cast<Tox_Message_Type>(event.value), data,
+                              length, &core);
+        break;
+    case Type::ReadReceipt:
+        Core::onReadReceiptCallback(tox, event.target, event.value, &core);
+        break;
+    case Type::LosslessPacket:
+        Core::onLosslessPacket(tox, event.target, data, length, &core);
+        break;
+    case Type::ConferenceMessage:
+        Core::onGroupMessage(tox, event.target, event.peer,
+                             static_cast<Tox_Message_Type>(event.value), data, length, &core);
+        break;
+    case Type::NgcPeerJoin:
+        Core::onNgcPeerJoin(tox, event.target, event.peer, &core);
+        break;
+    case Type::NgcPeerExit:
+        Core::onNgcPeerExit(tox, event.target, event.peer,
+                            static_cast<Tox_Group_Exit_Type>(event.value), data, length, nullptr, 0,
+                            &core);
+        break;
+    case Type::NgcPeerName:
+        Core::onNgcPeerName(tox, event.target, event.peer, data, length, &core);
+        break;
+    case Type::NgcMessage:
+        Core::onNgcGroupMessage(tox, event.target, event.peer,
+                                static_cast<Tox_Message_Type>(event.value), data, length, sequence,
+                                &core);
+        break;
+    case Type::NgcPrivateMessage:
+        Core::onNgcGroupPrivateMessage(tox, event.target, event.peer,
+                                       static_cast<Tox_Message_Type>(event.value), data, length,
+                                       &core);
+        break;
+    case Type::NgcCustomPacket:
+        Core::onNgcGroupCustomPacket(tox, event.target, event.peer, data, length, &core);
+        break;
+    case Type::NgcCustomPrivatePacket:
+        Core::onNgcGroupCustomPrivatePacket(tox, event.target, event.peer, data, length, &core);
+        break;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "toxeventrecorder.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+class Core;
+class QTimer;
+
+class ToxEventReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats
+    {
+        int events;
+        qint64 wallUs;
+        // how far the latest event fell behind its scheduled time
+        qint64 maxLagUs;
+    };
+
+    ToxEventReplayer(Core& core_, QVector<ToxEventRecorder::Event> events_, double speed_);
+
+    void start();
+    Stats getStats() const;
+
+    static void dispatch(Core& core, const ToxEventRecorder::Event& event, uint32_t sequence);
+
+    static constexpr int MAX_BATCH_EVENTS = 256;
+
+signals:
+    void finished();
+
+private slots:
+    void replayDue();
+
+private:
+    qint64 dueUs(int index) const;
+
+private:
+    Core& core;
+    const QVector<ToxEventRecorder::Event> events;
+    const double speed;
+    QTimer* timer;
+    QElapsedTimer clock;
+    int next = 0;
+    Stats stats{0, 0, 0};
+};
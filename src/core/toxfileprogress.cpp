@@ -21,6 +21,8 @@
 
 #include <limits>
 
+constexpr int ToxFileProgress::REPORT_PERIOD_MS;
+
 ToxFileProgress::ToxFileProgress(uint64_t filesize_, int samplePeriodMs_)
     : filesize(filesize_)
     , samplePeriodMs(samplePeriodMs_)
@@ -79,6 +81,25 @@ bool ToxFileProgress::addSample(uint64_t bytesSent, QTime now)
     return true;
 }
 
+/**
+ * @brief Decides whether progress should be shown, at most every REPORT_PERIOD_MS per file.
+ * @param now Time of the latest sample.
+ * @return True for the first and the completing sample and once per period otherwise, the
+ * report is then counted as done.
+ */
+bool ToxFileProgress::shouldReport(QTime now)
+{
+    const bool complete = samples[activeSample].bytesSent == filesize;
+    // a clock that went backwards reports right away instead of staying silent
+    if (!complete && lastReport.isValid() && now >= lastReport
+        && lastReport.msecsTo(now) < REPORT_PERIOD_MS) {
+        return false;
+    }
+
+    lastReport = now;
+    return true;
+}
+
 void ToxFileProgress::resetSpeed()
 {
     for (auto& sample : samples) {
@@ -30,6 +30,7 @@ public:
 
     QTime lastSampleTime() const;
     bool addSample(uint64_t bytesSent, QTime now = QTime::currentTime());
+    bool shouldReport(QTime now = QTime::currentTime());
     void resetSpeed();
 
     uint64_t getBytesSent() const;
@@ -38,6 +39,8 @@ public:
     double getSpeed() const;
     double getTimeLeftSeconds() const;
 
+    static constexpr int REPORT_PERIOD_MS = 100;
+
 private:
     // Should never be modified, but do not want to lose assignment operators
     uint64_t filesize;
@@ -51,4 +54,5 @@ private:
 
     std::array<Sample, 2> samples;
     uint8_t activeSample = 0;
+    QTime lastReport;
 };
@@ -22,6 +22,7 @@
 #include <tox/tox.h>
 
 #include <QDebug>
+#include <QLoggingCategory>
 #include <QRegularExpression>
 #include <QString>
 #include <QStringBuilder>
@@ -29,10 +30,13 @@
 namespace ToxLogger {
 namespace {
 
+// toxcore logs a lot from the tox thread, disable with AsyncLogger::setLogLevels()
+Q_LOGGING_CATEGORY(toxcoreLog, "tox.core")
+
 QByteArray cleanPath(const char *file)
 {
     // for privacy, make the path relative to the c-toxcore source directory
-    const QRegularExpression pathCleaner(QLatin1String{"[\\s|\\S]*c-toxcore."});
+    static const QRegularExpression pathCleaner(QLatin1String{"[\\s|\\S]*c-toxcore."});
     QByteArray cleanedPath = QString::fromUtf8(file).remove(pathCleaner).toUtf8();
     cleanedPath.append('\0');
     return cleanedPath;
@@ -49,22 +53,43 @@ void onLogMessage(Tox *tox, Tox_Log_Level level, const char *file, uint32_t line
 {
     std::ignore = tox;
     std::ignore = user_data;
-    const QByteArray cleanedPath = cleanPath(file);
-
+    QtMsgType type = QtDebugMsg;
     switch (level) {
     case TOX_LOG_LEVEL_TRACE:
         return; // trace level generates too much noise to enable by default
     case TOX_LOG_LEVEL_DEBUG:
-        QMessageLogger(cleanedPath.data(), line, func).debug() << message;
+        type = QtDebugMsg;
         break;
     case TOX_LOG_LEVEL_INFO:
-        QMessageLogger(cleanedPath.data(), line, func).info() << message;
+        type = QtInfoMsg;
         break;
     case TOX_LOG_LEVEL_WARNING:
-        QMessageLogger(cleanedPath.data(), line, func).warning() << message;
+        type = QtWarningMsg;
         break;
     case TOX_LOG_LEVEL_ERROR:
-        QMessageLogger(cleanedPath.data(), line, func).critical() << message;
+        type = QtCriticalMsg;
+        break;
+    }
+
+    // don't even clean the path of disabled messages
+    if (!toxcoreLog().isEnabled(type)) {
+        return;
+    }
+
+    const QByteArray cleanedPath = cleanPath(file);
+    const QMessageLogger logger(cleanedPath.data(), line, func);
+    switch (type) {
+    case QtDebugMsg:
+        logger.debug(toxcoreLog()) << message;
+        break;
+    case QtInfoMsg:
+        logger.info(toxcoreLog()) << message;
+        break;
+    case QtWarningMsg:
+        logger.warning(toxcoreLog()) << message;
+        break;
+    default:
+        logger.critical(toxcoreLog()) << message;
         break;
     }
 }
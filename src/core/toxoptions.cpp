@@ -155,3 +155,13 @@ void ToxOptions::setIPv6Enabled(bool enabled)
 {
     tox_options_set_ipv6_enabled(options, enabled);
 }
+
+/**
+ * @brief Binds UDP to a single port instead of the first free one of toxcore's default range.
+ * @param port The port to bind, 0 to use the default range again.
+ */
+void ToxOptions::setUdpPort(quint16 port)
+{
+    tox_options_set_start_port(options, port);
+    tox_options_set_end_port(options, port);
+}
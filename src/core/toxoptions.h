@@ -20,6 +20,7 @@
 #pragma once
 
 #include <QByteArray>
+#include <QtGlobal>
 
 #include <memory>
 
@@ -37,6 +38,7 @@ public:
                                                       const ICoreSettings& s);
     bool getIPv6Enabled() const;
     void setIPv6Enabled(bool enabled);
+    void setUdpPort(quint16 port);
 
 private:
     ToxOptions(Tox_Options* options_, const QByteArray& proxyAddrData_);
@@ -56,7 +56,7 @@ ToxPk::ToxPk(const QByteArray& rawId)
  * ToxPk::size from the specified buffer.
  */
 ToxPk::ToxPk(const uint8_t* rawId)
-    : ChatId(QByteArray(reinterpret_cast<const char*>(rawId), size))
+    : ChatId(rawId, size)
 {
 }
 
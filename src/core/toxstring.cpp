@@ -20,52 +20,185 @@
 #include "toxstring.h"
 
 #include <QByteArray>
+#include <QChar>
 #include <QString>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <vector>
 
 /**
  * @class ToxString
  * @brief Helper to convert safely between strings in the c-toxcore representation and QString.
+ *
+ * Text from c-toxcore is only viewed, not copied, so decoding a callback argument allocates
+ * nothing but the resulting QString. Text to send is encoded into a buffer each thread reuses,
+ * as long as no other ToxString of the same thread holds it, otherwise it gets its own
+ * QByteArray. A ToxString made from a pointer must not outlive the memory it points to.
  */
 
+constexpr int ToxString::MAX_BUFFERED_LENGTH;
+
+struct ToxString::EncodeBuffer
+{
+    std::vector<uint8_t> bytes;
+    bool inUse = false;
+};
+
+namespace {
+/**
+ * @brief Encodes UTF-16 as UTF-8 like QString::toUtf8, unpaired surrogates become '?'.
+ * @param text Text to encode.
+ * @param out Destination with room for 3 bytes per UTF-16 code unit.
+ * @return Number of bytes written.
+ */
+size_t encodeUtf8(const QString& text, uint8_t* out)
+{
+    const ushort* in = text.utf16();
+    const int count = text.size();
+    uint8_t* cursor = out;
+
+    for (int i = 0; i < count; ++i) {
+        uint32_t c = in[i];
+        if (c < 0x80) {
+            *cursor++ = static_cast<uint8_t>(c);
+        } else if (c < 0x800) {
+            *cursor++ = static_cast<uint8_t>(0xC0 | (c >> 6));
+            *cursor++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        } else if (QChar::isHighSurrogate(c) && i + 1 < count && QChar::isLowSurrogate(in[i + 1])) {
+            c = QChar::surrogateToUcs4(static_cast<ushort>(c), in[++i]);
+            *cursor++ = static_cast<uint8_t>(0xF0 | (c >> 18));
+            *cursor++ = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3F));
+            *cursor++ = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+            *cursor++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        } else if (QChar::isSurrogate(c)) {
+            *cursor++ = '?';
+        } else {
+            *cursor++ = static_cast<uint8_t>(0xE0 | (c >> 12));
+            *cursor++ = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+            *cursor++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        }
+    }
+
+    return static_cast<size_t>(cursor - out);
+}
+} // namespace
+
 /**
  * @brief Creates a ToxString from a QString.
  * @param string Input text.
  */
-ToxString::ToxString(const QString& text)
-    : ToxString(text.toUtf8())
+ToxString::ToxString(const QString& text_)
 {
+    EncodeBuffer& threadEncodeBuffer = threadBuffer();
+    if (threadEncodeBuffer.inUse || text_.size() > MAX_BUFFERED_LENGTH) {
+        string = text_.toUtf8();
+        text = reinterpret_cast<const uint8_t*>(string.constData());
+        length = string.size();
+        return;
+    }
+
+    // only grows, a single 0 byte on top keeps data() null terminated like QByteArray
+    std::vector<uint8_t>& bytes = threadEncodeBuffer.bytes;
+    bytes.resize(std::max(bytes.size(), static_cast<size_t>(text_.size()) * 3 + 1));
+    length = encodeUtf8(text_, bytes.data());
+    bytes[length] = 0;
+    text = bytes.data();
+    threadEncodeBuffer.inUse = true;
+    buffer = &threadEncodeBuffer;
 }
 
 /**
  * @brief Creates a ToxString from bytes in a QByteArray.
  * @param text Input text.
  */
-ToxString::ToxString(const QByteArray& text)
-    : string(text)
+ToxString::ToxString(const QByteArray& text_)
+    : string(text_)
+    , text{reinterpret_cast<const uint8_t*>(string.constData())}
+    , length{static_cast<size_t>(string.size())}
 {
 }
 
 /**
- * @brief Creates a ToxString from the representation used by c-toxcore.
- * @param text Pointer to the beginning of the text.
+ * @brief Creates a ToxString from the representation used by c-toxcore, without copying it.
+ * @param text Pointer to the beginning of the text, must stay valid while the ToxString is used.
  * @param length Number of bytes to read from the beginning.
  */
-ToxString::ToxString(const uint8_t* text, size_t length)
+ToxString::ToxString(const uint8_t* text_, size_t length_)
 {
-    assert(length <= INT_MAX);
-    string = QByteArray(reinterpret_cast<const char*>(text), length);
+    assert(length_ <= INT_MAX);
+    if (!text_) {
+        text = reinterpret_cast<const uint8_t*>("");
+        return;
+    }
+
+    text = text_;
+    length = length_;
+}
+
+/**
+ * @brief Copies a ToxString, a copy of the thread's buffer gets its own QByteArray.
+ * @param other ToxString to copy.
+ */
+ToxString::ToxString(const ToxString& other)
+{
+    copyFrom(other);
+}
+
+ToxString& ToxString::operator=(const ToxString& other)
+{
+    if (this != &other) {
+        release();
+        copyFrom(other);
+    }
+    return *this;
+}
+
+ToxString::~ToxString()
+{
+    release();
+}
+
+ToxString::EncodeBuffer& ToxString::threadBuffer()
+{
+    thread_local EncodeBuffer encodeBuffer;
+    return encodeBuffer;
+}
+
+void ToxString::copyFrom(const ToxString& other)
+{
+    if (other.buffer) {
+        string = QByteArray(reinterpret_cast<const char*>(other.text), static_cast<int>(other.length));
+        text = reinterpret_cast<const uint8_t*>(string.constData());
+    } else if (other.text == reinterpret_cast<const uint8_t*>(other.string.constData())) {
+        string = other.string;
+        text = reinterpret_cast<const uint8_t*>(string.constData());
+    } else {
+        string = QByteArray();
+        text = other.text;
+    }
+    length = other.length;
+    buffer = nullptr;
+}
+
+void ToxString::release()
+{
+    if (buffer) {
+        buffer->inUse = false;
+        buffer = nullptr;
+    }
 }
 
 /**
  * @brief Returns a pointer to the beginning of the string data.
  * @return Pointer to the beginning of the string data.
+ *
+ * @note Only null terminated if the ToxString was created from a QString or QByteArray.
  */
 const uint8_t* ToxString::data() const
 {
-    return reinterpret_cast<const uint8_t*>(string.constData());
+    return text;
 }
 
 /**
@@ -74,7 +207,7 @@ const uint8_t* ToxString::data() const
  */
 size_t ToxString::size() const
 {
-    return string.size();
+    return length;
 }
 
 /**
@@ -83,7 +216,7 @@ size_t ToxString::size() const
  */
 QString ToxString::getQString() const
 {
-    return QString::fromUtf8(string);
+    return QString::fromUtf8(reinterpret_cast<const char*>(text), static_cast<int>(length));
 }
 
 /**
@@ -92,5 +225,9 @@ QString ToxString::getQString() const
  */
 QByteArray ToxString::getBytes() const
 {
-    return QByteArray(string);
+    if (!buffer && text == reinterpret_cast<const uint8_t*>(string.constData())) {
+        return string;
+    }
+
+    return QByteArray(reinterpret_cast<const char*>(text), static_cast<int>(length));
 }
@@ -30,12 +30,28 @@ public:
     explicit ToxString(const QString& text);
     explicit ToxString(const QByteArray& text);
     ToxString(const uint8_t* text, size_t length);
+    ToxString(const ToxString& other);
+    ToxString& operator=(const ToxString& other);
+    ~ToxString();
 
     const uint8_t* data() const;
     size_t size() const;
     QString getQString() const;
     QByteArray getBytes() const;
 
+    // longer texts are encoded into their own QByteArray instead of the thread's buffer
+    static constexpr int MAX_BUFFERED_LENGTH = 4096;
+
+private:
+    struct EncodeBuffer;
+
+    static EncodeBuffer& threadBuffer();
+    void copyFrom(const ToxString& other);
+    void release();
+
 private:
     QByteArray string;
+    const uint8_t* text = nullptr;
+    size_t length = 0;
+    EncodeBuffer* buffer = nullptr;
 };
@@ -0,0 +1,108 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "voiceactivitydetector.h"
+
+#include <QDebug>
+
+/**
+ * @class VoiceActivityDetector
+ * @brief Decides if a captured audio stream carries speech, for discontinuous transmission.
+ *
+ * Runs the webrtc VAD on every 10ms block of a frame. A frame counts as active if any of its
+ * blocks contains voice, and the stream stays active for HANGOVER_MS after the last voiced
+ * block so word endings and short pauses aren't cut off. While inactive the caller can skip
+ * sending the frame entirely, the receiving side conceals the gap.
+ *
+ * If the VAD can't be set up or a frame can't be analyzed, the stream is considered active,
+ * so audio is never suppressed by mistake.
+ *
+ * @var VoiceActivityDetector::VAD_MODE
+ * @brief Aggressiveness from 0 to 3, higher values report voice less often.
+ */
+
+constexpr int VoiceActivityDetector::VAD_MODE;
+constexpr uint32_t VoiceActivityDetector::HANGOVER_MS;
+
+/**
+ * @brief Creates a detector for one stream.
+ * @param sampleRate_ Sample rate of the stream, 8, 16, 32 or 48kHz.
+ */
+VoiceActivityDetector::VoiceActivityDetector(uint32_t sampleRate_)
+    : vadInst{WebRtcVad_Create()}
+    , sampleRate{sampleRate_}
+    , blockSamples{sampleRate_ / 100}
+{
+    if (!vadInst || WebRtcVad_Init(vadInst) != 0 || WebRtcVad_set_mode(vadInst, VAD_MODE) != 0
+        || WebRtcVad_ValidRateAndFrameLength(static_cast<int>(sampleRate), blockSamples) != 0) {
+        qWarning() << "Failed to initialize voice activity detection at" << sampleRate << "Hz";
+        WebRtcVad_Free(vadInst);
+        vadInst = nullptr;
+    }
+}
+
+VoiceActivityDetector::~VoiceActivityDetector()
+{
+    WebRtcVad_Free(vadInst);
+}
+
+/**
+ * @brief Analyzes the next frame of the stream.
+ * @param pcm Mono samples at the sample rate given to the constructor.
+ * @param samples Number of samples, should be a multiple of 10ms.
+ * @return True if the frame should be sent.
+ */
+bool VoiceActivityDetector::process(const int16_t* pcm, size_t samples)
+{
+    if (!vadInst || samples == 0 || samples % blockSamples != 0) {
+        silentMs = 0;
+        return true;
+    }
+
+    bool voiced = false;
+    for (size_t offset = 0; offset < samples && !voiced; offset += blockSamples) {
+        voiced = WebRtcVad_Process(vadInst, static_cast<int>(sampleRate), pcm + offset,
+                                   blockSamples) == 1;
+    }
+
+    if (voiced) {
+        silentMs = 0;
+    } else if (silentMs < HANGOVER_MS) {
+        silentMs += static_cast<uint32_t>(samples / blockSamples * 10);
+    }
+
+    return isActive();
+}
+
+bool VoiceActivityDetector::isActive() const
+{
+    return silentMs < HANGOVER_MS;
+}
+
+/**
+ * @brief Starts over in the inactive state, e.g. after the microphone was unmuted.
+ */
+void VoiceActivityDetector::reset()
+{
+    silentMs = HANGOVER_MS;
+    if (vadInst) {
+        WebRtcVad_Init(vadInst);
+        WebRtcVad_set_mode(vadInst, VAD_MODE);
+    }
+}
@@ -0,0 +1,48 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "webrtc6/webrtc/common_audio/vad/include/webrtc_vad.h"
+
+#include <cstddef>
+#include <cstdint>
+
+class VoiceActivityDetector
+{
+public:
+    explicit VoiceActivityDetector(uint32_t sampleRate);
+    ~VoiceActivityDetector();
+
+    VoiceActivityDetector(const VoiceActivityDetector&) = delete;
+    VoiceActivityDetector& operator=(const VoiceActivityDetector&) = delete;
+
+    bool process(const int16_t* pcm, size_t samples);
+    bool isActive() const;
+    void reset();
+
+    static constexpr int VAD_MODE = 2;
+    static constexpr uint32_t HANGOVER_MS = 400;
+
+private:
+    VadInst* vadInst = nullptr;
+    const uint32_t sampleRate;
+    const size_t blockSamples;
+    uint32_t silentMs = HANGOVER_MS;
+};
@@ -0,0 +1,357 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "headlesssession.h"
+
+#include "src/core/core.h"
+#include "src/core/coreext.h"
+#include "src/core/toxid.h"
+#include "src/friendlist.h"
+#include "src/grouplist.h"
+#include "src/ipc.h"
+#include "src/model/chathistory.h"
+#include "src/model/friend.h"
+#include "src/model/friendmessagedispatcher.h"
+#include "src/persistence/profile.h"
+#include "src/persistence/settings.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <tox/tox.h>
+
+/**
+ * @class HeadlessMessageBoxManager
+ * @brief Logs the messages meant for the user instead of showing them, answers every question
+ * with its default answer.
+ */
+
+/**
+ * @class HeadlessSession
+ * @brief Runs a profile without any widgets, for bots and relays.
+ *
+ * Keeps what Widget does for the chats without their forms: it connects Core to a
+ * FriendMessageDispatcher and a ChatHistory per friend, so received messages are stored in the
+ * history and the offline messages are sent once a friend comes online. Groups, calls and file
+ * transfers aren't handled.
+ *
+ * The session is controlled by the commands qTox --control posts over IPC, see runCommand().
+ * It owns the profile and destroys it last.
+ *
+ * One process can host more sessions next to the one of its current profile, see --host-profile.
+ * A hosted session only receives the commands sent to its own profile with -p.
+ */
+
+const QString HeadlessSession::controlEventKey = QStringLiteral("control");
+
+namespace {
+constexpr int negotiationTimeoutMs = 1000;
+
+ToxPk parsePk(const QString& pk)
+{
+    return pk.length() == ToxPk::numHexChars ? ToxPk{pk} : ToxPk{};
+}
+} // namespace
+
+void HeadlessMessageBoxManager::showInfo(const QString& title, const QString& msg)
+{
+    qInfo() << title << msg;
+}
+
+void HeadlessMessageBoxManager::showWarning(const QString& title, const QString& msg)
+{
+    qWarning() << title << msg;
+}
+
+void HeadlessMessageBoxManager::showError(const QString& title, const QString& msg)
+{
+    qCritical() << title << msg;
+}
+
+bool HeadlessMessageBoxManager::askQuestion(const QString& title, const QString& msg,
+                                            bool defaultAns, bool warning, bool yesno)
+{
+    std::ignore = warning;
+    std::ignore = yesno;
+    qWarning() << title << msg << "answered" << defaultAns;
+    return defaultAns;
+}
+
+bool HeadlessMessageBoxManager::askQuestion(const QString& title, const QString& msg,
+                                            const QString& button1, const QString& button2,
+                                            bool defaultAns, bool warning)
+{
+    std::ignore = warning;
+    qWarning() << title << msg << "answered" << (defaultAns ? button1 : button2);
+    return defaultAns;
+}
+
+void HeadlessMessageBoxManager::confirmExecutableOpen(const QFileInfo& file)
+{
+    qWarning() << "Not opening" << file.filePath() << "in headless mode";
+}
+
+HeadlessSession::HeadlessSession(Profile* profile_, Settings& settings_, IPC& ipc_, bool hosted_)
+    : profile{profile_}
+    , settings{settings_}
+    , ipc{ipc_}
+    , hosted{hosted_}
+    , core{&profile->getCore()}
+    , friendList{new FriendList()}
+    , groupList{new GroupList()}
+{
+    sharedMessageProcessorParams.reset(new MessageProcessor::SharedParams(
+        static_cast<uint64_t>(TOX_MSGV3_MAX_MESSAGE_LENGTH),
+        core->getExt()->getMaxExtendedMessageSize()));
+    sharedMessageProcessorParams->setPublicKey(core->getSelfPublicKey().toString());
+
+    connect(core, &Core::friendAdded, this, &HeadlessSession::addFriend);
+    connect(core, &Core::failedToAddFriend, this, &HeadlessSession::onFailedToAddFriend);
+    connect(core, &Core::friendStatusChanged, this, &HeadlessSession::onFriendStatusChanged);
+    connect(core, &Core::friendMessageReceived, this, &HeadlessSession::onFriendMessageReceived);
+    connect(core, &Core::receiptRecieved, this, &HeadlessSession::onReceiptReceived);
+    connect(core, &Core::friendMessageSent, this, &HeadlessSession::onFriendMessageSent);
+    connect(core, &Core::friendMessagesRefused, this, &HeadlessSession::onFriendMessagesRefused);
+    connect(core, &Core::friendRequestReceived, this, &HeadlessSession::onFriendRequestReceived);
+    connect(core, &Core::usernameSet, this, [this](const QString& username) {
+        sharedMessageProcessorParams->onUserNameSet(username);
+    });
+
+    CoreExt* coreExt = core->getExt();
+    connect(coreExt, &CoreExt::extendedMessageReceived, this,
+            &HeadlessSession::onExtMessageReceived);
+    connect(coreExt, &CoreExt::extendedReceiptReceived, this,
+            &HeadlessSession::onExtReceiptReceived);
+    connect(coreExt, &CoreExt::extendedMessageSupport, this,
+            &HeadlessSession::onExtendedMessageSupport);
+}
+
+HeadlessSession::~HeadlessSession()
+{
+    if (hosted) {
+        ipc.unregisterProfileEventHandler(controlEventKey,
+                                          Settings::makeProfileId(profile->getName()));
+    } else {
+        ipc.unregisterEventHandler(controlEventKey);
+    }
+    negotiateTimers.clear();
+    // the chat logs and dispatchers reference the friends
+    friendChatLogs.clear();
+    friendMessageDispatchers.clear();
+    friendList->clear();
+}
+
+/**
+ * @brief Starts Core and accepts control commands.
+ */
+void HeadlessSession::start()
+{
+    if (ipc.isAttached() && hosted) {
+        ipc.registerProfileEventHandler(controlEventKey,
+                                        Settings::makeProfileId(profile->getName()),
+                                        &HeadlessSession::controlEventHandler, this);
+    } else if (ipc.isAttached()) {
+        ipc.registerEventHandler(controlEventKey, &HeadlessSession::controlEventHandler, this);
+    } else {
+        qWarning() << "IPC is not available, the headless session can't be controlled";
+    }
+
+    profile->startCore();
+    qInfo() << "Headless session started, Tox ID" << core->getSelfId().toString();
+}
+
+/**
+ * @brief Runs a control command.
+ * @param command One of
+ * - "add <Tox ID> [message]" sends a friend request,
+ * - "accept <public key>" accepts a friend request,
+ * - "message <public key> <text>" sends a message, it is kept as offline message until the
+ *   friend receives it,
+ * - "status" logs the Tox ID and the online friends,
+ * - "quit" exits qTox.
+ * @return False if the command is invalid.
+ */
+bool HeadlessSession::runCommand(const QString& command)
+{
+    const QString verb = command.section(QLatin1Char(' '), 0, 0);
+    const QString arg = command.section(QLatin1Char(' '), 1, 1);
+    const QString rest = command.section(QLatin1Char(' '), 2);
+
+    if (verb == QLatin1String("quit")) {
+        QCoreApplication::quit();
+        return true;
+    }
+
+    if (verb == QLatin1String("status")) {
+        int online = 0;
+        for (const Friend* f : friendList->getAllFriends()) {
+            online += Status::isOnline(f->getStatus()) ? 1 : 0;
+        }
+        qInfo() << "Tox ID" << core->getSelfId().toString() << "," << online << "of"
+                << friendList->getAllFriends().size() << "friends online";
+        return true;
+    }
+
+    if (verb == QLatin1String("add")) {
+        if (!ToxId::isValidToxId(arg)) {
+            qWarning() << "Invalid Tox ID" << arg;
+            return false;
+        }
+        core->requestFriendship(ToxId{arg}, rest);
+        return true;
+    }
+
+    const ToxPk friendPk = parsePk(arg);
+    if (friendPk.isEmpty()) {
+        qWarning() << "Invalid control command" << verb;
+        return false;
+    }
+
+    if (verb == QLatin1String("accept")) {
+        core->acceptFriendRequest(friendPk);
+        return true;
+    }
+
+    if (verb == QLatin1String("message") && !rest.isEmpty()) {
+        const auto it = friendMessageDispatchers.find(friendPk);
+        if (it == friendMessageDispatchers.end()) {
+            qWarning() << "Can't send a message to" << arg << ", it isn't a friend";
+            return false;
+        }
+        it.value()->sendMessage(false, rest);
+        return true;
+    }
+
+    qWarning() << "Invalid control command" << verb;
+    return false;
+}
+
+bool HeadlessSession::controlEventHandler(const QByteArray& data, void* userData)
+{
+    return static_cast<HeadlessSession*>(userData)->runCommand(QString::fromUtf8(data));
+}
+
+FriendMessageDispatcher* HeadlessSession::findDispatcher(uint32_t friendId)
+{
+    const auto it = friendMessageDispatchers.find(friendList->id2Key(friendId));
+    return it == friendMessageDispatchers.end() ? nullptr : it.value().get();
+}
+
+void HeadlessSession::addFriend(uint32_t friendId, const ToxPk& friendPk)
+{
+    settings.updateFriendAddress(friendPk.toString());
+    Friend* newfriend = friendList->addFriend(friendId, friendPk, settings);
+
+    auto messageProcessor = MessageProcessor(*sharedMessageProcessorParams);
+    auto friendMessageDispatcher = std::make_shared<FriendMessageDispatcher>(
+        *newfriend, std::move(messageProcessor), *core, *core->getExt());
+    // ChatHistory connects to the dispatcher and stores what it sends and receives
+    auto chatHistory =
+        std::make_shared<ChatHistory>(*newfriend, profile->getHistory(), *core, settings,
+                                      *friendMessageDispatcher, *friendList, *groupList);
+
+    friendMessageDispatchers[friendPk] = friendMessageDispatcher;
+    friendChatLogs[friendPk] = chatHistory;
+}
+
+void HeadlessSession::onFailedToAddFriend(const ToxPk& friendPk, const QString& errorInfo)
+{
+    qWarning() << "Couldn't send friend request to" << friendPk.toString() << errorInfo;
+}
+
+void HeadlessSession::onFriendStatusChanged(uint32_t friendId, Status::Status status)
+{
+    const ToxPk& friendPk = friendList->id2Key(friendId);
+    Friend* f = friendList->findFriend(friendPk);
+    if (!f) {
+        return;
+    }
+
+    const auto oldStatus = f->getStatus();
+    f->setStatus(status);
+    const auto newStatus = f->getStatus();
+
+    // the dispatcher sends the offline messages once the negotiation is complete
+    if (newStatus == Status::Status::Negotiating && oldStatus != newStatus) {
+        auto negotiateTimer = std::unique_ptr<QTimer>(new QTimer);
+        negotiateTimer->setSingleShot(true);
+        negotiateTimer->setInterval(negotiationTimeoutMs);
+        connect(negotiateTimer.get(), &QTimer::timeout, f, &Friend::onNegotiationComplete);
+        negotiateTimer->start();
+        negotiateTimers[friendPk] = std::move(negotiateTimer);
+    }
+}
+
+void HeadlessSession::onFriendMessageReceived(uint32_t friendId, const QString& message,
+                                              bool isAction, int hasIdType)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onMessageReceived(isAction, message, hasIdType);
+    }
+}
+
+void HeadlessSession::onReceiptReceived(int friendId, ReceiptNum receipt)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onReceiptReceived(receipt);
+    }
+}
+
+void HeadlessSession::onFriendMessageSent(uint32_t friendId, uint64_t queuedId, ReceiptNum receipt)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onCoreMessageSent(queuedId, receipt);
+    }
+}
+
+void HeadlessSession::onFriendMessagesRefused(uint32_t friendId, const QVector<uint64_t>& queuedIds)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onCoreMessagesRefused(queuedIds);
+    }
+}
+
+void HeadlessSession::onFriendRequestReceived(const ToxPk& friendPk, const QString& message)
+{
+    qInfo() << "Friend request from" << friendPk.toString() << ":" << message;
+}
+
+void HeadlessSession::onExtMessageReceived(uint32_t friendId, const QString& message)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onExtMessageReceived(message);
+    }
+}
+
+void HeadlessSession::onExtReceiptReceived(uint32_t friendId, uint64_t receiptId)
+{
+    if (FriendMessageDispatcher* dispatcher = findDispatcher(friendId)) {
+        dispatcher->onExtReceiptReceived(receiptId);
+    }
+}
+
+void HeadlessSession::onExtendedMessageSupport(uint32_t friendId, bool supported)
+{
+    Friend* f = friendList->findFriend(friendList->id2Key(friendId));
+    if (f) {
+        f->setExtendedMessageSupport(supported);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "src/core/receiptnum.h"
+#include "src/core/toxpk.h"
+#include "src/model/message.h"
+#include "src/model/status.h"
+#include "src/widget/tool/imessageboxmanager.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+#include <map>
+#include <memory>
+
+class ChatHistory;
+class Core;
+class FriendList;
+class FriendMessageDispatcher;
+class GroupList;
+class IPC;
+class Profile;
+class QTimer;
+class Settings;
+
+class HeadlessMessageBoxManager : public IMessageBoxManager
+{
+public:
+    void showInfo(const QString& title, const QString& msg) override;
+    void showWarning(const QString& title, const QString& msg) override;
+    void showError(const QString& title, const QString& msg) override;
+    bool askQuestion(const QString& title, const QString& msg, bool defaultAns = false,
+                     bool warning = true, bool yesno = true) override;
+    bool askQuestion(const QString& title, const QString& msg, const QString& button1,
+                     const QString& button2, bool defaultAns = false, bool warning = true) override;
+    void confirmExecutableOpen(const QFileInfo& file) override;
+};
+
+class HeadlessSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    HeadlessSession(Profile* profile_, Settings& settings_, IPC& ipc_, bool hosted_ = false);
+    ~HeadlessSession() override;
+    void start();
+    bool runCommand(const QString& command);
+
+    static const QString controlEventKey;
+
+private slots:
+    void addFriend(uint32_t friendId, const ToxPk& friendPk);
+    void onFailedToAddFriend(const ToxPk& friendPk, const QString& errorInfo);
+    void onFriendStatusChanged(uint32_t friendId, Status::Status status);
+    void onFriendMessageReceived(uint32_t friendId, const QString& message, bool isAction,
+                                 int hasIdType);
+    void onReceiptReceived(int friendId, ReceiptNum receipt);
+    void onFriendMessageSent(uint32_t friendId, uint64_t queuedId, ReceiptNum receipt);
+    void onFriendMessagesRefused(uint32_t friendId, const QVector<uint64_t>& queuedIds);
+    void onFriendRequestReceived(const ToxPk& friendPk, const QString& message);
+    void onExtMessageReceived(uint32_t friendId, const QString& message);
+    void onExtReceiptReceived(uint32_t friendId, uint64_t receiptId);
+    void onExtendedMessageSupport(uint32_t friendId, bool supported);
+
+private:
+    static bool controlEventHandler(const QByteArray& data, void* userData);
+    FriendMessageDispatcher* findDispatcher(uint32_t friendId);
+
+    std::unique_ptr<Profile> profile;
+    Settings& settings;
+    IPC& ipc;
+    const bool hosted;
+    Core* core = nullptr;
+    std::unique_ptr<FriendList> friendList;
+    std::unique_ptr<GroupList> groupList;
+    std::unique_ptr<MessageProcessor::SharedParams> sharedMessageProcessorParams;
+    QHash<ToxPk, std::shared_ptr<FriendMessageDispatcher>> friendMessageDispatchers;
+    QHash<ToxPk, std::shared_ptr<ChatHistory>> friendChatLogs;
+    std::map<ToxPk, std::unique_ptr<QTimer>> negotiateTimers;
+};
@@ -20,7 +20,9 @@
 #include "src/ipc.h"
 #include <QCoreApplication>
 #include <QDebug>
+#include <QLocalSocket>
 #include <QThread>
+#include <QVector>
 
 #include <chrono>
 #include <ctime>
@@ -64,9 +66,19 @@ namespace
  * @brief When processEvents() ran last time
  */
 
+/**
+ * @var uint64_t IPC::instances
+ * @brief Global IDs of all running instances, 0 for a free entry.
+ */
+
 /**
  * @class IPC
  * @brief Inter-process communication
+ *
+ * Events are posted into a shared memory table. Every instance also listens on a local socket
+ * named after its global ID and registers that ID in the shared memory, the poster then connects
+ * to all registered instances to wake them up. Instances don't poll the table, so an idle qTox
+ * doesn't wake up for IPC at all.
  */
 
 IPC::IPC(uint32_t profileId_)
@@ -75,15 +87,16 @@ IPC::IPC(uint32_t profileId_)
 {
     qRegisterMetaType<IPCEventHandler>("IPCEventHandler");
 
+    // only used to retry when the shared memory couldn't be locked
     timer.setInterval(EVENT_TIMER_MS);
     timer.setSingleShot(true);
     connect(&timer, &QTimer::timeout, this, &IPC::processEvents);
+    connect(&server, &QLocalServer::newConnection, this, &IPC::onNotified);
 
     // The first started instance gets to manage the shared memory by taking ownership
-    // Every time it processes events it updates the global shared timestamp "lastProcessed"
-    // If the timestamp isn't updated, that's a timeout and someone else can take ownership
-    // This is a safety measure, in case one of the clients crashes
-    // If the owner exits normally, it can set the timestamp to 0 first to immediately give
+    // If the owner's local socket can't be connected to, it crashed and someone else can take
+    // ownership
+    // If the owner exits normally, it sets the owner ID to 0 first to immediately give
     // ownership
 
     // use the clock rather than std::random_device because std::random_device may return constant values, and does
@@ -110,6 +123,17 @@ IPC::IPC(uint32_t profileId_)
         return; // We won't be able to do any IPC without being attached, let's get outta here
     }
 
+    const QString serverName = instanceServerName(globalId);
+    QLocalServer::removeServer(serverName);
+    if (server.listen(serverName)) {
+        if (globalMemory.lock()) {
+            registerInstance();
+            globalMemory.unlock();
+        }
+    } else {
+        qWarning() << "Failed to listen for IPC notifications:" << server.errorString();
+    }
+
     processEvents();
 }
 
@@ -120,10 +144,23 @@ IPC::~IPC()
         return;
     }
 
-    if (isCurrentOwnerNoLock()) {
-        global()->globalId = 0;
+    IPCMemory* mem = global();
+    for (uint64_t& instance : mem->instances) {
+        if (instance == globalId) {
+            instance = 0;
+        }
+    }
+
+    const bool wasOwner = isCurrentOwnerNoLock();
+    if (wasOwner) {
+        mem->globalId = 0;
     }
     globalMemory.unlock();
+
+    if (wasOwner) {
+        // let one of the other instances take ownership right away
+        notifyInstances();
+    }
 }
 
 /**
@@ -149,6 +186,8 @@ time_t IPC::postEvent(const QString& name, const QByteArray& data, uint32_t dest
         return 0;
     }
 
+    collectGarbage();
+
     IPCEvent* evt = nullptr;
     IPCMemory* mem = global();
     time_t result = 0;
@@ -170,6 +209,10 @@ time_t IPC::postEvent(const QString& name, const QByteArray& data, uint32_t dest
     }
 
     globalMemory.unlock();
+
+    if (result) {
+        notifyInstances();
+    }
     return result;
 }
 
@@ -201,6 +244,37 @@ void IPC::unregisterEventHandler(const QString& name)
     eventHandlers.remove(name);
 }
 
+/**
+ * @brief Registers a handler for the events sent to one profile only.
+ * @param dest Profile id, see Settings::makeProfileId.
+ *
+ * A headless relay host runs several profiles, this lets each of them receive the events sent
+ * to it next to the profile the IPC was created for. Global events still go to the handlers of
+ * registerEventHandler().
+ */
+void IPC::registerProfileEventHandler(const QString& name, uint32_t dest,
+                                      IPCEventHandler handler, void* userData)
+{
+    const std::lock_guard<std::mutex> lock(eventHandlersMutex);
+    const auto key = qMakePair(name, dest);
+    if (!profileEventHandlers.contains(key)) {
+        ++hostedProfiles[dest];
+    }
+    profileEventHandlers[key] = {handler, userData};
+}
+
+void IPC::unregisterProfileEventHandler(const QString& name, uint32_t dest)
+{
+    const std::lock_guard<std::mutex> lock(eventHandlersMutex);
+    if (profileEventHandlers.remove(qMakePair(name, dest)) == 0) {
+        return;
+    }
+
+    if (--hostedProfiles[dest] == 0) {
+        hostedProfiles.remove(dest);
+    }
+}
+
 bool IPC::isEventAccepted(time_t time)
 {
     bool result = false;
@@ -208,13 +282,12 @@ bool IPC::isEventAccepted(time_t time)
         return result;
     }
 
-    if (difftime(global()->lastProcessed, time) > 0) {
-        IPCMemory* mem = global();
-        for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; ++i) {
-            if (mem->events[i].posted == time && mem->events[i].processed) {
-                result = mem->events[i].accepted;
-                break;
-            }
+    // events are processed as soon as they are posted, lastProcessed may still equal the post time
+    IPCMemory* mem = global();
+    for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; ++i) {
+        if (mem->events[i].posted == time && mem->events[i].processed) {
+            result = mem->events[i].accepted;
+            break;
         }
     }
     globalMemory.unlock();
@@ -234,7 +307,7 @@ bool IPC::waitUntilAccepted(time_t postTime, int32_t timeout /*=-1*/)
         }
 
         qApp->processEvents();
-        QThread::msleep(0);
+        QThread::msleep(10);
     }
     return result;
 }
@@ -255,20 +328,14 @@ void IPC::setProfileId(uint32_t profileId_)
  */
 IPC::IPCEvent* IPC::fetchEvent()
 {
+    collectGarbage();
+
     IPCMemory* mem = global();
     for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; ++i) {
         IPCEvent* evt = &mem->events[i];
-
-        // Garbage-collect events that were not processed in EVENT_GC_TIMEOUT
-        // and events that were processed and EVENT_GC_TIMEOUT passed after
-        // so sending instance has time to react to those events.
-        if ((evt->processed && difftime(time(nullptr), evt->processed) > EVENT_GC_TIMEOUT)
-            || (!evt->processed && difftime(time(nullptr), evt->posted) > EVENT_GC_TIMEOUT)) {
-            memset(evt, 0, sizeof(IPCEvent));
-        }
-
         if (evt->posted && !evt->processed && evt->sender != getpid()
-            && (evt->dest == profileId || (evt->dest == 0 && isCurrentOwnerNoLock()))) {
+            && (evt->dest == profileId || hostedProfiles.contains(evt->dest)
+                || (evt->dest == 0 && isCurrentOwnerNoLock()))) {
             return evt;
         }
     }
@@ -303,13 +370,16 @@ void IPC::processEvents()
         // We're the owner, let's process those events
         mem->lastProcessed = time(nullptr);
     } else {
-        // Only the owner processes events. But if the previous owner's dead, we can take
-        // ownership now
-        if (difftime(time(nullptr), mem->lastProcessed) >= OWNERSHIP_TIMEOUT_S) {
-            qDebug() << "Previous owner timed out, taking ownership" << mem->globalId << "->"
+        // Only the owner processes events. But if the previous owner exited or is dead, we can
+        // take ownership now
+        if (mem->globalId == 0 || !isInstanceAlive(mem->globalId)) {
+            qDebug() << "Previous owner is gone, taking ownership" << mem->globalId << "->"
                      << globalId;
+            if (mem->globalId != 0) {
+                QLocalServer::removeServer(instanceServerName(mem->globalId));
+            }
             // Ignore events that were not meant for this instance
-            memset(mem, 0, sizeof(IPCMemory));
+            memset(mem->events, 0, sizeof(mem->events));
             mem->globalId = globalId;
             mem->lastProcessed = time(nullptr);
         }
@@ -319,8 +389,19 @@ void IPC::processEvents()
     const std::lock_guard<std::mutex> lock(eventHandlersMutex);
     while (IPCEvent* evt = fetchEvent()) {
         QString name = QString::fromUtf8(evt->name);
-        auto it = eventHandlers.find(name);
-        if (it != eventHandlers.end()) {
+        auto it = eventHandlers.end();
+        auto profileIt = profileEventHandlers.find(qMakePair(name, evt->dest));
+        if (profileIt != profileEventHandlers.end()) {
+            evt->accepted =
+                runEventHandler(profileIt.value().handler, evt->data, profileIt.value().userData);
+            qDebug() << "Processed event:" << name << "for profile" << evt->dest
+                     << "accepted:" << evt->accepted;
+            evt->processed = time(nullptr);
+        } else if (evt->dest != profileId && evt->dest != 0) {
+            // hosted profile without a handler for it, don't fall back to the current profile
+            qDebug() << "Received event:" << name << "without handler for profile" << evt->dest;
+            evt->processed = time(nullptr);
+        } else if ((it = eventHandlers.find(name)) != eventHandlers.end()) {
             evt->accepted = runEventHandler(it.value().handler, evt->data, it.value().userData);
             qDebug() << "Processed event:" << name << "posted:" << evt->posted
                      << "accepted:" << evt->accepted;
@@ -341,7 +422,120 @@ void IPC::processEvents()
     }
 
     globalMemory.unlock();
-    timer.start();
+}
+
+/**
+ * @brief Another instance posted an event or the owner exited.
+ */
+void IPC::onNotified()
+{
+    while (QLocalSocket* socket = server.nextPendingConnection()) {
+        // the connection itself is the notification
+        socket->disconnectFromServer();
+        socket->deleteLater();
+    }
+
+    processEvents();
+}
+
+/**
+ * @brief Only called when global memory IS LOCKED.
+ *
+ * Garbage-collect events that were not processed in EVENT_GC_TIMEOUT
+ * and events that were processed and EVENT_GC_TIMEOUT passed after
+ * so sending instance has time to react to those events.
+ */
+void IPC::collectGarbage()
+{
+    IPCMemory* mem = global();
+    const time_t now = time(nullptr);
+    for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; ++i) {
+        IPCEvent* evt = &mem->events[i];
+        if ((evt->processed && difftime(now, evt->processed) > EVENT_GC_TIMEOUT)
+            || (evt->posted && !evt->processed && difftime(now, evt->posted) > EVENT_GC_TIMEOUT)) {
+            memset(evt, 0, sizeof(IPCEvent));
+        }
+    }
+}
+
+/**
+ * @brief Only called when global memory IS LOCKED.
+ *
+ * Adds our global ID to the instances woken up by notifyInstances().
+ */
+void IPC::registerInstance()
+{
+    IPCMemory* mem = global();
+    for (uint64_t& instance : mem->instances) {
+        if (instance == 0 || instance == globalId) {
+            instance = globalId;
+            return;
+        }
+    }
+
+    qWarning() << "Too many running instances, this one won't receive IPC events";
+}
+
+/**
+ * @brief Wakes up all other running instances, so they process the event table.
+ *
+ * Instances that can't be reached anymore are removed from the table.
+ */
+void IPC::notifyInstances()
+{
+    if (!globalMemory.lock()) {
+        qWarning() << "Failed to lock in notifyInstances()";
+        return;
+    }
+
+    QVector<uint64_t> instances;
+    for (const uint64_t instance : global()->instances) {
+        if (instance != 0 && instance != globalId) {
+            instances.append(instance);
+        }
+    }
+    globalMemory.unlock();
+
+    QVector<uint64_t> deadInstances;
+    for (const uint64_t instance : instances) {
+        if (!isInstanceAlive(instance)) {
+            deadInstances.append(instance);
+        }
+    }
+
+    if (deadInstances.isEmpty() || !globalMemory.lock()) {
+        return;
+    }
+
+    for (uint64_t& instance : global()->instances) {
+        if (deadInstances.contains(instance)) {
+            qDebug() << "Removing crashed instance" << instance;
+            QLocalServer::removeServer(instanceServerName(instance));
+            instance = 0;
+        }
+    }
+    globalMemory.unlock();
+}
+
+QString IPC::instanceServerName(uint64_t id)
+{
+    return getIpcKey() + "-" + QString::number(id, 16);
+}
+
+/**
+ * @brief Connects to the local socket of an instance, which also wakes it up.
+ * @return False if the instance isn't running anymore.
+ */
+bool IPC::isInstanceAlive(uint64_t id)
+{
+    QLocalSocket socket;
+    socket.connectToServer(instanceServerName(id));
+    if (!socket.waitForConnected(CONNECT_TIMEOUT_MS)) {
+        return false;
+    }
+
+    socket.disconnectFromServer();
+    return true;
 }
 
 /**
@@ -20,7 +20,9 @@
 
 #pragma once
 
+#include <QLocalServer>
 #include <QMap>
+#include <QPair>
 #include <QObject>
 #include <QSharedMemory>
 #include <QTimer>
@@ -30,7 +32,7 @@
 
 using IPCEventHandler = std::function<bool(const QByteArray&, void*)>;
 
-#define IPC_PROTOCOL_VERSION "2"
+#define IPC_PROTOCOL_VERSION "3"
 
 class IPC : public QObject
 {
@@ -40,7 +42,8 @@ protected:
     static const int EVENT_TIMER_MS = 1000;
     static const int EVENT_GC_TIMEOUT = 5;
     static const int EVENT_QUEUE_SIZE = 32;
-    static const int OWNERSHIP_TIMEOUT_S = 5;
+    static const int MAX_INSTANCES = 16;
+    static const int CONNECT_TIMEOUT_MS = 1000;
 
 public:
     explicit IPC(uint32_t profileId_);
@@ -64,6 +67,7 @@ public:
         uint64_t globalId;
         time_t lastEvent;
         time_t lastProcessed;
+        uint64_t instances[IPC::MAX_INSTANCES];
         IPCEvent events[IPC::EVENT_QUEUE_SIZE];
     };
 
@@ -71,6 +75,9 @@ public:
     bool isCurrentOwner();
     void registerEventHandler(const QString& name, IPCEventHandler handler, void* userData);
     void unregisterEventHandler(const QString& name);
+    void registerProfileEventHandler(const QString& name, uint32_t dest, IPCEventHandler handler,
+                                     void* userData);
+    void unregisterProfileEventHandler(const QString& name, uint32_t dest);
     bool isEventAccepted(time_t time);
     bool waitUntilAccepted(time_t time, int32_t timeout = -1);
     bool isAttached() const;
@@ -84,6 +91,14 @@ private:
     IPCEvent* fetchEvent();
     void processEvents();
     bool isCurrentOwnerNoLock();
+    void collectGarbage();
+    void registerInstance();
+    void notifyInstances();
+    static QString instanceServerName(uint64_t id);
+    static bool isInstanceAlive(uint64_t id);
+
+private slots:
+    void onNotified();
 
 private:
     struct Callback
@@ -92,9 +107,13 @@ private:
         void* userData;
     };
     QTimer timer;
+    QLocalServer server;
     uint64_t globalId;
     uint32_t profileId;
     QSharedMemory globalMemory;
     mutable std::mutex eventHandlersMutex;
     QMap<QString, Callback> eventHandlers;
+    // handlers of the profiles hosted next to profileId, keyed by name and destination
+    QMap<QPair<QString, uint32_t>, Callback> profileEventHandlers;
+    QMap<uint32_t, int> hostedProfiles;
 };
@@ -18,12 +18,14 @@
 */
 
 #include "appmanager.h"
+#include "util/threadcputime.h"
 
 #include <QDebug>
 #include <QGuiApplication>
 
 int main(int argc, char* argv[])
 {
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("GUI"));
     AppManager appManager(argc, argv);
     int errorcode = appManager.run();
 
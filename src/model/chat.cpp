@@ -25,3 +25,60 @@ Chat::~Chat()
 {
 
 }
+
+/**
+ * @brief Activity summary of the chat, cheap enough to read for every friend list sort
+ */
+const ChatActivity& Chat::getActivity() const
+{
+    return activity;
+}
+
+/**
+ * @brief Replaces the activity, used when loading it from history
+ * @note Doesn't emit activityChanged, the new activity is already stored
+ */
+void Chat::setActivity(const ChatActivity& newActivity)
+{
+    activity = newActivity;
+}
+
+/**
+ * @brief Records a message or other event of the chat
+ * @param time When the event happened, the last activity never moves back
+ * @param unread True if the event counts as unread until markActivityRead()
+ * @param mention True if the event mentioned us
+ */
+void Chat::addActivity(const QDateTime& time, bool unread, bool mention)
+{
+    const bool newer = time.isValid()
+                       && (!activity.lastActivity.isValid() || time > activity.lastActivity);
+    if (!newer && !unread) {
+        return;
+    }
+
+    if (newer) {
+        activity.lastActivity = time;
+    }
+
+    if (unread) {
+        ++activity.unreadCount;
+        activity.mentioned = activity.mentioned || mention;
+    }
+
+    emit activityChanged(activity);
+}
+
+/**
+ * @brief Resets the unread counter and mention flag, once the user has seen the chat
+ */
+void Chat::markActivityRead()
+{
+    if (activity.unreadCount == 0 && !activity.mentioned) {
+        return;
+    }
+
+    activity.unreadCount = 0;
+    activity.mentioned = false;
+    emit activityChanged(activity);
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "src/core/chatid.h"
+#include "src/model/chatactivity.h"
 #include <QObject>
 #include <QString>
 
@@ -38,6 +39,15 @@ public:
     virtual void setEventFlag(bool flag) = 0;
     virtual bool getEventFlag() const = 0;
 
+    const ChatActivity& getActivity() const;
+    void setActivity(const ChatActivity& newActivity);
+    void addActivity(const QDateTime& time, bool unread, bool mention);
+    void markActivityRead();
+
 signals:
     void displayedNameChanged(const QString& newName);
+    void activityChanged(const ChatActivity& activity);
+
+private:
+    ChatActivity activity;
 };
@@ -0,0 +1,33 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QDateTime>
+
+/**
+ * @brief Activity summary of a chat, kept up to date by its ChatHistory and persisted in the
+ * chat_activity table so the friend list doesn't have to look at the chat itself
+ */
+struct ChatActivity
+{
+    QDateTime lastActivity;
+    int unreadCount = 0;
+    bool mentioned = false;
+};
@@ -22,10 +22,18 @@
 #include "src/core/chatid.h"
 #include "src/widget/widget.h"
 #include "src/widget/form/chatform.h"
+#include "util/hitchwatchdog.h"
+#include "util/tracer.h"
 
+#include <QDebug>
+
+#include <algorithm>
 #include <thread>
 
 namespace {
+// Number of messages loaded ahead of the rendered window, the same as a scroll step of ChatWidget
+constexpr size_t prefetchPageSize = 100;
+
 /**
  * @brief Determines if the given idx needs to be loaded from history
  * @param[in] idx index to check
@@ -95,6 +103,15 @@ ChatHistory::ChatHistory(Chat& chat_, History* history_, const ICoreIdHandler& c
             &ChatHistory::onMessageBroken);
     connect(&messageDispatcher, &IMessageDispatcher::groupSyncHistReqRecv, this,
             &ChatHistory::onGroupSyncHistReqRecv);
+    connect(&messageDispatcher, &IMessageDispatcher::sendBatchStarted, this,
+            &ChatHistory::onSendBatchStarted);
+    connect(&messageDispatcher, &IMessageDispatcher::sendBatchFinished, this,
+            &ChatHistory::onSendBatchFinished);
+
+    if (canUseHistory()) {
+        chat.setActivity(history->getChatActivity(chat.getPersistentId()));
+    }
+    connect(&chat, &Chat::activityChanged, this, &ChatHistory::onActivityChanged);
 
     if (canUseHistory()) {
         // Defer messageSent callback until we finish firing off all our unsent messages.
@@ -112,8 +129,19 @@ ChatHistory::ChatHistory(Chat& chat_, History* history_, const ICoreIdHandler& c
                                ? ChatLogIdx(0)
                                : sessionChatLog.getFirstIdx() - defaultNumMessagesToLoad;
 
+    if (history) {
+        prefetcher = std::unique_ptr<HistoryPrefetcher>(new HistoryPrefetcher(*history));
+    }
+
     if (canUseHistory()) {
         loadHistoryIntoSessionChatLog(firstChatLogIdx);
+
+        // Everything before the first message of this session is in history, so it can be
+        // dropped from memory and loaded again when it is needed
+        sessionChatLog.setHistoryLoader(sessionChatLog.getNextIdx(),
+                                        [this](ChatLogIdx begin, ChatLogIdx end) {
+                                            reloadHistoryRange(begin, end);
+                                        });
     }
 
     // We don't manage any of the item updates ourselves, we just forward along
@@ -289,6 +317,12 @@ void ChatHistory::onMessageReceived(const ToxPk& sender, const Message& message,
             message.extensionSet, displayName, {}, hasIdType, message.isPrivate);
     }
 
+    const bool mention = std::any_of(message.metadata.begin(), message.metadata.end(),
+                                     [](const MessageMetadata& metadata) {
+                                         return metadata.type == MessageMetadataType::selfMention;
+                                     });
+    chat.addActivity(message.timestamp, true, mention);
+
     sessionChatLog.onMessageReceived(sender, message, hasIdType);
 }
 
@@ -306,7 +340,12 @@ void ChatHistory::onGroupSyncHistReqRecv(const ToxPk& sender, int groupnumber, i
         auto t_sync_history = [](History* history_, const QByteArray& chatIdByteArray_, const ToxPk& sender_, int groupnumber_, int peernumber_)
         {
             const QDateTime _130_min_back_date = QDateTime::currentDateTime().addSecs(-(130 * 60)); // HINT: max. 130 minutes history
-            history_->getGroupMessagesXMinutesBack(chatIdByteArray_, _130_min_back_date, sender_, groupnumber_, peernumber_);
+            std::ignore = sender_;
+            // HINT: only the query runs here, Core paces the actual sending
+            QVector<QByteArray> packets = history_->getGroupSyncPackets(chatIdByteArray_, _130_min_back_date);
+            if (!packets.isEmpty()) {
+                emit history_->groupSyncPacketsReady(groupnumber_, peernumber_, packets);
+            }
         };
         std::thread t_it_thread(t_sync_history, history, chatIdByteArray, sender, groupnumber, peernumber);
         t_it_thread.detach();
@@ -350,9 +389,36 @@ void ChatHistory::onMessageSent(DispatchedMessageId id, const Message& message)
         }
     }
 
+    chat.addActivity(message.timestamp, false, false);
+
     sessionChatLog.onMessageSent(id, message);
 }
 
+/**
+ * @brief Stores the activity summary of our chat whenever it changes
+ */
+void ChatHistory::onActivityChanged(const ChatActivity& activity)
+{
+    if (canUseHistory()) {
+        history->setChatActivity(chat.getPersistentId(), activity);
+    }
+}
+
+void ChatHistory::onSendBatchStarted()
+{
+    if (canUseHistory()) {
+        history->beginBatch();
+    }
+}
+
+void ChatHistory::onSendBatchFinished()
+{
+    // also if history was disabled meanwhile, the batch must not stay open
+    if (history) {
+        history->endBatch();
+    }
+}
+
 void ChatHistory::onMessageComplete(DispatchedMessageId id)
 {
     if (canUseHistory()) {
@@ -400,16 +466,188 @@ void ChatHistory::loadHistoryIntoSessionChatLog(ChatLogIdx start) const
         return;
     }
 
+    HitchScope hitchScope{"history load"};
+    TRACE_SCOPE("ChatHistory::loadHistoryIntoSessionChatLog");
+
     auto end = sessionChatLog.getFirstIdx();
 
     // We know that both history and us have a start index of 0 so the type
     // conversion should be safe
     assert(getFirstIdx() == ChatLogIdx(0));
+    // We always load the messages directly preceding what we already have, so page by the id
+    // of the oldest loaded message instead of an offset SQLite would have to walk
     // qDebug() << "loadHistoryIntoSessionChatLog:getMessagesForChat:START";
-    auto messages = history->getMessagesForChat(chat.getPersistentId(), start.get(), end.get());
+    auto messages = history->getMessagesForChatBefore(chat.getPersistentId(), firstLoadedHistoryId,
+                                                      end.get() - start.get());
     // qDebug() << "loadHistoryIntoSessionChatLog:getMessagesForChat:DONE";
 
     assert(messages.size() == static_cast<int>(end.get() - start.get()));
+    if (!messages.isEmpty()) {
+        firstLoadedHistoryId = messages.first().id;
+    }
+
+    auto nextIdx = insertHistoryMessages(messages, start);
+    assert(nextIdx == end);
+    std::ignore = nextIdx;
+}
+
+/**
+ * @brief Loads an evicted range of the session chat log from history again.
+ * @param[in] begin First index to load.
+ * @param[in] end Index after the last one to load.
+ * @note Only ranges that were loaded from history before may be reloaded, so history indexes
+ * match chat log indexes.
+ */
+void ChatHistory::reloadHistoryRange(ChatLogIdx begin, ChatLogIdx end) const
+{
+    HitchScope hitchScope{"history reload"};
+    TRACE_SCOPE("ChatHistory::reloadHistoryRange");
+    // the oldest chunk may only be partly loaded
+    begin = std::max(begin, sessionChatLog.getFirstIdx());
+    if (begin >= end) {
+        return;
+    }
+
+    auto prefetched = prefetchedPages.find(begin);
+    if (prefetched != prefetchedPages.end()) {
+        const auto messages = std::move(prefetched->second);
+        prefetchedPages.erase(prefetched);
+        if (messages.size() == static_cast<int>(end - begin)) {
+            insertHistoryMessages(messages, begin);
+            return;
+        }
+    }
+
+    auto messages = history->getMessagesForChat(chat.getPersistentId(), begin.get(), end.get());
+    if (messages.size() != static_cast<int>(end - begin)) {
+        qWarning() << "History changed, could only reload" << messages.size() << "of"
+                   << (end - begin) << "messages";
+    }
+
+    insertHistoryMessages(messages, begin);
+}
+
+/**
+ * @brief Loads the history around the rendered window in the background, so scrolling there
+ * doesn't have to wait for the database
+ * @param[in] begin first rendered idx
+ * @param[in] end idx after the last rendered one
+ */
+void ChatHistory::setRenderedWindow(ChatLogIdx begin, ChatLogIdx end)
+{
+    if (!canUseHistory() || !prefetcher) {
+        return;
+    }
+
+    // A window that doesn't touch the previous one means the user jumped somewhere else, pages
+    // around the old position aren't needed anymore
+    if (end < renderedBegin || begin > renderedEnd) {
+        prefetcher->cancel();
+        prefetchedPages.clear();
+    }
+    renderedBegin = begin;
+    renderedEnd = end;
+
+    prefetchPreviousPage(begin);
+    prefetchEvictedPages(begin, end);
+}
+
+/**
+ * @brief Loads the page before the oldest loaded message if the window comes close to it
+ * @param[in] windowBegin first rendered idx
+ */
+void ChatHistory::prefetchPreviousPage(ChatLogIdx windowBegin)
+{
+    const auto firstLoaded = sessionChatLog.getFirstIdx();
+    // Pages are requested relative to the oldest loaded message, without one we have no anchor
+    if (firstLoadedHistoryId.get() < 0 || firstLoaded == ChatLogIdx(0)
+        || windowBegin >= firstLoaded + prefetchPageSize) {
+        return;
+    }
+
+    const auto count = std::min(prefetchPageSize, firstLoaded.get());
+    const auto pageBegin = firstLoaded - count;
+    const auto beforeId = firstLoadedHistoryId;
+    std::shared_ptr<const ChatId> chatId = chat.getPersistentId().clone();
+
+    prefetcher->fetch(
+        pageBegin,
+        [chatId, beforeId, count](History& db) {
+            return db.getMessagesForChatBefore(*chatId, beforeId, count);
+        },
+        [this, pageBegin, beforeId](const QVector<History::HistMessage>& messages) {
+            // A synchronous load already got these
+            if (firstLoadedHistoryId != beforeId || messages.isEmpty()) {
+                return;
+            }
+
+            if (pageBegin + static_cast<size_t>(messages.size()) != sessionChatLog.getFirstIdx()) {
+                qWarning() << "History changed, dropping prefetched page at" << pageBegin.get();
+                return;
+            }
+
+            firstLoadedHistoryId = messages.first().id;
+            insertHistoryMessages(messages, pageBegin);
+        });
+}
+
+/**
+ * @brief Loads evicted chunks next to the rendered window, so they are ready when reloaded
+ * @param[in] windowBegin first rendered idx
+ * @param[in] windowEnd idx after the last rendered one
+ */
+void ChatHistory::prefetchEvictedPages(ChatLogIdx windowBegin, ChatLogIdx windowEnd)
+{
+    constexpr auto chunkSize = ChatLogChunks::CHUNK_SIZE;
+    const auto spanBegin = ChatLogIdx(windowBegin.get() < chunkSize
+                                          ? 0
+                                          : (windowBegin.get() - chunkSize) / chunkSize * chunkSize);
+    const auto spanEnd = windowEnd + chunkSize;
+
+    // Pages the window moved away from are loaded again on demand
+    for (auto it = prefetchedPages.begin(); it != prefetchedPages.end();) {
+        if (it->first < spanBegin || it->first >= spanEnd) {
+            it = prefetchedPages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::shared_ptr<const ChatId> chatId = chat.getPersistentId().clone();
+    for (auto chunkBegin = spanBegin; chunkBegin < spanEnd; chunkBegin = chunkBegin + chunkSize) {
+        if (!sessionChatLog.isEvicted(chunkBegin)) {
+            continue;
+        }
+
+        // Same range reloadHistoryRange() asks for
+        const auto pageBegin = std::max(chunkBegin, sessionChatLog.getFirstIdx());
+        const auto pageEnd = chunkBegin + chunkSize;
+        if (prefetchedPages.find(pageBegin) != prefetchedPages.end()) {
+            continue;
+        }
+
+        prefetcher->fetch(
+            pageBegin,
+            [chatId, pageBegin, pageEnd](History& db) {
+                return db.getMessagesForChat(*chatId, pageBegin.get(), pageEnd.get());
+            },
+            [this, pageBegin](const QVector<History::HistMessage>& messages) {
+                if (sessionChatLog.isEvicted(pageBegin)) {
+                    prefetchedPages[pageBegin] = messages;
+                }
+            });
+    }
+}
+
+/**
+ * @brief Inserts messages loaded from history into the session chat log
+ * @param[in] messages Messages in chronological order
+ * @param[in] start Index of the first message
+ * @return Index after the last inserted message
+ */
+ChatLogIdx ChatHistory::insertHistoryMessages(const QVector<History::HistMessage>& messages,
+                                              ChatLogIdx start) const
+{
     ChatLogIdx nextIdx = start;
 
     for (const auto& message : messages) {
@@ -419,7 +657,7 @@ void ChatHistory::loadHistoryIntoSessionChatLog(ChatLogIdx start) const
         switch (message.content.getType()) {
         case HistMessageContentType::file: {
             const auto date = message.timestamp;
-            const auto file = message.content.asFile();
+            const auto& file = message.content.asFile();
             const auto chatLogFile = ChatLogFile{date, file};
             sessionChatLog.insertFileAtIdx(currentIdx, message.sender, message.dispName, chatLogFile);
             break;
@@ -473,7 +711,7 @@ void ChatHistory::loadHistoryIntoSessionChatLog(ChatLogIdx start) const
         }
     }
 
-    assert(nextIdx == end);
+    return nextIdx;
 }
 
 /**
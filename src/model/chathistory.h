@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "historyprefetcher.h"
 #include "ichatlog.h"
 #include "sessionchatlog.h"
 #include "src/model/brokenmessagereason.h"
@@ -26,6 +27,9 @@
 
 #include <QSet>
 
+#include <map>
+#include <memory>
+
 class Settings;
 class FriendList;
 class GroupList;
@@ -46,6 +50,7 @@ public:
     ChatLogIdx getNextIdx() const override;
     std::vector<DateChatLogIdxPair> getDateIdxs(const QDate& startDate, size_t maxDates) const override;
     void addSystemMessage(const SystemMessage& message) override;
+    void setRenderedWindow(ChatLogIdx begin, ChatLogIdx end) override;
 
 public slots:
     void onFileUpdated(const ToxPk& sender, const ToxFile& file);
@@ -59,12 +64,20 @@ private slots:
     void onPushtokenPing(const ToxPk& sender);
     void onMessageSent(DispatchedMessageId id, const Message& message);
     void onMessageComplete(DispatchedMessageId id);
+    void onSendBatchStarted();
+    void onSendBatchFinished();
     void onMessageBroken(DispatchedMessageId id, BrokenMessageReason reason);
     void onGroupSyncHistReqRecv(const ToxPk& sender, int groupnumber, int peernumber);
+    void onActivityChanged(const ChatActivity& activity);
 
 private:
     void ensureIdxInSessionChatLog(ChatLogIdx idx) const;
     void loadHistoryIntoSessionChatLog(ChatLogIdx start) const;
+    void reloadHistoryRange(ChatLogIdx begin, ChatLogIdx end) const;
+    ChatLogIdx insertHistoryMessages(const QVector<History::HistMessage>& messages,
+                                     ChatLogIdx start) const;
+    void prefetchPreviousPage(ChatLogIdx windowBegin);
+    void prefetchEvictedPages(ChatLogIdx windowBegin, ChatLogIdx windowEnd);
     void dispatchUnsentMessages(IMessageDispatcher& messageDispatcher);
     void handleDispatchedMessage(DispatchedMessageId dispatchId, RowId historyId);
     void completeMessage(DispatchedMessageId id);
@@ -77,6 +90,14 @@ private:
     const Settings& settings;
     const ICoreIdHandler& coreIdHandler;
     mutable SessionChatLog sessionChatLog;
+    // History id of the oldest message loaded into sessionChatLog, -1 if none is loaded yet
+    mutable RowId firstLoadedHistoryId{-1};
+    // Declared after sessionChatLog, so no prefetched page arrives after it is gone
+    std::unique_ptr<HistoryPrefetcher> prefetcher;
+    // Pages of evicted chunks loaded ahead of time, by the first index of the page
+    mutable std::map<ChatLogIdx, QVector<History::HistMessage>> prefetchedPages;
+    ChatLogIdx renderedBegin{0};
+    ChatLogIdx renderedEnd{0};
 
     // If a message completes before it's inserted into history it will end up
     // in this set
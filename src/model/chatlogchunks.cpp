@@ -0,0 +1,250 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "chatlogchunks.h"
+#include "util/cacheregistry.h"
+
+#include <QDebug>
+
+#include <new>
+
+/**
+ * @class ChatLogChunks
+ * @brief Storage of ChatLogItems in fixed blocks of CHUNK_SIZE consecutive indexes.
+ *
+ * Every chunk holds its items in one allocation, instead of one tree node per item. Items don't
+ * move once inserted, so references stay valid as long as their chunk is loaded.
+ *
+ * If a loader is set, at most MAX_LOADED_CHUNKS chunks stay loaded, LOW_MEMORY_LOADED_CHUNKS in
+ * the low memory mode of the CacheRegistry. Inserting into a new chunk
+ * evicts the least recently used chunk that canEvict allows, and find() reloads an evicted
+ * chunk through the loader when it is needed again. Chunks are never evicted without a loader.
+ */
+
+constexpr size_t ChatLogChunks::CHUNK_SIZE;
+constexpr size_t ChatLogChunks::MAX_LOADED_CHUNKS;
+constexpr size_t ChatLogChunks::LOW_MEMORY_LOADED_CHUNKS;
+
+/**
+ * @brief Looks up an item, reloading its chunk if it was evicted.
+ * @param idx Index of the item.
+ * @return The item, nullptr if there is none at idx.
+ */
+ChatLogItem* ChatLogChunks::find(ChatLogIdx idx)
+{
+    const size_t number = chunkNumber(idx);
+    auto it = chunks.find(number);
+    Chunk* chunk = it != chunks.end() ? it->second.get() : reload(number);
+    if (!chunk) {
+        return nullptr;
+    }
+
+    chunk->lastUse = ++useCounter;
+    return chunk->get(idx.get() % CHUNK_SIZE);
+}
+
+/**
+ * @brief Inserts an item, unless there already is one at idx.
+ * @param idx Index of the item.
+ * @param item Item to insert.
+ * @return True if the item was inserted.
+ */
+bool ChatLogChunks::emplace(ChatLogIdx idx, ChatLogItem&& item)
+{
+    const size_t number = chunkNumber(idx);
+    auto it = chunks.find(number);
+    Chunk* chunk = it != chunks.end() ? it->second.get() : reload(number);
+    const bool newChunk = !chunk;
+    if (newChunk) {
+        chunk = new Chunk();
+        chunks.emplace(number, std::unique_ptr<Chunk>(chunk));
+    }
+
+    chunk->lastUse = ++useCounter;
+    if (!chunk->emplace(idx.get() % CHUNK_SIZE, std::move(item))) {
+        return false;
+    }
+
+    if (!hasItems || idx < lowestIdx) {
+        lowestIdx = idx;
+    }
+    hasItems = true;
+
+    if (newChunk) {
+        trim(maxLoadedChunks());
+    }
+    return true;
+}
+
+bool ChatLogChunks::empty() const
+{
+    return !hasItems;
+}
+
+/**
+ * @brief Lowest index ever inserted, evicted items included.
+ * @note Only valid if the storage isn't empty.
+ */
+ChatLogIdx ChatLogChunks::firstIdx() const
+{
+    return lowestIdx;
+}
+
+size_t ChatLogChunks::loadedChunks() const
+{
+    return chunks.size();
+}
+
+size_t ChatLogChunks::loadedItems() const
+{
+    size_t count = 0;
+    for (const auto& chunk : chunks) {
+        count += chunk.second->count();
+    }
+    return count;
+}
+
+/**
+ * @brief Memory of the loaded chunks, without what the items allocate themselves.
+ */
+size_t ChatLogChunks::loadedBytes() const
+{
+    return chunks.size() * sizeof(Chunk);
+}
+
+bool ChatLogChunks::isEvicted(ChatLogIdx idx) const
+{
+    return evicted.find(chunkNumber(idx)) != evicted.end();
+}
+
+/**
+ * @brief Enables eviction of chunks.
+ * @param loader_ Re-inserts all items of the given range with emplace().
+ * @param canEvict_ Whether the items of the given range can be dropped and loaded again later.
+ */
+void ChatLogChunks::setLoader(Loader loader_, CanEvict canEvict_)
+{
+    loader = std::move(loader_);
+    canEvict = std::move(canEvict_);
+    trim(maxLoadedChunks());
+}
+
+size_t ChatLogChunks::maxLoadedChunks()
+{
+    return CacheRegistry::getInstance().isLowMemory() ? LOW_MEMORY_LOADED_CHUNKS
+                                                      : MAX_LOADED_CHUNKS;
+}
+
+size_t ChatLogChunks::chunkNumber(ChatLogIdx idx)
+{
+    return idx.get() / CHUNK_SIZE;
+}
+
+ChatLogIdx ChatLogChunks::chunkBegin(size_t number)
+{
+    return ChatLogIdx(number * CHUNK_SIZE);
+}
+
+ChatLogChunks::Chunk* ChatLogChunks::reload(size_t number)
+{
+    auto evictedIt = evicted.find(number);
+    if (evictedIt == evicted.end() || !loader) {
+        return nullptr;
+    }
+
+    evicted.erase(evictedIt);
+    loader(chunkBegin(number), chunkBegin(number + 1));
+
+    auto it = chunks.find(number);
+    if (it == chunks.end()) {
+        qWarning() << "Reloading chat log items" << chunkBegin(number).get() << "failed";
+        return nullptr;
+    }
+
+    return it->second.get();
+}
+
+/**
+ * @brief Evicts the least recently used chunks that canEvict allows down to maxChunks.
+ * @note The chunk used last always stays loaded.
+ */
+void ChatLogChunks::trim(size_t maxChunks)
+{
+    if (!canEvict) {
+        return;
+    }
+
+    while (chunks.size() > maxChunks) {
+        auto victim = chunks.end();
+        for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+            // the chunk in use right now always stays
+            if (it->second->lastUse == useCounter) {
+                continue;
+            }
+
+            if ((victim == chunks.end() || it->second->lastUse < victim->second->lastUse)
+                && canEvict(chunkBegin(it->first), chunkBegin(it->first + 1))) {
+                victim = it;
+            }
+        }
+
+        if (victim == chunks.end()) {
+            return;
+        }
+
+        evicted.insert(victim->first);
+        chunks.erase(victim);
+    }
+}
+
+ChatLogChunks::Chunk::~Chunk()
+{
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+        if (used[i]) {
+            slot(i)->~ChatLogItem();
+        }
+    }
+}
+
+ChatLogItem* ChatLogChunks::Chunk::get(size_t offset)
+{
+    return used[offset] ? slot(offset) : nullptr;
+}
+
+size_t ChatLogChunks::Chunk::count() const
+{
+    return used.count();
+}
+
+bool ChatLogChunks::Chunk::emplace(size_t offset, ChatLogItem&& item)
+{
+    if (used[offset]) {
+        return false;
+    }
+
+    new (&storage[offset]) ChatLogItem(std::move(item));
+    used[offset] = true;
+    return true;
+}
+
+ChatLogItem* ChatLogChunks::Chunk::slot(size_t offset)
+{
+    return reinterpret_cast<ChatLogItem*>(&storage[offset]);
+}
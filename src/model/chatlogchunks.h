@@ -0,0 +1,93 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "chatlogitem.h"
+#include "ichatlog.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <type_traits>
+
+class ChatLogChunks
+{
+public:
+    using Loader = std::function<void(ChatLogIdx begin, ChatLogIdx end)>;
+    using CanEvict = std::function<bool(ChatLogIdx begin, ChatLogIdx end)>;
+
+    ChatLogItem* find(ChatLogIdx idx);
+    bool emplace(ChatLogIdx idx, ChatLogItem&& item);
+    bool empty() const;
+    ChatLogIdx firstIdx() const;
+    size_t loadedChunks() const;
+    size_t loadedItems() const;
+    size_t loadedBytes() const;
+    bool isEvicted(ChatLogIdx idx) const;
+
+    void setLoader(Loader loader, CanEvict canEvict);
+    void trim(size_t maxChunks);
+
+    static constexpr size_t CHUNK_SIZE = 256;
+    static constexpr size_t MAX_LOADED_CHUNKS = 8;
+    static constexpr size_t LOW_MEMORY_LOADED_CHUNKS = 2;
+
+private:
+    class Chunk
+    {
+    public:
+        Chunk() = default;
+        Chunk(const Chunk&) = delete;
+        Chunk& operator=(const Chunk&) = delete;
+        ~Chunk();
+
+        ChatLogItem* get(size_t offset);
+        size_t count() const;
+        bool emplace(size_t offset, ChatLogItem&& item);
+
+        uint64_t lastUse = 0;
+
+    private:
+        ChatLogItem* slot(size_t offset);
+
+        using Storage = typename std::aligned_storage<sizeof(ChatLogItem), alignof(ChatLogItem)>::type;
+        std::array<Storage, CHUNK_SIZE> storage;
+        std::bitset<CHUNK_SIZE> used;
+    };
+
+    static size_t maxLoadedChunks();
+    static size_t chunkNumber(ChatLogIdx idx);
+    static ChatLogIdx chunkBegin(size_t number);
+    Chunk* reload(size_t number);
+
+private:
+    std::map<size_t, std::unique_ptr<Chunk>> chunks;
+    std::set<size_t> evicted;
+    uint64_t useCounter = 0;
+    bool hasItems = false;
+    ChatLogIdx lowestIdx{0};
+    Loader loader;
+    CanEvict canEvict;
+};
@@ -17,6 +17,7 @@
     along with qTox.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "src/core/core.h"
 #include "src/grouplist.h"
 #include "src/model/chatroom/friendchatroom.h"
 #include "src/model/dialogs/idialogsmanager.h"
@@ -171,6 +172,7 @@ QVector<CircleToDisplay> FriendChatroom::getOtherCircles() const
 void FriendChatroom::resetEventFlags()
 {
     frnd->setEventFlag(false);
+    frnd->markActivityRead();
 }
 
 bool FriendChatroom::possibleToOpenInNewWindow() const
@@ -200,3 +202,8 @@ void FriendChatroom::removeFriendFromDialogs()
     auto dialogs = dialogsManager->getFriendDialogs(friendPk);
     dialogs->removeFriend(friendPk);
 }
+
+ConnectionPathStats::Snapshot FriendChatroom::getConnectionPath() const
+{
+    return core.getFriendConnectionPath(frnd->getId());
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "chatroom.h"
+#include "src/core/connectionpathstats.h"
 
 #include <QObject>
 #include <QString>
@@ -83,6 +84,8 @@ public slots:
     bool friendCanBeRemoved() const;
     void removeFriendFromDialogs();
 
+    ConnectionPathStats::Snapshot getConnectionPath() const;
+
 signals:
     void activeChanged(bool activated);
 
@@ -56,6 +56,7 @@ bool GroupChatroom::hasNewMessage() const
 void GroupChatroom::resetEventFlags()
 {
     group->setEventFlag(false);
+    group->markActivityRead();
     group->setMentionedFlag(false);
 }
 
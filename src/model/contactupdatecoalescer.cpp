@@ -0,0 +1,209 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "contactupdatecoalescer.h"
+
+#include <algorithm>
+
+/**
+ * @class ContactUpdateCoalescer
+ * @brief Merges the contact updates Core reports within one event loop turn.
+ *
+ * After a resume or a DHT reconnect Core reports thousands of status, name and peer list
+ * changes at once, and each of them used to update the widgets right away. Typing
+ * notifications of active chats flap just as often. The coalescer
+ * collects them per friend and per group instead and delivers them with one friendsUpdated()
+ * and one groupsUpdated() on the next event loop turn. The latest value of every property wins,
+ * a peer that joined and left again within the turn is dropped, a peer that left and joined
+ * again is reported with both.
+ */
+
+ContactUpdateCoalescer::ContactUpdateCoalescer(QObject* parent)
+    : QObject(parent)
+{
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(0);
+    connect(&flushTimer, &QTimer::timeout, this, &ContactUpdateCoalescer::flush);
+}
+
+/**
+ * @brief Delivers all pending updates now, in the order the contacts first changed.
+ */
+void ContactUpdateCoalescer::flush()
+{
+    flushTimer.stop();
+
+    QVector<FriendUpdate> friends;
+    friends.swap(friendUpdates);
+    friendIndex.clear();
+
+    QVector<GroupUpdate> groups;
+    groups.swap(groupUpdates);
+    groupIndex.clear();
+    peerIndices.clear();
+
+    for (GroupUpdate& update : groups) {
+        auto& changes = update.peerChanges;
+        changes.erase(std::remove_if(changes.begin(), changes.end(),
+                                     [](const PeerChange& change) {
+                                         return !change.exited && !change.joined && !change.renamed;
+                                     }),
+                      changes.end());
+    }
+
+    if (!friends.isEmpty()) {
+        emit friendsUpdated(friends);
+    }
+
+    if (!groups.isEmpty()) {
+        emit groupsUpdated(groups);
+    }
+}
+
+void ContactUpdateCoalescer::onFriendUsernameChanged(uint32_t friendId, const QString& username)
+{
+    FriendUpdate& update = friendUpdate(friendId);
+    update.hasUsername = true;
+    update.username = username;
+}
+
+void ContactUpdateCoalescer::onFriendStatusMessageChanged(uint32_t friendId, const QString& message)
+{
+    FriendUpdate& update = friendUpdate(friendId);
+    update.hasStatusMessage = true;
+    update.statusMessage = message;
+}
+
+void ContactUpdateCoalescer::onFriendTypingChanged(uint32_t friendId, bool isTyping)
+{
+    FriendUpdate& update = friendUpdate(friendId);
+    update.hasTyping = true;
+    update.isTyping = isTyping;
+}
+
+void ContactUpdateCoalescer::onFriendStatusChanged(uint32_t friendId, Status::Status status)
+{
+    FriendUpdate& update = friendUpdate(friendId);
+    update.hasStatus = true;
+    update.status = status;
+}
+
+void ContactUpdateCoalescer::onGroupPeerlistChanged(int groupnumber)
+{
+    groupUpdate(groupnumber).peerlistChanged = true;
+}
+
+void ContactUpdateCoalescer::onGroupPeerNameChanged(int groupnumber, const ToxPk& peerPk,
+                                                    const QString& newName)
+{
+    groupUpdate(groupnumber).peerNames[peerPk] = newName;
+}
+
+void ContactUpdateCoalescer::onGroupPeerJoined(int groupnumber, uint32_t peerId,
+                                               const ToxPk& peerPk, const QString& name)
+{
+    PeerChange& change = peerChange(groupnumber, peerPk);
+    change.joined = true;
+    change.renamed = false;
+    change.peerId = peerId;
+    change.name = name;
+}
+
+void ContactUpdateCoalescer::onGroupPeerExited(int groupnumber, uint32_t peerId,
+                                               const ToxPk& peerPk)
+{
+    PeerChange& change = peerChange(groupnumber, peerPk);
+    change.renamed = false;
+    if (change.joined) {
+        // nets out with the join, an exit before it still has to be applied
+        change.joined = false;
+        return;
+    }
+
+    change.exited = true;
+    change.peerId = peerId;
+}
+
+void ContactUpdateCoalescer::onGroupPeerRenamed(int groupnumber, uint32_t peerId,
+                                                const ToxPk& peerPk, const QString& name)
+{
+    PeerChange& change = peerChange(groupnumber, peerPk);
+    if (change.exited && !change.joined) {
+        return;
+    }
+
+    if (!change.joined) {
+        change.renamed = true;
+    }
+    change.peerId = peerId;
+    change.name = name;
+}
+
+ContactUpdateCoalescer::FriendUpdate& ContactUpdateCoalescer::friendUpdate(uint32_t friendId)
+{
+    auto it = friendIndex.constFind(friendId);
+    if (it != friendIndex.constEnd()) {
+        return friendUpdates[it.value()];
+    }
+
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+    friendIndex.insert(friendId, friendUpdates.size());
+    FriendUpdate update;
+    update.friendId = friendId;
+    friendUpdates.append(update);
+    return friendUpdates.last();
+}
+
+ContactUpdateCoalescer::GroupUpdate& ContactUpdateCoalescer::groupUpdate(int groupnumber)
+{
+    auto it = groupIndex.constFind(groupnumber);
+    if (it != groupIndex.constEnd()) {
+        return groupUpdates[it.value()];
+    }
+
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+    groupIndex.insert(groupnumber, groupUpdates.size());
+    GroupUpdate update;
+    update.groupnumber = groupnumber;
+    groupUpdates.append(update);
+    peerIndices.append({});
+    return groupUpdates.last();
+}
+
+ContactUpdateCoalescer::PeerChange& ContactUpdateCoalescer::peerChange(int groupnumber,
+                                                                       const ToxPk& peerPk)
+{
+    GroupUpdate& update = groupUpdate(groupnumber);
+    QHash<ToxPk, int>& peers = peerIndices[groupIndex.value(groupnumber)];
+    auto it = peers.constFind(peerPk);
+    if (it != peers.constEnd()) {
+        return update.peerChanges[it.value()];
+    }
+
+    peers.insert(peerPk, update.peerChanges.size());
+    PeerChange change;
+    change.peerPk = peerPk;
+    update.peerChanges.append(change);
+    return update.peerChanges.last();
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "src/core/toxpk.h"
+#include "src/model/status.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <cstdint>
+
+class ContactUpdateCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct FriendUpdate
+    {
+        uint32_t friendId = 0;
+        bool hasUsername = false;
+        QString username;
+        bool hasStatusMessage = false;
+        QString statusMessage;
+        bool hasTyping = false;
+        bool isTyping = false;
+        bool hasStatus = false;
+        Status::Status status = Status::Status::Offline;
+    };
+
+    struct PeerChange
+    {
+        ToxPk peerPk;
+        // the peer left before it (re)joined, exit first
+        bool exited = false;
+        bool joined = false;
+        // only when not joined, the join already carries the latest name
+        bool renamed = false;
+        uint32_t peerId = 0;
+        QString name;
+    };
+
+    struct GroupUpdate
+    {
+        int groupnumber = 0;
+        QVector<PeerChange> peerChanges;
+        QHash<ToxPk, QString> peerNames;
+        bool peerlistChanged = false;
+    };
+
+    explicit ContactUpdateCoalescer(QObject* parent = nullptr);
+
+    void flush();
+
+signals:
+    void friendsUpdated(const QVector<ContactUpdateCoalescer::FriendUpdate>& updates);
+    void groupsUpdated(const QVector<ContactUpdateCoalescer::GroupUpdate>& updates);
+
+public slots:
+    void onFriendUsernameChanged(uint32_t friendId, const QString& username);
+    void onFriendStatusMessageChanged(uint32_t friendId, const QString& message);
+    void onFriendTypingChanged(uint32_t friendId, bool isTyping);
+    void onFriendStatusChanged(uint32_t friendId, Status::Status status);
+    void onGroupPeerlistChanged(int groupnumber);
+    void onGroupPeerNameChanged(int groupnumber, const ToxPk& peerPk, const QString& newName);
+    void onGroupPeerJoined(int groupnumber, uint32_t peerId, const ToxPk& peerPk, const QString& name);
+    void onGroupPeerExited(int groupnumber, uint32_t peerId, const ToxPk& peerPk);
+    void onGroupPeerRenamed(int groupnumber, uint32_t peerId, const ToxPk& peerPk, const QString& name);
+
+private:
+    FriendUpdate& friendUpdate(uint32_t friendId);
+    GroupUpdate& groupUpdate(int groupnumber);
+    PeerChange& peerChange(int groupnumber, const ToxPk& peerPk);
+
+    QTimer flushTimer;
+    // in the order the contacts first changed, the indices map into them
+    QVector<FriendUpdate> friendUpdates;
+    QHash<uint32_t, int> friendIndex;
+    QVector<GroupUpdate> groupUpdates;
+    QHash<int, int> groupIndex;
+    // per entry of groupUpdates, maps into its peerChanges
+    QVector<QHash<ToxPk, int>> peerIndices;
+};
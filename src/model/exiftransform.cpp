@@ -22,15 +22,16 @@
 #include <libexif/exif-loader.h>
 
 #include <QDebug>
+#include <QIODevice>
 
-namespace ExifTransform
+namespace
 {
-    Orientation getOrientation(QByteArray imageData)
+    /**
+     * @brief Reads the orientation entry and frees exifData.
+     */
+    ExifTransform::Orientation takeOrientation(ExifData* exifData)
     {
-        auto data = imageData.constData();
-        auto size = imageData.size();
-
-        ExifData* exifData = exif_data_new_from_data(reinterpret_cast<const unsigned char*>(data), size);
+        using ExifTransform::Orientation;
 
         if (!exifData) {
             return Orientation::TopLeft;
@@ -69,6 +70,60 @@ namespace ExifTransform
             return Orientation::TopLeft;
         }
     }
+} // namespace
+
+namespace ExifTransform
+{
+    Orientation getOrientation(QByteArray imageData)
+    {
+        auto data = imageData.constData();
+        auto size = imageData.size();
+
+        return takeOrientation(
+            exif_data_new_from_data(reinterpret_cast<const unsigned char*>(data), size));
+    }
+
+    /**
+     * @brief Reads the orientation from the start of an image, without reading the whole file.
+     * @param device Open device, its position is restored afterwards.
+     * @return Orientation, TopLeft if the image has no EXIF data.
+     */
+    Orientation getOrientation(QIODevice& device)
+    {
+        const qint64 start = device.pos();
+        ExifLoader* loader = exif_loader_new();
+
+        // the loader stops accepting data once it has the EXIF block or knows there is none
+        unsigned char buffer[4096];
+        qint64 read;
+        while ((read = device.read(reinterpret_cast<char*>(buffer), sizeof(buffer))) > 0) {
+            if (!exif_loader_write(loader, buffer, static_cast<unsigned int>(read))) {
+                break;
+            }
+        }
+
+        ExifData* exifData = exif_loader_get_data(loader);
+        exif_loader_unref(loader);
+        device.seek(start);
+
+        return takeOrientation(exifData);
+    }
+
+    /**
+     * @brief Whether width and height of the image are swapped by the transformation.
+     */
+    bool swapsDimensions(Orientation orientation)
+    {
+        switch (orientation) {
+        case Orientation::LeftTop:
+        case Orientation::RightTop:
+        case Orientation::RightBottom:
+        case Orientation::LeftBottom:
+            return true;
+        default:
+            return false;
+        }
+    }
 
     QImage applyTransformation(QImage image, Orientation orientation)
     {
@@ -21,6 +21,8 @@
 
 #include <QPixmap>
 
+class QIODevice;
+
 namespace ExifTransform
 {
     enum class Orientation
@@ -41,5 +43,7 @@ namespace ExifTransform
     };
 
     Orientation getOrientation(QByteArray imageData);
+    Orientation getOrientation(QIODevice& device);
+    bool swapsDimensions(Orientation orientation);
     QImage applyTransformation(QImage image, Orientation orientation);
 }
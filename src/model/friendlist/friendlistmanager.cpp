@@ -20,6 +20,21 @@
 #include "friendlistmanager.h"
 #include "src/widget/genericchatroomwidget.h"
 
+#include <algorithm>
+
+/**
+ * @class FriendListManager
+ * @brief Keeps the friend list items ordered by name or by activity.
+ *
+ * Changes that affect every item, like adding or removing an item, a new filter or switching
+ * the sort mode, need a full sort on the next updatePositions. An item reported through
+ * setItemChanged is only moved to its new position with a binary search, the rest of the list
+ * is known to be ordered already. Any other change only requests checking the order.
+ *
+ * The search filter uses a FriendListSearchIndex, so items reported through setItemChanged
+ * are also reindexed in case they were renamed.
+ */
+
 FriendListManager::FriendListManager(int countContacts_, QObject *parent) : QObject(parent)
 {
     countContacts = countContacts_;
@@ -53,6 +68,7 @@ void FriendListManager::addFriendListItem(IFriendListItem *item)
     } else {
         items.push_back(IFriendListItemPtr(item));
     }
+    searchIndex.insert(item);
 
     if (countContacts <= items.size()) {
         countContacts = 0;
@@ -68,12 +84,18 @@ void FriendListManager::removeFriendListItem(IFriendListItem *item)
 
 void FriendListManager::sortByName()
 {
+    if (!byName) {
+        needSort = true;
+    }
     byName = true;
     updatePositions();
 }
 
 void FriendListManager::sortByActivity()
 {
+    if (byName) {
+        needSort = true;
+    }
     byName = false;
     updatePositions();
 }
@@ -103,29 +125,25 @@ void FriendListManager::setFilter(const QString &searchString, bool hideOnline,
 
 void FriendListManager::applyFilter()
 {
-    QString searchString = filterParams.searchString;
+    const QString& searchString = filterParams.searchString;
+    const QSet<IFriendListItem*> matches = searchIndex.search(searchString);
 
-    for (IFriendListItemPtr itemTmp : items) {
-        if (searchString.isEmpty()) {
-            itemTmp->setWidgetVisible(true);
-        } else {
-            QString tmp_name = itemTmp->getNameItem();
-            itemTmp->setWidgetVisible(tmp_name.contains(searchString, Qt::CaseInsensitive));
-        }
+    for (const IFriendListItemPtr& itemTmp : items) {
+        bool visible = searchString.isEmpty() || matches.contains(itemTmp.get());
 
-        if (filterParams.hideOnline && itemTmp->isOnline()) {
-            if (itemTmp->isFriend()) {
-                itemTmp->setWidgetVisible(false);
-            }
+        if (filterParams.hideOnline && itemTmp->isOnline() && itemTmp->isFriend()) {
+            visible = false;
         }
 
         if (filterParams.hideOffline && !itemTmp->isOnline()) {
-            itemTmp->setWidgetVisible(false);
+            visible = false;
         }
 
         if (filterParams.hideGroups && itemTmp->isGroup()) {
-            itemTmp->setWidgetVisible(false);
+            visible = false;
         }
+
+        itemTmp->setWidgetVisible(visible);
     }
 
     if (filterParams.hideOnline && filterParams.hideOffline) {
@@ -135,36 +153,75 @@ void FriendListManager::applyFilter()
     }
 }
 
-void FriendListManager::updatePositions()
+template <typename Compare>
+void FriendListManager::sortItems(Compare cmp)
 {
-    positionsChanged = true;
+    if (needSort) {
+        std::sort(items.begin(), items.end(), cmp);
+        positionsChanged = true;
+    } else {
+        const bool reported = !changedItems.isEmpty();
+        positionsChanged = reported && repositionChanged(cmp);
+        if ((needCheck || !reported) && !std::is_sorted(items.begin(), items.end(), cmp)) {
+            std::sort(items.begin(), items.end(), cmp);
+            positionsChanged = true;
+        }
+    }
 
-    if (byName) {
-        auto sortName = [&](const IFriendListItemPtr &a, const IFriendListItemPtr &b) {
-                            return cmpByName(a, b);
-                        };
-        if (!needSort) {
-            if (std::is_sorted(items.begin(), items.end(), sortName)) {
-                positionsChanged = false;
-                return;
-            }
+    needSort = false;
+    needCheck = false;
+    changedItems.clear();
+}
+
+/**
+ * @brief Moves the changed items to their new positions.
+ * @return True if any item ended up at a different position.
+ */
+template <typename Compare>
+bool FriendListManager::repositionChanged(Compare cmp)
+{
+    // Taking the changed items out keeps the others in order, so each can be inserted back
+    // with a binary search
+    QVector<IFriendListItemPtr> changed;
+    QVector<int> oldPositions;
+    int kept = 0;
+    for (int i = 0; i < items.size(); ++i) {
+        if (changedItems.contains(items[i].get())) {
+            changed.push_back(items[i]);
+            oldPositions.push_back(i);
+        } else {
+            items[kept++] = items[i];
         }
-        std::sort(items.begin(), items.end(), sortName);
+    }
+    items.resize(kept);
 
-    } else {
-        auto sortActivity = [&](const IFriendListItemPtr &a, const IFriendListItemPtr &b) {
-                                return cmpByActivity(a, b);
-                            };
-        if (!needSort) {
-            if (std::is_sorted(items.begin(), items.end(), sortActivity)) {
-                positionsChanged = false;
-                return;
-            }
+    for (const IFriendListItemPtr& item : changed) {
+        items.insert(std::upper_bound(items.begin(), items.end(), item, cmp), item);
+    }
+
+    for (int i = 0; i < changed.size(); ++i) {
+        if (items[oldPositions[i]] != changed[i]) {
+            return true;
         }
-        std::sort(items.begin(), items.end(), sortActivity);
     }
+    return false;
+}
 
-    needSort = false;
+void FriendListManager::updatePositions()
+{
+    for (IFriendListItem* item : changedItems) {
+        searchIndex.update(item);
+    }
+
+    if (byName) {
+        sortItems([&](const IFriendListItemPtr &a, const IFriendListItemPtr &b) {
+                      return cmpByName(a, b);
+                  });
+    } else {
+        sortItems([&](const IFriendListItemPtr &a, const IFriendListItemPtr &b) {
+                      return cmpByActivity(a, b);
+                  });
+    }
 }
 
 void FriendListManager::setSortRequired()
@@ -173,13 +230,37 @@ void FriendListManager::setSortRequired()
     emit itemsChanged();
 }
 
+/**
+ * @brief Requests checking the order on the next update, for changes not tied to one item.
+ */
+void FriendListManager::setCheckRequired()
+{
+    needCheck = true;
+    emit itemsChanged();
+}
+
+/**
+ * @brief Requests repositioning a single item, e.g. after its status, activity or name changed.
+ * @param item Item whose sort keys could have changed.
+ */
+void FriendListManager::setItemChanged(IFriendListItem* item)
+{
+    changedItems.insert(item);
+    emit itemsChanged();
+}
+
 void FriendListManager::setGroupsOnTop(bool v)
 {
+    if (groupsOnTop != v) {
+        needSort = true;
+    }
     groupsOnTop = v;
 }
 
 void FriendListManager::removeAll(IFriendListItem* item)
 {
+    changedItems.remove(item);
+    searchIndex.remove(item);
     for (int i = 0; i < items.size(); ++i) {
         if (items[i].get() == item) {
             items.remove(i);
@@ -19,9 +19,11 @@
 
 #pragma once
 
+#include "friendlistsearchindex.h"
 #include "ifriendlistitem.h"
 
 #include <QObject>
+#include <QSet>
 #include <QVector>
 
 #include <memory>
@@ -50,6 +52,8 @@ public:
     void applyFilter();
     void updatePositions();
     void setSortRequired();
+    void setCheckRequired();
+    void setItemChanged(IFriendListItem* item);
 
     void setGroupsOnTop(bool v);
 
@@ -65,6 +69,10 @@ private:
     } filterParams;
 
     void removeAll(IFriendListItem* item);
+    template <typename Compare>
+    void sortItems(Compare cmp);
+    template <typename Compare>
+    bool repositionChanged(Compare cmp);
     bool cmpByName(const IFriendListItemPtr& itemA, const IFriendListItemPtr& itemB);
     bool cmpByActivity(const IFriendListItemPtr& itemA, const IFriendListItemPtr& itemB);
 
@@ -73,7 +81,11 @@ private:
     bool groupsOnTop = true;
     bool positionsChanged = false;
     bool needSort = false;
+    bool needCheck = false;
     QVector<IFriendListItemPtr> items;
+    // Items whose sort keys changed since the last updatePositions
+    QSet<IFriendListItem*> changedItems;
+    FriendListSearchIndex searchIndex;
     // At startup, while the size of items is less than countContacts, the view will not be processed to improve performance
     int countContacts = 0;
 
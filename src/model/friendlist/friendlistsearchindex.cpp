@@ -0,0 +1,178 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "friendlistsearchindex.h"
+#include "ifriendlistitem.h"
+
+/**
+ * @class FriendListSearchIndex
+ * @brief Case insensitive substring search over the names of the friend list items.
+ *
+ * Every name is split into overlapping trigrams, a search for at least GRAM_SIZE characters
+ * only checks the items having the rarest trigram of the search string. The index is kept up to
+ * date per item, it's never rebuilt.
+ *
+ * The matches of the last search are kept, if the new search string contains the last one,
+ * which is the case while typing, only these are checked again.
+ */
+
+constexpr int FriendListSearchIndex::GRAM_SIZE;
+
+void FriendListSearchIndex::insert(IFriendListItem* item)
+{
+    const QString name = normalize(item->getNameItem());
+    names.insert(item, name);
+    addGrams(item, name);
+
+    if (!lastSearch.isEmpty() && name.contains(lastSearch)) {
+        lastMatches.insert(item);
+    }
+}
+
+void FriendListSearchIndex::remove(IFriendListItem* item)
+{
+    auto it = names.find(item);
+    if (it == names.end()) {
+        return;
+    }
+
+    removeGrams(item, it.value());
+    names.erase(it);
+    lastMatches.remove(item);
+}
+
+/**
+ * @brief Reindexes an item if its name changed.
+ * @param item Item to update, nothing happens if it isn't in the index.
+ */
+void FriendListSearchIndex::update(IFriendListItem* item)
+{
+    auto it = names.find(item);
+    if (it == names.end()) {
+        return;
+    }
+
+    const QString name = normalize(item->getNameItem());
+    if (name == it.value()) {
+        return;
+    }
+
+    removeGrams(item, it.value());
+    it.value() = name;
+    addGrams(item, name);
+
+    if (!lastSearch.isEmpty() && name.contains(lastSearch)) {
+        lastMatches.insert(item);
+    } else {
+        lastMatches.remove(item);
+    }
+}
+
+/**
+ * @brief Finds the items whose name contains the search string, ignoring case.
+ * @param searchString String to search for, an empty string matches nothing.
+ * @return Matching items.
+ */
+QSet<IFriendListItem*> FriendListSearchIndex::search(const QString& searchString)
+{
+    const QString needle = normalize(searchString);
+    if (needle.isEmpty()) {
+        lastSearch.clear();
+        lastMatches.clear();
+        return {};
+    }
+
+    if (needle == lastSearch) {
+        return lastMatches;
+    }
+
+    QSet<IFriendListItem*> checked;
+    if (!lastSearch.isEmpty() && needle.contains(lastSearch)) {
+        checked = lastMatches;
+    } else {
+        checked = candidates(needle);
+    }
+
+    QSet<IFriendListItem*> matches;
+    for (IFriendListItem* item : checked) {
+        if (names.value(item).contains(needle)) {
+            matches.insert(item);
+        }
+    }
+
+    lastSearch = needle;
+    lastMatches = matches;
+    return matches;
+}
+
+QString FriendListSearchIndex::normalize(const QString& name)
+{
+    return name.toCaseFolded();
+}
+
+void FriendListSearchIndex::addGrams(IFriendListItem* item, const QString& name)
+{
+    for (int i = 0; i + GRAM_SIZE <= name.size(); ++i) {
+        grams[name.mid(i, GRAM_SIZE)].insert(item);
+    }
+}
+
+void FriendListSearchIndex::removeGrams(IFriendListItem* item, const QString& name)
+{
+    for (int i = 0; i + GRAM_SIZE <= name.size(); ++i) {
+        auto it = grams.find(name.mid(i, GRAM_SIZE));
+        if (it == grams.end()) {
+            continue;
+        }
+
+        it.value().remove(item);
+        if (it.value().isEmpty()) {
+            grams.erase(it);
+        }
+    }
+}
+
+/**
+ * @brief Items that could contain the search string according to the trigrams.
+ */
+QSet<IFriendListItem*> FriendListSearchIndex::candidates(const QString& searchString) const
+{
+    if (searchString.size() < GRAM_SIZE) {
+        // too short for the index
+        QSet<IFriendListItem*> all;
+        for (auto it = names.constBegin(); it != names.constEnd(); ++it) {
+            all.insert(it.key());
+        }
+        return all;
+    }
+
+    // every match contains all trigrams of the search string, the rarest one is the shortest list
+    const QSet<IFriendListItem*>* rarest = nullptr;
+    for (int i = 0; i + GRAM_SIZE <= searchString.size(); ++i) {
+        auto it = grams.constFind(searchString.mid(i, GRAM_SIZE));
+        if (it == grams.constEnd()) {
+            return {};
+        }
+        if (rarest == nullptr || it.value().size() < rarest->size()) {
+            rarest = &it.value();
+        }
+    }
+
+    return *rarest;
+}
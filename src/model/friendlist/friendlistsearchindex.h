@@ -0,0 +1,50 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+class IFriendListItem;
+
+class FriendListSearchIndex
+{
+public:
+    void insert(IFriendListItem* item);
+    void remove(IFriendListItem* item);
+    void update(IFriendListItem* item);
+    QSet<IFriendListItem*> search(const QString& searchString);
+
+    static constexpr int GRAM_SIZE = 3;
+
+private:
+    static QString normalize(const QString& name);
+    void addGrams(IFriendListItem* item, const QString& name);
+    void removeGrams(IFriendListItem* item, const QString& name);
+    QSet<IFriendListItem*> candidates(const QString& searchString) const;
+
+private:
+    QHash<IFriendListItem*, QString> names;
+    QHash<QString, QSet<IFriendListItem*>> grams;
+    // Result of the last search, typing more characters only has to narrow it down
+    QString lastSearch;
+    QSet<IFriendListItem*> lastMatches;
+};
@@ -21,6 +21,8 @@
 #include "src/persistence/settings.h"
 #include "src/model/status.h"
 
+#include <algorithm>
+
 // zoff
 #include <QFile>
 #include <QDir>
@@ -35,6 +37,8 @@ FriendMessageDispatcher::FriendMessageDispatcher(Friend& f_, MessageProcessor pr
     , processor(std::move(processor_))
 {
     connect(&f, &Friend::onlineOfflineChanged, this, &FriendMessageDispatcher::onFriendOnlineOfflineChanged);
+    resendTimer.setSingleShot(true);
+    connect(&resendTimer, &QTimer::timeout, this, &FriendMessageDispatcher::resendQueuedMessages);
 }
 
 /**
@@ -113,6 +117,54 @@ void FriendMessageDispatcher::onExtReceiptReceived(uint64_t receiptId)
     offlineMsgEngine.onExtendedReceiptReceived(ExtendedReceiptNum(receiptId));
 }
 
+/**
+ * @brief Handles a queued message toxcore took
+ * @param[in] queuedId id the message was queued with
+ * @param[in] receipt receipt toxcore will ack it with
+ */
+void FriendMessageDispatcher::onCoreMessageSent(uint64_t queuedId, ReceiptNum receipt)
+{
+    // results come in the order the messages were queued, so this is almost always the front
+    const auto it = std::find_if(queuedCoreMessages.begin(), queuedCoreMessages.end(),
+                                 [queuedId](const QueuedCoreMessage& queued) {
+                                     return queued.queuedId == queuedId;
+                                 });
+    if (it == queuedCoreMessages.end()) {
+        return;
+    }
+
+    offlineMsgEngine.addSentCoreMessage(receipt, it->message, it->completionFn);
+    queuedCoreMessages.erase(it);
+}
+
+/**
+ * @brief Handles queued messages toxcore refused, they are resent in order with backoff
+ * @param[in] queuedIds ids the messages were queued with, in order
+ */
+void FriendMessageDispatcher::onCoreMessagesRefused(const QVector<uint64_t>& queuedIds)
+{
+    auto refused = std::vector<OfflineMsgEngine::RemovedMessage>();
+    for (const auto queuedId : queuedIds) {
+        const auto it = std::find_if(queuedCoreMessages.begin(), queuedCoreMessages.end(),
+                                     [queuedId](const QueuedCoreMessage& queued) {
+                                         return queued.queuedId == queuedId;
+                                     });
+        if (it == queuedCoreMessages.end()) {
+            continue;
+        }
+
+        refused.push_back(OfflineMsgEngine::RemovedMessage{it->message, it->completionFn});
+        queuedCoreMessages.erase(it);
+    }
+
+    if (refused.empty()) {
+        return;
+    }
+
+    offlineMsgEngine.requeueResends(std::move(refused), std::chrono::steady_clock::now());
+    startResendTimer();
+}
+
 /**
  * @brief Handles status change for friend
  * @note Parameters just to fit slot api
@@ -121,11 +173,32 @@ void FriendMessageDispatcher::onFriendOnlineOfflineChanged(const ToxPk& friendPk
 {
     std::ignore = friendPk;
     if (isOnline) {
-        auto messagesToResend = offlineMsgEngine.removeAllMessages();
-        for (auto const& message : messagesToResend) {
-            sendProcessedMessage(message.message, message.callback);
+        offlineMsgEngine.scheduleResend(std::chrono::steady_clock::now());
+        resendQueuedMessages();
+    } else {
+        resendTimer.stop();
+    }
+}
+
+/**
+ * @brief Sends the next batch of queued messages, stopping at the first one toxcore refuses
+ * to keep their order
+ */
+void FriendMessageDispatcher::resendQueuedMessages()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto batch = offlineMsgEngine.takeResendBatch(now);
+    size_t sentCount = 0;
+    for (auto const& message : batch) {
+        if (!Status::isOnline(f.getStatus())
+            || !trySendProcessedMessage(message.message, message.callback)) {
+            break;
         }
+        ++sentCount;
     }
+
+    offlineMsgEngine.completeResendBatch(sentCount, now);
+    startResendTimer();
 }
 
 /**
@@ -133,6 +206,8 @@ void FriendMessageDispatcher::onFriendOnlineOfflineChanged(const ToxPk& friendPk
  */
 void FriendMessageDispatcher::clearOutgoingMessages()
 {
+    resendTimer.stop();
+    queuedCoreMessages.clear();
     offlineMsgEngine.removeAllMessages();
 }
 
@@ -144,22 +219,46 @@ void FriendMessageDispatcher::sendProcessedMessage(Message const& message, Offli
         return;
     }
 
+    // A new message must not overtake the ones still waiting to be resent, and one that couldn't
+    // be sent is retried with backoff, with later messages queued up behind it
+    if (offlineMsgEngine.hasPendingResends() || !trySendProcessedMessage(message, onOfflineMsgComplete)) {
+        offlineMsgEngine.addResend(message, onOfflineMsgComplete);
+        startResendTimer();
+    }
+}
+
+/**
+ * @return False if the message couldn't be sent, it isn't tracked then. Core messages are only
+ * queued here, see onCoreMessagesRefused() for toxcore refusing them later.
+ */
+bool FriendMessageDispatcher::trySendProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete)
+{
     if (message.extensionSet[ExtensionType::messages] && !message.isAction) {
-        sendExtendedProcessedMessage(message, onOfflineMsgComplete);
-    } else {
-        sendCoreProcessedMessage(message, onOfflineMsgComplete);
+        return sendExtendedProcessedMessage(message, onOfflineMsgComplete);
     }
+
+    sendCoreProcessedMessage(message, onOfflineMsgComplete);
+    return true;
 }
 
+void FriendMessageDispatcher::startResendTimer()
+{
+    const int waitMs = offlineMsgEngine.msUntilNextResend(std::chrono::steady_clock::now());
+    if (waitMs < 0 || !Status::isOnline(f.getStatus())) {
+        resendTimer.stop();
+        return;
+    }
 
+    resendTimer.start(waitMs);
+}
 
-void FriendMessageDispatcher::sendExtendedProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete)
+bool FriendMessageDispatcher::sendExtendedProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete)
 {
     assert(!message.isAction); // Actions not supported with extensions
 
     if ((f.getSupportedExtensions() & message.extensionSet) != message.extensionSet) {
         onOfflineMsgComplete(false);
-        return;
+        return true;
     }
 
     auto receipt = ExtendedReceiptNum();
@@ -175,27 +274,19 @@ void FriendMessageDispatcher::sendExtendedProcessedMessage(Message const& messag
 
     if (messageSent) {
         offlineMsgEngine.addSentExtendedMessage(receipt, message, onOfflineMsgComplete);
-    } else {
-        offlineMsgEngine.addUnsentMessage(message, onOfflineMsgComplete);
     }
+    return messageSent;
 }
 
 void FriendMessageDispatcher::sendCoreProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete)
 {
-    auto receipt = ReceiptNum();
-
     uint32_t friendId = f.getId();
 
-    auto sendFn = message.isAction ? std::mem_fn(&ICoreFriendMessageSender::sendAction)
-                                   : std::mem_fn(&ICoreFriendMessageSender::sendMessage);
-
-    const auto messageSent = sendFn(messageSender, friendId, message.content, message.id_or_hash, message.timestamp, receipt);
+    auto queueFn = message.isAction ? std::mem_fn(&ICoreFriendMessageSender::queueAction)
+                                    : std::mem_fn(&ICoreFriendMessageSender::queueMessage);
 
-    if (messageSent) {
-        offlineMsgEngine.addSentCoreMessage(receipt, message, onOfflineMsgComplete);
-    } else {
-        offlineMsgEngine.addUnsentMessage(message, onOfflineMsgComplete);
-    }
+    const auto queuedId = queueFn(messageSender, friendId, message.content, message.id_or_hash, message.timestamp);
+    queuedCoreMessages.push_back(QueuedCoreMessage{queuedId, message, onOfflineMsgComplete});
 }
 
 OfflineMsgEngine::CompletionFn FriendMessageDispatcher::getCompletionFn(DispatchedMessageId messageId)
@@ -27,8 +27,11 @@
 
 #include <QObject>
 #include <QString>
+#include <QTimer>
+#include <QVector>
 
 #include <cstdint>
+#include <deque>
 
 class FriendMessageDispatcher : public IMessageDispatcher
 {
@@ -47,14 +50,19 @@ public:
     void onReceiptReceived(ReceiptNum receipt);
     void onExtMessageReceived(const QString& content);
     void onExtReceiptReceived(uint64_t receiptId);
+    void onCoreMessageSent(uint64_t queuedId, ReceiptNum receipt);
+    void onCoreMessagesRefused(const QVector<uint64_t>& queuedIds);
     void clearOutgoingMessages();
 private slots:
     void onFriendOnlineOfflineChanged(const ToxPk& friendPk, bool isOnline);
+    void resendQueuedMessages();
 
 private:
     void sendProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete);
-    void sendExtendedProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete);
+    bool trySendProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete);
+    bool sendExtendedProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete);
     void sendCoreProcessedMessage(Message const& message, OfflineMsgEngine::CompletionFn onOfflineMsgComplete);
+    void startResendTimer();
     OfflineMsgEngine::CompletionFn getCompletionFn(DispatchedMessageId messageId);
 
     Friend& f;
@@ -63,5 +71,14 @@ private:
 
     ICoreFriendMessageSender& messageSender;
     OfflineMsgEngine offlineMsgEngine;
+    struct QueuedCoreMessage
+    {
+        uint64_t queuedId;
+        Message message;
+        OfflineMsgEngine::CompletionFn completionFn;
+    };
+    // handed to core, waiting for toxcore to take them, in order
+    std::deque<QueuedCoreMessage> queuedCoreMessages;
+    QTimer resendTimer;
     MessageProcessor processor;
 };
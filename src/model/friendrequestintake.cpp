@@ -0,0 +1,116 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "friendrequestintake.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+/**
+ * @class FriendRequestIntake
+ * @brief Queues the friend requests Core reports and hands them to the GUI in small batches.
+ *
+ * Spam waves send thousands of friend requests within seconds, and every one of them used to
+ * add a widget, an alert and a notification right away. The intake keeps one pending request
+ * per public key, a repeated one only replaces the message, and at most MAX_PENDING of them,
+ * further ones are dropped until the queue drains. requestsReceived() delivers at most
+ * MAX_BATCH requests at a time and at most once per FLUSH_INTERVAL_MS, the first request after
+ * a quiet period right on the next event loop turn.
+ */
+
+constexpr int FriendRequestIntake::MAX_PENDING;
+constexpr int FriendRequestIntake::MAX_BATCH;
+constexpr int FriendRequestIntake::FLUSH_INTERVAL_MS;
+
+FriendRequestIntake::FriendRequestIntake(QObject* parent)
+    : QObject(parent)
+{
+    flushTimer.setSingleShot(true);
+    connect(&flushTimer, &QTimer::timeout, this, &FriendRequestIntake::flush);
+}
+
+/**
+ * @brief Delivers the oldest pending requests now, up to MAX_BATCH.
+ */
+void FriendRequestIntake::flush()
+{
+    flushTimer.stop();
+    lastFlush.start();
+    if (dropped > 0) {
+        qWarning() << "Dropped" << dropped << "friend requests, too many were pending";
+        dropped = 0;
+    }
+
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    const int count = std::min(pending.size(), MAX_BATCH);
+    const QVector<Request> batch = pending.mid(0, count);
+    pending.remove(0, count);
+    pendingIndex.clear();
+    for (int i = 0; i < pending.size(); ++i) {
+        pendingIndex.insert(pending.at(i).friendPk, i);
+    }
+
+    scheduleFlush();
+    emit requestsReceived(batch);
+}
+
+int FriendRequestIntake::getPendingCount() const
+{
+    return pending.size();
+}
+
+/**
+ * @brief Number of requests dropped since the last flush because the queue was full.
+ */
+int FriendRequestIntake::getDroppedCount() const
+{
+    return dropped;
+}
+
+void FriendRequestIntake::onFriendRequestReceived(const ToxPk& friendPk, const QString& message)
+{
+    auto it = pendingIndex.constFind(friendPk);
+    if (it != pendingIndex.constEnd()) {
+        pending[it.value()].message = message;
+        return;
+    }
+
+    if (pending.size() >= MAX_PENDING) {
+        ++dropped;
+        return;
+    }
+
+    pendingIndex.insert(friendPk, pending.size());
+    pending.append({friendPk, message});
+    scheduleFlush();
+}
+
+void FriendRequestIntake::scheduleFlush()
+{
+    if (pending.isEmpty() || flushTimer.isActive()) {
+        return;
+    }
+
+    const qint64 sinceFlush = lastFlush.isValid() ? lastFlush.elapsed() : FLUSH_INTERVAL_MS;
+    flushTimer.start(static_cast<int>(std::max<qint64>(0, FLUSH_INTERVAL_MS - sinceFlush)));
+}
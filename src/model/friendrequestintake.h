@@ -0,0 +1,67 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "src/core/toxpk.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+class FriendRequestIntake : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        ToxPk friendPk;
+        QString message;
+    };
+
+    explicit FriendRequestIntake(QObject* parent = nullptr);
+
+    void flush();
+    int getPendingCount() const;
+    int getDroppedCount() const;
+
+    static constexpr int MAX_PENDING = 100;
+    static constexpr int MAX_BATCH = 20;
+    static constexpr int FLUSH_INTERVAL_MS = 1000;
+
+signals:
+    void requestsReceived(const QVector<FriendRequestIntake::Request>& requests);
+
+public slots:
+    void onFriendRequestReceived(const ToxPk& friendPk, const QString& message);
+
+private:
+    void scheduleFlush();
+
+    QTimer flushTimer;
+    QElapsedTimer lastFlush;
+    // in the order the keys first asked, the index maps into it
+    QVector<Request> pending;
+    QHash<ToxPk, int> pendingIndex;
+    int dropped = 0;
+};
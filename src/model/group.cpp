@@ -114,6 +114,8 @@ void Group::regeneratePeerList()
     // receive the name changed signal a little later, we will emit userJoined before we have their
     // username, using just their ToxPk, then shortly after emit another peerNameChanged signal.
     // This can cause double-updated to UI and chatlog, but is unavoidable given the API of toxcore.
+    // NGC groups only do this once when joining, afterwards Core reports single peers, see
+    // addPeer, removePeer and renamePeer.
     QStringList peers = groupQuery.getGroupPeerNames(toxGroupNum);
     const auto oldPeerNames = peerDisplayNames;
     peerDisplayNames.clear();
@@ -174,6 +176,77 @@ void Group::regeneratePeerList()
     }
 }
 
+/**
+ * @brief Adds a peer that joined, without looking at the other peers.
+ * @param peerId Id of the peer in this group.
+ * @param pk Public key of the peer.
+ * @param name Name of the peer, may still be empty.
+ */
+void Group::addPeer(uint32_t peerId, const ToxPk& pk, const QString& name)
+{
+    const QString displayName = friendList.decideNickname(pk, ngcPeerName(peerId, name));
+    auto it = peerDisplayNames.find(pk);
+    if (it != peerDisplayNames.end()) {
+        // we already know them, e.g. from the resync when joining the group
+        if (*it != displayName) {
+            const QString oldName = *it;
+            *it = displayName;
+            emit peerNameChanged(pk, oldName, displayName);
+        }
+        return;
+    }
+
+    peerDisplayNames.insert(pk, displayName);
+    emit userJoined(pk, displayName);
+    emit numPeersChanged(peerDisplayNames.size());
+}
+
+/**
+ * @brief Removes a peer that left the group.
+ * @param pk Public key of the peer.
+ */
+void Group::removePeer(const ToxPk& pk)
+{
+    auto it = peerDisplayNames.find(pk);
+    if (it == peerDisplayNames.end()) {
+        return;
+    }
+
+    const QString name = *it;
+    peerDisplayNames.erase(it);
+    emit userLeft(pk, name);
+    emit numPeersChanged(peerDisplayNames.size());
+}
+
+/**
+ * @brief Updates the name of a single peer.
+ * @param peerId Id of the peer in this group.
+ * @param pk Public key of the peer.
+ * @param name New name of the peer.
+ */
+void Group::renamePeer(uint32_t peerId, const ToxPk& pk, const QString& name)
+{
+    if (!peerDisplayNames.contains(pk)) {
+        // the name can be announced before the join
+        addPeer(peerId, pk, name);
+        return;
+    }
+
+    updateUsername(pk, ngcPeerName(peerId, name));
+}
+
+/**
+ * @brief Name of an NGC peer as the full peer list shows it, prefixed with the peer id.
+ */
+QString Group::ngcPeerName(uint32_t peerId, const QString& name) const
+{
+    if (name.isEmpty() || toxGroupNum < static_cast<int>(Settings::NGC_GROUPNUM_OFFSET)) {
+        return name;
+    }
+
+    return QString::number(peerId) + QString(":") + name;
+}
+
 void Group::updateUsername(ToxPk pk, const QString newName)
 {
     const QString displayName = friendList.decideNickname(pk, newName);
@@ -45,6 +45,9 @@ public:
     const GroupId& getPersistentId() const override;
     int getPeersCount() const;
     void regeneratePeerList();
+    void addPeer(uint32_t peerId, const ToxPk& pk, const QString& name);
+    void removePeer(const ToxPk& pk);
+    void renamePeer(uint32_t peerId, const ToxPk& pk, const QString& name);
     const QMap<ToxPk, QString>& getPeerList() const;
     bool peerHasNickname(ToxPk pk);
 
@@ -72,6 +75,9 @@ signals:
     void numPeersChanged(int numPeers);
     void peerNameChanged(const ToxPk& peer, const QString& oldName, const QString& newName);
 
+private:
+    QString ngcPeerName(uint32_t peerId, const QString& name) const;
+
 private:
     ICoreGroupQuery& groupQuery;
     ICoreIdHandler& idHandler;
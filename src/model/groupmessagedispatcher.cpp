@@ -41,6 +41,8 @@ GroupMessageDispatcher::sendMessage(bool isAction, QString const& content)
     const auto firstMessageId = nextMessageId;
     auto lastMessageId = firstMessageId;
 
+    // Core queues the chunks and sends them in one go, history stores them in one transaction
+    emit sendBatchStarted();
     for (auto const& message : processor.processOutgoingMessage(isAction, content, ExtensionSet())) {
         auto messageId = nextMessageId++;
         lastMessageId = messageId;
@@ -61,6 +63,7 @@ GroupMessageDispatcher::sendMessage(bool isAction, QString const& content)
         emit messageSent(messageId, message);
         emit messageComplete(messageId);
     }
+    emit sendBatchFinished();
 
     return std::make_pair(firstMessageId, lastMessageId);
 }
@@ -101,6 +104,32 @@ void GroupMessageDispatcher::onMessageReceived(const ToxPk& sender, bool isActio
     emit messageReceived(sender, processor.processIncomingCoreMessage(isAction, content, isPrivate), hasIdType);
 }
 
+/**
+ * @brief Dispatches a message a peer sent us as part of a history sync
+ * @param[in] sender Author of the message
+ * @param[in] timestamp Time the message was originally received by the peer
+ * @param[in] content Message content, prefixed with its NGC message id
+ * @param[in] hasIdType Kind of id the content is prefixed with
+ * @note Duplicates were already dropped by Core, see NgcSyncIndex.
+ */
+void GroupMessageDispatcher::onSyncMessageReceived(const ToxPk& sender, const QDateTime& timestamp,
+                                                   QString const& content, const int hasIdType)
+{
+    // our own messages are in the history already
+    if (sender == idHandler.getSelfPublicKey()) {
+        return;
+    }
+
+    if (groupSettings.getBlackList().contains(sender.toString())) {
+        qDebug() << "onSyncMessageReceived: Filtered:" << sender.toString();
+        return;
+    }
+
+    Message message = processor.processIncomingCoreMessage(false, content);
+    message.timestamp = timestamp;
+    emit messageReceived(sender, message, hasIdType);
+}
+
 void GroupMessageDispatcher::onGroupSyncHistoryReqRecv(const ToxPk& sender, int groupnumber, int peernumber)
 {
     // qDebug() << "onGroupSyncHistoryReqRecv:";
@@ -25,6 +25,7 @@
 #include "src/model/imessagedispatcher.h"
 #include "src/model/message.h"
 
+#include <QDateTime>
 #include <QObject>
 #include <QString>
 
@@ -46,6 +47,8 @@ public:
     std::pair<DispatchedMessageId, DispatchedMessageId> sendExtendedMessage(const QString& content,
                             ExtensionSet extensions) override;
     void onMessageReceived(ToxPk const& sender, bool isAction, bool isPrivate, QString const& content, const int hasIdType = 0);
+    void onSyncMessageReceived(ToxPk const& sender, QDateTime const& timestamp,
+                               QString const& content, const int hasIdType);
     void onGroupSyncHistoryReqRecv(ToxPk const& sender, int groupnumber, int peernumber);
 
 private:
@@ -0,0 +1,97 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "historyprefetcher.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class HistoryPrefetcher
+ * @brief Loads pages of history off the GUI thread before the chat log asks for them.
+ *
+ * Queries only read from the database, so RawDatabase serves them from a read only connection
+ * on the prefetch thread. Finished pages are handed back on the GUI thread. Only one page per
+ * start index is in flight at a time.
+ *
+ * cancel() drops all requested pages, e.g. when the user jumps to a different part of the chat.
+ * Queries that didn't start yet are skipped, running ones finish but their result is discarded.
+ */
+
+HistoryPrefetcher::HistoryPrefetcher(History& history_, QObject* parent)
+    : QObject(parent)
+    , history{history_}
+    , cancelled{std::make_shared<std::atomic<bool>>(false)}
+{
+    // one chat is viewed at a time, there is no point in racing its own queries
+    pool.setMaxThreadCount(1);
+}
+
+HistoryPrefetcher::~HistoryPrefetcher()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+/**
+ * @brief Runs a history query in the background.
+ * @param pageBegin Chat log index of the first message of the page.
+ * @param query Called on the prefetch thread, must only use thread safe History functions.
+ * @param onReady Called on the GUI thread with the result, unless cancel() was called first.
+ * @return False if the page is already being fetched.
+ */
+bool HistoryPrefetcher::fetch(ChatLogIdx pageBegin, Query query, PageReady onReady)
+{
+    if (!pending.insert(pageBegin).second) {
+        return false;
+    }
+
+    auto token = cancelled;
+    History& db = history;
+    auto watcher = new QFutureWatcher<QVector<History::HistMessage>>(this);
+    connect(watcher, &QFutureWatcher<QVector<History::HistMessage>>::finished, this,
+            [this, watcher, token, pageBegin, onReady] {
+                watcher->deleteLater();
+                if (*token) {
+                    return;
+                }
+
+                pending.erase(pageBegin);
+                onReady(watcher->result());
+            });
+    watcher->setFuture(QtConcurrent::run(&pool, [&db, token, query] {
+        if (*token) {
+            return QVector<History::HistMessage>{};
+        }
+        return query(db);
+    }));
+
+    return true;
+}
+
+/**
+ * @brief Discards all pages requested so far.
+ */
+void HistoryPrefetcher::cancel()
+{
+    *cancelled = true;
+    cancelled = std::make_shared<std::atomic<bool>>(false);
+    pending.clear();
+}
@@ -0,0 +1,55 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "ichatlog.h"
+#include "src/persistence/history.h"
+
+#include <QVector>
+#include <QObject>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+
+class HistoryPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Query = std::function<QVector<History::HistMessage>(History& history)>;
+    using PageReady = std::function<void(const QVector<History::HistMessage>& messages)>;
+
+    explicit HistoryPrefetcher(History& history, QObject* parent = nullptr);
+    ~HistoryPrefetcher();
+
+    bool fetch(ChatLogIdx pageBegin, Query query, PageReady onReady);
+    void cancel();
+
+private:
+    History& history;
+    QThreadPool pool;
+    std::set<ChatLogIdx> pending;
+    // Set once the pages requested so far are no longer wanted
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
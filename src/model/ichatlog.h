@@ -33,6 +33,7 @@
 #include "util/strongtype.h"
 
 #include <cassert>
+#include <tuple>
 
 using ChatLogIdx =
     NamedType<size_t, struct ChatLogIdxTag, Orderable, UnderlyingAddable, UnitlessDifferencable, Incrementable>;
@@ -143,6 +144,19 @@ public:
      */
     virtual void addSystemMessage(const SystemMessage& message) = 0;
 
+    /**
+     * @brief Tells the chat log which items are currently rendered
+     * @param[in] begin first rendered idx
+     * @param[in] end idx after the last rendered one
+     * @note Only a hint, chat logs backed by storage may load items around the window ahead of
+     * time. The default does nothing
+     */
+    virtual void setRenderedWindow(ChatLogIdx begin, ChatLogIdx end)
+    {
+        std::ignore = begin;
+        std::ignore = end;
+    }
+
 signals:
     void itemUpdated(ChatLogIdx idx);
 };
@@ -0,0 +1,125 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imagecontainer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @namespace ImageContainer
+ * @brief Tells image formats apart by their magic bytes.
+ *
+ * Qt's format detection asks every image plugin in turn and doesn't detect some WebP files at
+ * all, so decoders used to try auto detection and then WebP, decoding broken images twice.
+ * Knowing the container up front picks the decoder once.
+ */
+
+namespace {
+bool startsWith(const QByteArray& data, int offset, const char* magic)
+{
+    const int length = static_cast<int>(std::strlen(magic));
+    return data.size() >= offset + length
+           && std::memcmp(data.constData() + offset, magic, length) == 0;
+}
+
+uint32_t readBigEndian32(const QByteArray& data, int offset)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.constData() + offset);
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16)
+           | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+/**
+ * @brief Checks the major and compatible brands of an ISO BMFF ftyp box for AVIF.
+ */
+bool isAvif(const QByteArray& data)
+{
+    if (!startsWith(data, 4, "ftyp") || data.size() < 16) {
+        return false;
+    }
+
+    const int boxSize = static_cast<int>(
+        std::min<uint32_t>(readBigEndian32(data, 0), static_cast<uint32_t>(data.size())));
+    // major brand at 8, minor version at 12, then the compatible brands
+    for (int offset = 8; offset + 4 <= boxSize; offset += offset == 8 ? 8 : 4) {
+        if (startsWith(data, offset, "avif") || startsWith(data, offset, "avis")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+} // namespace
+
+/**
+ * @brief Detects the container of an encoded image.
+ * @param data Encoded image, only the first bytes are looked at.
+ * @return The format, Unknown if none of the known signatures matched.
+ */
+ImageContainer::Format ImageContainer::sniff(const QByteArray& data)
+{
+    if (startsWith(data, 0, "\x89PNG\r\n\x1a\n")) {
+        return Format::Png;
+    }
+    if (startsWith(data, 0, "\xff\xd8\xff")) {
+        return Format::Jpeg;
+    }
+    if (startsWith(data, 0, "GIF87a") || startsWith(data, 0, "GIF89a")) {
+        return Format::Gif;
+    }
+    if (startsWith(data, 0, "RIFF") && startsWith(data, 8, "WEBP")) {
+        return Format::Webp;
+    }
+    if (isAvif(data)) {
+        return Format::Avif;
+    }
+    if (startsWith(data, 0, "BM")) {
+        return Format::Bmp;
+    }
+
+    return Format::Unknown;
+}
+
+/**
+ * @brief Name of a format for QImageReader.
+ * @return Format name, empty for Unknown to let Qt detect the format.
+ */
+QByteArray ImageContainer::qtFormat(Format format)
+{
+    switch (format) {
+    case Format::Png:
+        return QByteArrayLiteral("PNG");
+    case Format::Jpeg:
+        return QByteArrayLiteral("JPEG");
+    case Format::Gif:
+        return QByteArrayLiteral("GIF");
+    case Format::Bmp:
+        return QByteArrayLiteral("BMP");
+    case Format::Webp:
+        return QByteArrayLiteral("WEBP");
+    case Format::Avif:
+        return QByteArrayLiteral("AVIF");
+    case Format::Unknown:
+        break;
+    }
+
+    return {};
+}
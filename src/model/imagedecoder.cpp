@@ -0,0 +1,129 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "imagedecoder.h"
+#include "src/model/exiftransform.h"
+#include "util/threadscheduling.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QObject>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class ImageDecoder
+ * @brief Decodes local images for previews off the GUI thread.
+ *
+ * Only the start of the file is read for the EXIF orientation, the image itself is decoded
+ * directly at the size it is shown at, and the orientation is applied to that small image.
+ * Decoding a large photo at full resolution first took seconds and hundreds of MB.
+ */
+
+constexpr int ImageDecoder::MAX_THREADS;
+
+namespace {
+QThreadPool& decodePool()
+{
+    static QThreadPool pool;
+    static const bool initialized = [] {
+        pool.setMaxThreadCount(ImageDecoder::MAX_THREADS);
+        return true;
+    }();
+    Q_UNUSED(initialized)
+    return pool;
+}
+} // namespace
+
+/**
+ * @brief Decodes an image file on the decode thread pool.
+ * @param path Image file.
+ * @param boundingSize Size to scale down to keeping the aspect ratio, invalid for the original.
+ * @param receiver Callback is dropped if this object is deleted before the image is ready.
+ * @param onReady Called on the GUI thread, with a null image if decoding failed.
+ */
+void ImageDecoder::decodeFileAsync(const QString& path, QSize boundingSize, QObject* receiver,
+                                   ReadyCallback onReady)
+{
+    // the watcher is deleted together with the receiver, which drops the callback
+    auto watcher = new QFutureWatcher<QImage>(receiver);
+    QObject::connect(watcher, &QFutureWatcher<QImage>::finished, receiver, [watcher, onReady] {
+        onReady(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&decodePool(), [path, boundingSize] {
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+        return decodeFile(path, boundingSize);
+    }));
+}
+
+/**
+ * @note Thread safe.
+ */
+QImage ImageDecoder::decodeFile(const QString& path, QSize boundingSize)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Couldn't open image" << path;
+        return {};
+    }
+
+    return decode(file, boundingSize);
+}
+
+/**
+ * @brief Decodes an image, scaled down to fit into boundingSize after applying its orientation.
+ * @param device Open device positioned at the start of the image.
+ * @param boundingSize Size to scale down to keeping the aspect ratio, invalid for the original.
+ * @return The image, null if it couldn't be decoded.
+ * @note Thread safe, only uses QImage.
+ */
+QImage ImageDecoder::decode(QIODevice& device, QSize boundingSize)
+{
+    const ExifTransform::Orientation orientation = ExifTransform::getOrientation(device);
+
+    QImageReader reader{&device};
+    // orientation is applied below, after scaling
+    reader.setAutoTransform(false);
+
+    QSize scaledSize = reader.size();
+    if (boundingSize.isValid() && scaledSize.isValid()) {
+        if (ExifTransform::swapsDimensions(orientation)) {
+            boundingSize.transpose();
+        }
+
+        if (scaledSize.width() > boundingSize.width()
+            || scaledSize.height() > boundingSize.height()) {
+            // decoders supporting it decode directly at the smaller size
+            scaledSize.scale(boundingSize, Qt::KeepAspectRatio);
+            reader.setScaledSize(scaledSize);
+        }
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qDebug() << "Failed to decode image:" << reader.errorString();
+        return image;
+    }
+
+    return ExifTransform::applyTransformation(image, orientation);
+}
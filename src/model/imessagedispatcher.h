@@ -88,5 +88,12 @@ signals:
 
     void messageBroken(DispatchedMessageId id, BrokenMessageReason reason);
 
+    /**
+     * @brief Emitted around the messages one sendMessage() call was split into, so storing
+     *        them can be batched
+     */
+    void sendBatchStarted();
+    void sendBatchFinished();
+
     void groupSyncHistReqRecv(ToxPk const& sender, int groupnumber, int peernumber);
 };
@@ -23,48 +23,97 @@
 
 #include <QDebug>
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace {
+    /**
+     * @brief Finds the last c in data[1..last], a chunk can't be empty so data[0] doesn't count
+     * @return Position of c, 0 if there is none
+     */
+    int lastIndexOf(const char* data, int last, char c)
+    {
+        for (int i = last; i > 0; --i) {
+            if (data[i] == c) {
+                return i;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Builds a regex matching text as a whole word
+     * @return Empty regex if there's nothing to match
+     */
+    QRegularExpression wordMention(const QString& text)
+    {
+        if (text.isEmpty()) {
+            return {};
+        }
+
+        QRegularExpression mention{"\\b" + text + "\\b", QRegularExpression::CaseInsensitiveOption};
+        // compile now instead of on the first received message
+        mention.optimize();
+        return mention;
+    }
+
     QStringList splitMessage(const QString& message, uint64_t maxLength)
     {
         QStringList splittedMsgs;
-        QByteArray ba_message{message.toUtf8()};
-        while (static_cast<uint64_t>(ba_message.size()) > maxLength) {
-            int splitPos = ba_message.lastIndexOf('\n', maxLength - 1);
+        // encoded once, the chunks are decoded from views into this buffer
+        const QByteArray ba_message{message.toUtf8()};
+        const char* rest = ba_message.constData();
+        int restSize = ba_message.size();
+        const int maxSize =
+            static_cast<int>(std::min<uint64_t>(maxLength, std::numeric_limits<int>::max()));
+        while (restSize > maxSize) {
+            int splitPos = lastIndexOf(rest, maxSize - 1, '\n');
 
             if (splitPos <= 0) {
-                splitPos = ba_message.lastIndexOf(' ', maxLength - 1);
+                splitPos = lastIndexOf(rest, maxSize - 1, ' ');
             }
 
             if (splitPos <= 0) {
                 constexpr uint8_t firstOfMultiByteMask = 0xC0;
                 constexpr uint8_t multiByteMask = 0x80;
-                splitPos = maxLength;
+                splitPos = maxSize;
                 // don't split a utf8 character
-                if ((ba_message[splitPos] & multiByteMask) == multiByteMask) {
-                    while ((ba_message[splitPos] & firstOfMultiByteMask) != firstOfMultiByteMask) {
+                if ((static_cast<uint8_t>(rest[splitPos]) & multiByteMask) == multiByteMask) {
+                    while (splitPos > 0
+                           && (static_cast<uint8_t>(rest[splitPos]) & firstOfMultiByteMask)
+                                  != firstOfMultiByteMask) {
                         --splitPos;
                     }
                 }
                 --splitPos;
+                // not utf8 at all, split anywhere
+                if (splitPos < 0) {
+                    splitPos = maxSize - 1;
+                }
             }
-            splittedMsgs.append(QString::fromUtf8(ba_message.left(splitPos + 1)));
-            ba_message = ba_message.mid(splitPos + 1);
+            splittedMsgs.append(QString::fromUtf8(rest, splitPos + 1));
+            rest += splitPos + 1;
+            restSize -= splitPos + 1;
         }
 
-        splittedMsgs.append(QString::fromUtf8(ba_message));
+        splittedMsgs.append(QString::fromUtf8(rest, restSize));
         return splittedMsgs;
     }
 }
 void MessageProcessor::SharedParams::onUserNameSet(const QString& username)
 {
+    // the regexes are only rebuilt when the name really changes
+    if (username == userName && !nameMention.pattern().isEmpty()) {
+        return;
+    }
+
+    userName = username;
     QString sanename = username;
     sanename.remove(QRegularExpression("[\\t\\n\\v\\f\\r\\x0000]"));
-    nameMention = QRegularExpression("\\b" + QRegularExpression::escape(username) + "\\b",
-                                     QRegularExpression::CaseInsensitiveOption);
-    sanitizedNameMention = QRegularExpression("\\b" + QRegularExpression::escape(sanename) + "\\b",
-                                              QRegularExpression::CaseInsensitiveOption);
+    nameMention = wordMention(QRegularExpression::escape(username));
+    sanitizedNameMention = wordMention(QRegularExpression::escape(sanename));
 }
 
 /**
@@ -74,8 +123,7 @@ void MessageProcessor::SharedParams::onUserNameSet(const QString& username)
 void MessageProcessor::SharedParams::setPublicKey(const QString& pk)
 {
     // no sanitization needed, we expect a ToxPk in its string form
-    pubKeyMention = QRegularExpression("\\b" + pk + "\\b",
-                                       QRegularExpression::CaseInsensitiveOption);
+    pubKeyMention = wordMention(pk);
 }
 
 MessageProcessor::MessageProcessor(const MessageProcessor::SharedParams& sharedParams_)
@@ -140,17 +188,21 @@ Message MessageProcessor::processIncomingCoreMessage(bool isAction, QString cons
     // qDebug() << "processIncomingCoreMessage: isPrivate:" << isPrivate;
 
     if (detectingMentions) {
-        auto nameMention = sharedParams.getNameMention();
-        auto sanitizedNameMention = sharedParams.getSanitizedNameMention();
-        auto pubKeyMention = sharedParams.getPublicKeyMention();
+        const QRegularExpression* mentions[] = {&sharedParams.getNameMention(),
+                                                &sharedParams.getSanitizedNameMention(),
+                                                &sharedParams.getPublicKeyMention()};
 
-        for (auto const& mention : {nameMention, sanitizedNameMention, pubKeyMention}) {
-            auto matchIt = mention.globalMatch(ret.content);
-            if (!matchIt.hasNext()) {
+        for (const auto* mention : mentions) {
+            // empty for an empty name, it would match everywhere
+            if (mention->pattern().isEmpty()) {
                 continue;
             }
 
-            auto match = matchIt.next();
+            // only the first mention is marked
+            const auto match = mention->match(ret.content);
+            if (!match.hasMatch()) {
+                continue;
+            }
 
             auto pos = static_cast<size_t>(match.capturedStart());
             auto length = static_cast<size_t>(match.capturedLength());
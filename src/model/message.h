@@ -78,15 +78,15 @@ public:
             , maxExtendedMessageSize(maxExtendedMessageSize_)
         {}
 
-        QRegularExpression getNameMention() const
+        const QRegularExpression& getNameMention() const
         {
             return nameMention;
         }
-        QRegularExpression getSanitizedNameMention() const
+        const QRegularExpression& getSanitizedNameMention() const
         {
             return sanitizedNameMention;
         }
-        QRegularExpression getPublicKeyMention() const
+        const QRegularExpression& getPublicKeyMention() const
         {
             return pubKeyMention;
         }
@@ -106,6 +106,7 @@ public:
     private:
         uint64_t maxCoreMessageSize;
         uint64_t maxExtendedMessageSize;
+        QString userName;
         QRegularExpression nameMention;
         QRegularExpression sanitizedNameMention;
         QRegularExpression pubKeyMention;
@@ -0,0 +1,100 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "notificationcoalescer.h"
+
+/**
+ * @class NotificationCoalescer
+ * @brief Limits how often desktop notifications are shown and notification sounds are played.
+ *
+ * NotificationGenerator already counts the unread messages per chat and summarizes them in every
+ * notification it generates, so when many messages arrive at once only the latest notification
+ * matters. The first notification is shown right away and opens a window of WINDOW_MS, later
+ * notifications within the window only replace the pending one, which is shown when the window
+ * ends. A busy group or a history sync thus updates the desktop notification at most once per
+ * window instead of once per message.
+ *
+ * Sounds are rate limited separately, allowSound() returns true at most once per
+ * SOUND_INTERVAL_MS.
+ */
+
+constexpr int NotificationCoalescer::WINDOW_MS;
+constexpr int NotificationCoalescer::SOUND_INTERVAL_MS;
+
+NotificationCoalescer::NotificationCoalescer(int windowMs, int soundIntervalMs_, QObject* parent)
+    : QObject(parent)
+    , soundIntervalMs{soundIntervalMs_}
+{
+    windowTimer.setSingleShot(true);
+    windowTimer.setInterval(windowMs);
+    connect(&windowTimer, &QTimer::timeout, this, &NotificationCoalescer::onWindowEnded);
+}
+
+/**
+ * @brief Shows the notification now, or when the current window ends.
+ * @param notificationData Notification that supersedes all pending ones.
+ */
+void NotificationCoalescer::addNotification(const NotificationData& notificationData)
+{
+    if (windowTimer.isActive()) {
+        pending = notificationData;
+        hasPending = true;
+        return;
+    }
+
+    windowTimer.start();
+    emit notificationReady(notificationData);
+}
+
+/**
+ * @brief Checks if a notification sound may be played now.
+ * @return True if no sound was allowed within the last sound interval.
+ */
+bool NotificationCoalescer::allowSound()
+{
+    if (lastSound.isValid() && lastSound.elapsed() < soundIntervalMs) {
+        return false;
+    }
+
+    lastSound.start();
+    return true;
+}
+
+/**
+ * @brief Drops the pending notification, e.g. once the user saw the messages.
+ */
+void NotificationCoalescer::clear()
+{
+    pending = {};
+    hasPending = false;
+}
+
+void NotificationCoalescer::onWindowEnded()
+{
+    if (!hasPending) {
+        return;
+    }
+
+    // keep coalescing while the storm lasts
+    windowTimer.start();
+    const NotificationData notificationData = pending;
+    clear();
+    emit notificationReady(notificationData);
+}
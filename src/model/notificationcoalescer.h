@@ -0,0 +1,58 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "notificationdata.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+class NotificationCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NotificationCoalescer(int windowMs = WINDOW_MS, int soundIntervalMs = SOUND_INTERVAL_MS,
+                                   QObject* parent = nullptr);
+
+    void addNotification(const NotificationData& notificationData);
+    bool allowSound();
+
+    static constexpr int WINDOW_MS = 500;
+    static constexpr int SOUND_INTERVAL_MS = 2000;
+
+signals:
+    void notificationReady(const NotificationData& notificationData);
+
+public slots:
+    void clear();
+
+private slots:
+    void onWindowEnded();
+
+private:
+    QTimer windowTimer;
+    NotificationData pending;
+    bool hasPending = false;
+    QElapsedTimer lastSound;
+    const int soundIntervalMs;
+};
@@ -126,7 +126,8 @@ namespace
             assert(displayNames.size() > 0);
 
             // Lexiographically sort all display names to ensure consistent formatting
-            QCollator collator;
+            // constructing a collator is expensive, and this runs for every message of a storm
+            static const QCollator collator;
             std::sort(displayNames.begin(), displayNames.end(), [&] (const QString& a, const QString& b) {
                 return collator.compare(a, b) < 1;
             });
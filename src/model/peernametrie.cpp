@@ -0,0 +1,144 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "peernametrie.h"
+
+/**
+ * @class PeerNameTrie
+ * @brief Prefix tree of group peer names for nickname completion.
+ *
+ * Names are keyed case insensitively and without the leading punctuation nicknames often
+ * start with, so "[bot]Alice" completes from "al" as well. Lookups cost the length of the
+ * prefix plus the number of matches, no matter how many peers the group has. Several peers
+ * can use the same name, it is only returned once and stays until the last of them left.
+ */
+
+namespace {
+const QString leadingChars = QStringLiteral("-_[]{}|`^.\\");
+} // namespace
+
+/**
+ * @brief Key a name is stored under.
+ * @param name Peer name or prefix typed by the user.
+ * @return Lower case name without leading punctuation.
+ */
+QString PeerNameTrie::key(const QString& name)
+{
+    int start = 0;
+    while (start < name.size() && leadingChars.contains(name.at(start))) {
+        ++start;
+    }
+    return name.mid(start).toLower();
+}
+
+void PeerNameTrie::insert(const QString& name)
+{
+    Node* node = &root;
+    for (const QChar c : key(name)) {
+        std::unique_ptr<Node>& child = node->children[c];
+        if (!child) {
+            child.reset(new Node);
+        }
+        node = child.get();
+    }
+
+    if (++node->names[name] == 1) {
+        ++nameCount;
+    }
+}
+
+void PeerNameTrie::remove(const QString& name)
+{
+    removeFrom(root, key(name), 0, name);
+}
+
+void PeerNameTrie::clear()
+{
+    root.children.clear();
+    root.names.clear();
+    nameCount = 0;
+}
+
+/**
+ * @brief Finds all names starting with a prefix.
+ * @param prefix Prefix, compared the same way names are keyed.
+ * @return Distinct original names, in no particular order.
+ */
+QStringList PeerNameTrie::complete(const QString& prefix) const
+{
+    QStringList names;
+    const Node* node = find(key(prefix));
+    if (node) {
+        collect(*node, names);
+    }
+    return names;
+}
+
+/**
+ * @brief Number of distinct names.
+ */
+int PeerNameTrie::size() const
+{
+    return nameCount;
+}
+
+const PeerNameTrie::Node* PeerNameTrie::find(const QString& key) const
+{
+    const Node* node = &root;
+    for (const QChar c : key) {
+        const auto it = node->children.find(c);
+        if (it == node->children.end()) {
+            return nullptr;
+        }
+        node = it->second.get();
+    }
+    return node;
+}
+
+/**
+ * @return True if the node is empty afterwards and can be pruned.
+ */
+bool PeerNameTrie::removeFrom(Node& node, const QString& key, int depth, const QString& name)
+{
+    if (depth == key.size()) {
+        const auto it = node.names.find(name);
+        if (it != node.names.end() && --it.value() == 0) {
+            node.names.erase(it);
+            --nameCount;
+        }
+    } else {
+        const auto it = node.children.find(key.at(depth));
+        if (it != node.children.end() && removeFrom(*it->second, key, depth + 1, name)) {
+            node.children.erase(it);
+        }
+    }
+
+    return node.children.empty() && node.names.isEmpty();
+}
+
+void PeerNameTrie::collect(const Node& node, QStringList& names)
+{
+    for (auto it = node.names.constBegin(); it != node.names.constEnd(); ++it) {
+        names << it.key();
+    }
+    for (const auto& child : node.children) {
+        collect(*child.second, names);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QChar>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <memory>
+
+class PeerNameTrie
+{
+public:
+    void insert(const QString& name);
+    void remove(const QString& name);
+    void clear();
+    QStringList complete(const QString& prefix) const;
+    int size() const;
+
+    static QString key(const QString& name);
+
+private:
+    struct Node
+    {
+        std::map<QChar, std::unique_ptr<Node>> children;
+        // original names ending here, with the number of peers using them
+        QHash<QString, int> names;
+    };
+
+    const Node* find(const QString& key) const;
+    bool removeFrom(Node& node, const QString& key, int depth, const QString& name);
+    static void collect(const Node& node, QStringList& names);
+
+private:
+    Node root;
+    int nameCount = 0;
+};
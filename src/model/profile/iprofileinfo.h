@@ -52,9 +52,12 @@ public:
     virtual bool isEncrypted() const = 0;
 
     virtual void copyId() const = 0;
+    virtual ToxId getToxId() const = 0;
 
     virtual void setUsername(const QString& name) = 0;
     virtual void setStatusMessage(const QString& status) = 0;
+    virtual QString getUsername() const = 0;
+    virtual QString getStatusMessage() const = 0;
 
     virtual QString getProfileName() const = 0;
     virtual RenameResult renameProfile(const QString& name) = 0;
@@ -154,6 +154,11 @@ void ProfileInfo::copyId() const
     }
 }
 
+ToxId ProfileInfo::getToxId() const
+{
+    return core->getSelfId();
+}
+
 /**
  * @brief Set self user name.
  * @param name New name.
@@ -172,6 +177,16 @@ void ProfileInfo::setStatusMessage(const QString& status)
     core->setStatusMessage(status);
 }
 
+QString ProfileInfo::getUsername() const
+{
+    return core->getUsername();
+}
+
+QString ProfileInfo::getStatusMessage() const
+{
+    return core->getStatusMessage();
+}
+
 /**
  * @brief Get name of tox profile file.
  * @return Profile name.
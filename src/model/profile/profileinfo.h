@@ -42,9 +42,12 @@ public:
     bool isEncrypted() const override;
 
     void copyId() const override;
+    ToxId getToxId() const override;
 
     void setUsername(const QString& name) override;
     void setStatusMessage(const QString& status) override;
+    QString getUsername() const override;
+    QString getStatusMessage() const override;
 
     QString getProfileName() const override;
     RenameResult renameProfile(const QString& name) override;
@@ -24,32 +24,12 @@
 
 #include <QDebug>
 #include <QtGlobal>
+
+#include <algorithm>
 #include <mutex>
 
 namespace {
 
-/**
- * lower_bound needs two way comparisons. This adaptor allows us to compare
- * between a Message and QDateTime in both directions
- */
-struct MessageDateAdaptor
-{
-    static const QDateTime invalidDateTime;
-    MessageDateAdaptor(const std::pair<const ChatLogIdx, ChatLogItem>& item)
-        : timestamp(item.second.getContentType() == ChatLogItem::ContentType::message
-                        ? item.second.getContentAsMessage().message.timestamp
-                        : invalidDateTime)
-    {}
-
-    MessageDateAdaptor(const QDateTime& timestamp_)
-        : timestamp(timestamp_)
-    {}
-
-    const QDateTime& timestamp;
-};
-
-const QDateTime MessageDateAdaptor::invalidDateTime;
-
 /**
  * @brief The search types all can be represented as some regular expression. This function
  *   takes the input phrase and filter and generates the appropriate regular expression
@@ -95,19 +75,6 @@ bool toxFileIsComplete(ToxFile::FileStatus status)
     }
 }
 
-std::map<ChatLogIdx, ChatLogItem>::const_iterator
-firstItemAfterDate(QDate date, const std::map<ChatLogIdx, ChatLogItem>& items)
-{
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-    return std::lower_bound(items.begin(), items.end(), date.startOfDay(),
-#else
-    return std::lower_bound(items.begin(), items.end(), QDateTime(date),
-#endif
-                            [](const MessageDateAdaptor& a, MessageDateAdaptor const& b) {
-                                return a.timestamp.date() < b.timestamp.date();
-                            });
-}
-
 QString resolveToxPk(FriendList& friendList, GroupList& groupList, const ToxPk& pk)
 {
     Friend* f = friendList.findFriend(pk);
@@ -128,7 +95,8 @@ QString resolveToxPk(FriendList& friendList, GroupList& groupList, const ToxPk&
 
 SessionChatLog::SessionChatLog(const ICoreIdHandler& coreIdHandler_, FriendList& friendList_,
     GroupList& groupList_)
-    : coreIdHandler(coreIdHandler_)
+    : RegisteredCache("chat logs")
+    , coreIdHandler(coreIdHandler_)
     , friendList{friendList_}
     , groupList{groupList_}
 {}
@@ -138,7 +106,8 @@ SessionChatLog::SessionChatLog(const ICoreIdHandler& coreIdHandler_, FriendList&
  */
 SessionChatLog::SessionChatLog(ChatLogIdx initialIdx, const ICoreIdHandler& coreIdHandler_,
     FriendList& friendList_, GroupList& groupList_)
-    : coreIdHandler(coreIdHandler_)
+    : RegisteredCache("chat logs")
+    , coreIdHandler(coreIdHandler_)
     , nextIdx(initialIdx)
     , friendList{friendList_}
     , groupList{groupList_}
@@ -157,131 +126,257 @@ QString SessionChatLog::resolveSenderNameFromSender(const ToxPk& sender)
 const ChatLogItem& SessionChatLog::at(ChatLogIdx idx) const
 {
     auto item = items.find(idx);
-    if (item == items.end()) {
+    if (!item) {
         std::terminate();
     }
 
-    return item->second;
+    markCacheUsed();
+    return *item;
 }
 
-SearchResult SessionChatLog::searchForward(SearchPos startPos, const QString& phrase,
-                                           const ParameterSearch& parameter) const
+/**
+ * @brief Lets items that are also stored in history be evicted and loaded again on demand.
+ * @param historyEnd Items before this index are loaded from history.
+ * @param loader Inserts the items of a range from history again.
+ */
+void SessionChatLog::setHistoryLoader(ChatLogIdx historyEnd, ChatLogChunks::Loader loader)
 {
-    if (startPos.logIdx >= getNextIdx()) {
-        SearchResult res;
-        res.found = false;
-        return res;
+    items.setLoader(std::move(loader), [this, historyEnd](ChatLogIdx begin, ChatLogIdx end) {
+        if (end > historyEnd) {
+            return false;
+        }
+
+        // items that are still going to be updated have to stay
+        for (const auto& idx : outgoingMessages) {
+            if (idx >= begin && idx < end) {
+                return false;
+            }
+        }
+
+        return std::none_of(currentFileTransfers.begin(), currentFileTransfers.end(),
+                            [&](const CurrentFileTransfer& transfer) {
+                                return transfer.idx >= begin && transfer.idx < end;
+                            });
+    });
+}
+
+/**
+ * @brief Whether the item at idx was dropped from memory and has to be loaded again.
+ */
+bool SessionChatLog::isEvicted(ChatLogIdx idx) const
+{
+    return items.isEvicted(idx);
+}
+
+RegisteredCache::Usage SessionChatLog::getCacheUsage() const
+{
+    return {static_cast<qint64>(items.loadedBytes()), static_cast<int>(items.loadedItems())};
+}
+
+/**
+ * @brief Evicts chunks that can be loaded from history again, the chunk used last stays.
+ */
+void SessionChatLog::trimCache(qint64 maxBytes)
+{
+    const size_t chunkBytes = items.loadedBytes() / std::max<size_t>(items.loadedChunks(), 1);
+    if (chunkBytes > 0) {
+        items.trim(static_cast<size_t>(maxBytes) / chunkBytes);
     }
+}
 
-    auto currentPos = startPos;
+/**
+ * @brief Finds the first message on or after a date.
+ * @return Index of the message, getNextIdx() if there is none.
+ */
+ChatLogIdx SessionChatLog::firstItemAfterDate(QDate date) const
+{
+    // items are sorted by date, so bisect like lower_bound would
+    auto first = getFirstIdx();
+    auto count = nextIdx - first;
+    while (count > 0) {
+        const auto step = count / 2;
+        const auto mid = first + step;
+        const ChatLogItem* item = items.find(mid);
+        const QDate itemDate = item && item->getContentType() == ChatLogItem::ContentType::message
+                                   ? item->getContentAsMessage().message.timestamp.date()
+                                   : QDate();
+        if (itemDate < date) {
+            first = mid + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
 
-    auto regexp = getRegexpForPhrase(phrase, parameter.filter);
+    return first;
+}
 
-    for (auto it = items.find(currentPos.logIdx); it != items.end(); ++it) {
-        const auto& key = it->first;
-        const auto& item = it->second;
+/**
+ * @brief Searches a message for the first match after some matches.
+ *
+ * One step of searchForward(), nothing else may be searched than message items.
+ * @param skipMatches Number of matches of the message already found.
+ * @return True if there is a match, res is set to it.
+ */
+bool SessionChatLog::matchForward(ChatLogIdx key, size_t skipMatches, const QRegularExpression& regexp,
+                                  SearchResult& res) const
+{
+    const ChatLogItem* item = items.find(key);
+    if (!item || item->getContentType() != ChatLogItem::ContentType::message) {
+        return false;
+    }
+
+    const auto& content = item->getContentAsMessage();
+
+    auto match = regexp.globalMatch(content.message.content, 0);
+
+    auto numMatches = 0;
+    QRegularExpressionMatch lastMatch;
+    while (match.isValid() && numMatches <= static_cast<int>(skipMatches) && match.hasNext()) {
+        lastMatch = match.next();
+        numMatches++;
+    }
+
+    if (numMatches <= static_cast<int>(skipMatches)) {
+        return false;
+    }
+
+    res.found = true;
+    res.pos.logIdx = key;
+    res.pos.numMatches = numMatches;
+    res.start = lastMatch.capturedStart();
+    res.len = lastMatch.capturedLength();
+    return true;
+}
+
+/**
+ * @brief Searches a message for the last match before some match.
+ * @param beforeMatches Number of the match to stop before, 0 for the whole message.
+ * @return True if there is a match, res is set to it.
+ */
+bool SessionChatLog::matchBackward(ChatLogIdx key, size_t beforeMatches,
+                                   const QRegularExpression& regexp, SearchResult& res) const
+{
+    const ChatLogItem* item = items.find(key);
+    if (!item || item->getContentType() != ChatLogItem::ContentType::message) {
+        return false;
+    }
+
+    const auto& content = item->getContentAsMessage();
+    auto match = regexp.globalMatch(content.message.content, 0);
 
-        if (item.getContentType() != ChatLogItem::ContentType::message) {
-            continue;
+    auto numMatchesBeforePos = 0;
+    QRegularExpressionMatch lastMatch;
+    while (match.isValid() && match.hasNext()) {
+        auto currentMatch = match.next();
+        if (beforeMatches == 0 || static_cast<int>(beforeMatches) > numMatchesBeforePos) {
+            lastMatch = currentMatch;
+            numMatchesBeforePos++;
         }
+    }
 
-        const auto& content = item.getContentAsMessage();
+    if ((numMatchesBeforePos >= static_cast<int>(beforeMatches) && beforeMatches != 0)
+        || numMatchesBeforePos == 0) {
+        return false;
+    }
+
+    res.found = true;
+    res.pos.logIdx = key;
+    res.pos.numMatches = numMatchesBeforePos;
+    res.start = lastMatch.capturedStart();
+    res.len = lastMatch.capturedLength();
+    return true;
+}
 
-        auto match = regexp.globalMatch(content.message.content, 0);
+/**
+ * @note Only the candidates of searchIndex are matched against the phrase, unless the phrase is
+ * a regular expression.
+ */
+SearchResult SessionChatLog::searchForward(SearchPos startPos, const QString& phrase,
+                                           const ParameterSearch& parameter) const
+{
+    SearchResult res;
+    res.found = false;
+    if (startPos.logIdx >= getNextIdx()) {
+        return res;
+    }
 
-        auto numMatches = 0;
-        QRegularExpressionMatch lastMatch;
-        while (match.isValid() && numMatches <= static_cast<int>(currentPos.numMatches) && match.hasNext()) {
-            lastMatch = match.next();
-            numMatches++;
+    auto regexp = getRegexpForPhrase(phrase, parameter.filter);
+    // the match count only applies to the message the search starts at
+    auto skipMatches = [&startPos](ChatLogIdx key) {
+        return key == startPos.logIdx ? startPos.numMatches : 0;
+    };
+
+    const auto* candidates = searchIndex.candidates(phrase, parameter.filter);
+    if (candidates) {
+        for (auto it = std::lower_bound(candidates->begin(), candidates->end(), startPos.logIdx);
+             it != candidates->end() && *it < nextIdx; ++it) {
+            if (matchForward(*it, skipMatches(*it), regexp, res)) {
+                return res;
+            }
         }
+        return res;
+    }
 
-        if (numMatches > static_cast<int>(currentPos.numMatches)) {
-            SearchResult res;
-            res.found = true;
-            res.pos.logIdx = key;
-            res.pos.numMatches = numMatches;
-            res.start = lastMatch.capturedStart();
-            res.len = lastMatch.capturedLength();
+    for (auto key = startPos.logIdx; key < nextIdx; ++key) {
+        if (matchForward(key, skipMatches(key), regexp, res)) {
             return res;
         }
-
-        // After the first iteration we force this to 0 to search the whole
-        // message
-        currentPos.numMatches = 0;
     }
 
-    // We should have returned from the above loop if we had found anything
-    SearchResult ret;
-    ret.found = false;
-    return ret;
+    return res;
 }
 
+/**
+ * @note Only the candidates of searchIndex are matched against the phrase, unless the phrase is
+ * a regular expression.
+ */
 SearchResult SessionChatLog::searchBackward(SearchPos startPos, const QString& phrase,
                                             const ParameterSearch& parameter) const
 {
-    auto currentPos = startPos;
+    SearchResult res;
+    res.found = false;
     auto regexp = getRegexpForPhrase(phrase, parameter.filter);
-    auto startIt = items.find(currentPos.logIdx);
+    auto startKey = startPos.logIdx;
 
     // If we don't have it we'll start at the end
-    if (startIt == items.end()) {
+    if (startKey >= nextIdx || !items.find(startKey)) {
         if (items.empty()) {
-            SearchResult ret;
-            ret.found = false;
-            return ret;
+            return res;
         }
-        startIt = std::prev(items.end());
+        startKey = nextIdx - 1;
         startPos.numMatches = 0;
     }
 
-    // Off by 1 due to reverse_iterator api
-    auto rStartIt = std::reverse_iterator<decltype(startIt)>(std::next(startIt));
-    auto rEnd = std::reverse_iterator<decltype(startIt)>(items.begin());
-
-    for (auto it = rStartIt; it != rEnd; ++it) {
-        const auto& key = it->first;
-        const auto& item = it->second;
-
-        if (item.getContentType() != ChatLogItem::ContentType::message) {
-            continue;
-        }
-
-        const auto& content = item.getContentAsMessage();
-        auto match = regexp.globalMatch(content.message.content, 0);
-
-        auto totalMatches = 0;
-        auto numMatchesBeforePos = 0;
-        QRegularExpressionMatch lastMatch;
-        while (match.isValid() && match.hasNext()) {
-            auto currentMatch = match.next();
-            totalMatches++;
-            if (currentPos.numMatches == 0 || static_cast<int>(currentPos.numMatches) > numMatchesBeforePos) {
-                lastMatch = currentMatch;
-                numMatchesBeforePos++;
+    // the match count only applies to the message the search starts at
+    auto beforeMatches = [&startPos, startKey](ChatLogIdx key) {
+        return key == startKey ? startPos.numMatches : 0;
+    };
+
+    const auto firstKey = getFirstIdx();
+    const auto* candidates = searchIndex.candidates(phrase, parameter.filter);
+    if (candidates) {
+        auto it = std::upper_bound(candidates->begin(), candidates->end(), startKey);
+        while (it != candidates->begin()) {
+            --it;
+            if (*it < firstKey) {
+                break;
+            }
+            if (matchBackward(*it, beforeMatches(*it), regexp, res)) {
+                return res;
             }
         }
+        return res;
+    }
 
-        if ((numMatchesBeforePos < static_cast<int>(currentPos.numMatches) || currentPos.numMatches == 0)
-            && numMatchesBeforePos > 0) {
-            SearchResult res;
-            res.found = true;
-            res.pos.logIdx = key;
-            res.pos.numMatches = numMatchesBeforePos;
-            res.start = lastMatch.capturedStart();
-            res.len = lastMatch.capturedLength();
+    for (auto key = startKey + 1; key > firstKey;) {
+        key = key - 1;
+        if (matchBackward(key, beforeMatches(key), regexp, res)) {
             return res;
         }
-
-        // After the first iteration we force this to 0 to search the whole
-        // message
-        currentPos.numMatches = 0;
     }
 
-    // We should have returned from the above loop if we had found anything
-    SearchResult ret;
-    ret.found = false;
-    return ret;
+    return res;
 }
 
 ChatLogIdx SessionChatLog::getFirstIdx() const
@@ -290,7 +385,7 @@ ChatLogIdx SessionChatLog::getFirstIdx() const
         return nextIdx;
     }
 
-    return items.begin()->first;
+    return items.firstIdx();
 }
 
 ChatLogIdx SessionChatLog::getNextIdx() const
@@ -305,15 +400,15 @@ std::vector<IChatLog::DateChatLogIdxPair> SessionChatLog::getDateIdxs(const QDat
     auto dateIt = startDate;
 
     while (true) {
-        auto it = firstItemAfterDate(dateIt, items);
+        auto idx = firstItemAfterDate(dateIt);
 
-        if (it == items.end()) {
+        if (idx >= nextIdx) {
             break;
         }
 
         DateChatLogIdxPair pair;
         pair.date = dateIt;
-        pair.idx = it->first;
+        pair.idx = idx;
 
         ret.push_back(std::move(pair));
 
@@ -346,6 +441,7 @@ void SessionChatLog::insertCompleteMessageAtIdx(ChatLogIdx idx, const ToxPk& sen
     assert(message.state == MessageState::complete);
 
     items.emplace(idx, std::move(item));
+    searchIndex.add(idx, message.message.content);
 }
 
 void SessionChatLog::insertIncompleteMessageAtIdx(ChatLogIdx idx, const ToxPk& sender, QString senderName,
@@ -357,6 +453,7 @@ void SessionChatLog::insertIncompleteMessageAtIdx(ChatLogIdx idx, const ToxPk& s
     assert(message.state == MessageState::pending);
 
     items.emplace(idx, std::move(item));
+    searchIndex.add(idx, message.message.content);
     outgoingMessages.insert(dispatchId, idx);
 }
 
@@ -368,6 +465,7 @@ void SessionChatLog::insertBrokenMessageAtIdx(ChatLogIdx idx, const ToxPk& sende
     assert(message.state == MessageState::broken);
 
     items.emplace(idx, std::move(item));
+    searchIndex.add(idx, message.message.content);
 }
 
 void SessionChatLog::insertFileAtIdx(ChatLogIdx idx, const ToxPk& sender, QString senderName, const ChatLogFile& file)
@@ -429,6 +527,7 @@ void SessionChatLog::onMessageReceived(const ToxPk& sender, const Message& messa
     chatLogMessage.state = MessageState::complete;
     chatLogMessage.message = message3;
     items.emplace(messageIdx, ChatLogItem(sender, resolveSenderNameFromSender(sender), chatLogMessage));
+    searchIndex.add(messageIdx, message_real);
 
     emit itemUpdated(messageIdx);
 }
@@ -447,6 +546,7 @@ void SessionChatLog::onMessageSent(DispatchedMessageId id, const Message& messag
     const ToxPk selfPk = coreIdHandler.getSelfPublicKey();
     const QString selfName = resolveSenderNameFromSender(selfPk);
     items.emplace(messageIdx, ChatLogItem(selfPk, selfName, chatLogMessage));
+    searchIndex.add(messageIdx, message.content);
 
     outgoingMessages.insert(id, messageIdx);
 
@@ -467,16 +567,16 @@ void SessionChatLog::onMessageComplete(DispatchedMessageId id)
     }
 
     const auto& chatLogIdx = *chatLogIdxIt;
-    auto messageIt = items.find(chatLogIdx);
+    auto message = items.find(chatLogIdx);
 
-    if (messageIt == items.end()) {
+    if (!message) {
         qWarning() << "Failed to look up message in chat log";
         return;
     }
 
-    messageIt->second.getContentAsMessage().state = MessageState::complete;
+    message->getContentAsMessage().state = MessageState::complete;
 
-    emit itemUpdated(messageIt->first);
+    emit itemUpdated(chatLogIdx);
 }
 
 void SessionChatLog::onMessageBroken(DispatchedMessageId id, BrokenMessageReason reason)
@@ -490,17 +590,17 @@ void SessionChatLog::onMessageBroken(DispatchedMessageId id, BrokenMessageReason
     }
 
     const auto& chatLogIdx = *chatLogIdxIt;
-    auto messageIt = items.find(chatLogIdx);
+    auto message = items.find(chatLogIdx);
 
-    if (messageIt == items.end()) {
+    if (!message) {
         qWarning() << "Failed to look up message in chat log";
         return;
     }
 
     // NOTE: Reason for broken message not currently shown in UI, but it could be
-    messageIt->second.getContentAsMessage().state = MessageState::broken;
+    message->getContentAsMessage().state = MessageState::broken;
 
-    emit itemUpdated(messageIt->first);
+    emit itemUpdated(chatLogIdx);
 }
 
 /**
@@ -529,7 +629,7 @@ void SessionChatLog::onFileUpdated(const ToxPk& sender, const ToxFile& file)
         messageIdx = fileIt->idx;
         fileIt->file = file;
 
-        items.at(messageIdx).getContentAsFile().file = file;
+        items.find(messageIdx)->getContentAsFile().file = file;
     } else {
         // This may be a file unbroken message that we don't handle ATM
         return;
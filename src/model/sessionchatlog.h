@@ -19,17 +19,22 @@
 
 #pragma once
 
+#include "chatlogchunks.h"
 #include "ichatlog.h"
 #include "imessagedispatcher.h"
+#include "sessionsearchindex.h"
+
+#include "util/cacheregistry.h"
 
 #include <QList>
 #include <QObject>
+#include <QRegularExpression>
 
 struct SessionChatLogMetadata;
 class FriendList;
 class GroupList;
 
-class SessionChatLog : public IChatLog
+class SessionChatLog : public IChatLog, public RegisteredCache
 {
     Q_OBJECT
 public:
@@ -58,6 +63,12 @@ public:
     void insertFileAtIdx(ChatLogIdx idx, const ToxPk& sender, QString senderName, const ChatLogFile& file);
     void insertSystemMessageAtIdx(ChatLogIdx idx, SystemMessage message);
 
+    void setHistoryLoader(ChatLogIdx historyEnd, ChatLogChunks::Loader loader);
+    bool isEvicted(ChatLogIdx idx) const;
+
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
+
 public slots:
     void onMessageReceived(const ToxPk& sender, const Message& message, const int hasIdType = 0);
     void onMessageSent(DispatchedMessageId id, const Message& message);
@@ -71,6 +82,11 @@ public slots:
 
 private:
     QString resolveSenderNameFromSender(const ToxPk &sender);
+    ChatLogIdx firstItemAfterDate(QDate date) const;
+    bool matchForward(ChatLogIdx key, size_t skipMatches, const QRegularExpression& regexp,
+                      SearchResult& res) const;
+    bool matchBackward(ChatLogIdx key, size_t beforeMatches, const QRegularExpression& regexp,
+                       SearchResult& res) const;
 
 
 private:
@@ -78,7 +94,9 @@ private:
 
     ChatLogIdx nextIdx = ChatLogIdx(0);
 
-    std::map<ChatLogIdx, ChatLogItem> items;
+    // Mutable since looking up an evicted item loads it again
+    mutable ChatLogChunks items;
+    SessionSearchIndex searchIndex;
 
     struct CurrentFileTransfer
     {
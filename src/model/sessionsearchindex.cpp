@@ -0,0 +1,160 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sessionsearchindex.h"
+
+#include <algorithm>
+
+/**
+ * @class SessionSearchIndex
+ * @brief Token index over the messages of a SessionChatLog, narrows a search down to the
+ * messages that can match.
+ *
+ * Messages are split into runs of letters, numbers and marks, which are case folded. Any match
+ * of a search phrase contains each token of the phrase inside a single token of the message, so
+ * the messages holding a token that contains the longest token of the phrase are a superset of
+ * the matches. The search still runs the regular expression on those candidates to confirm them.
+ *
+ * Regular expression filters have no tokens that must occur, candidates() returns nullptr for
+ * them and the search falls back to scanning every message.
+ *
+ * Evicted items stay in the index, so searching only loads the chunks of candidates again.
+ */
+
+namespace {
+bool isTokenChar(QChar c)
+{
+    return c.isLetterOrNumber() || c.isMark();
+}
+
+bool isRegexFilter(FilterSearch filter)
+{
+    return filter == FilterSearch::Regular || filter == FilterSearch::RegisterAndRegular;
+}
+} // namespace
+
+/**
+ * @brief Adds the tokens of a message, adding the same message again changes nothing.
+ * @param idx Index of the message in the chat log.
+ * @param content Text of the message.
+ */
+void SessionSearchIndex::add(ChatLogIdx idx, const QString& content)
+{
+    QStringList tokens = tokenize(content);
+    tokens.removeDuplicates();
+    bool changed = false;
+    for (const auto& token : tokens) {
+        auto& indices = postings[token];
+        // messages mostly arrive at either end of the log
+        if (indices.empty() || indices.back() < idx) {
+            indices.push_back(idx);
+            changed = true;
+            continue;
+        }
+
+        const auto it = std::lower_bound(indices.begin(), indices.end(), idx);
+        if (it == indices.end() || *it != idx) {
+            indices.insert(it, idx);
+            changed = true;
+        }
+    }
+
+    // reloading an evicted chunk adds its messages again
+    if (changed) {
+        ++generation;
+    }
+}
+
+/**
+ * @brief Looks up the messages that can match a search.
+ * @param phrase Search phrase.
+ * @param filter Search filter.
+ * @return Sorted indices of the candidates, nullptr if the index can't narrow the search down.
+ * The result is valid until the next call.
+ */
+const std::vector<ChatLogIdx>* SessionSearchIndex::candidates(const QString& phrase,
+                                                              FilterSearch filter) const
+{
+    if (isRegexFilter(filter)) {
+        return nullptr;
+    }
+
+    if (cachedQuery.valid && cachedQuery.generation == generation
+        && cachedQuery.filter == filter && cachedQuery.phrase == phrase) {
+        return &cachedQuery.candidates;
+    }
+
+    const QStringList phraseTokens = tokenize(phrase);
+    if (phraseTokens.isEmpty()) {
+        return nullptr;
+    }
+
+    const QString longest = *std::max_element(phraseTokens.begin(), phraseTokens.end(),
+                                              [](const QString& a, const QString& b) {
+                                                  return a.size() < b.size();
+                                              });
+
+    std::vector<ChatLogIdx> result;
+    const auto exact = postings.constFind(longest);
+    if (exact != postings.constEnd()) {
+        result = exact.value();
+    }
+    // the token of the phrase can be part of a longer one, like "test" of "tests"
+    for (auto it = postings.constBegin(); it != postings.constEnd(); ++it) {
+        if (it.key().size() > longest.size() && it.key().contains(longest)) {
+            result.insert(result.end(), it.value().begin(), it.value().end());
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    cachedQuery.phrase = phrase;
+    cachedQuery.filter = filter;
+    cachedQuery.generation = generation;
+    cachedQuery.valid = true;
+    cachedQuery.candidates = std::move(result);
+    return &cachedQuery.candidates;
+}
+
+/**
+ * @brief Number of distinct tokens in the index.
+ */
+int SessionSearchIndex::tokenCount() const
+{
+    return postings.size();
+}
+
+/**
+ * @brief Splits text into its case folded runs of letters, numbers and marks.
+ */
+QStringList SessionSearchIndex::tokenize(const QString& text)
+{
+    QStringList tokens;
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i) {
+        const bool tokenChar = i < text.size() && isTokenChar(text.at(i));
+        if (tokenChar && start < 0) {
+            start = i;
+        } else if (!tokenChar && start >= 0) {
+            tokens.append(text.mid(start, i - start).toCaseFolded());
+            start = -1;
+        }
+    }
+    return tokens;
+}
@@ -0,0 +1,55 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "ichatlog.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <cstdint>
+#include <vector>
+
+class SessionSearchIndex
+{
+public:
+    void add(ChatLogIdx idx, const QString& content);
+    const std::vector<ChatLogIdx>* candidates(const QString& phrase, FilterSearch filter) const;
+    int tokenCount() const;
+
+    static QStringList tokenize(const QString& text);
+
+private:
+    // sorted and unique
+    QHash<QString, std::vector<ChatLogIdx>> postings;
+    uint64_t generation = 0;
+
+    struct CachedQuery
+    {
+        QString phrase;
+        FilterSearch filter = FilterSearch::None;
+        uint64_t generation = 0;
+        bool valid = false;
+        std::vector<ChatLogIdx> candidates;
+    };
+    // repeated "next match" requests ask for the same phrase
+    mutable CachedQuery cachedQuery;
+};
@@ -0,0 +1,113 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "typingnotifier.h"
+
+/**
+ * @class TypingNotifier
+ * @brief Decides when to tell a friend that we are typing.
+ *
+ * typingChanged() is only emitted on edges: true once the user starts composing, false once the
+ * text is gone or the user stopped typing for IDLE_MS. After a pause, typing again reports true
+ * at most once per RESEND_INTERVAL_MS, so stop and go typing doesn't flap the friend's typing
+ * notification. Nothing is sent while the friend is offline, apart from a single false when the
+ * friend goes offline while we are reported as typing, since toxcore would otherwise send the
+ * stale state once the friend reconnects.
+ */
+
+constexpr int TypingNotifier::IDLE_MS;
+constexpr int TypingNotifier::RESEND_INTERVAL_MS;
+
+TypingNotifier::TypingNotifier(int idleMs, int resendIntervalMs_, QObject* parent)
+    : QObject(parent)
+    , resendIntervalMs{resendIntervalMs_}
+{
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(idleMs);
+    connect(&idleTimer, &QTimer::timeout, this, &TypingNotifier::onIdle);
+    resendTimer.setSingleShot(true);
+    connect(&resendTimer, &QTimer::timeout, this, &TypingNotifier::update);
+}
+
+/**
+ * @brief Reports a change of the message being composed.
+ * @param composing_ True if there is text in the message box.
+ */
+void TypingNotifier::setComposing(bool composing_)
+{
+    composing = composing_;
+    if (composing) {
+        idleTimer.start();
+    } else {
+        idleTimer.stop();
+    }
+
+    update();
+}
+
+void TypingNotifier::setFriendOnline(bool online)
+{
+    if (friendOnline == online) {
+        return;
+    }
+
+    friendOnline = online;
+    if (!online && typingSent) {
+        typingSent = false;
+        resendTimer.stop();
+        emit typingChanged(false);
+        return;
+    }
+
+    update();
+}
+
+void TypingNotifier::onIdle()
+{
+    composing = false;
+    update();
+}
+
+void TypingNotifier::update()
+{
+    const bool typing = composing && friendOnline;
+    if (typing == typingSent) {
+        resendTimer.stop();
+        return;
+    }
+
+    if (!typing) {
+        resendTimer.stop();
+        typingSent = false;
+        emit typingChanged(false);
+        return;
+    }
+
+    if (lastTypingSent.isValid() && lastTypingSent.elapsed() < resendIntervalMs) {
+        if (!resendTimer.isActive()) {
+            resendTimer.start(static_cast<int>(resendIntervalMs - lastTypingSent.elapsed()));
+        }
+        return;
+    }
+
+    typingSent = true;
+    lastTypingSent.start();
+    emit typingChanged(true);
+}
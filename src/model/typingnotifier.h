@@ -0,0 +1,56 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+class TypingNotifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TypingNotifier(int idleMs = IDLE_MS, int resendIntervalMs = RESEND_INTERVAL_MS,
+                            QObject* parent = nullptr);
+
+    void setComposing(bool composing);
+    void setFriendOnline(bool online);
+
+    static constexpr int IDLE_MS = 3000;
+    static constexpr int RESEND_INTERVAL_MS = 2000;
+
+signals:
+    void typingChanged(bool isTyping);
+
+private slots:
+    void onIdle();
+    void update();
+
+private:
+    QTimer idleTimer;
+    QTimer resendTimer;
+    QElapsedTimer lastTypingSent;
+    const int resendIntervalMs;
+    bool composing = false;
+    bool friendOnline = false;
+    bool typingSent = false;
+};
@@ -22,6 +22,7 @@
 #include "src/core/core.h"
 #include "src/core/corefile.h"
 #include "src/model/status.h"
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QObject>
 
@@ -29,13 +30,20 @@
  * @class AvatarBroadcaster
  *
  * Takes care of broadcasting avatar changes to our friends in a smart way
- * Cache a copy of our current avatar and friends who have received it
+ * Cache a copy of our current avatar and the hash of the avatar each friend acknowledged,
  * so we don't spam avatar transfers to a friend who already has it.
+ * Only AvatarBroadcastQueue::MAX_CONCURRENT_SENDS transfers run at once, so a reconnect
+ * doesn't start an avatar transfer for every friend at the same time.
  */
 
 AvatarBroadcaster::AvatarBroadcaster(Core& _core)
     : core{_core}
-{}
+{
+    connect(core.getCoreFile(), &CoreFile::avatarSendFinished, this,
+            &AvatarBroadcaster::onAvatarSendFinished);
+    connect(&core, &Core::friendRemoved, this,
+            [this](uint32_t friendId) { queue.removeFriend(friendId); });
+}
 
 /**
  * @brief Set our current avatar.
@@ -48,12 +56,15 @@ void AvatarBroadcaster::setAvatar(QByteArray data)
     }
 
     avatarData = data;
-    friendsSentTo.clear();
+    queue.setAvatarHash(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
 
     QVector<uint32_t> friends = core.getFriendList();
     for (uint32_t friendId : friends) {
-        sendAvatarTo(friendId);
+        if (core.isFriendOnline(friendId)) {
+            queue.enqueue(friendId);
+        }
     }
+    pump();
 }
 
 /**
@@ -62,17 +73,13 @@ void AvatarBroadcaster::setAvatar(QByteArray data)
  */
 void AvatarBroadcaster::sendAvatarTo(uint32_t friendId)
 {
-    if (friendsSentTo.contains(friendId) && friendsSentTo[friendId]) {
-        return;
-    }
-
     if (!core.isFriendOnline(friendId)) {
         return;
     }
 
-    CoreFile* coreFile = core.getCoreFile();
-    coreFile->sendAvatarFile(friendId, avatarData);
-    friendsSentTo[friendId] = true;
+    if (queue.enqueue(friendId)) {
+        pump();
+    }
 }
 
 /**
@@ -81,9 +88,31 @@ void AvatarBroadcaster::sendAvatarTo(uint32_t friendId)
  */
 void AvatarBroadcaster::enableAutoBroadcast(bool state)
 {
-    disconnect(&core, nullptr, this, nullptr);
+    disconnect(&core, &Core::friendStatusChanged, this, nullptr);
     if (state) {
-        connect(&core, &Core::friendStatusChanged,
+        connect(&core, &Core::friendStatusChanged, this,
                 [=](uint32_t friendId, Status::Status) { sendAvatarTo(friendId); });
     }
 }
+
+void AvatarBroadcaster::onAvatarSendFinished(uint32_t friendId, bool delivered)
+{
+    queue.finished(friendId, delivered);
+    pump();
+}
+
+/**
+ * @brief Starts avatar transfers while the queue has free send slots.
+ *
+ * Friends who went offline while queued are skipped, they are queued again when they're back.
+ */
+void AvatarBroadcaster::pump()
+{
+    CoreFile* coreFile = core.getCoreFile();
+    uint32_t friendId;
+    while (queue.takeNext(friendId)) {
+        if (!core.isFriendOnline(friendId) || !coreFile->sendAvatarFile(friendId, avatarData)) {
+            queue.finished(friendId, false);
+        }
+    }
+}
@@ -20,8 +20,9 @@
 
 #pragma once
 
+#include "avatarbroadcastqueue.h"
+
 #include <QByteArray>
-#include <QMap>
 #include <QObject>
 
 class Core;
@@ -35,8 +36,14 @@ public:
     void sendAvatarTo(uint32_t friendId);
     void enableAutoBroadcast(bool state = true);
 
+private slots:
+    void onAvatarSendFinished(uint32_t friendId, bool delivered);
+
+private:
+    void pump();
+
 private:
     Core& core;
     QByteArray avatarData;
-    QMap<uint32_t, bool> friendsSentTo;
+    AvatarBroadcastQueue queue;
 };
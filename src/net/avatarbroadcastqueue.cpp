@@ -0,0 +1,140 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "avatarbroadcastqueue.h"
+
+/**
+ * @class AvatarBroadcastQueue
+ * @brief Decides which friends get our avatar next, at most MAX_CONCURRENT_SENDS at a time.
+ *
+ * Friends are served in the order they were queued. A friend whose last delivered avatar has
+ * the current hash isn't queued again, so reconnecting friends don't get the same avatar twice.
+ * Only hashes are kept, AvatarBroadcaster owns the avatar itself.
+ */
+
+constexpr int AvatarBroadcastQueue::MAX_CONCURRENT_SENDS;
+
+/**
+ * @brief Sets the hash of the avatar to send from now on.
+ * @param hash Hash of our current avatar.
+ *
+ * Friends still waiting for the previous avatar are dropped, the caller queues them again.
+ */
+void AvatarBroadcastQueue::setAvatarHash(const QByteArray& hash)
+{
+    if (avatarHash == hash) {
+        return;
+    }
+
+    avatarHash = hash;
+    pending.clear();
+}
+
+/**
+ * @brief Queues a friend for the current avatar.
+ * @param friendId Id of friend to send the avatar to.
+ * @return False if the friend already has or is getting the current avatar, or is queued.
+ */
+bool AvatarBroadcastQueue::enqueue(uint32_t friendId)
+{
+    const auto deliveredIt = deliveredHashes.constFind(friendId);
+    if (deliveredIt != deliveredHashes.constEnd() && *deliveredIt == avatarHash) {
+        return false;
+    }
+
+    const auto sendingIt = sending.constFind(friendId);
+    if (sendingIt != sending.constEnd() && *sendingIt == avatarHash) {
+        return false;
+    }
+
+    if (pending.contains(friendId)) {
+        return false;
+    }
+
+    pending.append(friendId);
+    return true;
+}
+
+/**
+ * @brief Takes the next friend to send the avatar to, if another send may start.
+ * @param friendId Set to the friend to send to.
+ * @return False if all send slots are in use or no friend can be served.
+ *
+ * Friends still receiving an older avatar wait until that transfer finished. The caller must
+ * report the end of the send with finished().
+ */
+bool AvatarBroadcastQueue::takeNext(uint32_t& friendId)
+{
+    if (sending.size() >= MAX_CONCURRENT_SENDS) {
+        return false;
+    }
+
+    for (auto it = pending.begin(); it != pending.end(); ++it) {
+        if (sending.contains(*it)) {
+            continue;
+        }
+
+        friendId = *it;
+        pending.erase(it);
+        sending.insert(friendId, avatarHash);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Frees the send slot of a friend.
+ * @param friendId Id of friend the avatar was sent to.
+ * @param delivered True if the friend has the avatar now.
+ */
+void AvatarBroadcastQueue::finished(uint32_t friendId, bool delivered)
+{
+    const auto it = sending.find(friendId);
+    if (it == sending.end()) {
+        return;
+    }
+
+    if (delivered) {
+        deliveredHashes.insert(friendId, *it);
+    }
+    sending.erase(it);
+}
+
+/**
+ * @brief Forgets a friend, toxcore reuses the ids of removed friends.
+ * @param friendId Id of the removed friend.
+ */
+void AvatarBroadcastQueue::removeFriend(uint32_t friendId)
+{
+    pending.removeAll(friendId);
+    sending.remove(friendId);
+    deliveredHashes.remove(friendId);
+}
+
+int AvatarBroadcastQueue::pendingCount() const
+{
+    return pending.size();
+}
+
+int AvatarBroadcastQueue::sendingCount() const
+{
+    return sending.size();
+}
@@ -0,0 +1,47 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+
+#include <cstdint>
+
+class AvatarBroadcastQueue
+{
+public:
+    void setAvatarHash(const QByteArray& hash);
+    bool enqueue(uint32_t friendId);
+    bool takeNext(uint32_t& friendId);
+    void finished(uint32_t friendId, bool delivered);
+    void removeFriend(uint32_t friendId);
+    int pendingCount() const;
+    int sendingCount() const;
+
+    static constexpr int MAX_CONCURRENT_SENDS = 4;
+
+private:
+    QByteArray avatarHash;
+    QList<uint32_t> pending;
+    QHash<uint32_t, QByteArray> sending;
+    QHash<uint32_t, QByteArray> deliveredHashes;
+};
@@ -23,15 +23,21 @@
 #include "src/core/toxpk.h"
 #include "src/core/toxid.h"
 
+#include <QDataStream>
+#include <QDateTime>
 #include <QDirIterator>
 #include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutexLocker>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QRegularExpression>
-#include <QJsonArray>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <cstdint>
 
@@ -53,6 +59,12 @@ const QLatin1String jsonNodeArrayName{"nodes"};
 const QLatin1String emptyAddress{"-"};
 const QRegularExpression ToxPkRegEx(QString("(^|\\s)[A-Fa-f0-9]{%1}($|\\s)").arg(64));
 const QLatin1String builtinNodesFile{":/conf/nodes.json"};
+// "QTNC", followed by the cache version
+constexpr quint32 nodeCacheMagic = 0x51544e43;
+constexpr quint16 nodeCacheVersion = 1;
+// a corrupt count mustn't make us allocate gigabytes
+constexpr quint32 maxCachedNodes = 10000;
+constexpr quint32 maxCachedTcpPorts = 64;
 
 void jsonNodeToDhtServer(const QJsonObject& node, QList<DhtServer>& outList)
 {
@@ -202,40 +214,95 @@ QByteArray serialize(QList<DhtServer> nodes)
     return doc.toJson(QJsonDocument::Indented);
 }
 
-void createExampleBootstrapNodesFile(const Paths& paths)
+void writeExampleNodesFile(const QString& path, const QList<DhtServer>& builtinNodes)
 {
     // deserialize and reserialize instead of just copying to strip out any unnecessary json, making it easier for
     // users to edit. Overwrite the file on every start to keep it up to date when our internal list updates.
-    auto buildInNodes = loadNodesFile(builtinNodesFile);
-    auto serializedNodes = serialize(buildInNodes);
+    auto serializedNodes = serialize(builtinNodes);
 
-    QFile outFile(paths.getExampleNodesFilePath());
+    QFile outFile(path);
     outFile.open(QIODevice::WriteOnly | QIODevice::Text);
     outFile.write(serializedNodes.data(), serializedNodes.size());
     outFile.close();
 }
+
+/**
+ * @brief Identifies the version of a node list file the cache was made from.
+ */
+struct SourceStamp
+{
+    QString path;
+    qint64 size;
+    qint64 modifiedMs;
+};
+
+SourceStamp sourceStamp(const QString& sourcePath)
+{
+    const QFileInfo source{sourcePath};
+    return {sourcePath, source.size(), source.lastModified().toMSecsSinceEpoch()};
+}
+
+QList<DhtServer> parseNodesJson(const QByteArray& json)
+{
+    QJsonDocument jsonDocument = QJsonDocument::fromJson(json);
+    if (jsonDocument.isNull()) {
+        return {};
+    }
+
+    return jsonToNodeList(jsonDocument);
+}
+
+/**
+ * @brief Returns the last node list of the process if it equals nodes, nodes otherwise.
+ *
+ * Every profile hosted in one process loads the same list, comparing it once lets them share
+ * one copy instead of keeping a list each.
+ */
+QList<DhtServer> sharedNodeList(const QList<DhtServer>& nodes)
+{
+    static QMutex sharedMutex;
+    static QList<DhtServer> shared;
+    QMutexLocker locker{&sharedMutex};
+    if (shared != nodes) {
+        shared = nodes;
+    }
+    return shared;
+}
 } // namespace
 
 /**
  * @brief Fetches a list of currently online bootstrap nodes from node.tox.chat
  * @param proxy Proxy to use for the lookup, must outlive this object
+ *
+ * The node list is parsed into a binary cache next to the user's node list, so startup only
+ * reads that one file. The cache remembers size and modification time of the node list it was
+ * made from and is ignored once the node list changed. Parsing it then, and writing the cache
+ * and the example file, runs on a thread of the global pool. Only if Core asks for nodes before
+ * that finished, getBootstrapNodes() parses the JSON itself.
  */
 BootstrapNodeUpdater::BootstrapNodeUpdater(const QNetworkProxy& proxy_, Paths& paths_, QObject* parent)
     : QObject{parent}
     , proxy{proxy_}
     , paths{paths_}
 {
-    createExampleBootstrapNodesFile(paths_);
+    QList<DhtServer> cached;
+    if (readNodeCache(paths.getNodesCacheFilePath(), nodesSourcePath(), cached)) {
+        setNodes(cached);
+    }
+    refreshNodes();
 }
 
+/**
+ * @note Thread safe, Core calls it from its thread.
+ */
 QList<DhtServer> BootstrapNodeUpdater::getBootstrapNodes() const
 {
-    auto userFilePath = paths.getUserNodesFilePath();
-    if (QFile::exists(userFilePath)) {
-        return loadNodesFile(userFilePath);
-    } else {
-        return loadNodesFile(builtinNodesFile);
+    QMutexLocker locker{&nodesMutex};
+    if (!nodesLoaded) {
+        nodes = loadNodesFile(nodesSourcePath());
+        nodesLoaded = true;
     }
+    return nodes;
 }
 
 void BootstrapNodeUpdater::requestBootstrapNodes()
@@ -259,6 +326,166 @@ QList<DhtServer> BootstrapNodeUpdater::loadDefaultBootstrapNodes()
     return loadNodesFile(builtinNodesFile);
 }
 
+/**
+ * @brief Writes the parsed node list in a compact binary form.
+ * @param cachePath File to write, replaced atomically.
+ * @param sourcePath Node list file the nodes were parsed from.
+ * @param nodes Parsed nodes.
+ * @return False if the file couldn't be written.
+ * @note Thread safe.
+ */
+bool BootstrapNodeUpdater::writeNodeCache(const QString& cachePath, const QString& sourcePath,
+                                          const QList<DhtServer>& nodes)
+{
+    QByteArray data;
+    QDataStream stream{&data, QIODevice::WriteOnly};
+    stream.setVersion(QDataStream::Qt_5_5);
+    const SourceStamp stamp = sourceStamp(sourcePath);
+    stream << nodeCacheMagic << nodeCacheVersion << stamp.path << stamp.size << stamp.modifiedMs
+           << static_cast<quint32>(nodes.size());
+    for (const DhtServer& node : nodes) {
+        stream << node.statusUdp << node.statusTcp << node.ipv4 << node.ipv6 << node.maintainer
+               << node.publicKey.getByteArray() << node.udpPort
+               << static_cast<quint32>(node.tcpPorts.size());
+        for (uint16_t port : node.tcpPorts) {
+            stream << port;
+        }
+    }
+
+    QSaveFile file{cachePath};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Couldn't write the bootstrap node cache" << cachePath;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a node list written by writeNodeCache().
+ * @param cachePath Cache file.
+ * @param sourcePath Node list file the cache must have been made from, in its current version.
+ * @param nodes Gets the cached nodes.
+ * @return False if there is no cache, it is corrupt or was made from another node list.
+ * @note Thread safe.
+ */
+bool BootstrapNodeUpdater::readNodeCache(const QString& cachePath, const QString& sourcePath,
+                                         QList<DhtServer>& nodes)
+{
+    QFile file{cachePath};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    QDataStream stream{data};
+    stream.setVersion(QDataStream::Qt_5_5);
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != nodeCacheMagic || version != nodeCacheVersion) {
+        return false;
+    }
+
+    const SourceStamp expected = sourceStamp(sourcePath);
+    SourceStamp stamp{{}, 0, 0};
+    quint32 count = 0;
+    stream >> stamp.path >> stamp.size >> stamp.modifiedMs >> count;
+    if (stream.status() != QDataStream::Ok || stamp.path != expected.path
+        || stamp.size != expected.size || stamp.modifiedMs != expected.modifiedMs
+        || count > maxCachedNodes) {
+        return false;
+    }
+
+    QList<DhtServer> cached;
+    cached.reserve(static_cast<int>(count));
+    for (quint32 i = 0; i < count; ++i) {
+        DhtServer node;
+        QByteArray publicKey;
+        quint32 portCount = 0;
+        stream >> node.statusUdp >> node.statusTcp >> node.ipv4 >> node.ipv6 >> node.maintainer
+            >> publicKey >> node.udpPort >> portCount;
+        if (stream.status() != QDataStream::Ok || publicKey.size() != ToxPk::size
+            || portCount > maxCachedTcpPorts) {
+            qWarning() << "Corrupt bootstrap node cache" << cachePath;
+            return false;
+        }
+
+        node.publicKey = ToxPk{publicKey};
+        for (quint32 j = 0; j < portCount; ++j) {
+            quint16 port = 0;
+            stream >> port;
+            node.tcpPorts.push_back(port);
+        }
+        cached.append(node);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Corrupt bootstrap node cache" << cachePath;
+        return false;
+    }
+
+    nodes = cached;
+    return true;
+}
+
+/**
+ * @brief The user's node list if there is one, the built in one otherwise.
+ */
+QString BootstrapNodeUpdater::nodesSourcePath() const
+{
+    const QString userFilePath = paths.getUserNodesFilePath();
+    return QFile::exists(userFilePath) ? userFilePath : QString{builtinNodesFile};
+}
+
+/**
+ * @brief Parses the node list and rewrites the cache and example file in the background.
+ */
+void BootstrapNodeUpdater::refreshNodes()
+{
+    const QString sourcePath = nodesSourcePath();
+    const QString cachePath = paths.getNodesCacheFilePath();
+    const QString examplePath = paths.getExampleNodesFilePath();
+    bool cached;
+    {
+        QMutexLocker locker{&nodesMutex};
+        cached = nodesLoaded;
+    }
+
+    // the watcher is deleted with this object, which drops the result
+    auto watcher = new QFutureWatcher<QList<DhtServer>>(this);
+    connect(watcher, &QFutureWatcher<QList<DhtServer>>::finished, this, [this, watcher] {
+        const QList<DhtServer> refreshed = watcher->result();
+        if (!refreshed.isEmpty()) {
+            setNodes(refreshed);
+        }
+        watcher->deleteLater();
+    });
+    auto refresh = [sourcePath, cachePath, examplePath, cached]() -> QList<DhtServer> {
+        const QList<DhtServer> builtinNodes = loadNodesFile(builtinNodesFile);
+        writeExampleNodesFile(examplePath, builtinNodes);
+        if (cached) {
+            // the cache was made from this very node list
+            return QList<DhtServer>{};
+        }
+
+        const QList<DhtServer> parsed =
+            sourcePath == builtinNodesFile ? builtinNodes : loadNodesFile(sourcePath);
+        if (!parsed.isEmpty()) {
+            writeNodeCache(cachePath, sourcePath, parsed);
+        }
+        return parsed;
+    };
+    watcher->setFuture(QtConcurrent::run(refresh));
+}
+
+void BootstrapNodeUpdater::setNodes(const QList<DhtServer>& newNodes)
+{
+    const QList<DhtServer> shared = sharedNodeList(newNodes);
+    QMutexLocker locker{&nodesMutex};
+    nodes = shared;
+    nodesLoaded = true;
+}
+
 void BootstrapNodeUpdater::onRequestComplete(QNetworkReply* reply)
 {
     if (reply->error() != QNetworkReply::NoError) {
@@ -267,15 +494,12 @@ void BootstrapNodeUpdater::onRequestComplete(QNetworkReply* reply)
         return;
     }
 
-    // parse the reply JSON
-    QJsonDocument jsonDocument = QJsonDocument::fromJson(reply->readAll());
-    if (jsonDocument.isNull()) {
-        emit availableBootstrapNodes({});
-        return;
-    }
-
-    qWarning() << "requestBootstrapNodes:onRequestComplete:**update bootstrapnodes from internet**";
-    QList<DhtServer> result = jsonToNodeList(jsonDocument);
-
-    emit availableBootstrapNodes(result);
+    // parse the reply JSON off the GUI thread
+    auto watcher = new QFutureWatcher<QList<DhtServer>>(this);
+    connect(watcher, &QFutureWatcher<QList<DhtServer>>::finished, this, [this, watcher] {
+        qWarning() << "requestBootstrapNodes:onRequestComplete:**update bootstrapnodes from internet**";
+        emit availableBootstrapNodes(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(parseNodesJson, reply->readAll()));
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <QList>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkProxy>
 #include <QObject>
@@ -39,6 +40,11 @@ public:
     void requestBootstrapNodes();
     static QList<DhtServer> loadDefaultBootstrapNodes();
 
+    static bool writeNodeCache(const QString& cachePath, const QString& sourcePath,
+                               const QList<DhtServer>& nodes);
+    static bool readNodeCache(const QString& cachePath, const QString& sourcePath,
+                              QList<DhtServer>& nodes);
+
 signals:
     void availableBootstrapNodes(QList<DhtServer> nodes);
 
@@ -46,10 +52,16 @@ private slots:
     void onRequestComplete(QNetworkReply* reply);
 
 private:
-    QList<DhtServer> loadUserBootrapNodes();
+    QString nodesSourcePath() const;
+    void refreshNodes();
+    void setNodes(const QList<DhtServer>& newNodes);
 
 private:
     QNetworkProxy proxy;
     QNetworkAccessManager nam;
     Paths& paths;
+    // read by Core from its thread
+    mutable QMutex nodesMutex;
+    mutable QList<DhtServer> nodes;
+    mutable bool nodesLoaded = false;
 };
@@ -32,6 +32,7 @@
 #include "src/widget/tool/messageboxmanager.h"
 #include "audio/audio.h"
 #include "src/ipc.h"
+#include "util/startupprofiler.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
@@ -94,6 +95,7 @@ Nexus::~Nexus()
  */
 void Nexus::start()
 {
+    StartupPhase phase{"Nexus::start"};
     qDebug() << "Starting up";
 
     // Setup the environment
@@ -117,9 +119,12 @@ void Nexus::start()
     qRegisterMetaType<ToxPk>("GroupId");
     qRegisterMetaType<ToxPk>("ChatId");
     qRegisterMetaType<GroupInvite>("GroupInvite");
+    qRegisterMetaType<QVector<LoadedFriend>>("QVector<LoadedFriend>");
+    qRegisterMetaType<QVector<LoadedGroup>>("QVector<LoadedGroup>");
     qRegisterMetaType<ReceiptNum>("ReceiptNum");
     qRegisterMetaType<RowId>("RowId");
     qRegisterMetaType<uint64_t>("uint64_t");
+    qRegisterMetaType<QVector<uint64_t>>("QVector<uint64_t>");
     qRegisterMetaType<ExtensionSet>("ExtensionSet");
 
     qApp->setQuitOnLastWindowClosed(false);
@@ -190,6 +195,7 @@ int Nexus::showLogin(const QString& profileName)
 
 void Nexus::bootstrapWithProfile(Profile* p)
 {
+    StartupPhase phase{"Nexus::bootstrapWithProfile"};
     // kriby: This is a hack until a proper controller is written
 
     profile = p;
@@ -209,6 +215,8 @@ void Nexus::connectLoginScreen(const LoginScreen& loginScreen)
     // Nexus -> LoginScreen
     QObject::connect(this, &Nexus::profileLoaded, &loginScreen, &LoginScreen::onProfileLoaded);
     QObject::connect(this, &Nexus::profileLoadFailed, &loginScreen, &LoginScreen::onProfileLoadFailed);
+    QObject::connect(this, &Nexus::profileLoadProgress, &loginScreen,
+                     &LoginScreen::onProfileLoadProgress);
     // LoginScreen -> Nexus
     QObject::connect(&loginScreen, &LoginScreen::createNewProfile, this, &Nexus::onCreateNewProfile);
     QObject::connect(&loginScreen, &LoginScreen::loadProfile, this, &Nexus::onLoadProfile);
@@ -226,8 +234,11 @@ void Nexus::showMainGUI()
     assert(profile);
 
     // Create GUI
-    widget = new Widget(*profile, *audioControl, cameraSource, settings, *style,
-        ipc, *this);
+    {
+        StartupPhase widgetPhase{"Widget::Widget"};
+        widget = new Widget(*profile, *audioControl, cameraSource, settings, *style,
+            ipc, *this);
+    }
 
     // Start GUI
     widget->init();
@@ -276,11 +287,13 @@ void Nexus::onCreateNewProfile(const QString& name, const QString& pass)
 
 /**
  * Loads an existing profile and replaces the current one.
+ * Unlocking the profile runs in the background, setProfile() is called when it is done.
  */
 void Nexus::onLoadProfile(const QString& name, const QString& pass)
 {
-    setProfile(Profile::loadProfile(name, pass, settings, parser, cameraSource,
-        messageBoxManager));
+    Profile::loadProfileAsync(name, pass, settings, parser, cameraSource, messageBoxManager, this,
+                              [this](Profile* p) { setProfile(p); },
+                              [this](int done, int total) { emit profileLoadProgress(done, total); });
     parser = nullptr; // only apply cmdline proxy settings once
 }
 /**
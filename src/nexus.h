@@ -89,6 +89,7 @@ signals:
     void currentProfileChanged(Profile* Profile);
     void profileLoaded();
     void profileLoadFailed();
+    void profileLoadProgress(int done, int total);
     void saveGlobal();
 
 public slots:
@@ -0,0 +1,251 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "blobstore.h"
+#include "src/core/toxencrypt.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QWriteLocker>
+
+namespace {
+// "BLOB" can't be the start of a hex string, so references never look like inline image data
+const QString REFERENCE_PREFIX = QStringLiteral("BLOB");
+constexpr int HASH_HEX_LENGTH = 64;
+const QString THUMBNAIL_DIR = QStringLiteral("thumbnails");
+} // namespace
+
+/**
+ * @class BlobStore
+ * @brief Content addressed files for data too big for the history database, e.g. group images.
+ *
+ * Every blob is stored once in its own file, named by the SHA256 of its content, so receiving
+ * the same image again doesn't take any more space. Messages reference a blob by a string of
+ * "BLOB" followed by that hash. With an encrypted profile the files are encrypted with the
+ * profile key.
+ *
+ * Downscaled copies of images for the chat log are kept in a "thumbnails" subdirectory, also
+ * encrypted. They are only a cache, so instead of re-encrypting them on a password change they
+ * are deleted and recreated on demand.
+ *
+ * @note get(), put() and the thumbnail functions may be called from worker threads, the other
+ * functions wait until those calls are done.
+ */
+
+/**
+ * @param dirPath Directory holding the blob files, created on first write.
+ * @param passkey Key to encrypt blobs with, nullptr to store them unencrypted.
+ */
+BlobStore::BlobStore(const QString& dirPath_, const ToxEncrypt* passkey_)
+    : dirPath{dirPath_}
+    , passkey{passkey_}
+{}
+
+/**
+ * @brief Checks whether an id of a message refers to a blob.
+ * @param idOrHash Id stored with the message.
+ * @return True if get() can resolve it.
+ */
+bool BlobStore::isReference(const QString& idOrHash)
+{
+    return idOrHash.size() == REFERENCE_PREFIX.size() + HASH_HEX_LENGTH
+           && idOrHash.startsWith(REFERENCE_PREFIX);
+}
+
+/**
+ * @brief Stores a blob, unless one with the same content is already stored.
+ * @param data Content of the blob.
+ * @return Reference to the blob, empty on failure.
+ */
+QString BlobStore::put(const QByteArray& data)
+{
+    const QString hash =
+        QString::fromUtf8(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex())
+            .toUpper();
+    const QString path = blobPath(hash);
+
+    QReadLocker locker{&lock};
+    if (!QFile::exists(path) && !writeBlob(dirPath, path, data, passkey)) {
+        return {};
+    }
+
+    return REFERENCE_PREFIX + hash;
+}
+
+/**
+ * @brief Loads the content of a blob.
+ * @param reference Reference returned by put().
+ * @return Content of the blob, empty if it is missing or can't be decrypted.
+ */
+QByteArray BlobStore::get(const QString& reference) const
+{
+    if (!isReference(reference)) {
+        return {};
+    }
+
+    QReadLocker locker{&lock};
+    return readBlob(blobPath(reference.mid(REFERENCE_PREFIX.size())), passkey);
+}
+
+/**
+ * @brief Loads a cached thumbnail.
+ * @param name Name the thumbnail was stored with.
+ * @return Content of the thumbnail, empty if it isn't cached.
+ */
+QByteArray BlobStore::getThumbnail(const QString& name) const
+{
+    QReadLocker locker{&lock};
+    const QString path = QDir(thumbnailDirPath()).filePath(name);
+    if (!QFile::exists(path)) {
+        return {};
+    }
+
+    return readBlob(path, passkey);
+}
+
+/**
+ * @brief Caches a thumbnail, replacing an older one with the same name.
+ * @param name File name for the thumbnail, e.g. derived from the image and its size.
+ * @param data Encoded thumbnail.
+ * @return False on failure.
+ */
+bool BlobStore::putThumbnail(const QString& name, const QByteArray& data) const
+{
+    QReadLocker locker{&lock};
+    const QString dir = thumbnailDirPath();
+    return writeBlob(dir, QDir(dir).filePath(name), data, passkey);
+}
+
+/**
+ * @brief Re-encrypts all stored blobs, e.g. after the profile password changed.
+ * @param newPasskey Key to use from now on, nullptr to store blobs unencrypted.
+ * @return False if any blob couldn't be converted, those keep the old key.
+ */
+bool BlobStore::setPasskey(const ToxEncrypt* newPasskey)
+{
+    QWriteLocker locker{&lock};
+    QDir(thumbnailDirPath()).removeRecursively();
+
+    bool success = true;
+    const QDir dir{dirPath};
+    for (const QString& name : dir.entryList(QDir::Files)) {
+        const QString path = dir.filePath(name);
+        const QByteArray data = readBlob(path, passkey);
+        if (data.isEmpty() || !writeBlob(dirPath, path, data, newPasskey)) {
+            qWarning() << "Failed to re-encrypt blob" << name;
+            success = false;
+        }
+    }
+
+    passkey = newPasskey;
+    return success;
+}
+
+/**
+ * @brief Moves the blobs to a new directory, e.g. when the profile is renamed.
+ * @param newDirPath New directory, must not exist yet.
+ * @return False if the blobs couldn't be moved, they stay at the old path then.
+ */
+bool BlobStore::rename(const QString& newDirPath)
+{
+    QWriteLocker locker{&lock};
+    if (QDir(dirPath).exists() && !QDir().rename(dirPath, newDirPath)) {
+        qWarning() << "Failed to move blobs to" << newDirPath;
+        return false;
+    }
+
+    dirPath = newDirPath;
+    return true;
+}
+
+/**
+ * @brief Deletes all blobs.
+ * @return False on failure.
+ */
+bool BlobStore::remove()
+{
+    QWriteLocker locker{&lock};
+    QDir dir{dirPath};
+    if (!dir.exists()) {
+        return true;
+    }
+
+    return dir.removeRecursively();
+}
+
+QString BlobStore::blobPath(const QString& hash) const
+{
+    return QDir(dirPath).filePath(hash);
+}
+
+QString BlobStore::thumbnailDirPath() const
+{
+    return QDir(dirPath).filePath(THUMBNAIL_DIR);
+}
+
+bool BlobStore::writeBlob(const QString& dir, const QString& path, const QByteArray& data,
+                          const ToxEncrypt* key) const
+{
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Couldn't create blob directory" << dir;
+        return false;
+    }
+
+    const QByteArray content = key ? key->encrypt(data) : data;
+    if (content.isEmpty()) {
+        qWarning() << "Failed to encrypt blob" << path;
+        return false;
+    }
+
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Blob" << path << "couldn't be saved";
+        return false;
+    }
+
+    file.write(content);
+    return file.commit();
+}
+
+QByteArray BlobStore::readBlob(const QString& path, const ToxEncrypt* key) const
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Blob" << path << "couldn't be opened";
+        return {};
+    }
+
+    const QByteArray content = file.readAll();
+    if (!ToxEncrypt::isEncrypted(content)) {
+        // stored before the profile got a password
+        return content;
+    }
+
+    if (!key) {
+        qWarning() << "Blob" << path << "is encrypted, but no key is set";
+        return {};
+    }
+
+    return key->decrypt(content);
+}
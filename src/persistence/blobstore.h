@@ -0,0 +1,55 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QReadWriteLock>
+#include <QString>
+
+class ToxEncrypt;
+
+class BlobStore
+{
+public:
+    BlobStore(const QString& dirPath, const ToxEncrypt* passkey);
+
+    static bool isReference(const QString& idOrHash);
+
+    QString put(const QByteArray& data);
+    QByteArray get(const QString& reference) const;
+    QByteArray getThumbnail(const QString& name) const;
+    bool putThumbnail(const QString& name, const QByteArray& data) const;
+    bool setPasskey(const ToxEncrypt* newPasskey);
+    bool rename(const QString& newDirPath);
+    bool remove();
+
+private:
+    QString blobPath(const QString& hash) const;
+    QString thumbnailDirPath() const;
+    bool writeBlob(const QString& dir, const QString& path, const QByteArray& data,
+                   const ToxEncrypt* key) const;
+    QByteArray readBlob(const QString& path, const ToxEncrypt* key) const;
+
+private:
+    mutable QReadWriteLock lock;
+    QString dirPath;
+    const ToxEncrypt* passkey;
+};
@@ -0,0 +1,246 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dbbackfill.h"
+
+#include <QDebug>
+
+#include <cassert>
+
+/**
+ * @class DbBackfill
+ * @brief Runs the data moving part of schema upgrades in the background after the profile opened.
+ *
+ * Upgrades that would fill a new table or index from the whole history only create the empty
+ * structure and schedule a task in the db_backfills table. The task advances its position in
+ * small batches, each batch commits its new position, so an interrupted backfill continues
+ * where it stopped on the next start. Only one batch is queued at a time and the next one waits
+ * BATCH_INTERVAL_MS, so queries of the GUI don't wait behind a long transaction.
+ *
+ * Until a task is finished its data is incomplete, readers check isPending() and fall back, see
+ * History.
+ *
+ * @var DbBackfill::Task::FullTextIndex
+ * @brief Fills text_messages_fts, position is the text_messages.id indexed up to.
+ *
+ * @var DbBackfill::Task::DayCounts
+ * @brief Fills chat_day_counts, position is the chats.id counted up to.
+ */
+
+constexpr int DbBackfill::FULL_TEXT_BATCH_IDS;
+constexpr int DbBackfill::BATCH_INTERVAL_MS;
+
+/**
+ * @param db_ Database to backfill, must be at the current schema version.
+ */
+DbBackfill::DbBackfill(std::shared_ptr<RawDatabase> db_)
+    : db{std::move(db_)}
+{
+    static int id = qRegisterMetaType<DbBackfill::Task>();
+    (void)id;
+
+    connect(this, &DbBackfill::batchDone, this, &DbBackfill::onBatchDone);
+    timer.setSingleShot(true);
+    timer.setInterval(BATCH_INTERVAL_MS);
+    connect(&timer, &QTimer::timeout, this, &DbBackfill::runNextBatch);
+
+    db->execNow(RawDatabase::Query{QStringLiteral("SELECT task FROM db_backfills;"),
+                                   [this](const QVector<QVariant>& row) {
+                                       const QString name = row[0].toString();
+                                       for (const auto task : {Task::FullTextIndex, Task::DayCounts}) {
+                                           if (taskName(task) == name) {
+                                               pendingTasks.append(task);
+                                           }
+                                       }
+                                   }});
+
+    if (!pendingTasks.isEmpty()) {
+        qDebug() << pendingTasks.size() << "database backfills are pending";
+    }
+}
+
+/**
+ * @brief Starts working on the scheduled tasks, does nothing if there are none.
+ */
+void DbBackfill::start()
+{
+    if (running || pendingTasks.isEmpty()) {
+        return;
+    }
+
+    running = true;
+    timer.start();
+}
+
+/**
+ * @brief Checks if the data of a task is still incomplete.
+ * @param task Task to check.
+ * @return True until the last batch of the task is committed.
+ */
+bool DbBackfill::isPending(Task task) const
+{
+    return pendingTasks.contains(task);
+}
+
+/**
+ * @brief Generate query creating the table of scheduled tasks, if it doesn't exist yet.
+ */
+RawDatabase::Query DbBackfill::createTable()
+{
+    return RawDatabase::Query{QStringLiteral(
+        "CREATE TABLE IF NOT EXISTS db_backfills (task TEXT PRIMARY KEY, "
+        "position INTEGER NOT NULL, last_id INTEGER NOT NULL);")};
+}
+
+/**
+ * @brief Generate queries scheduling a task to start from the beginning.
+ * @param task Task to schedule.
+ *
+ * Only rows that exist now are covered, rows inserted later are kept up to date by triggers.
+ * Nothing is scheduled for empty tables.
+ */
+QVector<RawDatabase::Query> DbBackfill::schedule(Task task)
+{
+    QString lastIdQuery;
+    switch (task) {
+    case Task::FullTextIndex:
+        lastIdQuery = QStringLiteral("SELECT id FROM text_messages ORDER BY id DESC LIMIT 1");
+        break;
+    case Task::DayCounts:
+        lastIdQuery = QStringLiteral("SELECT id FROM chats ORDER BY id DESC LIMIT 1");
+        break;
+    }
+
+    return {createTable(),
+            RawDatabase::Query{QStringLiteral("INSERT OR REPLACE INTO db_backfills "
+                                              "(task, position, last_id) "
+                                              "SELECT '%1', 0, id FROM (%2);")
+                                   .arg(taskName(task))
+                                   .arg(lastIdQuery)}};
+}
+
+/**
+ * @brief Generate the condition for triggers to skip rows a task hasn't reached yet.
+ * @param task Task covering the rows.
+ * @param rowId Expression of the row id, for example "old.id".
+ *
+ * The task fills those rows itself later, a trigger touching them too would do it twice.
+ */
+QString DbBackfill::notPendingCondition(Task task, const QString& rowId)
+{
+    return QStringLiteral("NOT EXISTS (SELECT 1 FROM db_backfills WHERE task = '%1' "
+                          "AND %2 > position AND %2 <= last_id)")
+        .arg(taskName(task))
+        .arg(rowId);
+}
+
+/**
+ * @brief Generate queries recounting the messages of one chat per day.
+ * @param chatIdQuery Expression of the chats.id to count.
+ * @param boundParams Parameters bound to chatIdQuery.
+ *
+ * Replaces whatever the triggers counted so far, so a chat can be counted again at any time.
+ */
+QVector<RawDatabase::Query> DbBackfill::fillDayCounts(const QString& chatIdQuery,
+                                                      const QVector<QByteArray>& boundParams)
+{
+    return {RawDatabase::Query{
+                QStringLiteral("DELETE FROM chat_day_counts WHERE chat_id = %1;").arg(chatIdQuery),
+                boundParams},
+            RawDatabase::Query{QStringLiteral("INSERT INTO chat_day_counts "
+                                              "(chat_id, day, count, first_id) "
+                                              "SELECT chat_id, timestamp / 86400000, COUNT(*), "
+                                              "MIN(id) FROM history WHERE chat_id = %1 "
+                                              "GROUP BY timestamp / 86400000;")
+                                   .arg(chatIdQuery),
+                               boundParams}};
+}
+
+void DbBackfill::runNextBatch()
+{
+    if (!db->isOpen() || pendingTasks.isEmpty()) {
+        running = false;
+        return;
+    }
+
+    const Task task = pendingTasks.first();
+    const QString name = taskName(task);
+    int step = 1;
+    QVector<RawDatabase::Query> queries;
+    switch (task) {
+    case Task::FullTextIndex:
+        step = FULL_TEXT_BATCH_IDS;
+        queries += RawDatabase::Query{
+            QStringLiteral("INSERT INTO text_messages_fts (rowid, message) "
+                           "SELECT text_messages.id, text_messages.message "
+                           "FROM text_messages, db_backfills WHERE db_backfills.task = '%1' "
+                           "AND text_messages.id > db_backfills.position "
+                           "AND text_messages.id <= MIN(db_backfills.position + %2, "
+                           "db_backfills.last_id);")
+                .arg(name)
+                .arg(step)};
+        break;
+    case Task::DayCounts:
+        // one chat per batch
+        queries += fillDayCounts(
+            QStringLiteral("(SELECT position + 1 FROM db_backfills WHERE task = '%1')").arg(name),
+            {});
+        break;
+    }
+
+    queries += RawDatabase::Query{QStringLiteral("UPDATE db_backfills SET position = "
+                                                 "MIN(position + %1, last_id) WHERE task = '%2';")
+                                      .arg(step)
+                                      .arg(name)};
+    queries += RawDatabase::Query{
+        QStringLiteral("SELECT position >= last_id FROM db_backfills WHERE task = '%1';").arg(name),
+        [this, task](const QVector<QVariant>& row) { emit batchDone(task, row[0].toBool()); }};
+    queries += RawDatabase::Query{
+        QStringLiteral("DELETE FROM db_backfills WHERE task = '%1' AND position >= last_id;")
+            .arg(name)};
+    db->execLater(queries);
+}
+
+/**
+ * @param task Task of the batch.
+ * @param taskFinished True if it was the last batch of the task.
+ */
+void DbBackfill::onBatchDone(Task task, bool taskFinished)
+{
+    running = false;
+    if (taskFinished) {
+        qDebug() << "Database backfill" << taskName(task) << "finished";
+        pendingTasks.removeAll(task);
+        emit finished(task);
+    }
+
+    start();
+}
+
+QString DbBackfill::taskName(Task task)
+{
+    switch (task) {
+    case Task::FullTextIndex:
+        return QStringLiteral("fts");
+    case Task::DayCounts:
+        return QStringLiteral("day_counts");
+    }
+    assert(false);
+    return {};
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "rawdatabase.h"
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+class DbBackfill : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Task
+    {
+        FullTextIndex,
+        DayCounts,
+    };
+
+    explicit DbBackfill(std::shared_ptr<RawDatabase> db);
+
+    void start();
+    bool isPending(Task task) const;
+
+    static RawDatabase::Query createTable();
+    static QVector<RawDatabase::Query> schedule(Task task);
+    static QString notPendingCondition(Task task, const QString& rowId);
+    static QVector<RawDatabase::Query> fillDayCounts(const QString& chatIdQuery,
+                                                     const QVector<QByteArray>& boundParams);
+
+    static constexpr int FULL_TEXT_BATCH_IDS = 2000;
+    static constexpr int BATCH_INTERVAL_MS = 20;
+
+signals:
+    void finished(DbBackfill::Task task);
+    void batchDone(DbBackfill::Task task, bool finished);
+
+private slots:
+    void runNextBatch();
+    void onBatchDone(DbBackfill::Task task, bool taskFinished);
+
+private:
+    static QString taskName(Task task);
+
+    std::shared_ptr<RawDatabase> db;
+    QVector<Task> pendingTasks;
+    bool running = false;
+    QTimer timer;
+};
+Q_DECLARE_METATYPE(DbBackfill::Task)
@@ -0,0 +1,56 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "dbmaintenancescheduler.h"
+#include "rawdatabase.h"
+
+/**
+ * @class DbMaintenanceScheduler
+ * @brief Hands the database short maintenance slices while the client is idle.
+ *
+ * Every CHECK_INTERVAL_MS the idle check is asked whether calls or file transfers are running,
+ * if none are the database gets MAINTENANCE_BUDGET_MS to work on its current maintenance round.
+ * RawDatabase::maintain decides itself whether a round is due and yields to pending writes.
+ */
+
+constexpr int DbMaintenanceScheduler::CHECK_INTERVAL_MS;
+constexpr qint64 DbMaintenanceScheduler::MAINTENANCE_BUDGET_MS;
+
+/**
+ * @param db_ Database to maintain.
+ * @param isIdle_ Returns false while latency sensitive work is going on, called on this thread.
+ */
+DbMaintenanceScheduler::DbMaintenanceScheduler(std::shared_ptr<RawDatabase> db_,
+                                               std::function<bool()> isIdle_)
+    : db{std::move(db_)}
+    , isIdle{std::move(isIdle_)}
+{
+    connect(&timer, &QTimer::timeout, this, &DbMaintenanceScheduler::onTimeout);
+    timer.start(CHECK_INTERVAL_MS);
+}
+
+void DbMaintenanceScheduler::onTimeout()
+{
+    if (!db->isOpen() || !isIdle()) {
+        return;
+    }
+
+    db->maintain(MAINTENANCE_BUDGET_MS);
+}
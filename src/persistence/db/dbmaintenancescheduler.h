@@ -0,0 +1,48 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+
+class RawDatabase;
+
+class DbMaintenanceScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    DbMaintenanceScheduler(std::shared_ptr<RawDatabase> db, std::function<bool()> isIdle);
+
+    static constexpr int CHECK_INTERVAL_MS = 60 * 1000;
+    static constexpr qint64 MAINTENANCE_BUDGET_MS = 250;
+
+private slots:
+    void onTimeout();
+
+private:
+    std::shared_ptr<RawDatabase> db;
+    std::function<bool()> isIdle;
+    QTimer timer;
+};
@@ -18,7 +18,11 @@
 */
 
 #include "rawdatabase.h"
+#include "util/lockprofiler.h"
+#include "util/threadscheduling.h"
+#include "util/tracer.h"
 
+#include <algorithm>
 #include <cassert>
 #include <tox/toxencryptsave.h>
 
@@ -28,6 +32,13 @@
 #include <QMetaObject>
 #include <QMutexLocker>
 
+constexpr size_t RawDatabase::STATEMENT_CACHE_SIZE;
+constexpr int RawDatabase::GROUP_COMMIT_WINDOW_MS;
+constexpr int RawDatabase::CHECKPOINT_DELAY_MS;
+constexpr size_t RawDatabase::READ_CONNECTIONS;
+constexpr int RawDatabase::READ_BUSY_TIMEOUT_MS;
+constexpr qint64 RawDatabase::MAINTENANCE_ROUND_INTERVAL_MS;
+constexpr int RawDatabase::VACUUM_SLICE_PAGES;
 
 /**
  * @class RawDatabase
@@ -39,6 +50,21 @@
  *
  * @var QMutex RawDatabase::transactionsMutex;
  * @brief Protects pendingTransactions
+ *
+ * @var std::list<CachedStatements> RawDatabase::statementCache
+ * @brief Prepared statements of recently executed queries, most recently used first.
+ *
+ * Only touched by the worker thread. Statements in the cache are reset and have no bindings.
+ * The cache is dropped whenever the connection is closed or a query changes the schema, cipher
+ * or attached databases.
+ *
+ * @var RawDatabase::statementCacheIndex
+ * @brief Looks up statementCache entries by their UTF-8 query string.
+
+ *
+ * @var RawDatabase::readConnections
+ * @brief Read only connections to the same database, used by execNow for SELECT queries from
+ * other threads so they don't queue behind the writes of the worker thread.
  */
 
 /**
@@ -61,10 +87,39 @@
  * @var std::function<void(const QVector<QVariant>&)> RawDatabase::Query::rowCallback
  * @brief Called during execution for each row
  *
+ * @var std::function<void(const Row&)> RawDatabase::Query::typedRowCallback
+ * @brief Called during execution for each row, reads the columns it needs directly from the
+ * statement instead of boxing every column in a QVariant
+ *
  * @var QVector<sqlite3_stmt*> RawDatabase::Query::statements
  * @brief Statements to be compiled from the query
+ *
+ * @var bool RawDatabase::Query::reusable
+ * @brief True if all statements compiled and may go back to the statement cache
  */
 
+/**
+ * @class Row
+ * @brief Typed view of the current result row of a statement, only valid during the row
+ * callback it was passed to.
+ *
+ * Columns are read with get<T>() or read(), which fills consecutive columns into variables of
+ * their types, straight from sqlite3_column_*. int64_t, RowId, bool, QString and QByteArray are
+ * supported. NULL reads as 0 or an empty value, like it did
+ * through QVariant.
+ */
+
+/**
+ * @brief Reads a blob column without copying it.
+ * @param col Column to read.
+ * @return Bytes owned by SQLite, only valid until the row callback returns.
+ */
+QByteArray RawDatabase::Row::getRawBlob(int col) const
+{
+    const char* data = reinterpret_cast<const char*>(sqlite3_column_blob(stmt, col));
+    return QByteArray::fromRawData(data, sqlite3_column_bytes(stmt, col));
+}
+
 /**
  * @struct Transaction
  * @brief SQL transactions to be processed.
@@ -76,6 +131,9 @@
  *
  * @var std::atomic_bool* RawDatabase::Transaction::done = nullptr;
  * @brief If not a nullptr, will be set to true when the transaction has been executed
+ *
+ * @var qint64 RawDatabase::Transaction::queuedNs
+ * @brief When the transaction was queued, on RawDatabase::queueClock
  */
 
 /**
@@ -83,18 +141,48 @@
  * @param path Path to database.
  * @param password If empty, the database will be opened unencrypted.
  * Otherwise we will use toxencryptsave to derive a key and encrypt the database.
+ * @param hexKey Key returned by getHexKey() in an earlier session. It is tried first, since
+ * deriving the key from the password takes a noticeable time.
+ * @param cipherTier_ Encryption params an encrypted database is migrated to when it's opened.
  */
-RawDatabase::RawDatabase(const QString& path_, const QString& password, const QByteArray& salt)
+RawDatabase::RawDatabase(const QString& path_, const QString& password, const QByteArray& salt,
+                         const QString& hexKey, SqlCipherTier cipherTier_)
     : workerThread{new QThread}
     , path{path_}
     , currentSalt{salt} // we need the salt later if a new password should be set
-    , currentHexKey{deriveKey(password, salt)}
+    , cipherTier{cipherTier_}
+    , groupCommitTimer{this}
+    , checkpointTimer{this}
+    , diagnostics{"database", [this] { return collectDiagnostics(); }}
 {
+    queueClock.start();
+    groupCommitTimer.setSingleShot(true);
+    groupCommitTimer.setTimerType(Qt::PreciseTimer);
+    groupCommitTimer.setInterval(GROUP_COMMIT_WINDOW_MS);
+    connect(&groupCommitTimer, &QTimer::timeout, this, &RawDatabase::process);
+    checkpointTimer.setSingleShot(true);
+    checkpointTimer.setInterval(CHECKPOINT_DELAY_MS);
+    connect(&checkpointTimer, &QTimer::timeout, this, &RawDatabase::checkpoint);
+
     workerThread->setObjectName("qTox Database");
+    connect(workerThread.get(), &QThread::started, this, []() {
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+    });
     moveToThread(workerThread.get());
     workerThread->start();
 
+    if (!password.isEmpty() && !hexKey.isEmpty()) {
+        currentHexKey = hexKey;
+        if (open(path, currentHexKey)) {
+            return;
+        }
+
+        qWarning() << "Cached database key doesn't fit, deriving it from the password";
+        close();
+    }
+
     // first try with the new salt
+    currentHexKey = deriveKey(password, salt);
     if (open(path, currentHexKey)) {
         return;
     }
@@ -180,9 +268,85 @@ bool RawDatabase::open(const QString& path_, const QString& hexKey)
             return false;
         }
     }
+
+    // Commits only append to the log, and synchronous = NORMAL syncs it at checkpoints instead of
+    // on every commit. A crash may lose the last commits, but never corrupts the database.
+    QString journalMode;
+    execNow(Query("PRAGMA journal_mode = WAL;", [&](const QVector<QVariant>& row) {
+        journalMode = row[0].toString();
+    }));
+    if (journalMode.compare("wal", Qt::CaseInsensitive) != 0
+        || !execNow("PRAGMA synchronous = NORMAL;")) {
+        qWarning() << "Failed to enable write-ahead logging, using the rollback journal";
+        return true;
+    }
+    // checkpoints are run by checkpoint() when we are idle
+    sqlite3_wal_autocheckpoint(sqlite, 0);
+
+    // readers only see committed data in WAL mode, so they can run next to the writer
+    if (!openReadConnections(path_, hexKey)) {
+        qWarning() << "Failed to open read connections, all queries will run on the worker thread";
+        closeReadConnections();
+    }
+    return true;
+}
+
+/**
+ * @brief Opens the read only connections serving execNow SELECT queries.
+ * @param path_ Path to database.
+ * @param hexKey Key of the database, empty if it isn't encrypted.
+ * @return True if all connections are usable.
+ */
+bool RawDatabase::openReadConnections(const QString& path_, const QString& hexKey)
+{
+    for (ReadConnection& connection : readConnections) {
+        QMutexLocker locker{&connection.mutex};
+        if (sqlite3_open_v2(path_.toUtf8().data(), &connection.sqlite,
+                            SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr)
+            != SQLITE_OK) {
+            qWarning() << "Failed to open read connection with error:"
+                       << sqlite3_errmsg(connection.sqlite);
+            return false;
+        }
+
+        sqlite3_busy_timeout(connection.sqlite, READ_BUSY_TIMEOUT_MS);
+        if (sqlite3_create_function(connection.sqlite, "regexp", 2, SQLITE_UTF8, nullptr,
+                                    &RawDatabase::regexpInsensitive, nullptr, nullptr)
+            || sqlite3_create_function(connection.sqlite, "regexpsensitive", 2, SQLITE_UTF8,
+                                       nullptr, &RawDatabase::regexpSensitive, nullptr, nullptr)) {
+            qWarning() << "Failed to create functions for read connection";
+            return false;
+        }
+
+        QString setup;
+        if (!hexKey.isEmpty()) {
+            setup = "PRAGMA key = \"x'" + hexKey + "'\";"
+                    + cipherParametersQuery(currentCipherParams, {});
+        }
+        setup += "SELECT count(*) FROM sqlite_master;";
+        if (sqlite3_exec(connection.sqlite, setup.toUtf8().constData(), nullptr, nullptr, nullptr)
+            != SQLITE_OK) {
+            qWarning() << "Read connection is not usable:" << sqlite3_errmsg(connection.sqlite);
+            return false;
+        }
+    }
     return true;
 }
 
+/**
+ * @brief Closes the read only connections, waiting for running reads to finish.
+ */
+void RawDatabase::closeReadConnections()
+{
+    for (ReadConnection& connection : readConnections) {
+        QMutexLocker locker{&connection.mutex};
+        if (connection.sqlite != nullptr) {
+            sqlite3_close(connection.sqlite);
+            connection.sqlite = nullptr;
+        }
+    }
+}
+
 bool RawDatabase::openEncryptedDatabaseAtLatestSupportedVersion(const QString& hexKey)
 {
     // old qTox database are saved with SQLCipher 3.x defaults. For a period after 1.16.3 but before 1.17.0, databases
@@ -197,6 +361,7 @@ bool RawDatabase::openEncryptedDatabaseAtLatestSupportedVersion(const QString& h
     if (setCipherParameters(highestSupportedVersion)) {
         if (testUsable()) {
             qInfo() << "Opened database with SQLCipher" << toString(highestSupportedVersion) << "parameters";
+            currentCipherParams = highestSupportedVersion;
             return true;
         } else {
             return updateSavedCipherParameters(hexKey, highestSupportedVersion);
@@ -214,7 +379,8 @@ bool RawDatabase::testUsable()
 }
 
 /**
- * @brief Changes stored db encryption from SQLCipher 3.x defaults to 4.x defaults
+ * @brief Changes stored db encryption from SQLCipher 3.x defaults to 4.x defaults, or between the
+ * 4.x default and performance params.
  */
 bool RawDatabase::updateSavedCipherParameters(const QString& hexKey, SqlCipherParams newParams)
 {
@@ -252,6 +418,18 @@ bool RawDatabase::updateSavedCipherParameters(const QString& hexKey, SqlCipherPa
 }
 
 bool RawDatabase::setCipherParameters(SqlCipherParams params, const QString& database)
+{
+    qDebug() << "Setting SQLCipher" << toString(params) << "parameters";
+    return execNow(cipherParametersQuery(params, database));
+}
+
+/**
+ * @brief Builds the PRAGMAs setting the SQLCipher parameters of a database.
+ * @param params Parameters to set.
+ * @param database Name of the attached database, null for the main database.
+ * @return Query string of all the PRAGMAs.
+ */
+QString RawDatabase::cipherParametersQuery(SqlCipherParams params, const QString& database)
 {
     QString prefix;
     if (!database.isNull()) {
@@ -273,6 +451,16 @@ bool RawDatabase::setCipherParameters(SqlCipherParams params, const QString& dat
                    "PRAGMA database.cipher_hmac_algorithm = HMAC_SHA512;"
                    "PRAGMA database.cipher_kdf_algorithm = PBKDF2_HMAC_SHA512;"
                    "PRAGMA database.cipher_memory_security = ON;"}; // got disabled by default in 4.5.0, so manually enable it
+    // Larger pages need fewer decryptions and HMAC checks when scanning the history, and without
+    // memory security SQLCipher doesn't lock and wipe every page buffer. The raw key skips the
+    // KDF, so kdf_iter only has to match the 4.0 defaults. A larger page cache keeps more
+    // decrypted pages around, memory mapping isn't used by SQLCipher for encrypted databases.
+    const QString performance4_xParams{"PRAGMA database.cipher_page_size = 16384;"
+                   "PRAGMA database.kdf_iter = 256000;"
+                   "PRAGMA database.cipher_hmac_algorithm = HMAC_SHA512;"
+                   "PRAGMA database.cipher_kdf_algorithm = PBKDF2_HMAC_SHA512;"
+                   "PRAGMA database.cipher_memory_security = OFF;"
+                   "PRAGMA database.cache_size = -8192;"};
 
     QString defaultParams;
     switch(params) {
@@ -288,10 +476,13 @@ bool RawDatabase::setCipherParameters(SqlCipherParams params, const QString& dat
             defaultParams = default4_xParams;
             break;
         }
+        case SqlCipherParams::p4_0Performance: {
+            defaultParams = performance4_xParams;
+            break;
+        }
     }
 
-    qDebug() << "Setting SQLCipher" << toString(params) << "parameters";
-    return execNow(defaultParams.replace("database.", prefix));
+    return defaultParams.replace("database.", prefix);
 }
 
 RawDatabase::SqlCipherParams RawDatabase::highestSupportedParams()
@@ -313,7 +504,9 @@ RawDatabase::SqlCipherParams RawDatabase::highestSupportedParams()
             highestSupportedParams = SqlCipherParams::halfUpgradedTo4;
             break;
         case 4:
-            highestSupportedParams = SqlCipherParams::p4_0;
+            highestSupportedParams = cipherTier == SqlCipherTier::Performance
+                                         ? SqlCipherParams::p4_0Performance
+                                         : SqlCipherParams::p4_0;
             break;
         default:
             qCritical() << "Unsupported SQLCipher version detected!";
@@ -325,8 +518,14 @@ RawDatabase::SqlCipherParams RawDatabase::highestSupportedParams()
 
 RawDatabase::SqlCipherParams RawDatabase::readSavedCipherParams(const QString& hexKey, SqlCipherParams newParams)
 {
-    for (int i = static_cast<int>(SqlCipherParams::p3_0); i < static_cast<int>(newParams); ++i)
+    // the performance params may also be left for the defaults, so try all others
+    for (int i = static_cast<int>(SqlCipherParams::p3_0);
+         i <= static_cast<int>(SqlCipherParams::p4_0Performance); ++i)
     {
+        if (i == static_cast<int>(newParams)) {
+            continue;
+        }
+
         if (!setKey(hexKey)) {
             break;
         }
@@ -375,6 +574,10 @@ void RawDatabase::close()
 
     // We assume we're in the ctor or dtor, so we just need to finish processing our transactions
     process();
+    closeReadConnections();
+    clearStatementCache();
+    groupCommitTimer.stop();
+    checkpointTimer.stop();
 
     if (sqlite3_close(sqlite) == SQLITE_OK)
         sqlite = nullptr;
@@ -424,6 +627,12 @@ bool RawDatabase::execNow(const QVector<RawDatabase::Query>& statements)
         return false;
     }
 
+    bool readSuccess;
+    if (QThread::currentThread() != workerThread.get() && isReadOnly(statements)
+        && execRead(statements, readSuccess)) {
+        return readSuccess;
+    }
+
     std::atomic_bool done{false};
     std::atomic_bool success{false};
 
@@ -432,8 +641,8 @@ bool RawDatabase::execNow(const QVector<RawDatabase::Query>& statements)
     trans.done = &done;
     trans.success = &success;
     {
-        QMutexLocker locker{&transactionsMutex};
-        pendingTransactions.enqueue(trans);
+        PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+        enqueueLocked(trans);
     }
 
     // We can't use blocking queued here, otherwise we might process future transactions
@@ -469,11 +678,57 @@ void RawDatabase::execLater(const QVector<RawDatabase::Query>& statements)
     Transaction trans;
     trans.queries = statements;
     {
-        QMutexLocker locker{&transactionsMutex};
-        pendingTransactions.enqueue(trans);
+        PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+        enqueueLocked(trans);
+    }
+
+    QMetaObject::invokeMethod(this, "scheduleProcess", Qt::QueuedConnection);
+}
+
+/**
+ * @brief Executes a read only transaction on one of the read connections.
+ * @param statements List of SELECT statements to execute.
+ * @param success Set to whether the transaction was successful.
+ * @return False if no read connection is open and the worker thread has to execute it.
+ *
+ * Waits for the transactions queued before to be processed first, so execLater writes are visible
+ * just like on the worker thread, but doesn't wait for anything queued later. Row callbacks run
+ * on the calling thread.
+ */
+bool RawDatabase::execRead(const QVector<Query>& statements, bool& success)
+{
+    {
+        PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+        const uint64_t waitFor = queuedTransactions;
+        while (processedTransactions < waitFor)
+            transactionsProcessed.wait(&transactionsMutex);
     }
 
-    QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+    ReadConnection& connection = readConnections[nextReadConnection++ % READ_CONNECTIONS];
+    QMutexLocker locker{&connection.mutex};
+    if (connection.sqlite == nullptr)
+        return false;
+
+    std::atomic_bool readSuccess{false};
+    Transaction trans;
+    trans.queries = statements;
+    trans.success = &readSuccess;
+    executeTransaction(connection.sqlite, trans, false, false);
+    success = readSuccess.load(std::memory_order_acquire);
+    return true;
+}
+
+/**
+ * @brief Checks if a transaction can run on a read only connection.
+ * @param statements Queries of the transaction.
+ * @return True if all queries are plain SELECTs.
+ */
+bool RawDatabase::isReadOnly(const QVector<Query>& statements)
+{
+    return std::all_of(statements.begin(), statements.end(), [](const Query& query) {
+        return !query.insertCallback && isCacheable(query.query)
+               && query.query.trimmed().left(6).toUpper() == "SELECT";
+    });
 }
 
 /**
@@ -484,6 +739,17 @@ void RawDatabase::sync()
     QMetaObject::invokeMethod(this, "process", Qt::BlockingQueuedConnection);
 }
 
+/**
+ * @brief Key the database is currently encrypted with.
+ * @return Hex encoded key, empty if the database isn't encrypted.
+ *
+ * @note The key is secret, callers may only store it encrypted.
+ */
+QString RawDatabase::getHexKey() const
+{
+    return currentHexKey;
+}
+
 /**
  * @brief Changes the database password, encrypting or decrypting if necessary.
  * @param password If password is empty, the database will be decrypted.
@@ -507,6 +773,7 @@ bool RawDatabase::setPassword(const QString& password)
     // If we need to decrypt or encrypt, we'll need to sync and close,
     // so we always process the pending queue before rekeying for consistency
     process();
+    clearStatementCache();
 
     if (QFile::exists(path + ".tmp")) {
         qWarning() << "Found old temporary export file while rekeying, deleting it";
@@ -521,6 +788,14 @@ bool RawDatabase::setPassword(const QString& password)
                 close();
                 return false;
             }
+
+            // reopen, the read connections still use the old key
+            close();
+            currentHexKey = newHexKey;
+            if (!open(path, currentHexKey)) {
+                qCritical() << "Failed to reopen the database with the new key";
+                return false;
+            }
         } else {
             if (!encryptDatabase(newHexKey)) {
                 close();
@@ -551,7 +826,9 @@ bool RawDatabase::encryptDatabase(const QString& newHexKey)
         qWarning() << "Failed to export encrypted database";
         return false;
     }
-    if (!setCipherParameters(SqlCipherParams::p4_0, "encrypted")) {
+    const auto params = cipherTier == SqlCipherTier::Performance ? SqlCipherParams::p4_0Performance
+                                                                 : SqlCipherParams::p4_0;
+    if (!setCipherParameters(params, "encrypted")) {
         return false;
     }
     if (!execNow("SELECT sqlcipher_export('encrypted');")) {
@@ -624,6 +901,7 @@ bool RawDatabase::rename(const QString& newPath)
     }
 
     process();
+    clearStatementCache();
 
     if (path == newPath)
         return true;
@@ -731,6 +1009,9 @@ QString RawDatabase::deriveKey(const QString& password, const QByteArray& salt)
  * @brief Implements the actual processing of pending transactions.
  * Unqueues, compiles, binds and executes queries, then notifies of results
  *
+ * execLater transactions queued back to back are committed together in one transaction, so a
+ * burst of writes costs a single sync instead of one per transaction.
+ *
  * @warning MUST only be called from the worker thread
  */
 void RawDatabase::process()
@@ -742,131 +1023,546 @@ void RawDatabase::process()
 
     forever
     {
-        // Fetch the next transaction
-        Transaction trans;
+        // Fetch the next transaction, and everything that can be committed together with it
+        QVector<Transaction> batch;
         {
-            QMutexLocker locker{&transactionsMutex};
+            PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
             if (pendingTransactions.isEmpty())
-                return;
-            trans = pendingTransactions.dequeue();
+                break;
+            batch += pendingTransactions.dequeue();
+            while (isGroupCommittable(batch.first()) && !pendingTransactions.isEmpty()
+                   && isGroupCommittable(pendingTransactions.head()))
+                batch += pendingTransactions.dequeue();
         }
 
-        // In case we exit early, prepare to signal errors
-        if (trans.success != nullptr)
-            trans.success->store(false, std::memory_order_release);
+        const qint64 startNs = queueClock.nsecsElapsed();
+        if (batch.size() == 1) {
+            executeTransaction(sqlite, batch.first(), false, true);
+        } else {
+            executeBatch(batch);
+        }
 
-        // Add transaction commands if necessary
-        if (trans.queries.size() > 1) {
-            trans.queries.prepend({"BEGIN;"});
-            trans.queries.append({"COMMIT;"});
+        const qint64 endNs = queueClock.nsecsElapsed();
+        commitDuration.add((endNs - startNs) / 1000000.0);
+        for (const Transaction& trans : batch) {
+            transactionLatency.add((endNs - trans.queuedNs) / 1000000.0);
         }
 
-        // Compile queries
-        for (Query& query : trans.queries) {
-            assert(query.statements.isEmpty());
-            // sqlite3_prepare_v2 only compiles one statement at a time in the query,
-            // we need to loop over them all
-            int curParam = 0;
-            const char* compileTail = query.query.data();
-            do {
-                // Compile the next statement
-                sqlite3_stmt* stmt;
-                int r;
-                if ((r = sqlite3_prepare_v2(sqlite, compileTail,
-                                            query.query.size()
-                                                - static_cast<int>(compileTail - query.query.data()),
-                                            &stmt, &compileTail))
-                    != SQLITE_OK) {
-                    qWarning() << "Failed to prepare statement" << anonymizeQuery(query.query)
-                               << "and returned" << r;
-                    qWarning("The full error is %d: %s", sqlite3_errcode(sqlite), sqlite3_errmsg(sqlite));
-                    goto cleanupStatements;
-                }
-                query.statements += stmt;
+        {
+            PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+            processedTransactions += static_cast<uint64_t>(batch.size());
+        }
+        transactionsProcessed.wakeAll();
+    }
 
-                // Now we can bind our params to this statement
-                int nParams = sqlite3_bind_parameter_count(stmt);
-                if (query.blobs.size() < curParam + nParams) {
-                    qWarning() << "Not enough parameters to bind to query "
-                               << anonymizeQuery(query.query);
-                    goto cleanupStatements;
-                }
-                for (int i = 0; i < nParams; ++i) {
-                    const QByteArray& blob = query.blobs[curParam + i];
+    if (!checkpointTimer.isActive())
+        checkpointTimer.start();
+}
+
+/**
+ * @brief Queues a transaction for the worker thread.
+ * @note transactionsMutex must be locked.
+ */
+void RawDatabase::enqueueLocked(Transaction& trans)
+{
+    trans.queuedNs = queueClock.nsecsElapsed();
+    pendingTransactions.enqueue(trans);
+    ++queuedTransactions;
+}
+
+/**
+ * @brief Queue depth and latencies for the "database" section of the diagnostics report.
+ * @note Thread safe.
+ */
+QJsonObject RawDatabase::collectDiagnostics() const
+{
+    QJsonObject json{{"transactionLatency", transactionLatency.toJson()},
+                     {"commitDuration", commitDuration.toJson()}};
+
+    PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+    json["pendingTransactions"] = pendingTransactions.size();
+    json["queuedTransactions"] = static_cast<qint64>(queuedTransactions);
+    json["processedTransactions"] = static_cast<qint64>(processedTransactions);
+    return json;
+}
+
+/**
+ * @brief Executes execLater transactions in one group commit transaction.
+ * @param batch Transactions in queue order.
+ */
+void RawDatabase::executeBatch(QVector<Transaction>& batch)
+{
+    TRACE_SCOPE("RawDatabase::executeBatch");
+    Transaction begin;
+    begin.queries += Query{"BEGIN;"};
+    const bool grouped = executeTransaction(sqlite, begin, false, true);
+    for (Transaction& trans : batch)
+        executeTransaction(sqlite, trans, grouped, true);
+
+    if (grouped) {
+        Transaction commit;
+        commit.queries += Query{"COMMIT;"};
+        if (!executeTransaction(sqlite, commit, false, true))
+            qWarning() << "Failed to commit a group of" << batch.size() << "transactions";
+    }
+}
+
+/**
+ * @brief Compiles, binds and executes the queries of one transaction and notifies of the result.
+ * @param db Connection to execute trans on.
+ * @param trans Transaction to execute.
+ * @param grouped True if trans runs inside a group commit transaction.
+ * @param useStatementCache True for the writer connection, which owns the statement cache.
+ * @return True if all queries succeeded, otherwise the transaction is rolled back.
+ *
+ * @warning MUST only be called from the worker thread
+ */
+bool RawDatabase::executeTransaction(sqlite3* db, Transaction& trans, bool grouped,
+                                     bool useStatementCache)
+{
+    TRACE_SCOPE("RawDatabase::executeTransaction");
+    // In case we exit early, prepare to signal errors
+    if (trans.success != nullptr)
+        trans.success->store(false, std::memory_order_release);
+
+    // Add transaction commands if necessary, inside a group commit every transaction gets a
+    // savepoint so it still succeeds or fails on its own
+    if (grouped) {
+        trans.queries.prepend({"SAVEPOINT group_commit;"});
+        trans.queries.append({"RELEASE group_commit;"});
+    } else if (trans.queries.size() > 1) {
+        trans.queries.prepend({"BEGIN;"});
+        trans.queries.append({"COMMIT;"});
+    }
+
+    // Compile queries
+    bool succeeded = false;
+    bool invalidatesCache = false;
+    for (Query& query : trans.queries) {
+        assert(query.statements.isEmpty());
+        const bool cacheable = isCacheable(query.query);
+        if (!cacheable) {
+            invalidatesCache = true;
+        } else if (useStatementCache && takeCachedStatements(query)) {
+            query.reusable = true;
+        }
+
+        // sqlite3_prepare_v2 only compiles one statement at a time in the query,
+        // we need to loop over them all
+        const char* compileTail = query.query.data();
+        while (!query.reusable && compileTail != query.query.data() + query.query.size()) {
+            // Compile the next statement
+            sqlite3_stmt* stmt;
+            int r;
+            if ((r = sqlite3_prepare_v2(db, compileTail,
+                                        query.query.size()
+                                            - static_cast<int>(compileTail - query.query.data()),
+                                        &stmt, &compileTail))
+                != SQLITE_OK) {
+                qWarning() << "Failed to prepare statement" << anonymizeQuery(query.query)
+                           << "and returned" << r;
+                qWarning("The full error is %d: %s", sqlite3_errcode(db), sqlite3_errmsg(db));
+                goto cleanupStatements;
+            }
+            query.statements += stmt;
+        }
+        query.reusable = useStatementCache && cacheable && !invalidatesCache;
+
+        // Now we can bind our params to the statements
+        int curParam = 0;
+        for (sqlite3_stmt* stmt : query.statements) {
+            int nParams = sqlite3_bind_parameter_count(stmt);
+            if (query.blobs.size() < curParam + nParams) {
+                qWarning() << "Not enough parameters to bind to query "
+                           << anonymizeQuery(query.query);
+                goto cleanupStatements;
+            }
+            for (int i = 0; i < nParams; ++i) {
+                const QByteArray& blob = query.blobs[curParam + i];
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
-                    // SQLITE_STATIC uses old-style cast and 0 as null pointer butcomes from system headers, so can't
-                    // be fixed by us
-                    auto sqliteDataType = SQLITE_STATIC;
+                // SQLITE_STATIC uses old-style cast and 0 as null pointer butcomes from system headers, so can't
+                // be fixed by us
+                auto sqliteDataType = SQLITE_STATIC;
 #pragma GCC diagnostic pop
-                    if (sqlite3_bind_blob(stmt, i + 1, blob.data(), blob.size(), sqliteDataType)
-                        != SQLITE_OK) {
-                        qWarning() << "Failed to bind param" << curParam + i << "to query"
-                                   << anonymizeQuery(query.query);
-                        goto cleanupStatements;
-                    }
-                }
-                curParam += nParams;
-            } while (compileTail != query.query.data() + query.query.size());
-
-
-            // Execute each statement of each query of our transaction
-            for (sqlite3_stmt* stmt : query.statements) {
-                int column_count = sqlite3_column_count(stmt);
-                int result;
-                do {
-                    result = sqlite3_step(stmt);
-
-                    // Execute our row callback
-                    if (result == SQLITE_ROW && query.rowCallback) {
-                        QVector<QVariant> row;
-                        for (int i = 0; i < column_count; ++i)
-                            row += extractData(stmt, i);
-
-                        query.rowCallback(row);
-                    }
-                } while (result == SQLITE_ROW);
-
-                if (result == SQLITE_DONE)
-                    continue;
-
-                QString anonQuery = anonymizeQuery(query.query);
-                switch (result) {
-                case SQLITE_ERROR:
-                    qWarning() << "Error executing query" << anonQuery;
-                    goto cleanupStatements;
-                case SQLITE_MISUSE:
-                    qWarning() << "Misuse executing query" << anonQuery;
-                    goto cleanupStatements;
-                case SQLITE_CONSTRAINT:
-                    qWarning() << "Constraint error executing query" << anonQuery;
-                    goto cleanupStatements;
-                default:
-                    qWarning() << "Unknown error" << result << "executing query" << anonQuery;
+                if (sqlite3_bind_blob(stmt, i + 1, blob.data(), blob.size(), sqliteDataType)
+                    != SQLITE_OK) {
+                    qWarning() << "Failed to bind param" << curParam + i << "to query"
+                               << anonymizeQuery(query.query);
                     goto cleanupStatements;
                 }
             }
+            curParam += nParams;
+        }
 
-            if (query.insertCallback)
-                query.insertCallback(RowId{sqlite3_last_insert_rowid(sqlite)});
+        // Execute each statement of each query of our transaction
+        for (sqlite3_stmt* stmt : query.statements) {
+            int column_count = sqlite3_column_count(stmt);
+            int result;
+            do {
+                result = sqlite3_step(stmt);
+
+                // Execute our row callback
+                if (result == SQLITE_ROW && query.typedRowCallback) {
+                    query.typedRowCallback(Row{stmt});
+                } else if (result == SQLITE_ROW && query.rowCallback) {
+                    QVector<QVariant> row;
+                    for (int i = 0; i < column_count; ++i)
+                        row += extractData(stmt, i);
+
+                    query.rowCallback(row);
+                }
+            } while (result == SQLITE_ROW);
+
+            if (result == SQLITE_DONE)
+                continue;
+
+            QString anonQuery = anonymizeQuery(query.query);
+            switch (result) {
+            case SQLITE_ERROR:
+                qWarning() << "Error executing query" << anonQuery;
+                goto cleanupStatements;
+            case SQLITE_MISUSE:
+                qWarning() << "Misuse executing query" << anonQuery;
+                goto cleanupStatements;
+            case SQLITE_CONSTRAINT:
+                qWarning() << "Constraint error executing query" << anonQuery;
+                goto cleanupStatements;
+            default:
+                qWarning() << "Unknown error" << result << "executing query" << anonQuery;
+                goto cleanupStatements;
+            }
         }
 
-        if (trans.success != nullptr)
-            trans.success->store(true, std::memory_order_release);
+        if (query.insertCallback)
+            query.insertCallback(RowId{sqlite3_last_insert_rowid(db)});
+    }
+
+    succeeded = true;
+    if (trans.success != nullptr)
+        trans.success->store(true, std::memory_order_release);
 
-    // Free our statements
-    cleanupStatements:
-        for (Query& query : trans.queries) {
+// Free our statements
+cleanupStatements:
+    for (Query& query : trans.queries) {
+        if (query.reusable) {
+            cacheStatements(query);
+        } else {
             for (sqlite3_stmt* stmt : query.statements)
                 sqlite3_finalize(stmt);
-            query.statements.clear();
         }
+        query.statements.clear();
+    }
+
+    // Schema changes, rekeying and attached databases make cached plans stale
+    if (useStatementCache && invalidatesCache)
+        clearStatementCache();
+
+    // Don't leave a failed transaction open, later ones would silently become part of it
+    if (!succeeded) {
+        if (grouped) {
+            sqlite3_exec(db, "ROLLBACK TO group_commit; RELEASE group_commit;", nullptr,
+                         nullptr, nullptr);
+        } else if (!sqlite3_get_autocommit(db)) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+    }
+
+    // Signal transaction results
+    if (trans.done != nullptr)
+        trans.done->store(true, std::memory_order_release);
+
+    return succeeded;
+}
+
+/**
+ * @brief Checks if a transaction may be committed together with others.
+ * @param trans Transaction to check.
+ * @return True for execLater transactions of plain statements.
+ *
+ * Nobody waits for the result of these, and none of them has to run outside of a transaction.
+ */
+bool RawDatabase::isGroupCommittable(const Transaction& trans)
+{
+    if (trans.success != nullptr || trans.done != nullptr)
+        return false;
+
+    return std::all_of(trans.queries.begin(), trans.queries.end(),
+                       [](const Query& query) { return isCacheable(query.query); });
+}
+
+/**
+ * @brief Starts the group commit window, unless it is already running.
+ */
+void RawDatabase::scheduleProcess()
+{
+    if (!groupCommitTimer.isActive())
+        groupCommitTimer.start();
+}
+
+/**
+ * @brief Copies the write-ahead log back into the database without blocking.
+ *
+ * Runs after the worker thread went idle for a moment, instead of inside whichever commit
+ * crosses the automatic checkpoint threshold.
+ */
+void RawDatabase::checkpoint()
+{
+    if (!sqlite)
+        return;
+
+    int logFrames = 0;
+    int checkpointedFrames = 0;
+    const int r = sqlite3_wal_checkpoint_v2(sqlite, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logFrames,
+                                            &checkpointedFrames);
+    if (r != SQLITE_OK) {
+        qWarning() << "Failed to checkpoint the write-ahead log:" << sqlite3_errmsg(sqlite);
+    }
+}
+
+/**
+ * @brief Runs database maintenance for at most about budgetMs, continuing where it stopped.
+ * @param budgetMs Time to spend, a step that was started is always finished.
+ *
+ * A round refreshes the query planner statistics, returns free pages to the file system and
+ * truncates the write-ahead log. Rounds run at most every MAINTENANCE_ROUND_INTERVAL_MS, and
+ * maintenance yields to transactions that are already waiting. Meant to be called repeatedly
+ * while the user is idle, see DbMaintenanceScheduler.
+ *
+ * A database created before auto_vacuum was enabled is converted once with a full VACUUM when a
+ * quarter of its pages are free, that step can't be split.
+ */
+void RawDatabase::maintain(qint64 budgetMs)
+{
+    if (QThread::currentThread() != workerThread.get()) {
+        QMetaObject::invokeMethod(this, "maintain", Qt::QueuedConnection, Q_ARG(qint64, budgetMs));
+        return;
+    }
+
+    if (!sqlite) {
+        return;
+    }
+
+    if (lastMaintenanceRound.isValid()
+        && !lastMaintenanceRound.hasExpired(MAINTENANCE_ROUND_INTERVAL_MS)) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (maintenanceStep != MaintenanceStep::Done && timer.elapsed() < budgetMs) {
+        {
+            PROFILED_MUTEX_LOCKER(locker, &transactionsMutex, "RawDatabase::transactionsMutex");
+            if (!pendingTransactions.isEmpty()) {
+                break;
+            }
+        }
+
+        if (!runMaintenanceStep()) {
+            qWarning() << "Database maintenance failed:" << sqlite3_errmsg(sqlite);
+            maintenanceStep = MaintenanceStep::Done;
+        }
+    }
+
+    if (maintenanceStep != MaintenanceStep::Done) {
+        qDebug() << "Database maintenance paused after" << timer.elapsed() << "ms";
+        return;
+    }
+
+    qDebug() << "Database maintenance finished, freed" << maintenanceFreedPages << "pages, last slice took"
+             << timer.elapsed() << "ms";
+    maintenanceStep = MaintenanceStep::Analyze;
+    maintenanceFreedPages = 0;
+    lastMaintenanceRound.start();
+}
 
-        // Signal transaction results
-        if (trans.done != nullptr)
-            trans.done->store(true, std::memory_order_release);
+/**
+ * @brief Lets the next maintain() call start a round even if the last one was recent.
+ *
+ * Used after deleting a lot of rows, so the freed pages are returned the next time the user is
+ * idle instead of after MAINTENANCE_ROUND_INTERVAL_MS.
+ */
+void RawDatabase::requestMaintenance()
+{
+    if (QThread::currentThread() != workerThread.get()) {
+        QMetaObject::invokeMethod(this, "requestMaintenance", Qt::QueuedConnection);
+        return;
     }
+
+    lastMaintenanceRound.invalidate();
+}
+
+/**
+ * @brief Runs the current maintenance step, or a slice of it, and advances to the next one.
+ * @return False on error.
+ */
+bool RawDatabase::runMaintenanceStep()
+{
+    switch (maintenanceStep) {
+    case MaintenanceStep::Analyze: {
+        maintenanceStep = MaintenanceStep::IncrementalVacuum;
+        const int64_t hasStatistics =
+            pragmaValue("SELECT COUNT(*) FROM sqlite_master WHERE name = 'sqlite_stat1';");
+        if (hasStatistics > 0) {
+            return execMaintenanceQuery(QStringLiteral("PRAGMA optimize;"));
+        }
+        // first run, analysis_limit keeps this quick on large tables
+        return execMaintenanceQuery(QStringLiteral("PRAGMA analysis_limit = 1000; ANALYZE;"));
+    }
+    case MaintenanceStep::IncrementalVacuum: {
+        const int64_t freePages = pragmaValue("PRAGMA freelist_count;");
+        if (freePages <= 0) {
+            maintenanceStep = MaintenanceStep::Checkpoint;
+            return freePages == 0;
+        }
+
+        constexpr int64_t autoVacuumIncremental = 2;
+        bool success;
+        if (pragmaValue("PRAGMA auto_vacuum;") == autoVacuumIncremental) {
+            success = execMaintenanceQuery(
+                QStringLiteral("PRAGMA incremental_vacuum(%1);").arg(VACUUM_SLICE_PAGES));
+        } else if (freePages * 4 > pragmaValue("PRAGMA page_count;")) {
+            qDebug() << "Enabling incremental vacuum, the database has" << freePages << "free pages";
+            clearStatementCache();
+            success = execMaintenanceQuery(
+                QStringLiteral("PRAGMA auto_vacuum = INCREMENTAL; VACUUM;"));
+        } else {
+            maintenanceStep = MaintenanceStep::Checkpoint;
+            return true;
+        }
+
+        const int64_t freePagesAfter = pragmaValue("PRAGMA freelist_count;");
+        if (freePagesAfter >= freePages) {
+            maintenanceStep = MaintenanceStep::Checkpoint;
+        }
+        maintenanceFreedPages += std::max<int64_t>(0, freePages - freePagesAfter);
+        return success;
+    }
+    case MaintenanceStep::Checkpoint: {
+        maintenanceStep = MaintenanceStep::Done;
+        const int r = sqlite3_wal_checkpoint_v2(sqlite, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                                nullptr, nullptr);
+        // readers may keep the log busy, the next round will try again
+        return r == SQLITE_OK || r == SQLITE_BUSY;
+    }
+    case MaintenanceStep::Done:
+        break;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a single integer, e.g. the value of a PRAGMA, on the worker thread.
+ * @param pragma Query returning one integer.
+ * @return The value, -1 on error.
+ */
+int64_t RawDatabase::pragmaValue(const char* pragma)
+{
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(sqlite, pragma, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+
+    int64_t value = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+bool RawDatabase::execMaintenanceQuery(const QString& query)
+{
+    return sqlite3_exec(sqlite, query.toUtf8().constData(), nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+/**
+ * @brief Moves the cached statements of a query into it.
+ * @param query Query to execute, its statements must be empty.
+ * @return False if the query isn't cached, it has to be compiled then.
+ *
+ * The entry leaves the cache while in use, so the same query appearing twice in a transaction
+ * gets its own statements.
+ */
+bool RawDatabase::takeCachedStatements(Query& query)
+{
+    auto it = statementCacheIndex.find(query.query);
+    if (it == statementCacheIndex.end())
+        return false;
+
+    query.statements = it.value()->statements;
+    statementCache.erase(it.value());
+    statementCacheIndex.erase(it);
+    return true;
+}
+
+/**
+ * @brief Resets the statements of an executed query and keeps them for the next execution.
+ * @param query Executed query, gives up ownership of its statements.
+ *
+ * Evicts the least recently used entry if the cache is full.
+ */
+void RawDatabase::cacheStatements(Query& query)
+{
+    for (sqlite3_stmt* stmt : query.statements) {
+        sqlite3_reset(stmt);
+        // bound blobs point into the query we are about to destroy
+        sqlite3_clear_bindings(stmt);
+    }
+
+    if (statementCacheIndex.contains(query.query)) {
+        for (sqlite3_stmt* stmt : query.statements)
+            sqlite3_finalize(stmt);
+        return;
+    }
+
+    statementCache.push_front({query.query, query.statements});
+    statementCacheIndex.insert(query.query, statementCache.begin());
+
+    if (statementCache.size() > STATEMENT_CACHE_SIZE) {
+        const CachedStatements& oldest = statementCache.back();
+        for (sqlite3_stmt* stmt : oldest.statements)
+            sqlite3_finalize(stmt);
+        statementCacheIndex.remove(oldest.query);
+        statementCache.pop_back();
+    }
+}
+
+/**
+ * @brief Finalizes all cached statements.
+ * @warning MUST only be called from the worker thread
+ */
+void RawDatabase::clearStatementCache()
+{
+    assert(QThread::currentThread() == workerThread.get());
+
+    for (const CachedStatements& entry : statementCache) {
+        for (sqlite3_stmt* stmt : entry.statements)
+            sqlite3_finalize(stmt);
+    }
+    statementCache.clear();
+    statementCacheIndex.clear();
+}
+
+/**
+ * @brief Checks if the statements of a query may be kept for reuse.
+ * @param query UTF-8 query string.
+ * @return False for queries changing the schema, cipher or attached databases.
+ *
+ * These also invalidate the whole cache after they ran, and must not stay in memory with a key
+ * in their text.
+ */
+bool RawDatabase::isCacheable(const QByteArray& query)
+{
+    static const char* const uncacheable[] = {"PRAGMA", "ATTACH", "DETACH", "CREATE", "DROP",
+                                              "ALTER", "VACUUM", "SQLCIPHER_EXPORT"};
+    const QByteArray upper = query.toUpper();
+    for (const char* keyword : uncacheable) {
+        if (upper.contains(keyword))
+            return false;
+    }
+    return true;
 }
 
 /**
@@ -934,14 +1630,29 @@ void RawDatabase::regexpSensitive(sqlite3_context* ctx, int argc, sqlite3_value*
 void RawDatabase::regexp(sqlite3_context* ctx, int argc, sqlite3_value** argv, const QRegularExpression::PatternOptions cs)
 {
     std::ignore = argc;
-    QRegularExpression regex;
-    const QString str1 = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argv[0])));
-    const QString str2 = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argv[1])));
 
-    regex.setPattern(str1);
-    regex.setPatternOptions(cs);
+    // The pattern is the same for every row of a search, keep the compiled regex as auxiliary
+    // data of the argument for as long as SQLite considers it constant
+    auto* regex = static_cast<QRegularExpression*>(sqlite3_get_auxdata(ctx, 0));
+    if (!regex) {
+        const QString pattern = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argv[0])));
+        regex = new QRegularExpression(pattern, cs);
+        regex->optimize();
+        sqlite3_set_auxdata(ctx, 0, regex, [](void* data) {
+            delete static_cast<QRegularExpression*>(data);
+        });
+        // SQLite may already have destroyed it if it couldn't store it
+        regex = static_cast<QRegularExpression*>(sqlite3_get_auxdata(ctx, 0));
+    }
 
-    const bool b = str2.contains(regex);
+    const QString str2 = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argv[1])));
+    bool b;
+    if (regex) {
+        b = str2.contains(*regex);
+    } else {
+        const QString pattern = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_value_text(argv[0])));
+        b = str2.contains(QRegularExpression(pattern, cs));
+    }
 
     if (b) {
         sqlite3_result_int(ctx, 1);
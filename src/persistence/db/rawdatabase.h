@@ -19,21 +19,30 @@
 
 #pragma once
 
+#include "src/core/latencyhistogram.h"
+#include "util/diagnosticsregistry.h"
 #include "util/strongtype.h"
 
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
 #include <QMutex>
 #include <QPair>
 #include <QQueue>
 #include <QString>
 #include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
 #include <QVariant>
 #include <QVector>
 #include <QRegularExpression>
 
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <functional>
+#include <list>
 #include <memory>
 
 /// The two following defines are required to use SQLCipher
@@ -54,6 +63,50 @@ class RawDatabase : QObject
     Q_OBJECT
 
 public:
+    class Row
+    {
+    public:
+        explicit Row(sqlite3_stmt* stmt_)
+            : stmt{stmt_}
+        {
+        }
+
+        int size() const
+        {
+            return sqlite3_column_count(stmt);
+        }
+
+        bool isNull(int col) const
+        {
+            return sqlite3_column_type(stmt, col) == SQLITE_NULL;
+        }
+
+        template <typename T>
+        T get(int col) const;
+
+        QByteArray getRawBlob(int col) const;
+
+        template <typename... Columns>
+        void read(int firstCol, Columns&... columns) const
+        {
+            readFrom(firstCol, columns...);
+        }
+
+    private:
+        void readFrom(int) const
+        {
+        }
+
+        template <typename T, typename... Rest>
+        void readFrom(int col, T& column, Rest&... rest) const
+        {
+            column = get<T>(col);
+            readFrom(col + 1, rest...);
+        }
+
+        sqlite3_stmt* stmt;
+    };
+
     class Query
     {
     public:
@@ -81,6 +134,18 @@ public:
             , rowCallback{rowCallback_}
         {
         }
+        Query(QString query_, const std::function<void(const Row&)>& typedRowCallback_)
+            : query{query_.toUtf8()}
+            , typedRowCallback{typedRowCallback_}
+        {
+        }
+        Query(QString query_, QVector<QByteArray> blobs_,
+            const std::function<void(const Row&)>& typedRowCallback_)
+            : query{query_.toUtf8()}
+            , blobs{blobs_}
+            , typedRowCallback{typedRowCallback_}
+        {
+        }
         Query() = default;
 
     private:
@@ -88,7 +153,9 @@ public:
         QVector<QByteArray> blobs;
         std::function<void(RowId)> insertCallback;
         std::function<void(const QVector<QVariant>&)> rowCallback;
+        std::function<void(const Row&)> typedRowCallback;
         QVector<sqlite3_stmt*> statements;
+        bool reusable = false;
 
         friend class RawDatabase;
     };
@@ -101,12 +168,21 @@ public:
         // We accidentally got to this state when attemption to update all databases to 4.0 defaults even when using
         // SQLCipher 3.x, but might as well keep using these for people with SQLCipher 3.x.
         halfUpgradedTo4,
-        p4_0 // SQLCipher 4.0 default encryption params
+        p4_0, // SQLCipher 4.0 default encryption params
+        // SQLCipher 4.0 params with larger pages and without wiping memory, opted into per profile
+        p4_0Performance
     };
 
-    RawDatabase(const QString& path_, const QString& password, const QByteArray& salt);
+    enum class SqlCipherTier {
+        Default, // highest supported default params
+        Performance // p4_0Performance where SQLCipher 4.x is available
+    };
+
+    RawDatabase(const QString& path_, const QString& password, const QByteArray& salt,
+                const QString& hexKey = {}, SqlCipherTier cipherTier_ = SqlCipherTier::Default);
     ~RawDatabase();
     bool isOpen();
+    QString getHexKey() const;
 
     bool execNow(const QString& statement);
     bool execNow(const Query& statement);
@@ -128,6 +204,8 @@ public:
             return "3.x max compatible";
         case SqlCipherParams::p4_0:
             return "4.0 default";
+        case SqlCipherParams::p4_0Performance:
+            return "4.0 performance";
         }
         assert(false);
         return {};
@@ -137,17 +215,22 @@ public slots:
     bool setPassword(const QString& password);
     bool rename(const QString& newPath);
     bool remove();
+    void maintain(qint64 budgetMs);
+    void requestMaintenance();
 
 protected slots:
     bool open(const QString& path_, const QString& hexKey = {});
     void close();
     void process();
+    void scheduleProcess();
+    void checkpoint();
 
 private:
     QString anonymizeQuery(const QByteArray& query);
     bool openEncryptedDatabaseAtLatestSupportedVersion(const QString& hexKey);
     bool updateSavedCipherParameters(const QString& hexKey, SqlCipherParams newParams);
     bool setCipherParameters(SqlCipherParams params, const QString& database = {});
+    static QString cipherParametersQuery(SqlCipherParams params, const QString& database);
     SqlCipherParams highestSupportedParams();
     SqlCipherParams readSavedCipherParams(const QString& hexKey, SqlCipherParams newParams);
     bool setKey(const QString& hexKey);
@@ -156,6 +239,10 @@ private:
     bool decryptDatabase();
     bool commitDbSwap(const QString& hexKey);
     bool testUsable();
+    bool takeCachedStatements(Query& query);
+    void cacheStatements(Query& query);
+    void clearStatementCache();
+    static bool isCacheable(const QByteArray& query);
 
 protected:
     static QString deriveKey(const QString& password, const QByteArray& salt);
@@ -172,14 +259,109 @@ private:
         QVector<Query> queries;
         std::atomic_bool* success = nullptr;
         std::atomic_bool* done = nullptr;
+        qint64 queuedNs = 0;
+    };
+
+    struct CachedStatements
+    {
+        QByteArray query;
+        QVector<sqlite3_stmt*> statements;
+    };
+
+    static constexpr size_t STATEMENT_CACHE_SIZE = 64;
+    static constexpr int GROUP_COMMIT_WINDOW_MS = 5;
+    static constexpr int CHECKPOINT_DELAY_MS = 1000;
+    static constexpr size_t READ_CONNECTIONS = 2;
+    static constexpr int READ_BUSY_TIMEOUT_MS = 1000;
+    static constexpr qint64 MAINTENANCE_ROUND_INTERVAL_MS = 6 * 60 * 60 * 1000;
+    static constexpr int VACUUM_SLICE_PAGES = 256;
+
+    enum class MaintenanceStep
+    {
+        Analyze,
+        IncrementalVacuum,
+        Checkpoint,
+        Done
     };
 
+    struct ReadConnection
+    {
+        QMutex mutex;
+        sqlite3* sqlite = nullptr;
+    };
+
+    bool executeTransaction(sqlite3* db, Transaction& trans, bool grouped, bool useStatementCache);
+    void executeBatch(QVector<Transaction>& batch);
+    static bool isGroupCommittable(const Transaction& trans);
+    bool openReadConnections(const QString& path_, const QString& hexKey);
+    void closeReadConnections();
+    bool execRead(const QVector<Query>& statements, bool& success);
+    static bool isReadOnly(const QVector<Query>& statements);
+    bool runMaintenanceStep();
+    int64_t pragmaValue(const char* pragma);
+    bool execMaintenanceQuery(const QString& query);
+    void enqueueLocked(Transaction& trans);
+    QJsonObject collectDiagnostics() const;
+
 private:
     sqlite3* sqlite;
     std::unique_ptr<QThread> workerThread;
     QQueue<Transaction> pendingTransactions;
-    QMutex transactionsMutex;
+    mutable QMutex transactionsMutex;
     QString path;
     QByteArray currentSalt;
     QString currentHexKey;
+    SqlCipherParams currentCipherParams = SqlCipherParams::p4_0;
+    const SqlCipherTier cipherTier;
+    std::list<CachedStatements> statementCache;
+    QHash<QByteArray, std::list<CachedStatements>::iterator> statementCacheIndex;
+    QTimer groupCommitTimer;
+    QTimer checkpointTimer;
+    std::array<ReadConnection, READ_CONNECTIONS> readConnections;
+    std::atomic<size_t> nextReadConnection{0};
+    // both protected by transactionsMutex
+    uint64_t queuedTransactions = 0;
+    uint64_t processedTransactions = 0;
+    QWaitCondition transactionsProcessed;
+    QElapsedTimer queueClock;
+    LatencyHistogram transactionLatency;
+    LatencyHistogram commitDuration;
+    // only used on the worker thread
+    MaintenanceStep maintenanceStep = MaintenanceStep::Analyze;
+    QElapsedTimer lastMaintenanceRound;
+    int64_t maintenanceFreedPages = 0;
+    // last, so it unregisters before the stats it reads are destroyed
+    DiagnosticsSource diagnostics;
 };
+
+template <>
+inline int64_t RawDatabase::Row::get<int64_t>(int col) const
+{
+    return sqlite3_column_int64(stmt, col);
+}
+
+template <>
+inline RowId RawDatabase::Row::get<RowId>(int col) const
+{
+    return RowId{sqlite3_column_int64(stmt, col)};
+}
+
+template <>
+inline bool RawDatabase::Row::get<bool>(int col) const
+{
+    return sqlite3_column_int64(stmt, col) != 0;
+}
+
+template <>
+inline QString RawDatabase::Row::get<QString>(int col) const
+{
+    const char* str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+    return QString::fromUtf8(str, sqlite3_column_bytes(stmt, col));
+}
+
+template <>
+inline QByteArray RawDatabase::Row::get<QByteArray>(int col) const
+{
+    const char* data = reinterpret_cast<const char*>(sqlite3_column_blob(stmt, col));
+    return QByteArray(data, sqlite3_column_bytes(stmt, col));
+}
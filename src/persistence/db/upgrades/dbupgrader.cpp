@@ -20,6 +20,7 @@
 #include "dbupgrader.h"
 #include "src/core/chatid.h"
 #include "src/core/toxpk.h"
+#include "src/persistence/db/dbbackfill.h"
 #include "src/persistence/db/rawdatabase.h"
 #include "src/persistence/db/upgrades/dbto11.h"
 #include "src/widget/tool/imessageboxmanager.h"
@@ -29,7 +30,17 @@
 #include <QTranslator>
 
 namespace {
-constexpr int SCHEMA_VERSION = 15;
+constexpr int SCHEMA_VERSION = 24;
+
+bool isFts5Available(RawDatabase& db)
+{
+    bool available = false;
+    db.execNow(RawDatabase::Query("SELECT sqlite_compileoption_used('ENABLE_FTS5');",
+                                  [&](const QVector<QVariant>& row) {
+                                      available = row[0].toLongLong() != 0;
+                                  }));
+    return available;
+}
 
 std::vector<DbUpgrader::BadEntry> getInvalidPeers(RawDatabase& db)
 {
@@ -201,10 +212,17 @@ void addForeignKeyToBrokenMessages(QVector<RawDatabase::Query>& queries)
 
 /**
  * @brief Upgrade the db schema
+ * @param progress Called with the number of finished and total upgrade steps before and after
+ * every step, may be empty.
  * @note On future alterations of the database all you have to do is bump the SCHEMA_VERSION
  * variable and add another case to the switch statement below. Make sure to fall through on each case.
+ *
+ * Every step commits its own user_version, an interrupted upgrade continues with the step that
+ * didn't finish. Steps that would fill new tables from the whole history schedule a DbBackfill
+ * task instead, which runs after the profile opened.
  */
-bool DbUpgrader::dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxManager& messageBoxManager)
+bool DbUpgrader::dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxManager& messageBoxManager,
+                                 const std::function<void(int, int)>& progress)
 {
     // If we're a new dB we can just make a new one and call it a day
     bool success = false;
@@ -240,6 +258,51 @@ bool DbUpgrader::dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxMa
             return false;
         }
 
+        if (!dbSchema15to16(*db)) {
+            qCritical() << "Failed to create current db schema(5)";
+            return false;
+        }
+
+        if (!dbSchema16to17(*db)) {
+            qCritical() << "Failed to create current db schema(6)";
+            return false;
+        }
+
+        if (!dbSchema17to18(*db)) {
+            qCritical() << "Failed to create current db schema(7)";
+            return false;
+        }
+
+        if (!dbSchema18to19(*db)) {
+            qCritical() << "Failed to create current db schema(8)";
+            return false;
+        }
+
+        if (!dbSchema19to20(*db)) {
+            qCritical() << "Failed to create current db schema(9)";
+            return false;
+        }
+
+        if (!dbSchema20to21(*db)) {
+            qCritical() << "Failed to create current db schema(10)";
+            return false;
+        }
+
+        if (!dbSchema21to22(*db)) {
+            qCritical() << "Failed to create current db schema(11)";
+            return false;
+        }
+
+        if (!dbSchema22to23(*db)) {
+            qCritical() << "Failed to create current db schema(12)";
+            return false;
+        }
+
+        if (!dbSchema23to24(*db)) {
+            qCritical() << "Failed to create current db schema(13)";
+            return false;
+        }
+
         qDebug() << "Database created at schema version" << SCHEMA_VERSION;
         return true;
     }
@@ -275,12 +338,21 @@ bool DbUpgrader::dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxMa
                                                  dbSchema6to7, dbSchema7to8, dbSchema8to9,
                                                  dbSchema9to10, DbTo11::dbSchema10to11,
                                                  dbSchema11to12, dbSchema12to13,
-                                                 dbSchema13to14, dbSchema14to15};
+                                                 dbSchema13to14, dbSchema14to15,
+                                                 dbSchema15to16, dbSchema16to17,
+                                                 dbSchema17to18, dbSchema18to19,
+                                                 dbSchema19to20, dbSchema20to21,
+                                                 dbSchema21to22, dbSchema22to23,
+                                                 dbSchema23to24};
 
     assert(databaseSchemaVersion < static_cast<int>(upgradeFns.size()));
     assert(upgradeFns.size() == SCHEMA_VERSION);
 
+    const int steps = SCHEMA_VERSION - static_cast<int>(databaseSchemaVersion);
     for (int64_t i = databaseSchemaVersion; i < static_cast<int>(upgradeFns.size()); ++i) {
+        if (progress) {
+            progress(static_cast<int>(i - databaseSchemaVersion), steps);
+        }
         auto const newDbVersion = i + 1;
         if (!upgradeFns[i](*db)) {
             qCritical() << "Failed to upgrade db to schema version " << newDbVersion << " aborting";
@@ -288,6 +360,9 @@ bool DbUpgrader::dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxMa
         }
         qDebug() << "Database upgraded incrementally to schema version " << newDbVersion;
     }
+    if (progress) {
+        progress(steps, steps);
+    }
 
     qInfo() << "Database upgrade finished (databaseSchemaVersion" << databaseSchemaVersion << "->"
             << SCHEMA_VERSION << ")";
@@ -697,6 +772,260 @@ bool DbUpgrader::dbSchema14to15(RawDatabase& db)
     return db.execNow(upgradeQueries);
 }
 
+/**
+ * @brief Adds a full text index over text_messages.message for history search.
+ *
+ * The index is an external content FTS5 table, triggers keep it in sync with inserts, updates
+ * and deletes of text_messages. Existing messages are indexed by DbBackfill after the profile
+ * opened, the triggers skip the messages it hasn't reached yet. If SQLCipher was built without
+ * FTS5 only the version is bumped and searches keep scanning the table.
+ */
+bool DbUpgrader::dbSchema15to16(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    if (isFts5Available(db)) {
+        const auto task = DbBackfill::Task::FullTextIndex;
+        upgradeQueries += DbBackfill::schedule(task);
+        upgradeQueries += RawDatabase::Query{QString(
+            "CREATE VIRTUAL TABLE text_messages_fts USING fts5("
+            "message, content='text_messages', content_rowid='id');")};
+        upgradeQueries += RawDatabase::Query{QStringLiteral(
+            "CREATE TRIGGER text_messages_fts_insert AFTER INSERT ON text_messages WHEN %1 BEGIN "
+            "INSERT INTO text_messages_fts (rowid, message) VALUES (new.id, new.message); "
+            "END;").arg(DbBackfill::notPendingCondition(task, QStringLiteral("new.id")))};
+        upgradeQueries += RawDatabase::Query{QStringLiteral(
+            "CREATE TRIGGER text_messages_fts_delete AFTER DELETE ON text_messages WHEN %1 BEGIN "
+            "INSERT INTO text_messages_fts (text_messages_fts, rowid, message) "
+            "VALUES ('delete', old.id, old.message); "
+            "END;").arg(DbBackfill::notPendingCondition(task, QStringLiteral("old.id")))};
+        upgradeQueries += RawDatabase::Query{QStringLiteral(
+            "CREATE TRIGGER text_messages_fts_update AFTER UPDATE OF message ON text_messages "
+            "WHEN %1 BEGIN "
+            "INSERT INTO text_messages_fts (text_messages_fts, rowid, message) "
+            "VALUES ('delete', old.id, old.message); "
+            "INSERT INTO text_messages_fts (rowid, message) VALUES (new.id, new.message); "
+            "END;").arg(DbBackfill::notPendingCondition(task, QStringLiteral("old.id")))};
+    } else {
+        qWarning() << "SQLCipher lacks FTS5, history search will not be indexed";
+    }
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 16;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds per chat message counters, bucketed by UTC day.
+ *
+ * Triggers on history keep chat_day_counts in sync in the same transaction as the insert, delete
+ * or update of a message, so counting the messages of a chat no longer scans its history. The
+ * counters are filled from the existing history once. The chat_id, timestamp index bounds the
+ * remaining scan to a single day when counting up to a point in time.
+ */
+bool DbUpgrader::dbSchema16to17(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TABLE chat_day_counts (chat_id INTEGER NOT NULL, day INTEGER NOT NULL, "
+        "count INTEGER NOT NULL, PRIMARY KEY (chat_id, day)) WITHOUT ROWID;")};
+    upgradeQueries += DbBackfill::schedule(DbBackfill::Task::DayCounts);
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE INDEX chat_id_timestamp_idx ON history (chat_id, timestamp);")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TRIGGER chat_day_counts_insert AFTER INSERT ON history BEGIN "
+        "INSERT OR IGNORE INTO chat_day_counts (chat_id, day, count) "
+        "VALUES (new.chat_id, new.timestamp / 86400000, 0); "
+        "UPDATE chat_day_counts SET count = count + 1 "
+        "WHERE chat_id = new.chat_id AND day = new.timestamp / 86400000; "
+        "END;")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TRIGGER chat_day_counts_delete AFTER DELETE ON history BEGIN "
+        "UPDATE chat_day_counts SET count = count - 1 "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000; "
+        "DELETE FROM chat_day_counts "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000 AND count <= 0; "
+        "END;")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TRIGGER chat_day_counts_update AFTER UPDATE OF chat_id, timestamp ON history BEGIN "
+        "UPDATE chat_day_counts SET count = count - 1 "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000; "
+        "DELETE FROM chat_day_counts "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000 AND count <= 0; "
+        "INSERT OR IGNORE INTO chat_day_counts (chat_id, day, count) "
+        "VALUES (new.chat_id, new.timestamp / 86400000, 0); "
+        "UPDATE chat_day_counts SET count = count + 1 "
+        "WHERE chat_id = new.chat_id AND day = new.timestamp / 86400000; "
+        "END;")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 17;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Turns the per day message counters into an index for date navigation.
+ *
+ * chat_day_counts gets the id of the first message of each day, the triggers from 16to17 are
+ * replaced by ones maintaining it as well. When that first message is removed, the next one is
+ * looked up through the chat_id, timestamp index.
+ */
+bool DbUpgrader::dbSchema17to18(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "ALTER TABLE chat_day_counts ADD COLUMN first_id INTEGER NOT NULL DEFAULT 0;")};
+    // recounting also fills first_id
+    upgradeQueries += DbBackfill::schedule(DbBackfill::Task::DayCounts);
+    upgradeQueries += RawDatabase::Query{QString("DROP TRIGGER chat_day_counts_insert;")};
+    upgradeQueries += RawDatabase::Query{QString("DROP TRIGGER chat_day_counts_delete;")};
+    upgradeQueries += RawDatabase::Query{QString("DROP TRIGGER chat_day_counts_update;")};
+
+    const QString addNew = QStringLiteral(
+        "INSERT OR IGNORE INTO chat_day_counts (chat_id, day, count, first_id) "
+        "VALUES (new.chat_id, new.timestamp / 86400000, 0, new.id); "
+        "UPDATE chat_day_counts SET count = count + 1, first_id = MIN(first_id, new.id) "
+        "WHERE chat_id = new.chat_id AND day = new.timestamp / 86400000; ");
+    const QString removeOld = QStringLiteral(
+        "UPDATE chat_day_counts SET count = count - 1 "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000; "
+        "DELETE FROM chat_day_counts "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000 AND count <= 0; "
+        "UPDATE chat_day_counts SET first_id = ("
+        "SELECT MIN(id) FROM history WHERE history.chat_id = old.chat_id "
+        "AND timestamp >= day * 86400000 AND timestamp < (day + 1) * 86400000) "
+        "WHERE chat_id = old.chat_id AND day = old.timestamp / 86400000 AND first_id = old.id; ");
+
+    upgradeQueries += RawDatabase::Query{
+        QStringLiteral("CREATE TRIGGER chat_day_counts_insert AFTER INSERT ON history BEGIN ")
+        + addNew + QStringLiteral("END;")};
+    upgradeQueries += RawDatabase::Query{
+        QStringLiteral("CREATE TRIGGER chat_day_counts_delete AFTER DELETE ON history BEGIN ")
+        + removeOld + QStringLiteral("END;")};
+    upgradeQueries += RawDatabase::Query{
+        QStringLiteral("CREATE TRIGGER chat_day_counts_update "
+                       "AFTER UPDATE OF chat_id, timestamp ON history BEGIN ")
+        + removeOld + addNew + QStringLiteral("END;")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 18;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Indexes the group image messages.
+ *
+ * Group images used to be stored as hex in text_messages.ngc_msgid, History moves them to the
+ * BlobStore on load. The partial index only covers image messages, so finding the ones left to
+ * move doesn't scan all text messages on every start.
+ */
+bool DbUpgrader::dbSchema18to19(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    // messages are bound as blobs, '___' is the content of every group image message
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE INDEX text_messages_image_idx ON text_messages (id) "
+        "WHERE message = x'5F5F5F';")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 19;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds the index of NGC messages used to drop repeated history sync messages.
+ *
+ * Holds sender, hash and time of the public NGC messages, one row per message, so NgcSyncIndex
+ * can be seeded after a restart. Messages stored before this version aren't indexed, their
+ * hash includes the NGC message id, which sqlite can't compute.
+ */
+bool DbUpgrader::dbSchema19to20(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TABLE ngc_sync_index (chat_id INTEGER NOT NULL, sender_key BLOB NOT NULL, "
+        "message_hash BLOB NOT NULL, timestamp INTEGER NOT NULL, "
+        "PRIMARY KEY (chat_id, sender_key, message_hash), "
+        "FOREIGN KEY (chat_id) REFERENCES chats(id)) WITHOUT ROWID;")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE INDEX ngc_sync_index_timestamp_idx ON ngc_sync_index (timestamp);")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 20;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds the activity summary of every chat, so the friend list can be sorted without
+ * reading history. The last activity is filled from the existing history once, unread counters
+ * start at zero.
+ */
+bool DbUpgrader::dbSchema20to21(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TABLE chat_activity (chat_id INTEGER PRIMARY KEY, "
+        "last_activity INTEGER NOT NULL, unread_count INTEGER NOT NULL DEFAULT 0, "
+        "mentioned INTEGER NOT NULL DEFAULT 0);")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "INSERT INTO chat_activity (chat_id, last_activity) "
+        "SELECT chat_id, MAX(timestamp) FROM history GROUP BY chat_id;")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 21;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds the unfinished file transfers CoreFile resumes after a restart, see
+ * IFileResumeStore. Keyed by the tox file id, the friend isn't a chat row since a transfer can
+ * start before anything of the chat is logged.
+ */
+bool DbUpgrader::dbSchema21to22(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TABLE file_resume (file_id BLOB PRIMARY KEY, friend_key BLOB NOT NULL, "
+        "direction INTEGER NOT NULL, file_name BLOB NOT NULL, file_path BLOB NOT NULL, "
+        "file_size INTEGER NOT NULL, bytes_done INTEGER NOT NULL, "
+        "timestamp INTEGER NOT NULL) WITHOUT ROWID;")};
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE INDEX file_resume_friend_idx ON file_resume (friend_key);")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 22;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds the tombstones of chats whose history is still being deleted in the background,
+ * so History resumes the deletion after a restart.
+ */
+bool DbUpgrader::dbSchema22to23(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += RawDatabase::Query{QString(
+        "CREATE TABLE chat_deletions (chat_id INTEGER PRIMARY KEY, "
+        "FOREIGN KEY (chat_id) REFERENCES chats(id));")};
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 23;"));
+    return db.execNow(upgradeQueries);
+}
+
+/**
+ * @brief Adds the tasks of DbBackfill. Upgrades scheduling a task create the table as well, it
+ * only has to be created here for databases that were past those upgrades already.
+ */
+bool DbUpgrader::dbSchema23to24(RawDatabase& db)
+{
+    QVector<RawDatabase::Query> upgradeQueries;
+
+    upgradeQueries += DbBackfill::createTable();
+
+    upgradeQueries += RawDatabase::Query(QStringLiteral("PRAGMA user_version = 24;"));
+    return db.execNow(upgradeQueries);
+}
+
 void DbUpgrader::mergeDuplicatePeers(QVector<RawDatabase::Query>& upgradeQueries, RawDatabase& db,
                          std::vector<BadEntry> badPeers)
 {
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 
 #include "src/persistence/db/rawdatabase.h"
@@ -27,7 +28,8 @@ class RawDatabase;
 class IMessageBoxManager;
 namespace DbUpgrader
 {
-    bool dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxManager& messageBoxManager);
+    bool dbSchemaUpgrade(std::shared_ptr<RawDatabase>& db, IMessageBoxManager& messageBoxManager,
+                         const std::function<void(int, int)>& progress = {});
 
     bool createCurrentSchema(RawDatabase& db);
     bool isNewDb(std::shared_ptr<RawDatabase>& db, bool& success);
@@ -46,6 +48,15 @@ namespace DbUpgrader
     bool dbSchema12to13(RawDatabase& db);
     bool dbSchema13to14(RawDatabase& db);
     bool dbSchema14to15(RawDatabase& db);
+    bool dbSchema15to16(RawDatabase& db);
+    bool dbSchema16to17(RawDatabase& db);
+    bool dbSchema17to18(RawDatabase& db);
+    bool dbSchema18to19(RawDatabase& db);
+    bool dbSchema19to20(RawDatabase& db);
+    bool dbSchema20to21(RawDatabase& db);
+    bool dbSchema21to22(RawDatabase& db);
+    bool dbSchema22to23(RawDatabase& db);
+    bool dbSchema23to24(RawDatabase& db);
 
     struct BadEntry
     {
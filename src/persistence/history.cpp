@@ -20,15 +20,14 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QNetworkAccessManager>
-#if QT_VERSION >= QT_VERSION_CHECK( 5, 10, 0 )
-#include <QRandomGenerator>
-#endif
 #include <QUrlQuery>
 #include <QNetworkProxy>
 #include <QNetworkReply>
+#include <algorithm>
 #include <cassert>
 
 #include "history.h"
+#include "blobstore.h"
 #include "profile.h"
 #include "src/core/icoresettings.h"
 #include "settings.h"
@@ -36,12 +35,16 @@
 #include "db/rawdatabase.h"
 #include "src/core/toxpk.h"
 #include "src/core/chatid.h"
+#include "src/core/ngcsyncindex.h"
 
 // zoff
 #include <curl/curl.h>
 // zoff
 
 namespace {
+// history buckets messages by UTC day, the triggers on history compute the same in SQL
+constexpr qint64 MS_PER_DAY = 24 * 60 * 60 * 1000;
+
 MessageState getMessageState(bool isPending, bool isBroken)
 {
     assert(!(isPending && isBroken));
@@ -57,6 +60,20 @@ MessageState getMessageState(bool isPending, bool isBroken)
     return messageState;
 }
 
+/**
+ * @brief Reads a text column that may contain null bytes, QString::fromUtf8 truncates on null
+ * bytes so we strip them
+ */
+QString fromUtf8WithoutNulls(const RawDatabase::Row& row, int col)
+{
+    const QByteArray data = row.getRawBlob(col);
+    if (!data.contains('\0')) {
+        return QString::fromUtf8(data.constData(), data.size());
+    }
+
+    return QString::fromUtf8(QByteArray(data.constData(), data.size()).replace('\0', ""));
+}
+
 void addAuthorIdSubQuery(QString& queryString, QVector<QByteArray>& boundParams, const ToxPk& authorPk)
 {
     boundParams.append(authorPk.getByteArray());
@@ -69,6 +86,23 @@ void addChatIdSubQuery(QString& queryString, QVector<QByteArray>& boundParams, c
     queryString += "(SELECT id FROM chats WHERE uuid = ?)";
 }
 
+/**
+ * @brief Generate query to remember a public NGC message for NgcSyncIndex
+ */
+RawDatabase::Query generateNgcSyncIndexInsertion(const ChatId& chatId, const ToxPk& sender,
+                                                 const QDateTime& time, const QByteArray& msgId,
+                                                 const QString& text)
+{
+    QVector<QByteArray> boundParams;
+    QString queryString = QStringLiteral("INSERT OR IGNORE INTO ngc_sync_index "
+                                         "(chat_id, sender_key, message_hash, timestamp) VALUES (");
+    addChatIdSubQuery(queryString, boundParams, chatId);
+    queryString += QStringLiteral(", ?, ?, %1);").arg(time.toMSecsSinceEpoch());
+    boundParams += sender.getByteArray();
+    boundParams += NgcSyncIndex::messageHash(msgId, text);
+    return RawDatabase::Query(queryString, boundParams);
+}
+
 RawDatabase::Query generateEnsurePkInChats(ChatId const& id)
 {
     return RawDatabase::Query{QStringLiteral("INSERT OR IGNORE INTO chats (uuid) "
@@ -222,6 +256,14 @@ generateNewTextMessageQueries(const ChatId& chatId, const QString& message, cons
                 .arg(extensionSet.to_ulong())};
     }
 
+    if (hasIdType == 2 && !isPrivate) {
+        const QByteArray msgId = QByteArray::fromHex(message.section(':', 0, 0).toLatin1());
+        if (msgId.size() == NgcSyncIndex::MSG_ID_SIZE) {
+            queries += generateNgcSyncIndexInsertion(chatId, sender, time, msgId,
+                                                     message.section(':', 1));
+        }
+    }
+
     return queries;
 }
 
@@ -245,6 +287,16 @@ QVector<RawDatabase::Query> generateNewSystemMessageQueries(const ChatId& chatId
 
     return queries;
 }
+/**
+ * @brief Generate query to give chats a uuid no ChatId has, so they look gone to every reader
+ * @param condition Condition selecting the rows of chats.
+ */
+RawDatabase::Query generateDetachChats(const QString& condition)
+{
+    // ChatIds are 32 bytes long
+    return RawDatabase::Query{
+        QStringLiteral("UPDATE chats SET uuid = randomblob(16) WHERE %1;").arg(condition)};
+}
 } // namespace
 
 /**
@@ -254,8 +306,17 @@ QVector<RawDatabase::Query> generateNewSystemMessageQueries(const ChatId& chatId
  * @var QHash<QString, int64_t> History::peers
  * @brief Maps friend public keys to unique IDs by index.
  * Caches mappings to speed up message saving.
+ *
+ * Removed chats are detached from their ChatId right away and their messages are deleted in
+ * batches of CHAT_DELETION_BATCH_SIZE afterwards, see removeChatHistory(). The chats still
+ * being deleted are kept in the chat_deletions table, so the deletion continues after a
+ * restart.
  */
 
+constexpr int History::CHAT_DELETION_BATCH_SIZE;
+constexpr int History::CHAT_DELETION_INTERVAL_MS;
+constexpr int History::UNDELIVERED_CHAT_UUID_COLUMN;
+
 FileDbInsertionData::FileDbInsertionData()
 {
     static int id = qRegisterMetaType<FileDbInsertionData>();
@@ -266,7 +327,8 @@ FileDbInsertionData::FileDbInsertionData()
  * @brief Prepares the database to work with the history.
  * @param db This database will be prepared for use with the history.
  */
-History::History(std::shared_ptr<RawDatabase> db_, Settings& settings_, IMessageBoxManager& messageBoxManager)
+History::History(std::shared_ptr<RawDatabase> db_, Settings& settings_, IMessageBoxManager& messageBoxManager,
+                 const std::function<void(int, int)>& upgradeProgress)
     : db(db_)
     , settings(settings_)
 {
@@ -280,7 +342,7 @@ History::History(std::shared_ptr<RawDatabase> db_, Settings& settings_, IMessage
     db->execNow(
         "PRAGMA foreign_keys = ON;");
 
-    const auto upgradeSucceeded = DbUpgrader::dbSchemaUpgrade(db, messageBoxManager);
+    const auto upgradeSucceeded = DbUpgrader::dbSchemaUpgrade(db, messageBoxManager, upgradeProgress);
 
     // dbSchemaUpgrade may have put us in an invalid state
     if (!upgradeSucceeded) {
@@ -288,7 +350,27 @@ History::History(std::shared_ptr<RawDatabase> db_, Settings& settings_, IMessage
         return;
     }
 
+    // until the backfills of the upgrade finished, searching scans the messages and message
+    // counts are computed when a chat is opened
+    backfill.reset(new DbBackfill(db));
+    connect(backfill.get(), &DbBackfill::finished, this, &History::onBackfillFinished);
+    hasFullTextIndex =
+        !backfill->isPending(DbBackfill::Task::FullTextIndex) && fullTextIndexExists();
+    dayCountsPending = backfill->isPending(DbBackfill::Task::DayCounts);
+    backfill->start();
+
     connect(this, &History::fileInserted, this, &History::onFileInserted);
+    connect(this, &History::chatDeletionBatchDone, this, &History::onChatDeletionBatchDone);
+
+    chatDeletionTimer.setSingleShot(true);
+    chatDeletionTimer.setInterval(CHAT_DELETION_INTERVAL_MS);
+    connect(&chatDeletionTimer, &QTimer::timeout, this, &History::deleteNextChatBatch);
+
+    loadPushtokens();
+
+    // deletions interrupted by the last shutdown
+    loadChatDeletions();
+    continueChatDeletions();
 }
 
 History::~History()
@@ -327,6 +409,9 @@ bool History::historyExists(const ChatId& chatId)
 
 /**
  * @brief Erases all the chat history from the database.
+ *
+ * All chats are hidden immediately, their messages are deleted in the background like with
+ * removeChatHistory().
  */
 void History::eraseHistory()
 {
@@ -334,21 +419,84 @@ void History::eraseHistory()
         return;
     }
 
-    db->execNow("DELETE FROM faux_offline_pending;"
-                "DELETE FROM broken_messages;"
-                "DELETE FROM text_messages;"
-                "DELETE FROM file_transfers;"
-                "DELETE FROM system_messages;"
-                "DELETE FROM history;"
-                "DELETE FROM chats;"
-                "DELETE FROM aliases;"
-                "DELETE FROM authors;"
-                "VACUUM;");
+    if (!db->execNow({RawDatabase::Query{QStringLiteral(
+                          "INSERT OR IGNORE INTO chat_deletions (chat_id) SELECT id FROM chats;")},
+                      generateDetachChats(QStringLiteral("1")),
+                      RawDatabase::Query{QStringLiteral("DELETE FROM chat_activity;")},
+                      RawDatabase::Query{QStringLiteral("DELETE FROM file_resume;")}})) {
+        qWarning() << "Failed to erase the history";
+        return;
+    }
+
+    loadChatDeletions();
+    continueChatDeletions();
+}
+
+/**
+ * @brief Moves group images still stored inline out of the database.
+ * @param blobStore Store to move the images to.
+ *
+ * Images received before the BlobStore existed are kept as hex in text_messages.ngc_msgid, they
+ * are replaced by a reference to their blob. Runs in small batches since every row can hold a
+ * whole image, rows that fail to move are kept as they are.
+ */
+void History::moveImagesToBlobStore(BlobStore& blobStore)
+{
+    if (!isValid()) {
+        return;
+    }
+
+    constexpr int batchSize = 16;
+    int64_t lastId = -1;
+    int movedImages = 0;
+    bool more = true;
+    while (more) {
+        QVector<RawDatabase::Query> updateQueries;
+        int rows = 0;
+        auto rowCallback = [&](const QVector<QVariant>& row) {
+            ++rows;
+            lastId = row[0].toLongLong();
+            const QByteArray image = QByteArray::fromHex(row[1].toByteArray());
+            const QString reference = blobStore.put(image);
+            if (image.isEmpty() || reference.isEmpty()) {
+                qWarning() << "Failed to move image of message" << lastId << "to the blob store";
+                return;
+            }
+
+            updateQueries += RawDatabase::Query{
+                QStringLiteral("UPDATE text_messages SET ngc_msgid = ? WHERE id = %1;").arg(lastId),
+                {reference.toUtf8()}};
+        };
+
+        db->execNow(RawDatabase::Query{QStringLiteral("SELECT id, ngc_msgid FROM text_messages "
+                                                      "WHERE message = x'5F5F5F' AND id > %1 "
+                                                      "AND length(ngc_msgid) > 8 "
+                                                      "AND substr(ngc_msgid, 1, 4) != CAST('BLOB' AS BLOB) "
+                                                      "ORDER BY id LIMIT %2;")
+                                           .arg(lastId)
+                                           .arg(batchSize),
+                                       rowCallback});
+
+        if (!updateQueries.isEmpty() && db->execNow(updateQueries)) {
+            movedImages += updateQueries.size();
+        }
+        more = rows == batchSize;
+    }
+
+    if (movedImages > 0) {
+        qDebug() << "Moved" << movedImages << "group images from the history to the blob store";
+    }
 }
 
 /**
  * @brief Erases the chat history of one chat.
  * @param chatId Chat ID to erase.
+ *
+ * The chat is detached from chatId and tombstoned in one transaction, so it looks empty
+ * immediately and new messages of chatId start a new chat. A chat of a million messages would
+ * block the database for a long time in a single transaction, so its rows are deleted in
+ * bounded batches afterwards, see deleteNextChatBatch(). The freed pages are returned by the
+ * incremental vacuum of RawDatabase::maintain().
  */
 void History::removeChatHistory(const ChatId& chatId)
 {
@@ -356,87 +504,176 @@ void History::removeChatHistory(const ChatId& chatId)
         return;
     }
 
-    QVector<RawDatabase::Query> queries;
-    QVector<QByteArray> boundParams;
-    QString queryString = QStringLiteral(
-        "DELETE FROM faux_offline_pending "
-        "WHERE faux_offline_pending.id IN ( "
-        "    SELECT faux_offline_pending.id FROM faux_offline_pending "
-        "    LEFT JOIN history ON faux_offline_pending.id = history.id "
-        "    WHERE chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(")");
-    queries += {queryString, boundParams};
-    boundParams.clear();
+    RowId chatRowId{-1};
+    db->execNow(RawDatabase::Query{QStringLiteral("SELECT id FROM chats WHERE uuid = ?;"),
+                                   {chatId.getByteArray()},
+                                   [&chatRowId](const RawDatabase::Row& row) {
+                                       chatRowId = row.get<RowId>(0);
+                                   }});
+    if (chatRowId.get() < 0) {
+        return;
+    }
 
-    queryString = QStringLiteral(
-        "DELETE FROM broken_messages "
-        "WHERE broken_messages.id IN ( "
-        "    SELECT broken_messages.id FROM broken_messages "
-        "    LEFT JOIN history ON broken_messages.id = history.id "
-        "    WHERE chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(")");
-    queries += {queryString, boundParams};
-    boundParams.clear();
+    if (!db->execNow({RawDatabase::Query{QStringLiteral(
+                          "INSERT OR IGNORE INTO chat_deletions (chat_id) VALUES (%1);")
+                                             .arg(chatRowId.get())},
+                      generateDetachChats(QStringLiteral("id = %1").arg(chatRowId.get())),
+                      RawDatabase::Query{QStringLiteral(
+                          "DELETE FROM chat_activity WHERE chat_id = %1;")
+                                             .arg(chatRowId.get())}})) {
+        qWarning() << "Failed to remove friend's history";
+        return;
+    }
 
-    queryString = QStringLiteral(
-        "DELETE FROM text_messages "
-        "WHERE id IN ("
-        "   SELECT id from history "
-        "   WHERE message_type = 'T' AND chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(")");
-    queries += {queryString, boundParams};
-    boundParams.clear();
+    if (!pendingChatDeletions.contains(chatRowId)) {
+        pendingChatDeletions.append(chatRowId);
+    }
+    continueChatDeletions();
+}
 
-    queryString = QStringLiteral(
-        "DELETE FROM file_transfers "
-        "WHERE id IN ( "
-        "    SELECT id from history "
-        "    WHERE message_type = 'F' AND chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(")");
-    queries += {queryString, boundParams};
-    boundParams.clear();
+/**
+ * @brief Reads the chats whose deletion isn't finished yet.
+ */
+void History::loadChatDeletions()
+{
+    pendingChatDeletions.clear();
+    db->execNow(RawDatabase::Query{QStringLiteral(
+                                       "SELECT chat_id FROM chat_deletions ORDER BY chat_id;"),
+                                   [this](const RawDatabase::Row& row) {
+                                       pendingChatDeletions.append(row.get<RowId>(0));
+                                   }});
+}
 
-    queryString = QStringLiteral(
-        "DELETE FROM system_messages "
-        "WHERE id IN ( "
-        "   SELECT id from history "
-        "   WHERE message_type = 'S' AND chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(")");
-    queries += {queryString, boundParams};
-    boundParams.clear();
+/**
+ * @brief Schedules the next deletion batch, unless one is already queued or running.
+ */
+void History::continueChatDeletions()
+{
+    if (chatDeletionRunning || pendingChatDeletions.isEmpty()) {
+        return;
+    }
 
-    queryString = QStringLiteral(
-        "DELETE FROM history WHERE chat_id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queries += {queryString, boundParams};
-    boundParams.clear();
+    chatDeletionRunning = true;
+    chatDeletionTimer.start();
+}
 
-    queryString = QStringLiteral(
-        "DELETE FROM chats WHERE id=");
-    addChatIdSubQuery(queryString, boundParams, chatId);
-    queries += {queryString, boundParams};
-    boundParams.clear();
+/**
+ * @brief Checks if the full text index exists, it's missing if SQLCipher was built without FTS5.
+ */
+bool History::fullTextIndexExists()
+{
+    bool exists = false;
+    db->execNow(RawDatabase::Query(
+        "SELECT COUNT(*) FROM sqlite_master WHERE name = 'text_messages_fts';",
+        [&exists](const QVector<QVariant>& row) { exists = row[0].toLongLong() > 0; }));
+    return exists;
+}
+
+void History::onBackfillFinished(DbBackfill::Task task)
+{
+    switch (task) {
+    case DbBackfill::Task::FullTextIndex:
+        hasFullTextIndex = fullTextIndexExists();
+        break;
+    case DbBackfill::Task::DayCounts:
+        dayCountsPending = false;
+        break;
+    }
+}
+
+/**
+ * @brief Counts the messages of a chat per day right away if the DbBackfill counting all chats
+ * hasn't finished yet, so the counts of the chat being viewed are right.
+ * @param chatId Chat to count the messages of.
+ */
+void History::ensureDayCounts(const ChatId& chatId)
+{
+    if (!dayCountsPending) {
+        return;
+    }
 
-    queries += RawDatabase::Query{QStringLiteral(
-        "DELETE FROM aliases WHERE id NOT IN ( "
-        "   SELECT DISTINCT sender_alias FROM text_messages "
-        "   UNION "
-        "   SELECT DISTINCT sender_alias FROM file_transfers)")};
+    QMutexLocker locker{&dayCountsLock};
+    if (dayCountedChats.contains(chatId.getByteArray())) {
+        return;
+    }
 
-    queries += RawDatabase::Query{QStringLiteral(
-        "DELETE FROM authors WHERE id NOT IN ( "
-        "   SELECT DISTINCT owner FROM aliases)")};
+    QString chatIdQuery;
+    QVector<QByteArray> boundParams;
+    addChatIdSubQuery(chatIdQuery, boundParams, chatId);
+    db->execNow(DbBackfill::fillDayCounts(chatIdQuery, boundParams));
+    dayCountedChats.insert(chatId.getByteArray());
+}
 
-    if (!db->execNow(queries)) {
-        qWarning() << "Failed to remove friend's history";
-    } else {
-        db->execNow(RawDatabase::Query{QStringLiteral("VACUUM")});
+/**
+ * @brief Deletes the next CHAT_DELETION_BATCH_SIZE messages of the first tombstoned chat.
+ *
+ * Only one batch is queued at a time and the next one waits CHAT_DELETION_INTERVAL_MS after it
+ * finished, so other queries never wait for more than one batch.
+ */
+void History::deleteNextChatBatch()
+{
+    if (!isValid() || pendingChatDeletions.isEmpty()) {
+        chatDeletionRunning = false;
+        return;
+    }
+
+    const RowId chatRowId = pendingChatDeletions.first();
+    const QString batch =
+        QStringLiteral("(SELECT id FROM history WHERE chat_id = %1 ORDER BY id LIMIT %2)")
+            .arg(chatRowId.get())
+            .arg(CHAT_DELETION_BATCH_SIZE);
+
+    QVector<RawDatabase::Query> queries;
+    // message subtypes first, they reference history
+    for (const auto& table : {QStringLiteral("faux_offline_pending"),
+                              QStringLiteral("broken_messages"), QStringLiteral("text_messages"),
+                              QStringLiteral("file_transfers"),
+                              QStringLiteral("system_messages")}) {
+        queries += RawDatabase::Query{
+            QStringLiteral("DELETE FROM %1 WHERE id IN %2;").arg(table).arg(batch)};
     }
+    queries += RawDatabase::Query{QStringLiteral("DELETE FROM history WHERE id IN %1;").arg(batch)};
+    queries += RawDatabase::Query{
+        QStringLiteral("SELECT EXISTS (SELECT 1 FROM history WHERE chat_id = %1);")
+            .arg(chatRowId.get()),
+        [this, chatRowId](const RawDatabase::Row& row) {
+            emit chatDeletionBatchDone(chatRowId, row.get<int64_t>(0) == 0);
+        }};
+    db->execLater(queries);
+}
+
+/**
+ * @brief Removes the chat once its last message is deleted and continues with the next batch.
+ * @param chatRowId Row of the chat of the batch.
+ * @param finished True if the chat has no messages left.
+ */
+void History::onChatDeletionBatchDone(RowId chatRowId, bool finished)
+{
+    chatDeletionRunning = false;
+
+    if (finished) {
+        db->execLater(
+            {RawDatabase::Query{QStringLiteral("DELETE FROM ngc_sync_index WHERE chat_id = %1;")
+                                    .arg(chatRowId.get())},
+             RawDatabase::Query{QStringLiteral("DELETE FROM chat_deletions WHERE chat_id = %1;")
+                                    .arg(chatRowId.get())},
+             RawDatabase::Query{
+                 QStringLiteral("DELETE FROM chats WHERE id = %1;").arg(chatRowId.get())},
+             RawDatabase::Query{QStringLiteral("DELETE FROM aliases WHERE id NOT IN ( "
+                                               "   SELECT DISTINCT sender_alias FROM text_messages "
+                                               "   UNION "
+                                               "   SELECT DISTINCT sender_alias FROM file_transfers)")},
+             RawDatabase::Query{QStringLiteral("DELETE FROM authors WHERE id NOT IN ( "
+                                               "   SELECT DISTINCT owner FROM aliases)")}});
+        pendingChatDeletions.removeAll(chatRowId);
+
+        if (pendingChatDeletions.isEmpty()) {
+            qDebug() << "Finished deleting removed chats";
+            db->requestMaintenance();
+        }
+    }
+
+    continueChatDeletions();
 }
 
 void History::onFileInserted(RowId dbId, QByteArray fileId)
@@ -594,8 +831,44 @@ void History::addNewMessage(const ChatId& chatId, const QString& message, const
 
     // qDebug() << "History::addNewMessage: isPrivate:" << isPrivate;
 
-    db->execLater(generateNewTextMessageQueries(chatId, message, sender, time, isDelivered,
-                                                extensionSet, dispName, insertIdCallback, hasIdType, isPrivate));
+    auto queries = generateNewTextMessageQueries(chatId, message, sender, time, isDelivered,
+                                                 extensionSet, dispName, insertIdCallback,
+                                                 hasIdType, isPrivate);
+    if (batchDepth > 0) {
+        batchQueries += queries;
+        return;
+    }
+
+    db->execLater(queries);
+}
+
+/**
+ * @brief Collects the messages added until endBatch() into a single transaction.
+ *
+ * Used when one sent message is split into many, e.g. a pasted log. Batches nest, only the
+ * outermost endBatch() writes. Must be called from the thread adding the messages.
+ */
+void History::beginBatch()
+{
+    ++batchDepth;
+}
+
+/**
+ * @brief Writes the messages collected since beginBatch().
+ */
+void History::endBatch()
+{
+    if (batchDepth == 0 || --batchDepth > 0 || batchQueries.isEmpty()) {
+        return;
+    }
+
+    QVector<RawDatabase::Query> queries;
+    queries.swap(batchQueries);
+    if (historyAccessBlocked()) {
+        return;
+    }
+
+    db->execLater(queries);
 }
 
 static size_t xnet_pack_u16_hist(uint8_t *bytes, uint16_t v)
@@ -613,22 +886,25 @@ static size_t xnet_pack_u32_hist(uint8_t *bytes, uint32_t v)
     return p - bytes;
 }
 
-QList<History::HistMessage> History::getGroupMessagesXMinutesBack(const QByteArray& chatIdByteArray, const QDateTime& date,
-                    const ToxPk& sender, int groupnumber, int peernumber)
+/**
+ * @brief Builds the reply to a NGC history sync request.
+ * @param chatIdByteArray Persistent id of the group.
+ * @param date Oldest message to include.
+ * @return One custom private packet per public text message, oldest first.
+ *
+ * Only runs the query, pacing and sending the packets is up to the caller, see GroupSyncSender.
+ */
+QVector<QByteArray> History::getGroupSyncPackets(const QByteArray& chatIdByteArray, const QDateTime& date)
 {
     if (historyAccessBlocked()) {
         return {};
     }
 
-    std::ignore = sender;
-
-    QString queryText = QString("SELECT history.id, history.message_type, history.timestamp, "
-                                "text_messages.message, "
-                                "authors.public_key as sender_key, aliases.display_name, text_messages.ngc_msgid, "
-                                "text_messages.msgv3hash, chats.uuid "
+    QString queryText = QString("SELECT history.timestamp, text_messages.message, "
+                                "authors.public_key as sender_key, aliases.display_name, "
+                                "text_messages.ngc_msgid "
                                 "FROM history "
-                                "LEFT JOIN text_messages ON history.id = text_messages.id "
-                                "JOIN chats ON chat_id = chats.id "
+                                "JOIN text_messages ON history.id = text_messages.id "
                                 "LEFT JOIN aliases ON text_messages.sender_alias = aliases.id "
                                 "LEFT JOIN authors ON aliases.owner = authors.id "
                                 "WHERE history.chat_id = ");
@@ -639,217 +915,200 @@ QList<History::HistMessage> History::getGroupMessagesXMinutesBack(const QByteArr
     queryText += QString(" AND text_messages.private = '0'");
     queryText += QString(" order by timestamp ASC;");
 
-    // qDebug() << QString("getGroupMessagesXMinutesBack:SQL:") << queryText;
-    // const bool isGuiThread2 = QThread::currentThread() == QCoreApplication::instance()->thread();
-    // qDebug() << QString("getGroupMessagesXMinutesBack:THREAD:001:") << QThread::currentThreadId() << "isGuiThread" << isGuiThread2;
-
-    Tox* toxcore = settings.getToxcore();
-    QList<HistMessage> messages;
-    auto rowCallback = [&toxcore, groupnumber, peernumber](const QVector<QVariant>& row) {
+    QVector<QByteArray> packets;
+    auto rowCallback = [&packets](const QVector<QVariant>& row) {
         auto it = row.begin();
 
-        constexpr auto messageOffset = 3;
-        constexpr auto senderOffset = 4;
-
-        const auto id = RowId{(*it++).toLongLong()};
-        std::ignore = id;
-        const auto messageType = (*it++).toString();
         const auto timestamp = QDateTime::fromMSecsSinceEpoch((*it++).toLongLong());
+        const auto messageContent = (*it++).toString();
+        const auto senderKey = (*it++).toByteArray();
+        auto senderName = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
+        senderName = senderName.section(':', 1);
+        const auto ngcMsgid = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
+
+        if ((messageContent == "___") && (ngcMsgid.size() > 8)) {
+            // HINT: message is a group image, those are not synced
+            return;
+        }
 
-        assert(messageType.size() == 1);
-        switch (messageType[0].toLatin1()) {
-        case 'T': {
-            it = std::next(row.begin(), messageOffset);
-            assert(!it->isNull());
-            auto messageContent = (*it++).toString();
-
-            it = std::next(row.begin(), senderOffset);
-            // ---------------------
-            const auto senderKey__bin = (*it++).toByteArray();
-            const auto senderKey__str = QString::fromUtf8(senderKey__bin.toHex()).toUpper();
-            // ---------------------
-            const auto senderName__bin = (*it).toByteArray();
-            auto senderName__str = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            senderName__str = senderName__str.section(':', 1);
-            // ---------------------
-            const auto ngc_msgid2__bin = (*it).toByteArray();
-            const auto ngc_msgid2__str = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            // ---------------------
-            const auto msgv3hash = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            // ---------------------
-            const auto chat_uuid__bin = (*it++).toByteArray();
-            const auto chat_uuid__str = QString::fromUtf8(chat_uuid__bin.toHex()).toUpper();
-            // ---------------------
-
-            // qDebug() << QString("getGroupMessagesXMinutesBack:M:")
-            //     << "timestamp" << timestamp
-            //     << "chat_uuid" << chat_uuid__str
-            //     << "senderKey" << senderKey__str
-            //     << "messageContent" << messageContent
-            //     << "senderName" << senderName__str
-            //     << "ngc_msgid2" << ngc_msgid2__str.left(16)
-            //     << "msgv3hash" << msgv3hash.left(16)
-            //     ;
-
-            if ((messageContent == "___") && (ngc_msgid2__str.size() > 8))
-            {
-                // HINT: message is a group image
-                // qDebug() << QString("getGroupMessagesXMinutesBack:M:__group_image");
-            }
-            else
-            {
-                if (messageContent.size() == 0)
-                {
-                    // qDebug() << QString("getGroupMessagesXMinutesBack: messageContent has zero size");
-                    break;
-                }
-                // HINT: regular group text message
-                // qDebug() << QString("getGroupMessagesXMinutesBack:M:__group_text message");
+        const QByteArray messageBytes = messageContent.toUtf8();
+        if (messageBytes.isEmpty()) {
+            return;
+        }
 
-                const int delay = 301;
-#if QT_VERSION < QT_VERSION_CHECK( 5, 10, 0 )
-                int rndi = qrand() % delay;
-#else
-                int rndi = QRandomGenerator::global()->generate() % delay;
-#endif
-                int n = 300 + rndi;
-                std::ignore = n;
+        const int header_length = 6 + 1 + 1 + 4 + 32 + 4 + 25;
+        const int data_length = header_length + messageBytes.size();
+        if (data_length > 40000) {
+            qDebug() << QString("getGroupSyncPackets: some error in calculating data length");
+            return;
+        }
 
-                const int header_length = 6 + 1 + 1 + 4 + 32 + 4 + 25;
-                const int data_length = header_length + messageContent.toUtf8().size();
+        const QByteArray msgidBytes = QByteArray::fromHex(ngcMsgid.toLatin1());
+        if (msgidBytes.size() != 4) {
+            qDebug() << QString("getGroupSyncPackets: ngc_msgid size != 4") << msgidBytes.size();
+            return;
+        }
 
-                if (data_length < (header_length + 1) || (data_length > 40000))
-                {
-                    qDebug() << QString("getGroupMessagesXMinutesBack: some error in calculating data length");
-                    break;
-                }
+        if (senderKey.size() != 32) {
+            qDebug() << QString("getGroupSyncPackets: sender key size != 32") << senderKey.size();
+            return;
+        }
 
-                uint8_t* data_buf = reinterpret_cast<uint8_t*>(calloc(1, data_length));
-                if (data_buf)
-                {
-                    // -----------------------------------------------------------
-                    // header (8 bytes)
-                    uint8_t* data_buf_cur = data_buf;
-                    *data_buf_cur = 0x66;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x77;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x88;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x11;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x34;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x35;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x1;
-                    data_buf_cur++;
-                    *data_buf_cur = 0x2;
-                    data_buf_cur++;
-                    // -----------------------------------------------------------
-                    // ngc message id (4 bytes)
-                    const auto ngc_msgid2__bin_bytes = QByteArray::fromHex(ngc_msgid2__str.toLatin1());
-                    if (ngc_msgid2__bin_bytes.size() != 4)
-                    {
-                        qDebug() << QString("getGroupMessagesXMinutesBack: ngc_msgid2__bin_bytes.size() != 4") << ngc_msgid2__bin_bytes.size();
-                        free(data_buf);
-                        break;
-                    }
-                    memcpy(data_buf_cur, reinterpret_cast<const uint8_t*>(ngc_msgid2__bin_bytes.constData()), 4);
-                    data_buf_cur = data_buf_cur + 4;
-                    // -----------------------------------------------------------
-                    // sender peer pubkey (32 bytes)
-                    const auto senderKey__bin_bytes = QByteArray::fromHex(senderKey__str.toLatin1());
-                    if (senderKey__bin_bytes.size() != 32)
-                    {
-                        qDebug() << QString("getGroupMessagesXMinutesBack: senderKey__bin_bytes.size() != 32") << senderKey__bin_bytes.size();
-                        free(data_buf);
-                        break;
-                    }
-                    memcpy(data_buf_cur, reinterpret_cast<const uint8_t*>(senderKey__bin_bytes.constData()), 32);
-                    data_buf_cur = data_buf_cur + 32;
-                    // -----------------------------------------------------------
-                    // timestamp // (unix timestamp 4 bytes)
-                    uint32_t timestamp_c = static_cast<uint32_t>(timestamp.toMSecsSinceEpoch() / 1000);
-                    uint32_t timestamp_unix_buf;
-                    xnet_pack_u32_hist(reinterpret_cast<uint8_t*>(&timestamp_unix_buf), timestamp_c);
-                    memcpy(data_buf_cur, &timestamp_unix_buf, 4);
-                    data_buf_cur = data_buf_cur + 4;
-                    // -----------------------------------------------------------
-                    // sender name (cut to 25 bytes)
-                    uint8_t* name_buf = reinterpret_cast<uint8_t*>(calloc(1, 25));
-                    if (name_buf)
-                    {
-                        const auto senderName__bin_bytes = senderName__str.toUtf8();
-                        const int name_in_bytes = senderName__bin_bytes.size();
-                        // qDebug() << QString("getGroupMessagesXMinutesBack: senderName__bin_bytes.size():")
-                        //     << senderName__bin_bytes.size();
-
-                        // qDebug() << QString("getGroupMessagesXMinutesBack:senderName__bin_bytes hex:")
-                        //     << QString::fromUtf8(senderName__bin_bytes.toHex()).toUpper();
-
-                        const int max_name_bytes = 25;
-                        if (name_in_bytes > max_name_bytes)
-                        {
-                            memcpy(name_buf, reinterpret_cast<const uint8_t*>(senderName__bin_bytes.constData()), max_name_bytes);
-                        }
-                        else
-                        {
-                            memcpy(name_buf, reinterpret_cast<const uint8_t*>(senderName__bin_bytes.constData()), name_in_bytes);
-                        }
-                        memcpy(data_buf_cur, reinterpret_cast<const uint8_t*>(name_buf), max_name_bytes);
-                        free(name_buf);
-                    }
-                    data_buf_cur = data_buf_cur + 25;
-                    // -----------------------------------------------------------
-                    // the actual message text
-                    memcpy(data_buf_cur, reinterpret_cast<const uint8_t*>(messageContent.toUtf8().constData()),
-                                messageContent.toUtf8().size());
-                    // -----------------------------------------------------------
-                    // now send the whole thing
-                    //
-                    // QByteArray data_buf_bytearray = QByteArray(reinterpret_cast<const char*>(data_buf), data_length);
-                    // qDebug() << QString("getGroupMessagesXMinutesBack:send_bytes:") << QString::fromUtf8(data_buf_bytearray.toHex()).toUpper();
-                    if (toxcore != nullptr)
-                    {
-                        const bool isGuiThread3 = QThread::currentThread() == QCoreApplication::instance()->thread();
-                        qDebug() << QString("getGroupMessagesXMinutesBack:THREAD:002:") << QThread::currentThreadId() << "isGuiThread" << isGuiThread3;
-                        // HINT: wait "n" milliseconds before sending the sync message
-                        QThread::msleep(n);
-                        Tox_Err_Group_Send_Custom_Private_Packet error;
-                        std::ignore = error;
-                        int result = tox_group_send_custom_private_packet(toxcore, (groupnumber - Settings::NGC_GROUPNUM_OFFSET),
-                                                                          peernumber, 1, data_buf,
-                                                                          data_length, &error);
-                        std::ignore = result;
-                        // qDebug() << QString("getGroupMessagesXMinutesBack:sending_request:groupnumber:") << groupnumber << "groupnumber_corr:" << (groupnumber - Settings::NGC_GROUPNUM_OFFSET);
-                        // qDebug() << QString("getGroupMessagesXMinutesBack:sending_request:result:") << result << "error:" << error;
-                    }
-                    free(data_buf);
-                }
-                else
-                {
-                    qDebug() << QString("getGroupMessagesXMinutesBack: error allocating buffer");
-                }
-            }
+        QByteArray packet;
+        packet.reserve(data_length);
+        // header (8 bytes)
+        const char header[] = {0x66, 0x77, static_cast<char>(0x88), 0x11, 0x34, 0x35, 0x1, 0x2};
+        packet.append(header, sizeof(header));
+        // ngc message id (4 bytes)
+        packet.append(msgidBytes);
+        // sender peer pubkey (32 bytes)
+        packet.append(senderKey);
+        // timestamp (unix timestamp 4 bytes)
+        uint8_t timestamp_buf[4];
+        xnet_pack_u32_hist(timestamp_buf, static_cast<uint32_t>(timestamp.toMSecsSinceEpoch() / 1000));
+        packet.append(reinterpret_cast<const char*>(timestamp_buf), sizeof(timestamp_buf));
+        // sender name (cut to 25 bytes, zero padded)
+        const int max_name_bytes = 25;
+        QByteArray nameBytes = senderName.toUtf8().left(max_name_bytes);
+        nameBytes.append(QByteArray(max_name_bytes - nameBytes.size(), '\0'));
+        packet.append(nameBytes);
+        // the actual message text
+        packet.append(messageBytes);
+
+        packets.append(packet);
+    };
 
-            break;
-            }
-        }
+    db->execNow({queryText, boundParams, rowCallback});
+
+    return packets;
+}
+
+/**
+ * @brief Reads the public NGC messages stored for a group, to seed NgcSyncIndex.
+ * @param chatId Persistent id of the group.
+ * @param since Oldest message to read. Rows older than this are removed for all groups, no sync
+ * reaches back that far.
+ * @return Sender, time and hash of each message.
+ */
+QVector<NgcSyncIndex::Entry> History::getNgcSyncIndex(const ChatId& chatId, const QDateTime& since)
+{
+    if (historyAccessBlocked()) {
+        return {};
+    }
+
+    const qint64 sinceMs = since.toMSecsSinceEpoch();
+    db->execNow(RawDatabase::Query{
+        QStringLiteral("DELETE FROM ngc_sync_index WHERE timestamp < %1;").arg(sinceMs)});
+
+    QString queryText = QStringLiteral("SELECT sender_key, timestamp, message_hash "
+                                       "FROM ngc_sync_index WHERE chat_id = ");
+    QVector<QByteArray> boundParams;
+    addChatIdSubQuery(queryText, boundParams, chatId);
+    queryText += QStringLiteral(" AND timestamp >= %1;").arg(sinceMs);
+
+    QVector<NgcSyncIndex::Entry> entries;
+    auto rowCallback = [&entries](const QVector<QVariant>& row) {
+        NgcSyncIndex::Entry entry;
+        entry.sender = ToxPk{row[0].toByteArray()};
+        entry.timestampMs = row[1].toLongLong();
+        entry.messageHash = row[2].toByteArray();
+        entries.append(entry);
     };
 
     db->execNow({queryText, boundParams, rowCallback});
+    return entries;
+}
 
-    return messages;
+/**
+ * @brief Remembers how far an unfinished file transfer got, replacing what was stored for it.
+ * @param entry Transfer to remember, keyed by its file id.
+ */
+void History::saveFileProgress(const Entry& entry)
+{
+    if (historyAccessBlocked()) {
+        return;
+    }
+
+    QVector<QByteArray> boundParams;
+    boundParams += entry.fileId;
+    boundParams += entry.friendPk.getByteArray();
+    boundParams += entry.fileName.toUtf8();
+    boundParams += entry.filePath.toUtf8();
+    db->execLater(RawDatabase::Query{
+        QStringLiteral("INSERT OR REPLACE INTO file_resume (file_id, friend_key, direction, "
+                       "file_name, file_path, file_size, bytes_done, timestamp) "
+                       "VALUES (?, ?, %1, ?, ?, %2, %3, %4);")
+            .arg(static_cast<int>(entry.sending ? ToxFile::SENDING : ToxFile::RECEIVING))
+            .arg(entry.fileSize)
+            .arg(entry.bytesDone)
+            .arg(QDateTime::currentMSecsSinceEpoch()),
+        boundParams});
 }
 
+/**
+ * @brief Forgets a file transfer once it finished or was cancelled.
+ * @param fileId Tox file id of the transfer.
+ */
+void History::removeFileProgress(const QByteArray& fileId)
+{
+    if (historyAccessBlocked()) {
+        return;
+    }
+
+    db->execLater(RawDatabase::Query{QStringLiteral("DELETE FROM file_resume WHERE file_id = ?;"),
+                                     QVector<QByteArray>{fileId}});
+}
+
+/**
+ * @brief Reads the unfinished file transfers with a friend, in both directions.
+ * @param friendPk Friend the files were sent to or received from.
+ * @return One entry per transfer, oldest first.
+ */
+QVector<IFileResumeStore::Entry> History::getResumableFiles(const ToxPk& friendPk)
+{
+    if (historyAccessBlocked()) {
+        return {};
+    }
+
+    QVector<Entry> entries;
+    auto rowCallback = [&entries, &friendPk](const QVector<QVariant>& row) {
+        Entry entry;
+        entry.fileId = row[0].toByteArray();
+        entry.friendPk = friendPk;
+        entry.sending = row[1].toInt() == static_cast<int>(ToxFile::SENDING);
+        entry.fileName = QString::fromUtf8(row[2].toByteArray());
+        entry.filePath = QString::fromUtf8(row[3].toByteArray());
+        entry.fileSize = row[4].toULongLong();
+        entry.bytesDone = row[5].toULongLong();
+        entries.append(entry);
+    };
+
+    db->execNow({QStringLiteral("SELECT file_id, direction, file_name, file_path, file_size, "
+                                "bytes_done FROM file_resume WHERE friend_key = ? "
+                                "ORDER BY timestamp;"),
+                 QVector<QByteArray>{friendPk.getByteArray()}, rowCallback});
+    return entries;
+}
+
+/**
+ * @brief Stores the pushtoken of a friend.
+ * @param sender Public key of the friend.
+ * @param pushtoken Pushtoken the friend sent us.
+ *
+ * The cache is updated right away, the database is written asynchronously.
+ */
 void History::addPushtoken(const ToxPk& sender, const QString& pushtoken)
 {
     if (!isValid()) {
         return;
     }
 
-    db->execNow(
+    {
+        QMutexLocker locker{&pushtokensLock};
+        pushtokens.insert(sender, pushtoken);
+    }
+
+    db->execLater(
                RawDatabase::Query(QStringLiteral("UPDATE authors "
                                                  "set push_token = ? "
                                                  "WHERE public_key = ?"),
@@ -863,17 +1122,40 @@ QString History::getPushtoken(const ToxPk& friendPk)
         return QString("_");
     }
 
-    QString pushtoken = QString("_");
+    QMutexLocker locker{&pushtokensLock};
+    return pushtokens.value(friendPk, QString("_"));
+}
+
+/**
+ * @brief Returns the pushtokens of all known authors.
+ * @return Pushtoken by public key, keys without a database row are missing.
+ *
+ * Used when loading the friend list, served from the cache filled by loadPushtokens().
+ */
+QHash<ToxPk, QString> History::getPushtokens()
+{
+    QMutexLocker locker{&pushtokensLock};
+    return pushtokens;
+}
+
+/**
+ * @brief Reads the pushtokens of all known authors with a single query.
+ *
+ * Called once when the profile is opened, so looking up a pushtoken later never waits for the
+ * database thread.
+ */
+void History::loadPushtokens()
+{
+    QHash<ToxPk, QString> loaded;
     db->execNow(
-        RawDatabase::Query("SELECT push_token from authors WHERE public_key = ?",
-            {friendPk.getByteArray()},
+        RawDatabase::Query("SELECT public_key, push_token from authors",
             [&](const QVector<QVariant>& row) {
-                    pushtoken = row[0].toString();
-                    qDebug() << "getPushtoken:" << pushtoken;
+                    loaded.insert(ToxPk(row[0].toByteArray()), row[1].toString());
             })
     );
 
-    return pushtoken;
+    QMutexLocker locker{&pushtokensLock};
+    pushtokens = loaded;
 }
 
 QString History::getSqlcipherVersion()
@@ -903,147 +1185,149 @@ void History::pushtokenPing(const ToxPk& sender)
     if (!settings.getUsePushNotification()) {
         qDebug() << "pushtokenPing:UsePushNotification set to false. Push Notification NOT sent!";
         return;
-    } else {
-        db->execNow(
-            RawDatabase::Query("SELECT push_token from authors WHERE public_key = ?",
-                {sender.getByteArray()},
-                [&](const QVector<QVariant>& row) {
-                        auto url = row[0].toString();
-
-                        qDebug() << "wakeupMobile:START";
-                        qDebug() << "pushtokenPing:pushtoken=" << url;
-                        qDebug() << "pushtokenPing:pushtoken(as hex bytes)=" << url.toLatin1().toHex();
-
-                        if (url.isNull()) {
-                            qDebug() << "pushtokenPing:url.isNull()";
-                        }
-                        else if (url.size() < 8) {
-                            qDebug() << "pushtokenPing:url.size() < 8";
-                        }
-                        else if (url.isEmpty()) {
-                            qDebug() << "pushtokenPing:url.isEmpty()";
-                        }
-                        else if (url.startsWith("https://")) {
+    }
 
-                            bool push_url_in_whitelist = false;
-                            foreach (QString listitem, Settings::PUSHURL_WHITELIST) {
-                                qDebug() << "wakeupMobile:check against whitelist: " << listitem << " -> " << url;
-                                if (url.startsWith(listitem)) {
-                                    push_url_in_whitelist = true;
-                                    break;
-                                }
-                            }
+    QString url;
+    {
+        QMutexLocker locker{&pushtokensLock};
+        const auto it = pushtokens.constFind(sender);
+        if (it == pushtokens.constEnd()) {
+            return;
+        }
+        url = *it;
+    }
 
-                            if (push_url_in_whitelist) {
+    qDebug() << "wakeupMobile:START";
+    qDebug() << "pushtokenPing:pushtoken=" << url;
+    qDebug() << "pushtokenPing:pushtoken(as hex bytes)=" << url.toLatin1().toHex();
 
-                                qDebug() << "wakeupMobile:push_url=" << url;
+    if (url.isNull()) {
+        qDebug() << "pushtokenPing:url.isNull()";
+    }
+    else if (url.size() < 8) {
+        qDebug() << "pushtokenPing:url.size() < 8";
+    }
+    else if (url.isEmpty()) {
+        qDebug() << "pushtokenPing:url.isEmpty()";
+    }
+    else if (url.startsWith("https://")) {
+
+        bool push_url_in_whitelist = false;
+        foreach (QString listitem, Settings::PUSHURL_WHITELIST) {
+            qDebug() << "wakeupMobile:check against whitelist: " << listitem << " -> " << url;
+            if (url.startsWith(listitem)) {
+                push_url_in_whitelist = true;
+                break;
+            }
+        }
+
+        if (push_url_in_whitelist) {
+
+            qDebug() << "wakeupMobile:push_url=" << url;
 #if 1
-                                qDebug() << "wakeupMobile:network method:QNetworkAccessManager";
-
-                                QString proxy_addr = settings.getProxyAddr();
-                                quint16 proxy_port = settings.getProxyPort();
-                                QNetworkProxy proxy = settings.getProxy();
-                                ICoreSettings::ProxyType proxy_type = settings.getProxyType();
-                                qDebug() << "wakeupMobile:proxy_addr=" << proxy_addr.toUtf8() << " bytes=" << proxy_addr.toUtf8().size();
-                                qDebug() << "wakeupMobile:proxy_port=" << proxy_port;
-                                qDebug() << "wakeupMobile:proxy_type=" << static_cast<int>(proxy_type);
-                                qDebug() << "wakeupMobile:proxy=" << proxy;
-
-                                QNetworkAccessManager *nam = new QNetworkAccessManager(QThread::currentThread());
-                                nam->setProxy(proxy);
-
-                                QUrlQuery paramsQuery;
-                                paramsQuery.addQueryItem("ping", "1");
-
-                                QUrl resource(url);
-
-                                QNetworkRequest request(resource);
-                                request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
-                                request.setRawHeader("User-Agent", "Mozilla/5.0 (Windows NT 6.1; rv:60.0) Gecko/20100101 Firefox/60.0");
-
-                                connect(nam, &QNetworkAccessManager::finished,[=](QNetworkReply* reply){
-                                    if (reply->error() == QNetworkReply::NoError) {
-                                        qDebug() << "pushPingFinished:OK";
-                                    } else {
-                                        qDebug() << "pushPingFinished:error:" << reply->errorString();
-                                    }
-                                });
-
-                                qDebug() << "wakeupMobile:calling url ...";
-                                nam->post(request, paramsQuery.query(QUrl::FullyEncoded).toUtf8());
+            qDebug() << "wakeupMobile:network method:QNetworkAccessManager";
+
+            QString proxy_addr = settings.getProxyAddr();
+            quint16 proxy_port = settings.getProxyPort();
+            QNetworkProxy proxy = settings.getProxy();
+            ICoreSettings::ProxyType proxy_type = settings.getProxyType();
+            qDebug() << "wakeupMobile:proxy_addr=" << proxy_addr.toUtf8() << " bytes=" << proxy_addr.toUtf8().size();
+            qDebug() << "wakeupMobile:proxy_port=" << proxy_port;
+            qDebug() << "wakeupMobile:proxy_type=" << static_cast<int>(proxy_type);
+            qDebug() << "wakeupMobile:proxy=" << proxy;
+
+            QNetworkAccessManager *nam = new QNetworkAccessManager(QThread::currentThread());
+            nam->setProxy(proxy);
+
+            QUrlQuery paramsQuery;
+            paramsQuery.addQueryItem("ping", "1");
+
+            QUrl resource(url);
+
+            QNetworkRequest request(resource);
+            request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+            request.setRawHeader("User-Agent", "Mozilla/5.0 (Windows NT 6.1; rv:60.0) Gecko/20100101 Firefox/60.0");
+
+            connect(nam, &QNetworkAccessManager::finished,[=](QNetworkReply* reply){
+                if (reply->error() == QNetworkReply::NoError) {
+                    qDebug() << "pushPingFinished:OK";
+                } else {
+                    qDebug() << "pushPingFinished:error:" << reply->errorString();
+                }
+            });
+
+            qDebug() << "wakeupMobile:calling url ...";
+            nam->post(request, paramsQuery.query(QUrl::FullyEncoded).toUtf8());
 #else
 
-                                qDebug() << "wakeupMobile:network method:CURL";
-                                curl_global_init(CURL_GLOBAL_ALL);
-                                CURL *curl;
-                                CURLcode res;
-                                curl = curl_easy_init();
+            qDebug() << "wakeupMobile:network method:CURL";
+            curl_global_init(CURL_GLOBAL_ALL);
+            CURL *curl;
+            CURLcode res;
+            curl = curl_easy_init();
 
-                                // HINT: show verbose curl output
-                                curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+            // HINT: show verbose curl output
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 
-                                if (curl)
-                                {
-                                    const char *url_c_str = url.toLatin1().constData();
+            if (curl)
+            {
+                const char *url_c_str = url.toLatin1().constData();
 #if defined(Q_OS_WIN32)
-                                    curl_easy_setopt(curl, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
+                curl_easy_setopt(curl, CURLOPT_SSL_OPTIONS, CURLSSLOPT_NATIVE_CA);
 #endif
 
-                                    QString proxy_addr = settings.getProxyAddr();
-                                    quint16 proxy_port = settings.getProxyPort();
-                                    QNetworkProxy proxy = settings.getProxy();
-                                    ICoreSettings::ProxyType proxy_type = settings.getProxyType();
-                                    qDebug() << "wakeupMobile:proxy_addr=" << proxy_addr.toUtf8() << " bytes=" << proxy_addr.toUtf8().size();
-                                    qDebug() << "wakeupMobile:proxy_port=" << proxy_port;
-                                    qDebug() << "wakeupMobile:proxy_type=" << static_cast<int>(proxy_type);
-                                    qDebug() << "wakeupMobile:proxy=" << proxy;
-
-                                    if (proxy_type != ICoreSettings::ProxyType::ptNone) {
-                                        if (static_cast<uint32_t>(proxy_addr.length()) > 300) {
-                                            qWarning() << "Proxy address" << proxy_addr << "is too long (max. 300 chars)";
-                                        } else if (!proxy_addr.isEmpty() && proxy_port > 0) {
-                                            if (proxy_type == ICoreSettings::ProxyType::ptSOCKS5) {
-                                                curl_easy_setopt(curl, CURLOPT_PROXY, proxy_addr.toUtf8().data());
-                                                curl_easy_setopt(curl, CURLOPT_PROXYPORT, proxy_port);
-                                                curl_easy_setopt(curl, CURLOPT_PROXYTYPE, CURLPROXY_SOCKS5);
-                                                curl_easy_setopt(curl, CURLOPT_HTTPPROXYTUNNEL, 1);
-                                                qDebug() << "Using CURLPROXY_SOCKS5 proxy" << proxy_addr << ":" << proxy_port;
-                                            } else if (proxy_type == ICoreSettings::ProxyType::ptHTTP) {
-                                                curl_easy_setopt(curl, CURLOPT_PROXY, proxy_addr.toUtf8().data());
-                                                curl_easy_setopt(curl, CURLOPT_PROXYPORT, proxy_port);
-                                                curl_easy_setopt(curl, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
-                                                curl_easy_setopt(curl, CURLOPT_HTTPPROXYTUNNEL, 1);
-                                                qDebug() << "Using CURLPROXY_HTTP proxy" << proxy_addr << ":" << proxy_port;
-                                            }
-                                        }
-                                    }
-
-                                    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "ping=1");
-                                    curl_easy_setopt(curl, CURLOPT_URL, url_c_str);
-                                    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 6.1; rv:60.0) Gecko/20100101 Firefox/60.0");
-                                    res = curl_easy_perform(curl);
-
-                                    if (res == CURLE_OK)
-                                    {
-                                        qDebug() << "curl:CURLE_OK";
-                                    }
-                                    else
-                                    {
-                                        qDebug() << "curl:ERROR:res=" << res;
-                                    }
-
-                                    curl_easy_cleanup(curl);
-                                }
-                                curl_global_cleanup();
-#endif
-                            } else {
-                                qDebug() << "wakeupMobile:check against whitelist:URL not in whitelist -> " << url;
-                            }
-                        } else {
-                            qDebug() << "pushtokenPing:some other problem";
+                QString proxy_addr = settings.getProxyAddr();
+                quint16 proxy_port = settings.getProxyPort();
+                QNetworkProxy proxy = settings.getProxy();
+                ICoreSettings::ProxyType proxy_type = settings.getProxyType();
+                qDebug() << "wakeupMobile:proxy_addr=" << proxy_addr.toUtf8() << " bytes=" << proxy_addr.toUtf8().size();
+                qDebug() << "wakeupMobile:proxy_port=" << proxy_port;
+                qDebug() << "wakeupMobile:proxy_type=" << static_cast<int>(proxy_type);
+                qDebug() << "wakeupMobile:proxy=" << proxy;
+
+                if (proxy_type != ICoreSettings::ProxyType::ptNone) {
+                    if (static_cast<uint32_t>(proxy_addr.length()) > 300) {
+                        qWarning() << "Proxy address" << proxy_addr << "is too long (max. 300 chars)";
+                    } else if (!proxy_addr.isEmpty() && proxy_port > 0) {
+                        if (proxy_type == ICoreSettings::ProxyType::ptSOCKS5) {
+                            curl_easy_setopt(curl, CURLOPT_PROXY, proxy_addr.toUtf8().data());
+                            curl_easy_setopt(curl, CURLOPT_PROXYPORT, proxy_port);
+                            curl_easy_setopt(curl, CURLOPT_PROXYTYPE, CURLPROXY_SOCKS5);
+                            curl_easy_setopt(curl, CURLOPT_HTTPPROXYTUNNEL, 1);
+                            qDebug() << "Using CURLPROXY_SOCKS5 proxy" << proxy_addr << ":" << proxy_port;
+                        } else if (proxy_type == ICoreSettings::ProxyType::ptHTTP) {
+                            curl_easy_setopt(curl, CURLOPT_PROXY, proxy_addr.toUtf8().data());
+                            curl_easy_setopt(curl, CURLOPT_PROXYPORT, proxy_port);
+                            curl_easy_setopt(curl, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
+                            curl_easy_setopt(curl, CURLOPT_HTTPPROXYTUNNEL, 1);
+                            qDebug() << "Using CURLPROXY_HTTP proxy" << proxy_addr << ":" << proxy_port;
                         }
-                })
-            );
+                    }
+                }
+
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "ping=1");
+                curl_easy_setopt(curl, CURLOPT_URL, url_c_str);
+                curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 6.1; rv:60.0) Gecko/20100101 Firefox/60.0");
+                res = curl_easy_perform(curl);
+
+                if (res == CURLE_OK)
+                {
+                    qDebug() << "curl:CURLE_OK";
+                }
+                else
+                {
+                    qDebug() << "curl:ERROR:res=" << res;
+                }
+
+                curl_easy_cleanup(curl);
+            }
+            curl_global_cleanup();
+#endif
+        } else {
+            qDebug() << "wakeupMobile:check against whitelist:URL not in whitelist -> " << url;
+        }
+    } else {
+        qDebug() << "pushtokenPing:some other problem";
     }
 }
 
@@ -1076,21 +1360,95 @@ size_t History::getNumMessagesForChat(const ChatId& chatId)
     return getNumMessagesForChatBeforeDate(chatId, QDateTime());
 }
 
+/**
+ * @brief Reads the activity summary of a chat.
+ * @param chatId Chat to read the summary of.
+ * @return Stored summary, an empty one if the chat has no activity yet.
+ */
+ChatActivity History::getChatActivity(const ChatId& chatId)
+{
+    if (historyAccessBlocked()) {
+        return {};
+    }
+
+    ChatActivity activity;
+    auto rowCallback = [&activity](const RawDatabase::Row& row) {
+        activity.lastActivity = QDateTime::fromMSecsSinceEpoch(row.get<int64_t>(0));
+        activity.unreadCount = static_cast<int>(row.get<int64_t>(1));
+        activity.mentioned = row.get<bool>(2);
+    };
+
+    QString queryString = QStringLiteral("SELECT last_activity, unread_count, mentioned "
+                                         "FROM chat_activity WHERE chat_id = ");
+    QVector<QByteArray> boundParams;
+    addChatIdSubQuery(queryString, boundParams, chatId);
+    queryString += QStringLiteral(";");
+    db->execNow({queryString, boundParams, rowCallback});
+
+    return activity;
+}
+
+/**
+ * @brief Stores the activity summary of a chat.
+ * @param chatId Chat to store the summary of.
+ * @param activity New summary.
+ *
+ * Nothing is stored for chats without a row in chats, they get one with their first message.
+ */
+void History::setChatActivity(const ChatId& chatId, const ChatActivity& activity)
+{
+    if (historyAccessBlocked() || !activity.lastActivity.isValid()) {
+        return;
+    }
+
+    db->execLater(RawDatabase::Query{
+        QStringLiteral("INSERT OR REPLACE INTO chat_activity "
+                       "(chat_id, last_activity, unread_count, mentioned) "
+                       "SELECT id, %1, %2, %3 FROM chats WHERE uuid = ?;")
+            .arg(activity.lastActivity.toMSecsSinceEpoch())
+            .arg(activity.unreadCount)
+            .arg(activity.mentioned ? 1 : 0),
+        {chatId.getByteArray()}});
+}
+
+/**
+ * @brief Counts the messages of a chat that are older than a given time.
+ * @param chatId Chat to count the messages of.
+ * @param date Messages at or after this time are not counted, a null date counts all messages.
+ * @return Number of messages.
+ *
+ * Sums the per day counters kept by triggers on history, only the messages of the day of date
+ * itself are counted row by row.
+ */
 size_t History::getNumMessagesForChatBeforeDate(const ChatId& chatId, const QDateTime& date)
 {
     if (historyAccessBlocked()) {
         return 0;
     }
 
-    QString queryText = QString("SELECT COUNT(history.id) "
-                                "FROM history "
-                                "JOIN chats ON chat_id = chats.id "
-                                "WHERE chats.uuid = ?");
+    ensureDayCounts(chatId);
 
+    QString queryText;
+    QVector<QByteArray> boundParams;
     if (date.isNull()) {
-        queryText += ";";
+        queryText = QStringLiteral("SELECT COALESCE(SUM(count), 0) FROM chat_day_counts "
+                                   "WHERE chat_id = ");
+        addChatIdSubQuery(queryText, boundParams, chatId);
+        queryText += QStringLiteral(";");
     } else {
-        queryText += QString(" AND timestamp < %1;").arg(date.toMSecsSinceEpoch());
+        const qint64 timestamp = date.toMSecsSinceEpoch();
+        const qint64 day = timestamp / MS_PER_DAY;
+
+        queryText = QStringLiteral("SELECT (SELECT COALESCE(SUM(count), 0) FROM chat_day_counts "
+                                   "WHERE chat_id = ");
+        addChatIdSubQuery(queryText, boundParams, chatId);
+        queryText += QStringLiteral(" AND day < %1) + "
+                                    "(SELECT COUNT(*) FROM history WHERE chat_id = ")
+                         .arg(day);
+        addChatIdSubQuery(queryText, boundParams, chatId);
+        queryText += QStringLiteral(" AND timestamp >= %1 AND timestamp < %2);")
+                         .arg(day * MS_PER_DAY)
+                         .arg(timestamp);
     }
 
     size_t numMessages = 0;
@@ -1098,98 +1456,136 @@ size_t History::getNumMessagesForChatBeforeDate(const ChatId& chatId, const QDat
         numMessages = row[0].toLongLong();
     };
 
-    db->execNow({queryText, {chatId.getByteArray()}, rowCallback});
+    db->execNow({queryText, boundParams, rowCallback});
 
     return numMessages;
 }
 
-QList<History::HistMessage> History::getMessagesForChat(const ChatId& chatId, size_t firstIdx,
+/**
+ * @brief Fetches a range of messages of a chat by their position.
+ * @param chatId Chat to fetch the messages of.
+ * @param firstIdx Position of the first message, counted from the oldest one.
+ * @param lastIdx Position after the last message.
+ * @return Messages in chronological order.
+ *
+ * @note The offset makes SQLite walk all earlier rows, prefer getMessagesForChatBefore when
+ * paging backwards through a chat.
+ */
+QVector<History::HistMessage> History::getMessagesForChat(const ChatId& chatId, size_t firstIdx,
                                                           size_t lastIdx)
 {
     if (historyAccessBlocked()) {
         return {};
     }
 
-    QList<HistMessage> messages;
+    return queryMessagesForChat(chatId, QStringLiteral(" LIMIT %1 OFFSET %2;")
+                                            .arg(lastIdx - firstIdx)
+                                            .arg(firstIdx));
+}
 
-    auto rowCallback = [&chatId, &messages](const QVector<QVariant>& row) {
+/**
+ * @brief Fetches the messages of a chat that directly precede a given message.
+ * @param chatId Chat to fetch the messages of.
+ * @param beforeId Only messages older than this one are returned, RowId{-1} for the newest
+ * messages of the chat.
+ * @param count Maximum number of messages to return.
+ * @return Messages in chronological order.
+ *
+ * Seeks through the chat_id index by history.id, so a page costs the same no matter how far
+ * back in the chat it is.
+ */
+QVector<History::HistMessage> History::getMessagesForChatBefore(const ChatId& chatId,
+                                                                RowId beforeId, size_t count)
+{
+    if (historyAccessBlocked() || count == 0) {
+        return {};
+    }
+
+    QString suffix;
+    if (beforeId.get() >= 0) {
+        suffix += QStringLiteral(" AND history.id < %1").arg(beforeId.get());
+    }
+    suffix += QStringLiteral(" ORDER BY history.id DESC LIMIT %1;").arg(count);
+
+    auto messages = queryMessagesForChat(chatId, suffix);
+    std::reverse(messages.begin(), messages.end());
+    return messages;
+}
+
+QVector<History::HistMessage> History::queryMessagesForChat(const ChatId& chatId,
+                                                            const QString& querySuffix)
+{
+    QVector<HistMessage> messages;
+    const ChatIdPtr chat{chatId.clone()};
+
+    auto rowCallback = [&chat, &messages](const RawDatabase::Row& row) {
         // If the select statement is changed please update these constants
         constexpr auto messageOffset = 6;
         constexpr auto fileOffset = 7;
         constexpr auto senderOffset = 13;
         constexpr auto systemOffset = 16;
 
-        auto it = row.begin();
-
-        const auto id = RowId{(*it++).toLongLong()};
-        const auto messageType = (*it++).toString();
-        const auto timestamp = QDateTime::fromMSecsSinceEpoch((*it++).toLongLong());
-        const auto isPending = !(*it++).isNull();
+        const auto id = row.get<RowId>(0);
+        const auto messageType = row.getRawBlob(1);
+        const auto timestamp = QDateTime::fromMSecsSinceEpoch(row.get<int64_t>(2));
+        const auto isPending = !row.isNull(3);
         // If NULL this should just reutrn 0 which is an empty extension set, good enough for now
-        const auto requiredExtensions = ExtensionSet((*it++).toLongLong());
-        const auto isBroken = !(*it++).isNull();
+        const auto requiredExtensions = ExtensionSet(row.get<int64_t>(4));
+        const auto isBroken = !row.isNull(5);
         const auto messageState = getMessageState(isPending, isBroken);
 
-        // Intentionally arrange query so message types are at the end so we don't have to think
-        // about the iterator jumping around after handling the different types.
         assert(messageType.size() == 1);
-        switch (messageType[0].toLatin1()) {
+        switch (messageType.isEmpty() ? 'S' : messageType[0]) {
         case 'T': {
-            it = std::next(row.begin(), messageOffset);
-            assert(!it->isNull());
-            auto messageContent = (*it++).toString();
-            it = std::next(row.begin(), senderOffset);
-            const auto senderKey = ToxPk{(*it++).toByteArray()};
-            const auto senderName = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            const auto ngc_msgid2 = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            // qDebug() << QString("getMessagesForChat:ngc_msgid:") << ngc_msgid2.left(16);
+            assert(!row.isNull(messageOffset));
+            auto messageContent = row.get<QString>(messageOffset);
+            const auto senderKey = ToxPk{row.getRawBlob(senderOffset)};
+            const auto senderName = fromUtf8WithoutNulls(row, senderOffset + 1);
+            const auto ngc_msgid2 = fromUtf8WithoutNulls(row, senderOffset + 2);
             if (messageContent.size() == 0)
             {
                 messageContent = "___";
             }
-            HistMessage h = HistMessage(id, messageState, requiredExtensions, timestamp,
-                            chatId.clone(), senderName, senderKey, messageContent, ngc_msgid2);
-            // qDebug() << QString("getMessagesForChat:ngcMsgid:") << h.ngcMsgid.left(16);
-            messages += h;
+            messages.append(HistMessage(id, messageState, requiredExtensions, timestamp, chat,
+                                        senderName, senderKey, messageContent, ngc_msgid2));
             break;
         }
         case 'F': {
-            it = std::next(row.begin(), fileOffset);
-            assert(!it->isNull());
+            assert(!row.isNull(fileOffset));
             const auto fileKind = TOX_FILE_KIND_DATA;
-            const auto resumeFileId = (*it++).toByteArray();
-            const auto fileName = (*it++).toString();
-            const auto filePath = (*it++).toString();
-            const auto filesize = (*it++).toLongLong();
-            const auto direction = static_cast<ToxFile::FileDirection>((*it++).toLongLong());
-            const auto status = static_cast<ToxFile::FileStatus>((*it++).toLongLong());
-
-            ToxFile file(0, 0, fileName, filePath, filesize, direction, fileKind);
+            QByteArray resumeFileId;
+            QString fileName;
+            QString filePath;
+            int64_t filesize;
+            int64_t direction;
+            int64_t status;
+            row.read(fileOffset, resumeFileId, fileName, filePath, filesize, direction, status);
+
+            ToxFile file(0, 0, fileName, filePath, filesize,
+                         static_cast<ToxFile::FileDirection>(direction), fileKind);
             file.resumeFileId = resumeFileId;
-            file.status = status;
+            file.status = static_cast<ToxFile::FileStatus>(status);
 
-            it = std::next(row.begin(), senderOffset);
-            const auto senderKey = ToxPk{(*it++).toByteArray()};
-            const auto senderName = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-            messages += HistMessage(id, messageState, timestamp, chatId.clone(), senderName,
-                                    senderKey, file);
+            const auto senderKey = ToxPk{row.getRawBlob(senderOffset)};
+            const auto senderName = fromUtf8WithoutNulls(row, senderOffset + 1);
+            messages.append(HistMessage(id, messageState, timestamp, chat, senderName, senderKey,
+                                        std::move(file)));
             break;
         }
         default:
         case 'S':
-            it = std::next(row.begin(), systemOffset);
-            assert(!it->isNull());
+            assert(!row.isNull(systemOffset));
             SystemMessage systemMessage;
-            systemMessage.messageType = static_cast<SystemMessageType>((*it++).toLongLong());
+            systemMessage.messageType =
+                static_cast<SystemMessageType>(row.get<int64_t>(systemOffset));
             systemMessage.timestamp = timestamp;
 
-            auto argEnd = std::next(it, systemMessage.args.size());
-            std::transform(it, argEnd, systemMessage.args.begin(), [](const QVariant& arg) {
-                return QString::fromUtf8(arg.toByteArray().replace('\0', ""));
-            });
-            it = argEnd;
+            for (size_t i = 0; i < systemMessage.args.size(); ++i) {
+                const auto col = systemOffset + 1 + static_cast<int>(i);
+                systemMessage.args[i] = fromUtf8WithoutNulls(row, col);
+            }
 
-            messages += HistMessage(id, timestamp, chatId.clone(), systemMessage);
+            messages.append(HistMessage(id, timestamp, chat, std::move(systemMessage)));
             break;
         }
     };
@@ -1215,62 +1611,120 @@ QList<History::HistMessage> History::getMessagesForChat(const ChatId& chatId, si
             "WHERE history.chat_id = ");
     QVector<QByteArray> boundParams;
     addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(
-            " LIMIT %1 OFFSET %2;")
-            .arg(lastIdx - firstIdx)
-            .arg(firstIdx);
+    queryString += querySuffix;
     db->execNow({queryString, boundParams, rowCallback});
 
     return messages;
 }
 
-QList<History::HistMessage> History::getUndeliveredMessagesForChat(const ChatId& chatId)
+QVector<History::HistMessage> History::getUndeliveredMessagesForChat(const ChatId& chatId)
 {
     if (historyAccessBlocked()) {
         return {};
     }
 
-    QList<History::HistMessage> ret;
-    auto rowCallback = [&chatId, &ret](const QVector<QVariant>& row) {
-        auto it = row.begin();
-        // dispName and message could have null bytes, QString::fromUtf8
-        // truncates on null bytes so we strip them
-        auto id = RowId{(*it++).toLongLong()};
-        auto timestamp = QDateTime::fromMSecsSinceEpoch((*it++).toLongLong());
-        auto isPending = !(*it++).isNull();
-        auto extensionSet = ExtensionSet((*it++).toLongLong());
-        auto isBroken = !(*it++).isNull();
-        auto messageContent = (*it++).toString();
-        auto senderKey = ToxPk{(*it++).toByteArray()};
-        auto displayName = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-        auto ngc_msgid3 = QString::fromUtf8((*it++).toByteArray().replace('\0', ""));
-
-        MessageState messageState = getMessageState(isPending, isBroken);
-
-        ret += {id,          messageState, extensionSet,  timestamp, chatId.clone(),
-                displayName, senderKey,    messageContent, ngc_msgid3};
+    const ChatIdPtr chat{chatId.clone()};
+    if (undeliveredPreloaded) {
+        QVector<HistMessage> ret = preloadedUndelivered.take(chatId.getByteArray());
+        for (HistMessage& message : ret) {
+            message.chat = chat;
+        }
+        return ret;
+    }
+
+    QVector<History::HistMessage> ret;
+    auto rowCallback = [&chat, &ret](const RawDatabase::Row& row) {
+        ret.append(undeliveredMessageFromRow(row, chat));
     };
 
-    QString queryString =
-        QStringLiteral(
-            "SELECT history.id, history.timestamp, faux_offline_pending.id, "
-            "    faux_offline_pending.required_extensions, broken_messages.id, text_messages.message, "
-            "    authors.public_key as sender_key, aliases.display_name, text_messages.ngc_msgid "
-            "FROM history "
-            "JOIN text_messages ON history.id = text_messages.id "
-            "JOIN aliases ON text_messages.sender_alias = aliases.id "
-            "JOIN authors ON aliases.owner = authors.id "
-            "JOIN faux_offline_pending ON faux_offline_pending.id = history.id "
-            "LEFT JOIN broken_messages ON broken_messages.id = history.id "
-            "WHERE history.chat_id = ");
+    QString queryString = undeliveredMessagesQuery() + QStringLiteral("AND history.chat_id = ");
     QVector<QByteArray> boundParams;
     addChatIdSubQuery(queryString, boundParams, chatId);
-    queryString += QStringLiteral(" AND history.message_type = 'T';");
+    queryString += QStringLiteral(" ORDER BY history.id;");
     db->execNow({queryString, boundParams, rowCallback});
 
     return ret;
 }
 
+/**
+ * @brief Fetches the undelivered messages of all chats with a single query.
+ *
+ * Until clearPreloadedUndeliveredMessages() is called, getUndeliveredMessagesForChat() hands out
+ * the messages of a chat from this result instead of querying the database for every chat.
+ * Used while the friend list is built at startup, where every ChatHistory asks for its unsent
+ * messages.
+ */
+void History::preloadUndeliveredMessages()
+{
+    if (historyAccessBlocked()) {
+        return;
+    }
+
+    QHash<QByteArray, QVector<HistMessage>> byChat;
+    auto rowCallback = [&byChat](const RawDatabase::Row& row) {
+        byChat[row.getRawBlob(UNDELIVERED_CHAT_UUID_COLUMN)].append(
+            undeliveredMessageFromRow(row, {}));
+    };
+
+    db->execNow({undeliveredMessagesQuery() + QStringLiteral(" ORDER BY history.id;"),
+                 rowCallback});
+
+    preloadedUndelivered = std::move(byChat);
+    undeliveredPreloaded = true;
+}
+
+/**
+ * @brief Drops what preloadUndeliveredMessages() fetched and wasn't taken by a chat.
+ *
+ * getUndeliveredMessagesForChat() queries the database again afterwards.
+ */
+void History::clearPreloadedUndeliveredMessages()
+{
+    preloadedUndelivered.clear();
+    undeliveredPreloaded = false;
+}
+
+/**
+ * @brief Returns the query of all undelivered text messages, to be extended by a condition
+ * starting with AND.
+ */
+QString History::undeliveredMessagesQuery()
+{
+    // Don't forget to update undeliveredMessageFromRow if you change the selected columns!
+    return QStringLiteral(
+        "SELECT history.id, history.timestamp, faux_offline_pending.id, "
+        "    faux_offline_pending.required_extensions, broken_messages.id, text_messages.message, "
+        "    authors.public_key as sender_key, aliases.display_name, text_messages.ngc_msgid, "
+        "    chats.uuid "
+        "FROM history "
+        "JOIN chats ON history.chat_id = chats.id "
+        "JOIN text_messages ON history.id = text_messages.id "
+        "JOIN aliases ON text_messages.sender_alias = aliases.id "
+        "JOIN authors ON aliases.owner = authors.id "
+        "JOIN faux_offline_pending ON faux_offline_pending.id = history.id "
+        "LEFT JOIN broken_messages ON broken_messages.id = history.id "
+        "WHERE history.message_type = 'T' ");
+}
+
+History::HistMessage History::undeliveredMessageFromRow(const RawDatabase::Row& row,
+                                                        const ChatIdPtr& chat)
+{
+    auto id = row.get<RowId>(0);
+    auto timestamp = QDateTime::fromMSecsSinceEpoch(row.get<int64_t>(1));
+    auto isPending = !row.isNull(2);
+    auto extensionSet = ExtensionSet(row.get<int64_t>(3));
+    auto isBroken = !row.isNull(4);
+    auto messageContent = row.get<QString>(5);
+    auto senderKey = ToxPk{row.getRawBlob(6)};
+    auto displayName = fromUtf8WithoutNulls(row, 7);
+    auto ngc_msgid3 = fromUtf8WithoutNulls(row, 8);
+
+    MessageState messageState = getMessageState(isPending, isBroken);
+
+    return HistMessage(id, messageState, extensionSet, timestamp, chat, displayName, senderKey,
+                       messageContent, ngc_msgid3);
+}
+
 /**
  * @brief Search phrase in chat messages
  * @param chatId Chat ID
@@ -1287,12 +1741,25 @@ QDateTime History::getDateWhereFindPhrase(const ChatId& chatId, const QDateTime&
     }
 
     QDateTime result;
-    auto rowCallback = [&result](const QVector<QVariant>& row) {
-        result = QDateTime::fromMSecsSinceEpoch(row[0].toLongLong());
+    auto rowCallback = [&result](const RawDatabase::Row& row) {
+        result = QDateTime::fromMSecsSinceEpoch(row.get<int64_t>(0));
     };
 
     phrase.replace("'", "''");
 
+    // Whole word matches always contain the words of the phrase as adjacent tokens, so the full
+    // text index can narrow the rows down before the regex confirms the match. Substring and
+    // arbitrary regex searches can't be answered from tokens and still scan.
+    QString wordsIndexFilter;
+    const bool hasWordChars = std::any_of(phrase.begin(), phrase.end(),
+                                          [](const QChar& c) { return c.isLetterOrNumber(); });
+    if (hasFullTextIndex && hasWordChars) {
+        const QString ftsPhrase = QString(phrase).replace('"', QStringLiteral("\"\""));
+        wordsIndexFilter = QStringLiteral("text_messages.id IN (SELECT rowid FROM text_messages_fts "
+                                          "WHERE text_messages_fts MATCH '\"%1\"') AND ")
+                               .arg(ftsPhrase);
+    }
+
     QString message;
 
     switch (parameter.filter) {
@@ -1300,18 +1767,20 @@ QDateTime History::getDateWhereFindPhrase(const ChatId& chatId, const QDateTime&
         message = QStringLiteral("text_messages.message LIKE '%%1%'").arg(phrase);
         break;
     case FilterSearch::WordsOnly:
-        message = QStringLiteral("text_messages.message REGEXP '%1'")
-                      .arg(SearchExtraFunctions::generateFilterWordsOnly(phrase).toLower());
+        message = wordsIndexFilter
+                  + QStringLiteral("text_messages.message REGEXP '%1'")
+                        .arg(SearchExtraFunctions::generateFilterWordsOnly(phrase).toLower());
         break;
     case FilterSearch::RegisterAndWordsOnly:
-        message = QStringLiteral("REGEXPSENSITIVE(text_messages.message, '%1')")
-                      .arg(SearchExtraFunctions::generateFilterWordsOnly(phrase));
+        message = wordsIndexFilter
+                  + QStringLiteral("REGEXPSENSITIVE('%1', text_messages.message)")
+                        .arg(SearchExtraFunctions::generateFilterWordsOnly(phrase));
         break;
     case FilterSearch::Regular:
         message = QStringLiteral("text_messages.message REGEXP '%1'").arg(phrase);
         break;
     case FilterSearch::RegisterAndRegular:
-        message = QStringLiteral("REGEXPSENSITIVE(text_messages.message '%1')").arg(phrase);
+        message = QStringLiteral("REGEXPSENSITIVE('%1', text_messages.message)").arg(phrase);
         break;
     default:
         message = QStringLiteral("LOWER(text_messages.message) LIKE '%%1%'").arg(phrase.toLower());
@@ -1381,6 +1850,8 @@ QDateTime History::getDateWhereFindPhrase(const ChatId& chatId, const QDateTime&
  * have an API that can be used to get the first item after a date (for search) and to get a list
  * of date changes (for loadHistory). We could write two separate queries but the query is fairly
  * intricate compared to our other ones so reducing duplication of it is preferable.
+ * @note Days are read from the chat_day_counts index, so this costs the same no matter how many
+ * messages the chat has.
  */
 QList<History::DateIdx> History::getNumMessagesForChatBeforeDateBoundaries(const ChatId& chatId,
                                                                              const QDate& from,
@@ -1390,48 +1861,48 @@ QList<History::DateIdx> History::getNumMessagesForChatBeforeDateBoundaries(const
         return {};
     }
 
+    ensureDayCounts(chatId);
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    const qint64 fromDay = QDateTime(from.startOfDay()).toMSecsSinceEpoch() / MS_PER_DAY;
+#else
+    const qint64 fromDay = QDateTime(from).toMSecsSinceEpoch() / MS_PER_DAY;
+#endif
+
+    // Both queries read the day buckets maintained by triggers on history, the index of the
+    // first message of a day is the number of messages on all days before it.
+    size_t numMessagesBefore = 0;
+    QVector<RawDatabase::Query> queries;
+
+    QString queryText = QStringLiteral("SELECT COALESCE(SUM(count), 0) FROM chat_day_counts "
+                                       "WHERE chat_id = ");
+    QVector<QByteArray> boundParams;
+    addChatIdSubQuery(queryText, boundParams, chatId);
+    queryText += QStringLiteral(" AND day < %1;").arg(fromDay);
+    queries += RawDatabase::Query{queryText, boundParams,
+                                  [&numMessagesBefore](const RawDatabase::Row& row) {
+                                      numMessagesBefore = row.get<int64_t>(0);
+                                  }};
+
     QList<DateIdx> dateIdxs;
-    auto rowCallback = [&dateIdxs](const QVector<QVariant>& row) {
+    auto rowCallback = [&dateIdxs, &numMessagesBefore](const RawDatabase::Row& row) {
         DateIdx dateIdx;
-        dateIdx.numMessagesIn = row[0].toLongLong();
-        dateIdx.date =
-            QDateTime::fromMSecsSinceEpoch(row[1].toLongLong() * 24 * 60 * 60 * 1000).date();
+        dateIdx.date = QDateTime::fromMSecsSinceEpoch(row.get<int64_t>(0) * MS_PER_DAY).date();
+        dateIdx.firstId = row.get<RowId>(1);
+        dateIdx.numMessagesIn = numMessagesBefore;
+        numMessagesBefore += row.get<int64_t>(2);
         dateIdxs.append(dateIdx);
     };
 
-    // No guarantee that this is the most efficient way to do this...
-    // We want to count messages that happened for a friend before a
-    // certain date. We do this by re-joining our table a second time
-    // but this time with the only filter being that our id is less than
-    // the ID of the corresponding row in the table that is grouped by day
-    auto countMessagesForFriend =
-        QStringLiteral("SELECT COUNT(*) - 1 " // Count - 1 corresponds to 0 indexed message id for friend
-                "FROM history countHistory "            // Import unfiltered table as countHistory
-                "JOIN chats ON chat_id = chats.id " // link chat_id to chat.id
-                "WHERE chats.uuid = ?"          // filter this conversation
-                "AND countHistory.id <= history.id"); // and filter that our unfiltered table history id only has elements up to history.id
-
-    auto limitString = (maxNum) ? QString("LIMIT %1").arg(maxNum) : QString("");
-
-    auto query = RawDatabase::Query(QStringLiteral(
-                        "SELECT (%1), (timestamp / 1000 / 60 / 60 / 24) AS day "
-                               "FROM history "
-                               "JOIN chats ON chat_id = chats.id "
-                               "WHERE chats.uuid = ? "
-                               "AND timestamp >= %2 "
-                               "GROUP by day "
-                               "%3;")
-                           .arg(countMessagesForFriend)
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-                           .arg(QDateTime(from.startOfDay()).toMSecsSinceEpoch())
-#else
-                           .arg(QDateTime(from).toMSecsSinceEpoch())
-#endif
-                           .arg(limitString),
-                           {chatId.getByteArray(), chatId.getByteArray()},
-                           rowCallback);
+    auto limitString = (maxNum) ? QString(" LIMIT %1").arg(maxNum) : QString("");
 
-    db->execNow(query);
+    queryText = QStringLiteral("SELECT day, first_id, count FROM chat_day_counts WHERE chat_id = ");
+    boundParams.clear();
+    addChatIdSubQuery(queryText, boundParams, chatId);
+    queryText += QStringLiteral(" AND day >= %1 ORDER BY day%2;").arg(fromDay).arg(limitString);
+    queries += RawDatabase::Query{queryText, boundParams, rowCallback};
+
+    db->execNow(queries);
 
     return dateIdxs;
 }
@@ -22,21 +22,33 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QHash>
+#include <QMutex>
 #include <QPointer>
+#include <QSet>
+#include <QTimer>
 #include <QVector>
 
 #include <cassert>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
 #include <tox/toxencryptsave.h>
 
 #include "src/core/extension.h"
+#include "src/core/ifileresumestore.h"
+#include "src/core/ngcsyncindex.h"
 #include "src/core/toxfile.h"
 #include "src/core/toxpk.h"
 #include "src/model/brokenmessagereason.h"
+#include "src/model/chatactivity.h"
 #include "src/model/systemmessage.h"
+#include "src/persistence/db/dbbackfill.h"
 #include "src/persistence/db/rawdatabase.h"
 #include "src/widget/searchtypes.h"
 
+class BlobStore;
 class Profile;
 class HistoryKeeper;
 class Settings;
@@ -50,24 +62,65 @@ enum class HistMessageContentType
     system,
 };
 
+/**
+ * @brief Holds one of the message, file or system payloads by value, copies and moves don't
+ * allocate a node for the payload
+ */
 class HistMessageContent
 {
 public:
-    HistMessageContent(QString message)
-        : data(std::make_shared<QString>(std::move(message)))
-        , type(HistMessageContentType::message)
+    HistMessageContent(QString message_)
+        : type(HistMessageContentType::message)
+        , message(std::move(message_))
     {}
 
-    HistMessageContent(ToxFile file)
-        : data(std::make_shared<ToxFile>(std::move(file)))
-        , type(HistMessageContentType::file)
+    HistMessageContent(ToxFile file_)
+        : type(HistMessageContentType::file)
+        , file(std::move(file_))
     {}
 
-    HistMessageContent(SystemMessage systemMessage)
-        : data(std::make_shared<SystemMessage>(std::move(systemMessage)))
-        , type(HistMessageContentType::system)
+    HistMessageContent(SystemMessage systemMessage_)
+        : type(HistMessageContentType::system)
+        , systemMessage(std::move(systemMessage_))
     {}
 
+    HistMessageContent(const HistMessageContent& other)
+        : type(other.type)
+    {
+        construct(other);
+    }
+
+    HistMessageContent(HistMessageContent&& other)
+        : type(other.type)
+    {
+        construct(std::move(other));
+    }
+
+    HistMessageContent& operator=(const HistMessageContent& other)
+    {
+        if (this != &other) {
+            destroy();
+            type = other.type;
+            construct(other);
+        }
+        return *this;
+    }
+
+    HistMessageContent& operator=(HistMessageContent&& other)
+    {
+        if (this != &other) {
+            destroy();
+            type = other.type;
+            construct(std::move(other));
+        }
+        return *this;
+    }
+
+    ~HistMessageContent()
+    {
+        destroy();
+    }
+
     HistMessageContentType getType() const
     {
         return type;
@@ -76,43 +129,79 @@ public:
     QString& asMessage()
     {
         assert(type == HistMessageContentType::message);
-        return *static_cast<QString*>(data.get());
+        return message;
     }
 
     ToxFile& asFile()
     {
         assert(type == HistMessageContentType::file);
-        return *static_cast<ToxFile*>(data.get());
+        return file;
     }
 
     SystemMessage& asSystemMessage()
     {
         assert(type == HistMessageContentType::system);
-        return *static_cast<SystemMessage*>(data.get());
+        return systemMessage;
     }
 
     const QString& asMessage() const
     {
         assert(type == HistMessageContentType::message);
-        return *static_cast<QString*>(data.get());
+        return message;
     }
 
     const ToxFile& asFile() const
     {
         assert(type == HistMessageContentType::file);
-        return *static_cast<ToxFile*>(data.get());
+        return file;
     }
 
     const SystemMessage& asSystemMessage() const
     {
         assert(type == HistMessageContentType::system);
-        return *static_cast<SystemMessage*>(data.get());
+        return systemMessage;
     }
 
 private:
-    // Not really shared but shared_ptr has support for shared_ptr<void>
-    std::shared_ptr<void> data;
+    // type must already be the one of other
+    template <typename Content>
+    void construct(Content&& other)
+    {
+        switch (type) {
+        case HistMessageContentType::message:
+            new (&message) QString(std::forward<Content>(other).message);
+            break;
+        case HistMessageContentType::file:
+            new (&file) ToxFile(std::forward<Content>(other).file);
+            break;
+        case HistMessageContentType::system:
+            new (&systemMessage) SystemMessage(std::forward<Content>(other).systemMessage);
+            break;
+        }
+    }
+
+    void destroy()
+    {
+        switch (type) {
+        case HistMessageContentType::message:
+            message.~QString();
+            break;
+        case HistMessageContentType::file:
+            file.~ToxFile();
+            break;
+        case HistMessageContentType::system:
+            systemMessage.~SystemMessage();
+            break;
+        }
+    }
+
     HistMessageContentType type;
+    union
+    {
+        QString message;
+        ToxFile file;
+        SystemMessage systemMessage;
+    };
 };
 
 struct FileDbInsertionData
@@ -135,38 +224,40 @@ enum class MessageState
     broken
 };
 
-class History : public QObject, public std::enable_shared_from_this<History>
+class History : public QObject,
+                public IFileResumeStore,
+                public std::enable_shared_from_this<History>
 {
     Q_OBJECT
 public:
     struct HistMessage
     {
-        HistMessage(RowId id_, MessageState state_, ExtensionSet extensionSet_, QDateTime timestamp_, std::unique_ptr<ChatId> chat_,
+        HistMessage(RowId id_, MessageState state_, ExtensionSet extensionSet_, QDateTime timestamp_, ChatIdPtr chat_,
                     QString dispName_, ToxPk sender_, QString message, QString ngc_msgid_)
             : chat{std::move(chat_)}
-            , sender{sender_}
-            , dispName{dispName_}
+            , sender{std::move(sender_)}
+            , dispName{std::move(dispName_)}
             , timestamp{timestamp_}
             , id{id_}
             , state{state_}
             , extensionSet(extensionSet_)
             , content(std::move(message))
-            , ngcMsgid{ngc_msgid_}
+            , ngcMsgid{std::move(ngc_msgid_)}
         {
         }
 
-        HistMessage(RowId id_, MessageState state_, QDateTime timestamp_, std::unique_ptr<ChatId> chat_, QString dispName_,
+        HistMessage(RowId id_, MessageState state_, QDateTime timestamp_, ChatIdPtr chat_, QString dispName_,
                     ToxPk sender_, ToxFile file)
             : chat{std::move(chat_)}
-            , sender{sender_}
-            , dispName{dispName_}
+            , sender{std::move(sender_)}
+            , dispName{std::move(dispName_)}
             , timestamp{timestamp_}
             , id{id_}
             , state{state_}
             , content(std::move(file))
         {}
 
-        HistMessage(RowId id_, QDateTime timestamp_, std::unique_ptr<ChatId> chat_, SystemMessage systemMessage)
+        HistMessage(RowId id_, QDateTime timestamp_, ChatIdPtr chat_, SystemMessage systemMessage)
             : chat{std::move(chat_)}
             , timestamp{timestamp_}
             , id{id_}
@@ -174,33 +265,8 @@ public:
             , content(std::move(systemMessage))
         {}
 
-        HistMessage(const History::HistMessage& other)
-            : chat{other.chat->clone()}
-            , sender{other.sender}
-            , dispName{other.dispName}
-            , timestamp{other.timestamp}
-            , id{other.id}
-            , state{other.state}
-            , extensionSet{other.extensionSet}
-            , content{other.content}
-            , ngcMsgid{other.ngcMsgid}
-        {}
-
-        HistMessage& operator=(const HistMessage& other)
-        {
-            chat = other.chat->clone();
-            sender = other.sender;
-            dispName = other.dispName;
-            timestamp = other.timestamp;
-            id = other.id;
-            state = other.state;
-            extensionSet = other.extensionSet;
-            content = other.content;
-            ngcMsgid = other.ngcMsgid;
-            return *this;
-        }
-
-        std::unique_ptr<ChatId> chat;
+        // shared by all messages of a query, every row has the same chat
+        ChatIdPtr chat;
         ToxPk sender;
         QString dispName;
         QDateTime timestamp;
@@ -215,10 +281,12 @@ public:
     {
         QDate date;
         size_t numMessagesIn;
+        RowId firstId;
     };
 
 public:
-    History(std::shared_ptr<RawDatabase> db, Settings& settings, IMessageBoxManager& messageBoxManager);
+    History(std::shared_ptr<RawDatabase> db, Settings& settings, IMessageBoxManager& messageBoxManager,
+            const std::function<void(int, int)>& upgradeProgress = {});
     ~History();
 
     bool isValid();
@@ -227,13 +295,17 @@ public:
 
     void eraseHistory();
     void removeChatHistory(const ChatId& chatId);
+    void moveImagesToBlobStore(BlobStore& blobStore);
     void addNewMessage(const ChatId& chatId, const QString& message, const ToxPk& sender,
                        const QDateTime& time, bool isDelivered, ExtensionSet extensions,
                        QString dispName, const std::function<void(RowId)>& insertIdCallback = {},
                        const int hasIdType = 0, const bool isPrivate = false);
+    void beginBatch();
+    void endBatch();
 
     void addPushtoken(const ToxPk& sender, const QString& pushtoken);
     QString getPushtoken(const ToxPk& friendPk);
+    QHash<ToxPk, QString> getPushtokens();
     QString getSqlcipherVersion();
     void pushtokenPing(const ToxPk& sender);
 
@@ -245,10 +317,16 @@ public:
 
     void setFileFinished(const QByteArray& fileId, bool success, const QString& filePath, const QByteArray& fileHash);
     size_t getNumMessagesForChat(const ChatId& chatId);
+    ChatActivity getChatActivity(const ChatId& chatId);
+    void setChatActivity(const ChatId& chatId, const ChatActivity& activity);
     size_t getNumMessagesForChatBeforeDate(const ChatId& chatId, const QDateTime& date);
-    QList<HistMessage> getMessagesForChat(const ChatId& chatId, size_t firstIdx, size_t lastIdx);
-    QList<HistMessage> getGroupMessagesXMinutesBack(const QByteArray& chatIdByteArray, const QDateTime& date, const ToxPk& sender, int groupnumber, int peernumber);
-    QList<HistMessage> getUndeliveredMessagesForChat(const ChatId& chatId);
+    QVector<HistMessage> getMessagesForChat(const ChatId& chatId, size_t firstIdx, size_t lastIdx);
+    QVector<HistMessage> getMessagesForChatBefore(const ChatId& chatId, RowId beforeId, size_t count);
+    QVector<QByteArray> getGroupSyncPackets(const QByteArray& chatIdByteArray, const QDateTime& date);
+    QVector<NgcSyncIndex::Entry> getNgcSyncIndex(const ChatId& chatId, const QDateTime& since);
+    QVector<HistMessage> getUndeliveredMessagesForChat(const ChatId& chatId);
+    void preloadUndeliveredMessages();
+    void clearPreloadedUndeliveredMessages();
     QDateTime getDateWhereFindPhrase(const ChatId& chatId, const QDateTime& from, QString phrase,
                                      const ParameterSearch& parameter);
     QList<DateIdx> getNumMessagesForChatBeforeDateBoundaries(const ChatId& chatId,
@@ -257,17 +335,34 @@ public:
     void markAsDelivered(RowId messageId);
     void markAsBroken(RowId messageId, BrokenMessageReason reason);
 
+    void saveFileProgress(const Entry& entry) override;
+    void removeFileProgress(const QByteArray& fileId) override;
+    QVector<Entry> getResumableFiles(const ToxPk& friendPk) override;
+
 signals:
     void fileInserted(RowId dbId, QByteArray fileId);
+    void chatDeletionBatchDone(RowId chatRowId, bool finished);
+    void groupSyncPacketsReady(int groupnumber, int peernumber, QVector<QByteArray> packets);
 
 private slots:
     void onFileInserted(RowId dbId, QByteArray fileId);
+    void deleteNextChatBatch();
+    void onChatDeletionBatchDone(RowId chatRowId, bool finished);
+    void onBackfillFinished(DbBackfill::Task task);
 
 private:
     QVector<RawDatabase::Query>
     generateNewFileTransferQueries(const ChatId& chatId, const ToxPk& sender, const QDateTime& time,
                                    const QString& dispName, const FileDbInsertionData& insertionData);
     bool historyAccessBlocked();
+    void loadPushtokens();
+    void loadChatDeletions();
+    void continueChatDeletions();
+    void ensureDayCounts(const ChatId& chatId);
+    bool fullTextIndexExists();
+    QVector<HistMessage> queryMessagesForChat(const ChatId& chatId, const QString& querySuffix);
+    static QString undeliveredMessagesQuery();
+    static HistMessage undeliveredMessageFromRow(const RawDatabase::Row& row, const ChatIdPtr& chat);
     static RawDatabase::Query generateFileFinished(RowId fileId, bool success,
                                                    const QString& filePath, const QByteArray& fileHash);
 
@@ -286,4 +381,24 @@ private:
     // This needs to be a shared pointer to avoid callback lifetime issues
     QHash<QByteArray, FileInfo> fileInfos;
     Settings& settings;
+    std::atomic_bool hasFullTextIndex{false};
+    int batchDepth = 0;
+    QVector<RawDatabase::Query> batchQueries;
+
+    static constexpr int CHAT_DELETION_BATCH_SIZE = 500;
+    static constexpr int CHAT_DELETION_INTERVAL_MS = 50;
+    QVector<RowId> pendingChatDeletions;
+    bool chatDeletionRunning = false;
+    QTimer chatDeletionTimer;
+
+    static constexpr int UNDELIVERED_CHAT_UUID_COLUMN = 9;
+    bool undeliveredPreloaded = false;
+    QHash<QByteArray, QVector<HistMessage>> preloadedUndelivered;
+
+    std::unique_ptr<DbBackfill> backfill;
+    std::atomic_bool dayCountsPending{false};
+    QMutex dayCountsLock;
+    QSet<QByteArray> dayCountedChats;
+    QMutex pushtokensLock;
+    QHash<ToxPk, QString> pushtokens;
 };
@@ -29,6 +29,24 @@
 #include <QCoreApplication>
 #include <chrono>
 
+/**
+ * @var RESEND_BATCH_SIZE
+ * @brief Messages resent at a time, a friend with hundreds of queued messages gets them spread
+ * out instead of bursting them all into toxcore's send queue
+ *
+ * @var RESEND_INTERVAL_MS
+ * @brief Pause between two resend batches
+ *
+ * @var RESEND_BACKOFF_MIN_MS
+ * @brief First wait after toxcore refused a message, doubled on every further refusal up to
+ * RESEND_BACKOFF_MAX_MS
+ */
+
+constexpr size_t OfflineMsgEngine::RESEND_BATCH_SIZE;
+constexpr int OfflineMsgEngine::RESEND_INTERVAL_MS;
+constexpr int OfflineMsgEngine::RESEND_BACKOFF_MIN_MS;
+constexpr int OfflineMsgEngine::RESEND_BACKOFF_MAX_MS;
+
 /**
 * @brief Notification that the message is now delivered.
 *
@@ -91,6 +109,167 @@ void OfflineMsgEngine::addSentExtendedMessage(ExtendedReceiptNum receipt, Messag
 std::vector<OfflineMsgEngine::RemovedMessage> OfflineMsgEngine::removeAllMessages()
 {
     QMutexLocker ml(&mutex);
+    auto messages = takeAllMessages();
+
+    auto ret = std::vector<RemovedMessage>();
+    ret.reserve(messages.size());
+
+    std::transform(messages.begin(), messages.end(), std::back_inserter(ret), [](const OfflineMessage& msg) {
+        return RemovedMessage{msg.message, msg.completionFn};
+    });
+
+    return ret;
+}
+
+/**
+* @brief Queues all tracked messages for resending, e.g. because the friend came online again.
+*
+* The messages are resent in the order they were written, in batches of RESEND_BATCH_SIZE
+* taken by takeResendBatch(). The first batch is due right away.
+*
+* @param[in] now   current time
+*/
+void OfflineMsgEngine::scheduleResend(Clock::time_point now)
+{
+    QMutexLocker ml(&mutex);
+    for (auto& message : takeAllMessages()) {
+        resendQueue.push_back(std::move(message));
+    }
+
+    nextResend = now;
+    resendBackoffMs = RESEND_BACKOFF_MIN_MS;
+}
+
+/**
+* @brief Whether messages are waiting to be resent, new messages have to queue up behind them.
+*/
+bool OfflineMsgEngine::hasPendingResends()
+{
+    QMutexLocker ml(&mutex);
+    return !resendQueue.empty();
+}
+
+/**
+* @brief Adds a message behind the messages waiting to be resent, so it doesn't overtake them.
+*/
+void OfflineMsgEngine::addResend(Message const& message, CompletionFn completionCallback)
+{
+    QMutexLocker ml(&mutex);
+    resendQueue.push_back(OfflineMessage{message, std::chrono::steady_clock::now(), completionCallback});
+}
+
+/**
+* @brief Takes the next messages to resend, if they are due.
+*
+* Every batch must be finished with completeResendBatch() before the next one is taken.
+*
+* @param[in] now   current time
+* @return Up to RESEND_BATCH_SIZE messages in order, empty if none is due yet.
+*/
+std::vector<OfflineMsgEngine::RemovedMessage> OfflineMsgEngine::takeResendBatch(Clock::time_point now)
+{
+    QMutexLocker ml(&mutex);
+    auto ret = std::vector<RemovedMessage>();
+    if (now < nextResend) {
+        return ret;
+    }
+
+    while (!resendQueue.empty() && ret.size() < RESEND_BATCH_SIZE) {
+        ret.push_back(RemovedMessage{resendQueue.front().message, resendQueue.front().completionFn});
+        resendBatch.push_back(std::move(resendQueue.front()));
+        resendQueue.pop_front();
+    }
+
+    nextResend = now + std::chrono::milliseconds(RESEND_INTERVAL_MS);
+    return ret;
+}
+
+/**
+* @brief Finishes a resend batch.
+*
+* @param[in] sentCount   number of messages of the batch that were handed to toxcore, in order.
+*                        The rest goes back to the front of the queue and is retried with
+*                        exponential backoff.
+* @param[in] now         current time
+*/
+void OfflineMsgEngine::completeResendBatch(size_t sentCount, Clock::time_point now)
+{
+    QMutexLocker ml(&mutex);
+    if (resendBatch.empty()) {
+        return;
+    }
+
+    sentCount = std::min(sentCount, resendBatch.size());
+    for (size_t i = resendBatch.size(); i > sentCount; --i) {
+        resendQueue.push_front(std::move(resendBatch[i - 1]));
+    }
+
+    const bool refused = sentCount < resendBatch.size();
+    resendBatch.clear();
+    if (!refused) {
+        resendBackoffMs = RESEND_BACKOFF_MIN_MS;
+        return;
+    }
+
+    backOffResend(now);
+}
+
+/**
+* @brief Puts messages toxcore refused after they were queued back in front of the queue.
+*
+* They are retried with exponential backoff, like the refused rest of a resend batch.
+*
+* @param[in] messages   refused messages, in order
+* @param[in] now        current time
+*/
+void OfflineMsgEngine::requeueResends(std::vector<RemovedMessage> messages, Clock::time_point now)
+{
+    QMutexLocker ml(&mutex);
+    if (messages.empty()) {
+        return;
+    }
+
+    for (size_t i = messages.size(); i > 0; --i) {
+        auto& refused = messages[i - 1];
+        resendQueue.push_front(OfflineMessage{std::move(refused.message), now, std::move(refused.callback)});
+    }
+
+    backOffResend(now);
+}
+
+void OfflineMsgEngine::backOffResend(Clock::time_point now)
+{
+    nextResend = now + std::chrono::milliseconds(resendBackoffMs);
+    resendBackoffMs = std::min(resendBackoffMs * 2, RESEND_BACKOFF_MAX_MS);
+}
+
+/**
+* @brief Time until takeResendBatch() returns messages.
+*
+* @param[in] now   current time
+* @return Milliseconds, 0 if a batch is due, -1 if nothing is waiting.
+*/
+int OfflineMsgEngine::msUntilNextResend(Clock::time_point now)
+{
+    QMutexLocker ml(&mutex);
+    if (resendQueue.empty()) {
+        return -1;
+    }
+
+    if (now >= nextResend) {
+        return 0;
+    }
+
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextResend - now);
+    // round up, so the timer doesn't fire just before the batch is due
+    return static_cast<int>(wait.count()) + 1;
+}
+
+/**
+* @brief Takes all tracked messages out of the engine, oldest first.
+*/
+std::vector<OfflineMsgEngine::OfflineMessage> OfflineMsgEngine::takeAllMessages()
+{
     auto messages = receiptResolver.clear();
     auto extendedMessages = extendedReceiptResolver.clear();
 
@@ -106,16 +285,23 @@ std::vector<OfflineMsgEngine::RemovedMessage> OfflineMsgEngine::removeAllMessage
 
     unsentMessages.clear();
 
-    std::sort(messages.begin(), messages.end(), [] (const OfflineMessage& a, const OfflineMessage& b) {
-        return a.authorshipTime < b.authorshipTime;
-    });
+    messages.insert(
+        messages.end(),
+        std::make_move_iterator(resendBatch.begin()),
+        std::make_move_iterator(resendBatch.end()));
 
-    auto ret = std::vector<RemovedMessage>();
-    ret.reserve(messages.size());
+    resendBatch.clear();
 
-    std::transform(messages.begin(), messages.end(), std::back_inserter(ret), [](const OfflineMessage& msg) {
-        return RemovedMessage{msg.message, msg.completionFn};
+    messages.insert(
+        messages.end(),
+        std::make_move_iterator(resendQueue.begin()),
+        std::make_move_iterator(resendQueue.end()));
+
+    resendQueue.clear();
+
+    std::stable_sort(messages.begin(), messages.end(), [] (const OfflineMessage& a, const OfflineMessage& b) {
+        return a.authorshipTime < b.authorshipTime;
     });
 
-    return ret;
+    return messages;
 }
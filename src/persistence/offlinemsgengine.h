@@ -31,7 +31,12 @@
 #include <QMutex>
 #include <QObject>
 #include <QSet>
+
+#include <algorithm>
 #include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
 
 
 class OfflineMsgEngine : public QObject
@@ -39,6 +44,7 @@ class OfflineMsgEngine : public QObject
     Q_OBJECT
 public:
     using CompletionFn = std::function<void(bool)>;
+    using Clock = std::chrono::steady_clock;
     OfflineMsgEngine() = default;
     void addUnsentMessage(Message const& message, CompletionFn completionCallback);
     void addSentCoreMessage(ReceiptNum receipt, Message const& message, CompletionFn completionCallback);
@@ -51,6 +57,19 @@ public:
     };
     std::vector<RemovedMessage> removeAllMessages();
 
+    void scheduleResend(Clock::time_point now);
+    bool hasPendingResends();
+    void addResend(Message const& message, CompletionFn completionCallback);
+    std::vector<RemovedMessage> takeResendBatch(Clock::time_point now);
+    void completeResendBatch(size_t sentCount, Clock::time_point now);
+    void requeueResends(std::vector<RemovedMessage> messages, Clock::time_point now);
+    int msUntilNextResend(Clock::time_point now);
+
+    static constexpr size_t RESEND_BATCH_SIZE = 10;
+    static constexpr int RESEND_INTERVAL_MS = 200;
+    static constexpr int RESEND_BACKOFF_MIN_MS = 1000;
+    static constexpr int RESEND_BACKOFF_MAX_MS = 60000;
+
 public slots:
     void onReceiptReceived(ReceiptNum receipt);
     void onExtendedReceiptReceived(ExtendedReceiptNum receipt);
@@ -63,6 +82,9 @@ private:
         CompletionFn completionFn;
     };
 
+    std::vector<OfflineMessage> takeAllMessages();
+    void backOffResend(Clock::time_point now);
+
     CompatibleRecursiveMutex mutex;
 
     template <class ReceiptT>
@@ -80,13 +102,19 @@ private:
                 return;
             }
 
-            unAckedMessages[receipt] = message;
+            // receipts count up, so this is almost always an append
+            auto it = findUnacked(receipt);
+            if (it != unAckedMessages.end() && it->first == receipt) {
+                it->second = message;
+            } else {
+                unAckedMessages.insert(it, {receipt, message});
+            }
         }
 
         void notifyReceiptReceived(ReceiptT receipt)
         {
-            auto unackedMessageIt = unAckedMessages.find(receipt);
-            if (unackedMessageIt != unAckedMessages.end()) {
+            auto unackedMessageIt = findUnacked(receipt);
+            if (unackedMessageIt != unAckedMessages.end() && unackedMessageIt->first == receipt) {
                 unackedMessageIt->second.completionFn(true);
                 unAckedMessages.erase(unackedMessageIt);
                 return;
@@ -98,12 +126,10 @@ private:
         std::vector<OfflineMessage> clear()
         {
             auto ret = std::vector<OfflineMessage>();
-            std::transform(
-                std::make_move_iterator(unAckedMessages.begin()), std::make_move_iterator(unAckedMessages.end()),
-                std::back_inserter(ret),
-                [] (const std::pair<ReceiptT, OfflineMessage>& pair) {
-                    return std::move(pair.second);
-                });
+            ret.reserve(unAckedMessages.size());
+            for (auto& unacked : unAckedMessages) {
+                ret.push_back(std::move(unacked.second));
+            }
 
             receivedReceipts.clear();
             unAckedMessages.clear();
@@ -111,10 +137,29 @@ private:
         }
 
         std::vector<ReceiptT> receivedReceipts;
-        std::map<ReceiptT, OfflineMessage> unAckedMessages;
+        // sorted by receipt, a flat table is much cheaper than a map for the usual few entries
+        std::vector<std::pair<ReceiptT, OfflineMessage>> unAckedMessages;
+
+    private:
+        typename std::vector<std::pair<ReceiptT, OfflineMessage>>::iterator
+        findUnacked(ReceiptT receipt)
+        {
+            if (unAckedMessages.empty() || unAckedMessages.back().first < receipt) {
+                return unAckedMessages.end();
+            }
+
+            return std::lower_bound(unAckedMessages.begin(), unAckedMessages.end(), receipt,
+                                    [](const std::pair<ReceiptT, OfflineMessage>& unacked,
+                                       ReceiptT r) { return unacked.first < r; });
+        }
     };
 
     ReceiptResolver<ReceiptNum> receiptResolver;
     ReceiptResolver<ExtendedReceiptNum> extendedReceiptResolver;
     std::vector<OfflineMessage> unsentMessages;
+    // waiting to be resent in order, see scheduleResend()
+    std::deque<OfflineMessage> resendQueue;
+    std::vector<OfflineMessage> resendBatch;
+    Clock::time_point nextResend;
+    int resendBackoffMs = RESEND_BACKOFF_MIN_MS;
 };
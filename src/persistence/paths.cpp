@@ -389,4 +389,11 @@ QString Paths::getBackupUserNodesFilePath() const
     return dir.filePath(nodesFileName);
 }
 
+QString Paths::getNodesCacheFilePath() const
+{
+    QDir dir(getSettingsDirPath());
+    constexpr static char nodesFileName[] = "bootstrapNodes.cache";
+    return dir.filePath(nodesFileName);
+}
+
 #endif // PATHS_VERSION_TCS_COMPLIANT
@@ -54,6 +54,7 @@ public:
     QString getExampleNodesFilePath() const;
     QString getUserNodesFilePath() const;
     QString getBackupUserNodesFilePath() const;
+    QString getNodesCacheFilePath() const;
 #endif
 
 private:
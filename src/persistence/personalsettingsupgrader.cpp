@@ -24,6 +24,7 @@
 #include <QDebug>
 
 #include <cassert>
+#include <tuple>
 
 namespace {
     bool version0to1(SettingsSerializer& ps)
@@ -43,6 +44,14 @@ namespace {
 
         return true;
     }
+
+    bool version1to2(SettingsSerializer& ps)
+    {
+        // no schema change, but from now on SettingsSerializer saves the indexed format, which
+        // older versions can't read
+        std::ignore = ps;
+        return true;
+    }
 } // namespace
 
 bool PersonalSettingsUpgrader::doUpgrade(SettingsSerializer& settingsSerializer, int fromVer, int toVer)
@@ -59,7 +68,7 @@ bool PersonalSettingsUpgrader::doUpgrade(SettingsSerializer& settingsSerializer,
     }
 
     using SettingsUpgradeFn = bool (*)(SettingsSerializer&);
-    std::vector<SettingsUpgradeFn> upgradeFns = {version0to1};
+    std::vector<SettingsUpgradeFn> upgradeFns = {version0to1, version1to2};
 
     assert(fromVer < static_cast<int>(upgradeFns.size()));
     assert(toVer == static_cast<int>(upgradeFns.size()));
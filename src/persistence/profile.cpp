@@ -21,10 +21,15 @@
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImage>
 #include <QObject>
+#include <QPointer>
 #include <QSaveFile>
 #include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
 
+#include <algorithm>
 #include <cassert>
 #include <sodium.h>
 
@@ -40,8 +45,12 @@
 #include "src/widget/tool/identicon.h"
 #include "src/widget/widget.h"
 #include "src/widget/tool/imessageboxmanager.h"
+#include "util/startupprofiler.h"
 
 namespace {
+// history syncs reach back 130 minutes, keep some margin for clock differences between peers
+const qint64 NGC_SYNC_INDEX_SECONDS = 24 * 60 * 60;
+
 enum class LoadToxDataError
 {
     OK = 0,
@@ -124,6 +133,16 @@ fail:
     return nullptr;
 }
 
+/**
+ * @brief Result of loadToxData() run on a worker thread.
+ */
+struct LoadedToxData
+{
+    QByteArray data;
+    std::unique_ptr<ToxEncrypt> key;
+    LoadToxDataError error;
+};
+
 /**
  * Create a new tox data save file.
  * @param name The name to use for the new data file.
@@ -218,6 +237,58 @@ bool logCreateToxDataError(const CreateToxDataError& error, const QString& userN
     }
     return true;
 }
+/**
+ * @brief Reads an avatar file, safe to call from any thread.
+ * @param path Path of the avatar file.
+ * @param plainPath Path of the unencrypted file, tried if an encrypted file doesn't exist.
+ * @param passkey Key to decrypt the avatar with, nullptr if the profile isn't encrypted.
+ * @return Avatar data, empty if there is none.
+ */
+QByteArray readAvatarFile(QString path, const QString& plainPath, const ToxEncrypt* passkey)
+{
+    bool avatarEncrypted = passkey != nullptr;
+    // If the encrypted avatar isn't found, try loading the unencrypted one for the same ID
+    if (avatarEncrypted && !QFile::exists(path)) {
+        avatarEncrypted = false;
+        path = plainPath;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QByteArray pic = file.readAll();
+    if (avatarEncrypted && !pic.isEmpty()) {
+        pic = passkey->decrypt(pic);
+        if (pic.isEmpty()) {
+            qWarning() << "Failed to decrypt avatar at" << path;
+        }
+    }
+
+    return pic;
+}
+
+/**
+ * @brief Decodes avatar data, safe to call from any thread.
+ * @param data Avatar data, an identicon is generated instead if empty and showIdenticons is set.
+ * @param size Size to scale to, the original size if invalid.
+ * @return The avatar, null if there is none.
+ */
+QImage decodeAvatar(const QByteArray& data, const ToxPk& owner, bool showIdenticons, QSize size)
+{
+    QImage image;
+    if (!data.isEmpty()) {
+        image.loadFromData(data);
+    } else if (showIdenticons) {
+        image = Identicon::cachedImage(owner.getByteArray(), 16);
+    }
+
+    if (!image.isNull() && size.isValid()) {
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
 } // namespace
 
 /**
@@ -232,9 +303,11 @@ bool logCreateToxDataError(const CreateToxDataError& error, const QString& userN
  */
 
 QStringList Profile::profiles;
+constexpr int Profile::AVATAR_CACHE_KB;
 
-void Profile::initCore(const QByteArray& toxsave, Settings& s, bool isNewProfile, CameraSource& cameraSource)
+void Profile::initCore(const QByteArray& toxsave, Settings& s, bool isNewProfile, CameraSource* cameraSource)
 {
+    StartupPhase phase{"Profile::initCore"};
     if (toxsave.isEmpty() && !isNewProfile) {
         qCritical() << "Existing toxsave is empty";
         emit failedToStart();
@@ -266,16 +339,19 @@ void Profile::initCore(const QByteArray& toxsave, Settings& s, bool isNewProfile
         return;
     }
 
-    coreAv = CoreAV::makeCoreAV(core->getTox(), core->getCoreLoopLock(), s, s, cameraSource);
-    if (!coreAv) {
-        qDebug() << "Failed to start ToxAV";
-        emit failedToStart();
-        return;
-    }
+    // headless profiles run without ToxAV, so they never get calls
+    if (cameraSource) {
+        coreAv = CoreAV::makeCoreAV(core->getTox(), core->getCoreLoopLock(), s, s, *cameraSource);
+        if (!coreAv) {
+            qDebug() << "Failed to start ToxAV";
+            emit failedToStart();
+            return;
+        }
 
-    // Tell Core that we run with AV before doing anything else
-    core->setAv(coreAv.get());
-    coreAv->start();
+        // Tell Core that we run with AV before doing anything else
+        core->setAv(coreAv.get());
+        coreAv->start();
+    }
 
     if (isNewProfile) {
         core->setStatusMessage(tr("Toxing on qTox"));
@@ -292,17 +368,27 @@ void Profile::initCore(const QByteArray& toxsave, Settings& s, bool isNewProfile
             Qt::ConnectionType::QueuedConnection);
     // broadcast our own avatar
     avatarBroadcaster = std::unique_ptr<AvatarBroadcaster>(new AvatarBroadcaster(*core));
+    // group images are stored off the GUI thread, BlobStore::put() is thread safe
+    BlobStore* store = blobStore.get();
+    core->setGroupImageStore([store](const QByteArray& image) { return store->put(image); });
 }
 
 Profile::Profile(const QString& name_, std::unique_ptr<ToxEncrypt> passkey_, Paths& paths_,
     Settings& settings_)
-    : name{name_}
+    : RegisteredCache("avatars")
+    , name{name_}
     , passkey{std::move(passkey_)}
     , isRemoved{false}
     , encrypted{passkey != nullptr}
     , paths{paths_}
     , settings{settings_}
-{}
+    , avatarCache{AVATAR_CACHE_KB}
+{
+    blobStore.reset(new BlobStore(getBlobDirPath(name, paths), encrypted ? passkey.get() : nullptr));
+    toxSaveWriter.reset(new ToxSaveWriter(paths.getSettingsDirPath() + name + ".tox",
+                                          [this] { return core->getToxSaveData(); }));
+    toxSaveWriter->setPasskey(encrypted ? passkey : nullptr);
+}
 
 /**
  * @brief Locks and loads an existing profile and creates the associate Core* instance.
@@ -316,34 +402,162 @@ Profile* Profile::loadProfile(const QString& name, const QString& password, Sett
                               const QCommandLineParser* parser, CameraSource& cameraSource,
                               IMessageBoxManager& messageBoxManager)
 {
-    if (ProfileLocker::hasLock()) {
-        qCritical() << "Tried to load profile " << name << ", but another profile is already locked!";
+    return openProfileFile(name, password, settings, parser, &cameraSource, messageBoxManager);
+}
+
+/**
+ * @brief Like loadProfile(), but without ToxAV, for the headless mode.
+ */
+Profile* Profile::loadHeadlessProfile(const QString& name, const QString& password,
+                                      Settings& settings, const QCommandLineParser* parser,
+                                      IMessageBoxManager& messageBoxManager)
+{
+    return openProfileFile(name, password, settings, parser, nullptr, messageBoxManager);
+}
+
+/**
+ * @brief Like loadHeadlessProfile(), but for a profile hosted next to the current one.
+ * @param settings Settings of this profile alone, they must not be shared with another profile.
+ *
+ * A relay host runs several profiles in one headless process, each with its own Core and
+ * database, see HeadlessSession.
+ */
+Profile* Profile::loadHostedProfile(const QString& name, const QString& password,
+                                    Settings& settings, const QCommandLineParser* parser,
+                                    IMessageBoxManager& messageBoxManager)
+{
+    StartupPhase phase{"Profile::loadHostedProfile"};
+    if (!ProfileLocker::lockHosted(name, settings.getPaths())) {
+        qWarning() << "Failed to lock hosted profile " << name;
         return nullptr;
     }
 
-    Paths& paths = settings.getPaths();
-    if (!ProfileLocker::lock(name, paths)) {
-        qWarning() << "Failed to lock profile " << name;
+    LoadToxDataError error;
+    QByteArray toxsave = QByteArray();
+    QString path = settings.getPaths().getSettingsDirPath() + name + ".tox";
+    std::unique_ptr<ToxEncrypt> tmpKey = loadToxData(password, path, toxsave, error);
+    if (logLoadToxDataError(error, path)) {
+        ProfileLocker::unlockHosted(name);
+        return nullptr;
+    }
+
+    Profile* p = openProfile(name, password, std::move(tmpKey), toxsave, settings, parser,
+                             nullptr, messageBoxManager);
+    p->hosted = true;
+    return p;
+}
+
+/**
+ * @brief Locks and decrypts a profile, then opens it.
+ * @param cameraSource Camera for ToxAV, nullptr to run without ToxAV.
+ */
+Profile* Profile::openProfileFile(const QString& name, const QString& password,
+                                  Settings& settings, const QCommandLineParser* parser,
+                                  CameraSource* cameraSource,
+                                  IMessageBoxManager& messageBoxManager)
+{
+    StartupPhase phase{"Profile::loadProfile"};
+    if (!lockProfile(name, settings.getPaths())) {
         return nullptr;
     }
 
     LoadToxDataError error;
     QByteArray toxsave = QByteArray();
-    QString path = paths.getSettingsDirPath() + name + ".tox";
+    QString path = settings.getPaths().getSettingsDirPath() + name + ".tox";
     std::unique_ptr<ToxEncrypt> tmpKey = loadToxData(password, path, toxsave, error);
     if (logLoadToxDataError(error, path)) {
         ProfileLocker::unlock();
         return nullptr;
     }
 
-    Profile* p = new Profile(name, std::move(tmpKey), paths, settings);
+    return openProfile(name, password, std::move(tmpKey), toxsave, settings, parser, cameraSource,
+                       messageBoxManager);
+}
+
+/**
+ * @brief Like loadProfile(), but derives the key and decrypts the tox save on a worker thread.
+ * @param name Profile name.
+ * @param password Profile password.
+ * @param context Object living on the GUI thread, onLoaded isn't called if it is destroyed.
+ * @param onLoaded Called on the GUI thread with the loaded profile, nullptr on error.
+ * @param onUpgradeProgress Called with the finished and total steps while the chat history is
+ * upgraded, see DbUpgrader::dbSchemaUpgrade.
+ *
+ * Deriving the key of an encrypted profile takes a noticeable time, this keeps the GUI
+ * responsive meanwhile. Everything else runs on the GUI thread, like in loadProfile().
+ */
+void Profile::loadProfileAsync(const QString& name, const QString& password, Settings& settings,
+                               const QCommandLineParser* parser, CameraSource& cameraSource,
+                               IMessageBoxManager& messageBoxManager, QObject* context,
+                               std::function<void(Profile*)> onLoaded,
+                               std::function<void(int, int)> onUpgradeProgress)
+{
+    if (!lockProfile(name, settings.getPaths())) {
+        onLoaded(nullptr);
+        return;
+    }
+
+    const QString path = settings.getPaths().getSettingsDirPath() + name + ".tox";
+    auto loaded = std::make_shared<LoadedToxData>();
+    auto watcher = new QFutureWatcher<void>(context);
+    connect(watcher, &QFutureWatcher<void>::finished, context,
+            [=, &settings, &cameraSource, &messageBoxManager] {
+                watcher->deleteLater();
+                if (logLoadToxDataError(loaded->error, path)) {
+                    ProfileLocker::unlock();
+                    onLoaded(nullptr);
+                    return;
+                }
+
+                StartupPhase phase{"Profile::loadProfile"};
+                onLoaded(openProfile(name, password, std::move(loaded->key), loaded->data, settings,
+                                     parser, &cameraSource, messageBoxManager, onUpgradeProgress));
+            });
+    watcher->setFuture(QtConcurrent::run([loaded, password, path] {
+        loaded->key = loadToxData(password, path, loaded->data, loaded->error);
+    }));
+}
+
+/**
+ * @brief Takes the lock of a profile before loading it.
+ * @param name Profile name.
+ * @return True if the lock is ours now.
+ */
+bool Profile::lockProfile(const QString& name, Paths& paths)
+{
+    if (ProfileLocker::hasLock()) {
+        qCritical() << "Tried to load profile " << name << ", but another profile is already locked!";
+        return false;
+    }
+
+    if (!ProfileLocker::lock(name, paths)) {
+        qWarning() << "Failed to lock profile " << name;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Creates the profile and its Core from an already decrypted tox save.
+ * @param passkey Key the tox save was encrypted with, nullptr if it wasn't encrypted.
+ * @param toxsave Decrypted tox save.
+ * @return The loaded profile.
+ */
+Profile* Profile::openProfile(const QString& name, const QString& password,
+                              std::unique_ptr<ToxEncrypt> passkey, const QByteArray& toxsave,
+                              Settings& settings, const QCommandLineParser* parser,
+                              CameraSource* cameraSource, IMessageBoxManager& messageBoxManager,
+                              const std::function<void(int, int)>& onUpgradeProgress)
+{
+    Profile* p = new Profile(name, std::move(passkey), settings.getPaths(), settings);
 
     // Core settings are saved per profile, need to load them before starting Core
     constexpr bool isNewProfile = false;
     settings.updateProfileData(p, parser, isNewProfile);
 
     p->initCore(toxsave, settings, isNewProfile, cameraSource);
-    p->loadDatabase(password, messageBoxManager);
+    p->loadDatabase(password, messageBoxManager, onUpgradeProgress);
 
     return p;
 }
@@ -375,20 +589,34 @@ Profile* Profile::createProfile(const QString& name, const QString& password, Se
     constexpr bool isNewProfile = true;
     settings.updateProfileData(p, parser, isNewProfile);
 
-    p->initCore(QByteArray(), settings, isNewProfile, cameraSource);
+    p->initCore(QByteArray(), settings, isNewProfile, &cameraSource);
     p->loadDatabase(password, messageBoxManager);
     return p;
 }
 
 Profile::~Profile()
 {
+    // core outlives blobStore and history, it must not use them any more
+    if (core) {
+        core->setGroupImageStore({});
+        core->setNgcSyncIndexLoader({});
+        core->getCoreFile()->setResumeStore(nullptr);
+    }
+
     if (isRemoved) {
         return;
     }
 
-    onSaveToxSave();
+    // write the latest state on exit, the delayed save would be dropped otherwise
+    toxSaveWriter->requestSave();
+    toxSaveWriter->flush();
     settings.savePersonal();
     settings.sync();
+    if (hosted) {
+        ProfileLocker::unlockHosted(name);
+        return;
+    }
+
     ProfileLocker::assertLock(paths);
     assert(ProfileLocker::getCurLockName() == name);
     ProfileLocker::unlock();
@@ -467,14 +695,17 @@ void Profile::startCore()
 }
 
 /**
- * @brief Saves the profile's .tox save, encrypted if needed.
- * @warning Invalid on deleted profiles.
+ * @brief Saves the profile's .tox save soon, encrypted if needed.
+ *
+ * Requests in short succession are written only once, see ToxSaveWriter.
  */
 void Profile::onSaveToxSave()
 {
-    QByteArray data = core->getToxSaveData();
-    assert(data.size());
-    saveToxSave(data);
+    if (isRemoved) {
+        return;
+    }
+
+    toxSaveWriter->requestSave();
 }
 
 // TODO(sudden6): handle this better maybe?
@@ -485,51 +716,6 @@ void Profile::onAvatarOfferReceived(uint32_t friendId, uint32_t fileId, const QB
     core->getCoreFile()->handleAvatarOffer(friendId, fileId, accept, filesize);
 }
 
-/**
- * @brief Write the .tox save, encrypted if needed.
- * @param data Byte array of profile save.
- * @return true if successfully saved, false otherwise
- * @warning Invalid on deleted profiles.
- */
-bool Profile::saveToxSave(QByteArray data)
-{
-    // qDebug() << "Profile::saveToxSave:START";
-    assert(!isRemoved);
-    ProfileLocker::assertLock(paths);
-    assert(ProfileLocker::getCurLockName() == name);
-
-    QString path = paths.getSettingsDirPath() + name + ".tox";
-    // qDebug() << "Saving tox save to " << path;
-    QSaveFile saveFile(path);
-    if (!saveFile.open(QIODevice::WriteOnly)) {
-        qCritical() << "Tox save file " << path << " couldn't be opened";
-        return false;
-    }
-
-    if (encrypted) {
-        data = passkey->encrypt(data);
-        if (data.isEmpty()) {
-            qCritical() << "Failed to encrypt, can't save!";
-            saveFile.cancelWriting();
-            return false;
-        }
-    }
-
-    saveFile.write(data);
-
-    // check if everything got written
-    if (saveFile.flush()) {
-        saveFile.commit();
-    } else {
-        saveFile.cancelWriting();
-        qCritical() << "Failed to write, can't save!";
-        return false;
-    }
-
-    // qDebug() << "Profile::saveToxSave:END";
-    return true;
-}
-
 /**
  * @brief Gets the path of the avatar file cached by this profile and corresponding to this owner
  * ID.
@@ -575,21 +761,64 @@ QPixmap Profile::loadAvatar()
  */
 QPixmap Profile::loadAvatar(const ToxPk& owner)
 {
-    QPixmap pic;
-    if (settings.getShowIdenticons()) {
+    const AvatarKey key{owner, QSize{}};
+    const QPixmap* cached = avatarCache.object(key);
+    markCacheUsed();
+    if (cached != nullptr) {
+        return *cached;
+    }
 
-        const QByteArray avatarData = loadAvatarData(owner);
-        if (avatarData.isEmpty()) {
-            pic = QPixmap::fromImage(Identicon(owner.getByteArray()).toImage(16));
-        } else {
-            pic.loadFromData(avatarData);
-        }
+    const QImage image = decodeAvatar(loadAvatarData(owner), owner, settings.getShowIdenticons(), {});
+    const QPixmap pic = QPixmap::fromImage(image);
+    cacheAvatar(key, pic);
+    return pic;
+}
 
-    } else {
-        pic.loadFromData(loadAvatarData(owner));
+/**
+ * @brief Loads a contact's avatar on a worker thread.
+ * @param owner Friend PK to load avatar.
+ * @param size Size to scale the avatar to, keeping its aspect ratio. The original size if invalid.
+ * @param context onLoaded isn't called after this object got destroyed.
+ * @param onLoaded Called with the avatar, immediately if it is cached. Not called at all if the
+ * avatar changes while loading, the change is signalled instead.
+ */
+void Profile::loadAvatarAsync(const ToxPk& owner, QSize size, QObject* context,
+                              std::function<void(const QPixmap&)> onLoaded)
+{
+    const AvatarKey avatarKey{owner, size};
+    const QPixmap* cached = avatarCache.object(avatarKey);
+    markCacheUsed();
+    if (cached != nullptr) {
+        onLoaded(*cached);
+        return;
     }
 
-    return pic;
+    const QString path = avatarPath(owner);
+    const QString plainPath = avatarPath(owner, true);
+    const std::shared_ptr<const ToxEncrypt> decryptKey = encrypted ? passkey : nullptr;
+    const bool showIdenticons = settings.getShowIdenticons();
+    const int version = avatarVersions.value(owner);
+    const QPointer<QObject> receiver{context};
+
+    auto image = std::make_shared<QImage>();
+    auto watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcher<void>::finished, this, [=] {
+        watcher->deleteLater();
+        if (avatarVersions.value(owner) != version) {
+            return;
+        }
+
+        // QPixmap can only be created on the GUI thread
+        const QPixmap pixmap = QPixmap::fromImage(*image);
+        cacheAvatar(avatarKey, pixmap);
+        if (receiver) {
+            onLoaded(pixmap);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([=] {
+        *image = decodeAvatar(readAvatarFile(path, plainPath, decryptKey.get()), owner, showIdenticons,
+                              size);
+    }));
 }
 
 /**
@@ -599,32 +828,48 @@ QPixmap Profile::loadAvatar(const ToxPk& owner)
  */
 QByteArray Profile::loadAvatarData(const ToxPk& owner)
 {
-    QString path = avatarPath(owner);
-    bool avatarEncrypted = encrypted;
-    // If the encrypted avatar isn't found, try loading the unencrypted one for the same ID
-    if (avatarEncrypted && !QFile::exists(path)) {
-        avatarEncrypted = false;
-        path = avatarPath(owner, true);
-    }
+    return readAvatarFile(avatarPath(owner), avatarPath(owner, true),
+                          encrypted ? passkey.get() : nullptr);
+}
 
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return {};
-    }
+void Profile::cacheAvatar(const AvatarKey& key, const QPixmap& pixmap)
+{
+    const int costKb = std::max(1, pixmap.width() * pixmap.height() * pixmap.depth() / 8 / 1024);
+    avatarCache.insert(key, new QPixmap(pixmap), costKb);
+}
 
-    QByteArray pic = file.readAll();
-    if (avatarEncrypted && !pic.isEmpty()) {
-        pic = passkey->decrypt(pic);
-        if (pic.isEmpty()) {
-            qWarning() << "Failed to decrypt avatar at" << path;
+RegisteredCache::Usage Profile::getCacheUsage() const
+{
+    return {static_cast<qint64>(avatarCache.totalCost()) * 1024, avatarCache.count()};
+}
+
+/**
+ * @brief Drops the least recently used avatars, they are loaded from disk again when needed.
+ */
+void Profile::trimCache(qint64 maxBytes)
+{
+    // QCache evicts down to its maximum cost right away
+    avatarCache.setMaxCost(static_cast<int>(std::min<qint64>(maxBytes / 1024, AVATAR_CACHE_KB)));
+    avatarCache.setMaxCost(AVATAR_CACHE_KB);
+}
+
+/**
+ * @brief Drops all cached sizes of an avatar and the loads still running for it.
+ */
+void Profile::invalidateAvatar(const ToxPk& owner)
+{
+    ++avatarVersions[owner];
+    for (const AvatarKey& key : avatarCache.keys()) {
+        if (key.owner == owner) {
+            avatarCache.remove(key);
         }
     }
-
-    return pic;
 }
 
-void Profile::loadDatabase(QString password, IMessageBoxManager& messageBoxManager)
+void Profile::loadDatabase(QString password, IMessageBoxManager& messageBoxManager,
+                           const std::function<void(int, int)>& onUpgradeProgress)
 {
+    StartupPhase phase{"Profile::loadDatabase"};
     assert(core);
 
     if (isRemoved) {
@@ -641,10 +886,33 @@ void Profile::loadDatabase(QString password, IMessageBoxManager& messageBoxManag
     // At this point it's too early to load the personal settings (Nexus will do it), so we always
     // load
     // the history, and if it fails we can't change the setting now, but we keep a nullptr
+    const QString cachedKey = encrypted ? settings.getDatabaseKey() : QString{};
+    const auto cipherTier = settings.getFastDatabaseEncryption()
+                                ? RawDatabase::SqlCipherTier::Performance
+                                : RawDatabase::SqlCipherTier::Default;
     database = std::make_shared<RawDatabase>(getDbPath(name, settings.getPaths()),
-        password, salt);
+        password, salt, cachedKey, cipherTier);
     if (database && database->isOpen()) {
-        history.reset(new History(database, settings, messageBoxManager));
+        if (encrypted && database->getHexKey() != cachedKey) {
+            // the key had to be derived from the password, the next login can skip that
+            settings.setDatabaseKey(database->getHexKey());
+            settings.savePersonal();
+        }
+
+        history.reset(new History(database, settings, messageBoxManager, onUpgradeProgress));
+        history->moveImagesToBlobStore(*blobStore);
+        // read on the tox thread, History only runs blocking queries on the database thread
+        History* syncHistory = history.get();
+        core->setNgcSyncIndexLoader([syncHistory](const GroupId& groupId) {
+            const auto since = QDateTime::currentDateTime().addSecs(-NGC_SYNC_INDEX_SECONDS);
+            return syncHistory->getNgcSyncIndex(groupId, since);
+        });
+        core->getCoreFile()->setResumeStore(syncHistory);
+        dbMaintenance.reset(new DbMaintenanceScheduler(database, [this] {
+            const bool inCall = coreAv && coreAv->hasCalls();
+            const bool transferring = core && core->getCoreFile()->hasActiveTransfers();
+            return !inCall && !transferring;
+        }));
     } else {
         qWarning() << "Failed to open database for profile" << name;
         messageBoxManager.showError(QObject::tr("Error"),
@@ -666,7 +934,7 @@ void Profile::setAvatar(QByteArray pic)
         avatarData = pic;
     } else {
         if (settings.getShowIdenticons()) {
-            const QImage identicon = Identicon(selfPk.getByteArray()).toImage(32);
+            const QImage identicon = Identicon::cachedImage(selfPk.getByteArray(), 32);
             pixmap = QPixmap::fromImage(identicon);
 
         } else {
@@ -696,7 +964,7 @@ void Profile::setFriendAvatar(const ToxPk& owner, QByteArray pic)
         avatarData = pic;
         emit friendAvatarSet(owner, pixmap);
     } else if (settings.getShowIdenticons()) {
-        const QImage identicon = Identicon(owner.getByteArray()).toImage(32);
+        const QImage identicon = Identicon::cachedImage(owner.getByteArray(), 32);
         pixmap = QPixmap::fromImage(identicon);
         emit friendAvatarSet(owner, pixmap);
     } else {
@@ -732,6 +1000,7 @@ void Profile::onRequestSent(const ToxPk& friendPk, const QString& message)
  */
 void Profile::saveAvatar(const ToxPk& owner, const QByteArray& avatar)
 {
+    invalidateAvatar(owner);
     const bool needEncrypt = encrypted && !avatar.isEmpty();
     const QByteArray& pic = needEncrypt ? passkey->encrypt(avatar) : avatar;
 
@@ -798,12 +1067,22 @@ History* Profile::getHistory()
     return history.get();
 }
 
+/**
+ * @brief Get the store for group images and other large message data.
+ * @return Never a nullptr, the store works without history too.
+ */
+BlobStore* Profile::getBlobStore()
+{
+    return blobStore.get();
+}
+
 /**
  * @brief Removes a cached avatar.
  * @param owner Friend PK whose avater to delete.
  */
 void Profile::removeAvatar(const ToxPk& owner)
 {
+    invalidateAvatar(owner);
     QFile::remove(avatarPath(owner));
     if (owner == core->getSelfPublicKey()) {
         setAvatar({});
@@ -853,7 +1132,7 @@ bool Profile::isEncrypted(QString name, Paths& paths)
  * @brief Removes the profile permanently.
  * Updates the profiles vector.
  * @return Vector of filenames that could not be removed.
- * @warning It is invalid to call loadToxSave or saveToxSave on a deleted profile.
+ * @warning Requests to save the tox save are ignored once the profile is removed.
  */
 QStringList Profile::remove()
 {
@@ -873,6 +1152,10 @@ QStringList Profile::remove()
     QString path = paths.getSettingsDirPath() + name;
     ProfileLocker::unlock();
 
+    // flush delayed saves now, they must not recreate the settings file later
+    settings.sync();
+    toxSaveWriter->flush();
+
     QFile profileMain{path + ".tox"};
     QFile profileConfig{path + ".ini"};
 
@@ -887,12 +1170,23 @@ QStringList Profile::remove()
         qWarning() << "Could not remove file " << profileConfig.fileName();
     }
 
+    dbMaintenance.reset();
     QString dbPath = getDbPath(name, settings.getPaths());
     if (database && database->isOpen() && !database->remove() && QFile::exists(dbPath)) {
         ret.push_back(dbPath);
         qWarning() << "Could not remove file " << dbPath;
     }
 
+    if (!blobStore->remove()) {
+        const QString blobDirPath = getBlobDirPath(name, settings.getPaths());
+        ret.push_back(blobDirPath);
+        qWarning() << "Could not remove directory " << blobDirPath;
+    }
+
+    if (core) {
+        core->setNgcSyncIndexLoader({});
+        core->getCoreFile()->setResumeStore(nullptr);
+    }
     history.reset();
     database.reset();
 
@@ -913,11 +1207,14 @@ bool Profile::rename(QString newName)
         return false;
     }
 
+    toxSaveWriter->flush();
     QFile::rename(path + ".tox", newPath + ".tox");
+    toxSaveWriter->setPath(newPath + ".tox");
     QFile::rename(path + ".ini", newPath + ".ini");
     if (database) {
         database->rename(newName);
     }
+    blobStore->rename(getBlobDirPath(newName, paths));
 
     bool resetAutorun = settings.getAutorun();
     settings.setAutorun(false);
@@ -947,6 +1244,7 @@ QString Profile::setPassword(const QString& newPassword)
     if (newPassword.isEmpty()) {
         // remove password
         encrypted = false;
+        blobStore->setPasskey(nullptr);
     } else {
         std::unique_ptr<ToxEncrypt> newpasskey = ToxEncrypt::makeToxEncrypt(newPassword);
         if (!newpasskey) {
@@ -956,19 +1254,25 @@ QString Profile::setPassword(const QString& newPassword)
                 "Failed to derive key from password, the profile won't use the new password.");
         }
         // apply change
+        blobStore->setPasskey(newpasskey.get());
         passkey = std::move(newpasskey);
         encrypted = true;
     }
 
     // apply new encryption
-    onSaveToxSave();
+    toxSaveWriter->setPasskey(encrypted ? passkey : nullptr);
+    toxSaveWriter->requestSave();
+    toxSaveWriter->flush();
 
     bool dbSuccess = false;
 
     // TODO: ensure the database and the tox save file use the same password
     if (database) {
         dbSuccess = database->setPassword(newPassword);
+        settings.setDatabaseKey(encrypted ? database->getHexKey() : QString{});
     }
+    // re-encrypt the personal settings, a pending save may still refer to the old key
+    settings.savePersonal();
 
     QString error{};
     if (!dbSuccess) {
@@ -997,3 +1301,13 @@ QString Profile::getDbPath(const QString& profileName, Paths& paths)
 {
     return paths.getSettingsDirPath() + profileName + ".db";
 }
+
+/**
+ * @brief Retrieves the path to the blob directory for a given profile.
+ * @param profileName Profile name.
+ * @return Path to the directory.
+ */
+QString Profile::getBlobDirPath(const QString& profileName, Paths& paths)
+{
+    return paths.getSettingsDirPath() + profileName + ".blobs";
+}
@@ -25,14 +25,24 @@
 
 #include "src/net/avatarbroadcaster.h"
 
+#include "src/persistence/blobstore.h"
+#include "src/persistence/db/dbmaintenancescheduler.h"
 #include "src/persistence/history.h"
+#include "src/persistence/toxsavewriter.h"
 #include "src/net/bootstrapnodeupdater.h"
 
+#include "util/cacheregistry.h"
+
 #include <QByteArray>
+#include <QCache>
+#include <QHash>
 #include <QObject>
 #include <QPixmap>
+#include <QSize>
 #include <QString>
 #include <QVector>
+
+#include <functional>
 #include <memory>
 
 class Settings;
@@ -41,7 +51,7 @@ class ToxPk;
 class CameraSource;
 class IMessageBoxManager;
 
-class Profile : public QObject
+class Profile : public QObject, public RegisteredCache
 {
     Q_OBJECT
 
@@ -49,6 +59,17 @@ public:
     static Profile* loadProfile(const QString& name, const QString& password, Settings& settings,
                                 const QCommandLineParser* parser, CameraSource& cameraSource,
                                     IMessageBoxManager& messageBoxManager);
+    static Profile* loadHeadlessProfile(const QString& name, const QString& password,
+                                        Settings& settings, const QCommandLineParser* parser,
+                                        IMessageBoxManager& messageBoxManager);
+    static Profile* loadHostedProfile(const QString& name, const QString& password,
+                                      Settings& settings, const QCommandLineParser* parser,
+                                      IMessageBoxManager& messageBoxManager);
+    static void loadProfileAsync(const QString& name, const QString& password, Settings& settings,
+                                 const QCommandLineParser* parser, CameraSource& cameraSource,
+                                 IMessageBoxManager& messageBoxManager, QObject* context,
+                                 std::function<void(Profile*)> onLoaded,
+                                 std::function<void(int, int)> onUpgradeProgress = {});
     static Profile* createProfile(const QString& name, const QString& password, Settings& settings,
                                   const QCommandLineParser* parser, CameraSource& cameraSource, IMessageBoxManager& messageBoxManager);
     ~Profile();
@@ -63,6 +84,8 @@ public:
 
     QPixmap loadAvatar();
     QPixmap loadAvatar(const ToxPk& owner);
+    void loadAvatarAsync(const ToxPk& owner, QSize size, QObject* context,
+                         std::function<void(const QPixmap&)> onLoaded);
     QByteArray loadAvatarData(const ToxPk& owner);
     void setAvatar(QByteArray pic);
     void setFriendAvatar(const ToxPk& owner, QByteArray pic);
@@ -71,6 +94,7 @@ public:
     void removeFriendAvatar(const ToxPk& owner);
     bool isHistoryEnabled();
     History* getHistory();
+    BlobStore* getBlobStore();
 
     QStringList remove();
 
@@ -81,6 +105,12 @@ public:
     static bool exists(QString name, Paths& paths);
     static bool isEncrypted(QString name, Paths& paths);
     static QString getDbPath(const QString& profileName, Paths& paths);
+    static QString getBlobDirPath(const QString& profileName, Paths& paths);
+
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
+
+    static constexpr int AVATAR_CACHE_KB = 32 * 1024;
 
 signals:
     void selfAvatarChanged(const QPixmap& pixmap);
@@ -99,7 +129,8 @@ public slots:
     void onRequestSent(const ToxPk& friendPk, const QString& message);
 
 private slots:
-    void loadDatabase(QString password, IMessageBoxManager& messageBoxManager);
+    void loadDatabase(QString password, IMessageBoxManager& messageBoxManager,
+                      const std::function<void(int, int)>& onUpgradeProgress = {});
     void saveAvatar(const ToxPk& owner, const QByteArray& avatar);
     void removeAvatar(const ToxPk& owner);
     void onSaveToxSave();
@@ -107,25 +138,63 @@ private slots:
     void onAvatarOfferReceived(uint32_t friendId, uint32_t fileId, const QByteArray& avatarHash, uint64_t filesize);
 
 private:
+    struct AvatarKey
+    {
+        ToxPk owner;
+        // invalid for the unscaled avatar
+        QSize size;
+
+        bool operator==(const AvatarKey& other) const
+        {
+            return owner == other.owner && size == other.size;
+        }
+
+        friend uint qHash(const AvatarKey& key)
+        {
+            return qHash(key.owner) ^ qHash((key.size.width() << 16) ^ key.size.height());
+        }
+    };
+
     Profile(const QString& name_, std::unique_ptr<ToxEncrypt> passkey_, Paths& paths_,
         Settings &settings_);
+    static bool lockProfile(const QString& name, Paths& paths);
+    static Profile* openProfileFile(const QString& name, const QString& password,
+                                    Settings& settings, const QCommandLineParser* parser,
+                                    CameraSource* cameraSource,
+                                    IMessageBoxManager& messageBoxManager);
+    static Profile* openProfile(const QString& name, const QString& password,
+                                std::unique_ptr<ToxEncrypt> passkey, const QByteArray& toxsave,
+                                Settings& settings, const QCommandLineParser* parser,
+                                CameraSource* cameraSource, IMessageBoxManager& messageBoxManager,
+                                const std::function<void(int, int)>& onUpgradeProgress = {});
     static QStringList getFilesByExt(QString extension, Settings& settings);
     QString avatarPath(const ToxPk& owner, bool forceUnencrypted = false);
-    bool saveToxSave(QByteArray data);
-    void initCore(const QByteArray& toxsave, Settings &s, bool isNewProfile, CameraSource& cameraSource);
+    void cacheAvatar(const AvatarKey& key, const QPixmap& pixmap);
+    void invalidateAvatar(const ToxPk& owner);
+    void initCore(const QByteArray& toxsave, Settings &s, bool isNewProfile, CameraSource* cameraSource);
 
 private:
     std::unique_ptr<AvatarBroadcaster> avatarBroadcaster;
     std::unique_ptr<Core> core;
     std::unique_ptr<CoreAV> coreAv;
     QString name;
-    std::unique_ptr<ToxEncrypt> passkey;
+    // shared with avatar loads still running when the password changes
+    std::shared_ptr<ToxEncrypt> passkey;
     std::shared_ptr<RawDatabase> database;
     std::shared_ptr<History> history;
+    std::unique_ptr<BlobStore> blobStore;
+    std::unique_ptr<DbMaintenanceScheduler> dbMaintenance;
     bool isRemoved;
     bool encrypted = false;
+    // locked with ProfileLocker::lockHosted() next to the current profile
+    bool hosted = false;
     static QStringList profiles;
     std::unique_ptr<BootstrapNodeUpdater> bootstrapNodes;
+    std::unique_ptr<ToxSaveWriter> toxSaveWriter;
     Paths& paths;
     Settings& settings;
+    // least recently used avatars, the cost is the size in KiB
+    QCache<AvatarKey, QPixmap> avatarCache;
+    // bumped on every change of an avatar, so older loads still running get dropped
+    QHash<ToxPk, int> avatarVersions;
 };
@@ -30,12 +30,16 @@
  * Only one lock can be acquired at the same time, which means
  * that there is little need for manually unlocking.
  * The current lock will expire if you exit or acquire a new one.
+ *
+ * A headless process can host more profiles next to its current one, their locks are taken
+ * with lockHosted() and kept until unlockHosted().
  */
 
 using namespace std;
 
 unique_ptr<QLockFile> ProfileLocker::lockfile;
 QString ProfileLocker::curLockName;
+std::map<QString, std::unique_ptr<QLockFile>> ProfileLocker::hostedLocks;
 
 QString ProfileLocker::lockPathFromName(const QString& name, const Paths& paths)
 {
@@ -53,7 +57,7 @@ QString ProfileLocker::lockPathFromName(const QString& name, const Paths& paths)
 bool ProfileLocker::isLockable(QString profile, Paths& paths)
 {
     // If we already have the lock, it's definitely lockable
-    if (lockfile && curLockName == profile)
+    if ((lockfile && curLockName == profile) || hostedLocks.count(profile) != 0)
         return true;
 
     QLockFile newLock(lockPathFromName(profile, paths));
@@ -150,3 +154,41 @@ QString ProfileLocker::getCurLockName()
     else
         return QString();
 }
+
+/**
+ * @brief Locks a profile hosted next to the current one, see HeadlessSession.
+ * @param profile Profile to lock, must not be the current one.
+ * @return False if the profile is in use, also if it is the current profile.
+ */
+bool ProfileLocker::lockHosted(const QString& profile, Paths& paths)
+{
+    if (hostedLocks.count(profile) != 0) {
+        return true;
+    }
+    if (lockfile && curLockName == profile) {
+        return false;
+    }
+
+    std::unique_ptr<QLockFile> newLock{new QLockFile(lockPathFromName(profile, paths))};
+    newLock->setStaleLockTime(0);
+    if (!newLock->tryLock()) {
+        return false;
+    }
+
+    hostedLocks[profile] = std::move(newLock);
+    return true;
+}
+
+/**
+ * @brief Releases the lock of a hosted profile.
+ */
+void ProfileLocker::unlockHosted(const QString& profile)
+{
+    auto it = hostedLocks.find(profile);
+    if (it == hostedLocks.end()) {
+        return;
+    }
+
+    it->second->unlock();
+    hostedLocks.erase(it);
+}
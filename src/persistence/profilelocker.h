@@ -21,6 +21,9 @@
 #pragma once
 
 #include <QLockFile>
+#include <QString>
+
+#include <map>
 #include <memory>
 
 class Paths;
@@ -38,6 +41,9 @@ public:
     static QString getCurLockName();
     static void assertLock(Paths& paths);
 
+    static bool lockHosted(const QString& profile, Paths& paths);
+    static void unlockHosted(const QString& profile);
+
 private:
     static QString lockPathFromName(const QString& name, const Paths& paths);
     static void deathByBrokenLock();
@@ -45,4 +51,5 @@ private:
 private:
     static std::unique_ptr<QLockFile> lockfile;
     static QString curLockName;
+    static std::map<QString, std::unique_ptr<QLockFile>> hostedLocks;
 };
@@ -35,7 +35,11 @@
 #endif
 #include "src/ipc.h"
 
+#include "util/cacheregistry.h"
 #include "util/compatiblerecursivemutex.h"
+#include "util/hitchwatchdog.h"
+#include "util/lockprofiler.h"
+#include "util/threadscheduling.h"
 
 #include <QApplication>
 #include <QCryptographicHash>
@@ -50,8 +54,11 @@
 #include <QStandardPaths>
 #include <QStyleFactory>
 #include <QThread>
+#include <QTimer>
 #include <QtCore/QCommandLineParser>
 
+#include <algorithm>
+
 /**
  * @var QHash<QString, QByteArray> Settings::widgetSettings
  * @brief Assume all widgets have unique names
@@ -60,11 +67,21 @@
  * which have widget->saveX() and widget->loadX() methods.
  */
 
+/**
+ * @var std::shared_ptr<const Settings::FriendMap> Settings::friendLst
+ * @brief Per-friend settings, replaced as a whole on every change.
+ *
+ * Readers take the current snapshot without locking, so looking up an alias while rendering
+ * never waits for savePersonal() to finish. Writers still hold bigLock, modify a copy and
+ * publish it with publishFriendProps().
+ */
+
 const QString Settings::globalSettingsFile = "qtox.ini";
 CompatibleRecursiveMutex Settings::bigLock;
-QThread* Settings::settingsThread{nullptr};
 static constexpr int GLOBAL_SETTINGS_VERSION = 1;
-static constexpr int PERSONAL_SETTINGS_VERSION = 1;
+static constexpr int PERSONAL_SETTINGS_VERSION = 2;
+constexpr int Settings::SAVE_DELAY_MS;
+constexpr int Settings::MAX_FRIEND_REQUESTS;
 QStringList Settings::PUSHURL_WHITELIST = QStringList()
     << "https://tox.zoff.xyz/toxfcm/fcm.php?id="
     << "https://gotify1.unifiedpush.org/UP?token="
@@ -78,8 +95,14 @@ Settings::Settings(IMessageBoxManager& messageBoxManager_)
 {
     settingsThread = new QThread();
     settingsThread->setObjectName("qTox Settings");
+    QObject::connect(settingsThread, &QThread::started, []() {
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+    });
     settingsThread->start(QThread::LowPriority);
     qRegisterMetaType<const ToxEncrypt*>("const ToxEncrypt*");
+    saveTimer.setSingleShot(true);
+    saveTimer.setInterval(SAVE_DELAY_MS);
+    connect(&saveTimer, &QTimer::timeout, this, &Settings::writePendingSaves);
     moveToThread(settingsThread);
     loadGlobal();
 }
@@ -95,7 +118,7 @@ Settings::~Settings()
 
 void Settings::loadGlobal()
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     if (loaded)
         return;
@@ -177,6 +200,9 @@ void Settings::loadGlobal()
         enableIPv6 = s.value("enableIPv6", true).toBool();
         forceTCP = s.value("forceTCP", false).toBool();
         enableLanDiscovery = s.value("enableLanDiscovery", true).toBool();
+        cacheBudgetMb =
+            s.value("cacheBudgetMb", static_cast<int>(CacheRegistry::DEFAULT_BUDGET >> 20)).toInt();
+        lowMemoryMode = s.value("lowMemoryMode", false).toBool();
     }
     s.endGroup();
 
@@ -259,6 +285,14 @@ void Settings::loadGlobal()
         echoLatency = s.value("echoLatency", 80).toInt();
         aecechomode = s.value("aecechomode", 0).toInt();
         aecechonsmode = s.value("aecechonsmode", 0).toInt();
+        fullAudioProcessing = s.value("fullAudioProcessing", false).toBool();
+        audioTransientSuppression = s.value("audioTransientSuppression", false).toBool();
+        audioVoiceGate = s.value("audioVoiceGate", false).toBool();
+        const int inputMode = s.value("audioInputMode", static_cast<int>(InputMode::Voice)).toInt();
+        audioInputMode = inputMode >= static_cast<int>(InputMode::Voice)
+                                 && inputMode <= static_cast<int>(InputMode::Music)
+                             ? static_cast<InputMode>(inputMode)
+                             : InputMode::Voice;
         outVolume = s.value("outVolume", 100).toInt();
         enableTestSound = s.value("enableTestSound", true).toBool();
         audioBitrate = s.value("audioBitrate", 64).toInt();
@@ -271,8 +305,13 @@ void Settings::loadGlobal()
         camVideoRes = s.value("camVideoRes", QRect()).toRect();
         screenRegion = s.value("screenRegion", QRect()).toRect();
         screenGrabbed = s.value("screenGrabbed", false).toBool();
+        screenFollowWindow = s.value("screenFollowWindow", false).toBool();
         camVideoFPS = static_cast<quint16>(s.value("camVideoFPS", 0).toUInt());
         screenVideoFPS = s.value("screenVideoFPS", 10).toInt();
+        camVideoHwDecode = s.value("camVideoHwDecode", false).toBool();
+        camWarmStandby = s.value("camWarmStandby", false).toBool();
+        videoEncoderPreset = s.value("videoEncoderPreset", 1).toInt();
+        camModeCache = s.value("camModeCache", QByteArray()).toByteArray();
     }
     s.endGroup();
 
@@ -281,7 +320,7 @@ void Settings::loadGlobal()
 
 void Settings::updateProfileData(Profile* profile, const QCommandLineParser* parser, bool newProfile)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     if (profile == nullptr) {
         qWarning() << QString("Could not load new settings (profile change to nullptr)");
@@ -480,7 +519,7 @@ bool Settings::applyCommandLineOptions(const QCommandLineParser& parser)
 
 void Settings::loadPersonal(const Profile& profile, bool newProfile)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     loadedProfile = &profile;
     QDir dir(paths.getSettingsDirPath());
@@ -496,7 +535,7 @@ void Settings::loadPersonal(const Profile& profile, bool newProfile)
 
     SettingsSerializer ps(filePath, profile.getPasskey());
     ps.load();
-    friendLst.clear();
+    FriendMap friends;
 
     ps.beginGroup("Version");
     {
@@ -521,13 +560,15 @@ void Settings::loadPersonal(const Profile& profile, bool newProfile)
         typingNotification = ps.value("typingNotification", true).toBool();
         enableLogging = ps.value("enableLogging", true).toBool();
         blackList = ps.value("blackList").toString().split('\n');
+        databaseKey = ps.value("databaseKey").toString();
+        fastDatabaseEncryption = ps.value("fastDatabaseEncryption", false).toBool();
     }
     ps.endGroup();
 
     ps.beginGroup("Friends");
     {
         int size = ps.beginReadArray("Friend");
-        friendLst.reserve(size);
+        friends.reserve(size);
         for (int i = 0; i < size; i++) {
             ps.setArrayIndex(i);
             friendProp fp{ps.value("addr").toString()};
@@ -545,18 +586,21 @@ void Settings::loadPersonal(const Profile& profile, bool newProfile)
 
             if (getEnableLogging())
                 fp.activity = ps.value("activity", QDateTime()).toDateTime();
-            friendLst.insert(ToxPk(fp.addr).getByteArray(), fp);
+            friends.insert(ToxPk(fp.addr).getByteArray(), fp);
         }
         ps.endArray();
     }
     ps.endGroup();
+    publishFriendProps(std::move(friends));
 
     ps.beginGroup("Requests");
     {
-        int size = ps.beginReadArray("Request");
+        const int size = ps.beginReadArray("Request");
+        // profiles written before the limit may hold a whole spam wave
+        const int count = std::min(size, MAX_FRIEND_REQUESTS);
         friendRequests.clear();
-        friendRequests.reserve(size);
-        for (int i = 0; i < size; i++) {
+        friendRequests.reserve(count);
+        for (int i = 0; i < count; i++) {
             ps.setArrayIndex(i);
             Request request;
             request.address = ps.value("addr").toString();
@@ -585,6 +629,13 @@ void Settings::loadPersonal(const Profile& profile, bool newProfile)
     }
     ps.endGroup();
 
+    ps.beginGroup("Bootstrap");
+    {
+        bootstrapNodeRanking = ps.value("nodeRanking").toByteArray();
+        lanPeerCache = ps.value("lanPeers").toByteArray();
+    }
+    ps.endGroup();
+
     ps.beginGroup("Circles");
     {
         int size = ps.beginReadArray("Circle");
@@ -617,13 +668,42 @@ void Settings::resetToDefault()
 
 /**
  * @brief Asynchronous, saves the global settings.
+ *
+ * The write is delayed by up to SAVE_DELAY_MS, so a burst of changes is written only once.
  */
 void Settings::saveGlobal()
 {
     if (QThread::currentThread() != settingsThread)
         return (void)QMetaObject::invokeMethod(this, "saveGlobal");
 
-    QMutexLocker locker{&bigLock};
+    globalSavePending = true;
+    if (!saveTimer.isActive()) {
+        saveTimer.start();
+    }
+}
+
+/**
+ * @brief Writes the settings files that have saves pending.
+ * @note Must be called on the settings thread.
+ */
+void Settings::writePendingSaves()
+{
+    saveTimer.stop();
+
+    if (globalSavePending) {
+        globalSavePending = false;
+        writeGlobal();
+    }
+
+    if (personalSavePending) {
+        personalSavePending = false;
+        writePersonal(pendingProfileName, pendingPasskey);
+    }
+}
+
+void Settings::writeGlobal()
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if (!loaded)
         return;
 
@@ -667,6 +747,8 @@ void Settings::saveGlobal()
         s.setValue("enableIPv6", enableIPv6);
         s.setValue("forceTCP", forceTCP);
         s.setValue("enableLanDiscovery", enableLanDiscovery);
+        s.setValue("cacheBudgetMb", cacheBudgetMb);
+        s.setValue("lowMemoryMode", lowMemoryMode);
         s.setValue("dbSyncType", static_cast<int>(dbSyncType));
     }
     s.endGroup();
@@ -741,6 +823,10 @@ void Settings::saveGlobal()
         s.setValue("echoLatency", echoLatency);
         s.setValue("aecechomode", aecechomode);
         s.setValue("aecechonsmode", aecechonsmode);
+        s.setValue("fullAudioProcessing", fullAudioProcessing);
+        s.setValue("audioTransientSuppression", audioTransientSuppression);
+        s.setValue("audioVoiceGate", audioVoiceGate);
+        s.setValue("audioInputMode", static_cast<int>(audioInputMode));
     }
     s.endGroup();
 
@@ -750,8 +836,13 @@ void Settings::saveGlobal()
         s.setValue("camVideoRes", camVideoRes);
         s.setValue("camVideoFPS", camVideoFPS);
         s.setValue("screenVideoFPS", screenVideoFPS);
+        s.setValue("camVideoHwDecode", camVideoHwDecode);
+        s.setValue("camWarmStandby", camWarmStandby);
+        s.setValue("videoEncoderPreset", videoEncoderPreset);
+        s.setValue("camModeCache", camModeCache);
         s.setValue("screenRegion", screenRegion);
         s.setValue("screenGrabbed", screenGrabbed);
+        s.setValue("screenFollowWindow", screenFollowWindow);
     }
     s.endGroup();
 
@@ -764,6 +855,8 @@ void Settings::saveGlobal()
 
 /**
  * @brief Asynchronous, saves the profile.
+ *
+ * Like saveGlobal(), the write is delayed and coalesced with other saves.
  */
 void Settings::savePersonal()
 {
@@ -778,7 +871,18 @@ void Settings::savePersonal()
 
 void Settings::savePersonal(QString profileName, const ToxEncrypt* passkey)
 {
-    QMutexLocker locker{&bigLock};
+    // the latest request wins, an older passkey may already be deleted
+    pendingProfileName = profileName;
+    pendingPasskey = passkey;
+    personalSavePending = true;
+    if (!saveTimer.isActive()) {
+        saveTimer.start();
+    }
+}
+
+void Settings::writePersonal(const QString& profileName, const ToxEncrypt* passkey)
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if (!loaded)
         return;
 
@@ -789,9 +893,10 @@ void Settings::savePersonal(QString profileName, const ToxEncrypt* passkey)
     SettingsSerializer ps(path, passkey);
     ps.beginGroup("Friends");
     {
-        ps.beginWriteArray("Friend", friendLst.size());
+        const auto friends = loadFriendProps();
+        ps.beginWriteArray("Friend", friends->size());
         int index = 0;
-        for (auto& frnd : friendLst) {
+        for (const auto& frnd : *friends) {
             ps.setArrayIndex(index);
             ps.setValue("addr", frnd.addr);
             ps.setValue("alias", frnd.alias);
@@ -841,6 +946,13 @@ void Settings::savePersonal(QString profileName, const ToxEncrypt* passkey)
     }
     ps.endGroup();
 
+    ps.beginGroup("Bootstrap");
+    {
+        ps.setValue("nodeRanking", bootstrapNodeRanking);
+        ps.setValue("lanPeers", lanPeerCache);
+    }
+    ps.endGroup();
+
     ps.beginGroup("Circles");
     {
         ps.beginWriteArray("Circle", circleLst.size());
@@ -860,6 +972,8 @@ void Settings::savePersonal(QString profileName, const ToxEncrypt* passkey)
         ps.setValue("typingNotification", typingNotification);
         ps.setValue("enableLogging", enableLogging);
         ps.setValue("blackList", blackList.join('\n'));
+        ps.setValue("databaseKey", databaseKey);
+        ps.setValue("fastDatabaseEncryption", fastDatabaseEncryption);
     }
     ps.endGroup();
 
@@ -885,7 +999,7 @@ Paths& Settings::getPaths()
 
 bool Settings::getEnableTestSound() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return enableTestSound;
 }
 
@@ -898,7 +1012,7 @@ void Settings::setEnableTestSound(bool newValue)
 
 bool Settings::getEnableIPv6() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return enableIPv6;
 }
 
@@ -911,7 +1025,7 @@ void Settings::setEnableIPv6(bool enabled)
 
 bool Settings::getMakeToxPortable() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return paths.isPortable();
 }
 
@@ -919,7 +1033,7 @@ void Settings::setMakeToxPortable(bool newValue)
 {
     bool changed = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
         auto const oldSettingsPath = paths.getSettingsDirPath() + globalSettingsFile;
         changed = paths.setPortable(newValue);
         if (changed) {
@@ -930,9 +1044,41 @@ void Settings::setMakeToxPortable(bool newValue)
     }
 }
 
+/**
+ * @brief Budget of all in-memory caches combined in MiB, 0 for no budget.
+ */
+int Settings::getCacheBudgetMb() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return cacheBudgetMb;
+}
+
+void Settings::setCacheBudgetMb(int mb)
+{
+    if (setVal(cacheBudgetMb, mb)) {
+        emit cacheBudgetMbChanged(mb);
+    }
+}
+
+/**
+ * @brief Whether caches use the small CacheRegistry::LOW_MEMORY_BUDGET instead of their budget.
+ */
+bool Settings::getLowMemoryMode() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return lowMemoryMode;
+}
+
+void Settings::setLowMemoryMode(bool enabled)
+{
+    if (setVal(lowMemoryMode, enabled)) {
+        emit lowMemoryModeChanged(enabled);
+    }
+}
+
 bool Settings::getAutorun() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
 #ifdef QTOX_PLATFORM_EXT
     return Platform::getAutorun(*this);
@@ -957,13 +1103,13 @@ void Settings::setAutorun(bool newValue)
 
 bool Settings::getAutostartInTray() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return autostartInTray;
 }
 
 QString Settings::getStyle() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return style;
 }
 
@@ -976,7 +1122,7 @@ void Settings::setStyle(const QString& newStyle)
 
 bool Settings::getShowSystemTray() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return showSystemTray;
 }
 
@@ -996,7 +1142,7 @@ void Settings::setUseEmoticons(bool newValue)
 
 bool Settings::getUseEmoticons() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return useEmoticons;
 }
 
@@ -1009,7 +1155,7 @@ void Settings::setAutoSaveEnabled(bool newValue)
 
 bool Settings::getAutoSaveEnabled() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return autoSaveEnabled;
 }
 
@@ -1022,7 +1168,7 @@ void Settings::setAutostartInTray(bool newValue)
 
 bool Settings::getCloseToTray() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return closeToTray;
 }
 
@@ -1035,7 +1181,7 @@ void Settings::setCloseToTray(bool newValue)
 
 bool Settings::getMinimizeToTray() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return minimizeToTray;
 }
 
@@ -1048,7 +1194,7 @@ void Settings::setMinimizeToTray(bool newValue)
 
 bool Settings::getLightTrayIcon() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return lightTrayIcon;
 }
 
@@ -1061,7 +1207,7 @@ void Settings::setLightTrayIcon(bool newValue)
 
 bool Settings::getStatusChangeNotificationEnabled() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return statusChangeNotificationEnabled;
 }
 
@@ -1074,7 +1220,7 @@ void Settings::setStatusChangeNotificationEnabled(bool newValue)
 
 bool Settings::getShowGroupJoinLeaveMessages() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return showGroupJoinLeaveMessages;
 }
 
@@ -1087,7 +1233,7 @@ void Settings::setShowGroupJoinLeaveMessages(bool newValue)
 
 bool Settings::getSpellCheckingEnabled() const
 {
-    const QMutexLocker locker{&bigLock};
+    const PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return spellCheckingEnabled;
 }
 
@@ -1100,7 +1246,7 @@ void Settings::setSpellCheckingEnabled(bool newValue)
 
 bool Settings::getNotifySound() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return notifySound;
 }
 
@@ -1113,7 +1259,7 @@ void Settings::setNotifySound(bool newValue)
 
 bool Settings::getNotifyHide() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return notifyHide;
 }
 
@@ -1126,7 +1272,7 @@ void Settings::setNotifyHide(bool newValue)
 
 bool Settings::getBusySound() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return busySound;
 }
 
@@ -1139,7 +1285,7 @@ void Settings::setBusySound(bool newValue)
 
 bool Settings::getGroupAlwaysNotify() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return groupAlwaysNotify;
 }
 
@@ -1152,7 +1298,7 @@ void Settings::setGroupAlwaysNotify(bool newValue)
 
 QString Settings::getTranslation() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return translation;
 }
 
@@ -1165,7 +1311,7 @@ void Settings::setTranslation(const QString& newValue)
 
 bool Settings::getForceTCP() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return forceTCP;
 }
 
@@ -1178,7 +1324,7 @@ void Settings::setForceTCP(bool enabled)
 
 bool Settings::getEnableLanDiscovery() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return enableLanDiscovery;
 }
 
@@ -1191,7 +1337,7 @@ void Settings::setEnableLanDiscovery(bool enabled)
 
 QNetworkProxy Settings::getProxy() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     QNetworkProxy proxy;
     switch (Settings::getProxyType()) {
@@ -1217,19 +1363,19 @@ QNetworkProxy Settings::getProxy() const
 
 Tox* Settings::getToxcore() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return pToxcore;
 }
 
 void Settings::setToxcore(Tox *toxcorep)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     pToxcore = toxcorep;
 }
 
 Settings::ProxyType Settings::getProxyType() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return proxyType;
 }
 
@@ -1242,7 +1388,7 @@ void Settings::setProxyType(ProxyType newValue)
 
 QString Settings::getProxyAddr() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return proxyAddr;
 }
 
@@ -1255,7 +1401,7 @@ void Settings::setProxyAddr(const QString& address)
 
 quint16 Settings::getProxyPort() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return proxyPort;
 }
 
@@ -1266,15 +1412,37 @@ void Settings::setProxyPort(quint16 port)
     }
 }
 
+QByteArray Settings::getBootstrapNodeRanking() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return bootstrapNodeRanking;
+}
+
+void Settings::setBootstrapNodeRanking(const QByteArray& ranking)
+{
+    setVal(bootstrapNodeRanking, ranking);
+}
+
+QByteArray Settings::getLanPeerCache() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return lanPeerCache;
+}
+
+void Settings::setLanPeerCache(const QByteArray& peers)
+{
+    setVal(lanPeerCache, peers);
+}
+
 QString Settings::getCurrentProfile() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return currentProfile;
 }
 
 uint32_t Settings::getCurrentProfileId() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return currentProfileId;
 }
 
@@ -1283,7 +1451,7 @@ void Settings::setCurrentProfile(const QString& profile)
     bool updated = false;
     uint32_t newProfileId = 0;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
         if (profile != currentProfile) {
             currentProfile = profile;
@@ -1299,7 +1467,7 @@ void Settings::setCurrentProfile(const QString& profile)
 
 bool Settings::getEnableLogging() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return enableLogging;
 }
 
@@ -1310,9 +1478,43 @@ void Settings::setEnableLogging(bool newValue)
     }
 }
 
+/**
+ * @brief Key of the chat history database, hex encoded.
+ *
+ * Only stored for encrypted profiles, where the personal settings are encrypted with the profile
+ * key as well. Caching it spares deriving the database key from the password on every login.
+ */
+QString Settings::getDatabaseKey() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return databaseKey;
+}
+
+void Settings::setDatabaseKey(const QString& hexKey)
+{
+    setVal(databaseKey, hexKey);
+}
+
+/**
+ * @brief Whether the encrypted chat history uses the SQLCipher performance params.
+ *
+ * They trade wiping decrypted pages from memory for faster searches and scrolling through long
+ * histories. The database is migrated the next time the profile is loaded.
+ */
+bool Settings::getFastDatabaseEncryption() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return fastDatabaseEncryption;
+}
+
+void Settings::setFastDatabaseEncryption(bool enabled)
+{
+    setVal(fastDatabaseEncryption, enabled);
+}
+
 int Settings::getAutoAwayTime() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return autoAwayTime;
 }
 
@@ -1334,10 +1536,9 @@ void Settings::setAutoAwayTime(int newValue)
 
 QString Settings::getAutoAcceptDir(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->autoAcceptDir;
 
     return QString();
@@ -1347,12 +1548,14 @@ void Settings::setAutoAcceptDir(const ToxPk& id, const QString& dir)
 {
     bool updated = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
-        auto& frnd = getOrInsertFriendPropRef(id);
+        FriendMap friends = *loadFriendProps();
+        auto& frnd = getOrInsertFriendPropRef(friends, id);
 
         if (frnd.autoAcceptDir != dir) {
             frnd.autoAcceptDir = dir;
+            publishFriendProps(std::move(friends));
             updated = true;
         }
     }
@@ -1363,10 +1566,9 @@ void Settings::setAutoAcceptDir(const ToxPk& id, const QString& dir)
 
 Settings::AutoAcceptCallFlags Settings::getAutoAcceptCall(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->autoAcceptCall;
 
     return Settings::AutoAcceptCallFlags();
@@ -1376,12 +1578,14 @@ void Settings::setAutoAcceptCall(const ToxPk& id, AutoAcceptCallFlags accept)
 {
     bool updated = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
-        auto& frnd = getOrInsertFriendPropRef(id);
+        FriendMap friends = *loadFriendProps();
+        auto& frnd = getOrInsertFriendPropRef(friends, id);
 
         if (frnd.autoAcceptCall != accept) {
             frnd.autoAcceptCall = accept;
+            publishFriendProps(std::move(friends));
             updated = true;
         }
     }
@@ -1392,10 +1596,9 @@ void Settings::setAutoAcceptCall(const ToxPk& id, AutoAcceptCallFlags accept)
 
 bool Settings::getAutoGroupInvite(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end()) {
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end()) {
         return it->autoGroupInvite;
     }
 
@@ -1406,12 +1609,14 @@ void Settings::setAutoGroupInvite(const ToxPk& id, bool accept)
 {
     bool updated = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
-        auto& frnd = getOrInsertFriendPropRef(id);
+        FriendMap friends = *loadFriendProps();
+        auto& frnd = getOrInsertFriendPropRef(friends, id);
 
         if (frnd.autoGroupInvite != accept) {
             frnd.autoGroupInvite = accept;
+            publishFriendProps(std::move(friends));
             updated = true;
         }
     }
@@ -1423,10 +1628,9 @@ void Settings::setAutoGroupInvite(const ToxPk& id, bool accept)
 
 QString Settings::getContactNote(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->note;
 
     return QString();
@@ -1436,12 +1640,14 @@ void Settings::setContactNote(const ToxPk& id, const QString& note)
 {
     bool updated = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
-        auto& frnd = getOrInsertFriendPropRef(id);
+        FriendMap friends = *loadFriendProps();
+        auto& frnd = getOrInsertFriendPropRef(friends, id);
 
         if (frnd.note != note) {
             frnd.note = note;
+            publishFriendProps(std::move(friends));
             updated = true;
         }
     }
@@ -1452,7 +1658,7 @@ void Settings::setContactNote(const ToxPk& id, const QString& note)
 
 QString Settings::getGlobalAutoAcceptDir() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return globalAutoAcceptDir;
 }
 
@@ -1465,7 +1671,7 @@ void Settings::setGlobalAutoAcceptDir(const QString& newValue)
 
 size_t Settings::getMaxAutoAcceptSize() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return autoAcceptMaxSize;
 }
 
@@ -1478,7 +1684,7 @@ void Settings::setMaxAutoAcceptSize(size_t size)
 
 const QFont& Settings::getChatMessageFont() const
 {
-    QMutexLocker locker(&bigLock);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return chatMessageFont;
 }
 
@@ -1493,7 +1699,7 @@ void Settings::setWidgetData(const QString& uniqueName, const QByteArray& data)
 {
     bool updated = false;
     {
-        QMutexLocker locker{&bigLock};
+        PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
         if (!widgetSettings.contains(uniqueName) || widgetSettings[uniqueName] != data) {
             widgetSettings[uniqueName] = data;
@@ -1507,13 +1713,13 @@ void Settings::setWidgetData(const QString& uniqueName, const QByteArray& data)
 
 QByteArray Settings::getWidgetData(const QString& uniqueName) const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return widgetSettings.value(uniqueName);
 }
 
 QString Settings::getSmileyPack() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return smileyPack;
 }
 
@@ -1526,7 +1732,7 @@ void Settings::setSmileyPack(const QString& value)
 
 int Settings::getEmojiFontPointSize() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return emojiFontPointSize;
 }
 
@@ -1539,7 +1745,7 @@ void Settings::setEmojiFontPointSize(int value)
 
 const QString& Settings::getTimestampFormat() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return timestampFormat;
 }
 
@@ -1552,7 +1758,7 @@ void Settings::setTimestampFormat(const QString& format)
 
 const QString& Settings::getDateFormat() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return dateFormat;
 }
 
@@ -1565,7 +1771,7 @@ void Settings::setDateFormat(const QString& format)
 
 Settings::StyleType Settings::getStylePreference() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return stylePreference;
 }
 
@@ -1578,7 +1784,7 @@ void Settings::setStylePreference(StyleType newValue)
 
 QByteArray Settings::getWindowGeometry() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return windowGeometry;
 }
 
@@ -1591,7 +1797,7 @@ void Settings::setWindowGeometry(const QByteArray& value)
 
 QByteArray Settings::getWindowState() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return windowState;
 }
 
@@ -1604,7 +1810,7 @@ void Settings::setWindowState(const QByteArray& value)
 
 bool Settings::getCheckUpdates() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return checkUpdates;
 }
 
@@ -1617,7 +1823,7 @@ void Settings::setCheckUpdates(bool newValue)
 
 bool Settings::getUsePushNotification() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return usePushNotification;
 }
 
@@ -1630,7 +1836,7 @@ void Settings::setUsePushNotification(bool newValue)
 
 bool Settings::getEchoCancellation() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return echoCancellation;
 }
 
@@ -1643,7 +1849,7 @@ void Settings::setEchoCancellation(bool newValue)
 
 int Settings::getEchoLatency() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if ((echoLatency >= 0) && (echoLatency <= 300)) {
         return echoLatency;
     } else {
@@ -1662,7 +1868,7 @@ void Settings::setEchoLatency(int newValue)
 
 int Settings::getAecechomode() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if ((aecechomode >= 0) && (aecechomode <= 4)) {
         return aecechomode;
     } else {
@@ -1681,7 +1887,7 @@ void Settings::setAecechomode(int newValue)
 
 int Settings::getAecechonsmode() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if ((aecechonsmode >= 0) && (aecechonsmode <= 3)) {
         return aecechonsmode;
     } else {
@@ -1698,9 +1904,61 @@ void Settings::setAecechonsmode(int newValue)
     }
 }
 
+bool Settings::getFullAudioProcessing() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return fullAudioProcessing;
+}
+
+void Settings::setFullAudioProcessing(bool newValue)
+{
+    if (setVal(fullAudioProcessing, newValue)) {
+        emit fullAudioProcessingChanged(newValue);
+    }
+}
+
+bool Settings::getAudioTransientSuppression() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return audioTransientSuppression;
+}
+
+void Settings::setAudioTransientSuppression(bool newValue)
+{
+    if (setVal(audioTransientSuppression, newValue)) {
+        emit audioTransientSuppressionChanged(newValue);
+    }
+}
+
+bool Settings::getAudioVoiceGate() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return audioVoiceGate;
+}
+
+void Settings::setAudioVoiceGate(bool newValue)
+{
+    if (setVal(audioVoiceGate, newValue)) {
+        emit audioVoiceGateChanged(newValue);
+    }
+}
+
+IAudioSettings::InputMode Settings::getAudioInputMode() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return audioInputMode;
+}
+
+void Settings::setAudioInputMode(InputMode newValue)
+{
+    if (setVal(audioInputMode, newValue)) {
+        emit audioInputModeChanged(newValue);
+    }
+}
+
 bool Settings::getNotify() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return notify;
 }
 
@@ -1713,7 +1971,7 @@ void Settings::setNotify(bool newValue)
 
 bool Settings::getShowWindow() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return showWindow;
 }
 
@@ -1726,7 +1984,7 @@ void Settings::setShowWindow(bool newValue)
 
 bool Settings::getDesktopNotify() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return desktopNotify;
 }
 
@@ -1739,7 +1997,7 @@ void Settings::setDesktopNotify(bool enabled)
 
 QByteArray Settings::getSplitterState() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return splitterState;
 }
 
@@ -1752,7 +2010,7 @@ void Settings::setSplitterState(const QByteArray& value)
 
 QByteArray Settings::getDialogGeometry() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return dialogGeometry;
 }
 
@@ -1765,7 +2023,7 @@ void Settings::setDialogGeometry(const QByteArray& value)
 
 QByteArray Settings::getDialogSplitterState() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return dialogSplitterState;
 }
 
@@ -1778,7 +2036,7 @@ void Settings::setDialogSplitterState(const QByteArray& value)
 
 QByteArray Settings::getDialogSettingsGeometry() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return dialogSettingsGeometry;
 }
 
@@ -1791,7 +2049,7 @@ void Settings::setDialogSettingsGeometry(const QByteArray& value)
 
 bool Settings::getMinimizeOnClose() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return minimizeOnClose;
 }
 
@@ -1804,7 +2062,7 @@ void Settings::setMinimizeOnClose(bool newValue)
 
 bool Settings::getTypingNotification() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return typingNotification;
 }
 
@@ -1817,7 +2075,7 @@ void Settings::setTypingNotification(bool enabled)
 
 QStringList Settings::getBlackList() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return blackList;
 }
 
@@ -1830,7 +2088,7 @@ void Settings::setBlackList(const QStringList& blist)
 
 QString Settings::getInDev() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return inDev;
 }
 
@@ -1843,7 +2101,7 @@ void Settings::setInDev(const QString& deviceSpecifier)
 
 bool Settings::getAudioInDevEnabled() const
 {
-    QMutexLocker locker(&bigLock);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return audioInDevEnabled;
 }
 
@@ -1856,7 +2114,7 @@ void Settings::setAudioInDevEnabled(bool enabled)
 
 qreal Settings::getAudioInGainDecibel() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return audioInGainDecibel;
 }
 
@@ -1869,7 +2127,7 @@ void Settings::setAudioInGainDecibel(qreal dB)
 
 qreal Settings::getAudioThreshold() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return audioThreshold;
 }
 
@@ -1882,7 +2140,7 @@ void Settings::setAudioThreshold(qreal percent)
 
 QString Settings::getVideoDev() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return videoDev;
 }
 
@@ -1895,7 +2153,7 @@ void Settings::setVideoDev(const QString& deviceSpecifier)
 
 QString Settings::getOutDev() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return outDev;
 }
 
@@ -1908,7 +2166,7 @@ void Settings::setOutDev(const QString& deviceSpecifier)
 
 bool Settings::getAudioOutDevEnabled() const
 {
-    QMutexLocker locker(&bigLock);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return audioOutDevEnabled;
 }
 
@@ -1921,7 +2179,7 @@ void Settings::setAudioOutDevEnabled(bool enabled)
 
 int Settings::getOutVolume() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return outVolume;
 }
 
@@ -1934,7 +2192,7 @@ void Settings::setOutVolume(int volume)
 
 int Settings::getAudioBitrate() const
 {
-    const QMutexLocker locker{&bigLock};
+    const PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return audioBitrate;
 }
 
@@ -1947,7 +2205,7 @@ void Settings::setAudioBitrate(int bitrate)
 
 QRect Settings::getScreenRegion() const
 {
-    QMutexLocker locker(&bigLock);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return screenRegion;
 }
 
@@ -1960,7 +2218,7 @@ void Settings::setScreenRegion(const QRect& value)
 
 bool Settings::getScreenGrabbed() const
 {
-    QMutexLocker locker(&bigLock);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return screenGrabbed;
 }
 
@@ -1971,9 +2229,22 @@ void Settings::setScreenGrabbed(bool value)
     }
 }
 
+bool Settings::getScreenFollowWindow() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return screenFollowWindow;
+}
+
+void Settings::setScreenFollowWindow(bool value)
+{
+    if (setVal(screenFollowWindow, value)) {
+        emit screenFollowWindowChanged(value);
+    }
+}
+
 QRect Settings::getCamVideoRes() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return camVideoRes;
 }
 
@@ -1986,7 +2257,7 @@ void Settings::setCamVideoRes(QRect newValue)
 
 float Settings::getCamVideoFPS() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return camVideoFPS;
 }
 
@@ -1999,7 +2270,7 @@ void Settings::setCamVideoFPS(float newValue)
 
 int Settings::getScreenVideoFPS() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if (screenVideoFPS == 5) {
         return 10;
     }
@@ -2013,19 +2284,77 @@ void Settings::setScreenVideoFPS(int newValue)
     }
 }
 
+bool Settings::getCamVideoHwDecode() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return camVideoHwDecode;
+}
+
+void Settings::setCamVideoHwDecode(bool newValue)
+{
+    if (setVal(camVideoHwDecode, newValue)) {
+        emit camVideoHwDecodeChanged(newValue);
+    }
+}
+
+bool Settings::getCamWarmStandby() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return camWarmStandby;
+}
+
+void Settings::setCamWarmStandby(bool newValue)
+{
+    if (setVal(camWarmStandby, newValue)) {
+        emit camWarmStandbyChanged(newValue);
+    }
+}
+
+/**
+ * @brief Encoder speed for new calls, a CallEncoderProfile::Preset.
+ */
+int Settings::getVideoEncoderPreset() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return videoEncoderPreset;
+}
+
+void Settings::setVideoEncoderPreset(int newValue)
+{
+    if (setVal(videoEncoderPreset, newValue)) {
+        emit videoEncoderPresetChanged(newValue);
+    }
+}
+
+/**
+ * @brief Serialized CameraModeCache, so cameras aren't probed again after a restart.
+ */
+QByteArray Settings::getCamModeCache() const
+{
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    return camModeCache;
+}
+
+void Settings::setCamModeCache(const QByteArray& newValue)
+{
+    setVal(camModeCache, newValue);
+}
+
 void Settings::updateFriendAddress(const QString& newAddr)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     auto key = ToxPk(newAddr);
-    auto& frnd = getOrInsertFriendPropRef(key);
+    FriendMap friends = *loadFriendProps();
+    auto& frnd = getOrInsertFriendPropRef(friends, key);
     frnd.addr = newAddr;
+    publishFriendProps(std::move(friends));
 }
 
 QString Settings::getFriendAlias(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->alias;
 
     return QString();
@@ -2033,16 +2362,18 @@ QString Settings::getFriendAlias(const ToxPk& id) const
 
 void Settings::setFriendAlias(const ToxPk& id, const QString& alias)
 {
-    QMutexLocker locker{&bigLock};
-    auto& frnd = getOrInsertFriendPropRef(id);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    FriendMap friends = *loadFriendProps();
+    auto& frnd = getOrInsertFriendPropRef(friends, id);
     frnd.alias = alias;
+    publishFriendProps(std::move(friends));
 }
 
 int Settings::getFriendCircleID(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->circleID;
 
     return -1;
@@ -2050,16 +2381,18 @@ int Settings::getFriendCircleID(const ToxPk& id) const
 
 void Settings::setFriendCircleID(const ToxPk& id, int circleID)
 {
-    QMutexLocker locker{&bigLock};
-    auto& frnd = getOrInsertFriendPropRef(id);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    FriendMap friends = *loadFriendProps();
+    auto& frnd = getOrInsertFriendPropRef(friends, id);
     frnd.circleID = circleID;
+    publishFriendProps(std::move(friends));
 }
 
 QDateTime Settings::getFriendActivity(const ToxPk& id) const
 {
-    QMutexLocker locker{&bigLock};
-    auto it = friendLst.find(id.getByteArray());
-    if (it != friendLst.end())
+    const auto friends = loadFriendProps();
+    auto it = friends->find(id.getByteArray());
+    if (it != friends->end())
         return it->activity;
 
     return QDateTime();
@@ -2067,9 +2400,11 @@ QDateTime Settings::getFriendActivity(const ToxPk& id) const
 
 void Settings::setFriendActivity(const ToxPk& id, const QDateTime& activity)
 {
-    QMutexLocker locker{&bigLock};
-    auto& frnd = getOrInsertFriendPropRef(id);
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    FriendMap friends = *loadFriendProps();
+    auto& frnd = getOrInsertFriendPropRef(friends, id);
     frnd.activity = activity;
+    publishFriendProps(std::move(friends));
 }
 
 void Settings::saveFriendSettings(const ToxPk& id)
@@ -2080,13 +2415,15 @@ void Settings::saveFriendSettings(const ToxPk& id)
 
 void Settings::removeFriendSettings(const ToxPk& id)
 {
-    QMutexLocker locker{&bigLock};
-    friendLst.remove(id.getByteArray());
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
+    FriendMap friends = *loadFriendProps();
+    friends.remove(id.getByteArray());
+    publishFriendProps(std::move(friends));
 }
 
 bool Settings::getCompactLayout() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return compactLayout;
 }
 
@@ -2099,7 +2436,7 @@ void Settings::setCompactLayout(bool value)
 
 Settings::FriendListSortingMode Settings::getFriendSortingMode() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return sortingMode;
 }
 
@@ -2112,7 +2449,7 @@ void Settings::setFriendSortingMode(FriendListSortingMode mode)
 
 bool Settings::getSeparateWindow() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return separateWindow;
 }
 
@@ -2125,7 +2462,7 @@ void Settings::setSeparateWindow(bool value)
 
 bool Settings::getDontGroupWindows() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return dontGroupWindows;
 }
 
@@ -2138,7 +2475,7 @@ void Settings::setDontGroupWindows(bool value)
 
 bool Settings::getGroupchatPosition() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return groupchatPosition;
 }
 
@@ -2151,7 +2488,7 @@ void Settings::setGroupchatPosition(bool value)
 
 bool Settings::getShowIdenticons() const
 {
-    const QMutexLocker locker{&bigLock};
+    const PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return showIdenticons;
 }
 
@@ -2164,26 +2501,26 @@ void Settings::setShowIdenticons(bool value)
 
 int Settings::getCircleCount() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return circleLst.size();
 }
 
 QString Settings::getCircleName(int id) const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return circleLst[id].name;
 }
 
 void Settings::setCircleName(int id, const QString& name)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     circleLst[id].name = name;
     savePersonal();
 }
 
 int Settings::addCircle(const QString& name)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     circleProp cp;
     cp.expanded = false;
@@ -2200,21 +2537,21 @@ int Settings::addCircle(const QString& name)
 
 bool Settings::getCircleExpanded(int id) const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return circleLst[id].expanded;
 }
 
 void Settings::setCircleExpanded(int id, bool expanded)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     circleLst[id].expanded = expanded;
 }
 
 bool Settings::addFriendRequest(const QString& friendAddress, const QString& message)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
-    for (auto queued : friendRequests) {
+    for (auto& queued : friendRequests) {
         if (queued.address == friendAddress) {
             queued.message = message;
             queued.read = false;
@@ -2222,6 +2559,12 @@ bool Settings::addFriendRequest(const QString& friendAddress, const QString& mes
         }
     }
 
+    if (friendRequests.size() >= MAX_FRIEND_REQUESTS) {
+        qWarning() << "Not storing the friend request, already" << MAX_FRIEND_REQUESTS
+                   << "are pending";
+        return false;
+    }
+
     Request request;
     request.address = friendAddress;
     request.message = message;
@@ -2233,7 +2576,7 @@ bool Settings::addFriendRequest(const QString& friendAddress, const QString& mes
 
 unsigned int Settings::getUnreadFriendRequests() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     unsigned int unreadFriendRequests = 0;
     for (auto request : friendRequests)
         if (!request.read)
@@ -2244,19 +2587,19 @@ unsigned int Settings::getUnreadFriendRequests() const
 
 Settings::Request Settings::getFriendRequest(int index) const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return friendRequests.at(index);
 }
 
 int Settings::getFriendRequestSize() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return friendRequests.size();
 }
 
 void Settings::clearUnreadFriendRequests()
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     for (auto& request : friendRequests)
         request.read = true;
@@ -2264,13 +2607,13 @@ void Settings::clearUnreadFriendRequests()
 
 void Settings::removeFriendRequest(int index)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     friendRequests.removeAt(index);
 }
 
 void Settings::readFriendRequest(int index)
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     friendRequests[index].read = true;
 }
 
@@ -2286,7 +2629,7 @@ int Settings::removeCircle(int id)
 
 int Settings::getThemeColor() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return themeColor;
 }
 
@@ -2299,7 +2642,7 @@ void Settings::setThemeColor(int value)
 
 bool Settings::getAutoLogin() const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     return autoLogin;
 }
 
@@ -2330,7 +2673,7 @@ bool Settings::getEnableGroupChatsColor() const
  */
 void Settings::createPersonal(const QString& basename) const
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     QString path = paths.getSettingsDirPath() + QDir::separator() + basename + ".ini";
     qDebug() << "Creating new profile settings in " << path;
@@ -2351,7 +2694,7 @@ void Settings::createPersonal(const QString& basename) const
  */
 void Settings::createSettingsDir()
 {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
 
     QString dir = paths.getSettingsDirPath();
     QDir directory(dir);
@@ -2360,26 +2703,46 @@ void Settings::createSettingsDir()
 }
 
 /**
- * @brief Waits for all asynchronous operations to complete
+ * @brief Waits for all asynchronous operations to complete, including delayed saves
  */
 void Settings::sync()
 {
     if (QThread::currentThread() != settingsThread) {
+        HitchScope hitchScope{"settings save"};
         QMetaObject::invokeMethod(this, "sync", Qt::BlockingQueuedConnection);
         return;
     }
 
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     qApp->processEvents();
+    writePendingSaves();
+}
+
+/**
+ * @brief Current per-friend settings, readers get a consistent view without locking.
+ * @return Immutable snapshot.
+ */
+std::shared_ptr<const Settings::FriendMap> Settings::loadFriendProps() const
+{
+    return std::atomic_load(&friendLst);
+}
+
+/**
+ * @brief Replaces the per-friend settings seen by readers.
+ * @param friends Modified copy of the current snapshot.
+ * @note bigLock must be held, so concurrent writers don't lose each other's changes.
+ */
+void Settings::publishFriendProps(FriendMap friends)
+{
+    std::atomic_store(&friendLst, std::shared_ptr<const FriendMap>{
+                                      std::make_shared<FriendMap>(std::move(friends))});
 }
 
-Settings::friendProp& Settings::getOrInsertFriendPropRef(const ToxPk& id)
+Settings::friendProp& Settings::getOrInsertFriendPropRef(FriendMap& friends, const ToxPk& id)
 {
-    // No mutex lock, this is a private fn that should only be called by other
-    // public functions that already locked the mutex
-    auto it = friendLst.find(id.getByteArray());
-    if (it == friendLst.end()) {
-        it = friendLst.insert(id.getByteArray(), friendProp{id.toString()});
+    auto it = friends.find(id.getByteArray());
+    if (it == friends.end()) {
+        it = friends.insert(id.getByteArray(), friendProp{id.toString()});
     }
 
     return *it;
@@ -2401,7 +2764,7 @@ ICoreSettings::ProxyType Settings::fixInvalidProxyType(ICoreSettings::ProxyType
 
 template <typename T>
 bool Settings::setVal(T& savedVal, T newVal) {
-    QMutexLocker locker{&bigLock};
+    PROFILED_MUTEX_LOCKER(locker, &bigLock, "Settings::bigLock");
     if (savedVal != newVal) {
         savedVal = newVal;
         return true;
@@ -43,6 +43,9 @@
 #include <QNetworkProxy>
 #include <QObject>
 #include <QPixmap>
+#include <QTimer>
+
+#include <memory>
 
 class Profile;
 class QCommandLineParser;
@@ -132,14 +135,25 @@ class Settings : public QObject,
     Q_PROPERTY(int echoLatency READ getEchoLatency WRITE setEchoLatency NOTIFY echoLatencyChanged FINAL)
     Q_PROPERTY(int aecechomode READ getAecechomode WRITE setAecechomode NOTIFY aecechomodeChanged FINAL)
     Q_PROPERTY(int aecechonsmode READ getAecechonsmode WRITE setAecechonsmode NOTIFY aecechonsmodeChanged FINAL)
+    Q_PROPERTY(bool fullAudioProcessing READ getFullAudioProcessing WRITE setFullAudioProcessing
+                   NOTIFY fullAudioProcessingChanged FINAL)
+    Q_PROPERTY(bool audioTransientSuppression READ getAudioTransientSuppression
+                   WRITE setAudioTransientSuppression NOTIFY audioTransientSuppressionChanged FINAL)
+    Q_PROPERTY(bool audioVoiceGate READ getAudioVoiceGate WRITE setAudioVoiceGate
+                   NOTIFY audioVoiceGateChanged FINAL)
 
     // Video
     Q_PROPERTY(QString videoDev READ getVideoDev WRITE setVideoDev NOTIFY videoDevChanged FINAL)
     Q_PROPERTY(QRect camVideoRes READ getCamVideoRes WRITE setCamVideoRes NOTIFY camVideoResChanged FINAL)
     Q_PROPERTY(QRect screenRegion READ getScreenRegion WRITE setScreenRegion NOTIFY screenRegionChanged FINAL)
     Q_PROPERTY(bool screenGrabbed READ getScreenGrabbed WRITE setScreenGrabbed NOTIFY screenGrabbedChanged FINAL)
+    Q_PROPERTY(bool screenFollowWindow READ getScreenFollowWindow WRITE setScreenFollowWindow NOTIFY screenFollowWindowChanged FINAL)
     Q_PROPERTY(float camVideoFPS READ getCamVideoFPS WRITE setCamVideoFPS NOTIFY camVideoFPSChanged FINAL)
     Q_PROPERTY(int screenVideoFPS READ getScreenVideoFPS WRITE setScreenVideoFPS NOTIFY screenVideoFPSChanged FINAL)
+    Q_PROPERTY(bool camVideoHwDecode READ getCamVideoHwDecode WRITE setCamVideoHwDecode NOTIFY camVideoHwDecodeChanged FINAL)
+    Q_PROPERTY(bool camWarmStandby READ getCamWarmStandby WRITE setCamWarmStandby NOTIFY camWarmStandbyChanged FINAL)
+    Q_PROPERTY(int videoEncoderPreset READ getVideoEncoderPreset WRITE setVideoEncoderPreset
+                   NOTIFY videoEncoderPresetChanged FINAL)
 
 public:
     enum class StyleType
@@ -201,6 +215,8 @@ signals:
     void desktopNotifyChanged(bool enabled);
     void showWindowChanged(bool enabled);
     void makeToxPortableChanged(bool enabled);
+    void cacheBudgetMbChanged(int mb);
+    void lowMemoryModeChanged(bool enabled);
     void busySoundChanged(bool enabled);
     void notifySoundChanged(bool enabled);
     void notifyHideChanged(bool enabled);
@@ -256,6 +272,12 @@ public:
     bool getMakeToxPortable() const;
     void setMakeToxPortable(bool newValue);
 
+    int getCacheBudgetMb() const;
+    void setCacheBudgetMb(int mb);
+
+    bool getLowMemoryMode() const;
+    void setLowMemoryMode(bool enabled);
+
     bool getAutorun() const;
     void setAutorun(bool newValue);
 
@@ -314,6 +336,11 @@ public:
 
     QNetworkProxy getProxy() const override;
 
+    QByteArray getBootstrapNodeRanking() const override;
+    void setBootstrapNodeRanking(const QByteArray& ranking) override;
+    QByteArray getLanPeerCache() const override;
+    void setLanPeerCache(const QByteArray& peers) override;
+
     SIGNAL_IMPL(Settings, enableIPv6Changed, bool enabled)
     SIGNAL_IMPL(Settings, forceTCPChanged, bool enabled)
     SIGNAL_IMPL(Settings, enableLanDiscoveryChanged, bool enabled)
@@ -324,6 +351,12 @@ public:
     bool getEnableLogging() const;
     void setEnableLogging(bool newValue);
 
+    QString getDatabaseKey() const;
+    void setDatabaseKey(const QString& hexKey);
+
+    bool getFastDatabaseEncryption() const;
+    void setFastDatabaseEncryption(bool enabled);
+
     Db::syncType getDbSyncType() const;
     void setDbSyncType(Db::syncType newValue);
 
@@ -404,6 +437,18 @@ public:
     int getAecechonsmode() const override;
     void setAecechonsmode(int newValue) override;
 
+    bool getFullAudioProcessing() const override;
+    void setFullAudioProcessing(bool newValue) override;
+
+    bool getAudioTransientSuppression() const override;
+    void setAudioTransientSuppression(bool newValue) override;
+
+    bool getAudioVoiceGate() const override;
+    void setAudioVoiceGate(bool newValue) override;
+
+    InputMode getAudioInputMode() const override;
+    void setAudioInputMode(InputMode newValue) override;
+
     SIGNAL_IMPL(Settings, inDevChanged, const QString& device)
     SIGNAL_IMPL(Settings, audioInDevEnabledChanged, bool enabled)
 
@@ -419,6 +464,10 @@ public:
     SIGNAL_IMPL(Settings, echoLatencyChanged, int latency_ms)
     SIGNAL_IMPL(Settings, aecechomodeChanged, int mode)
     SIGNAL_IMPL(Settings, aecechonsmodeChanged, int mode)
+    SIGNAL_IMPL(Settings, fullAudioProcessingChanged, bool newValue)
+    SIGNAL_IMPL(Settings, audioTransientSuppressionChanged, bool newValue)
+    SIGNAL_IMPL(Settings, audioVoiceGateChanged, bool newValue)
+    SIGNAL_IMPL(Settings, audioInputModeChanged, IAudioSettings::InputMode mode)
 
     QString getVideoDev() const override;
     void setVideoDev(const QString& deviceSpecifier) override;
@@ -429,6 +478,9 @@ public:
     bool getScreenGrabbed() const override;
     void setScreenGrabbed(bool value) override;
 
+    bool getScreenFollowWindow() const override;
+    void setScreenFollowWindow(bool value) override;
+
     QRect getCamVideoRes() const override;
     void setCamVideoRes(QRect newValue) override;
 
@@ -438,12 +490,28 @@ public:
     int getScreenVideoFPS() const override;
     void setScreenVideoFPS(int newValue) override;
 
+    bool getCamVideoHwDecode() const override;
+    void setCamVideoHwDecode(bool newValue) override;
+
+    bool getCamWarmStandby() const override;
+    void setCamWarmStandby(bool newValue) override;
+
+    int getVideoEncoderPreset() const override;
+    void setVideoEncoderPreset(int newValue) override;
+
+    QByteArray getCamModeCache() const override;
+    void setCamModeCache(const QByteArray& newValue) override;
+
     SIGNAL_IMPL(Settings, videoDevChanged, const QString& device)
     SIGNAL_IMPL(Settings, screenRegionChanged, const QRect& region)
     SIGNAL_IMPL(Settings, screenGrabbedChanged, bool enabled)
+    SIGNAL_IMPL(Settings, screenFollowWindowChanged, bool enabled)
     SIGNAL_IMPL(Settings, camVideoResChanged, const QRect& region)
     SIGNAL_IMPL(Settings, camVideoFPSChanged, unsigned short fps)
     SIGNAL_IMPL(Settings, screenVideoFPSChanged, int fps)
+    SIGNAL_IMPL(Settings, camVideoHwDecodeChanged, bool enabled)
+    SIGNAL_IMPL(Settings, camWarmStandbyChanged, bool enabled)
+    SIGNAL_IMPL(Settings, videoEncoderPresetChanged, int preset)
 
     bool isAnimationEnabled() const;
     void setAnimationEnabled(bool newValue);
@@ -582,6 +650,8 @@ public:
     bool getCircleExpanded(int id) const;
     void setCircleExpanded(int id, bool expanded);
 
+    // unanswered requests beyond this are dropped, a spam wave must not bloat the profile
+    static constexpr int MAX_FRIEND_REQUESTS = 500;
     bool addFriendRequest(const QString& friendAddress, const QString& message);
     unsigned int getUnreadFriendRequests() const;
     Request getFriendRequest(int index) const;
@@ -612,7 +682,10 @@ public:
 
 private:
     struct friendProp;
-    friendProp& getOrInsertFriendPropRef(const ToxPk& id);
+    using FriendMap = QHash<QByteArray, friendProp>;
+    std::shared_ptr<const FriendMap> loadFriendProps() const;
+    void publishFriendProps(FriendMap friends);
+    static friendProp& getOrInsertFriendPropRef(FriendMap& friends, const ToxPk& id);
     static ICoreSettings::ProxyType fixInvalidProxyType(ICoreSettings::ProxyType proxyType);
 
     template <typename T>
@@ -620,6 +693,11 @@ private:
 
 private slots:
     void savePersonal(QString profileName, const ToxEncrypt* passkey);
+    void writePendingSaves();
+
+private:
+    void writeGlobal();
+    void writePersonal(const QString& profileName, const ToxEncrypt* passkey);
 
 private:
     bool loaded;
@@ -655,15 +733,22 @@ private:
 
     bool forceTCP;
     bool enableLanDiscovery;
+    int cacheBudgetMb;
+    bool lowMemoryMode;
 
     ICoreSettings::ProxyType proxyType;
     QString proxyAddr;
     quint16 proxyPort;
 
+    QByteArray bootstrapNodeRanking;
+    QByteArray lanPeerCache;
+
     QString currentProfile;
     uint32_t currentProfileId;
 
     bool enableLogging;
+    QString databaseKey;
+    bool fastDatabaseEncryption;
 
     int autoAwayTime;
 
@@ -718,14 +803,23 @@ private:
     int echoLatency;
     int aecechomode;
     int aecechonsmode;
+    bool fullAudioProcessing;
+    bool audioTransientSuppression;
+    bool audioVoiceGate;
+    InputMode audioInputMode;
 
     // Video
     QString videoDev;
     QRect camVideoRes;
     QRect screenRegion;
     bool screenGrabbed;
+    bool screenFollowWindow;
     float camVideoFPS;
     int screenVideoFPS;
+    bool camVideoHwDecode;
+    bool camWarmStandby;
+    int videoEncoderPreset;
+    QByteArray camModeCache;
 
     struct friendProp
     {
@@ -749,7 +843,10 @@ private:
         bool expanded;
     };
 
-    QHash<QByteArray, friendProp> friendLst;
+    /**
+     * @brief Published friend settings, only accessed with std::atomic_load/std::atomic_store.
+     */
+    std::shared_ptr<const FriendMap> friendLst{std::make_shared<FriendMap>()};
 
     QVector<circleProp> circleLst;
 
@@ -757,11 +854,20 @@ private:
 
     static CompatibleRecursiveMutex bigLock;
     static const QString globalSettingsFile;
-    static QThread* settingsThread;
+    // one per instance, a headless relay host runs several profiles with their own Settings
+    QThread* settingsThread = nullptr;
     Paths paths;
     int globalSettingsVersion = 0;
     int personalSettingsVersion = 0;
     IMessageBoxManager& messageBoxManager;
     const Profile* loadedProfile = nullptr;
     Tox *pToxcore = nullptr;
+
+    // saves requested within this window are written together
+    static constexpr int SAVE_DELAY_MS = 1000;
+    QTimer saveTimer{this};
+    bool globalSavePending = false;
+    bool personalSavePending = false;
+    QString pendingProfileName;
+    const ToxEncrypt* pendingPasskey = nullptr;
 };
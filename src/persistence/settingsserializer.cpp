@@ -38,6 +38,13 @@
  * The file is only written to disk if save() is called, the destructor does not save to disk
  * All member functions are reentrant, but not thread safe.
  *
+ * There are two serialized formats, both start with the magic and are decrypted in one go.
+ * Files of the first format are a stream of RecordTag records, every value is looked up by name
+ * while reading it. save() writes the indexed format: the magic is followed by indexedFormat, the
+ * group names, the arrays and then all values, each carrying the numbers of its group, array and
+ * array index. It is read in a single pass. In memory, values are found through a hash index in
+ * both cases, so reading many friends doesn't get quadratic.
+ *
  * @enum SettingsSerializer::RecordTag
  * @var Value
  * Followed by a QString key then a QVariant value
@@ -55,6 +62,12 @@
  * @brief Little endian ASCII "QTOX" magic
  */
 const char SettingsSerializer::magic[] = {0x51, 0x54, 0x4F, 0x58};
+
+/**
+ * @var static const uint8_t indexedFormat;
+ * @brief Follows the magic in files of the indexed format, it is no valid RecordTag.
+ */
+const uint8_t SettingsSerializer::indexedFormat = 0xF2;
 namespace {
 
 QDataStream& writeStream(QDataStream& dataStream, const SettingsSerializer::RecordTag& tag)
@@ -87,14 +100,39 @@ QDataStream& readStream(QDataStream& dataStream, QByteArray& data)
     int num = 0;
     int num2 = 0;
     do {
-        dataStream.readRawData(&num3, 1);
+        if (dataStream.readRawData(&num3, 1) != 1) {
+            // truncated file, the caller sees the stream's status
+            data.clear();
+            return dataStream;
+        }
         num |= (num3 & 0x7f) << num2;
         num2 += 7;
     } while ((num3 & 0x80) != 0);
+    if (num < 0 || num > dataStream.device()->bytesAvailable()) {
+        dataStream.setStatus(QDataStream::ReadCorruptData);
+        data.clear();
+        return dataStream;
+    }
     data.resize(num);
     dataStream.readRawData(data.data(), num);
     return dataStream;
 }
+
+/**
+ * @brief Reads a length prefixed vint, like the array sizes are stored.
+ * @return False if the stream ended.
+ */
+bool readVInt(QDataStream& dataStream, int& num)
+{
+    QByteArray data;
+    readStream(dataStream, data);
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    num = dataToVInt(data);
+    return true;
+}
 } // namespace
 
 SettingsSerializer::SettingsSerializer(QString filePath_, const ToxEncrypt* passKey_)
@@ -179,6 +217,7 @@ void SettingsSerializer::setValue(const QString& key, const QVariant& value)
         Value nv{group, array, arrayIndex, key, value};
         if (array >= 0)
             arrays[array].values.append(values.size());
+        index.insert(makeKey(group, array, arrayIndex, key), values.size());
         values.append(nv);
     }
 }
@@ -192,25 +231,24 @@ QVariant SettingsSerializer::value(const QString& key, const QVariant& defaultVa
         return defaultValue;
 }
 
+/**
+ * @brief Builds the key of a value in the index.
+ *
+ * The array index of values outside of arrays is meaningless, it's always -1 in the key.
+ */
+SettingsSerializer::ValueKey SettingsSerializer::makeKey(qint64 group, qint64 array,
+                                                         int arrayIndex, const QString& key)
+{
+    return {group, array, array == -1 ? -1 : arrayIndex, key};
+}
+
 const SettingsSerializer::Value* SettingsSerializer::findValue(const QString& key) const
 {
-    if (array != -1) {
-        for (const Array& a : arrays) {
-            if (a.group != group)
-                continue;
+    const auto it = index.constFind(makeKey(group, array, arrayIndex, key));
+    if (it == index.constEnd())
+        return nullptr;
 
-            for (int vi : a.values) {
-                const Value& v = values[vi];
-                if (v.arrayIndex == arrayIndex && v.key == key)
-                    return &v;
-            }
-        }
-    } else {
-        for (const Value& v : values)
-            if (v.group == group && v.array == -1 && v.key == key)
-                return &v;
-    }
-    return nullptr;
+    return &values[*it];
 }
 
 SettingsSerializer::Value* SettingsSerializer::findValue(const QString& key)
@@ -218,6 +256,19 @@ SettingsSerializer::Value* SettingsSerializer::findValue(const QString& key)
     return const_cast<Value*>(const_cast<const SettingsSerializer*>(this)->findValue(key));
 }
 
+/**
+ * @brief Recreates the index after values were moved or removed.
+ */
+void SettingsSerializer::rebuildIndex()
+{
+    index.clear();
+    index.reserve(values.size());
+    for (int i = 0; i < values.size(); ++i) {
+        const Value& v = values[i];
+        index.insert(makeKey(v.group, v.array, v.arrayIndex, v.key), i);
+    }
+}
+
 /**
  * @brief Checks if the file is serialized settings.
  * @param filePath Path to file to check.
@@ -259,44 +310,47 @@ void SettingsSerializer::save()
     QByteArray data(magic, 4);
     QDataStream stream(&data, QIODevice::ReadWrite | QIODevice::Append);
     stream.setVersion(QDataStream::Qt_5_0);
+    stream << indexedFormat;
 
-    // prevent signed overflow and the associated warning
-    int numGroups = std::max(0, groups.size());
-    for (int g = -1; g < numGroups; ++g) {
-        // Save the group name, if any
-        if (g != -1) {
-            writeStream(stream, RecordTag::GroupStart);
-            writeStream(stream, groups[g].toUtf8());
-        }
+    writeStream(stream, vintToData(groups.size()));
+    for (const QString& g : groups) {
+        writeStream(stream, g.toUtf8());
+    }
 
-        // Save all the arrays of this group
-        for (const Array& a : arrays) {
-            if (a.group != g)
-                continue;
-            if (a.size <= 0)
-                continue;
-            writeStream(stream, RecordTag::ArrayStart);
-            writeStream(stream, a.name.toUtf8());
-            writeStream(stream, vintToData(a.size));
-
-            for (int vi : a.values) {
-                const Value& v = values[vi];
-                writeStream(stream, RecordTag::ArrayValue);
-                writeStream(stream, vintToData(values[vi].arrayIndex));
-                writeStream(stream, v.key.toUtf8());
-                writePackedVariant(stream, v.value);
-            }
-            writeStream(stream, RecordTag::ArrayEnd);
+    // empty arrays are dropped together with their values, the rest is renumbered
+    QVector<int> arrayIds(arrays.size(), -1);
+    int numArrays = 0;
+    for (int ai = 0; ai < arrays.size(); ++ai) {
+        if (arrays[ai].size > 0) {
+            arrayIds[ai] = numArrays++;
         }
+    }
 
-        // Save all the values of this group that aren't in an array
-        for (const Value& v : values) {
-            if (v.group != g || v.array != -1)
-                continue;
-            writeStream(stream, RecordTag::Value);
-            writeStream(stream, v.key.toUtf8());
-            writePackedVariant(stream, v.value);
-        }
+    writeStream(stream, vintToData(numArrays));
+    for (const Array& a : arrays) {
+        if (a.size <= 0)
+            continue;
+        writeStream(stream, vintToData(static_cast<int>(a.group) + 1));
+        writeStream(stream, a.name.toUtf8());
+        writeStream(stream, vintToData(a.size));
+    }
+
+    int numValues = 0;
+    for (const Value& v : values) {
+        if (v.array == -1 || arrayIds[static_cast<int>(v.array)] != -1)
+            ++numValues;
+    }
+
+    writeStream(stream, vintToData(numValues));
+    for (const Value& v : values) {
+        const int arrayId = v.array == -1 ? -1 : arrayIds[static_cast<int>(v.array)];
+        if (v.array != -1 && arrayId == -1)
+            continue;
+        writeStream(stream, vintToData(static_cast<int>(v.group) + 1));
+        writeStream(stream, vintToData(arrayId + 1));
+        writeStream(stream, vintToData(arrayId == -1 ? 0 : v.arrayIndex + 1));
+        writeStream(stream, v.key.toUtf8());
+        writePackedVariant(stream, v.value);
     }
 
     // Encrypt
@@ -351,6 +405,98 @@ void SettingsSerializer::readSerialized()
     QDataStream stream(&data, QIODevice::ReadOnly);
     stream.setVersion(QDataStream::Qt_5_0);
 
+    if (!data.isEmpty() && static_cast<uint8_t>(data[0]) == indexedFormat) {
+        stream.skipRawData(1);
+        if (!readIndexed(stream)) {
+            qWarning("The personal save file is corrupted!");
+            groups.clear();
+            arrays.clear();
+            values.clear();
+            index.clear();
+        }
+    } else {
+        readTagged(stream);
+    }
+
+    group = array = -1;
+}
+
+/**
+ * @brief Reads a file of the indexed format, written by save().
+ * @param stream Stream positioned after the format marker.
+ * @return False if the file is corrupted.
+ */
+bool SettingsSerializer::readIndexed(QDataStream& stream)
+{
+    int numGroups;
+    if (!readVInt(stream, numGroups) || numGroups < 0)
+        return false;
+
+    QByteArray name;
+    groups.reserve(numGroups);
+    for (int i = 0; i < numGroups; ++i) {
+        readStream(stream, name);
+        groups.append(QString::fromUtf8(name));
+    }
+
+    int numArrays;
+    if (!readVInt(stream, numArrays) || numArrays < 0)
+        return false;
+
+    arrays.reserve(numArrays);
+    for (int i = 0; i < numArrays; ++i) {
+        int arrayGroup;
+        int size;
+        if (!readVInt(stream, arrayGroup))
+            return false;
+        readStream(stream, name);
+        if (!readVInt(stream, size) || arrayGroup < 0 || arrayGroup > numGroups)
+            return false;
+        arrays.append({arrayGroup - 1, size, QString::fromUtf8(name), {}});
+    }
+
+    int numValues;
+    if (!readVInt(stream, numValues) || numValues < 0)
+        return false;
+
+    values.reserve(numValues);
+    index.reserve(numValues);
+    for (int i = 0; i < numValues; ++i) {
+        int valueGroup;
+        int valueArray;
+        int valueIndex;
+        QByteArray key;
+        QByteArray value;
+        if (!readVInt(stream, valueGroup) || !readVInt(stream, valueArray)
+            || !readVInt(stream, valueIndex))
+            return false;
+        readStream(stream, key);
+        readStream(stream, value);
+        if (stream.status() != QDataStream::Ok || valueGroup < 0 || valueGroup > numGroups
+            || valueArray < 0 || valueArray > numArrays)
+            return false;
+
+        // all numbers are stored off by one, so -1 fits into a vuint
+        --valueGroup;
+        --valueArray;
+        --valueIndex;
+        const QString keyString = QString::fromUtf8(key);
+        if (valueArray >= 0)
+            arrays[valueArray].values.append(values.size());
+        index.insert(makeKey(valueGroup, valueArray, valueIndex, keyString), values.size());
+        values.append({valueGroup, valueArray, valueIndex, keyString,
+                       QVariant(QString::fromUtf8(value))});
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reads a file of the RecordTag stream format, written by older versions.
+ * @param stream Stream positioned after the magic.
+ */
+void SettingsSerializer::readTagged(QDataStream& stream)
+{
     while (!stream.atEnd()) {
         RecordTag tag;
         readStream(stream, tag);
@@ -393,8 +539,6 @@ void SettingsSerializer::readSerialized()
             endArray();
         }
     }
-
-    group = array = -1;
 }
 
 void SettingsSerializer::readIni()
@@ -523,6 +667,7 @@ void SettingsSerializer::readIni()
         removeGroup(g);
     }
 
+    rebuildIndex();
     group = array = -1;
 }
 
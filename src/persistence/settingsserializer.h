@@ -22,6 +22,7 @@
 #include "src/core/toxencrypt.h"
 
 #include <QDataStream>
+#include <QHash>
 #include <QSettings>
 #include <QString>
 #include <QVector>
@@ -89,10 +90,34 @@ private:
         QVector<int> values;
     };
 
+    struct ValueKey
+    {
+        qint64 group;
+        qint64 array;
+        int arrayIndex;
+        QString key;
+
+        bool operator==(const ValueKey& other) const
+        {
+            return group == other.group && array == other.array
+                   && arrayIndex == other.arrayIndex && key == other.key;
+        }
+
+        friend uint qHash(const ValueKey& k, uint seed = 0)
+        {
+            return qHash(k.key, seed)
+                   ^ qHash((k.group << 40) ^ (k.array << 20) ^ k.arrayIndex, seed);
+        }
+    };
+
 private:
+    static ValueKey makeKey(qint64 group, qint64 array, int arrayIndex, const QString& key);
     const Value* findValue(const QString& key) const;
     Value* findValue(const QString& key);
+    void rebuildIndex();
     void readSerialized();
+    void readTagged(QDataStream& stream);
+    bool readIndexed(QDataStream& stream);
     void readIni();
     void removeValue(const QString& key);
     void removeGroup(int group);
@@ -105,5 +130,7 @@ private:
     QStringList groups;
     QVector<Array> arrays;
     QVector<Value> values;
+    QHash<ValueKey, int> index;
     static const char magic[];
+    static const uint8_t indexedFormat;
 };
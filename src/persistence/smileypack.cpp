@@ -19,14 +19,18 @@
 
 #include "smileypack.h"
 #include "src/persistence/settings.h"
+#include "util/hitchwatchdog.h"
 
+#include <QDebug>
 #include <QDir>
-#include <QDomElement>
-#include <QRegularExpression>
+#include <QGuiApplication>
+#include <QImageReader>
 #include <QStandardPaths>
 #include <QStringBuilder>
+#include <QXmlStreamReader>
 #include <QtConcurrent/QtConcurrentRun>
-#include <QTimer>
+
+#include <algorithm>
 
 #if defined(Q_OS_FREEBSD)
 #include <locale.h>
@@ -36,11 +40,18 @@
  * @class SmileyPack
  * @brief Maps emoticons to smileys.
  *
- * @var SmileyPack::filenameTable
- * @brief Matches an emoticon to its corresponding smiley ie. ":)" -> "happy.png"
+ * Loading a pack only reads which emoticons map to which file, so switching packs costs the
+ * index rebuild and large emoji packs take little memory. Icons are read and rendered the first
+ * time they are asked for at a size, and kept in a cache of PIXMAP_CACHE_KB KiB.
+ *
+ * @var SmileyPack::emoticonToIcon
+ * @brief Matches an emoticon to the index of its smiley in iconFiles, ie. ":)" -> 0
+ *
+ * @var SmileyPack::iconFiles
+ * @brief File of each smiley relative to path, ie. "happy.png"
  *
- * @var SmileyPack::iconCache
- * @brief representation of a smiley ie. "happy.png" -> data
+ * @var SmileyPack::pixmapCache
+ * @brief Rendered smileys by icon index and size
  *
  * @var SmileyPack::emoticons
  * @brief {{ ":)", ":-)" }, {":(", ...}, ... }
@@ -61,7 +72,35 @@ const QString RICH_TEXT_PATTERN = QStringLiteral("<img title=\"%1\" src=\"key:%1
 
 const QString EMOTICONS_FILE_NAME = QStringLiteral("emoticons.xml");
 
-constexpr int CLEANUP_TIMEOUT = 5 * 60 * 1000; // 5 minutes
+/**
+ * @brief Reads an icon at the given size, like QIcon::pixmap() would.
+ *
+ * Bitmaps are only scaled down, keeping their aspect ratio, vector images are rendered to fit.
+ */
+QPixmap renderIcon(const QString& filename, QSize size)
+{
+    const qreal dpr = qApp->devicePixelRatio();
+    const QSize deviceSize = size * dpr;
+    QImageReader reader(filename);
+    QSize scaledSize = reader.size();
+    if (scaledSize.isValid()) {
+        const bool scalable = reader.format().startsWith("svg");
+        if (scalable || scaledSize.width() > deviceSize.width()
+            || scaledSize.height() > deviceSize.height()) {
+            scaledSize.scale(deviceSize, Qt::KeepAspectRatio);
+        }
+        reader.setScaledSize(scaledSize);
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to render smiley" << filename << reader.errorString();
+        return {};
+    }
+
+    image.setDevicePixelRatio(dpr);
+    return QPixmap::fromImage(image);
+}
 
 /**
  * @brief Construct list of standard directories with "emoticons" sub dir, whether these directories
@@ -103,24 +142,40 @@ bool isAscii(const QString& string)
     return (string.toUtf8()[0] & asciiExtMask) == 0;
 }
 
+/**
+ * @brief Same characters as \\s in a regular expression without Unicode properties
+ */
+bool isRegexSpace(QChar c)
+{
+    switch (c.unicode()) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\v':
+    case '\f':
+    case '\r':
+        return true;
+    default:
+        return false;
+    }
+}
+
 } // namespace
 
+constexpr int SmileyPack::PIXMAP_CACHE_KB;
+
 SmileyPack::SmileyPack(ISmileySettings& settings_)
-    : cleanupTimer{new QTimer(this)}
+    : RegisteredCache("smiley icons")
+    , pixmapCache{PIXMAP_CACHE_KB}
     , settings{settings_}
 {
     loadingMutex.lock();
     QtConcurrent::run(this, &SmileyPack::load, settings.getSmileyPack());
     settings.connectTo_smileyPackChanged(this,
         [&](const QString&) { onSmileyPackChanged(); });
-    connect(cleanupTimer, &QTimer::timeout, this, &SmileyPack::cleanupIconsCache);
-    cleanupTimer->start(CLEANUP_TIMEOUT);
 }
 
-SmileyPack::~SmileyPack()
-{
-    delete cleanupTimer;
-}
+SmileyPack::~SmileyPack() = default;
 
 /**
  * @brief Wraps passed string into smiley HTML image reference
@@ -132,17 +187,34 @@ QString SmileyPack::getAsRichText(const QString& key)
     return RICH_TEXT_PATTERN.arg(key);
 }
 
-void SmileyPack::cleanupIconsCache()
+/**
+ * @note Reports nothing while a pack is loading, so the GUI thread never waits for it.
+ */
+RegisteredCache::Usage SmileyPack::getCacheUsage() const
 {
-    QMutexLocker locker(&loadingMutex);
-    for (auto it = cachedIcon.begin(); it != cachedIcon.end();) {
-        std::shared_ptr<QIcon>& icon = it->second;
-        if (icon.use_count() == 1) {
-            it = cachedIcon.erase(it);
-        } else {
-            ++it;
-        }
+    if (!loadingMutex.tryLock()) {
+        return {0, 0};
     }
+
+    const Usage usage{static_cast<qint64>(pixmapCache.totalCost()) * 1024, pixmapCache.size()};
+    loadingMutex.unlock();
+    return usage;
+}
+
+/**
+ * @brief Drops the least recently used pixmaps until the cache fits into maxBytes.
+ * @note Must be called on the GUI thread, like getAsPixmap().
+ */
+void SmileyPack::trimCache(qint64 maxBytes)
+{
+    if (!loadingMutex.tryLock()) {
+        return;
+    }
+
+    // QCache drops entries right away when its limit shrinks
+    pixmapCache.setMaxCost(static_cast<int>(std::max<qint64>(maxBytes / 1024, 0)));
+    pixmapCache.setMaxCost(PIXMAP_CACHE_KB);
+    loadingMutex.unlock();
 }
 
 /**
@@ -203,10 +275,6 @@ bool SmileyPack::load(const QString& filename)
         return false;
     }
 
-    QDomDocument doc;
-    doc.setContent(xmlFile.readAll());
-    xmlFile.close();
-
     /* parse the cfg file
      * sample:
      * <?xml version='1.0'?>
@@ -223,71 +291,119 @@ bool SmileyPack::load(const QString& filename)
      */
 
     path = QFileInfo(filename).absolutePath();
-    QDomNodeList emoticonElements = doc.elementsByTagName("emoticon");
-    const QString itemName = QStringLiteral("file");
-    const QString childName = QStringLiteral("string");
-    const int iconsCount = emoticonElements.size();
     emoticons.clear();
-    emoticonToPath.clear();
-    cachedIcon.clear();
-
-    for (int i = 0; i < iconsCount; ++i) {
-        QDomNode node = emoticonElements.at(i);
-        QString iconName = node.attributes().namedItem(itemName).nodeValue();
-        QString iconPath = QDir{path}.filePath(iconName);
-        QDomElement stringElement = node.firstChildElement(childName);
-        QStringList emoticonList;
-        while (!stringElement.isNull()) {
-            QString emoticon = stringElement.text().replace("<", "&lt;").replace(">", "&gt;");
-            emoticonToPath.insert(emoticon, iconPath);
-            emoticonList.append(emoticon);
-            stringElement = stringElement.nextSibling().toElement();
+    emoticonToIcon.clear();
+    iconFiles.clear();
+    // pixmaps must be destroyed on the GUI thread, see getAsPixmap()
+    pixmapsStale = true;
+
+    // streamed, a DOM of a large emoji pack takes several times the memory of the file
+    QXmlStreamReader reader(&xmlFile);
+    const QString itemName = QStringLiteral("emoticon");
+    const QString fileName = QStringLiteral("file");
+    const QString childName = QStringLiteral("string");
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement) {
+            continue;
         }
 
-        emoticons.append(emoticonList);
+        if (reader.name() == itemName) {
+            iconFiles.append(reader.attributes().value(fileName).toString());
+            emoticons.append(QStringList());
+        } else if (reader.name() == childName && !iconFiles.isEmpty()) {
+            QString emoticon = reader.readElementText().replace("<", "&lt;").replace(">", "&gt;");
+            emoticonToIcon.insert(emoticon, iconFiles.size() - 1);
+            emoticons.last().append(emoticon);
+        }
     }
 
-    constructRegex();
+    if (reader.hasError()) {
+        qWarning() << "Failed to parse smiley pack" << filename << reader.errorString();
+    }
+
+    constructTrie();
 
     loadingMutex.unlock();
     return true;
 }
 
 /**
- * @brief Creates the regex for replacing emoticons with the path to their pictures
+ * @brief Builds the trie of all emoticons, used by smileyfied() to find them in one pass
  */
-void SmileyPack::constructRegex()
+void SmileyPack::constructTrie()
 {
-    QString allPattern = QStringLiteral("(");
-    QString regularPatterns;
-    QString multiCharacterEmojiPatterns;
-
-    // construct one big regex that matches on every emoticon
-    for (const QString& emote : emoticonToPath.keys()) {
-        if (!isAscii(emote)) {
-            if (emote.toUcs4().length() == 1) {
-                regularPatterns.append(emote);
-                regularPatterns.append(QStringLiteral("|"));
-            }
-            else {
-                multiCharacterEmojiPatterns.append(emote);
-                multiCharacterEmojiPatterns.append(QStringLiteral("|"));
+    trie.assign(1, TrieNode{});
+
+    for (auto it = emoticonToIcon.constBegin(); it != emoticonToIcon.constEnd(); ++it) {
+        const QString& emote = it.key();
+        if (emote.isEmpty()) {
+            continue;
+        }
+
+        int node = 0;
+        for (const QChar c : emote) {
+            auto& children = trie[node].children;
+            auto child = std::lower_bound(children.begin(), children.end(), c.unicode(),
+                                          [](const std::pair<ushort, int>& entry, ushort unit) {
+                                              return entry.first < unit;
+                                          });
+            if (child != children.end() && child->first == c.unicode()) {
+                node = child->second;
+                continue;
             }
-        } else {
-            // patterns like ":)" or ":smile:", don't match inside a word or else will hit punctuation and html tags
-            regularPatterns.append(QStringLiteral(R"((?<=^|\s))") % QRegularExpression::escape(emote) % QStringLiteral(R"((?=$|\s))"));
-            regularPatterns.append(QStringLiteral("|"));
+
+            const int next = static_cast<int>(trie.size());
+            children.insert(child, {c.unicode(), next});
+            // may reallocate, don't keep references across this
+            trie.emplace_back();
+            node = next;
         }
+
+        trie[node].isEmoticon = true;
+        // patterns like ":)" or ":smile:", don't match inside a word or else will hit punctuation and html tags
+        trie[node].needsWordBoundaries = isAscii(emote);
     }
+}
 
-    // Regexps are evaluated from left to right, insert multichar emojis first so they are evaluated first
-    allPattern.append(multiCharacterEmojiPatterns);
-    allPattern.append(regularPatterns);
-    allPattern[allPattern.size() - 1] = QChar(')');
+/**
+ * @brief Finds the longest emoticon starting at pos
+ * @param msg Message to search in
+ * @param pos Position of the first character of the emoticon
+ * @return Length of the emoticon, 0 if none starts at pos
+ */
+int SmileyPack::matchLength(const QString& msg, int pos) const
+{
+    if (trie.empty()) {
+        return 0;
+    }
+
+    const bool wordStart = pos == 0 || isRegexSpace(msg.at(pos - 1));
+    int node = 0;
+    int longest = 0;
+    for (int i = pos; i < msg.length(); ++i) {
+        const auto& children = trie[node].children;
+        const ushort unit = msg.at(i).unicode();
+        auto child = std::lower_bound(children.begin(), children.end(), unit,
+                                      [](const std::pair<ushort, int>& entry, ushort u) {
+                                          return entry.first < u;
+                                      });
+        if (child == children.end() || child->first != unit) {
+            break;
+        }
 
-    // compile and optimize regex
-    smilify.setPattern(allPattern);
-    smilify.optimize();
+        node = child->second;
+        const TrieNode& current = trie[node];
+        if (!current.isEmoticon) {
+            continue;
+        }
+
+        const bool wordEnd = i + 1 == msg.length() || isRegexSpace(msg.at(i + 1));
+        if (!current.needsWordBoundaries || (wordStart && wordEnd)) {
+            longest = i + 1 - pos;
+        }
+    }
+
+    return longest;
 }
 
 /**
@@ -297,20 +413,31 @@ void SmileyPack::constructRegex()
  */
 QString SmileyPack::smileyfied(const QString& msg)
 {
+    // waits for a smiley pack that is still loading
+    HitchScope hitchScope{"smiley pack load"};
     QMutexLocker locker(&loadingMutex);
-    QString result(msg);
-
-    int replaceDiff = 0;
-    QRegularExpressionMatchIterator iter = smilify.globalMatch(result);
-    while (iter.hasNext()) {
-        QRegularExpressionMatch match = iter.next();
-        int startPos = match.capturedStart();
-        int keyLength = match.capturedLength();
-        QString imgRichText = SmileyPack::getAsRichText(match.captured());
-        result.replace(startPos + replaceDiff, keyLength, imgRichText);
-        replaceDiff += imgRichText.length() - keyLength;
+    QString result;
+
+    int copiedUntil = 0;
+    int pos = 0;
+    while (pos < msg.length()) {
+        const int length = matchLength(msg, pos);
+        if (length == 0) {
+            ++pos;
+            continue;
+        }
+
+        result.append(msg.midRef(copiedUntil, pos - copiedUntil));
+        result.append(SmileyPack::getAsRichText(msg.mid(pos, length)));
+        pos += length;
+        copiedUntil = pos;
+    }
+
+    if (copiedUntil == 0) {
+        return msg;
     }
 
+    result.append(msg.midRef(copiedUntil));
     return result;
 }
 
@@ -324,26 +451,60 @@ QList<QStringList> SmileyPack::getEmoticons() const
 }
 
 /**
- * @brief Gets icon accoring to passed emoticon
+ * @brief Gets the smiley of an emoticon rendered at a size
  * @param emoticon Passed emoticon
- * @return Returns cached icon according to passed emoticon, null if no icon mapped to this emoticon
+ * @param size Size in device independent pixels
+ * @return Cached pixmap, null if no icon is mapped to this emoticon
+ * @note Must be called on the GUI thread.
  */
-std::shared_ptr<QIcon> SmileyPack::getAsIcon(const QString& emoticon) const
+QPixmap SmileyPack::getAsPixmap(const QString& emoticon, QSize size) const
 {
+    HitchScope hitchScope{"smiley pack load"};
     QMutexLocker locker(&loadingMutex);
-    if (cachedIcon.find(emoticon) != cachedIcon.end()) {
-        return cachedIcon[emoticon];
+    markCacheUsed();
+    if (pixmapsStale) {
+        pixmapCache.clear();
+        pixmapsStale = false;
+    }
+
+    const auto iconIt = emoticonToIcon.find(emoticon);
+    if (iconIt == emoticonToIcon.end()) {
+        return {};
+    }
+
+    const PixmapKey key{iconIt.value(), size};
+    if (const QPixmap* cached = pixmapCache.object(key)) {
+        return *cached;
     }
 
-    const auto iconPathIt = emoticonToPath.find(emoticon);
-    if (iconPathIt == emoticonToPath.end()) {
-        return std::make_shared<QIcon>();
+    const QPixmap pixmap = renderIcon(QDir{path}.filePath(iconFiles.at(iconIt.value())), size);
+    // failed renders are cached too, so a broken file isn't read over and over
+    const int costKb = pixmap.width() * pixmap.height() * pixmap.depth() / 8 / 1024;
+    pixmapCache.insert(key, new QPixmap(pixmap), std::max(costKb, 1));
+    return pixmap;
+}
+
+/**
+ * @brief Gets the icon of an emoticon, e.g. to find out which sizes it supports
+ * @param emoticon Passed emoticon
+ * @return Icon, null if no icon is mapped to this emoticon
+ * @note Not cached, use getAsPixmap() to draw smileys.
+ */
+QIcon SmileyPack::getAsIcon(const QString& emoticon) const
+{
+    const QString file = iconPath(emoticon);
+    return file.isEmpty() ? QIcon() : QIcon(file);
+}
+
+QString SmileyPack::iconPath(const QString& emoticon) const
+{
+    QMutexLocker locker(&loadingMutex);
+    const auto iconIt = emoticonToIcon.find(emoticon);
+    if (iconIt == emoticonToIcon.end()) {
+        return {};
     }
 
-    const QString& iconPath = iconPathIt.value();
-    auto icon = std::make_shared<QIcon>(iconPath);
-    cachedIcon[emoticon] = icon;
-    return icon;
+    return QDir{path}.filePath(iconFiles.at(iconIt.value()));
 }
 
 void SmileyPack::onSmileyPackChanged()
@@ -19,17 +19,22 @@
 
 #pragma once
 
+#include "util/cacheregistry.h"
+
+#include <QCache>
+#include <QHash>
 #include <QIcon>
-#include <QMap>
 #include <QMutex>
-#include <QRegularExpression>
+#include <QPixmap>
+#include <QSize>
+#include <QStringList>
 
-#include <memory>
+#include <utility>
+#include <vector>
 
-class QTimer;
 class ISmileySettings;
 
-class SmileyPack : public QObject
+class SmileyPack : public QObject, public RegisteredCache
 {
     Q_OBJECT
 
@@ -44,23 +49,56 @@ public:
 
     QString smileyfied(const QString& msg);
     QList<QStringList> getEmoticons() const;
-    std::shared_ptr<QIcon> getAsIcon(const QString& emoticon) const;
+    QPixmap getAsPixmap(const QString& emoticon, QSize size) const;
+    QIcon getAsIcon(const QString& emoticon) const;
     static QString getAsRichText(const QString& key);
+    Usage getCacheUsage() const override;
+    void trimCache(qint64 maxBytes) override;
+
+    static constexpr int PIXMAP_CACHE_KB = 4 * 1024;
 
 private slots:
     void onSmileyPackChanged();
-    void cleanupIconsCache();
 
 private:
+    struct PixmapKey
+    {
+        int icon;
+        QSize size;
+
+        bool operator==(const PixmapKey& other) const
+        {
+            return icon == other.icon && size == other.size;
+        }
+
+        friend uint qHash(const PixmapKey& key)
+        {
+            return qHash(key.icon) ^ qHash((key.size.width() << 16) ^ key.size.height());
+        }
+    };
+
+    struct TrieNode
+    {
+        // sorted by code unit
+        std::vector<std::pair<ushort, int>> children;
+        bool isEmoticon = false;
+        bool needsWordBoundaries = false;
+    };
+
     bool load(const QString& filename);
-    void constructRegex();
+    void constructTrie();
+    int matchLength(const QString& msg, int pos) const;
+    QString iconPath(const QString& emoticon) const;
 
-    mutable std::map<QString, std::shared_ptr<QIcon>> cachedIcon;
-    QHash<QString, QString> emoticonToPath;
+    // least recently used pixmaps, the cost is the size in KiB
+    mutable QCache<PixmapKey, QPixmap> pixmapCache;
+    // set by load() on its thread, the cache is cleared on the GUI thread
+    mutable bool pixmapsStale = false;
+    QHash<QString, int> emoticonToIcon;
+    QStringList iconFiles;
     QList<QStringList> emoticons;
     QString path;
-    QTimer* cleanupTimer;
-    QRegularExpression smilify;
+    std::vector<TrieNode> trie;
     mutable QMutex loadingMutex;
     ISmileySettings& settings;
 };
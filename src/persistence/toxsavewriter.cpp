@@ -0,0 +1,213 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "toxsavewriter.h"
+#include "src/core/toxencrypt.h"
+#include "util/threadscheduling.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * @class ToxSaveWriter
+ * @brief Coalesces requests to save the .tox file and writes it on a worker thread.
+ *
+ * Core asks for a save on every change of the name, status, friends or groups, so accepting a
+ * batch of friend requests used to serialize, encrypt and write the whole save once per request.
+ * Requests are collected for SAVE_DELAY_MS instead, then the save is snapshotted once on the
+ * calling thread, which holds the core lock only for that copy. Encryption and the write run on
+ * a worker thread through a QSaveFile, so an interrupted write never replaces the old save.
+ *
+ * At most one snapshot waits for the worker, a newer one replaces it before it was written.
+ *
+ * @note requestSave(), flush() and the setters must be called from the thread that owns the
+ * writer.
+ */
+
+constexpr int ToxSaveWriter::SAVE_DELAY_MS;
+
+namespace {
+// a single thread, so two writes of the same file never run at once
+class WriterPool : public QThreadPool
+{
+public:
+    WriterPool()
+    {
+        setMaxThreadCount(1);
+    }
+};
+
+QThreadPool* writerPool()
+{
+    static WriterPool pool;
+    return &pool;
+}
+} // namespace
+
+/**
+ * @param path_ Path of the .tox file.
+ * @param snapshot_ Returns the unencrypted save, called on the thread owning the writer.
+ */
+ToxSaveWriter::ToxSaveWriter(const QString& path_, Snapshot snapshot_)
+    : snapshot{std::move(snapshot_)}
+    , path{path_}
+    , delayTimer{this}
+{
+    delayTimer.setSingleShot(true);
+    delayTimer.setInterval(SAVE_DELAY_MS);
+    connect(&delayTimer, &QTimer::timeout, this, &ToxSaveWriter::takeSnapshot);
+}
+
+/**
+ * @brief Waits for the write in progress, a save still delayed is dropped.
+ * @note Call flush() before to keep the latest changes.
+ */
+ToxSaveWriter::~ToxSaveWriter()
+{
+    delayTimer.stop();
+
+    QMutexLocker locker{&mutex};
+    while (draining) {
+        idle.wait(&mutex);
+    }
+}
+
+/**
+ * @brief Changes the path used by the following saves, e.g. after the profile was renamed.
+ */
+void ToxSaveWriter::setPath(const QString& newPath)
+{
+    path = newPath;
+}
+
+/**
+ * @brief Changes the key the following saves are encrypted with.
+ * @param newPasskey Key to encrypt with, nullptr to write the save unencrypted.
+ */
+void ToxSaveWriter::setPasskey(std::shared_ptr<const ToxEncrypt> newPasskey)
+{
+    passkey = std::move(newPasskey);
+}
+
+/**
+ * @brief Saves within SAVE_DELAY_MS, together with all other requests until then.
+ */
+void ToxSaveWriter::requestSave()
+{
+    if (!delayTimer.isActive()) {
+        delayTimer.start();
+    }
+}
+
+/**
+ * @brief Takes the delayed snapshot now, if any, and waits until everything was written.
+ * @return False if the last write failed.
+ */
+bool ToxSaveWriter::flush()
+{
+    if (delayTimer.isActive()) {
+        takeSnapshot();
+    }
+
+    QMutexLocker locker{&mutex};
+    while (draining) {
+        idle.wait(&mutex);
+    }
+
+    return !failed;
+}
+
+/**
+ * @brief Number of saves written so far, failed ones included.
+ */
+int ToxSaveWriter::getWriteCount() const
+{
+    QMutexLocker locker{&mutex};
+    return writeCount;
+}
+
+void ToxSaveWriter::takeSnapshot()
+{
+    delayTimer.stop();
+
+    std::unique_ptr<Job> job{new Job{snapshot(), path, passkey}};
+    if (job->data.isEmpty()) {
+        qWarning() << "Tox save snapshot is empty, not saving";
+        return;
+    }
+
+    QMutexLocker locker{&mutex};
+    pending = std::move(job);
+    if (!draining) {
+        draining = true;
+        QtConcurrent::run(writerPool(), [this] { drain(); });
+    }
+}
+
+void ToxSaveWriter::drain()
+{
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+    QMutexLocker locker{&mutex};
+    while (pending) {
+        const std::unique_ptr<Job> job = std::move(pending);
+
+        locker.unlock();
+        const bool written = write(*job);
+        locker.relock();
+
+        failed = !written;
+        ++writeCount;
+    }
+
+    draining = false;
+    idle.wakeAll();
+}
+
+bool ToxSaveWriter::write(const Job& job)
+{
+    QSaveFile saveFile(job.path);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        qCritical() << "Tox save file " << job.path << " couldn't be opened";
+        return false;
+    }
+
+    QByteArray data = job.data;
+    if (job.passkey) {
+        data = job.passkey->encrypt(data);
+        if (data.isEmpty()) {
+            qCritical() << "Failed to encrypt, can't save!";
+            saveFile.cancelWriting();
+            return false;
+        }
+    }
+
+    saveFile.write(data);
+
+    // check if everything got written
+    if (!saveFile.flush() || !saveFile.commit()) {
+        saveFile.cancelWriting();
+        qCritical() << "Failed to write, can't save!";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include <functional>
+#include <memory>
+
+class ToxEncrypt;
+
+class ToxSaveWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Snapshot = std::function<QByteArray()>;
+
+    ToxSaveWriter(const QString& path_, Snapshot snapshot_);
+    ~ToxSaveWriter() override;
+
+    void setPath(const QString& newPath);
+    void setPasskey(std::shared_ptr<const ToxEncrypt> newPasskey);
+    void requestSave();
+    bool flush();
+    int getWriteCount() const;
+
+    static constexpr int SAVE_DELAY_MS = 500;
+
+private slots:
+    void takeSnapshot();
+
+private:
+    struct Job
+    {
+        QByteArray data;
+        QString path;
+        std::shared_ptr<const ToxEncrypt> passkey;
+    };
+
+    void drain();
+    static bool write(const Job& job);
+
+private:
+    const Snapshot snapshot;
+    QString path;
+    std::shared_ptr<const ToxEncrypt> passkey;
+    QTimer delayTimer;
+
+    mutable QMutex mutex;
+    QWaitCondition idle;
+    std::unique_ptr<Job> pending;
+    bool draining = false;
+    bool failed = false;
+    int writeCount = 0;
+};
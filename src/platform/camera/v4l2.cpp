@@ -23,6 +23,9 @@
 #include "v4l2.h"
 
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -215,6 +218,28 @@ QVector<QPair<QString, QString>> v4l2::getDeviceList()
     return devices;
 }
 
+/**
+ * @brief Identifies the hardware and driver behind a device node without opening it.
+ * @param devName Device node, e.g. /dev/video0.
+ * @return Name and bus id of the device from sysfs and the kernel release, which in-tree
+ * drivers report as their version.
+ */
+QString v4l2::getDeviceFingerprint(const QString& devName)
+{
+    const QString sysfs =
+        QStringLiteral("/sys/class/video4linux/%1/").arg(QFileInfo{devName}.fileName());
+    QString fingerprint;
+    for (const QString& attribute : {QStringLiteral("name"), QStringLiteral("device/modalias")}) {
+        QFile file{sysfs + attribute};
+        if (file.open(QIODevice::ReadOnly)) {
+            fingerprint += QString::fromUtf8(file.readAll()).trimmed();
+        }
+        fingerprint += '|';
+    }
+
+    return fingerprint + QSysInfo::kernelVersion();
+}
+
 QString v4l2::getPixelFormatString(uint32_t pixel_format)
 {
     if (pixFmtToName.find(pixel_format) == pixFmtToName.end()) {
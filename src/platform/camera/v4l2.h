@@ -30,6 +30,7 @@
 namespace v4l2 {
 QVector<VideoMode> getDeviceModes(QString devName);
 QVector<QPair<QString, QString>> getDeviceList();
+QString getDeviceFingerprint(const QString& devName);
 QString getPixelFormatString(uint32_t pixel_format);
 bool betterPixelFormat(uint32_t a, uint32_t b);
 }
@@ -0,0 +1,433 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "v4l2capture.h"
+#include "v4l2.h"
+#include "src/video/videoframepool.h"
+
+extern "C" {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#pragma GCC diagnostic pop
+}
+
+#include <QDebug>
+#include <QString>
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @class V4l2Capture
+ * @brief Captures from a V4L2 device using memory mapped streaming I/O.
+ *
+ * The driver fills BUFFER_COUNT memory mapped buffers in turn. A dequeued buffer is wrapped into
+ * an AVBufferRef without copying it and queued to the driver again once the last frame or packet
+ * referencing it is freed. If consumers hold on to so many frames that fewer than
+ * MIN_QUEUED_BUFFERS stay with the driver, the image is copied instead and its buffer returned
+ * right away, so a slow consumer can't stall the camera.
+ *
+ * Only formats VideoFrame or FFmpeg's decoders understand directly are captured natively, for
+ * any other format CameraSource falls back to FFmpeg's video4linux2 input device.
+ */
+
+/**
+ * @brief Memory mapped buffers of a streaming device, shared with frames still referencing them.
+ *
+ * The device is closed when the capture and all frames are gone.
+ */
+struct V4l2CaptureBuffers
+{
+    V4l2CaptureBuffers() = default;
+    ~V4l2CaptureBuffers();
+    V4l2CaptureBuffers(const V4l2CaptureBuffers&) = delete;
+    V4l2CaptureBuffers& operator=(const V4l2CaptureBuffers&) = delete;
+
+    bool queue(uint32_t index);
+
+    int fd = -1;
+    std::vector<std::pair<void*, size_t>> maps;
+    std::atomic_int queued{0};
+    std::atomic_bool streaming{false};
+};
+
+namespace {
+constexpr uint32_t BUFFER_COUNT = 6;
+constexpr int MIN_QUEUED_BUFFERS = 2;
+
+struct NativeFormat
+{
+    uint32_t fourcc;
+    AVPixelFormat pixelFormat;
+    AVCodecID codecId;
+};
+
+const NativeFormat nativeFormats[] = {
+    {V4L2_PIX_FMT_YUV420, AV_PIX_FMT_YUV420P, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_YUYV, AV_PIX_FMT_YUYV422, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_UYVY, AV_PIX_FMT_UYVY422, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_NV12, AV_PIX_FMT_NV12, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_RGB24, AV_PIX_FMT_RGB24, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_BGR24, AV_PIX_FMT_BGR24, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_GREY, AV_PIX_FMT_GRAY8, AV_CODEC_ID_NONE},
+    {V4L2_PIX_FMT_MJPEG, AV_PIX_FMT_NONE, AV_CODEC_ID_MJPEG},
+    {V4L2_PIX_FMT_JPEG, AV_PIX_FMT_NONE, AV_CODEC_ID_MJPEG},
+    {V4L2_PIX_FMT_H264, AV_PIX_FMT_NONE, AV_CODEC_ID_H264},
+};
+
+const NativeFormat* findNativeFormat(uint32_t fourcc)
+{
+    for (const NativeFormat& format : nativeFormats) {
+        if (format.fourcc == fourcc) {
+            return &format;
+        }
+    }
+
+    return nullptr;
+}
+
+int xioctl(int fd, unsigned long request, void* arg)
+{
+    int ret;
+    do {
+        ret = ioctl(fd, request, arg);
+    } while (ret == -1 && errno == EINTR);
+    return ret;
+}
+
+struct BufferOwner
+{
+    std::shared_ptr<V4l2CaptureBuffers> buffers;
+    uint32_t index;
+};
+
+void returnBuffer(void* opaque, uint8_t* data)
+{
+    std::ignore = data;
+    BufferOwner* owner = static_cast<BufferOwner*>(opaque);
+    owner->buffers->queue(owner->index);
+    delete owner;
+}
+} // namespace
+
+V4l2CaptureBuffers::~V4l2CaptureBuffers()
+{
+    for (const auto& map : maps) {
+        munmap(map.first, map.second);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Hands a buffer back to the driver to be filled again.
+ * @return False if the device doesn't stream anymore or refused the buffer.
+ */
+bool V4l2CaptureBuffers::queue(uint32_t index)
+{
+    if (!streaming) {
+        return false;
+    }
+
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (xioctl(fd, VIDIOC_QBUF, &buf) < 0) {
+        qWarning() << "Failed to queue capture buffer:" << strerror(errno);
+        return false;
+    }
+
+    ++queued;
+    return true;
+}
+
+/**
+ * @brief Opens a device and starts streaming.
+ * @param devName Device node, e.g. /dev/video0.
+ * @param mode Size, frame rate and V4L2 pixel format to capture in, the current format of the
+ * device is kept for all unset values.
+ * @return Capture or nullptr if the device can't stream in a format we capture natively.
+ */
+std::unique_ptr<CameraCapture> V4l2Capture::open(const QString& devName, const VideoMode& mode)
+{
+    auto buffers = std::make_shared<V4l2CaptureBuffers>();
+    const std::string path = devName.toStdString();
+    buffers->fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    const int fd = buffers->fd;
+    if (fd < 0) {
+        qWarning() << "Can't open" << devName << ":" << strerror(errno);
+        return nullptr;
+    }
+
+    v4l2_capability cap{};
+    if (xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        return nullptr;
+    }
+
+    const uint32_t caps =
+        (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+        return nullptr;
+    }
+
+    v4l2_format fmt{};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_FMT, &fmt) < 0) {
+        return nullptr;
+    }
+
+    if (mode.width > 0 && mode.height > 0) {
+        fmt.fmt.pix.width = static_cast<uint32_t>(mode.width);
+        fmt.fmt.pix.height = static_cast<uint32_t>(mode.height);
+    }
+    if (mode.pixel_format != 0) {
+        fmt.fmt.pix.pixelformat = mode.pixel_format;
+    }
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
+        qWarning() << "Can't set the capture format of" << devName << ":" << strerror(errno);
+        return nullptr;
+    }
+
+    const NativeFormat* format = findNativeFormat(fmt.fmt.pix.pixelformat);
+    if (!format || fmt.fmt.pix.field != V4L2_FIELD_NONE) {
+        qDebug() << "Format" << v4l2::getPixelFormatString(fmt.fmt.pix.pixelformat)
+                 << "can't be captured natively, using FFmpeg";
+        return nullptr;
+    }
+
+    if (mode.FPS > 0.0f) {
+        v4l2_streamparm parm{};
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1000;
+        parm.parm.capture.timeperframe.denominator =
+            static_cast<uint32_t>(std::lround(mode.FPS * 1000));
+        if (xioctl(fd, VIDIOC_S_PARM, &parm) < 0) {
+            qDebug() << "Can't set the frame rate of" << devName << ", using the default";
+        }
+    }
+
+    v4l2_requestbuffers req{};
+    req.count = BUFFER_COUNT;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0 || req.count < 2) {
+        qDebug() << devName << "doesn't support memory mapped capture, using FFmpeg";
+        return nullptr;
+    }
+
+    for (uint32_t i = 0; i < req.count; ++i) {
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+            return nullptr;
+        }
+
+        void* start =
+            mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+        if (start == MAP_FAILED) {
+            qWarning() << "Can't map capture buffer:" << strerror(errno);
+            return nullptr;
+        }
+
+        buffers->maps.emplace_back(start, buf.length);
+    }
+
+    buffers->streaming = true;
+    for (uint32_t i = 0; i < req.count; ++i) {
+        if (!buffers->queue(i)) {
+            return nullptr;
+        }
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+        qWarning() << "Can't start streaming from" << devName << ":" << strerror(errno);
+        return nullptr;
+    }
+
+    const QSize size{static_cast<int>(fmt.fmt.pix.width), static_cast<int>(fmt.fmt.pix.height)};
+    qDebug() << "Capturing" << devName << "natively at" << size << "in"
+             << v4l2::getPixelFormatString(fmt.fmt.pix.pixelformat);
+    return std::unique_ptr<CameraCapture>{new V4l2Capture{
+        std::move(buffers), size, fmt.fmt.pix.bytesperline, format->pixelFormat, format->codecId}};
+}
+
+V4l2Capture::V4l2Capture(std::shared_ptr<V4l2CaptureBuffers> buffers_, QSize size_,
+                         uint32_t bytesPerLine_, int pixelFormat_, int codecId_)
+    : buffers{std::move(buffers_)}
+    , size{size_}
+    , bytesPerLine{bytesPerLine_}
+    , pixelFormat{pixelFormat_}
+    , codecId{codecId_}
+{
+}
+
+V4l2Capture::~V4l2Capture()
+{
+    // frames still referencing buffers close the device once they're freed
+    buffers->streaming = false;
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(buffers->fd, VIDIOC_STREAMOFF, &type);
+}
+
+/**
+ * @brief Waits for the driver to fill a buffer with poll() and dequeues it.
+ */
+CameraCapture::Result V4l2Capture::capture(int timeoutMs, VideoFramePool& pool, AVFrame* frame,
+                                           AVPacket* packet)
+{
+    pollfd pfd{buffers->fd, POLLIN, 0};
+    const int ready = poll(&pfd, 1, timeoutMs);
+    if (ready == 0 || (ready < 0 && errno == EINTR)) {
+        return Result::None;
+    }
+
+    if (ready < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+        qWarning() << "Polling the camera failed, it was probably unplugged";
+        return Result::Failed;
+    }
+
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(buffers->fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno == EAGAIN) {
+            return Result::None;
+        }
+
+        qWarning() << "Failed to dequeue capture buffer:" << strerror(errno);
+        return Result::Failed;
+    }
+
+    --buffers->queued;
+    if ((buf.flags & V4L2_BUF_FLAG_ERROR) || buf.bytesused == 0) {
+        buffers->queue(buf.index);
+        return Result::None;
+    }
+
+    const bool isPacket = codecId != AV_CODEC_ID_NONE;
+    uint8_t* data = static_cast<uint8_t*>(buffers->maps[buf.index].first);
+    const size_t length = buffers->maps[buf.index].second;
+    const int bytesUsed = static_cast<int>(buf.bytesused);
+
+    // decoders may read past the end of the packet
+    const bool padded = !isPacket || length - buf.bytesused >= AV_INPUT_BUFFER_PADDING_SIZE;
+    AVBufferRef* buffer = nullptr;
+    if (buffers->queued >= MIN_QUEUED_BUFFERS && padded) {
+        BufferOwner* owner = new BufferOwner{buffers, buf.index};
+        buffer = av_buffer_create(data, bytesUsed, returnBuffer, owner, 0);
+        if (!buffer) {
+            delete owner;
+            buffers->queue(buf.index);
+        }
+    } else {
+        // compressed images vary in size, pooling their copies would only churn the pools
+        buffer = isPacket ? av_buffer_alloc(bytesUsed + AV_INPUT_BUFFER_PADDING_SIZE)
+                          : pool.acquireBuffer(bytesUsed);
+        if (buffer) {
+            memcpy(buffer->data, data, buf.bytesused);
+            if (isPacket) {
+                memset(buffer->data + bytesUsed, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+            }
+        }
+        buffers->queue(buf.index);
+    }
+
+    if (!buffer) {
+        return Result::None;
+    }
+
+    if (isPacket) {
+        packet->buf = buffer;
+        packet->data = buffer->data;
+        packet->size = bytesUsed;
+        return Result::Packet;
+    }
+
+    if (!fillFrame(frame, buffer, bytesUsed)) {
+        av_buffer_unref(&buffer);
+        return Result::None;
+    }
+
+    return Result::Frame;
+}
+
+int V4l2Capture::getCodecId() const
+{
+    return codecId;
+}
+
+QSize V4l2Capture::getSize() const
+{
+    return size;
+}
+
+/**
+ * @brief Points the planes of a frame into a captured raw image.
+ * @param frame Frame taking over the reference to buffer on success.
+ * @param buffer Captured image.
+ * @param bytesUsed Size of the image in buffer.
+ * @return False if the image is smaller than its format requires.
+ */
+bool V4l2Capture::fillFrame(AVFrame* frame, AVBufferRef* buffer, int bytesUsed) const
+{
+    const AVPixelFormat format = static_cast<AVPixelFormat>(pixelFormat);
+    if (av_image_fill_linesizes(frame->linesize, format, size.width()) < 0) {
+        return false;
+    }
+
+    // bytesperline describes the first plane, the other planes are padded in proportion
+    const int padded = static_cast<int>(bytesPerLine);
+    if (padded > frame->linesize[0]) {
+        const int unpadded = frame->linesize[0];
+        for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->linesize[i] > 0; ++i) {
+            frame->linesize[i] = frame->linesize[i] * padded / unpadded;
+        }
+    }
+
+    const int required =
+        av_image_fill_pointers(frame->data, format, size.height(), buffer->data, frame->linesize);
+    if (required < 0 || required > bytesUsed) {
+        return false;
+    }
+
+    frame->width = size.width();
+    frame->height = size.height();
+    frame->format = pixelFormat;
+    frame->buf[0] = buffer;
+    return true;
+}
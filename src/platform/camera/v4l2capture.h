@@ -0,0 +1,57 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "src/video/cameracapture.h"
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <memory>
+
+#if !(defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD))
+#error "This file is only meant to be compiled for Linux or FreeBSD targets"
+#endif
+
+struct AVBufferRef;
+struct V4l2CaptureBuffers;
+
+class V4l2Capture : public CameraCapture
+{
+public:
+    static std::unique_ptr<CameraCapture> open(const QString& devName, const VideoMode& mode);
+    ~V4l2Capture() override;
+
+    Result capture(int timeoutMs, VideoFramePool& pool, AVFrame* frame,
+                   AVPacket* packet) override;
+    int getCodecId() const override;
+    QSize getSize() const override;
+
+private:
+    V4l2Capture(std::shared_ptr<V4l2CaptureBuffers> buffers_, QSize size_, uint32_t bytesPerLine_,
+                int pixelFormat_, int codecId_);
+    bool fillFrame(AVFrame* frame, AVBufferRef* buffer, int bytesUsed) const;
+
+    std::shared_ptr<V4l2CaptureBuffers> buffers;
+    QSize size;
+    uint32_t bytesPerLine;
+    int pixelFormat;
+    int codecId;
+};
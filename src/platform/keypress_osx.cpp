@@ -0,0 +1,30 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/keypress.h"
+#include <CoreGraphics/CoreGraphics.h>
+
+bool Platform::anyKeyPressed()
+{
+    // there is no key state to poll, treat a key down within the last audio frame as pressed
+    const CFTimeInterval sinceKeyDown =
+        CGEventSourceSecondsSinceLastEventType(kCGEventSourceStateHIDSystemState, kCGEventKeyDown);
+    return sinceKeyDown < 0.05;
+}
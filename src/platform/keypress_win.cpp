@@ -0,0 +1,33 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/keypress.h"
+#include <windows.h>
+
+bool Platform::anyKeyPressed()
+{
+    // skip the mouse buttons, they're virtual keys 0x01 to 0x06
+    for (int key = VK_BACK; key <= 0xFE; ++key) {
+        if (GetAsyncKeyState(key) & 0x8000) {
+            return true;
+        }
+    }
+    return false;
+}
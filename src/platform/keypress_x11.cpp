@@ -0,0 +1,43 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/keypress.h"
+#include "src/platform/x11_display.h"
+#include <X11/Xlib.h>
+#undef KeyPress
+#undef KeyRelease
+#undef FocusIn
+#undef FocusOut
+
+#include <algorithm>
+
+bool Platform::anyKeyPressed()
+{
+    Display* d = X11Display::lock();
+    bool pressed = false;
+    if (d) {
+        // one bit per keycode, set while the key is held down
+        char keys[32] = {};
+        XQueryKeymap(d, keys);
+        pressed = std::any_of(keys, keys + sizeof(keys), [](char bits) { return bits != 0; });
+    }
+    X11Display::unlock();
+    return pressed;
+}
@@ -0,0 +1,101 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/memorypressure.h"
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+
+namespace {
+// share of the time some tasks stalled on memory over the last 10 seconds, in percent
+const double STALL_PERCENT = 10.0;
+// available memory below this share of the total counts as low without pressure stall info
+const double AVAILABLE_SHARE = 0.1;
+
+QByteArray readProcFile(const char* path)
+{
+    QFile file{QString::fromLatin1(path)};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    // files in /proc report a size of 0, readAll() reads until the end anyway
+    return file.readAll();
+}
+
+/**
+ * @brief Reads "some avg10" of /proc/pressure/memory, available since Linux 4.20.
+ * @return Percentage, negative if the kernel doesn't report it.
+ */
+double memoryStallPercent()
+{
+    const QByteArray pressure = readProcFile("/proc/pressure/memory");
+    for (const QByteArray& line : pressure.split('\n')) {
+        if (!line.startsWith("some ")) {
+            continue;
+        }
+
+        for (const QByteArray& field : line.split(' ')) {
+            if (field.startsWith("avg10=")) {
+                bool ok = false;
+                const double value = field.mid(6).toDouble(&ok);
+                return ok ? value : -1.0;
+            }
+        }
+    }
+
+    return -1.0;
+}
+
+qint64 meminfoKb(const QByteArray& meminfo, const QByteArray& key)
+{
+    for (const QByteArray& line : meminfo.split('\n')) {
+        if (line.startsWith(key)) {
+            return line.mid(key.size()).trimmed().split(' ').first().toLongLong();
+        }
+    }
+
+    return 0;
+}
+} // namespace
+
+/**
+ * @brief Whether the kernel reports memory pressure, or little memory is available.
+ *
+ * Pressure stall information also notices a system that thrashes while some memory is still
+ * available, MemAvailable is the fallback for kernels without it. Both are read from /proc, so
+ * systems without it never report low memory.
+ */
+bool Platform::isMemoryLow()
+{
+    const double stall = memoryStallPercent();
+    if (stall >= 0) {
+        return stall >= STALL_PERCENT;
+    }
+
+    const QByteArray meminfo = readProcFile("/proc/meminfo");
+    const qint64 totalKb = meminfoKb(meminfo, "MemTotal:");
+    const qint64 availableKb = meminfoKb(meminfo, "MemAvailable:");
+    if (totalKb <= 0 || availableKb <= 0) {
+        return false;
+    }
+
+    return availableKb < totalKb * AVAILABLE_SHARE;
+}
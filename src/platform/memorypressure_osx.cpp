@@ -0,0 +1,41 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/memorypressure.h"
+#include <sys/sysctl.h>
+
+namespace {
+// kern.memorystatus_vm_pressure_level reports DISPATCH_MEMORYPRESSURE_WARN or worse
+const int PRESSURE_LEVEL_WARN = 2;
+} // namespace
+
+/**
+ * @brief Whether the kernel reports memory pressure.
+ */
+bool Platform::isMemoryLow()
+{
+    int level = 0;
+    size_t size = sizeof(level);
+    if (sysctlbyname("kern.memorystatus_vm_pressure_level", &level, &size, nullptr, 0) != 0) {
+        return false;
+    }
+
+    return level >= PRESSURE_LEVEL_WARN;
+}
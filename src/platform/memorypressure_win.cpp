@@ -0,0 +1,41 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/qsystemdetection.h>
+#include "src/platform/memorypressure.h"
+#include <windows.h>
+
+namespace {
+// percentage of the physical memory in use from which Windows starts paging heavily
+const DWORD HIGH_MEMORY_LOAD = 90;
+} // namespace
+
+/**
+ * @brief Whether the system runs low on physical memory.
+ */
+bool Platform::isMemoryLow()
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) {
+        return false;
+    }
+
+    return status.dwMemoryLoad >= HIGH_MEMORY_LOAD;
+}
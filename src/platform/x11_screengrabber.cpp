@@ -0,0 +1,348 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/platform/x11_screengrabber.h"
+
+#include <QDebug>
+#include <QString>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @class X11ScreenGrabber
+ * @brief Grabs the screen through the MIT-SHM extension and tracks changes with XDamage.
+ *
+ * The image is copied by the X server straight into a shared memory segment, and only when the
+ * damage reported for the root window intersects the grabbed region or the cursor moved. The
+ * cursor is drawn into the image with XFixes, like x11grab does.
+ *
+ * When following a window, the top level window below the center of the region is watched for
+ * ConfigureNotify events and the region keeps its offset to it, so users can share a single
+ * window without capturing and encoding the rest of the desktop. The region size never changes,
+ * so the stream resolution stays the same while the window moves.
+ */
+
+namespace {
+bool xErrorOccurred = false;
+
+int ignoreXError(Display*, XErrorEvent*)
+{
+    xErrorOccurred = true;
+    return 0;
+}
+} // namespace
+
+X11ScreenGrabber::X11ScreenGrabber(Display* display_)
+    : display{display_}
+{
+    shmInfo.shmid = -1;
+    shmInfo.shmaddr = nullptr;
+}
+
+X11ScreenGrabber::~X11ScreenGrabber()
+{
+    if (damageHandle) {
+        XDamageDestroy(display, damageHandle);
+    }
+
+    if (followed) {
+        XSelectInput(display, followed, NoEventMask);
+    }
+
+    if (shmAttached) {
+        XShmDetach(display, &shmInfo);
+        XSync(display, False);
+    }
+
+    if (image) {
+        // the data is the shared memory segment, detached below
+        image->data = nullptr;
+        XDestroyImage(image);
+    }
+
+    if (shmInfo.shmaddr) {
+        shmdt(shmInfo.shmaddr);
+    }
+
+    XCloseDisplay(display);
+}
+
+/**
+ * @brief Connects to the X server and sets up shared memory and damage tracking.
+ * @param displayName X display, e.g. ":0".
+ * @param region Part of the root window to grab, the whole root window if empty.
+ * @param followWindow Move the region along with the window below its center.
+ * @return Grabber or nullptr if the needed extensions aren't available.
+ */
+std::unique_ptr<ScreenGrabber> X11ScreenGrabber::create(const QString& displayName,
+                                                        const QRect& region, bool followWindow)
+{
+    const QByteArray name = displayName.toLocal8Bit();
+    Display* display = XOpenDisplay(name.isEmpty() ? nullptr : name.constData());
+    if (!display) {
+        qWarning() << "Can't open X display" << displayName;
+        return nullptr;
+    }
+
+    std::unique_ptr<X11ScreenGrabber> grabber{new X11ScreenGrabber(display)};
+    if (!grabber->init(region)) {
+        return nullptr;
+    }
+
+    if (followWindow) {
+        grabber->trackWindow();
+    }
+
+    return std::move(grabber);
+}
+
+bool X11ScreenGrabber::init(const QRect& wantedRegion)
+{
+    int damageErrorBase;
+    int fixesEventBase;
+    int fixesErrorBase;
+    if (!XShmQueryExtension(display)
+        || !XDamageQueryExtension(display, &damageEventBase, &damageErrorBase)
+        || !XFixesQueryExtension(display, &fixesEventBase, &fixesErrorBase)) {
+        qWarning() << "X server lacks MIT-SHM, DAMAGE or XFIXES, using x11grab";
+        return false;
+    }
+
+    const int screen = DefaultScreen(display);
+    root = RootWindow(display, screen);
+    rootRect = QRect{0, 0, DisplayWidth(display, screen), DisplayHeight(display, screen)};
+    region = wantedRegion.isEmpty() ? rootRect : wantedRegion.intersected(rootRect);
+    if (region.isEmpty()) {
+        qWarning() << "Screen region" << wantedRegion << "is outside of the screen";
+        return false;
+    }
+
+    image = XShmCreateImage(display, DefaultVisual(display, screen), DefaultDepth(display, screen),
+                            ZPixmap, nullptr, &shmInfo, region.width(), region.height());
+    if (!image || image->bits_per_pixel != 32) {
+        qWarning() << "Unsupported X visual for native screen grabbing";
+        return false;
+    }
+
+    shmInfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (shmInfo.shmid < 0) {
+        return false;
+    }
+
+    shmInfo.shmaddr = static_cast<char*>(shmat(shmInfo.shmid, nullptr, 0));
+    // the segment is freed once both sides detached
+    shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+    if (shmInfo.shmaddr == reinterpret_cast<char*>(-1)) {
+        shmInfo.shmaddr = nullptr;
+        return false;
+    }
+
+    image->data = shmInfo.shmaddr;
+    shmInfo.readOnly = False;
+    if (!XShmAttach(display, &shmInfo)) {
+        return false;
+    }
+    shmAttached = true;
+
+    damageHandle = XDamageCreate(display, root, XDamageReportBoundingBox);
+    XSync(display, False);
+
+    qDebug() << "Grabbing" << region << "with MIT-SHM";
+    return true;
+}
+
+bool X11ScreenGrabber::grab(QRect& damage)
+{
+    while (XPending(display)) {
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type == damageEventBase + XDamageNotify) {
+            const XDamageNotifyEvent* notify = reinterpret_cast<XDamageNotifyEvent*>(&event);
+            pendingDamage |= QRect{notify->area.x, notify->area.y, notify->area.width,
+                                   notify->area.height};
+        } else if (event.type == ConfigureNotify && event.xconfigure.window == followed) {
+            if (moveWithWindow(event.xconfigure)) {
+                firstGrab = true;
+            }
+        } else if (event.type == DestroyNotify && event.xdestroywindow.window == followed) {
+            qDebug() << "Followed window was closed, keeping the last region";
+            followed = 0;
+        }
+    }
+    // everything changing after this point triggers a new event
+    XDamageSubtract(display, damageHandle, None, None);
+
+    XFixesCursorImage* cursor = nullptr;
+    const QRect cursorRect = queryCursor(cursor);
+    if (cursorRect != lastCursorRect) {
+        pendingDamage |= cursorRect | lastCursorRect;
+        lastCursorRect = cursorRect;
+    }
+
+    damage = pendingDamage.intersected(region).translated(-region.topLeft());
+    if (firstGrab) {
+        damage = QRect{QPoint{}, region.size()};
+    }
+
+    if (damage.isEmpty()) {
+        if (cursor) {
+            XFree(cursor);
+        }
+        return true;
+    }
+
+    const bool ok = XShmGetImage(display, root, image, region.x(), region.y(), AllPlanes);
+    if (ok) {
+        if (cursor) {
+            drawCursor(*cursor);
+        }
+        pendingDamage = QRect{};
+        firstGrab = false;
+    } else {
+        qWarning() << "XShmGetImage failed";
+    }
+
+    if (cursor) {
+        XFree(cursor);
+    }
+    return ok;
+}
+
+const uint8_t* X11ScreenGrabber::getData() const
+{
+    return reinterpret_cast<const uint8_t*>(image->data);
+}
+
+int X11ScreenGrabber::getStride() const
+{
+    return image->bytes_per_line;
+}
+
+QSize X11ScreenGrabber::getSize() const
+{
+    return region.size();
+}
+
+/**
+ * @brief Fetches the cursor image.
+ * @param cursor Set to the cursor image or nullptr, must be freed with XFree.
+ * @return Cursor rectangle in root window coordinates.
+ */
+QRect X11ScreenGrabber::queryCursor(XFixesCursorImage*& cursor)
+{
+    cursor = XFixesGetCursorImage(display);
+    if (!cursor) {
+        return {};
+    }
+
+    return {cursor->x - cursor->xhot, cursor->y - cursor->yhot, cursor->width, cursor->height};
+}
+
+/**
+ * @brief Blends the premultiplied ARGB cursor into the grabbed image.
+ */
+void X11ScreenGrabber::drawCursor(const XFixesCursorImage& cursor)
+{
+    const QRect cursorRect{cursor.x - cursor.xhot, cursor.y - cursor.yhot, cursor.width,
+                           cursor.height};
+    const QRect visible = cursorRect.intersected(region);
+
+    for (int y = visible.top(); y <= visible.bottom(); ++y) {
+        uint8_t* dst = reinterpret_cast<uint8_t*>(image->data)
+                       + (y - region.y()) * image->bytes_per_line + (visible.x() - region.x()) * 4;
+        // XFixes stores every 32 bit pixel in an unsigned long
+        const unsigned long* src =
+            cursor.pixels + (y - cursorRect.y()) * cursor.width + (visible.x() - cursorRect.x());
+
+        for (int x = 0; x < visible.width(); ++x, dst += 4, ++src) {
+            const uint32_t pixel = static_cast<uint32_t>(*src);
+            const uint32_t alpha = pixel >> 24;
+            if (alpha == 0) {
+                continue;
+            }
+
+            const uint32_t inverse = 255 - alpha;
+            dst[0] = static_cast<uint8_t>((pixel & 0xff) + dst[0] * inverse / 255);
+            dst[1] = static_cast<uint8_t>(((pixel >> 8) & 0xff) + dst[1] * inverse / 255);
+            dst[2] = static_cast<uint8_t>(((pixel >> 16) & 0xff) + dst[2] * inverse / 255);
+        }
+    }
+}
+
+/**
+ * @brief Starts following the top level window below the center of the region.
+ *
+ * Top level windows are the direct children of the root window, with a reparenting window manager
+ * that's the frame, whose ConfigureNotify coordinates are relative to the root window.
+ */
+void X11ScreenGrabber::trackWindow()
+{
+    const QPoint center = region.center();
+    int x;
+    int y;
+    Window child = 0;
+    XTranslateCoordinates(display, root, root, center.x(), center.y(), &x, &y, &child);
+    if (!child) {
+        qDebug() << "No window below" << center << "to follow";
+        return;
+    }
+
+    XWindowAttributes attributes;
+    // the window may be gone already, which must not end the process
+    xErrorOccurred = false;
+    XSync(display, False);
+    const auto previousHandler = XSetErrorHandler(ignoreXError);
+    const bool known = XGetWindowAttributes(display, child, &attributes);
+    XSelectInput(display, child, StructureNotifyMask);
+    XSync(display, False);
+    XSetErrorHandler(previousHandler);
+    if (!known || xErrorOccurred) {
+        return;
+    }
+
+    followed = child;
+    windowOffset = region.topLeft() - QPoint{attributes.x, attributes.y};
+    qDebug() << "Following window" << followed << "with region offset" << windowOffset;
+}
+
+/**
+ * @brief Moves the region to keep its offset to the followed window.
+ * @return True if the region moved.
+ */
+bool X11ScreenGrabber::moveWithWindow(const XConfigureEvent& event)
+{
+    QRect moved = region;
+    moved.moveTopLeft(QPoint{event.x, event.y} + windowOffset);
+
+    // keep the whole region on screen, the image has a fixed size
+    const int maxX = rootRect.right() - moved.width() + 1;
+    const int maxY = rootRect.bottom() - moved.height() + 1;
+    moved.moveLeft(std::max(rootRect.left(), std::min(moved.left(), maxX)));
+    moved.moveTop(std::max(rootRect.top(), std::min(moved.top(), maxY)));
+    if (moved == region) {
+        return false;
+    }
+
+    region = moved;
+    return true;
+}
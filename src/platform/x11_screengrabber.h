@@ -0,0 +1,69 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef QTOX_X11_SCREEN_GRAB
+
+#include "src/video/screengrabber.h"
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+
+class QString;
+
+class X11ScreenGrabber : public ScreenGrabber
+{
+public:
+    static std::unique_ptr<ScreenGrabber> create(const QString& displayName, const QRect& region,
+                                                 bool followWindow);
+    ~X11ScreenGrabber() override;
+
+    bool grab(QRect& damage) override;
+    const uint8_t* getData() const override;
+    int getStride() const override;
+    QSize getSize() const override;
+
+private:
+    explicit X11ScreenGrabber(Display* display_);
+    bool init(const QRect& wantedRegion);
+    QRect queryCursor(XFixesCursorImage*& cursor);
+    void drawCursor(const XFixesCursorImage& cursor);
+    void trackWindow();
+    bool moveWithWindow(const XConfigureEvent& event);
+
+    Display* display;
+    Window root{0};
+    QRect region;
+    QRect rootRect;
+    Window followed{0};
+    QPoint windowOffset;
+    XImage* image{nullptr};
+    XShmSegmentInfo shmInfo;
+    bool shmAttached{false};
+    Damage damageHandle{0};
+    int damageEventBase{0};
+    bool firstGrab{true};
+    QRect pendingDamage;
+    QRect lastCursorRect;
+};
+
+#endif // QTOX_X11_SCREEN_GRAB
@@ -0,0 +1,83 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cameracapture.h"
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+#include "src/platform/camera/v4l2capture.h"
+#endif
+
+#include <QString>
+
+#include <tuple>
+
+/**
+ * @class CameraCapture
+ * @brief Native camera capture backend used by CameraSource instead of an FFmpeg input device.
+ *
+ * Backends wait for the driver without busy looping and hand its buffers out without copying
+ * them, the buffer returns to the driver once the last frame or packet referencing it is freed.
+ *
+ * @enum CameraCapture::Result
+ * @brief Outcome of a capture() call.
+ *
+ * @var CameraCapture::Result::None
+ * @brief Nothing was captured within the timeout, or the captured buffer was unusable.
+ * @var CameraCapture::Result::Frame
+ * @brief A raw image was captured into the frame.
+ * @var CameraCapture::Result::Packet
+ * @brief A compressed image was captured into the packet, it needs to be decoded with the codec
+ * returned by getCodecId().
+ * @var CameraCapture::Result::Failed
+ * @brief The device stopped working and the backend should not be used anymore.
+ *
+ * @fn CameraCapture::Result CameraCapture::capture(int timeoutMs, VideoFramePool& pool,
+ *                                                 AVFrame* frame, AVPacket* packet)
+ * @brief Waits for the next image of the camera.
+ * @param timeoutMs Longest time to wait for an image.
+ * @param pool Pool to copy the image into if the driver is short on buffers.
+ * @param frame Empty frame, filled in if a raw image was captured.
+ * @param packet Empty packet, filled in if a compressed image was captured.
+ *
+ * @fn int CameraCapture::getCodecId() const
+ * @brief AVCodecID to decode captured packets with, AV_CODEC_ID_NONE if only raw frames are
+ * captured.
+ */
+
+CameraCapture::~CameraCapture() = default;
+
+/**
+ * @brief Creates the native backend for a camera, if there is one for this platform.
+ * @param deviceName Device name as used by CameraDevice, e.g. "/dev/video0".
+ * @param mode Mode to open the camera in, the current mode of the camera if empty.
+ * @return Capture backend or nullptr if FFmpeg has to be used.
+ */
+std::unique_ptr<CameraCapture> CameraCapture::create(const QString& deviceName,
+                                                     const VideoMode& mode)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+    if (deviceName.startsWith("/dev/")) {
+        return V4l2Capture::open(deviceName, mode);
+    }
+#endif
+
+    std::ignore = deviceName;
+    std::ignore = mode;
+    return nullptr;
+}
@@ -0,0 +1,54 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QSize>
+
+#include <memory>
+
+class QString;
+class VideoFramePool;
+struct AVFrame;
+struct AVPacket;
+struct VideoMode;
+
+class CameraCapture
+{
+public:
+    enum class Result
+    {
+        None,
+        Frame,
+        Packet,
+        Failed
+    };
+
+    CameraCapture() = default;
+    virtual ~CameraCapture();
+    CameraCapture(const CameraCapture&) = delete;
+    CameraCapture& operator=(const CameraCapture&) = delete;
+
+    static std::unique_ptr<CameraCapture> create(const QString& deviceName, const VideoMode& mode);
+
+    virtual Result capture(int timeoutMs, VideoFramePool& pool, AVFrame* frame,
+                           AVPacket* packet) = 0;
+    virtual int getCodecId() const = 0;
+    virtual QSize getSize() const = 0;
+};
@@ -21,6 +21,7 @@
 #include <QDebug>
 #include <QDesktopWidget>
 #include <QScreen>
+#include <QSysInfo>
 extern "C" {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
@@ -480,6 +481,22 @@ QVector<VideoMode> CameraDevice::getVideoModes(QString devName)
     return {};
 }
 
+/**
+ * @brief Identifies the hardware and driver behind a device without opening it.
+ * @param devName Device name as returned by getDeviceList().
+ * @return Changes if the device name refers to another camera or the driver changed.
+ */
+QString CameraDevice::getDeviceFingerprint(const QString& devName)
+{
+#if USING_V4L
+    if (devName.startsWith(QStringLiteral("/dev/"))) {
+        return v4l2::getDeviceFingerprint(devName);
+    }
+#endif
+    // DirectShow and AVFoundation names already identify the hardware
+    return devName + '|' + QSysInfo::kernelVersion();
+}
+
 /**
  * @brief Get the name of the pixel format of a video mode.
  * @param pixel_format Pixel format to get the name from.
@@ -43,6 +43,7 @@ public:
     static QVector<QPair<QString, QString>> getDeviceList();
 
     static QVector<VideoMode> getVideoModes(QString devName);
+    static QString getDeviceFingerprint(const QString& devName);
     static QString getPixelFormatString(uint32_t pixel_format);
     static bool betterPixelFormat(uint32_t a, uint32_t b);
 
@@ -0,0 +1,188 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cameramodecache.h"
+#include "cameradevice.h"
+#include "ivideosettings.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+
+/**
+ * @class CameraModeCache
+ * @brief Remembers the video modes of cameras, so they don't have to be opened to list them.
+ *
+ * Probing a camera opens it, which can take hundreds of milliseconds. The modes are kept per
+ * device together with a fingerprint of the hardware and driver behind it, see
+ * CameraDevice::getDeviceFingerprint(), and persisted in the settings. A device is probed again
+ * if its fingerprint changed, e.g. because another camera got the same device node or the driver
+ * was updated.
+ *
+ * On Linux, /dev is watched to notice hotplugging. Entries of devices that are gone are dropped
+ * and devicesChanged() is emitted so the device list can be refreshed.
+ *
+ * Screens are never cached, their modes change with the screen setup and are cheap to list.
+ */
+
+constexpr int CameraModeCache::FORMAT_VERSION;
+
+CameraModeCache::CameraModeCache(IVideoSettings& settings_, QObject* parent)
+    : CameraModeCache(settings_, CameraDevice::getVideoModes, CameraDevice::getDeviceFingerprint,
+                      parent)
+{
+}
+
+/**
+ * @brief Creates a cache probing devices with custom functions instead of CameraDevice.
+ */
+CameraModeCache::CameraModeCache(IVideoSettings& settings_, Prober prober_,
+                                 Fingerprinter fingerprinter_, QObject* parent)
+    : QObject(parent)
+    , settings{settings_}
+    , prober{std::move(prober_)}
+    , fingerprinter{std::move(fingerprinter_)}
+{
+    load();
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+    if (QDir{"/dev"}.exists()) {
+        hotplugWatcher.addPath("/dev");
+    }
+#endif
+    connect(&hotplugWatcher, &QFileSystemWatcher::directoryChanged, this,
+            &CameraModeCache::onDevicesChanged);
+}
+
+/**
+ * @brief Lists the video modes of a device, probing it only if they aren't known.
+ * @param devName Device name as returned by CameraDevice::getDeviceList().
+ * @return Supported modes, empty if the device couldn't be probed.
+ */
+QVector<VideoMode> CameraModeCache::getVideoModes(const QString& devName)
+{
+    if (CameraDevice::isScreen(devName)) {
+        return prober(devName);
+    }
+
+    const QString fingerprint = fingerprinter(devName);
+    auto it = entries.constFind(devName);
+    if (it != entries.constEnd() && it->fingerprint == fingerprint) {
+        return it->modes;
+    }
+
+    const QVector<VideoMode> modes = prober(devName);
+    if (modes.isEmpty()) {
+        // maybe busy or unplugged right now, try again next time
+        return modes;
+    }
+
+    entries.insert(devName, {fingerprint, modes});
+    save();
+    return modes;
+}
+
+/**
+ * @brief Forgets the modes of a device, it is probed again the next time.
+ */
+void CameraModeCache::invalidate(const QString& devName)
+{
+    if (entries.remove(devName) > 0) {
+        save();
+    }
+}
+
+void CameraModeCache::onDevicesChanged()
+{
+    bool removed = false;
+    for (auto it = entries.begin(); it != entries.end();) {
+        // only device nodes can be checked without opening them
+        if (it.key().startsWith('/') && !QFile::exists(it.key())) {
+            it = entries.erase(it);
+            removed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    if (removed) {
+        save();
+    }
+    emit devicesChanged();
+}
+
+void CameraModeCache::load()
+{
+    const QByteArray data = settings.getCamModeCache();
+    if (data.isEmpty()) {
+        return;
+    }
+
+    QDataStream stream{data};
+    qint32 version = 0;
+    qint32 count = 0;
+    stream >> version >> count;
+    if (version != FORMAT_VERSION) {
+        qDebug() << "Dropping camera mode cache of version" << version;
+        return;
+    }
+
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString devName;
+        Entry entry;
+        qint32 modeCount = 0;
+        stream >> devName >> entry.fingerprint >> modeCount;
+        for (qint32 j = 0; j < modeCount && stream.status() == QDataStream::Ok; ++j) {
+            VideoMode mode;
+            qint32 width, height, x, y;
+            quint32 pixelFormat;
+            stream >> width >> height >> x >> y >> mode.FPS >> pixelFormat;
+            mode.width = width;
+            mode.height = height;
+            mode.x = x;
+            mode.y = y;
+            mode.pixel_format = pixelFormat;
+            entry.modes.append(mode);
+        }
+        entries.insert(devName, entry);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Camera mode cache is corrupted, dropping it";
+        entries.clear();
+    }
+}
+
+void CameraModeCache::save()
+{
+    QByteArray data;
+    QDataStream stream{&data, QIODevice::WriteOnly};
+    stream << static_cast<qint32>(FORMAT_VERSION) << static_cast<qint32>(entries.size());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        stream << it.key() << it->fingerprint << static_cast<qint32>(it->modes.size());
+        for (const VideoMode& mode : it->modes) {
+            stream << static_cast<qint32>(mode.width) << static_cast<qint32>(mode.height)
+                   << static_cast<qint32>(mode.x) << static_cast<qint32>(mode.y) << mode.FPS
+                   << static_cast<quint32>(mode.pixel_format);
+        }
+    }
+
+    settings.setCamModeCache(data);
+}
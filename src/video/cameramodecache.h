@@ -0,0 +1,73 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "videomode.h"
+
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+class IVideoSettings;
+
+class CameraModeCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Prober = std::function<QVector<VideoMode>(const QString& devName)>;
+    using Fingerprinter = std::function<QString(const QString& devName)>;
+
+    explicit CameraModeCache(IVideoSettings& settings, QObject* parent = nullptr);
+    CameraModeCache(IVideoSettings& settings, Prober prober, Fingerprinter fingerprinter,
+                    QObject* parent = nullptr);
+
+    QVector<VideoMode> getVideoModes(const QString& devName);
+    void invalidate(const QString& devName);
+
+signals:
+    void devicesChanged();
+
+private slots:
+    void onDevicesChanged();
+
+private:
+    struct Entry
+    {
+        QString fingerprint;
+        QVector<VideoMode> modes;
+    };
+
+    void load();
+    void save();
+
+    static constexpr int FORMAT_VERSION = 1;
+
+    IVideoSettings& settings;
+    Prober prober;
+    Fingerprinter fingerprinter;
+    QHash<QString, Entry> entries;
+    QFileSystemWatcher hotplugWatcher;
+};
@@ -23,19 +23,87 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavdevice/avdevice.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 #pragma GCC diagnostic pop
 }
+#include "cameracapture.h"
 #include "cameradevice.h"
 #include "camerasource.h"
+#include "screengrabber.h"
 #include "videoframe.h"
+#include "videoframepool.h"
 #include "src/persistence/settings.h"
+#include "util/cacheregistry.h"
+#include "util/threadcputime.h"
+#include "util/threadscheduling.h"
+#include "util/tracer.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QMetaMethod>
 #include <QReadLocker>
+#include <QScreen>
+#include <QTimer>
 #include <QWriteLocker>
 #include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <tuple>
+#include <vector>
+
+// avcodec_get_hw_config() and the AVCodecHWConfig API appeared in FFmpeg 4.0
+#define HW_DECODE_SUPPORTED (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 18, 100))
+
+namespace {
+#if HW_DECODE_SUPPORTED
+/**
+ * @brief Hardware decoders to try, in order of preference, for the platform we're built for.
+ */
+const std::vector<AVHWDeviceType>& preferredHwDevices()
+{
+    static const std::vector<AVHWDeviceType> devices{
+#if defined(Q_OS_WIN)
+        AV_HWDEVICE_TYPE_D3D11VA, AV_HWDEVICE_TYPE_DXVA2,
+#elif defined(Q_OS_MACOS)
+        AV_HWDEVICE_TYPE_VIDEOTOOLBOX,
+#elif defined(Q_OS_LINUX)
+        AV_HWDEVICE_TYPE_VAAPI, AV_HWDEVICE_TYPE_VDPAU,
+#endif
+    };
+    return devices;
+}
+
+/**
+ * @brief get_format callback picking the hardware format chosen in setupHwDecoder().
+ *
+ * If the decoder doesn't offer it, e.g. for an unsupported profile, the first software format is
+ * picked and FFmpeg decodes on the CPU.
+ */
+AVPixelFormat getHwFormat(AVCodecContext* ctx, const AVPixelFormat* formats)
+{
+    const int wanted = *static_cast<int*>(ctx->opaque);
+    for (const AVPixelFormat* fmt = formats; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+        if (*fmt == wanted) {
+            return *fmt;
+        }
+    }
+
+    qWarning() << "Hardware decoding not possible for this stream, falling back to software";
+    for (const AVPixelFormat* fmt = formats; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(*fmt);
+        if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            return *fmt;
+        }
+    }
+
+    return AV_PIX_FMT_NONE;
+}
+#endif
+} // namespace
 
 /**
  * @class CameraSource
@@ -64,6 +132,18 @@ extern "C" {
  * @brief Non-owning pointer to an open CameraDevice, or nullptr. Not atomic, synced with memfences
  * when becomes null.
  *
+ * @var std::unique_ptr<ScreenGrabber> CameraSource::screenGrabber
+ * @brief Native screen capture used instead of device for screens, where available
+ *
+ * @var std::unique_ptr<CameraCapture> CameraSource::capture
+ * @brief Native camera capture used instead of device for cameras, where available
+ *
+ * @var std::atomic_int CameraSource::pendingDeviceChanges
+ * @brief Number of threads waiting to lock the streamMutex for writing
+ *
+ * The stream threads keep the streamMutex locked for reading while streaming and only let go of
+ * it when this is non-zero.
+ *
  * @var VideoMode CameraSource::mode
  * @brief What mode we tried to open the device in, all zeros means default mode
  *
@@ -77,6 +157,15 @@ extern "C" {
  * @var int CameraSource::videoStreamIndex
  * @brief A camera can have multiple streams, this is the one we're decoding
  *
+ * @var std::shared_ptr<VideoFramePool> CameraSource::framePool
+ * @brief Recycles decoded frames and their conversion buffers, shared with the emitted frames
+ *
+ * @var AVBufferRef* CameraSource::hwDeviceCtx
+ * @brief Hardware decoder device of the current stream, or nullptr when decoding in software
+ *
+ * @var int CameraSource::hwPixelFormat
+ * @brief Pixel format of frames decoded in hardware, AV_PIX_FMT_NONE when decoding in software
+ *
  * @var QMutex CameraSource::biglock
  * @brief True when locked. Faster than mutexes for video decoding.
  *
@@ -88,10 +177,20 @@ extern "C" {
  *
  * @var std::atomic_int CameraSource::subscriptions
  * @brief Remember how many times we subscribed for RAII
+ *
+ * @var QTimer* CameraSource::standbyTimer
+ * @brief Closes a camera kept open after the last subscriber left, see closeDevice()
+ *
+ * @struct CameraSource::OpenedDevice
+ * @brief Everything a stream loop needs, a device is opened into one before it replaces the
+ * streaming device
  */
 
+constexpr int CameraSource::CAMERA_STANDBY_MS;
+
 CameraSource::CameraSource(Settings& settings_)
     : deviceThread{new QThread}
+    , standbyTimer{new QTimer(this)}
     , deviceName{"none"}
     , device{nullptr}
     , mode(VideoMode())
@@ -101,11 +200,20 @@ CameraSource::CameraSource(Settings& settings_)
     , cctxOrig{nullptr}
 #endif
     , videoStreamIndex{-1}
+    , framePool{std::make_shared<VideoFramePool>()}
+    , hwDeviceCtx{nullptr}
+    , hwPixelFormat{AV_PIX_FMT_NONE}
     , isNone_{true}
+    , isScreen_{false}
     , subscriptions{0}
+    , pendingDeviceChanges{0}
     , settings{settings_}
 {
     qRegisterMetaType<VideoMode>("VideoMode");
+    standbyTimer->setSingleShot(true);
+    standbyTimer->setInterval(CAMERA_STANDBY_MS);
+    connect(standbyTimer, &QTimer::timeout, this, &CameraSource::onStandbyTimeout);
+
     deviceThread->setObjectName("Device thread");
     deviceThread->start();
     moveToThread(deviceThread);
@@ -141,6 +249,10 @@ void CameraSource::setupDefault()
 /**
  * @brief Change the device and mode.
  * @note If a device is already open, the source will seamlessly switch to the new device.
+ *
+ * The new device is opened while the current one keeps streaming and subscribers don't wait for
+ * it. Only reopening the same device, e.g. in another mode, has to close it first, since cameras
+ * can't be opened twice.
  */
 void CameraSource::setupDevice(const QString& deviceName_, const VideoMode& mode_)
 {
@@ -156,20 +268,27 @@ void CameraSource::setupDevice(const QString& deviceName_, const VideoMode& mode
         return;
     }
 
-    if (subscriptions) {
-        // To force close, ignoring optimization
-        int subs = subscriptions;
-        subscriptions = 0;
-        closeDevice();
-        subscriptions = subs;
-    }
-
+    const bool sameDevice = deviceName_ == deviceName;
     deviceName = deviceName_;
-    mode = mode_;
     isNone_ = (deviceName == "none");
+    isScreen_ = CameraDevice::isScreen(deviceName);
+    locker.unlock();
+
+    {
+        // the stream loops read the mode
+        ++pendingDeviceChanges;
+        QWriteLocker streamLocker{&streamMutex};
+        --pendingDeviceChanges;
+        mode = mode_;
+    }
+
+    standbyTimer->stop();
+    if (!subscriptions || isNone_ || sameDevice) {
+        releaseDevice();
+    }
 
     if (subscriptions && !isNone_) {
-        openDevice();
+        switchDevice();
     }
 }
 
@@ -178,9 +297,24 @@ bool CameraSource::isNone() const
     return isNone_;
 }
 
+/**
+ * @brief Whether the selected device captures a screen instead of a camera.
+ */
+bool CameraSource::isScreen() const
+{
+    return isScreen_;
+}
+
 CameraSource::~CameraSource()
 {
+    if (QThread::currentThread() != deviceThread) {
+        // timers can only be stopped from their own thread
+        QMetaObject::invokeMethod(standbyTimer, "stop", Qt::BlockingQueuedConnection);
+    }
+
+    ++pendingDeviceChanges;
     QWriteLocker locker{&streamMutex};
+    --pendingDeviceChanges;
     QWriteLocker locker2{&deviceMutex};
 
     // Stop the device thread
@@ -193,23 +327,12 @@ CameraSource::~CameraSource()
     }
 
     // Free all remaining VideoFrame
-    VideoFrame::untrackFrames(id, true);
-
-    if (cctx) {
-        avcodec_free_context(&cctx);
-    }
-#if LIBAVCODEC_VERSION_INT < 3747941
-    if (cctxOrig) {
-        avcodec_close(cctxOrig);
-    }
-#endif
-
-    if (device) {
-        for (int i = 0; i < subscriptions; ++i)
-            device->close();
+    frameRegistry->releaseAll();
 
-        device = nullptr;
-    }
+    // also closes a camera kept in standby
+    OpenedDevice previous;
+    swapDevice(previous);
+    closeOpened(previous);
 
     locker.unlock();
 
@@ -247,12 +370,17 @@ void CameraSource::openDevice()
         return;
     }
 
-    QWriteLocker locker{&streamMutex};
     if (subscriptions == 0) {
         return;
     }
 
-    qDebug() << "Opening device" << deviceName << "subscriptions:" << subscriptions;
+    // a device kept in standby is simply used again
+    standbyTimer->stop();
+
+    // the streaming device only changes on this thread, reading it needs no lock
+    if (screenGrabber || capture) {
+        return;
+    }
 
     if (device) {
         device->open();
@@ -260,190 +388,710 @@ void CameraSource::openDevice()
         return;
     }
 
-    // We need to create a new CameraDevice
-    device = CameraDevice::open(deviceName, settings, mode);
+    switchDevice();
+}
 
-    if (!device) {
-        qWarning() << "Failed to open device!";
+/**
+ * @brief Closes the video device and stops streaming.
+ *
+ * With warm standby enabled, a camera is kept open for CAMERA_STANDBY_MS first, since a call often
+ * follows the preview right away and opening a camera can take half a second.
+ * @note Callers must own the biglock.
+ */
+void CameraSource::closeDevice()
+{
+    if (QThread::currentThread() != deviceThread) {
+        QMetaObject::invokeMethod(this, "closeDevice");
+        return;
+    }
+
+    if (subscriptions != 0) {
+        return;
+    }
+
+    if (!isScreen_ && (device || capture) && settings.getCamWarmStandby()
+        && !CacheRegistry::getInstance().isLowMemory()) {
+        qDebug() << "Keeping device" << deviceName << "in standby";
+        standbyTimer->start();
+        return;
+    }
+
+    releaseDevice();
+}
+
+/**
+ * @brief Closes the device once the standby time ran out without new subscribers.
+ */
+void CameraSource::onStandbyTimeout()
+{
+    if (subscriptions == 0) {
+        releaseDevice();
+    }
+}
+
+/**
+ * @brief Stops streaming and closes the streaming device right away.
+ */
+void CameraSource::releaseDevice()
+{
+    OpenedDevice previous;
+    {
+        ++pendingDeviceChanges;
+        QWriteLocker locker{&streamMutex};
+        --pendingDeviceChanges;
+        if (!device && !screenGrabber && !capture) {
+            return;
+        }
+
+        qDebug() << "Closing device, subscriptions:" << subscriptions;
+        swapDevice(previous);
+
+        // Free all remaining VideoFrame
+        frameRegistry->releaseAll();
+        if (CacheRegistry::getInstance().isLowMemory()) {
+            // the next call or preview allocates them again, keeping them only helps a quick reopen
+            framePool->clear();
+        }
+    }
+
+    // the stream loop exits once it sees the device is gone and never touches previous again
+    closeOpened(previous);
+}
+
+/**
+ * @brief Opens deviceName and replaces the streaming device with it.
+ *
+ * The current device keeps streaming until the new one and its decoder are open. If opening fails
+ * the current device is kept, otherwise the stream loop is restarted for the new device, which
+ * only takes as long as the current loop needs to notice, at most one frame.
+ */
+void CameraSource::switchDevice()
+{
+    OpenedDevice next;
+    if (!openInto(next)) {
+        closeOpened(next);
         emit openFailed();
         return;
     }
 
+    OpenedDevice previous;
+    {
+        ++pendingDeviceChanges;
+        QWriteLocker locker{&streamMutex};
+        --pendingDeviceChanges;
+        swapDevice(previous);
+    }
+
+    // the stream loops exit as soon as they see their device is gone
+    streamFuture.waitForFinished();
+
+    void (CameraSource::*streamLoop)() = next.streamLoop;
+    {
+        ++pendingDeviceChanges;
+        QWriteLocker locker{&streamMutex};
+        --pendingDeviceChanges;
+        swapDevice(next);
+    }
+
+    streamFuture = QtConcurrent::run(std::bind(&CameraSource::runStream, this, streamLoop));
+
+    // Synchronize with our stream thread
+    while (!streamFuture.isRunning())
+        QThread::yieldCurrentThread();
+
+    emit deviceOpened();
+
+    // closing can be slow as well, the new device is already streaming
+    closeOpened(previous);
+}
+
+/**
+ * @brief Opens deviceName in mode with a decoder, without touching the streaming device.
+ * @param next Receives the opened device, must be closed with closeOpened() if this fails.
+ * @return False if the device couldn't be opened.
+ */
+bool CameraSource::openInto(OpenedDevice& next)
+{
+    qDebug() << "Opening device" << deviceName << "subscriptions:" << subscriptions;
+
+    if (CameraDevice::isScreen(deviceName)) {
+        QRect region{mode.x, mode.y, mode.width, mode.height};
+        // only a selected region can belong to a window
+        const bool followWindow = !region.isEmpty() && settings.getScreenFollowWindow();
+        if (region.isEmpty()) {
+            // CameraDevice grabs the size of the primary screen in this case
+            region.setSize(QGuiApplication::primaryScreen()->size());
+        }
+        next.screenGrabber = ScreenGrabber::create(deviceName, region, followWindow);
+        if (next.screenGrabber) {
+            next.streamLoop = &CameraSource::streamScreen;
+            return true;
+        }
+    }
+
+    if (!CameraDevice::isScreen(deviceName) && openCapture(next)) {
+        next.streamLoop = &CameraSource::streamCapture;
+        return true;
+    }
+
+    // We need to create a new CameraDevice
+    next.device = CameraDevice::open(deviceName, settings, mode);
+
+    if (!next.device) {
+        qWarning() << "Failed to open device!";
+        return false;
+    }
+
     // We need to open the device as many time as we already have subscribers,
     // otherwise the device could get closed while we still have subscribers
     for (int i = 0; i < subscriptions; ++i) {
-        device->open();
+        next.device->open();
     }
 
+    AVFormatContext* context = next.device->context;
     // Find the first video stream, if any
-    for (unsigned i = 0; i < device->context->nb_streams; ++i) {
+    for (unsigned i = 0; i < context->nb_streams; ++i) {
         AVMediaType type;
 #if LIBAVCODEC_VERSION_INT < 3747941
-        type = device->context->streams[i]->codec->codec_type;
+        type = context->streams[i]->codec->codec_type;
 #else
-        type = device->context->streams[i]->codecpar->codec_type;
+        type = context->streams[i]->codecpar->codec_type;
 #endif
         if (type == AVMEDIA_TYPE_VIDEO) {
-            videoStreamIndex = i;
+            next.videoStreamIndex = i;
             break;
         }
     }
 
-    if (videoStreamIndex == -1) {
+    if (next.videoStreamIndex == -1) {
         qWarning() << "Video stream not found";
-        emit openFailed();
-        return;
+        return false;
     }
 
     AVCodecID codecId;
 #if LIBAVCODEC_VERSION_INT < 3747941
-    cctxOrig = device->context->streams[videoStreamIndex]->codec;
-    codecId = cctxOrig->codec_id;
+    next.cctxOrig = context->streams[next.videoStreamIndex]->codec;
+    codecId = next.cctxOrig->codec_id;
 #else
     // Get the stream's codec's parameters and find a matching decoder
-    AVCodecParameters* cparams = device->context->streams[videoStreamIndex]->codecpar;
+    AVCodecParameters* cparams = context->streams[next.videoStreamIndex]->codecpar;
     codecId = cparams->codec_id;
 #endif
     const AVCodec* codec = avcodec_find_decoder(codecId);
     if (!codec) {
         qWarning() << "Codec not found";
-        emit openFailed();
-        return;
+        return false;
     }
 
 
 #if LIBAVCODEC_VERSION_INT < 3747941
     // Copy context, since we apparently aren't allowed to use the original
-    cctx = avcodec_alloc_context3(codec);
-    if (avcodec_copy_context(cctx, cctxOrig) != 0) {
+    next.cctx = avcodec_alloc_context3(codec);
+    if (avcodec_copy_context(next.cctx, next.cctxOrig) != 0) {
         qWarning() << "Can't copy context";
-        emit openFailed();
-        return;
+        return false;
     }
 
-    cctx->refcounted_frames = 1;
+    next.cctx->refcounted_frames = 1;
 #else
     // Create a context for our codec, using the existing parameters
-    cctx = avcodec_alloc_context3(codec);
-    if (avcodec_parameters_to_context(cctx, cparams) < 0) {
+    next.cctx = avcodec_alloc_context3(codec);
+    if (avcodec_parameters_to_context(next.cctx, cparams) < 0) {
         qWarning() << "Can't create AV context from parameters";
-        emit openFailed();
-        return;
+        return false;
+    }
+
+    if (settings.getCamVideoHwDecode()) {
+        setupHwDecoder(next);
     }
 #endif
 
     // Open codec
-    if (avcodec_open2(cctx, codec, nullptr) < 0) {
+    if (avcodec_open2(next.cctx, codec, nullptr) < 0) {
         qWarning() << "Can't open codec";
-        avcodec_free_context(&cctx);
-        emit openFailed();
-        return;
+        return false;
     }
 
-    if (streamFuture.isRunning())
-        qDebug() << "The stream thread is already running! Keeping the current one open.";
-    else
-        streamFuture = QtConcurrent::run(std::bind(&CameraSource::stream, this));
+    next.streamLoop = &CameraSource::stream;
+    return true;
+}
 
-    // Synchronize with our stream thread
-    while (!streamFuture.isRunning())
-        QThread::yieldCurrentThread();
+/**
+ * @brief Frees a device opened by openInto() or swapped out of the stream.
+ */
+void CameraSource::closeOpened(OpenedDevice& opened)
+{
+    avcodec_free_context(&opened.cctx);
+    av_buffer_unref(&opened.hwDeviceCtx);
+    opened.hwPixelFormat = AV_PIX_FMT_NONE;
+    opened.screenGrabber.reset();
+    opened.capture.reset();
+#if LIBAVCODEC_VERSION_INT < 3747941
+    if (opened.cctxOrig) {
+        avcodec_close(opened.cctxOrig);
+    }
+#endif
+    opened.cctxOrig = nullptr;
+    opened.videoStreamIndex = -1;
+    while (opened.device && !opened.device->close()) {
+    }
+    opened.device = nullptr;
+}
 
-    emit deviceOpened();
+/**
+ * @brief Exchanges the streaming device with another one.
+ * @note Callers must own the streamMutex for writing.
+ */
+void CameraSource::swapDevice(OpenedDevice& other)
+{
+    std::swap(device, other.device);
+    std::swap(screenGrabber, other.screenGrabber);
+    std::swap(capture, other.capture);
+    std::swap(cctx, other.cctx);
+    std::swap(cctxOrig, other.cctxOrig);
+    std::swap(videoStreamIndex, other.videoStreamIndex);
+    std::swap(hwDeviceCtx, other.hwDeviceCtx);
+    std::swap(hwPixelFormat, other.hwPixelFormat);
+
+    // getHwFormat() reads the pixel format through the codec's opaque pointer
+    if (cctx && hwDeviceCtx) {
+        cctx->opaque = &hwPixelFormat;
+    }
+    if (other.cctx && other.hwDeviceCtx) {
+        other.cctx->opaque = &other.hwPixelFormat;
+    }
 }
 
 /**
- * @brief Closes the video device and stops streaming.
- * @note Callers must own the biglock.
+ * @brief Opens the native capture backend for the device and a decoder for it, if needed.
+ * @param next Receives the capture backend and decoder.
+ * @return False if the device has to be opened through FFmpeg.
  */
-void CameraSource::closeDevice()
+bool CameraSource::openCapture(OpenedDevice& next)
 {
-    if (QThread::currentThread() != deviceThread) {
-        QMetaObject::invokeMethod(this, "closeDevice");
-        return;
+#if LIBAVCODEC_VERSION_INT < 3747941
+    // captured packets are decoded with the send/receive API
+    std::ignore = next;
+    return false;
+#else
+    next.capture = CameraCapture::create(deviceName, mode);
+    if (!next.capture) {
+        return false;
     }
 
-    QWriteLocker locker{&streamMutex};
-    if (subscriptions != 0) {
-        return;
+    const AVCodecID codecId = static_cast<AVCodecID>(next.capture->getCodecId());
+    if (codecId == AV_CODEC_ID_NONE) {
+        return true;
     }
 
-    qDebug() << "Closing device" << deviceName << "subscriptions:" << subscriptions;
+    const AVCodec* codec = avcodec_find_decoder(codecId);
+    next.cctx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!next.cctx) {
+        qWarning() << "Codec not found";
+        next.capture.reset();
+        return false;
+    }
 
-    // Free all remaining VideoFrame
-    VideoFrame::untrackFrames(id, true);
+    next.cctx->width = next.capture->getSize().width();
+    next.cctx->height = next.capture->getSize().height();
+    if (settings.getCamVideoHwDecode()) {
+        setupHwDecoder(next);
+    }
 
-    // Free our resources and close the device
-    videoStreamIndex = -1;
-    avcodec_free_context(&cctx);
-#if LIBAVCODEC_VERSION_INT < 3747941
-    avcodec_close(cctxOrig);
-    cctxOrig = nullptr;
+    if (avcodec_open2(next.cctx, codec, nullptr) < 0) {
+        qWarning() << "Can't open codec";
+        avcodec_free_context(&next.cctx);
+        av_buffer_unref(&next.hwDeviceCtx);
+        next.hwPixelFormat = AV_PIX_FMT_NONE;
+        next.capture.reset();
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+/**
+ * @brief Attaches the first hardware decoder available for the stream's codec to the decoder.
+ *
+ * Leaves the decoder untouched if no hardware decoder can be created, the stream is decoded in
+ * software then.
+ * @param next Device whose decoder is set up, call this before opening the codec.
+ */
+void CameraSource::setupHwDecoder(OpenedDevice& next)
+{
+#if HW_DECODE_SUPPORTED
+    AVCodecContext* ctx = next.cctx;
+    for (AVHWDeviceType type : preferredHwDevices()) {
+        for (int i = 0;; ++i) {
+            const AVCodecHWConfig* config = avcodec_get_hw_config(ctx->codec, i);
+            if (!config) {
+                break;
+            }
+
+            if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)
+                || config->device_type != type) {
+                continue;
+            }
+
+            if (av_hwdevice_ctx_create(&next.hwDeviceCtx, type, nullptr, nullptr, 0) < 0) {
+                break;
+            }
+
+            next.hwPixelFormat = config->pix_fmt;
+            ctx->hw_device_ctx = av_buffer_ref(next.hwDeviceCtx);
+            // pointed at the member once the device streams, see swapDevice()
+            ctx->opaque = &next.hwPixelFormat;
+            ctx->get_format = getHwFormat;
+            qDebug() << "Decoding camera stream with" << av_hwdevice_get_type_name(type);
+            return;
+        }
+    }
+
+    qDebug() << "No hardware decoder available for" << ctx->codec->name
+             << ", decoding in software";
+#else
+    std::ignore = next;
+#endif
+}
+
+/**
+ * @brief Replaces a frame decoded in hardware with a copy in system memory.
+ *
+ * Frames decoded in software are left untouched.
+ * @param frame Decoded frame from framePool, replaced by the downloaded frame.
+ * @return False if the frame couldn't be downloaded and was released.
+ */
+bool CameraSource::downloadHwFrame(AVFrame*& frame)
+{
+#if HW_DECODE_SUPPORTED
+    if (hwPixelFormat == AV_PIX_FMT_NONE || frame->format != hwPixelFormat) {
+        return true;
+    }
+
+    AVFrame* swFrame = framePool->acquireFrame();
+    if (!swFrame || av_hwframe_transfer_data(swFrame, frame, 0) < 0
+        || av_frame_copy_props(swFrame, frame) < 0) {
+        qWarning() << "Failed to download hardware decoded frame";
+        framePool->releaseFrame(swFrame);
+        framePool->releaseFrame(frame);
+        frame = nullptr;
+        return false;
+    }
+
+    framePool->releaseFrame(frame);
+    frame = swFrame;
+#else
+    std::ignore = frame;
 #endif
-    while (device && !device->close()) {
+    return true;
+}
+
+/**
+ * @brief Checks if a frame captured now should be emitted.
+ *
+ * Frames aren't wanted if nobody is connected to frameAvailable, or if the camera delivers them
+ * faster than the frame rate of the mode it was opened in.
+ * @param nowNs Capture time of the frame.
+ * @param lastFrameNs Capture time of the last wanted frame, updated if this one is wanted.
+ */
+bool CameraSource::wantsFrame(qint64 nowNs, qint64& lastFrameNs) const
+{
+    static const QMetaMethod frameAvailableSignal =
+        QMetaMethod::fromSignal(&VideoSource::frameAvailable);
+    if (!isSignalConnected(frameAvailableSignal)) {
+        return false;
+    }
+
+    if (mode.FPS > 0.0f && lastFrameNs >= 0) {
+        // tolerate jitter, but halve the rate of a camera running at twice the mode
+        const qint64 minIntervalNs = static_cast<qint64>(750000000 / mode.FPS);
+        if (nowNs - lastFrameNs < minIntervalNs) {
+            return false;
+        }
     }
-    device = nullptr;
+
+    lastFrameNs = nowNs;
+    return true;
 }
 
 /**
  * @brief Blocking. Decodes video stream and emits new frames.
+ *
+ * Reading blocks until the device delivers the next packet. Unwanted frames of codecs without
+ * inter frames, e.g. MJPEG or raw video, are dropped before decoding them, and read errors are
+ * retried with an increasing pause instead of spinning.
  * @note Designed to run in its own thread.
  */
+/**
+ * @brief Runs one of the stream loops on the pooled stream thread and measures its CPU time.
+ * @param streamLoop stream(), streamCapture() or streamScreen().
+ */
+void CameraSource::runStream(void (CameraSource::*streamLoop)())
+{
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("Camera"));
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Interactive);
+    (this->*streamLoop)();
+    // the pool reuses the thread for other work
+    ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Normal);
+    ThreadCpuTime::unregisterCurrentThread();
+}
+
 void CameraSource::stream()
 {
-    auto streamLoop = [=]() {
+    constexpr unsigned long MAX_ERROR_BACKOFF_MS = 100;
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastFrameNs = -1;
+    unsigned long errorBackoffMs = 0;
+
+    auto streamLoop = [&]() -> bool {
         AVPacket packet;
         if (av_read_frame(device->context, &packet) != 0) {
-            return;
+            return false;
+        }
+
+        if (packet.stream_index != videoStreamIndex) {
+            av_packet_unref(&packet);
+            return true;
+        }
+
+        const bool wanted = wantsFrame(clock.nsecsElapsed(), lastFrameNs);
+        const AVCodecDescriptor* descriptor = avcodec_descriptor_get(cctx->codec_id);
+        if (!wanted && descriptor && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY)) {
+            av_packet_unref(&packet);
+            return true;
         }
 
+        TRACE_SCOPE("CameraSource::decode");
+
 #if LIBAVCODEC_VERSION_INT < 3747941
-        AVFrame* frame = av_frame_alloc();
+        AVFrame* frame = framePool->acquireFrame();
         if (!frame) {
-            return;
+            av_packet_unref(&packet);
+            return true;
         }
 
-        // Only keep packets from the right stream;
-        if (packet.stream_index == videoStreamIndex) {
-            // Decode video frame
-            int frameFinished;
-            avcodec_decode_video2(cctx, frame, &frameFinished, &packet);
-            if (!frameFinished) {
-                return;
-            }
-
-            VideoFrame* vframe = new VideoFrame(id, frame);
-            emit frameAvailable(vframe->trackFrame());
+        // Decode video frame
+        int frameFinished;
+        avcodec_decode_video2(cctx, frame, &frameFinished, &packet);
+        if (frameFinished && wanted) {
+            VideoFrame* vframe = new VideoFrame(id, frame, false, framePool);
+            conversionPlanner.prepare(*vframe);
+            emit frameAvailable(VideoFrameRegistry::track(frameRegistry, vframe));
+        } else {
+            framePool->releaseFrame(frame);
         }
 #else
 
         // Forward packets to the decoder and grab the decoded frame
-        bool isVideo = packet.stream_index == videoStreamIndex;
-        bool readyToRecive = isVideo && !avcodec_send_packet(cctx, &packet);
-
-        if (readyToRecive) {
-            AVFrame* frame = av_frame_alloc();
-            if (frame && !avcodec_receive_frame(cctx, frame)) {
-                VideoFrame* vframe = new VideoFrame(id, frame);
-                emit frameAvailable(vframe->trackFrame());
+        if (!avcodec_send_packet(cctx, &packet)) {
+            AVFrame* frame = framePool->acquireFrame();
+            if (frame && !avcodec_receive_frame(cctx, frame) && wanted && downloadHwFrame(frame)) {
+                VideoFrame* vframe = new VideoFrame(id, frame, false, framePool);
+                conversionPlanner.prepare(*vframe);
+                emit frameAvailable(VideoFrameRegistry::track(frameRegistry, vframe));
             } else {
-                av_frame_free(&frame);
+                framePool->releaseFrame(frame);
             }
         }
 #endif
 
         av_packet_unref(&packet);
+        return true;
     };
 
+    QReadLocker locker{&streamMutex};
     forever
     {
-        QReadLocker locker{&streamMutex};
+        if (pendingDeviceChanges > 0) {
+            locker.unlock();
+            locker.relock();
+        }
 
         // Exit if device is no longer valid
         if (!device) {
             break;
         }
 
-        streamLoop();
+        if (streamLoop()) {
+            errorBackoffMs = 0;
+            continue;
+        }
+
+        // a flaky camera, don't burn a core retrying
+        errorBackoffMs = std::min(MAX_ERROR_BACKOFF_MS, std::max(1ul, errorBackoffMs * 2));
+        locker.unlock();
+        QThread::msleep(errorBackoffMs);
+        locker.relock();
+    }
+}
+
+/**
+ * @brief Blocking. Waits for images from capture, decodes them if needed and emits new frames.
+ * @note Designed to run in its own thread.
+ */
+void CameraSource::streamCapture()
+{
+    // bounds how long a device change waits for the streamMutex
+    constexpr int CAPTURE_TIMEOUT_MS = 100;
+
+#if LIBAVCODEC_VERSION_INT >= 3747941
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastFrameNs = -1;
+    AVPacket* packet = av_packet_alloc();
+    QReadLocker locker{&streamMutex};
+    forever
+    {
+        if (pendingDeviceChanges > 0) {
+            locker.unlock();
+            locker.relock();
+        }
+
+        // Exit if device is no longer valid
+        if (!capture || !packet) {
+            break;
+        }
+
+        AVFrame* frame = framePool->acquireFrame();
+        if (!frame) {
+            continue;
+        }
+
+        const CameraCapture::Result result =
+            capture->capture(CAPTURE_TIMEOUT_MS, *framePool, frame, packet);
+        if (result == CameraCapture::Result::Failed) {
+            qWarning() << "Camera capture failed, stopping the stream";
+            framePool->releaseFrame(frame);
+            break;
+        }
+
+        if (result == CameraCapture::Result::None) {
+            framePool->releaseFrame(frame);
+            continue;
+        }
+
+        const bool wanted = wantsFrame(clock.nsecsElapsed(), lastFrameNs);
+        if (result == CameraCapture::Result::Packet) {
+            const AVCodecDescriptor* descriptor = avcodec_descriptor_get(cctx->codec_id);
+            const bool skip = !wanted && descriptor
+                              && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY);
+            TRACE_SCOPE("CameraSource::decode");
+            const bool decoded = !skip && !avcodec_send_packet(cctx, packet)
+                                 && !avcodec_receive_frame(cctx, frame) && downloadHwFrame(frame);
+            av_packet_unref(packet);
+            if (!decoded) {
+                framePool->releaseFrame(frame);
+                continue;
+            }
+        }
+
+        if (!wanted) {
+            framePool->releaseFrame(frame);
+            continue;
+        }
+
+        VideoFrame* vframe = new VideoFrame(id, frame, false, framePool);
+        conversionPlanner.prepare(*vframe);
+        emit frameAvailable(VideoFrameRegistry::track(frameRegistry, vframe));
+    }
+
+    av_packet_free(&packet);
+#else
+    std::ignore = CAPTURE_TIMEOUT_MS;
+#endif
+}
+
+/**
+ * @brief Blocking. Grabs the screen with screenGrabber and emits changed frames.
+ *
+ * Frames are only emitted when the screen changed, and once per SCREEN_KEEPALIVE_MS otherwise so
+ * peers recover from lost packets on a static screen.
+ * @note Designed to run in its own thread.
+ */
+void CameraSource::streamScreen()
+{
+    constexpr qint64 SCREEN_KEEPALIVE_MS = 1000;
+
+    // Same frame rate CameraDevice picks for x11grab
+    float fps = std::max(10.0f, static_cast<float>(settings.getScreenVideoFPS()));
+    if (mode.FPS > 0.0f) {
+        fps = mode.FPS;
+    }
+    const qint64 frameIntervalMs = std::max<qint64>(1, static_cast<qint64>(1000 / fps));
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextFrameMs = 0;
+    qint64 lastEmitMs = -SCREEN_KEEPALIVE_MS;
+
+    forever
+    {
+        {
+            QReadLocker locker{&streamMutex};
+
+            // Exit if device is no longer valid
+            if (!screenGrabber) {
+                break;
+            }
+
+            QRect damage;
+            if (!screenGrabber->grab(damage)) {
+                qWarning() << "Screen grabbing failed, stopping the stream";
+                break;
+            }
+
+            const qint64 now = clock.elapsed();
+            if (!damage.isEmpty() || now - lastEmitMs >= SCREEN_KEEPALIVE_MS) {
+                emitScreenFrame();
+                lastEmitMs = now;
+            }
+        }
+
+        nextFrameMs += frameIntervalMs;
+        const qint64 sleepMs = nextFrameMs - clock.elapsed();
+        if (sleepMs > 0) {
+            QThread::msleep(static_cast<unsigned long>(sleepMs));
+        } else {
+            // we're behind, don't try to catch up with a burst of frames
+            nextFrameMs = clock.elapsed();
+        }
+    }
+}
+
+/**
+ * @brief Copies the current screenGrabber image into a pooled frame and emits it.
+ * @note Callers must own the streamMutex.
+ */
+void CameraSource::emitScreenFrame()
+{
+    TRACE_SCOPE("CameraSource::emitScreenFrame");
+    const QSize size = screenGrabber->getSize();
+    AVFrame* frame = framePool->acquireFrame();
+    if (!frame) {
+        return;
+    }
+
+    frame->width = size.width();
+    frame->height = size.height();
+    frame->format = AV_PIX_FMT_BGR0;
+
+    const int bufSize = av_image_get_buffer_size(AV_PIX_FMT_BGR0, size.width(), size.height(),
+                                                 VideoFrame::dataAlignment);
+    frame->buf[0] = bufSize < 0 ? nullptr : framePool->acquireBuffer(bufSize);
+    if (!frame->buf[0]) {
+        framePool->releaseFrame(frame);
+        return;
     }
+
+    av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data, AV_PIX_FMT_BGR0,
+                         size.width(), size.height(), VideoFrame::dataAlignment);
+    av_image_copy_plane(frame->data[0], frame->linesize[0], screenGrabber->getData(),
+                        screenGrabber->getStride(), size.width() * 4, size.height());
+
+    VideoFrame* vframe = new VideoFrame(id, frame, false, framePool);
+    conversionPlanner.prepare(*vframe);
+    emit frameAvailable(VideoFrameRegistry::track(frameRegistry, vframe));
 }
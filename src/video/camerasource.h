@@ -27,9 +27,16 @@
 #include <QString>
 #include <QVector>
 #include <atomic>
+#include <memory>
 
+class CameraCapture;
 class CameraDevice;
+class ScreenGrabber;
+class VideoFramePool;
+struct AVBufferRef;
 struct AVCodecContext;
+struct AVFrame;
+class QTimer;
 class Settings;
 
 class CameraSource : public VideoSource
@@ -41,6 +48,7 @@ public:
     ~CameraSource();
     void setupDefault();
     bool isNone() const;
+    bool isScreen() const;
 
     // VideoSource interface
     void subscribe() override;
@@ -54,28 +62,66 @@ signals:
     void openFailed();
 
 private:
+    struct OpenedDevice
+    {
+        CameraDevice* device{nullptr};
+        std::unique_ptr<ScreenGrabber> screenGrabber;
+        std::unique_ptr<CameraCapture> capture;
+        AVCodecContext* cctx{nullptr};
+        AVCodecContext* cctxOrig{nullptr};
+        int videoStreamIndex{-1};
+        AVBufferRef* hwDeviceCtx{nullptr};
+        // AV_PIX_FMT_NONE
+        int hwPixelFormat{-1};
+        void (CameraSource::*streamLoop)() = nullptr;
+    };
+
+    static constexpr int CAMERA_STANDBY_MS = 3000;
+
     void stream();
+    void streamScreen();
+    void streamCapture();
+    void runStream(void (CameraSource::*streamLoop)());
+    bool wantsFrame(qint64 nowNs, qint64& lastFrameNs) const;
+    void emitScreenFrame();
+    void switchDevice();
+    void releaseDevice();
+    bool openInto(OpenedDevice& next);
+    void closeOpened(OpenedDevice& opened);
+    void swapDevice(OpenedDevice& other);
+    bool openCapture(OpenedDevice& next);
+    void setupHwDecoder(OpenedDevice& next);
+    bool downloadHwFrame(AVFrame*& frame);
 
 private slots:
     void openDevice();
     void closeDevice();
+    void onStandbyTimeout();
 
 private:
     QFuture<void> streamFuture;
     QThread* deviceThread;
+    QTimer* standbyTimer;
 
     QString deviceName;
     CameraDevice* device;
+    std::unique_ptr<ScreenGrabber> screenGrabber;
+    std::unique_ptr<CameraCapture> capture;
     VideoMode mode;
     AVCodecContext* cctx;
     // TODO: Remove when ffmpeg version will be bumped to the 3.1.0
     AVCodecContext* cctxOrig;
     int videoStreamIndex;
+    std::shared_ptr<VideoFramePool> framePool;
+    AVBufferRef* hwDeviceCtx;
+    int hwPixelFormat;
 
     QReadWriteLock deviceMutex;
     QReadWriteLock streamMutex;
 
     std::atomic_bool isNone_;
+    std::atomic_bool isScreen_;
     std::atomic_int subscriptions;
+    std::atomic_int pendingDeviceChanges;
     Settings& settings;
 };
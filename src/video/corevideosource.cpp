@@ -21,6 +21,7 @@ extern "C" {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
 #include <libavutil/imgutils.h>
 #pragma GCC diagnostic pop
 }
@@ -39,6 +40,9 @@ extern "C" {
  *
  * @var std::atomic_bool deleteOnClose
  * @brief If true, self-delete after the last suscriber is gone
+ *
+ * @var AVBufferPool* bufferPool
+ * @brief Recycles the frame buffers of emitted frames, sized to the current stream resolution
  */
 
 /**
@@ -50,12 +54,23 @@ CoreVideoSource::CoreVideoSource()
     : subscribers{0}
     , deleteOnClose{false}
     , stopped{false}
+    , bufferPool{nullptr}
+    , bufferPoolSize{0}
+{
+}
+
+CoreVideoSource::~CoreVideoSource()
 {
+    // frames still held by subscribers keep the pool alive until they are released
+    av_buffer_pool_uninit(&bufferPool);
 }
 
 /**
- * @brief Makes a copy of the vpx_image_t and emits it as a new VideoFrame.
- * @param vpxframe Frame to copy.
+ * @brief Copies the vpx_image_t into a pooled buffer and emits it as a new VideoFrame.
+ * @param vpxframe Frame to copy, only valid for the duration of the call.
+ *
+ * The buffer returns to the pool once the last subscriber drops the VideoFrame, so no
+ * allocation happens per frame as long as the resolution doesn't change.
  */
 void CoreVideoSource::pushFrame(const vpx_image_t* vpxframe)
 {
@@ -71,6 +86,20 @@ void CoreVideoSource::pushFrame(const vpx_image_t* vpxframe)
     if (subscribers <= 0)
         return;
 
+    const int bufSize =
+        av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, VideoFrame::dataAlignment);
+    if (bufSize < 0)
+        return;
+
+    if (!bufferPool || bufferPoolSize != bufSize) {
+        // previous buffers are freed once their frames are released
+        av_buffer_pool_uninit(&bufferPool);
+        bufferPool = av_buffer_pool_init(bufSize, nullptr);
+        bufferPoolSize = bufferPool ? bufSize : 0;
+        if (!bufferPool)
+            return;
+    }
+
     AVFrame* avframe = av_frame_alloc();
     if (!avframe)
         return;
@@ -78,30 +107,25 @@ void CoreVideoSource::pushFrame(const vpx_image_t* vpxframe)
     avframe->width = width;
     avframe->height = height;
     avframe->format = AV_PIX_FMT_YUV420P;
+    avframe->buf[0] = av_buffer_pool_get(bufferPool);
 
-    int bufSize =
-        av_image_alloc(avframe->data, avframe->linesize, width, height,
-                       static_cast<AVPixelFormat>(AV_PIX_FMT_YUV420P), VideoFrame::dataAlignment);
-
-    if (bufSize < 0) {
+    if (!avframe->buf[0]) {
         av_frame_free(&avframe);
         return;
     }
 
-    for (int i = 0; i < 3; ++i) {
-        int dstStride = avframe->linesize[i];
-        int srcStride = vpxframe->stride[i];
-        int minStride = std::min(dstStride, srcStride);
-        int size = (i == 0) ? height : height / 2;
+    av_image_fill_arrays(avframe->data, avframe->linesize, avframe->buf[0]->data,
+                         AV_PIX_FMT_YUV420P, width, height, VideoFrame::dataAlignment);
 
-        for (int j = 0; j < size; ++j) {
-            uint8_t* dst = avframe->data[i] + dstStride * j;
-            uint8_t* src = vpxframe->planes[i] + srcStride * j;
-            memcpy(dst, src, minStride);
-        }
-    }
+    const uint8_t* srcData[4] = {vpxframe->planes[0], vpxframe->planes[1], vpxframe->planes[2],
+                                 nullptr};
+    const int srcLinesize[4] = {vpxframe->stride[0], vpxframe->stride[1], vpxframe->stride[2], 0};
+    av_image_copy(avframe->data, avframe->linesize, srcData, srcLinesize, AV_PIX_FMT_YUV420P,
+                  width, height);
 
-    vframe = std::make_shared<VideoFrame>(id, avframe, true);
+    // the frame doesn't own its data pointers, freeing it unreferences buf[0] instead
+    vframe = std::make_shared<VideoFrame>(id, avframe);
+    conversionPlanner.prepare(*vframe);
     emit frameAvailable(vframe);
 }
 
@@ -25,6 +25,8 @@
 #include <atomic>
 #include <vpx/vpx_image.h>
 
+struct AVBufferPool;
+
 class CoreVideoSource : public VideoSource
 {
     Q_OBJECT
@@ -35,6 +37,7 @@ public:
 
 private:
     CoreVideoSource();
+    ~CoreVideoSource() override;
 
     void pushFrame(const vpx_image_t* frame);
     void setDeleteOnClose(bool newstate);
@@ -47,6 +50,8 @@ private:
     std::atomic_bool deleteOnClose;
     QMutex biglock;
     std::atomic_bool stopped;
+    AVBufferPool* bufferPool;
+    int bufferPoolSize;
 
     friend class CoreAV;
     friend class ToxFriendCall;
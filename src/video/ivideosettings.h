@@ -21,6 +21,7 @@
 
 #include "util/interface.h"
 
+#include <QByteArray>
 #include <QString>
 #include <QRect>
 
@@ -42,6 +43,9 @@ public:
     virtual bool getScreenGrabbed() const = 0;
     virtual void setScreenGrabbed(bool value) = 0;
 
+    virtual bool getScreenFollowWindow() const = 0;
+    virtual void setScreenFollowWindow(bool value) = 0;
+
     virtual QRect getCamVideoRes() const = 0;
     virtual void setCamVideoRes(QRect newValue) = 0;
 
@@ -51,10 +55,22 @@ public:
     virtual int getScreenVideoFPS() const = 0;
     virtual void setScreenVideoFPS(int newValue) = 0;
 
+    virtual bool getCamVideoHwDecode() const = 0;
+    virtual void setCamVideoHwDecode(bool newValue) = 0;
+
+    virtual bool getCamWarmStandby() const = 0;
+    virtual void setCamWarmStandby(bool newValue) = 0;
+
+    virtual QByteArray getCamModeCache() const = 0;
+    virtual void setCamModeCache(const QByteArray& newValue) = 0;
+
     DECLARE_SIGNAL(videoDevChanged, const QString& device);
     DECLARE_SIGNAL(screenRegionChanged, const QRect& region);
     DECLARE_SIGNAL(screenGrabbedChanged, bool enabled);
+    DECLARE_SIGNAL(screenFollowWindowChanged, bool enabled);
     DECLARE_SIGNAL(camVideoResChanged, const QRect& region);
     DECLARE_SIGNAL(camVideoFPSChanged, unsigned short fps);
     DECLARE_SIGNAL(screenVideoFPSChanged, int fps);
+    DECLARE_SIGNAL(camVideoHwDecodeChanged, bool enabled);
+    DECLARE_SIGNAL(camWarmStandbyChanged, bool enabled);
 };
@@ -19,6 +19,7 @@
 
 #include "netcamview.h"
 #include "camerasource.h"
+#include "src/core/coreav.h"
 #include "src/core/core.h"
 #include "src/friendlist.h"
 #include "src/model/friend.h"
@@ -37,6 +38,7 @@
 #include <QCloseEvent>
 #include <QPushButton>
 #include <QDesktopWidget>
+#include <QTimer>
 
 namespace
 {
@@ -45,6 +47,14 @@ const auto BTN_STATE_RED = QVariant("red");
 const int BTN_PANEL_HEIGHT = 55;
 const int BTN_PANEL_WIDTH = 250;
 const auto BTN_STYLE_SHEET_PATH = QStringLiteral("chatForm/fullScreenButtons.css");
+const int CALL_STATS_INTERVAL_MS = 1000;
+const int CALL_STATS_MARGIN = 8;
+
+QString sizeToString(const QSize& size)
+{
+    return size.isEmpty() ? QStringLiteral("-")
+                          : QStringLiteral("%1x%2").arg(size.width()).arg(size.height());
+}
 }
 
 NetCamView::NetCamView(ToxPk friendPk_, CameraSource& cameraSource_,
@@ -65,13 +75,20 @@ NetCamView::NetCamView(ToxPk friendPk_, CameraSource& cameraSource_,
     toggleMessagesButton = new QPushButton();
     enterFullScreenButton = new QPushButton();
     enterFullScreenButton->setText(tr("Full Screen"));
+    callStatsButton = new QPushButton();
+    callStatsButton->setText(tr("Statistics"));
+    callStatsButton->setToolTip(tr("Show call statistics (F3)"));
+    callStatsButton->setCheckable(true);
+    callStatsButton->hide();
 
     buttonLayout->addStretch();
+    buttonLayout->addWidget(callStatsButton);
     buttonLayout->addWidget(toggleMessagesButton);
     buttonLayout->addWidget(enterFullScreenButton);
 
     connect(toggleMessagesButton, &QPushButton::clicked, this, &NetCamView::showMessageClicked);
     connect(enterFullScreenButton, &QPushButton::clicked, this, &NetCamView::toggleFullScreen);
+    connect(callStatsButton, &QPushButton::clicked, this, &NetCamView::toggleCallStats);
 
     verLayout->addLayout(buttonLayout);
     verLayout->setContentsMargins(0, 0, 0, 0);
@@ -122,12 +139,25 @@ NetCamView::NetCamView(ToxPk friendPk_, CameraSource& cameraSource_,
 
     selfVideoSurface = new VideoSurface(profile.loadAvatar(), this, true);
     selfVideoSurface->setObjectName(QStringLiteral("CamVideoSurface"));
+    selfVideoSurface->setPreview(true);
     selfVideoSurface->setMouseTracking(true);
     selfVideoSurface->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
     selfFrame = new MovableWidget(videoSurface);
     selfFrame->show();
 
+    // the overlay only reads and formats the call counters while it is shown
+    callStatsLabel = new QLabel(videoSurface);
+    callStatsLabel->setStyleSheet(
+        QStringLiteral("QLabel { background-color: rgba(0, 0, 0, 160); color: white; padding: 4px; }"));
+    callStatsLabel->setAttribute(Qt::WA_TransparentForMouseEvents);
+    callStatsLabel->move(CALL_STATS_MARGIN, CALL_STATS_MARGIN);
+    callStatsLabel->hide();
+
+    callStatsTimer = new QTimer(this);
+    callStatsTimer->setInterval(CALL_STATS_INTERVAL_MS);
+    connect(callStatsTimer, &QTimer::timeout, this, &NetCamView::updateCallStats);
+
     QHBoxLayout* frameLayout = new QHBoxLayout(selfFrame);
     frameLayout->addWidget(selfVideoSurface);
     frameLayout->setMargin(0);
@@ -179,6 +209,9 @@ void NetCamView::show(VideoSource* source, const QString& title)
 
 void NetCamView::hide()
 {
+    callStatsTimer->stop();
+    callStatsLabel->hide();
+    callStatsButton->setChecked(false);
     setSource(nullptr);
     selfVideoSurface->setSource(nullptr);
 
@@ -222,6 +255,21 @@ void NetCamView::updateFrameSize(QSize size)
         selfFrame->setMaximumHeight(selfFrame->maximumWidth() / selfVideoSurface->getRatio());
 }
 
+/**
+ * @brief Offers the call statistics overlay for a friend call.
+ * @param av CoreAV running the call, may be nullptr to hide the overlay.
+ * @param friendId Id of the friend in the call list.
+ */
+void NetCamView::setCallStatsSource(const CoreAV* av, uint32_t friendId)
+{
+    callStatsAv = av;
+    callStatsFriendId = friendId;
+    callStatsButton->setVisible(av != nullptr);
+    if (!av && callStatsTimer->isActive()) {
+        toggleCallStats();
+    }
+}
+
 QSize NetCamView::getSurfaceMinSize()
 {
     QSize surfaceSize = videoSurface->minimumSize();
@@ -298,6 +346,63 @@ void NetCamView::toggleVideoPreview()
     }
 }
 
+void NetCamView::toggleCallStats()
+{
+    if (callStatsTimer->isActive()) {
+        callStatsTimer->stop();
+        callStatsLabel->hide();
+        callStatsButton->setChecked(false);
+        return;
+    }
+
+    if (!callStatsAv) {
+        callStatsButton->setChecked(false);
+        return;
+    }
+
+    // start new intervals, whatever was counted while hidden isn't meaningful
+    callStatsAv->takeCallStats(callStatsFriendId);
+    videoSurface->takeFrameStats();
+    callStatsLabel->setText(tr("Collecting call statistics..."));
+    callStatsLabel->adjustSize();
+    callStatsLabel->show();
+    callStatsLabel->raise();
+    callStatsButton->setChecked(true);
+    callStatsTimer->start();
+}
+
+void NetCamView::updateCallStats()
+{
+    if (!callStatsAv) {
+        return;
+    }
+
+    const CallStats::Snapshot call = callStatsAv->takeCallStats(callStatsFriendId);
+    const VideoSurface::FrameStats shown = videoSurface->takeFrameStats();
+
+    QStringList lines;
+    lines << tr("Sent: %1 at %2 fps, %3 ms per frame")
+                 .arg(sizeToString(call.sentSize))
+                 .arg(call.sentFps, 0, 'f', 1)
+                 .arg(call.processMs, 0, 'f', 1);
+    lines << tr("Received: %1 at %2 fps, shown at %3 fps, %4 ms to display")
+                 .arg(sizeToString(call.receivedSize))
+                 .arg(call.receivedFps, 0, 'f', 1)
+                 .arg(shown.fps, 0, 'f', 1)
+                 .arg(shown.delayMs, 0, 'f', 1);
+    lines << tr("Video bitrate: %1 kbit/s, target %2 kbit/s")
+                 .arg(call.encoderKbps)
+                 .arg(call.targetKbps);
+    lines << tr("Audio send queue: %1 ms, frames dropped: %2%")
+                 .arg(call.audioQueueMs, 0, 'f', 1)
+                 .arg(call.sendLoss * 100, 0, 'f', 1);
+
+    callStatsLabel->setText(lines.join('\n'));
+    callStatsLabel->adjustSize();
+    // the OpenGL renderer may have been shown on top of us since the last update
+    callStatsLabel->raise();
+}
+
 QPushButton* NetCamView::createButton(const QString& name, const QString& state)
 {
     QPushButton* btn = new QPushButton();
@@ -346,6 +451,8 @@ void NetCamView::keyPressEvent(QKeyEvent *event)
     int key = event->key();
     if (key == Qt::Key_Escape && isFullScreen()) {
         exitFullScreen();
+    } else if (key == Qt::Key_F3) {
+        toggleCallStats();
     }
 }
 
@@ -23,7 +23,10 @@
 #include <QVector>
 #include <QWidget>
 
+class CoreAV;
 class QHBoxLayout;
+class QLabel;
+class QTimer;
 struct vpx_image;
 class VideoSource;
 class QFrame;
@@ -54,6 +57,7 @@ public:
     void setSource(VideoSource* s);
     void setTitle(const QString& title);
     QSize getSurfaceMinSize();
+    void setCallStatsSource(const CoreAV* av, uint32_t friendId);
 
 protected:
     void showEvent(QShowEvent* event);
@@ -74,6 +78,7 @@ public slots:
 
 private slots:
     void updateRatio();
+    void updateCallStats();
 
 private:
     void updateFrameSize(QSize size);
@@ -83,6 +88,7 @@ private:
     void exitFullScreen();
     void endVideoCall();
     void toggleVideoPreview();
+    void toggleCallStats();
     void toggleButtonState(QPushButton* btn);
     void updateButtonState(QPushButton* btn, bool active);
     void keyPressEvent(QKeyEvent *event);
@@ -100,6 +106,11 @@ private:
     QPushButton* microphoneButton = nullptr;
     QPushButton* endVideoButton = nullptr;
     QPushButton* exitFullScreenButton = nullptr;
+    QPushButton* callStatsButton = nullptr;
+    QLabel* callStatsLabel = nullptr;
+    QTimer* callStatsTimer = nullptr;
+    const CoreAV* callStatsAv = nullptr;
+    uint32_t callStatsFriendId = 0;
     CameraSource& cameraSource;
     Settings& settings;
     Style& style;
@@ -0,0 +1,70 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "screengrabber.h"
+
+#ifdef QTOX_X11_SCREEN_GRAB
+#include "src/platform/x11_screengrabber.h"
+#endif
+
+#include <QString>
+
+#include <tuple>
+
+/**
+ * @class ScreenGrabber
+ * @brief Native screen capture backend used by CameraSource instead of an FFmpeg grab device.
+ *
+ * Backends keep the captured image in memory shared with the display server and report which part
+ * of the screen changed since the previous grab, so unchanged frames don't have to be converted and
+ * encoded at all. Images are always 32 bit BGRX (AV_PIX_FMT_BGR0).
+ *
+ * @fn bool ScreenGrabber::grab(QRect& damage)
+ * @brief Updates the image if anything changed since the previous call.
+ * @param damage Set to the bounding box of the changed area relative to the grabbed region,
+ * empty if nothing changed. The first grab always reports the whole region.
+ * @return False if grabbing failed and the grabber should not be used anymore.
+ *
+ * @fn const uint8_t* ScreenGrabber::getData() const
+ * @brief Image data, valid until the next call to grab().
+ */
+
+ScreenGrabber::~ScreenGrabber() = default;
+
+/**
+ * @brief Creates the native backend for a screen device, if there is one for this platform.
+ * @param deviceName Device name as used by CameraDevice, e.g. "x11grab#:0".
+ * @param region Part of the screen to grab, the whole screen if empty.
+ * @param followWindow Move the region along with the window below its center.
+ * @return Grabber or nullptr if FFmpeg has to be used.
+ */
+std::unique_ptr<ScreenGrabber> ScreenGrabber::create(const QString& deviceName, const QRect& region,
+                                                     bool followWindow)
+{
+#ifdef QTOX_X11_SCREEN_GRAB
+    if (deviceName.startsWith("x11grab#")) {
+        return X11ScreenGrabber::create(deviceName.mid(8), region, followWindow);
+    }
+#endif
+
+    std::ignore = deviceName;
+    std::ignore = region;
+    std::ignore = followWindow;
+    return nullptr;
+}
@@ -0,0 +1,43 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QRect>
+#include <QSize>
+
+#include <cstdint>
+#include <memory>
+
+class ScreenGrabber
+{
+public:
+    ScreenGrabber() = default;
+    virtual ~ScreenGrabber();
+    ScreenGrabber(const ScreenGrabber&) = delete;
+    ScreenGrabber& operator=(const ScreenGrabber&) = delete;
+
+    static std::unique_ptr<ScreenGrabber> create(const QString& deviceName, const QRect& region,
+                                                 bool followWindow);
+
+    virtual bool grab(QRect& damage) = 0;
+    virtual const uint8_t* getData() const = 0;
+    virtual int getStride() const = 0;
+    virtual QSize getSize() const = 0;
+};
@@ -0,0 +1,180 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoconversionplanner.h"
+#include "videoframe.h"
+#include "util/tracer.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+/**
+ * @class VideoConversionPlanner
+ * @brief Converts each frame of a VideoSource once into everything its subscribers will ask for.
+ *
+ * Subscribers register the size and pixel format they request from VideoFrame. The source calls
+ * prepare() on its own thread before emitting a frame, so the subscribers only look the results
+ * up. The largest outputs are converted first and smaller ones are scaled down from the smallest
+ * result that still covers them instead of from the full source frame.
+ *
+ * @var int VideoConversionPlanner::Step::base
+ * @brief Index of the step whose result is scaled down, -1 for the source frame.
+ */
+
+namespace {
+qint64 area(const QSize& size)
+{
+    return static_cast<qint64>(size.width()) * size.height();
+}
+
+bool covers(const QSize& larger, const QSize& smaller)
+{
+    return larger.width() >= smaller.width() && larger.height() >= smaller.height();
+}
+} // namespace
+
+VideoConversionPlanner::Output::Output(const QSize& size_, int pixelFormat_, bool requireAligned_)
+    : size{size_}
+    , pixelFormat{pixelFormat_}
+    , requireAligned{requireAligned_}
+{
+}
+
+bool VideoConversionPlanner::Output::operator==(const Output& other) const
+{
+    return size == other.size && pixelFormat == other.pixelFormat
+           && requireAligned == other.requireAligned;
+}
+
+/**
+ * @brief Registers what a subscriber will request.
+ * @param output Requested frame, a negative pixel format requests nothing yet.
+ * @return Id to change or remove the output with.
+ */
+int VideoConversionPlanner::addOutput(const Output& output)
+{
+    QMutexLocker locker{&mutex};
+    const int id = nextId++;
+    outputs[id] = output;
+    return id;
+}
+
+/**
+ * @brief Changes a registered output, takes effect from the next frame on.
+ */
+void VideoConversionPlanner::setOutput(int id, const Output& output)
+{
+    QMutexLocker locker{&mutex};
+    auto it = outputs.find(id);
+    if (it != outputs.end()) {
+        it->second = output;
+    }
+}
+
+void VideoConversionPlanner::removeOutput(int id)
+{
+    QMutexLocker locker{&mutex};
+    outputs.erase(id);
+}
+
+/**
+ * @brief Produces all registered outputs of a frame.
+ * @note Call on the thread that emits the frame, before emitting it.
+ */
+void VideoConversionPlanner::prepare(VideoFrame& frame)
+{
+    std::vector<Output> requested;
+    {
+        QMutexLocker locker{&mutex};
+        for (const auto& entry : outputs) {
+            requested.push_back(entry.second);
+        }
+    }
+
+    if (requested.empty()) {
+        return;
+    }
+
+    TRACE_SCOPE("VideoConversionPlanner::prepare");
+    const std::vector<Step> steps = plan(std::move(requested), frame.getSourceDimensions().size());
+    std::vector<const AVFrame*> results;
+    results.reserve(steps.size());
+    for (const Step& step : steps) {
+        const AVFrame* base = step.base < 0 ? nullptr : results[step.base];
+        const Output& out = step.output;
+        results.push_back(frame.getAVFrame(out.size, out.pixelFormat, out.requireAligned, base));
+    }
+}
+
+/**
+ * @brief Orders conversions so each is scaled from the cheapest input.
+ * @param outputs Requested outputs, an invalid size requests the source size like VideoFrame
+ * does. Duplicates and outputs without pixel format are dropped.
+ * @param sourceSize Size of the source frame.
+ * @return Steps to convert in order.
+ *
+ * A result is only used as input if it covers the requested size and is in the requested pixel
+ * format or in YUV420P, which any other format can be derived from without visible loss.
+ */
+std::vector<VideoConversionPlanner::Step> VideoConversionPlanner::plan(std::vector<Output> outputs,
+                                                                       const QSize& sourceSize)
+{
+    const auto unset = [](const Output& out) { return out.pixelFormat < 0; };
+    outputs.erase(std::remove_if(outputs.begin(), outputs.end(), unset), outputs.end());
+    for (Output& out : outputs) {
+        if (!out.size.isValid()) {
+            out.size = sourceSize;
+        }
+    }
+    std::stable_sort(outputs.begin(), outputs.end(), [](const Output& a, const Output& b) {
+        return area(a.size) > area(b.size);
+    });
+
+    std::vector<Step> steps;
+    for (const Output& out : outputs) {
+        const bool duplicate = std::any_of(steps.cbegin(), steps.cend(), [&out](const Step& step) {
+            return step.output == out;
+        });
+        if (duplicate) {
+            continue;
+        }
+
+        int base = -1;
+        qint64 baseArea = area(sourceSize);
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const Output& candidate = steps[i].output;
+            const bool formatFits = candidate.pixelFormat == out.pixelFormat
+                                    || candidate.pixelFormat == AV_PIX_FMT_YUV420P;
+            // at equal size a converted frame is cheaper to read than the source format
+            if (formatFits && covers(candidate.size, out.size) && area(candidate.size) <= baseArea) {
+                base = static_cast<int>(i);
+                baseArea = area(candidate.size);
+            }
+        }
+
+        steps.push_back({out, base});
+    }
+
+    return steps;
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QSize>
+
+#include <map>
+#include <vector>
+
+class VideoFrame;
+
+class VideoConversionPlanner
+{
+public:
+    struct Output
+    {
+        Output() = default;
+        Output(const QSize& size_, int pixelFormat_, bool requireAligned_);
+
+        QSize size;
+        int pixelFormat = -1;
+        bool requireAligned = false;
+
+        bool operator==(const Output& other) const;
+    };
+
+    struct Step
+    {
+        Output output;
+        // index of the step whose result is scaled down, -1 for the source frame
+        int base;
+    };
+
+    VideoConversionPlanner() = default;
+    VideoConversionPlanner(const VideoConversionPlanner&) = delete;
+    VideoConversionPlanner& operator=(const VideoConversionPlanner&) = delete;
+
+    int addOutput(const Output& output);
+    void setOutput(int id, const Output& output);
+    void removeOutput(int id);
+
+    void prepare(VideoFrame& frame);
+    static std::vector<Step> plan(std::vector<Output> outputs, const QSize& sourceSize);
+
+private:
+    QMutex mutex;
+    std::map<int, Output> outputs;
+    int nextId = 0;
+};
@@ -18,12 +18,237 @@
 */
 
 #include "videoframe.h"
+#include "videoframepool.h"
+#include "util/tracer.h"
+
+#include <QMutexLocker>
+
+#include <tuple>
+#include <vector>
 
 extern "C" {
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 }
 
+#ifdef QTOX_LIBYUV
+#include <libyuv.h>
+#endif
+
+namespace {
+/**
+ * @brief Parameters a SwsContext was created with.
+ */
+struct ScalerKey
+{
+    int sourceWidth;
+    int sourceHeight;
+    int sourceFormat;
+    int targetWidth;
+    int targetHeight;
+    int targetFormat;
+    int flags;
+
+    bool operator==(const ScalerKey& other) const
+    {
+        return sourceWidth == other.sourceWidth && sourceHeight == other.sourceHeight
+               && sourceFormat == other.sourceFormat && targetWidth == other.targetWidth
+               && targetHeight == other.targetHeight && targetFormat == other.targetFormat
+               && flags == other.flags;
+    }
+
+    static size_t hash(const ScalerKey& key)
+    {
+        std::hash<int> intHasher;
+
+        // Same java-style combination as FrameBufferKey::hash()
+        size_t ret = 47;
+
+        ret = 37 * ret + intHasher(key.sourceWidth);
+        ret = 37 * ret + intHasher(key.sourceHeight);
+        ret = 37 * ret + intHasher(key.sourceFormat);
+        ret = 37 * ret + intHasher(key.targetWidth);
+        ret = 37 * ret + intHasher(key.targetHeight);
+        ret = 37 * ret + intHasher(key.targetFormat);
+        ret = 37 * ret + intHasher(key.flags);
+
+        return ret;
+    }
+};
+
+/**
+ * @brief Keeps idle SwsContexts around so conversions don't have to create one per frame.
+ *
+ * A SwsContext can only be used by one thread at a time, so contexts are taken out of the pool
+ * while scaling and put back afterwards. The number of idle contexts is bounded, when it
+ * overflows all contexts not matching the returned one are freed, since that means the
+ * parameters changed, e.g. because a video widget was resized.
+ */
+class ScalerPool
+{
+public:
+    ~ScalerPool()
+    {
+        for (auto& entry : idle) {
+            for (SwsContext* ctx : entry.second) {
+                sws_freeContext(ctx);
+            }
+        }
+    }
+
+    SwsContext* acquire(const ScalerKey& key)
+    {
+        {
+            QMutexLocker locker{&mutex};
+            auto it = idle.find(key);
+            if (it != idle.end() && !it->second.empty()) {
+                SwsContext* ctx = it->second.back();
+                it->second.pop_back();
+                --idleCount;
+                return ctx;
+            }
+        }
+
+        return sws_getContext(key.sourceWidth, key.sourceHeight,
+                              static_cast<AVPixelFormat>(key.sourceFormat), key.targetWidth,
+                              key.targetHeight, static_cast<AVPixelFormat>(key.targetFormat),
+                              key.flags, nullptr, nullptr, nullptr);
+    }
+
+    void release(const ScalerKey& key, SwsContext* ctx)
+    {
+        QMutexLocker locker{&mutex};
+
+        if (idleCount >= MAX_IDLE_CONTEXTS) {
+            for (auto it = idle.begin(); it != idle.end();) {
+                if (it->first == key) {
+                    ++it;
+                    continue;
+                }
+
+                for (SwsContext* stale : it->second) {
+                    sws_freeContext(stale);
+                }
+                idleCount -= it->second.size();
+                it = idle.erase(it);
+            }
+        }
+
+        if (idleCount >= MAX_IDLE_CONTEXTS) {
+            sws_freeContext(ctx);
+            return;
+        }
+
+        idle[key].push_back(ctx);
+        ++idleCount;
+    }
+
+private:
+    static constexpr size_t MAX_IDLE_CONTEXTS = 16;
+
+    QMutex mutex;
+    size_t idleCount = 0;
+    std::unordered_map<ScalerKey, std::vector<SwsContext*>, std::function<decltype(ScalerKey::hash)>>
+        idle{8, ScalerKey::hash};
+};
+
+constexpr size_t ScalerPool::MAX_IDLE_CONTEXTS;
+
+ScalerPool scalerPool;
+
+#ifdef QTOX_LIBYUV
+/**
+ * @brief A conversion libyuv's SIMD kernels do faster than swscale.
+ *
+ * Only targets the size of the source or exact 2:1 and 4:1 downscales of it when scales is set,
+ * anything else is left to swscale.
+ */
+struct FastPath
+{
+    int sourceFormat;
+    int targetFormat;
+    bool scales;
+    int (*convert)(const AVFrame& source, const QSize& sourceSize, AVFrame& target);
+};
+
+int scaleI420(const AVFrame& source, const QSize& sourceSize, AVFrame& target)
+{
+    return libyuv::I420Scale(source.data[0], source.linesize[0], source.data[1],
+                             source.linesize[1], source.data[2], source.linesize[2],
+                             sourceSize.width(), sourceSize.height(), target.data[0], target.linesize[0], target.data[1],
+                             target.linesize[1], target.data[2], target.linesize[2], target.width,
+                             target.height, libyuv::kFilterBox);
+}
+
+int yuyvToI420(const AVFrame& source, const QSize& sourceSize, AVFrame& target)
+{
+    std::ignore = sourceSize;
+    return libyuv::YUY2ToI420(source.data[0], source.linesize[0], target.data[0],
+                              target.linesize[0], target.data[1], target.linesize[1],
+                              target.data[2], target.linesize[2], target.width, target.height);
+}
+
+int nv12ToI420(const AVFrame& source, const QSize& sourceSize, AVFrame& target)
+{
+    std::ignore = sourceSize;
+    return libyuv::NV12ToI420(source.data[0], source.linesize[0], source.data[1],
+                              source.linesize[1], target.data[0], target.linesize[0],
+                              target.data[1], target.linesize[1], target.data[2],
+                              target.linesize[2], target.width, target.height);
+}
+
+int i420ToRgb24(const AVFrame& source, const QSize& sourceSize, AVFrame& target)
+{
+    std::ignore = sourceSize;
+    // libyuv names formats after their little endian words, RAW is R, G, B in memory order
+    return libyuv::I420ToRAW(source.data[0], source.linesize[0], source.data[1],
+                             source.linesize[1], source.data[2], source.linesize[2],
+                             target.data[0], target.linesize[0], target.width, target.height);
+}
+
+// decoded MJPEG frames are YUVJ420P, VideoFrame treats them as YUV420P already
+const FastPath fastPaths[] = {
+    {AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P, true, scaleI420},
+    {AV_PIX_FMT_YUYV422, AV_PIX_FMT_YUV420P, false, yuyvToI420},
+    {AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P, false, nv12ToI420},
+    {AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB24, false, i420ToRgb24},
+};
+
+bool isFastScale(const QSize& sourceSize, const AVFrame& target)
+{
+    for (int factor : {2, 4}) {
+        if (sourceSize.width() == target.width * factor
+            && sourceSize.height() == target.height * factor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Converts a frame with libyuv if it has a fast path for it.
+ * @param sourceFormat Pixel format to read the source as.
+ * @param sourceSize Part of the source to convert, starting at its top left corner.
+ * @return False if swscale has to do it.
+ */
+bool convertFast(const AVFrame& source, int sourceFormat, const QSize& sourceSize,
+                 AVFrame& target)
+{
+    const bool sameSize = sourceSize == QSize{target.width, target.height};
+    for (const FastPath& path : fastPaths) {
+        if (path.sourceFormat != sourceFormat || path.targetFormat != target.format) {
+            continue;
+        }
+        if (!sameSize && !(path.scales && isFastScale(sourceSize, target))) {
+            continue;
+        }
+        return path.convert(source, sourceSize, target) == 0;
+    }
+    return false;
+}
+#endif
+} // namespace
+
 /**
  * @struct ToxYUVFrame
  * @brief A simple structure to represent a ToxYUV video frame (corresponds to a frame encoded
@@ -70,17 +295,19 @@ extern "C" {
  * @class FrameBufferKey
  * @brief A class representing a structure that stores frame properties to be used as the key
  * value for a std::unordered_map.
+ *
+ *
+ * @class VideoFrameRegistry
+ * @brief Keeps weak references to the frames emitted by a single VideoSource.
+ *
+ * Each VideoSource owns its own registry, so tracking and releasing frames only contends with
+ * frames of the same source. Frames refer back to their registry weakly, a registry may be
+ * destroyed before the frames it tracked.
  */
 
 // Initialize static fields
 VideoFrame::AtomicIDType VideoFrame::frameIDs{0};
 
-std::unordered_map<VideoFrame::IDType, QMutex> VideoFrame::mutexMap{};
-std::unordered_map<VideoFrame::IDType, std::unordered_map<VideoFrame::IDType, std::weak_ptr<VideoFrame>>>
-    VideoFrame::refsMap{};
-
-QReadWriteLock VideoFrame::refsLock{};
-
 /**
  * @brief Constructs a new instance of a VideoFrame, sourced by a given AVFrame pointer.
  *
@@ -89,14 +316,18 @@ QReadWriteLock VideoFrame::refsLock{};
  * @param dimensions the dimensions of the AVFrame, obtained from the AVFrame if not given.
  * @param pixFmt the pixel format of the AVFrame, obtained from the AVFrame if not given.
  * @param freeSourceFrame whether to free the source frame buffers or not.
+ * @param framePool pool the source frame was taken from and derived frames are allocated from,
+ * optional.
  */
 VideoFrame::VideoFrame(IDType sourceID_, AVFrame* sourceFrame, QRect dimensions, int pixFmt,
-                       bool freeSourceFrame_)
+                       bool freeSourceFrame_, std::shared_ptr<VideoFramePool> framePool_)
     : frameID(frameIDs++)
     , sourceID(sourceID_)
+    , created(std::chrono::steady_clock::now())
     , sourceDimensions(dimensions)
     , sourceFrameKey(getFrameKey(dimensions.size(), pixFmt, sourceFrame->linesize[0]))
     , freeSourceFrame(freeSourceFrame_)
+    , framePool(std::move(framePool_))
 {
 
     // We override the pixel format in the case a deprecated one is used
@@ -140,9 +371,10 @@ VideoFrame::VideoFrame(IDType sourceID_, AVFrame* sourceFrame, QRect dimensions,
     frameBuffer[sourceFrameKey] = sourceFrame;
 }
 
-VideoFrame::VideoFrame(IDType sourceID_, AVFrame* sourceFrame, bool freeSourceFrame_)
+VideoFrame::VideoFrame(IDType sourceID_, AVFrame* sourceFrame, bool freeSourceFrame_,
+                       std::shared_ptr<VideoFramePool> framePool_)
     : VideoFrame(sourceID_, sourceFrame, QRect{0, 0, sourceFrame->width, sourceFrame->height},
-                 sourceFrame->format, freeSourceFrame_)
+                 sourceFrame->format, freeSourceFrame_, std::move(framePool_))
 {
 }
 
@@ -159,17 +391,10 @@ VideoFrame::~VideoFrame()
     frameLock.unlock();
 
     // Delete tracked reference
-    refsLock.lockForRead();
-
-    if (refsMap.count(sourceID) > 0) {
-        QMutex& sourceMutex = mutexMap[sourceID];
-
-        sourceMutex.lock();
-        refsMap[sourceID].erase(frameID);
-        sourceMutex.unlock();
+    std::shared_ptr<VideoFrameRegistry> frameRegistry = registry.lock();
+    if (frameRegistry) {
+        frameRegistry->untrack(frameID);
     }
-
-    refsLock.unlock();
 }
 
 /**
@@ -189,85 +414,6 @@ bool VideoFrame::isValid()
     return retValue;
 }
 
-/**
- * @brief Causes the VideoFrame class to maintain an internal reference for the frame.
- *
- * The internal reference is managed via a std::weak_ptr such that it doesn't inhibit
- * destruction of the object once all external references are no longer reachable.
- *
- * @return a std::shared_ptr holding a reference to this frame.
- */
-std::shared_ptr<VideoFrame> VideoFrame::trackFrame()
-{
-    // Add frame to tracked reference list
-    refsLock.lockForRead();
-
-    if (refsMap.count(sourceID) == 0) {
-        // We need to add a new source to our reference map, obtain write lock
-        refsLock.unlock();
-        refsLock.lockForWrite();
-    }
-
-    QMutex& sourceMutex = mutexMap[sourceID];
-
-    sourceMutex.lock();
-
-    std::shared_ptr<VideoFrame> ret{this};
-
-    refsMap[sourceID][frameID] = ret;
-
-    sourceMutex.unlock();
-    refsLock.unlock();
-
-    return ret;
-}
-
-/**
- * @brief Untracks all the frames for the given VideoSource, releasing them if specified.
- *
- * This function causes all internally tracked frames for the given VideoSource to be dropped.
- * If the releaseFrames option is set to true, the frames are sequentially released on the
- * caller's thread in an unspecified order.
- *
- * @param sourceID the ID of the VideoSource to untrack frames from.
- * @param releaseFrames true to release the frames as necessary, false otherwise. Defaults to
- * false.
- */
-void VideoFrame::untrackFrames(const VideoFrame::IDType& sourceID, bool releaseFrames)
-{
-    refsLock.lockForWrite();
-
-    if (refsMap.count(sourceID) == 0) {
-        // No tracking reference exists for source, simply return
-        refsLock.unlock();
-
-        return;
-    }
-
-    if (releaseFrames) {
-        QMutex& sourceMutex = mutexMap[sourceID];
-
-        sourceMutex.lock();
-
-        for (auto& frameIterator : refsMap[sourceID]) {
-            std::shared_ptr<VideoFrame> frame = frameIterator.second.lock();
-
-            if (frame) {
-                frame->releaseFrame();
-            }
-        }
-
-        sourceMutex.unlock();
-    }
-
-    refsMap[sourceID].clear();
-
-    mutexMap.erase(sourceID);
-    refsMap.erase(sourceID);
-
-    refsLock.unlock();
-}
-
 /**
  * @brief Releases all frames managed by this VideoFrame and invalidates it.
  */
@@ -290,10 +436,13 @@ void VideoFrame::releaseFrame()
  * is invalid.
  * @param pixelFormat the desired pixel format of the frame.
  * @param requireAligned true if the returned frame must be frame aligned, false if not.
+ * @param base frame of this VideoFrame to convert from instead of the source, must be at least
+ * as large as frameSize.
  * @return a pointer to a AVFrame with the given parameters or nullptr if the VideoFrame is no
  * longer valid.
  */
-const AVFrame* VideoFrame::getAVFrame(QSize frameSize, const int pixelFormat, const bool requireAligned)
+const AVFrame* VideoFrame::getAVFrame(QSize frameSize, const int pixelFormat, const bool requireAligned,
+                                      const AVFrame* base)
 {
     if (!frameSize.isValid()) {
         frameSize = sourceDimensions.size();
@@ -308,7 +457,7 @@ const AVFrame* VideoFrame::getAVFrame(QSize frameSize, const int pixelFormat, co
     AVFrame* nullPointer = nullptr;
 
     // Returns std::nullptr case of invalid generation
-    return toGenericObject(frameSize, pixelFormat, requireAligned, converter, nullPointer);
+    return toGenericObject(frameSize, pixelFormat, requireAligned, converter, nullPointer, base);
 }
 
 /**
@@ -324,6 +473,7 @@ const AVFrame* VideoFrame::getAVFrame(QSize frameSize, const int pixelFormat, co
  */
 QImage VideoFrame::toQImage(QSize frameSize)
 {
+    TRACE_SCOPE("VideoFrame::toQImage");
     if (!frameSize.isValid()) {
         frameSize = sourceDimensions.size();
     }
@@ -351,6 +501,7 @@ QImage VideoFrame::toQImage(QSize frameSize)
  */
 ToxYUVFrame VideoFrame::toToxYUVFrame(QSize frameSize)
 {
+    TRACE_SCOPE("VideoFrame::toToxYUVFrame");
     if (!frameSize.isValid()) {
         frameSize = sourceDimensions.size();
     }
@@ -410,6 +561,18 @@ int VideoFrame::getSourcePixelFormat() const
     return sourcePixelFormat;
 }
 
+/**
+ * @brief Time since this frame was created by its source, i.e. decoded or captured.
+ *
+ * @return nanoseconds since construction.
+ */
+qint64 VideoFrame::getAgeNs() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                - created)
+        .count();
+}
+
 
 /**
  * @brief Constructs a new FrameBufferKey with the given attributes.
@@ -552,12 +715,13 @@ AVFrame* VideoFrame::retrieveAVFrame(const QSize& dimensions, const int pixelFor
  * @param dimensions the required dimensions for the frame, must be valid.
  * @param pixelFormat the required pixel format for the frame.
  * @param requireAligned true if the generated frame needs to be frame aligned, false otherwise.
+ * @param base frame to convert from, the source frame if nullptr.
  * @return an AVFrame with the given specifications.
  */
 AVFrame* VideoFrame::generateAVFrame(const QSize& dimensions, const int pixelFormat,
-                                     const bool requireAligned)
+                                     const bool requireAligned, const AVFrame* base)
 {
-    AVFrame* ret = av_frame_alloc();
+    AVFrame* ret = framePool ? framePool->acquireFrame() : av_frame_alloc();
 
     if (!ret) {
         return nullptr;
@@ -576,46 +740,59 @@ AVFrame* VideoFrame::generateAVFrame(const QSize& dimensions, const int pixelFor
     int bufSize;
 
     const bool alreadyAligned = dimensions.width() % dataAlignment == 0 && dimensions.height() % dataAlignment == 0;
+    const int alignment = !requireAligned || alreadyAligned ? dataAlignment : 1;
 
-    if (!requireAligned || alreadyAligned) {
-        bufSize = av_image_alloc(ret->data, ret->linesize, dimensions.width(), dimensions.height(),
-                                 static_cast<AVPixelFormat>(pixelFormat), dataAlignment);
+    if (framePool) {
+        bufSize = av_image_get_buffer_size(static_cast<AVPixelFormat>(pixelFormat),
+                                           dimensions.width(), dimensions.height(), alignment);
+        ret->buf[0] = bufSize < 0 ? nullptr : framePool->acquireBuffer(bufSize);
+
+        if (ret->buf[0]) {
+            bufSize = av_image_fill_arrays(ret->data, ret->linesize, ret->buf[0]->data,
+                                           static_cast<AVPixelFormat>(pixelFormat),
+                                           dimensions.width(), dimensions.height(), alignment);
+        } else {
+            bufSize = -1;
+        }
     } else {
         bufSize = av_image_alloc(ret->data, ret->linesize, dimensions.width(), dimensions.height(),
-                                 static_cast<AVPixelFormat>(pixelFormat), 1);
+                                 static_cast<AVPixelFormat>(pixelFormat), alignment);
     }
 
     if (bufSize < 0) {
-        av_frame_free(&ret);
+        freeAVFrame(ret, true);
         return nullptr;
     }
 
+    const AVFrame* source = base ? base : frameBuffer[sourceFrameKey];
+    const QSize inputSize = base ? QSize{base->width, base->height} : sourceDimensions.size();
+    const int inputFormat = base ? base->format : sourcePixelFormat;
+
+#ifdef QTOX_LIBYUV
+    if (convertFast(*source, inputFormat, inputSize, *ret)) {
+        return ret;
+    }
+#endif
+
     // Bilinear is better for shrinking, bicubic better for upscaling
-    int resizeAlgo = sourceDimensions.width() > dimensions.width() ? SWS_BILINEAR : SWS_BICUBIC;
-    if (sourceDimensions.width() > 1920) {
+    int resizeAlgo = inputSize.width() > dimensions.width() ? SWS_BILINEAR : SWS_BICUBIC;
+    if (inputSize.width() > 1920) {
         resizeAlgo = SWS_BICUBIC;
     }
 
-    SwsContext* swsCtx =
-        sws_getContext(sourceDimensions.width(), sourceDimensions.height(),
-                       static_cast<AVPixelFormat>(sourcePixelFormat), dimensions.width(),
-                       dimensions.height(), static_cast<AVPixelFormat>(pixelFormat), resizeAlgo,
-                       nullptr, nullptr, nullptr);
+    const ScalerKey scalerKey{inputSize.width(),  inputSize.height(),  inputFormat,
+                              dimensions.width(), dimensions.height(), pixelFormat,
+                              resizeAlgo};
+    SwsContext* swsCtx = scalerPool.acquire(scalerKey);
 
     if (!swsCtx) {
-        av_freep(&ret->data[0]);
-#if LIBAVCODEC_VERSION_INT < 3747941
-        av_frame_unref(ret);
-#endif
-        av_frame_free(&ret);
+        freeAVFrame(ret, true);
         return nullptr;
     }
 
-    AVFrame* source = frameBuffer[sourceFrameKey];
-
-    sws_scale(swsCtx, source->data, source->linesize, 0, sourceDimensions.height(), ret->data,
+    sws_scale(swsCtx, source->data, source->linesize, 0, inputSize.height(), ret->data,
               ret->linesize);
-    sws_freeContext(swsCtx);
+    scalerPool.release(scalerKey, swsCtx);
 
     return ret;
 }
@@ -651,11 +828,7 @@ AVFrame* VideoFrame::storeAVFrame(AVFrame* frame, const QSize& dimensions, const
         AVFrame* old_ret = frameBuffer[frameKey];
 
         // Free new frame
-        av_freep(&frame->data[0]);
-#if LIBAVCODEC_VERSION_INT < 3747941
-        av_frame_unref(frame);
-#endif
-        av_frame_free(&frame);
+        freeAVFrame(frame, true);
 
         return old_ret;
     } else {
@@ -665,6 +838,30 @@ AVFrame* VideoFrame::storeAVFrame(AVFrame* frame, const QSize& dimensions, const
     }
 }
 
+/**
+ * @brief Frees an AVFrame or returns it to the frame pool.
+ *
+ * @param frame the frame to free.
+ * @param freeData true if data not owned by the frame's AVBufferRefs has to be freed as well.
+ */
+void VideoFrame::freeAVFrame(AVFrame* frame, bool freeData)
+{
+    // Pooled buffers are owned by buf[0] and returned by unreferencing the frame
+    if (freeData && !frame->buf[0]) {
+        av_freep(&frame->data[0]);
+    }
+
+    if (framePool) {
+        framePool->releaseFrame(frame);
+        return;
+    }
+
+#if LIBAVCODEC_VERSION_INT < 3747941
+    av_frame_unref(frame);
+#endif
+    av_frame_free(&frame);
+}
+
 /**
  * @brief Releases all frames within the frame buffer.
  *
@@ -678,24 +875,9 @@ void VideoFrame::deleteFrameBuffer()
     }
 
     for (const auto& frameIterator : frameBuffer) {
-        AVFrame* frame = frameIterator.second;
-
         // Treat source frame and derived frames separately
-        if (sourceFrameKey == frameIterator.first) {
-            if (freeSourceFrame) {
-                av_freep(&frame->data[0]);
-            }
-#if LIBAVCODEC_VERSION_INT < 3747941
-            av_frame_unref(frame);
-#endif
-            av_frame_free(&frame);
-        } else {
-            av_freep(&frame->data[0]);
-#if LIBAVCODEC_VERSION_INT < 3747941
-            av_frame_unref(frame);
-#endif
-            av_frame_free(&frame);
-        }
+        const bool freeData = sourceFrameKey != frameIterator.first || freeSourceFrame;
+        freeAVFrame(frameIterator.second, freeData);
     }
 
     frameBuffer.clear();
@@ -724,7 +906,7 @@ void VideoFrame::deleteFrameBuffer()
 template <typename T>
 T VideoFrame::toGenericObject(const QSize& dimensions, const int pixelFormat, const bool requireAligned,
                               const std::function<T(AVFrame* const)>& objectConstructor,
-                              const T& nullObject)
+                              const T& nullObject, const AVFrame* base)
 {
     frameLock.lockForRead();
 
@@ -744,7 +926,7 @@ T VideoFrame::toGenericObject(const QSize& dimensions, const int pixelFormat, co
     }
 
     // VideoFrame does not contain an AVFrame to spec, generate one here
-    frame = generateAVFrame(dimensions, static_cast<int>(pixelFormat), requireAligned);
+    frame = generateAVFrame(dimensions, static_cast<int>(pixelFormat), requireAligned, base);
 
     /*
      * We need to "upgrade" the lock to a write lock so we can update our frameBuffer map.
@@ -767,10 +949,71 @@ T VideoFrame::toGenericObject(const QSize& dimensions, const int pixelFormat, co
 // Explicitly specialize VideoFrame::toGenericObject() function
 template QImage VideoFrame::toGenericObject<QImage>(
     const QSize& dimensions, const int pixelFormat, const bool requireAligned,
-    const std::function<QImage(AVFrame* const)> &objectConstructor, const QImage& nullObject);
+    const std::function<QImage(AVFrame* const)> &objectConstructor, const QImage& nullObject,
+    const AVFrame* base);
 template ToxYUVFrame VideoFrame::toGenericObject<ToxYUVFrame>(
     const QSize& dimensions, const int pixelFormat, const bool requireAligned,
-    const std::function<ToxYUVFrame(AVFrame* const)> &objectConstructor, const ToxYUVFrame& nullObject);
+    const std::function<ToxYUVFrame(AVFrame* const)> &objectConstructor, const ToxYUVFrame& nullObject,
+    const AVFrame* base);
+
+/**
+ * @brief Tracks a frame with the given registry.
+ *
+ * The internal reference is managed via a std::weak_ptr such that it doesn't inhibit
+ * destruction of the object once all external references are no longer reachable.
+ *
+ * @param registry the registry of the VideoSource which created the frame.
+ * @param frame the frame to track, ownership is taken by the returned pointer.
+ * @return a std::shared_ptr holding a reference to the frame.
+ */
+std::shared_ptr<VideoFrame> VideoFrameRegistry::track(const std::shared_ptr<VideoFrameRegistry>& registry,
+                                                      VideoFrame* frame)
+{
+    std::shared_ptr<VideoFrame> ret{frame};
+    frame->registry = registry;
+
+    QMutexLocker locker{&registry->mutex};
+    registry->frames[frame->getFrameID()] = ret;
+
+    return ret;
+}
+
+/**
+ * @brief Untracks all frames and releases those still referenced, on the caller's thread.
+ */
+void VideoFrameRegistry::releaseAll()
+{
+    std::vector<std::shared_ptr<VideoFrame>> alive;
+
+    {
+        QMutexLocker locker{&mutex};
+        alive.reserve(frames.size());
+        for (auto& frameIterator : frames) {
+            std::shared_ptr<VideoFrame> frame = frameIterator.second.lock();
+            if (frame) {
+                alive.push_back(std::move(frame));
+            }
+        }
+        frames.clear();
+    }
+
+    // Released outside of the lock, dropping the last reference runs the destructor which
+    // untracks the frame again
+    for (const auto& frame : alive) {
+        frame->releaseFrame();
+    }
+}
+
+/**
+ * @brief Removes a destroyed frame from the registry.
+ *
+ * @param frameID the ID of the frame.
+ */
+void VideoFrameRegistry::untrack(VideoFrame::IDType frameID)
+{
+    QMutexLocker locker{&mutex};
+    frames.erase(frameID);
+}
 
 /**
  * @brief Returns whether the given ToxYUVFrame represents a valid frame or not.
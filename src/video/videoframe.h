@@ -33,11 +33,15 @@ extern "C" {
 }
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <unordered_map>
 
+class VideoFramePool;
+class VideoFrameRegistry;
+
 struct ToxYUVFrame
 {
 public:
@@ -61,8 +65,9 @@ public:
 
 public:
     VideoFrame(IDType sourceID_, AVFrame* sourceFrame, QRect dimensions, int pixFmt,
-               bool freeSourceFrame_ = false);
-    VideoFrame(IDType sourceID_, AVFrame* sourceFrame, bool freeSourceFrame_ = false);
+               bool freeSourceFrame_ = false, std::shared_ptr<VideoFramePool> framePool_ = {});
+    VideoFrame(IDType sourceID_, AVFrame* sourceFrame, bool freeSourceFrame_ = false,
+               std::shared_ptr<VideoFramePool> framePool_ = {});
 
     ~VideoFrame();
 
@@ -77,12 +82,10 @@ public:
 
     bool isValid();
 
-    std::shared_ptr<VideoFrame> trackFrame();
-    static void untrackFrames(const IDType& sourceID, bool releaseFrames = false);
-
     void releaseFrame();
 
-    const AVFrame* getAVFrame(QSize frameSize, const int pixelFormat, const bool requireAligned);
+    const AVFrame* getAVFrame(QSize frameSize, const int pixelFormat, const bool requireAligned,
+                              const AVFrame* base = nullptr);
     QImage toQImage(QSize frameSize = {});
     ToxYUVFrame toToxYUVFrame(QSize frameSize = {});
 
@@ -90,6 +93,7 @@ public:
     IDType getSourceID() const;
     QRect getSourceDimensions() const;
     int getSourcePixelFormat() const;
+    qint64 getAgeNs() const;
 
     static constexpr int dataAlignment = 32;
 
@@ -128,19 +132,25 @@ private:
                                       const bool frameAligned);
 
     AVFrame* retrieveAVFrame(const QSize& dimensions, const int pixelFormat, const bool requireAligned);
-    AVFrame* generateAVFrame(const QSize& dimensions, const int pixelFormat, const bool requireAligned);
+    AVFrame* generateAVFrame(const QSize& dimensions, const int pixelFormat, const bool requireAligned,
+                             const AVFrame* base);
     AVFrame* storeAVFrame(AVFrame* frame, const QSize& dimensions, const int pixelFormat);
 
+    void freeAVFrame(AVFrame* frame, bool freeData);
     void deleteFrameBuffer();
 
     template <typename T>
     T toGenericObject(const QSize& dimensions, const int pixelFormat, const bool requireAligned,
-                      const std::function<T(AVFrame* const)>& objectConstructor, const T& nullObject);
+                      const std::function<T(AVFrame* const)>& objectConstructor, const T& nullObject,
+                      const AVFrame* base = nullptr);
 
 private:
+    friend class VideoFrameRegistry;
+
     // ID
     const IDType frameID;
     const IDType sourceID;
+    const std::chrono::steady_clock::time_point created;
 
     // Main framebuffer store
     std::unordered_map<FrameBufferKey, AVFrame*, std::function<decltype(FrameBufferKey::hash)>>
@@ -152,13 +162,34 @@ private:
     const FrameBufferKey sourceFrameKey;
     const bool freeSourceFrame;
 
+    // Recycles the AVFrames and derived frame buffers, may be null
+    const std::shared_ptr<VideoFramePool> framePool;
+
     // Reference store
     static AtomicIDType frameIDs;
-
-    static std::unordered_map<IDType, QMutex> mutexMap;
-    static std::unordered_map<IDType, std::unordered_map<IDType, std::weak_ptr<VideoFrame>>> refsMap;
+    std::weak_ptr<VideoFrameRegistry> registry;
 
     // Concurrency
     QReadWriteLock frameLock{};
-    static QReadWriteLock refsLock;
+};
+
+class VideoFrameRegistry
+{
+public:
+    VideoFrameRegistry() = default;
+
+    VideoFrameRegistry(const VideoFrameRegistry&) = delete;
+    VideoFrameRegistry& operator=(const VideoFrameRegistry&) = delete;
+
+    static std::shared_ptr<VideoFrame> track(const std::shared_ptr<VideoFrameRegistry>& registry,
+                                             VideoFrame* frame);
+    void releaseAll();
+
+private:
+    friend class VideoFrame;
+
+    void untrack(VideoFrame::IDType frameID);
+
+    QMutex mutex;
+    std::unordered_map<VideoFrame::IDType, std::weak_ptr<VideoFrame>> frames;
 };
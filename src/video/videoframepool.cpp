@@ -0,0 +1,141 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoframepool.h"
+
+extern "C" {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#pragma GCC diagnostic pop
+}
+
+#include <QMutexLocker>
+
+/**
+ * @class VideoFramePool
+ * @brief Recycles the AVFrames and frame buffers of a single VideoSource.
+ *
+ * A source emitting frames at a steady resolution allocates the same AVFrame structs and the
+ * same conversion buffers over and over. VideoFrames created with a pool hand their AVFrames
+ * back here when they are released, and allocate converted frames from size keyed
+ * AVBufferPools, so the steady state doesn't touch the heap for frame data.
+ *
+ * Buffers handed out stay valid after the pool is destroyed, every AVBufferPool is only freed
+ * once its last buffer returned.
+ *
+ * @note All methods are thread safe.
+ */
+
+constexpr size_t VideoFramePool::MAX_IDLE_FRAMES;
+constexpr size_t VideoFramePool::MAX_BUFFER_POOLS;
+
+VideoFramePool::~VideoFramePool()
+{
+    clear();
+}
+
+/**
+ * @brief Returns an empty AVFrame, to be given back with releaseFrame().
+ * @return Empty frame or nullptr if the allocation failed.
+ */
+AVFrame* VideoFramePool::acquireFrame()
+{
+    {
+        QMutexLocker locker{&mutex};
+        if (!idleFrames.empty()) {
+            AVFrame* frame = idleFrames.back();
+            idleFrames.pop_back();
+            return frame;
+        }
+    }
+
+    return av_frame_alloc();
+}
+
+/**
+ * @brief Unreferences the buffers of a frame and keeps it for reuse.
+ * @param frame Frame from acquireFrame(), its data must be owned by its AVBufferRefs.
+ */
+void VideoFramePool::releaseFrame(AVFrame* frame)
+{
+    if (!frame) {
+        return;
+    }
+
+    av_frame_unref(frame);
+
+    QMutexLocker locker{&mutex};
+    if (idleFrames.size() >= MAX_IDLE_FRAMES) {
+        av_frame_free(&frame);
+        return;
+    }
+
+    idleFrames.push_back(frame);
+}
+
+/**
+ * @brief Returns a recycled buffer of the given size.
+ * @param size Buffer size in bytes.
+ * @return Buffer reference or nullptr on failure, unreference it to return it.
+ */
+AVBufferRef* VideoFramePool::acquireBuffer(int size)
+{
+    QMutexLocker locker{&mutex};
+
+    auto it = bufferPools.find(size);
+    if (it == bufferPools.end()) {
+        if (bufferPools.size() >= MAX_BUFFER_POOLS) {
+            // the resolution changed, the old pools free themselves once their buffers return
+            for (auto& entry : bufferPools) {
+                av_buffer_pool_uninit(&entry.second);
+            }
+            bufferPools.clear();
+        }
+
+        AVBufferPool* pool = av_buffer_pool_init(size, nullptr);
+        if (!pool) {
+            return nullptr;
+        }
+
+        it = bufferPools.emplace(size, pool).first;
+    }
+
+    return av_buffer_pool_get(it->second);
+}
+
+/**
+ * @brief Frees the idle frames and the buffers not in use, e.g. once the source stopped.
+ *
+ * Buffers still held by frames are freed when they return, the pool keeps working afterwards.
+ */
+void VideoFramePool::clear()
+{
+    QMutexLocker locker{&mutex};
+    for (AVFrame* frame : idleFrames) {
+        av_frame_free(&frame);
+    }
+    idleFrames.clear();
+
+    for (auto& entry : bufferPools) {
+        av_buffer_pool_uninit(&entry.second);
+    }
+    bufferPools.clear();
+}
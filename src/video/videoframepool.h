@@ -0,0 +1,52 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+
+#include <unordered_map>
+#include <vector>
+
+struct AVBufferPool;
+struct AVBufferRef;
+struct AVFrame;
+
+class VideoFramePool
+{
+public:
+    VideoFramePool() = default;
+    ~VideoFramePool();
+
+    VideoFramePool(const VideoFramePool&) = delete;
+    VideoFramePool& operator=(const VideoFramePool&) = delete;
+
+    AVFrame* acquireFrame();
+    void releaseFrame(AVFrame* frame);
+    AVBufferRef* acquireBuffer(int size);
+    void clear();
+
+private:
+    static constexpr size_t MAX_IDLE_FRAMES = 16;
+    static constexpr size_t MAX_BUFFER_POOLS = 4;
+
+    QMutex mutex;
+    std::vector<AVFrame*> idleFrames;
+    std::unordered_map<int, AVBufferPool*> bufferPools;
+};
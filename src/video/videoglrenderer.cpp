@@ -0,0 +1,195 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoglrenderer.h"
+#include "src/video/videoframe.h"
+
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QVector2D>
+
+/**
+ * @class VideoGLRenderer
+ * @brief Draws VideoFrames with OpenGL, converting YUV to RGB and scaling in a shader.
+ *
+ * The Y, U and V planes of the frame are uploaded as three single channel textures, so the CPU
+ * only copies the planes instead of converting and scaling every pixel with swscale. If the
+ * context or the shaders can't be created, unavailable() is emitted once and nothing is drawn,
+ * the owner is expected to fall back to VideoFrame::toQImage().
+ */
+
+namespace {
+const char* const vertexShader = R"(
+attribute vec2 position;
+attribute vec2 texCoord;
+varying vec2 vTexCoord;
+
+void main()
+{
+    gl_Position = vec4(position, 0.0, 1.0);
+    vTexCoord = texCoord;
+}
+)";
+
+// BT.601 limited range, the same conversion swscale uses for toQImage()
+const char* const fragmentShader = R"(
+#ifdef GL_ES
+precision mediump float;
+#endif
+uniform sampler2D texY;
+uniform sampler2D texU;
+uniform sampler2D texV;
+uniform vec2 lumaScale;
+uniform vec2 chromaScale;
+varying vec2 vTexCoord;
+
+void main()
+{
+    float y = 1.1643 * (texture2D(texY, vTexCoord * lumaScale).r - 0.0625);
+    float u = texture2D(texU, vTexCoord * chromaScale).r - 0.5;
+    float v = texture2D(texV, vTexCoord * chromaScale).r - 0.5;
+    gl_FragColor = vec4(y + 1.5958 * v, y - 0.39173 * u - 0.81290 * v, y + 2.017 * u, 1.0);
+}
+)";
+
+// Triangle strip covering the viewport, texture origin is the top left corner of the frame
+const GLfloat quadVertices[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+const GLfloat quadTexCoords[] = {0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+} // namespace
+
+VideoGLRenderer::VideoGLRenderer(QWidget* parent)
+    : QOpenGLWidget{parent}
+{
+    // Mouse handling is done by the VideoSurface below
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+VideoGLRenderer::~VideoGLRenderer()
+{
+    if (!textures[0]) {
+        return;
+    }
+
+    makeCurrent();
+    glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    doneCurrent();
+}
+
+/**
+ * @brief Sets the frame to draw and schedules a repaint.
+ * @param newFrame Frame to draw, nullptr to draw nothing.
+ */
+void VideoGLRenderer::setFrame(std::shared_ptr<VideoFrame> newFrame)
+{
+    frame = std::move(newFrame);
+    update();
+}
+
+/**
+ * @brief Returns false once OpenGL rendering failed, see unavailable().
+ */
+bool VideoGLRenderer::isAvailable() const
+{
+    return available;
+}
+
+void VideoGLRenderer::initializeGL()
+{
+    if (!context() || !context()->isValid()) {
+        fail("no valid OpenGL context");
+        return;
+    }
+
+    initializeOpenGLFunctions();
+
+    if (!program.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader)
+        || !program.addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader)
+        || !program.link()) {
+        fail(program.log());
+        return;
+    }
+
+    glGenTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
+void VideoGLRenderer::paintGL()
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!available || !frame) {
+        return;
+    }
+
+    const AVFrame* yuv = frame->getAVFrame({}, AV_PIX_FMT_YUV420P, false);
+    if (!yuv) {
+        frame.reset();
+        return;
+    }
+
+    // Textures are as wide as the linesize, the padding is cut off with the texture coordinates
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < textures.size(); ++i) {
+        const QSize size{yuv->linesize[i], i == 0 ? yuv->height : (yuv->height + 1) / 2};
+
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        if (size != textureSizes[i]) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, size.width(), size.height(), 0,
+                         GL_LUMINANCE, GL_UNSIGNED_BYTE, yuv->data[i]);
+            textureSizes[i] = size;
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_LUMINANCE,
+                            GL_UNSIGNED_BYTE, yuv->data[i]);
+        }
+    }
+
+    program.bind();
+    program.setUniformValue("texY", 0);
+    program.setUniformValue("texU", 1);
+    program.setUniformValue("texV", 2);
+    program.setUniformValue("lumaScale",
+                            QVector2D(static_cast<float>(yuv->width) / yuv->linesize[0], 1.0f));
+    program.setUniformValue("chromaScale",
+                            QVector2D(static_cast<float>((yuv->width + 1) / 2) / yuv->linesize[1],
+                                      1.0f));
+
+    program.enableAttributeArray("position");
+    program.enableAttributeArray("texCoord");
+    program.setAttributeArray("position", quadVertices, 2);
+    program.setAttributeArray("texCoord", quadTexCoords, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    program.disableAttributeArray("position");
+    program.disableAttributeArray("texCoord");
+    program.release();
+}
+
+void VideoGLRenderer::fail(const QString& reason)
+{
+    qWarning() << "OpenGL video rendering not available:" << reason;
+    available = false;
+    emit unavailable();
+}
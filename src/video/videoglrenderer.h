@@ -0,0 +1,58 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLWidget>
+#include <QSize>
+
+#include <array>
+#include <memory>
+
+class VideoFrame;
+
+class VideoGLRenderer : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit VideoGLRenderer(QWidget* parent = nullptr);
+    ~VideoGLRenderer() override;
+
+    void setFrame(std::shared_ptr<VideoFrame> newFrame);
+    bool isAvailable() const;
+
+signals:
+    void unavailable();
+
+protected:
+    void initializeGL() final;
+    void paintGL() final;
+
+private:
+    void fail(const QString& reason);
+
+    QOpenGLShaderProgram program;
+    std::array<GLuint, 3> textures{{0, 0, 0}};
+    std::array<QSize, 3> textureSizes;
+    std::shared_ptr<VideoFrame> frame;
+    bool available{true};
+};
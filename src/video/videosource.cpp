@@ -18,6 +18,7 @@
 */
 
 #include "videosource.h"
+#include "videoframe.h"
 
 /**
  * @class VideoSource
@@ -29,3 +30,19 @@
 
 // Initialize sourceIDs to 0
 VideoSource::AtomicIDType VideoSource::sourceIDs{0};
+
+VideoSource::VideoSource()
+    : id(sourceIDs++)
+    , frameRegistry(std::make_shared<VideoFrameRegistry>())
+{
+}
+
+VideoSource::~VideoSource() = default;
+
+/**
+ * @brief Lets subscribers register the conversions they request from emitted frames.
+ */
+VideoConversionPlanner& VideoSource::getConversionPlanner()
+{
+    return conversionPlanner;
+}
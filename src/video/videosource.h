@@ -19,12 +19,15 @@
 
 #pragma once
 
+#include "videoconversionplanner.h"
+
 #include <QObject>
 
 #include <atomic>
 #include <memory>
 
 class VideoFrame;
+class VideoFrameRegistry;
 
 class VideoSource : public QObject
 {
@@ -36,12 +39,8 @@ public:
     using AtomicIDType = std::atomic_uint_fast64_t;
 
 public:
-    VideoSource()
-        : id(sourceIDs++)
-    {
-    }
-
-    virtual ~VideoSource() = default;
+    VideoSource();
+    virtual ~VideoSource();
     /**
      * @brief If subscribe sucessfully opens the source, it will start emitting frameAvailable
      * signals.
@@ -52,6 +51,8 @@ public:
      */
     virtual void unsubscribe() = 0;
 
+    VideoConversionPlanner& getConversionPlanner();
+
     /// ID of this VideoSource
     const IDType id;
 signals:
@@ -66,6 +67,12 @@ signals:
      */
     void sourceStopped();
 
+protected:
+    /// Frames emitted by this source that are still alive
+    const std::shared_ptr<VideoFrameRegistry> frameRegistry;
+    /// Converts emitted frames for all subscribers, call prepare() before emitting
+    VideoConversionPlanner conversionPlanner;
+
 private:
     // Used to manage a global ID for all VideoSources
     static AtomicIDType sourceIDs;
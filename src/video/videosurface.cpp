@@ -23,12 +23,20 @@
 #include "src/friendlist.h"
 #include "src/persistence/settings.h"
 #include "src/video/videoframe.h"
+#include "src/video/videoglrenderer.h"
 #include "src/widget/friendwidget.h"
 #include "src/widget/style.h"
+#include "src/widget/tool/windowvisibility.h"
+#include "util/tracer.h"
 
 #include <QDebug>
+#include <QGuiApplication>
 #include <QLabel>
 #include <QPainter>
+#include <QScreen>
+#include <QWindow>
+
+#include <algorithm>
 
 namespace {
 float getSizeRatio(const QSize size)
@@ -40,16 +48,30 @@ float getSizeRatio(const QSize size)
 /**
  * @var std::atomic_bool VideoSurface::frameLock
  * @brief Fast lock for lastFrame.
+ *
+ * @var VideoGLRenderer* VideoSurface::glRenderer
+ * @brief Child widget drawing the frames inside boundingRect, nullptr if OpenGL isn't usable and
+ * frames are converted with VideoFrame::toQImage() instead.
+ *
+ * @var std::atomic_int VideoSurface::previewFpsLimit
+ * @brief Repaint rate cap of all previews from CpuGovernor, 0 for the display refresh rate.
  */
+std::atomic_int VideoSurface::previewFpsLimit{0};
+
 VideoSurface::VideoSurface(const QPixmap& avatar_, QWidget* parent, bool expanding_)
     : QWidget{parent}
     , source{nullptr}
+    , glRenderer{new VideoGLRenderer(this)}
     , frameLock{false}
     , hasSubscribed{0}
     , avatar{avatar_}
     , ratio{1.0f}
     , expanding{expanding_}
 {
+    glRenderer->hide();
+    connect(glRenderer, &VideoGLRenderer::unavailable, this, &VideoSurface::onGLUnavailable);
+    previewTimer.setSingleShot(true);
+    connect(&previewTimer, &QTimer::timeout, this, static_cast<void (QWidget::*)()>(&QWidget::update));
     recalulateBounds();
 }
 
@@ -109,10 +131,60 @@ QPixmap VideoSurface::getAvatar() const
     return avatar;
 }
 
+/**
+ * @brief Returns what was painted since the previous call and starts a new interval.
+ * @return Frame rate and size of the painted frames and their average delay from being decoded
+ * or captured to being painted. The frame rate is zero for the first call.
+ */
+VideoSurface::FrameStats VideoSurface::takeFrameStats()
+{
+    FrameStats stats;
+    stats.size = paintedSize;
+    if (statsTimer.isValid() && statsTimer.elapsed() > 0) {
+        stats.fps = paintedFrames * 1000.0 / statsTimer.elapsed();
+    }
+    if (paintedFrames > 0) {
+        stats.delayMs = paintDelayNs / 1000000.0 / paintedFrames;
+    }
+
+    paintedFrames = 0;
+    paintDelayNs = 0;
+    statsTimer.start();
+    return stats;
+}
+
+/**
+ * @brief Shows the frames as a small preview of the own camera.
+ * @param enabled True for a preview.
+ *
+ * A preview converts each frame to its on-screen size in one scaler pass instead of drawing the
+ * full source resolution and repaints at most at the display refresh rate. Like every surface it
+ * drops frames while it can't be seen.
+ */
+void VideoSurface::setPreview(bool enabled)
+{
+    preview = enabled;
+    if (preview && glRenderer) {
+        // the renderer uploads full resolution textures, the preview only needs its own size
+        onGLUnavailable();
+    }
+    updateOutput();
+}
+
+/**
+ * @brief Caps the repaint rate of all previews, e.g. to save CPU during a call.
+ * @param fps Highest rate to repaint at, 0 for the display refresh rate.
+ */
+void VideoSurface::setPreviewFpsLimit(int fps)
+{
+    previewFpsLimit = std::max(0, fps);
+}
+
 void VideoSurface::subscribe()
 {
     if (source && hasSubscribed++ == 0) {
         source->subscribe();
+        videoOutput = source->getConversionPlanner().addOutput(getPaintedOutput());
         connect(source, &VideoSource::frameAvailable, this, &VideoSurface::onNewFrameAvailable);
         connect(source, &VideoSource::sourceStopped, this, &VideoSurface::onSourceStopped);
     }
@@ -129,6 +201,7 @@ void VideoSurface::unsubscribe()
     lock();
     lastFrame.reset();
     unlock();
+    updateRenderer();
 
     ratio = 1.0f;
     recalulateBounds();
@@ -137,11 +210,19 @@ void VideoSurface::unsubscribe()
 
     disconnect(source, &VideoSource::frameAvailable, this, &VideoSurface::onNewFrameAvailable);
     disconnect(source, &VideoSource::sourceStopped, this, &VideoSurface::onSourceStopped);
+    source->getConversionPlanner().removeOutput(videoOutput);
+    videoOutput = -1;
     source->unsubscribe();
 }
 
 void VideoSurface::onNewFrameAvailable(const std::shared_ptr<VideoFrame>& newFrame)
 {
+    // stops conversions on the source thread as well while we can't be seen
+    updateOutput();
+    if (!isShown()) {
+        return;
+    }
+
     QSize newSize;
 
     lock();
@@ -158,6 +239,12 @@ void VideoSurface::onNewFrameAvailable(const std::shared_ptr<VideoFrame>& newFra
         emit boundaryChanged();
     }
 
+    if (preview) {
+        schedulePreview();
+        return;
+    }
+
+    updateRenderer();
     update();
 }
 
@@ -165,18 +252,48 @@ void VideoSurface::onSourceStopped()
 {
     // If the source's stream is on hold, just revert back to the avatar view
     lastFrame.reset();
+    updateRenderer();
+    update();
+}
+
+/**
+ * @brief Falls back to drawing with QPainter.
+ */
+void VideoSurface::onGLUnavailable()
+{
+    glRenderer->deleteLater();
+    glRenderer = nullptr;
+    updateOutput();
     update();
 }
 
 void VideoSurface::paintEvent(QPaintEvent* event)
 {
+    TRACE_SCOPE("VideoSurface::paintEvent");
     std::ignore = event;
     lock();
 
     QPainter painter(this);
     painter.fillRect(painter.viewport(), Qt::black);
     if (lastFrame) {
-        QImage frame = lastFrame->toQImage(rect().size());
+        if (lastFrame->getFrameID() != lastPaintedFrame) {
+            lastPaintedFrame = lastFrame->getFrameID();
+            ++paintedFrames;
+            paintDelayNs += lastFrame->getAgeNs();
+            paintedSize = lastFrame->getSourceDimensions().size();
+        }
+
+        // glRenderer draws the frame on top of us if available
+        if (glRenderer) {
+            unlock();
+            return;
+        }
+
+        if (preview) {
+            lastPreviewPaint.start();
+        }
+
+        QImage frame = lastFrame->toQImage(getPaintedOutput().size);
         if (frame.isNull())
             lastFrame.reset();
         painter.drawImage(boundingRect, frame, frame.rect(), Qt::NoFormatConversion);
@@ -227,9 +344,87 @@ void VideoSurface::recalulateBounds()
         boundingRect.setRect(pos.x(), pos.y(), size.width(), size.height());
     }
 
+    if (glRenderer) {
+        glRenderer->setGeometry(boundingRect);
+    }
+
+    updateOutput();
     update();
 }
 
+/**
+ * @brief Hands the current frame to glRenderer, which is only shown while there is a frame.
+ */
+void VideoSurface::updateRenderer()
+{
+    if (!glRenderer) {
+        return;
+    }
+
+    lock();
+    std::shared_ptr<VideoFrame> frame = lastFrame;
+    unlock();
+
+    glRenderer->setFrame(frame);
+    glRenderer->setVisible(frame != nullptr);
+}
+
+/**
+ * @brief The frame this surface converts each video frame to for painting.
+ */
+VideoConversionPlanner::Output VideoSurface::getPaintedOutput() const
+{
+    if (!isShown()) {
+        return {};
+    }
+    if (glRenderer) {
+        return {QSize(), AV_PIX_FMT_YUV420P, false};
+    }
+
+    const QSize size = preview ? boundingRect.size() * devicePixelRatioF() : rect().size();
+    return {size, AV_PIX_FMT_RGB24, false};
+}
+
+/**
+ * @brief Lets the source convert its frames for us before emitting them.
+ */
+void VideoSurface::updateOutput()
+{
+    if (source && videoOutput >= 0) {
+        source->getConversionPlanner().setOutput(videoOutput, getPaintedOutput());
+    }
+}
+
+/**
+ * @brief Whether frames could be seen, not while the window is minimized or covered.
+ */
+bool VideoSurface::isShown() const
+{
+    return isVisible() && WindowVisibility::isRendered(this);
+}
+
+/**
+ * @brief Repaints the preview once a display refresh passed since the last time.
+ */
+void VideoSurface::schedulePreview()
+{
+    if (previewTimer.isActive()) {
+        return;
+    }
+
+    const QWindow* handle = window()->windowHandle();
+    const QScreen* screen = handle ? handle->screen() : QGuiApplication::primaryScreen();
+    qreal refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+    const int fpsLimit = previewFpsLimit;
+    if (fpsLimit > 0) {
+        refreshRate = std::min<qreal>(refreshRate, fpsLimit);
+    }
+    const qint64 intervalMs = static_cast<qint64>(1000 / refreshRate);
+    const qint64 sincePaintMs = lastPreviewPaint.isValid() ? lastPreviewPaint.elapsed() : intervalMs;
+
+    previewTimer.start(static_cast<int>(std::max<qint64>(0, intervalMs - sincePaintMs)));
+}
+
 void VideoSurface::lock()
 {
     // Fast lock
@@ -20,15 +20,27 @@
 #pragma once
 
 #include "src/video/videosource.h"
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QWidget>
 #include <atomic>
+#include <cstdint>
 #include <memory>
 
+class VideoGLRenderer;
+
 class VideoSurface : public QWidget
 {
     Q_OBJECT
 
 public:
+    struct FrameStats
+    {
+        qreal fps = 0;
+        QSize size;
+        qreal delayMs = 0;
+    };
+
     VideoSurface(const QPixmap& avatar_, QWidget* parent = nullptr, bool expanding_ = false);
     VideoSurface(const QPixmap& avatar_, VideoSource* source_, QWidget* parent = nullptr);
     ~VideoSurface();
@@ -39,6 +51,10 @@ public:
     float getRatio() const;
     void setAvatar(const QPixmap& pixmap);
     QPixmap getAvatar() const;
+    FrameStats takeFrameStats();
+    void setPreview(bool enabled);
+
+    static void setPreviewFpsLimit(int fps);
 
 signals:
     void ratioChanged();
@@ -55,18 +71,37 @@ protected:
 private slots:
     void onNewFrameAvailable(const std::shared_ptr<VideoFrame>& newFrame);
     void onSourceStopped();
+    void onGLUnavailable();
 
 private:
     void recalulateBounds();
+    void updateRenderer();
+    bool isShown() const;
+    VideoConversionPlanner::Output getPaintedOutput() const;
+    void updateOutput();
+    void schedulePreview();
     void lock();
     void unlock();
 
     QRect boundingRect;
     VideoSource* source;
+    VideoGLRenderer* glRenderer;
     std::shared_ptr<VideoFrame> lastFrame;
     std::atomic_bool frameLock;
     uint8_t hasSubscribed;
     QPixmap avatar;
     float ratio;
     bool expanding;
+    bool preview = false;
+    int videoOutput = -1;
+    QTimer previewTimer;
+    QElapsedTimer lastPreviewPaint;
+    static std::atomic_int previewFpsLimit;
+
+    // frames painted since the last takeFrameStats(), only used on the GUI thread
+    uint64_t lastPaintedFrame = UINT64_MAX;
+    int paintedFrames = 0;
+    qint64 paintDelayNs = 0;
+    QSize paintedSize;
+    QElapsedTimer statsTimer;
 };
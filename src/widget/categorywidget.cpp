@@ -132,10 +132,13 @@ void CategoryWidget::editName()
 
 void CategoryWidget::addFriendWidget(FriendWidget* w, Status::Status s)
 {
+    const bool moved = w->parentWidget() != listWidget;
     listLayout->addFriendWidget(w, s);
     updateStatus();
     onAddFriendWidget(w);
-    w->reloadTheme(); // Otherwise theme will change when moving to another circle.
+    if (moved) {
+        w->reloadTheme(); // Otherwise theme will change when moving to another circle.
+    }
 }
 
 void CategoryWidget::removeFriendWidget(FriendWidget* w, Status::Status s)
@@ -167,7 +167,7 @@ ChatFormHeader::ChatFormHeader(Settings& settings_, Style& style_, QWidget* pare
     setLayout(headLayout);
 
     updateButtonsView();
-    Translator::registerHandler(std::bind(&ChatFormHeader::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ChatFormHeader::retranslateUi, this), this, this);
 
     connect(&style, &Style::themeReload, this, &ChatFormHeader::reloadTheme);
 }
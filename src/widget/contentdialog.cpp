@@ -145,7 +145,7 @@ ContentDialog::ContentDialog(const Core &core, Settings& settings_,
     connect(&settings, &Settings::groupchatPositionChanged, this, &ContentDialog::onGroupchatPositionChanged);
     connect(splitter, &QSplitter::splitterMoved, this, &ContentDialog::saveSplitterState);
 
-    Translator::registerHandler(std::bind(&ContentDialog::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ContentDialog::retranslateUi, this), this, this);
 }
 
 ContentDialog::~ContentDialog()
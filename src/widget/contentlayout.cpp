@@ -20,9 +20,29 @@
 #include "contentlayout.h"
 #include "style.h"
 #include "src/persistence/settings.h"
+#include "util/cacheregistry.h"
 #include <QFrame>
 #include <QStyleFactory>
 
+#include <algorithm>
+
+/**
+ * @class ContentLayout
+ * @brief Head and content area of the main window or a ContentDialog.
+ *
+ * Chat forms shown with showCachedForm() stay laid out as hidden children when another form is
+ * shown, so switching back to one of the last MAX_CACHED_FORMS chats is only a show(). Older
+ * forms are evicted: they are taken out of the layout and unparented, which also lets them
+ * release memory, see GenericChatForm::event().
+ *
+ * In the low memory mode of the CacheRegistry only LOW_MEMORY_CACHED_FORMS stay cached, and
+ * hidden forms are evicted once they weren't shown for INACTIVE_FORM_MS.
+ */
+
+constexpr int ContentLayout::MAX_CACHED_FORMS;
+constexpr int ContentLayout::LOW_MEMORY_CACHED_FORMS;
+constexpr int ContentLayout::INACTIVE_FORM_MS;
+
 ContentLayout::ContentLayout(Settings& settings_, Style& style_)
     : QVBoxLayout()
     , settings{settings_}
@@ -64,6 +84,11 @@ ContentLayout::ContentLayout(Settings& settings_, Style& style_, QWidget* parent
 
 ContentLayout::~ContentLayout()
 {
+    // the forms are owned elsewhere and must not be deleted with mainContent
+    for (const CachedForm& form : cachedForms) {
+        evict(form);
+    }
+    cachedForms.clear();
     clear();
 
     mainHead->deleteLater();
@@ -78,19 +103,116 @@ void ContentLayout::reloadTheme()
 #endif
 }
 
+/**
+ * @brief Hides all widgets, removes those that aren't cached forms.
+ */
 void ContentLayout::clear()
 {
-    QLayoutItem* item;
-    while ((item = mainHead->layout()->takeAt(0)) != nullptr) {
-        item->widget()->hide();
-        item->widget()->setParent(nullptr);
-        delete item;
+    for (QLayout* layout : {mainHead->layout(), mainContent->layout()}) {
+        for (int i = layout->count() - 1; i >= 0; --i) {
+            QWidget* widget = layout->itemAt(i)->widget();
+            widget->hide();
+            if (isCached(widget)) {
+                continue;
+            }
+
+            delete layout->takeAt(i);
+            widget->setParent(nullptr);
+        }
+    }
+}
+
+/**
+ * @brief Shows a chat form, reusing its layout if it was shown here recently.
+ * @param head Head widget of the form.
+ * @param content The form itself.
+ * @note Call clear() before, to hide the form shown so far.
+ */
+void ContentLayout::showCachedForm(QWidget* head, QWidget* content)
+{
+    pruneCache();
+
+    const auto it =
+        std::find_if(cachedForms.begin(), cachedForms.end(),
+                     [content](const CachedForm& form) { return form.content == content; });
+    if (it != cachedForms.end()) {
+        CachedForm form = *it;
+        form.lastShownMs = clock.elapsed();
+        cachedForms.erase(it);
+        cachedForms.prepend(form);
+    } else {
+        cachedForms.prepend({head, content, clock.elapsed()});
+        mainHead->layout()->addWidget(head);
+#if QT_VERSION < QT_VERSION_CHECK(5, 12, 4) && QT_VERSION > QT_VERSION_CHECK(5, 11, 0)
+        // HACK: switching order happens to avoid a Qt bug causing segfault, present between these versions.
+        // this could cause flickering if our form is shown before added to the layout
+        // https://github.com/qTox/qTox/issues/5570
+        content->show();
+#endif
+        mainContent->layout()->addWidget(content);
     }
 
-    while ((item = mainContent->layout()->takeAt(0)) != nullptr) {
-        item->widget()->hide();
-        item->widget()->setParent(nullptr);
-        delete item;
+    head->show();
+    content->show();
+
+    const int maxForms =
+        CacheRegistry::getInstance().isLowMemory() ? LOW_MEMORY_CACHED_FORMS : MAX_CACHED_FORMS;
+    while (cachedForms.size() > maxForms) {
+        evict(cachedForms.takeLast());
+    }
+}
+
+bool ContentLayout::isCached(const QWidget* widget) const
+{
+    return std::any_of(cachedForms.begin(), cachedForms.end(), [widget](const CachedForm& form) {
+        return form.head == widget || form.content == widget;
+    });
+}
+
+/**
+ * @brief Forgets forms that were deleted or moved to another ContentLayout.
+ */
+void ContentLayout::pruneCache()
+{
+    auto isGone = [this](const CachedForm& form) {
+        return !form.head || !form.content || form.head->parentWidget() != mainHead
+               || form.content->parentWidget() != mainContent;
+    };
+    cachedForms.erase(std::remove_if(cachedForms.begin(), cachedForms.end(), isGone),
+                      cachedForms.end());
+}
+
+void ContentLayout::evict(const CachedForm& form)
+{
+    if (form.head && form.head->parentWidget() == mainHead) {
+        form.head->hide();
+        mainHead->layout()->removeWidget(form.head);
+        form.head->setParent(nullptr);
+    }
+
+    if (form.content && form.content->parentWidget() == mainContent) {
+        form.content->hide();
+        mainContent->layout()->removeWidget(form.content);
+        form.content->setParent(nullptr);
+    }
+}
+
+/**
+ * @brief Evicts the hidden forms that weren't shown for a while, only in the low memory mode.
+ */
+void ContentLayout::evictInactive()
+{
+    if (!CacheRegistry::getInstance().isLowMemory()) {
+        return;
+    }
+
+    pruneCache();
+    const qint64 now = clock.elapsed();
+    for (int i = cachedForms.size() - 1; i >= 0; --i) {
+        const CachedForm& form = cachedForms[i];
+        if (!form.content->isVisible() && now - form.lastShownMs >= INACTIVE_FORM_MS) {
+            evict(cachedForms.takeAt(i));
+        }
     }
 }
 
@@ -133,4 +255,9 @@ void ContentLayout::init()
     addWidget(mainHead);
     addLayout(&mainHLineLayout);
     addWidget(mainContent);
+
+    clock.start();
+    inactiveTimer.setInterval(INACTIVE_FORM_MS / 5);
+    connect(&inactiveTimer, &QTimer::timeout, this, &ContentLayout::evictInactive);
+    inactiveTimer.start();
 }
@@ -20,7 +20,11 @@
 #pragma once
 
 #include <QBoxLayout>
+#include <QElapsedTimer>
 #include <QFrame>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
 
 class Settings;
 class Style;
@@ -33,6 +37,11 @@ public:
     ~ContentLayout();
 
     void clear();
+    void showCachedForm(QWidget* head, QWidget* content);
+
+    static constexpr int MAX_CACHED_FORMS = 8;
+    static constexpr int LOW_MEMORY_CACHED_FORMS = 2;
+    static constexpr int INACTIVE_FORM_MS = 5 * 60 * 1000;
 
     QFrame mainHLine;
     QHBoxLayout mainHLineLayout;
@@ -45,5 +54,22 @@ public slots:
     void reloadTheme();
 
 private:
+    struct CachedForm
+    {
+        QPointer<QWidget> head;
+        QPointer<QWidget> content;
+        qint64 lastShownMs;
+    };
+
     void init();
+    bool isCached(const QWidget* widget) const;
+    void pruneCache();
+    void evict(const CachedForm& form);
+    void evictInactive();
+
+private:
+    // most recently shown first
+    QVector<CachedForm> cachedForms;
+    QElapsedTimer clock;
+    QTimer inactiveTimer;
 };
@@ -29,11 +29,27 @@
 #include <QPushButton>
 #include <QRadioButton>
 
+#include <algorithm>
 #include <math.h>
 
-EmoticonsWidget::EmoticonsWidget(SmileyPack& smileyPack, Settings& settings,
+/**
+ * @class EmoticonsWidget
+ * @brief Emoticon picker showing the loaded pack in pages of ITEMS_PER_PAGE buttons.
+ *
+ * Only the page shown and its neighbours get their buttons, the rest are built when the user
+ * flips to them, so opening the picker with a large pack doesn't create thousands of widgets and
+ * pixmaps. The pixmaps come from the SmileyPack cache.
+ */
+
+constexpr int EmoticonsWidget::MAX_COLS;
+constexpr int EmoticonsWidget::MAX_ROWS;
+constexpr int EmoticonsWidget::ITEMS_PER_PAGE;
+
+EmoticonsWidget::EmoticonsWidget(SmileyPack& smileyPack_, Settings& settings,
     Style& style, QWidget* parent)
     : QMenu(parent)
+    , smileyPack{smileyPack_}
+    , emoticons(smileyPack_.getEmoticons())
 {
     setStyleSheet(style.getStylesheet("emoticonWidget/emoticonWidget.css", settings));
     setLayout(&layout);
@@ -45,30 +61,22 @@ EmoticonsWidget::EmoticonsWidget(SmileyPack& smileyPack, Settings& settings,
 
     layout.addWidget(pageButtonsContainer);
 
-    const int maxCols = 8;
-    const int maxRows = 8;
-    const int itemsPerPage = maxRows * maxCols;
-
-    const QList<QStringList>& emoticons = smileyPack.getEmoticons();
     int itemCount = emoticons.size();
-    int pageCount = ceil(float(itemCount) / float(itemsPerPage));
-    int currPage = 0;
-    int currItem = 0;
-    int row = 0;
-    int col = 0;
+    int pageCount = ceil(float(itemCount) / float(ITEMS_PER_PAGE));
+    pagesBuilt.fill(false, pageCount);
 
     // respect configured emoticon size
     const int px = settings.getEmojiFontPointSize();
-    const QSize size(px, px);
+    emoticonSize = QSize(px, px);
 
     // create pages
     buttonLayout->addStretch();
     for (int i = 0; i < pageCount; ++i) {
         QGridLayout* pageLayout = new QGridLayout;
         pageLayout->addItem(new QSpacerItem(0, 0, QSizePolicy::Minimum, QSizePolicy::Expanding),
-                            maxRows, 0);
+                            MAX_ROWS, 0);
         pageLayout->addItem(new QSpacerItem(0, 0, QSizePolicy::Expanding, QSizePolicy::Minimum), 0,
-                            maxCols);
+                            MAX_COLS);
 
         QWidget* page = new QWidget;
         page->setLayout(pageLayout);
@@ -87,41 +95,54 @@ EmoticonsWidget::EmoticonsWidget(SmileyPack& smileyPack, Settings& settings,
     }
     buttonLayout->addStretch();
 
-    for (const QStringList& set : emoticons) {
+    // the first page is full unless it's the only one, so the size hint is right from the start
+    buildVisiblePages();
+    connect(&stack, &QStackedWidget::currentChanged, this, &EmoticonsWidget::buildVisiblePages);
+
+    // calculates sizeHint
+    layout.activate();
+}
+
+/**
+ * @brief Builds the current page and its neighbours, so flipping never shows an empty page.
+ */
+void EmoticonsWidget::buildVisiblePages()
+{
+    const int current = stack.currentIndex();
+    for (int page = current - 1; page <= current + 1; ++page) {
+        buildPage(page);
+    }
+}
+
+/**
+ * @brief Creates the buttons of a page, if that didn't happen yet.
+ */
+void EmoticonsWidget::buildPage(int page)
+{
+    if (page < 0 || page >= pagesBuilt.size() || pagesBuilt[page]) {
+        return;
+    }
+    pagesBuilt[page] = true;
+
+    QGridLayout* pageLayout = qobject_cast<QGridLayout*>(stack.widget(page)->layout());
+    const int first = page * ITEMS_PER_PAGE;
+    const int last = std::min(first + ITEMS_PER_PAGE, static_cast<int>(emoticons.size()));
+    for (int i = first; i < last; ++i) {
+        const QStringList& set = emoticons[i];
         QPushButton* button = new QPushButton;
-        std::shared_ptr<QIcon> icon = smileyPack.getAsIcon(set[0]);
-        emoticonsIcons.append(icon);
-        button->setIcon(icon->pixmap(size));
+        button->setIcon(smileyPack.getAsPixmap(set[0], emoticonSize));
         button->setToolTip(set.join(" "));
         button->setProperty("sequence", set[0]);
         button->setCursor(Qt::PointingHandCursor);
         button->setFlat(true);
-        button->setIconSize(size);
-        button->setFixedSize(size);
+        button->setIconSize(emoticonSize);
+        button->setFixedSize(emoticonSize);
 
         connect(button, &QPushButton::clicked, this, &EmoticonsWidget::onSmileyClicked);
 
-        qobject_cast<QGridLayout*>(stack.widget(currPage)->layout())->addWidget(button, row, col);
-
-        ++col;
-        ++currItem;
-
-        // next row
-        if (col >= maxCols) {
-            col = 0;
-            ++row;
-        }
-
-        // next page
-        if (currItem >= itemsPerPage) {
-            row = 0;
-            currItem = 0;
-            ++currPage;
-        }
+        const int item = i - first;
+        pageLayout->addWidget(button, item / MAX_COLS, item % MAX_COLS);
     }
-
-    // calculates sizeHint
-    layout.activate();
 }
 
 void EmoticonsWidget::onSmileyClicked()
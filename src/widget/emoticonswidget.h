@@ -19,8 +19,10 @@
 
 #pragma once
 
+#include <QList>
 #include <QMenu>
 #include <QStackedWidget>
+#include <QStringList>
 #include <QVBoxLayout>
 #include <QVector>
 
@@ -45,6 +47,7 @@ private slots:
     void onSmileyClicked();
     void onPageButtonClicked();
     void PageButtonsUpdate();
+    void buildVisiblePages();
 
 protected:
     void mouseReleaseEvent(QMouseEvent* ev) final;
@@ -53,9 +56,19 @@ protected:
     void keyPressEvent(QKeyEvent* e) final;
 
 private:
+    void buildPage(int page);
+
+private:
+    static constexpr int MAX_COLS = 8;
+    static constexpr int MAX_ROWS = 8;
+    static constexpr int ITEMS_PER_PAGE = MAX_ROWS * MAX_COLS;
+
+    SmileyPack& smileyPack;
+    QList<QStringList> emoticons;
+    QSize emoticonSize;
+    QVector<bool> pagesBuilt;
     QStackedWidget stack;
     QVBoxLayout layout;
-    QList<std::shared_ptr<QIcon>> emoticonsIcons;
 
 public:
     QSize sizeHint() const override;
@@ -72,7 +72,6 @@
 namespace {
 constexpr int CHAT_WIDGET_MIN_HEIGHT = 50;
 constexpr int SCREENSHOT_GRABBER_OPENING_DELAY = 500;
-constexpr int TYPING_NOTIFICATION_DURATION = 3000;
 } // namespace
 
 const QString ChatForm::ACTION_PREFIX = QStringLiteral("/me ");
@@ -114,10 +113,9 @@ ChatForm::ChatForm(Profile& profile_, Friend* chatFriend, IChatLog& chatLog_,
     GroupList& groupList_)
     : GenericChatForm(profile_.getCore(), chatFriend, chatLog_, messageDispatcher_,
         documentCache_, smileyPack_, settings_, style_, messageBoxManager, friendList_,
-        groupList_)
+        groupList_, *profile_.getBlobStore())
     , core{profile_.getCore()}
     , f(chatFriend)
-    , isTyping{false}
     , lastCallIsVideo{false}
     , cameraSource{cameraSource_}
     , settings{settings_}
@@ -136,8 +134,6 @@ ChatForm::ChatForm(Profile& profile_, Friend* chatFriend, IChatLog& chatLog_,
     statusMessageLabel->setTextFormat(Qt::PlainText);
     statusMessageLabel->setContextMenuPolicy(Qt::CustomContextMenu);
 
-    typingTimer.setSingleShot(true);
-
     callDurationTimer = nullptr;
 
     chatWidget->setMinimumHeight(CHAT_WIDGET_MIN_HEIGHT);
@@ -171,7 +167,6 @@ ChatForm::ChatForm(Profile& profile_, Friend* chatFriend, IChatLog& chatLog_,
     connect(&profile, &Profile::friendAvatarChanged, this, &ChatForm::onAvatarChanged);
     connect(coreFile, &CoreFile::fileReceiveRequested, this, &ChatForm::updateFriendActivityForFile);
     connect(coreFile, &CoreFile::fileSendStarted, this, &ChatForm::updateFriendActivityForFile);
-    connect(&core, &Core::friendTypingChanged, this, &ChatForm::onFriendTypingChanged);
     connect(coreFile, &CoreFile::fileNameChanged, this, &ChatForm::onFileNameChanged);
 
     connect(chatFriend, &Friend::statusChanged, this, &ChatForm::onFriendStatusChanged);
@@ -200,9 +195,11 @@ ChatForm::ChatForm(Profile& profile_, Friend* chatFriend, IChatLog& chatLog_,
                 }
             });
 
-    connect(&typingTimer, &QTimer::timeout, this, [&] {
-        core.sendTyping(f->getId(), false);
-        isTyping = false;
+    typingNotifier.setFriendOnline(Status::isOnline(f->getStatus()));
+    // queued to the core thread, typing doesn't wait for coreLoopLock
+    connect(&typingNotifier, &TypingNotifier::typingChanged, this, [this](bool typing) {
+        QMetaObject::invokeMethod(&core, "sendTyping", Qt::QueuedConnection,
+                                  Q_ARG(uint32_t, f->getId()), Q_ARG(bool, typing));
     });
 
     // reflect name changes in the header
@@ -220,7 +217,7 @@ ChatForm::ChatForm(Profile& profile_, Friend* chatFriend, IChatLog& chatLog_,
 
     setAcceptDrops(true);
     retranslateUi();
-    Translator::registerHandler(std::bind(&ChatForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ChatForm::retranslateUi, this), this, this);
 }
 
 ChatForm::~ChatForm()
@@ -267,22 +264,11 @@ void ChatForm::onExtensionSupportChanged(ExtensionSet extensions)
 void ChatForm::onTextEditChanged()
 {
     if (!settings.getTypingNotification()) {
-        if (isTyping) {
-            isTyping = false;
-            core.sendTyping(f->getId(), false);
-        }
-
+        typingNotifier.setComposing(false);
         return;
     }
-    bool isTypingNow = !msgEdit->toPlainText().isEmpty();
-    if (isTyping != isTypingNow) {
-        core.sendTyping(f->getId(), isTypingNow);
-        if (isTypingNow) {
-            typingTimer.start(TYPING_NOTIFICATION_DURATION);
-        }
 
-        isTyping = isTypingNow;
-    }
+    typingNotifier.setComposing(!msgEdit->toPlainText().isEmpty());
 }
 
 void ChatForm::onAttachClicked()
@@ -471,6 +457,7 @@ void ChatForm::onFriendStatusChanged(const ToxPk& friendPk, Status::Status statu
     assert(friendPk == f->getPublicKey());
     std::ignore = friendPk;
 
+    typingNotifier.setFriendOnline(Status::isOnline(f->getStatus()));
     if (!Status::isOnline(f->getStatus())) {
         // Hide the "is typing" message when a friend goes offline
         setFriendTyping(false);
@@ -485,13 +472,6 @@ void ChatForm::onFriendStatusChanged(const ToxPk& friendPk, Status::Status statu
     }
 }
 
-void ChatForm::onFriendTypingChanged(quint32 friendId, bool isTyping_)
-{
-    if (friendId == f->getId()) {
-        setFriendTyping(isTyping_);
-    }
-}
-
 void ChatForm::onFriendNameChanged(const QString& name)
 {
     if (sender() == f) {
@@ -524,6 +504,7 @@ std::unique_ptr<NetCamView> ChatForm::createNetcam()
     CoreAV* av = core.getAv();
     VideoSource* source = av->getVideoSourceFromCall(friendId);
     view->show(source, f->getDisplayedName());
+    view->setCallStatsSource(av, friendId);
     connect(view.get(), &NetCamView::videoCallEnd, this, &ChatForm::onVideoCallTriggered);
     connect(view.get(), &NetCamView::volMuteToggle, this, &ChatForm::onVolMuteToggle);
     connect(view.get(), &NetCamView::micMuteToggle, this, &ChatForm::onMicMuteToggle);
@@ -717,6 +698,12 @@ void ChatForm::onUpdateTime()
 
 void ChatForm::setFriendTyping(bool isTyping_)
 {
+    // each change relayouts the chat, repeated states are common
+    if (isTyping_ == friendTyping) {
+        return;
+    }
+
+    friendTyping = isTyping_;
     chatWidget->setTypingNotificationVisible(isTyping_);
     QString name = f->getDisplayedName();
     chatWidget->setTypingNotificationName(name);
@@ -730,11 +717,29 @@ void ChatForm::show(ContentLayout* contentLayout_)
 void ChatForm::reloadTheme()
 {
     GenericChatForm::reloadTheme();
+    // the chat widget recreated its hidden typing notification
+    if (friendTyping) {
+        friendTyping = false;
+        setFriendTyping(true);
+    }
 }
 
 void ChatForm::showEvent(QShowEvent* event)
 {
     GenericChatForm::showEvent(event);
+    if (avatarRequested) {
+        return;
+    }
+
+    // Loaded only now, most chat forms are never opened
+    avatarRequested = true;
+    const ToxPk friendPk = f->getPublicKey();
+    profile.loadAvatarAsync(friendPk, headWidget->getAvatarSize(), this,
+                            [this, friendPk](const QPixmap& pic) {
+                                if (!pic.isNull()) {
+                                    onAvatarChanged(friendPk, pic);
+                                }
+                            });
 }
 
 void ChatForm::hideEvent(QHideEvent* event)
@@ -29,6 +29,7 @@
 #include "src/model/ichatlog.h"
 #include "src/model/imessagedispatcher.h"
 #include "src/model/status.h"
+#include "src/model/typingnotifier.h"
 #include "src/persistence/history.h"
 #include "src/widget/tool/screenshotgrabber.h"
 #include "src/video/netcamview.h"
@@ -105,7 +106,6 @@ private slots:
     void onVolMuteToggle();
 
     void onFriendStatusChanged(const ToxPk& friendPk, Status::Status status);
-    void onFriendTypingChanged(quint32 friendId, bool isTyping_);
     void onFriendNameChanged(const QString& name);
     void onStatusMessage(const QString& message);
     void onUpdateTime();
@@ -142,13 +142,14 @@ private:
     QMenu statusMessageMenu;
     QLabel* callDuration;
     QTimer* callDurationTimer;
-    QTimer typingTimer;
+    TypingNotifier typingNotifier;
     QElapsedTimer timeElapsed;
     QAction* copyStatusAction;
     QPixmap imagePreviewSource;
     ImagePreviewButton* imagePreview;
-    bool isTyping;
+    bool friendTyping = false;
     bool lastCallIsVideo;
+    bool avatarRequested = false;
     std::unique_ptr<NetCamView> netcam;
     CameraSource& cameraSource;
     Settings& settings;
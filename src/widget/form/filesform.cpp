@@ -35,6 +35,7 @@
 #include <QPushButton>
 #include <QPainter>
 #include <QMouseEvent>
+#include <algorithm>
 #include <cmath>
 
 namespace {
@@ -171,10 +172,25 @@ namespace FileTransferList
         return static_cast<EditorAction>(in);
     }
 
+    /**
+     * @class Model
+     * @brief Table of the file transfers in one direction.
+     *
+     * Updates are stored right away, but the dataChanged signals for them are collected and
+     * emitted as one range after UPDATE_INTERVAL_MS, so many transfers making progress at once
+     * repaint the view once per frame instead of once per chunk.
+     */
+
+    constexpr int Model::UPDATE_INTERVAL_MS;
+
     Model::Model(FriendList& friendList_, QObject* parent)
         : QAbstractTableModel(parent)
         , friendList{friendList_}
-    {}
+    {
+        updateTimer.setSingleShot(true);
+        updateTimer.setInterval(UPDATE_INTERVAL_MS);
+        connect(&updateTimer, &QTimer::timeout, this, &Model::flushUpdates);
+    }
 
     QVariant Model::headerData(int section, Qt::Orientation orientation, int role) const
     {
@@ -219,6 +235,8 @@ namespace FileTransferList
             rowIdx = idxIt.value();
             files[rowIdx] = file;
             if (fileTransferFailed(file.status)) {
+                // pending rows would shift under the view
+                flushUpdates();
                 emit rowsAboutToBeRemoved(QModelIndex(), rowIdx, rowIdx, {});
 
                 for (auto it = idToRow.begin(); it != idToRow.end(); ++it) {
@@ -232,12 +250,44 @@ namespace FileTransferList
                 emit rowsRemoved(QModelIndex(), rowIdx, rowIdx, {});
             }
             else {
-                emit dataChanged(index(rowIdx, 0), index(rowIdx, columnCount()));
+                markChanged(rowIdx);
             }
         }
 
     }
 
+    /**
+     * @brief Emits the collected dataChanged range now instead of waiting for the timer.
+     */
+    void Model::flushUpdates()
+    {
+        updateTimer.stop();
+        if (firstChangedRow < 0) {
+            return;
+        }
+
+        const int first = firstChangedRow;
+        const int last = lastChangedRow;
+        firstChangedRow = -1;
+        lastChangedRow = -1;
+        emit dataChanged(index(first, 0), index(last, columnCount() - 1));
+    }
+
+    void Model::markChanged(int row)
+    {
+        if (firstChangedRow < 0) {
+            firstChangedRow = row;
+            lastChangedRow = row;
+        } else {
+            firstChangedRow = std::min(firstChangedRow, row);
+            lastChangedRow = std::max(lastChangedRow, row);
+        }
+
+        if (!updateTimer.isActive()) {
+            updateTimer.start();
+        }
+    }
+
     int Model::rowCount(const QModelIndex& parent) const
     {
         std::ignore = parent;
@@ -474,7 +524,7 @@ FilesForm::FilesForm(CoreFile& coreFile, Settings& settings, Style& style,
     connect(recvd, &QTableView::activated, this, &FilesForm::onReceivedFileActivated);
 
     retranslateUi();
-    Translator::registerHandler(std::bind(&FilesForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&FilesForm::retranslateUi, this), this, &main);
 }
 
 FilesForm::~FilesForm()
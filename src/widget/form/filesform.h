@@ -31,6 +31,7 @@
 #include <QAbstractTableModel>
 #include <QStyledItemDelegate>
 #include <QTableView>
+#include <QTimer>
 
 class ContentLayout;
 class QTableView;
@@ -81,14 +82,25 @@ namespace FileTransferList
         QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
         bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
 
+        void flushUpdates();
+
+        // roughly one frame, progress of all transfers is repainted at most this often
+        static constexpr int UPDATE_INTERVAL_MS = 16;
+
     signals:
         void togglePause(ToxFile file);
         void cancel(ToxFile file);
 
+    private:
+        void markChanged(int row);
+
     private:
         QHash<QByteArray /*file id*/, int /*row index*/> idToRow;
         std::vector<ToxFile> files;
         FriendList& friendList;
+        QTimer updateTimer;
+        int firstChangedRow = -1;
+        int lastChangedRow = -1;
     };
 
     class Delegate : public QStyledItemDelegate
@@ -54,6 +54,8 @@
 #include <QtGlobal>
 
 #ifdef SPELL_CHECKING
+#include "src/widget/tool/spellcheckhighlighter.h"
+
 #include <KF5/SonnetUi/sonnet/spellcheckdecorator.h>
 #endif
 
@@ -140,7 +142,7 @@ GenericChatForm::GenericChatForm(const Core& core_, const Chat* chat, IChatLog&
                                  IMessageDispatcher& messageDispatcher_, DocumentCache& documentCache,
                                  SmileyPack& smileyPack_, Settings& settings_, Style& style_,
                                  IMessageBoxManager& messageBoxManager, FriendList& friendList_,
-                                 GroupList& groupList_, QWidget* parent_)
+                                 GroupList& groupList_, BlobStore& blobStore, QWidget* parent_)
     : QWidget(parent_, Qt::Window)
     , core{core_}
     , audioInputFlag(false)
@@ -158,7 +160,7 @@ GenericChatForm::GenericChatForm(const Core& core_, const Chat* chat, IChatLog&
     searchForm = new SearchForm(settings, style);
     dateInfo = new QLabel(this);
     chatWidget = new ChatWidget(chatLog_, core, documentCache, smileyPack,
-        settings, style, messageBoxManager, this);
+        settings, style, messageBoxManager, blobStore, this);
     searchForm->hide();
     dateInfo->setAlignment(Qt::AlignHCenter);
     dateInfo->setVisible(false);
@@ -171,6 +173,9 @@ GenericChatForm::GenericChatForm(const Core& core_, const Chat* chat, IChatLog&
 #ifdef SPELL_CHECKING
     if (settings.getSpellCheckingEnabled()) {
         decorator = new Sonnet::SpellCheckDecorator(msgEdit);
+        // the default highlighter checks every word of a changed paragraph on the GUI thread
+        delete decorator->highlighter();
+        decorator->setHighlighter(new SpellCheckHighlighter(msgEdit));
     }
 #endif
 
@@ -275,7 +280,7 @@ GenericChatForm::GenericChatForm(const Core& core_, const Chat* chat, IChatLog&
     fileFlyout->installEventFilter(this);
 
     retranslateUi();
-    Translator::registerHandler(std::bind(&GenericChatForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&GenericChatForm::retranslateUi, this), this, this);
 
     // update header on name/title change
     connect(chat, &Chat::displayedNameChanged, this, &GenericChatForm::setName);
@@ -374,19 +379,7 @@ void GenericChatForm::setName(const QString& newName)
 
 void GenericChatForm::show(ContentLayout* contentLayout_)
 {
-    contentLayout_->mainHead->layout()->addWidget(headWidget);
-    headWidget->show();
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 12, 4) && QT_VERSION > QT_VERSION_CHECK(5, 11, 0)
-    // HACK: switching order happens to avoid a Qt bug causing segfault, present between these versions.
-    // this could cause flickering if our form is shown before added to the layout
-    // https://github.com/qTox/qTox/issues/5570
-    QWidget::show();
-    contentLayout->mainContent->layout()->addWidget(this);
-#else
-    contentLayout_->mainContent->layout()->addWidget(this);
-    QWidget::show();
-#endif
+    contentLayout_->showCachedForm(headWidget, this);
 }
 
 void GenericChatForm::showEvent(QShowEvent* event)
@@ -398,6 +391,11 @@ void GenericChatForm::showEvent(QShowEvent* event)
 
 bool GenericChatForm::event(QEvent* e)
 {
+    // Evicted from the form cache of a ContentLayout, nobody sees the old lines anymore
+    if (e->type() == QEvent::ParentChange && parentWidget() == nullptr) {
+        chatWidget->trimLines();
+    }
+
     // If the user accidentally starts typing outside of the msgEdit, focus it automatically
     if (e->type() == QEvent::KeyPress) {
         QKeyEvent* ke = static_cast<QKeyEvent*>(e);
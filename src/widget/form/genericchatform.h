@@ -58,6 +58,7 @@ class SmileyPack;
 class Settings;
 class Style;
 class IMessageBoxManager;
+class BlobStore;
 class FriendList;
 
 namespace Ui {
@@ -78,7 +79,7 @@ public:
                     IMessageDispatcher& messageDispatcher_, DocumentCache& documentCache,
                     SmileyPack& smileyPack, Settings& settings, Style& style,
                     IMessageBoxManager& messageBoxmanager, FriendList& friendList,
-                    GroupList& groupList, QWidget* parent_ = nullptr);
+                    GroupList& groupList, BlobStore& blobStore, QWidget* parent_ = nullptr);
     ~GenericChatForm() override;
 
     void setName(const QString& newName);
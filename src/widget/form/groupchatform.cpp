@@ -79,17 +79,30 @@ QString editName(const QString& name)
  * @var QList<QLabel*> GroupChatForm::peerLabels
  * @brief Maps peernumbers to the QLabels in namesListLayout.
  *
- * @var QMap<int, QTimer*> GroupChatForm::peerAudioTimers
- * @brief Timeout = peer stopped sending audio.
+ * @var QMap<ToxPk, qint64> GroupChatForm::peerSpeakingUntil
+ * @brief Peers shown as speaking, with the time on speakingClock their label falls back.
+ *
+ * @var GroupChatForm::SPEAKING_POLL_INTERVAL_MS
+ * @brief Interval in which peer audio levels are polled from CoreAV while the form is visible.
+ *
+ * @var GroupChatForm::SPEAKING_HOLD_MS
+ * @brief Time a peer stays marked as speaking after their audio dropped below the threshold.
+ *
+ * @var GroupChatForm::SPEAKING_THRESHOLD
+ * @brief Volume a peer's audio needs to reach to mark them as speaking.
  */
 
+constexpr int GroupChatForm::SPEAKING_POLL_INTERVAL_MS;
+constexpr qint64 GroupChatForm::SPEAKING_HOLD_MS;
+constexpr float GroupChatForm::SPEAKING_THRESHOLD;
+
 GroupChatForm::GroupChatForm(Core& core_, Group* chatGroup, IChatLog& chatLog_,
     IMessageDispatcher& messageDispatcher_, Settings& settings_, DocumentCache& documentCache_,
         SmileyPack& smileyPack_, Style& style_, IMessageBoxManager& messageBoxManager,
-        FriendList& friendList_, GroupList& groupList_)
+        FriendList& friendList_, GroupList& groupList_, BlobStore& blobStore)
     : GenericChatForm(core_, chatGroup, chatLog_, messageDispatcher_,
         documentCache_, smileyPack_, settings_, style_, messageBoxManager, friendList_,
-        groupList_)
+        groupList_, blobStore)
     , core{core_}
     , group(chatGroup)
     , inCall(false)
@@ -139,6 +152,9 @@ GroupChatForm::GroupChatForm(Core& core_, Group* chatGroup, IChatLog& chatLog_,
     connect(group, &Group::userLeft, this, &GroupChatForm::onUserLeft);
     connect(group, &Group::peerNameChanged, this, &GroupChatForm::onPeerNameChanged);
     connect(group, &Group::numPeersChanged, this, &GroupChatForm::updateUserCount);
+    speakingTimer.setInterval(SPEAKING_POLL_INTERVAL_MS);
+    connect(&speakingTimer, &QTimer::timeout, this, &GroupChatForm::updateSpeakingPeers);
+    speakingClock.start();
     settings.connectTo_blackListChanged(this, [this](QStringList const&) { updateUserNames(); });
 
     if (settings.getShowGroupJoinLeaveMessages()) {
@@ -147,7 +163,7 @@ GroupChatForm::GroupChatForm(Core& core_, Group* chatGroup, IChatLog& chatLog_,
 
     updateUserNames();
     setAcceptDrops(true);
-    Translator::registerHandler(std::bind(&GroupChatForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&GroupChatForm::retranslateUi, this), this, this);
 }
 
 GroupChatForm::~GroupChatForm()
@@ -222,6 +238,10 @@ void GroupChatForm::updateUserNames()
             label->setProperty("peerType", LABEL_PEER_TYPE_MUTED);
         }
 
+        if (peerSpeakingUntil.contains(peerPk)) {
+            label->setProperty("playingAudio", LABEL_PEER_PLAYING_AUDIO);
+        }
+
         label->setStyleSheet(style.getStylesheet(PEER_LABEL_STYLE_SHEET_PATH, settings));
         peerLabels.insert(peerPk, label);
     }
@@ -270,29 +290,69 @@ void GroupChatForm::onPeerNameChanged(const ToxPk& peer, const QString& oldName,
     updateUserNames();
 }
 
-void GroupChatForm::peerAudioPlaying(ToxPk peerPk)
+/**
+ * @brief Marks peers whose audio got loud enough since the last poll as speaking.
+ *
+ * Levels are measured where the audio is decoded and only read here, so a busy group call
+ * doesn't send a signal per peer and frame to the GUI thread.
+ */
+void GroupChatForm::updateSpeakingPeers()
 {
-    peerLabels[peerPk]->setProperty("playingAudio", LABEL_PEER_PLAYING_AUDIO);
-    peerLabels[peerPk]->style()->unpolish(peerLabels[peerPk]);
-    peerLabels[peerPk]->style()->polish(peerLabels[peerPk]);
-    // TODO(sudden6): check if this can ever be false, cause [] default constructs
-    if (!peerAudioTimers[peerPk]) {
-        peerAudioTimers[peerPk] = new QTimer(this);
-        peerAudioTimers[peerPk]->setSingleShot(true);
-        connect(peerAudioTimers[peerPk], &QTimer::timeout, [this, peerPk] {
-            auto it = peerLabels.find(peerPk);
-            if (it != peerLabels.end()) {
-                peerLabels[peerPk]->setProperty("playingAudio", LABEL_PEER_NOT_PLAYING_AUDIO);
-                peerLabels[peerPk]->style()->unpolish(peerLabels[peerPk]);
-                peerLabels[peerPk]->style()->polish(peerLabels[peerPk]);
-            }
-            delete peerAudioTimers[peerPk];
-            peerAudioTimers[peerPk] = nullptr;
-        });
+    const qint64 now = speakingClock.elapsed();
+    const auto levels = core.getAv()->takeGroupPeerLevels(group->getId());
+    for (const auto& level : levels) {
+        if (level.second.volume() < SPEAKING_THRESHOLD) {
+            continue;
+        }
+
+        const bool wasSpeaking = peerSpeakingUntil.contains(level.first);
+        peerSpeakingUntil[level.first] = now + SPEAKING_HOLD_MS;
+        if (!wasSpeaking) {
+            setPeerSpeaking(level.first, true);
+        }
     }
 
-    peerLabels[peerPk]->setStyleSheet(style.getStylesheet(PEER_LABEL_STYLE_SHEET_PATH, settings));
-    peerAudioTimers[peerPk]->start(500);
+    auto it = peerSpeakingUntil.begin();
+    while (it != peerSpeakingUntil.end()) {
+        if (it.value() > now) {
+            ++it;
+            continue;
+        }
+
+        setPeerSpeaking(it.key(), false);
+        it = peerSpeakingUntil.erase(it);
+    }
+}
+
+void GroupChatForm::setPeerSpeaking(const ToxPk& peerPk, bool speaking)
+{
+    auto it = peerLabels.find(peerPk);
+    if (it == peerLabels.end()) {
+        return;
+    }
+
+    QLabel* const label = it.value();
+    label->setProperty("playingAudio",
+                       speaking ? LABEL_PEER_PLAYING_AUDIO : LABEL_PEER_NOT_PLAYING_AUDIO);
+    label->style()->unpolish(label);
+    label->style()->polish(label);
+}
+
+void GroupChatForm::showEvent(QShowEvent* event)
+{
+    if (group->isAvGroupchat()) {
+        // drop the levels from while we were hidden
+        std::ignore = core.getAv()->takeGroupPeerLevels(group->getId());
+        speakingTimer.start();
+    }
+
+    GenericChatForm::showEvent(event);
+}
+
+void GroupChatForm::hideEvent(QHideEvent* event)
+{
+    speakingTimer.stop();
+    GenericChatForm::hideEvent(event);
 }
 
 void GroupChatForm::dragEnterEvent(QDragEnterEvent* ev)
@@ -22,7 +22,9 @@
 #include "genericchatform.h"
 #include "src/core/toxpk.h"
 #include "src/persistence/igroupsettings.h"
+#include <QElapsedTimer>
 #include <QMap>
+#include <QTimer>
 
 namespace Ui {
 class MainWindow;
@@ -30,8 +32,8 @@ class MainWindow;
 class Group;
 class TabCompleter;
 class FlowLayout;
-class QTimer;
 class GroupId;
+class BlobStore;
 class IMessageDispatcher;
 struct Message;
 class Settings;
@@ -50,11 +52,9 @@ public:
         IMessageDispatcher& messageDispatcher_, Settings& settings_,
         DocumentCache& documentCache, SmileyPack& smileyPack, Style& style,
             IMessageBoxManager& messageBoxManager, FriendList& friendList,
-            GroupList& groupList);
+            GroupList& groupList, BlobStore& blobStore);
     ~GroupChatForm();
 
-    void peerAudioPlaying(ToxPk peerPk);
-
 private slots:
     void onScreenshotClicked() override;
     void onAttachClicked() override;
@@ -66,6 +66,7 @@ private slots:
     void onPeerNameChanged(const ToxPk& peer, const QString& oldName, const QString& newName);
     void onTitleChanged(const QString& author, const QString& title);
     void onLabelContextMenuRequested(const QPoint& localPos);
+    void updateSpeakingPeers();
 
 protected:
     void keyPressEvent(QKeyEvent* ev) final;
@@ -73,6 +74,8 @@ protected:
     // drag & drop
     void dragEnterEvent(QDragEnterEvent* ev) final;
     void dropEvent(QDropEvent* ev) final;
+    void hideEvent(QHideEvent* event) final;
+    void showEvent(QShowEvent* event) final;
 
 private:
     void retranslateUi();
@@ -80,12 +83,20 @@ private:
     void updateUserNames();
     void joinGroupCall();
     void leaveGroupCall();
+    void setPeerSpeaking(const ToxPk& peerPk, bool speaking);
+
+private:
+    static constexpr int SPEAKING_POLL_INTERVAL_MS = 100;
+    static constexpr qint64 SPEAKING_HOLD_MS = 500;
+    static constexpr float SPEAKING_THRESHOLD = 0.02f;
 
 private:
     Core& core;
     Group* group;
     QMap<ToxPk, QLabel*> peerLabels;
-    QMap<ToxPk, QTimer*> peerAudioTimers;
+    QMap<ToxPk, qint64> peerSpeakingUntil;
+    QTimer speakingTimer;
+    QElapsedTimer speakingClock;
     FlowLayout* namesListLayout;
     QLabel* nusersLabel;
     TabCompleter* tabber;
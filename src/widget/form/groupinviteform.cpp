@@ -78,7 +78,7 @@ GroupInviteForm::GroupInviteForm(Settings& settings_, Core& core_)
     headLayout->addWidget(headLabel);
 
     retranslateUi();
-    Translator::registerHandler(std::bind(&GroupInviteForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&GroupInviteForm::retranslateUi, this), this, this);
 }
 
 GroupInviteForm::~GroupInviteForm()
@@ -183,8 +183,13 @@ ProfileForm::ProfileForm(IProfileInfo* profileInfo_, Settings& settings_,
         cb->setFocusPolicy(Qt::StrongFocus);
     }
 
+    // the form may be created long after the core announced these
+    setToxId(profileInfo_->getToxId());
+    bodyUI->userName->setText(profileInfo_->getUsername());
+    bodyUI->statusMessage->setText(profileInfo_->getStatusMessage());
+
     retranslateUi();
-    Translator::registerHandler(std::bind(&ProfileForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ProfileForm::retranslateUi, this), this, this);
 }
 
 void ProfileForm::prFileLabelUpdate()
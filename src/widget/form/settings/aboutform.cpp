@@ -95,7 +95,7 @@ AboutForm::AboutForm(UpdateCheck* updateCheck_, Style& style_)
         bodyUI->gitVersion->setOpenExternalLinks(false);
 
     eventsInit();
-    Translator::registerHandler(std::bind(&AboutForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&AboutForm::retranslateUi, this), this, this);
 }
 
 /**
@@ -26,15 +26,23 @@
 #include <QClipboard>
 #include <QDir>
 #include <QFileDialog>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMessageBox>
 #include <QProcess>
+#include <QSaveFile>
+#include <QSysInfo>
 
+#include "src/core/connectionpathstats.h"
+#include "src/core/loopstats.h"
 #include "src/model/status.h"
 #include "src/persistence/profile.h"
 #include "src/persistence/settings.h"
 #include "src/widget/tool/recursivesignalblocker.h"
 #include "src/widget/tool/imessageboxmanager.h"
 #include "src/widget/translator.h"
+#include "util/cacheregistry.h"
+#include "util/diagnosticsregistry.h"
 
 /**
  * @class AdvancedForm
@@ -43,6 +51,26 @@
  * Is also contains "Reset settings" button and "Make portable" checkbox.
  */
 
+namespace {
+/**
+ * @brief Diagnostics report with the versions we'd otherwise ask for in the bug report.
+ */
+QByteArray diagnosticsReport()
+{
+    QJsonObject report = DiagnosticsRegistry::getInstance().collect();
+    report["qtoxVersion"] = QString(GIT_DESCRIBE);
+    report["qtoxCommit"] = QString(GIT_VERSION);
+    report["toxcoreVersion"] = QStringLiteral("%1.%2.%3")
+                                   .arg(tox_version_major())
+                                   .arg(tox_version_minor())
+                                   .arg(tox_version_patch());
+    report["qtVersion"] = QString::fromLatin1(qVersion());
+    report["os"] = QSysInfo::prettyProductName();
+    report["cpuArchitecture"] = QSysInfo::currentCpuArchitecture();
+    return QJsonDocument(report).toJson(QJsonDocument::Indented);
+}
+} // namespace
+
 AdvancedForm::AdvancedForm(Settings& settings_, Style& style, IMessageBoxManager& messageBoxManager_)
     : GenericForm(QPixmap(":/img/settings/general.png"), style)
     , bodyUI(new Ui::AdvancedSettings)
@@ -70,6 +98,11 @@ AdvancedForm::AdvancedForm(Settings& settings_, Style& style, IMessageBoxManager
     bodyUI->cbEnableLanDiscovery->setChecked(settings.getEnableLanDiscovery() && udpEnabled);
     bodyUI->cbEnableLanDiscovery->setEnabled(udpEnabled);
 
+    const bool lowMemory = settings.getLowMemoryMode();
+    bodyUI->cbLowMemory->setChecked(lowMemory);
+    bodyUI->cacheBudget->setValue(settings.getCacheBudgetMb());
+    bodyUI->cacheBudget->setEnabled(!lowMemory);
+
     QString warningBody = tr("Unless you %1 know what you are doing, "
                              "please do %2 change anything here. Changes "
                              "made here may lead to problems with qTox, and even "
@@ -87,7 +120,7 @@ AdvancedForm::AdvancedForm(Settings& settings_, Style& style, IMessageBoxManager
     bodyUI->warningLabel->setText(warning);
 
     eventsInit();
-    Translator::registerHandler(std::bind(&AdvancedForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&AdvancedForm::retranslateUi, this), this, this);
 }
 
 AdvancedForm::~AdvancedForm()
@@ -147,6 +180,47 @@ void AdvancedForm::on_btnShownetcon_clicked()
     }
 }
 
+void AdvancedForm::on_btnShowLoopTiming_clicked()
+{
+    const QString report = LoopStats::report();
+    bodyUI->textShownetcon->setText(report.isEmpty() ? tr("No main loop running") : report);
+}
+
+void AdvancedForm::on_btnShowCacheUsage_clicked()
+{
+    bodyUI->textShownetcon->setText(CacheRegistry::getInstance().report());
+}
+
+void AdvancedForm::on_btnShowFriendPaths_clicked()
+{
+    const QString report = ConnectionPathStats::report();
+    bodyUI->textShownetcon->setText(report.isEmpty() ? tr("Not connected to Tox") : report);
+}
+
+void AdvancedForm::on_btnShowDiagnostics_clicked()
+{
+    bodyUI->textShownetcon->setText(QString::fromUtf8(diagnosticsReport()));
+}
+
+void AdvancedForm::on_btnExportDiagnostics_clicked()
+{
+    const QString savefile = QFileDialog::getSaveFileName(
+        Q_NULLPTR, tr("Save file"), QStringLiteral("qtox-diagnostics.json"), tr("JSON (*.json)"));
+    if (savefile.isEmpty()) {
+        qDebug() << "Diagnostics save file was not properly chosen";
+        return;
+    }
+
+    const QByteArray report = diagnosticsReport();
+    QSaveFile file{savefile};
+    if (!file.open(QIODevice::WriteOnly) || file.write(report) != report.size() || !file.commit()) {
+        qWarning() << "Failed to write diagnostics to" << savefile;
+        return;
+    }
+
+    qDebug() << "Wrote diagnostics to" << savefile;
+}
+
 void AdvancedForm::on_btnCopyDebug_clicked()
 {
     QString logFileDir = settings.getPaths().getAppCacheDirPath();
@@ -237,6 +311,18 @@ void AdvancedForm::on_proxyType_currentIndexChanged(int index)
     settings.setProxyType(proxytype);
 }
 
+void AdvancedForm::on_cbLowMemory_stateChanged()
+{
+    const bool lowMemory = bodyUI->cbLowMemory->isChecked();
+    bodyUI->cacheBudget->setEnabled(!lowMemory);
+    settings.setLowMemoryMode(lowMemory);
+}
+
+void AdvancedForm::on_cacheBudget_editingFinished()
+{
+    settings.setCacheBudgetMb(bodyUI->cacheBudget->value());
+}
+
 /**
  * @brief Retranslate all elements in the form.
  */
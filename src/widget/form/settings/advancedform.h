@@ -48,7 +48,12 @@ private slots:
     // Debug
     void on_btnCopyDebug_clicked();
     void on_btnShownetcon_clicked();
+    void on_btnShowLoopTiming_clicked();
+    void on_btnShowCacheUsage_clicked();
+    void on_btnShowFriendPaths_clicked();
+    void on_btnShowDiagnostics_clicked();
     void on_btnExportLog_clicked();
+    void on_btnExportDiagnostics_clicked();
     // Connection
     void on_cbEnableIPv6_stateChanged();
     void on_cbEnableUDP_stateChanged();
@@ -56,6 +61,9 @@ private slots:
     void on_proxyAddr_editingFinished();
     void on_proxyPort_valueChanged(int port);
     void on_proxyType_currentIndexChanged(int index);
+    // Memory
+    void on_cbLowMemory_stateChanged();
+    void on_cacheBudget_editingFinished();
 
 private:
     void retranslateUi();
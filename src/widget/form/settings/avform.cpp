@@ -28,8 +28,10 @@
 #include <QShowEvent>
 
 #include "audio/audio.h"
+#include "audio/iaudiocontrol.h"
 #include "audio/iaudiosettings.h"
 #include "audio/iaudiosource.h"
+#include "src/core/callencoderprofile.h"
 #include "src/core/core.h"
 #include "src/core/coreav.h"
 #include "src/video/cameradevice.h"
@@ -44,6 +46,13 @@
 #define ALC_ALL_DEVICES_SPECIFIER ALC_DEVICE_SPECIFIER
 #endif
 
+/**
+ * @var AVForm::VOLUME_POLL_INTERVAL_MS
+ * @brief Interval of the input level display, about 30 Hz
+ */
+
+constexpr int AVForm::VOLUME_POLL_INTERVAL_MS;
+
 AVForm::AVForm(IAudioControl& audio_, CoreAV* coreAV_, CameraSource& camera_,
                IAudioSettings* audioSettings_, IVideoSettings* videoSettings_,
                Style& style)
@@ -52,6 +61,7 @@ AVForm::AVForm(IAudioControl& audio_, CoreAV* coreAV_, CameraSource& camera_,
     , coreAV{coreAV_}
     , audioSettings{audioSettings_}
     , videoSettings{videoSettings_}
+    , modeCache{*videoSettings_}
     , camVideoSurface(nullptr)
     , camera(camera_)
 {
@@ -67,8 +77,22 @@ AVForm::AVForm(IAudioControl& audio_, CoreAV* coreAV_, CameraSource& camera_,
     echoLatency->setValue(audioSettings_->getEchoLatency());
     aecechomode->setValue(audioSettings_->getAecechomode());
     aecechonsmode->setValue(audioSettings_->getAecechonsmode());
+    cbFullAudioProcessing->setChecked(audioSettings_->getFullAudioProcessing());
+    cbTransientSuppression->setChecked(audioSettings_->getAudioTransientSuppression());
+
+    cbHwVideoDecode->setChecked(videoSettings_->getCamVideoHwDecode());
+    cbScreenFollowWindow->setChecked(videoSettings_->getScreenFollowWindow());
+    cbCamWarmStandby->setChecked(videoSettings_->getCamWarmStandby());
 
     connect(rescanButton, &QPushButton::clicked, this, &AVForm::rescanDevices);
+    connect(&modeCache, &CameraModeCache::devicesChanged, this, &AVForm::rescanDevices);
+
+    latencyTimer.setInterval(1000);
+    connect(&latencyTimer, &QTimer::timeout, this, &AVForm::updateAudioLatency);
+
+    // the capture thread only publishes levels, we pull them at display rate while visible
+    volumeTimer.setInterval(VOLUME_POLL_INTERVAL_MS);
+    connect(&volumeTimer, &QTimer::timeout, this, &AVForm::updateVolume);
 
     playbackSlider->setTracking(false);
     playbackSlider->setMaximum(totalSliderSteps);
@@ -100,11 +124,15 @@ AVForm::AVForm(IAudioControl& audio_, CoreAV* coreAV_, CameraSource& camera_,
                                                      audio_.maxInputThreshold()));
     audioThresholdSlider->setTracking(false);
     audioThresholdSlider->installEventFilter(this);
+    cbVoiceGate->setChecked(audioSettings_->getAudioVoiceGate());
+    audioThresholdSlider->setEnabled(!cbVoiceGate->isChecked());
 
     volumeDisplay->setMaximum(totalSliderSteps);
 
     fillAudioQualityComboBox();
+    fillInputModeComboBox();
     fillScreenFpsComboBox();
+    fillEncoderPresetComboBox();
 
     eventsInit();
 
@@ -116,7 +144,7 @@ AVForm::AVForm(IAudioControl& audio_, CoreAV* coreAV_, CameraSource& camera_,
     connect(qGUIApp, &QGuiApplication::screenAdded, this, &AVForm::trackNewScreenGeometry);
     connect(qGUIApp, &QGuiApplication::screenAdded, this, &AVForm::rescanDevices);
     connect(qGUIApp, &QGuiApplication::screenRemoved, this, &AVForm::rescanDevices);
-    Translator::registerHandler(std::bind(&AVForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&AVForm::retranslateUi, this), this, this);
 }
 
 AVForm::~AVForm()
@@ -127,6 +155,8 @@ AVForm::~AVForm()
 
 void AVForm::hideEvent(QHideEvent* event)
 {
+    latencyTimer.stop();
+    volumeTimer.stop();
     audioSink.reset();
     audioSrc.reset();
 
@@ -148,13 +178,18 @@ void AVForm::showEvent(QShowEvent* event)
 
     if (audioSrc == nullptr) {
         audioSrc = audio.makeSource();
-        connect(audioSrc.get(), &IAudioSource::volumeAvailable, this, &AVForm::setVolume);
     }
 
     if (audioSink == nullptr) {
         audioSink = audio.makeSink();
     }
 
+    updateAudioLatency();
+    latencyTimer.start();
+    // drop whatever was measured while we were hidden
+    std::ignore = audio.takeInputLevel();
+    volumeTimer.start();
+
     GenericForm::showEvent(event);
 }
 
@@ -177,8 +212,15 @@ void AVForm::rescanDevices()
     getVideoDevices();
 }
 
-void AVForm::setVolume(qreal value)
+void AVForm::updateAudioLatency()
 {
+    const QString report = coreAV ? coreAV->getAudioLatencyReport() : QString{};
+    audioLatencyReport->setText(report.isEmpty() ? tr("No active call") : report);
+}
+
+void AVForm::updateVolume()
+{
+    const qreal value = audio.takeInputLevel().volume();
     volumeDisplay->setValue(getStepsFromValue(value, audio.minOutputVolume(), audio.maxOutputVolume()));
 }
 
@@ -392,6 +434,22 @@ void AVForm::fillAudioQualityComboBox()
     audioQualityComboBox->blockSignals(previouslyBlocked);
 }
 
+void AVForm::fillInputModeComboBox()
+{
+    const bool previouslyBlocked = inputModeComboBox->blockSignals(true);
+
+    using InputMode = IAudioSettings::InputMode;
+    inputModeComboBox->addItem(tr("Single microphone"), static_cast<int>(InputMode::Voice));
+    inputModeComboBox->addItem(tr("Microphone array (beamforming)"),
+                               static_cast<int>(InputMode::MicArray));
+    inputModeComboBox->addItem(tr("Stereo music, no processing"),
+                               static_cast<int>(InputMode::Music));
+
+    const int currentMode = static_cast<int>(audioSettings->getAudioInputMode());
+    inputModeComboBox->setCurrentIndex(inputModeComboBox->findData(currentMode));
+    inputModeComboBox->blockSignals(previouslyBlocked);
+}
+
 void AVForm::fillScreenFpsComboBox()
 {
     const bool previouslyBlocked = screenFpsComboBox->blockSignals(true);
@@ -409,6 +467,24 @@ void AVForm::fillScreenFpsComboBox()
     screenFpsComboBox->blockSignals(previouslyBlocked);
 }
 
+void AVForm::fillEncoderPresetComboBox()
+{
+    const bool previouslyBlocked = encoderPresetComboBox->blockSignals(true);
+    encoderPresetComboBox->clear();
+
+    encoderPresetComboBox->addItem(tr("Best quality"),
+                                   static_cast<int>(CallEncoderProfile::Preset::Quality));
+    encoderPresetComboBox->addItem(tr("Balanced"),
+                                   static_cast<int>(CallEncoderProfile::Preset::Balanced));
+    encoderPresetComboBox->addItem(tr("Fast, for slow computers"),
+                                   static_cast<int>(CallEncoderProfile::Preset::Fast));
+
+    const int current = static_cast<int>(
+        CallEncoderProfile::presetFromInt(audioSettings->getVideoEncoderPreset()));
+    encoderPresetComboBox->setCurrentIndex(encoderPresetComboBox->findData(current));
+    encoderPresetComboBox->blockSignals(previouslyBlocked);
+}
+
 void AVForm::updateVideoModes(int curIndex)
 {
     if (curIndex < 0 || curIndex >= videoDeviceList.size()) {
@@ -416,10 +492,16 @@ void AVForm::updateVideoModes(int curIndex)
         return;
     }
     QString devName = videoDeviceList[curIndex].first;
-    QVector<VideoMode> allVideoModes = CameraDevice::getVideoModes(devName);
+    QVector<VideoMode> allVideoModes = modeCache.getVideoModes(devName);
 
     qDebug("available Modes:");
     bool isScreen = CameraDevice::isScreen(devName);
+#ifdef QTOX_X11_SCREEN_GRAB
+    // only the native grabber can follow windows
+    cbScreenFollowWindow->setVisible(isScreen && devName.startsWith("x11grab#"));
+#else
+    cbScreenFollowWindow->setVisible(false);
+#endif
     if (isScreen) {
         // Add extra video mode to region selection
         allVideoModes.push_back(VideoMode());
@@ -493,12 +575,48 @@ void AVForm::on_audioQualityComboBox_currentIndexChanged(int index)
     audioSettings->setAudioBitrate(audioQualityComboBox->currentData().toInt());
 }
 
+void AVForm::on_inputModeComboBox_currentIndexChanged(int index)
+{
+    std::ignore = index;
+    const auto mode =
+        static_cast<IAudioSettings::InputMode>(inputModeComboBox->currentData().toInt());
+    if (mode == audioSettings->getAudioInputMode()) {
+        return;
+    }
+
+    audioSettings->setAudioInputMode(mode);
+    // the capture device has to be reopened to switch between mono and stereo
+    audio.reinitInput(audioSettings->getInDev());
+    audioSrc = audio.makeSource();
+}
+
 void AVForm::on_screenFpsComboBox_currentIndexChanged(int index)
 {
     std::ignore = index;
     videoSettings->setScreenVideoFPS(screenFpsComboBox->currentData().toInt());
 }
 
+void AVForm::on_cbHwVideoDecode_stateChanged()
+{
+    videoSettings->setCamVideoHwDecode(cbHwVideoDecode->isChecked());
+}
+
+void AVForm::on_cbScreenFollowWindow_stateChanged()
+{
+    videoSettings->setScreenFollowWindow(cbScreenFollowWindow->isChecked());
+}
+
+void AVForm::on_cbCamWarmStandby_stateChanged()
+{
+    videoSettings->setCamWarmStandby(cbCamWarmStandby->isChecked());
+}
+
+void AVForm::on_encoderPresetComboBox_currentIndexChanged(int index)
+{
+    std::ignore = index;
+    audioSettings->setVideoEncoderPreset(encoderPresetComboBox->currentData().toInt());
+}
+
 void AVForm::getVideoDevices()
 {
     QString settingsInDev = videoSettings->getVideoDev();
@@ -575,7 +693,6 @@ void AVForm::on_inDevCombobox_currentIndexChanged(int deviceIndex)
         audioSettings->setInDev(deviceName);
         audio.reinitInput(deviceName);
         audioSrc = audio.makeSource();
-        connect(audioSrc.get(), &IAudioSource::volumeAvailable, this, &AVForm::setVolume);
     }
 
     microphoneSlider->setEnabled(inputEnabled);
@@ -646,6 +763,14 @@ void AVForm::on_audioThresholdSlider_valueChanged(int sliderSteps)
     audio.setInputThreshold(normThreshold);
 }
 
+void AVForm::on_cbVoiceGate_stateChanged()
+{
+    const bool enabled = cbVoiceGate->isChecked();
+    audioSettings->setAudioVoiceGate(enabled);
+    audio.setVoiceGate(enabled);
+    audioThresholdSlider->setEnabled(!enabled);
+}
+
 void AVForm::on_cbEchoCancellation_stateChanged()
 {
     qWarning() << "on_cbEchoCancellation_stateChanged:" << cbEchoCancellation->isChecked();
@@ -670,6 +795,16 @@ void AVForm::on_aecechonsmode_valueChanged(int mode)
     audioSettings->setAecechonsmode(mode);
 }
 
+void AVForm::on_cbFullAudioProcessing_stateChanged()
+{
+    audioSettings->setFullAudioProcessing(cbFullAudioProcessing->isChecked());
+}
+
+void AVForm::on_cbTransientSuppression_stateChanged()
+{
+    audioSettings->setAudioTransientSuppression(cbTransientSuppression->isChecked());
+}
+
 void AVForm::createVideoSurface()
 {
     if (camVideoSurface)
@@ -678,6 +813,7 @@ void AVForm::createVideoSurface()
     camVideoSurface = new VideoSurface(QPixmap(), CamFrame);
     camVideoSurface->setObjectName(QStringLiteral("CamVideoSurface"));
     camVideoSurface->setMinimumSize(QSize(160, 120));
+    camVideoSurface->setPreview(true);
     camVideoSurface->setSource(&camera);
     gridLayout->addWidget(camVideoSurface, 0, 0, 1, 1);
 }
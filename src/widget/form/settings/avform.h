@@ -22,9 +22,11 @@
 #include <QList>
 #include <QObject>
 #include <QString>
+#include <QTimer>
 
 #include "genericsettings.h"
 #include "ui_avform.h"
+#include "src/video/cameramodecache.h"
 #include "src/video/videomode.h"
 
 #include <memory>
@@ -60,7 +62,9 @@ private:
     void fillCameraModesComboBox();
     void fillScreenModesComboBox();
     void fillAudioQualityComboBox();
+    void fillInputModeComboBox();
     void fillScreenFpsComboBox();
+    void fillEncoderPresetComboBox();
     int searchPreferredIndex();
 
     void createVideoSurface();
@@ -76,19 +80,28 @@ private slots:
     void on_cbEnableTestSound_stateChanged();
     void on_microphoneSlider_valueChanged(int sliderSteps);
     void on_audioThresholdSlider_valueChanged(int sliderSteps);
+    void on_cbVoiceGate_stateChanged();
     void on_audioQualityComboBox_currentIndexChanged(int index);
+    void on_inputModeComboBox_currentIndexChanged(int index);
     void on_cbEchoCancellation_stateChanged();
     void on_echoLatency_valueChanged(int latency_ms);
     void on_aecechomode_valueChanged(int mode);
     void on_aecechonsmode_valueChanged(int mode);
+    void on_cbFullAudioProcessing_stateChanged();
+    void on_cbTransientSuppression_stateChanged();
 
     // camera
     void on_videoDevCombobox_currentIndexChanged(int index);
     void on_videoModescomboBox_currentIndexChanged(int index);
     void on_screenFpsComboBox_currentIndexChanged(int index);
+    void on_cbHwVideoDecode_stateChanged();
+    void on_cbScreenFollowWindow_stateChanged();
+    void on_cbCamWarmStandby_stateChanged();
+    void on_encoderPresetComboBox_currentIndexChanged(int index);
 
     void rescanDevices();
-    void setVolume(qreal value);
+    void updateVolume();
+    void updateAudioLatency();
 
 protected:
     void updateVideoModes(int curIndex);
@@ -106,6 +119,7 @@ private:
     CoreAV* coreAV;
     IAudioSettings* audioSettings;
     IVideoSettings* videoSettings;
+    CameraModeCache modeCache;
 
     bool subscribedToAudioIn;
     std::unique_ptr<IAudioSink> audioSink;
@@ -115,5 +129,8 @@ private:
     QVector<QPair<QString, QString>> videoDeviceList;
     QVector<VideoMode> videoModes;
     uint alSource;
+    QTimer latencyTimer;
+    QTimer volumeTimer;
+    static constexpr int VOLUME_POLL_INTERVAL_MS = 33;
     const uint totalSliderSteps = 100; // arbitrary number of steps to give slider a good "feel"
 };
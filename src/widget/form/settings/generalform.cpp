@@ -165,7 +165,7 @@ GeneralForm::GeneralForm(SettingsWidget* myParent, Settings& settings_, Style& s
 #endif
 
     eventsInit();
-    Translator::registerHandler(std::bind(&GeneralForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&GeneralForm::retranslateUi, this), this, this);
 }
 
 GeneralForm::~GeneralForm()
@@ -51,7 +51,7 @@ PrivacyForm::PrivacyForm(Core* core_, Settings& settings_, Style& style, Profile
     const RecursiveSignalBlocker signalBlocker(this);
 
     eventsInit();
-    Translator::registerHandler(std::bind(&PrivacyForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&PrivacyForm::retranslateUi, this), this, this);
 }
 
 PrivacyForm::~PrivacyForm()
@@ -76,6 +76,11 @@ void PrivacyForm::on_cbKeepHistory_stateChanged()
     }
 }
 
+void PrivacyForm::on_cbFastHistoryEncryption_stateChanged()
+{
+    settings.setFastDatabaseEncryption(bodyUI->cbFastHistoryEncryption->isChecked());
+}
+
 void PrivacyForm::on_cbTypingNotification_stateChanged()
 {
     settings.setTypingNotification(bodyUI->cbTypingNotification->isChecked());
@@ -99,6 +104,9 @@ void PrivacyForm::showEvent(QShowEvent* event)
     bodyUI->nospamLineEdit->setText(core->getSelfId().getNoSpamString());
     bodyUI->cbTypingNotification->setChecked(s.getTypingNotification());
     bodyUI->cbKeepHistory->setChecked(settings.getEnableLogging());
+    // only encrypted histories have encryption params to choose from
+    bodyUI->cbFastHistoryEncryption->setEnabled(profile.isEncrypted());
+    bodyUI->cbFastHistoryEncryption->setChecked(settings.getFastDatabaseEncryption());
     bodyUI->blackListTextEdit->setText(s.getBlackList().join('\n'));
 }
 
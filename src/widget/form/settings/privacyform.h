@@ -46,6 +46,7 @@ signals:
 
 private slots:
     void on_cbKeepHistory_stateChanged();
+    void on_cbFastHistoryEncryption_stateChanged();
     void on_cbTypingNotification_stateChanged();
     void on_nospamLineEdit_editingFinished();
     void on_randomNosapamButton_clicked();
@@ -170,7 +170,7 @@ UserInterfaceForm::UserInterfaceForm(SmileyPack& smileyPack_, Settings& settings
     on_dateFormats_editTextChanged(dateFormat);
 
     eventsInit();
-    Translator::registerHandler(std::bind(&UserInterfaceForm::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&UserInterfaceForm::retranslateUi, this), this, this);
 }
 
 UserInterfaceForm::~UserInterfaceForm()
@@ -252,12 +252,9 @@ void UserInterfaceForm::reloadSmileys()
     for (int i = 0; i < emoticons.size(); ++i)
         smileys.push_front(emoticons.at(i).first());
 
-    emoticonsIcons.clear();
     const QSize size(18, 18);
     for (int i = 0; i < smileLabels.size(); ++i) {
-        std::shared_ptr<QIcon> icon = smileyPack.getAsIcon(smileys[i]);
-        emoticonsIcons.append(icon);
-        smileLabels[i]->setPixmap(icon->pixmap(size));
+        smileLabels[i]->setPixmap(smileyPack.getAsPixmap(smileys[i], size));
         smileLabels[i]->setToolTip(smileys[i]);
     }
 
@@ -268,7 +265,7 @@ void UserInterfaceForm::reloadSmileys()
     int maxSide = qMin(desktop.geometry().height() / sideSize, desktop.geometry().width() / sideSize);
     QSize maxSize(maxSide, maxSide);
 
-    QSize actualSize = emoticonsIcons.first()->actualSize(maxSize);
+    QSize actualSize = smileyPack.getAsIcon(smileys.first()).actualSize(maxSize);
     bodyUI->emoticonSize->setMaximum(actualSize.width());
 }
 
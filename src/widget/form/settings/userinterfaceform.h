@@ -74,7 +74,6 @@ private:
 
 private:
     QList<QLabel*> smileLabels;
-    QList<std::shared_ptr<QIcon>> emoticonsIcons;
     SettingsWidget* parent;
     Ui::UserInterfaceSettings* bodyUI;
     const int MAX_FORMAT_LENGTH = 128;
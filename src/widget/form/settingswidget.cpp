@@ -78,7 +78,7 @@ SettingsWidget::SettingsWidget(UpdateCheck* updateCheck, IAudioControl& audio,
 
     connect(settingsWidgets.get(), &QTabWidget::currentChanged, this, &SettingsWidget::onTabChanged);
 
-    Translator::registerHandler(std::bind(&SettingsWidget::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&SettingsWidget::retranslateUi, this), this, this);
 }
 
 SettingsWidget::~SettingsWidget()
@@ -44,6 +44,19 @@ TabCompleter::TabCompleter(ChatTextEdit* msgEdit_, Group* group_)
     , enabled{false}
     , lastCompletionLength{0}
 {
+    for (const auto& name : group->getPeerList()) {
+        peerNames.insert(name);
+    }
+
+    connect(group, &Group::userJoined, this,
+            [this](const ToxPk&, const QString& name) { peerNames.insert(name); });
+    connect(group, &Group::userLeft, this,
+            [this](const ToxPk&, const QString& name) { peerNames.remove(name); });
+    connect(group, &Group::peerNameChanged, this,
+            [this](const ToxPk&, const QString& oldName, const QString& newName) {
+                peerNames.remove(oldName);
+                peerNames.insert(newName);
+            });
 }
 
 /* from quassel/src/uisupport/multilineedit.h
@@ -67,19 +80,14 @@ void TabCompleter::buildCompletionList()
     QString tabAbbrev = msgEdit->toPlainText()
                             .left(msgEdit->textCursor().position())
                             .section(QRegExp("[^\\w\\d\\$:@--_\\[\\]{}|`^.\\\\]"), -1, -1);
-    // that section is then used as the completion regex
-    QRegExp regex(QString("^[-_\\[\\]{}|`^.\\\\]*").append(QRegExp::escape(tabAbbrev)),
-                  Qt::CaseInsensitive);
-
+    // that section is then looked up in the peer names, ignoring leading punctuation
     const QString ownNick = group->getSelfName();
-    for (const auto& name : group->getPeerList()) {
+    for (const auto& name : peerNames.complete(tabAbbrev)) {
         if (name == ownNick) {
             continue;   // don't auto complete own name
         }
-        if (regex.indexIn(name) > -1) {
-            SortableString lower = SortableString(name.toLower());
-            completionMap[lower] = name;
-        }
+        SortableString lower = SortableString(name.toLower());
+        completionMap[lower] = name;
     }
 
     nextCompletion = completionMap.begin();
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "src/model/group.h"
+#include "src/model/peernametrie.h"
 #include "src/widget/tool/chattextedit.h"
 #include <QMap>
 #include <QString>
@@ -53,6 +54,7 @@ private:
     bool enabled;
     const static QString nickSuffix;
 
+    PeerNameTrie peerNames;
     QMap<SortableString, QString> completionMap;
     QMap<SortableString, QString>::Iterator nextCompletion;
     int lastCompletionLength;
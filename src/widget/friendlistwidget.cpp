@@ -85,9 +85,9 @@ Time getTimeBucket(const QDateTime& date)
     return Time::LongAgo;
 }
 
-QDateTime getActiveTimeFriend(const Friend* contact, Settings& settings)
+QDateTime getActiveTimeFriend(const Friend* contact)
 {
-    return settings.getFriendActivity(contact->getPublicKey());
+    return contact->getActivity().lastActivity;
 }
 
 qint64 timeUntilTomorrow()
@@ -114,7 +114,13 @@ FriendListWidget::FriendListWidget(const Core &core_, Widget* parent,
     int countContacts = core.getFriendList().size();
     manager = new FriendListManager(countContacts, this);
     manager->setGroupsOnTop(groupsOnTop);
-    connect(manager, &FriendListManager::itemsChanged, this, &FriendListWidget::itemsChanged);
+    connect(manager, &FriendListManager::itemsChanged, this, &FriendListWidget::scheduleSort);
+
+    // All changes of one event loop turn are applied with a single sort
+    sortTimer = new QTimer(this);
+    sortTimer->setSingleShot(true);
+    sortTimer->setInterval(0);
+    connect(sortTimer, &QTimer::timeout, this, &FriendListWidget::sortByMode);
 
     listLayout = new QVBoxLayout;
     setLayout(listLayout);
@@ -159,7 +165,7 @@ void FriendListWidget::sortByMode()
             return;
         }
 
-        cleanMainLayout();
+        cleanMainLayout(false);
 
         for (int i = 0; i < settings.getCircleCount(); ++i) {
             addCircleWidget(i);
@@ -221,7 +227,9 @@ void FriendListWidget::sortByMode()
         if (!manager->getPositionsChanged()) {
             return;
         }
-        cleanMainLayout();
+        // The categories are kept between sorts, so friends that stay in their category are
+        // not taken out of it and put back again
+        cleanMainLayout(true);
 
         QLocale ql(settings.getTranslation());
         QDate today = QDate::currentDate();
@@ -243,68 +251,89 @@ void FriendListWidget::sortByMode()
 // clang-format on
 #undef COMMENT
 
-        QVector<std::shared_ptr<IFriendListItem>> itemsTmp = manager->getItems();
-
-        for (int i = 0; i < itemsTmp.size(); ++i) {
-            listLayout->addWidget(itemsTmp[i]->getWidget());
-        }
-
-        activityLayout = new QVBoxLayout();
-        bool compact = settings.getCompactLayout();
-        for (Time t : names.keys()) {
-            CategoryWidget* category = new CategoryWidget(compact, settings, style, this);
-            category->setName(names[t]);
-            activityLayout->addWidget(category);
+        if (activityLayout == nullptr) {
+            activityLayout = new QVBoxLayout();
+            bool compact = settings.getCompactLayout();
+            for (Time t : names.keys()) {
+                CategoryWidget* category = new CategoryWidget(compact, settings, style, this);
+                category->setName(names[t]);
+                activityLayout->addWidget(category);
+            }
+            listLayout->addLayout(activityLayout);
+        } else {
+            // month names move on with the date
+            int i = 0;
+            for (Time t : names.keys()) {
+                QWidget* widget = activityLayout->itemAt(i++)->widget();
+                qobject_cast<CategoryWidget*>(widget)->setName(names[t]);
+            }
         }
 
         // TODO: Try to remove
         manager->applyFilter();
 
-        // Insert widgets to CategoryWidget
+        // Groups and filtered out friends go in front of the categories, the other friends to
+        // the category of their last activity
+        QVector<std::shared_ptr<IFriendListItem>> itemsTmp = manager->getItems();
+        int listPos = 0;
         for (int i = 0; i < itemsTmp.size(); ++i) {
-            if (itemsTmp[i]->isFriend()) {
+            QWidget* widget = itemsTmp[i]->getWidget();
+            if (itemsTmp[i]->isFriend() && (!isVisible() || !widget->isHidden())) {
                 int timeIndex = static_cast<int>(getTimeBucket(itemsTmp[i]->getLastActivity()));
-                QWidget* widget = activityLayout->itemAt(timeIndex)->widget();
-                CategoryWidget* categoryWidget = qobject_cast<CategoryWidget*>(widget);
-                FriendWidget* frnd = qobject_cast<FriendWidget*>((itemsTmp[i].get())->getWidget());
-                if (!isVisible() || (isVisible() && frnd->isVisible())) {
-                    categoryWidget->addFriendWidget(frnd, frnd->getFriend()->getStatus());
-                }
+                QWidget* categoryItem = activityLayout->itemAt(timeIndex)->widget();
+                CategoryWidget* categoryWidget = qobject_cast<CategoryWidget*>(categoryItem);
+                FriendWidget* frnd = qobject_cast<FriendWidget*>(widget);
+                categoryWidget->addFriendWidget(frnd, frnd->getFriend()->getStatus());
+            } else {
+                listLayout->insertWidget(listPos++, widget);
             }
         }
 
-        //Hide empty categories
+        // Update counters of categories friends left, hide empty categories
         for (int i = 0; i < activityLayout->count(); ++i) {
             QWidget* widget = activityLayout->itemAt(i)->widget();
             CategoryWidget* categoryWidget = qobject_cast<CategoryWidget*>(widget);
+            categoryWidget->updateStatus();
             categoryWidget->setVisible(categoryWidget->hasChatrooms());
         }
-
-        listLayout->addLayout(activityLayout);
     }
 }
 
 /**
  * @brief Clears the listLayout by performing the creation and ownership inverse of sortByMode.
+ * @param keepActivity Keep the activity categories and the friends inside them.
+ *
+ * Friend and group widgets placed directly in the list stay children of it, sortByMode adds
+ * them back right away. Reparenting them would hide, re-polish and show every single contact.
  */
-void FriendListWidget::cleanMainLayout()
+void FriendListWidget::cleanMainLayout(bool keepActivity)
 {
-    manager->resetParents();
+    if (activityLayout != nullptr && !keepActivity) {
+        // friends must leave the categories before they are deleted
+        manager->resetParents();
+    }
 
-    QLayoutItem* itemForDel;
-    while ((itemForDel = listLayout->takeAt(0)) != nullptr) {
-        listLayout->removeWidget(itemForDel->widget());
+    for (int i = listLayout->count() - 1; i >= 0; --i) {
+        QLayoutItem* itemForDel = listLayout->itemAt(i);
+        QLayout* layout = itemForDel->layout();
+        if (keepActivity && layout != nullptr && layout == activityLayout) {
+            continue;
+        }
+
+        listLayout->takeAt(i);
         QWidget* wgt = itemForDel->widget();
-        if (wgt != nullptr) {
+        if (qobject_cast<CircleWidget*>(wgt) != nullptr) {
             wgt->setParent(nullptr);
-        } else if (itemForDel->layout() != nullptr) {
-            QLayout* layout = itemForDel->layout();
+        } else if (layout != nullptr) {
             QLayoutItem* itemTmp;
             while ((itemTmp = layout->takeAt(0)) != nullptr) {
                 wgt = itemTmp->widget();
                 delete wgt;
                 delete itemTmp;
             }
+            if (layout == activityLayout) {
+                activityLayout = nullptr;
+            }
         }
         delete itemForDel;
     }
@@ -344,7 +373,7 @@ FriendListWidget::getItemsFromCircle(CircleWidget *circle) const
 
 CategoryWidget* FriendListWidget::getTimeCategoryWidget(const Friend* frd) const
 {
-    const auto activityTime = getActiveTimeFriend(frd, settings);
+    const auto activityTime = getActiveTimeFriend(frd);
     int timeIndex = static_cast<int>(getTimeBucket(activityTime));
     QWidget* widget = activityLayout->itemAt(timeIndex)->widget();
     return qobject_cast<CategoryWidget*>(widget);
@@ -424,9 +453,14 @@ void FriendListWidget::searchChatrooms(const QString& searchString, bool hideOnl
 
 void FriendListWidget::renameGroupWidget(GroupWidget* groupWidget, const QString& newName)
 {
-    std::ignore = groupWidget;
     std::ignore = newName;
-    itemsChanged();
+    manager->setItemChanged(groupWidget);
+}
+
+void FriendListWidget::renameFriendWidget(FriendWidget* friendWidget, const QString& newName)
+{
+    std::ignore = newName;
+    manager->setItemChanged(friendWidget);
 }
 
 void FriendListWidget::renameCircleWidget(CircleWidget* circleWidget, const QString& newName)
@@ -462,7 +496,7 @@ void FriendListWidget::cycleChats(GenericChatroomWidget* activeChatroomWidget, b
             return;
         }
 
-        const auto activityTime = getActiveTimeFriend(friendWidget->getFriend(), settings);
+        const auto activityTime = getActiveTimeFriend(friendWidget->getFriend());
         index = static_cast<int>(getTimeBucket(activityTime));
         QWidget* widget_ = activityLayout->itemAt(index)->widget();
         CategoryWidget* categoryWidget = qobject_cast<CategoryWidget*>(widget_);
@@ -567,9 +601,17 @@ void FriendListWidget::dayTimeout()
     dayTimer->start(timeUntilTomorrow());
 }
 
+/**
+ * @brief Requests a resort for changes not reported for a single item.
+ */
 void FriendListWidget::itemsChanged()
 {
-    sortByMode();
+    manager->setCheckRequired();
+}
+
+void FriendListWidget::scheduleSort()
+{
+    sortTimer->start();
 }
 
 void FriendListWidget::moveWidget(FriendWidget* widget, Status::Status s, bool add)
@@ -584,7 +626,7 @@ void FriendListWidget::moveWidget(FriendWidget* widget, Status::Status s, bool a
                 settings.setFriendCircleID(f->getPublicKey(), -1);
                 manager->setSortRequired();
             } else {
-                itemsChanged();
+                manager->setItemChanged(widget);
             }
             return;
         }
@@ -596,7 +638,7 @@ void FriendListWidget::moveWidget(FriendWidget* widget, Status::Status s, bool a
         categoryWidget->addFriendWidget(widget, contact->getStatus());
         categoryWidget->show();
     }
-    itemsChanged();
+    manager->setItemChanged(widget);
 }
 
 void FriendListWidget::updateActivityTime(const QDateTime& time)
@@ -78,6 +78,7 @@ signals:
 
 public slots:
     void renameGroupWidget(GroupWidget* groupWidget, const QString& newName);
+    void renameFriendWidget(FriendWidget* friendWidget, const QString& newName);
     void renameCircleWidget(CircleWidget* circleWidget, const QString& newName);
     void onGroupchatPositionChanged(bool top);
     void moveWidget(FriendWidget* w, Status::Status s, bool add = false);
@@ -89,12 +90,13 @@ protected:
 
 private slots:
     void dayTimeout();
+    void scheduleSort();
 
 private:
     CircleWidget* createCircleWidget(int id = -1);
     CategoryWidget* getTimeCategoryWidget(const Friend* frd) const;
     void sortByMode();
-    void cleanMainLayout();
+    void cleanMainLayout(bool keepActivity);
     QWidget* getNextWidgetForName(IFriendListItem* currentPos, bool forward) const;
     QVector<std::shared_ptr<IFriendListItem> > getItemsFromCircle(CircleWidget* circle) const;
 
@@ -102,6 +104,7 @@ private:
     QVBoxLayout* listLayout = nullptr;
     QVBoxLayout* activityLayout = nullptr;
     QTimer* dayTimer;
+    QTimer* sortTimer;
     FriendListManager* manager;
 
     const Core& core;
@@ -31,6 +31,7 @@
 #include "src/model/friend.h"
 #include "src/model/group.h"
 #include "src/model/status.h"
+#include "src/persistence/profile.h"
 #include "src/persistence/settings.h"
 #include "src/widget/about/aboutfriendform.h"
 #include "src/widget/form/chatform.h"
@@ -40,6 +41,7 @@
 
 #include <QApplication>
 #include <QBitmap>
+#include <QClipboard>
 #include <QContextMenuEvent>
 #include <QDrag>
 #include <QFileDialog>
@@ -189,6 +191,7 @@ void FriendWidget::onContextMenuCalled(QContextMenuEvent* event)
     }
 
     menu.addSeparator();
+    addConnectionPathMenu(menu);
     const auto aboutWindow = menu.addAction(tr("Show details"));
     connect(aboutWindow, &QAction::triggered, this, &FriendWidget::showDetails);
 
@@ -202,6 +205,54 @@ void FriendWidget::onContextMenuCalled(QContextMenuEvent* event)
     }
 }
 
+/**
+ * @brief Adds a submenu telling how we are connected to the friend and how stable that is.
+ */
+void FriendWidget::addConnectionPathMenu(QMenu& menu)
+{
+    using Path = ConnectionPathStats::Path;
+    const auto stats = chatroom->getConnectionPath();
+    const auto duration = [](qint64 ms) {
+        const qint64 secs = ms / 1000;
+        return QStringLiteral("%1:%2:%3")
+            .arg(secs / 3600)
+            .arg((secs / 60) % 60, 2, 10, QLatin1Char('0'))
+            .arg(secs % 60, 2, 10, QLatin1Char('0'));
+    };
+
+    QString path;
+    switch (stats.path) {
+    case Path::Offline:
+        path = tr("offline", "connection path");
+        break;
+    case Path::TcpRelay:
+        path = stats.proxied ? tr("TCP relay via proxy", "connection path")
+                             : tr("TCP relay", "connection path");
+        break;
+    case Path::Udp:
+        path = tr("direct UDP", "connection path");
+        break;
+    }
+
+    QMenu* pathMenu = menu.addMenu(tr("Connection: %1").arg(path));
+    const QStringList lines{
+        tr("Current path for %1").arg(duration(stats.currentMs)),
+        tr("Direct UDP: %1").arg(duration(stats.totalMs[static_cast<int>(Path::Udp)])),
+        tr("TCP relay: %1").arg(duration(stats.totalMs[static_cast<int>(Path::TcpRelay)])),
+        tr("Path changes: %1, fallbacks to a relay: %2").arg(stats.flips).arg(stats.fallbacks),
+        tr("Disconnects: %1").arg(stats.disconnects),
+        stats.rttMs < 0 ? tr("Round trip time: unknown")
+                        : tr("Round trip time: %1 ms").arg(stats.rttMs)};
+    for (const QString& line : lines) {
+        pathMenu->addAction(line)->setEnabled(false);
+    }
+
+    pathMenu->addSeparator();
+    const auto copyReport = pathMenu->addAction(tr("Copy report of all friends"));
+    connect(copyReport, &QAction::triggered, this,
+            []() { QApplication::clipboard()->setText(ConnectionPathStats::report()); });
+}
+
 void FriendWidget::removeChatWindow()
 {
     chatroom->removeFriendFromDialogs();
@@ -431,8 +482,7 @@ QString FriendWidget::getNameItem() const
 
 QDateTime FriendWidget::getLastActivity() const
 {
-    const auto frnd = chatroom->getFriend();
-    return settings.getFriendActivity(frnd->getPublicKey());
+    return chatroom->getFriend()->getActivity().lastActivity;
 }
 
 QWidget *FriendWidget::getWidget()
@@ -466,6 +516,26 @@ void FriendWidget::onAvatarSet(const ToxPk& friendPk, const QPixmap& pic)
     avatar->setPixmap(pic);
 }
 
+/**
+ * @brief Loads the avatar once the widget is shown for the first time.
+ */
+void FriendWidget::showEvent(QShowEvent* event)
+{
+    GenericChatroomWidget::showEvent(event);
+    if (avatarRequested) {
+        return;
+    }
+
+    avatarRequested = true;
+    const ToxPk friendPk = chatroom->getFriend()->getPublicKey();
+    // the size of the normal avatar, compact mode only scales it down
+    profile.loadAvatarAsync(friendPk, QSize{40, 40}, this, [this, friendPk](const QPixmap& pic) {
+        if (!pic.isNull()) {
+            onAvatarSet(friendPk, pic);
+        }
+    });
+}
+
 void FriendWidget::onAvatarRemoved(const ToxPk& friendPk)
 {
     const auto frnd = chatroom->getFriend();
@@ -26,6 +26,7 @@
 #include <memory>
 
 class FriendChatroom;
+class QMenu;
 class QPixmap;
 class MaskablePixmapWidget;
 class CircleWidget;
@@ -76,6 +77,7 @@ public slots:
     void setActive(bool active_);
 
 protected:
+    void showEvent(QShowEvent* event) override;
     void mousePressEvent(QMouseEvent* ev) override;
     void mouseMoveEvent(QMouseEvent* ev) override;
     void setFriendAlias();
@@ -88,6 +90,9 @@ private slots:
     void changeAutoAccept(bool enable);
     void showDetails();
 
+private:
+    void addConnectionPathMenu(QMenu& menu);
+
 public:
     std::shared_ptr<FriendChatroom> chatroom;
     bool isDefaultAvatar;
@@ -95,4 +100,7 @@ public:
     Style& style;
     IMessageBoxManager& messageBoxManager;
     Profile& profile;
+
+private:
+    bool avatarRequested = false;
 };
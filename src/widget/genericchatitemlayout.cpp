@@ -108,6 +108,10 @@ int GenericChatItemLayout::indexOfClosestSortedWidget(GenericChatItemWidget* wid
 {
     // Binary search: Deferred test of equality.
     int min = 0, max = layout->count();
+    // Creating a collator is far more expensive than comparing with it, so do it only once
+    QCollator collator;
+    collator.setNumericMode(true);
+
     while (min < max) {
         int mid = (max - min) / 2 + min;
         GenericChatItemWidget* atMid =
@@ -115,10 +119,6 @@ int GenericChatItemLayout::indexOfClosestSortedWidget(GenericChatItemWidget* wid
         assert(atMid != nullptr);
 
         bool lessThan = false;
-
-        QCollator collator;
-        collator.setNumericMode(true);
-
         int compareValue = collator.compare(atMid->getName(), widget->getName());
 
         if (compareValue < 0)
@@ -61,7 +61,7 @@ GroupWidget::GroupWidget(std::shared_ptr<GroupChatroom> chatroom_, bool compact_
     connect(g, &Group::titleChanged, this, &GroupWidget::updateTitle);
     connect(g, &Group::numPeersChanged, this, &GroupWidget::updateUserCount);
     connect(nameLabel, &CroppingLabel::editFinished, this, &GroupWidget::setName);
-    Translator::registerHandler(std::bind(&GroupWidget::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&GroupWidget::retranslateUi, this), this, this);
 }
 
 GroupWidget::~GroupWidget()
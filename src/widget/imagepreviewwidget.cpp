@@ -18,37 +18,24 @@
 */
 
 #include "imagepreviewwidget.h"
-#include "src/model/exiftransform.h"
+#include "src/model/imagedecoder.h"
 
-#include <QFile>
 #include <QFileInfo>
 #include <QString>
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QBuffer>
 
+#include <algorithm>
+
 namespace
 {
-QPixmap pixmapFromFile(const QString& filename)
+bool canPreview(const QString& filename)
 {
     static const QStringList previewExtensions = {"png", "jpeg", "jpg", "gif", "svg",
                                                   "PNG", "JPEG", "JPG", "GIF", "SVG"};
 
-    if (!previewExtensions.contains(QFileInfo(filename).suffix())) {
-        return QPixmap();
-    }
-
-    QFile imageFile(filename);
-    if (!imageFile.open(QIODevice::ReadOnly)) {
-        return QPixmap();
-    }
-
-    const QByteArray imageFileData = imageFile.readAll();
-    QImage image = QImage::fromData(imageFileData);
-    auto orientation = ExifTransform::getOrientation(imageFileData);
-    image = ExifTransform::applyTransformation(image, orientation);
-
-    return QPixmap::fromImage(image);
+    return previewExtensions.contains(QFileInfo(filename).suffix());
 }
 
 QPixmap scaleCropIntoSquare(const QPixmap& source, const int targetSize)
@@ -118,10 +105,26 @@ void ImagePreviewButton::initialize(const QPixmap& image)
 
 void ImagePreviewButton::setIconFromFile(const QString& filename)
 {
-    initialize(pixmapFromFile(filename));
+    const int request = ++previewRequest;
+    if (!canPreview(filename)) {
+        initialize(QPixmap());
+        return;
+    }
+
+    // the preview is never shown larger than half the screen, so don't decode more than that
+    const QRect desktopSize = QApplication::desktop()->geometry();
+    const int maxPreviewSize = std::max(desktopSize.width(), desktopSize.height()) / 2;
+    ImageDecoder::decodeFileAsync(filename, QSize(maxPreviewSize, maxPreviewSize), this,
+                                  [this, request](const QImage& image) {
+                                      // a newer file was set while this one was decoded
+                                      if (request == previewRequest) {
+                                          initialize(QPixmap::fromImage(image));
+                                      }
+                                  });
 }
 
 void ImagePreviewButton::setIconFromPixmap(const QPixmap& pixmap)
 {
+    ++previewRequest;
     initialize(pixmap);
 }
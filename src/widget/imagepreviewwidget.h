@@ -39,4 +39,7 @@ public:
     void setIconFromPixmap(const QPixmap& pixmap);
 private:
     void initialize(const QPixmap& image);
+
+private:
+    int previewRequest = 0;
 };
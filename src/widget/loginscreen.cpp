@@ -28,6 +28,7 @@
 #include "src/widget/tool/profileimporter.h"
 #include "src/widget/translator.h"
 #include "src/persistence/settings.h"
+#include <QApplication>
 #include <QDebug>
 #include <QDialog>
 #include <QMessageBox>
@@ -62,6 +63,7 @@ LoginScreen::LoginScreen(Settings& settings_, Style& style,
     connect(ui->autoLoginCB, &QCheckBox::stateChanged, this, &LoginScreen::onAutoLoginCheckboxChanged);
     connect(ui->importButton, &QPushButton::clicked, this, &LoginScreen::onImportProfile);
 
+    ui->unlockProgress->hide();
     reset(initialProfileName);
     setStyleSheet(style.getStylesheet("loginScreen/loginScreen.css", settings));
 
@@ -109,11 +111,29 @@ void LoginScreen::onProfileLoaded()
 
 void LoginScreen::onProfileLoadFailed()
 {
+    setUnlocking(false);
     QMessageBox::critical(this, tr("Couldn't load this profile"), tr("Wrong password."));
     ui->loginPassword->setFocus();
     ui->loginPassword->selectAll();
 }
 
+/**
+ * @brief Shows how far the upgrade of the chat history of the profile being unlocked is.
+ * @param done Upgrade steps finished.
+ * @param total Upgrade steps in total.
+ *
+ * The upgrade blocks the GUI thread, so the progress is painted right away. User input stays
+ * queued until the profile is loaded.
+ */
+void LoginScreen::onProfileLoadProgress(int done, int total)
+{
+    ui->unlockProgress->setMaximum(total);
+    ui->unlockProgress->setValue(done);
+    ui->unlockProgress->setFormat(tr("Upgrading chat history… %p%"));
+    ui->unlockProgress->setTextVisible(true);
+    qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+}
+
 void LoginScreen::onAutoLoginChanged(bool state)
 {
     ui->autoLoginCB->setChecked(state);
@@ -219,9 +239,28 @@ void LoginScreen::onLogin()
         return;
     }
 
+    // the profile is unlocked in the background, Nexus reports back when it is done
+    setUnlocking(true);
     emit loadProfile(name, pass);
 }
 
+/**
+ * @brief Shows the unlock progress and blocks the login form while a profile is unlocked.
+ */
+void LoginScreen::setUnlocking(bool unlocking)
+{
+    ui->unlockProgress->setVisible(unlocking);
+    // busy indicator until an upgrade reports its progress
+    ui->unlockProgress->setMaximum(0);
+    ui->unlockProgress->setTextVisible(false);
+    ui->loginUsernames->setEnabled(!unlocking);
+    ui->loginPassword->setEnabled(!unlocking);
+    ui->autoLoginCB->setEnabled(!unlocking);
+    ui->importButton->setEnabled(!unlocking);
+    ui->loginButton->setEnabled(!unlocking);
+    ui->newProfilePgbtn->setEnabled(!unlocking);
+}
+
 void LoginScreen::onPasswordEdited()
 {
     ui->passStrengthMeter->setValue(SetPasswordDialog::getPasswordStrength(ui->newPass->text()));
@@ -52,6 +52,7 @@ signals:
 public slots:
     void onProfileLoaded();
     void onProfileLoadFailed();
+    void onProfileLoadProgress(int done, int total);
     void onAutoLoginChanged(bool state);
 
 private slots:
@@ -72,6 +73,7 @@ private:
     void showCapsIndicator();
     void hideCapsIndicator();
     void checkCapsLock();
+    void setUnlocking(bool unlocking);
 
 private:
     Ui::LoginScreen* ui;
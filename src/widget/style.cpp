@@ -26,13 +26,16 @@
 #include <QFontInfo>
 #include <QMap>
 #include <QPainter>
-#include <QRegularExpression>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QStringBuilder>
 #include <QStyle>
 #include <QSvgRenderer>
+#include <QVector>
 #include <QWidget>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 /**
  * @enum Style::Font
@@ -81,6 +84,16 @@ QString qssifyFont(QFont font)
     return QString("%1 %2px \"%3\"").arg(font.weight() * 8).arg(font.pixelSize()).arg(font.family());
 }
 
+QString qssifyBaseFont(const QFont& baseFont)
+{
+    return QString::fromUtf8("'%1' %2px").arg(baseFont.family()).arg(QFontInfo(baseFont).pixelSize());
+}
+
+bool isTokenChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
 using MainTheme = Style::MainTheme;
 struct ThemeNameColor {
     MainTheme type;
@@ -159,15 +172,20 @@ QString Style::getThemeFolder(Settings& settings)
 
 const QString Style::getStylesheet(const QString& filename, Settings& settings, const QFont& baseFont)
 {
-    const QString fullPath = getThemeFolder(settings) + filename;
-    const std::pair<const QString, const QFont> cacheKey(fullPath, baseFont);
+    const StylesheetKey cacheKey(filename, baseFont);
     auto it = stylesheetsCache.find(cacheKey);
+    if (it == stylesheetsCache.end() && prewarmPending) {
+        // the pool is already resolving what was in use before the theme change
+        takePrewarmed();
+        it = stylesheetsCache.find(cacheKey);
+    }
+
     if (it != stylesheetsCache.end())
     {
         // cache hit
         return it->second;
     }
-    // cache miss, new styleSheet, read it from file and add to cache
+    // cache miss, new styleSheet, splice it from the tokenized file and add to cache
     const QString newStylesheet = resolve(filename, settings, baseFont);
     stylesheetsCache.insert(std::make_pair(cacheKey, newStylesheet));
     return newStylesheet;
@@ -227,39 +245,160 @@ QFont Style::getFont(Font font)
 
 const QString Style::resolve(const QString& filename, Settings& settings, const QFont& baseFont)
 {
-    QString themePath = getThemeFolder(settings);
-    QString fullPath = themePath + filename;
-    QString qss;
+    if (palette.isEmpty()) {
+        initPalette(settings);
+    }
+
+    if (dictColor.isEmpty()) {
+        initDictColor();
+    }
+
+    updateTokenValues();
+    return splice(getTemplate(filename, settings), tokenValues, qssifyBaseFont(baseFont));
+}
+
+/**
+ * @brief Returns the tokenized stylesheet file, reading and tokenizing it on first use.
+ *
+ * Templates don't depend on colors or fonts, so they survive theme color changes as long as the
+ * theme they fall back to stays the same.
+ */
+const Style::StylesheetTemplate& Style::getTemplate(const QString& filename, Settings& settings)
+{
+    const QString fallbackPath = getThemePath(settings);
+    if (fallbackPath != templatesFallbackPath) {
+        // image fallbacks are part of the templates
+        templates.clear();
+        templatesFallbackPath = fallbackPath;
+    }
+
+    const QString themePath = getThemeFolder(settings);
+    const QString fullPath = themePath + filename;
+    auto it = templates.constFind(fullPath);
+    if (it != templates.constEnd()) {
+        return *it;
+    }
+
+    return *templates.insert(fullPath, loadTemplate(themePath, fallbackPath, filename));
+}
 
+Style::StylesheetTemplate Style::loadTemplate(const QString& themePath, const QString& fallbackPath,
+                                              const QString& filename)
+{
+    QString fullPath = themePath + filename;
     QFile file{fullPath};
     if (file.open(QFile::ReadOnly | QFile::Text)) {
-        qss = QString::fromUtf8(file.readAll());
-    } else {
-        qWarning() << "Failed to open file:" << fullPath;
+        return compile(QString::fromUtf8(file.readAll()), themePath, fallbackPath);
+    }
 
-        fullPath = getThemePath(settings);
-        QFile defaultFile{fullPath};
+    qWarning() << "Failed to open file:" << fullPath;
 
-        if (defaultFile.open(QFile::ReadOnly | QFile::Text)) {
-            qss = QString::fromUtf8(defaultFile.readAll());
-        } else {
-            qWarning() << "Failed to open default file:" << fullPath;
-            return {};
+    fullPath = fallbackPath + filename;
+    QFile defaultFile{fullPath};
+    if (defaultFile.open(QFile::ReadOnly | QFile::Text)) {
+        return compile(QString::fromUtf8(defaultFile.readAll()), themePath, fallbackPath);
+    }
+
+    qWarning() << "Failed to open default file:" << fullPath;
+    return compile({}, themePath, fallbackPath);
+}
+
+/**
+ * @brief Splits a stylesheet into literal chunks and the @-tokens between them.
+ *
+ * @getImagePath() calls are resolved right away and become part of the literal text.
+ */
+Style::StylesheetTemplate Style::compile(const QString& qss, const QString& themePath,
+                                         const QString& fallbackPath)
+{
+    static const QLatin1String imageFunction{"getImagePath("};
+
+    StylesheetTemplate tmpl;
+    QString chunk;
+    int chunkStart = 0;
+    int pos = 0;
+    while ((pos = qss.indexOf(QLatin1Char('@'), pos)) >= 0) {
+        const int nameStart = pos + 1;
+
+        if (qss.midRef(nameStart, imageFunction.size()) == imageFunction) {
+            const int argStart = nameStart + imageFunction.size();
+            const int argEnd = qss.indexOf(QLatin1Char(')'), argStart);
+            const QString path = argEnd < 0 ? QString{} : qss.mid(argStart, argEnd - argStart);
+            const bool valid = argEnd >= 0
+                               && std::none_of(path.begin(), path.end(),
+                                               [](QChar c) { return c.isSpace(); });
+            if (valid) {
+                QString fullImagePath = themePath + path;
+                if (!QFileInfo::exists(fullImagePath)) {
+                    qWarning() << "Failed to open file (using defaults):" << fullImagePath;
+                    fullImagePath = fallbackPath % path;
+                }
+
+                chunk += qss.midRef(chunkStart, pos - chunkStart);
+                chunk += fullImagePath;
+                chunkStart = pos = argEnd + 1;
+                continue;
+            }
         }
+
+        int nameEnd = nameStart;
+        while (nameEnd < qss.size() && isTokenChar(qss[nameEnd])) {
+            ++nameEnd;
+        }
+
+        if (nameEnd > nameStart) {
+            chunk += qss.midRef(chunkStart, pos - chunkStart);
+            tmpl.literalSize += chunk.size();
+            tmpl.chunks << chunk;
+            tmpl.tokens << qss.mid(pos, nameEnd - pos);
+            chunk.clear();
+            chunkStart = nameEnd;
+        }
+
+        pos = nameEnd;
     }
 
-    if (palette.isEmpty()) {
-        initPalette(settings);
+    chunk += qss.midRef(chunkStart);
+    tmpl.literalSize += chunk.size();
+    tmpl.chunks << chunk;
+    return tmpl;
+}
+
+/**
+ * @brief Builds the stylesheet from a template, tokens without a value are kept as they are.
+ */
+QString Style::splice(const StylesheetTemplate& tmpl, const QHash<QString, QString>& values,
+                      const QString& baseFont)
+{
+    static const QLatin1String baseFontToken{"@baseFont"};
+
+    QString qss;
+    qss.reserve(tmpl.literalSize + tmpl.tokens.size() * baseFont.size());
+    for (int i = 0; i < tmpl.tokens.size(); ++i) {
+        qss += tmpl.chunks[i];
+
+        const QString& token = tmpl.tokens[i];
+        if (token == baseFontToken) {
+            qss += baseFont;
+            continue;
+        }
+
+        auto value = values.constFind(token);
+        qss += value != values.constEnd() ? *value : token;
     }
 
-    if (dictColor.isEmpty()) {
-        initDictColor();
+    qss += tmpl.chunks.last();
+    return qss;
+}
+
+void Style::updateTokenValues()
+{
+    if (!tokenValuesDirty) {
+        return;
     }
 
     if (dictFont.isEmpty()) {
         dictFont = {
-            {"@baseFont",
-             QString::fromUtf8("'%1' %2px").arg(baseFont.family()).arg(QFontInfo(baseFont).pixelSize())},
             {"@extraBig", qssifyFont(Style::getFont(Font::ExtraBig))},
             {"@big", qssifyFont(Style::getFont(Font::Big))},
             {"@bigBold", qssifyFont(Style::getFont(Font::BigBold))},
@@ -269,45 +408,75 @@ const QString Style::resolve(const QString& filename, Settings& settings, const
             {"@smallLight", qssifyFont(Style::getFont(Font::SmallLight))}};
     }
 
-    for (const QString& key : dictColor.keys()) {
-        qss.replace(QRegularExpression(key % QLatin1String{"\\b"}), dictColor[key]);
+    tokenValues.clear();
+    for (const QMap<QString, QString>* dict : {&dictColor, &dictFont, &dictTheme}) {
+        for (auto it = dict->constBegin(); it != dict->constEnd(); ++it) {
+            tokenValues.insert(it.key(), it.value());
+        }
     }
 
-    for (const QString& key : dictFont.keys()) {
-        qss.replace(QRegularExpression(key % QLatin1String{"\\b"}), dictFont[key]);
+    tokenValuesDirty = false;
+}
+
+/**
+ * @brief Resolves stylesheets in the global thread pool.
+ * @param keys Stylesheets to resolve, usually the ones in use before a theme change.
+ *
+ * Widgets reload their stylesheets one after another right after a theme change, getStylesheet
+ * then only has to wait for the pool instead of resolving every file on the GUI thread.
+ */
+void Style::prewarmStylesheets(Settings& settings, const std::vector<StylesheetKey>& keys)
+{
+    if (keys.empty()) {
+        return;
     }
 
-    for (const QString& key : dictTheme.keys()) {
-        qss.replace(QRegularExpression(key % QLatin1String{"\\b"}), dictTheme[key]);
+    updateTokenValues();
+    const QString themePath = getThemeFolder(settings);
+    const QString fallbackPath = getThemePath(settings);
+    if (fallbackPath != templatesFallbackPath) {
+        templates.clear();
+        templatesFallbackPath = fallbackPath;
     }
 
-    // @getImagePath() function
-    const QRegularExpression re{QStringLiteral(R"(@getImagePath\([^)\s]*\))")};
-    QRegularExpressionMatchIterator i = re.globalMatch(qss);
-
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        QString path = match.captured(0);
-        const QString phrase = path;
-
-        path.remove(QStringLiteral("@getImagePath("));
-        path.chop(1);
-
-        QString fullImagePath = getThemeFolder(settings) + path;
-        // image not in cache
-        if (!existingImagesCache.contains(fullPath)) {
-            if (QFileInfo::exists(fullImagePath)) {
-                existingImagesCache << fullImagePath;
-            } else {
-                qWarning() << "Failed to open file (using defaults):" << fullImagePath;
-                fullImagePath = getThemePath(settings) % path;
-            }
+    QVector<PrewarmJob> jobs;
+    jobs.reserve(static_cast<int>(keys.size()));
+    for (const StylesheetKey& key : keys) {
+        auto it = templates.constFind(themePath + key.first);
+        const bool compiled = it != templates.constEnd();
+        jobs.append({key, themePath, fallbackPath, compiled,
+                     compiled ? *it : StylesheetTemplate{}, tokenValues,
+                     qssifyBaseFont(key.second)});
+    }
+
+    prewarm = QtConcurrent::mapped(jobs, &Style::resolvePrewarmJob);
+    prewarmPending = true;
+}
+
+Style::ResolvedStylesheet Style::resolvePrewarmJob(const PrewarmJob& job)
+{
+    const StylesheetTemplate tmpl =
+        job.compiled ? job.tmpl : loadTemplate(job.themePath, job.fallbackPath, job.key.first);
+    return {job.key, job.themePath + job.key.first, tmpl, splice(tmpl, job.values, job.baseFont)};
+}
+
+/**
+ * @brief Waits for the pre-resolved stylesheets and moves them into the caches.
+ */
+void Style::takePrewarmed()
+{
+    prewarmPending = false;
+    prewarm.waitForFinished();
+    const QList<ResolvedStylesheet> results = prewarm.results();
+    prewarm = QFuture<ResolvedStylesheet>();
+
+    for (const ResolvedStylesheet& resolved : results) {
+        if (!templates.contains(resolved.fullPath)) {
+            templates.insert(resolved.fullPath, resolved.tmpl);
         }
 
-        qss.replace(phrase, fullImagePath);
+        stylesheetsCache.insert(std::make_pair(resolved.key, resolved.qss));
     }
-
-    return qss;
 }
 
 void Style::repolish(QWidget* w)
@@ -326,6 +495,16 @@ void Style::repolish(QWidget* w)
 
 void Style::setThemeColor(Settings& settings, int color)
 {
+    std::vector<StylesheetKey> inUse;
+    inUse.reserve(stylesheetsCache.size());
+    for (const auto& entry : stylesheetsCache) {
+        inUse.push_back(entry.first);
+    }
+
+    // results of an older theme change are stale, workers own their inputs so just drop them
+    prewarm.cancel();
+    prewarm = QFuture<ResolvedStylesheet>();
+    prewarmPending = false;
     stylesheetsCache.clear(); // clear stylesheet cache which includes color info
     palette.clear();
     dictColor.clear();
@@ -335,6 +514,8 @@ void Style::setThemeColor(Settings& settings, int color)
         setThemeColor(QColor());
     else
         setThemeColor(themeNameColors[color].color);
+
+    prewarmStylesheets(settings, inUse);
 }
 
 /**
@@ -362,6 +543,7 @@ void Style::setThemeColor(const QColor& color)
     dictTheme["@themeMediumDark"] = getColor(ColorPalette::ThemeMediumDark).name();
     dictTheme["@themeMedium"] = getColor(ColorPalette::ThemeMedium).name();
     dictTheme["@themeLight"] = getColor(ColorPalette::ThemeLight).name();
+    tokenValuesDirty = true;
 }
 
 /**
@@ -420,6 +602,7 @@ void Style::initDictColor()
             {"@link", Style::getColor(ColorPalette::Link).name()},
             {"@searchHighlighted", Style::getColor(ColorPalette::SearchHighlighted).name()},
             {"@selectText", Style::getColor(ColorPalette::SelectText).name()}};
+    tokenValuesDirty = true;
 }
 
 QString Style::getThemePath(Settings& settings)
@@ -21,8 +21,14 @@
 
 #include <QColor>
 #include <QFont>
+#include <QFuture>
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QStringList>
+
+#include <map>
+#include <vector>
 
 class QString;
 class QWidget;
@@ -95,12 +101,58 @@ signals:
     void themeReload();
 
 private:
+    struct StylesheetTemplate
+    {
+        // literal text between tokens, always one more chunk than tokens
+        QStringList chunks;
+        QStringList tokens;
+        int literalSize = 0;
+    };
+    using StylesheetKey = std::pair<QString, QFont>;
+    struct PrewarmJob
+    {
+        StylesheetKey key;
+        QString themePath;
+        QString fallbackPath;
+        bool compiled;
+        StylesheetTemplate tmpl;
+        QHash<QString, QString> values;
+        QString baseFont;
+    };
+    struct ResolvedStylesheet
+    {
+        StylesheetKey key;
+        QString fullPath;
+        StylesheetTemplate tmpl;
+        QString qss;
+    };
+
+    const StylesheetTemplate& getTemplate(const QString& filename, Settings& settings);
+    void updateTokenValues();
+    void prewarmStylesheets(Settings& settings, const std::vector<StylesheetKey>& keys);
+    void takePrewarmed();
+    static StylesheetTemplate loadTemplate(const QString& themePath, const QString& fallbackPath,
+                                           const QString& filename);
+    static StylesheetTemplate compile(const QString& qss, const QString& themePath,
+                                      const QString& fallbackPath);
+    static QString splice(const StylesheetTemplate& tmpl, const QHash<QString, QString>& values,
+                          const QString& baseFont);
+    static ResolvedStylesheet resolvePrewarmJob(const PrewarmJob& job);
+
     QMap<ColorPalette, QColor> palette;
     QMap<QString, QString> dictColor;
     QMap<QString, QString> dictFont;
     QMap<QString, QString> dictTheme;
+    // all three dictionaries merged, rebuilt lazily after one of them changed
+    QHash<QString, QString> tokenValues;
+    bool tokenValuesDirty = true;
     // stylesheet filename, font -> stylesheet
     // QString implicit sharing deduplicates stylesheets rather than constructing a new one each time
-    std::map<std::pair<const QString, const QFont>, const QString> stylesheetsCache;
+    std::map<StylesheetKey, QString> stylesheetsCache;
+    // full stylesheet path -> tokenized file, valid for templatesFallbackPath
+    QHash<QString, StylesheetTemplate> templates;
+    QString templatesFallbackPath;
+    QFuture<ResolvedStylesheet> prewarm;
+    bool prewarmPending = false;
     QStringList existingImagesCache;
 };
@@ -33,7 +33,7 @@ ChatTextEdit::ChatTextEdit(QWidget* parent)
     setAcceptRichText(false);
     setAcceptDrops(false);
 
-    Translator::registerHandler(std::bind(&ChatTextEdit::retranslateUi, this), this);
+    Translator::registerLazyHandler(std::bind(&ChatTextEdit::retranslateUi, this), this, this);
 }
 
 ChatTextEdit::~ChatTextEdit()
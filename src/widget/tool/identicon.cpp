@@ -20,12 +20,41 @@
 #include "identicon.h"
 #include "src/core/toxpk.h"
 
+#include <algorithm>
 #include <cassert>
 
+#include <QCache>
 #include <QColor>
 #include <QCryptographicHash>
 #include <QDebug>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace {
+struct CacheKey
+{
+    QByteArray data;
+    int scaleFactor;
+    qreal devicePixelRatio;
+
+    bool operator==(const CacheKey& other) const
+    {
+        return scaleFactor == other.scaleFactor && devicePixelRatio == other.devicePixelRatio
+               && data == other.data;
+    }
+
+    friend uint qHash(const CacheKey& key, uint seed = 0)
+    {
+        return qHash(key.data, seed) ^ qHash(key.scaleFactor, seed)
+               ^ qHash(static_cast<int>(key.devicePixelRatio * 100), seed);
+    }
+};
+
+QMutex cacheMutex;
+QCache<CacheKey, QImage> cache{Identicon::CACHE_KB};
+} // namespace
 
 // The following constants change the appearance of the identicon
 // they have been choosen by trying to make the output look nice.
@@ -56,6 +85,8 @@
  * the rest controls the pixel placement
  */
 
+constexpr int Identicon::CACHE_KB;
+
 /**
  * @brief Creates an Identicon, that visualizes a hash in graphical form.
  * @param data Data to visualize
@@ -116,16 +147,22 @@ qreal Identicon::bytesToColor(QByteArray bytes)
  * @brief Writes the Identicon to a QImage
  * @param scaleFactor the image will be a square with scaleFactor * IDENTICON_ROWS pixels,
  *                    must be >= 1
+ * @param devicePixelRatio the image has devicePixelRatio times as many pixels, for high DPI
+ *                         screens
  * @return a QImage with the identicon
  */
-QImage Identicon::toImage(int scaleFactor)
+QImage Identicon::toImage(int scaleFactor, qreal devicePixelRatio)
 {
     if (scaleFactor < 1) {
         qDebug() << "Can't scale with values <1, clamping to 1";
         scaleFactor = 1;
     }
 
-    scaleFactor *= IDENTICON_ROWS;
+    if (devicePixelRatio < 1.0) {
+        devicePixelRatio = 1.0;
+    }
+
+    const int size = qRound(scaleFactor * IDENTICON_ROWS * devicePixelRatio);
 
     QImage pixels(IDENTICON_ROWS, IDENTICON_ROWS, QImage::Format_RGB888);
 
@@ -139,5 +176,35 @@ QImage Identicon::toImage(int scaleFactor)
     }
 
     // scale up without smoothing to make it look sharp
-    return pixels.scaled(scaleFactor, scaleFactor, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    QImage image = pixels.scaled(size, size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    image.setDevicePixelRatio(devicePixelRatio);
+    return image;
+}
+
+/**
+ * @brief Same as Identicon(data).toImage(scaleFactor, devicePixelRatio), but remembers the
+ * result.
+ *
+ * Contacts without an avatar all show their identicon, and every avatar size requested by the
+ * widgets would otherwise hash the key and scale the image again. The cache is bounded to
+ * CACHE_KB of image data and safe to use from any thread, so avatar loaders running on worker
+ * threads fill it lazily.
+ */
+QImage Identicon::cachedImage(const QByteArray& data, int scaleFactor, qreal devicePixelRatio)
+{
+    const CacheKey key{data, scaleFactor, devicePixelRatio};
+    {
+        QMutexLocker locker{&cacheMutex};
+        const QImage* cached = cache.object(key);
+        if (cached != nullptr) {
+            return *cached;
+        }
+    }
+
+    // render without holding the lock, a concurrent render of the same key is harmless
+    const QImage image = Identicon(data).toImage(scaleFactor, devicePixelRatio);
+    const int costKb = std::max(1, image.width() * image.height() * image.depth() / 8 / 1024);
+    QMutexLocker locker{&cacheMutex};
+    cache.insert(key, new QImage(image), costKb);
+    return image;
 }
@@ -26,12 +26,15 @@ class Identicon
 {
 public:
     Identicon(const QByteArray& data);
-    QImage toImage(int scaleFactor = 1);
+    QImage toImage(int scaleFactor = 1, qreal devicePixelRatio = 1.0);
+    static QImage cachedImage(const QByteArray& data, int scaleFactor = 1,
+                              qreal devicePixelRatio = 1.0);
     static qreal bytesToColor(QByteArray bytes);
 
 public:
     static constexpr int IDENTICON_ROWS = 5;
     static constexpr int IDENTICON_COLOR_BYTES = 6;
+    static constexpr int CACHE_KB = 4 * 1024;
 
 private:
     static constexpr int COLORS = 2;
@@ -27,6 +27,9 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsView>
 #include <QMouseEvent>
+#include <QOpenGLContext>
+#include <QOpenGLWidget>
+#include <QPainter>
 #include <QScreen>
 #include <QTimer>
 
@@ -35,6 +38,26 @@
 #include "toolboxgraphicsitem.h"
 #include "src/widget/widget.h"
 
+#include <algorithm>
+
+/**
+ * @class ScreenshotGrabber
+ * @brief Fullscreen overlay to select a region of the desktop.
+ *
+ * Every screen is grabbed on its own at its native resolution and shown as a separate item,
+ * instead of grabbing the whole virtual desktop into one pixmap, which also covers the gaps
+ * between differently sized screens. The view is composited with OpenGL if it's available.
+ * Only the accepted region is copied out of the screen grabs.
+ */
+
+namespace {
+bool isOpenGLAvailable()
+{
+    QOpenGLContext context;
+    return context.create();
+}
+} // namespace
+
 ScreenshotGrabber::ScreenshotGrabber()
     : QObject()
     , mKeysBlocked(false)
@@ -48,6 +71,10 @@ ScreenshotGrabber::ScreenshotGrabber()
     window->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     window->setFrameShape(QFrame::NoFrame);
     window->installEventFilter(this);
+    if (isOpenGLAvailable()) {
+        window->setViewport(new QOpenGLWidget);
+        window->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    }
     pixRatio = QApplication::primaryScreen()->devicePixelRatio();
 
     setupScene();
@@ -77,14 +104,19 @@ bool ScreenshotGrabber::eventFilter(QObject* object, QEvent* event)
 
 void ScreenshotGrabber::showGrabber()
 {
-    screenGrab = grabScreen();
-    screenGrabDisplay->setPixmap(screenGrab);
+    grabScreens();
+    for (const ScreenCapture& capture : screenGrabs) {
+        QGraphicsPixmapItem* display = scene->addPixmap(capture.pixmap);
+        display->setPos(capture.geometry.topLeft());
+        display->setZValue(-1);
+    }
+
     window->show();
     window->setFocus();
     window->grabKeyboard();
 
-    QRect fullGrabbedRect = screenGrab.rect();
-    QRect rec = QApplication::primaryScreen()->virtualGeometry();
+    const QRect rec = QApplication::primaryScreen()->virtualGeometry();
+    const QRect fullGrabbedRect{QPoint(), rec.size()};
 
     window->setGeometry(rec);
     scene->setSceneRect(fullGrabbedRect);
@@ -120,17 +152,17 @@ bool ScreenshotGrabber::handleKeyPress(QKeyEvent* event)
 
 void ScreenshotGrabber::acceptRegion()
 {
-    QRect rect = chooserRect->chosenRect();
+    const QRect rect = chooserRect->chosenRect();
     if (rect.width() < 1 || rect.height() < 1)
         return;
 
     // Scale the accepted region from DIPs to actual pixels
-    rect.setRect(rect.x() * pixRatio, rect.y() * pixRatio, rect.width() * pixRatio,
-                 rect.height() * pixRatio);
+    const QRect pixelRect(rect.x() * pixRatio, rect.y() * pixRatio, rect.width() * pixRatio,
+                          rect.height() * pixRatio);
 
-    emit regionChosen(rect);
-    qDebug() << "Screenshot accepted, chosen region" << rect;
-    QPixmap pixmap = screenGrab.copy(rect);
+    emit regionChosen(pixelRect);
+    qDebug() << "Screenshot accepted, chosen region" << pixelRect;
+    QPixmap pixmap = cropRegion(rect);
     restoreHiddenWindows();
     emit screenshotTaken(pixmap);
 
@@ -146,7 +178,6 @@ void ScreenshotGrabber::setupScene()
     overlay = new ScreenGrabberOverlayItem(this);
     helperToolbox = new ToolBoxGraphicsItem;
 
-    screenGrabDisplay = scene->addPixmap(screenGrab);
     helperTooltip = scene->addText(QString());
 
     scene->addItem(overlay);
@@ -222,14 +253,65 @@ void ScreenshotGrabber::reject()
     deleteLater();
 }
 
-QPixmap ScreenshotGrabber::grabScreen()
+void ScreenshotGrabber::grabScreens()
 {
-    QScreen* screen = QGuiApplication::primaryScreen();
-    QRect rec = screen->virtualGeometry();
+    screenGrabs.clear();
+    const QPoint origin = QGuiApplication::primaryScreen()->virtualGeometry().topLeft();
+
+    for (QScreen* screen : QGuiApplication::screens()) {
+        // grabs only this screen, at its own device pixel ratio
+        QPixmap pixmap = screen->grabWindow(0);
+        if (pixmap.isNull()) {
+            qWarning() << "Failed to grab screen" << screen->name();
+            continue;
+        }
+
+        pixmap.setDevicePixelRatio(screen->devicePixelRatio());
+        screenGrabs.push_back({screen->geometry().translated(-origin), pixmap});
+    }
+}
+
+/**
+ * @brief Copies a region out of the screen grabs.
+ * @param region Region in device independent pixels of the scene.
+ * @return The region at the highest resolution of the screens it covers.
+ */
+QPixmap ScreenshotGrabber::cropRegion(QRect region) const
+{
+    QVector<const ScreenCapture*> covered;
+    qreal ratio = 1.0;
+    for (const ScreenCapture& capture : screenGrabs) {
+        if (capture.geometry.intersects(region)) {
+            covered << &capture;
+            ratio = std::max(ratio, capture.pixmap.devicePixelRatio());
+        }
+    }
+
+    const auto toPixels = [](QRect rect, qreal dpr) {
+        return QRect(rect.x() * dpr, rect.y() * dpr, rect.width() * dpr, rect.height() * dpr);
+    };
+
+    if (covered.size() == 1) {
+        const ScreenCapture& capture = *covered.first();
+        const QRect local =
+            region.intersected(capture.geometry).translated(-capture.geometry.topLeft());
+        return capture.pixmap.copy(toPixels(local, capture.pixmap.devicePixelRatio()));
+    }
+
+    // region spans screens, compose only the selected parts
+    QPixmap result{region.size() * ratio};
+    result.setDevicePixelRatio(ratio);
+    result.fill(Qt::black);
+
+    QPainter painter{&result};
+    for (const ScreenCapture* capture : covered) {
+        const QRect part = region.intersected(capture->geometry);
+        const QRect source = toPixels(part.translated(-capture->geometry.topLeft()),
+                                      capture->pixmap.devicePixelRatio());
+        painter.drawPixmap(part.translated(-region.topLeft()), capture->pixmap, source);
+    }
 
-    // Multiply by devicePixelRatio to get actual desktop size
-    return screen->grabWindow(QApplication::desktop()->winId(), rec.x() * pixRatio,
-                              rec.y() * pixRatio, rec.width() * pixRatio, rec.height() * pixRatio);
+    return result;
 }
 
 void ScreenshotGrabber::hideVisibleWindows()
@@ -21,6 +21,8 @@
 
 #include <QPixmap>
 #include <QPointer>
+#include <QRect>
+#include <QVector>
 
 class QGraphicsSceneMouseEvent;
 class QGraphicsPixmapItem;
@@ -67,7 +69,8 @@ private:
     bool handleKeyPress(QKeyEvent* event);
     void reject();
 
-    QPixmap grabScreen();
+    void grabScreens();
+    QPixmap cropRegion(QRect region) const;
 
     void hideVisibleWindows();
     void restoreHiddenWindows();
@@ -75,10 +78,16 @@ private:
     void beginRectChooser(QGraphicsSceneMouseEvent* event);
 
 private:
-    QPixmap screenGrab;
+    struct ScreenCapture
+    {
+        // in device independent pixels, relative to the top left of the virtual desktop
+        QRect geometry;
+        QPixmap pixmap;
+    };
+
+    QVector<ScreenCapture> screenGrabs;
     QGraphicsScene* scene;
     QGraphicsView* window;
-    QGraphicsPixmapItem* screenGrabDisplay;
     ScreenGrabberOverlayItem* overlay;
     ScreenGrabberChooserRectItem* chooserRect;
     ToolBoxGraphicsItem* helperToolbox;
@@ -0,0 +1,193 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "spellcheckhighlighter.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QTextBlock>
+#include <QTextBoundaryFinder>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <QThread>
+
+/**
+ * @class SpellCheckHighlighter
+ * @brief Spell checking highlighter that never checks words on the GUI thread.
+ *
+ * Sonnet's own highlighter asks the speller for every word of a paragraph whenever it changes,
+ * so pasting a long text blocks the GUI. QSyntaxHighlighter already only calls highlightBlock()
+ * for changed paragraphs, this highlighter then only looks the words up in a cache shared by all
+ * chats, per dictionary. Unknown words are collected for one event loop iteration and sent to
+ * SpellCheckWorker, once the results arrive the waiting paragraphs are highlighted again.
+ *
+ * @class SpellCheckWorker
+ * @brief Checks words with Sonnet on a low priority background thread.
+ */
+
+constexpr int SpellCheckHighlighter::MAX_CACHED_WORDS;
+
+namespace {
+/**
+ * @brief Word -> correctly spelled, per dictionary. Only used on the GUI thread.
+ */
+QHash<QString, QHash<QString, bool>>& wordCache()
+{
+    static QHash<QString, QHash<QString, bool>> cache;
+    return cache;
+}
+
+bool isCheckable(const QString& word)
+{
+    if (word.size() < 2) {
+        return false;
+    }
+
+    bool hasLetter = false;
+    for (const QChar c : word) {
+        if (c.isDigit()) {
+            return false;
+        }
+        hasLetter = hasLetter || c.isLetter();
+    }
+    return hasLetter;
+}
+} // namespace
+
+SpellCheckWorker& SpellCheckWorker::getInstance()
+{
+    static SpellCheckWorker* worker = [] {
+        QThread* thread = new QThread(qApp);
+        thread->setObjectName("qTox SpellCheck");
+        SpellCheckWorker* newWorker = new SpellCheckWorker();
+        newWorker->moveToThread(thread);
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, thread, [thread] {
+            thread->quit();
+            thread->wait();
+        });
+        thread->start(QThread::LowPriority);
+        return newWorker;
+    }();
+    return *worker;
+}
+
+/**
+ * @brief Checks the words with the given dictionary, runs on the worker thread.
+ */
+void SpellCheckWorker::checkWords(const QString& language, const QStringList& words)
+{
+    if (!speller) {
+        speller.reset(new Sonnet::Speller(language));
+    } else if (speller->language() != language) {
+        speller->setLanguage(language);
+    }
+
+    QStringList misspelled;
+    for (const QString& word : words) {
+        if (speller->isMisspelled(word)) {
+            misspelled << word;
+        }
+    }
+
+    emit wordsChecked(language, words, misspelled);
+}
+
+SpellCheckHighlighter::SpellCheckHighlighter(QTextEdit* textEdit_)
+    : Sonnet::Highlighter(textEdit_)
+    , textEdit{textEdit_}
+{
+    requestTimer.setSingleShot(true);
+    requestTimer.setInterval(0);
+    connect(&requestTimer, &QTimer::timeout, this, &SpellCheckHighlighter::requestPending);
+
+    SpellCheckWorker& worker = SpellCheckWorker::getInstance();
+    connect(this, &SpellCheckHighlighter::checkRequested, &worker, &SpellCheckWorker::checkWords);
+    connect(&worker, &SpellCheckWorker::wordsChecked, this, &SpellCheckHighlighter::onWordsChecked);
+}
+
+void SpellCheckHighlighter::highlightBlock(const QString& text)
+{
+    if (!isActive() || text.isEmpty()) {
+        return;
+    }
+
+    const QHash<QString, bool>& words = wordCache()[currentLanguage()];
+    bool hasUnknown = false;
+
+    QTextBoundaryFinder finder{QTextBoundaryFinder::Word, text};
+    int start = 0;
+    for (int end = finder.toNextBoundary(); end >= 0; end = finder.toNextBoundary()) {
+        if (finder.boundaryReasons() & QTextBoundaryFinder::EndOfItem) {
+            const QString word = text.mid(start, end - start);
+            if (isCheckable(word)) {
+                const auto it = words.constFind(word);
+                if (it == words.constEnd()) {
+                    unknownWords.insert(word);
+                    hasUnknown = true;
+                } else if (!it.value()) {
+                    setMisspelled(start, end - start);
+                }
+            }
+        }
+        start = end;
+    }
+
+    if (hasUnknown) {
+        pendingBlocks.insert(currentBlock().blockNumber());
+        requestTimer.start();
+    }
+}
+
+void SpellCheckHighlighter::requestPending()
+{
+    if (unknownWords.isEmpty()) {
+        return;
+    }
+
+    emit checkRequested(currentLanguage(), unknownWords.toList());
+    unknownWords.clear();
+}
+
+void SpellCheckHighlighter::onWordsChecked(const QString& language, const QStringList& words,
+                                           const QStringList& misspelled)
+{
+    QHash<QString, bool>& cache = wordCache()[language];
+    if (cache.size() + words.size() > MAX_CACHED_WORDS) {
+        cache.clear();
+    }
+
+    const QSet<QString> misspelledSet = misspelled.toSet();
+    for (const QString& word : words) {
+        cache.insert(word, !misspelledSet.contains(word));
+    }
+
+    if (language != currentLanguage() || pendingBlocks.isEmpty()) {
+        return;
+    }
+
+    const QSet<int> blocks = pendingBlocks;
+    pendingBlocks.clear();
+    for (const int blockNumber : blocks) {
+        const QTextBlock block = textEdit->document()->findBlockByNumber(blockNumber);
+        if (block.isValid()) {
+            rehighlightBlock(block);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <KF5/SonnetCore/sonnet/speller.h>
+#include <KF5/SonnetUi/sonnet/highlighter.h>
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <memory>
+
+class QTextEdit;
+
+class SpellCheckWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SpellCheckWorker& getInstance();
+
+public slots:
+    void checkWords(const QString& language, const QStringList& words);
+
+signals:
+    void wordsChecked(const QString& language, const QStringList& words,
+                      const QStringList& misspelled);
+
+private:
+    SpellCheckWorker() = default;
+
+private:
+    std::unique_ptr<Sonnet::Speller> speller;
+};
+
+class SpellCheckHighlighter : public Sonnet::Highlighter
+{
+    Q_OBJECT
+
+public:
+    explicit SpellCheckHighlighter(QTextEdit* textEdit);
+
+    static constexpr int MAX_CACHED_WORDS = 50000;
+
+signals:
+    void checkRequested(const QString& language, const QStringList& words);
+
+protected:
+    void highlightBlock(const QString& text) override;
+
+private slots:
+    void requestPending();
+    void onWordsChecked(const QString& language, const QStringList& words,
+                        const QStringList& misspelled);
+
+private:
+    QTextEdit* textEdit;
+    QTimer requestTimer;
+    QSet<QString> unknownWords;
+    QSet<int> pendingBlocks;
+};
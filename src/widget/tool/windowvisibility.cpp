@@ -0,0 +1,129 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "windowvisibility.h"
+
+#include <QEvent>
+#include <QWidget>
+#include <QWindow>
+
+/**
+ * @class WindowVisibility
+ * @brief Tells whether the window of a widget can currently be seen.
+ *
+ * A window can't be seen while it is hidden, minimized or not exposed, which is how platforms
+ * that track it report a window that is fully covered or on another virtual desktop. Widgets
+ * use this to skip rendering that nobody would see and catch up once renderedChanged() reports
+ * the window as visible again.
+ *
+ * The widget may be moved to another window, e.g. when a chat is moved to a detached
+ * ContentDialog, which is picked up the next time the widget is shown.
+ */
+
+/**
+ * @param widget Widget to track the window of, also the parent of this object.
+ */
+WindowVisibility::WindowVisibility(QWidget* widget_)
+    : QObject{widget_}
+    , widget{widget_}
+    , rendered{isRendered(widget_)}
+{
+    widget->installEventFilter(this);
+    watchWindow();
+}
+
+/**
+ * @brief Whether the window of the tracked widget can be seen.
+ */
+bool WindowVisibility::isRendered() const
+{
+    return rendered;
+}
+
+/**
+ * @brief Whether the window of a widget can be seen, without tracking it.
+ * @note The widget itself may still be hidden inside of a visible window.
+ */
+bool WindowVisibility::isRendered(const QWidget* widget)
+{
+    const QWidget* top = widget->window();
+    if (!top->isVisible() || top->isMinimized()) {
+        return false;
+    }
+
+    const QWindow* topHandle = top->windowHandle();
+    return !topHandle || topHandle->isExposed();
+}
+
+bool WindowVisibility::eventFilter(QObject* watched, QEvent* event)
+{
+    switch (event->type()) {
+    case QEvent::Show:
+        watchWindow();
+        update();
+        break;
+    case QEvent::Hide:
+    case QEvent::WindowStateChange:
+    case QEvent::Expose:
+        update();
+        break;
+    default:
+        break;
+    }
+
+    return QObject::eventFilter(watched, event);
+}
+
+void WindowVisibility::watchWindow()
+{
+    QWidget* top = widget->window();
+    if (top != window) {
+        if (window && window != widget) {
+            window->removeEventFilter(this);
+        }
+        window = top;
+        if (window != widget) {
+            window->installEventFilter(this);
+        }
+    }
+
+    // the native window only exists once the window was shown
+    QWindow* topHandle = window->windowHandle();
+    if (topHandle != handle) {
+        if (handle) {
+            handle->removeEventFilter(this);
+        }
+        handle = topHandle;
+        if (handle) {
+            handle->installEventFilter(this);
+        }
+    }
+}
+
+void WindowVisibility::update()
+{
+    const bool nowRendered = isRendered(widget);
+    if (nowRendered == rendered) {
+        return;
+    }
+
+    rendered = nowRendered;
+    emit renderedChanged(rendered);
+}
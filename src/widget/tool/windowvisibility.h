@@ -0,0 +1,54 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+
+class QWidget;
+class QWindow;
+
+class WindowVisibility : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WindowVisibility(QWidget* widget);
+
+    bool isRendered() const;
+    static bool isRendered(const QWidget* widget);
+
+signals:
+    void renderedChanged(bool rendered);
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    void watchWindow();
+    void update();
+
+private:
+    QWidget* widget;
+    QPointer<QWidget> window;
+    QPointer<QWindow> handle;
+    bool rendered;
+};
@@ -21,17 +21,55 @@
 #include "translator.h"
 #include <QApplication>
 #include <QDebug>
+#include <QEvent>
 #include <QLibraryInfo>
 #include <QLocale>
 #include <QMutexLocker>
 #include <QString>
 #include <QTranslator>
+#include <QWidget>
 #include <algorithm>
+#include <vector>
+
+/**
+ * @brief Retranslates stale widgets right before they are shown.
+ */
+class Translator::ShowFilter : public QObject
+{
+public:
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if (event->type() != QEvent::Show) {
+            return false;
+        }
+
+        watched->removeEventFilter(this);
+
+        // handlers may register new handlers, so they run without the lock
+        std::vector<std::function<void()>> pending;
+        {
+            QMutexLocker locker{&lock};
+            for (Callback& c : callbacks) {
+                if (c.stale && c.widget == watched) {
+                    c.stale = false;
+                    pending.push_back(c.f);
+                }
+            }
+        }
+
+        for (const auto& f : pending) {
+            f();
+        }
+
+        return false;
+    }
+};
 
 QTranslator* Translator::core_translator{nullptr};
 QTranslator* Translator::app_translator{nullptr};
 QVector<Translator::Callback> Translator::callbacks;
 QMutex Translator::lock;
+Translator::ShowFilter* Translator::showFilter{nullptr};
 
 /**
  * @brief Loads the translations according to the settings or locale.
@@ -81,8 +119,22 @@ void Translator::translate(const QString& localeName)
 
     QGuiApplication::setLayoutDirection(direction == "RTL" ? Qt::RightToLeft : Qt::LeftToRight);
 
-    for (auto pair : callbacks)
-        pair.second();
+    if (!showFilter)
+        showFilter = new ShowFilter();
+
+    for (Callback& c : callbacks) {
+        // hidden widgets only get retranslated once they are shown again
+        if (c.widget && !c.widget->isVisible()) {
+            if (!c.stale) {
+                c.stale = true;
+                c.widget->installEventFilter(showFilter);
+            }
+            continue;
+        }
+
+        c.stale = false;
+        c.f();
+    }
 }
 
 /**
@@ -93,7 +145,23 @@ void Translator::translate(const QString& localeName)
 void Translator::registerHandler(const std::function<void()>& f, void* owner)
 {
     QMutexLocker locker{&lock};
-    callbacks.push_back({owner, f});
+    callbacks.push_back({owner, f, nullptr, false});
+}
+
+/**
+ * @brief Register a function to be called when the UI needs to be retranslated, but only while
+ * the widget is visible.
+ * @param f Function, wich will called.
+ * @param owner Owner to unregister the handler with, usually the widget itself.
+ * @param widget Widget showing the translated strings.
+ *
+ * If the language changes while the widget is hidden, it is marked stale and f is called the next
+ * time the widget is shown. Language switches then only cost what is on screen.
+ */
+void Translator::registerLazyHandler(const std::function<void()>& f, void* owner, QWidget* widget)
+{
+    QMutexLocker locker{&lock};
+    callbacks.push_back({owner, f, widget, false});
 }
 
 /**
@@ -104,6 +172,6 @@ void Translator::unregister(void* owner)
 {
     QMutexLocker locker{&lock};
     callbacks.erase(std::remove_if(begin(callbacks), end(callbacks),
-                                   [=](const Callback& c) { return c.first == owner; }),
+                                   [=](const Callback& c) { return c.owner == owner; }),
                     end(callbacks));
 }
@@ -21,23 +21,32 @@
 #pragma once
 
 #include <QMutex>
-#include <QPair>
 #include <QVector>
 #include <functional>
 
 class QTranslator;
+class QWidget;
 
 class Translator
 {
 public:
     static void translate(const QString& localeName);
     static void registerHandler(const std::function<void()>& f, void* owner);
+    static void registerLazyHandler(const std::function<void()>& f, void* owner, QWidget* widget);
     static void unregister(void* owner);
 
 private:
-    using Callback = QPair<void*, std::function<void()>>;
+    class ShowFilter;
+    struct Callback
+    {
+        void* owner;
+        std::function<void()> f;
+        QWidget* widget;
+        bool stale;
+    };
     static QVector<Callback> callbacks;
     static QMutex lock;
+    static ShowFilter* showFilter;
     static QTranslator* core_translator;
     static QTranslator* app_translator;
 };
@@ -22,7 +22,6 @@
 #include <cassert>
 
 #include <QClipboard>
-#include <QCryptographicHash>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDesktopWidget>
@@ -52,6 +51,7 @@
 #include "form/groupchatform.h"
 #include "src/chatlog/content/filetransferwidget.h"
 #include "src/chatlog/documentcache.h"
+#include "src/chatlog/pixmapcache.h"
 #include "src/core/core.h"
 #include "src/core/coreav.h"
 #include "src/core/corefile.h"
@@ -85,6 +85,7 @@
 #include "src/persistence/smileypack.h"
 #include "src/persistence/toxsave.h"
 #include "src/ipc.h"
+#include "util/startupprofiler.h"
 
 namespace {
 
@@ -178,6 +179,7 @@ Widget::Widget(Profile &profile_, IAudioControl& audio_, CameraSource& cameraSou
 
 void Widget::init()
 {
+    StartupPhase phase{"Widget::init"};
     auto history_cur = profile.getHistory();
     Widget::sqlcipher_version = history_cur->getSqlcipherVersion();
 
@@ -310,26 +312,24 @@ void Widget::init()
     style.setThemeColor(settings, settings.getThemeColor());
 
     CoreFile* coreFile = core->getCoreFile();
-    filesForm = new FilesForm(*coreFile, settings, style, *messageBoxManager, *friendList);
-    addFriendForm = new AddFriendForm(core->getSelfId(), settings, style,
-        *messageBoxManager, *core);
-    groupInviteForm = new GroupInviteForm(settings, *core);
+    // the files, add friend, group invite, settings and profile forms are built on first use,
+    // most sessions never open settings and its device enumeration is slow
 
-    settingsWidget = new SettingsWidget(updateCheck.get(), audio, core, *smileyPack,
-        cameraSource, settings, style, *messageBoxManager, profile, this);
-
-    profileInfo = new ProfileInfo(core, &profile, settings, nexus);
-    profileForm = new ProfileForm(profileInfo, settings, style, *messageBoxManager);
+    connect(&contactUpdates, &ContactUpdateCoalescer::friendsUpdated, this, &Widget::onFriendsUpdated);
+    connect(&contactUpdates, &ContactUpdateCoalescer::groupsUpdated, this, &Widget::onGroupsUpdated);
+    connect(&friendRequestIntake, &FriendRequestIntake::requestsReceived, this,
+            &Widget::onFriendRequestsReceived);
 
 #if DESKTOP_NOTIFICATIONS
     notificationGenerator.reset(new NotificationGenerator(settings, &profile));
     connect(&notifier, &DesktopNotify::notificationClosed, notificationGenerator.get(), &NotificationGenerator::onNotificationActivated);
+    connect(&notifier, &DesktopNotify::notificationClosed, &notificationCoalescer, &NotificationCoalescer::clear);
+    connect(&notificationCoalescer, &NotificationCoalescer::notificationReady, &notifier, &DesktopNotify::notifyMessage);
 #endif
 
     // connect logout tray menu action
-    connect(actionLogout, &QAction::triggered, profileForm, &ProfileForm::onLogoutClicked);
-
-    connect(&profile, &Profile::selfAvatarChanged, profileForm, &ProfileForm::onSelfAvatarLoaded);
+    connect(actionLogout, &QAction::triggered, this,
+            [this]() { getProfileForm()->onLogoutClicked(); });
 
     connect(coreFile, &CoreFile::fileReceiveRequested, this, &Widget::onFileReceiveRequested);
     connect(ui->addButton, &QPushButton::clicked, this, &Widget::onAddClicked);
@@ -340,9 +340,6 @@ void Widget::init()
     connect(ui->nameLabel, &CroppingLabel::clicked, this, &Widget::showProfile);
     connect(ui->statusLabel, &CroppingLabel::editFinished, this, &Widget::onStatusMessageChanged);
     connect(ui->mainSplitter, &QSplitter::splitterMoved, this, &Widget::onSplitterMoved);
-    connect(addFriendForm, &AddFriendForm::friendRequested, this, &Widget::friendRequested);
-    connect(addFriendForm, &AddFriendForm::NgcRequested, this, &Widget::NgcRequested);
-    connect(groupInviteForm, &GroupInviteForm::groupCreate, core, &Core::createGroup);
     connect(timer, &QTimer::timeout, this, &Widget::onUserAwayCheck);
     connect(timer, &QTimer::timeout, this, &Widget::onEventIconTick);
     connect(timer, &QTimer::timeout, this, &Widget::onTryCreateTrayIcon);
@@ -460,7 +457,7 @@ void Widget::init()
     aboutAction->setMenuRole(QAction::AboutRole);
     connect(aboutAction, &QAction::triggered, [this]() {
         onShowSettings();
-        settingsWidget->showAbout();
+        getSettingsWidget()->showAbout();
     });
 
     QMenu* dockChangeStatusMenu = new QMenu(tr("Status"), this);
@@ -496,13 +493,6 @@ void Widget::init()
     groupInvitesButton = nullptr;
     unreadGroupInvites = 0;
 
-    connect(addFriendForm, &AddFriendForm::friendRequested, this, &Widget::friendRequestsUpdate);
-    connect(addFriendForm, &AddFriendForm::friendRequestsSeen, this, &Widget::friendRequestsUpdate);
-    connect(addFriendForm, &AddFriendForm::friendRequestAccepted, this, &Widget::friendRequestAccepted);
-    connect(groupInviteForm, &GroupInviteForm::groupInvitesSeen, this, &Widget::groupInvitesClear);
-    connect(groupInviteForm, &GroupInviteForm::groupInviteAccepted, this,
-            &Widget::onGroupInviteAccepted);
-
     // settings
     connect(&settings, &Settings::showSystemTrayChanged, this, &Widget::onSetShowSystemTray);
     connect(&settings, &Settings::separateWindowChanged, this, &Widget::onSeparateWindowClicked);
@@ -664,7 +654,86 @@ Widget::~Widget()
 void Widget::showUpdateDownloadProgress()
 {
     onShowSettings();
-    settingsWidget->showAbout();
+    getSettingsWidget()->showAbout();
+}
+
+/**
+ * @brief Returns the file transfer form, creating it on first use.
+ */
+FilesForm* Widget::getFilesForm()
+{
+    if (!filesForm) {
+        filesForm = new FilesForm(*core->getCoreFile(), settings, style, *messageBoxManager,
+                                  *friendList);
+    }
+
+    return filesForm;
+}
+
+/**
+ * @brief Returns the add friend form, creating it on first use.
+ */
+AddFriendForm* Widget::getAddFriendForm()
+{
+    if (!addFriendForm) {
+        addFriendForm = new AddFriendForm(core->getSelfId(), settings, style, *messageBoxManager,
+                                          *core);
+        connect(addFriendForm, &AddFriendForm::friendRequested, this, &Widget::friendRequested);
+        connect(addFriendForm, &AddFriendForm::NgcRequested, this, &Widget::NgcRequested);
+        connect(addFriendForm, &AddFriendForm::friendRequested, this,
+                &Widget::friendRequestsUpdate);
+        connect(addFriendForm, &AddFriendForm::friendRequestsSeen, this,
+                &Widget::friendRequestsUpdate);
+        connect(addFriendForm, &AddFriendForm::friendRequestAccepted, this,
+                &Widget::friendRequestAccepted);
+    }
+
+    return addFriendForm;
+}
+
+/**
+ * @brief Returns the group invite form, creating it on first use.
+ */
+GroupInviteForm* Widget::getGroupInviteForm()
+{
+    if (!groupInviteForm) {
+        groupInviteForm = new GroupInviteForm(settings, *core);
+        connect(groupInviteForm, &GroupInviteForm::groupCreate, core, &Core::createGroup);
+        connect(groupInviteForm, &GroupInviteForm::groupInvitesSeen, this,
+                &Widget::groupInvitesClear);
+        connect(groupInviteForm, &GroupInviteForm::groupInviteAccepted, this,
+                &Widget::onGroupInviteAccepted);
+    }
+
+    return groupInviteForm;
+}
+
+/**
+ * @brief Returns the settings widget, creating it on first use.
+ */
+SettingsWidget* Widget::getSettingsWidget()
+{
+    if (!settingsWidget) {
+        settingsWidget = new SettingsWidget(updateCheck.get(), audio, core, *smileyPack,
+                                            cameraSource, settings, style, *messageBoxManager,
+                                            profile, this);
+    }
+
+    return settingsWidget;
+}
+
+/**
+ * @brief Returns the profile form, creating it on first use.
+ */
+ProfileForm* Widget::getProfileForm()
+{
+    if (!profileForm) {
+        profileInfo = new ProfileInfo(core, &profile, settings, nexus);
+        profileForm = new ProfileForm(profileInfo, settings, style, *messageBoxManager);
+        profileForm->onSelfAvatarLoaded(selfAvatar);
+    }
+
+    return profileForm;
 }
 
 void Widget::moveEvent(QMoveEvent* event)
@@ -715,7 +784,11 @@ QString Widget::getUsername()
 
 void Widget::onSelfAvatarLoaded(const QPixmap& pic)
 {
+    selfAvatar = pic;
     profilePicture->setPixmap(pic);
+    if (profileForm) {
+        profileForm->onSelfAvatarLoaded(pic);
+    }
 }
 
 void Widget::onCoreChanged(Core& core_)
@@ -728,26 +801,34 @@ void Widget::onCoreChanged(Core& core_)
     connect(core, &Core::statusMessageSet, this, &Widget::setStatusMessage);
     connect(core, &Core::friendAdded, this, &Widget::addFriend);
     connect(core, &Core::failedToAddFriend, this, &Widget::addFriendFailed);
-    connect(core, &Core::friendUsernameChanged, this, &Widget::onFriendUsernameChanged);
-    connect(core, &Core::friendLoaded, this, &Widget::onFriendLoaded);
-    connect(core, &Core::friendStatusChanged, this, &Widget::onCoreFriendStatusChanged);
-    connect(core, &Core::friendStatusMessageChanged, this, &Widget::onFriendStatusMessageChanged);
-    connect(core, &Core::friendRequestReceived, this, &Widget::onFriendRequestReceived);
+    // updates coming in bursts are applied once per event loop turn, see onFriendsUpdated()
+    connect(core, &Core::friendUsernameChanged, &contactUpdates, &ContactUpdateCoalescer::onFriendUsernameChanged);
+    connect(core, &Core::friendsLoaded, this, &Widget::onFriendsLoaded);
+    connect(core, &Core::friendStatusChanged, &contactUpdates, &ContactUpdateCoalescer::onFriendStatusChanged);
+    connect(core, &Core::friendStatusMessageChanged, &contactUpdates, &ContactUpdateCoalescer::onFriendStatusMessageChanged);
+    // spam waves are queued and handed over in small batches, see FriendRequestIntake
+    connect(core, &Core::friendRequestReceived, &friendRequestIntake, &FriendRequestIntake::onFriendRequestReceived);
     connect(core, &Core::friendMessageReceived, this, &Widget::onFriendMessageReceived);
     connect(core, &Core::friendPushtokenReceived, this, &Widget::onFriendPushtokenReceived);
     connect(core, &Core::onFriendConnectionStatusFullChanged, this, &Widget::onFriendConnectionStatusFullChanged);
     connect(core, &Core::receiptRecieved, this, &Widget::onReceiptReceived);
+    connect(core, &Core::friendMessageSent, this, &Widget::onFriendMessageSent);
+    connect(core, &Core::friendMessagesRefused, this, &Widget::onFriendMessagesRefused);
     connect(core, &Core::groupInviteReceived, this, &Widget::onGroupInviteReceived);
     connect(core, &Core::groupMessageReceived, this, &Widget::onGroupMessageReceived);
     connect(core, &Core::groupMessageReceivedImage, this, &Widget::onGroupMessageReceivedImage);
     connect(core, &Core::groupSyncHistoryReqReceived, this, &Widget::onGroupSyncHistoryReqReceived);
-    connect(core, &Core::groupPeerlistChanged, this, &Widget::onGroupPeerlistChanged);
-    connect(core, &Core::groupPeerNameChanged, this, &Widget::onGroupPeerNameChanged);
+    connect(core, &Core::groupSyncMessageReceived, this, &Widget::onGroupSyncMessageReceived);
+    connect(core, &Core::groupPeerlistChanged, &contactUpdates, &ContactUpdateCoalescer::onGroupPeerlistChanged);
+    connect(core, &Core::groupPeerNameChanged, &contactUpdates, &ContactUpdateCoalescer::onGroupPeerNameChanged);
+    connect(core, &Core::groupPeerJoined, &contactUpdates, &ContactUpdateCoalescer::onGroupPeerJoined);
+    connect(core, &Core::groupPeerExited, &contactUpdates, &ContactUpdateCoalescer::onGroupPeerExited);
+    connect(core, &Core::groupPeerRenamed, &contactUpdates, &ContactUpdateCoalescer::onGroupPeerRenamed);
     connect(core, &Core::groupTitleChanged, this, &Widget::onGroupTitleChanged);
-    connect(core, &Core::groupPeerAudioPlaying, this, &Widget::onGroupPeerAudioPlaying);
     connect(core, &Core::emptyGroupCreated, this, &Widget::onEmptyGroupCreated);
+    connect(core, &Core::groupsLoaded, this, &Widget::onGroupsLoaded);
     connect(core, &Core::groupJoined, this, &Widget::onGroupJoined);
-    connect(core, &Core::friendTypingChanged, this, &Widget::onFriendTypingChanged);
+    connect(core, &Core::friendTypingChanged, &contactUpdates, &ContactUpdateCoalescer::onFriendTypingChanged);
     connect(core, &Core::groupSentFailed, this, &Widget::onGroupSendFailed);
     connect(core, &Core::usernameSet, this, &Widget::refreshPeerListsLocal);
 
@@ -763,6 +844,11 @@ void Widget::onCoreChanged(Core& core_)
     connect(this, &Widget::friendRequestAccepted, core, &Core::acceptFriendRequest);
     connect(this, &Widget::changeGroupTitle, core, &Core::changeGroupTitle);
 
+    auto history = profile.getHistory();
+    if (history) {
+        connect(history, &History::groupSyncPacketsReady, core, &Core::queueGroupSyncPackets);
+    }
+
     sharedMessageProcessorParams->setPublicKey(core->getSelfPublicKey().toString());
 }
 
@@ -909,14 +995,14 @@ void Widget::forceShow()
 void Widget::onAddClicked()
 {
     if (settings.getSeparateWindow()) {
-        if (!addFriendForm->isShown()) {
+        if (!getAddFriendForm()->isShown()) {
             addFriendForm->show(createContentDialog(DialogType::AddDialog));
         }
 
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     } else {
         hideMainForms(nullptr);
-        addFriendForm->show(contentLayout);
+        getAddFriendForm()->show(contentLayout);
         setWindowTitle(fromDialogType(DialogType::AddDialog));
         setActiveToolMenuButton(ActiveToolMenuButton::AddButton);
     }
@@ -925,14 +1011,14 @@ void Widget::onAddClicked()
 void Widget::onGroupClicked()
 {
     if (settings.getSeparateWindow()) {
-        if (!groupInviteForm->isShown()) {
+        if (!getGroupInviteForm()->isShown()) {
             groupInviteForm->show(createContentDialog(DialogType::GroupDialog));
         }
 
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     } else {
         hideMainForms(nullptr);
-        groupInviteForm->show(contentLayout);
+        getGroupInviteForm()->show(contentLayout);
         setWindowTitle(fromDialogType(DialogType::GroupDialog));
         setActiveToolMenuButton(ActiveToolMenuButton::GroupButton);
     }
@@ -941,14 +1027,14 @@ void Widget::onGroupClicked()
 void Widget::onTransferClicked()
 {
     if (settings.getSeparateWindow()) {
-        if (!filesForm->isShown()) {
+        if (!getFilesForm()->isShown()) {
             filesForm->show(createContentDialog(DialogType::TransferDialog));
         }
 
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     } else {
         hideMainForms(nullptr);
-        filesForm->show(contentLayout);
+        getFilesForm()->show(contentLayout);
         setWindowTitle(fromDialogType(DialogType::TransferDialog));
         setActiveToolMenuButton(ActiveToolMenuButton::TransferButton);
     }
@@ -981,14 +1067,14 @@ void Widget::onIconClick(QSystemTrayIcon::ActivationReason reason)
 void Widget::onShowSettings()
 {
     if (settings.getSeparateWindow()) {
-        if (!settingsWidget->isShown()) {
+        if (!getSettingsWidget()->isShown()) {
             settingsWidget->show(createContentDialog(DialogType::SettingDialog));
         }
 
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     } else {
         hideMainForms(nullptr);
-        settingsWidget->show(contentLayout);
+        getSettingsWidget()->show(contentLayout);
         setWindowTitle(fromDialogType(DialogType::SettingDialog));
         setActiveToolMenuButton(ActiveToolMenuButton::SettingButton);
     }
@@ -997,14 +1083,14 @@ void Widget::onShowSettings()
 void Widget::showProfile() // onAvatarClicked, onUsernameClicked
 {
     if (settings.getSeparateWindow()) {
-        if (!profileForm->isShown()) {
+        if (!getProfileForm()->isShown()) {
             profileForm->show(createContentDialog(DialogType::ProfileDialog));
         }
 
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     } else {
         hideMainForms(nullptr);
-        profileForm->show(contentLayout);
+        getProfileForm()->show(contentLayout);
         setWindowTitle(fromDialogType(DialogType::ProfileDialog));
         setActiveToolMenuButton(ActiveToolMenuButton::None);
     }
@@ -1150,7 +1236,7 @@ void Widget::dispatchFile(ToxFile file)
     const auto senderPk = (file.direction == ToxFile::SENDING) ? core->getSelfPublicKey() : pk;
     friendChatLogs[pk]->onFileUpdated(senderPk, file);
 
-    filesForm->onFileUpdated(file);
+    getFilesForm()->onFileUpdated(file);
 }
 
 void Widget::dispatchFileWithBool(ToxFile file, bool pausedOrBroken)
@@ -1180,6 +1266,8 @@ void Widget::onRejectCall(uint32_t friendId)
 
 void Widget::addFriend(uint32_t friendId, const ToxPk& friendPk)
 {
+    // mostly the ChatForm, the first one also loads the chat styles and emoji
+    StartupPhase phase{"Widget::addFriend"};
     assert(core != nullptr);
     settings.updateFriendAddress(friendPk.toString());
 
@@ -1218,6 +1306,8 @@ void Widget::addFriend(uint32_t friendId, const ToxPk& friendPk)
     if (chatTime > activityTime && chatTime.isValid()) {
         settings.setFriendActivity(friendPk, chatTime);
     }
+    // the friend list sorts by the activity of the chat, it already knows the history part
+    newfriend->addActivity(activityTime, false, false);
 
     chatListWidget->addFriendWidget(widget);
 
@@ -1267,13 +1357,7 @@ void Widget::addFriend(uint32_t friendId, const ToxPk& friendPk)
 
     connect(&profile, &Profile::friendAvatarSet, widget, &FriendWidget::onAvatarSet);
     connect(&profile, &Profile::friendAvatarRemoved, widget, &FriendWidget::onAvatarRemoved);
-
-    // Try to get the avatar from the cache
-    QPixmap avatar = profile.loadAvatar(friendPk);
-    if (!avatar.isNull()) {
-        friendForm->onAvatarChanged(friendPk, avatar);
-        widget->onAvatarSet(friendPk, avatar);
-    }
+    // the widget and the chat form load the avatar once they are shown
 }
 
 void Widget::addFriendFailed(const ToxPk& userId, const QString& errorInfo)
@@ -1370,20 +1454,74 @@ void Widget::onFriendDisplayedNameChanged(const QString& displayed)
         formatWindowTitle(displayed);
     }
 
-    chatListWidget->itemsChanged();
+    chatListWidget->renameFriendWidget(friendWidget, displayed);
 }
 
-void Widget::onFriendLoaded(int friendId)
+/**
+ * @brief Adds the friend list loaded from the save file.
+ * @param friends All friends, in the order toxcore returned them.
+ *
+ * The pushtokens and unsent messages of all friends are read from the database with a single
+ * query each.
+ */
+void Widget::onFriendsLoaded(const QVector<LoadedFriend>& friends)
 {
-    const auto& friendPk = friendList->id2Key(friendId);
-    Friend* f = friendList->findFriend(friendPk);
-    if (!f) {
-        return;
-    }
+    StartupPhase phase{"Widget::onFriendsLoaded"};
 
+    QHash<ToxPk, QString> pushtokens;
     auto history = profile.getHistory();
-    auto pushtoken = history->getPushtoken(friendPk);
-    f->setPushToken(pushtoken);
+    if (history) {
+        pushtokens = history->getPushtokens();
+        history->preloadUndeliveredMessages();
+    }
+
+    for (const LoadedFriend& loaded : friends) {
+        addFriend(loaded.friendId, loaded.publicKey);
+        onFriendUsernameChanged(loaded.friendId, loaded.username);
+        if (!loaded.statusMessage.isEmpty()) {
+            onFriendStatusMessageChanged(loaded.friendId, loaded.statusMessage);
+        }
+
+        Friend* f = friendList->findFriend(loaded.publicKey);
+        if (f) {
+            f->setPushToken(pushtokens.value(loaded.publicKey, QStringLiteral("_")));
+        }
+
+        // HINT: yes 3 times. we need to force a status change so the UI will update
+        // and takes the pushtoken into account
+        onCoreFriendStatusChanged(loaded.friendId, Status::Status::Online);
+        onCoreFriendStatusChanged(loaded.friendId, Status::Status::Offline);
+        onCoreFriendStatusChanged(loaded.friendId, loaded.status);
+    }
+
+    if (history) {
+        history->clearPreloadedUndeliveredMessages();
+    }
+}
+
+/**
+ * @brief Applies the friend updates of one event loop turn.
+ * @param updates Latest name, status message, typing state and status of every friend that
+ * changed.
+ */
+void Widget::onFriendsUpdated(const QVector<ContactUpdateCoalescer::FriendUpdate>& updates)
+{
+    for (const auto& update : updates) {
+        const int friendId = static_cast<int>(update.friendId);
+        if (update.hasUsername) {
+            onFriendUsernameChanged(friendId, update.username);
+        }
+        if (update.hasStatusMessage) {
+            onFriendStatusMessageChanged(friendId, update.statusMessage);
+        }
+        // before the status, going offline hides the typing notification
+        if (update.hasTyping) {
+            onFriendTypingChanged(update.friendId, update.isTyping);
+        }
+        if (update.hasStatus) {
+            onCoreFriendStatusChanged(friendId, update.status);
+        }
+    }
 }
 
 void Widget::onFriendUsernameChanged(int friendId, const QString& username)
@@ -1516,6 +1654,28 @@ void Widget::onReceiptReceived(int friendId, ReceiptNum receipt)
     friendMessageDispatchers[f->getPublicKey()]->onReceiptReceived(receipt);
 }
 
+void Widget::onFriendMessageSent(uint32_t friendId, uint64_t queuedId, ReceiptNum receipt)
+{
+    const auto& friendKey = friendList->id2Key(friendId);
+    Friend* f = friendList->findFriend(friendKey);
+    if (!f) {
+        return;
+    }
+
+    friendMessageDispatchers[f->getPublicKey()]->onCoreMessageSent(queuedId, receipt);
+}
+
+void Widget::onFriendMessagesRefused(uint32_t friendId, const QVector<uint64_t>& queuedIds)
+{
+    const auto& friendKey = friendList->id2Key(friendId);
+    Friend* f = friendList->findFriend(friendKey);
+    if (!f) {
+        return;
+    }
+
+    friendMessageDispatchers[f->getPublicKey()]->onCoreMessagesRefused(queuedIds);
+}
+
 void Widget::onExtendedMessageSupport(uint32_t friendNumber, bool supported)
 {
     const auto& friendKey = friendList->id2Key(friendNumber);
@@ -1588,11 +1748,6 @@ void Widget::addFriendDialog(const Friend* frnd, ContentDialog* dialog)
 
     connect(&profile, &Profile::friendAvatarSet, friendWidget, &FriendWidget::onAvatarSet);
     connect(&profile, &Profile::friendAvatarRemoved, friendWidget, &FriendWidget::onAvatarRemoved);
-
-    QPixmap avatar = profile.loadAvatar(frnd->getPublicKey());
-    if (!avatar.isNull()) {
-        friendWidget->onAvatarSet(frnd->getPublicKey(), avatar);
-    }
 }
 
 void Widget::addGroupDialog(const Group* group, ContentDialog* dialog)
@@ -1679,7 +1834,7 @@ bool Widget::newFriendMessageAlert(const ToxPk& friendId, const QString& text, b
 #if DESKTOP_NOTIFICATIONS
         auto notificationData = filename.isEmpty() ? notificationGenerator->friendMessageNotification(f, text)
                                                    : notificationGenerator->fileTransferNotification(f, filename, filesize);
-        notifier.notifyMessage(notificationData);
+        notificationCoalescer.addNotification(notificationData);
 #else
         std::ignore = text;
         std::ignore = filename;
@@ -1725,7 +1880,7 @@ bool Widget::newGroupMessageAlert(const GroupId& groupId, const ToxPk& authorPk,
     widget->updateStatusLight();
 #if DESKTOP_NOTIFICATIONS
     auto notificationData = notificationGenerator->groupMessageNotification(g, authorPk, message);
-    notifier.notifyMessage(notificationData);
+    notificationCoalescer.addNotification(notificationData);
 #else
     std::ignore = authorPk;
     std::ignore = message;
@@ -1789,7 +1944,7 @@ bool Widget::newMessageAlert(QWidget* currentWindow, bool isActive, bool sound,
             bool busySound = settings.getBusySound();
             bool notifySound = settings.getNotifySound();
 
-            if (notifySound && sound && (!isBusy || busySound)) {
+            if (notifySound && sound && (!isBusy || busySound) && notificationCoalescer.allowSound()) {
                 playNotificationSound(IAudioSink::Sound::NewMessage);
             }
         }
@@ -1798,16 +1953,28 @@ bool Widget::newMessageAlert(QWidget* currentWindow, bool isActive, bool sound,
     return true;
 }
 
-void Widget::onFriendRequestReceived(const ToxPk& friendPk, const QString& message)
+void Widget::onFriendRequestsReceived(const QVector<FriendRequestIntake::Request>& requests)
 {
-    if (addFriendForm->addFriendRequest(friendPk.toString(), message)) {
-        friendRequestsUpdate();
-        newMessageAlert(window(), isActiveWindow(), true, true);
+    const FriendRequestIntake::Request* lastAdded = nullptr;
+    for (const FriendRequestIntake::Request& request : requests) {
+        if (getAddFriendForm()->addFriendRequest(request.friendPk.toString(), request.message)) {
+            lastAdded = &request;
+        }
+    }
+
+    if (!lastAdded) {
+        return;
+    }
+
+    // one save, alert and notification per batch, however many requests it holds
+    settings.savePersonal();
+    friendRequestsUpdate();
+    newMessageAlert(window(), isActiveWindow(), true, true);
 #if DESKTOP_NOTIFICATIONS
-        auto notificationData = notificationGenerator->friendRequestNotification(friendPk, message);
-        notifier.notifyMessage(notificationData);
+    auto notificationData =
+        notificationGenerator->friendRequestNotification(lastAdded->friendPk, lastAdded->message);
+    notifier.notifyMessage(notificationData);
 #endif
-    }
 }
 
 void Widget::onFileReceiveRequested(const ToxFile& file)
@@ -1819,9 +1986,13 @@ void Widget::onFileReceiveRequested(const ToxFile& file)
 void Widget::updateFriendActivity(const Friend& frnd)
 {
     const ToxPk& pk = frnd.getPublicKey();
-    const auto oldTime = settings.getFriendActivity(pk);
+    const auto oldTime = frnd.getActivity().lastActivity;
     const auto newTime = QDateTime::currentDateTime();
     settings.setFriendActivity(pk, newTime);
+    Friend* f = friendList->findFriend(pk);
+    if (f) {
+        f->addActivity(newTime, false, false);
+    }
     FriendWidget* widget = friendWidgets[frnd.getPublicKey()];
     chatListWidget->moveWidget(widget, frnd.getStatus());
     chatListWidget->updateActivityTime(oldTime); // update old category widget
@@ -1876,6 +2047,7 @@ void Widget::removeFriend(Friend* f, bool fake)
     auto chatForm = chatForms[friendPk];
     chatForms.remove(friendPk);
     delete chatForm;
+    documentCache->trim();
 
     delete f;
     if (contentLayout && contentLayout->mainHead->layout()->isEmpty()) {
@@ -1944,6 +2116,8 @@ void Widget::registerContentDialog(ContentDialog& contentDialog) const
     connect(&contentDialog, &ContentDialog::addFriendDialog, this, &Widget::addFriendDialog);
     connect(&contentDialog, &ContentDialog::addGroupDialog, this, &Widget::addGroupDialog);
     connect(&contentDialog, &ContentDialog::connectFriendWidget, this, &Widget::connectFriendWidget);
+    // the hidden chats gave their documents back
+    connect(&contentDialog, &ContentDialog::destroyed, this, [this] { documentCache->trim(); });
 
 #ifdef Q_OS_MAC
     Nexus& n = nexus;
@@ -2057,7 +2231,7 @@ void Widget::onGroupInviteReceived(const GroupInvite& inviteInfo)
         if (settings.getAutoGroupInvite(f->getPublicKey())) {
             onGroupInviteAccepted(inviteInfo);
         } else {
-            if (!groupInviteForm->addGroupInvite(inviteInfo)) {
+            if (!getGroupInviteForm()->addGroupInvite(inviteInfo)) {
                 return;
             }
 
@@ -2087,47 +2261,26 @@ void Widget::onGroupInviteAccepted(const GroupInvite& inviteInfo)
 void Widget::onGroupMessageReceived(int groupnumber, int peernumber, const QString& message,
                                     bool isAction, bool isPrivate, const int hasIdType)
 {
+    // the author may have joined within this event loop turn
+    contactUpdates.flush();
     const GroupId& groupId = groupList->id2Key(groupnumber);
     assert(groupList->findGroup(groupId));
     ToxPk author = core->getGroupPeerPk(groupnumber, peernumber);
     groupMessageDispatchers[groupId]->onMessageReceived(author, isAction, isPrivate, message, hasIdType);
 }
 
-void Widget::onGroupMessageReceivedImage(int groupnumber, int peernumber, const QByteArray& image_bytes,
-                                    size_t length, bool isAction, const int hasIdType)
+void Widget::onGroupMessageReceivedImage(int groupnumber, int peernumber, const ToxPk& author,
+                                         const QString& imageId)
 {
+    std::ignore = peernumber;
+    contactUpdates.flush();
     const GroupId& groupId = groupList->id2Key(groupnumber);
     assert(groupList->findGroup(groupId));
-    ToxPk author = core->getGroupPeerPk(groupnumber, peernumber);
-
-    std::ignore = groupId;
-    std::ignore = isAction;
-    std::ignore = hasIdType;
-
-    QByteArray shaBa = QCryptographicHash::hash(image_bytes, QCryptographicHash::Sha256);
-    QString sha256hash = QString::fromUtf8(shaBa.toHex()).toUpper();
-    qDebug() << "onGroupMessageReceivedImage:SHA256:" << sha256hash << "length" << length;
-
-    // qDebug() << "onGroupMessageReceivedImage:image_bytes:"
-    //    << QString::fromUtf8(image_bytes.toHex()).toUpper().rightJustified((length * 2), '0')
-    //        << "len:" << length;
 
-    QPixmap mpixmap;
-    bool result = mpixmap.loadFromData(image_bytes);
-    if (!result)
-    {
-        qDebug() << "onGroupMessageReceivedImage:loadFromData:trying with hardcoded WEBP type";
-        result = mpixmap.loadFromData(image_bytes, "WEBP");
-    }
-    qDebug() << "onGroupMessageReceivedImage:loadFromData:res=" << result;
-
-    //if (result)
-    //{
-        // HINT: image could be loaded OK, so save hex data into DB
-        //       add message even if image could not be loaded
-        QString message = QString::fromUtf8(image_bytes.toHex()).toUpper().rightJustified((length * 2), '0') + QString(":") + QString("___");
-        groupMessageDispatchers[groupId]->onMessageReceived(author, isAction, false, message, hasIdType);
-    //}
+    // HINT: the image was already stored off the GUI thread, the message only references it
+    const QString message = imageId + QString(":") + QString("___");
+    groupMessageDispatchers[groupId]->onMessageReceived(
+        author, false, false, message, static_cast<int>(Widget::MessageHasIdType::NGC_MSG_ID));
 }
 
 void Widget::onGroupSyncHistoryReqReceived(int groupnumber, int peernumber, ToxPk peerPk)
@@ -2138,11 +2291,55 @@ void Widget::onGroupSyncHistoryReqReceived(int groupnumber, int peernumber, ToxP
     groupMessageDispatchers[groupId]->onGroupSyncHistoryReqRecv(peerPk, groupnumber, peernumber);
 }
 
+void Widget::onGroupSyncMessageReceived(int groupnumber, const ToxPk& sender,
+                                        const QDateTime& timestamp, const QString& message)
+{
+    const GroupId& groupId = groupList->id2Key(groupnumber);
+    assert(groupList->findGroup(groupId));
+
+    groupMessageDispatchers[groupId]->onSyncMessageReceived(
+        sender, timestamp, message, static_cast<int>(Widget::MessageHasIdType::NGC_MSG_ID));
+}
+
+/**
+ * @brief Applies the group peer updates of one event loop turn.
+ * @param updates Netted out peer changes and latest peer names of every group that changed.
+ *
+ * The peer list is regenerated last, it reads the current state from Core anyway.
+ */
+void Widget::onGroupsUpdated(const QVector<ContactUpdateCoalescer::GroupUpdate>& updates)
+{
+    for (const auto& update : updates) {
+        const uint32_t groupnumber = static_cast<uint32_t>(update.groupnumber);
+        for (const auto& change : update.peerChanges) {
+            if (change.exited) {
+                onGroupPeerExited(groupnumber, change.peerId, change.peerPk);
+            }
+            if (change.joined) {
+                onGroupPeerJoined(groupnumber, change.peerId, change.peerPk, change.name);
+            } else if (change.renamed) {
+                onGroupPeerRenamed(groupnumber, change.peerId, change.peerPk, change.name);
+            }
+        }
+
+        for (auto it = update.peerNames.constBegin(); it != update.peerNames.constEnd(); ++it) {
+            onGroupPeerNameChanged(groupnumber, it.key(), it.value());
+        }
+
+        if (update.peerlistChanged) {
+            onGroupPeerlistChanged(groupnumber);
+        }
+    }
+}
+
+// the group updates are delivered late, the group may be gone already
 void Widget::onGroupPeerlistChanged(uint32_t groupnumber)
 {
     const GroupId& groupId = groupList->id2Key(groupnumber);
     Group* g = groupList->findGroup(groupId);
-    assert(g);
+    if (!g) {
+        return;
+    }
     g->regeneratePeerList();
 }
 
@@ -2150,12 +2347,47 @@ void Widget::onGroupPeerNameChanged(uint32_t groupnumber, const ToxPk& peerPk, c
 {
     const GroupId& groupId = groupList->id2Key(groupnumber);
     Group* g = groupList->findGroup(groupId);
-    assert(g);
+    if (!g) {
+        return;
+    }
 
     const QString setName = friendList->decideNickname(peerPk, newName);
     g->updateUsername(peerPk, newName);
 }
 
+void Widget::onGroupPeerJoined(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk,
+                               const QString& name)
+{
+    const GroupId& groupId = groupList->id2Key(groupnumber);
+    Group* g = groupList->findGroup(groupId);
+    if (!g) {
+        return;
+    }
+    g->addPeer(peerId, peerPk, name);
+}
+
+void Widget::onGroupPeerExited(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk)
+{
+    const GroupId& groupId = groupList->id2Key(groupnumber);
+    Group* g = groupList->findGroup(groupId);
+    if (!g) {
+        return;
+    }
+    std::ignore = peerId;
+    g->removePeer(peerPk);
+}
+
+void Widget::onGroupPeerRenamed(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk,
+                                const QString& name)
+{
+    const GroupId& groupId = groupList->id2Key(groupnumber);
+    Group* g = groupList->findGroup(groupId);
+    if (!g) {
+        return;
+    }
+    g->renamePeer(peerId, peerPk, name);
+}
+
 void Widget::onGroupTitleChanged(uint32_t groupnumber, const QString& author, const QString& title)
 {
     const GroupId& groupId = groupList->id2Key(groupnumber);
@@ -2178,15 +2410,6 @@ void Widget::titleChangedByUser(const QString& title)
     emit changeGroupTitle(group->getId(), title);
 }
 
-void Widget::onGroupPeerAudioPlaying(int groupnumber, ToxPk peerPk)
-{
-    const GroupId& groupId = groupList->id2Key(groupnumber);
-    assert(groupList->findGroup(groupId));
-
-    auto form = groupChatForms[groupId].data();
-    form->peerAudioPlaying(peerPk);
-}
-
 void Widget::removeGroup(Group* g, bool fake)
 {
     assert(g);
@@ -2236,6 +2459,7 @@ void Widget::removeGroup(Group* g, bool fake)
     }
     groupChatForms.erase(groupChatFormIt);
     groupAlertConnections.remove(groupId);
+    documentCache->trim();
 
     delete g;
     if (contentLayout && contentLayout->mainHead->layout()->isEmpty()) {
@@ -2323,7 +2547,8 @@ Group* Widget::createGroup(uint32_t groupnumber, const GroupId& groupId)
     groupAlertConnections.insert(groupId, notifyReceivedConnection);
 
     auto form = new GroupChatForm(*core, newgroup, *chatHistory, *messageDispatcher,
-        settings, *documentCache, *smileyPack, style, *messageBoxManager, *friendList, *groupList);
+        settings, *documentCache, *smileyPack, style, *messageBoxManager, *friendList, *groupList,
+        *profile.getBlobStore());
     connect(&settings, &Settings::nameColorsChanged, form, &GenericChatForm::setColorizedNames);
     form->setColorizedNames(settings.getEnableGroupChatsColor());
     groupMessageDispatchers[groupId] = messageDispatcher;
@@ -2369,6 +2594,17 @@ void Widget::onEmptyGroupCreated(uint32_t groupnumber, const GroupId& groupId, c
     }
 }
 
+/**
+ * @brief Adds the conferences and NGC groups loaded from the save file.
+ */
+void Widget::onGroupsLoaded(const QVector<LoadedGroup>& groups)
+{
+    for (const LoadedGroup& loaded : groups) {
+        onEmptyGroupCreated(static_cast<uint32_t>(loaded.groupNumber), loaded.persistentId,
+                            loaded.title);
+    }
+}
+
 void Widget::onGroupJoined(int groupNum, const GroupId& groupId)
 {
     createGroup(groupNum, groupId);
@@ -2639,6 +2875,15 @@ void Widget::reloadTheme()
     ui->statusButton->setStyleSheet(style.getStylesheet("statusButton/statusButton.css", settings));
 
     profilePicture->setStyleSheet(style.getStylesheet("window/profile.css", settings));
+
+    // render the chat icons of the new theme before the first chat needs them
+    PixmapCache& pixmapCache = PixmapCache::getInstance();
+    pixmapCache.clear();
+    pixmapCache.prerender(style.getImagePath("chatArea/spinner.svg", settings), QSize(16, 16));
+    pixmapCache.prerender(style.getImagePath("chatArea/error.svg", settings), QSize(16, 16));
+    pixmapCache.prerender(style.getImagePath("chatArea/error.svg", settings), QSize(18, 18));
+    pixmapCache.prerender(style.getImagePath("chatArea/info.svg", settings), QSize(18, 18));
+    pixmapCache.prerender(style.getImagePath("chatArea/typing.svg", settings), QSize(18, 18));
 }
 
 void Widget::nextChat()
@@ -2775,7 +3020,7 @@ void Widget::friendRequestsUpdate()
 
         connect(friendRequestsButton, &QPushButton::released, [this]() {
             onAddClicked();
-            addFriendForm->setMode(AddFriendForm::Mode::FriendRequest);
+            getAddFriendForm()->setMode(AddFriendForm::Mode::FriendRequest);
         });
     }
 
@@ -2878,7 +3123,7 @@ void Widget::focusChatInput()
         }
     }
 
-    if (addFriendForm->isShown()) {
+    if (addFriendForm && addFriendForm->isShown()) {
         addFriendForm->showFocusAgain();
     }
 }
@@ -23,6 +23,7 @@
 
 #include <QFileInfo>
 #include <QMainWindow>
+#include <QPixmap>
 #include <QPointer>
 #include <QSystemTrayIcon>
 
@@ -35,9 +36,12 @@
 #include "src/core/toxfile.h"
 #include "src/core/toxid.h"
 #include "src/core/toxpk.h"
+#include "src/model/contactupdatecoalescer.h"
 #include "src/model/friendmessagedispatcher.h"
+#include "src/model/friendrequestintake.h"
 #include "src/model/groupmessagedispatcher.h"
 #if DESKTOP_NOTIFICATIONS
+#include "src/model/notificationcoalescer.h"
 #include "src/model/notificationgenerator.h"
 #include "src/platform/desktop_notifications/desktopnotify.h"
 #endif
@@ -192,29 +196,41 @@ public slots:
     void onFriendStatusMessageChanged(int friendId, const QString& message);
     void onFriendDisplayedNameChanged(const QString& displayed);
     void onFriendUsernameChanged(int friendId, const QString& username);
-    void onFriendLoaded(int friendId);
+    void onFriendsLoaded(const QVector<LoadedFriend>& friends);
+    void onFriendsUpdated(const QVector<ContactUpdateCoalescer::FriendUpdate>& updates);
     void onFriendAliasChanged(const ToxPk& friendId, const QString& alias);
     void onFriendMessageReceived(uint32_t friendnumber, const QString& message, bool isAction, const int hasIdType = 0);
     void onFriendPushtokenReceived(uint32_t friendnumber, const QString& pushtoken);
     void onFriendConnectionStatusFullChanged(uint32_t friendnumber, const uint32_t connection_status_full);
     void onReceiptReceived(int friendId, ReceiptNum receipt);
+    void onFriendMessageSent(uint32_t friendId, uint64_t queuedId, ReceiptNum receipt);
+    void onFriendMessagesRefused(uint32_t friendId, const QVector<uint64_t>& queuedIds);
     void onExtendedMessageSupport(uint32_t friendNumber, bool supported);
     void onFriendExtMessageReceived(uint32_t friendNumber, const QString& message);
     void onExtReceiptReceived(uint32_t friendNumber, uint64_t receiptId);
-    void onFriendRequestReceived(const ToxPk& friendPk, const QString& message);
+    void onFriendRequestsReceived(const QVector<FriendRequestIntake::Request>& requests);
     void onFileReceiveRequested(const ToxFile& file);
     void onEmptyGroupCreated(uint32_t groupnumber, const GroupId& groupId, const QString& title);
+    void onGroupsLoaded(const QVector<LoadedGroup>& groups);
     void onGroupJoined(int groupNum, const GroupId& groupId);
     void onGroupInviteReceived(const GroupInvite& inviteInfo);
     void onGroupInviteAccepted(const GroupInvite& inviteInfo);
     void onGroupMessageReceived(int groupnumber, int peernumber, const QString& message, bool isAction, bool isPrivate = false, const int hasIdType = 0);
-    void onGroupMessageReceivedImage(int groupnumber, int peernumber, const QByteArray& image_bytes, size_t length, bool isAction, const int hasIdType = 0);
+    void onGroupMessageReceivedImage(int groupnumber, int peernumber, const ToxPk& author,
+                                     const QString& imageId);
     void onGroupSyncHistoryReqReceived(int groupnumber, int peernumber, ToxPk peerPk);
+    void onGroupSyncMessageReceived(int groupnumber, const ToxPk& sender,
+                                    const QDateTime& timestamp, const QString& message);
     void onGroupPeerlistChanged(uint32_t groupnumber);
     void onGroupPeerNameChanged(uint32_t groupnumber, const ToxPk& peerPk, const QString& newName);
+    void onGroupPeerJoined(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk,
+                           const QString& name);
+    void onGroupPeerExited(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk);
+    void onGroupPeerRenamed(uint32_t groupnumber, uint32_t peerId, const ToxPk& peerPk,
+                            const QString& name);
+    void onGroupsUpdated(const QVector<ContactUpdateCoalescer::GroupUpdate>& updates);
     void onGroupTitleChanged(uint32_t groupnumber, const QString& author, const QString& title);
     void titleChangedByUser(const QString& title);
-    void onGroupPeerAudioPlaying(int groupnumber, ToxPk peerPk);
     void onGroupSendFailed(uint32_t groupnumber);
     void onFriendTypingChanged(uint32_t friendnumber, bool isTyping);
     void nextChat();
@@ -309,6 +325,11 @@ private:
     void cleanupNotificationSound();
     void acceptFileTransfer(const ToxFile &file, const QString &path);
     void formatWindowTitle(const QString& content);
+    FilesForm* getFilesForm();
+    AddFriendForm* getAddFriendForm();
+    GroupInviteForm* getGroupInviteForm();
+    SettingsWidget* getSettingsWidget();
+    ProfileForm* getProfileForm();
 
 private:
     Profile& profile;
@@ -338,15 +359,17 @@ private:
     QSplitter* centralLayout;
     QPoint dragPosition;
     ContentLayout* contentLayout;
-    AddFriendForm* addFriendForm;
-    GroupInviteForm* groupInviteForm;
+    // created on first use, see the getters
+    AddFriendForm* addFriendForm = nullptr;
+    GroupInviteForm* groupInviteForm = nullptr;
 
-    ProfileInfo* profileInfo;
-    ProfileForm* profileForm;
+    ProfileInfo* profileInfo = nullptr;
+    ProfileForm* profileForm = nullptr;
+    QPixmap selfAvatar;
 
     QPointer<SettingsWidget> settingsWidget;
     std::unique_ptr<UpdateCheck> updateCheck; // ownership should be moved outside Widget once non-singleton
-    FilesForm* filesForm;
+    FilesForm* filesForm = nullptr;
     static Widget* instance;
     GenericChatroomWidget* activeChatroomWidget;
     FriendListWidget* chatListWidget;
@@ -394,6 +417,9 @@ private:
 
 
     std::unique_ptr<MessageProcessor::SharedParams> sharedMessageProcessorParams;
+    NotificationCoalescer notificationCoalescer;
+    ContactUpdateCoalescer contactUpdates;
+    FriendRequestIntake friendRequestIntake;
 #if DESKTOP_NOTIFICATIONS
     std::unique_ptr<NotificationGenerator> notificationGenerator;
     DesktopNotify notifier;
@@ -0,0 +1,113 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audio/audiolevel.h"
+
+#include <QTest>
+
+#include <cmath>
+#include <vector>
+
+class TestAudioLevel : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testSilence();
+    void testFullScale();
+    void testMatchesScalarReference();
+    void testMeterKeepsLoudest();
+    void testTakeResets();
+};
+
+void TestAudioLevel::testSilence()
+{
+    const std::vector<int16_t> pcm(1920, 0);
+    const AudioLevel level = AudioLevel::measure(pcm.data(), pcm.size());
+    QCOMPARE(level.peak, 0.0f);
+    QCOMPARE(level.rms, 0.0f);
+    QCOMPARE(AudioLevel::measure(nullptr, 0).peak, 0.0f);
+}
+
+void TestAudioLevel::testFullScale()
+{
+    // odd length to cover the scalar tail, and the most negative sample that can't be negated
+    std::vector<int16_t> pcm(1923);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = i % 2 ? -32768 : 32767;
+    }
+
+    const AudioLevel level = AudioLevel::measure(pcm.data(), pcm.size());
+    QCOMPARE(level.peak, 1.0f);
+    QCOMPARE(level.rms, 1.0f);
+    QCOMPARE(level.volume(), 1.0f);
+}
+
+void TestAudioLevel::testMatchesScalarReference()
+{
+    std::vector<int16_t> pcm(1931);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = static_cast<int16_t>(std::lround(12000 * std::sin(i * 0.05)) - 300);
+    }
+    pcm[1930] = -20000;
+
+    double sumOfSquares = 0;
+    int peak = 0;
+    for (const int16_t sample : pcm) {
+        sumOfSquares += static_cast<double>(sample) * sample;
+        peak = std::max(peak, std::abs(static_cast<int>(sample)));
+    }
+
+    const AudioLevel level = AudioLevel::measure(pcm.data(), pcm.size());
+    QCOMPARE(level.peak, peak / 32767.0f);
+    QVERIFY(std::abs(level.rms - std::sqrt(sumOfSquares / pcm.size()) / 32767.0) < 1e-5);
+}
+
+void TestAudioLevel::testMeterKeepsLoudest()
+{
+    AudioLevelMeter meter;
+    AudioLevel loudPeak;
+    loudPeak.peak = 0.8f;
+    loudPeak.rms = 0.1f;
+    AudioLevel loudRms;
+    loudRms.peak = 0.5f;
+    loudRms.rms = 0.4f;
+    meter.publish(loudPeak);
+    meter.publish(loudRms);
+
+    const AudioLevel level = meter.take();
+    QVERIFY(std::abs(level.peak - 0.8f) < 1e-4f);
+    QVERIFY(std::abs(level.rms - 0.4f) < 1e-4f);
+}
+
+void TestAudioLevel::testTakeResets()
+{
+    AudioLevelMeter meter;
+    AudioLevel level;
+    level.peak = 1.0f;
+    level.rms = 1.0f;
+    meter.publish(level);
+    QCOMPARE(meter.take().peak, 1.0f);
+
+    const AudioLevel empty = meter.take();
+    QCOMPARE(empty.peak, 0.0f);
+    QCOMPARE(empty.rms, 0.0f);
+}
+
+QTEST_GUILESS_MAIN(TestAudioLevel)
+#include "audiolevel_test.moc"
@@ -0,0 +1,408 @@
+/*
+    Copyright © 2022 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mock/mockbootstraplistgenerator.h"
+#include "mock/mockcoresettings.h"
+#include "src/chatlog/chatwidget.h"
+#include "src/chatlog/documentcache.h"
+#include "src/core/core.h"
+#include "src/core/toxfile.h"
+#include "src/friendlist.h"
+#include "src/grouplist.h"
+#include "src/model/sessionchatlog.h"
+#include "src/persistence/blobstore.h"
+#include "src/persistence/settings.h"
+#include "src/persistence/smileypack.h"
+#include "src/widget/searchtypes.h"
+#include "src/widget/style.h"
+#include "src/widget/tool/imessageboxmanager.h"
+
+#include <QApplication>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QScrollBar>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+/**
+ * @brief Frame time benchmarks of ChatWidget on a generated chat log.
+ *
+ * Not part of ctest, run "qtox_chatwidget_bench -o chatwidget_bench.xml,xml" and compare the
+ * results across builds, next to the chatlinestorage and textformatter tests. Runs on the
+ * offscreen platform unless QT_QPA_PLATFORM says otherwise. The SessionChatLog holds 20000
+ * messages over two years by default, set QTOX_BENCH_CHAT_MESSAGES for other sizes. Every
+ * benchmark iteration is one frame: the change, the events it posts and a synchronous repaint
+ * of the viewport, so the reported time is the mean frame time.
+ */
+
+namespace {
+const QString needle = QStringLiteral("zebracorn");
+const QStringList words = {"hello", "how",   "are",  "you",  "file",    "sent",  "tox",
+                           "call",  "later", "ok",   "good", "morning", "night", "thanks",
+                           "see",   "this",  "link", "lol",  "meeting", "today"};
+const QStringList emoji = {":)", ":D", ";)", ":P", "😀", "👍", "🎉", "❤️"};
+const QStringList links = {"https://qtox.github.io", "https://tox.chat/download.html"};
+constexpr int scrollStep = 120;
+constexpr int maxDates = 50;
+const std::vector<int> widths = {360, 640, 900, 1280, 1920};
+
+int envInt(const char* name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+QByteArray makePng(int size, QRgb color)
+{
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(color);
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return data;
+}
+
+class BenchMessageBoxManager : public IMessageBoxManager
+{
+public:
+    void showInfo(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showWarning(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showError(const QString& title, const QString& msg) override
+    {
+        qWarning() << title << msg;
+    }
+    bool askQuestion(const QString& title, const QString& msg, bool defaultAns = false,
+                     bool warning = true, bool yesno = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = warning;
+        std::ignore = yesno;
+        return defaultAns;
+    }
+    bool askQuestion(const QString& title, const QString& msg, const QString& button1,
+                     const QString& button2, bool defaultAns = false, bool warning = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = button1;
+        std::ignore = button2;
+        std::ignore = warning;
+        return defaultAns;
+    }
+    void confirmExecutableOpen(const QFileInfo& file) override
+    {
+        std::ignore = file;
+    }
+};
+} // namespace
+
+class BenchChatWidget : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchScroll();
+    void benchJumpToDate();
+    void benchResize();
+    void benchSearch();
+
+private:
+    void generateChatLog(int numMessages);
+    QString makeText(int index);
+    void frame();
+    void jumpToEnd();
+
+    std::unique_ptr<QTemporaryDir> dir;
+    std::unique_ptr<BenchMessageBoxManager> messageBoxManager;
+    std::unique_ptr<Settings> settings;
+    MockSettings coreSettings;
+    MockBootstrapListGenerator bootstrapNodes;
+    ToxCorePtr core;
+    std::unique_ptr<FriendList> friendList;
+    std::unique_ptr<GroupList> groupList;
+    std::unique_ptr<SessionChatLog> chatLog;
+    std::unique_ptr<SmileyPack> smileyPack;
+    std::unique_ptr<DocumentCache> documentCache;
+    std::unique_ptr<Style> style;
+    std::unique_ptr<BlobStore> blobStore;
+    std::unique_ptr<ChatWidget> chatWidget;
+    std::mt19937 rng{42};
+};
+
+void BenchChatWidget::initTestCase()
+{
+    // don't touch the settings of the user running the benchmark
+    QStandardPaths::setTestModeEnabled(true);
+    dir = std::unique_ptr<QTemporaryDir>(new QTemporaryDir());
+    QVERIFY(dir->isValid());
+
+    messageBoxManager = std::unique_ptr<BenchMessageBoxManager>(new BenchMessageBoxManager());
+    settings = std::unique_ptr<Settings>(new Settings(*messageBoxManager));
+    core = Core::makeToxCore({}, coreSettings, bootstrapNodes);
+    QVERIFY(core);
+
+    friendList = std::unique_ptr<FriendList>(new FriendList());
+    groupList = std::unique_ptr<GroupList>(new GroupList());
+    chatLog = std::unique_ptr<SessionChatLog>(new SessionChatLog(*core, *friendList, *groupList));
+    smileyPack = std::unique_ptr<SmileyPack>(new SmileyPack(*settings));
+    documentCache = std::unique_ptr<DocumentCache>(new DocumentCache(*smileyPack, *settings));
+    style = std::unique_ptr<Style>(new Style());
+    blobStore = std::unique_ptr<BlobStore>(new BlobStore(dir->filePath("blobs"), nullptr));
+
+    const int numMessages = envInt("QTOX_BENCH_CHAT_MESSAGES", 20000);
+    QElapsedTimer timer;
+    timer.start();
+    generateChatLog(numMessages);
+    qInfo() << "Generated" << numMessages << "messages in" << timer.elapsed() << "ms";
+
+    chatWidget = std::unique_ptr<ChatWidget>(
+        new ChatWidget(*chatLog, *core, *documentCache, *smileyPack, *settings, *style,
+                       *messageBoxManager, *blobStore));
+    chatWidget->resize(widths[1], 720);
+    chatWidget->show();
+    QVERIFY(QTest::qWaitForWindowExposed(chatWidget.get()));
+
+    timer.restart();
+    jumpToEnd();
+    qInfo() << "First render took" << timer.elapsed() << "ms";
+}
+
+void BenchChatWidget::cleanupTestCase()
+{
+    chatWidget.reset();
+    chatLog.reset();
+    documentCache.reset();
+    smileyPack.reset();
+    core.reset();
+    settings.reset();
+}
+
+/**
+ * @brief Fills the chat log like a long friend chat, mostly text with emoji and links, some
+ * finished image and file transfers, group images from the blob store and system messages,
+ * in chronological order over the last two years.
+ */
+void BenchChatWidget::generateChatLog(int numMessages)
+{
+    const ToxPk selfPk = core->getSelfPublicKey();
+    QByteArray friendKey(ToxPk::size, Qt::Uninitialized);
+    for (char& c : friendKey) {
+        c = static_cast<char>(rng());
+    }
+    const ToxPk friendPk{friendKey};
+
+    const QString imagePath = dir->filePath("image.png");
+    QFile imageFile(imagePath);
+    QVERIFY(imageFile.open(QIODevice::WriteOnly));
+    imageFile.write(makePng(640, qRgb(40, 120, 200)));
+    imageFile.close();
+    const QString blobReference = blobStore->put(makePng(480, qRgb(200, 80, 40)));
+    QVERIFY(BlobStore::isReference(blobReference));
+
+    const QDateTime start = QDateTime::currentDateTime().addYears(-2);
+    const qint64 stepMs = std::max<qint64>(start.msecsTo(QDateTime::currentDateTime()) / numMessages, 1);
+    QDateTime time = start;
+
+    for (int i = 0; i < numMessages; ++i) {
+        time = time.addMSecs(stepMs / 2 + static_cast<qint64>(rng() % stepMs));
+        const ChatLogIdx idx{static_cast<size_t>(i)};
+        const bool isSelf = rng() % 2;
+        const ToxPk& sender = isSelf ? selfPk : friendPk;
+        const QString senderName = isSelf ? QStringLiteral("me") : QStringLiteral("friend");
+
+        if (i % 200 == 100) {
+            ToxFile file(static_cast<uint32_t>(i), 0, QStringLiteral("image.png"), imagePath,
+                         static_cast<uint64_t>(imageFile.size()),
+                         isSelf ? ToxFile::SENDING : ToxFile::RECEIVING, 0);
+            file.status = ToxFile::FINISHED;
+            chatLog->insertFileAtIdx(idx, sender, senderName, ChatLogFile{time, file});
+        } else if (i % 200 == 150) {
+            ToxFile file(static_cast<uint32_t>(i), 0, QStringLiteral("notes.tar.gz"),
+                         dir->filePath("notes.tar.gz"), 1 << 20,
+                         isSelf ? ToxFile::SENDING : ToxFile::RECEIVING, 0);
+            file.status = ToxFile::FINISHED;
+            chatLog->insertFileAtIdx(idx, sender, senderName, ChatLogFile{time, file});
+        } else if (i % 500 == 250) {
+            Message message;
+            message.isAction = false;
+            message.isPrivate = false;
+            message.content = QStringLiteral("___");
+            message.id_or_hash = blobReference;
+            message.timestamp = time;
+            chatLog->insertCompleteMessageAtIdx(idx, sender, senderName,
+                                                ChatLogMessage{MessageState::complete, message});
+        } else if (i % 1000 == 500) {
+            SystemMessage systemMessage;
+            systemMessage.messageType = SystemMessageType::peerNameChanged;
+            systemMessage.timestamp = time;
+            systemMessage.args = {QStringLiteral("old"), QStringLiteral("new")};
+            chatLog->insertSystemMessageAtIdx(idx, systemMessage);
+        } else {
+            Message message;
+            message.isAction = i % 100 == 7;
+            message.isPrivate = false;
+            message.content = makeText(i);
+            message.timestamp = time;
+            chatLog->insertCompleteMessageAtIdx(idx, sender, senderName,
+                                                ChatLogMessage{MessageState::complete, message});
+        }
+    }
+}
+
+/**
+ * @brief Some words with emoji and the occasional link or long paragraph, the needle only
+ * turns up in one of the oldest messages so searching for it walks the whole log.
+ */
+QString BenchChatWidget::makeText(int index)
+{
+    if (index == 10) {
+        return QStringLiteral("did you see the %1 yesterday").arg(needle);
+    }
+
+    const int numWords = index % 50 == 3 ? 150 : 3 + static_cast<int>(rng() % 18);
+    QStringList text;
+    for (int i = 0; i < numWords; ++i) {
+        const int pick = static_cast<int>(rng() % 40);
+        if (pick == 0) {
+            text << emoji[static_cast<int>(rng() % emoji.size())];
+        } else if (pick == 1) {
+            text << links[static_cast<int>(rng() % links.size())];
+        } else {
+            text << words[static_cast<int>(rng() % words.size())];
+        }
+    }
+    return text.join(' ');
+}
+
+/**
+ * @brief Handles what the last change posted and paints the viewport like the next frame would
+ */
+void BenchChatWidget::frame()
+{
+    QCoreApplication::processEvents();
+    chatWidget->viewport()->repaint();
+}
+
+void BenchChatWidget::jumpToEnd()
+{
+    chatWidget->jumpToIdx(chatLog->getNextIdx());
+    frame();
+}
+
+/**
+ * @brief Scrolls up through the log a wheel step per frame, rendering older messages as they
+ * come into view, and starts over at the bottom once the top is reached
+ */
+void BenchChatWidget::benchScroll()
+{
+    QScrollBar* scrollBar = chatWidget->verticalScrollBar();
+    jumpToEnd();
+
+    QBENCHMARK {
+        const int value = scrollBar->value();
+        scrollBar->setValue(value - scrollStep);
+        frame();
+        if (value == scrollBar->minimum() && scrollBar->value() == value) {
+            jumpToEnd();
+        }
+    }
+}
+
+/**
+ * @brief Jumps between the dates getDateIdxs offers, how the date picker of the search moves
+ */
+void BenchChatWidget::benchJumpToDate()
+{
+    const auto dates = chatLog->getDateIdxs(chatLog->at(chatLog->getFirstIdx()).getTimestamp().date(),
+                                            maxDates);
+    QVERIFY(dates.size() > 1);
+    size_t next = 0;
+
+    QBENCHMARK {
+        chatWidget->jumpToDate(dates[next].date);
+        frame();
+        next = (next + 7) % dates.size();
+    }
+}
+
+/**
+ * @brief Resizes the window between common widths, relayouting the rendered lines
+ */
+void BenchChatWidget::benchResize()
+{
+    jumpToEnd();
+    size_t next = 0;
+
+    QBENCHMARK {
+        next = (next + 1) % widths.size();
+        chatWidget->resize(widths[next], chatWidget->height());
+        frame();
+    }
+
+    chatWidget->resize(widths[1], chatWidget->height());
+    frame();
+}
+
+/**
+ * @brief Searches for a phrase only one of the oldest messages has, from the bottom
+ */
+void BenchChatWidget::benchSearch()
+{
+    jumpToEnd();
+
+    QBENCHMARK {
+        chatWidget->startSearch(needle, ParameterSearch());
+        frame();
+        chatWidget->removeSearchPhrase();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    BenchChatWidget bench;
+    return QTest::qExec(&bench, argc, argv);
+}
+
+#include "chatwidget_bench.moc"
@@ -0,0 +1,396 @@
+/*
+    Copyright © 2022 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/groupid.h"
+#include "src/core/toxpk.h"
+#include "src/persistence/db/rawdatabase.h"
+#include "src/persistence/history.h"
+#include "src/persistence/settings.h"
+#include "src/widget/searchtypes.h"
+#include "src/widget/tool/imessageboxmanager.h"
+
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+Q_DECLARE_METATYPE(FilterSearch)
+
+/**
+ * @brief Benchmarks of History on a generated profile.
+ *
+ * Not part of ctest, run "qtox_history_bench -o history_bench.xml,xml" and compare the results
+ * across builds. The profile is written through the History API into an encrypted database, by
+ * default 100 chats with 200000 messages, half of them in one deep chat. Set
+ * QTOX_BENCH_CHATS and QTOX_BENCH_MESSAGES for other sizes, e.g. 5000000 messages for a heavy
+ * profile. Generating it is timed and printed too.
+ */
+
+namespace {
+const QString benchPassword = QStringLiteral("qTox history benchmark");
+const QString needle = QStringLiteral("zebracorn");
+const QStringList words = {"hello", "how",   "are",  "you",  "file",    "sent",  "tox",
+                           "call",  "later", "ok",   "good", "morning", "night", "thanks",
+                           "see",   "this",  "link", "lol",  "meeting", "today"};
+constexpr int groupPeers = 20;
+constexpr int burstSize = 100;
+constexpr int pageSize = 100;
+constexpr int batchSize = 1000;
+
+int envInt(const char* name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+QByteArray makeKey(std::mt19937& rng)
+{
+    QByteArray key(ToxPk::size, Qt::Uninitialized);
+    for (char& c : key) {
+        c = static_cast<char>(rng());
+    }
+    return key;
+}
+
+class BenchMessageBoxManager : public IMessageBoxManager
+{
+public:
+    void showInfo(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showWarning(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showError(const QString& title, const QString& msg) override
+    {
+        qWarning() << title << msg;
+    }
+    bool askQuestion(const QString& title, const QString& msg, bool defaultAns = false,
+                     bool warning = true, bool yesno = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = warning;
+        std::ignore = yesno;
+        return defaultAns;
+    }
+    bool askQuestion(const QString& title, const QString& msg, const QString& button1,
+                     const QString& button2, bool defaultAns = false, bool warning = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = button1;
+        std::ignore = button2;
+        std::ignore = warning;
+        return defaultAns;
+    }
+    void confirmExecutableOpen(const QFileInfo& file) override
+    {
+        std::ignore = file;
+    }
+};
+} // namespace
+
+class BenchHistory : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchGetMessagesForChat_data();
+    void benchGetMessagesForChat();
+    void benchGetMessagesForChatBefore_data();
+    void benchGetMessagesForChatBefore();
+    void benchFindPhrase_data();
+    void benchFindPhrase();
+    void benchDateBoundaries();
+    void benchInsertBurst();
+    void benchOpenProfile();
+
+private:
+    void generateProfile(int numChats, int numMessages);
+    QString makeText(int index);
+    void addDepthRows();
+
+    std::unique_ptr<QTemporaryDir> dir;
+    QString dbPath;
+    QByteArray salt;
+    std::unique_ptr<BenchMessageBoxManager> messageBoxManager;
+    std::unique_ptr<Settings> settings;
+    std::shared_ptr<RawDatabase> db;
+    std::shared_ptr<History> history;
+    std::mt19937 rng{42};
+    ToxPk selfPk;
+    std::unique_ptr<ToxPk> deepChat;
+    size_t deepChatSize = 0;
+};
+
+void BenchHistory::initTestCase()
+{
+    // don't touch the settings of the user running the benchmark
+    QStandardPaths::setTestModeEnabled(true);
+    dir = std::unique_ptr<QTemporaryDir>(new QTemporaryDir());
+    QVERIFY(dir->isValid());
+    dbPath = dir->filePath(QStringLiteral("bench.db"));
+    salt = makeKey(rng);
+    selfPk = ToxPk{makeKey(rng)};
+
+    messageBoxManager = std::unique_ptr<BenchMessageBoxManager>(new BenchMessageBoxManager());
+    settings = std::unique_ptr<Settings>(new Settings(*messageBoxManager));
+    settings->setEnableLogging(true);
+
+    db = std::make_shared<RawDatabase>(dbPath, benchPassword, salt);
+    QVERIFY(db->isOpen());
+    history = std::make_shared<History>(db, *settings, *messageBoxManager);
+    QVERIFY(history->isValid());
+
+    const int numChats = envInt("QTOX_BENCH_CHATS", 100);
+    const int numMessages = envInt("QTOX_BENCH_MESSAGES", 200000);
+    QElapsedTimer timer;
+    timer.start();
+    generateProfile(numChats, numMessages);
+    const qint64 elapsedMs = std::max<qint64>(timer.elapsed(), 1);
+    qInfo() << "Generated" << numMessages << "messages in" << numChats << "chats in" << elapsedMs
+            << "ms," << numMessages * 1000 / elapsedMs << "messages/s";
+
+    deepChatSize = history->getNumMessagesForChat(*deepChat);
+    QVERIFY(deepChatSize > static_cast<size_t>(pageSize));
+}
+
+void BenchHistory::cleanupTestCase()
+{
+    history.reset();
+    db.reset();
+    settings.reset();
+}
+
+/**
+ * @brief Fills the database like a long used profile would be, friends and NGC groups with
+ * text, a few file transfers and system messages, all in chronological order per chat.
+ */
+void BenchHistory::generateProfile(int numChats, int numMessages)
+{
+    const int numGroups = std::max(1, numChats / 5);
+    const int numFriends = std::max(1, numChats - numGroups);
+    const QDateTime start = QDateTime::currentDateTime().addYears(-3);
+    const qint64 spanMs = start.msecsTo(QDateTime::currentDateTime());
+
+    std::vector<QByteArray> peers;
+    for (int i = 0; i < groupPeers; ++i) {
+        peers.push_back(makeKey(rng));
+    }
+
+    for (int chat = 0; chat < numFriends + numGroups; ++chat) {
+        const bool isGroup = chat >= numFriends;
+        // the first chat is the deep one the queries run on
+        const int count = chat == 0 ? numMessages / 2
+                                    : (numMessages - numMessages / 2) / (numFriends + numGroups - 1);
+        if (count == 0) {
+            continue;
+        }
+
+        std::unique_ptr<ChatId> chatId;
+        if (isGroup) {
+            chatId = std::unique_ptr<ChatId>(new GroupId(makeKey(rng)));
+        } else {
+            chatId = std::unique_ptr<ChatId>(new ToxPk(makeKey(rng)));
+        }
+        if (chat == 0) {
+            deepChat = std::unique_ptr<ToxPk>(new ToxPk(chatId->getByteArray()));
+        }
+
+        const ToxPk friendPk{chatId->getByteArray()};
+        const qint64 stepMs = std::max<qint64>(spanMs / count, 1);
+        QDateTime time = start;
+
+        history->beginBatch();
+        for (int i = 0; i < count; ++i) {
+            time = time.addMSecs(stepMs / 2 + static_cast<qint64>(rng() % stepMs));
+            if (i % batchSize == batchSize - 1) {
+                history->endBatch();
+                history->beginBatch();
+            }
+
+            const QString text = makeText(i);
+            if (isGroup) {
+                const ToxPk sender{peers[rng() % peers.size()]};
+                const QString msgId = QString::fromLatin1(makeKey(rng).toHex());
+                history->addNewMessage(*chatId, msgId + ":" + text, sender, time, true,
+                                       ExtensionSet(), sender.toString().left(8), {}, 2);
+            } else if (i % 500 == 250) {
+                const ToxPk& sender = rng() % 2 ? friendPk : selfPk;
+                history->addNewFileMessage(*chatId, makeKey(rng), QStringLiteral("file.png"),
+                                           QStringLiteral("/tmp/file.png"), 1 << 20, sender, time,
+                                           QStringLiteral("sender"));
+            } else if (i % 1000 == 500) {
+                SystemMessage systemMessage;
+                systemMessage.messageType = SystemMessageType::peerNameChanged;
+                systemMessage.timestamp = time;
+                systemMessage.args = {QStringLiteral("old"), QStringLiteral("new")};
+                history->addNewSystemMessage(*chatId, systemMessage);
+            } else {
+                const ToxPk& sender = rng() % 2 ? friendPk : selfPk;
+                history->addNewMessage(*chatId, text, sender, time, true, ExtensionSet(),
+                                       QStringLiteral("sender"));
+            }
+        }
+        history->endBatch();
+    }
+
+    db->sync();
+}
+
+/**
+ * @brief Some words, the needle only turns up in the oldest messages so searches for it scan
+ * most of a chat.
+ */
+QString BenchHistory::makeText(int index)
+{
+    if (index == 10) {
+        return QStringLiteral("did you see the %1 yesterday").arg(needle);
+    }
+
+    const int numWords = 3 + static_cast<int>(rng() % 18);
+    QStringList text;
+    for (int i = 0; i < numWords; ++i) {
+        text << words[static_cast<int>(rng() % words.size())];
+    }
+    return text.join(' ');
+}
+
+void BenchHistory::addDepthRows()
+{
+    QTest::addColumn<double>("depth");
+    QTest::newRow("newest") << 0.0;
+    QTest::newRow("middle") << 0.5;
+    QTest::newRow("oldest") << 1.0;
+}
+
+void BenchHistory::benchGetMessagesForChat_data()
+{
+    addDepthRows();
+}
+
+/**
+ * @brief Loads a page by its position, how reloading an evicted chunk pages
+ */
+void BenchHistory::benchGetMessagesForChat()
+{
+    QFETCH(double, depth);
+    const size_t last = deepChatSize - static_cast<size_t>(depth * (deepChatSize - pageSize));
+    const size_t first = last - pageSize;
+
+    QBENCHMARK {
+        QCOMPARE(history->getMessagesForChat(*deepChat, first, last).size(), pageSize);
+    }
+}
+
+void BenchHistory::benchGetMessagesForChatBefore_data()
+{
+    addDepthRows();
+}
+
+/**
+ * @brief Loads the page before a message, how scrolling up into history pages
+ */
+void BenchHistory::benchGetMessagesForChatBefore()
+{
+    QFETCH(double, depth);
+    const size_t last = deepChatSize - static_cast<size_t>(depth * (deepChatSize - pageSize));
+    const auto anchor = history->getMessagesForChat(*deepChat, last - 1, last);
+    QCOMPARE(anchor.size(), 1);
+    const RowId beforeId = anchor.first().id;
+
+    QBENCHMARK {
+        QVERIFY(!history->getMessagesForChatBefore(*deepChat, beforeId, pageSize).isEmpty());
+    }
+}
+
+void BenchHistory::benchFindPhrase_data()
+{
+    QTest::addColumn<FilterSearch>("filter");
+    QTest::newRow("default") << FilterSearch::None;
+    QTest::newRow("case sensitive") << FilterSearch::Register;
+    QTest::newRow("words only") << FilterSearch::WordsOnly;
+    QTest::newRow("regex") << FilterSearch::Regular;
+}
+
+void BenchHistory::benchFindPhrase()
+{
+    QFETCH(FilterSearch, filter);
+    ParameterSearch parameter;
+    parameter.filter = filter;
+
+    QBENCHMARK {
+        QVERIFY(history->getDateWhereFindPhrase(*deepChat, QDateTime(), needle, parameter).isValid());
+    }
+}
+
+void BenchHistory::benchDateBoundaries()
+{
+    const QDate from = QDateTime::currentDateTime().addYears(-4).date();
+
+    QBENCHMARK {
+        QVERIFY(!history->getNumMessagesForChatBeforeDateBoundaries(*deepChat, from, 0).isEmpty());
+    }
+}
+
+/**
+ * @brief Messages arriving one after the other, like a busy group, until they are on disk
+ */
+void BenchHistory::benchInsertBurst()
+{
+    QDateTime time = QDateTime::currentDateTime();
+
+    QBENCHMARK {
+        for (int i = 0; i < burstSize; ++i) {
+            time = time.addMSecs(10);
+            history->addNewMessage(*deepChat, makeText(i), *deepChat, time, true, ExtensionSet(),
+                                   QStringLiteral("sender"));
+        }
+        db->sync();
+    }
+}
+
+/**
+ * @brief Opening the encrypted database and checking its schema, what loading a profile does
+ */
+void BenchHistory::benchOpenProfile()
+{
+    QBENCHMARK {
+        auto openedDb = std::make_shared<RawDatabase>(dbPath, benchPassword, salt);
+        QVERIFY(openedDb->isOpen());
+        auto openedHistory = std::make_shared<History>(openedDb, *settings, *messageBoxManager);
+        QVERIFY(openedHistory->isValid());
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchHistory)
+#include "history_bench.moc"
@@ -0,0 +1,297 @@
+/*
+    Copyright © 2022 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "audio/audio.h"
+#include "audio/iaudiocontrol.h"
+#include "audio/iaudiosink.h"
+#include "src/core/callaudiodsp.h"
+#include "src/core/polyphaseresampler.h"
+#include "src/video/corevideosource.h"
+#include "src/video/videoframe.h"
+#include "mock/mockaudiosettings.h"
+
+#include <QTest>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <vpx/vpx_image.h>
+}
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Microbenchmarks of the media pipeline.
+ *
+ * Not part of ctest, run "qtox_bench -o bench.xml,xml" or "qtox_bench -csv" and compare the
+ * results across builds. The "bench" target writes bench.xml to the build directory.
+ */
+
+namespace {
+const size_t audioFrameSamples = IAudioControl::AUDIO_FRAME_SAMPLE_COUNT_PER_CHANNEL;
+const double pi = 3.14159265358979323846;
+
+/**
+ * @brief A 1080p YUV420P frame with a gradient, like a camera would deliver it.
+ */
+AVFrame* makeSourceFrame()
+{
+    AVFrame* frame = av_frame_alloc();
+    frame->width = 1920;
+    frame->height = 1080;
+    frame->format = AV_PIX_FMT_YUV420P;
+    av_frame_get_buffer(frame, VideoFrame::dataAlignment);
+
+    for (int plane = 0; plane < 3; ++plane) {
+        const int height = plane == 0 ? frame->height : frame->height / 2;
+        for (int y = 0; y < height; ++y) {
+            uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+            for (int x = 0; x < frame->linesize[plane]; ++x) {
+                row[x] = static_cast<uint8_t>(x + y + plane * 64);
+            }
+        }
+    }
+
+    return frame;
+}
+
+/**
+ * @brief Speech-like test signal, a tone with some harmonics.
+ */
+std::vector<int16_t> makeSpeech(size_t samples, uint32_t sampleRate)
+{
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        const double t = static_cast<double>(i) / sampleRate;
+        const double v = std::sin(2 * pi * 220 * t) + 0.5 * std::sin(2 * pi * 440 * t)
+                         + 0.25 * std::sin(2 * pi * 1320 * t);
+        pcm[i] = static_cast<int16_t>(v * 6000);
+    }
+    return pcm;
+}
+
+void addVideoSizes()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::newRow("1080p") << QSize(1920, 1080);
+    QTest::newRow("720p") << QSize(1280, 720);
+    QTest::newRow("360p") << QSize(640, 360);
+}
+} // namespace
+
+class BenchMediaPipeline : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchToToxYUVFrame_data();
+    void benchToToxYUVFrame();
+    void benchToQImage_data();
+    void benchToQImage();
+    void benchDownsample48To16();
+    void benchUpsample16To48();
+    void benchAecmNsxFrame();
+    void benchTransientSuppression_data();
+    void benchTransientSuppression();
+    void benchPushFrame_data();
+    void benchPushFrame();
+    void benchPlayAudioBuffer();
+
+private:
+    AVFrame* sourceFrame = nullptr;
+    MockAudioSettings audioSettings;
+};
+
+void BenchMediaPipeline::initTestCase()
+{
+    sourceFrame = makeSourceFrame();
+    QVERIFY(sourceFrame->data[0] != nullptr);
+}
+
+void BenchMediaPipeline::cleanupTestCase()
+{
+    av_frame_free(&sourceFrame);
+}
+
+void BenchMediaPipeline::benchToToxYUVFrame_data()
+{
+    addVideoSizes();
+}
+
+void BenchMediaPipeline::benchToToxYUVFrame()
+{
+    QFETCH(QSize, size);
+
+    QBENCHMARK {
+        // a new frame each time, VideoFrame caches its conversions
+        VideoFrame frame{0, av_frame_clone(sourceFrame), true};
+        QVERIFY(frame.toToxYUVFrame(size).isValid());
+    }
+}
+
+void BenchMediaPipeline::benchToQImage_data()
+{
+    addVideoSizes();
+}
+
+void BenchMediaPipeline::benchToQImage()
+{
+    QFETCH(QSize, size);
+
+    QBENCHMARK {
+        VideoFrame frame{0, av_frame_clone(sourceFrame), true};
+        QVERIFY(!frame.toQImage(size).isNull());
+    }
+}
+
+void BenchMediaPipeline::benchDownsample48To16()
+{
+    const std::vector<int16_t> in = makeSpeech(audioFrameSamples, 48000);
+    std::vector<int16_t> out(audioFrameSamples / PolyphaseResampler::FACTOR);
+    PolyphaseResampler resampler{PolyphaseResampler::Direction::Downsample, audioFrameSamples};
+
+    QBENCHMARK {
+        QCOMPARE(resampler.process(in.data(), in.size(), out.data()), out.size());
+    }
+}
+
+void BenchMediaPipeline::benchUpsample16To48()
+{
+    const size_t inSamples = audioFrameSamples / PolyphaseResampler::FACTOR;
+    const std::vector<int16_t> in = makeSpeech(inSamples, 16000);
+    std::vector<int16_t> out(audioFrameSamples);
+    PolyphaseResampler resampler{PolyphaseResampler::Direction::Upsample, inSamples};
+
+    QBENCHMARK {
+        QCOMPARE(resampler.process(in.data(), in.size(), out.data()), out.size());
+    }
+}
+
+void BenchMediaPipeline::benchAecmNsxFrame()
+{
+    const std::vector<int16_t> farEnd = makeSpeech(audioFrameSamples, 48000);
+    std::vector<int16_t> nearEnd = farEnd;
+    for (int16_t& sample : nearEnd) {
+        sample /= 4;
+    }
+
+    CallAudioDsp dsp;
+    dsp.setAecMode(audioSettings.getAecechomode());
+    dsp.setNsMode(audioSettings.getAecechonsmode());
+
+    QBENCHMARK {
+        dsp.bufferFarEnd(farEnd.data(), farEnd.size());
+        QVERIFY(dsp.processNearEnd(nearEnd.data(), nearEnd.size(), audioSettings.getEchoLatency(),
+                                   false)
+                != nullptr);
+    }
+}
+
+void BenchMediaPipeline::benchTransientSuppression_data()
+{
+    QTest::addColumn<bool>("enabled");
+    QTest::newRow("off") << false;
+    QTest::newRow("on") << true;
+}
+
+/**
+ * @brief Cost of one 10ms frame through the DSP chain, the difference between the rows is the
+ * cost of the transient suppressor.
+ */
+void BenchMediaPipeline::benchTransientSuppression()
+{
+    QFETCH(bool, enabled);
+
+    const size_t frameSamples = IAudioControl::AUDIO_SAMPLE_RATE / 100;
+    std::vector<int16_t> nearEnd = makeSpeech(frameSamples, 48000);
+    // a broadband key click on top of the speech
+    uint32_t seed = 1;
+    for (size_t i = frameSamples / 4; i < frameSamples / 4 + 96; ++i) {
+        seed = seed * 1103515245 + 12345;
+        nearEnd[i] = static_cast<int16_t>(static_cast<int>((seed >> 16) % 24000) - 12000);
+    }
+
+    CallAudioDsp dsp;
+    dsp.setAecMode(audioSettings.getAecechomode());
+    dsp.setNsMode(audioSettings.getAecechonsmode());
+    dsp.setTransientSuppression(enabled);
+    // keep typing, so the suppressor is enabled and not only analyzing
+    for (int i = 0; i < 100; ++i) {
+        dsp.processNearEnd(nearEnd.data(), nearEnd.size(), audioSettings.getEchoLatency(), true);
+    }
+
+    QBENCHMARK {
+        QVERIFY(dsp.processNearEnd(nearEnd.data(), nearEnd.size(), audioSettings.getEchoLatency(),
+                                   true)
+                != nullptr);
+    }
+}
+
+void BenchMediaPipeline::benchPushFrame_data()
+{
+    addVideoSizes();
+}
+
+void BenchMediaPipeline::benchPushFrame()
+{
+    QFETCH(QSize, size);
+
+    vpx_image image{};
+    image.d_w = size.width();
+    image.d_h = size.height();
+    image.planes[0] = sourceFrame->data[0];
+    image.planes[1] = sourceFrame->data[1];
+    image.planes[2] = sourceFrame->data[2];
+    image.stride[0] = sourceFrame->linesize[0];
+    image.stride[1] = sourceFrame->linesize[1];
+    image.stride[2] = sourceFrame->linesize[2];
+
+    CoreVideoSource source;
+    source.subscribe();
+
+    QBENCHMARK {
+        source.pushFrame(&image);
+    }
+
+    source.unsubscribe();
+}
+
+void BenchMediaPipeline::benchPlayAudioBuffer()
+{
+    // OpenAL Soft's null backend, measures our queueing without a sound card
+    qputenv("ALSOFT_DRIVERS", "null");
+    std::unique_ptr<IAudioControl> audio = Audio::makeAudio(audioSettings);
+    std::unique_ptr<IAudioSink> sink = audio->makeSink();
+    if (!sink) {
+        QSKIP("No OpenAL output device available");
+    }
+
+    const std::vector<int16_t> pcm = makeSpeech(audioFrameSamples, 48000);
+
+    QBENCHMARK {
+        sink->playAudioBuffer(pcm.data(), pcm.size(), 1, IAudioControl::AUDIO_SAMPLE_RATE);
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchMediaPipeline)
+#include "mediapipeline_bench.moc"
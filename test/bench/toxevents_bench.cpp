@@ -0,0 +1,437 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mock/mockbootstraplistgenerator.h"
+#include "mock/mockcoresettings.h"
+#include "src/chatlog/chatwidget.h"
+#include "src/chatlog/documentcache.h"
+#include "src/core/core.h"
+#include "src/core/groupid.h"
+#include "src/core/toxeventrecorder.h"
+#include "src/core/toxeventreplayer.h"
+#include "src/friendlist.h"
+#include "src/grouplist.h"
+#include "src/model/message.h"
+#include "src/model/sessionchatlog.h"
+#include "src/model/status.h"
+#include "src/persistence/blobstore.h"
+#include "src/persistence/db/rawdatabase.h"
+#include "src/persistence/history.h"
+#include "src/persistence/settings.h"
+#include "src/persistence/smileypack.h"
+#include "src/widget/style.h"
+#include "src/widget/tool/imessageboxmanager.h"
+#include "util/threadcputime.h"
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <tuple>
+
+Q_DECLARE_METATYPE(ToxPk)
+Q_DECLARE_METATYPE(Status::Status)
+
+/**
+ * @brief Load tests replaying tox events into a Core, with the chat log, history and chat
+ * widget a real session would update.
+ *
+ * Not part of ctest, run "qtox_toxevents_bench -o toxevents_bench.xml,xml" and compare the
+ * results across builds. The Core runs on toxcore without network, the events go through its
+ * callbacks via ToxEventReplayer. Received messages are added to a shown ChatWidget and written
+ * to an encrypted History, so the reported time covers the Core, GUI and database work. Besides
+ * the QtTest result every benchmark prints the CPU time of the GUI thread and the whole process,
+ * the longest the GUI event loop didn't respond and how long the database took to catch up.
+ *
+ * Two generated scenarios run by default, a group flood and a reconnect storm. Set
+ * QTOX_REPLAY_EVENTS to a file written with --record-tox-events to replay real traffic too.
+ * Events are replayed as fast as possible, set QTOX_REPLAY_SPEED to 1 for their recorded
+ * timing or e.g. 10 for ten times faster.
+ */
+
+namespace {
+using Event = ToxEventRecorder::Event;
+using Type = ToxEventRecorder::Type;
+
+constexpr int floodGroups = 4;
+constexpr int floodPeers = 50;
+constexpr int stormFriends = 200;
+constexpr int heartbeatMs = 5;
+constexpr int replayTimeoutMs = 10 * 60 * 1000;
+const QString benchPassword = QStringLiteral("qTox tox events benchmark");
+
+int envInt(const char* name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+double replaySpeed()
+{
+    bool ok = false;
+    const double speed = qEnvironmentVariable("QTOX_REPLAY_SPEED").toDouble(&ok);
+    return ok ? speed : 0;
+}
+
+/**
+ * @brief Stable made up key for a friend or peer number, the recording has none.
+ */
+ToxPk makeKey(int group, int number)
+{
+    const QByteArray seed = QByteArray::number(group) + ':' + QByteArray::number(number);
+    return ToxPk{QCryptographicHash::hash(seed, QCryptographicHash::Sha256)};
+}
+
+/**
+ * @brief Peers joining groups, then a burst of messages with a few renames in between.
+ */
+QVector<Event> makeGroupFlood(int numMessages, std::mt19937& rng)
+{
+    QVector<Event> events;
+    qint64 timeUs = 0;
+    for (uint32_t group = 0; group < floodGroups; ++group) {
+        for (uint32_t peer = 0; peer < floodPeers; ++peer) {
+            events.append({timeUs, Type::NgcPeerJoin, group, peer, 0, 0, {}});
+            timeUs += 200;
+        }
+    }
+
+    for (int i = 0; i < numMessages; ++i) {
+        timeUs += static_cast<qint64>(rng() % 20000);
+        const uint32_t group = rng() % floodGroups;
+        const uint32_t peer = rng() % floodPeers;
+        if (i % 100 == 50) {
+            const uint32_t nameLength = 8 + rng() % 16;
+            events.append({timeUs, Type::NgcPeerName, group, peer, 0, nameLength, {}});
+            continue;
+        }
+        const uint32_t length = 20 + rng() % 400;
+        events.append({timeUs, Type::NgcMessage, group, peer, TOX_MESSAGE_TYPE_NORMAL, length, {}});
+    }
+    return events;
+}
+
+/**
+ * @brief Friends dropping and coming back in waves, each time resending their name, status
+ * message and status like toxcore does.
+ */
+QVector<Event> makeReconnectStorm(int rounds, std::mt19937& rng)
+{
+    QVector<Event> events;
+    qint64 timeUs = 0;
+    for (int round = 0; round < rounds; ++round) {
+        events.append({timeUs, Type::SelfConnection, 0, 0, TOX_CONNECTION_NONE, 0, {}});
+        for (uint32_t friendId = 0; friendId < stormFriends; ++friendId) {
+            events.append(
+                {timeUs, Type::FriendConnection, friendId, 0, TOX_CONNECTION_NONE, 0, {}});
+        }
+
+        timeUs += 500000;
+        events.append({timeUs, Type::SelfConnection, 0, 0, TOX_CONNECTION_TCP, 0, {}});
+        for (uint32_t friendId = 0; friendId < stormFriends; ++friendId) {
+            timeUs += static_cast<qint64>(rng() % 5000);
+            const uint32_t connection = rng() % 2 ? TOX_CONNECTION_TCP : TOX_CONNECTION_UDP;
+            events.append({timeUs, Type::FriendConnection, friendId, 0, connection, 0, {}});
+            const uint32_t nameLength = 4 + rng() % 20;
+            const uint32_t statusLength = rng() % 80;
+            events.append({timeUs, Type::FriendName, friendId, 0, 0, nameLength, {}});
+            events.append({timeUs, Type::FriendStatusMessage, friendId, 0, 0, statusLength, {}});
+            events.append({timeUs, Type::FriendStatus, friendId, 0, TOX_USER_STATUS_NONE, 0, {}});
+        }
+        timeUs += 2000000;
+    }
+    return events;
+}
+
+qint64 guiCpuNs()
+{
+    for (const ThreadCpuTime::Sample& sample : ThreadCpuTime::sample()) {
+        if (sample.name == QLatin1String("GUI")) {
+            return sample.cpuNs;
+        }
+    }
+    return 0;
+}
+
+class BenchMessageBoxManager : public IMessageBoxManager
+{
+public:
+    void showInfo(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showWarning(const QString& title, const QString& msg) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+    }
+    void showError(const QString& title, const QString& msg) override
+    {
+        qWarning() << title << msg;
+    }
+    bool askQuestion(const QString& title, const QString& msg, bool defaultAns = false,
+                     bool warning = true, bool yesno = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = warning;
+        std::ignore = yesno;
+        return defaultAns;
+    }
+    bool askQuestion(const QString& title, const QString& msg, const QString& button1,
+                     const QString& button2, bool defaultAns = false, bool warning = true) override
+    {
+        std::ignore = title;
+        std::ignore = msg;
+        std::ignore = button1;
+        std::ignore = button2;
+        std::ignore = warning;
+        return defaultAns;
+    }
+    void confirmExecutableOpen(const QFileInfo& file) override
+    {
+        std::ignore = file;
+    }
+};
+} // namespace
+
+class BenchToxEvents : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchGroupFlood();
+    void benchReconnectStorm();
+    void benchRecording();
+
+private:
+    void replay(const QVector<Event>& events);
+    void onMessage(const ChatId& chatId, const ToxPk& sender, const QString& text, bool isAction,
+                   bool isPrivate, int hasIdType);
+
+    std::unique_ptr<QTemporaryDir> dir;
+    std::unique_ptr<BenchMessageBoxManager> messageBoxManager;
+    std::unique_ptr<Settings> settings;
+    std::shared_ptr<RawDatabase> db;
+    std::shared_ptr<History> history;
+    MockSettings coreSettings;
+    MockBootstrapListGenerator bootstrapNodes;
+    ToxCorePtr core;
+    std::unique_ptr<FriendList> friendList;
+    std::unique_ptr<GroupList> groupList;
+    std::unique_ptr<SessionChatLog> chatLog;
+    std::unique_ptr<SmileyPack> smileyPack;
+    std::unique_ptr<DocumentCache> documentCache;
+    std::unique_ptr<Style> style;
+    std::unique_ptr<BlobStore> blobStore;
+    std::unique_ptr<ChatWidget> chatWidget;
+    std::mt19937 rng{42};
+    int receivedMessages = 0;
+    int statusUpdates = 0;
+};
+
+void BenchToxEvents::initTestCase()
+{
+    // don't touch the settings of the user running the benchmark
+    QStandardPaths::setTestModeEnabled(true);
+    dir = std::unique_ptr<QTemporaryDir>(new QTemporaryDir());
+    QVERIFY(dir->isValid());
+    qRegisterMetaType<ToxPk>("ToxPk");
+    qRegisterMetaType<uint32_t>("uint32_t");
+    qRegisterMetaType<Status::Status>("Status::Status");
+
+    messageBoxManager = std::unique_ptr<BenchMessageBoxManager>(new BenchMessageBoxManager());
+    settings = std::unique_ptr<Settings>(new Settings(*messageBoxManager));
+    settings->setEnableLogging(true);
+
+    QByteArray salt(ToxPk::size, Qt::Uninitialized);
+    for (char& c : salt) {
+        c = static_cast<char>(rng());
+    }
+    db = std::make_shared<RawDatabase>(dir->filePath("bench.db"), benchPassword, salt);
+    QVERIFY(db->isOpen());
+    history = std::make_shared<History>(db, *settings, *messageBoxManager);
+    QVERIFY(history->isValid());
+
+    core = Core::makeToxCore({}, coreSettings, bootstrapNodes);
+    QVERIFY(core);
+
+    friendList = std::unique_ptr<FriendList>(new FriendList());
+    groupList = std::unique_ptr<GroupList>(new GroupList());
+    chatLog = std::unique_ptr<SessionChatLog>(new SessionChatLog(*core, *friendList, *groupList));
+    smileyPack = std::unique_ptr<SmileyPack>(new SmileyPack(*settings));
+    documentCache = std::unique_ptr<DocumentCache>(new DocumentCache(*smileyPack, *settings));
+    style = std::unique_ptr<Style>(new Style());
+    blobStore = std::unique_ptr<BlobStore>(new BlobStore(dir->filePath("blobs"), nullptr));
+    chatWidget = std::unique_ptr<ChatWidget>(
+        new ChatWidget(*chatLog, *core, *documentCache, *smileyPack, *settings, *style,
+                       *messageBoxManager, *blobStore));
+    chatWidget->resize(640, 720);
+    chatWidget->show();
+    QVERIFY(QTest::qWaitForWindowExposed(chatWidget.get()));
+
+    // queued to this thread, like Widget receives them
+    connect(core.get(), &Core::groupMessageReceived, this,
+            [this](int groupnumber, int peernumber, const QString& message, bool isAction,
+                   bool isPrivate, int hasIdType) {
+                const GroupId groupId{makeKey(-1, groupnumber).getByteArray()};
+                onMessage(groupId, makeKey(groupnumber, peernumber), message, isAction,
+                          isPrivate, hasIdType);
+            });
+    connect(core.get(), &Core::friendMessageReceived, this,
+            [this](uint32_t friendId, const QString& message, bool isAction, int hasIdType) {
+                const ToxPk friendPk = makeKey(-1, static_cast<int>(friendId));
+                onMessage(friendPk, friendPk, message, isAction, false, hasIdType);
+            });
+    connect(core.get(), &Core::friendStatusChanged, this, [this] { ++statusUpdates; });
+    connect(core.get(), &Core::friendUsernameChanged, this, [this] { ++statusUpdates; });
+    connect(core.get(), &Core::friendStatusMessageChanged, this, [this] { ++statusUpdates; });
+
+    QSignalSpy idSet(core.get(), &Core::idSet);
+    core->start();
+    QVERIFY(idSet.wait());
+}
+
+void BenchToxEvents::cleanupTestCase()
+{
+    chatWidget.reset();
+    chatLog.reset();
+    documentCache.reset();
+    smileyPack.reset();
+    core.reset();
+    history.reset();
+    db.reset();
+    settings.reset();
+}
+
+void BenchToxEvents::onMessage(const ChatId& chatId, const ToxPk& sender, const QString& text,
+                               bool isAction, bool isPrivate, int hasIdType)
+{
+    ++receivedMessages;
+    const QDateTime now = QDateTime::currentDateTime();
+    const Message message{isAction, text, now, ExtensionSet(), {}, QString(), isPrivate};
+    chatLog->onMessageReceived(sender, message, hasIdType);
+    history->addNewMessage(chatId, text, sender, now, true, ExtensionSet(),
+                           sender.toString().left(8), {}, hasIdType, isPrivate);
+}
+
+/**
+ * @brief Replays the events and waits until the GUI thread and the database took them in.
+ */
+void BenchToxEvents::replay(const QVector<Event>& events)
+{
+    QVERIFY(!events.isEmpty());
+    receivedMessages = 0;
+    statusUpdates = 0;
+
+    // created here, but lives on the Core thread
+    std::unique_ptr<ToxEventReplayer> replayer{new ToxEventReplayer(*core, events, replaySpeed())};
+    QEventLoop loop;
+    bool finished = false;
+    // queued, finished() is emitted on the Core thread after everything the events emitted
+    connect(replayer.get(), &ToxEventReplayer::finished, &loop, [&loop, &finished] {
+        finished = true;
+        loop.quit();
+    });
+    QTimer::singleShot(replayTimeoutMs, &loop, &QEventLoop::quit);
+
+    QElapsedTimer heartbeat;
+    qint64 maxGapMs = 0;
+    QTimer ticker;
+    ticker.setInterval(heartbeatMs);
+    connect(&ticker, &QTimer::timeout, this, [&heartbeat, &maxGapMs] {
+        maxGapMs = std::max(maxGapMs, heartbeat.restart());
+    });
+
+    const qint64 processStartNs = ThreadCpuTime::processNs();
+    const qint64 guiStartNs = guiCpuNs();
+    qint64 dbMs = 0;
+    QBENCHMARK_ONCE {
+        heartbeat.start();
+        ticker.start();
+        replayer->start();
+        loop.exec();
+        QVERIFY(finished);
+        QCoreApplication::processEvents();
+        ticker.stop();
+
+        QElapsedTimer dbTimer;
+        dbTimer.start();
+        db->sync();
+        dbMs = dbTimer.elapsed();
+    }
+
+    const ToxEventReplayer::Stats stats = replayer->getStats();
+    qInfo() << "Replayed" << stats.events << "events in" << stats.wallUs / 1000 << "ms, max lag"
+            << stats.maxLagUs / 1000 << "ms," << receivedMessages << "messages and"
+            << statusUpdates << "friend updates reached the GUI thread";
+    qInfo() << "CPU: GUI thread" << (guiCpuNs() - guiStartNs) / 1000000 << "ms, process"
+            << (ThreadCpuTime::processNs() - processStartNs) / 1000000
+            << "ms, longest GUI stall" << maxGapMs << "ms, database caught up in" << dbMs << "ms";
+    QCOMPARE(stats.events, events.size());
+}
+
+void BenchToxEvents::benchGroupFlood()
+{
+    replay(makeGroupFlood(envInt("QTOX_BENCH_FLOOD_MESSAGES", 20000), rng));
+}
+
+void BenchToxEvents::benchReconnectStorm()
+{
+    replay(makeReconnectStorm(envInt("QTOX_BENCH_STORM_ROUNDS", 20), rng));
+}
+
+void BenchToxEvents::benchRecording()
+{
+    const QString path = qEnvironmentVariable("QTOX_REPLAY_EVENTS");
+    if (path.isEmpty()) {
+        QSKIP("Set QTOX_REPLAY_EVENTS to a file written with --record-tox-events");
+    }
+
+    QVector<Event> events;
+    QVERIFY(ToxEventRecorder::load(path, events));
+    replay(events);
+}
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    ThreadCpuTime::registerCurrentThread(QStringLiteral("GUI"));
+    BenchToxEvents bench;
+    return QTest::qExec(&bench, argc, argv);
+}
+
+#include "toxevents_bench.moc"
@@ -235,6 +235,11 @@ void TestChatLineStorage::testDateLineRemoval()
 
     QVERIFY(!storage.contains(initialTimestamp));
     QCOMPARE(idxFromChatLine(storage[0]).get(), initialStartIdx);
+
+    // The message after the date line must still be indexed
+    QVERIFY(storage.contains(ChatLogIdx(initialStartIdx)));
+    QCOMPARE(idxFromChatLine(storage[ChatLogIdx(initialStartIdx)]).get(), initialStartIdx);
+    QCOMPARE(storage.find(ChatLogIdx(initialStartIdx)), storage.begin());
 }
 
 void TestChatLineStorage::testInsertionBeforeDates()
@@ -0,0 +1,79 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/chatlog/sendercolorcache.h"
+
+#include <QtTest/QtTest>
+
+namespace {
+const QString PUBKEY = QStringLiteral("C7719C6808C14B77348004956D1D98046CE09A34370E7608150EAD74C3815D30");
+} // namespace
+
+class TestSenderColorCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testMatchesComputed();
+    void testKeyedByPubkey();
+    void testBaseColorChange();
+    void testBounded();
+};
+
+void TestSenderColorCache::testMatchesComputed()
+{
+    SenderColorCache cache;
+    const QColor base{Qt::black};
+    QCOMPARE(cache.get(PUBKEY, "Alice", base), SenderColorCache::computeColor(PUBKEY, "Alice", base));
+    QCOMPARE(cache.get({}, "Bob", base), SenderColorCache::computeColor({}, "Bob", base));
+    QCOMPARE(cache.size(), 2);
+}
+
+void TestSenderColorCache::testKeyedByPubkey()
+{
+    SenderColorCache cache;
+    const QColor base{Qt::black};
+    const QColor color = cache.get(PUBKEY, "Alice", base);
+
+    // a renamed peer keeps its color and entry
+    QCOMPARE(cache.get(PUBKEY, "Alice renamed", base), color);
+    QCOMPARE(cache.size(), 1);
+}
+
+void TestSenderColorCache::testBaseColorChange()
+{
+    SenderColorCache cache;
+    cache.get(PUBKEY, "Alice", QColor{Qt::black});
+    const QColor white{Qt::white};
+    QCOMPARE(cache.get(PUBKEY, "Alice", white), SenderColorCache::computeColor(PUBKEY, "Alice", white));
+    QCOMPARE(cache.size(), 1);
+}
+
+void TestSenderColorCache::testBounded()
+{
+    SenderColorCache cache;
+    const QColor base{Qt::black};
+    for (int i = 0; i <= SenderColorCache::MAX_ENTRIES; ++i) {
+        cache.get({}, QString::number(i), base);
+    }
+
+    QVERIFY(cache.size() <= SenderColorCache::MAX_ENTRIES);
+}
+
+QTEST_GUILESS_MAIN(TestSenderColorCache)
+#include "sendercolorcache_test.moc"
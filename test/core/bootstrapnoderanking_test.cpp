@@ -0,0 +1,258 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/bootstrapnoderanking.h"
+
+#include <QTest>
+
+namespace {
+using Outcome = BootstrapNodeRanking::Outcome;
+
+const qint64 testNowSecs = 1600000000;
+
+DhtServer makeNode(char keyByte)
+{
+    DhtServer node;
+    node.statusUdp = true;
+    node.statusTcp = true;
+    node.ipv4 = "127.0.0.1";
+    node.publicKey = ToxPk{QByteArray(ToxPk::size, keyByte)};
+    node.udpPort = 33445;
+    node.tcpPorts = {33445};
+    return node;
+}
+
+BootstrapNodeRanking::ProbeResult answered(qint64 udpRttMs, qint64 tcpRttMs)
+{
+    return {Outcome::Ok, udpRttMs, Outcome::Ok, tcpRttMs};
+}
+
+BootstrapNodeRanking::ProbeResult failed()
+{
+    return {Outcome::Failed, -1, Outcome::Failed, -1};
+}
+} // namespace
+
+class TestBootstrapNodeRanking : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testUnknownNodes();
+    void testRankByLatency();
+    void testFailuresRankLast();
+    void testTcpOnly();
+    void testSkippedIgnored();
+    void testConnectedFirst();
+    void testConnectedForgottenOnFailure();
+    void testProbeCandidates();
+    void testNeedsProbe();
+    void testSaveLoad();
+    void testSaveDropsOldNodes();
+    void testSaveConnectState();
+    void testLoadInvalid();
+};
+
+void TestBootstrapNodeRanking::testUnknownNodes()
+{
+    BootstrapNodeRanking ranking;
+    const QList<DhtServer> nodes{makeNode(1), makeNode(2), makeNode(3)};
+    const auto ranked = ranking.rank(nodes, false);
+    QCOMPARE(ranked.size(), nodes.size());
+    for (const auto& node : nodes) {
+        QVERIFY(ranked.contains(node));
+        QCOMPARE(ranking.expectedLatencyMs(node.publicKey, false),
+                 BootstrapNodeRanking::UNKNOWN_LATENCY_MS);
+    }
+}
+
+void TestBootstrapNodeRanking::testRankByLatency()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer slow = makeNode(1);
+    const DhtServer fast = makeNode(2);
+    const DhtServer unknown = makeNode(3);
+    ranking.recordProbe(slow.publicKey, answered(400, 500), testNowSecs);
+    ranking.recordProbe(fast.publicKey, answered(30, 60), testNowSecs);
+
+    const auto ranked = ranking.rank({unknown, slow, fast}, false);
+    QCOMPARE(ranked.at(0), fast);
+    QCOMPARE(ranked.at(1), slow);
+    QCOMPARE(ranked.at(2), unknown);
+    QCOMPARE(ranking.expectedLatencyMs(fast.publicKey, false), qint64{30});
+}
+
+void TestBootstrapNodeRanking::testFailuresRankLast()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer dead = makeNode(1);
+    const DhtServer flaky = makeNode(2);
+    const DhtServer unknown = makeNode(3);
+    ranking.recordProbe(dead.publicKey, failed(), testNowSecs);
+    ranking.recordProbe(flaky.publicKey, answered(50, 50), testNowSecs);
+    ranking.recordProbe(flaky.publicKey, failed(), testNowSecs);
+
+    const auto ranked = ranking.rank({dead, flaky, unknown}, false);
+    QCOMPARE(ranked.at(0), unknown);
+    QCOMPARE(ranked.at(1), flaky);
+    QCOMPARE(ranked.at(2), dead);
+    QCOMPARE(ranking.expectedLatencyMs(dead.publicKey, false),
+             BootstrapNodeRanking::PROBE_TIMEOUT_MS);
+}
+
+void TestBootstrapNodeRanking::testTcpOnly()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer udpOnly = makeNode(1);
+    const DhtServer tcp = makeNode(2);
+    ranking.recordProbe(udpOnly.publicKey, {Outcome::Ok, 10, Outcome::Failed, -1}, testNowSecs);
+    ranking.recordProbe(tcp.publicKey, answered(200, 200), testNowSecs);
+
+    QCOMPARE(ranking.rank({udpOnly, tcp}, false).at(0), udpOnly);
+    QCOMPARE(ranking.rank({udpOnly, tcp}, true).at(0), tcp);
+}
+
+void TestBootstrapNodeRanking::testSkippedIgnored()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer node = makeNode(1);
+    ranking.recordProbe(node.publicKey, {Outcome::Skipped, -1, Outcome::Ok, 80}, testNowSecs);
+    QCOMPARE(ranking.expectedLatencyMs(node.publicKey, false), qint64{80});
+    QCOMPARE(ranking.expectedLatencyMs(node.publicKey, true), qint64{80});
+}
+
+void TestBootstrapNodeRanking::testConnectedFirst()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer fast = makeNode(1);
+    const DhtServer older = makeNode(2);
+    const DhtServer recent = makeNode(3);
+    ranking.recordProbe(fast.publicKey, answered(10, 10), testNowSecs);
+    ranking.recordProbe(older.publicKey, answered(300, 300), testNowSecs);
+    ranking.markConnected({older.publicKey}, testNowSecs);
+    ranking.markConnected({recent.publicKey}, testNowSecs + 1);
+
+    const auto ranked = ranking.rank({fast, older, recent}, false);
+    QCOMPARE(ranked.at(0), recent);
+    QCOMPARE(ranked.at(1), older);
+    QCOMPARE(ranked.at(2), fast);
+}
+
+void TestBootstrapNodeRanking::testConnectedForgottenOnFailure()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer fast = makeNode(1);
+    const DhtServer gone = makeNode(2);
+    ranking.recordProbe(fast.publicKey, answered(10, 10), testNowSecs);
+    ranking.markConnected({gone.publicKey}, testNowSecs);
+
+    // one transport answering is enough to keep it
+    ranking.recordProbe(gone.publicKey, {Outcome::Failed, -1, Outcome::Ok, 500}, testNowSecs);
+    QCOMPARE(ranking.rank({fast, gone}, false).at(0), gone);
+
+    ranking.recordProbe(gone.publicKey, failed(), testNowSecs);
+    QCOMPARE(ranking.rank({fast, gone}, false).at(0), fast);
+}
+
+void TestBootstrapNodeRanking::testProbeCandidates()
+{
+    BootstrapNodeRanking ranking;
+    QList<DhtServer> nodes;
+    for (int i = 0; i < 3 * BootstrapNodeRanking::MAX_PROBED_NODES; ++i) {
+        nodes.append(makeNode(static_cast<char>(i + 1)));
+    }
+    const DhtServer best = nodes.last();
+    ranking.recordProbe(best.publicKey, answered(10, 10), testNowSecs);
+
+    const auto candidates = ranking.probeCandidates(nodes, false);
+    QCOMPARE(candidates.size(), BootstrapNodeRanking::MAX_PROBED_NODES);
+    QCOMPARE(candidates.at(0), best);
+
+    const QList<DhtServer> few = nodes.mid(0, 3);
+    QCOMPARE(ranking.probeCandidates(few, false).size(), few.size());
+}
+
+void TestBootstrapNodeRanking::testNeedsProbe()
+{
+    BootstrapNodeRanking ranking;
+    QVERIFY(ranking.needsProbe(testNowSecs));
+    ranking.setProbed(testNowSecs);
+    QVERIFY(!ranking.needsProbe(testNowSecs + 1));
+    QVERIFY(ranking.needsProbe(testNowSecs + BootstrapNodeRanking::PROBE_INTERVAL_SECS));
+    // the clock went backwards
+    QVERIFY(ranking.needsProbe(testNowSecs - 1));
+}
+
+void TestBootstrapNodeRanking::testSaveLoad()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer fast = makeNode(1);
+    const DhtServer dead = makeNode(2);
+    ranking.recordProbe(fast.publicKey, answered(30, 60), testNowSecs);
+    ranking.recordProbe(dead.publicKey, failed(), testNowSecs);
+    ranking.setProbed(testNowSecs);
+
+    BootstrapNodeRanking loaded;
+    QVERIFY(loaded.load(ranking.save(testNowSecs)));
+    QVERIFY(!loaded.needsProbe(testNowSecs + 1));
+    QCOMPARE(loaded.expectedLatencyMs(fast.publicKey, false), qint64{30});
+    QCOMPARE(loaded.expectedLatencyMs(fast.publicKey, true), qint64{60});
+    QCOMPARE(loaded.expectedLatencyMs(dead.publicKey, false),
+             BootstrapNodeRanking::PROBE_TIMEOUT_MS);
+}
+
+void TestBootstrapNodeRanking::testSaveDropsOldNodes()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer node = makeNode(1);
+    ranking.recordProbe(node.publicKey, answered(30, 30), testNowSecs);
+
+    BootstrapNodeRanking loaded;
+    QVERIFY(loaded.load(ranking.save(testNowSecs + BootstrapNodeRanking::MAX_AGE_SECS + 1)));
+    QCOMPARE(loaded.expectedLatencyMs(node.publicKey, false),
+             BootstrapNodeRanking::UNKNOWN_LATENCY_MS);
+}
+
+void TestBootstrapNodeRanking::testSaveConnectState()
+{
+    BootstrapNodeRanking ranking;
+    const DhtServer fast = makeNode(1);
+    const DhtServer connected = makeNode(2);
+    ranking.recordProbe(fast.publicKey, answered(10, 10), testNowSecs);
+    ranking.markConnected({connected.publicKey}, testNowSecs);
+    ranking.setLastUdpPort(33446);
+
+    BootstrapNodeRanking loaded;
+    QVERIFY(loaded.load(ranking.save(testNowSecs)));
+    QCOMPARE(loaded.getLastUdpPort(), quint16{33446});
+    QCOMPARE(loaded.rank({fast, connected}, false).at(0), connected);
+}
+
+void TestBootstrapNodeRanking::testLoadInvalid()
+{
+    BootstrapNodeRanking ranking;
+    QVERIFY(ranking.load({}));
+    QVERIFY(!ranking.load("not json"));
+    QVERIFY(ranking.load(R"({"nodes":[{"pk":"tooshort","udpRtt":1,"udpOk":1}]})"));
+    QCOMPARE(ranking.expectedLatencyMs(makeNode(1).publicKey, false),
+             BootstrapNodeRanking::UNKNOWN_LATENCY_MS);
+}
+
+QTEST_GUILESS_MAIN(TestBootstrapNodeRanking)
+#include "bootstrapnoderanking_test.moc"
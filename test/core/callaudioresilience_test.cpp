@@ -0,0 +1,133 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/callaudioresilience.h"
+
+#include <QTest>
+
+namespace {
+/**
+ * @brief Sends and receives frames for one update interval, dropping some of them.
+ * @return True if the profile changed.
+ */
+bool lossyInterval(CallAudioResilience& resilience, qint64& nowMs, int lostPercent,
+                   uint64_t& lateTotal)
+{
+    for (int i = 0; i < 50; ++i) {
+        resilience.onAudioSent(i * 2 < lostPercent);
+        lateTotal += i * 2 < lostPercent ? 1 : 0;
+        resilience.onAudioReceived(lateTotal);
+    }
+
+    nowMs += CallAudioResilience::UPDATE_INTERVAL_MS;
+    return resilience.update(nowMs);
+}
+} // namespace
+
+class TestCallAudioResilience : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testStartsWithoutFec();
+    void testNoUpdateWithinInterval();
+    void testLossEnablesFec();
+    void testHeavyLossShortensFrames();
+    void testRecoversSlowly();
+    void testSinkRestart();
+
+private:
+    CallAudioResilience resilience;
+    qint64 nowMs = 0;
+    uint64_t lateTotal = 0;
+};
+
+void TestCallAudioResilience::init()
+{
+    resilience.reset();
+    nowMs = 0;
+    lateTotal = 0;
+    // the first update only starts the clock
+    QVERIFY(!resilience.update(nowMs));
+}
+
+void TestCallAudioResilience::testStartsWithoutFec()
+{
+    QVERIFY(!lossyInterval(resilience, nowMs, 0, lateTotal));
+    const CallAudioResilience::Profile profile = resilience.getProfile();
+    QVERIFY(!profile.fec);
+    QCOMPARE(profile.expectedLossPercent, 0u);
+    QCOMPARE(profile.frameMs, CallAudioResilience::LONG_FRAME_MS);
+}
+
+void TestCallAudioResilience::testNoUpdateWithinInterval()
+{
+    resilience.onAudioSent(true);
+    QVERIFY(!resilience.update(nowMs + CallAudioResilience::UPDATE_INTERVAL_MS - 1));
+    QCOMPARE(resilience.getProfile().expectedLossPercent, 0u);
+}
+
+void TestCallAudioResilience::testLossEnablesFec()
+{
+    QVERIFY(lossyInterval(resilience, nowMs, 6, lateTotal));
+    const CallAudioResilience::Profile profile = resilience.getProfile();
+    QVERIFY(profile.fec);
+    QCOMPARE(profile.expectedLossPercent, 3u);
+    QCOMPARE(profile.frameMs, CallAudioResilience::LONG_FRAME_MS);
+}
+
+void TestCallAudioResilience::testHeavyLossShortensFrames()
+{
+    QVERIFY(lossyInterval(resilience, nowMs, 20, lateTotal));
+    const CallAudioResilience::Profile profile = resilience.getProfile();
+    QVERIFY(profile.fec);
+    QCOMPARE(profile.frameMs, CallAudioResilience::SHORT_FRAME_MS);
+}
+
+void TestCallAudioResilience::testRecoversSlowly()
+{
+    lossyInterval(resilience, nowMs, 20, lateTotal);
+
+    // one clean interval is not enough to trust the path again
+    QVERIFY(!lossyInterval(resilience, nowMs, 0, lateTotal));
+    QCOMPARE(resilience.getProfile().frameMs, CallAudioResilience::SHORT_FRAME_MS);
+
+    int intervals = 0;
+    while (resilience.getProfile().fec && intervals < 100) {
+        lossyInterval(resilience, nowMs, 0, lateTotal);
+        ++intervals;
+    }
+    QVERIFY(intervals > 5);
+    QVERIFY(!resilience.getProfile().fec);
+    QCOMPARE(resilience.getProfile().frameMs, CallAudioResilience::LONG_FRAME_MS);
+}
+
+void TestCallAudioResilience::testSinkRestart()
+{
+    lossyInterval(resilience, nowMs, 6, lateTotal);
+    const uint32_t lossPercent = resilience.getProfile().expectedLossPercent;
+
+    // a new sink counts from zero again, that is no loss
+    lateTotal = 0;
+    lossyInterval(resilience, nowMs, 0, lateTotal);
+    QVERIFY(resilience.getProfile().expectedLossPercent <= lossPercent);
+}
+
+QTEST_GUILESS_MAIN(TestCallAudioResilience)
+#include "callaudioresilience_test.moc"
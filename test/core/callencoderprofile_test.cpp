@@ -0,0 +1,74 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/callencoderprofile.h"
+
+#include <QTest>
+
+using Preset = CallEncoderProfile::Preset;
+
+class TestCallEncoderProfile : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testPresetFromInt();
+    void testFasterPresetsUseLessCpu();
+    void testStepsStopAtEnds();
+    void testScreenContent();
+};
+
+void TestCallEncoderProfile::testPresetFromInt()
+{
+    QCOMPARE(CallEncoderProfile::presetFromInt(-1), Preset::Quality);
+    QCOMPARE(CallEncoderProfile::presetFromInt(1), Preset::Balanced);
+    QCOMPARE(CallEncoderProfile::presetFromInt(CallEncoderProfile::PRESET_COUNT), Preset::Fast);
+}
+
+void TestCallEncoderProfile::testFasterPresetsUseLessCpu()
+{
+    const CallEncoderProfile quality{Preset::Quality, false};
+    const CallEncoderProfile balanced{Preset::Balanced, false};
+    const CallEncoderProfile fast{Preset::Fast, false};
+    QVERIFY(quality.getCpuUsed() < balanced.getCpuUsed());
+    QVERIFY(balanced.getCpuUsed() < fast.getCpuUsed());
+}
+
+void TestCallEncoderProfile::testStepsStopAtEnds()
+{
+    const CallEncoderProfile balanced{Preset::Balanced, true};
+    QCOMPARE(balanced.faster().getPreset(), Preset::Fast);
+    QCOMPARE(balanced.faster().faster().getPreset(), Preset::Fast);
+    QCOMPARE(balanced.slower().getPreset(), Preset::Quality);
+    QCOMPARE(balanced.slower().slower().getPreset(), Preset::Quality);
+    QVERIFY(balanced.faster().isScreenContent());
+}
+
+void TestCallEncoderProfile::testScreenContent()
+{
+    const CallEncoderProfile camera{Preset::Balanced, false};
+    const CallEncoderProfile screen{Preset::Balanced, true};
+    QVERIFY(!camera.getHighQuality());
+    QVERIFY(screen.getHighQuality());
+    QCOMPARE(camera.getCpuUsed(), screen.getCpuUsed());
+    QVERIFY(camera != screen);
+    QVERIFY(camera == CallEncoderProfile{});
+}
+
+QTEST_GUILESS_MAIN(TestCallEncoderProfile)
+#include "callencoderprofile_test.moc"
@@ -0,0 +1,192 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/callratecontroller.h"
+
+#include <QTest>
+
+namespace {
+const CallRateController::VideoLimits testLimits{500, 4000, 11000};
+const uint32_t testAudioKbps = 64;
+
+/**
+ * @brief Moves the controller forward by one update interval.
+ */
+bool nextInterval(CallRateController& controller, qint64& nowMs)
+{
+    nowMs += CallRateController::UPDATE_INTERVAL_MS;
+    return controller.update(nowMs);
+}
+} // namespace
+
+class TestCallRateController : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testStartValues();
+    void testNoUpdateWithinInterval();
+    void testRecommendationLowersVideo();
+    void testDroppedFramesDecrease();
+    void testLatencyIncreaseDecreases();
+    void testAudioOnlyLoweredAtVideoFloor();
+    void testAudioFloorHolds();
+    void testIncreaseAfterHold();
+    void testIncreaseStopsAtEncoderUsage();
+    void testNeverExceedsLimits();
+
+private:
+    CallRateController controller;
+    qint64 nowMs = 0;
+};
+
+void TestCallRateController::init()
+{
+    controller.reset(testAudioKbps, testLimits);
+    nowMs = 0;
+    // the first update only starts the clock
+    QVERIFY(!controller.update(nowMs));
+}
+
+void TestCallRateController::testStartValues()
+{
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps);
+    QCOMPARE(controller.getVideoBitrate(), testLimits.startKbps);
+    QCOMPARE(controller.getVideoLimits().minKbps, testLimits.minKbps);
+    QCOMPARE(controller.getVideoLimits().maxKbps, testLimits.maxKbps);
+}
+
+void TestCallRateController::testNoUpdateWithinInterval()
+{
+    controller.onRecommendedVideoBitrate(1000);
+    QVERIFY(!controller.update(nowMs + CallRateController::UPDATE_INTERVAL_MS - 1));
+    QCOMPARE(controller.getVideoBitrate(), testLimits.startKbps);
+}
+
+void TestCallRateController::testRecommendationLowersVideo()
+{
+    controller.onRecommendedVideoBitrate(1000);
+    QVERIFY(nextInterval(controller, nowMs));
+    QCOMPARE(controller.getVideoBitrate(), 1000u);
+
+    // recommendations below the floor are clamped
+    controller.onRecommendedVideoBitrate(100);
+    QVERIFY(nextInterval(controller, nowMs));
+    QCOMPARE(controller.getVideoBitrate(), testLimits.minKbps);
+}
+
+void TestCallRateController::testDroppedFramesDecrease()
+{
+    for (int i = 0; i < 10; ++i) {
+        controller.onVideoSent(5, i == 0);
+    }
+    QVERIFY(nextInterval(controller, nowMs));
+    QCOMPARE(controller.getVideoBitrate(), testLimits.startKbps * 85 / 100);
+}
+
+void TestCallRateController::testLatencyIncreaseDecreases()
+{
+    // establish a base latency
+    for (int i = 0; i < 25; ++i) {
+        controller.onVideoSent(5, false);
+    }
+    QVERIFY(!nextInterval(controller, nowMs));
+
+    for (int i = 0; i < 25; ++i) {
+        controller.onVideoSent(40, false);
+    }
+    QVERIFY(nextInterval(controller, nowMs));
+    QVERIFY(controller.getVideoBitrate() < testLimits.startKbps);
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps);
+}
+
+void TestCallRateController::testAudioOnlyLoweredAtVideoFloor()
+{
+    controller.onRecommendedVideoBitrate(testLimits.minKbps);
+    QVERIFY(nextInterval(controller, nowMs));
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps);
+
+    controller.onAudioSent(1, true);
+    QVERIFY(nextInterval(controller, nowMs));
+    QCOMPARE(controller.getVideoBitrate(), testLimits.minKbps);
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps * 3 / 4);
+
+    // never below the audio floor
+    for (int i = 0; i < 20; ++i) {
+        controller.onAudioSent(1, true);
+        nextInterval(controller, nowMs);
+    }
+    QCOMPARE(controller.getAudioBitrate(), CallRateController::AUDIO_MIN_KBPS);
+}
+
+void TestCallRateController::testAudioFloorHolds()
+{
+    controller.onRecommendedVideoBitrate(testLimits.minKbps);
+    nextInterval(controller, nowMs);
+    for (int i = 0; i < 20; ++i) {
+        controller.onAudioSent(1, true);
+        nextInterval(controller, nowMs);
+    }
+    QCOMPARE(controller.getAudioBitrate(), CallRateController::AUDIO_MIN_KBPS);
+
+    // raising the floor raises the bitrate right away, lowering it doesn't
+    QVERIFY(controller.setAudioFloor(24));
+    QCOMPARE(controller.getAudioBitrate(), 24u);
+    controller.onRecommendedAudioBitrate(10);
+    controller.onAudioSent(1, true);
+    nextInterval(controller, nowMs);
+    QCOMPARE(controller.getAudioBitrate(), 24u);
+    QVERIFY(!controller.setAudioFloor(0));
+    QCOMPARE(controller.getAudioBitrate(), 24u);
+
+    // the floor never exceeds the configured bitrate
+    QVERIFY(controller.setAudioFloor(testAudioKbps * 2));
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps);
+}
+
+void TestCallRateController::testIncreaseAfterHold()
+{
+    for (int i = 1; i < CallRateController::INCREASE_HOLD_INTERVALS; ++i) {
+        QVERIFY(!nextInterval(controller, nowMs));
+    }
+    QVERIFY(nextInterval(controller, nowMs));
+    QVERIFY(controller.getVideoBitrate() > testLimits.startKbps);
+}
+
+void TestCallRateController::testIncreaseStopsAtEncoderUsage()
+{
+    for (int i = 0; i < 20; ++i) {
+        controller.onEncoderBitrate(1000);
+        nextInterval(controller, nowMs);
+    }
+    // the encoder only uses 1000, so we don't raise above the start value
+    QCOMPARE(controller.getVideoBitrate(), testLimits.startKbps);
+}
+
+void TestCallRateController::testNeverExceedsLimits()
+{
+    for (int i = 0; i < 500; ++i) {
+        nextInterval(controller, nowMs);
+    }
+    QCOMPARE(controller.getVideoBitrate(), testLimits.maxKbps);
+    QCOMPARE(controller.getAudioBitrate(), testAudioKbps);
+}
+
+QTEST_GUILESS_MAIN(TestCallRateController)
+#include "callratecontroller_test.moc"
@@ -0,0 +1,98 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/callstats.h"
+
+#include <QTest>
+
+class TestCallStats : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testFirstSnapshotHasNoRates();
+    void testRates();
+    void testIntervalsReset();
+    void testSendLoss();
+};
+
+void TestCallStats::testFirstSnapshotHasNoRates()
+{
+    CallStats stats;
+    stats.onVideoSent(640, 480, 5000000, false);
+    stats.onVideoReceived(320, 240);
+
+    const CallStats::Snapshot snapshot = stats.takeSnapshot(1000);
+    QCOMPARE(snapshot.sentFps, 0.0);
+    QCOMPARE(snapshot.receivedFps, 0.0);
+    QCOMPARE(snapshot.sentSize, QSize(640, 480));
+    QCOMPARE(snapshot.receivedSize, QSize(320, 240));
+    QCOMPARE(snapshot.processMs, 5.0);
+}
+
+void TestCallStats::testRates()
+{
+    CallStats stats;
+    stats.takeSnapshot(0);
+    for (int i = 0; i < 30; ++i) {
+        stats.onVideoSent(1280, 720, (i % 2 ? 4 : 6) * 1000000, false);
+    }
+    for (int i = 0; i < 15; ++i) {
+        stats.onVideoReceived(640, 360);
+    }
+    stats.onEncoderBitrate(1500);
+
+    const CallStats::Snapshot snapshot = stats.takeSnapshot(2000);
+    QCOMPARE(snapshot.sentFps, 15.0);
+    QCOMPARE(snapshot.receivedFps, 7.5);
+    QCOMPARE(snapshot.processMs, 5.0);
+    QCOMPARE(snapshot.encoderKbps, 1500u);
+}
+
+void TestCallStats::testIntervalsReset()
+{
+    CallStats stats;
+    stats.takeSnapshot(0);
+    stats.onVideoSent(640, 480, 1000000, false);
+    stats.takeSnapshot(1000);
+
+    // sizes and bitrate stay, counts start over
+    const CallStats::Snapshot snapshot = stats.takeSnapshot(2000);
+    QCOMPARE(snapshot.sentFps, 0.0);
+    QCOMPARE(snapshot.processMs, 0.0);
+    QCOMPARE(snapshot.sentSize, QSize(640, 480));
+}
+
+void TestCallStats::testSendLoss()
+{
+    CallStats stats;
+    for (int i = 0; i < 6; ++i) {
+        stats.onAudioSent(i == 0);
+    }
+    stats.onVideoSent(640, 480, 1000000, false);
+    stats.onVideoSent(640, 480, 1000000, false);
+    stats.onVideoSent(640, 480, 1000000, true);
+    stats.onVideoSent(640, 480, 1000000, false);
+
+    // 2 of 10 frames refused
+    QCOMPARE(stats.takeSnapshot(0).sendLoss, 0.2);
+    QCOMPARE(stats.takeSnapshot(1000).sendLoss, 0.0);
+}
+
+QTEST_GUILESS_MAIN(TestCallStats)
+#include "callstats_test.moc"
@@ -0,0 +1,184 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/callvideoladder.h"
+
+#include <QTest>
+
+namespace {
+const uint32_t plentyKbps = 10000;
+
+/**
+ * @brief Reports frames sent at a fixed pace and processing time.
+ */
+void sendFrames(CallVideoLadder& ladder, qint64& nowMs, int count, qint64 intervalMs,
+                qint64 processMs)
+{
+    for (int i = 0; i < count; ++i) {
+        nowMs += intervalMs;
+        ladder.onFrameSent(nowMs, processMs);
+    }
+}
+} // namespace
+
+class TestCallVideoLadder : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testScaledSize();
+    void testNoChangeWithoutSamples();
+    void testOverloadStepsDownAfterHold();
+    void testLowBitrateStepsDown();
+    void testStaysAtBottom();
+    void testStepsUpAfterHold();
+    void testNoStepUpWithoutBitrate();
+    void testNoStepUpIntoOverload();
+    void testFrameRateCap();
+    void testCpuCap();
+
+private:
+    CallVideoLadder ladder;
+    qint64 nowMs = 0;
+};
+
+void TestCallVideoLadder::init()
+{
+    ladder.reset();
+    ladder.setCpuCap(0, 0);
+    nowMs = 0;
+}
+
+void TestCallVideoLadder::testScaledSize()
+{
+    QCOMPARE(ladder.scaledSize(QSize(3840, 2160)), QSize(1920, 1080));
+    QCOMPARE(ladder.scaledSize(QSize(640, 480)), QSize(640, 480));
+    // aspect ratio is kept
+    QCOMPARE(ladder.scaledSize(QSize(2560, 1600)), QSize(1728, 1080));
+    QCOMPARE(ladder.scaledSize(QSize(2160, 3840)), QSize(1080, 1920));
+}
+
+void TestCallVideoLadder::testNoChangeWithoutSamples()
+{
+    sendFrames(ladder, nowMs, CallVideoLadder::MIN_SAMPLES - 1, 33, 100);
+    QVERIFY(!ladder.update(nowMs + CallVideoLadder::DOWN_HOLD_MS, plentyKbps));
+    QCOMPARE(ladder.getRungIndex(), 0);
+}
+
+void TestCallVideoLadder::testOverloadStepsDownAfterHold()
+{
+    sendFrames(ladder, nowMs, CallVideoLadder::MIN_SAMPLES, 33, 40);
+    QVERIFY(!ladder.update(nowMs, plentyKbps));
+
+    sendFrames(ladder, nowMs, 60, 33, 40);
+    QVERIFY(ladder.update(nowMs, plentyKbps));
+    QCOMPARE(ladder.getRungIndex(), 1);
+    QCOMPARE(ladder.scaledSize(QSize(1920, 1080)), QSize(1280, 720));
+
+    // measurements start over on the new rung
+    QVERIFY(!ladder.update(nowMs + CallVideoLadder::DOWN_HOLD_MS, plentyKbps));
+}
+
+void TestCallVideoLadder::testLowBitrateStepsDown()
+{
+    sendFrames(ladder, nowMs, 70, 33, 5);
+    QVERIFY(ladder.update(nowMs, CallVideoLadder::rungAt(0).minKbps - 1));
+    QCOMPARE(ladder.getRungIndex(), 1);
+}
+
+void TestCallVideoLadder::testStaysAtBottom()
+{
+    for (int i = 0; i < 2 * CallVideoLadder::RUNG_COUNT; ++i) {
+        sendFrames(ladder, nowMs, 70, 33, 200);
+        ladder.update(nowMs, 0);
+    }
+    QCOMPARE(ladder.getRungIndex(), CallVideoLadder::RUNG_COUNT - 1);
+}
+
+void TestCallVideoLadder::testStepsUpAfterHold()
+{
+    sendFrames(ladder, nowMs, 70, 33, 40);
+    QVERIFY(ladder.update(nowMs, plentyKbps));
+
+    sendFrames(ladder, nowMs, 100, 33, 5);
+    QVERIFY(!ladder.update(nowMs, plentyKbps));
+
+    sendFrames(ladder, nowMs, 250, 33, 5);
+    QVERIFY(ladder.update(nowMs, plentyKbps));
+    QCOMPARE(ladder.getRungIndex(), 0);
+}
+
+void TestCallVideoLadder::testNoStepUpWithoutBitrate()
+{
+    sendFrames(ladder, nowMs, 70, 33, 40);
+    QVERIFY(ladder.update(nowMs, plentyKbps));
+
+    // enough for the current rung, but without headroom for the next one
+    sendFrames(ladder, nowMs, 350, 33, 5);
+    QVERIFY(!ladder.update(nowMs, CallVideoLadder::rungAt(0).minKbps));
+    QCOMPARE(ladder.getRungIndex(), 1);
+}
+
+void TestCallVideoLadder::testNoStepUpIntoOverload()
+{
+    sendFrames(ladder, nowMs, 70, 33, 40);
+    QVERIFY(ladder.update(nowMs, plentyKbps));
+
+    // fine at 720p, but 1080p costs ~2.25 times as much and would overload again
+    sendFrames(ladder, nowMs, 350, 33, 12);
+    QVERIFY(!ladder.update(nowMs, plentyKbps));
+    QCOMPARE(ladder.getRungIndex(), 1);
+}
+
+void TestCallVideoLadder::testFrameRateCap()
+{
+    QVERIFY(ladder.shouldSend(nowMs));
+    ladder.onFrameSent(nowMs, 0);
+    QVERIFY(ladder.shouldSend(nowMs + 33));
+
+    for (int i = 0; i < 2 * CallVideoLadder::RUNG_COUNT; ++i) {
+        sendFrames(ladder, nowMs, 70, 33, 200);
+        ladder.update(nowMs, 0);
+    }
+    QCOMPARE(ladder.getRung().fps, 15);
+
+    ladder.onFrameSent(nowMs, 0);
+    QVERIFY(!ladder.shouldSend(nowMs + 33));
+    QVERIFY(ladder.shouldSend(nowMs + 66));
+}
+
+void TestCallVideoLadder::testCpuCap()
+{
+    ladder.setCpuCap(2, 15);
+    QCOMPARE(ladder.scaledSize(QSize(1920, 1080)), QSize(960, 540));
+    ladder.onFrameSent(nowMs, 0);
+    QVERIFY(!ladder.shouldSend(nowMs + 33));
+    QVERIFY(ladder.shouldSend(nowMs + 66));
+
+    // the ladder itself didn't move and the cap survives a reset
+    QCOMPARE(ladder.getRungIndex(), 0);
+    ladder.reset();
+    QCOMPARE(ladder.scaledSize(QSize(1920, 1080)), QSize(960, 540));
+
+    ladder.setCpuCap(0, 0);
+    QCOMPARE(ladder.scaledSize(QSize(1920, 1080)), QSize(1920, 1080));
+}
+
+QTEST_GUILESS_MAIN(TestCallVideoLadder)
+#include "callvideoladder_test.moc"
@@ -49,6 +49,7 @@ private slots:
     void dataTest();
     void sizeTest();
     void hashableTest();
+    void orderTest();
 };
 
 void TestChatId::toStringTest()
@@ -108,5 +109,20 @@ void TestChatId::hashableTest()
     QVERIFY(qHash(pk1) != qHash(pk3));
 }
 
+void TestChatId::orderTest()
+{
+    ToxPk empty;
+    ToxPk pk1{testPk};
+    ToxPk pk2{echoPk};
+    // same ordering as the raw bytes
+    QCOMPARE(pk1 < pk2, testPk < echoPk);
+    QCOMPARE(pk2 < pk1, echoPk < testPk);
+    QVERIFY(!(pk1 < pk1));
+    QVERIFY(empty < pk1);
+    QVERIFY(empty.getData() == nullptr);
+    QVERIFY(empty.getByteArray().isEmpty());
+    QVERIFY(empty.toString().isEmpty());
+}
+
 QTEST_GUILESS_MAIN(TestChatId)
 #include "chatid_test.moc"
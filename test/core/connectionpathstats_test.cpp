@@ -0,0 +1,212 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/connectionpathstats.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTest>
+
+namespace {
+using Path = ConnectionPathStats::Path;
+
+const qint64 testNowMs = 1600000000000;
+
+qint64 total(const ConnectionPathStats::Snapshot& snapshot, Path path)
+{
+    return snapshot.totalMs[static_cast<int>(path)];
+}
+} // namespace
+
+class TestConnectionPathStats : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testUnknownFriend();
+    void testTimePerPath();
+    void testFlipsAndFallbacks();
+    void testDisconnects();
+    void testProxied();
+    void testRoundTripTime();
+    void testRoundTripIgnoresSlowReceipts();
+    void testPendingReceiptsBounded();
+    void testRemoveFriend();
+    void testReport();
+    void testJsonIsAnonymous();
+};
+
+void TestConnectionPathStats::testUnknownFriend()
+{
+    ConnectionPathStats stats;
+    const auto snapshot = stats.getSnapshot(1, testNowMs);
+    QCOMPARE(snapshot.path, Path::Offline);
+    QCOMPARE(snapshot.flips, 0u);
+    QCOMPARE(snapshot.rttMs, qint64{-1});
+}
+
+void TestConnectionPathStats::testTimePerPath()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    stats.setPath(1, "a", Path::TcpRelay, false, testNowMs + 5000);
+
+    const auto snapshot = stats.getSnapshot(1, testNowMs + 7000);
+    QCOMPARE(snapshot.path, Path::TcpRelay);
+    QCOMPARE(snapshot.currentMs, qint64{2000});
+    QCOMPARE(total(snapshot, Path::Udp), qint64{5000});
+    QCOMPARE(total(snapshot, Path::TcpRelay), qint64{2000});
+    QCOMPARE(total(snapshot, Path::Offline), qint64{0});
+}
+
+void TestConnectionPathStats::testFlipsAndFallbacks()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::TcpRelay, false, testNowMs);
+    stats.setPath(1, "a", Path::Udp, false, testNowMs + 1);
+    stats.setPath(1, "a", Path::TcpRelay, false, testNowMs + 2);
+    // reporting the same path again is no change
+    stats.setPath(1, "a", Path::TcpRelay, false, testNowMs + 3);
+
+    const auto snapshot = stats.getSnapshot(1, testNowMs + 4);
+    QCOMPARE(snapshot.flips, 2u);
+    QCOMPARE(snapshot.fallbacks, 1u);
+    QCOMPARE(snapshot.disconnects, 0u);
+}
+
+void TestConnectionPathStats::testDisconnects()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    stats.setPath(1, "a", Path::Offline, false, testNowMs + 1000);
+    stats.setPath(1, "a", Path::Udp, false, testNowMs + 3000);
+
+    const auto snapshot = stats.getSnapshot(1, testNowMs + 3000);
+    QCOMPARE(snapshot.disconnects, 1u);
+    // going offline and back isn't a flip between paths
+    QCOMPARE(snapshot.flips, 0u);
+    QCOMPARE(total(snapshot, Path::Offline), qint64{2000});
+}
+
+void TestConnectionPathStats::testProxied()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::TcpRelay, true, testNowMs);
+    QVERIFY(stats.getSnapshot(1, testNowMs).proxied);
+    QCOMPARE(ConnectionPathStats::pathName(Path::TcpRelay, true),
+             QStringLiteral("TCP relay via proxy"));
+}
+
+void TestConnectionPathStats::testRoundTripTime()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    stats.messageSent(1, 10, testNowMs);
+    stats.messageSent(1, 11, testNowMs);
+    stats.receiptReceived(1, 10, testNowMs + 80);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttMs, qint64{80});
+
+    stats.receiptReceived(1, 11, testNowMs + 160);
+    const auto snapshot = stats.getSnapshot(1, testNowMs);
+    QCOMPARE(snapshot.rttMs, qint64{(7 * 80 + 160) / 8});
+    QCOMPARE(snapshot.rttSamples, 2u);
+
+    // unknown receipts are ignored
+    stats.receiptReceived(1, 99, testNowMs + 5);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttSamples, 2u);
+}
+
+void TestConnectionPathStats::testRoundTripIgnoresSlowReceipts()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    stats.messageSent(1, 10, testNowMs);
+    stats.receiptReceived(1, 10, testNowMs + ConnectionPathStats::MAX_RTT_SAMPLE_MS + 1);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttMs, qint64{-1});
+
+    // receipts of messages sent before a disconnect are dropped
+    stats.messageSent(1, 11, testNowMs);
+    stats.setPath(1, "a", Path::Offline, false, testNowMs + 10);
+    stats.setPath(1, "a", Path::Udp, false, testNowMs + 20);
+    stats.receiptReceived(1, 11, testNowMs + 30);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttSamples, 0u);
+}
+
+void TestConnectionPathStats::testPendingReceiptsBounded()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    for (uint32_t i = 0; i <= ConnectionPathStats::MAX_PENDING_RECEIPTS; ++i) {
+        stats.messageSent(1, i, testNowMs);
+    }
+
+    // the oldest one was forgotten
+    stats.receiptReceived(1, 0, testNowMs + 10);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttSamples, 0u);
+    stats.receiptReceived(1, ConnectionPathStats::MAX_PENDING_RECEIPTS, testNowMs + 10);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).rttSamples, 1u);
+}
+
+void TestConnectionPathStats::testRemoveFriend()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "a", Path::Udp, false, testNowMs);
+    stats.removeFriend(1);
+    QCOMPARE(stats.getSnapshot(1, testNowMs).path, Path::Offline);
+}
+
+void TestConnectionPathStats::testReport()
+{
+    ConnectionPathStats stats;
+    QVERIFY(stats.toString(testNowMs).isEmpty());
+
+    stats.setPath(1, "direct", Path::Udp, false, testNowMs);
+    stats.setPath(2, "relayed", Path::TcpRelay, false, testNowMs);
+    stats.setPath(3, "never online", Path::Offline, false, testNowMs);
+
+    const QStringList lines = stats.toString(testNowMs + 61000).split(QLatin1Char('\n'));
+    QCOMPARE(lines.size(), 2);
+    // friends stuck on a relay are listed first
+    QVERIFY(lines.at(0).startsWith(QStringLiteral("relayed: TCP relay for 1m 1s")));
+    QVERIFY(lines.at(1).startsWith(QStringLiteral("direct: direct UDP for 1m 1s")));
+    QVERIFY(lines.at(1).endsWith(QStringLiteral("RTT unknown")));
+
+    QVERIFY(ConnectionPathStats::report().contains(QStringLiteral("relayed: TCP relay")));
+}
+
+void TestConnectionPathStats::testJsonIsAnonymous()
+{
+    ConnectionPathStats stats;
+    stats.setPath(1, "secret name", Path::TcpRelay, true, testNowMs);
+    stats.setPath(2, "other name", Path::Udp, false, testNowMs);
+
+    const QJsonObject json = stats.toJson(testNowMs + 1000);
+    QCOMPARE(json["tcpRelay"].toInt(), 1);
+    QCOMPARE(json["udp"].toInt(), 1);
+    const QJsonArray friends = json["friends"].toArray();
+    QCOMPARE(friends.size(), 2);
+    QCOMPARE(friends.at(0).toObject()["path"].toString(), QStringLiteral("TCP relay via proxy"));
+    QCOMPARE(friends.at(0).toObject()["currentMs"].toInt(), 1000);
+
+    const QByteArray document = QJsonDocument(json).toJson();
+    QVERIFY(!document.contains("secret name"));
+    QVERIFY(!document.contains("other name"));
+}
+
+QTEST_GUILESS_MAIN(TestConnectionPathStats)
+#include "connectionpathstats_test.moc"
@@ -81,12 +81,24 @@ void bootstrapToxes(Core& alice, MockBootstrapListGenerator& alicesNodes,
 
     QSignalSpy spyAlice(&alice, &Core::connected);
     QSignalSpy spyBob(&bob, &Core::connected);
+    QSignalSpy spyAliceDisconnected(&alice, &Core::disconnected);
+    QSignalSpy spyBobDisconnected(&bob, &Core::disconnected);
 
     alice.start();
     bob.start();
 
+    // The connection is reported by the self connection status callback, the watchdog only
+    // bootstraps after a couple of its ticks without connection
     QTRY_VERIFY_WITH_TIMEOUT(spyAlice.count() == 1 &&
         spyBob.count() == 1, bootstrap_timeout);
+
+    for (const auto* spy : {&spyAlice, &spyBob}) {
+        const auto status = spy->first().first().toUInt();
+        QVERIFY(status == static_cast<uint32_t>(TOX_CONNECTION_TCP)
+                || status == static_cast<uint32_t>(TOX_CONNECTION_UDP));
+    }
+    QCOMPARE(spyAliceDisconnected.count(), 0);
+    QCOMPARE(spyBobDisconnected.count(), 0);
 }
 } // namespace
 
@@ -0,0 +1,125 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/corestate.h"
+
+#include <QTest>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+ToxPk makePk(uint8_t fill)
+{
+    uint8_t raw[ToxPk::size];
+    std::fill(std::begin(raw), std::end(raw), fill);
+    return ToxPk{raw};
+}
+
+CoreState::Peer makePeer(uint32_t peerId, const QString& name)
+{
+    CoreState::Peer peer;
+    peer.peerId = peerId;
+    peer.publicKey = makePk(static_cast<uint8_t>(peerId));
+    peer.name = name;
+    return peer;
+}
+} // namespace
+
+class TestCoreState : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testFriends();
+    void testGroupPeers();
+    void testCopiesAreIndependent();
+};
+
+void TestCoreState::testFriends()
+{
+    CoreState state;
+    QVERIFY(!state.findFriend(0));
+
+    CoreState::Friend alice{makePk(1), QStringLiteral("Alice"), true};
+    state.setFriend(3, alice);
+    QCOMPARE(state.findFriend(3)->name, QStringLiteral("Alice"));
+    QVERIFY(state.findFriend(3)->online);
+    QCOMPARE(state.findFriend(makePk(1))->name, QStringLiteral("Alice"));
+
+    // a friend number can be reused for a different key
+    CoreState::Friend bob{makePk(2), QStringLiteral("Bob"), false};
+    state.setFriend(3, bob);
+    QVERIFY(!state.findFriend(makePk(1)));
+    QCOMPARE(state.findFriend(makePk(2))->name, QStringLiteral("Bob"));
+
+    state.removeFriend(3);
+    QVERIFY(!state.findFriend(3));
+    QVERIFY(!state.findFriend(makePk(2)));
+}
+
+void TestCoreState::testGroupPeers()
+{
+    CoreState::Group group;
+    group.setPeers({makePeer(7, "a"), makePeer(2, "b"), makePeer(9, "c")});
+    QCOMPARE(group.findPeer(2)->name, QStringLiteral("b"));
+    QVERIFY(!group.findPeer(3));
+
+    group.setPeer(makePeer(2, "renamed"));
+    group.setPeer(makePeer(4, "d"));
+    QCOMPARE(group.getPeers().size(), 4);
+    QCOMPARE(group.findPeer(2)->name, QStringLiteral("renamed"));
+    QCOMPARE(group.getPeers().last().peerId, 4u);
+
+    group.removePeer(7);
+    QCOMPARE(group.getPeers().size(), 3);
+    QVERIFY(!group.findPeer(7));
+    // positions after the removed peer moved
+    QCOMPARE(group.findPeer(9)->name, QStringLiteral("c"));
+    QCOMPARE(group.findPeer(4)->name, QStringLiteral("d"));
+}
+
+void TestCoreState::testCopiesAreIndependent()
+{
+    CoreState first;
+    CoreState::Group group;
+    group.setPeers({makePeer(0, "a")});
+    first.setGroup(1, group);
+    first.setFriend(0, CoreState::Friend{makePk(1), QStringLiteral("Alice"), false});
+
+    CoreState second{first};
+    CoreState::Group changed = *second.findGroup(1);
+    changed.setPeer(makePeer(1, "b"));
+    second.setGroup(1, changed);
+    second.removeFriend(0);
+    second.advanceVersion();
+
+    QCOMPARE(first.findGroup(1)->getPeers().size(), 1);
+    QCOMPARE(second.findGroup(1)->getPeers().size(), 2);
+    QVERIFY(first.findFriend(0));
+    QVERIFY(!second.findFriend(0));
+    QCOMPARE(second.getVersion(), first.getVersion() + 1);
+
+    second.removeGroup(1);
+    QVERIFY(!second.findGroup(1));
+    QVERIFY(first.findGroup(1));
+}
+
+QTEST_GUILESS_MAIN(TestCoreState)
+#include "corestate_test.moc"
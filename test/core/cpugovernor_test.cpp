@@ -0,0 +1,141 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/cpugovernor.h"
+
+#include <QTest>
+
+namespace {
+const qint64 sampleMs = 1000;
+
+/**
+ * @brief Reports samples one second apart with a constant load.
+ */
+void runAt(CpuGovernor& governor, qint64& nowMs, qint64& cpuNs, double cores, qint64 durationMs)
+{
+    for (qint64 elapsed = 0; elapsed < durationMs; elapsed += sampleMs) {
+        nowMs += sampleMs;
+        cpuNs += static_cast<qint64>(cores * sampleMs * 1000000);
+        governor.update(nowMs, cpuNs);
+    }
+}
+} // namespace
+
+class TestCpuGovernor : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testFirstSampleOnlyPrimes();
+    void testStaysWithinBudget();
+    void testStepsDownInOrder();
+    void testStepsBackUpAfterHold();
+    void testNoFlappingBetweenLimits();
+    void testDisabledWithoutBudget();
+
+private:
+    CpuGovernor governor;
+    qint64 nowMs = 0;
+    qint64 cpuNs = 0;
+};
+
+void TestCpuGovernor::init()
+{
+    governor.reset();
+    governor.setBudget(1.0);
+    nowMs = 0;
+    cpuNs = 0;
+}
+
+void TestCpuGovernor::testFirstSampleOnlyPrimes()
+{
+    QVERIFY(!governor.update(nowMs, cpuNs));
+    QCOMPARE(governor.getLoad(), 0.0);
+}
+
+void TestCpuGovernor::testStaysWithinBudget()
+{
+    governor.update(nowMs, cpuNs);
+    runAt(governor, nowMs, cpuNs, 0.8, 20000);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::None);
+    QVERIFY(!governor.isActive(CpuGovernor::Step::PreviewFps));
+}
+
+void TestCpuGovernor::testStepsDownInOrder()
+{
+    governor.update(nowMs, cpuNs);
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::PreviewFps);
+    QVERIFY(governor.isActive(CpuGovernor::Step::PreviewFps));
+    QVERIFY(!governor.isActive(CpuGovernor::Step::CaptureResolution));
+
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::CaptureResolution);
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::EncoderSpeed);
+    // audio is only touched after all video steps but the frame rate
+    QVERIFY(!governor.isActive(CpuGovernor::Step::NoiseSuppression));
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::NoiseSuppression);
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::VideoFps);
+
+    runAt(governor, nowMs, cpuNs, 2.0, 4 * CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::VideoFps);
+}
+
+void TestCpuGovernor::testStepsBackUpAfterHold()
+{
+    governor.update(nowMs, cpuNs);
+    runAt(governor, nowMs, cpuNs, 2.0, 2 * CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::CaptureResolution);
+
+    runAt(governor, nowMs, cpuNs, 0.2, CpuGovernor::UP_HOLD_MS - sampleMs);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::CaptureResolution);
+    runAt(governor, nowMs, cpuNs, 0.2, sampleMs);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::PreviewFps);
+    runAt(governor, nowMs, cpuNs, 0.2, CpuGovernor::UP_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::None);
+}
+
+void TestCpuGovernor::testNoFlappingBetweenLimits()
+{
+    governor.update(nowMs, cpuNs);
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::PreviewFps);
+
+    // below the budget, but not far enough to give the step back
+    runAt(governor, nowMs, cpuNs, 0.7, 3 * CpuGovernor::UP_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::PreviewFps);
+}
+
+void TestCpuGovernor::testDisabledWithoutBudget()
+{
+    governor.update(nowMs, cpuNs);
+    runAt(governor, nowMs, cpuNs, 2.0, CpuGovernor::DOWN_HOLD_MS);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::PreviewFps);
+
+    governor.setBudget(0.0);
+    runAt(governor, nowMs, cpuNs, 2.0, sampleMs);
+    QCOMPARE(governor.getLevel(), CpuGovernor::Step::None);
+}
+
+QTEST_GUILESS_MAIN(TestCpuGovernor)
+#include "cpugovernor_test.moc"
@@ -0,0 +1,148 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/custompacketregistry.h"
+
+#include <QTest>
+
+#include <functional>
+#include <vector>
+
+namespace {
+using Header = CustomPacketHeader<2, 0x66, 0x77, 0x88>;
+using Registry = CustomPacketRegistry<Header, int>;
+
+QByteArray makePacket(uint8_t kind, uint8_t subtype, const QByteArray& payload = {})
+{
+    QByteArray packet("\x66\x77\x88", 3);
+    packet.append(static_cast<char>(kind));
+    packet.append(static_cast<char>(subtype));
+    packet.append(payload);
+    return packet;
+}
+
+bool dispatch(const Registry& registry, int source, const QByteArray& packet)
+{
+    return registry.dispatch(source, reinterpret_cast<const uint8_t*>(packet.constData()),
+                             static_cast<size_t>(packet.size()));
+}
+} // namespace
+
+class TestCustomPacketRegistry : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testParse();
+    void testInline();
+    void testWorker();
+    void testUnknownType();
+};
+
+void TestCustomPacketRegistry::testParse()
+{
+    const QByteArray packet = makePacket(0x1, 0x13, "payload");
+    const auto* data = reinterpret_cast<const uint8_t*>(packet.constData());
+    QCOMPARE(Header::parse(data, packet.size()), Header::type(0x1, 0x13));
+    QCOMPARE(Header::parse(data, Header::SIZE), Header::type(0x1, 0x13));
+    QCOMPARE(Header::parse(data, Header::SIZE - 1), -1);
+
+    QByteArray wrongMagic = packet;
+    wrongMagic[2] = 0x12;
+    QCOMPARE(Header::parse(reinterpret_cast<const uint8_t*>(wrongMagic.constData()),
+                           wrongMagic.size()),
+             -1);
+
+    using IdHeader = CustomPacketHeader<1>;
+    const uint8_t idPacket[] = {181, 'a'};
+    QCOMPARE(IdHeader::parse(idPacket, sizeof(idPacket)), 181);
+    QCOMPARE(IdHeader::parse(idPacket, 0), -1);
+}
+
+void TestCustomPacketRegistry::testInline()
+{
+    int queued = 0;
+    Registry registry{[&queued](std::function<void()>) {
+        ++queued;
+        return true;
+    }};
+
+    int handledSource = 0;
+    QByteArray handledPacket;
+    registry.add(Header::type(0x1, 0x2), Registry::Context::Inline,
+                 [&](const int& source, const QByteArray& packet) {
+                     handledSource = source;
+                     handledPacket = QByteArray(packet.constData(), packet.size());
+                 });
+
+    const QByteArray packet = makePacket(0x1, 0x2, "payload");
+    QVERIFY(dispatch(registry, 7, packet));
+    QCOMPARE(handledSource, 7);
+    QCOMPARE(handledPacket, packet);
+    QCOMPARE(queued, 0);
+}
+
+void TestCustomPacketRegistry::testWorker()
+{
+    std::vector<std::function<void()>> jobs;
+    bool accept = true;
+    Registry registry{[&](std::function<void()> job) {
+        if (accept) {
+            jobs.push_back(std::move(job));
+        }
+        return accept;
+    }};
+
+    QByteArray handledPacket;
+    registry.add(Header::type(0x1, 0x14), Registry::Context::Worker,
+                 [&](const int&, const QByteArray& packet) { handledPacket = packet; });
+
+    QByteArray packet = makePacket(0x1, 0x14, "chunk");
+    const QByteArray expected = packet;
+    QVERIFY(dispatch(registry, 1, packet));
+    QVERIFY(handledPacket.isEmpty());
+    QCOMPARE(jobs.size(), size_t{1});
+
+    // the worker gets its own copy, the toxcore buffer is gone by the time it runs
+    packet.fill('\0');
+    jobs.front()();
+    QCOMPARE(handledPacket, expected);
+
+    accept = false;
+    QVERIFY(!dispatch(registry, 1, expected));
+}
+
+void TestCustomPacketRegistry::testUnknownType()
+{
+    Registry registry{[](std::function<void()> job) {
+        job();
+        return true;
+    }};
+
+    bool handled = false;
+    registry.add(Header::type(0x1, 0x1), Registry::Context::Inline,
+                 [&handled](const int&, const QByteArray&) { handled = true; });
+
+    QVERIFY(!dispatch(registry, 1, makePacket(0x1, 0x3)));
+    QVERIFY(!dispatch(registry, 1, makePacket(0x2, 0x1)));
+    QVERIFY(!dispatch(registry, 1, QByteArray("\x66\x78\x88\x01\x01", 5)));
+    QVERIFY(!handled);
+}
+
+QTEST_GUILESS_MAIN(TestCustomPacketRegistry)
+#include "custompacketregistry_test.moc"
@@ -0,0 +1,187 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/echodelayestimator.h"
+
+#include <QTest>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+const uint32_t sampleRate = EchoDelayEstimator::SAMPLE_RATE;
+const size_t blockSamples = sampleRate / 100;
+const size_t samplesPerMs = sampleRate / 1000;
+
+/**
+ * @brief Plays speech like noise bursts and captures them again after a configurable delay.
+ */
+class EchoPath
+{
+public:
+    explicit EchoPath(EchoDelayEstimator& estimator_)
+        : estimator{estimator_}
+    {}
+
+    /**
+     * @brief Runs the echo path for a number of 10ms blocks.
+     * @param blocks Number of blocks to run.
+     * @param delaySamples Delay of the echo in 16kHz samples.
+     * @param farActive False to play silence.
+     */
+    void run(size_t blocks, size_t delaySamples, bool farActive = true)
+    {
+        std::vector<int16_t> far(blockSamples);
+        std::vector<int16_t> near(blockSamples);
+        for (size_t block = 0; block < blocks; ++block) {
+            for (size_t i = 0; i < blockSamples; ++i) {
+                far[i] = farActive ? nextSample() : 0;
+                history.push_back(far[i]);
+                const size_t index = history.size() - 1;
+                const int16_t echo = index >= delaySamples ? history[index - delaySamples] : 0;
+                near[i] = static_cast<int16_t>(echo / 2 + noise() / 64);
+            }
+
+            estimator.addFarEnd(far.data(), far.size());
+            estimator.addNearEnd(near.data(), near.size());
+        }
+    }
+
+private:
+    int16_t noise()
+    {
+        seed = seed * 1103515245u + 12345u;
+        return static_cast<int16_t>(seed >> 16);
+    }
+
+    int16_t nextSample()
+    {
+        // syllables of about 200ms
+        const double t = (position++) / static_cast<double>(sampleRate);
+        const double envelope = 0.5 + 0.5 * std::sin(2.0 * 3.14159265358979 * 2.5 * t);
+        return static_cast<int16_t>(noise() / 4 * envelope);
+    }
+
+private:
+    EchoDelayEstimator& estimator;
+    std::vector<int16_t> history;
+    uint32_t seed = 1;
+    size_t position = 0;
+};
+} // namespace
+
+class TestEchoDelayEstimator : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testNoEstimateAtStart();
+    void testFindsDelay_data();
+    void testFindsDelay();
+    void testNoEstimateWithoutFarEnd();
+    void testFollowsDelayChange();
+    void testMeasuresDrift();
+    void testReset();
+
+private:
+    EchoDelayEstimator estimator;
+};
+
+void TestEchoDelayEstimator::init()
+{
+    estimator.reset();
+}
+
+void TestEchoDelayEstimator::testNoEstimateAtStart()
+{
+    QCOMPARE(estimator.getDelayMs(), -1);
+    QCOMPARE(estimator.getDriftPpm(), 0.0);
+}
+
+void TestEchoDelayEstimator::testFindsDelay_data()
+{
+    QTest::addColumn<int>("delayMs");
+    QTest::newRow("0ms") << 0;
+    QTest::newRow("40ms") << 40;
+    QTest::newRow("120ms") << 120;
+    QTest::newRow("350ms") << 350;
+    QTest::newRow("480ms") << 480;
+}
+
+void TestEchoDelayEstimator::testFindsDelay()
+{
+    QFETCH(int, delayMs);
+
+    EchoPath path{estimator};
+    path.run(300, delayMs * samplesPerMs);
+    QVERIFY(std::abs(estimator.getDelayMs() - delayMs) <= 2);
+}
+
+void TestEchoDelayEstimator::testNoEstimateWithoutFarEnd()
+{
+    EchoPath path{estimator};
+    path.run(300, 120 * samplesPerMs, false);
+    QCOMPARE(estimator.getDelayMs(), -1);
+}
+
+void TestEchoDelayEstimator::testFollowsDelayChange()
+{
+    EchoPath path{estimator};
+    path.run(300, 120 * samplesPerMs);
+    QVERIFY(std::abs(estimator.getDelayMs() - 120) <= 2);
+
+    // a single outlier isn't enough to move the delay
+    path.run(25, 250 * samplesPerMs);
+    QVERIFY(std::abs(estimator.getDelayMs() - 120) <= 2);
+
+    path.run(300, 250 * samplesPerMs);
+    QVERIFY(std::abs(estimator.getDelayMs() - 250) <= 2);
+}
+
+void TestEchoDelayEstimator::testMeasuresDrift()
+{
+    // the delay grows by one sample every 100ms, which is 625ppm
+    EchoPath path{estimator};
+    size_t delaySamples = 100 * samplesPerMs;
+    for (int i = 0; i < 300; ++i) {
+        path.run(10, delaySamples++);
+    }
+
+    QVERIFY(estimator.getDriftPpm() > 400.0);
+    QVERIFY(estimator.getDriftPpm() < 850.0);
+
+    // the delay keeps moving on while the far end is silent
+    const int delayMs = estimator.getDelayMs();
+    path.run(800, delaySamples, false);
+    QVERIFY(estimator.getDelayMs() >= delayMs + 4);
+}
+
+void TestEchoDelayEstimator::testReset()
+{
+    EchoPath path{estimator};
+    path.run(300, 120 * samplesPerMs);
+    QVERIFY(estimator.getDelayMs() >= 0);
+
+    estimator.reset();
+    QCOMPARE(estimator.getDelayMs(), -1);
+}
+
+QTEST_GUILESS_MAIN(TestEchoDelayEstimator)
+#include "echodelayestimator_test.moc"
@@ -0,0 +1,123 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/filechunkreader.h"
+
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTest>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+// toxcore's chunk size, doesn't divide the window size
+const qint64 chunkSize = 1371;
+const qint64 fileSize = FileChunkReader::READ_AHEAD_SIZE * 5 / 2 + 17;
+
+char expectedByte(qint64 pos)
+{
+    return static_cast<char>((pos * 7) % 251);
+}
+
+bool verifyChunk(const char* chunk, qint64 pos, qint64 length)
+{
+    for (qint64 i = 0; i < length; ++i) {
+        if (chunk[i] != expectedByte(pos + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+class TestFileChunkReader : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void testSequential();
+    void testRandomAccess();
+    void testPastEnd();
+
+private:
+    std::shared_ptr<QFile> openFile();
+
+    QTemporaryFile tempFile;
+};
+
+void TestFileChunkReader::initTestCase()
+{
+    QVERIFY(tempFile.open());
+    QByteArray content(static_cast<int>(fileSize), Qt::Uninitialized);
+    for (qint64 i = 0; i < fileSize; ++i) {
+        content[static_cast<int>(i)] = expectedByte(i);
+    }
+    QCOMPARE(tempFile.write(content), fileSize);
+    tempFile.close();
+}
+
+std::shared_ptr<QFile> TestFileChunkReader::openFile()
+{
+    auto file = std::make_shared<QFile>(tempFile.fileName());
+    file->open(QIODevice::ReadOnly);
+    return file;
+}
+
+void TestFileChunkReader::testSequential()
+{
+    FileChunkReader reader{openFile()};
+    qint64 pos = 0;
+    while (pos < fileSize) {
+        qint64 nread = 0;
+        const char* chunk = reader.read(pos, chunkSize, nread);
+        QVERIFY(chunk);
+        QCOMPARE(nread, std::min(chunkSize, fileSize - pos));
+        QVERIFY(verifyChunk(chunk, pos, nread));
+        pos += nread;
+    }
+    QCOMPARE(pos, fileSize);
+}
+
+void TestFileChunkReader::testRandomAccess()
+{
+    FileChunkReader reader{openFile()};
+    const qint64 positions[] = {FileChunkReader::READ_AHEAD_SIZE * 2 - 5, 0,
+                                FileChunkReader::READ_AHEAD_SIZE - 1, 100,
+                                fileSize - chunkSize};
+    for (qint64 pos : positions) {
+        qint64 nread = 0;
+        const char* chunk = reader.read(pos, chunkSize, nread);
+        QVERIFY(chunk);
+        QCOMPARE(nread, chunkSize);
+        QVERIFY(verifyChunk(chunk, pos, nread));
+    }
+}
+
+void TestFileChunkReader::testPastEnd()
+{
+    FileChunkReader reader{openFile()};
+    qint64 nread = 1;
+    QVERIFY(!reader.read(fileSize, chunkSize, nread));
+    QCOMPARE(nread, qint64{0});
+}
+
+QTEST_GUILESS_MAIN(TestFileChunkReader)
+#include "filechunkreader_test.moc"
@@ -0,0 +1,130 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/filechunkwriter.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTest>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+QByteArray makeContent(int size)
+{
+    QByteArray content(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        content[i] = static_cast<char>((i * 13) % 251);
+    }
+    return content;
+}
+} // namespace
+
+class TestFileChunkWriter : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testWritesInOrder();
+    void testPendingBytes();
+    void testEmptyFile();
+    void testResume();
+
+private:
+    std::unique_ptr<QTemporaryFile> tempFile;
+    std::shared_ptr<QFile> file;
+    std::shared_ptr<QCryptographicHash> hash;
+};
+
+void TestFileChunkWriter::init()
+{
+    tempFile.reset(new QTemporaryFile);
+    QVERIFY(tempFile->open());
+    file = std::make_shared<QFile>(tempFile->fileName());
+    QVERIFY(file->open(QIODevice::WriteOnly));
+    hash = std::make_shared<QCryptographicHash>(QCryptographicHash::Sha256);
+}
+
+void TestFileChunkWriter::testWritesInOrder()
+{
+    // a few batches and a partial one, in toxcore sized chunks
+    const QByteArray content = makeContent(static_cast<int>(FileChunkWriter::BATCH_SIZE * 3 + 999));
+    {
+        FileChunkWriter writer{file, hash};
+        for (int pos = 0; pos < content.size(); pos += 1371) {
+            writer.write(content.constData() + pos, std::min(1371, content.size() - pos));
+        }
+        QVERIFY(writer.finish(FileChunkWriter::SyncPolicy::Sync));
+        QCOMPARE(writer.getPendingBytes(), qint64{0});
+    }
+    file->close();
+
+    QVERIFY(file->open(QIODevice::ReadOnly));
+    QCOMPARE(file->readAll(), content);
+    QCOMPARE(hash->result(), QCryptographicHash::hash(content, QCryptographicHash::Sha256));
+}
+
+void TestFileChunkWriter::testPendingBytes()
+{
+    FileChunkWriter writer{file, hash};
+    const QByteArray chunk = makeContent(1000);
+    writer.write(chunk.constData(), chunk.size());
+    // less than a batch is kept until finish()
+    QCOMPARE(writer.getPendingBytes(), qint64{1000});
+    QVERIFY(writer.finish(FileChunkWriter::SyncPolicy::Flush));
+    QCOMPARE(writer.getPendingBytes(), qint64{0});
+    QCOMPARE(file->size(), qint64{1000});
+}
+
+void TestFileChunkWriter::testEmptyFile()
+{
+    FileChunkWriter writer{file, hash};
+    QVERIFY(writer.finish(FileChunkWriter::SyncPolicy::None));
+    QCOMPARE(file->size(), qint64{0});
+}
+
+void TestFileChunkWriter::testResume()
+{
+    const QByteArray content = makeContent(static_cast<int>(FileChunkWriter::BATCH_SIZE * 2 + 321));
+    const int kept = static_cast<int>(FileChunkWriter::BATCH_SIZE + 77);
+
+    // an earlier transfer broke, some bytes after the resume offset never made it
+    file->write(content.constData(), kept);
+    file->write("stale bytes");
+    file->close();
+    QVERIFY(file->open(QIODevice::ReadWrite));
+
+    {
+        FileChunkWriter writer{file, hash};
+        writer.resumeFrom(kept);
+        writer.write(content.constData() + kept, content.size() - kept);
+        QVERIFY(writer.finish(FileChunkWriter::SyncPolicy::Flush));
+    }
+    file->close();
+
+    QVERIFY(file->open(QIODevice::ReadOnly));
+    QCOMPARE(file->readAll(), content);
+    QCOMPARE(hash->result(), QCryptographicHash::hash(content, QCryptographicHash::Sha256));
+}
+
+QTEST_GUILESS_MAIN(TestFileChunkWriter)
+#include "filechunkwriter_test.moc"
@@ -40,6 +40,7 @@ private slots:
     void testFinishedSpeed();
     void testSamplePeriod();
     void testInvalidSamplePeriod();
+    void testReportPeriod();
 };
 
 /**
@@ -337,5 +338,33 @@ void TestFileProgress::testInvalidSamplePeriod()
     QCOMPARE(progress.getSpeed(), 60.0);
 }
 
+/**
+ * @brief Test that progress is reported for the first sample, then at most once per period
+ * and always when the file completes
+ */
+void TestFileProgress::testReportPeriod()
+{
+    auto progress = ToxFileProgress(100, 1000);
+    const auto start = QTime(1, 0, 0);
+
+    QVERIFY(progress.addSample(10, start));
+    QVERIFY(progress.shouldReport(start));
+
+    QVERIFY(progress.addSample(20, start.addMSecs(10)));
+    QVERIFY(!progress.shouldReport(start.addMSecs(10)));
+    QVERIFY(progress.addSample(30, start.addMSecs(ToxFileProgress::REPORT_PERIOD_MS - 1)));
+    QVERIFY(!progress.shouldReport(start.addMSecs(ToxFileProgress::REPORT_PERIOD_MS - 1)));
+
+    QVERIFY(progress.addSample(40, start.addMSecs(ToxFileProgress::REPORT_PERIOD_MS)));
+    QVERIFY(progress.shouldReport(start.addMSecs(ToxFileProgress::REPORT_PERIOD_MS)));
+
+    // reported right away when the clock goes back
+    QVERIFY(progress.shouldReport(start));
+
+    // the last chunk is always shown, or the transfer would look stuck below 100%
+    QVERIFY(progress.addSample(100, start.addMSecs(1)));
+    QVERIFY(progress.shouldReport(start.addMSecs(1)));
+}
+
 QTEST_GUILESS_MAIN(TestFileProgress)
 #include "fileprogress_test.moc"
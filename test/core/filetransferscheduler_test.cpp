@@ -0,0 +1,160 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/filetransferscheduler.h"
+
+#include <QTest>
+
+#include <algorithm>
+
+#include <tox/tox.h>
+
+namespace {
+using Priority = FileTransferScheduler::Priority;
+const size_t chunkLength = 1000;
+
+FileTransferScheduler::ChunkRequest makeRequest(uint64_t key, uint32_t friendId, uint64_t pos,
+                                                Priority priority = Priority::Bulk)
+{
+    return {key, friendId, pos, chunkLength, priority};
+}
+
+/**
+ * @brief Sends everything the scheduler allows.
+ * @return The keys of the sent requests in order.
+ */
+QVector<uint64_t> drain(FileTransferScheduler& scheduler, int max = 1000)
+{
+    QVector<uint64_t> keys;
+    FileTransferScheduler::ChunkRequest request;
+    while (keys.size() < max && scheduler.next(request)) {
+        keys.append(request.key);
+        scheduler.commit(request);
+    }
+    return keys;
+}
+} // namespace
+
+class TestFileTransferScheduler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testPriorityFor();
+    void testPriorityOrder();
+    void testFileOrderKept();
+    void testFairAcrossFriends();
+    void testUpstreamLimit();
+    void testRemove();
+};
+
+void TestFileTransferScheduler::testPriorityFor()
+{
+    QCOMPARE(FileTransferScheduler::priorityFor(TOX_FILE_KIND_AVATAR, 100000), Priority::Avatar);
+    QCOMPARE(FileTransferScheduler::priorityFor(TOX_FILE_KIND_DATA, 100000), Priority::Small);
+    QCOMPARE(FileTransferScheduler::priorityFor(TOX_FILE_KIND_DATA,
+                                                FileTransferScheduler::SMALL_FILE_SIZE + 1),
+             Priority::Bulk);
+}
+
+void TestFileTransferScheduler::testPriorityOrder()
+{
+    FileTransferScheduler scheduler;
+    scheduler.enqueue(makeRequest(3, 1, 0, Priority::Bulk));
+    scheduler.enqueue(makeRequest(2, 1, 0, Priority::Small));
+    scheduler.enqueue(makeRequest(1, 2, 0, Priority::Avatar));
+
+    QCOMPARE(drain(scheduler), (QVector<uint64_t>{2, 3, 1}));
+    QVERIFY(scheduler.isEmpty());
+}
+
+void TestFileTransferScheduler::testFileOrderKept()
+{
+    FileTransferScheduler scheduler;
+    for (uint64_t pos = 0; pos < 10; ++pos) {
+        scheduler.enqueue(makeRequest(1, 1, pos * chunkLength));
+    }
+
+    FileTransferScheduler::ChunkRequest request;
+    for (uint64_t pos = 0; pos < 10; ++pos) {
+        QVERIFY(scheduler.next(request));
+        QCOMPARE(request.pos, pos * chunkLength);
+        scheduler.commit(request);
+    }
+    QVERIFY(!scheduler.next(request));
+}
+
+void TestFileTransferScheduler::testFairAcrossFriends()
+{
+    FileTransferScheduler scheduler;
+    // friend 1 has two big transfers queued before friend 2's single one
+    for (uint64_t pos = 0; pos < 20; ++pos) {
+        scheduler.enqueue(makeRequest(10, 1, pos));
+        scheduler.enqueue(makeRequest(11, 1, pos));
+    }
+    for (uint64_t pos = 0; pos < 20; ++pos) {
+        scheduler.enqueue(makeRequest(20, 2, pos));
+    }
+
+    const QVector<uint64_t> keys = drain(scheduler, 20);
+    const int friend2 = static_cast<int>(std::count(keys.begin(), keys.end(), 20u));
+    // each friend gets about half, no matter how many files it sends
+    QVERIFY(friend2 >= 8 && friend2 <= 12);
+}
+
+void TestFileTransferScheduler::testUpstreamLimit()
+{
+    FileTransferScheduler scheduler;
+    const qint64 limit = 100 * 1000;
+    scheduler.setUpstreamLimit(limit);
+    for (uint64_t pos = 0; pos < 100; ++pos) {
+        scheduler.enqueue(makeRequest(1, 1, pos));
+    }
+
+    qint64 nowMs = 0;
+    scheduler.refill(nowMs);
+    // the first burst is MAX_BURST_MS worth of data
+    const int burst = drain(scheduler).size();
+    QCOMPARE(burst, static_cast<int>(limit * FileTransferScheduler::MAX_BURST_MS / 1000 / chunkLength));
+
+    nowMs += 50;
+    scheduler.refill(nowMs);
+    QCOMPARE(drain(scheduler).size(), static_cast<int>(limit * 50 / 1000 / chunkLength));
+
+    // no limit sends everything
+    scheduler.setUpstreamLimit(0);
+    scheduler.refill(nowMs);
+    drain(scheduler);
+    QVERIFY(scheduler.isEmpty());
+}
+
+void TestFileTransferScheduler::testRemove()
+{
+    FileTransferScheduler scheduler;
+    scheduler.enqueue(makeRequest(1, 1, 0));
+    scheduler.enqueue(makeRequest(2, 1, 0));
+    scheduler.enqueue(makeRequest(2, 2, 0, Priority::Small));
+    scheduler.remove(2);
+
+    QCOMPARE(drain(scheduler), (QVector<uint64_t>{1}));
+    QVERIFY(scheduler.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestFileTransferScheduler)
+#include "filetransferscheduler_test.moc"
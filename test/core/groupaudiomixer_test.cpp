@@ -0,0 +1,166 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/groupaudiomixer.h"
+
+#include <QTest>
+
+#include <memory>
+#include <vector>
+
+namespace {
+const size_t frameSamples = GroupAudioMixer::BLOCK_SAMPLES;
+
+std::vector<int16_t> constantFrame(int16_t value, unsigned channels)
+{
+    return std::vector<int16_t>(frameSamples * channels, value);
+}
+} // namespace
+
+class TestGroupAudioMixer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testSinglePeerPassesThrough();
+    void testWaitsForActivePeers();
+    void testSaturates();
+    void testPeerAheadFlushes();
+    void testInactivePeerNotWaitedFor();
+    void testPanning();
+    void testRemovePeer();
+
+private:
+    void addTwoPeers(const std::vector<int16_t>& frame);
+
+    std::vector<std::vector<int16_t>> blocks;
+    std::unique_ptr<GroupAudioMixer> mixer;
+};
+
+void TestGroupAudioMixer::init()
+{
+    blocks.clear();
+    mixer.reset(new GroupAudioMixer{[this](const int16_t* pcm, size_t samples) {
+        blocks.emplace_back(pcm, pcm + samples * GroupAudioMixer::CHANNELS);
+    }});
+}
+
+/**
+ * @brief Makes peers 1 and 2 known to the mixer, ends with an empty block.
+ */
+void TestGroupAudioMixer::addTwoPeers(const std::vector<int16_t>& frame)
+{
+    // a single peer is flushed right away, then the mixer waits for both
+    mixer->push(1, frame.data(), frameSamples, 1);
+    mixer->push(2, frame.data(), frameSamples, 1);
+    mixer->push(1, frame.data(), frameSamples, 1);
+}
+
+void TestGroupAudioMixer::testSinglePeerPassesThrough()
+{
+    const auto frame = constantFrame(1000, 1);
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), size_t{1});
+    QCOMPARE(blocks[0].size(), frameSamples * 2);
+    QCOMPARE(blocks[0].front(), int16_t{1000});
+    QCOMPARE(blocks[0].back(), int16_t{1000});
+}
+
+void TestGroupAudioMixer::testWaitsForActivePeers()
+{
+    addTwoPeers(constantFrame(0, 1));
+    QCOMPARE(blocks.size(), size_t{2});
+
+    const auto first = constantFrame(1000, 2);
+    const auto second = constantFrame(-300, 1);
+    mixer->push(1, first.data(), frameSamples, 2);
+    QCOMPARE(blocks.size(), size_t{2});
+    mixer->push(2, second.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), size_t{3});
+    QCOMPARE(blocks[2][0], int16_t{700});
+    QCOMPARE(blocks[2][1], int16_t{700});
+}
+
+void TestGroupAudioMixer::testSaturates()
+{
+    addTwoPeers(constantFrame(30000, 1));
+    QCOMPARE(blocks.back()[0], int16_t{32767});
+
+    const auto quiet = constantFrame(-30000, 1);
+    mixer->push(1, quiet.data(), frameSamples, 1);
+    mixer->push(2, quiet.data(), frameSamples, 1);
+    QCOMPARE(blocks.back()[0], int16_t{-32768});
+}
+
+void TestGroupAudioMixer::testPeerAheadFlushes()
+{
+    const auto frame = constantFrame(100, 1);
+    addTwoPeers(frame);
+    const size_t before = blocks.size();
+
+    // peer 2 is late, peer 1 starting its next frame pushes the block out
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), before);
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), before + 1);
+    QCOMPARE(blocks.back()[0], int16_t{100});
+}
+
+void TestGroupAudioMixer::testInactivePeerNotWaitedFor()
+{
+    const auto frame = constantFrame(100, 1);
+    addTwoPeers(frame);
+    QCOMPARE(mixer->activePeers(), 2);
+
+    for (int i = 0; i <= GroupAudioMixer::INACTIVE_BLOCKS; ++i) {
+        mixer->push(1, frame.data(), frameSamples, 1);
+    }
+    QCOMPARE(mixer->activePeers(), 1);
+
+    const size_t before = blocks.size();
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), before + 1);
+}
+
+void TestGroupAudioMixer::testPanning()
+{
+    mixer->setPeerGain(1, 0.5f, -1.0f);
+    // setting a gain alone doesn't make the mixer wait for that peer
+    QCOMPARE(mixer->activePeers(), 0);
+
+    const auto frame = constantFrame(1000, 1);
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), size_t{1});
+    QCOMPARE(blocks[0][0], int16_t{500});
+    QCOMPARE(blocks[0][1], int16_t{0});
+}
+
+void TestGroupAudioMixer::testRemovePeer()
+{
+    const auto frame = constantFrame(100, 1);
+    addTwoPeers(frame);
+    mixer->removePeer(2);
+
+    const size_t before = blocks.size();
+    mixer->push(1, frame.data(), frameSamples, 1);
+    QCOMPARE(blocks.size(), before + 1);
+}
+
+QTEST_GUILESS_MAIN(TestGroupAudioMixer)
+#include "groupaudiomixer_test.moc"
@@ -0,0 +1,210 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/lanpeercache.h"
+
+#include <QTest>
+
+namespace {
+const qint64 testNowSecs = 1600000000;
+
+const QList<LanPeerCache::LocalAddress> office{{QHostAddress{"192.168.10.5"}, 24}};
+const QList<LanPeerCache::LocalAddress> home{{QHostAddress{"10.0.0.7"}, 8}};
+
+ToxPk makeKey(char keyByte)
+{
+    return ToxPk{QByteArray(ToxPk::size, keyByte)};
+}
+
+LanPeerCache::Announcement makeAnnouncement(char dhtByte, const QString& address)
+{
+    return {makeKey(dhtByte), 33445, {QHostAddress{address}}};
+}
+} // namespace
+
+class TestLanPeerCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testNetworkKey();
+    void testRecordLocalPeer();
+    void testIgnoreOtherSubnets();
+    void testPeersPerNetwork();
+    void testMostRecentFirst();
+    void testAnnouncementRoundTrip();
+    void testParseInvalid();
+    void testSaveLoad();
+    void testSaveDropsOldPeers();
+    void testLoadInvalid();
+};
+
+void TestLanPeerCache::testNetworkKey()
+{
+    LanPeerCache cache;
+    QVERIFY(cache.getNetworkKey().isEmpty());
+
+    cache.setNetwork(office);
+    QCOMPARE(cache.getNetworkKey(), QStringLiteral("192.168.10.0/24"));
+
+    // another address in the same subnet is the same network
+    cache.setNetwork({{QHostAddress{"192.168.10.99"}, 24}});
+    QCOMPARE(cache.getNetworkKey(), QStringLiteral("192.168.10.0/24"));
+
+    cache.setNetwork({home.first(), office.first()});
+    QCOMPARE(cache.getNetworkKey(), QStringLiteral("10.0.0.0/8,192.168.10.0/24"));
+}
+
+void TestLanPeerCache::testRecordLocalPeer()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    QVERIFY(cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.20"),
+                                     testNowSecs));
+
+    const auto peers = cache.getPeers();
+    QCOMPARE(peers.size(), 1);
+    QCOMPARE(peers.at(0).friendPk, makeKey(1));
+    QCOMPARE(peers.at(0).dhtId, makeKey(2));
+    QCOMPARE(peers.at(0).address, QHostAddress{"192.168.10.20"});
+    QCOMPARE(peers.at(0).port, quint16{33445});
+}
+
+void TestLanPeerCache::testIgnoreOtherSubnets()
+{
+    LanPeerCache cache;
+    QVERIFY(!cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.20"),
+                                      testNowSecs));
+
+    cache.setNetwork(office);
+    QVERIFY(!cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.11.20"),
+                                      testNowSecs));
+    // our own address announced back to us is no peer
+    QVERIFY(!cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.5"),
+                                      testNowSecs));
+    QVERIFY(cache.getPeers().isEmpty());
+}
+
+void TestLanPeerCache::testPeersPerNetwork()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    QVERIFY(cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.20"),
+                                     testNowSecs));
+
+    cache.setNetwork(home);
+    QVERIFY(cache.getPeers().isEmpty());
+    QVERIFY(cache.recordAnnouncement(makeKey(3), makeAnnouncement(4, "10.1.2.3"), testNowSecs));
+    QCOMPARE(cache.getPeers().at(0).friendPk, makeKey(3));
+
+    cache.setNetwork(office);
+    QCOMPARE(cache.getPeers().size(), 1);
+    QCOMPARE(cache.getPeers().at(0).friendPk, makeKey(1));
+}
+
+void TestLanPeerCache::testMostRecentFirst()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    for (char i = 1; i <= LanPeerCache::MAX_BOOTSTRAP_PEERS + 2; ++i) {
+        QVERIFY(cache.recordAnnouncement(makeKey(i), makeAnnouncement(i, "192.168.10.20"),
+                                         testNowSecs + i));
+    }
+
+    // a friend seen again moves to the front with its new DHT key
+    QVERIFY(cache.recordAnnouncement(makeKey(1), makeAnnouncement(99, "192.168.10.21"),
+                                     testNowSecs + 100));
+
+    const auto peers = cache.getPeers();
+    QCOMPARE(peers.size(), LanPeerCache::MAX_BOOTSTRAP_PEERS);
+    QCOMPARE(peers.at(0).friendPk, makeKey(1));
+    QCOMPARE(peers.at(0).dhtId, makeKey(99));
+    QCOMPARE(peers.at(1).friendPk, makeKey(LanPeerCache::MAX_BOOTSTRAP_PEERS + 2));
+}
+
+void TestLanPeerCache::testAnnouncementRoundTrip()
+{
+    LanPeerCache::Announcement announcement{makeKey(7), 33446, {}};
+    for (int i = 0; i < LanPeerCache::MAX_ADDRESSES + 2; ++i) {
+        announcement.addresses.append(QHostAddress{QStringLiteral("10.0.0.%1").arg(i + 1)});
+    }
+
+    LanPeerCache::Announcement parsed;
+    QVERIFY(LanPeerCache::parseAnnouncement(LanPeerCache::makeAnnouncement(announcement), parsed));
+    QCOMPARE(parsed.dhtId, makeKey(7));
+    QCOMPARE(parsed.port, quint16{33446});
+    QCOMPARE(parsed.addresses, announcement.addresses.mid(0, LanPeerCache::MAX_ADDRESSES));
+}
+
+void TestLanPeerCache::testParseInvalid()
+{
+    LanPeerCache::Announcement parsed;
+    QVERIFY(!LanPeerCache::parseAnnouncement({}, parsed));
+
+    QByteArray data = LanPeerCache::makeAnnouncement(makeAnnouncement(1, "10.0.0.1"));
+    QVERIFY(!LanPeerCache::parseAnnouncement(data.left(data.size() - 1), parsed));
+
+    data[0] = 2;
+    QVERIFY(!LanPeerCache::parseAnnouncement(data, parsed));
+}
+
+void TestLanPeerCache::testSaveLoad()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    QVERIFY(cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.20"),
+                                     testNowSecs));
+    cache.setNetwork(home);
+    QVERIFY(cache.recordAnnouncement(makeKey(3), makeAnnouncement(4, "10.1.2.3"), testNowSecs));
+
+    LanPeerCache loaded;
+    QVERIFY(loaded.load(cache.save(testNowSecs)));
+    loaded.setNetwork(office);
+    QCOMPARE(loaded.getPeers().size(), 1);
+    QCOMPARE(loaded.getPeers().at(0).dhtId, makeKey(2));
+    QCOMPARE(loaded.getPeers().at(0).address, QHostAddress{"192.168.10.20"});
+    loaded.setNetwork(home);
+    QCOMPARE(loaded.getPeers().at(0).friendPk, makeKey(3));
+}
+
+void TestLanPeerCache::testSaveDropsOldPeers()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    QVERIFY(cache.recordAnnouncement(makeKey(1), makeAnnouncement(2, "192.168.10.20"),
+                                     testNowSecs));
+
+    LanPeerCache loaded;
+    loaded.setNetwork(office);
+    QVERIFY(loaded.load(cache.save(testNowSecs + LanPeerCache::MAX_AGE_SECS + 1)));
+    QVERIFY(loaded.getPeers().isEmpty());
+}
+
+void TestLanPeerCache::testLoadInvalid()
+{
+    LanPeerCache cache;
+    cache.setNetwork(office);
+    QVERIFY(cache.load({}));
+    QVERIFY(!cache.load("not json"));
+    QVERIFY(cache.load(
+        R"({"networks":[{"key":"192.168.10.0/24","peers":[{"friend":"short","port":1}]}]})"));
+    QVERIFY(cache.getPeers().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestLanPeerCache)
+#include "lanpeercache_test.moc"
@@ -0,0 +1,113 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/latencyhistogram.h"
+
+#include <QJsonArray>
+#include <QTest>
+
+class TestLatencyHistogram : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testEmpty();
+    void testPercentiles();
+    void testOverflowBucket();
+    void testOldWindowsAgeOut();
+    void testToJson();
+
+private:
+    LatencyHistogram histogram;
+};
+
+void TestLatencyHistogram::init()
+{
+    histogram.reset();
+}
+
+void TestLatencyHistogram::testEmpty()
+{
+    QCOMPARE(histogram.getCount(), 0u);
+    QCOMPARE(histogram.percentile(0.5), -1.0);
+    QCOMPARE(histogram.toString(), QStringLiteral("-"));
+}
+
+void TestLatencyHistogram::testPercentiles()
+{
+    for (int i = 0; i < 90; ++i) {
+        histogram.add(15);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.add(70);
+    }
+
+    QCOMPARE(histogram.getCount(), 100u);
+    QCOMPARE(histogram.percentile(0.5), 20.0);
+    QCOMPARE(histogram.percentile(0.9), 20.0);
+    QCOMPARE(histogram.percentile(0.95), 80.0);
+    QCOMPARE(histogram.getMax(), 70.0);
+}
+
+void TestLatencyHistogram::testOverflowBucket()
+{
+    histogram.add(1000);
+    QCOMPARE(histogram.percentile(0.5), 1000.0);
+}
+
+void TestLatencyHistogram::testOldWindowsAgeOut()
+{
+    histogram.add(500);
+    // fill the current window, then a complete second one
+    for (uint32_t i = 1; i < 2 * LatencyHistogram::WINDOW_SAMPLES; ++i) {
+        histogram.add(3);
+    }
+    QCOMPARE(histogram.getMax(), 500.0);
+
+    histogram.add(3);
+    QCOMPARE(histogram.getCount(), LatencyHistogram::WINDOW_SAMPLES + 1);
+    QCOMPARE(histogram.getMax(), 3.0);
+    QCOMPARE(histogram.percentile(1), 5.0);
+}
+
+void TestLatencyHistogram::testToJson()
+{
+    for (int i = 0; i < 90; ++i) {
+        histogram.add(15);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.add(70);
+    }
+
+    const QJsonObject json = histogram.toJson();
+    QCOMPARE(json["count"].toInt(), 100);
+    QCOMPARE(json["p50Ms"].toDouble(), 20.0);
+    QCOMPARE(json["p95Ms"].toDouble(), 80.0);
+    QCOMPARE(json["maxMs"].toDouble(), 70.0);
+
+    const QJsonArray buckets = json["buckets"].toArray();
+    QCOMPARE(buckets.size(), LatencyHistogram::BUCKET_COUNT);
+    // 15 ms counts into the bucket up to 20 ms, 70 ms into the one up to 80 ms
+    QCOMPARE(buckets.at(4).toInt(), 90);
+    QCOMPARE(buckets.at(6).toInt(), 10);
+}
+
+QTEST_GUILESS_MAIN(TestLatencyHistogram)
+#include "latencyhistogram_test.moc"
@@ -0,0 +1,122 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/loopstats.h"
+
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QTest>
+#include <QThread>
+
+class TestLoopStats : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testStagesReported();
+    void testStallCounted();
+    void testTimerLateness();
+    void testReportListsLoops();
+    void testDiagnostics();
+};
+
+void TestLoopStats::testStagesReported()
+{
+    LoopStats stats{QStringLiteral("Test"), 1000};
+    stats.beginIteration();
+    stats.beginStage("first stage");
+    stats.beginStage("second stage");
+    stats.endIteration();
+
+    const QString report = stats.toString();
+    QVERIFY(report.startsWith(QStringLiteral("Test loop, 0 stalls")));
+    QVERIFY(report.contains(QStringLiteral("first stage: p50")));
+    QVERIFY(report.contains(QStringLiteral("second stage: p50")));
+    QVERIFY(!report.contains(QStringLiteral("running")));
+}
+
+void TestLoopStats::testStallCounted()
+{
+    LoopStats stats{QStringLiteral("Test"), 10};
+    stats.beginIteration();
+    stats.beginStage("slow stage");
+    QThread::msleep(50);
+    stats.endIteration();
+
+    stats.beginIteration();
+    stats.beginStage("fast stage");
+    stats.endIteration();
+
+    QVERIFY(stats.toString().startsWith(QStringLiteral("Test loop, 1 stalls over 10 ms")));
+}
+
+void TestLoopStats::testTimerLateness()
+{
+    LoopStats stats{QStringLiteral("Test"), 1000};
+    stats.timerStarted(0);
+    QThread::msleep(30);
+    stats.beginIteration();
+    stats.endIteration();
+
+    // the sleep may take longer, but never less
+    const auto match = QRegularExpression(QStringLiteral("timer lateness: p50 <([\\d.]+) ms"))
+                           .match(stats.toString());
+    QVERIFY(match.hasMatch());
+    QVERIFY(match.captured(1).toDouble() >= 40);
+}
+
+void TestLoopStats::testReportListsLoops()
+{
+    LoopStats first{QStringLiteral("First"), 1000};
+    {
+        LoopStats second{QStringLiteral("Second"), 1000};
+        second.beginIteration();
+        second.beginStage("hanging stage");
+
+        const QString report = LoopStats::report();
+        QVERIFY(report.contains(QStringLiteral("First loop")));
+        QVERIFY(report.contains(QStringLiteral("Second loop")));
+        QVERIFY(report.contains(QStringLiteral("running hanging stage for")));
+    }
+
+    QVERIFY(!LoopStats::report().contains(QStringLiteral("Second loop")));
+}
+
+void TestLoopStats::testDiagnostics()
+{
+    LoopStats stats{QStringLiteral("Diagnosed"), 1000};
+    stats.beginIteration();
+    stats.beginStage("only stage");
+    stats.endIteration();
+
+    QJsonObject loop;
+    for (const QJsonValue& value : DiagnosticsRegistry::getInstance().collect()["loops"].toArray()) {
+        if (value.toObject()["name"].toString() == QStringLiteral("Diagnosed")) {
+            loop = value.toObject();
+        }
+    }
+
+    QCOMPARE(loop["iteration"].toObject()["count"].toInt(), 1);
+    QVERIFY(!loop.contains("runningStage"));
+    const QJsonArray stages = loop["stages"].toArray();
+    QCOMPARE(stages.size(), 1);
+    QCOMPARE(stages.at(0).toObject()["name"].toString(), QStringLiteral("only stage"));
+}
+
+QTEST_GUILESS_MAIN(TestLoopStats)
+#include "loopstats_test.moc"
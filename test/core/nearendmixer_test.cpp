@@ -0,0 +1,146 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/nearendmixer.h"
+
+#include <QTest>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+const size_t frameSamples = NearEndMixer::SAMPLE_RATE / 50;
+
+/**
+ * @brief Deterministic noise, a beamformer needs a broadband signal to work with.
+ */
+std::vector<int16_t> makeNoise(size_t samples)
+{
+    std::vector<int16_t> noise(samples);
+    uint32_t state = 12345;
+    for (int16_t& sample : noise) {
+        state = state * 1103515245 + 12345;
+        sample = static_cast<int16_t>(static_cast<int32_t>((state >> 16) & 0x7fff) - 0x4000) / 2;
+    }
+    return noise;
+}
+
+/**
+ * @brief Interleaves a source into stereo, the second channel delayed by delaySamples.
+ */
+std::vector<int16_t> toStereo(const std::vector<int16_t>& source, size_t delaySamples)
+{
+    std::vector<int16_t> stereo(source.size() * 2);
+    for (size_t i = 0; i < source.size(); ++i) {
+        stereo[2 * i] = source[i];
+        stereo[2 * i + 1] = i >= delaySamples ? source[i - delaySamples] : 0;
+    }
+    return stereo;
+}
+
+/**
+ * @brief Energy of the output relative to the first input channel, over the last half of the
+ * signal once the beamformer adapted.
+ */
+double processedGainDb(NearEndMixer& mixer, const std::vector<int16_t>& stereo)
+{
+    const size_t samples = stereo.size() / 2;
+    double inEnergy = 0;
+    double outEnergy = 0;
+    for (size_t offset = 0; offset + frameSamples <= samples; offset += frameSamples) {
+        const int16_t* out = mixer.process(stereo.data() + 2 * offset, frameSamples, 2);
+        if (offset < samples / 2) {
+            continue;
+        }
+        for (size_t i = 0; i < frameSamples; ++i) {
+            const double in = stereo[2 * (offset + i)];
+            inEnergy += in * in;
+            outEnergy += static_cast<double>(out[i]) * out[i];
+        }
+    }
+    return 10 * std::log10(outEnergy / inEnergy);
+}
+} // namespace
+
+class TestNearEndMixer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testMonoUnchanged();
+    void testDownmix();
+    void testDownmixOddFrames();
+    void testBeamformKeepsFront();
+    void testBeamformAttenuatesSide();
+};
+
+void TestNearEndMixer::testMonoUnchanged()
+{
+    NearEndMixer mixer;
+    const std::vector<int16_t> mono = makeNoise(frameSamples);
+    QCOMPARE(mixer.process(mono.data(), mono.size(), 1), mono.data());
+}
+
+void TestNearEndMixer::testDownmix()
+{
+    NearEndMixer mixer;
+    std::vector<int16_t> stereo(frameSamples * 2);
+    for (size_t i = 0; i < frameSamples; ++i) {
+        stereo[2 * i] = 1000;
+        stereo[2 * i + 1] = -200;
+    }
+
+    const int16_t* mono = mixer.process(stereo.data(), frameSamples, 2);
+    for (size_t i = 0; i < frameSamples; ++i) {
+        QCOMPARE(mono[i], static_cast<int16_t>(400));
+    }
+}
+
+void TestNearEndMixer::testDownmixOddFrames()
+{
+    // the beamformer needs whole 10ms chunks, others are averaged
+    NearEndMixer mixer;
+    mixer.setBeamforming(true);
+    const size_t samples = NearEndMixer::CHUNK_SAMPLES + 1;
+    const std::vector<int16_t> stereo(samples * 2, 300);
+    const int16_t* mono = mixer.process(stereo.data(), samples, 2);
+    QCOMPARE(mono[samples - 1], static_cast<int16_t>(300));
+}
+
+void TestNearEndMixer::testBeamformKeepsFront()
+{
+    NearEndMixer mixer;
+    mixer.setBeamforming(true);
+    const std::vector<int16_t> stereo = toStereo(makeNoise(frameSamples * 100), 0);
+    QVERIFY(std::abs(processedGainDb(mixer, stereo)) < 3);
+}
+
+void TestNearEndMixer::testBeamformAttenuatesSide()
+{
+    NearEndMixer mixer;
+    mixer.setBeamforming(true);
+    // sound along the axis of the array reaches the second microphone spacing / c later
+    const size_t delay = static_cast<size_t>(
+        std::lround(NearEndMixer::MIC_SPACING_M / 343.0 * NearEndMixer::SAMPLE_RATE));
+    const std::vector<int16_t> stereo = toStereo(makeNoise(frameSamples * 100), delay);
+    QVERIFY(processedGainDb(mixer, stereo) < -10);
+}
+
+QTEST_GUILESS_MAIN(TestNearEndMixer)
+#include "nearendmixer_test.moc"
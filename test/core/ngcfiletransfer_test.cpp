@@ -0,0 +1,196 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/ngcfiletransfer.h"
+
+#include <QTest>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace {
+const int testGroup = 1000;
+const uint32_t testPeer = 7;
+const ToxPk testAuthor{QByteArray(ToxPk::size, 'a')};
+
+QByteArray makeFile(int chunks)
+{
+    QByteArray file;
+    for (int i = 0; i < chunks * NgcFileTransfer::CHUNK_SIZE - NgcFileTransfer::CHUNK_SIZE / 2; ++i) {
+        file.append(static_cast<char>(i * 31));
+    }
+    return file;
+}
+
+int requestCount(const QByteArray& request)
+{
+    return static_cast<uint8_t>(request[NgcFileTransfer::HEADER_SIZE + NgcFileTransfer::FILE_ID_SIZE]);
+}
+} // namespace
+
+class TestNgcFileTransfer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testPacketType();
+    void testOutOfOrderTransfer();
+    void testWindow();
+    void testResumeAfterStall();
+    void testRejectsLargeFile();
+    void testHashMismatch();
+
+private:
+    QByteArray announceTo(NgcFileTransfer& receiver, const QByteArray& file);
+
+    NgcFileTransfer sender;
+    qint64 nowMs = 0;
+};
+
+void TestNgcFileTransfer::init()
+{
+    nowMs = 0;
+}
+
+QByteArray TestNgcFileTransfer::announceTo(NgcFileTransfer& receiver, const QByteArray& file)
+{
+    const QByteArray announce = sender.offerFile(file);
+    return receiver.handleAnnounce(testGroup, testPeer, testAuthor, announce, nowMs);
+}
+
+void TestNgcFileTransfer::testPacketType()
+{
+    const QByteArray header = NgcFileTransfer::packetHeader(NgcFileTransfer::PacketType::Chunk);
+    QCOMPARE(NgcFileTransfer::packetType(header),
+             static_cast<int>(NgcFileTransfer::PacketType::Chunk));
+    QCOMPARE(NgcFileTransfer::packetType(header.left(5)), -1);
+}
+
+void TestNgcFileTransfer::testOutOfOrderTransfer()
+{
+    NgcFileTransfer receiver;
+    const QByteArray file = makeFile(3);
+    const QByteArray request = announceTo(receiver, file);
+    QCOMPARE(requestCount(request), 3);
+
+    QVector<QByteArray> chunks = sender.handleRequest(request);
+    QCOMPARE(chunks.size(), 3);
+    std::reverse(chunks.begin(), chunks.end());
+
+    QByteArray received;
+    QByteArray nextRequest;
+    for (int i = 0; i < chunks.size(); ++i) {
+        const bool complete = receiver.handleChunk(testGroup, testPeer, testAuthor, chunks[i],
+                                                   nowMs, nextRequest, received);
+        QCOMPARE(complete, i == chunks.size() - 1);
+        QVERIFY(nextRequest.isEmpty());
+    }
+    QCOMPARE(received, file);
+    QCOMPARE(receiver.getIncomingCount(), 0);
+}
+
+void TestNgcFileTransfer::testWindow()
+{
+    NgcFileTransfer receiver;
+    const QByteArray request = announceTo(receiver, makeFile(10));
+    QCOMPARE(requestCount(request), NgcFileTransfer::WINDOW_CHUNKS);
+
+    const QVector<QByteArray> chunks = sender.handleRequest(request);
+    QByteArray file;
+    QByteArray nextRequest;
+    QVERIFY(!receiver.handleChunk(testGroup, testPeer, testAuthor, chunks[0], nowMs, nextRequest,
+                                  file));
+    QVERIFY(nextRequest.isEmpty());
+
+    // once half of the window arrived, the next chunks are requested
+    QVERIFY(!receiver.handleChunk(testGroup, testPeer, testAuthor, chunks[1], nowMs, nextRequest,
+                                  file));
+    QCOMPARE(requestCount(nextRequest), NgcFileTransfer::WINDOW_CHUNKS / 2);
+
+    // duplicates are ignored
+    nextRequest.clear();
+    QVERIFY(!receiver.handleChunk(testGroup, testPeer, testAuthor, chunks[1], nowMs, nextRequest,
+                                  file));
+    QVERIFY(nextRequest.isEmpty());
+}
+
+void TestNgcFileTransfer::testResumeAfterStall()
+{
+    NgcFileTransfer receiver;
+    const QByteArray file = makeFile(2);
+    const QByteArray request = announceTo(receiver, file);
+    QVERIFY(receiver.expire(nowMs + NgcFileTransfer::STALL_TIMEOUT_MS - 1).isEmpty());
+
+    // the chunks got lost, they are requested again
+    nowMs += NgcFileTransfer::STALL_TIMEOUT_MS;
+    const QVector<NgcFileTransfer::Request> requests = receiver.expire(nowMs);
+    QCOMPARE(requests.size(), 1);
+    QCOMPARE(requests[0].groupnumber, testGroup);
+    QCOMPARE(requests[0].peerId, testPeer);
+    QCOMPARE(requests[0].packet, request);
+
+    QByteArray received;
+    QByteArray nextRequest;
+    for (const QByteArray& chunk : sender.handleRequest(requests[0].packet)) {
+        receiver.handleChunk(testGroup, testPeer, testAuthor, chunk, nowMs, nextRequest, received);
+    }
+    QCOMPARE(received, file);
+
+    // transfers that never make progress are dropped
+    announceTo(receiver, file);
+    for (int i = 0; i <= NgcFileTransfer::MAX_RETRIES; ++i) {
+        nowMs += NgcFileTransfer::STALL_TIMEOUT_MS;
+        receiver.expire(nowMs);
+    }
+    QCOMPARE(receiver.getIncomingCount(), 0);
+}
+
+void TestNgcFileTransfer::testRejectsLargeFile()
+{
+    NgcFileTransfer receiver;
+    QByteArray announce = NgcFileTransfer::packetHeader(NgcFileTransfer::PacketType::FileAnnounce);
+    announce.append(QByteArray(NgcFileTransfer::FILE_ID_SIZE, 'f'));
+    uchar size[4];
+    qToBigEndian(NgcFileTransfer::MAX_FILE_SIZE + 1, size);
+    announce.append(reinterpret_cast<const char*>(size), sizeof(size));
+
+    QVERIFY(receiver.handleAnnounce(testGroup, testPeer, testAuthor, announce, nowMs).isEmpty());
+    QCOMPARE(receiver.getIncomingCount(), 0);
+    QVERIFY(sender.offerFile(QByteArray()).isEmpty());
+}
+
+void TestNgcFileTransfer::testHashMismatch()
+{
+    NgcFileTransfer receiver;
+    const QByteArray request = announceTo(receiver, makeFile(1));
+    QVector<QByteArray> chunks = sender.handleRequest(request);
+    QCOMPARE(chunks.size(), 1);
+    chunks[0][chunks[0].size() - 1] = chunks[0][chunks[0].size() - 1] + 1;
+
+    QByteArray received;
+    QByteArray nextRequest;
+    QVERIFY(!receiver.handleChunk(testGroup, testPeer, testAuthor, chunks[0], nowMs, nextRequest,
+                                  received));
+    QVERIFY(received.isEmpty());
+    QCOMPARE(receiver.getIncomingCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestNgcFileTransfer)
+#include "ngcfiletransfer_test.moc"
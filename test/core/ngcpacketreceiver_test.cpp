@@ -0,0 +1,80 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/core/ngcpacketreceiver.h"
+
+#include <QTest>
+
+namespace {
+QByteArray makeGroupFilePacket(const QByteArray& file)
+{
+    QByteArray packet;
+    packet.append("\x66\x77\x88\x11\x34\x35", 6);
+    packet.append('\x01');
+    packet.append('\x11');
+    packet.append(QByteArray(NgcPacketReceiver::GROUP_FILE_HEADER_SIZE - packet.size(), '\0'));
+    packet.append(file);
+    return packet;
+}
+} // namespace
+
+class TestNgcPacketReceiver : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testParseGroupFile();
+    void testWrongMagic();
+    void testWrongType();
+    void testHeaderOnly();
+};
+
+void TestNgcPacketReceiver::testParseGroupFile()
+{
+    const QByteArray file{"image data"};
+    QByteArray fileData;
+    QVERIFY(NgcPacketReceiver::parseGroupFile(makeGroupFilePacket(file), fileData));
+    QCOMPARE(fileData, file);
+}
+
+void TestNgcPacketReceiver::testWrongMagic()
+{
+    QByteArray packet = makeGroupFilePacket("image data");
+    packet[2] = 0x12;
+    QByteArray fileData;
+    QVERIFY(!NgcPacketReceiver::parseGroupFile(packet, fileData));
+}
+
+void TestNgcPacketReceiver::testWrongType()
+{
+    QByteArray packet = makeGroupFilePacket("image data");
+    packet[7] = 0x01;
+    QByteArray fileData;
+    QVERIFY(!NgcPacketReceiver::parseGroupFile(packet, fileData));
+}
+
+void TestNgcPacketReceiver::testHeaderOnly()
+{
+    QByteArray fileData;
+    QVERIFY(!NgcPacketReceiver::parseGroupFile(makeGroupFilePacket({}), fileData));
+    QVERIFY(!NgcPacketReceiver::parseGroupFile({}, fileData));
+}
+
+QTEST_GUILESS_MAIN(TestNgcPacketReceiver)
+#include "ngcpacketreceiver_test.moc"
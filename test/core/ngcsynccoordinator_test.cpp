@@ -0,0 +1,249 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/ngcsynccoordinator.h"
+
+#include <QTest>
+
+#include <memory>
+#include <set>
+
+namespace {
+const uint32_t testGroup = 3;
+const qint64 testStartMs = 1600000000000;
+const uint32_t testSeed = 42;
+
+/**
+ * @brief Advances the time in small steps, collecting all requests sent meanwhile.
+ */
+std::vector<NgcSyncCoordinator::Request> runFor(NgcSyncCoordinator& coordinator, qint64& nowMs,
+                                                qint64 durationMs)
+{
+    std::vector<NgcSyncCoordinator::Request> all;
+    const qint64 endMs = nowMs + durationMs;
+    for (; nowMs < endMs; nowMs += 100) {
+        for (const auto& request : coordinator.takeDueRequests(nowMs)) {
+            all.push_back(request);
+        }
+    }
+    return all;
+}
+
+/**
+ * @brief Advances the time until the next requests are sent.
+ */
+std::vector<NgcSyncCoordinator::Request> nextRequests(NgcSyncCoordinator& coordinator,
+                                                      qint64& nowMs)
+{
+    std::vector<NgcSyncCoordinator::Request> requests;
+    for (int i = 0; requests.empty() && i < 10000; ++i) {
+        nowMs += 100;
+        requests = coordinator.takeDueRequests(nowMs);
+    }
+    return requests;
+}
+
+ToxPk makePk(char fill)
+{
+    return ToxPk{QByteArray(ToxPk::size, fill)};
+}
+} // namespace
+
+class TestNgcSyncCoordinator : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testStartDelay();
+    void testRespondersLimited();
+    void testOutstandingLimited();
+    void testReplyKeepsOutstanding();
+    void testRoundCoalesced();
+    void testSkipWhenHeld();
+    void testFinishedRoundIsWatermark();
+    void testPeerLeaves();
+    void testLatePeerAsked();
+    void testAcceptRequestLimits();
+    void testAcceptRequestWindow();
+
+private:
+    std::unique_ptr<NgcSyncCoordinator> coordinator;
+    qint64 nowMs = 0;
+};
+
+void TestNgcSyncCoordinator::init()
+{
+    coordinator.reset(new NgcSyncCoordinator{testSeed});
+    coordinator->setPeers(testGroup, {1, 2, 3, 4, 5, 6, 7, 8});
+    nowMs = testStartMs;
+}
+
+void TestNgcSyncCoordinator::testStartDelay()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    QVERIFY(coordinator->isRoundActive(testGroup));
+
+    QVERIFY(runFor(*coordinator, nowMs, NgcSyncCoordinator::START_DELAY_MS).empty());
+    const auto requests = nextRequests(*coordinator, nowMs);
+    QCOMPARE(requests.size(), size_t{1});
+    QCOMPARE(requests[0].groupNumber, testGroup);
+    QVERIFY(nowMs - testStartMs
+            <= NgcSyncCoordinator::START_DELAY_MS + NgcSyncCoordinator::START_JITTER_MS);
+}
+
+void TestNgcSyncCoordinator::testRespondersLimited()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    const auto requests = runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS * 2);
+    QCOMPARE(requests.size(), static_cast<size_t>(NgcSyncCoordinator::MAX_RESPONDERS));
+
+    std::set<uint32_t> peers;
+    for (const auto& request : requests) {
+        peers.insert(request.peerId);
+    }
+    QCOMPARE(peers.size(), requests.size());
+    QVERIFY(!coordinator->isRoundActive(testGroup));
+}
+
+void TestNgcSyncCoordinator::testOutstandingLimited()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    std::vector<NgcSyncCoordinator::Request> requests;
+    // every responder keeps sending, so none of them finishes
+    for (const qint64 endMs = nowMs + NgcSyncCoordinator::ROUND_TIMEOUT_MS / 2; nowMs < endMs;
+         nowMs += 100) {
+        for (const auto& request : coordinator->takeDueRequests(nowMs)) {
+            requests.push_back(request);
+        }
+        for (const auto& request : requests) {
+            coordinator->onReplyPacket(testGroup, request.peerId, nowMs);
+        }
+    }
+    QCOMPARE(requests.size(), static_cast<size_t>(NgcSyncCoordinator::MAX_OUTSTANDING));
+}
+
+void TestNgcSyncCoordinator::testReplyKeepsOutstanding()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    coordinator->setPeers(testGroup, {1, 2});
+    auto requests = nextRequests(*coordinator, nowMs);
+    QCOMPARE(requests.size(), size_t{1});
+    const uint32_t firstPeer = requests[0].peerId;
+    requests = nextRequests(*coordinator, nowMs);
+    QCOMPARE(requests.size(), size_t{1});
+
+    // the second reply never comes, the first one goes on beyond the round timeout
+    const qint64 firstRequestMs = nowMs;
+    for (int i = 0; i < 150; ++i) {
+        coordinator->onReplyPacket(testGroup, firstPeer, nowMs);
+        nowMs += 500;
+        QVERIFY(coordinator->takeDueRequests(nowMs).empty());
+    }
+    QVERIFY(coordinator->isRoundActive(testGroup));
+    QVERIFY(nowMs - firstRequestMs > NgcSyncCoordinator::ROUND_TIMEOUT_MS);
+
+    // the round ends once the reply stops
+    runFor(*coordinator, nowMs, NgcSyncCoordinator::REPLY_IDLE_MS);
+    QVERIFY(!coordinator->isRoundActive(testGroup));
+}
+
+void TestNgcSyncCoordinator::testRoundCoalesced()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    QVERIFY(!coordinator->startRound(testGroup, nowMs + 1000, 0));
+    const auto requests = runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS * 2);
+    QCOMPARE(requests.size(), static_cast<size_t>(NgcSyncCoordinator::MAX_RESPONDERS));
+}
+
+void TestNgcSyncCoordinator::testSkipWhenHeld()
+{
+    QVERIFY(!coordinator->startRound(testGroup, nowMs, nowMs - 1000));
+    QVERIFY(!coordinator->isRoundActive(testGroup));
+    QVERIFY(runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS).empty());
+
+    QVERIFY(coordinator->startRound(testGroup, nowMs,
+                                    nowMs - NgcSyncCoordinator::SKIP_GAP_MS - 1000));
+}
+
+void TestNgcSyncCoordinator::testFinishedRoundIsWatermark()
+{
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS * 2);
+    QVERIFY(!coordinator->isRoundActive(testGroup));
+
+    // the round started more than the gap ago
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+
+    init();
+    coordinator->setPeers(testGroup, {1});
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    const qint64 roundStartMs = nowMs;
+    while (coordinator->isRoundActive(testGroup)) {
+        coordinator->takeDueRequests(nowMs);
+        nowMs += 100;
+    }
+    QVERIFY(!coordinator->startRound(testGroup, roundStartMs + 1000, 0));
+}
+
+void TestNgcSyncCoordinator::testPeerLeaves()
+{
+    coordinator->setPeers(testGroup, {1});
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    coordinator->removePeer(testGroup, 1);
+    QVERIFY(runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS * 2).empty());
+    QVERIFY(!coordinator->isRoundActive(testGroup));
+}
+
+void TestNgcSyncCoordinator::testLatePeerAsked()
+{
+    coordinator->setPeers(testGroup, {});
+    QVERIFY(coordinator->startRound(testGroup, nowMs, 0));
+    QVERIFY(runFor(*coordinator, nowMs, NgcSyncCoordinator::ROUND_TIMEOUT_MS / 2).empty());
+
+    coordinator->addPeer(testGroup, 9);
+    const auto requests = runFor(*coordinator, nowMs, 1000);
+    QCOMPARE(requests.size(), size_t{1});
+    QCOMPARE(requests[0].peerId, 9u);
+}
+
+void TestNgcSyncCoordinator::testAcceptRequestLimits()
+{
+    QVERIFY(coordinator->acceptRequest(testGroup, makePk(0), nowMs));
+    QVERIFY(!coordinator->acceptRequest(testGroup, makePk(0), nowMs + 1000));
+
+    for (int i = 1; i < NgcSyncCoordinator::MAX_REPLIES_PER_WINDOW; ++i) {
+        QVERIFY(coordinator->acceptRequest(testGroup, makePk(static_cast<char>(i)), nowMs));
+    }
+    QVERIFY(!coordinator->acceptRequest(testGroup, makePk(100), nowMs));
+
+    // other groups have their own limit
+    QVERIFY(coordinator->acceptRequest(testGroup + 1, makePk(100), nowMs));
+}
+
+void TestNgcSyncCoordinator::testAcceptRequestWindow()
+{
+    QVERIFY(coordinator->acceptRequest(testGroup, makePk(0), nowMs));
+    QVERIFY(!coordinator->acceptRequest(testGroup, makePk(0),
+                                        nowMs + NgcSyncCoordinator::REPLY_WINDOW_MS - 1));
+    QVERIFY(coordinator->acceptRequest(testGroup, makePk(0),
+                                       nowMs + NgcSyncCoordinator::REPLY_WINDOW_MS));
+}
+
+QTEST_GUILESS_MAIN(TestNgcSyncCoordinator)
+#include "ngcsynccoordinator_test.moc"
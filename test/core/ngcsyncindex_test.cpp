@@ -0,0 +1,185 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/ngcsyncindex.h"
+
+#include <QTest>
+
+namespace {
+const int testGroup = 1000000;
+const qint64 testTimeMs = 1600000000000;
+
+ToxPk makePk(char fill)
+{
+    return ToxPk{QByteArray(ToxPk::size, fill)};
+}
+
+QByteArray makeHash(const QString& text)
+{
+    return NgcSyncIndex::messageHash(QByteArray("\x01\x02\x03\x04", 4), text);
+}
+
+/**
+ * @brief Builds a sync message the way History::getGroupSyncPackets does.
+ */
+QByteArray makeSyncPacket(const ToxPk& sender, uint32_t seconds, const QByteArray& name,
+                          const QByteArray& text)
+{
+    QByteArray packet("\x66\x77\x88\x11\x34\x35\x01\x02", 8);
+    packet.append("\xAB\xCD\xEF\x01", 4);
+    packet.append(sender.getByteArray());
+    packet.append(static_cast<char>(seconds >> 24));
+    packet.append(static_cast<char>(seconds >> 16));
+    packet.append(static_cast<char>(seconds >> 8));
+    packet.append(static_cast<char>(seconds));
+    packet.append(name.left(NgcSyncIndex::NAME_SIZE));
+    packet.append(QByteArray(NgcSyncIndex::NAME_SIZE - name.left(NgcSyncIndex::NAME_SIZE).size(),
+                             '\0'));
+    packet.append(text);
+    return packet;
+}
+} // namespace
+
+class TestNgcSyncIndex : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testDuplicateDropped();
+    void testTimestampTolerance();
+    void testKeyParts();
+    void testCapacity();
+    void testLoader();
+    void testRemoveGroup();
+    void testParseSyncMessage();
+    void testParseInvalid();
+};
+
+void TestNgcSyncIndex::testDuplicateDropped()
+{
+    NgcSyncIndex index;
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QCOMPARE(index.size(), size_t{1});
+    QCOMPARE(index.getDuplicates(), uint64_t{2});
+}
+
+void TestNgcSyncIndex::testTimestampTolerance()
+{
+    NgcSyncIndex index;
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+
+    // another responder received the message a bit later
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs + 3000, makeHash("hello")));
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs - NgcSyncIndex::MATCH_WINDOW_MS,
+                          makeHash("hello")));
+
+    // same id and text an hour later is a new message
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs + 60 * 60 * 1000, makeHash("hello")));
+}
+
+void TestNgcSyncIndex::testKeyParts()
+{
+    NgcSyncIndex index;
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(index.insert(testGroup + 1, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(index.insert(testGroup, makePk(2), testTimeMs, makeHash("hello")));
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello!")));
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs,
+                         NgcSyncIndex::messageHash(QByteArray(4, '\0'), "hello")));
+    QCOMPARE(index.size(), size_t{5});
+}
+
+void TestNgcSyncIndex::testCapacity()
+{
+    NgcSyncIndex index{3};
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash(QString::number(i))));
+    }
+    QCOMPARE(index.size(), size_t{3});
+
+    // the oldest message was evicted
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("0")));
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs, makeHash("3")));
+}
+
+void TestNgcSyncIndex::testLoader()
+{
+    NgcSyncIndex index;
+    int loads = 0;
+    index.setLoader([&loads](int groupnumber) {
+        ++loads;
+        QVector<NgcSyncIndex::Entry> entries;
+        if (groupnumber == testGroup) {
+            entries.append({makePk(1), testTimeMs, makeHash("stored")});
+        }
+        return entries;
+    });
+
+    QVERIFY(!index.insert(testGroup, makePk(1), testTimeMs + 1000, makeHash("stored")));
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("new")));
+    QVERIFY(index.insert(testGroup + 1, makePk(1), testTimeMs, makeHash("stored")));
+    QCOMPARE(loads, 2);
+}
+
+void TestNgcSyncIndex::testRemoveGroup()
+{
+    NgcSyncIndex index;
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(index.insert(testGroup + 1, makePk(1), testTimeMs, makeHash("hello")));
+
+    index.removeGroup(testGroup);
+    QCOMPARE(index.size(), size_t{1});
+    QVERIFY(index.insert(testGroup, makePk(1), testTimeMs, makeHash("hello")));
+    QVERIFY(!index.insert(testGroup + 1, makePk(1), testTimeMs, makeHash("hello")));
+}
+
+void TestNgcSyncIndex::testParseSyncMessage()
+{
+    const QByteArray packet = makeSyncPacket(makePk(7), 1600000000, "alice", "hello group");
+    NgcSyncIndex::SyncMessage message;
+    QVERIFY(NgcSyncIndex::parseSyncMessage(packet, message));
+    QCOMPARE(message.msgId, QByteArray("\xAB\xCD\xEF\x01", 4));
+    QCOMPARE(message.sender, makePk(7));
+    QCOMPARE(message.timestampMs, qint64{1600000000} * 1000);
+    QCOMPARE(message.senderName, QString("alice"));
+    QCOMPARE(message.text, QString("hello group"));
+
+    // names use all 25 bytes without a terminator
+    const QByteArray longName(NgcSyncIndex::NAME_SIZE, 'n');
+    QVERIFY(NgcSyncIndex::parseSyncMessage(makeSyncPacket(makePk(7), 1, longName, "x"), message));
+    QCOMPARE(message.senderName, QString::fromUtf8(longName));
+}
+
+void TestNgcSyncIndex::testParseInvalid()
+{
+    NgcSyncIndex::SyncMessage message;
+
+    // a message needs text
+    QVERIFY(!NgcSyncIndex::parseSyncMessage(makeSyncPacket(makePk(7), 1, "alice", {}), message));
+
+    QByteArray packet = makeSyncPacket(makePk(7), 1, "alice", "hello");
+    packet[7] = 0x03;
+    QVERIFY(!NgcSyncIndex::parseSyncMessage(packet, message));
+
+    QVERIFY(!NgcSyncIndex::parseSyncMessage({}, message));
+}
+
+QTEST_GUILESS_MAIN(TestNgcSyncIndex)
+#include "ngcsyncindex_test.moc"
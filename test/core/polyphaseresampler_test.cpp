@@ -0,0 +1,138 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/polyphaseresampler.h"
+
+#include <QTest>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+const size_t highRateFrame = 480 * 6;
+const size_t lowRateFrame = highRateFrame / PolyphaseResampler::FACTOR;
+
+std::vector<int16_t> tone(double frequency, double sampleRate, size_t samples)
+{
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        pcm[i] = static_cast<int16_t>(10000.0 * std::sin(2.0 * 3.14159265358979 * frequency * i
+                                                         / sampleRate));
+    }
+    return pcm;
+}
+
+/**
+ * @brief RMS of the second half of a signal, skipping the filter's start-up transient.
+ */
+double settledRms(const std::vector<int16_t>& pcm)
+{
+    double sum = 0.0;
+    for (size_t i = pcm.size() / 2; i < pcm.size(); ++i) {
+        sum += static_cast<double>(pcm[i]) * pcm[i];
+    }
+    return std::sqrt(sum / (pcm.size() - pcm.size() / 2));
+}
+} // namespace
+
+class TestPolyphaseResampler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testRejectsBadFrames();
+    void testDownsampleDcGain();
+    void testDownsampleKeepsSpeech();
+    void testDownsampleRejectsAliases();
+    void testUpsampleKeepsSpeech();
+    void testStateCarriesOver();
+};
+
+void TestPolyphaseResampler::testRejectsBadFrames()
+{
+    PolyphaseResampler down{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    std::vector<int16_t> in(highRateFrame + 3);
+    std::vector<int16_t> out(in.size());
+    QCOMPARE(down.process(in.data(), 0, out.data()), size_t{0});
+    QCOMPARE(down.process(in.data(), 481, out.data()), size_t{0});
+    QCOMPARE(down.process(in.data(), in.size(), out.data()), size_t{0});
+    QCOMPARE(down.process(in.data(), 480, out.data()), size_t{160});
+}
+
+void TestPolyphaseResampler::testDownsampleDcGain()
+{
+    PolyphaseResampler down{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    const std::vector<int16_t> in(highRateFrame, 1000);
+    std::vector<int16_t> out(lowRateFrame);
+    QCOMPARE(down.process(in.data(), in.size(), out.data()), lowRateFrame);
+    QVERIFY(std::abs(out.back() - 1000) <= 1);
+}
+
+void TestPolyphaseResampler::testDownsampleKeepsSpeech()
+{
+    PolyphaseResampler down{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    const std::vector<int16_t> in = tone(1000, 48000, highRateFrame);
+    std::vector<int16_t> out(lowRateFrame);
+    down.process(in.data(), in.size(), out.data());
+
+    const double ratio = settledRms(out) / settledRms(in);
+    QVERIFY(ratio > 0.97 && ratio < 1.03);
+}
+
+void TestPolyphaseResampler::testDownsampleRejectsAliases()
+{
+    PolyphaseResampler down{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    // would fold back to 4kHz without filtering
+    const std::vector<int16_t> in = tone(12000, 48000, highRateFrame);
+    std::vector<int16_t> out(lowRateFrame);
+    down.process(in.data(), in.size(), out.data());
+
+    QVERIFY(settledRms(out) < settledRms(in) / 100);
+}
+
+void TestPolyphaseResampler::testUpsampleKeepsSpeech()
+{
+    PolyphaseResampler up{PolyphaseResampler::Direction::Upsample, lowRateFrame};
+    const std::vector<int16_t> in = tone(1000, 16000, lowRateFrame);
+    std::vector<int16_t> out(highRateFrame);
+    QCOMPARE(up.process(in.data(), in.size(), out.data()), highRateFrame);
+
+    const double ratio = settledRms(out) / settledRms(in);
+    QVERIFY(ratio > 0.97 && ratio < 1.03);
+}
+
+void TestPolyphaseResampler::testStateCarriesOver()
+{
+    PolyphaseResampler whole{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    PolyphaseResampler split{PolyphaseResampler::Direction::Downsample, highRateFrame};
+    const std::vector<int16_t> in = tone(440, 48000, highRateFrame);
+
+    std::vector<int16_t> wholeOut(lowRateFrame);
+    whole.process(in.data(), in.size(), wholeOut.data());
+
+    // 10ms blocks must give the same result as one big frame
+    std::vector<int16_t> splitOut(lowRateFrame);
+    for (size_t offset = 0; offset < highRateFrame; offset += 480) {
+        split.process(in.data() + offset, 480, splitOut.data() + offset / 3);
+    }
+
+    QVERIFY(wholeOut == splitOut);
+}
+
+QTEST_GUILESS_MAIN(TestPolyphaseResampler)
+#include "polyphaseresampler_test.moc"
@@ -0,0 +1,127 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/toxeventrecorder.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+using Type = ToxEventRecorder::Type;
+using Event = ToxEventRecorder::Event;
+
+class TestToxEventRecorder : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testDisabledRecordsNothing();
+    void testRecordAnonymized();
+    void testRoundTrip();
+    void testInvalidLine();
+    void testWriteAndLoad();
+};
+
+void TestToxEventRecorder::testDisabledRecordsNothing()
+{
+    ToxEventRecorder& recorder = ToxEventRecorder::getInstance();
+    QVERIFY(!recorder.isEnabled());
+    recorder.record(Type::FriendMessage, 1, 0, 0, 12);
+    QVERIFY(recorder.getEvents().isEmpty());
+    QVERIFY(!recorder.write());
+}
+
+void TestToxEventRecorder::testRecordAnonymized()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ToxEventRecorder& recorder = ToxEventRecorder::getInstance();
+    recorder.enable(dir.filePath("events.jsonl"));
+
+    const QByteArray packet = QByteArrayLiteral("\x66\x77\x88\x11\x34\x35\x01\x02secret payload");
+    recorder.record(Type::NgcCustomPacket, 3, 7, 0, static_cast<size_t>(packet.size()),
+                    reinterpret_cast<const uint8_t*>(packet.constData()));
+    recorder.record(Type::NgcMessage, 3, 7, 1, 42);
+
+    const QVector<Event> events = recorder.getEvents();
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events[0].type, Type::NgcCustomPacket);
+    QCOMPARE(events[0].target, 3u);
+    QCOMPARE(events[0].peer, 7u);
+    QCOMPARE(events[0].length, static_cast<uint32_t>(packet.size()));
+    // only the packet id is kept
+    QCOMPARE(events[0].header, packet.left(ToxEventRecorder::HEADER_BYTES));
+    QCOMPARE(events[1].value, 1u);
+    QCOMPARE(events[1].length, 42u);
+    QVERIFY(events[1].header.isEmpty());
+    QVERIFY(events[1].timeUs >= events[0].timeUs);
+}
+
+void TestToxEventRecorder::testRoundTrip()
+{
+    const QVector<Event> events = {
+        {0, Type::SelfConnection, 0, 0, 2, 0, {}},
+        {1500, Type::FriendConnection, 4, 0, 1, 0, {}},
+        {2000, Type::LosslessPacket, 4, 0, 0, 300, QByteArrayLiteral("\xa0")},
+        {9000000000, Type::NgcPeerExit, 1, 4294967295u, 3, 9, {}},
+    };
+
+    QVector<Event> parsed;
+    QVERIFY(ToxEventRecorder::parse(ToxEventRecorder::serialize(events), parsed));
+    QCOMPARE(parsed.size(), events.size());
+    for (int i = 0; i < events.size(); ++i) {
+        QCOMPARE(parsed[i].timeUs, events[i].timeUs);
+        QCOMPARE(parsed[i].type, events[i].type);
+        QCOMPARE(parsed[i].target, events[i].target);
+        QCOMPARE(parsed[i].peer, events[i].peer);
+        QCOMPARE(parsed[i].value, events[i].value);
+        QCOMPARE(parsed[i].length, events[i].length);
+        QCOMPARE(parsed[i].header, events[i].header);
+    }
+}
+
+void TestToxEventRecorder::testInvalidLine()
+{
+    QVector<Event> parsed;
+    const QByteArray data = "{\"t\":1,\"e\":\"ngcPeerJoin\",\"n\":2,\"p\":5}\n"
+                            "{\"t\":2,\"e\":\"noSuchEvent\"}\n";
+    QVERIFY(!ToxEventRecorder::parse(data, parsed));
+    QCOMPARE(parsed.size(), 1);
+    QCOMPARE(parsed[0].type, Type::NgcPeerJoin);
+    QCOMPARE(parsed[0].peer, 5u);
+}
+
+void TestToxEventRecorder::testWriteAndLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("events.jsonl");
+    ToxEventRecorder& recorder = ToxEventRecorder::getInstance();
+    recorder.enable(path);
+    recorder.record(Type::ReadReceipt, 2, 0, 17);
+    QVERIFY(recorder.write());
+
+    QVector<Event> loaded;
+    QVERIFY(ToxEventRecorder::load(path, loaded));
+    QCOMPARE(loaded.size(), recorder.getEvents().size());
+    QCOMPARE(loaded.last().type, Type::ReadReceipt);
+    QCOMPARE(loaded.last().value, 17u);
+    QVERIFY(!ToxEventRecorder::load(dir.filePath("missing.jsonl"), loaded));
+}
+
+QTEST_GUILESS_MAIN(TestToxEventRecorder)
+#include "toxeventrecorder_test.moc"
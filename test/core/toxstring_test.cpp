@@ -23,6 +23,8 @@
 #include <QByteArray>
 #include <QString>
 
+#include <memory>
+
 class TestToxString : public QObject
 {
 Q_OBJECT
@@ -34,6 +36,10 @@ private slots:
     void emptyQByteTest();
     void emptyUINT8Test();
     void nullptrUINT8Test();
+    void unicodeQStrTest();
+    void nestedQStrTest();
+    void copyQStrTest();
+    void viewUINT8Test();
 
 private:
     /* Test Strings */
@@ -253,5 +259,69 @@ void TestToxString::nullptrUINT8Test()
     }
 }
 
+/**
+ * @brief Use QString with multi byte characters and an unpaired surrogate as input data, check
+ *        the bytes are the same as QString::toUtf8() gives
+ */
+void TestToxString::unicodeQStrTest()
+{
+    QString text = QStringLiteral("aé€😀");
+    text += QChar(0xD800);
+    text += QStringLiteral("z");
+    ToxString test(text);
+
+    QCOMPARE(test.getBytes(), text.toUtf8());
+    QCOMPARE(test.size(), static_cast<size_t>(text.toUtf8().size()));
+    QCOMPARE(test.data()[test.size()], static_cast<uint8_t>(0));
+    QCOMPARE(ToxString(QStringLiteral("aé€😀")).getQString(), QStringLiteral("aé€😀"));
+}
+
+/**
+ * @brief Create a ToxString from QString while another one holds the thread's buffer, both
+ *        keep their text
+ */
+void TestToxString::nestedQStrTest()
+{
+    ToxString first(testStr);
+    ToxString second(emptyStr);
+    const QString longText(ToxString::MAX_BUFFERED_LENGTH + 1, QChar('x'));
+    ToxString third(longText);
+
+    QCOMPARE(first.getQString(), testStr);
+    QCOMPARE(second.getQString(), emptyStr);
+    QCOMPARE(third.getQString(), longText);
+    QVERIFY(first.data() != second.data());
+}
+
+/**
+ * @brief Copy a ToxString from QString, the copy stays valid when the thread's buffer is reused
+ */
+void TestToxString::copyQStrTest()
+{
+    std::unique_ptr<ToxString> copy;
+    {
+        ToxString test(testStr);
+        copy = std::unique_ptr<ToxString>(new ToxString(test));
+    }
+    ToxString reuse(QStringLiteral("something else"));
+
+    QCOMPARE(copy->getQString(), testStr);
+    QCOMPARE(copy->getBytes(), testByte);
+    QCOMPARE(reuse.getQString(), QStringLiteral("something else"));
+}
+
+/**
+ * @brief Use uint8_t* as input data, check it is viewed and not copied
+ */
+void TestToxString::viewUINT8Test()
+{
+    ToxString test(testUINT8, lengthUINT8);
+    ToxString copy(test);
+
+    QVERIFY(test.data() == testUINT8);
+    QVERIFY(copy.data() == testUINT8);
+    QCOMPARE(copy.getBytes(), testByte);
+}
+
 QTEST_GUILESS_MAIN(TestToxString)
 #include "toxstring_test.moc"
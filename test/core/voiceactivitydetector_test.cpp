@@ -0,0 +1,113 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/core/voiceactivitydetector.h"
+
+#include <QTest>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+const uint32_t sampleRate = 48000;
+const size_t frameSamples = sampleRate / 50;
+const uint32_t frameMs = 20;
+
+/**
+ * @brief A voiced sound: pitch with harmonics and a slow amplitude modulation.
+ */
+std::vector<int16_t> voicedFrame(int index)
+{
+    std::vector<int16_t> pcm(frameSamples);
+    for (size_t i = 0; i < frameSamples; ++i) {
+        const double t = (index * frameSamples + i) / static_cast<double>(sampleRate);
+        double sample = 0.0;
+        for (int harmonic = 1; harmonic < 20; ++harmonic) {
+            sample += std::sin(2.0 * 3.14159265358979 * 140.0 * harmonic * t) / harmonic;
+        }
+        sample *= 0.6 + 0.4 * std::sin(2.0 * 3.14159265358979 * 4.0 * t);
+        pcm[i] = static_cast<int16_t>(3000.0 * sample);
+    }
+    return pcm;
+}
+} // namespace
+
+class TestVoiceActivityDetector : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testStartsInactive();
+    void testDetectsVoice();
+    void testHangover();
+    void testUnknownFramesAreSent();
+};
+
+void TestVoiceActivityDetector::testStartsInactive()
+{
+    VoiceActivityDetector vad{sampleRate};
+    QVERIFY(!vad.isActive());
+
+    const std::vector<int16_t> silence(frameSamples, 0);
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(!vad.process(silence.data(), silence.size()));
+    }
+}
+
+void TestVoiceActivityDetector::testDetectsVoice()
+{
+    VoiceActivityDetector vad{sampleRate};
+    int active = 0;
+    for (int i = 0; i < 50; ++i) {
+        const std::vector<int16_t> frame = voicedFrame(i);
+        active += vad.process(frame.data(), frame.size()) ? 1 : 0;
+    }
+    QVERIFY(active > 45);
+}
+
+void TestVoiceActivityDetector::testHangover()
+{
+    VoiceActivityDetector vad{sampleRate};
+    for (int i = 0; i < 50; ++i) {
+        const std::vector<int16_t> frame = voicedFrame(i);
+        vad.process(frame.data(), frame.size());
+    }
+    QVERIFY(vad.isActive());
+
+    // the stream stays active for at least the hangover after speech stopped
+    const std::vector<int16_t> silence(frameSamples, 0);
+    for (uint32_t ms = frameMs; ms < VoiceActivityDetector::HANGOVER_MS; ms += frameMs) {
+        QVERIFY(vad.process(silence.data(), silence.size()));
+    }
+
+    int frames = 0;
+    while (vad.process(silence.data(), silence.size()) && frames < 100) {
+        ++frames;
+    }
+    QVERIFY(!vad.isActive());
+}
+
+void TestVoiceActivityDetector::testUnknownFramesAreSent()
+{
+    VoiceActivityDetector vad{sampleRate};
+    const std::vector<int16_t> odd(frameSamples + 1, 0);
+    QVERIFY(vad.process(odd.data(), odd.size()));
+}
+
+QTEST_GUILESS_MAIN(TestVoiceActivityDetector)
+#include "voiceactivitydetector_test.moc"
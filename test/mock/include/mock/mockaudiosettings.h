@@ -0,0 +1,177 @@
+/*
+    Copyright © 2022 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "audio/iaudiosettings.h"
+
+#include <QObject>
+
+#include <tuple>
+
+class MockAudioSettings : public QObject, public IAudioSettings
+{
+    Q_OBJECT
+public:
+    MockAudioSettings() = default;
+    ~MockAudioSettings();
+
+    QString getInDev() const override
+    {
+        return {};
+    }
+    void setInDev(const QString& deviceSpecifier) override { std::ignore = deviceSpecifier; }
+
+    bool getAudioInDevEnabled() const override
+    {
+        return true;
+    }
+    void setAudioInDevEnabled(bool enabled) override { std::ignore = enabled; }
+
+    QString getOutDev() const override
+    {
+        return {};
+    }
+    void setOutDev(const QString& deviceSpecifier) override { std::ignore = deviceSpecifier; }
+
+    bool getAudioOutDevEnabled() const override
+    {
+        return true;
+    }
+    void setAudioOutDevEnabled(bool enabled) override { std::ignore = enabled; }
+
+    qreal getAudioInGainDecibel() const override
+    {
+        return 0;
+    }
+    void setAudioInGainDecibel(qreal dB) override { std::ignore = dB; }
+
+    qreal getAudioThreshold() const override
+    {
+        return 0;
+    }
+    void setAudioThreshold(qreal percent) override { std::ignore = percent; }
+
+    int getOutVolume() const override
+    {
+        return 100;
+    }
+    void setOutVolume(int volume) override { std::ignore = volume; }
+
+    int getOutVolumeMin() const override
+    {
+        return 0;
+    }
+    int getOutVolumeMax() const override
+    {
+        return 100;
+    }
+
+    int getAudioBitrate() const override
+    {
+        return 64;
+    }
+    void setAudioBitrate(int bitrate) override { std::ignore = bitrate; }
+
+    bool getEnableTestSound() const override
+    {
+        return false;
+    }
+    void setEnableTestSound(bool newValue) override { std::ignore = newValue; }
+
+    int getScreenVideoFPS() const override
+    {
+        return 30;
+    }
+    void setScreenVideoFPS(int newValue) override { std::ignore = newValue; }
+
+    int getVideoEncoderPreset() const override
+    {
+        return 1;
+    }
+    void setVideoEncoderPreset(int newValue) override { std::ignore = newValue; }
+
+    bool getEchoCancellation() const override
+    {
+        return true;
+    }
+    void setEchoCancellation(bool newValue) override { std::ignore = newValue; }
+
+    int getEchoLatency() const override
+    {
+        return 80;
+    }
+    void setEchoLatency(int newValue) override { std::ignore = newValue; }
+
+    int getAecechomode() const override
+    {
+        return 3;
+    }
+    void setAecechomode(int newValue) override { std::ignore = newValue; }
+
+    int getAecechonsmode() const override
+    {
+        return 1;
+    }
+    void setAecechonsmode(int newValue) override { std::ignore = newValue; }
+
+    bool getFullAudioProcessing() const override
+    {
+        return false;
+    }
+    void setFullAudioProcessing(bool newValue) override { std::ignore = newValue; }
+
+    bool getAudioTransientSuppression() const override
+    {
+        return false;
+    }
+    void setAudioTransientSuppression(bool newValue) override { std::ignore = newValue; }
+
+    bool getAudioVoiceGate() const override
+    {
+        return false;
+    }
+    void setAudioVoiceGate(bool newValue) override { std::ignore = newValue; }
+
+    InputMode getAudioInputMode() const override
+    {
+        return InputMode::Voice;
+    }
+    void setAudioInputMode(InputMode newValue) override { std::ignore = newValue; }
+
+    SIGNAL_IMPL(MockAudioSettings, inDevChanged, const QString& device)
+    SIGNAL_IMPL(MockAudioSettings, audioInDevEnabledChanged, bool enabled)
+    SIGNAL_IMPL(MockAudioSettings, outDevChanged, const QString& device)
+    SIGNAL_IMPL(MockAudioSettings, audioOutDevEnabledChanged, bool enabled)
+    SIGNAL_IMPL(MockAudioSettings, audioInGainDecibelChanged, qreal dB)
+    SIGNAL_IMPL(MockAudioSettings, audioThresholdChanged, qreal dB)
+    SIGNAL_IMPL(MockAudioSettings, outVolumeChanged, int volume)
+    SIGNAL_IMPL(MockAudioSettings, audioBitrateChanged, int bitrate)
+    SIGNAL_IMPL(MockAudioSettings, enableTestSoundChanged, bool newValue)
+    SIGNAL_IMPL(MockAudioSettings, screenVideoFPSChanged, int fps)
+    SIGNAL_IMPL(MockAudioSettings, videoEncoderPresetChanged, int preset)
+    SIGNAL_IMPL(MockAudioSettings, echoCancellationChanged, bool newValue)
+    SIGNAL_IMPL(MockAudioSettings, echoLatencyChanged, int latency_ms)
+    SIGNAL_IMPL(MockAudioSettings, aecechomodeChanged, int mode)
+    SIGNAL_IMPL(MockAudioSettings, aecechonsmodeChanged, int mode)
+    SIGNAL_IMPL(MockAudioSettings, fullAudioProcessingChanged, bool newValue)
+    SIGNAL_IMPL(MockAudioSettings, audioTransientSuppressionChanged, bool newValue)
+    SIGNAL_IMPL(MockAudioSettings, audioVoiceGateChanged, bool newValue)
+    SIGNAL_IMPL(MockAudioSettings, audioInputModeChanged, IAudioSettings::InputMode mode)
+};
@@ -97,6 +97,24 @@ public:
         return QNetworkProxy(QNetworkProxy::ProxyType::NoProxy);
     }
 
+    QByteArray getBootstrapNodeRanking() const override
+    {
+        return nodeRanking;
+    }
+    void setBootstrapNodeRanking(const QByteArray& ranking) override
+    {
+        nodeRanking = ranking;
+    }
+
+    QByteArray getLanPeerCache() const override
+    {
+        return lanPeers;
+    }
+    void setLanPeerCache(const QByteArray& peers) override
+    {
+        lanPeers = peers;
+    }
+
     SIGNAL_IMPL(MockSettings, enableIPv6Changed, bool enabled)
     SIGNAL_IMPL(MockSettings, forceTCPChanged, bool enabled)
     SIGNAL_IMPL(MockSettings, enableLanDiscoveryChanged, bool enabled)
@@ -109,4 +127,6 @@ private:
     ProxyType type;
     quint16 port;
     Tox *pToxcore;
+    QByteArray nodeRanking;
+    QByteArray lanPeers;
 };
@@ -0,0 +1,177 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/model/chatlogchunks.h"
+#include "util/cacheregistry.h"
+
+#include <QTest>
+
+#include <vector>
+
+namespace {
+ChatLogItem makeItem(size_t idx)
+{
+    SystemMessage message;
+    message.messageType = SystemMessageType::titleChanged;
+    message.args[0] = QString::number(idx);
+    return ChatLogItem(message);
+}
+
+QString itemText(const ChatLogItem* item)
+{
+    return item->getContentAsSystemMessage().args[0];
+}
+} // namespace
+
+class TestChatLogChunks : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testInsertAndFind();
+    void testNoEvictionWithoutLoader();
+    void testEvictionAndReload();
+    void testPinnedChunksStay();
+    void testTrimOnRequest();
+    void testLowMemory();
+};
+
+void TestChatLogChunks::testInsertAndFind()
+{
+    ChatLogChunks chunks;
+    QVERIFY(chunks.empty());
+
+    // insert out of order and across chunk borders, like history loading does
+    const size_t start = ChatLogChunks::CHUNK_SIZE - 3;
+    for (size_t idx = start + 6; idx > start; --idx) {
+        QVERIFY(chunks.emplace(ChatLogIdx(idx - 1), makeItem(idx - 1)));
+    }
+    QVERIFY(!chunks.emplace(ChatLogIdx(start), makeItem(0)));
+
+    QVERIFY(!chunks.empty());
+    QCOMPARE(chunks.firstIdx().get(), start);
+    QCOMPARE(chunks.loadedChunks(), static_cast<size_t>(2));
+    for (size_t idx = start; idx < start + 6; ++idx) {
+        QCOMPARE(itemText(chunks.find(ChatLogIdx(idx))), QString::number(idx));
+    }
+    QVERIFY(!chunks.find(ChatLogIdx(start + 6)));
+}
+
+void TestChatLogChunks::testNoEvictionWithoutLoader()
+{
+    ChatLogChunks chunks;
+    const size_t count = ChatLogChunks::CHUNK_SIZE * (ChatLogChunks::MAX_LOADED_CHUNKS + 2);
+    for (size_t idx = 0; idx < count; ++idx) {
+        chunks.emplace(ChatLogIdx(idx), makeItem(idx));
+    }
+
+    QCOMPARE(chunks.loadedChunks(), ChatLogChunks::MAX_LOADED_CHUNKS + 2);
+    QVERIFY(chunks.find(ChatLogIdx(0)));
+}
+
+void TestChatLogChunks::testEvictionAndReload()
+{
+    ChatLogChunks chunks;
+    std::vector<size_t> reloads;
+    chunks.setLoader(
+        [&](ChatLogIdx begin, ChatLogIdx end) {
+            reloads.push_back(begin.get());
+            for (auto idx = begin; idx < end; ++idx) {
+                chunks.emplace(idx, makeItem(idx.get()));
+            }
+        },
+        [](ChatLogIdx, ChatLogIdx) { return true; });
+
+    const size_t count = ChatLogChunks::CHUNK_SIZE * (ChatLogChunks::MAX_LOADED_CHUNKS + 2);
+    for (size_t idx = 0; idx < count; ++idx) {
+        chunks.emplace(ChatLogIdx(idx), makeItem(idx));
+    }
+
+    // the least recently used chunks were dropped
+    QCOMPARE(chunks.loadedChunks(), ChatLogChunks::MAX_LOADED_CHUNKS);
+    QVERIFY(chunks.isEvicted(ChatLogIdx(0)));
+    QVERIFY(chunks.isEvicted(ChatLogIdx(ChatLogChunks::CHUNK_SIZE)));
+    QVERIFY(!chunks.isEvicted(ChatLogIdx(count - 1)));
+    QCOMPARE(chunks.firstIdx().get(), static_cast<size_t>(0));
+    QVERIFY(reloads.empty());
+
+    // and come back on demand
+    QCOMPARE(itemText(chunks.find(ChatLogIdx(1))), QString::number(1));
+    QCOMPARE(reloads.size(), static_cast<size_t>(1));
+    QCOMPARE(reloads.front(), static_cast<size_t>(0));
+    QVERIFY(!chunks.isEvicted(ChatLogIdx(0)));
+    QCOMPARE(chunks.loadedChunks(), ChatLogChunks::MAX_LOADED_CHUNKS);
+}
+
+void TestChatLogChunks::testPinnedChunksStay()
+{
+    ChatLogChunks chunks;
+    chunks.setLoader([](ChatLogIdx, ChatLogIdx) {},
+                     [](ChatLogIdx begin, ChatLogIdx) { return begin.get() != 0; });
+
+    const size_t count = ChatLogChunks::CHUNK_SIZE * (ChatLogChunks::MAX_LOADED_CHUNKS + 2);
+    for (size_t idx = 0; idx < count; ++idx) {
+        chunks.emplace(ChatLogIdx(idx), makeItem(idx));
+    }
+
+    QVERIFY(!chunks.isEvicted(ChatLogIdx(0)));
+    QVERIFY(chunks.isEvicted(ChatLogIdx(ChatLogChunks::CHUNK_SIZE)));
+    QCOMPARE(itemText(chunks.find(ChatLogIdx(0))), QString::number(0));
+}
+
+void TestChatLogChunks::testTrimOnRequest()
+{
+    ChatLogChunks chunks;
+    chunks.setLoader([](ChatLogIdx, ChatLogIdx) {}, [](ChatLogIdx, ChatLogIdx) { return true; });
+
+    const size_t count = ChatLogChunks::CHUNK_SIZE * 3 + 1;
+    for (size_t idx = 0; idx < count; ++idx) {
+        chunks.emplace(ChatLogIdx(idx), makeItem(idx));
+    }
+    QCOMPARE(chunks.loadedItems(), count);
+    const size_t chunkBytes = chunks.loadedBytes() / chunks.loadedChunks();
+
+    chunks.trim(1);
+    QCOMPARE(chunks.loadedChunks(), static_cast<size_t>(1));
+    QCOMPARE(chunks.loadedItems(), static_cast<size_t>(1));
+    QCOMPARE(chunks.loadedBytes(), chunkBytes);
+
+    // the chunk used last always stays
+    chunks.trim(0);
+    QCOMPARE(chunks.loadedChunks(), static_cast<size_t>(1));
+    QVERIFY(!chunks.isEvicted(ChatLogIdx(count - 1)));
+}
+
+void TestChatLogChunks::testLowMemory()
+{
+    CacheRegistry::getInstance().setLowMemory(true);
+
+    ChatLogChunks chunks;
+    chunks.setLoader([](ChatLogIdx, ChatLogIdx) {}, [](ChatLogIdx, ChatLogIdx) { return true; });
+    const size_t count = ChatLogChunks::CHUNK_SIZE * (ChatLogChunks::MAX_LOADED_CHUNKS + 2);
+    for (size_t idx = 0; idx < count; ++idx) {
+        chunks.emplace(ChatLogIdx(idx), makeItem(idx));
+    }
+
+    CacheRegistry::getInstance().setLowMemory(false);
+    QCOMPARE(chunks.loadedChunks(), ChatLogChunks::LOW_MEMORY_LOADED_CHUNKS);
+}
+
+QTEST_GUILESS_MAIN(TestChatLogChunks)
+#include "chatlogchunks_test.moc"
@@ -0,0 +1,165 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "src/model/contactupdatecoalescer.h"
+
+#include <QTest>
+
+#include <memory>
+
+namespace {
+ToxPk makePk(uint8_t id)
+{
+    QByteArray bytes(ToxPk::size, static_cast<char>(id));
+    return ToxPk(bytes);
+}
+} // namespace
+
+class TestContactUpdateCoalescer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testLastValueWins();
+    void testDeliveredNextTurn();
+    void testJoinExitNettedOut();
+    void testRejoinKeepsExit();
+    void testRenameFoldedIntoJoin();
+
+private:
+    std::unique_ptr<ContactUpdateCoalescer> coalescer;
+    QVector<QVector<ContactUpdateCoalescer::FriendUpdate>> friendBatches;
+    QVector<QVector<ContactUpdateCoalescer::GroupUpdate>> groupBatches;
+};
+
+void TestContactUpdateCoalescer::init()
+{
+    coalescer.reset(new ContactUpdateCoalescer());
+    friendBatches.clear();
+    groupBatches.clear();
+    connect(coalescer.get(), &ContactUpdateCoalescer::friendsUpdated, this,
+            [this](const QVector<ContactUpdateCoalescer::FriendUpdate>& updates) {
+                friendBatches << updates;
+            });
+    connect(coalescer.get(), &ContactUpdateCoalescer::groupsUpdated, this,
+            [this](const QVector<ContactUpdateCoalescer::GroupUpdate>& updates) {
+                groupBatches << updates;
+            });
+}
+
+void TestContactUpdateCoalescer::testLastValueWins()
+{
+    coalescer->onFriendStatusChanged(1, Status::Status::Online);
+    coalescer->onFriendUsernameChanged(2, "first");
+    coalescer->onFriendStatusChanged(1, Status::Status::Offline);
+    coalescer->onFriendUsernameChanged(2, "second");
+    coalescer->onFriendStatusChanged(1, Status::Status::Away);
+    coalescer->onFriendTypingChanged(2, true);
+    coalescer->onFriendTypingChanged(2, false);
+    coalescer->flush();
+
+    QCOMPARE(friendBatches.size(), 1);
+    const auto& updates = friendBatches.first();
+    QCOMPARE(updates.size(), 2);
+    QCOMPARE(updates[0].friendId, 1u);
+    QVERIFY(updates[0].hasStatus);
+    QVERIFY(!updates[0].hasUsername);
+    QVERIFY(updates[0].status == Status::Status::Away);
+    QCOMPARE(updates[1].friendId, 2u);
+    QVERIFY(!updates[1].hasStatus);
+    QCOMPARE(updates[1].username, QStringLiteral("second"));
+    QVERIFY(updates[1].hasTyping);
+    QVERIFY(!updates[1].isTyping);
+    QVERIFY(groupBatches.isEmpty());
+}
+
+void TestContactUpdateCoalescer::testDeliveredNextTurn()
+{
+    for (int i = 0; i < 100; ++i) {
+        coalescer->onFriendStatusMessageChanged(7, QString::number(i));
+        coalescer->onGroupPeerlistChanged(3);
+    }
+    QVERIFY(friendBatches.isEmpty());
+
+    QTRY_COMPARE(friendBatches.size(), 1);
+    QCOMPARE(friendBatches.first().size(), 1);
+    QCOMPARE(friendBatches.first().first().statusMessage, QStringLiteral("99"));
+    QCOMPARE(groupBatches.size(), 1);
+    QVERIFY(groupBatches.first().first().peerlistChanged);
+
+    // nothing new, nothing delivered
+    QTest::qWait(10);
+    QCOMPARE(friendBatches.size(), 1);
+}
+
+void TestContactUpdateCoalescer::testJoinExitNettedOut()
+{
+    coalescer->onGroupPeerJoined(0, 1, makePk(1), "peer");
+    coalescer->onGroupPeerRenamed(0, 1, makePk(1), "renamed");
+    coalescer->onGroupPeerExited(0, 1, makePk(1));
+    coalescer->onGroupPeerExited(0, 2, makePk(2));
+    coalescer->flush();
+
+    QCOMPARE(groupBatches.size(), 1);
+    const auto& changes = groupBatches.first().first().peerChanges;
+    QCOMPARE(changes.size(), 1);
+    QVERIFY(changes[0].peerPk == makePk(2));
+    QVERIFY(changes[0].exited);
+    QVERIFY(!changes[0].joined);
+}
+
+void TestContactUpdateCoalescer::testRejoinKeepsExit()
+{
+    coalescer->onGroupPeerExited(0, 1, makePk(1));
+    coalescer->onGroupPeerJoined(0, 5, makePk(1), "back");
+    coalescer->flush();
+
+    const auto& changes = groupBatches.first().first().peerChanges;
+    QCOMPARE(changes.size(), 1);
+    QVERIFY(changes[0].exited);
+    QVERIFY(changes[0].joined);
+    QCOMPARE(changes[0].peerId, 5u);
+    QCOMPARE(changes[0].name, QStringLiteral("back"));
+}
+
+void TestContactUpdateCoalescer::testRenameFoldedIntoJoin()
+{
+    coalescer->onGroupPeerJoined(4, 1, makePk(1), "peer");
+    coalescer->onGroupPeerRenamed(4, 1, makePk(1), "renamed");
+    coalescer->onGroupPeerRenamed(4, 2, makePk(2), "other");
+    coalescer->onGroupPeerNameChanged(4, makePk(3), "a");
+    coalescer->onGroupPeerNameChanged(4, makePk(3), "b");
+    coalescer->flush();
+
+    const auto& update = groupBatches.first().first();
+    QCOMPARE(update.groupnumber, 4);
+    QCOMPARE(update.peerChanges.size(), 2);
+    QVERIFY(update.peerChanges[0].joined);
+    QVERIFY(!update.peerChanges[0].renamed);
+    QCOMPARE(update.peerChanges[0].name, QStringLiteral("renamed"));
+    QVERIFY(update.peerChanges[1].renamed);
+    QCOMPARE(update.peerChanges[1].name, QStringLiteral("other"));
+    QCOMPARE(update.peerNames.size(), 1);
+    QCOMPARE(update.peerNames.value(makePk(3)), QStringLiteral("b"));
+}
+
+QTEST_GUILESS_MAIN(TestContactUpdateCoalescer)
+#include "contactupdatecoalescer_test.moc"
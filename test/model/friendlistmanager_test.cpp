@@ -48,6 +48,10 @@ public:
 
     void setWidgetVisible(bool v) override { visible = v; }
 
+    void setName(const QString& v) { name = v; }
+    void setOnline(bool v) { online = v; }
+    void setLastActivity(const QDateTime& v) { lastActivity = v; }
+
 private:
     QString name;
     QDateTime lastActivity;
@@ -294,9 +298,16 @@ private slots:
     void testApplyFilterSearchString();
     void testApplyFilterByStatus();
     void testSetGroupsOnTop();
+    void testSetItemChangedByName();
+    void testSetItemChangedByActivity();
+    void testSetItemChangedUnmoved();
+    void testSetCheckRequired();
+    void testApplyFilterNarrowing();
+    void testApplyFilterRename();
 private:
     std::unique_ptr<FriendListManager> createManagerWithItems(
             const QVector<IFriendListItem*> itemsVec);
+    void checkSameAsFullSort(FriendListManager& manager, bool byName);
 };
 
 void TestFriendListManager::testAddFriendListItem()
@@ -529,6 +540,160 @@ void TestFriendListManager::testSetGroupsOnTop()
     }
 }
 
+void TestFriendListManager::testSetItemChangedByName()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    manager->sortByName();
+    QSignalSpy spy(manager.get(), &FriendListManager::itemsChanged);
+
+    // Two friends go online and one offline within one update
+    auto items = manager->getItems();
+    QVector<MockFriend*> changed;
+    for (auto item : items) {
+        if (item->isFriend()) {
+            changed.push_back(static_cast<MockFriend*>(item.get()));
+        }
+    }
+    changed.first()->setOnline(!changed.first()->isOnline());
+    changed.last()->setOnline(!changed.last()->isOnline());
+    changed.at(changed.size() / 2)->setOnline(!changed.at(changed.size() / 2)->isOnline());
+    manager->setItemChanged(changed.first());
+    manager->setItemChanged(changed.last());
+    manager->setItemChanged(changed.at(changed.size() / 2));
+    QCOMPARE(spy.count(), 3);
+
+    manager->sortByName();
+    QCOMPARE(manager->getPositionsChanged(), true);
+    checkSameAsFullSort(*manager, true);
+}
+
+void TestFriendListManager::testSetItemChangedByActivity()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    manager->sortByActivity();
+
+    // The least recently active friend writes a message
+    auto items = manager->getItems();
+    MockFriend* last = static_cast<MockFriend*>(items.last().get());
+    last->setLastActivity(QDateTime::currentDateTime().addSecs(60));
+    manager->setItemChanged(last);
+
+    manager->sortByActivity();
+    QCOMPARE(manager->getPositionsChanged(), true);
+    checkSameAsFullSort(*manager, false);
+}
+
+void TestFriendListManager::testSetItemChangedUnmoved()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    manager->sortByName();
+
+    auto items = manager->getItems();
+    manager->setItemChanged(items.first().get());
+    manager->setItemChanged(items.at(items.size() / 2).get());
+    manager->sortByName();
+
+    QCOMPARE(manager->getPositionsChanged(), false);
+    QCOMPARE(manager->getItems(), items);
+}
+
+void TestFriendListManager::testSetCheckRequired()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    manager->sortByName();
+
+    // One change is reported, the other one is not
+    auto items = manager->getItems();
+    QVector<MockFriend*> friends;
+    for (auto item : items) {
+        if (item->isFriend()) {
+            friends.push_back(static_cast<MockFriend*>(item.get()));
+        }
+    }
+    friends.first()->setOnline(!friends.first()->isOnline());
+    friends.last()->setOnline(!friends.last()->isOnline());
+    manager->setItemChanged(friends.first());
+    manager->setCheckRequired();
+
+    manager->sortByName();
+    QCOMPARE(manager->getPositionsChanged(), true);
+    checkSameAsFullSort(*manager, true);
+}
+
+void TestFriendListManager::testApplyFilterNarrowing()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    manager->sortByName();
+
+    // typing "test user" one character at a time, then deleting them again
+    const QString searchString = "test user";
+    auto checkVisible = [&](const QString& search) {
+        manager->setFilter(search, false, false, false);
+        manager->applyFilter();
+        for (auto item : manager->getItems()) {
+            QCOMPARE(item->widgetIsVisible(), item->getNameItem().contains(search, Qt::CaseInsensitive));
+        }
+    };
+    for (int i = 1; i <= searchString.size(); ++i) {
+        checkVisible(searchString.left(i));
+    }
+    for (int i = searchString.size() - 1; i > 0; --i) {
+        checkVisible(searchString.left(i));
+    }
+    checkVisible("USER WITH");
+    checkVisible("group");
+}
+
+void TestFriendListManager::testApplyFilterRename()
+{
+    FriendItemsBuilder listBuilder;
+    auto manager = createManagerWithItems(
+                listBuilder.addOfflineFriends()->addOnlineFriends()->addGroups()->buildUnsorted());
+    auto renamed = new MockFriend("Old name", false, QDateTime::currentDateTime());
+    manager->addFriendListItem(renamed);
+    manager->sortByName();
+
+    manager->setFilter("new n", false, false, false);
+    manager->applyFilter();
+    QCOMPARE(renamed->widgetIsVisible(), false);
+
+    renamed->setName("New name");
+    manager->setItemChanged(renamed);
+    manager->sortByName();
+    manager->applyFilter();
+    QCOMPARE(renamed->widgetIsVisible(), true);
+
+    // the old name must not match anymore
+    manager->setFilter("old", false, false, false);
+    manager->applyFilter();
+    QCOMPARE(renamed->widgetIsVisible(), false);
+}
+
+/**
+ * @brief Compares the current order of the manager with a full sort of its items.
+ */
+void TestFriendListManager::checkSameAsFullSort(FriendListManager& manager, bool byName)
+{
+    auto incremental = manager.getItems();
+    manager.setSortRequired();
+    if (byName) {
+        manager.sortByName();
+    } else {
+        manager.sortByActivity();
+    }
+    QCOMPARE(incremental, manager.getItems());
+}
+
 std::unique_ptr<FriendListManager> TestFriendListManager::createManagerWithItems(
         const QVector<IFriendListItem*> itemsVec)
 {
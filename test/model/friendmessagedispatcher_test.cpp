@@ -81,42 +81,73 @@ std::unique_ptr<ICoreExtPacket> MockCoreExtPacketAllocator::getPacket(uint32_t f
 class MockFriendMessageSender : public ICoreFriendMessageSender
 {
 public:
-    bool sendAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt) override;
+    uint64_t queueAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp) override;
 
-    bool sendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt) override;
+    uint64_t queueMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp) override;
 
+    void process(FriendMessageDispatcher& dispatcher);
+
+    struct QueuedMessage
+    {
+        uint64_t queuedId;
+        bool isAction;
+        QString content;
+    };
+
+    std::deque<QueuedMessage> queuedMessages;
+    uint64_t nextQueuedId = 0;
     bool canSend = true;
     ReceiptNum receiptNum{0};
     size_t numSentActions = 0;
     size_t numSentMessages = 0;
+    std::vector<QString> sentContents;
 };
 
-bool MockFriendMessageSender::sendAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt)
+uint64_t MockFriendMessageSender::queueAction(uint32_t friendId, const QString& action, const QString& id_or_hash, const QDateTime& timestamp)
 {
     std::ignore = friendId;
-    std::ignore = action;
     std::ignore = id_or_hash;
     std::ignore = timestamp;
-    if (canSend) {
-        numSentActions++;
-        receipt = receiptNum;
-        receiptNum.get() += 1;
-    }
-    return canSend;
+    queuedMessages.push_back({nextQueuedId, true, action});
+    return nextQueuedId++;
 }
 
-bool MockFriendMessageSender::sendMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp, ReceiptNum& receipt)
+uint64_t MockFriendMessageSender::queueMessage(uint32_t friendId, const QString& message, const QString& id_or_hash, const QDateTime& timestamp)
 {
     std::ignore = friendId;
-    std::ignore = message;
     std::ignore = id_or_hash;
     std::ignore = timestamp;
-    if (canSend) {
-        numSentMessages++;
-        receipt = receiptNum;
+    queuedMessages.push_back({nextQueuedId, false, message});
+    return nextQueuedId++;
+}
+
+/**
+ * @brief Hands all queued messages to "toxcore" like Core::process() does, refusing the ones
+ * behind the first refused message too
+ */
+void MockFriendMessageSender::process(FriendMessageDispatcher& dispatcher)
+{
+    auto refused = QVector<uint64_t>();
+    for (const auto& queued : queuedMessages) {
+        if (!canSend || !refused.isEmpty()) {
+            refused.append(queued.queuedId);
+            continue;
+        }
+
+        if (queued.isAction) {
+            numSentActions++;
+        } else {
+            numSentMessages++;
+        }
+        sentContents.push_back(queued.content);
+        dispatcher.onCoreMessageSent(queued.queuedId, receiptNum);
         receiptNum.get() += 1;
     }
-    return canSend;
+    queuedMessages.clear();
+
+    if (!refused.isEmpty()) {
+        dispatcher.onCoreMessagesRefused(refused);
+    }
 }
 
 class TestFriendMessageDispatcher : public QObject
@@ -132,6 +163,7 @@ private slots:
     void testMessageSending();
     void testOfflineMessages();
     void testFailedMessage();
+    void testRefusedMessagesKeepOrder();
     void testNegotiationFailure();
     void testNegotiationSuccess();
     void testOfflineExtensionMessages();
@@ -217,6 +249,7 @@ void TestFriendMessageDispatcher::testSignals()
 {
     auto startReceiptNum = messageSender->receiptNum;
     auto sentIds = friendMessageDispatcher->sendMessage(false, "test");
+    messageSender->process(*friendMessageDispatcher);
     auto endReceiptNum = messageSender->receiptNum;
 
     // We should have received some message ids in our callbacks
@@ -250,11 +283,13 @@ void TestFriendMessageDispatcher::testSignals()
 void TestFriendMessageDispatcher::testMessageSending()
 {
     friendMessageDispatcher->sendMessage(false, "Test");
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentMessages == 1);
     QVERIFY(messageSender->numSentActions == 0);
 
     friendMessageDispatcher->sendMessage(true, "Test");
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentMessages == 1);
     QVERIFY(messageSender->numSentActions == 1);
@@ -278,6 +313,7 @@ void TestFriendMessageDispatcher::testOfflineMessages()
 
     f->setStatus(Status::Status::Online);
     f->onNegotiationComplete();
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentActions == 1);
     QVERIFY(messageSender->numSentMessages == 2);
@@ -301,6 +337,7 @@ void TestFriendMessageDispatcher::testFailedMessage()
     messageSender->canSend = false;
 
     friendMessageDispatcher->sendMessage(false, "test");
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentMessages == 0);
 
@@ -308,10 +345,46 @@ void TestFriendMessageDispatcher::testFailedMessage()
     f->setStatus(Status::Status::Offline);
     f->setStatus(Status::Status::Online);
     f->onNegotiationComplete();
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentMessages == 1);
 }
 
+/**
+ * @brief Tests that messages toxcore refused after they were queued are resent in order, and
+ * new messages don't overtake them
+ */
+void TestFriendMessageDispatcher::testRefusedMessagesKeepOrder()
+{
+    messageSender->canSend = false;
+
+    friendMessageDispatcher->sendMessage(false, "test1");
+    friendMessageDispatcher->sendMessage(false, "test2");
+    messageSender->process(*friendMessageDispatcher);
+
+    QVERIFY(messageSender->numSentMessages == 0);
+
+    messageSender->canSend = true;
+    friendMessageDispatcher->sendMessage(false, "test3");
+    messageSender->process(*friendMessageDispatcher);
+
+    // still backing off
+    QVERIFY(messageSender->numSentMessages == 0);
+
+    f->setStatus(Status::Status::Offline);
+    f->setStatus(Status::Status::Online);
+    f->onNegotiationComplete();
+    messageSender->process(*friendMessageDispatcher);
+
+    QVERIFY(messageSender->sentContents == std::vector<QString>({"test1", "test2", "test3"}));
+
+    auto lastReceipt = messageSender->receiptNum;
+    for (auto i = ReceiptNum{0}; i < lastReceipt; ++i.get()) {
+        friendMessageDispatcher->onReceiptReceived(i);
+    }
+    QVERIFY(outgoingMessages.empty());
+}
+
 void TestFriendMessageDispatcher::testNegotiationFailure()
 {
     f->setStatus(Status::Status::Offline);
@@ -324,6 +397,7 @@ void TestFriendMessageDispatcher::testNegotiationFailure()
     QVERIFY(messageSender->numSentMessages == 0);
 
     f->onNegotiationComplete();
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(messageSender->numSentMessages == 1);
 }
@@ -408,6 +482,7 @@ void TestFriendMessageDispatcher::testActionMessagesSplitWithExtensions()
     }
 
     friendMessageDispatcher->sendMessage(true, reallyLongMessage);
+    messageSender->process(*friendMessageDispatcher);
 
     QVERIFY(coreExtPacketAllocator->numSentMessages == 0);
     QVERIFY(messageSender->numSentMessages == 0);
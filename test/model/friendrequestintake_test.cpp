@@ -0,0 +1,127 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/model/friendrequestintake.h"
+
+#include <QTest>
+
+#include <memory>
+
+namespace {
+ToxPk makePk(int id)
+{
+    QByteArray bytes(ToxPk::size, 0);
+    bytes[0] = static_cast<char>(id & 0xFF);
+    bytes[1] = static_cast<char>(id >> 8);
+    return ToxPk(bytes);
+}
+} // namespace
+
+class TestFriendRequestIntake : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testFirstDeliveredNextTurn();
+    void testDuplicatesMerged();
+    void testQueueBounded();
+    void testBatchesRateLimited();
+
+private:
+    std::unique_ptr<FriendRequestIntake> intake;
+    QVector<QVector<FriendRequestIntake::Request>> batches;
+};
+
+void TestFriendRequestIntake::init()
+{
+    intake.reset(new FriendRequestIntake());
+    batches.clear();
+    connect(intake.get(), &FriendRequestIntake::requestsReceived, this,
+            [this](const QVector<FriendRequestIntake::Request>& requests) { batches << requests; });
+}
+
+void TestFriendRequestIntake::testFirstDeliveredNextTurn()
+{
+    intake->onFriendRequestReceived(makePk(1), "hello");
+    QVERIFY(batches.isEmpty());
+
+    QTRY_COMPARE_WITH_TIMEOUT(batches.size(), 1, FriendRequestIntake::FLUSH_INTERVAL_MS / 2);
+    QCOMPARE(batches[0].size(), 1);
+    QCOMPARE(batches[0][0].friendPk, makePk(1));
+    QCOMPARE(batches[0][0].message, QStringLiteral("hello"));
+    QCOMPARE(intake->getPendingCount(), 0);
+}
+
+void TestFriendRequestIntake::testDuplicatesMerged()
+{
+    intake->onFriendRequestReceived(makePk(1), "first");
+    intake->onFriendRequestReceived(makePk(2), "other");
+    intake->onFriendRequestReceived(makePk(1), "second");
+    QCOMPARE(intake->getPendingCount(), 2);
+
+    intake->flush();
+    QCOMPARE(batches.size(), 1);
+    QCOMPARE(batches[0].size(), 2);
+    // keeps the order of the first request, with the latest message
+    QCOMPARE(batches[0][0].friendPk, makePk(1));
+    QCOMPARE(batches[0][0].message, QStringLiteral("second"));
+    QCOMPARE(batches[0][1].friendPk, makePk(2));
+}
+
+void TestFriendRequestIntake::testQueueBounded()
+{
+    for (int i = 0; i < FriendRequestIntake::MAX_PENDING + 50; ++i) {
+        intake->onFriendRequestReceived(makePk(i), {});
+    }
+    QCOMPARE(intake->getPendingCount(), FriendRequestIntake::MAX_PENDING);
+    QCOMPARE(intake->getDroppedCount(), 50);
+
+    // a pending key still gets its message updated
+    intake->onFriendRequestReceived(makePk(0), "update");
+    QCOMPARE(intake->getDroppedCount(), 50);
+
+    intake->flush();
+    QCOMPARE(intake->getDroppedCount(), 0);
+    QCOMPARE(batches[0][0].message, QStringLiteral("update"));
+}
+
+void TestFriendRequestIntake::testBatchesRateLimited()
+{
+    const int total = FriendRequestIntake::MAX_BATCH * 2 + 1;
+    for (int i = 0; i < total; ++i) {
+        intake->onFriendRequestReceived(makePk(i), {});
+    }
+
+    intake->flush();
+    QCOMPARE(batches.size(), 1);
+    QCOMPARE(batches[0].size(), FriendRequestIntake::MAX_BATCH);
+
+    // the rest waits for the interval
+    QTest::qWait(FriendRequestIntake::FLUSH_INTERVAL_MS / 4);
+    QCOMPARE(batches.size(), 1);
+
+    QTRY_COMPARE_WITH_TIMEOUT(batches.size(), 3, FriendRequestIntake::FLUSH_INTERVAL_MS * 4);
+    QCOMPARE(batches[1].size(), FriendRequestIntake::MAX_BATCH);
+    QCOMPARE(batches[2].size(), 1);
+    QCOMPARE(batches[2][0].friendPk, makePk(total - 1));
+    QCOMPARE(intake->getPendingCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestFriendRequestIntake)
+#include "friendrequestintake_test.moc"
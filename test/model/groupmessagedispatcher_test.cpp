@@ -99,6 +99,7 @@ private slots:
     void init();
     void testSignals();
     void testMessageSending();
+    void testSendBatch();
     void testEmptyGroup();
     void testSelfReceive();
     void testBlacklist();
@@ -213,6 +214,30 @@ void TestGroupMessageDispatcher::testMessageSending()
     QVERIFY(messageSender->numSentActions == 1);
 }
 
+/**
+ * @brief Tests that the chunks of a long message are sent within one batch
+ */
+void TestGroupMessageDispatcher::testSendBatch()
+{
+    int batchesStarted = 0;
+    int batchesFinished = 0;
+    size_t sentInBatch = 0;
+    connect(groupMessageDispatcher.get(), &GroupMessageDispatcher::sendBatchStarted,
+            [&] { ++batchesStarted; });
+    connect(groupMessageDispatcher.get(), &GroupMessageDispatcher::sendBatchFinished, [&] {
+        ++batchesFinished;
+        sentInBatch = sentMessages.size();
+    });
+
+    groupMessageDispatcher->sendMessage(false, QString(tox_max_message_length() * 3, 'a'));
+
+    QCOMPARE(batchesStarted, 1);
+    QCOMPARE(batchesFinished, 1);
+    QVERIFY(sentMessages.size() > 1);
+    QCOMPARE(sentInBatch, sentMessages.size());
+    QCOMPARE(messageSender->numSentMessages, sentMessages.size());
+}
+
 /**
  * @brief Tests that if we are the only member in a group we do _not_ send messages to core. Toxcore
  * isn't too happy if we send messages and we're the only one in the group
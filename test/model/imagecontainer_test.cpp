@@ -0,0 +1,83 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/model/imagecontainer.h"
+
+#include <QTest>
+
+using ImageContainer::Format;
+Q_DECLARE_METATYPE(ImageContainer::Format)
+
+namespace {
+QByteArray bytes(const char* data, int size)
+{
+    return QByteArray{data, size};
+}
+} // namespace
+
+class TestImageContainer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testSniff_data();
+    void testSniff();
+    void testQtFormat();
+};
+
+void TestImageContainer::testSniff_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<Format>("format");
+
+    QTest::newRow("png") << bytes("\x89PNG\r\n\x1a\n\0\0\0\rIHDR", 16) << Format::Png;
+    QTest::newRow("jpeg") << bytes("\xff\xd8\xff\xe0\0\x10JFIF", 10) << Format::Jpeg;
+    QTest::newRow("gif") << QByteArray("GIF89a\x01\0\x01\0", 10) << Format::Gif;
+    QTest::newRow("webp") << bytes("RIFF\x24\0\0\0WEBPVP8 ", 16) << Format::Webp;
+    QTest::newRow("avif major brand")
+        << bytes("\0\0\0\x1c" "ftypavif\0\0\0\0avifmif1miaf", 28) << Format::Avif;
+    QTest::newRow("avif compatible brand")
+        << bytes("\0\0\0\x18" "ftypmif1\0\0\0\0mif1avis", 24) << Format::Avif;
+    QTest::newRow("heic") << bytes("\0\0\0\x18" "ftypheic\0\0\0\0mif1heic", 24)
+                          << Format::Unknown;
+    QTest::newRow("bmp") << QByteArray("BM\x36\0\0\0", 6) << Format::Bmp;
+    QTest::newRow("riff without webp") << bytes("RIFF\x24\0\0\0WAVEfmt ", 16)
+                                       << Format::Unknown;
+    QTest::newRow("truncated png") << bytes("\x89PN", 3) << Format::Unknown;
+    QTest::newRow("empty") << QByteArray() << Format::Unknown;
+}
+
+void TestImageContainer::testSniff()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(Format, format);
+
+    QCOMPARE(ImageContainer::sniff(data), format);
+}
+
+void TestImageContainer::testQtFormat()
+{
+    QCOMPARE(ImageContainer::qtFormat(Format::Png), QByteArray("PNG"));
+    QCOMPARE(ImageContainer::qtFormat(Format::Webp), QByteArray("WEBP"));
+    QCOMPARE(ImageContainer::qtFormat(Format::Avif), QByteArray("AVIF"));
+    // empty lets QImageReader detect the format
+    QVERIFY(ImageContainer::qtFormat(Format::Unknown).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestImageContainer)
+#include "imagecontainer_test.moc"
@@ -0,0 +1,83 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/model/imagedecoder.h"
+
+#include <QBuffer>
+#include <QTest>
+
+namespace {
+QByteArray encodePng(QSize size)
+{
+    QImage image{size, QImage::Format_RGB32};
+    image.fill(Qt::green);
+
+    QByteArray data;
+    QBuffer buffer{&data};
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return data;
+}
+
+QImage decodeData(const QByteArray& data, QSize boundingSize)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    return ImageDecoder::decode(buffer, boundingSize);
+}
+} // namespace
+
+class TestImageDecoder : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testScaledDown();
+    void testOriginalSize();
+    void testNotUpscaled();
+    void testInvalidData();
+};
+
+void TestImageDecoder::testScaledDown()
+{
+    const QImage image = decodeData(encodePng({200, 100}), {50, 50});
+    QCOMPARE(image.size(), QSize(50, 25));
+}
+
+void TestImageDecoder::testOriginalSize()
+{
+    const QImage image = decodeData(encodePng({200, 100}), QSize());
+    QCOMPARE(image.size(), QSize(200, 100));
+}
+
+void TestImageDecoder::testNotUpscaled()
+{
+    const QImage image = decodeData(encodePng({20, 10}), {50, 50});
+    QCOMPARE(image.size(), QSize(20, 10));
+}
+
+void TestImageDecoder::testInvalidData()
+{
+    const QImage image = decodeData(QByteArrayLiteral("not an image"), {50, 50});
+    QVERIFY(image.isNull());
+}
+
+QTEST_GUILESS_MAIN(TestImageDecoder)
+#include "imagedecoder_test.moc"
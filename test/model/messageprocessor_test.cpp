@@ -44,6 +44,7 @@ public:
 private slots:
     void testSelfMention();
     void testOutgoingMessage();
+    void testSplitBoundaries();
     void testIncomingMessage();
 };
 
@@ -149,6 +150,31 @@ void TestMessageProcessor::testOutgoingMessage()
 /**
  * @brief Tests behavior of the processor for incoming messages
  */
+/**
+ * @brief Tests that messages are split on lines, words and never inside a utf8 character
+ */
+void TestMessageProcessor::testSplitBoundaries()
+{
+    auto sharedParams = MessageProcessor::SharedParams(10, 10 * 1024 * 1024);
+    auto messageProcessor = MessageProcessor(sharedParams);
+
+    auto contents = [&](const QString& str) {
+        QStringList ret;
+        for (const auto& message : messageProcessor.processOutgoingMessage(false, str, ExtensionSet())) {
+            ret.append(message.content);
+        }
+        return ret;
+    };
+
+    QCOMPARE(contents("hello world again"), (QStringList{"hello ", "world ", "again"}));
+    QCOMPARE(contents("ab cd\nefghij"), (QStringList{"ab cd\n", "efghij"}));
+    QCOMPARE(contents(QString::fromUtf8("aaaaaaaaa\xC3\xA4")),
+             (QStringList{"aaaaaaaaa", QString::fromUtf8("\xC3\xA4")}));
+    QCOMPARE(contents(QString::fromUtf8("\xE2\x82\xAC\xE2\x82\xAC\xE2\x82\xAC\xE2\x82\xAC")),
+             (QStringList{QString::fromUtf8("\xE2\x82\xAC\xE2\x82\xAC\xE2\x82\xAC"),
+                          QString::fromUtf8("\xE2\x82\xAC")}));
+}
+
 void TestMessageProcessor::testIncomingMessage()
 {
     // Nothing too special happening on the incoming side if we aren't looking for self mentions
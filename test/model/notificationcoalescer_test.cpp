@@ -0,0 +1,112 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/model/notificationcoalescer.h"
+
+#include <QStringList>
+#include <QTest>
+
+#include <memory>
+
+namespace {
+constexpr int windowMs = 50;
+constexpr int soundIntervalMs = 50;
+
+NotificationData makeNotification(const QString& title)
+{
+    NotificationData notificationData;
+    notificationData.title = title;
+    return notificationData;
+}
+} // namespace
+
+class TestNotificationCoalescer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testFirstIsImmediate();
+    void testStormCoalesced();
+    void testNothingPending();
+    void testClear();
+    void testSoundRateLimit();
+
+private:
+    std::unique_ptr<NotificationCoalescer> coalescer;
+    QStringList shown;
+};
+
+void TestNotificationCoalescer::init()
+{
+    coalescer.reset(new NotificationCoalescer(windowMs, soundIntervalMs));
+    shown.clear();
+    connect(coalescer.get(), &NotificationCoalescer::notificationReady, this,
+            [this](const NotificationData& notificationData) { shown << notificationData.title; });
+}
+
+void TestNotificationCoalescer::testFirstIsImmediate()
+{
+    coalescer->addNotification(makeNotification("first"));
+    QCOMPARE(shown, QStringList{"first"});
+}
+
+void TestNotificationCoalescer::testStormCoalesced()
+{
+    coalescer->addNotification(makeNotification("1"));
+    for (int i = 2; i <= 100; ++i) {
+        coalescer->addNotification(makeNotification(QString::number(i)));
+    }
+    QCOMPARE(shown.size(), 1);
+
+    // only the latest notification of the window is shown
+    QTRY_COMPARE_WITH_TIMEOUT(shown.size(), 2, windowMs * 10);
+    QCOMPARE(shown, (QStringList{"1", "100"}));
+}
+
+void TestNotificationCoalescer::testNothingPending()
+{
+    coalescer->addNotification(makeNotification("only"));
+    QTest::qWait(windowMs * 3);
+    QCOMPARE(shown.size(), 1);
+
+    // the window is over, the next one is immediate again
+    coalescer->addNotification(makeNotification("next"));
+    QCOMPARE(shown, (QStringList{"only", "next"}));
+}
+
+void TestNotificationCoalescer::testClear()
+{
+    coalescer->addNotification(makeNotification("1"));
+    coalescer->addNotification(makeNotification("2"));
+    coalescer->clear();
+    QTest::qWait(windowMs * 3);
+    QCOMPARE(shown, QStringList{"1"});
+}
+
+void TestNotificationCoalescer::testSoundRateLimit()
+{
+    QVERIFY(coalescer->allowSound());
+    QVERIFY(!coalescer->allowSound());
+    QTest::qWait(soundIntervalMs * 2);
+    QVERIFY(coalescer->allowSound());
+}
+
+QTEST_GUILESS_MAIN(TestNotificationCoalescer)
+#include "notificationcoalescer_test.moc"
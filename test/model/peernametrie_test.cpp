@@ -0,0 +1,119 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/model/peernametrie.h"
+
+#include <QTest>
+
+namespace {
+QStringList sorted(QStringList names)
+{
+    names.sort();
+    return names;
+}
+} // namespace
+
+class TestPeerNameTrie : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testPrefix();
+    void testCaseInsensitive();
+    void testLeadingPunctuation();
+    void testEmptyPrefix();
+    void testDuplicateNames();
+    void testRemovePrunes();
+};
+
+void TestPeerNameTrie::testPrefix()
+{
+    PeerNameTrie trie;
+    trie.insert("alice");
+    trie.insert("alfred");
+    trie.insert("bob");
+
+    QCOMPARE(sorted(trie.complete("al")), QStringList({"alfred", "alice"}));
+    QCOMPARE(trie.complete("bo"), QStringList{"bob"});
+    QVERIFY(trie.complete("x").isEmpty());
+    QVERIFY(trie.complete("alicee").isEmpty());
+}
+
+void TestPeerNameTrie::testCaseInsensitive()
+{
+    PeerNameTrie trie;
+    trie.insert("Alice");
+
+    QCOMPARE(trie.complete("aL"), QStringList{"Alice"});
+}
+
+void TestPeerNameTrie::testLeadingPunctuation()
+{
+    PeerNameTrie trie;
+    trie.insert("[bot]Alice");
+    trie.insert("_carol");
+
+    QCOMPARE(trie.complete("bot"), QStringList{"[bot]Alice"});
+    QCOMPARE(trie.complete("car"), QStringList{"_carol"});
+    QCOMPARE(trie.complete("_car"), QStringList{"_carol"});
+}
+
+void TestPeerNameTrie::testEmptyPrefix()
+{
+    PeerNameTrie trie;
+    trie.insert("alice");
+    trie.insert("bob");
+
+    QCOMPARE(sorted(trie.complete("")), QStringList({"alice", "bob"}));
+}
+
+void TestPeerNameTrie::testDuplicateNames()
+{
+    PeerNameTrie trie;
+    trie.insert("alice");
+    trie.insert("alice");
+    QCOMPARE(trie.size(), 1);
+    QCOMPARE(trie.complete("a"), QStringList{"alice"});
+
+    // still used by the second peer
+    trie.remove("alice");
+    QCOMPARE(trie.complete("a"), QStringList{"alice"});
+
+    trie.remove("alice");
+    QVERIFY(trie.complete("a").isEmpty());
+    QCOMPARE(trie.size(), 0);
+}
+
+void TestPeerNameTrie::testRemovePrunes()
+{
+    PeerNameTrie trie;
+    trie.insert("alice");
+    trie.insert("al");
+    trie.remove("alice");
+
+    QCOMPARE(trie.complete("a"), QStringList{"al"});
+    QVERIFY(trie.complete("ali").isEmpty());
+
+    // removing unknown names is harmless
+    trie.remove("nobody");
+    QCOMPARE(trie.size(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestPeerNameTrie)
+#include "peernametrie_test.moc"
@@ -68,6 +68,7 @@ private slots:
     void init();
 
     void testSanity();
+    void testIndexedSearch();
 
 private:
     MockCoreIdHandler idHandler;
@@ -138,5 +139,46 @@ void TestSessionChatLog::testSanity()
     QVERIFY(searchResult.start == 5);
 }
 
+/**
+ * @brief Tests that searching through the token index finds the same matches as scanning
+ */
+void TestSessionChatLog::testIndexedSearch()
+{
+    /* ChatLogIdx(0) */ chatLog->onMessageSent(DispatchedMessageId(0), createMessage("Unittests"));
+    /* ChatLogIdx(1) */ chatLog->onMessageReceived(ToxPk(), createMessage("nothing here"));
+    /* ChatLogIdx(2) */ chatLog->onMessageReceived(ToxPk(), createMessage("a TEST, again"));
+    /* ChatLogIdx(3) */ chatLog->onMessageSent(DispatchedMessageId(1), createMessage("...!"));
+
+    // part of a longer word, case insensitive
+    auto searchResult = chatLog->searchForward(SearchPos{ChatLogIdx(0), 0}, "test", ParameterSearch());
+    QVERIFY(searchResult.found);
+    QCOMPARE(searchResult.pos.logIdx, ChatLogIdx(0));
+    QCOMPARE(searchResult.start, 4);
+
+    searchResult = chatLog->searchForward(searchResult.pos, "test", ParameterSearch());
+    QVERIFY(searchResult.found);
+    QCOMPARE(searchResult.pos.logIdx, ChatLogIdx(2));
+    QCOMPARE(searchResult.start, 2);
+
+    searchResult = chatLog->searchForward(searchResult.pos, "test", ParameterSearch());
+    QVERIFY(!searchResult.found);
+
+    // tokens are found across punctuation
+    searchResult = chatLog->searchBackward(SearchPos{ChatLogIdx(4), 0}, "test, a", ParameterSearch());
+    QVERIFY(searchResult.found);
+    QCOMPARE(searchResult.pos.logIdx, ChatLogIdx(2));
+
+    // phrases without tokens and regular expressions scan all messages
+    searchResult = chatLog->searchForward(SearchPos{ChatLogIdx(0), 0}, "..", ParameterSearch());
+    QVERIFY(searchResult.found);
+    QCOMPARE(searchResult.pos.logIdx, ChatLogIdx(3));
+
+    ParameterSearch regular;
+    regular.filter = FilterSearch::Regular;
+    searchResult = chatLog->searchForward(SearchPos{ChatLogIdx(0), 0}, "no.hing", regular);
+    QVERIFY(searchResult.found);
+    QCOMPARE(searchResult.pos.logIdx, ChatLogIdx(1));
+}
+
 QTEST_GUILESS_MAIN(TestSessionChatLog)
 #include "sessionchatlog_test.moc"
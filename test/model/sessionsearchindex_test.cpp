@@ -0,0 +1,92 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/model/sessionsearchindex.h"
+
+#include <QtTest/QtTest>
+
+class TestSessionSearchIndex : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testTokenize();
+    void testCandidates();
+    void testAddTwice();
+    void testRegexFilter();
+};
+
+void TestSessionSearchIndex::testTokenize()
+{
+    QCOMPARE(SessionSearchIndex::tokenize(QStringLiteral("Hello, wörld! 42x")),
+             (QStringList{QStringLiteral("hello"), QStringLiteral("wörld"), QStringLiteral("42x")}));
+    QVERIFY(SessionSearchIndex::tokenize(QStringLiteral(" ...!? ")).isEmpty());
+}
+
+void TestSessionSearchIndex::testCandidates()
+{
+    SessionSearchIndex index;
+    index.add(ChatLogIdx(5), QStringLiteral("running tests"));
+    index.add(ChatLogIdx(1), QStringLiteral("a Test"));
+    index.add(ChatLogIdx(3), QStringLiteral("nothing"));
+
+    const auto* candidates = index.candidates(QStringLiteral("test"), FilterSearch::None);
+    QVERIFY(candidates);
+    QCOMPARE(*candidates, (std::vector<ChatLogIdx>{ChatLogIdx(1), ChatLogIdx(5)}));
+
+    // the longest token of the phrase narrows the search
+    candidates = index.candidates(QStringLiteral("running te"), FilterSearch::None);
+    QVERIFY(candidates);
+    QCOMPARE(*candidates, (std::vector<ChatLogIdx>{ChatLogIdx(5)}));
+
+    candidates = index.candidates(QStringLiteral("absent"), FilterSearch::WordsOnly);
+    QVERIFY(candidates);
+    QVERIFY(candidates->empty());
+
+    // new messages are found by the same query again
+    index.add(ChatLogIdx(7), QStringLiteral("absentee"));
+    candidates = index.candidates(QStringLiteral("absent"), FilterSearch::WordsOnly);
+    QVERIFY(candidates);
+    QCOMPARE(*candidates, (std::vector<ChatLogIdx>{ChatLogIdx(7)}));
+
+    QVERIFY(!index.candidates(QStringLiteral("!!"), FilterSearch::None));
+}
+
+void TestSessionSearchIndex::testAddTwice()
+{
+    SessionSearchIndex index;
+    index.add(ChatLogIdx(2), QStringLiteral("word word"));
+    index.add(ChatLogIdx(0), QStringLiteral("word"));
+    index.add(ChatLogIdx(2), QStringLiteral("word word"));
+
+    const auto* candidates = index.candidates(QStringLiteral("word"), FilterSearch::None);
+    QVERIFY(candidates);
+    QCOMPARE(*candidates, (std::vector<ChatLogIdx>{ChatLogIdx(0), ChatLogIdx(2)}));
+    QCOMPARE(index.tokenCount(), 1);
+}
+
+void TestSessionSearchIndex::testRegexFilter()
+{
+    SessionSearchIndex index;
+    index.add(ChatLogIdx(0), QStringLiteral("abc"));
+    QVERIFY(!index.candidates(QStringLiteral("a.c"), FilterSearch::Regular));
+    QVERIFY(!index.candidates(QStringLiteral("a.c"), FilterSearch::RegisterAndRegular));
+}
+
+QTEST_GUILESS_MAIN(TestSessionSearchIndex)
+#include "sessionsearchindex_test.moc"
@@ -0,0 +1,101 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "src/model/typingnotifier.h"
+
+#include <QTest>
+
+#include <memory>
+
+namespace {
+constexpr int idleMs = 300;
+constexpr int resendIntervalMs = 100;
+} // namespace
+
+class TestTypingNotifier : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testOnlyEdges();
+    void testIdle();
+    void testResendThrottled();
+    void testOffline();
+
+private:
+    std::unique_ptr<TypingNotifier> notifier;
+    QVector<bool> sent;
+};
+
+void TestTypingNotifier::init()
+{
+    notifier.reset(new TypingNotifier(idleMs, resendIntervalMs));
+    sent.clear();
+    connect(notifier.get(), &TypingNotifier::typingChanged, this,
+            [this](bool isTyping) { sent << isTyping; });
+    notifier->setFriendOnline(true);
+}
+
+void TestTypingNotifier::testOnlyEdges()
+{
+    for (int i = 0; i < 20; ++i) {
+        notifier->setComposing(true);
+    }
+    QCOMPARE(sent, QVector<bool>{true});
+
+    notifier->setComposing(false);
+    notifier->setComposing(false);
+    QCOMPARE(sent, (QVector<bool>{true, false}));
+}
+
+void TestTypingNotifier::testIdle()
+{
+    notifier->setComposing(true);
+    QTRY_COMPARE_WITH_TIMEOUT(sent, (QVector<bool>{true, false}), idleMs * 10);
+}
+
+void TestTypingNotifier::testResendThrottled()
+{
+    notifier->setComposing(true);
+    notifier->setComposing(false);
+    notifier->setComposing(true);
+    // typing again right after stopping waits for the resend interval
+    QCOMPARE(sent, (QVector<bool>{true, false}));
+
+    QTRY_COMPARE_WITH_TIMEOUT(sent, (QVector<bool>{true, false, true}), resendIntervalMs * 5);
+}
+
+void TestTypingNotifier::testOffline()
+{
+    notifier->setComposing(true);
+    notifier->setFriendOnline(false);
+    QCOMPARE(sent, (QVector<bool>{true, false}));
+
+    // nothing is sent to an offline friend
+    notifier->setComposing(false);
+    QTest::qWait(resendIntervalMs);
+    notifier->setComposing(true);
+    QTest::qWait(idleMs * 2);
+    QCOMPARE(sent, (QVector<bool>{true, false}));
+}
+
+QTEST_GUILESS_MAIN(TestTypingNotifier)
+#include "typingnotifier_test.moc"
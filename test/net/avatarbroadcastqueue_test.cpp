@@ -0,0 +1,136 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/net/avatarbroadcastqueue.h"
+
+#include <QtTest/QtTest>
+
+class TestAvatarBroadcastQueue : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testConcurrencyCap();
+    void testDeliveredSkipped();
+    void testFailedRetried();
+    void testNewAvatarWaitsForOld();
+    void testNoDuplicates();
+    void testRemoveFriend();
+};
+
+void TestAvatarBroadcastQueue::testConcurrencyCap()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    const uint32_t friends = AvatarBroadcastQueue::MAX_CONCURRENT_SENDS + 2;
+    for (uint32_t friendId = 0; friendId < friends; ++friendId) {
+        QVERIFY(queue.enqueue(friendId));
+    }
+
+    uint32_t friendId;
+    for (uint32_t expected = 0; expected < AvatarBroadcastQueue::MAX_CONCURRENT_SENDS; ++expected) {
+        QVERIFY(queue.takeNext(friendId));
+        QCOMPARE(friendId, expected);
+    }
+    QVERIFY(!queue.takeNext(friendId));
+    QCOMPARE(queue.sendingCount(), AvatarBroadcastQueue::MAX_CONCURRENT_SENDS);
+
+    queue.finished(1, true);
+    QVERIFY(queue.takeNext(friendId));
+    QCOMPARE(friendId, static_cast<uint32_t>(AvatarBroadcastQueue::MAX_CONCURRENT_SENDS));
+    QVERIFY(!queue.takeNext(friendId));
+}
+
+void TestAvatarBroadcastQueue::testDeliveredSkipped()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    uint32_t friendId;
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(queue.takeNext(friendId));
+    queue.finished(friendId, true);
+
+    QVERIFY(!queue.enqueue(7));
+
+    queue.setAvatarHash("b");
+    QVERIFY(queue.enqueue(7));
+}
+
+void TestAvatarBroadcastQueue::testFailedRetried()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    uint32_t friendId;
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(queue.takeNext(friendId));
+    queue.finished(friendId, false);
+
+    QCOMPARE(queue.sendingCount(), 0);
+    QVERIFY(queue.enqueue(7));
+}
+
+void TestAvatarBroadcastQueue::testNewAvatarWaitsForOld()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    uint32_t friendId;
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(queue.takeNext(friendId));
+
+    queue.setAvatarHash("b");
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(queue.enqueue(8));
+    QVERIFY(queue.takeNext(friendId));
+    QCOMPARE(friendId, 8u);
+    QVERIFY(!queue.takeNext(friendId));
+
+    queue.finished(7, true);
+    QVERIFY(queue.takeNext(friendId));
+    QCOMPARE(friendId, 7u);
+}
+
+void TestAvatarBroadcastQueue::testNoDuplicates()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(!queue.enqueue(7));
+    QCOMPARE(queue.pendingCount(), 1);
+
+    uint32_t friendId;
+    QVERIFY(queue.takeNext(friendId));
+    QVERIFY(!queue.enqueue(7));
+    QCOMPARE(queue.pendingCount(), 0);
+}
+
+void TestAvatarBroadcastQueue::testRemoveFriend()
+{
+    AvatarBroadcastQueue queue;
+    queue.setAvatarHash("a");
+    uint32_t friendId;
+    QVERIFY(queue.enqueue(7));
+    QVERIFY(queue.takeNext(friendId));
+    queue.finished(friendId, true);
+
+    queue.removeFriend(7);
+    QVERIFY(queue.enqueue(7));
+}
+
+QTEST_GUILESS_MAIN(TestAvatarBroadcastQueue)
+#include "avatarbroadcastqueue_test.moc"
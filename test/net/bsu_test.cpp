@@ -22,6 +22,7 @@
 
 #include <QNetworkProxy>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 
 #include <QtTest/QtTest>
 
@@ -36,6 +37,9 @@ public:
 private slots:
     void testOnline();
     void testLocal();
+    void testCache();
+    void testStaleCache();
+    void testCorruptCache();
 };
 
 TestBootstrapNodesUpdater::TestBootstrapNodesUpdater()
@@ -67,5 +71,62 @@ void TestBootstrapNodesUpdater::testLocal()
     QVERIFY(defaultNodes.size() > 0);
 }
 
+void TestBootstrapNodesUpdater::testCache()
+{
+    QTemporaryDir dir;
+    const QString source = dir.filePath("nodes.json");
+    const QString cache = dir.filePath("nodes.cache");
+    QVERIFY(QFile::copy(":/conf/nodes.json", source));
+
+    const QList<DhtServer> defaultNodes = BootstrapNodeUpdater::loadDefaultBootstrapNodes();
+    QVERIFY(BootstrapNodeUpdater::writeNodeCache(cache, source, defaultNodes));
+
+    QList<DhtServer> cached;
+    QVERIFY(BootstrapNodeUpdater::readNodeCache(cache, source, cached));
+    QCOMPARE(cached, defaultNodes);
+}
+
+void TestBootstrapNodesUpdater::testStaleCache()
+{
+    QTemporaryDir dir;
+    const QString source = dir.filePath("nodes.json");
+    const QString cache = dir.filePath("nodes.cache");
+    QVERIFY(QFile::copy(":/conf/nodes.json", source));
+
+    const QList<DhtServer> defaultNodes = BootstrapNodeUpdater::loadDefaultBootstrapNodes();
+    QVERIFY(BootstrapNodeUpdater::writeNodeCache(cache, source, defaultNodes));
+
+    QList<DhtServer> cached;
+    QVERIFY(!BootstrapNodeUpdater::readNodeCache(cache, dir.filePath("other.json"), cached));
+
+    QFile sourceFile{source};
+    QVERIFY(sourceFile.setPermissions(sourceFile.permissions() | QFileDevice::WriteOwner));
+    QVERIFY(sourceFile.open(QIODevice::Append));
+    sourceFile.write("\n");
+    sourceFile.close();
+    QVERIFY(!BootstrapNodeUpdater::readNodeCache(cache, source, cached));
+    QVERIFY(cached.isEmpty());
+}
+
+void TestBootstrapNodesUpdater::testCorruptCache()
+{
+    QTemporaryDir dir;
+    const QString source = dir.filePath("nodes.json");
+    const QString cache = dir.filePath("nodes.cache");
+    QVERIFY(QFile::copy(":/conf/nodes.json", source));
+
+    const QList<DhtServer> defaultNodes = BootstrapNodeUpdater::loadDefaultBootstrapNodes();
+    QVERIFY(BootstrapNodeUpdater::writeNodeCache(cache, source, defaultNodes));
+
+    QFile cacheFile{cache};
+    QVERIFY(cacheFile.open(QIODevice::ReadWrite));
+    QVERIFY(cacheFile.resize(cacheFile.size() / 2));
+    cacheFile.close();
+
+    QList<DhtServer> cached;
+    QVERIFY(!BootstrapNodeUpdater::readNodeCache(cache, source, cached));
+    QVERIFY(cached.isEmpty());
+}
+
 QTEST_GUILESS_MAIN(TestBootstrapNodesUpdater)
 #include "bsu_test.moc"
@@ -0,0 +1,163 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "src/persistence/blobstore.h"
+#include "src/core/toxencrypt.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+namespace {
+const QByteArray testImage = QByteArray("\x89PNG\r\n\x1a\n", 8) + QByteArray(1000, 'x');
+} // namespace
+
+class TestBlobStore : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testRoundTrip();
+    void testDeduplication();
+    void testReference();
+    void testEncrypted();
+    void testChangePasskey();
+    void testRename();
+    void testThumbnails();
+
+private:
+    std::unique_ptr<QTemporaryDir> tempDir;
+    QString blobDir;
+};
+
+void TestBlobStore::init()
+{
+    tempDir.reset(new QTemporaryDir());
+    QVERIFY(tempDir->isValid());
+    blobDir = tempDir->filePath("test.blobs");
+}
+
+void TestBlobStore::testRoundTrip()
+{
+    BlobStore store{blobDir, nullptr};
+    const QString reference = store.put(testImage);
+    QVERIFY(!reference.isEmpty());
+    QCOMPARE(store.get(reference), testImage);
+}
+
+void TestBlobStore::testDeduplication()
+{
+    BlobStore store{blobDir, nullptr};
+    const QString first = store.put(testImage);
+    const QString second = store.put(testImage);
+    QCOMPARE(first, second);
+    QCOMPARE(QDir(blobDir).entryList(QDir::Files).size(), 1);
+
+    QVERIFY(store.put(testImage + "y") != first);
+    QCOMPARE(QDir(blobDir).entryList(QDir::Files).size(), 2);
+}
+
+void TestBlobStore::testReference()
+{
+    BlobStore store{blobDir, nullptr};
+    const QString reference = store.put(testImage);
+    QVERIFY(BlobStore::isReference(reference));
+
+    // inline hex images and ngc message ids are not references
+    QVERIFY(!BlobStore::isReference(QString::fromUtf8(testImage.toHex()).toUpper()));
+    QVERIFY(!BlobStore::isReference(QStringLiteral("0A1B2C3D")));
+    QVERIFY(store.get(QStringLiteral("0A1B2C3D")).isEmpty());
+}
+
+void TestBlobStore::testEncrypted()
+{
+    auto passkey = ToxEncrypt::makeToxEncrypt(QStringLiteral("password"));
+    QVERIFY(passkey);
+
+    BlobStore store{blobDir, passkey.get()};
+    const QString reference = store.put(testImage);
+    QCOMPARE(store.get(reference), testImage);
+
+    const QStringList files = QDir(blobDir).entryList(QDir::Files);
+    QCOMPARE(files.size(), 1);
+    QFile file{QDir(blobDir).filePath(files.first())};
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(ToxEncrypt::isEncrypted(file.readAll()));
+
+    BlobStore noKey{blobDir, nullptr};
+    QVERIFY(noKey.get(reference).isEmpty());
+}
+
+void TestBlobStore::testChangePasskey()
+{
+    BlobStore store{blobDir, nullptr};
+    const QString reference = store.put(testImage);
+
+    auto passkey = ToxEncrypt::makeToxEncrypt(QStringLiteral("password"));
+    QVERIFY(passkey);
+    QVERIFY(store.setPasskey(passkey.get()));
+    QCOMPARE(store.get(reference), testImage);
+
+    BlobStore noKey{blobDir, nullptr};
+    QVERIFY(noKey.get(reference).isEmpty());
+
+    QVERIFY(store.setPasskey(nullptr));
+    QCOMPARE(noKey.get(reference), testImage);
+}
+
+void TestBlobStore::testRename()
+{
+    BlobStore store{blobDir, nullptr};
+    const QString reference = store.put(testImage);
+
+    const QString newDir = tempDir->filePath("renamed.blobs");
+    QVERIFY(store.rename(newDir));
+    QVERIFY(!QDir(blobDir).exists());
+    QCOMPARE(store.get(reference), testImage);
+
+    QVERIFY(store.remove());
+    QVERIFY(!QDir(newDir).exists());
+}
+
+void TestBlobStore::testThumbnails()
+{
+    auto passkey = ToxEncrypt::makeToxEncrypt(QStringLiteral("password"));
+    QVERIFY(passkey);
+
+    BlobStore store{blobDir, passkey.get()};
+    const QString reference = store.put(testImage);
+    QVERIFY(store.getThumbnail(QStringLiteral("thumb")).isEmpty());
+    QVERIFY(store.putThumbnail(QStringLiteral("thumb"), testImage));
+    QCOMPARE(store.getThumbnail(QStringLiteral("thumb")), testImage);
+
+    // thumbnails don't count as blobs
+    QCOMPARE(QDir(blobDir).entryList(QDir::Files).size(), 1);
+
+    // thumbnails are dropped instead of being re-encrypted
+    QVERIFY(store.setPasskey(nullptr));
+    QVERIFY(store.getThumbnail(QStringLiteral("thumb")).isEmpty());
+    QCOMPARE(store.get(reference), testImage);
+}
+
+QTEST_GUILESS_MAIN(TestBlobStore)
+#include "blobstore_test.moc"
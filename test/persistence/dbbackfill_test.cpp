@@ -0,0 +1,178 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/persistence/db/dbbackfill.h"
+#include "src/persistence/db/rawdatabase.h"
+
+#include <QTemporaryFile>
+#include <QTest>
+
+#include <memory>
+
+namespace {
+constexpr qint64 MS_PER_DAY = 86400000;
+
+int64_t queryInt(RawDatabase& db, const QString& query)
+{
+    int64_t value = -1;
+    db.execNow(RawDatabase::Query{query, [&value](const QVector<QVariant>& row) {
+                                      value = row[0].toLongLong();
+                                  }});
+    return value;
+}
+} // namespace
+
+class TestDbBackfill : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void cleanup();
+    void testScheduleEmpty();
+    void testDayCounts();
+    void testResume();
+    void testNotPendingCondition();
+
+private:
+    void addMessage(int id, int chatId, qint64 timestamp);
+
+    std::unique_ptr<QTemporaryFile> testDatabaseFile;
+    std::shared_ptr<RawDatabase> db;
+};
+
+void TestDbBackfill::init()
+{
+    testDatabaseFile = std::unique_ptr<QTemporaryFile>(new QTemporaryFile());
+    // fileName is only defined once the file is opened. Since RawDatabase
+    // will be openening the file itself not using QFile, open and close it now.
+    QVERIFY(testDatabaseFile->open());
+    testDatabaseFile->close();
+
+    db = std::shared_ptr<RawDatabase>{new RawDatabase{testDatabaseFile->fileName(), {}, {}}};
+    QVERIFY(db->execNow(
+        "CREATE TABLE chats (id INTEGER PRIMARY KEY, uuid BLOB NOT NULL UNIQUE);"
+        "CREATE TABLE history (id INTEGER PRIMARY KEY, timestamp INTEGER NOT NULL, "
+        "chat_id INTEGER NOT NULL);"
+        "CREATE TABLE chat_day_counts (chat_id INTEGER NOT NULL, day INTEGER NOT NULL, "
+        "count INTEGER NOT NULL, first_id INTEGER NOT NULL DEFAULT 0, "
+        "PRIMARY KEY (chat_id, day)) WITHOUT ROWID;"));
+}
+
+void TestDbBackfill::cleanup()
+{
+    db.reset();
+    testDatabaseFile.reset();
+}
+
+void TestDbBackfill::addMessage(int id, int chatId, qint64 timestamp)
+{
+    QVERIFY(db->execNow(QStringLiteral("INSERT OR IGNORE INTO chats (id, uuid) VALUES (%1, '%1');"
+                                       "INSERT INTO history (id, timestamp, chat_id) "
+                                       "VALUES (%2, %3, %1);")
+                            .arg(chatId)
+                            .arg(id)
+                            .arg(timestamp)));
+}
+
+void TestDbBackfill::testScheduleEmpty()
+{
+    QVERIFY(db->execNow(DbBackfill::schedule(DbBackfill::Task::DayCounts)));
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT COUNT(*) FROM db_backfills;")), 0);
+
+    DbBackfill backfill{db};
+    QVERIFY(!backfill.isPending(DbBackfill::Task::DayCounts));
+}
+
+void TestDbBackfill::testDayCounts()
+{
+    addMessage(1, 1, 0);
+    addMessage(2, 1, 10);
+    addMessage(3, 1, MS_PER_DAY + 5);
+    addMessage(4, 2, 3 * MS_PER_DAY);
+    QVERIFY(db->execNow(DbBackfill::schedule(DbBackfill::Task::DayCounts)));
+    // counted partially by the triggers meanwhile
+    QVERIFY(db->execNow("INSERT INTO chat_day_counts (chat_id, day, count, first_id) "
+                        "VALUES (1, 0, 1, 2);"));
+
+    DbBackfill backfill{db};
+    QVERIFY(backfill.isPending(DbBackfill::Task::DayCounts));
+    backfill.start();
+    QTRY_VERIFY(!backfill.isPending(DbBackfill::Task::DayCounts));
+
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT count FROM chat_day_counts "
+                                          "WHERE chat_id = 1 AND day = 0;")),
+             2);
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT first_id FROM chat_day_counts "
+                                          "WHERE chat_id = 1 AND day = 0;")),
+             1);
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT count FROM chat_day_counts "
+                                          "WHERE chat_id = 1 AND day = 1;")),
+             1);
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT first_id FROM chat_day_counts "
+                                          "WHERE chat_id = 2 AND day = 3;")),
+             4);
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT COUNT(*) FROM db_backfills;")), 0);
+}
+
+void TestDbBackfill::testResume()
+{
+    addMessage(1, 1, 0);
+    addMessage(2, 2, 0);
+    QVERIFY(db->execNow(DbBackfill::schedule(DbBackfill::Task::DayCounts)));
+    // chat 1 was counted before the last shutdown
+    QVERIFY(db->execNow("UPDATE db_backfills SET position = 1;"
+                        "INSERT INTO chat_day_counts (chat_id, day, count, first_id) "
+                        "VALUES (1, 0, 7, 1);"));
+
+    DbBackfill backfill{db};
+    backfill.start();
+    QTRY_VERIFY(!backfill.isPending(DbBackfill::Task::DayCounts));
+
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT count FROM chat_day_counts "
+                                          "WHERE chat_id = 1;")),
+             7);
+    QCOMPARE(queryInt(*db, QStringLiteral("SELECT count FROM chat_day_counts "
+                                          "WHERE chat_id = 2;")),
+             1);
+}
+
+void TestDbBackfill::testNotPendingCondition()
+{
+    addMessage(1, 1, 0);
+    addMessage(2, 2, 0);
+    addMessage(3, 3, 0);
+    QVERIFY(db->execNow(DbBackfill::schedule(DbBackfill::Task::DayCounts)));
+    QVERIFY(db->execNow("UPDATE db_backfills SET position = 1;"));
+
+    const auto condition = [](int id) {
+        return QStringLiteral("SELECT %1;")
+            .arg(DbBackfill::notPendingCondition(DbBackfill::Task::DayCounts,
+                                                 QString::number(id)));
+    };
+    QCOMPARE(queryInt(*db, condition(1)), 1);
+    QCOMPARE(queryInt(*db, condition(2)), 0);
+    QCOMPARE(queryInt(*db, condition(3)), 0);
+    QCOMPARE(queryInt(*db, condition(4)), 1);
+
+    QVERIFY(db->execNow("DELETE FROM db_backfills;"));
+    QCOMPARE(queryInt(*db, condition(2)), 1);
+}
+
+QTEST_GUILESS_MAIN(TestDbBackfill)
+#include "dbbackfill_test.moc"
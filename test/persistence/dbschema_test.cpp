@@ -139,6 +139,7 @@ private slots:
     void test9to10();
     // test10to11 handled in dbTo11_test
     // test suite
+    void testTypedRow();
 
 private:
     std::unique_ptr<QTemporaryFile> testDatabaseFile;
@@ -422,5 +423,37 @@ void TestDbSchema::test9to10()
     verifyDb(db, DbUtility::schema10);
 }
 
+void TestDbSchema::testTypedRow()
+{
+    auto db = std::shared_ptr<RawDatabase>{new RawDatabase{testDatabaseFile->fileName(), {}, {}}};
+    const QByteArray blob{"a\0b", 3};
+    QVERIFY(db->execNow(RawDatabase::Query{
+        QStringLiteral("CREATE TABLE typed (number INTEGER, text TEXT, data BLOB, empty INTEGER); "
+                       "INSERT INTO typed VALUES (42, 'text', ?, NULL);"),
+        {blob}}));
+
+    int rows = 0;
+    QVERIFY(db->execNow(RawDatabase::Query{
+        QStringLiteral("SELECT number, text, data, empty FROM typed;"),
+        [&](const RawDatabase::Row& row) {
+            ++rows;
+            QCOMPARE(row.size(), 4);
+            int64_t number = 0;
+            QString text;
+            QByteArray data;
+            row.read(0, number, text, data);
+            QCOMPARE(number, int64_t{42});
+            QVERIFY(row.get<RowId>(0) == RowId{42});
+            QCOMPARE(text, QStringLiteral("text"));
+            QCOMPARE(data, blob);
+            QCOMPARE(row.getRawBlob(2), blob);
+            QVERIFY(!row.isNull(0));
+            QVERIFY(row.isNull(3));
+            QCOMPARE(row.get<int64_t>(3), int64_t{0});
+            QVERIFY(row.get<QString>(3).isEmpty());
+        }}));
+    QCOMPARE(rows, 1);
+}
+
 QTEST_GUILESS_MAIN(TestDbSchema)
 #include "dbschema_test.moc"
@@ -35,10 +35,21 @@ private slots:
     void testTypeCoordination();
     void testCallback();
     void testExtendedMessageCoordination();
+    void testUnorderedReceipts();
+    void testResendBatches();
+    void testResendBackoff();
+    void testResendKeepsOrder();
 };
 
 namespace {
 void completionFn(bool success) { std::ignore = success; }
+
+Message makeMessage(const QString& content)
+{
+    auto msg = Message();
+    msg.content = content;
+    return msg;
+}
 } // namespace
 
 void TestOfflineMsgEngine::testReceiptBeforeMessage()
@@ -185,5 +196,123 @@ void TestOfflineMsgEngine::testExtendedMessageCoordination()
     QVERIFY(numCallbacks == 3);
 }
 
+void TestOfflineMsgEngine::testUnorderedReceipts()
+{
+    OfflineMsgEngine offlineMsgEngine;
+
+    size_t numCallbacks = 0;
+    auto callback = [&numCallbacks] (bool) { numCallbacks++; };
+
+    offlineMsgEngine.addSentCoreMessage(ReceiptNum(5), makeMessage("msg5"), callback);
+    offlineMsgEngine.addSentCoreMessage(ReceiptNum(3), makeMessage("msg3"), callback);
+    offlineMsgEngine.addSentCoreMessage(ReceiptNum(4), makeMessage("msg4"), callback);
+
+    offlineMsgEngine.onReceiptReceived(ReceiptNum(4));
+    QVERIFY(numCallbacks == 1);
+    offlineMsgEngine.onReceiptReceived(ReceiptNum(6));
+    QVERIFY(numCallbacks == 1);
+
+    const auto messagesToResend = offlineMsgEngine.removeAllMessages();
+    QVERIFY(messagesToResend.size() == 2);
+    for (const auto& message : messagesToResend) {
+        QVERIFY(message.message.content == "msg3" || message.message.content == "msg5");
+    }
+}
+
+void TestOfflineMsgEngine::testResendBatches()
+{
+    OfflineMsgEngine offlineMsgEngine;
+
+    const size_t numMessages = OfflineMsgEngine::RESEND_BATCH_SIZE * 2 + 5;
+    for (size_t i = 0; i < numMessages; ++i) {
+        offlineMsgEngine.addUnsentMessage(makeMessage(QString::number(i)), completionFn);
+    }
+
+    auto now = OfflineMsgEngine::Clock::now();
+    offlineMsgEngine.scheduleResend(now);
+    QVERIFY(offlineMsgEngine.msUntilNextResend(now) == 0);
+
+    size_t nextContent = 0;
+    while (offlineMsgEngine.hasPendingResends()) {
+        const auto batch = offlineMsgEngine.takeResendBatch(now);
+        QVERIFY(!batch.empty());
+        QVERIFY(batch.size() <= OfflineMsgEngine::RESEND_BATCH_SIZE);
+        for (const auto& message : batch) {
+            QVERIFY(message.message.content == QString::number(nextContent++));
+        }
+        offlineMsgEngine.completeResendBatch(batch.size(), now);
+
+        // the next batch waits for the interval
+        if (offlineMsgEngine.hasPendingResends()) {
+            QVERIFY(offlineMsgEngine.takeResendBatch(now).empty());
+            QVERIFY(offlineMsgEngine.msUntilNextResend(now) > 0);
+            QVERIFY(offlineMsgEngine.msUntilNextResend(now) <= OfflineMsgEngine::RESEND_INTERVAL_MS + 1);
+        }
+        now += std::chrono::milliseconds(OfflineMsgEngine::RESEND_INTERVAL_MS);
+    }
+
+    QVERIFY(nextContent == numMessages);
+    QVERIFY(offlineMsgEngine.msUntilNextResend(now) == -1);
+}
+
+void TestOfflineMsgEngine::testResendBackoff()
+{
+    OfflineMsgEngine offlineMsgEngine;
+
+    offlineMsgEngine.addUnsentMessage(makeMessage("msg1"), completionFn);
+    offlineMsgEngine.addUnsentMessage(makeMessage("msg2"), completionFn);
+    offlineMsgEngine.addUnsentMessage(makeMessage("msg3"), completionFn);
+
+    auto now = OfflineMsgEngine::Clock::now();
+    offlineMsgEngine.scheduleResend(now);
+    auto batch = offlineMsgEngine.takeResendBatch(now);
+    QVERIFY(batch.size() == 3);
+
+    // toxcore only took the first message
+    offlineMsgEngine.completeResendBatch(1, now);
+    auto backoff = std::chrono::milliseconds(OfflineMsgEngine::RESEND_BACKOFF_MIN_MS);
+    QVERIFY(offlineMsgEngine.takeResendBatch(now + backoff - std::chrono::milliseconds(1)).empty());
+
+    now += backoff;
+    batch = offlineMsgEngine.takeResendBatch(now);
+    QVERIFY(batch.size() == 2);
+    QVERIFY(batch[0].message.content == "msg2");
+    QVERIFY(batch[1].message.content == "msg3");
+
+    // refused again, the wait doubles
+    offlineMsgEngine.completeResendBatch(0, now);
+    backoff *= 2;
+    QVERIFY(offlineMsgEngine.takeResendBatch(now + backoff - std::chrono::milliseconds(1)).empty());
+
+    now += backoff;
+    batch = offlineMsgEngine.takeResendBatch(now);
+    QVERIFY(batch.size() == 2);
+    QVERIFY(batch[0].message.content == "msg2");
+    offlineMsgEngine.completeResendBatch(batch.size(), now);
+    QVERIFY(!offlineMsgEngine.hasPendingResends());
+}
+
+void TestOfflineMsgEngine::testResendKeepsOrder()
+{
+    OfflineMsgEngine offlineMsgEngine;
+
+    offlineMsgEngine.addUnsentMessage(makeMessage("msg1"), completionFn);
+    offlineMsgEngine.addSentCoreMessage(ReceiptNum(1), makeMessage("msg2"), completionFn);
+
+    const auto now = OfflineMsgEngine::Clock::now();
+    offlineMsgEngine.scheduleResend(now);
+    QVERIFY(offlineMsgEngine.hasPendingResends());
+
+    // written while the others still wait, so it goes last
+    offlineMsgEngine.addResend(makeMessage("msg3"), completionFn);
+
+    auto const messagesToResend = offlineMsgEngine.removeAllMessages();
+    QVERIFY(messagesToResend.size() == 3);
+    QVERIFY(messagesToResend[0].message.content == "msg1");
+    QVERIFY(messagesToResend[1].message.content == "msg2");
+    QVERIFY(messagesToResend[2].message.content == "msg3");
+    QVERIFY(!offlineMsgEngine.hasPendingResends());
+}
+
 QTEST_GUILESS_MAIN(TestOfflineMsgEngine)
 #include "offlinemsgengine_test.moc"
@@ -0,0 +1,194 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/persistence/settingsserializer.h"
+#include "src/persistence/serialize.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+namespace {
+const int testFriends = 2000;
+
+/**
+ * @brief Appends a length prefixed field, like SettingsSerializer stores strings.
+ */
+void appendField(QByteArray& data, const QByteArray& field)
+{
+    data += vintToData(field.size());
+    data += field;
+}
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    QCOMPARE(f.write(data), static_cast<qint64>(data.size()));
+}
+
+void writeFriends(SettingsSerializer& ps)
+{
+    ps.beginGroup("Friends");
+    ps.beginWriteArray("Friend", testFriends);
+    for (int i = 0; i < testFriends; ++i) {
+        ps.setArrayIndex(i);
+        ps.setValue("addr", QString::number(i));
+        ps.setValue("alias", QString("friend %1").arg(i));
+    }
+    ps.endArray();
+    ps.setValue("count", testFriends);
+    ps.endGroup();
+}
+} // namespace
+
+class TestSettingsSerializer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testRoundTrip();
+    void testValueOutsideArray();
+    void testReadTaggedFormat();
+    void testCorruptedFile();
+
+private:
+    std::unique_ptr<QTemporaryDir> tempDir;
+    QString path;
+};
+
+void TestSettingsSerializer::init()
+{
+    tempDir.reset(new QTemporaryDir());
+    QVERIFY(tempDir->isValid());
+    path = tempDir->filePath("test.ini");
+}
+
+void TestSettingsSerializer::testRoundTrip()
+{
+    {
+        SettingsSerializer ps{path};
+        writeFriends(ps);
+        ps.beginGroup("Privacy");
+        ps.setValue("typingNotification", true);
+        ps.endGroup();
+        ps.save();
+    }
+
+    QVERIFY(SettingsSerializer::isSerializedFormat(path));
+    SettingsSerializer ps{path};
+    ps.load();
+
+    ps.beginGroup("Friends");
+    QCOMPARE(ps.beginReadArray("Friend"), testFriends);
+    for (int i = 0; i < testFriends; ++i) {
+        ps.setArrayIndex(i);
+        QCOMPARE(ps.value("addr").toString(), QString::number(i));
+        QCOMPARE(ps.value("alias").toString(), QString("friend %1").arg(i));
+    }
+    ps.endArray();
+    QCOMPARE(ps.value("count").toInt(), testFriends);
+    ps.endGroup();
+
+    ps.beginGroup("Privacy");
+    QVERIFY(ps.value("typingNotification").toBool());
+    QVERIFY(!ps.value("missing").isValid());
+    ps.endGroup();
+}
+
+void TestSettingsSerializer::testValueOutsideArray()
+{
+    SettingsSerializer ps{path};
+    ps.beginGroup("Friends");
+    ps.beginWriteArray("Friend", 1);
+    ps.setArrayIndex(0);
+    ps.setValue("addr", "a");
+    ps.endArray();
+
+    // the array index stays set, but doesn't apply outside of the array
+    ps.setValue("count", 1);
+    ps.setArrayIndex(5);
+    QCOMPARE(ps.value("count").toInt(), 1);
+    QVERIFY(!ps.value("addr").isValid());
+}
+
+void TestSettingsSerializer::testReadTaggedFormat()
+{
+    QByteArray data("QTOX", 4);
+    data += static_cast<char>(SettingsSerializer::RecordTag::GroupStart);
+    appendField(data, "Friends");
+    data += static_cast<char>(SettingsSerializer::RecordTag::ArrayStart);
+    appendField(data, "Friend");
+    appendField(data, vintToData(2));
+    for (int i = 0; i < 2; ++i) {
+        data += static_cast<char>(SettingsSerializer::RecordTag::ArrayValue);
+        appendField(data, vintToData(i));
+        appendField(data, "addr");
+        appendField(data, QByteArray::number(i));
+    }
+    data += static_cast<char>(SettingsSerializer::RecordTag::ArrayEnd);
+    data += static_cast<char>(SettingsSerializer::RecordTag::Value);
+    appendField(data, "count");
+    appendField(data, "2");
+    writeFile(path, data);
+
+    SettingsSerializer ps{path};
+    ps.load();
+    ps.beginGroup("Friends");
+    QCOMPARE(ps.beginReadArray("Friend"), 2);
+    ps.setArrayIndex(1);
+    QCOMPARE(ps.value("addr").toString(), QStringLiteral("1"));
+    ps.endArray();
+    QCOMPARE(ps.value("count").toInt(), 2);
+    ps.endGroup();
+
+    // saving converts to the indexed format
+    ps.save();
+    SettingsSerializer converted{path};
+    converted.load();
+    converted.beginGroup("Friends");
+    QCOMPARE(converted.beginReadArray("Friend"), 2);
+    converted.setArrayIndex(0);
+    QCOMPARE(converted.value("addr").toString(), QStringLiteral("0"));
+}
+
+void TestSettingsSerializer::testCorruptedFile()
+{
+    {
+        SettingsSerializer ps{path};
+        writeFriends(ps);
+        ps.save();
+    }
+
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray data = f.readAll();
+    f.close();
+    writeFile(path, data.left(data.size() / 2));
+
+    SettingsSerializer ps{path};
+    ps.load();
+    ps.beginGroup("Friends");
+    QCOMPARE(ps.beginReadArray("Friend"), 0);
+}
+
+QTEST_GUILESS_MAIN(TestSettingsSerializer)
+#include "settingsserializer_test.moc"
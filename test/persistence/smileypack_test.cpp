@@ -53,6 +53,7 @@ private slots:
     void testSmilifySingleCharEmoji();
     void testSmilifyMultiCharEmoji();
     void testSmilifyAsciiEmoticon();
+    void testLazyPixmaps();
 private:
     std::unique_ptr<QGuiApplication> app;
     std::unique_ptr<MockSettings> settings;
@@ -127,6 +128,33 @@ void TestSmileyPack::testSmilifyAsciiEmoticon()
     QVERIFY(result == "  " + SmileyPack::getAsRichText(":-)") + "  ");
 }
 
+/**
+ * @brief Test that icons are only rendered when asked for, once per size
+ */
+void TestSmileyPack::testLazyPixmaps()
+{
+    SmileyPack smileyPack{*settings};
+    QVERIFY(!smileyPack.getEmoticons().isEmpty());
+    QCOMPARE(smileyPack.getCacheUsage().entries, 0);
+
+    const QSize size(16, 16);
+    const QPixmap pixmap = smileyPack.getAsPixmap("😊", size);
+    QVERIFY(!pixmap.isNull());
+    QVERIFY(pixmap.width() <= size.width() * pixmap.devicePixelRatio());
+    QVERIFY(pixmap.height() <= size.height() * pixmap.devicePixelRatio());
+    QCOMPARE(smileyPack.getCacheUsage().entries, 1);
+
+    smileyPack.getAsPixmap("😊", size);
+    QCOMPARE(smileyPack.getCacheUsage().entries, 1);
+    smileyPack.getAsPixmap("😊", QSize(32, 32));
+    QCOMPARE(smileyPack.getCacheUsage().entries, 2);
+
+    QVERIFY(smileyPack.getAsPixmap("not an emoticon", size).isNull());
+    QCOMPARE(smileyPack.getCacheUsage().entries, 2);
+
+    smileyPack.trimCache(0);
+    QCOMPARE(smileyPack.getCacheUsage().entries, 0);
+}
 
 QTEST_GUILESS_MAIN(TestSmileyPack)
 #include "smileypack_test.moc"
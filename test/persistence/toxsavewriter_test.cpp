@@ -0,0 +1,139 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/persistence/toxsavewriter.h"
+#include "src/core/toxencrypt.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+namespace {
+QByteArray readFile(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return file.readAll();
+}
+} // namespace
+
+class TestToxSaveWriter : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testCoalesce();
+    void testDelayedSave();
+    void testFlushWithoutRequest();
+    void testEncrypted();
+    void testSetPath();
+    void testEmptySnapshot();
+
+private:
+    std::unique_ptr<QTemporaryDir> tempDir;
+    QString savePath;
+    QByteArray state;
+    int snapshots = 0;
+    std::unique_ptr<ToxSaveWriter> writer;
+};
+
+void TestToxSaveWriter::init()
+{
+    tempDir.reset(new QTemporaryDir());
+    QVERIFY(tempDir->isValid());
+    savePath = tempDir->filePath("test.tox");
+    state = QByteArray("save");
+    snapshots = 0;
+    writer.reset(new ToxSaveWriter(savePath, [this] {
+        ++snapshots;
+        return state;
+    }));
+}
+
+void TestToxSaveWriter::testCoalesce()
+{
+    for (int i = 0; i < 10; ++i) {
+        state = QByteArray::number(i);
+        writer->requestSave();
+    }
+
+    QVERIFY(writer->flush());
+    QCOMPARE(snapshots, 1);
+    QCOMPARE(writer->getWriteCount(), 1);
+    QCOMPARE(readFile(savePath), QByteArray("9"));
+}
+
+void TestToxSaveWriter::testDelayedSave()
+{
+    writer->requestSave();
+    QCOMPARE(snapshots, 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(writer->getWriteCount(), 1, ToxSaveWriter::SAVE_DELAY_MS * 10);
+    QCOMPARE(snapshots, 1);
+    QCOMPARE(readFile(savePath), state);
+}
+
+void TestToxSaveWriter::testFlushWithoutRequest()
+{
+    QVERIFY(writer->flush());
+    QCOMPARE(snapshots, 0);
+    QVERIFY(!QFile::exists(savePath));
+}
+
+void TestToxSaveWriter::testEncrypted()
+{
+    std::shared_ptr<const ToxEncrypt> passkey =
+        ToxEncrypt::makeToxEncrypt(QStringLiteral("password"));
+    QVERIFY(passkey);
+    writer->setPasskey(passkey);
+
+    writer->requestSave();
+    QVERIFY(writer->flush());
+
+    const QByteArray written = readFile(savePath);
+    QVERIFY(ToxEncrypt::isEncrypted(written));
+    QCOMPARE(passkey->decrypt(written), state);
+}
+
+void TestToxSaveWriter::testSetPath()
+{
+    const QString newPath = tempDir->filePath("renamed.tox");
+    writer->setPath(newPath);
+
+    writer->requestSave();
+    QVERIFY(writer->flush());
+    QVERIFY(!QFile::exists(savePath));
+    QCOMPARE(readFile(newPath), state);
+}
+
+void TestToxSaveWriter::testEmptySnapshot()
+{
+    state.clear();
+    writer->requestSave();
+    QVERIFY(writer->flush());
+    QCOMPARE(writer->getWriteCount(), 0);
+    QVERIFY(!QFile::exists(savePath));
+}
+
+QTEST_GUILESS_MAIN(TestToxSaveWriter)
+#include "toxsavewriter_test.moc"
@@ -0,0 +1,115 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/asynclogger.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <cstdio>
+
+namespace {
+Q_LOGGING_CATEGORY(testLog, "qtox.test.logger")
+} // namespace
+
+class TestAsyncLogger : public QObject
+{
+    Q_OBJECT
+private slots:
+    void cleanup();
+    void testLogLevels();
+    void testWildcardLevels();
+    void testInvalidLevels();
+    void testBufferedUntilLogFile();
+
+private:
+    QTemporaryDir dir;
+};
+
+void TestAsyncLogger::cleanup()
+{
+    QLoggingCategory::setFilterRules(QString());
+}
+
+void TestAsyncLogger::testLogLevels()
+{
+    QVERIFY(AsyncLogger::setLogLevels("qtox.test.logger=warning"));
+    QVERIFY(!testLog().isDebugEnabled());
+    QVERIFY(!testLog().isInfoEnabled());
+    QVERIFY(testLog().isWarningEnabled());
+    QVERIFY(testLog().isCriticalEnabled());
+
+    QVERIFY(AsyncLogger::setLogLevels("qtox.test.logger=off"));
+    QVERIFY(!testLog().isCriticalEnabled());
+
+    QVERIFY(AsyncLogger::setLogLevels("qtox.test.logger=Debug"));
+    QVERIFY(testLog().isDebugEnabled());
+}
+
+void TestAsyncLogger::testWildcardLevels()
+{
+    QVERIFY(AsyncLogger::setLogLevels("qtox.test.*=critical, other=debug"));
+    QVERIFY(!testLog().isWarningEnabled());
+    QVERIFY(testLog().isCriticalEnabled());
+}
+
+void TestAsyncLogger::testInvalidLevels()
+{
+    QVERIFY(AsyncLogger::setLogLevels("qtox.test.logger=warning"));
+    QVERIFY(!AsyncLogger::setLogLevels("qtox.test.logger"));
+    QVERIFY(!AsyncLogger::setLogLevels("=debug"));
+    QVERIFY(!AsyncLogger::setLogLevels("qtox.test.logger=loud"));
+    // invalid levels don't change anything
+    QVERIFY(!testLog().isDebugEnabled());
+    QVERIFY(testLog().isWarningEnabled());
+}
+
+void TestAsyncLogger::testBufferedUntilLogFile()
+{
+    AsyncLogger& logger = AsyncLogger::getInstance();
+    logger.startLogging(true);
+    logger.log(QtWarningMsg, "before.cpp", 1, "before the log file");
+
+    const QString path = dir.filePath("qtox.log");
+    FILE* file = fopen(path.toLocal8Bit().constData(), "a");
+    QVERIFY(file);
+    QCOMPARE(logger.setLogFile(file), static_cast<FILE*>(nullptr));
+
+    logger.log(QtDebugMsg, "after.cpp", 2, "after the log file %1");
+    // filtered noise never reaches the file
+    logger.log(QtDebugMsg, "after.cpp", 3, "Unable to find any suggestion for secret");
+    logger.stop();
+    QCOMPARE(logger.setLogFile(nullptr), file);
+    fclose(file);
+
+    QFile log{path};
+    QVERIFY(log.open(QIODevice::ReadOnly));
+    const QList<QByteArray> lines = log.readAll().split('\n');
+    QCOMPARE(lines.size(), 3);
+    QVERIFY(lines[0].endsWith("before.cpp:1 : Warning: before the log file"));
+    QVERIFY(lines[1].endsWith("after.cpp:2 : Debug: after the log file %1"));
+    QVERIFY(lines[2].isEmpty());
+    QCOMPARE(logger.getDroppedMessages(), static_cast<uint64_t>(0));
+}
+
+QTEST_GUILESS_MAIN(TestAsyncLogger)
+#include "asynclogger_test.moc"
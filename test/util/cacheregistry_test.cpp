@@ -0,0 +1,140 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/cacheregistry.h"
+
+#include <QTest>
+
+#include <algorithm>
+
+namespace {
+class FakeCache : public RegisteredCache
+{
+public:
+    FakeCache(const char* name, CacheRegistry& registry, qint64 bytes_, int entries_)
+        : RegisteredCache(name, registry)
+        , bytes{bytes_}
+        , entries{entries_}
+    {
+    }
+
+    Usage getCacheUsage() const override
+    {
+        return {bytes, entries};
+    }
+
+    void trimCache(qint64 maxBytes) override
+    {
+        bytes = std::max(std::min(bytes, maxBytes), pinnedBytes);
+    }
+
+    void use()
+    {
+        markCacheUsed();
+    }
+
+    qint64 bytes;
+    int entries;
+    qint64 pinnedBytes = 0;
+};
+} // namespace
+
+class TestCacheRegistry : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testNoBudget();
+    void testTrimsLeastRecentlyUsedFirst();
+    void testSkipsEntriesInUse();
+    void testUsageSummedByName();
+    void testUnregister();
+};
+
+void TestCacheRegistry::testNoBudget()
+{
+    CacheRegistry registry;
+    FakeCache cache("cache", registry, 1000, 1);
+    QCOMPARE(registry.enforceBudget(), qint64{0});
+    QCOMPARE(cache.bytes, qint64{1000});
+}
+
+void TestCacheRegistry::testTrimsLeastRecentlyUsedFirst()
+{
+    CacheRegistry registry;
+    FakeCache oldest("oldest", registry, 100, 1);
+    FakeCache older("older", registry, 200, 1);
+    FakeCache newest("newest", registry, 300, 1);
+    oldest.use();
+    older.use();
+    newest.use();
+
+    registry.setBudget(450);
+    QCOMPARE(oldest.bytes, qint64{0});
+    QCOMPARE(older.bytes, qint64{150});
+    QCOMPARE(newest.bytes, qint64{300});
+
+    newest.bytes = 400;
+    QCOMPARE(registry.enforceBudget(), qint64{100});
+    QCOMPARE(older.bytes, qint64{50});
+    QCOMPARE(newest.bytes, qint64{400});
+}
+
+void TestCacheRegistry::testSkipsEntriesInUse()
+{
+    CacheRegistry registry;
+    FakeCache pinned("pinned", registry, 100, 1);
+    FakeCache other("other", registry, 100, 1);
+    pinned.pinnedBytes = 80;
+    pinned.use();
+    other.use();
+
+    registry.setBudget(100);
+    QCOMPARE(pinned.bytes, qint64{80});
+    QCOMPARE(other.bytes, qint64{20});
+}
+
+void TestCacheRegistry::testUsageSummedByName()
+{
+    CacheRegistry registry;
+    FakeCache small("small", registry, 10, 1);
+    FakeCache firstLarge("large", registry, 100, 2);
+    FakeCache secondLarge("large", registry, 200, 3);
+
+    const std::vector<CacheRegistry::Usage> usage = registry.getUsage();
+    QCOMPARE(usage.size(), size_t{2});
+    QCOMPARE(usage[0].name, QStringLiteral("large"));
+    QCOMPARE(usage[0].bytes, qint64{300});
+    QCOMPARE(usage[0].entries, 5);
+    QCOMPARE(usage[0].instances, 2);
+    QCOMPARE(usage[1].name, QStringLiteral("small"));
+    QVERIFY(registry.report().contains(QStringLiteral("large")));
+}
+
+void TestCacheRegistry::testUnregister()
+{
+    CacheRegistry registry;
+    {
+        FakeCache cache("cache", registry, 100, 1);
+        QCOMPARE(registry.getUsage().size(), size_t{1});
+    }
+    QVERIFY(registry.getUsage().empty());
+}
+
+QTEST_GUILESS_MAIN(TestCacheRegistry)
+#include "cacheregistry_test.moc"
@@ -0,0 +1,97 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/diagnosticsregistry.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTest>
+
+#include <memory>
+
+class TestDiagnosticsRegistry : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testBuiltinSections();
+    void testSourcesGroupedBySection();
+    void testUnregister();
+    void testToJson();
+};
+
+void TestDiagnosticsRegistry::testBuiltinSections()
+{
+    DiagnosticsRegistry registry;
+    const QJsonObject report = registry.collect();
+    QCOMPARE(report["formatVersion"].toInt(), DiagnosticsRegistry::FORMAT_VERSION);
+    QVERIFY(report["uptimeMs"].isDouble());
+    QVERIFY(report["threads"].toObject()["threads"].isArray());
+    QVERIFY(report["startup"].toObject()["phases"].isArray());
+    QVERIFY(report["caches"].toObject()["caches"].isArray());
+}
+
+void TestDiagnosticsRegistry::testSourcesGroupedBySection()
+{
+    DiagnosticsRegistry registry;
+    int collected = 0;
+    const DiagnosticsSource first{"loops",
+                                  [&collected] {
+                                      ++collected;
+                                      return QJsonObject{{"name", "first"}};
+                                  },
+                                  registry};
+    const DiagnosticsSource second{"loops", [] { return QJsonObject{{"name", "second"}}; },
+                                   registry};
+    const DiagnosticsSource other{"database", [] { return QJsonObject{{"queued", 3}}; },
+                                  registry};
+
+    const QJsonObject report = registry.collect();
+    const QJsonArray loops = report["loops"].toArray();
+    QCOMPARE(loops.size(), 2);
+    QCOMPARE(loops.at(0).toObject()["name"].toString(), QStringLiteral("first"));
+    QCOMPARE(loops.at(1).toObject()["name"].toString(), QStringLiteral("second"));
+    QCOMPARE(report["database"].toArray().at(0).toObject()["queued"].toInt(), 3);
+    QCOMPARE(collected, 1);
+}
+
+void TestDiagnosticsRegistry::testUnregister()
+{
+    DiagnosticsRegistry registry;
+    std::unique_ptr<DiagnosticsSource> source{
+        new DiagnosticsSource{"calls", [] { return QJsonObject{}; }, registry}};
+    QVERIFY(registry.collect().contains("calls"));
+
+    source.reset();
+    QVERIFY(!registry.collect().contains("calls"));
+}
+
+void TestDiagnosticsRegistry::testToJson()
+{
+    DiagnosticsRegistry registry;
+    const DiagnosticsSource source{"transfers", [] { return QJsonObject{{"active", 1}}; },
+                                   registry};
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(registry.toJson(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(doc.object()["transfers"].toArray().at(0).toObject()["active"].toInt(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestDiagnosticsRegistry)
+#include "diagnosticsregistry_test.moc"
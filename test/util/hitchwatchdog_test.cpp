@@ -0,0 +1,134 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/hitchwatchdog.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+
+#include <thread>
+#include <tuple>
+
+class TestHitchWatchdog : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testActiveScopes();
+    void testScopesBeyondMaxDepth();
+    void testScopeOnlyOnWatchedThread();
+    void testHitchLogged();
+    void testNoHitchWhileResponsive();
+
+private:
+    QTemporaryDir dir;
+};
+
+void TestHitchWatchdog::testActiveScopes()
+{
+    HitchWatchdog watchdog;
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("no scope"));
+
+    watchdog.enterScope("outer");
+    watchdog.enterScope("inner");
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("outer > inner"));
+
+    watchdog.leaveScope();
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("outer"));
+    watchdog.leaveScope();
+    watchdog.leaveScope();
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("no scope"));
+}
+
+void TestHitchWatchdog::testScopesBeyondMaxDepth()
+{
+    HitchWatchdog watchdog;
+    const int depth = HitchWatchdog::MAX_SCOPE_DEPTH + 2;
+    for (int i = 0; i < depth; ++i) {
+        watchdog.enterScope("nested");
+    }
+    QCOMPARE(watchdog.activeScopes().count(QStringLiteral("nested")),
+             HitchWatchdog::MAX_SCOPE_DEPTH);
+
+    for (int i = 0; i < depth - 1; ++i) {
+        watchdog.leaveScope();
+    }
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("nested"));
+}
+
+void TestHitchWatchdog::testScopeOnlyOnWatchedThread()
+{
+    HitchWatchdog& watchdog = HitchWatchdog::getInstance();
+    QVERIFY(!watchdog.isWatching());
+    {
+        HitchScope scope{"not running"};
+        QCOMPARE(watchdog.activeScopes(), QStringLiteral("no scope"));
+    }
+
+    watchdog.start({}, 1000);
+    {
+        HitchScope scope{"watched"};
+        QCOMPARE(watchdog.activeScopes(), QStringLiteral("watched"));
+
+        std::thread other([]() {
+            HitchScope otherScope{"other thread"};
+            std::ignore = otherScope;
+        });
+        other.join();
+        QCOMPARE(watchdog.activeScopes(), QStringLiteral("watched"));
+    }
+    watchdog.stop();
+    QCOMPARE(watchdog.activeScopes(), QStringLiteral("no scope"));
+}
+
+void TestHitchWatchdog::testHitchLogged()
+{
+    const QString logPath = dir.filePath(QStringLiteral("hitches.log"));
+    HitchWatchdog watchdog;
+    watchdog.start(logPath, 100);
+    QTest::qWait(200);
+
+    watchdog.enterScope("blocking test");
+    QThread::msleep(600);
+    watchdog.leaveScope();
+    // let the heartbeat come back and the watchdog notice
+    QTest::qWait(300);
+    watchdog.stop();
+
+    QFile log{logPath};
+    QVERIFY(log.open(QIODevice::ReadOnly));
+    const QString line = QString::fromUtf8(log.readAll());
+    QVERIFY(line.contains(QStringLiteral("GUI blocked for")));
+    QVERIFY(line.contains(QStringLiteral("in blocking test")));
+}
+
+void TestHitchWatchdog::testNoHitchWhileResponsive()
+{
+    const QString logPath = dir.filePath(QStringLiteral("responsive.log"));
+    HitchWatchdog watchdog;
+    watchdog.start(logPath, 300);
+    QTest::qWait(700);
+    watchdog.stop();
+
+    QVERIFY(!QFile::exists(logPath));
+}
+
+QTEST_GUILESS_MAIN(TestHitchWatchdog)
+#include "hitchwatchdog_test.moc"
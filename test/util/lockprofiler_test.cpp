@@ -0,0 +1,129 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/lockprofiler.h"
+
+#include <QJsonArray>
+#include <QSemaphore>
+#include <QThread>
+#include <QtTest/QtTest>
+
+#include <thread>
+
+class TestLockProfiler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testUncontended();
+    void testContended();
+    void testReadWrite();
+    void testReport();
+};
+
+void TestLockProfiler::testUncontended()
+{
+    QMutex mutex;
+    LockProfiler::Site& site = LockProfiler::getInstance().site("uncontended", "testUncontended");
+    for (int i = 0; i < 3; ++i) {
+        const ProfiledLocker<QMutex> locker{&mutex, site};
+    }
+
+    QCOMPARE(site.acquisitions.load(), static_cast<uint64_t>(3));
+    QCOMPARE(site.contentions.load(), static_cast<uint64_t>(0));
+    QCOMPARE(site.waitNs.load(), static_cast<uint64_t>(0));
+    QVERIFY(mutex.tryLock());
+    mutex.unlock();
+}
+
+void TestLockProfiler::testContended()
+{
+    QMutex mutex;
+    QSemaphore locked;
+    LockProfiler::Site& holderSite = LockProfiler::getInstance().site("contended", "holder");
+    LockProfiler::Site& waiterSite = LockProfiler::getInstance().site("contended", "waiter");
+
+    std::thread holder{[&]() {
+        const ProfiledLocker<QMutex> locker{&mutex, holderSite};
+        locked.release();
+        QThread::msleep(50);
+    }};
+    locked.acquire();
+    {
+        const ProfiledLocker<QMutex> locker{&mutex, waiterSite};
+    }
+    holder.join();
+
+    QCOMPARE(waiterSite.contentions.load(), static_cast<uint64_t>(1));
+    QVERIFY(waiterSite.waitNs > 0);
+    QCOMPARE(waiterSite.maxWaitNs.load(), waiterSite.waitNs.load());
+    QVERIFY(holderSite.holdNs >= 40 * 1000000ULL);
+}
+
+void TestLockProfiler::testReadWrite()
+{
+    QReadWriteLock lock;
+    LockProfiler::Site& site = LockProfiler::getInstance().site("readwrite", "testReadWrite");
+    {
+        const ProfiledLocker<QReadWriteLock, LockPolicy::Read> first{&lock, site};
+        const ProfiledLocker<QReadWriteLock, LockPolicy::Read> second{&lock, site};
+        QVERIFY(!lock.tryLockForWrite());
+    }
+    {
+        const ProfiledLocker<QReadWriteLock, LockPolicy::Write> writer{&lock, site};
+        QVERIFY(!lock.tryLockForRead());
+    }
+
+    QCOMPARE(site.acquisitions.load(), static_cast<uint64_t>(3));
+    QCOMPARE(site.contentions.load(), static_cast<uint64_t>(0));
+    QVERIFY(lock.tryLockForWrite());
+    lock.unlock();
+}
+
+void TestLockProfiler::testReport()
+{
+    QMutex mutex;
+    LockProfiler& profiler = LockProfiler::getInstance();
+    LockProfiler::Site& site = profiler.site("reported", "testReport");
+    {
+        const ProfiledLocker<QMutex> locker{&mutex, site};
+    }
+
+    const QString report = profiler.report();
+    QVERIFY(report.contains(QStringLiteral("reported: 1 locks")));
+    QVERIFY(report.contains(QStringLiteral("    testReport: 1 locks")));
+
+    bool found = false;
+    for (const QJsonValue& value : profiler.toJson()["sites"].toArray()) {
+        const QJsonObject entry = value.toObject();
+        if (entry["lock"].toString() == QStringLiteral("reported")) {
+            QCOMPARE(entry["scope"].toString(), QStringLiteral("testReport"));
+            QCOMPARE(entry["acquisitions"].toInt(), 1);
+            found = true;
+        }
+    }
+    QVERIFY(found);
+
+    profiler.reset();
+    QCOMPARE(site.acquisitions.load(), static_cast<uint64_t>(0));
+    QVERIFY(!profiler.report().contains(QStringLiteral("reported")));
+}
+
+QTEST_GUILESS_MAIN(TestLockProfiler)
+#include "lockprofiler_test.moc"
@@ -0,0 +1,127 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/mpscqueue.h"
+
+#include <QTest>
+
+#include <thread>
+#include <vector>
+
+namespace {
+struct Item
+{
+    int producer;
+    int value;
+};
+
+constexpr int producerCount = 4;
+constexpr int itemsPerProducer = 20000;
+} // namespace
+
+class TestMpscQueue : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testEmpty();
+    void testFull();
+    void testOrder();
+    void testProducers();
+};
+
+void TestMpscQueue::testEmpty()
+{
+    MpscQueue<Item, 4> queue;
+    Item item;
+    QVERIFY(queue.empty());
+    QVERIFY(!queue.pop(item));
+}
+
+void TestMpscQueue::testFull()
+{
+    MpscQueue<Item, 4> queue;
+    for (size_t i = 0; i < queue.capacity(); ++i) {
+        QVERIFY(queue.push(Item{0, static_cast<int>(i)}));
+    }
+    QVERIFY(!queue.push(Item{0, 42}));
+
+    // a popped slot can be reused
+    Item item;
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item.value, 0);
+    QVERIFY(queue.push(Item{0, 42}));
+}
+
+void TestMpscQueue::testOrder()
+{
+    MpscQueue<Item, 8> queue;
+    Item item;
+    // wrap around a few times
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(queue.push(Item{0, i}));
+        QVERIFY(queue.push(Item{0, -i}));
+        QVERIFY(queue.pop(item));
+        QCOMPARE(item.value, i);
+        QVERIFY(queue.pop(item));
+        QCOMPARE(item.value, -i);
+        QVERIFY(queue.empty());
+    }
+}
+
+void TestMpscQueue::testProducers()
+{
+    MpscQueue<Item, 256> queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < itemsPerProducer; ++i) {
+                while (!queue.push(Item{p, i})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // items of each producer must arrive complete and in order
+    std::vector<int> next(producerCount, 0);
+    int received = 0;
+    int outOfOrder = 0;
+    Item item;
+    while (received < producerCount * itemsPerProducer) {
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.value != next[item.producer]) {
+            ++outOfOrder;
+        }
+        next[item.producer] = item.value + 1;
+        ++received;
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    QCOMPARE(outOfOrder, 0);
+    QVERIFY(queue.empty());
+}
+
+QTEST_GUILESS_MAIN(TestMpscQueue)
+#include "mpscqueue_test.moc"
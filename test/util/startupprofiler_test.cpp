@@ -0,0 +1,167 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/startupprofiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+QJsonArray traceEvents()
+{
+    const QJsonDocument doc = QJsonDocument::fromJson(StartupProfiler::getInstance().toJson());
+    return doc.object()["traceEvents"].toArray();
+}
+
+QJsonObject findEvent(const QJsonArray& events, const QString& name)
+{
+    for (const QJsonValue& value : events) {
+        if (value.toObject()["name"].toString() == name) {
+            return value.toObject();
+        }
+    }
+    return {};
+}
+} // namespace
+
+class TestStartupProfiler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testDisabledRecordsNothing();
+    void testSummaryWhileDisabled();
+    void testPhases();
+    void testThreads();
+    void testWrite();
+
+private:
+    QTemporaryDir dir;
+};
+
+void TestStartupProfiler::testDisabledRecordsNothing()
+{
+    QVERIFY(!StartupProfiler::getInstance().isEnabled());
+    {
+        StartupPhase phase{"disabled"};
+    }
+    StartupProfiler::getInstance().addMark("disabled mark");
+    QVERIFY(traceEvents().isEmpty());
+    QVERIFY(!StartupProfiler::getInstance().write());
+}
+
+void TestStartupProfiler::testSummaryWhileDisabled()
+{
+    for (int i = 0; i < 2; ++i) {
+        StartupPhase phase{"per friend"};
+        QTest::qSleep(1);
+    }
+    StartupProfiler::getInstance().addMark("summary mark");
+    QVERIFY(traceEvents().isEmpty());
+
+    const QVector<StartupProfiler::PhaseSummary> summary =
+        StartupProfiler::getInstance().getPhaseSummary();
+    auto find = [&summary](const QString& name) {
+        return std::find_if(summary.begin(), summary.end(),
+                            [&name](const StartupProfiler::PhaseSummary& phase) {
+                                return phase.name == name;
+                            });
+    };
+
+    const auto perFriend = find("per friend");
+    QVERIFY(perFriend != summary.end());
+    QCOMPARE(perFriend->count, 2);
+    QVERIFY(perFriend->totalUs >= 2000);
+
+    const auto mark = find("summary mark");
+    QVERIFY(mark != summary.end());
+    QCOMPARE(mark->totalUs, qint64{0});
+    QVERIFY(mark->firstStartUs >= perFriend->firstStartUs + perFriend->totalUs);
+}
+
+void TestStartupProfiler::testPhases()
+{
+    StartupProfiler::getInstance().enable(dir.filePath("trace.json"));
+    {
+        StartupPhase outer{"outer"};
+        StartupPhase inner{"inner"};
+        QTest::qSleep(2);
+    }
+    StartupProfiler::getInstance().addMark("mark");
+
+    const QJsonArray events = traceEvents();
+    const QJsonObject outer = findEvent(events, "outer");
+    const QJsonObject inner = findEvent(events, "inner");
+    QCOMPARE(outer["ph"].toString(), QStringLiteral("X"));
+    QVERIFY(inner["dur"].toDouble() >= 1000);
+    // the inner phase ends first, but lies within the outer one
+    QVERIFY(outer["ts"].toDouble() <= inner["ts"].toDouble());
+    QVERIFY(outer["dur"].toDouble() >= inner["dur"].toDouble());
+    QCOMPARE(outer["tid"].toInt(), inner["tid"].toInt());
+
+    const QJsonObject mark = findEvent(events, "mark");
+    QCOMPARE(mark["ph"].toString(), QStringLiteral("i"));
+    QVERIFY(mark["ts"].toDouble() >= outer["ts"].toDouble() + outer["dur"].toDouble());
+}
+
+void TestStartupProfiler::testThreads()
+{
+    QThread thread;
+    thread.setObjectName("worker");
+    QObject worker;
+    worker.moveToThread(&thread);
+    connect(&thread, &QThread::started, &worker, []() {
+        StartupPhase phase{"on worker"};
+    });
+    thread.start();
+    QTRY_VERIFY(!findEvent(traceEvents(), "on worker").isEmpty());
+    thread.quit();
+    thread.wait();
+
+    const QJsonArray events = traceEvents();
+    const int workerTid = findEvent(events, "on worker")["tid"].toInt();
+    QVERIFY(workerTid != findEvent(events, "outer")["tid"].toInt());
+
+    bool named = false;
+    for (const QJsonValue& value : events) {
+        const QJsonObject event = value.toObject();
+        if (event["ph"].toString() == "M" && event["tid"].toInt() == workerTid) {
+            named = event["args"].toObject()["name"].toString() == "worker";
+        }
+    }
+    QVERIFY(named);
+}
+
+void TestStartupProfiler::testWrite()
+{
+    QVERIFY(StartupProfiler::getInstance().write());
+    QFile file{dir.filePath("trace.json")};
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), StartupProfiler::getInstance().toJson());
+}
+
+QTEST_GUILESS_MAIN(TestStartupProfiler)
+#include "startupprofiler_test.moc"
@@ -0,0 +1,114 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/threadcputime.h"
+
+#include <QElapsedTimer>
+#include <QTest>
+
+#include <thread>
+
+namespace {
+qint64 findSample(const QString& name)
+{
+    for (const ThreadCpuTime::Sample& sample : ThreadCpuTime::sample()) {
+        if (sample.name == name) {
+            return sample.cpuNs;
+        }
+    }
+    return -1;
+}
+
+void burnCpu(int ms)
+{
+    QElapsedTimer timer;
+    timer.start();
+    volatile quint64 sink = 0;
+    while (timer.elapsed() < ms) {
+        sink = sink + 1;
+    }
+}
+} // namespace
+
+class TestThreadCpuTime : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testProcessTimeGrows();
+    void testThreadTimeGrows();
+    void testRetiredThreadKeepsTotal();
+    void testUnregisteredThreadNotReported();
+};
+
+void TestThreadCpuTime::testProcessTimeGrows()
+{
+    const qint64 before = ThreadCpuTime::processNs();
+    QVERIFY(before >= 0);
+    burnCpu(20);
+    QVERIFY(ThreadCpuTime::processNs() > before);
+}
+
+void TestThreadCpuTime::testThreadTimeGrows()
+{
+    if (!ThreadCpuTime::hasThreadClocks()) {
+        QSKIP("No thread clocks on this platform");
+    }
+
+    ThreadCpuTime::registerCurrentThread("grows");
+    const qint64 before = findSample("grows");
+    QVERIFY(before >= 0);
+    burnCpu(20);
+    QVERIFY(findSample("grows") > before);
+    ThreadCpuTime::unregisterCurrentThread();
+}
+
+void TestThreadCpuTime::testRetiredThreadKeepsTotal()
+{
+    if (!ThreadCpuTime::hasThreadClocks()) {
+        QSKIP("No thread clocks on this platform");
+    }
+
+    std::thread worker{[] {
+        ThreadCpuTime::registerCurrentThread("retired");
+        burnCpu(20);
+        ThreadCpuTime::unregisterCurrentThread();
+    }};
+    worker.join();
+
+    const qint64 first = findSample("retired");
+    QVERIFY(first > 0);
+
+    std::thread second{[] {
+        ThreadCpuTime::registerCurrentThread("retired");
+        burnCpu(20);
+        ThreadCpuTime::unregisterCurrentThread();
+    }};
+    second.join();
+    QVERIFY(findSample("retired") > first);
+}
+
+void TestThreadCpuTime::testUnregisteredThreadNotReported()
+{
+    ThreadCpuTime::unregisterCurrentThread();
+    QCOMPARE(findSample("never registered"), -1);
+}
+
+QTEST_GUILESS_MAIN(TestThreadCpuTime)
+#include "threadcputime_test.moc"
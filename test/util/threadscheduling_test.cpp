@@ -0,0 +1,73 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/threadscheduling.h"
+
+#include <QtTest/QtTest>
+
+#include <thread>
+
+class TestThreadScheduling : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testDefaultClass();
+    void testBackground();
+    void testPerThread();
+};
+
+void TestThreadScheduling::testDefaultClass()
+{
+    std::thread worker{[]() {
+        QCOMPARE(ThreadScheduling::getCurrentThreadClass(), ThreadScheduling::Class::Normal);
+        // switching to the class a thread already has never touches the scheduler
+        QVERIFY(ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Normal));
+    }};
+    worker.join();
+}
+
+void TestThreadScheduling::testBackground()
+{
+    std::thread worker{[]() {
+        const bool applied =
+            ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Background);
+#if defined(Q_OS_WIN) || defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+        // lowering the own priority never needs privileges
+        QVERIFY(applied);
+#else
+        Q_UNUSED(applied);
+#endif
+        QCOMPARE(ThreadScheduling::getCurrentThreadClass(), ThreadScheduling::Class::Background);
+    }};
+    worker.join();
+}
+
+void TestThreadScheduling::testPerThread()
+{
+    std::thread worker{[]() {
+        // may be refused without privileges, the class is tracked either way
+        ThreadScheduling::setCurrentThreadClass(ThreadScheduling::Class::Interactive);
+        QCOMPARE(ThreadScheduling::getCurrentThreadClass(), ThreadScheduling::Class::Interactive);
+    }};
+    worker.join();
+    QCOMPARE(ThreadScheduling::getCurrentThreadClass(), ThreadScheduling::Class::Normal);
+}
+
+QTEST_GUILESS_MAIN(TestThreadScheduling)
+#include "threadscheduling_test.moc"
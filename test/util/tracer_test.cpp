@@ -0,0 +1,108 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/tracer.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include <thread>
+
+namespace {
+QJsonArray spans(const Tracer& tracer, const QString& name)
+{
+    QJsonArray result;
+    const QJsonArray events = QJsonDocument::fromJson(tracer.toJson()).object()["traceEvents"].toArray();
+    for (const QJsonValue& event : events) {
+        const QJsonObject object = event.toObject();
+        if (object["ph"].toString() == QStringLiteral("X") && object["name"].toString() == name) {
+            result.append(object);
+        }
+    }
+    return result;
+}
+} // namespace
+
+class TestTracer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testDisabledByDefault();
+    void testSpan();
+    void testThreadsGetOwnTracks();
+    void testRingBufferKeepsNewest();
+};
+
+void TestTracer::testDisabledByDefault()
+{
+    Tracer tracer;
+    QVERIFY(!tracer.isEnabled());
+    tracer.addSpan("span", 0, 1);
+    QVERIFY(spans(tracer, QStringLiteral("span")).isEmpty());
+    QVERIFY(!tracer.write());
+}
+
+void TestTracer::testSpan()
+{
+    Tracer tracer;
+    tracer.enable(QString());
+    tracer.addSpan("span", 10, 25);
+
+    const QJsonArray recorded = spans(tracer, QStringLiteral("span"));
+    QCOMPARE(recorded.size(), 1);
+    const QJsonObject span = recorded.first().toObject();
+    QCOMPARE(span["ts"].toInt(), 10);
+    QCOMPARE(span["dur"].toInt(), 15);
+}
+
+void TestTracer::testThreadsGetOwnTracks()
+{
+    Tracer tracer;
+    tracer.enable(QString());
+    tracer.addSpan("main", 0, 1);
+    std::thread worker{[&tracer] { tracer.addSpan("worker", 1, 2); }};
+    worker.join();
+
+    const QJsonArray main = spans(tracer, QStringLiteral("main"));
+    const QJsonArray other = spans(tracer, QStringLiteral("worker"));
+    QCOMPARE(main.size(), 1);
+    QCOMPARE(other.size(), 1);
+    QVERIFY(main.first().toObject()["tid"].toInt() != other.first().toObject()["tid"].toInt());
+}
+
+void TestTracer::testRingBufferKeepsNewest()
+{
+    Tracer tracer;
+    tracer.enable(QString());
+    const qint64 count = static_cast<qint64>(Tracer::EVENTS_PER_THREAD) + 10;
+    for (qint64 i = 0; i < count; ++i) {
+        tracer.addSpan("span", i, i + 1);
+    }
+
+    // the oldest slot is skipped, since the owner could be overwriting it right now
+    const QJsonArray recorded = spans(tracer, QStringLiteral("span"));
+    QCOMPARE(recorded.size(), static_cast<int>(Tracer::EVENTS_PER_THREAD) - 1);
+    QCOMPARE(recorded.first().toObject()["ts"].toInt(), 11);
+    QCOMPARE(recorded.last().toObject()["ts"].toInt(), static_cast<int>(count - 1));
+}
+
+QTEST_GUILESS_MAIN(TestTracer)
+#include "tracer_test.moc"
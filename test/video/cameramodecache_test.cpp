@@ -0,0 +1,208 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/video/cameramodecache.h"
+#include "src/video/ivideosettings.h"
+
+#include <QTest>
+
+namespace {
+class MockVideoSettings : public IVideoSettings
+{
+public:
+    QString getVideoDev() const override { return {}; }
+    void setVideoDev(const QString&) override {}
+    QRect getScreenRegion() const override { return {}; }
+    void setScreenRegion(const QRect&) override {}
+    bool getScreenGrabbed() const override { return false; }
+    void setScreenGrabbed(bool) override {}
+    bool getScreenFollowWindow() const override { return false; }
+    void setScreenFollowWindow(bool) override {}
+    QRect getCamVideoRes() const override { return {}; }
+    void setCamVideoRes(QRect) override {}
+    float getCamVideoFPS() const override { return 0; }
+    void setCamVideoFPS(float) override {}
+    int getScreenVideoFPS() const override { return 0; }
+    void setScreenVideoFPS(int) override {}
+    bool getCamVideoHwDecode() const override { return false; }
+    void setCamVideoHwDecode(bool) override {}
+    bool getCamWarmStandby() const override { return false; }
+    void setCamWarmStandby(bool) override {}
+    QByteArray getCamModeCache() const override { return camModeCache; }
+    void setCamModeCache(const QByteArray& newValue) override { camModeCache = newValue; }
+
+    QMetaObject::Connection connectTo_videoDevChanged(QObject*, Slot_videoDevChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection connectTo_screenRegionChanged(QObject*,
+                                                          Slot_screenRegionChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection connectTo_screenGrabbedChanged(QObject*,
+                                                           Slot_screenGrabbedChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection
+    connectTo_screenFollowWindowChanged(QObject*, Slot_screenFollowWindowChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection connectTo_camVideoResChanged(QObject*,
+                                                         Slot_camVideoResChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection connectTo_camVideoFPSChanged(QObject*,
+                                                         Slot_camVideoFPSChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection connectTo_screenVideoFPSChanged(QObject*,
+                                                            Slot_screenVideoFPSChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection
+    connectTo_camVideoHwDecodeChanged(QObject*, Slot_camVideoHwDecodeChanged) const override
+    {
+        return {};
+    }
+    QMetaObject::Connection
+    connectTo_camWarmStandbyChanged(QObject*, Slot_camWarmStandbyChanged) const override
+    {
+        return {};
+    }
+
+    QByteArray camModeCache;
+};
+
+VideoMode makeMode(int width, int height, float fps)
+{
+    VideoMode mode;
+    mode.width = width;
+    mode.height = height;
+    mode.FPS = fps;
+    return mode;
+}
+} // namespace
+
+class TestCameraModeCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void testCachesProbe();
+    void testFingerprintChange();
+    void testPersistence();
+    void testInvalidate();
+    void testEmptyProbeNotCached();
+
+private:
+    CameraModeCache::Prober prober();
+    CameraModeCache::Fingerprinter fingerprinter();
+
+    MockVideoSettings settings;
+    QVector<VideoMode> modes;
+    QString fingerprint;
+    int probes = 0;
+};
+
+CameraModeCache::Prober TestCameraModeCache::prober()
+{
+    return [this](const QString&) {
+        ++probes;
+        return modes;
+    };
+}
+
+CameraModeCache::Fingerprinter TestCameraModeCache::fingerprinter()
+{
+    return [this](const QString&) { return fingerprint; };
+}
+
+void TestCameraModeCache::init()
+{
+    settings.camModeCache.clear();
+    modes = {makeMode(640, 480, 30), makeMode(1280, 720, 30)};
+    fingerprint = QStringLiteral("usb:v046Dp0825|5.10.0");
+    probes = 0;
+}
+
+void TestCameraModeCache::testCachesProbe()
+{
+    CameraModeCache cache{settings, prober(), fingerprinter()};
+    QCOMPARE(cache.getVideoModes("cam0"), modes);
+    QCOMPARE(cache.getVideoModes("cam0"), modes);
+    QCOMPARE(probes, 1);
+
+    cache.getVideoModes("cam1");
+    QCOMPARE(probes, 2);
+}
+
+void TestCameraModeCache::testFingerprintChange()
+{
+    CameraModeCache cache{settings, prober(), fingerprinter()};
+    cache.getVideoModes("cam0");
+
+    fingerprint = QStringLiteral("usb:v046Dp0825|5.11.0");
+    modes = {makeMode(1920, 1080, 30)};
+    QCOMPARE(cache.getVideoModes("cam0"), modes);
+    QCOMPARE(probes, 2);
+}
+
+void TestCameraModeCache::testPersistence()
+{
+    const QVector<VideoMode> probed = modes;
+    {
+        CameraModeCache cache{settings, prober(), fingerprinter()};
+        cache.getVideoModes("cam0");
+    }
+
+    modes.clear();
+    CameraModeCache restored{settings, prober(), fingerprinter()};
+    QCOMPARE(restored.getVideoModes("cam0"), probed);
+    QCOMPARE(probes, 1);
+}
+
+void TestCameraModeCache::testInvalidate()
+{
+    CameraModeCache cache{settings, prober(), fingerprinter()};
+    cache.getVideoModes("cam0");
+    cache.invalidate("cam0");
+    cache.getVideoModes("cam0");
+    QCOMPARE(probes, 2);
+}
+
+void TestCameraModeCache::testEmptyProbeNotCached()
+{
+    modes.clear();
+    CameraModeCache cache{settings, prober(), fingerprinter()};
+    QVERIFY(cache.getVideoModes("cam0").isEmpty());
+    QVERIFY(settings.camModeCache.isEmpty());
+
+    modes = {makeMode(640, 480, 30)};
+    QCOMPARE(cache.getVideoModes("cam0"), modes);
+    QCOMPARE(probes, 2);
+}
+
+QTEST_GUILESS_MAIN(TestCameraModeCache)
+#include "cameramodecache_test.moc"
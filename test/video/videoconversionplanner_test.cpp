@@ -0,0 +1,105 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "src/video/videoconversionplanner.h"
+
+#include <QTest>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+using Output = VideoConversionPlanner::Output;
+
+namespace {
+const QSize source{1920, 1080};
+} // namespace
+
+class TestVideoConversionPlanner : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testLargestFirst();
+    void testDerivesFromSmallestCover();
+    void testFormatOfBase();
+    void testDropsUnsetAndDuplicates();
+    void testDefaultSize();
+};
+
+void TestVideoConversionPlanner::testLargestFirst()
+{
+    const auto steps = VideoConversionPlanner::plan(
+        {{{320, 180}, AV_PIX_FMT_RGB24, false}, {{1920, 1080}, AV_PIX_FMT_YUV420P, true}}, source);
+
+    QCOMPARE(steps.size(), size_t{2});
+    QCOMPARE(steps[0].output.size, QSize(1920, 1080));
+    QCOMPARE(steps[0].base, -1);
+    QCOMPARE(steps[1].output.size, QSize(320, 180));
+}
+
+void TestVideoConversionPlanner::testDerivesFromSmallestCover()
+{
+    // the encoder at 1080p, a second call at 720p and the local preview
+    const auto steps = VideoConversionPlanner::plan({{{1920, 1080}, AV_PIX_FMT_YUV420P, true},
+                                                     {{320, 180}, AV_PIX_FMT_RGB24, false},
+                                                     {{1280, 720}, AV_PIX_FMT_YUV420P, true}},
+                                                    source);
+
+    QCOMPARE(steps.size(), size_t{3});
+    QCOMPARE(steps[0].base, -1);
+    QCOMPARE(steps[1].output.size, QSize(1280, 720));
+    QCOMPARE(steps[1].base, 0);
+    QCOMPARE(steps[2].output.size, QSize(320, 180));
+    QCOMPARE(steps[2].base, 1);
+}
+
+void TestVideoConversionPlanner::testFormatOfBase()
+{
+    // RGB isn't used to derive YUV from, but covers a smaller RGB output
+    const auto steps = VideoConversionPlanner::plan({{{640, 360}, AV_PIX_FMT_RGB24, false},
+                                                     {{320, 180}, AV_PIX_FMT_YUV420P, true},
+                                                     {{160, 90}, AV_PIX_FMT_RGB24, false}},
+                                                    source);
+
+    QCOMPARE(steps.size(), size_t{3});
+    QCOMPARE(steps[1].output.pixelFormat, static_cast<int>(AV_PIX_FMT_YUV420P));
+    QCOMPARE(steps[1].base, -1);
+    QCOMPARE(steps[2].base, 1);
+}
+
+void TestVideoConversionPlanner::testDropsUnsetAndDuplicates()
+{
+    const Output preview{{320, 180}, AV_PIX_FMT_RGB24, false};
+    const auto steps = VideoConversionPlanner::plan({preview, Output{}, preview}, source);
+
+    QCOMPARE(steps.size(), size_t{1});
+    QVERIFY(steps[0].output == preview);
+}
+
+void TestVideoConversionPlanner::testDefaultSize()
+{
+    const auto steps =
+        VideoConversionPlanner::plan({{QSize(), AV_PIX_FMT_YUV420P, false}}, source);
+
+    QCOMPARE(steps.size(), size_t{1});
+    QCOMPARE(steps[0].output.size, source);
+}
+
+QTEST_GUILESS_MAIN(TestVideoConversionPlanner)
+#include "videoconversionplanner_test.moc"
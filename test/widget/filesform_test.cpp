@@ -21,6 +21,7 @@
 #include "src/friendlist.h"
 #include "src/model/friend.h"
 
+#include <QSignalSpy>
 #include <QTest>
 #include <limits>
 
@@ -44,7 +45,11 @@ private slots:
     void testAvatarIgnored();
     void testMultipleFiles();
     void testFileRemoval();
+    void testProgressBatching();
+    void testRemovalFlushesProgress();
 private:
+    void addFiles(int count);
+
     std::unique_ptr<FileTransferList::Model> model;
     std::unique_ptr<FriendList> friendList;
 };
@@ -271,5 +276,78 @@ void TestFileTransferList::testFileRemoval()
     QCOMPARE(model->rowCount(), 1);
 }
 
+void TestFileTransferList::addFiles(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        ToxFile file(i, 0, QString::number(i), "", 1000, ToxFile::FileDirection::SENDING,
+                     static_cast<uint32_t>(TOX_FILE_KIND_DATA));
+        file.resumeFileId = QByteArray::number(i);
+        file.status = ToxFile::TRANSMITTING;
+        model->onFileUpdated(file);
+    }
+}
+
+void TestFileTransferList::testProgressBatching()
+{
+    addFiles(4);
+    QSignalSpy spy(model.get(), &Model::dataChanged);
+
+    for (int sample = 1; sample <= 10; ++sample) {
+        for (int row : {1, 3}) {
+            ToxFile file(row, 0, QString::number(row), "", 1000, ToxFile::FileDirection::SENDING,
+                         static_cast<uint32_t>(TOX_FILE_KIND_DATA));
+            file.resumeFileId = QByteArray::number(row);
+            file.status = ToxFile::TRANSMITTING;
+            file.progress.addSample(sample * 10, QTime(1, 0, 0));
+            model->onFileUpdated(file);
+        }
+    }
+
+    // the model has the latest progress right away, the view only hears about it later
+    QCOMPARE(model->index(3, static_cast<int>(Column::progress)).data().toFloat(), 10.0f);
+    QCOMPARE(spy.count(), 0);
+
+    // all changes in one range, rows 1 to 3 over every column
+    QTRY_COMPARE(spy.count(), 1);
+    const auto topLeft = spy.first().at(0).toModelIndex();
+    const auto bottomRight = spy.first().at(1).toModelIndex();
+    QCOMPARE(topLeft.row(), 1);
+    QCOMPARE(topLeft.column(), 0);
+    QCOMPARE(bottomRight.row(), 3);
+    QCOMPARE(bottomRight.column(), model->columnCount() - 1);
+
+    QTest::qWait(Model::UPDATE_INTERVAL_MS * 2);
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestFileTransferList::testRemovalFlushesProgress()
+{
+    addFiles(3);
+    QSignalSpy changedSpy(model.get(), &Model::dataChanged);
+    QSignalSpy removedSpy(model.get(), &Model::rowsAboutToBeRemoved);
+
+    ToxFile file(2, 0, "2", "", 1000, ToxFile::FileDirection::SENDING,
+                 static_cast<uint32_t>(TOX_FILE_KIND_DATA));
+    file.resumeFileId = QByteArray::number(2);
+    file.status = ToxFile::TRANSMITTING;
+    model->onFileUpdated(file);
+
+    QObject::connect(model.get(), &Model::rowsAboutToBeRemoved, [&] {
+        // the pending row 2 has to be announced while row 2 still is that file
+        QCOMPARE(changedSpy.count(), 1);
+    });
+
+    file = ToxFile(0, 0, "0", "", 1000, ToxFile::FileDirection::SENDING,
+                   static_cast<uint32_t>(TOX_FILE_KIND_DATA));
+    file.resumeFileId = QByteArray::number(0);
+    file.status = ToxFile::CANCELED;
+    model->onFileUpdated(file);
+
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.first().at(0).toModelIndex().row(), 2);
+    QCOMPARE(model->rowCount(), 2);
+}
+
 QTEST_GUILESS_MAIN(TestFileTransferList)
 #include "filesform_test.moc"
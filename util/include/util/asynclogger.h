@@ -0,0 +1,90 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "util/mpscqueue.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+class AsyncLogger : public QThread
+{
+public:
+    static AsyncLogger& getInstance();
+
+    void log(QtMsgType type, const char* file, int line, const QString& msg);
+    FILE* setLogFile(FILE* file);
+    void startLogging(bool bufferForFile);
+    void flush();
+    void stop();
+    uint64_t getDroppedMessages() const;
+
+    static bool setLogLevels(const QString& levels);
+
+    static constexpr size_t QUEUE_SIZE = 4096;
+    static constexpr size_t FILE_NAME_SIZE = 64;
+    static constexpr int FLUSH_TIMEOUT_MS = 1000;
+
+protected:
+    void run() override;
+
+private:
+    AsyncLogger() = default;
+
+    struct Record
+    {
+        QtMsgType type = QtDebugMsg;
+        int line = 0;
+        qint64 timeMs = 0;
+        std::array<char, FILE_NAME_SIZE> file{};
+        QString msg;
+    };
+
+    void drain();
+    void write(const Record& record);
+    void writeLine(const QByteArray& line);
+
+private:
+    MpscQueue<Record, QUEUE_SIZE> queue;
+    QSemaphore wakeup;
+    std::atomic<bool> running{false};
+    std::atomic<bool> consumerWaiting{false};
+    std::atomic<uint64_t> queuedMessages{0};
+    std::atomic<uint64_t> handledMessages{0};
+    std::atomic<uint64_t> droppedMessages{0};
+    uint64_t reportedDropped = 0;
+
+    // guards the outputs, the sync fallback paths write from the logging thread
+    QMutex writeMutex;
+    FILE* logFile = nullptr;
+    bool bufferForFile = false;
+    QList<QByteArray> fileBuffer;
+};
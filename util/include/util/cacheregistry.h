@@ -0,0 +1,106 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class QTimer;
+class RegisteredCache;
+
+class CacheRegistry
+{
+public:
+    struct Usage
+    {
+        QString name;
+        qint64 bytes;
+        int entries;
+        int instances;
+    };
+
+    CacheRegistry();
+    ~CacheRegistry();
+    CacheRegistry(const CacheRegistry&) = delete;
+    CacheRegistry& operator=(const CacheRegistry&) = delete;
+
+    static CacheRegistry& getInstance();
+
+    void setBudget(qint64 bytes);
+    qint64 getBudget() const;
+    void setLowMemory(bool enabled);
+    bool isLowMemory() const;
+    qint64 enforceBudget();
+    std::vector<Usage> getUsage() const;
+    QString report() const;
+
+    static constexpr qint64 DEFAULT_BUDGET = 256 * 1024 * 1024;
+    static constexpr qint64 LOW_MEMORY_BUDGET = 64 * 1024 * 1024;
+    static constexpr int CHECK_INTERVAL_MS = 5000;
+
+private:
+    friend class RegisteredCache;
+
+    void add(RegisteredCache* cache);
+    void remove(RegisteredCache* cache);
+    uint64_t nextUse();
+
+private:
+    mutable QMutex mutex;
+    std::vector<RegisteredCache*> caches;
+    std::atomic<uint64_t> useCounter{0};
+    qint64 budget = 0;
+    std::atomic_bool lowMemory{false};
+    std::unique_ptr<QTimer> checkTimer;
+};
+
+class RegisteredCache
+{
+public:
+    struct Usage
+    {
+        qint64 bytes;
+        int entries;
+    };
+
+    explicit RegisteredCache(const char* name, CacheRegistry& registry = CacheRegistry::getInstance());
+    virtual ~RegisteredCache();
+    RegisteredCache(const RegisteredCache&) = delete;
+    RegisteredCache& operator=(const RegisteredCache&) = delete;
+
+    const char* getCacheName() const;
+    uint64_t getLastUse() const;
+
+    virtual Usage getCacheUsage() const = 0;
+    virtual void trimCache(qint64 maxBytes) = 0;
+
+protected:
+    void markCacheUsed() const;
+
+private:
+    const char* const name;
+    CacheRegistry& registry;
+    mutable std::atomic<uint64_t> lastUse{0};
+};
@@ -0,0 +1,74 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+
+#include <functional>
+#include <vector>
+
+class DiagnosticsSource;
+
+class DiagnosticsRegistry
+{
+public:
+    DiagnosticsRegistry();
+    DiagnosticsRegistry(const DiagnosticsRegistry&) = delete;
+    DiagnosticsRegistry& operator=(const DiagnosticsRegistry&) = delete;
+
+    static DiagnosticsRegistry& getInstance();
+
+    QJsonObject collect() const;
+    QByteArray toJson() const;
+
+    static constexpr int FORMAT_VERSION = 1;
+
+private:
+    friend class DiagnosticsSource;
+
+    void add(const DiagnosticsSource* source);
+    void remove(const DiagnosticsSource* source);
+
+private:
+    mutable QMutex mutex;
+    std::vector<const DiagnosticsSource*> sources;
+};
+
+class DiagnosticsSource
+{
+public:
+    using Collector = std::function<QJsonObject()>;
+
+    DiagnosticsSource(const char* section, Collector collector,
+                      DiagnosticsRegistry& registry = DiagnosticsRegistry::getInstance());
+    ~DiagnosticsSource();
+    DiagnosticsSource(const DiagnosticsSource&) = delete;
+    DiagnosticsSource& operator=(const DiagnosticsSource&) = delete;
+
+    const char* getSection() const;
+    QJsonObject collect() const;
+
+private:
+    const char* section;
+    Collector collector;
+    DiagnosticsRegistry& registry;
+};
@@ -0,0 +1,92 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QString>
+#include <QStringList>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+class QThread;
+class QTimer;
+
+class HitchWatchdog
+{
+public:
+    HitchWatchdog();
+    ~HitchWatchdog();
+    HitchWatchdog(const HitchWatchdog&) = delete;
+    HitchWatchdog& operator=(const HitchWatchdog&) = delete;
+
+    static HitchWatchdog& getInstance();
+
+    void start(const QString& logPath, qint64 thresholdMs);
+    void stop();
+    bool isRunning() const;
+    bool isWatching() const;
+
+    void enterScope(const char* name);
+    void leaveScope();
+    QString activeScopes() const;
+
+    static constexpr qint64 DEFAULT_THRESHOLD_MS = 500;
+    static constexpr qint64 BEAT_INTERVAL_MS = 50;
+    static constexpr int MAX_SCOPE_DEPTH = 8;
+    static constexpr int MAX_SCOPE_SAMPLES = 4;
+    static constexpr qint64 MAX_LOG_SIZE = 1000000;
+
+private:
+    class WatchThread;
+
+    void watch();
+    void writeHitch(qint64 durationMs, const QStringList& scopes) const;
+
+private:
+    QElapsedTimer clock;
+    std::atomic<bool> running{false};
+    std::atomic<qint64> lastBeatMs{0};
+    std::atomic<const QThread*> watchedThread{nullptr};
+
+    // written by the watched thread only, read by the watchdog
+    std::array<std::atomic<const char*>, MAX_SCOPE_DEPTH> scopes;
+    std::atomic<int> depth{0};
+
+    QString logPath;
+    qint64 thresholdMs = DEFAULT_THRESHOLD_MS;
+    std::unique_ptr<QTimer> beatTimer;
+    std::unique_ptr<WatchThread> thread;
+    QSemaphore stopRequest;
+};
+
+class HitchScope
+{
+public:
+    explicit HitchScope(const char* name);
+    ~HitchScope();
+    HitchScope(const HitchScope&) = delete;
+    HitchScope& operator=(const HitchScope&) = delete;
+
+private:
+    bool entered;
+};
@@ -0,0 +1,176 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "util/diagnosticsregistry.h"
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#ifndef QTOX_LOCK_PROFILING
+#define QTOX_LOCK_PROFILING 0
+#endif
+
+class LockProfiler
+{
+public:
+    class Site
+    {
+    public:
+        Site(const char* lock_, const char* scope_);
+
+        void recordAcquire(qint64 waitNs, bool contended);
+        void recordRelease(qint64 holdNs);
+
+        const char* const lock;
+        const char* const scope;
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contentions{0};
+        std::atomic<uint64_t> waitNs{0};
+        std::atomic<uint64_t> maxWaitNs{0};
+        std::atomic<uint64_t> holdNs{0};
+        std::atomic<uint64_t> maxHoldNs{0};
+    };
+
+    LockProfiler();
+    LockProfiler(const LockProfiler&) = delete;
+    LockProfiler& operator=(const LockProfiler&) = delete;
+
+    static LockProfiler& getInstance();
+
+    Site& site(const char* lock, const char* scope);
+    qint64 nowNs() const;
+    void reset();
+    QString report() const;
+    QJsonObject toJson() const;
+
+    static constexpr int REPORT_INTERVAL_MS = 60 * 1000;
+    static constexpr int REPORT_TOP_SITES = 5;
+
+private:
+    QElapsedTimer clock;
+    mutable QMutex mutex;
+    std::vector<std::unique_ptr<Site>> sites;
+    DiagnosticsSource diagnostics;
+};
+
+namespace LockPolicy {
+struct Exclusive
+{
+    template <typename Lock>
+    static bool tryLock(Lock& lock)
+    {
+        return lock.tryLock();
+    }
+    template <typename Lock>
+    static void lock(Lock& lock)
+    {
+        lock.lock();
+    }
+};
+
+struct Read
+{
+    static bool tryLock(QReadWriteLock& lock)
+    {
+        return lock.tryLockForRead();
+    }
+    static void lock(QReadWriteLock& lock)
+    {
+        lock.lockForRead();
+    }
+};
+
+struct Write
+{
+    static bool tryLock(QReadWriteLock& lock)
+    {
+        return lock.tryLockForWrite();
+    }
+    static void lock(QReadWriteLock& lock)
+    {
+        lock.lockForWrite();
+    }
+};
+} // namespace LockPolicy
+
+template <typename Lock, typename Policy = LockPolicy::Exclusive>
+class ProfiledLocker
+{
+public:
+    ProfiledLocker(Lock* lock_, LockProfiler::Site& site_)
+        : lock{lock_}
+        , site{site_}
+    {
+        const LockProfiler& profiler = LockProfiler::getInstance();
+        const qint64 startNs = profiler.nowNs();
+        const bool contended = !Policy::tryLock(*lock);
+        if (contended) {
+            Policy::lock(*lock);
+        }
+        acquiredNs = profiler.nowNs();
+        site.recordAcquire(acquiredNs - startNs, contended);
+    }
+
+    ~ProfiledLocker()
+    {
+        site.recordRelease(LockProfiler::getInstance().nowNs() - acquiredNs);
+        lock->unlock();
+    }
+
+    ProfiledLocker(const ProfiledLocker&) = delete;
+    ProfiledLocker& operator=(const ProfiledLocker&) = delete;
+
+private:
+    Lock* lock;
+    LockProfiler::Site& site;
+    qint64 acquiredNs;
+};
+
+#if QTOX_LOCK_PROFILING
+#define QTOX_LOCK_CONCAT_INNER(a, b) a##b
+#define QTOX_LOCK_CONCAT(a, b) QTOX_LOCK_CONCAT_INNER(a, b)
+#define QTOX_LOCK_SITE QTOX_LOCK_CONCAT(lockSite, __LINE__)
+#define QTOX_PROFILED_LOCKER(var, lock, name, ...)                                        \
+    static LockProfiler::Site& QTOX_LOCK_SITE =                                           \
+        LockProfiler::getInstance().site(name, __func__);                                 \
+    const ProfiledLocker<__VA_ARGS__> var{lock, QTOX_LOCK_SITE}
+#define PROFILED_MUTEX_LOCKER(var, mutex, name)                                           \
+    QTOX_PROFILED_LOCKER(var, mutex, name, std::remove_pointer<decltype(mutex)>::type)
+#define PROFILED_READ_LOCKER(var, lock, name)                                             \
+    QTOX_PROFILED_LOCKER(var, lock, name, QReadWriteLock, LockPolicy::Read)
+#define PROFILED_WRITE_LOCKER(var, lock, name)                                            \
+    QTOX_PROFILED_LOCKER(var, lock, name, QReadWriteLock, LockPolicy::Write)
+#else
+#define PROFILED_MUTEX_LOCKER(var, mutex, name) QMutexLocker var{mutex}
+#define PROFILED_READ_LOCKER(var, lock, name) QReadLocker var{lock}
+#define PROFILED_WRITE_LOCKER(var, lock, name) QWriteLocker var{lock}
+#endif
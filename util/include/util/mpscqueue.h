@@ -0,0 +1,128 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * @brief Bounded lock-free queue for any number of producer threads and one consumer thread.
+ *
+ * Every slot carries a sequence number telling whether it is free for the producer of a given
+ * position or holds an item for the consumer, so producers only contend on a single atomic
+ * compare-and-swap and never block each other or the consumer. Pushing into a full queue fails
+ * instead of waiting.
+ *
+ * @tparam T Item type, must be default constructible and movable.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class MpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Producer side, may be called from any thread.
+     * @return False if the queue is full, the item is not queued then.
+     */
+    bool push(T item)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & MASK];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.item = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                // pos was updated by the failed exchange, try again with it
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Consumer side, must always be called from the same thread.
+     * @return False if no item is ready.
+     */
+    bool pop(T& item)
+    {
+        Slot& slot = slots[dequeuePos & MASK];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1) {
+            return false;
+        }
+
+        item = std::move(slot.item);
+        // don't keep e.g. shared data of the moved from item alive until the slot is reused
+        slot.item = T{};
+        slot.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    /**
+     * @brief Consumer side: true if no item is ready.
+     */
+    bool empty() const
+    {
+        const Slot& slot = slots[dequeuePos & MASK];
+        return slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence{0};
+        T item{};
+    };
+
+    std::array<Slot, Capacity> slots;
+    std::atomic<size_t> enqueuePos{0};
+    size_t dequeuePos = 0;
+};
@@ -0,0 +1,131 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer and one consumer thread.
+ *
+ * Slots are preallocated, so pushing and popping never allocate. The producer writes into the
+ * slot returned by producerSlot() and publishes it with commitPush(), the consumer reads the
+ * slot returned by consumerSlot() and releases it with commitPop(). One slot is always kept free
+ * to tell a full queue from an empty one, so at most Capacity - 1 items are queued.
+ *
+ * @tparam T Item type, should be cheap to overwrite.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Producer side: free slot to write the next item into.
+     * @return nullptr if the queue is full.
+     */
+    T* producerSlot()
+    {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        if (((head + 1) & MASK) == readIndex.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[head];
+    }
+
+    /**
+     * @brief Producer side: publish the slot returned by producerSlot().
+     */
+    void commitPush()
+    {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        writeIndex.store((head + 1) & MASK, std::memory_order_release);
+    }
+
+    bool push(const T& item)
+    {
+        T* slot = producerSlot();
+        if (!slot) {
+            return false;
+        }
+        *slot = item;
+        commitPush();
+        return true;
+    }
+
+    /**
+     * @brief Consumer side: oldest queued item.
+     * @return nullptr if the queue is empty.
+     */
+    T* consumerSlot()
+    {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[tail];
+    }
+
+    /**
+     * @brief Consumer side: release the slot returned by consumerSlot().
+     */
+    void commitPop()
+    {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        readIndex.store((tail + 1) & MASK, std::memory_order_release);
+    }
+
+    bool pop(T& item)
+    {
+        T* slot = consumerSlot();
+        if (!slot) {
+            return false;
+        }
+        item = *slot;
+        commitPop();
+        return true;
+    }
+
+    bool empty() const
+    {
+        return readIndex.load(std::memory_order_acquire)
+               == writeIndex.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity - 1;
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    std::array<T, Capacity> slots{};
+    std::atomic<size_t> writeIndex{0};
+    std::atomic<size_t> readIndex{0};
+};
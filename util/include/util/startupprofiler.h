@@ -0,0 +1,100 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+
+class StartupProfiler
+{
+public:
+    struct PhaseSummary
+    {
+        QString name;
+        qint64 firstStartUs;
+        qint64 totalUs;
+        int count;
+    };
+
+    static StartupProfiler& getInstance();
+
+    void enable(const QString& tracePath);
+    bool isEnabled() const;
+
+    qint64 elapsedUs() const;
+    void addPhase(const char* name, qint64 startUs, qint64 durationUs);
+    void addMark(const char* name);
+
+    QByteArray toJson() const;
+    bool write() const;
+    QVector<PhaseSummary> getPhaseSummary() const;
+
+    static constexpr int MAX_EVENTS = 100000;
+    static constexpr int MAX_SUMMARY_PHASES = 64;
+
+private:
+    StartupProfiler();
+
+    struct Event
+    {
+        const char* name;
+        char type;
+        qint64 startUs;
+        qint64 durationUs;
+        int threadId;
+    };
+
+    void addEvent(const Event& event);
+    void addToSummary(const char* name, qint64 startUs, qint64 durationUs);
+
+private:
+    QElapsedTimer clock;
+    std::atomic<bool> enabled{false};
+    mutable QMutex mutex;
+    QString path;
+    QVector<Event> events;
+    QHash<const QThread*, int> threadIds;
+    QVector<QString> threadNames;
+    // kept even when recording is off, phase names are string literals
+    QVector<const char*> summaryNames;
+    QVector<PhaseSummary> summary;
+};
+
+class StartupPhase
+{
+public:
+    explicit StartupPhase(const char* name_);
+    ~StartupPhase();
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+    const char* name;
+    qint64 startUs;
+};
@@ -0,0 +1,40 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+class ThreadScheduling
+{
+public:
+    enum class Class
+    {
+        Normal,
+        Background,
+        Interactive,
+        RealtimeAudio
+    };
+
+    static bool setCurrentThreadClass(Class schedulingClass);
+    static Class getCurrentThreadClass();
+
+    static constexpr int REALTIME_PRIORITY = 10;
+    static constexpr int INTERACTIVE_NICE = -5;
+    static constexpr int BACKGROUND_NICE = 10;
+};
@@ -53,6 +53,7 @@ namespace ToxcoreErrorParser {
     bool parseErr(Tox_Err_Get_Port error, int line);
     bool parseErr(Tox_Err_File_Control error, int line);
     bool parseErr(Tox_Err_File_Get error, int line);
+    bool parseErr(Tox_Err_File_Seek error, int line);
     bool parseErr(Tox_Err_File_Send error, int line);
     bool parseErr(Tox_Err_File_Send_Chunk error, int line);
     bool parseErr(Toxav_Err_Bit_Rate_Set error, int line);
@@ -0,0 +1,106 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef QTOX_TRACING
+#define QTOX_TRACING 0
+#endif
+
+class Tracer
+{
+public:
+    Tracer();
+    ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static Tracer& getInstance();
+
+    void enable(const QString& tracePath);
+    bool isEnabled() const;
+
+    qint64 nowUs() const;
+    void addSpan(const char* name, qint64 beginUs, qint64 endUs);
+
+    QByteArray toJson() const;
+    bool write() const;
+
+    static constexpr size_t EVENTS_PER_THREAD = 8192;
+
+private:
+    struct Event
+    {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<qint64> beginUs{0};
+        std::atomic<qint64> endUs{0};
+    };
+
+    struct ThreadBuffer
+    {
+        std::thread::id owner;
+        int threadId;
+        QString threadName;
+        std::atomic<uint64_t> written{0};
+        std::array<Event, EVENTS_PER_THREAD> events;
+    };
+
+    ThreadBuffer& localBuffer();
+
+private:
+    const uint64_t generation;
+    QElapsedTimer clock;
+    std::atomic<bool> enabled{false};
+    mutable QMutex mutex;
+    QString path;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name_);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    qint64 beginUs;
+};
+
+#if QTOX_TRACING
+#define QTOX_TRACE_CONCAT_INNER(a, b) a##b
+#define QTOX_TRACE_CONCAT(a, b) QTOX_TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) const TraceScope QTOX_TRACE_CONCAT(traceScope, __LINE__){name}
+#else
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#endif
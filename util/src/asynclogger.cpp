@@ -0,0 +1,364 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/asynclogger.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTime>
+
+#include <cstring>
+
+/**
+ * @class AsyncLogger
+ * @brief Writes log messages to stderr and the log file on a background thread.
+ *
+ * The Qt message handler runs on whichever thread logs, including the tox and audio threads.
+ * log() only copies the message into a compact record and pushes it into a lock-free queue, the
+ * logger thread then drops known noise, formats the line and does the blocking writes. If the
+ * queue is full, messages are dropped and the number of dropped messages is logged later.
+ *
+ * Until startLogging() is called and after stop() messages are written synchronously.
+ * Fatal messages are always written synchronously, after the queue was flushed, because the
+ * application aborts right after logging them.
+ *
+ * Disabled log levels are filtered by QLoggingCategory before a message is even formatted, use
+ * setLogLevels() to change them at runtime.
+ */
+
+constexpr size_t AsyncLogger::QUEUE_SIZE;
+constexpr size_t AsyncLogger::FILE_NAME_SIZE;
+constexpr int AsyncLogger::FLUSH_TIMEOUT_MS;
+
+namespace {
+/**
+ * @brief Returns true for messages that should never end up in the log.
+ */
+bool isFilteredMessage(QtMsgType type, const QString& msg)
+{
+    if (msg.startsWith(QLatin1String("Unable to find any suggestion for"))) {
+        // Prevent sonnet's complaints from leaking user chat messages to logs
+        return true;
+    }
+
+    if (msg == QLatin1String("attempted to send message with network family 10 (probably IPv6) on IPv4 socket")) {
+        // non-stop c-toxcore spam for IPv4 users: https://github.com/TokTok/c-toxcore/issues/1432
+        return true;
+    }
+
+    // snorenotify logs this when we call requestCloseNotification correctly. The behaviour still works, so we'll
+    // just mask the warning for now. The issue has been reported upstream:
+    // https://github.com/qTox/qTox/pull/6073#pullrequestreview-420748519
+    static const QRegularExpression snoreFilter{QStringLiteral("Snore::Notification.*was already closed")};
+    return type == QtWarningMsg && msg.contains(snoreFilter);
+}
+
+const char* typeName(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+        return "Debug";
+    case QtInfoMsg:
+        return "Info";
+    case QtWarningMsg:
+        return "Warning";
+    case QtCriticalMsg:
+        return "Critical";
+    case QtFatalMsg:
+        return "Fatal";
+    }
+    return "";
+}
+
+/**
+ * @brief Message types that are disabled by a log level, from least to most severe.
+ */
+const char* const disabledTypes[] = {"debug", "info", "warning", "critical"};
+const char* const levelNames[] = {"debug", "info", "warning", "critical", "off"};
+} // namespace
+
+/**
+ * @brief The logger is intentionally leaked, messages may still be logged during static
+ * destruction.
+ */
+AsyncLogger& AsyncLogger::getInstance()
+{
+    static AsyncLogger* logger = new AsyncLogger();
+    return *logger;
+}
+
+/**
+ * @brief Queues a log message, may be called from any thread.
+ * @param type Message type.
+ * @param file Source file, copied and shortened to its last FILE_NAME_SIZE - 1 characters.
+ * @param line Source line.
+ * @param msg Message text, not copied thanks to implicit sharing.
+ */
+void AsyncLogger::log(QtMsgType type, const char* file, int line, const QString& msg)
+{
+    Record record;
+    record.type = type;
+    record.line = line;
+    record.timeMs = QDateTime::currentMSecsSinceEpoch();
+    if (file) {
+        // keep the end of long paths, that's where the file name is
+        const size_t length = strlen(file);
+        if (length >= FILE_NAME_SIZE) {
+            file += length - (FILE_NAME_SIZE - 1);
+        }
+        qstrncpy(record.file.data(), file, FILE_NAME_SIZE);
+    }
+    record.msg = msg;
+
+    if (type == QtFatalMsg || !running.load(std::memory_order_acquire)) {
+        flush();
+        write(record);
+        return;
+    }
+
+    if (!queue.push(std::move(record))) {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    queuedMessages.fetch_add(1, std::memory_order_release);
+    if (consumerWaiting.exchange(false)) {
+        wakeup.release();
+    }
+}
+
+/**
+ * @brief Starts the logger thread.
+ * @param bufferForFile_ Keep all messages in memory until setLogFile() is called, so that they
+ * can still be written to the log file once it is open.
+ */
+void AsyncLogger::startLogging(bool bufferForFile_)
+{
+    {
+        QMutexLocker locker{&writeMutex};
+        bufferForFile = bufferForFile_;
+    }
+
+    if (running.exchange(true)) {
+        return;
+    }
+
+    setObjectName("qTox Logger");
+    start();
+}
+
+/**
+ * @brief Sets the file messages are written to, in addition to stderr.
+ * @param file Opened file, or nullptr to stop writing to a file.
+ * @return The previous file, the caller must close it.
+ *
+ * Messages buffered since startLogging() are written to the new file first.
+ */
+FILE* AsyncLogger::setLogFile(FILE* file)
+{
+    QMutexLocker locker{&writeMutex};
+    FILE* previous = logFile;
+    logFile = file;
+
+    if (bufferForFile) {
+        if (logFile) {
+            for (const QByteArray& bufferedMsg : fileBuffer) {
+                fwrite(bufferedMsg.constData(), 1, bufferedMsg.size(), logFile);
+            }
+            fflush(logFile);
+        }
+        fileBuffer.clear();
+        bufferForFile = false;
+    }
+
+    return previous;
+}
+
+/**
+ * @brief Waits until the logger thread wrote everything queued before this call.
+ */
+void AsyncLogger::flush()
+{
+    if (!running.load(std::memory_order_acquire) || QThread::currentThread() == this) {
+        return;
+    }
+
+    const uint64_t target = queuedMessages.load(std::memory_order_acquire);
+    QElapsedTimer timer;
+    timer.start();
+    while (handledMessages.load(std::memory_order_acquire) < target
+           && timer.elapsed() < FLUSH_TIMEOUT_MS) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+/**
+ * @brief Writes the remaining messages and stops the logger thread, later messages are written
+ * synchronously.
+ */
+void AsyncLogger::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    wakeup.release();
+    wait();
+    // messages pushed while the thread was finishing
+    drain();
+}
+
+uint64_t AsyncLogger::getDroppedMessages() const
+{
+    return droppedMessages.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Changes the enabled log levels per logging category.
+ * @param levels Comma separated list of "<category>=<level>" pairs, level being one of debug,
+ * info, warning, critical or off. Messages less severe than the level are disabled. Categories
+ * may use wildcards like QLoggingCategory rules, e.g. "qtox.core.*=warning".
+ * @return False if levels couldn't be parsed, nothing is changed then.
+ */
+bool AsyncLogger::setLogLevels(const QString& levels)
+{
+    QStringList rules;
+    for (const QString& entry : levels.split(',')) {
+        if (entry.trimmed().isEmpty()) {
+            continue;
+        }
+
+        const int separator = entry.indexOf('=');
+        const QString category = entry.left(separator).trimmed();
+        const QString level = entry.mid(separator + 1).trimmed().toLower();
+        if (separator < 0 || category.isEmpty()) {
+            return false;
+        }
+
+        int disabledCount = -1;
+        for (size_t i = 0; i < sizeof(levelNames) / sizeof(levelNames[0]); ++i) {
+            if (level == QLatin1String(levelNames[i])) {
+                disabledCount = static_cast<int>(i);
+            }
+        }
+        if (disabledCount < 0) {
+            return false;
+        }
+
+        for (int i = 0; i < static_cast<int>(sizeof(disabledTypes) / sizeof(disabledTypes[0])); ++i) {
+            rules << QStringLiteral("%1.%2=%3")
+                         .arg(category, QLatin1String(disabledTypes[i]),
+                              i < disabledCount ? QStringLiteral("false") : QStringLiteral("true"));
+        }
+    }
+
+    QLoggingCategory::setFilterRules(rules.join('\n'));
+    return true;
+}
+
+void AsyncLogger::run()
+{
+    while (true) {
+        drain();
+        if (!running.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        consumerWaiting.store(true);
+        if (!queue.empty() || !running.load(std::memory_order_acquire)) {
+            consumerWaiting.store(false);
+            continue;
+        }
+        wakeup.acquire();
+        consumerWaiting.store(false);
+    }
+}
+
+/**
+ * @brief Consumer side: writes all queued messages.
+ */
+void AsyncLogger::drain()
+{
+    Record record;
+    bool wrote = false;
+    while (queue.pop(record)) {
+        write(record);
+        wrote = true;
+        handledMessages.fetch_add(1, std::memory_order_release);
+    }
+
+    const uint64_t dropped = droppedMessages.load(std::memory_order_relaxed);
+    if (dropped != reportedDropped) {
+        Record warning;
+        warning.type = QtWarningMsg;
+        warning.timeMs = QDateTime::currentMSecsSinceEpoch();
+        qstrncpy(warning.file.data(), "asynclogger.cpp", FILE_NAME_SIZE);
+        warning.line = __LINE__;
+        warning.msg = QStringLiteral("%1 log messages were dropped, the queue was full")
+                          .arg(dropped - reportedDropped);
+        reportedDropped = dropped;
+        write(warning);
+        wrote = true;
+    }
+
+    if (wrote) {
+        // the logger thread flushes the log file once per batch instead of once per line
+        QMutexLocker locker{&writeMutex};
+        if (logFile) {
+            fflush(logFile);
+        }
+    }
+}
+
+void AsyncLogger::write(const Record& record)
+{
+    if (isFilteredMessage(record.type, record.msg)) {
+        return;
+    }
+
+    // Time should be in UTC to save user privacy on log sharing
+    const QTime time = QDateTime::fromMSecsSinceEpoch(record.timeMs, Qt::UTC).time();
+    // a single arg() call, so that placeholders in the message itself are left alone
+    const QString logMsg = QStringLiteral("[%1 UTC] %2:%3 : %4: %5\n")
+                               .arg(time.toString("HH:mm:ss.zzz"),
+                                    QString::fromUtf8(record.file.data()),
+                                    QString::number(record.line),
+                                    QLatin1String(typeName(record.type)), record.msg);
+    writeLine(logMsg.toUtf8());
+}
+
+void AsyncLogger::writeLine(const QByteArray& line)
+{
+    QMutexLocker locker{&writeMutex};
+    fwrite(line.constData(), 1, line.size(), stderr);
+
+    if (logFile) {
+        fwrite(line.constData(), 1, line.size(), logFile);
+        if (!running.load(std::memory_order_relaxed) || QThread::currentThread() != this) {
+            fflush(logFile);
+        }
+    } else if (bufferForFile) {
+        fileBuffer.append(line);
+    }
+}
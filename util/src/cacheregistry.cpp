@@ -0,0 +1,320 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/cacheregistry.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+#include <map>
+
+/**
+ * @class CacheRegistry
+ * @brief Keeps the memory used by all in-memory caches within a global budget.
+ *
+ * Every RegisteredCache reports how many bytes and entries it holds and can be asked to shrink.
+ * Once a budget is set, the registry checks the total every CHECK_INTERVAL_MS and trims the least
+ * recently used caches first until the total fits again. Caches may keep entries that are still
+ * in use, so the budget is a target, not a hard limit.
+ *
+ * In low memory mode, see setLowMemory(), caches and the code filling them also keep less on
+ * their own, e.g. fewer rendered chat lines or cached chat forms.
+ *
+ * @note Caches are queried and trimmed on the thread that set the budget, usually the GUI thread,
+ * so they should be created and destroyed there too. Caches that are used on other threads must
+ * make getCacheUsage() and trimCache() thread safe.
+ */
+
+/**
+ * @class RegisteredCache
+ * @brief Base of caches accounted for by the CacheRegistry.
+ *
+ * Registers itself on construction and unregisters on destruction. Subclasses call
+ * markCacheUsed() when an entry is looked up, which decides the order caches are trimmed in.
+ */
+
+/**
+ * @var CacheRegistry::DEFAULT_BUDGET
+ * @brief Budget used unless the user chose another one.
+ *
+ * @var CacheRegistry::LOW_MEMORY_BUDGET
+ * @brief Budget of the low memory preset.
+ */
+
+constexpr qint64 CacheRegistry::DEFAULT_BUDGET;
+constexpr qint64 CacheRegistry::LOW_MEMORY_BUDGET;
+constexpr int CacheRegistry::CHECK_INTERVAL_MS;
+
+namespace {
+QString formatBytes(qint64 bytes)
+{
+    if (bytes < 1024 * 1024) {
+        return QStringLiteral("%1 KiB").arg(bytes / 1024);
+    }
+
+    return QStringLiteral("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+} // namespace
+
+CacheRegistry::CacheRegistry() = default;
+
+CacheRegistry::~CacheRegistry() = default;
+
+/**
+ * @brief Returns the registry all caches register in by default.
+ */
+CacheRegistry& CacheRegistry::getInstance()
+{
+    static CacheRegistry instance;
+    return instance;
+}
+
+/**
+ * @brief Sets the budget of all caches combined and trims them right away if needed.
+ * @param bytes Budget in bytes, 0 for no budget.
+ */
+void CacheRegistry::setBudget(qint64 bytes)
+{
+    const qint64 newBudget = std::max<qint64>(bytes, 0);
+    {
+        QMutexLocker locker{&mutex};
+        budget = newBudget;
+    }
+
+    if (newBudget == 0) {
+        checkTimer.reset();
+        return;
+    }
+
+    if (!checkTimer) {
+        checkTimer.reset(new QTimer);
+        checkTimer->setInterval(CHECK_INTERVAL_MS);
+        QObject::connect(checkTimer.get(), &QTimer::timeout, [this] { enforceBudget(); });
+        checkTimer->start();
+    }
+
+    enforceBudget();
+}
+
+qint64 CacheRegistry::getBudget() const
+{
+    QMutexLocker locker{&mutex};
+    return budget;
+}
+
+/**
+ * @brief Switches the low memory mode, which the owners of caches look up with isLowMemory().
+ * @param enabled True if the user asked for it or the OS runs low on memory.
+ * @note Set the matching budget with setBudget() too, this doesn't change it.
+ */
+void CacheRegistry::setLowMemory(bool enabled)
+{
+    lowMemory = enabled;
+}
+
+/**
+ * @brief Whether caches should stay well below their usual limits.
+ * @note Thread safe.
+ */
+bool CacheRegistry::isLowMemory() const
+{
+    return lowMemory;
+}
+
+/**
+ * @brief Trims the least recently used caches until all of them fit into the budget.
+ * @return Number of bytes freed.
+ */
+qint64 CacheRegistry::enforceBudget()
+{
+    QMutexLocker locker{&mutex};
+    if (budget == 0) {
+        return 0;
+    }
+
+    struct Candidate
+    {
+        RegisteredCache* cache;
+        uint64_t lastUse;
+        qint64 bytes;
+    };
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(caches.size());
+    qint64 total = 0;
+    for (RegisteredCache* cache : caches) {
+        const qint64 bytes = cache->getCacheUsage().bytes;
+        candidates.push_back({cache, cache->getLastUse(), bytes});
+        total += bytes;
+    }
+
+    if (total <= budget) {
+        return 0;
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.lastUse < b.lastUse; });
+
+    qint64 freed = 0;
+    for (const Candidate& candidate : candidates) {
+        const qint64 excess = total - freed - budget;
+        if (excess <= 0) {
+            break;
+        }
+
+        if (candidate.bytes == 0) {
+            continue;
+        }
+
+        candidate.cache->trimCache(std::max<qint64>(candidate.bytes - excess, 0));
+        freed += candidate.bytes - candidate.cache->getCacheUsage().bytes;
+    }
+
+    qDebug() << "Trimmed caches by" << freed << "bytes from" << total << "to stay within the budget of"
+             << budget << "bytes";
+    return freed;
+}
+
+/**
+ * @brief Returns the usage of all caches, instances with the same name are summed up.
+ * @return Usage sorted by size, largest first.
+ */
+std::vector<CacheRegistry::Usage> CacheRegistry::getUsage() const
+{
+    std::map<QString, Usage> byName;
+    {
+        QMutexLocker locker{&mutex};
+        for (const RegisteredCache* cache : caches) {
+            const QString name = QString::fromLatin1(cache->getCacheName());
+            const RegisteredCache::Usage usage = cache->getCacheUsage();
+            auto itr = byName.find(name);
+            if (itr == byName.end()) {
+                byName.emplace(name, Usage{name, usage.bytes, usage.entries, 1});
+            } else {
+                itr->second.bytes += usage.bytes;
+                itr->second.entries += usage.entries;
+                ++itr->second.instances;
+            }
+        }
+    }
+
+    std::vector<Usage> result;
+    result.reserve(byName.size());
+    for (const auto& entry : byName) {
+        result.push_back(entry.second);
+    }
+
+    std::stable_sort(result.begin(), result.end(),
+                     [](const Usage& a, const Usage& b) { return a.bytes > b.bytes; });
+    return result;
+}
+
+/**
+ * @brief Human readable breakdown of the memory used by all caches.
+ */
+QString CacheRegistry::report() const
+{
+    const std::vector<Usage> usage = getUsage();
+    qint64 total = 0;
+    QStringList lines;
+    for (const Usage& cache : usage) {
+        total += cache.bytes;
+        QString line = QStringLiteral("%1: %2 in %3 entries")
+                           .arg(cache.name, formatBytes(cache.bytes))
+                           .arg(cache.entries);
+        if (cache.instances > 1) {
+            line += QStringLiteral(" (%1 instances)").arg(cache.instances);
+        }
+        lines << line;
+    }
+
+    const qint64 currentBudget = getBudget();
+    const QString budgetText =
+        currentBudget == 0 ? QStringLiteral("unlimited") : formatBytes(currentBudget);
+    lines.prepend(QStringLiteral("total: %1 of %2").arg(formatBytes(total), budgetText));
+    return lines.join('\n');
+}
+
+void CacheRegistry::add(RegisteredCache* cache)
+{
+    QMutexLocker locker{&mutex};
+    caches.push_back(cache);
+}
+
+void CacheRegistry::remove(RegisteredCache* cache)
+{
+    QMutexLocker locker{&mutex};
+    caches.erase(std::remove(caches.begin(), caches.end(), cache), caches.end());
+}
+
+uint64_t CacheRegistry::nextUse()
+{
+    return useCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+/**
+ * @brief Registers the cache.
+ * @param name_ Shown in the report, caches with the same name are reported together. Must
+ * outlive the cache, use string literals.
+ * @param registry_ Registry accounting for this cache.
+ */
+RegisteredCache::RegisteredCache(const char* name_, CacheRegistry& registry_)
+    : name{name_}
+    , registry{registry_}
+{
+    registry.add(this);
+}
+
+RegisteredCache::~RegisteredCache()
+{
+    registry.remove(this);
+}
+
+const char* RegisteredCache::getCacheName() const
+{
+    return name;
+}
+
+/**
+ * @brief Returns when the cache was last used, compared to other caches of the registry.
+ */
+uint64_t RegisteredCache::getLastUse() const
+{
+    return lastUse.load(std::memory_order_relaxed);
+}
+
+/**
+ * @fn RegisteredCache::Usage RegisteredCache::getCacheUsage() const
+ * @brief Returns the memory used by the cache, estimates are fine.
+ *
+ * @fn void RegisteredCache::trimCache(qint64 maxBytes)
+ * @brief Drops entries until the cache uses at most maxBytes, if it can.
+ * @note Must not create or destroy registered caches.
+ */
+
+/**
+ * @brief Marks the cache as recently used, cheap enough to call on every lookup.
+ */
+void RegisteredCache::markCacheUsed() const
+{
+    lastUse.store(registry.nextUse(), std::memory_order_relaxed);
+}
@@ -0,0 +1,194 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/diagnosticsregistry.h"
+#include "util/cacheregistry.h"
+#include "util/startupprofiler.h"
+#include "util/threadcputime.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+/**
+ * @class DiagnosticsRegistry
+ * @brief Collects the runtime statistics of all subsystems into one JSON report.
+ *
+ * Thread CPU times, startup phase durations and cache usage are always part of the report.
+ * Everything else is contributed by a DiagnosticsSource, e.g. the loop timing of every
+ * LoopStats or the transaction latency of the database. Sources sharing a section name are
+ * collected into one JSON array under that name, so the report keeps the same layout no matter
+ * how many instances exist.
+ *
+ * The report is meant to be attached to bug reports, so sources must leave out anything
+ * identifying the user or their contacts: no names, public keys, file names or paths. Refer to
+ * contacts by their position in the report instead.
+ *
+ * @note collect() runs every collector on the calling thread, usually the GUI thread, with the
+ * registry locked. Collectors must be thread safe and must not wait for locks that are held
+ * while a DiagnosticsSource is destroyed.
+ */
+
+/**
+ * @class DiagnosticsSource
+ * @brief Adds a section to the DiagnosticsRegistry report while it exists.
+ *
+ * The collector is called by DiagnosticsRegistry::collect() until the source is destroyed, so
+ * make the source the last member of its owner, then it is gone before the data it reads.
+ */
+
+/**
+ * @var DiagnosticsRegistry::FORMAT_VERSION
+ * @brief Increased whenever a field of the report changes meaning or is removed.
+ */
+constexpr int DiagnosticsRegistry::FORMAT_VERSION;
+
+namespace {
+QJsonObject collectThreads()
+{
+    QJsonArray threads;
+    for (const ThreadCpuTime::Sample& sample : ThreadCpuTime::sample()) {
+        threads.append(QJsonObject{{"name", sample.name}, {"cpuMs", sample.cpuNs / 1000000}});
+    }
+
+    return QJsonObject{{"threadClocks", ThreadCpuTime::hasThreadClocks()},
+                       {"processCpuMs", ThreadCpuTime::processNs() / 1000000},
+                       {"threads", threads}};
+}
+
+QJsonObject collectStartup()
+{
+    QJsonArray phases;
+    for (const StartupProfiler::PhaseSummary& phase :
+         StartupProfiler::getInstance().getPhaseSummary()) {
+        phases.append(QJsonObject{{"name", phase.name},
+                                  {"firstStartMs", phase.firstStartUs / 1000.0},
+                                  {"totalMs", phase.totalUs / 1000.0},
+                                  {"count", phase.count}});
+    }
+
+    return QJsonObject{{"phases", phases}};
+}
+
+QJsonObject collectCaches()
+{
+    const CacheRegistry& registry = CacheRegistry::getInstance();
+    QJsonArray caches;
+    for (const CacheRegistry::Usage& usage : registry.getUsage()) {
+        caches.append(QJsonObject{{"name", usage.name},
+                                  {"bytes", usage.bytes},
+                                  {"entries", usage.entries},
+                                  {"instances", usage.instances}});
+    }
+
+    return QJsonObject{{"budgetBytes", registry.getBudget()},
+                       {"lowMemory", registry.isLowMemory()},
+                       {"caches", caches}};
+}
+} // namespace
+
+DiagnosticsRegistry::DiagnosticsRegistry() = default;
+
+/**
+ * @brief Returns the registry all sources register in by default.
+ */
+DiagnosticsRegistry& DiagnosticsRegistry::getInstance()
+{
+    static DiagnosticsRegistry instance;
+    return instance;
+}
+
+/**
+ * @brief Builds the report.
+ * @return One key per section, registered sections hold an array with one object per source.
+ */
+QJsonObject DiagnosticsRegistry::collect() const
+{
+    QJsonObject report;
+    report["formatVersion"] = FORMAT_VERSION;
+    report["uptimeMs"] = StartupProfiler::getInstance().elapsedUs() / 1000;
+    report["threads"] = collectThreads();
+    report["startup"] = collectStartup();
+    report["caches"] = collectCaches();
+
+    QMutexLocker locker{&mutex};
+    for (const DiagnosticsSource* source : sources) {
+        const QString section = QString::fromLatin1(source->getSection());
+        QJsonArray entries = report.value(section).toArray();
+        entries.append(source->collect());
+        report[section] = entries;
+    }
+
+    return report;
+}
+
+/**
+ * @brief Builds the report as an indented JSON document, for display and export.
+ */
+QByteArray DiagnosticsRegistry::toJson() const
+{
+    return QJsonDocument(collect()).toJson(QJsonDocument::Indented);
+}
+
+void DiagnosticsRegistry::add(const DiagnosticsSource* source)
+{
+    QMutexLocker locker{&mutex};
+    sources.push_back(source);
+}
+
+void DiagnosticsRegistry::remove(const DiagnosticsSource* source)
+{
+    QMutexLocker locker{&mutex};
+    sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+}
+
+/**
+ * @param section Key of the report the collected object is added to, must be a string literal
+ * and must not be one of the built in sections "threads", "startup" or "caches".
+ * @param collector Returns the current state of the owner, without identifying data.
+ * @param registry Registry to add the section to.
+ */
+DiagnosticsSource::DiagnosticsSource(const char* section_, Collector collector_,
+                                     DiagnosticsRegistry& registry_)
+    : section{section_}
+    , collector{std::move(collector_)}
+    , registry{registry_}
+{
+    registry.add(this);
+}
+
+/**
+ * @brief Unregisters, waiting for a running collect() to finish.
+ */
+DiagnosticsSource::~DiagnosticsSource()
+{
+    registry.remove(this);
+}
+
+const char* DiagnosticsSource::getSection() const
+{
+    return section;
+}
+
+QJsonObject DiagnosticsSource::collect() const
+{
+    return collector();
+}
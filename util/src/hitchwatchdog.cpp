@@ -0,0 +1,273 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/hitchwatchdog.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+
+/**
+ * @class HitchWatchdog
+ * @brief Detects when the GUI event loop stops processing events and logs what it was doing.
+ *
+ * A timer on the watched thread, usually the GUI thread, records a heartbeat every
+ * BEAT_INTERVAL_MS. A separate thread checks the heartbeat, and if it is older than the
+ * threshold, samples the HitchScopes active on the watched thread until the heartbeat returns.
+ * Each hitch is then appended to a log file with its duration and the scopes seen, e.g.
+ * "chat layout > smiley pack load". The log is rotated once it grows over MAX_LOG_SIZE.
+ *
+ * Scopes are plain atomic stores of string literals, so they cost next to nothing and are
+ * ignored on other threads and while the watchdog isn't running.
+ */
+
+/**
+ * @class HitchScope
+ * @brief Marks a scope on the GUI thread that the HitchWatchdog reports when it hitches.
+ *
+ * @note The name must outlive the watchdog, use string literals.
+ */
+
+/**
+ * @var HitchWatchdog::BEAT_INTERVAL_MS
+ * @brief How often the watched event loop records its heartbeat, limits the precision.
+ *
+ * @var HitchWatchdog::MAX_SCOPE_DEPTH
+ * @brief Deeper nested scopes are counted, but not reported.
+ *
+ * @var HitchWatchdog::MAX_SCOPE_SAMPLES
+ * @brief Number of different scope stacks reported for a single hitch.
+ */
+
+constexpr qint64 HitchWatchdog::DEFAULT_THRESHOLD_MS;
+constexpr qint64 HitchWatchdog::BEAT_INTERVAL_MS;
+constexpr int HitchWatchdog::MAX_SCOPE_DEPTH;
+constexpr int HitchWatchdog::MAX_SCOPE_SAMPLES;
+constexpr qint64 HitchWatchdog::MAX_LOG_SIZE;
+
+class HitchWatchdog::WatchThread : public QThread
+{
+public:
+    explicit WatchThread(HitchWatchdog& watchdog_)
+        : watchdog{watchdog_}
+    {
+        setObjectName(QStringLiteral("qTox HitchWatchdog"));
+    }
+
+protected:
+    void run() override
+    {
+        watchdog.watch();
+    }
+
+private:
+    HitchWatchdog& watchdog;
+};
+
+HitchWatchdog::HitchWatchdog()
+{
+    for (auto& scope : scopes) {
+        scope = nullptr;
+    }
+    clock.start();
+}
+
+HitchWatchdog::~HitchWatchdog()
+{
+    stop();
+}
+
+HitchWatchdog& HitchWatchdog::getInstance()
+{
+    static HitchWatchdog watchdog;
+    return watchdog;
+}
+
+/**
+ * @brief Starts watching the calling thread's event loop.
+ * @param logPath_ File the hitches are appended to.
+ * @param thresholdMs_ The event loop not running for longer is a hitch.
+ */
+void HitchWatchdog::start(const QString& logPath_, qint64 thresholdMs_)
+{
+    if (running) {
+        return;
+    }
+
+    logPath = logPath_;
+    thresholdMs = std::max(thresholdMs_, 2 * BEAT_INTERVAL_MS);
+    lastBeatMs = clock.elapsed();
+    watchedThread = QThread::currentThread();
+
+    beatTimer = std::unique_ptr<QTimer>(new QTimer());
+    beatTimer->setInterval(static_cast<int>(BEAT_INTERVAL_MS));
+    QObject::connect(beatTimer.get(), &QTimer::timeout, [this]() { lastBeatMs = clock.elapsed(); });
+    beatTimer->start();
+
+    running = true;
+    thread = std::unique_ptr<WatchThread>(new WatchThread(*this));
+    thread->start(QThread::LowPriority);
+    qDebug() << "Watching the GUI thread for hitches over" << thresholdMs << "ms";
+}
+
+/**
+ * @brief Stops watching, must be called from the watched thread.
+ */
+void HitchWatchdog::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    stopRequest.release();
+    thread->wait();
+    thread.reset();
+    beatTimer.reset();
+    watchedThread = nullptr;
+    // don't leave a request behind for the next start()
+    stopRequest.tryAcquire(stopRequest.available());
+}
+
+bool HitchWatchdog::isRunning() const
+{
+    return running;
+}
+
+/**
+ * @brief True if running and called from the watched thread, scopes are only tracked then.
+ */
+bool HitchWatchdog::isWatching() const
+{
+    return running && QThread::currentThread() == watchedThread;
+}
+
+/**
+ * @brief Pushes a scope, usually through HitchScope.
+ * @param name Scope name, must outlive the watchdog.
+ * @note Only call from the watched thread.
+ */
+void HitchWatchdog::enterScope(const char* name)
+{
+    const int index = depth.load(std::memory_order_relaxed);
+    if (index < MAX_SCOPE_DEPTH) {
+        scopes[index].store(name, std::memory_order_relaxed);
+    }
+    depth.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Pops the innermost scope.
+ * @note Only call from the watched thread.
+ */
+void HitchWatchdog::leaveScope()
+{
+    const int index = depth.load(std::memory_order_relaxed) - 1;
+    if (index < 0) {
+        return;
+    }
+
+    depth.store(index, std::memory_order_release);
+}
+
+/**
+ * @brief Describes the scopes active on the watched thread.
+ * @return Outermost first, e.g. "history load > chat layout", or "no scope".
+ */
+QString HitchWatchdog::activeScopes() const
+{
+    const int count = std::min(depth.load(std::memory_order_acquire), MAX_SCOPE_DEPTH);
+    QStringList names;
+    for (int i = 0; i < count; ++i) {
+        const char* name = scopes[i].load(std::memory_order_relaxed);
+        names << (name ? QString::fromLatin1(name) : QStringLiteral("?"));
+    }
+
+    return names.isEmpty() ? QStringLiteral("no scope") : names.join(QStringLiteral(" > "));
+}
+
+void HitchWatchdog::watch()
+{
+    const qint64 checkIntervalMs = std::max<qint64>(BEAT_INTERVAL_MS, thresholdMs / 4);
+    bool hitching = false;
+    qint64 hitchStartMs = 0;
+    QStringList seenScopes;
+
+    while (!stopRequest.tryAcquire(1, static_cast<int>(checkIntervalMs))) {
+        const qint64 beatMs = lastBeatMs;
+        if (clock.elapsed() - beatMs > thresholdMs) {
+            if (!hitching) {
+                hitching = true;
+                hitchStartMs = beatMs;
+                seenScopes.clear();
+            }
+
+            const QString active = activeScopes();
+            if (!seenScopes.contains(active) && seenScopes.size() < MAX_SCOPE_SAMPLES) {
+                seenScopes << active;
+            }
+        } else if (hitching) {
+            hitching = false;
+            writeHitch(beatMs - hitchStartMs, seenScopes);
+        }
+    }
+}
+
+void HitchWatchdog::writeHitch(qint64 durationMs, const QStringList& hitchScopes) const
+{
+    const QString line = QStringLiteral("%1 GUI blocked for %2 ms in %3\n")
+                             .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+                             .arg(durationMs)
+                             .arg(hitchScopes.join(QStringLiteral(", ")));
+    qWarning().noquote() << line.trimmed();
+
+    if (logPath.isEmpty()) {
+        return;
+    }
+
+    if (QFileInfo(logPath).size() > MAX_LOG_SIZE) {
+        const QString rotated = logPath + QStringLiteral(".1");
+        QFile::remove(rotated);
+        QFile::rename(logPath, rotated);
+    }
+
+    QFile file{logPath};
+    if (!file.open(QIODevice::Append | QIODevice::Text) || file.write(line.toUtf8()) < 0) {
+        qWarning() << "Failed to write the hitch log" << logPath;
+    }
+}
+
+HitchScope::HitchScope(const char* name)
+    : entered{HitchWatchdog::getInstance().isWatching()}
+{
+    if (entered) {
+        HitchWatchdog::getInstance().enterScope(name);
+    }
+}
+
+HitchScope::~HitchScope()
+{
+    if (entered) {
+        HitchWatchdog::getInstance().leaveScope();
+    }
+}
@@ -0,0 +1,248 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/lockprofiler.h"
+
+#include <QJsonArray>
+#include <QStringList>
+
+#include <algorithm>
+#include <map>
+
+/**
+ * @class LockProfiler
+ * @brief Records how long threads wait for and hold the core locks, broken down by call site.
+ *
+ * Locks are profiled by taking them with PROFILED_MUTEX_LOCKER, PROFILED_READ_LOCKER or
+ * PROFILED_WRITE_LOCKER instead of QMutexLocker, QReadLocker or QWriteLocker. Every call site
+ * gets its own Site, named after the lock and the function taking it, so report() can tell
+ * which scope holds a lock the longest and which one waits for it the most.
+ *
+ * The macros are plain Qt lockers unless qTox is built with the LOCK_PROFILING CMake option,
+ * so the profiler costs nothing in normal builds. With it, the report is logged every
+ * REPORT_INTERVAL_MS and is part of the diagnostics report as the "locks" section.
+ *
+ * @note A nested lock of a recursive mutex is counted as an uncontended acquisition of its own,
+ * its hold time is included in the hold time of the outer scope as well.
+ */
+
+/**
+ * @class LockProfiler::Site
+ * @brief Statistics of one lock taken in one scope, updated without locking.
+ *
+ * @note lock and scope must outlive the profiler, use string literals and __func__.
+ */
+
+/**
+ * @class ProfiledLocker
+ * @brief Takes a lock like QMutexLocker and records wait and hold time in a LockProfiler::Site.
+ *
+ * The lock is tried first, only a failed try counts as contention and its wait time is
+ * measured.
+ */
+
+constexpr int LockProfiler::REPORT_INTERVAL_MS;
+constexpr int LockProfiler::REPORT_TOP_SITES;
+
+namespace {
+void updateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current
+           && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+struct LockTotals
+{
+    uint64_t acquisitions = 0;
+    uint64_t contentions = 0;
+    uint64_t waitNs = 0;
+    uint64_t maxWaitNs = 0;
+    uint64_t holdNs = 0;
+    uint64_t maxHoldNs = 0;
+    std::vector<const LockProfiler::Site*> sites;
+};
+
+double toMs(uint64_t ns)
+{
+    return ns / 1000000.0;
+}
+} // namespace
+
+LockProfiler::Site::Site(const char* lock_, const char* scope_)
+    : lock{lock_}
+    , scope{scope_}
+{}
+
+void LockProfiler::Site::recordAcquire(qint64 waitNs_, bool contended)
+{
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (!contended) {
+        return;
+    }
+
+    const uint64_t wait = static_cast<uint64_t>(std::max<qint64>(waitNs_, 0));
+    contentions.fetch_add(1, std::memory_order_relaxed);
+    waitNs.fetch_add(wait, std::memory_order_relaxed);
+    updateMax(maxWaitNs, wait);
+}
+
+void LockProfiler::Site::recordRelease(qint64 holdNs_)
+{
+    const uint64_t hold = static_cast<uint64_t>(std::max<qint64>(holdNs_, 0));
+    holdNs.fetch_add(hold, std::memory_order_relaxed);
+    updateMax(maxHoldNs, hold);
+}
+
+LockProfiler::LockProfiler()
+    : diagnostics{"locks", [this]() { return toJson(); }}
+{
+    clock.start();
+}
+
+/**
+ * @brief Returns the profiler all locks record into.
+ *
+ * Never destroyed, locks may still be taken while other static objects are torn down.
+ */
+LockProfiler& LockProfiler::getInstance()
+{
+    static LockProfiler* instance = new LockProfiler;
+    return *instance;
+}
+
+/**
+ * @brief Returns the statistics of a call site, creating them on first use.
+ * @param lock Name of the lock.
+ * @param scope Name of the scope taking the lock.
+ *
+ * The macros call this once per call site and keep the reference.
+ */
+LockProfiler::Site& LockProfiler::site(const char* lock, const char* scope)
+{
+    QMutexLocker locker{&mutex};
+    sites.emplace_back(new Site{lock, scope});
+    return *sites.back();
+}
+
+qint64 LockProfiler::nowNs() const
+{
+    return clock.nsecsElapsed();
+}
+
+/**
+ * @brief Clears all statistics, e.g. before measuring a specific workload.
+ */
+void LockProfiler::reset()
+{
+    QMutexLocker locker{&mutex};
+    for (const std::unique_ptr<Site>& site : sites) {
+        site->acquisitions = 0;
+        site->contentions = 0;
+        site->waitNs = 0;
+        site->maxWaitNs = 0;
+        site->holdNs = 0;
+        site->maxHoldNs = 0;
+    }
+}
+
+/**
+ * @brief Human readable statistics of every lock, with the REPORT_TOP_SITES scopes waiting
+ * the longest.
+ */
+QString LockProfiler::report() const
+{
+    std::map<QString, LockTotals> locks;
+    {
+        QMutexLocker locker{&mutex};
+        for (const std::unique_ptr<Site>& site : sites) {
+            LockTotals& totals = locks[QString::fromUtf8(site->lock)];
+            totals.acquisitions += site->acquisitions;
+            totals.contentions += site->contentions;
+            totals.waitNs += site->waitNs;
+            totals.maxWaitNs = std::max<uint64_t>(totals.maxWaitNs, site->maxWaitNs);
+            totals.holdNs += site->holdNs;
+            totals.maxHoldNs = std::max<uint64_t>(totals.maxHoldNs, site->maxHoldNs);
+            totals.sites.push_back(site.get());
+        }
+    }
+
+    QStringList lines;
+    for (auto& lock : locks) {
+        LockTotals& totals = lock.second;
+        if (totals.acquisitions == 0) {
+            continue;
+        }
+
+        lines << QStringLiteral("%1: %2 locks, %3 contended, wait %4 ms (max %5 ms), "
+                                "hold %6 ms (max %7 ms)")
+                     .arg(lock.first)
+                     .arg(totals.acquisitions)
+                     .arg(totals.contentions)
+                     .arg(toMs(totals.waitNs), 0, 'f', 1)
+                     .arg(toMs(totals.maxWaitNs), 0, 'f', 1)
+                     .arg(toMs(totals.holdNs), 0, 'f', 1)
+                     .arg(toMs(totals.maxHoldNs), 0, 'f', 1);
+
+        std::sort(totals.sites.begin(), totals.sites.end(), [](const Site* a, const Site* b) {
+            return a->waitNs > b->waitNs || (a->waitNs == b->waitNs && a->holdNs > b->holdNs);
+        });
+        const size_t count = std::min<size_t>(totals.sites.size(), REPORT_TOP_SITES);
+        for (size_t i = 0; i < count; ++i) {
+            const Site* site = totals.sites[i];
+            if (site->acquisitions == 0) {
+                break;
+            }
+            lines << QStringLiteral("    %1: %2 locks, wait %3 ms, hold %4 ms (max %5 ms)")
+                         .arg(QString::fromUtf8(site->scope))
+                         .arg(site->acquisitions)
+                         .arg(toMs(site->waitNs), 0, 'f', 1)
+                         .arg(toMs(site->holdNs), 0, 'f', 1)
+                         .arg(toMs(site->maxHoldNs), 0, 'f', 1);
+        }
+    }
+
+    return lines.join('\n');
+}
+
+/**
+ * @brief Statistics of every call site, for the diagnostics report.
+ */
+QJsonObject LockProfiler::toJson() const
+{
+    QJsonArray result;
+    QMutexLocker locker{&mutex};
+    for (const std::unique_ptr<Site>& site : sites) {
+        if (site->acquisitions == 0) {
+            continue;
+        }
+        result.append(QJsonObject{{"lock", QString::fromUtf8(site->lock)},
+                                  {"scope", QString::fromUtf8(site->scope)},
+                                  {"acquisitions", static_cast<qint64>(site->acquisitions)},
+                                  {"contentions", static_cast<qint64>(site->contentions)},
+                                  {"waitMs", toMs(site->waitNs)},
+                                  {"maxWaitMs", toMs(site->maxWaitNs)},
+                                  {"holdMs", toMs(site->holdNs)},
+                                  {"maxHoldMs", toMs(site->maxHoldNs)}});
+    }
+
+    return QJsonObject{{"profiling", QTOX_LOCK_PROFILING != 0}, {"sites", result}};
+}
@@ -0,0 +1,253 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/startupprofiler.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+
+/**
+ * @class StartupProfiler
+ * @brief Collects how long the phases of the startup took and writes them as a timeline.
+ *
+ * The timeline uses the Chrome trace event format, which chrome://tracing and
+ * https://ui.perfetto.dev open directly. Every thread gets its own track, named after the
+ * QThread's object name. Recording is off unless enable() was called, which the
+ * --startup-trace command line option does.
+ *
+ * Independent of that, the total duration of every phase name is summed up for the diagnostics
+ * report, see getPhaseSummary(). That costs two clock reads per phase and keeps one entry per
+ * name, so phases run per friend don't grow it.
+ *
+ * Timestamps are microseconds since the profiler was first used, which is at the start of
+ * AppManager::run().
+ *
+ * @note Thread safe, phases run on the GUI and the Core thread.
+ */
+
+/**
+ * @class StartupPhase
+ * @brief Scoped timer adding a phase to the StartupProfiler when it goes out of scope.
+ *
+ * @note The name must outlive the profiler, use string literals.
+ */
+
+constexpr int StartupProfiler::MAX_EVENTS;
+constexpr int StartupProfiler::MAX_SUMMARY_PHASES;
+
+StartupProfiler::StartupProfiler()
+{
+    clock.start();
+}
+
+StartupProfiler& StartupProfiler::getInstance()
+{
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+/**
+ * @brief Starts recording.
+ * @param tracePath File the timeline gets written to by write().
+ */
+void StartupProfiler::enable(const QString& tracePath)
+{
+    QMutexLocker locker{&mutex};
+    path = tracePath;
+    enabled = true;
+    qDebug() << "Recording the startup timeline to" << path;
+}
+
+bool StartupProfiler::isEnabled() const
+{
+    return enabled;
+}
+
+qint64 StartupProfiler::elapsedUs() const
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+/**
+ * @brief Adds a finished phase to the timeline, usually through StartupPhase.
+ * @param name Phase name, must outlive the profiler.
+ * @param startUs Start time as returned by elapsedUs().
+ * @param durationUs How long the phase took.
+ */
+void StartupProfiler::addPhase(const char* name, qint64 startUs, qint64 durationUs)
+{
+    addToSummary(name, startUs, durationUs);
+    addEvent({name, 'X', startUs, durationUs, 0});
+}
+
+/**
+ * @brief Adds a point in time to the timeline, e.g. when we got online.
+ * @param name Mark name, must outlive the profiler.
+ */
+void StartupProfiler::addMark(const char* name)
+{
+    const qint64 nowUs = elapsedUs();
+    addToSummary(name, nowUs, 0);
+    addEvent({name, 'i', nowUs, 0, 0});
+}
+
+/**
+ * @brief Serializes the timeline.
+ * @return Chrome trace event JSON document.
+ */
+QByteArray StartupProfiler::toJson() const
+{
+    QMutexLocker locker{&mutex};
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray traceEvents;
+    for (int i = 0; i < threadNames.size(); ++i) {
+        QJsonObject metadata;
+        metadata["name"] = "thread_name";
+        metadata["ph"] = "M";
+        metadata["pid"] = pid;
+        metadata["tid"] = i;
+        metadata["args"] = QJsonObject{{"name", threadNames.at(i)}};
+        traceEvents.append(metadata);
+    }
+
+    for (const Event& event : events) {
+        QJsonObject traceEvent;
+        traceEvent["name"] = QString::fromUtf8(event.name);
+        traceEvent["ph"] = QString(QChar::fromLatin1(event.type));
+        traceEvent["ts"] = event.startUs;
+        traceEvent["pid"] = pid;
+        traceEvent["tid"] = event.threadId;
+        if (event.type == 'X') {
+            traceEvent["dur"] = event.durationUs;
+        } else {
+            // instant events span all tracks
+            traceEvent["s"] = "g";
+        }
+        traceEvents.append(traceEvent);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @brief Writes the timeline to the file given to enable().
+ * @return False if recording is off or the file couldn't be written.
+ */
+bool StartupProfiler::write() const
+{
+    if (!enabled) {
+        return false;
+    }
+
+    const QByteArray json = toJson();
+    QString tracePath;
+    {
+        QMutexLocker locker{&mutex};
+        tracePath = path;
+    }
+
+    QSaveFile file{tracePath};
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qWarning() << "Failed to write the startup timeline to" << tracePath;
+        return false;
+    }
+
+    qDebug() << "Wrote the startup timeline to" << tracePath;
+    return true;
+}
+
+/**
+ * @brief Total time spent in each phase, recorded even when the timeline isn't.
+ * @return One entry per phase or mark name, in the order they first finished.
+ */
+QVector<StartupProfiler::PhaseSummary> StartupProfiler::getPhaseSummary() const
+{
+    QMutexLocker locker{&mutex};
+    return summary;
+}
+
+void StartupProfiler::addToSummary(const char* name, qint64 startUs, qint64 durationUs)
+{
+    QMutexLocker locker{&mutex};
+    const int index = summaryNames.indexOf(name);
+    if (index >= 0) {
+        PhaseSummary& phase = summary[index];
+        phase.firstStartUs = std::min(phase.firstStartUs, startUs);
+        phase.totalUs += durationUs;
+        ++phase.count;
+        return;
+    }
+
+    if (summary.size() >= MAX_SUMMARY_PHASES) {
+        return;
+    }
+
+    summaryNames.append(name);
+    summary.append({QString::fromUtf8(name), startUs, durationUs, 1});
+}
+
+void StartupProfiler::addEvent(const Event& event)
+{
+    if (!enabled) {
+        return;
+    }
+
+    const QThread* thread = QThread::currentThread();
+
+    QMutexLocker locker{&mutex};
+    if (events.size() >= MAX_EVENTS) {
+        return;
+    }
+
+    auto it = threadIds.constFind(thread);
+    if (it == threadIds.constEnd()) {
+        const QString threadName = thread->objectName();
+        threadNames.append(threadName.isEmpty() ? QStringLiteral("qTox") : threadName);
+        it = threadIds.insert(thread, threadNames.size() - 1);
+    }
+
+    Event stored = event;
+    stored.threadId = *it;
+    events.append(stored);
+}
+
+StartupPhase::StartupPhase(const char* name_)
+    : name{name_}
+    , startUs{StartupProfiler::getInstance().elapsedUs()}
+{
+}
+
+StartupPhase::~StartupPhase()
+{
+    StartupProfiler& profiler = StartupProfiler::getInstance();
+    profiler.addPhase(name, startUs, profiler.elapsedUs() - startUs);
+}
@@ -0,0 +1,266 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/threadcputime.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/**
+ * @class ThreadCpuTime
+ * @brief Measures the CPU time of named threads and of the whole process.
+ *
+ * Threads register themselves under a name, several threads may share one. sample() reports the
+ * CPU time each name used so far, including threads that unregistered already, so the totals only
+ * grow and can be compared between samples.
+ *
+ * Thread clocks are available on Linux, FreeBSD and Windows. Elsewhere sample() is empty and only
+ * the process time can be used.
+ *
+ * @note All methods are thread safe.
+ */
+
+namespace {
+#if defined(Q_OS_WIN)
+using ThreadClock = HANDLE;
+
+bool getCurrentThreadClock(ThreadClock& clock)
+{
+    return DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &clock,
+                           THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0);
+}
+
+qint64 fileTimeNs(const FILETIME& time)
+{
+    // FILETIME counts 100 ns intervals
+    return ((static_cast<qint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+}
+
+bool readThreadClock(ThreadClock clock, qint64& ns)
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(clock, &creation, &exit, &kernel, &user)) {
+        return false;
+    }
+
+    ns = fileTimeNs(kernel) + fileTimeNs(user);
+    return true;
+}
+
+void releaseThreadClock(ThreadClock clock)
+{
+    CloseHandle(clock);
+}
+#elif defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+using ThreadClock = clockid_t;
+
+bool getCurrentThreadClock(ThreadClock& clock)
+{
+    return pthread_getcpuclockid(pthread_self(), &clock) == 0;
+}
+
+bool readThreadClock(ThreadClock clock, qint64& ns)
+{
+    timespec time;
+    if (clock_gettime(clock, &time) != 0) {
+        // the thread is gone
+        return false;
+    }
+
+    ns = static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    return true;
+}
+
+void releaseThreadClock(ThreadClock clock)
+{
+    std::ignore = clock;
+}
+#else
+using ThreadClock = int;
+
+bool getCurrentThreadClock(ThreadClock& clock)
+{
+    std::ignore = clock;
+    return false;
+}
+
+bool readThreadClock(ThreadClock clock, qint64& ns)
+{
+    std::ignore = clock;
+    std::ignore = ns;
+    return false;
+}
+
+void releaseThreadClock(ThreadClock clock)
+{
+    std::ignore = clock;
+}
+#endif
+
+struct RegisteredThread
+{
+    QString name;
+    Qt::HANDLE id;
+    ThreadClock clock;
+};
+
+struct Registry
+{
+    QMutex mutex;
+    std::vector<RegisteredThread> threads;
+    // CPU time of unregistered threads by name
+    std::map<QString, qint64> retiredNs;
+};
+
+Registry& getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+std::vector<RegisteredThread>::iterator findCurrentThread(Registry& registry)
+{
+    const Qt::HANDLE id = QThread::currentThreadId();
+    auto it = registry.threads.begin();
+    while (it != registry.threads.end() && it->id != id) {
+        ++it;
+    }
+    return it;
+}
+} // namespace
+
+/**
+ * @brief Starts measuring the calling thread.
+ * @param name Name to report the thread's time under, registering again renames the thread.
+ */
+void ThreadCpuTime::registerCurrentThread(const QString& name)
+{
+    Registry& registry = getRegistry();
+    QMutexLocker locker{&registry.mutex};
+
+    auto it = findCurrentThread(registry);
+    if (it != registry.threads.end()) {
+        it->name = name;
+        return;
+    }
+
+    ThreadClock clock;
+    if (getCurrentThreadClock(clock)) {
+        registry.threads.push_back({name, QThread::currentThreadId(), clock});
+    }
+}
+
+/**
+ * @brief Stops measuring the calling thread, its time so far stays part of its name's total.
+ *
+ * Call this before a registered thread exits, or before a pooled thread is reused for something
+ * else.
+ */
+void ThreadCpuTime::unregisterCurrentThread()
+{
+    Registry& registry = getRegistry();
+    QMutexLocker locker{&registry.mutex};
+
+    auto it = findCurrentThread(registry);
+    if (it == registry.threads.end()) {
+        return;
+    }
+
+    qint64 ns = 0;
+    if (readThreadClock(it->clock, ns)) {
+        registry.retiredNs[it->name] += ns;
+    }
+    releaseThreadClock(it->clock);
+    registry.threads.erase(it);
+}
+
+/**
+ * @brief Reads the CPU time used under each registered name so far, sorted by name.
+ */
+QVector<ThreadCpuTime::Sample> ThreadCpuTime::sample()
+{
+    Registry& registry = getRegistry();
+    QMutexLocker locker{&registry.mutex};
+
+    std::map<QString, qint64> totals = registry.retiredNs;
+    for (const RegisteredThread& thread : registry.threads) {
+        qint64 ns = 0;
+        if (readThreadClock(thread.clock, ns)) {
+            totals[thread.name] += ns;
+        } else {
+            totals.emplace(thread.name, 0);
+        }
+    }
+
+    QVector<Sample> samples;
+    samples.reserve(static_cast<int>(totals.size()));
+    for (const auto& total : totals) {
+        samples.append({total.first, total.second});
+    }
+    return samples;
+}
+
+/**
+ * @brief Whether threads can be measured on this platform.
+ */
+bool ThreadCpuTime::hasThreadClocks()
+{
+    ThreadClock clock;
+    if (!getCurrentThreadClock(clock)) {
+        return false;
+    }
+
+    releaseThreadClock(clock);
+    return true;
+}
+
+/**
+ * @brief CPU time the whole process used so far, in nanoseconds.
+ * @return -1 if it can't be measured.
+ */
+qint64 ThreadCpuTime::processNs()
+{
+#if defined(Q_OS_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return -1;
+    }
+
+    return fileTimeNs(kernel) + fileTimeNs(user);
+#else
+    timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+        return -1;
+    }
+
+    return static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+}
@@ -0,0 +1,291 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "util/threadscheduling.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include <algorithm>
+#include <tuple>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#if defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+/**
+ * @class ThreadScheduling
+ * @brief Moves the calling thread into a scheduling class fitting its work.
+ *
+ * Audio threads must run every few milliseconds no matter what else is going on, media threads
+ * should win against the GUI and bulk work like database writes, file I/O and thumbnailing should
+ * only use what's left. QThread priorities don't do that on Linux and macOS, where they only
+ * apply to the default time sharing policy, so the platform is asked directly:
+ *  - RealtimeAudio: MMCSS "Pro Audio" on Windows, SCHED_RR at REALTIME_PRIORITY on Linux and
+ *    BSD where the user is allowed to, user interactive QoS on macOS.
+ *  - Interactive: above normal priority on Windows, INTERACTIVE_NICE on Linux, user initiated
+ *    QoS on macOS.
+ *  - Background: background mode, which lowers I/O priority as well, on Windows,
+ *    BACKGROUND_NICE and the lowest best effort I/O priority on Linux, utility QoS on macOS.
+ *
+ * Unprivileged Linux users usually can't get real-time scheduling or a negative nice value,
+ * the thread then keeps its previous scheduling and setCurrentThreadClass() returns false.
+ *
+ * @note Threads of a pool keep their class for the next job, pools doing bulk work set it in
+ * every job, which is cheap as nothing is changed when the class stays the same.
+ */
+
+constexpr int ThreadScheduling::REALTIME_PRIORITY;
+constexpr int ThreadScheduling::INTERACTIVE_NICE;
+constexpr int ThreadScheduling::BACKGROUND_NICE;
+
+namespace {
+thread_local ThreadScheduling::Class currentClass = ThreadScheduling::Class::Normal;
+
+#if defined(Q_OS_WIN)
+using AvSetMmThreadCharacteristicsFn = HANDLE(WINAPI*)(LPCWSTR, LPDWORD);
+using AvRevertMmThreadCharacteristicsFn = BOOL(WINAPI*)(HANDLE);
+
+thread_local HANDLE mmcssTask = nullptr;
+
+HMODULE avrtLibrary()
+{
+    // avrt.dll is part of every Windows since Vista, loading it avoids a link time dependency
+    static HMODULE library = LoadLibraryW(L"avrt.dll");
+    return library;
+}
+
+bool joinProAudio()
+{
+    const auto avSet = reinterpret_cast<AvSetMmThreadCharacteristicsFn>(
+        avrtLibrary() ? GetProcAddress(avrtLibrary(), "AvSetMmThreadCharacteristicsW") : nullptr);
+    if (!avSet) {
+        return false;
+    }
+
+    DWORD taskIndex = 0;
+    mmcssTask = avSet(L"Pro Audio", &taskIndex);
+    return mmcssTask != nullptr;
+}
+
+void leaveProAudio()
+{
+    if (!mmcssTask) {
+        return;
+    }
+
+    const auto avRevert = reinterpret_cast<AvRevertMmThreadCharacteristicsFn>(
+        GetProcAddress(avrtLibrary(), "AvRevertMmThreadCharacteristics"));
+    if (avRevert) {
+        avRevert(mmcssTask);
+    }
+    mmcssTask = nullptr;
+}
+
+bool applyClass(ThreadScheduling::Class previous, ThreadScheduling::Class next)
+{
+    const HANDLE thread = GetCurrentThread();
+    if (previous == ThreadScheduling::Class::Background) {
+        SetThreadPriority(thread, THREAD_MODE_BACKGROUND_END);
+    } else if (previous == ThreadScheduling::Class::RealtimeAudio) {
+        leaveProAudio();
+    }
+
+    switch (next) {
+    case ThreadScheduling::Class::Normal:
+        return SetThreadPriority(thread, THREAD_PRIORITY_NORMAL) != 0;
+    case ThreadScheduling::Class::Background:
+        return SetThreadPriority(thread, THREAD_MODE_BACKGROUND_BEGIN) != 0;
+    case ThreadScheduling::Class::Interactive:
+        return SetThreadPriority(thread, THREAD_PRIORITY_ABOVE_NORMAL) != 0;
+    case ThreadScheduling::Class::RealtimeAudio:
+        if (joinProAudio()) {
+            return true;
+        }
+        SetThreadPriority(thread, THREAD_PRIORITY_TIME_CRITICAL);
+        return false;
+    }
+
+    return false;
+}
+#elif defined(Q_OS_MACOS)
+bool applyClass(ThreadScheduling::Class previous, ThreadScheduling::Class next)
+{
+    std::ignore = previous;
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (next) {
+    case ThreadScheduling::Class::Normal:
+        qos = QOS_CLASS_DEFAULT;
+        break;
+    case ThreadScheduling::Class::Background:
+        qos = QOS_CLASS_UTILITY;
+        break;
+    case ThreadScheduling::Class::Interactive:
+        qos = QOS_CLASS_USER_INITIATED;
+        break;
+    case ThreadScheduling::Class::RealtimeAudio:
+        qos = QOS_CLASS_USER_INTERACTIVE;
+        break;
+    }
+
+    return pthread_set_qos_class_self_np(qos, 0) == 0;
+}
+#else
+#if defined(Q_OS_LINUX)
+int currentThreadId()
+{
+    return static_cast<int>(syscall(SYS_gettid));
+}
+
+bool setNice(int nice)
+{
+    // Linux applies the nice value to the thread with this id only
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(currentThreadId()), nice) == 0;
+}
+
+bool setIoPriority(int level)
+{
+#ifdef SYS_ioprio_set
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+    constexpr int IOPRIO_CLASS_BE = 2;
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, currentThreadId(),
+                   (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | level)
+           == 0;
+#else
+    std::ignore = level;
+    return false;
+#endif
+}
+
+bool setRealtime(bool enabled)
+{
+    sched_param param{};
+    int policy = SCHED_OTHER;
+    if (enabled) {
+        policy = SCHED_RR;
+        param.sched_priority = std::min(ThreadScheduling::REALTIME_PRIORITY,
+                                        sched_get_priority_max(SCHED_RR));
+#ifdef SCHED_RESET_ON_FORK
+        // processes started from this thread must not inherit real-time scheduling
+        policy |= SCHED_RESET_ON_FORK;
+#endif
+    }
+
+    return sched_setscheduler(currentThreadId(), policy, &param) == 0;
+}
+#else
+bool setNice(int nice)
+{
+    std::ignore = nice;
+    return false;
+}
+
+bool setIoPriority(int level)
+{
+    std::ignore = level;
+    return false;
+}
+
+bool setRealtime(bool enabled)
+{
+    sched_param param{};
+    int policy = SCHED_OTHER;
+    if (enabled) {
+        policy = SCHED_RR;
+        param.sched_priority = std::min(ThreadScheduling::REALTIME_PRIORITY,
+                                        sched_get_priority_max(SCHED_RR));
+    }
+
+    return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+#endif
+
+bool applyClass(ThreadScheduling::Class previous, ThreadScheduling::Class next)
+{
+    if (previous == ThreadScheduling::Class::RealtimeAudio) {
+        setRealtime(false);
+    }
+
+    // the default best effort I/O level is 4
+    switch (next) {
+    case ThreadScheduling::Class::Normal:
+        setIoPriority(4);
+        return setNice(0);
+    case ThreadScheduling::Class::Background:
+        setIoPriority(7);
+        return setNice(ThreadScheduling::BACKGROUND_NICE);
+    case ThreadScheduling::Class::Interactive:
+        setIoPriority(4);
+        return setNice(ThreadScheduling::INTERACTIVE_NICE);
+    case ThreadScheduling::Class::RealtimeAudio:
+        if (setRealtime(true)) {
+            return true;
+        }
+        // rejected without CAP_SYS_NICE or RLIMIT_RTPRIO, at least try to win against the GUI
+        setNice(ThreadScheduling::INTERACTIVE_NICE);
+        return false;
+    }
+
+    return false;
+}
+#endif
+} // namespace
+
+/**
+ * @brief Moves the calling thread into a scheduling class.
+ * @param schedulingClass Class fitting the work of the thread.
+ * @return False if the platform refused the class, the thread may have been given a weaker
+ * boost instead.
+ */
+bool ThreadScheduling::setCurrentThreadClass(Class schedulingClass)
+{
+    if (currentClass == schedulingClass) {
+        return true;
+    }
+
+    const bool applied = applyClass(currentClass, schedulingClass);
+    if (!applied) {
+        qDebug() << "Thread" << QThread::currentThread()->objectName()
+                 << "couldn't switch to scheduling class" << static_cast<int>(schedulingClass);
+    }
+
+    currentClass = schedulingClass;
+    return applied;
+}
+
+/**
+ * @brief Returns the class last set for the calling thread, Normal if none was set.
+ */
+ThreadScheduling::Class ThreadScheduling::getCurrentThreadClass()
+{
+    return currentClass;
+}
@@ -472,6 +472,40 @@ bool ToxcoreErrorParser::parseErr(Tox_Err_File_Get error, int line)
     return false;
 }
 
+bool ToxcoreErrorParser::parseErr(Tox_Err_File_Seek error, int line)
+{
+    switch (error) {
+    case TOX_ERR_FILE_SEEK_OK:
+        return true;
+
+    case TOX_ERR_FILE_SEEK_FRIEND_NOT_FOUND:
+        qCritical() << line << ": The friend_number passed did not designate a valid friend.";
+        return false;
+
+    case TOX_ERR_FILE_SEEK_FRIEND_NOT_CONNECTED:
+        qCritical() << line << ": This client is currently not connected to the friend.";
+        return false;
+
+    case TOX_ERR_FILE_SEEK_NOT_FOUND:
+        qCritical() << line << ": No file transfer with the given file number was found for the given friend.";
+        return false;
+
+    case TOX_ERR_FILE_SEEK_DENIED:
+        qCritical() << line << ": File was not in a state where it could be seeked.";
+        return false;
+
+    case TOX_ERR_FILE_SEEK_INVALID_POSITION:
+        qCritical() << line << ": Seek position was invalid.";
+        return false;
+
+    case TOX_ERR_FILE_SEEK_SENDQ:
+        qCritical() << line << ": Packet queue is full.";
+        return false;
+    }
+    qCritical() << line << ": Unknown Tox_Err_File_Seek error code:" << error;
+    return false;
+}
+
 bool ToxcoreErrorParser::parseErr(Tox_Err_File_Send error, int line)
 {
     switch (error) {
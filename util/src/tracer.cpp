@@ -0,0 +1,274 @@
+/*
+    Copyright © 2021 by The qTox Project Contributors
+
+    This file is part of qTox, a Qt-based graphical interface for Tox.
+
+    qTox is libre software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    qTox is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with qTox.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+
+/**
+ * @class Tracer
+ * @brief Records spans on all threads and writes them as a Chrome trace on demand.
+ *
+ * Spans are usually recorded with TRACE_SCOPE("name"), which closes the span when the scope
+ * ends. Every thread writes into its own ring buffer of EVENTS_PER_THREAD spans, so recording
+ * never takes a lock and only the newest spans are kept. The buffers are dumped as Chrome trace
+ * event JSON, which chrome://tracing and https://ui.perfetto.dev open directly, with one track
+ * per thread named after its QThread.
+ *
+ * TRACE_SCOPE compiles to nothing unless qTox is built with the TRACING CMake option, and
+ * records only after enable(), which the --trace command line option does.
+ *
+ * @note The buffer of a thread is only allocated when it records its first span.
+ */
+
+/**
+ * @class TraceScope
+ * @brief Records the span from its construction to its destruction in the Tracer.
+ *
+ * @note The name must outlive the tracer, use string literals.
+ */
+
+/**
+ * @var Tracer::EVENTS_PER_THREAD
+ * @brief Size of the ring buffer of every thread, older spans get overwritten.
+ */
+
+constexpr size_t Tracer::EVENTS_PER_THREAD;
+
+namespace {
+std::atomic<uint64_t> nextGeneration{1};
+
+struct LocalBuffer
+{
+    uint64_t generation = 0;
+    void* buffer = nullptr;
+};
+
+thread_local LocalBuffer localBufferCache;
+} // namespace
+
+Tracer::Tracer()
+    : generation{nextGeneration.fetch_add(1)}
+{
+    clock.start();
+}
+
+Tracer::~Tracer() = default;
+
+/**
+ * @brief Returns the tracer TRACE_SCOPE records into.
+ */
+Tracer& Tracer::getInstance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+/**
+ * @brief Starts recording.
+ * @param tracePath File the trace gets written to by write().
+ */
+void Tracer::enable(const QString& tracePath)
+{
+    QMutexLocker locker{&mutex};
+    path = tracePath;
+    enabled = true;
+    qDebug() << "Recording a trace of the last" << EVENTS_PER_THREAD << "spans per thread to"
+             << path;
+}
+
+bool Tracer::isEnabled() const
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Microseconds since the tracer was created.
+ */
+qint64 Tracer::nowUs() const
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+/**
+ * @brief Adds a finished span to the buffer of the calling thread.
+ * @param name Span name, must outlive the tracer.
+ * @param beginUs Start time as returned by nowUs().
+ * @param endUs End time as returned by nowUs().
+ */
+void Tracer::addSpan(const char* name, qint64 beginUs, qint64 endUs)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    ThreadBuffer& buffer = localBuffer();
+    const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % EVENTS_PER_THREAD];
+    event.name.store(name, std::memory_order_relaxed);
+    event.beginUs.store(beginUs, std::memory_order_relaxed);
+    event.endUs.store(endUs, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Serializes the spans recorded so far, recording goes on meanwhile.
+ * @return Chrome trace event JSON document.
+ */
+QByteArray Tracer::toJson() const
+{
+    QMutexLocker locker{&mutex};
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray traceEvents;
+    for (const auto& buffer : buffers) {
+        QJsonObject metadata;
+        metadata["name"] = "thread_name";
+        metadata["ph"] = "M";
+        metadata["pid"] = pid;
+        metadata["tid"] = buffer->threadId;
+        metadata["args"] = QJsonObject{{"name", buffer->threadName}};
+        traceEvents.append(metadata);
+
+        const uint64_t written = buffer->written.load(std::memory_order_acquire);
+        const uint64_t first = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+        std::vector<std::array<qint64, 2>> times;
+        std::vector<const char*> names;
+        times.reserve(written - first);
+        names.reserve(written - first);
+        for (uint64_t i = first; i < written; ++i) {
+            const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+            names.push_back(event.name.load(std::memory_order_relaxed));
+            times.push_back({event.beginUs.load(std::memory_order_relaxed),
+                             event.endUs.load(std::memory_order_relaxed)});
+        }
+
+        // the owner kept writing while we copied, drop what it may have overwritten
+        const uint64_t writtenAfter = buffer->written.load(std::memory_order_acquire);
+        const uint64_t valid =
+            writtenAfter >= EVENTS_PER_THREAD ? writtenAfter - EVENTS_PER_THREAD + 1 : 0;
+        for (uint64_t i = std::max(first, valid); i < written; ++i) {
+            const size_t offset = static_cast<size_t>(i - first);
+            QJsonObject traceEvent;
+            traceEvent["name"] = QString::fromUtf8(names[offset]);
+            traceEvent["ph"] = "X";
+            traceEvent["ts"] = times[offset][0];
+            traceEvent["dur"] = times[offset][1] - times[offset][0];
+            traceEvent["pid"] = pid;
+            traceEvent["tid"] = buffer->threadId;
+            traceEvents.append(traceEvent);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @brief Writes the trace to the file given to enable().
+ * @return False if recording is off or the file couldn't be written.
+ */
+bool Tracer::write() const
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    const QByteArray json = toJson();
+    QString tracePath;
+    {
+        QMutexLocker locker{&mutex};
+        tracePath = path;
+    }
+
+    QSaveFile file{tracePath};
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qWarning() << "Failed to write the trace to" << tracePath;
+        return false;
+    }
+
+    qDebug() << "Wrote the trace to" << tracePath;
+    return true;
+}
+
+Tracer::ThreadBuffer& Tracer::localBuffer()
+{
+    LocalBuffer& cache = localBufferCache;
+    if (cache.generation == generation) {
+        return *static_cast<ThreadBuffer*>(cache.buffer);
+    }
+
+    const std::thread::id self = std::this_thread::get_id();
+    QMutexLocker locker{&mutex};
+    ThreadBuffer* buffer = nullptr;
+    for (const auto& existing : buffers) {
+        if (existing->owner == self) {
+            buffer = existing.get();
+            break;
+        }
+    }
+
+    if (!buffer) {
+        buffers.emplace_back(new ThreadBuffer);
+        buffer = buffers.back().get();
+        buffer->owner = self;
+        buffer->threadId = static_cast<int>(buffers.size());
+    }
+
+    // thread ids can be reused, so refresh the name
+    const QThread* thread = QThread::currentThread();
+    const QCoreApplication* app = QCoreApplication::instance();
+    buffer->threadName = thread->objectName();
+    if (app && thread == app->thread()) {
+        buffer->threadName = QStringLiteral("qTox GUI");
+    } else if (buffer->threadName.isEmpty()) {
+        buffer->threadName = QStringLiteral("Thread %1").arg(buffer->threadId);
+    }
+
+    cache.generation = generation;
+    cache.buffer = buffer;
+    return *buffer;
+}
+
+TraceScope::TraceScope(const char* name_)
+    : name{name_}
+    , beginUs{Tracer::getInstance().isEnabled() ? Tracer::getInstance().nowUs() : -1}
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (beginUs < 0) {
+        return;
+    }
+
+    Tracer& tracer = Tracer::getInstance();
+    tracer.addSpan(name, beginUs, tracer.nowUs());
+}
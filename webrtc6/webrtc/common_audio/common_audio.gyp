@@ -51,6 +51,8 @@
         'real_fourier.h',
         'real_fourier_ooura.cc',
         'real_fourier_ooura.h',
+        'real_fourier_simd.cc',
+        'real_fourier_simd.h',
         'resampler/include/push_resampler.h',
         'resampler/include/resampler.h',
         'resampler/push_resampler.cc',
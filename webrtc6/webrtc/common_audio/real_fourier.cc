@@ -13,7 +13,9 @@
 #include "webrtc/base/checks.h"
 #include "webrtc/common_audio/real_fourier_ooura.h"
 #include "webrtc/common_audio/real_fourier_openmax.h"
+#include "webrtc/common_audio/real_fourier_simd.h"
 #include "webrtc/common_audio/signal_processing/include/spl_inl.h"
+#include "webrtc/typedefs.h"
 
 namespace webrtc {
 
@@ -24,6 +26,8 @@ const int RealFourier::kFftBufferAlignment = 32;
 rtc::scoped_ptr<RealFourier> RealFourier::Create(int fft_order) {
 #if defined(RTC_USE_OPENMAX_DL)
   return rtc::scoped_ptr<RealFourier>(new RealFourierOpenmax(fft_order));
+#elif defined(WEBRTC_ARCH_X86_FAMILY) || defined(WEBRTC_HAS_NEON)
+  return rtc::scoped_ptr<RealFourier>(new RealFourierSimd(fft_order));
 #else
   return rtc::scoped_ptr<RealFourier>(new RealFourierOoura(fft_order));
 #endif
@@ -0,0 +1,520 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/common_audio/real_fourier_simd.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "webrtc/base/checks.h"
+#include "webrtc/typedefs.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <xmmintrin.h>
+#define REAL_FOURIER_HAS_V4SF
+#elif defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#define REAL_FOURIER_HAS_V4SF
+#endif
+
+namespace webrtc {
+
+using std::complex;
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Twiddle tables of the passes start at multiples of four floats, so vector
+// loads of them stay aligned.
+size_t PaddedSize(size_t size) {
+  return (size + 3) & ~static_cast<size_t>(3);
+}
+
+// Size of the twiddle table of all passes for a complex FFT of |length|.
+size_t PassTwiddleSize(size_t length) {
+  size_t size = 0;
+  size_t span = 1;
+  for (; span * 4 <= length; span *= 4) {
+    size += PaddedSize(3 * span);
+  }
+  if (span < length) {
+    size += PaddedSize(span);
+  }
+  return std::max<size_t>(size, 1);
+}
+
+// The passes are radix-4 Stockham passes: butterfly |j| reads |j| plus
+// multiples of a quarter of the input, multiplies them with the twiddles of
+// its position |k| within the span and writes the four outputs |span| apart
+// into its output group. The output is in natural order after the last pass,
+// no bit reversal is needed. If the length isn't a power of four, a radix-2
+// pass finishes the transform.
+//
+// The twiddles of a radix-4 pass are three tables of |span| values, for the
+// second, third and fourth input.
+void Radix4Pass(const float* twiddle_re,
+                const float* twiddle_im,
+                size_t span,
+                size_t quarter,
+                const float* in_re,
+                const float* in_im,
+                float* out_re,
+                float* out_im) {
+  for (size_t j = 0; j < quarter; ++j) {
+    const size_t k = j & (span - 1);
+    const size_t out = ((j - k) << 2) + k;
+    float a_re[4];
+    float a_im[4];
+    a_re[0] = in_re[j];
+    a_im[0] = in_im[j];
+    for (size_t n = 1; n < 4; ++n) {
+      const float x_re = in_re[j + n * quarter];
+      const float x_im = in_im[j + n * quarter];
+      const float w_re = twiddle_re[(n - 1) * span + k];
+      const float w_im = twiddle_im[(n - 1) * span + k];
+      a_re[n] = x_re * w_re - x_im * w_im;
+      a_im[n] = x_re * w_im + x_im * w_re;
+    }
+    const float t0_re = a_re[0] + a_re[2];
+    const float t0_im = a_im[0] + a_im[2];
+    const float t1_re = a_re[0] - a_re[2];
+    const float t1_im = a_im[0] - a_im[2];
+    const float t2_re = a_re[1] + a_re[3];
+    const float t2_im = a_im[1] + a_im[3];
+    // (a1 - a3) * -i
+    const float t3_re = a_im[1] - a_im[3];
+    const float t3_im = a_re[3] - a_re[1];
+    out_re[out] = t0_re + t2_re;
+    out_im[out] = t0_im + t2_im;
+    out_re[out + span] = t1_re + t3_re;
+    out_im[out + span] = t1_im + t3_im;
+    out_re[out + 2 * span] = t0_re - t2_re;
+    out_im[out + 2 * span] = t0_im - t2_im;
+    out_re[out + 3 * span] = t1_re - t3_re;
+    out_im[out + 3 * span] = t1_im - t3_im;
+  }
+}
+
+void Radix2Pass(const float* twiddle_re,
+                const float* twiddle_im,
+                size_t span,
+                size_t half,
+                const float* in_re,
+                const float* in_im,
+                float* out_re,
+                float* out_im) {
+  for (size_t j = 0; j < half; ++j) {
+    const size_t k = j & (span - 1);
+    const size_t out = ((j - k) << 1) + k;
+    const float b_re =
+        in_re[j + half] * twiddle_re[k] - in_im[j + half] * twiddle_im[k];
+    const float b_im =
+        in_re[j + half] * twiddle_im[k] + in_im[j + half] * twiddle_re[k];
+    out_re[out] = in_re[j] + b_re;
+    out_im[out] = in_im[j] + b_im;
+    out_re[out + span] = in_re[j] - b_re;
+    out_im[out + span] = in_im[j] - b_im;
+  }
+}
+
+#if defined(REAL_FOURIER_HAS_V4SF)
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+typedef __m128 v4sf;
+inline v4sf Load(const float* p) { return _mm_load_ps(p); }
+inline v4sf LoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, v4sf v) { _mm_store_ps(p, v); }
+inline v4sf Splat(float f) { return _mm_set1_ps(f); }
+inline v4sf Add(v4sf a, v4sf b) { return _mm_add_ps(a, b); }
+inline v4sf Sub(v4sf a, v4sf b) { return _mm_sub_ps(a, b); }
+inline v4sf Mul(v4sf a, v4sf b) { return _mm_mul_ps(a, b); }
+inline v4sf Reverse(v4sf v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+// Splits eight interleaved floats into the even and odd ones.
+inline void LoadDeinterleaved(const float* p, v4sf* even, v4sf* odd) {
+  const v4sf a = _mm_loadu_ps(p);
+  const v4sf b = _mm_loadu_ps(p + 4);
+  *even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+inline void StoreInterleaved(float* p, v4sf even, v4sf odd) {
+  _mm_storeu_ps(p, _mm_unpacklo_ps(even, odd));
+  _mm_storeu_ps(p + 4, _mm_unpackhi_ps(even, odd));
+}
+// Stores a0 b0 c0 d0 a1 b1 c1 d1 ... to the aligned |p|.
+inline void StoreInterleaved4(float* p, v4sf a, v4sf b, v4sf c, v4sf d) {
+  _MM_TRANSPOSE4_PS(a, b, c, d);
+  _mm_store_ps(p, a);
+  _mm_store_ps(p + 4, b);
+  _mm_store_ps(p + 8, c);
+  _mm_store_ps(p + 12, d);
+}
+#else
+typedef float32x4_t v4sf;
+inline v4sf Load(const float* p) { return vld1q_f32(p); }
+inline v4sf LoadUnaligned(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, v4sf v) { vst1q_f32(p, v); }
+inline v4sf Splat(float f) { return vdupq_n_f32(f); }
+inline v4sf Add(v4sf a, v4sf b) { return vaddq_f32(a, b); }
+inline v4sf Sub(v4sf a, v4sf b) { return vsubq_f32(a, b); }
+inline v4sf Mul(v4sf a, v4sf b) { return vmulq_f32(a, b); }
+inline v4sf Reverse(v4sf v) {
+  v = vrev64q_f32(v);
+  return vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+}
+inline void LoadDeinterleaved(const float* p, v4sf* even, v4sf* odd) {
+  const float32x4x2_t v = vld2q_f32(p);
+  *even = v.val[0];
+  *odd = v.val[1];
+}
+inline void StoreInterleaved(float* p, v4sf even, v4sf odd) {
+  float32x4x2_t v;
+  v.val[0] = even;
+  v.val[1] = odd;
+  vst2q_f32(p, v);
+}
+inline void StoreInterleaved4(float* p, v4sf a, v4sf b, v4sf c, v4sf d) {
+  float32x4x4_t v;
+  v.val[0] = a;
+  v.val[1] = b;
+  v.val[2] = c;
+  v.val[3] = d;
+  vst4q_f32(p, v);
+}
+#endif
+
+// Radix4Pass() for spans of at least four, four butterflies at a time.
+// Neighbouring butterflies then also have neighbouring twiddles and outputs,
+// and all accesses stay aligned.
+void Radix4PassV4sf(const float* twiddle_re,
+                    const float* twiddle_im,
+                    size_t span,
+                    size_t quarter,
+                    const float* in_re,
+                    const float* in_im,
+                    float* out_re,
+                    float* out_im) {
+  for (size_t j = 0; j < quarter; j += 4) {
+    const size_t k = j & (span - 1);
+    const size_t out = ((j - k) << 2) + k;
+    v4sf a_re[4];
+    v4sf a_im[4];
+    a_re[0] = Load(in_re + j);
+    a_im[0] = Load(in_im + j);
+    for (size_t n = 1; n < 4; ++n) {
+      const v4sf x_re = Load(in_re + j + n * quarter);
+      const v4sf x_im = Load(in_im + j + n * quarter);
+      const v4sf w_re = Load(twiddle_re + (n - 1) * span + k);
+      const v4sf w_im = Load(twiddle_im + (n - 1) * span + k);
+      a_re[n] = Sub(Mul(x_re, w_re), Mul(x_im, w_im));
+      a_im[n] = Add(Mul(x_re, w_im), Mul(x_im, w_re));
+    }
+    const v4sf t0_re = Add(a_re[0], a_re[2]);
+    const v4sf t0_im = Add(a_im[0], a_im[2]);
+    const v4sf t1_re = Sub(a_re[0], a_re[2]);
+    const v4sf t1_im = Sub(a_im[0], a_im[2]);
+    const v4sf t2_re = Add(a_re[1], a_re[3]);
+    const v4sf t2_im = Add(a_im[1], a_im[3]);
+    const v4sf t3_re = Sub(a_im[1], a_im[3]);
+    const v4sf t3_im = Sub(a_re[3], a_re[1]);
+    Store(out_re + out, Add(t0_re, t2_re));
+    Store(out_im + out, Add(t0_im, t2_im));
+    Store(out_re + out + span, Add(t1_re, t3_re));
+    Store(out_im + out + span, Add(t1_im, t3_im));
+    Store(out_re + out + 2 * span, Sub(t0_re, t2_re));
+    Store(out_im + out + 2 * span, Sub(t0_im, t2_im));
+    Store(out_re + out + 3 * span, Sub(t1_re, t3_re));
+    Store(out_im + out + 3 * span, Sub(t1_im, t3_im));
+  }
+}
+
+// The first radix-4 pass has no twiddles, but its four outputs are
+// neighbours, so they are transposed before they're stored.
+void FirstRadix4PassV4sf(size_t quarter,
+                         const float* in_re,
+                         const float* in_im,
+                         float* out_re,
+                         float* out_im) {
+  for (size_t j = 0; j < quarter; j += 4) {
+    const v4sf a0_re = Load(in_re + j);
+    const v4sf a0_im = Load(in_im + j);
+    const v4sf a1_re = Load(in_re + j + quarter);
+    const v4sf a1_im = Load(in_im + j + quarter);
+    const v4sf a2_re = Load(in_re + j + 2 * quarter);
+    const v4sf a2_im = Load(in_im + j + 2 * quarter);
+    const v4sf a3_re = Load(in_re + j + 3 * quarter);
+    const v4sf a3_im = Load(in_im + j + 3 * quarter);
+    const v4sf t0_re = Add(a0_re, a2_re);
+    const v4sf t0_im = Add(a0_im, a2_im);
+    const v4sf t1_re = Sub(a0_re, a2_re);
+    const v4sf t1_im = Sub(a0_im, a2_im);
+    const v4sf t2_re = Add(a1_re, a3_re);
+    const v4sf t2_im = Add(a1_im, a3_im);
+    const v4sf t3_re = Sub(a1_im, a3_im);
+    const v4sf t3_im = Sub(a3_re, a1_re);
+    StoreInterleaved4(out_re + 4 * j, Add(t0_re, t2_re), Add(t1_re, t3_re),
+                      Sub(t0_re, t2_re), Sub(t1_re, t3_re));
+    StoreInterleaved4(out_im + 4 * j, Add(t0_im, t2_im), Add(t1_im, t3_im),
+                      Sub(t0_im, t2_im), Sub(t1_im, t3_im));
+  }
+}
+
+// Radix2Pass() for spans of at least four.
+void Radix2PassV4sf(const float* twiddle_re,
+                    const float* twiddle_im,
+                    size_t span,
+                    size_t half,
+                    const float* in_re,
+                    const float* in_im,
+                    float* out_re,
+                    float* out_im) {
+  for (size_t j = 0; j < half; j += 4) {
+    const size_t k = j & (span - 1);
+    const size_t out = ((j - k) << 1) + k;
+    const v4sf w_re = Load(twiddle_re + k);
+    const v4sf w_im = Load(twiddle_im + k);
+    const v4sf a_re = Load(in_re + j);
+    const v4sf a_im = Load(in_im + j);
+    const v4sf c_re = Load(in_re + j + half);
+    const v4sf c_im = Load(in_im + j + half);
+    const v4sf b_re = Sub(Mul(c_re, w_re), Mul(c_im, w_im));
+    const v4sf b_im = Add(Mul(c_re, w_im), Mul(c_im, w_re));
+    Store(out_re + out, Add(a_re, b_re));
+    Store(out_im + out, Add(a_im, b_im));
+    Store(out_re + out + span, Sub(a_re, b_re));
+    Store(out_im + out + span, Sub(a_im, b_im));
+  }
+}
+#endif  // REAL_FOURIER_HAS_V4SF
+
+}  // namespace
+
+RealFourierSimd::RealFourierSimd(int fft_order)
+    : order_(fft_order),
+      length_(FftLength(order_)),
+      half_length_(length_ / 2),
+      pass_twiddle_re_(
+          AllocRealBuffer(static_cast<int>(PassTwiddleSize(half_length_)))),
+      pass_twiddle_im_(
+          AllocRealBuffer(static_cast<int>(PassTwiddleSize(half_length_)))),
+      split_twiddle_re_(AllocRealBuffer(static_cast<int>(half_length_))),
+      split_twiddle_im_(AllocRealBuffer(static_cast<int>(half_length_))),
+      work_re_(AllocRealBuffer(static_cast<int>(half_length_))),
+      work_im_(AllocRealBuffer(static_cast<int>(half_length_))),
+      scratch_re_(AllocRealBuffer(static_cast<int>(half_length_))),
+      scratch_im_(AllocRealBuffer(static_cast<int>(half_length_))) {
+  RTC_CHECK_GE(fft_order, 1);
+
+  float* twiddle_re = pass_twiddle_re_.get();
+  float* twiddle_im = pass_twiddle_im_.get();
+  size_t span = 1;
+  for (; span * 4 <= half_length_; span *= 4) {
+    for (size_t n = 1; n < 4; ++n) {
+      for (size_t k = 0; k < span; ++k) {
+        const double angle = -2.0 * kPi * n * k / (4 * span);
+        twiddle_re[(n - 1) * span + k] = static_cast<float>(std::cos(angle));
+        twiddle_im[(n - 1) * span + k] = static_cast<float>(std::sin(angle));
+      }
+    }
+    twiddle_re += PaddedSize(3 * span);
+    twiddle_im += PaddedSize(3 * span);
+  }
+  if (span < half_length_) {
+    for (size_t k = 0; k < span; ++k) {
+      const double angle = -kPi * k / span;
+      twiddle_re[k] = static_cast<float>(std::cos(angle));
+      twiddle_im[k] = static_cast<float>(std::sin(angle));
+    }
+  }
+
+  for (size_t k = 0; k < half_length_; ++k) {
+    const double angle = -2.0 * kPi * k / length_;
+    split_twiddle_re_[k] = static_cast<float>(std::cos(angle));
+    split_twiddle_im_[k] = static_cast<float>(std::sin(angle));
+  }
+}
+
+void RealFourierSimd::ComplexForward(const float** re, const float** im) const {
+  const float* twiddle_re = pass_twiddle_re_.get();
+  const float* twiddle_im = pass_twiddle_im_.get();
+  float* in_re = work_re_.get();
+  float* in_im = work_im_.get();
+  float* out_re = scratch_re_.get();
+  float* out_im = scratch_im_.get();
+  const size_t quarter = half_length_ / 4;
+  size_t span = 1;
+
+  for (; span * 4 <= half_length_; span *= 4) {
+#if defined(REAL_FOURIER_HAS_V4SF)
+    if (span == 1 && quarter >= 4) {
+      FirstRadix4PassV4sf(quarter, in_re, in_im, out_re, out_im);
+    } else if (span >= 4) {
+      Radix4PassV4sf(twiddle_re, twiddle_im, span, quarter, in_re, in_im,
+                     out_re, out_im);
+    } else
+#endif
+    {
+      Radix4Pass(twiddle_re, twiddle_im, span, quarter, in_re, in_im, out_re,
+                 out_im);
+    }
+    twiddle_re += PaddedSize(3 * span);
+    twiddle_im += PaddedSize(3 * span);
+    std::swap(in_re, out_re);
+    std::swap(in_im, out_im);
+  }
+
+  if (span < half_length_) {
+    const size_t half = half_length_ / 2;
+#if defined(REAL_FOURIER_HAS_V4SF)
+    if (span >= 4) {
+      Radix2PassV4sf(twiddle_re, twiddle_im, span, half, in_re, in_im, out_re,
+                     out_im);
+    } else
+#endif
+    {
+      Radix2Pass(twiddle_re, twiddle_im, span, half, in_re, in_im, out_re,
+                 out_im);
+    }
+    std::swap(in_re, out_re);
+    std::swap(in_im, out_im);
+  }
+
+  *re = in_re;
+  *im = in_im;
+}
+
+void RealFourierSimd::Forward(const float* src, complex<float>* dest) const {
+  const size_t n = half_length_;
+  // This cast is well-defined since C++11. See "Non-static data members" at:
+  // http://en.cppreference.com/w/cpp/numeric/complex
+  auto dest_float = reinterpret_cast<float*>(dest);
+  size_t k = 0;
+
+  // The even samples are the real and the odd ones the imaginary part of the
+  // half length transform.
+#if defined(REAL_FOURIER_HAS_V4SF)
+  for (; k + 4 <= n; k += 4) {
+    v4sf even, odd;
+    LoadDeinterleaved(src + 2 * k, &even, &odd);
+    Store(work_re_.get() + k, even);
+    Store(work_im_.get() + k, odd);
+  }
+#endif
+  for (; k < n; ++k) {
+    work_re_[k] = src[2 * k];
+    work_im_[k] = src[2 * k + 1];
+  }
+
+  const float* re = nullptr;
+  const float* im = nullptr;
+  ComplexForward(&re, &im);
+
+  // Split into the spectra of the even and odd samples and combine them.
+  dest[0] = complex<float>(re[0] + im[0], 0.0f);
+  dest[n] = complex<float>(re[0] - im[0], 0.0f);
+  k = 1;
+#if defined(REAL_FOURIER_HAS_V4SF)
+  const v4sf half = Splat(0.5f);
+  for (; k + 4 <= n; k += 4) {
+    const v4sf z_re = LoadUnaligned(re + k);
+    const v4sf z_im = LoadUnaligned(im + k);
+    const v4sf mirror_re = Reverse(LoadUnaligned(re + n - k - 3));
+    const v4sf mirror_im = Reverse(LoadUnaligned(im + n - k - 3));
+    const v4sf even_re = Mul(half, Add(z_re, mirror_re));
+    const v4sf even_im = Mul(half, Sub(z_im, mirror_im));
+    const v4sf odd_re = Mul(half, Add(z_im, mirror_im));
+    const v4sf odd_im = Mul(half, Sub(mirror_re, z_re));
+    const v4sf w_re = LoadUnaligned(split_twiddle_re_.get() + k);
+    const v4sf w_im = LoadUnaligned(split_twiddle_im_.get() + k);
+    StoreInterleaved(
+        dest_float + 2 * k,
+        Add(even_re, Sub(Mul(w_re, odd_re), Mul(w_im, odd_im))),
+        Add(even_im, Add(Mul(w_re, odd_im), Mul(w_im, odd_re))));
+  }
+#endif
+  for (; k < n; ++k) {
+    const size_t mirror = n - k;
+    const float even_re = 0.5f * (re[k] + re[mirror]);
+    const float even_im = 0.5f * (im[k] - im[mirror]);
+    const float odd_re = 0.5f * (im[k] + im[mirror]);
+    const float odd_im = 0.5f * (re[mirror] - re[k]);
+    const float w_re = split_twiddle_re_[k];
+    const float w_im = split_twiddle_im_[k];
+    dest_float[2 * k] = even_re + w_re * odd_re - w_im * odd_im;
+    dest_float[2 * k + 1] = even_im + w_re * odd_im + w_im * odd_re;
+  }
+}
+
+void RealFourierSimd::Inverse(const complex<float>* src, float* dest) const {
+  const size_t n = half_length_;
+  size_t k = 0;
+
+  // Recombine the spectra of the even and odd samples into the half length
+  // spectrum. Its conjugate goes into the forward transform, since the
+  // inverse transform is the conjugate of the forward transform of the
+  // conjugate.
+#if defined(REAL_FOURIER_HAS_V4SF)
+  auto src_float = reinterpret_cast<const float*>(src);
+  const v4sf half = Splat(0.5f);
+  for (; k + 4 <= n; k += 4) {
+    v4sf x_re, x_im, mirror_re, mirror_im;
+    LoadDeinterleaved(src_float + 2 * k, &x_re, &x_im);
+    LoadDeinterleaved(src_float + 2 * (n - k - 3), &mirror_re, &mirror_im);
+    mirror_re = Reverse(mirror_re);
+    mirror_im = Reverse(mirror_im);
+    const v4sf even_re = Mul(half, Add(x_re, mirror_re));
+    const v4sf even_im = Mul(half, Sub(x_im, mirror_im));
+    const v4sf diff_re = Mul(half, Sub(x_re, mirror_re));
+    const v4sf diff_im = Mul(half, Add(x_im, mirror_im));
+    // Divide by the twiddle, i.e. multiply with its conjugate.
+    const v4sf w_re = Load(split_twiddle_re_.get() + k);
+    const v4sf w_im = Load(split_twiddle_im_.get() + k);
+    const v4sf odd_re = Add(Mul(diff_re, w_re), Mul(diff_im, w_im));
+    const v4sf odd_im = Sub(Mul(diff_im, w_re), Mul(diff_re, w_im));
+    Store(work_re_.get() + k, Sub(even_re, odd_im));
+    Store(work_im_.get() + k, Sub(Splat(0.0f), Add(even_im, odd_re)));
+  }
+#endif
+  for (; k < n; ++k) {
+    const size_t mirror = n - k;
+    const float even_re = 0.5f * (src[k].real() + src[mirror].real());
+    const float even_im = 0.5f * (src[k].imag() - src[mirror].imag());
+    const float diff_re = 0.5f * (src[k].real() - src[mirror].real());
+    const float diff_im = 0.5f * (src[k].imag() + src[mirror].imag());
+    const float w_re = split_twiddle_re_[k];
+    const float w_im = split_twiddle_im_[k];
+    const float odd_re = diff_re * w_re + diff_im * w_im;
+    const float odd_im = diff_im * w_re - diff_re * w_im;
+    work_re_[k] = even_re - odd_im;
+    work_im_[k] = -(even_im + odd_re);
+  }
+
+  const float* re = nullptr;
+  const float* im = nullptr;
+  ComplexForward(&re, &im);
+
+  const float scale = 1.0f / n;
+  k = 0;
+#if defined(REAL_FOURIER_HAS_V4SF)
+  const v4sf scale_v = Splat(scale);
+  const v4sf minus_scale_v = Splat(-scale);
+  for (; k + 4 <= n; k += 4) {
+    StoreInterleaved(dest + 2 * k, Mul(Load(re + k), scale_v),
+                     Mul(Load(im + k), minus_scale_v));
+  }
+#endif
+  for (; k < n; ++k) {
+    dest[2 * k] = re[k] * scale;
+    dest[2 * k + 1] = -im[k] * scale;
+  }
+}
+
+}  // namespace webrtc
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef WEBRTC_COMMON_AUDIO_REAL_FOURIER_SIMD_H_
+#define WEBRTC_COMMON_AUDIO_REAL_FOURIER_SIMD_H_
+
+#include <complex>
+
+#include "webrtc/common_audio/real_fourier.h"
+
+namespace webrtc {
+
+// Real DFT computed through a complex FFT of half the length. The complex
+// FFT is a radix-4 Stockham transform on split real/imaginary arrays, so all
+// butterflies and the split into the real spectrum run four at a time on SSE
+// or Neon. Platforms without either run the same passes in plain C.
+class RealFourierSimd : public RealFourier {
+ public:
+  explicit RealFourierSimd(int fft_order);
+
+  void Forward(const float* src, std::complex<float>* dest) const override;
+  void Inverse(const std::complex<float>* src, float* dest) const override;
+
+  int order() const override {
+    return order_;
+  }
+
+ private:
+  // Transforms the |half_length_| complex values in |work_re_|/|work_im_|.
+  // Points |re| and |im| to the buffers holding the result.
+  void ComplexForward(const float** re, const float** im) const;
+
+  const int order_;
+  const size_t length_;
+  const size_t half_length_;
+  // Twiddles of all passes, in the order the passes run.
+  const fft_real_scoper pass_twiddle_re_;
+  const fft_real_scoper pass_twiddle_im_;
+  // exp(-2 * pi * i * k / length_) for splitting the half length transform.
+  const fft_real_scoper split_twiddle_re_;
+  const fft_real_scoper split_twiddle_im_;
+  // Input of the complex FFT, the passes alternate with the scratch buffers.
+  const fft_real_scoper work_re_;
+  const fft_real_scoper work_im_;
+  const fft_real_scoper scratch_re_;
+  const fft_real_scoper scratch_im_;
+};
+
+}  // namespace webrtc
+
+#endif  // WEBRTC_COMMON_AUDIO_REAL_FOURIER_SIMD_H_
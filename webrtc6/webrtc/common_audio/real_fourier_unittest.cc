@@ -16,6 +16,7 @@
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/common_audio/real_fourier_openmax.h"
 #include "webrtc/common_audio/real_fourier_ooura.h"
+#include "webrtc/common_audio/real_fourier_simd.h"
 
 namespace webrtc {
 
@@ -74,7 +75,8 @@ using FftTypes = ::testing::Types<
 #if defined(RTC_USE_OPENMAX_DL)
     RealFourierOpenmax,
 #endif
-    RealFourierOoura>;
+    RealFourierOoura,
+    RealFourierSimd>;
 TYPED_TEST_CASE(RealFourierTest, FftTypes);
 
 TYPED_TEST(RealFourierTest, SimpleForwardTransform) {
@@ -106,5 +108,38 @@ TYPED_TEST(RealFourierTest, SimpleBackwardTransform) {
   EXPECT_NEAR(this->real_buffer_[3], 4.0f, 1e-8f);
 }
 
+TEST(RealFourierSimdTest, MatchesOoura) {
+  srand(42);
+  for (int order = 1; order <= 10; ++order) {
+    RealFourierOoura ooura(order);
+    RealFourierSimd simd(order);
+    const int length = static_cast<int>(RealFourier::FftLength(order));
+    const int complex_length =
+        static_cast<int>(RealFourier::ComplexLength(order));
+    RealFourier::fft_real_scoper input = RealFourier::AllocRealBuffer(length);
+    RealFourier::fft_real_scoper output = RealFourier::AllocRealBuffer(length);
+    RealFourier::fft_cplx_scoper expected =
+        RealFourier::AllocCplxBuffer(complex_length);
+    RealFourier::fft_cplx_scoper actual =
+        RealFourier::AllocCplxBuffer(complex_length);
+    for (int i = 0; i < length; ++i) {
+      input[i] = static_cast<float>(rand()) / RAND_MAX * 2.0f - 1.0f;
+    }
+
+    ooura.Forward(input.get(), expected.get());
+    simd.Forward(input.get(), actual.get());
+    const float tolerance = 1e-5f * length;
+    for (int i = 0; i < complex_length; ++i) {
+      EXPECT_NEAR(expected[i].real(), actual[i].real(), tolerance);
+      EXPECT_NEAR(expected[i].imag(), actual[i].imag(), tolerance);
+    }
+
+    simd.Inverse(actual.get(), output.get());
+    for (int i = 0; i < length; ++i) {
+      EXPECT_NEAR(input[i], output[i], 1e-5f);
+    }
+  }
+}
+
 }  // namespace webrtc
 
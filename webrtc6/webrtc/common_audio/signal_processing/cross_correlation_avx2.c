@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/common_audio/signal_processing/include/signal_processing_library.h"
+
+#include <immintrin.h>
+
+// Every product is shifted before it's accumulated, exactly like the C
+// version, so results are bit exact including wrap around.
+static inline int32_t DotProductWithShift(const int16_t* seq1,
+                                          const int16_t* seq2,
+                                          size_t length,
+                                          int right_shifts) {
+  const __m128i shift = _mm_cvtsi32_si128(right_shifts);
+  __m256i sum_v = _mm256_setzero_si256();
+  __m128i sum;
+  size_t i = 0;
+  int32_t corr = 0;
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i a = _mm256_loadu_si256((const __m256i*)&seq1[i]);
+    const __m256i b = _mm256_loadu_si256((const __m256i*)&seq2[i]);
+    const __m256i lo = _mm256_mullo_epi16(a, b);
+    const __m256i hi = _mm256_mulhi_epi16(a, b);
+    sum_v = _mm256_add_epi32(
+        sum_v, _mm256_sra_epi32(_mm256_unpacklo_epi16(lo, hi), shift));
+    sum_v = _mm256_add_epi32(
+        sum_v, _mm256_sra_epi32(_mm256_unpackhi_epi16(lo, hi), shift));
+  }
+  sum = _mm_add_epi32(_mm256_castsi256_si128(sum_v),
+                      _mm256_extracti128_si256(sum_v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  corr = _mm_cvtsi128_si32(sum);
+
+  for (; i < length; i++) {
+    corr += (seq1[i] * seq2[i]) >> right_shifts;
+  }
+
+  return corr;
+}
+
+void WebRtcSpl_CrossCorrelationAvx2(int32_t* cross_correlation,
+                                    const int16_t* seq1,
+                                    const int16_t* seq2,
+                                    size_t dim_seq,
+                                    size_t dim_cross_correlation,
+                                    int right_shifts,
+                                    int step_seq2) {
+  size_t i = 0;
+
+  for (i = 0; i < dim_cross_correlation; i++) {
+    *cross_correlation++ = DotProductWithShift(seq1, seq2, dim_seq,
+                                               right_shifts);
+    seq2 += step_seq2;
+  }
+}
@@ -156,6 +156,12 @@ int16_t WebRtcSpl_MaxAbsValueW16C(const int16_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MaxAbsValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MaxAbsValueW16Sse2(const int16_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int16_t WebRtcSpl_MaxAbsValueW16Avx2(const int16_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MaxAbsValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -173,6 +179,12 @@ int32_t WebRtcSpl_MaxAbsValueW32C(const int32_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MaxAbsValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MaxAbsValueW32Sse2(const int32_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int32_t WebRtcSpl_MaxAbsValueW32Avx2(const int32_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS_DSP_R1_LE)
 int32_t WebRtcSpl_MaxAbsValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -190,6 +202,12 @@ int16_t WebRtcSpl_MaxValueW16C(const int16_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MaxValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MaxValueW16Sse2(const int16_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int16_t WebRtcSpl_MaxValueW16Avx2(const int16_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MaxValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -207,6 +225,12 @@ int32_t WebRtcSpl_MaxValueW32C(const int32_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MaxValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MaxValueW32Sse2(const int32_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int32_t WebRtcSpl_MaxValueW32Avx2(const int32_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS32_LE)
 int32_t WebRtcSpl_MaxValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -224,6 +248,12 @@ int16_t WebRtcSpl_MinValueW16C(const int16_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MinValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MinValueW16Sse2(const int16_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int16_t WebRtcSpl_MinValueW16Avx2(const int16_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MinValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -241,6 +271,12 @@ int32_t WebRtcSpl_MinValueW32C(const int32_t* vector, size_t length);
 #if (defined WEBRTC_DETECT_NEON) || (defined WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MinValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MinValueW32Sse2(const int32_t* vector, size_t length);
+#if defined(WEBRTC_X86_AVX2)
+int32_t WebRtcSpl_MinValueW32Avx2(const int32_t* vector, size_t length);
+#endif
+#endif
 #if defined(MIPS32_LE)
 int32_t WebRtcSpl_MinValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -540,6 +576,24 @@ void WebRtcSpl_CrossCorrelationNeon(int32_t* cross_correlation,
                                     int right_shifts,
                                     int step_seq2);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+void WebRtcSpl_CrossCorrelationSse2(int32_t* cross_correlation,
+                                    const int16_t* seq1,
+                                    const int16_t* seq2,
+                                    size_t dim_seq,
+                                    size_t dim_cross_correlation,
+                                    int right_shifts,
+                                    int step_seq2);
+#if defined(WEBRTC_X86_AVX2)
+void WebRtcSpl_CrossCorrelationAvx2(int32_t* cross_correlation,
+                                    const int16_t* seq1,
+                                    const int16_t* seq2,
+                                    size_t dim_seq,
+                                    size_t dim_cross_correlation,
+                                    int right_shifts,
+                                    int step_seq2);
+#endif
+#endif
 #if defined(MIPS32_LE)
 void WebRtcSpl_CrossCorrelation_mips(int32_t* cross_correlation,
                                      const int16_t* seq1,
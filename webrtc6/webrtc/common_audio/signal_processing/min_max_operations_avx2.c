@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <assert.h>
+#include <immintrin.h>
+#include <stdlib.h>
+
+#include "webrtc/common_audio/signal_processing/include/signal_processing_library.h"
+
+static inline int16_t MaxLanesW16(__m256i v) {
+  __m128i m = _mm_max_epi16(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  m = _mm_max_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_max_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  m = _mm_max_epi16(m, _mm_shufflelo_epi16(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_extract_epi16(m, 0);
+}
+
+static inline int16_t MinLanesW16(__m256i v) {
+  __m128i m = _mm_min_epi16(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  m = _mm_min_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  m = _mm_min_epi16(m, _mm_shufflelo_epi16(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_extract_epi16(m, 0);
+}
+
+static inline int32_t MaxLanesW32(__m256i v) {
+  __m128i m = _mm_max_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(m);
+}
+
+static inline int32_t MinLanesW32(__m256i v) {
+  __m128i m = _mm_min_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(m);
+}
+
+// Maximum absolute value of word16 vector. AVX2 version for x86.
+int16_t WebRtcSpl_MaxAbsValueW16Avx2(const int16_t* vector, size_t length) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i maximum_v = zero;
+  int absolute = 0, maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    // The saturating negation already maps abs(-32768) to 32767.
+    maximum_v = _mm256_max_epi16(
+        maximum_v, _mm256_max_epi16(in, _mm256_subs_epi16(zero, in)));
+  }
+  maximum = MaxLanesW16(maximum_v);
+
+  for (; i < length; i++) {
+    absolute = abs((int)vector[i]);
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+
+  // Guard the case for abs(-32768).
+  if (maximum > WEBRTC_SPL_WORD16_MAX) {
+    maximum = WEBRTC_SPL_WORD16_MAX;
+  }
+
+  return (int16_t)maximum;
+}
+
+// Maximum absolute value of word32 vector. AVX2 version for x86.
+int32_t WebRtcSpl_MaxAbsValueW32Avx2(const int32_t* vector, size_t length) {
+  __m256i maximum_v = _mm256_setzero_si256();
+  uint32_t absolute = 0, maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    __m256i absolute_v = _mm256_abs_epi32(in);
+    // abs(0x80000000) is 0x80000000, clamp it to WEBRTC_SPL_WORD32_MAX.
+    absolute_v = _mm256_sub_epi32(absolute_v,
+                                  _mm256_srli_epi32(absolute_v, 31));
+    maximum_v = _mm256_max_epi32(maximum_v, absolute_v);
+  }
+  maximum = (uint32_t)MaxLanesW32(maximum_v);
+
+  for (; i < length; i++) {
+    absolute = abs((int)vector[i]);
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+
+  maximum = WEBRTC_SPL_MIN(maximum, WEBRTC_SPL_WORD32_MAX);
+
+  return (int32_t)maximum;
+}
+
+// Maximum value of word16 vector. AVX2 version for x86.
+int16_t WebRtcSpl_MaxValueW16Avx2(const int16_t* vector, size_t length) {
+  __m256i maximum_v = _mm256_set1_epi16(WEBRTC_SPL_WORD16_MIN);
+  int16_t maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    maximum_v = _mm256_max_epi16(maximum_v, in);
+  }
+  maximum = MaxLanesW16(maximum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] > maximum)
+      maximum = vector[i];
+  }
+
+  return maximum;
+}
+
+// Maximum value of word32 vector. AVX2 version for x86.
+int32_t WebRtcSpl_MaxValueW32Avx2(const int32_t* vector, size_t length) {
+  __m256i maximum_v = _mm256_set1_epi32(WEBRTC_SPL_WORD32_MIN);
+  int32_t maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    maximum_v = _mm256_max_epi32(maximum_v, in);
+  }
+  maximum = MaxLanesW32(maximum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] > maximum)
+      maximum = vector[i];
+  }
+
+  return maximum;
+}
+
+// Minimum value of word16 vector. AVX2 version for x86.
+int16_t WebRtcSpl_MinValueW16Avx2(const int16_t* vector, size_t length) {
+  __m256i minimum_v = _mm256_set1_epi16(WEBRTC_SPL_WORD16_MAX);
+  int16_t minimum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    minimum_v = _mm256_min_epi16(minimum_v, in);
+  }
+  minimum = MinLanesW16(minimum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] < minimum)
+      minimum = vector[i];
+  }
+
+  return minimum;
+}
+
+// Minimum value of word32 vector. AVX2 version for x86.
+int32_t WebRtcSpl_MinValueW32Avx2(const int32_t* vector, size_t length) {
+  __m256i minimum_v = _mm256_set1_epi32(WEBRTC_SPL_WORD32_MAX);
+  int32_t minimum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m256i in = _mm256_loadu_si256((const __m256i*)&vector[i]);
+    minimum_v = _mm256_min_epi32(minimum_v, in);
+  }
+  minimum = MinLanesW32(minimum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] < minimum)
+      minimum = vector[i];
+  }
+
+  return minimum;
+}
@@ -0,0 +1,204 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <assert.h>
+#include <emmintrin.h>
+#include <stdlib.h>
+
+#include "webrtc/common_audio/signal_processing/include/signal_processing_library.h"
+
+// SSE2 has no 32 bit min/max instructions, they are built from compares.
+static inline __m128i MaxW32(__m128i a, __m128i b) {
+  const __m128i greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, a),
+                      _mm_andnot_si128(greater, b));
+}
+
+static inline __m128i MinW32(__m128i a, __m128i b) {
+  const __m128i greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, b),
+                      _mm_andnot_si128(greater, a));
+}
+
+static inline int16_t MaxLanesW16(__m128i v) {
+  v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_max_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_extract_epi16(v, 0);
+}
+
+static inline int16_t MinLanesW16(__m128i v) {
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_min_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_extract_epi16(v, 0);
+}
+
+static inline int32_t MaxLanesW32(__m128i v) {
+  v = MaxW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = MaxW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+static inline int32_t MinLanesW32(__m128i v) {
+  v = MinW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = MinW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+// Maximum absolute value of word16 vector. SSE2 version for x86.
+int16_t WebRtcSpl_MaxAbsValueW16Sse2(const int16_t* vector, size_t length) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i maximum_v = zero;
+  int absolute = 0, maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    // The saturating negation already maps abs(-32768) to 32767.
+    maximum_v = _mm_max_epi16(maximum_v,
+                              _mm_max_epi16(in, _mm_subs_epi16(zero, in)));
+  }
+  maximum = MaxLanesW16(maximum_v);
+
+  for (; i < length; i++) {
+    absolute = abs((int)vector[i]);
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+
+  // Guard the case for abs(-32768).
+  if (maximum > WEBRTC_SPL_WORD16_MAX) {
+    maximum = WEBRTC_SPL_WORD16_MAX;
+  }
+
+  return (int16_t)maximum;
+}
+
+// Maximum absolute value of word32 vector. SSE2 version for x86.
+int32_t WebRtcSpl_MaxAbsValueW32Sse2(const int32_t* vector, size_t length) {
+  __m128i maximum_v = _mm_setzero_si128();
+  uint32_t absolute = 0, maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 4 <= length; i += 4) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    const __m128i sign = _mm_srai_epi32(in, 31);
+    __m128i absolute_v = _mm_sub_epi32(_mm_xor_si128(in, sign), sign);
+    // abs(0x80000000) is 0x80000000, clamp it to WEBRTC_SPL_WORD32_MAX.
+    absolute_v = _mm_sub_epi32(absolute_v, _mm_srli_epi32(absolute_v, 31));
+    maximum_v = MaxW32(maximum_v, absolute_v);
+  }
+  maximum = (uint32_t)MaxLanesW32(maximum_v);
+
+  for (; i < length; i++) {
+    absolute = abs((int)vector[i]);
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+
+  maximum = WEBRTC_SPL_MIN(maximum, WEBRTC_SPL_WORD32_MAX);
+
+  return (int32_t)maximum;
+}
+
+// Maximum value of word16 vector. SSE2 version for x86.
+int16_t WebRtcSpl_MaxValueW16Sse2(const int16_t* vector, size_t length) {
+  __m128i maximum_v = _mm_set1_epi16(WEBRTC_SPL_WORD16_MIN);
+  int16_t maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    maximum_v = _mm_max_epi16(maximum_v, in);
+  }
+  maximum = MaxLanesW16(maximum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] > maximum)
+      maximum = vector[i];
+  }
+
+  return maximum;
+}
+
+// Maximum value of word32 vector. SSE2 version for x86.
+int32_t WebRtcSpl_MaxValueW32Sse2(const int32_t* vector, size_t length) {
+  __m128i maximum_v = _mm_set1_epi32(WEBRTC_SPL_WORD32_MIN);
+  int32_t maximum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 4 <= length; i += 4) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    maximum_v = MaxW32(maximum_v, in);
+  }
+  maximum = MaxLanesW32(maximum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] > maximum)
+      maximum = vector[i];
+  }
+
+  return maximum;
+}
+
+// Minimum value of word16 vector. SSE2 version for x86.
+int16_t WebRtcSpl_MinValueW16Sse2(const int16_t* vector, size_t length) {
+  __m128i minimum_v = _mm_set1_epi16(WEBRTC_SPL_WORD16_MAX);
+  int16_t minimum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    minimum_v = _mm_min_epi16(minimum_v, in);
+  }
+  minimum = MinLanesW16(minimum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] < minimum)
+      minimum = vector[i];
+  }
+
+  return minimum;
+}
+
+// Minimum value of word32 vector. SSE2 version for x86.
+int32_t WebRtcSpl_MinValueW32Sse2(const int32_t* vector, size_t length) {
+  __m128i minimum_v = _mm_set1_epi32(WEBRTC_SPL_WORD32_MAX);
+  int32_t minimum = 0;
+  size_t i = 0;
+
+  assert(length > 0);
+
+  for (i = 0; i + 4 <= length; i += 4) {
+    const __m128i in = _mm_loadu_si128((const __m128i*)&vector[i]);
+    minimum_v = MinW32(minimum_v, in);
+  }
+  minimum = MinLanesW32(minimum_v);
+
+  for (; i < length; i++) {
+    if (vector[i] < minimum)
+      minimum = vector[i];
+  }
+
+  return minimum;
+}
@@ -9,7 +9,7 @@
  */
 
 /* The global function contained in this file initializes SPL function
- * pointers, currently only for ARM platforms.
+ * pointers for ARM, MIPS and x86 platforms.
  *
  * Some code came from common/rtcd.c in the WebM project.
  */
@@ -61,6 +61,33 @@ static void InitPointersToNeon() {
 }
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+/* Initialize function pointers to the x86 versions. SSE2 is always available,
+ * AVX2 is used if the CPU and OS support it.
+ */
+static void InitPointersToX86() {
+  InitPointersToC();
+  WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Sse2;
+  WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Sse2;
+  WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Sse2;
+  WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Sse2;
+  WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Sse2;
+  WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Sse2;
+  WebRtcSpl_CrossCorrelation = WebRtcSpl_CrossCorrelationSse2;
+#if defined(WEBRTC_X86_AVX2)
+  if (WebRtc_GetCPUInfo(kAVX2)) {
+    WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Avx2;
+    WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Avx2;
+    WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Avx2;
+    WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Avx2;
+    WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Avx2;
+    WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Avx2;
+    WebRtcSpl_CrossCorrelation = WebRtcSpl_CrossCorrelationAvx2;
+  }
+#endif
+}
+#endif
+
 #if defined(MIPS32_LE)
 /* Initialize function pointers to the MIPS version. */
 static void InitPointersToMIPS() {
@@ -94,6 +121,8 @@ static void InitFunctionPointers(void) {
   InitPointersToNeon();
 #elif defined(MIPS32_LE)
   InitPointersToMIPS();
+#elif defined(WEBRTC_ARCH_X86_FAMILY)
+  InitPointersToX86();
 #else
   InitPointersToC();
 #endif  /* WEBRTC_DETECT_NEON */
@@ -370,6 +370,25 @@ static void WebRtcAecm_InitNeon(void)
 }
 #endif
 
+// Initialize function pointers for x86, SSE2 is always available and AVX2 is
+// used if the CPU and OS support it.
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+static void WebRtcAecm_InitX86(void)
+{
+  WebRtcAecm_StoreAdaptiveChannel = WebRtcAecm_StoreAdaptiveChannelSse2;
+  WebRtcAecm_ResetAdaptiveChannel = WebRtcAecm_ResetAdaptiveChannelSse2;
+  WebRtcAecm_CalcLinearEnergies = WebRtcAecm_CalcLinearEnergiesSse2;
+#if defined(WEBRTC_X86_AVX2)
+  if (WebRtc_GetCPUInfo(kAVX2))
+  {
+    WebRtcAecm_StoreAdaptiveChannel = WebRtcAecm_StoreAdaptiveChannelAvx2;
+    WebRtcAecm_ResetAdaptiveChannel = WebRtcAecm_ResetAdaptiveChannelAvx2;
+    WebRtcAecm_CalcLinearEnergies = WebRtcAecm_CalcLinearEnergiesAvx2;
+  }
+#endif
+}
+#endif
+
 // Initialize function pointers for MIPS platform.
 #if defined(MIPS32_LE)
 static void WebRtcAecm_InitMips(void)
@@ -518,6 +537,10 @@ int WebRtcAecm_InitCore(AecmCore* const aecm, int samplingFreq) {
     WebRtcAecm_InitNeon();
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    WebRtcAecm_InitX86();
+#endif
+
 #if defined(MIPS32_LE)
     WebRtcAecm_InitMips();
 #endif
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/modules/audio_processing/aecm/aecm_core.h"
+
+#include <immintrin.h>
+#include <string.h>
+
+// This file is compiled with -mavx2, the functions are only selected in
+// WebRtcAecm_InitCore() if the CPU supports AVX2.
+
+static inline uint32_t AddLanes(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+void WebRtcAecm_CalcLinearEnergiesAvx2(AecmCore* aecm,
+                                       const uint16_t* far_spectrum,
+                                       int32_t* echo_est,
+                                       uint32_t* far_energy,
+                                       uint32_t* echo_energy_adapt,
+                                       uint32_t* echo_energy_stored) {
+  __m256i far_energy_v = _mm256_setzero_si256();
+  __m256i echo_adapt_v = _mm256_setzero_si256();
+  __m256i echo_stored_v = _mm256_setzero_si256();
+  int i;
+
+  // All sums wrap around like the uint32_t sums of the C version, so the
+  // order of additions doesn't change the result.
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m256i spectrum = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128((const __m128i*)&far_spectrum[i]));
+    const __m256i stored = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]));
+    const __m256i adapt = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)&aecm->channelAdapt16[i]));
+    const __m256i est = _mm256_mullo_epi32(stored, spectrum);
+
+    _mm256_storeu_si256((__m256i*)&echo_est[i], est);
+    far_energy_v = _mm256_add_epi32(far_energy_v, spectrum);
+    echo_stored_v = _mm256_add_epi32(echo_stored_v, est);
+    echo_adapt_v = _mm256_add_epi32(echo_adapt_v, _mm256_mullo_epi32(adapt, spectrum));
+  }
+
+  echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i], far_spectrum[i]);
+  *far_energy += AddLanes(far_energy_v) + far_spectrum[i];
+  *echo_energy_adapt += AddLanes(echo_adapt_v) +
+                        aecm->channelAdapt16[i] * far_spectrum[i];
+  *echo_energy_stored += AddLanes(echo_stored_v) + (uint32_t)echo_est[i];
+}
+
+void WebRtcAecm_StoreAdaptiveChannelAvx2(AecmCore* aecm,
+                                         const uint16_t* far_spectrum,
+                                         int32_t* echo_est) {
+  int i;
+
+  // During startup we store the channel every block.
+  memcpy(aecm->channelStored, aecm->channelAdapt16, sizeof(int16_t) * PART_LEN1);
+  // Recalculate echo estimate
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m256i spectrum = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128((const __m128i*)&far_spectrum[i]));
+    const __m256i stored = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]));
+    _mm256_storeu_si256((__m256i*)&echo_est[i], _mm256_mullo_epi32(stored, spectrum));
+  }
+  echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i], far_spectrum[i]);
+}
+
+void WebRtcAecm_ResetAdaptiveChannelAvx2(AecmCore* aecm) {
+  int i;
+
+  // The stored channel has a significantly lower MSE than the adaptive one for
+  // two consecutive calculations. Reset the adaptive channel.
+  memcpy(aecm->channelAdapt16, aecm->channelStored, sizeof(int16_t) * PART_LEN1);
+  // Restore the W32 channel
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m256i stored = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]));
+    _mm256_storeu_si256((__m256i*)&aecm->channelAdapt32[i], _mm256_slli_epi32(stored, 16));
+  }
+  aecm->channelAdapt32[i] = (int32_t)aecm->channelStored[i] << 16;
+}
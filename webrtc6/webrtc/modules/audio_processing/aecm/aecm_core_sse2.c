@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/modules/audio_processing/aecm/aecm_core.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+// SSE2 is part of the x86-64 baseline and required by the build on 32 bit x86,
+// so these are used without runtime detection.
+
+static inline uint32_t AddLanes(__m128i v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+// Multiplies signed 16 bit by unsigned 16 bit values, like
+// WEBRTC_SPL_MUL_16_U16, into eight 32 bit products.
+static inline void MulS16U16(__m128i a, __m128i b, __m128i* low, __m128i* high) {
+  const __m128i lo = _mm_mullo_epi16(a, b);
+  // unsigned high half, corrected for negative a
+  const __m128i hi = _mm_sub_epi16(_mm_mulhi_epu16(a, b),
+                                   _mm_and_si128(_mm_srai_epi16(a, 15), b));
+  *low = _mm_unpacklo_epi16(lo, hi);
+  *high = _mm_unpackhi_epi16(lo, hi);
+}
+
+void WebRtcAecm_CalcLinearEnergiesSse2(AecmCore* aecm,
+                                       const uint16_t* far_spectrum,
+                                       int32_t* echo_est,
+                                       uint32_t* far_energy,
+                                       uint32_t* echo_energy_adapt,
+                                       uint32_t* echo_energy_stored) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i far_energy_v = zero;
+  __m128i echo_adapt_v = zero;
+  __m128i echo_stored_v = zero;
+  int i;
+
+  // All sums wrap around like the uint32_t sums of the C version, so the
+  // order of additions doesn't change the result.
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m128i spectrum = _mm_loadu_si128((const __m128i*)&far_spectrum[i]);
+    const __m128i stored = _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]);
+    const __m128i adapt = _mm_loadu_si128((const __m128i*)&aecm->channelAdapt16[i]);
+    __m128i est_low, est_high, adapt_low, adapt_high;
+
+    far_energy_v = _mm_add_epi32(far_energy_v, _mm_unpacklo_epi16(spectrum, zero));
+    far_energy_v = _mm_add_epi32(far_energy_v, _mm_unpackhi_epi16(spectrum, zero));
+
+    MulS16U16(stored, spectrum, &est_low, &est_high);
+    _mm_storeu_si128((__m128i*)&echo_est[i], est_low);
+    _mm_storeu_si128((__m128i*)&echo_est[i + 4], est_high);
+    echo_stored_v = _mm_add_epi32(echo_stored_v, est_low);
+    echo_stored_v = _mm_add_epi32(echo_stored_v, est_high);
+
+    MulS16U16(adapt, spectrum, &adapt_low, &adapt_high);
+    echo_adapt_v = _mm_add_epi32(echo_adapt_v, adapt_low);
+    echo_adapt_v = _mm_add_epi32(echo_adapt_v, adapt_high);
+  }
+
+  echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i], far_spectrum[i]);
+  *far_energy += AddLanes(far_energy_v) + far_spectrum[i];
+  *echo_energy_adapt += AddLanes(echo_adapt_v) +
+                        aecm->channelAdapt16[i] * far_spectrum[i];
+  *echo_energy_stored += AddLanes(echo_stored_v) + (uint32_t)echo_est[i];
+}
+
+void WebRtcAecm_StoreAdaptiveChannelSse2(AecmCore* aecm,
+                                         const uint16_t* far_spectrum,
+                                         int32_t* echo_est) {
+  int i;
+
+  // During startup we store the channel every block.
+  memcpy(aecm->channelStored, aecm->channelAdapt16, sizeof(int16_t) * PART_LEN1);
+  // Recalculate echo estimate
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m128i spectrum = _mm_loadu_si128((const __m128i*)&far_spectrum[i]);
+    const __m128i stored = _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]);
+    __m128i est_low, est_high;
+
+    MulS16U16(stored, spectrum, &est_low, &est_high);
+    _mm_storeu_si128((__m128i*)&echo_est[i], est_low);
+    _mm_storeu_si128((__m128i*)&echo_est[i + 4], est_high);
+  }
+  echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i], far_spectrum[i]);
+}
+
+void WebRtcAecm_ResetAdaptiveChannelSse2(AecmCore* aecm) {
+  const __m128i zero = _mm_setzero_si128();
+  int i;
+
+  // The stored channel has a significantly lower MSE than the adaptive one for
+  // two consecutive calculations. Reset the adaptive channel.
+  memcpy(aecm->channelAdapt16, aecm->channelStored, sizeof(int16_t) * PART_LEN1);
+  // Restore the W32 channel, interleaving with zero shifts each value by 16
+  for (i = 0; i < PART_LEN; i += 8) {
+    const __m128i stored = _mm_loadu_si128((const __m128i*)&aecm->channelStored[i]);
+    _mm_storeu_si128((__m128i*)&aecm->channelAdapt32[i], _mm_unpacklo_epi16(zero, stored));
+    _mm_storeu_si128((__m128i*)&aecm->channelAdapt32[i + 4], _mm_unpackhi_epi16(zero, stored));
+  }
+  aecm->channelAdapt32[i] = (int32_t)aecm->channelStored[i] << 16;
+}
@@ -0,0 +1,297 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+// Reduced version of audio_processing_performance_unittest.cc and
+// audio_processing_impl_locking_unittest.cc without the gtest, rtc and
+// AudioProcessing dependencies. It times the legacy C components on 10 ms
+// blocks, configured the way qTox's CallAudioDsp uses them: 48 kHz capture
+// resampled to 16 kHz mono, AECM, NSX, adaptive digital AGC and VAD mode 2.
+//
+// Usage: audio_processing_benchmark [blocks]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "webrtc/common_audio/signal_processing/include/signal_processing_library.h"
+#include "webrtc/common_audio/vad/include/webrtc_vad.h"
+#include "webrtc/modules/audio_processing/aecm/echo_control_mobile.h"
+#include "webrtc/modules/audio_processing/agc/legacy/gain_control.h"
+#include "webrtc/modules/audio_processing/ns/noise_suppression_x.h"
+#include "webrtc/modules/audio_processing/transient/transient_suppressor.h"
+
+namespace webrtc {
+namespace {
+
+const int kCaptureRateHz = 48000;
+const int kProcessRateHz = 16000;
+const size_t kCaptureBlock = kCaptureRateHz / 100;
+const size_t kProcessBlock = kProcessRateHz / 100;
+const int kEchoDelayMs = 80 + 40;  // Default AEC latency plus one frame.
+const int kDefaultBlocks = 3000;
+
+// Speech-like harmonics with noise, |blocks| 10 ms blocks at |rate_hz|.
+std::vector<int16_t> MakeSignal(int rate_hz, int blocks, int amplitude) {
+  const size_t samples = static_cast<size_t>(rate_hz / 100 * blocks);
+  std::vector<int16_t> signal(samples);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < samples; ++i) {
+    const double t = static_cast<double>(i) / rate_hz;
+    const double voice = std::sin(2 * M_PI * 220 * t) +
+                         0.5 * std::sin(2 * M_PI * 440 * t) +
+                         0.25 * std::sin(2 * M_PI * 1320 * t);
+    // Syllables of roughly 200 ms.
+    const double envelope = 0.5 + 0.5 * std::sin(2 * M_PI * 2.5 * t);
+    seed = seed * 1103515245 + 12345;
+    const int noise = static_cast<int>((seed >> 16) % 1000) - 500;
+    signal[i] = static_cast<int16_t>(voice * envelope * amplitude + noise);
+  }
+  return signal;
+}
+
+struct Durations {
+  std::vector<double> us;
+
+  void Report(const char* name, const char* config) {
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double d : us)
+      sum += d;
+    const double mean = sum / us.size();
+    const double median = us[us.size() / 2];
+    const double p99 = us[us.size() * 99 / 100];
+    // Same layout as test/testsupport/perf_test.h prints.
+    printf("RESULT %s: %s= {%.2f,%.2f} us/10ms median %.2f p99 %.2f max %.2f\n",
+           name, config, mean, p99 - median, median, p99, us.back());
+  }
+};
+
+// Calls |process| once per block and records how long each call took.
+Durations Time(int blocks, const std::function<void(int)>& process) {
+  Durations durations;
+  durations.us.reserve(blocks);
+  for (int i = 0; i < blocks; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    process(i);
+    const auto end = std::chrono::steady_clock::now();
+    durations.us.push_back(
+        std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  return durations;
+}
+
+void BenchmarkResampling(int blocks) {
+  const std::vector<int16_t> capture = MakeSignal(kCaptureRateHz, blocks, 6000);
+  const std::vector<int16_t> process = MakeSignal(kProcessRateHz, blocks, 6000);
+  int16_t out[kCaptureBlock];
+  int32_t tmpmem[496];
+
+  WebRtcSpl_State48khzTo16khz down;
+  WebRtcSpl_ResetResample48khzTo16khz(&down);
+  Time(blocks, [&](int i) {
+    WebRtcSpl_Resample48khzTo16khz(&capture[i * kCaptureBlock], out, &down,
+                                   tmpmem);
+  }).Report("resample", "48khz_to_16khz");
+
+  WebRtcSpl_State16khzTo48khz up;
+  WebRtcSpl_ResetResample16khzTo48khz(&up);
+  Time(blocks, [&](int i) {
+    WebRtcSpl_Resample16khzTo48khz(&process[i * kProcessBlock], out, &up,
+                                   tmpmem);
+  }).Report("resample", "16khz_to_48khz");
+}
+
+void BenchmarkNsx(int blocks) {
+  const std::vector<int16_t> near = MakeSignal(kProcessRateHz, blocks, 6000);
+  int16_t out[kProcessBlock];
+
+  for (int policy = 0; policy <= 3; ++policy) {
+    NsxHandle* nsx = WebRtcNsx_Create();
+    WebRtcNsx_Init(nsx, kProcessRateHz);
+    WebRtcNsx_set_policy(nsx, policy);
+    char config[32];
+    snprintf(config, sizeof(config), "16khz_policy%d", policy);
+    Time(blocks, [&](int i) {
+      const int16_t* const in_bands[] = {&near[i * kProcessBlock]};
+      int16_t* const out_bands[] = {out};
+      WebRtcNsx_Process(nsx, in_bands, 1, out_bands);
+    }).Report("nsx", config);
+    WebRtcNsx_Free(nsx);
+  }
+}
+
+void* CreateAecm(int16_t cng_mode) {
+  void* aecm = WebRtcAecm_Create();
+  WebRtcAecm_Init(aecm, kProcessRateHz);
+  AecmConfig config;
+  config.echoMode = AecmTrue;
+  config.cngMode = cng_mode;
+  WebRtcAecm_set_config(aecm, config);
+  return aecm;
+}
+
+void BenchmarkAecm(int blocks) {
+  const std::vector<int16_t> far = MakeSignal(kProcessRateHz, blocks, 8000);
+  std::vector<int16_t> near = far;
+  for (int16_t& sample : near)
+    sample /= 4;
+  int16_t out[kProcessBlock];
+
+  for (int16_t cng = AecmFalse; cng <= AecmTrue; ++cng) {
+    void* aecm = CreateAecm(cng);
+    char config[32];
+    snprintf(config, sizeof(config), "16khz_cng%d", cng);
+    Time(blocks, [&](int i) {
+      WebRtcAecm_BufferFarend(aecm, &far[i * kProcessBlock], kProcessBlock);
+      WebRtcAecm_Process(aecm, &near[i * kProcessBlock],
+                         &near[i * kProcessBlock], out, kProcessBlock,
+                         kEchoDelayMs);
+    }).Report("aecm", config);
+    WebRtcAecm_Free(aecm);
+  }
+}
+
+// Like CallAudioDsp, the far end is buffered from a second thread and the
+// instance is shared under a mutex. Reports the capture side only, including
+// the time it waits for the lock, while "aecm" includes the far end buffering.
+void BenchmarkAecmLocking(int blocks) {
+  const std::vector<int16_t> far = MakeSignal(kProcessRateHz, blocks, 8000);
+  std::vector<int16_t> near = far;
+  for (int16_t& sample : near)
+    sample /= 4;
+  int16_t out[kProcessBlock];
+
+  void* aecm = CreateAecm(AecmFalse);
+  std::mutex aecm_lock;
+  // AECM stays in its start up mode unless the far end is as far ahead of
+  // the near end as the echo delay says, like a playout buffer.
+  const int lead = kEchoDelayMs / 10 + 2;
+  std::atomic<int> rendered(0);
+  std::atomic<int> captured(0);
+  std::atomic<bool> done(false);
+
+  std::thread render([&] {
+    for (int i = 0; i < blocks && !done; ++i) {
+      while (!done && i > captured + lead)
+        std::this_thread::yield();
+      std::lock_guard<std::mutex> locker(aecm_lock);
+      WebRtcAecm_BufferFarend(aecm, &far[i * kProcessBlock], kProcessBlock);
+      rendered = i + 1;
+    }
+  });
+
+  Time(blocks, [&](int i) {
+    // Only waits at the start, the render thread stays ahead afterwards.
+    while (rendered < std::min(i + lead, blocks))
+      std::this_thread::yield();
+    std::lock_guard<std::mutex> locker(aecm_lock);
+    WebRtcAecm_Process(aecm, &near[i * kProcessBlock],
+                       &near[i * kProcessBlock], out, kProcessBlock,
+                       kEchoDelayMs);
+    captured = i + 1;
+  }).Report("aecm_locked", "16khz_render_thread");
+
+  done = true;
+  render.join();
+  WebRtcAecm_Free(aecm);
+}
+
+void BenchmarkAgc(int blocks) {
+  std::vector<int16_t> near = MakeSignal(kProcessRateHz, blocks, 2000);
+
+  void* agc = WebRtcAgc_Create();
+  WebRtcAgc_Init(agc, 0, 255, kAgcModeAdaptiveDigital, kProcessRateHz);
+  WebRtcAgcConfig config;
+  config.targetLevelDbfs = 3;
+  config.compressionGaindB = 9;
+  config.limiterEnable = 1;
+  WebRtcAgc_set_config(agc, config);
+
+  int32_t mic_level = 0;
+  Time(blocks, [&](int i) {
+    int16_t* const bands[] = {&near[i * kProcessBlock]};
+    int32_t level_out = mic_level;
+    WebRtcAgc_VirtualMic(agc, bands, 1, kProcessBlock, mic_level, &level_out);
+    mic_level = level_out;
+    uint8_t saturated = 0;
+    WebRtcAgc_Process(agc, bands, 1, kProcessBlock, bands, mic_level,
+                      &level_out, 0, &saturated);
+    mic_level = level_out;
+  }).Report("agc", "16khz_adaptive_digital");
+  WebRtcAgc_Free(agc);
+}
+
+void BenchmarkVad(int blocks) {
+  const std::vector<int16_t> near = MakeSignal(kProcessRateHz, blocks, 6000);
+
+  VadInst* vad = WebRtcVad_Create();
+  WebRtcVad_Init(vad);
+  WebRtcVad_set_mode(vad, 2);
+  Time(blocks, [&](int i) {
+    WebRtcVad_Process(vad, kProcessRateHz, &near[i * kProcessBlock],
+                      kProcessBlock);
+  }).Report("vad", "16khz_mode2");
+  WebRtcVad_Free(vad);
+
+  const std::vector<int16_t> capture = MakeSignal(kCaptureRateHz, blocks, 6000);
+  vad = WebRtcVad_Create();
+  WebRtcVad_Init(vad);
+  WebRtcVad_set_mode(vad, 2);
+  Time(blocks, [&](int i) {
+    WebRtcVad_Process(vad, kCaptureRateHz, &capture[i * kCaptureBlock],
+                      kCaptureBlock);
+  }).Report("vad", "48khz_mode2");
+  WebRtcVad_Free(vad);
+}
+
+void BenchmarkTransientSuppressor(int blocks) {
+  const std::vector<int16_t> near = MakeSignal(kProcessRateHz, blocks, 6000);
+  float data[kProcessBlock];
+
+  TransientSuppressor suppressor;
+  suppressor.Initialize(kProcessRateHz, kProcessRateHz, 1);
+  Time(blocks, [&](int i) {
+    std::copy(&near[i * kProcessBlock], &near[(i + 1) * kProcessBlock], data);
+    // Typing all the time, so suppression is enabled and not only detection.
+    suppressor.Suppress(data, kProcessBlock, 1, NULL, kProcessBlock, NULL, 0,
+                        1.f, true);
+  }).Report("transient_suppressor", "16khz_typing");
+}
+
+}  // namespace
+}  // namespace webrtc
+
+int main(int argc, char* argv[]) {
+  const int blocks = argc > 1 ? atoi(argv[1]) : webrtc::kDefaultBlocks;
+  if (blocks < 100) {
+    fprintf(stderr, "usage: %s [blocks >= 100]\n", argv[0]);
+    return 1;
+  }
+
+  printf("Timing %d blocks of 10 ms, values are {mean,spread} in us\n",
+         blocks);
+  webrtc::BenchmarkResampling(blocks);
+  webrtc::BenchmarkNsx(blocks);
+  webrtc::BenchmarkAecm(blocks);
+  webrtc::BenchmarkAecmLocking(blocks);
+  webrtc::BenchmarkAgc(blocks);
+  webrtc::BenchmarkVad(blocks);
+  webrtc::BenchmarkTransientSuppressor(blocks);
+  return 0;
+}
@@ -567,6 +567,23 @@ static void WebRtcNsx_InitNeon(void) {
 }
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// Initialize function pointers for x86, SSE2 is always available and AVX2 is
+// used if the CPU and OS support it.
+static void WebRtcNsx_InitX86(void) {
+  WebRtcNsx_SynthesisUpdate = WebRtcNsx_SynthesisUpdateSse2;
+  WebRtcNsx_AnalysisUpdate = WebRtcNsx_AnalysisUpdateSse2;
+  WebRtcNsx_Denormalize = WebRtcNsx_DenormalizeSse2;
+#if defined(WEBRTC_X86_AVX2)
+  if (WebRtc_GetCPUInfo(kAVX2)) {
+    WebRtcNsx_SynthesisUpdate = WebRtcNsx_SynthesisUpdateAvx2;
+    WebRtcNsx_AnalysisUpdate = WebRtcNsx_AnalysisUpdateAvx2;
+    WebRtcNsx_Denormalize = WebRtcNsx_DenormalizeAvx2;
+  }
+#endif
+}
+#endif
+
 #if defined(MIPS32_LE)
 // Initialize function pointers for MIPS platform.
 static void WebRtcNsx_InitMips(void) {
@@ -771,6 +788,10 @@ int32_t WebRtcNsx_InitCore(NoiseSuppressionFixedC* inst, uint32_t fs) {
   WebRtcNsx_InitNeon();
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+  WebRtcNsx_InitX86();
+#endif
+
 #if defined(MIPS32_LE)
   WebRtcNsx_InitMips();
 #endif
@@ -233,6 +233,33 @@ void WebRtcNsx_PrepareSpectrumNeon(NoiseSuppressionFixedC* inst,
                                    int16_t* freq_buff);
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// For the above function pointers, functions for generic platforms are declared
+// and defined as static in file nsx_core.c, while those for x86 platforms are
+// declared below and defined in files nsx_core_sse2.c and nsx_core_avx2.c.
+void WebRtcNsx_SynthesisUpdateSse2(NoiseSuppressionFixedC* inst,
+                                   int16_t* out_frame,
+                                   int16_t gain_factor);
+void WebRtcNsx_AnalysisUpdateSse2(NoiseSuppressionFixedC* inst,
+                                  int16_t* out,
+                                  int16_t* new_speech);
+void WebRtcNsx_DenormalizeSse2(NoiseSuppressionFixedC* inst,
+                               int16_t* in,
+                               int factor);
+
+#if defined(WEBRTC_X86_AVX2)
+void WebRtcNsx_SynthesisUpdateAvx2(NoiseSuppressionFixedC* inst,
+                                   int16_t* out_frame,
+                                   int16_t gain_factor);
+void WebRtcNsx_AnalysisUpdateAvx2(NoiseSuppressionFixedC* inst,
+                                  int16_t* out,
+                                  int16_t* new_speech);
+void WebRtcNsx_DenormalizeAvx2(NoiseSuppressionFixedC* inst,
+                               int16_t* in,
+                               int factor);
+#endif
+#endif
+
 #if defined(MIPS32_LE)
 // For the above function pointers, functions for generic platforms are declared
 // and defined as static in file nsx_core.c, while those for MIPS platforms
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/modules/audio_processing/ns/nsx_core.h"
+
+#include <assert.h>
+#include <immintrin.h>
+#include <string.h>
+
+// These are only selected if the CPU and OS support AVX2. The 256 bit
+// multiply, unpack and pack instructions all work within 128 bit lanes, so the
+// element order matches the SSE2 versions. All kernels are bit exact with the
+// generic C versions in nsx_core.c.
+
+// Computes WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(a, b, shift) for 16 values
+// and returns the 32 bit results in |low| and |high|.
+static inline void MulRound(__m256i a, __m256i b, int shift,
+                            __m256i* low, __m256i* high) {
+  const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const __m256i lo = _mm256_mullo_epi16(a, b);
+  const __m256i hi = _mm256_mulhi_epi16(a, b);
+  *low = _mm256_sra_epi32(
+      _mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), round), count);
+  *high = _mm256_sra_epi32(
+      _mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), round), count);
+}
+
+// Narrows 32 bit values to 16 bit like a cast to int16_t, i.e. without
+// saturation.
+static inline __m256i PackTruncate(__m256i low, __m256i high) {
+  low = _mm256_srai_epi32(_mm256_slli_epi32(low, 16), 16);
+  high = _mm256_srai_epi32(_mm256_slli_epi32(high, 16), 16);
+  return _mm256_packs_epi32(low, high);
+}
+
+void WebRtcNsx_AnalysisUpdateAvx2(NoiseSuppressionFixedC* inst,
+                                  int16_t* out,
+                                  int16_t* new_speech) {
+  size_t i = 0;
+  __m256i low, high;
+
+  assert(inst->anaLen % 16 == 0);
+
+  // For lower band update analysis buffer.
+  memmove(inst->analysisBuffer, inst->analysisBuffer + inst->blockLen10ms,
+      (inst->anaLen - inst->blockLen10ms) * sizeof(*inst->analysisBuffer));
+  memcpy(inst->analysisBuffer + inst->anaLen - inst->blockLen10ms, new_speech,
+      inst->blockLen10ms * sizeof(*inst->analysisBuffer));
+
+  // Window data before FFT.
+  for (i = 0; i < inst->anaLen; i += 16) {
+    const __m256i window =
+        _mm256_loadu_si256((const __m256i*)&inst->window[i]);
+    const __m256i data =
+        _mm256_loadu_si256((const __m256i*)&inst->analysisBuffer[i]);
+    MulRound(window, data, 14, &low, &high);
+    _mm256_storeu_si256((__m256i*)&out[i], PackTruncate(low, high));  // Q0
+  }
+}
+
+void WebRtcNsx_DenormalizeAvx2(NoiseSuppressionFixedC* inst,
+                               int16_t* in,
+                               int factor) {
+  size_t i = 0;
+  const int shift = factor - inst->normData;
+  const __m128i count = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+
+  assert(inst->anaLen % 16 == 0);
+
+  for (i = 0; i < inst->anaLen; i += 16) {
+    const __m256i data = _mm256_loadu_si256((const __m256i*)&in[i]);
+    __m256i low = _mm256_srai_epi32(_mm256_unpacklo_epi16(data, data), 16);
+    __m256i high = _mm256_srai_epi32(_mm256_unpackhi_epi16(data, data), 16);
+    if (shift >= 0) {
+      low = _mm256_sll_epi32(low, count);
+      high = _mm256_sll_epi32(high, count);
+    } else {
+      low = _mm256_sra_epi32(low, count);
+      high = _mm256_sra_epi32(high, count);
+    }
+    // Saturating pack, like WebRtcSpl_SatW32ToW16().
+    _mm256_storeu_si256((__m256i*)&inst->real[i],
+                        _mm256_packs_epi32(low, high));
+  }
+}
+
+void WebRtcNsx_SynthesisUpdateAvx2(NoiseSuppressionFixedC* inst,
+                                   int16_t* out_frame,
+                                   int16_t gain_factor) {
+  size_t i = 0;
+  const __m256i gain = _mm256_set1_epi16(gain_factor);
+  __m256i low, high;
+
+  assert(inst->anaLen % 16 == 0);
+
+  // synthesis
+  for (i = 0; i < inst->anaLen; i += 16) {
+    const __m256i window =
+        _mm256_loadu_si256((const __m256i*)&inst->window[i]);
+    const __m256i real =
+        _mm256_loadu_si256((const __m256i*)&inst->real[i]);
+    const __m256i synthesis =
+        _mm256_loadu_si256((const __m256i*)&inst->synthesisBuffer[i]);
+    __m256i windowed;
+
+    MulRound(window, real, 14, &low, &high);  // Q0, window in Q14
+    windowed = PackTruncate(low, high);
+    MulRound(windowed, gain, 13, &low, &high);  // Q0
+    _mm256_storeu_si256(
+        (__m256i*)&inst->synthesisBuffer[i],
+        _mm256_adds_epi16(synthesis, _mm256_packs_epi32(low, high)));
+  }
+
+  // read out fully processed segment
+  memcpy(out_frame, inst->synthesisBuffer,
+      inst->blockLen10ms * sizeof(*inst->synthesisBuffer));
+
+  // update synthesis buffer
+  memmove(inst->synthesisBuffer, inst->synthesisBuffer + inst->blockLen10ms,
+      (inst->anaLen - inst->blockLen10ms) * sizeof(*inst->synthesisBuffer));
+  memset(inst->synthesisBuffer + inst->anaLen - inst->blockLen10ms, 0,
+      inst->blockLen10ms * sizeof(*inst->synthesisBuffer));
+}
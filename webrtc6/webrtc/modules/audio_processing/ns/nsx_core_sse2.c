@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/modules/audio_processing/ns/nsx_core.h"
+
+#include <assert.h>
+#include <emmintrin.h>
+#include <string.h>
+
+// SSE2 is part of the x86-64 baseline and required by the build on 32 bit x86,
+// so these are used without runtime detection. All kernels are bit exact with
+// the generic C versions in nsx_core.c.
+
+// Computes WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(a, b, shift) for eight values
+// and returns the 32 bit results in |low| and |high|.
+static inline void MulRound(__m128i a, __m128i b, int shift,
+                            __m128i* low, __m128i* high) {
+  const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const __m128i lo = _mm_mullo_epi16(a, b);
+  const __m128i hi = _mm_mulhi_epi16(a, b);
+  *low = _mm_sra_epi32(
+      _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), count);
+  *high = _mm_sra_epi32(
+      _mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), count);
+}
+
+// Narrows 32 bit values to 16 bit like a cast to int16_t, i.e. without
+// saturation.
+static inline __m128i PackTruncate(__m128i low, __m128i high) {
+  low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+  high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+  return _mm_packs_epi32(low, high);
+}
+
+void WebRtcNsx_AnalysisUpdateSse2(NoiseSuppressionFixedC* inst,
+                                  int16_t* out,
+                                  int16_t* new_speech) {
+  size_t i = 0;
+  __m128i low, high;
+
+  assert(inst->anaLen % 8 == 0);
+
+  // For lower band update analysis buffer.
+  memmove(inst->analysisBuffer, inst->analysisBuffer + inst->blockLen10ms,
+      (inst->anaLen - inst->blockLen10ms) * sizeof(*inst->analysisBuffer));
+  memcpy(inst->analysisBuffer + inst->anaLen - inst->blockLen10ms, new_speech,
+      inst->blockLen10ms * sizeof(*inst->analysisBuffer));
+
+  // Window data before FFT.
+  for (i = 0; i < inst->anaLen; i += 8) {
+    const __m128i window = _mm_loadu_si128((const __m128i*)&inst->window[i]);
+    const __m128i data =
+        _mm_loadu_si128((const __m128i*)&inst->analysisBuffer[i]);
+    MulRound(window, data, 14, &low, &high);
+    _mm_storeu_si128((__m128i*)&out[i], PackTruncate(low, high));  // Q0
+  }
+}
+
+void WebRtcNsx_DenormalizeSse2(NoiseSuppressionFixedC* inst,
+                               int16_t* in,
+                               int factor) {
+  size_t i = 0;
+  const int shift = factor - inst->normData;
+  const __m128i count = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+
+  assert(inst->anaLen % 8 == 0);
+
+  for (i = 0; i < inst->anaLen; i += 8) {
+    const __m128i data = _mm_loadu_si128((const __m128i*)&in[i]);
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(data, data), 16);
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(data, data), 16);
+    if (shift >= 0) {
+      low = _mm_sll_epi32(low, count);
+      high = _mm_sll_epi32(high, count);
+    } else {
+      low = _mm_sra_epi32(low, count);
+      high = _mm_sra_epi32(high, count);
+    }
+    // Saturating pack, like WebRtcSpl_SatW32ToW16().
+    _mm_storeu_si128((__m128i*)&inst->real[i], _mm_packs_epi32(low, high));
+  }
+}
+
+void WebRtcNsx_SynthesisUpdateSse2(NoiseSuppressionFixedC* inst,
+                                   int16_t* out_frame,
+                                   int16_t gain_factor) {
+  size_t i = 0;
+  const __m128i gain = _mm_set1_epi16(gain_factor);
+  __m128i low, high;
+
+  assert(inst->anaLen % 8 == 0);
+
+  // synthesis
+  for (i = 0; i < inst->anaLen; i += 8) {
+    const __m128i window = _mm_loadu_si128((const __m128i*)&inst->window[i]);
+    const __m128i real = _mm_loadu_si128((const __m128i*)&inst->real[i]);
+    const __m128i synthesis =
+        _mm_loadu_si128((const __m128i*)&inst->synthesisBuffer[i]);
+    __m128i windowed;
+
+    MulRound(window, real, 14, &low, &high);  // Q0, window in Q14
+    windowed = PackTruncate(low, high);
+    MulRound(windowed, gain, 13, &low, &high);  // Q0
+    _mm_storeu_si128((__m128i*)&inst->synthesisBuffer[i],
+                     _mm_adds_epi16(synthesis, _mm_packs_epi32(low, high)));
+  }
+
+  // read out fully processed segment
+  memcpy(out_frame, inst->synthesisBuffer,
+      inst->blockLen10ms * sizeof(*inst->synthesisBuffer));
+
+  // update synthesis buffer
+  memmove(inst->synthesisBuffer, inst->synthesisBuffer + inst->blockLen10ms,
+      (inst->anaLen - inst->blockLen10ms) * sizeof(*inst->synthesisBuffer));
+  memset(inst->synthesisBuffer + inst->anaLen - inst->blockLen10ms, 0,
+      inst->blockLen10ms * sizeof(*inst->synthesisBuffer));
+}
@@ -24,7 +24,6 @@
 #include "webrtc/modules/audio_processing/transient/common.h"
 #include "webrtc/modules/audio_processing/transient/transient_detector.h"
 #include "webrtc/modules/audio_processing/ns/windows_private.h"
-#include "webrtc/system_wrappers/include/logging.h"
 #include "webrtc/typedefs.h"
 
 namespace webrtc {
@@ -294,18 +293,12 @@ void TransientSuppressor::UpdateKeypress(bool key_pressed) {
   keypress_counter_ = std::max(0, keypress_counter_ - 1);
 
   if (keypress_counter_ > kIsTypingThreshold) {
-    if (!suppression_enabled_) {
-      LOG(LS_INFO) << "[ts] Transient suppression is now enabled.";
-    }
     suppression_enabled_ = true;
     keypress_counter_ = 0;
   }
 
   if (detection_enabled_ &&
       ++chunks_since_keypress_ > kChunksUntilNotTyping) {
-    if (suppression_enabled_) {
-      LOG(LS_INFO) << "[ts] Transient suppression is now disabled.";
-    }
     detection_enabled_ = false;
     suppression_enabled_ = false;
     keypress_counter_ = 0;